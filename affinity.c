@@ -36,64 +36,98 @@ static const char *option = "taskset";
 #include <errno.h>
 
 
-static void check_cpu_affinity_range(
+static int check_cpu_affinity_range(
+	const char *opt_name,
 	const int32_t max_cpus,
 	const int32_t cpu)
 {
-	if ((cpu < 0) || ((max_cpus != -1) && (cpu >= max_cpus))) {
-		fprintf(stderr, "%s: invalid range, %" PRId32 " is not allowed, "
-			"allowed range: 0 to %" PRId32 "\n", option,
-			cpu, max_cpus - 1);
-		exit(EXIT_FAILURE);
+	const int32_t max = ((max_cpus == -1) || (max_cpus > CPU_SETSIZE)) ?
+		CPU_SETSIZE : max_cpus;
+
+	if ((cpu < 0) || (cpu >= max)) {
+		if (opt_name)
+			fprintf(stderr, "%s: invalid range, %" PRId32 " is not "
+				"allowed, allowed range: 0 to %" PRId32 "\n",
+				opt_name, cpu, max - 1);
+		return -1;
 	}
+	return 0;
 }
 
-static int get_cpu(char *const str)
+static int get_cpu(const char *opt_name, char *const str, int *cpu)
 {
-	int val;
-
-	if (sscanf(str, "%d", &val) != 1) {
-		fprintf(stderr, "%s: invalid number '%s'\n", option, str);
-		exit(EXIT_FAILURE);
+	if (sscanf(str, "%d", cpu) != 1) {
+		if (opt_name)
+			fprintf(stderr, "%s: invalid number '%s'\n",
+				opt_name, str);
+		return -1;
 	}
-	return val;
+	return 0;
 }
 
-int set_cpu_affinity(char *const arg)
+/*
+ *  stress_parse_cpulist()
+ *	parse a list of CPUs, e.g. 0,2-5,7 into a CPU set, returns
+ *	the number of CPUs in the set or -1 on an invalid list.
+ *	A NULL opt_name parses a list read from sysfs: errors are
+ *	not reported and numbers are not checked against the
+ *	configured CPUs, so node lists can be parsed too
+ */
+int stress_parse_cpulist(const char *opt_name, char *const arg, cpu_set_t *set)
 {
-	cpu_set_t set;
-	char *str, *token;
-	int32_t max_cpus = stress_get_processors_configured();
+	char *str, *token, *saveptr = NULL;
+	const int32_t max_cpus = opt_name ?
+		stress_get_processors_configured() : -1;
+	int n = 0;
 
-	CPU_ZERO(&set);
+	CPU_ZERO(set);
 
-	for (str = arg; (token = strtok(str, ",")) != NULL; str = NULL) {
+	for (str = arg; (token = strtok_r(str, ",\n", &saveptr)) != NULL; str = NULL) {
 		int i, lo, hi;
 		char *ptr = strstr(token, "-");
 
-		hi = lo = get_cpu(token);
+		if (get_cpu(opt_name, token, &lo) < 0)
+			return -1;
+		hi = lo;
 		if (ptr) {
 			ptr++;
-			if (*ptr)
-				hi = get_cpu(ptr);
-			else {
-				fprintf(stderr, "%s: expecting number following "
-					"'-' in '%s'\n", option, token);
-				exit(EXIT_FAILURE);
+			if (!*ptr) {
+				if (opt_name)
+					fprintf(stderr, "%s: expecting number "
+						"following '-' in '%s'\n",
+						opt_name, token);
+				return -1;
 			}
+			if (get_cpu(opt_name, ptr, &hi) < 0)
+				return -1;
 			if (hi <= lo) {
-				fprintf(stderr, "%s: invalid range in '%s' "
-					"(end value must be larger than "
-					"start value\n", option, token);
-				exit(EXIT_FAILURE);
+				if (opt_name)
+					fprintf(stderr, "%s: invalid range in "
+						"'%s' (end value must be larger "
+						"than start value\n",
+						opt_name, token);
+				return -1;
 			}
 		}
-		check_cpu_affinity_range(max_cpus, lo);
-		check_cpu_affinity_range(max_cpus, hi);
-
-		for (i = lo; i <= hi; i++)
-			CPU_SET(i, &set);
+		if ((check_cpu_affinity_range(opt_name, max_cpus, lo) < 0) ||
+		    (check_cpu_affinity_range(opt_name, max_cpus, hi) < 0))
+			return -1;
+
+		for (i = lo; i <= hi; i++) {
+			if (!CPU_ISSET(i, set))
+				n++;
+			CPU_SET(i, set);
+		}
 	}
+	return n;
+}
+
+int set_cpu_affinity(char *const arg)
+{
+	cpu_set_t set;
+
+	if (stress_parse_cpulist(option, arg, &set) < 0)
+		exit(EXIT_FAILURE);
 	if (sched_setaffinity(getpid(), sizeof(set), &set) < 0) {
 		pr_err(stderr, "%s: cannot set CPU affinity, errno=%d (%s)\n",
 			option, errno, strerror(errno));
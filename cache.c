@@ -326,6 +326,15 @@ static int add_cpu_cache_detail(cpu_cache_t *cache, const char *index_path)
 	 * way-based.
 	 */
 	cache->ways = contents ? atoi(contents) : 0;
+	if (contents) {
+		free(contents);
+		contents = NULL;
+	}
+
+	/* e.g. "0-3" or "0,4", the first CPU identifies the cache */
+	(void)snprintf(path, sizeof(path), "%s/shared_cpu_list", index_path);
+	contents = get_string_from_file(path);
+	cache->shared_cpu = contents ? atoi(contents) : -1;
 
 	ret = EXIT_SUCCESS;
 
@@ -526,6 +535,45 @@ err:
 	return ret;
 }
 
+/*
+ * get_cpu_topology()
+ * @cpu: cpu to fill in.
+ * @cpu_path: Full /sys path to cpu which will be represented by @cpu.
+ * Populate the CPU number, core, package and last level cache
+ * ids of @cpu, ids that cannot be read are set to -1.
+ */
+static void get_cpu_topology(cpu_t *cpu, const char *cpu_path)
+{
+	char     path[PATH_MAX];
+	char    *contents;
+	const char *name = strrchr(cpu_path, '/');
+	uint32_t i;
+	uint16_t level = 0;
+
+	cpu->id = name ? atoi(name + 4) : (int32_t)cpu->num;
+
+	(void)snprintf(path, sizeof(path), "%s/topology/core_id", cpu_path);
+	contents = get_string_from_file(path);
+	cpu->core_id = contents ? atoi(contents) : -1;
+	free(contents);
+
+	(void)snprintf(path, sizeof(path), "%s/topology/physical_package_id", cpu_path);
+	contents = get_string_from_file(path);
+	cpu->package_id = contents ? atoi(contents) : -1;
+	free(contents);
+
+	cpu->llc_id = -1;
+	for (i = 0; i < cpu->cache_count; i++) {
+		const cpu_cache_t *cache = &cpu->caches[i];
+
+		if ((cache->type != CACHE_TYPE_INSTRUCTION) &&
+		    (cache->level > level)) {
+			level = cache->level;
+			cpu->llc_id = cache->shared_cpu;
+		}
+	}
+}
+
 /*
  * get_all_cpu_cache_details()
  * Obtain information on all cpus caches on the system.
@@ -614,6 +662,7 @@ cpus_t * get_all_cpu_cache_details(void)
 			cpus = NULL;
 			goto out;
 		}
+		get_cpu_topology(&cpus->cpus[i], results[i]);
 	}
 
 out:
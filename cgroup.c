@@ -0,0 +1,672 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+static const char *option = "cgroup";
+
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+typedef enum {
+	CGROUP_NONE = 0,
+	CGROUP_STRESSOR,	/* a group for each stressor */
+	CGROUP_INSTANCE,	/* a group for each instance */
+} cgroup_mode_t;
+
+/* Throttling counters of one group */
+typedef struct {
+	uint64_t nr_periods;	/* cpu.stat enforcement periods */
+	uint64_t nr_throttled;	/* cpu.stat periods throttled */
+	uint64_t throttled_usec;/* cpu.stat time throttled */
+	uint64_t mem_high;	/* memory.events over memory.high */
+	uint64_t mem_max;	/* memory.events hits of memory.max */
+	uint64_t oom_kill;	/* memory.events OOM kills */
+	uint64_t mem_peak;	/* memory.peak, 0 = not available */
+} cgroup_stat_t;
+
+static cgroup_mode_t opt_cgroup = CGROUP_NONE;
+static char opt_cgroup_cpu_max[32];	/* cpu.max, "" = not set */
+static uint64_t opt_cgroup_memory_max;	/* memory.max, 0 = not set */
+static char opt_cgroup_io_max[128];	/* io.max without device, "" = not set */
+static char cgroup_base[PATH_MAX];	/* the run's group, "" = disabled */
+static char cgroup_io_dev[32];		/* major:minor of the temp path disk */
+
+/*
+ *  stress_set_cgroup()
+ *	set whether each stressor or each instance gets a group
+ */
+int stress_set_cgroup(const char *name)
+{
+	if (!strcmp(name, "stressor"))
+		opt_cgroup = CGROUP_STRESSOR;
+	else if (!strcmp(name, "instance"))
+		opt_cgroup = CGROUP_INSTANCE;
+	else {
+		fprintf(stderr, "%s must be one of: stressor instance\n", option);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_set_cgroup_cpu_max()
+ *	set cpu.max from QUOTA[/PERIOD] in microseconds, or max
+ */
+int stress_set_cgroup_cpu_max(const char *str)
+{
+	uint64_t quota, period = 100000;
+	char extra;
+
+	if (opt_cgroup == CGROUP_NONE)
+		opt_cgroup = CGROUP_STRESSOR;
+	if (!strcmp(str, "max")) {
+		(void)snprintf(opt_cgroup_cpu_max, sizeof(opt_cgroup_cpu_max), "max");
+		return 0;
+	}
+	if ((sscanf(str, "%" SCNu64 "/%" SCNu64 "%c", &quota, &period, &extra) != 2) &&
+	    (sscanf(str, "%" SCNu64 "%c", &quota, &extra) != 1)) {
+		fprintf(stderr, "cgroup-cpu-max must be QUOTA[/PERIOD] "
+			"in microseconds or max\n");
+		return -1;
+	}
+	check_range("cgroup-cpu-max period", period, 1000, 1000000);
+	check_range("cgroup-cpu-max quota", quota, 1000, 1000000ULL * 1024);
+	(void)snprintf(opt_cgroup_cpu_max, sizeof(opt_cgroup_cpu_max),
+		"%" PRIu64 " %" PRIu64, quota, period);
+	return 0;
+}
+
+/*
+ *  stress_set_cgroup_memory_max()
+ *	set memory.max in bytes
+ */
+void stress_set_cgroup_memory_max(const char *optarg)
+{
+	if (opt_cgroup == CGROUP_NONE)
+		opt_cgroup = CGROUP_STRESSOR;
+	opt_cgroup_memory_max = get_uint64_byte(optarg);
+	check_range("cgroup-memory-max", opt_cgroup_memory_max,
+		MIN_CGROUP_MEMORY_MAX, MAX_CGROUP_MEMORY_MAX);
+}
+
+/*
+ *  stress_set_cgroup_io_max()
+ *	set the io.max limits of the disk holding the temp path,
+ *	a comma separated list of rbps, wbps, riops and wiops
+ */
+int stress_set_cgroup_io_max(const char *str)
+{
+	static const char *keys[] = { "rbps", "wbps", "riops", "wiops" };
+	char buf[sizeof(opt_cgroup_io_max)], *tok, *saveptr = NULL;
+	size_t used = 0;
+
+	if (opt_cgroup == CGROUP_NONE)
+		opt_cgroup = CGROUP_STRESSOR;
+	if (strlen(str) >= sizeof(buf))
+		goto err;
+	(void)strcpy(buf, str);
+	for (tok = strtok_r(buf, ",", &saveptr); tok;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		char *eq = strchr(tok, '='), val[32];
+		size_t i;
+
+		if (!eq)
+			goto err;
+		*eq = '\0';
+		for (i = 0; i < SIZEOF_ARRAY(keys); i++)
+			if (!strcmp(tok, keys[i]))
+				break;
+		if (i == SIZEOF_ARRAY(keys))
+			goto err;
+		/* io.max takes plain numbers, so expand any k, m or g suffix */
+		if (strcmp(eq + 1, "max"))
+			(void)snprintf(val, sizeof(val), "%" PRIu64,
+				get_uint64_byte(eq + 1));
+		else
+			(void)snprintf(val, sizeof(val), "max");
+		used += (size_t)snprintf(opt_cgroup_io_max + used,
+			sizeof(opt_cgroup_io_max) - used, "%s%s=%s",
+			used ? " " : "", tok, val);
+		if (used >= sizeof(opt_cgroup_io_max))
+			goto err;
+	}
+	if (used)
+		return 0;
+err:
+	fprintf(stderr, "cgroup-io-max must be a comma separated list of "
+		"rbps=N, wbps=N, riops=N and wiops=N\n");
+	return -1;
+}
+
+/*
+ *  cgroup_write()
+ *	write a value to a file of a group
+ */
+static int cgroup_write(const char *dir, const char *file, const char *val)
+{
+	char path[PATH_MAX];
+	int fd, ret = 0;
+
+	if (snprintf(path, sizeof(path), "%s/%s", dir, file) >= (int)sizeof(path))
+		return -ENAMETOOLONG;
+	if ((fd = open(path, O_WRONLY)) < 0)
+		return -errno;
+	if (write(fd, val, strlen(val)) < 0)
+		ret = -errno;
+	(void)close(fd);
+	return ret;
+}
+
+/*
+ *  cgroup_path()
+ *	find the cgroup v2 directory this process is in from
+ *	the cgroup2 mount and the 0:: line of /proc/self/cgroup
+ */
+static int cgroup_path(char *path, const size_t len)
+{
+	char buf[PATH_MAX + 64], mnt[PATH_MAX] = "", self[PATH_MAX] = "";
+	FILE *fp;
+
+	if ((fp = fopen("/proc/mounts", "r")) == NULL)
+		return -1;
+	while (fgets(buf, sizeof(buf), fp)) {
+		char dev[64], dir[PATH_MAX], type[64];
+
+		if ((sscanf(buf, "%63s %4095s %63s", dev, dir, type) == 3) &&
+		    !strcmp(type, "cgroup2")) {
+			(void)snprintf(mnt, sizeof(mnt), "%s", dir);
+			break;
+		}
+	}
+	(void)fclose(fp);
+
+	if ((fp = fopen("/proc/self/cgroup", "r")) == NULL)
+		return -1;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (!strncmp(buf, "0::", 3)) {
+			buf[strcspn(buf, "\n")] = '\0';
+			if (snprintf(self, sizeof(self), "%s", buf + 3) >= (int)sizeof(self))
+				*self = '\0';
+			break;
+		}
+	}
+	(void)fclose(fp);
+
+	if (!*mnt || !*self)
+		return -1;
+	if (snprintf(path, len, "%s%s", mnt, strcmp(self, "/") ? self : "") >= (int)len)
+		return -1;
+	return 0;
+}
+
+/*
+ *  stress_cgroup_self()
+ *	the cgroup v2 directory of the calling process,
+ *	returns -1 if there is no cgroup v2 hierarchy
+ */
+int stress_cgroup_self(char *path, const size_t len)
+{
+	return cgroup_path(path, len);
+}
+
+/*
+ *  cgroup_io_device()
+ *	io.max only takes whole disks, find the disk holding the
+ *	temp path, going up from a partition to its disk
+ */
+static int cgroup_io_device(void)
+{
+	char path[PATH_MAX], real[PATH_MAX], buf[32];
+	struct stat st;
+	FILE *fp;
+
+	if (stat(stress_get_temp_path(), &st) < 0)
+		return -1;
+	(void)snprintf(cgroup_io_dev, sizeof(cgroup_io_dev), "%u:%u",
+		major(st.st_dev), minor(st.st_dev));
+	(void)snprintf(path, sizeof(path), "/sys/dev/block/%s/partition",
+		cgroup_io_dev);
+	if (access(path, R_OK) < 0)
+		return 0;
+	(void)snprintf(path, sizeof(path), "/sys/dev/block/%s", cgroup_io_dev);
+	if (!realpath(path, real))
+		return -1;
+	(void)snprintf(path, sizeof(path), "%s/dev", dirname(real));
+	if ((fp = fopen(path, "r")) == NULL)
+		return -1;
+	if (!fgets(buf, sizeof(buf), fp)) {
+		(void)fclose(fp);
+		return -1;
+	}
+	(void)fclose(fp);
+	buf[strcspn(buf, "\n")] = '\0';
+	(void)snprintf(cgroup_io_dev, sizeof(cgroup_io_dev), "%s", buf);
+	return 0;
+}
+
+/*
+ *  stress_cgroup_init()
+ *	create the group of this run under the group stress-ng is
+ *	in and enable the cpu, memory and io controllers for the
+ *	stressor groups. Called once by the parent
+ */
+void stress_cgroup_init(void)
+{
+	static const char *controllers[] = { "cpu", "memory", "io" };
+	char parent[PATH_MAX];
+	size_t i;
+
+	if (opt_cgroup == CGROUP_NONE)
+		return;
+	if (cgroup_path(parent, sizeof(parent)) < 0) {
+		pr_inf(stderr, "%s: no cgroup v2 hierarchy found, stressors "
+			"will not be put into groups\n", option);
+		return;
+	}
+	if (snprintf(cgroup_base, sizeof(cgroup_base), "%s/%s-%d",
+		     parent, app_name, getpid()) >= (int)sizeof(cgroup_base)) {
+		pr_inf(stderr, "%s: cgroup path under %s is too long, stressors "
+			"will not be put into groups\n", option, parent);
+		*cgroup_base = '\0';
+		return;
+	}
+	if ((mkdir(cgroup_base, 0755) < 0) && (errno != EEXIST)) {
+		pr_inf(stderr, "%s: cannot create %s, errno=%d (%s), stressors "
+			"will not be put into groups\n", option, cgroup_base,
+			errno, strerror(errno));
+		*cgroup_base = '\0';
+		return;
+	}
+
+	/*
+	 *  Controllers are enabled top down. The parent refuses if
+	 *  it is not the root and has processes in it, in which case
+	 *  only controllers it already passes down can be used
+	 */
+	for (i = 0; i < SIZEOF_ARRAY(controllers); i++) {
+		char ctrl[16];
+		int ret;
+
+		(void)snprintf(ctrl, sizeof(ctrl), "+%s", controllers[i]);
+		(void)cgroup_write(parent, "cgroup.subtree_control", ctrl);
+		ret = cgroup_write(cgroup_base, "cgroup.subtree_control", ctrl);
+		if (ret < 0)
+			pr_dbg(stderr, "%s: cannot enable the %s controller, "
+				"errno=%d (%s)\n", option, controllers[i],
+				-ret, strerror(-ret));
+	}
+	if (*opt_cgroup_io_max && (cgroup_io_device() < 0)) {
+		pr_inf(stderr, "%s: cannot find the disk of the temp path, "
+			"io.max will not be set\n", option);
+		*opt_cgroup_io_max = '\0';
+	}
+	pr_dbg(stderr, "%s: stressors run in groups under %s\n",
+		option, cgroup_base);
+}
+
+/*
+ *  cgroup_leaf()
+ *	path of the group of a stressor or of one of its instances,
+ *	returns -1 if the path does not fit
+ */
+static int cgroup_leaf(
+	char *path,
+	const size_t len,
+	const char *name,
+	const uint32_t instance)
+{
+	int n;
+
+	if (opt_cgroup == CGROUP_INSTANCE)
+		n = snprintf(path, len, "%s/%s-%" PRIu32,
+			cgroup_base, name, instance);
+	else
+		n = snprintf(path, len, "%s/%s", cgroup_base, name);
+	return ((n < 0) || ((size_t)n >= len)) ? -1 : 0;
+}
+
+/*
+ *  stress_cgroup_leaf()
+ *	path of the group an instance of a stressor runs in,
+ *	returns -1 if stressors are not put into groups
+ */
+int stress_cgroup_leaf(
+	char *path,
+	const size_t len,
+	const char *name,
+	const uint32_t instance)
+{
+	if (!*cgroup_base)
+		return -1;
+	return cgroup_leaf(path, len, name, instance);
+}
+
+/*
+ *  cgroup_limit()
+ *	set a limit on a group, a failure is reported once per run
+ */
+static void cgroup_limit(const char *leaf, const char *file, const char *val)
+{
+	const int ret = cgroup_write(leaf, file, val);
+
+	if ((ret < 0) && warn_once(WARN_ONCE_CGROUP))
+		pr_inf(stderr, "%s: cannot set %s to '%s', errno=%d (%s), "
+			"is the controller enabled?\n", option, file, val,
+			-ret, strerror(-ret));
+}
+
+/*
+ *  stress_cgroup_enter()
+ *	move the calling stressor instance into its group, the
+ *	first instance to get here creates it and sets the limits
+ */
+void stress_cgroup_enter(const char *name, const uint32_t instance)
+{
+	char leaf[PATH_MAX], buf[64];
+	int ret;
+
+	if (!*cgroup_base)
+		return;
+	if (cgroup_leaf(leaf, sizeof(leaf), name, instance) < 0) {
+		pr_dbg(stderr, "%s: group path for %s is too long\n",
+			option, name);
+		return;
+	}
+	if (mkdir(leaf, 0755) == 0) {
+		if (*opt_cgroup_cpu_max)
+			cgroup_limit(leaf, "cpu.max", opt_cgroup_cpu_max);
+		if (opt_cgroup_memory_max) {
+			(void)snprintf(buf, sizeof(buf), "%" PRIu64,
+				opt_cgroup_memory_max);
+			cgroup_limit(leaf, "memory.max", buf);
+		}
+		if (*opt_cgroup_io_max) {
+			char io[sizeof(opt_cgroup_io_max) + sizeof(cgroup_io_dev) + 1];
+
+			(void)snprintf(io, sizeof(io), "%s %s",
+				cgroup_io_dev, opt_cgroup_io_max);
+			cgroup_limit(leaf, "io.max", io);
+		}
+	} else if (errno != EEXIST) {
+		pr_dbg(stderr, "%s: cannot create %s, errno=%d (%s)\n",
+			option, leaf, errno, strerror(errno));
+		return;
+	}
+	ret = cgroup_write(leaf, "cgroup.procs", "0");
+	if (ret < 0)
+		pr_dbg(stderr, "%s: cannot join %s, errno=%d (%s)\n",
+			option, leaf, -ret, strerror(-ret));
+}
+
+/*
+ *  cgroup_fopen()
+ *	open a file of a group for reading, NULL if the
+ *	path does not fit or the file cannot be opened
+ */
+static FILE *cgroup_fopen(const char *leaf, const char *file)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/%s", leaf, file) >= (int)sizeof(path))
+		return NULL;
+	return fopen(path, "r");
+}
+
+/*
+ *  cgroup_stat()
+ *	read the throttling counters of a group, false if the
+ *	group has none of them
+ */
+static bool cgroup_stat(const char *leaf, cgroup_stat_t *cs)
+{
+	char buf[128];
+	FILE *fp;
+	bool ok = false;
+
+	memset(cs, 0, sizeof(*cs));
+	if ((fp = cgroup_fopen(leaf, "cpu.stat")) != NULL) {
+		while (fgets(buf, sizeof(buf), fp)) {
+			(void)sscanf(buf, "nr_periods %" SCNu64, &cs->nr_periods);
+			(void)sscanf(buf, "nr_throttled %" SCNu64, &cs->nr_throttled);
+			(void)sscanf(buf, "throttled_usec %" SCNu64, &cs->throttled_usec);
+		}
+		(void)fclose(fp);
+		ok = true;
+	}
+	if ((fp = cgroup_fopen(leaf, "memory.events")) != NULL) {
+		while (fgets(buf, sizeof(buf), fp)) {
+			(void)sscanf(buf, "high %" SCNu64, &cs->mem_high);
+			(void)sscanf(buf, "max %" SCNu64, &cs->mem_max);
+			(void)sscanf(buf, "oom_kill %" SCNu64, &cs->oom_kill);
+		}
+		(void)fclose(fp);
+		ok = true;
+	}
+	if ((fp = cgroup_fopen(leaf, "memory.peak")) != NULL) {
+		if (fgets(buf, sizeof(buf), fp))
+			(void)sscanf(buf, "%" SCNu64, &cs->mem_peak);
+		(void)fclose(fp);
+	}
+	return ok;
+}
+
+/*
+ *  stress_cgroup_dump()
+ *	report the CPU throttling and memory limit events of
+ *	each group after the run
+ */
+void stress_cgroup_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+	bool header = false;
+
+	if (!*cgroup_base)
+		return;
+
+	pr_yaml(yaml, "cgroups:\n");
+	json_array_begin(json, "cgroups");
+	for (i = 0; i < STRESS_MAX; i++) {
+		const char *munged;
+		int32_t j, n;
+
+		if (!procs[i].started_procs)
+			continue;
+		munged = munge_underscore(stressors[i].name);
+		n = (opt_cgroup == CGROUP_INSTANCE) ? procs[i].started_procs : 1;
+		for (j = 0; j < n; j++) {
+			char leaf[PATH_MAX], group[16];
+			cgroup_stat_t cs;
+
+			if (cgroup_leaf(leaf, sizeof(leaf), munged, (uint32_t)j) < 0)
+				continue;
+			if (!cgroup_stat(leaf, &cs))
+				continue;
+			if (opt_cgroup == CGROUP_INSTANCE)
+				(void)snprintf(group, sizeof(group), "%" PRId32, j);
+			else
+				(void)snprintf(group, sizeof(group), "all");
+			if (!header) {
+				pr_inf(stdout, "%-13s %5s %9s %9s %12s %8s %8s %8s %9s\n",
+					"cgroup", "inst", "periods", "throttled",
+					"throttle ms", "mem high", "mem max",
+					"oom kill", "peak MB");
+				header = true;
+			}
+			pr_inf(stdout, "%-13s %5s %9" PRIu64 " %9" PRIu64
+				" %12.1f %8" PRIu64 " %8" PRIu64 " %8" PRIu64
+				" %9.1f\n", munged, group, cs.nr_periods,
+				cs.nr_throttled, (double)cs.throttled_usec / 1000.0,
+				cs.mem_high, cs.mem_max, cs.oom_kill,
+				(double)cs.mem_peak / (double)MB);
+
+			pr_yaml(yaml, "    - stressor: %s\n", munged);
+			pr_yaml(yaml, "      instance: %s\n", group);
+			pr_yaml(yaml, "      nr-periods: %" PRIu64 "\n", cs.nr_periods);
+			pr_yaml(yaml, "      nr-throttled: %" PRIu64 "\n", cs.nr_throttled);
+			pr_yaml(yaml, "      throttled-usec: %" PRIu64 "\n", cs.throttled_usec);
+			pr_yaml(yaml, "      memory-high-events: %" PRIu64 "\n", cs.mem_high);
+			pr_yaml(yaml, "      memory-max-events: %" PRIu64 "\n", cs.mem_max);
+			pr_yaml(yaml, "      oom-kills: %" PRIu64 "\n", cs.oom_kill);
+			pr_yaml(yaml, "      memory-peak: %" PRIu64 "\n", cs.mem_peak);
+
+			json_obj_begin(json, NULL);
+			json_str(json, "stressor", munged);
+			json_str(json, "instance", group);
+			json_uint(json, "nr-periods", cs.nr_periods);
+			json_uint(json, "nr-throttled", cs.nr_throttled);
+			json_uint(json, "throttled-usec", cs.throttled_usec);
+			json_uint(json, "memory-high-events", cs.mem_high);
+			json_uint(json, "memory-max-events", cs.mem_max);
+			json_uint(json, "oom-kills", cs.oom_kill);
+			json_uint(json, "memory-peak", cs.mem_peak);
+			json_obj_end(json);
+		}
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+}
+
+/*
+ *  stress_cgroup_free()
+ *	remove the groups once all the stressors have been reaped
+ */
+void stress_cgroup_free(void)
+{
+	DIR *dir;
+	struct dirent *d;
+
+	if (!*cgroup_base)
+		return;
+	if ((dir = opendir(cgroup_base)) != NULL) {
+		while ((d = readdir(dir)) != NULL) {
+			char path[PATH_MAX];
+
+			if ((d->d_type != DT_DIR) || (d->d_name[0] == '.'))
+				continue;
+			if (snprintf(path, sizeof(path), "%s/%s", cgroup_base,
+				     d->d_name) >= (int)sizeof(path))
+				continue;
+			if (rmdir(path) < 0)
+				pr_dbg(stderr, "%s: cannot remove %s, errno=%d (%s)\n",
+					option, path, errno, strerror(errno));
+		}
+		(void)closedir(dir);
+	}
+	(void)rmdir(cgroup_base);
+	*cgroup_base = '\0';
+}
+
+#else
+int stress_set_cgroup(const char *name)
+{
+	(void)name;
+
+	fprintf(stderr, "%s: cgroups not supported\n", option);
+	return -1;
+}
+
+int stress_set_cgroup_cpu_max(const char *str)
+{
+	return stress_set_cgroup(str);
+}
+
+void stress_set_cgroup_memory_max(const char *optarg)
+{
+	(void)optarg;
+}
+
+int stress_set_cgroup_io_max(const char *str)
+{
+	return stress_set_cgroup(str);
+}
+
+int stress_cgroup_self(char *path, const size_t len)
+{
+	(void)path;
+	(void)len;
+
+	return -1;
+}
+
+void stress_cgroup_init(void)
+{
+}
+
+void stress_cgroup_enter(const char *name, const uint32_t instance)
+{
+	(void)name;
+	(void)instance;
+}
+
+int stress_cgroup_leaf(
+	char *path,
+	const size_t len,
+	const char *name,
+	const uint32_t instance)
+{
+	(void)path;
+	(void)len;
+	(void)name;
+	(void)instance;
+
+	return -1;
+}
+
+void stress_cgroup_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	(void)yaml;
+	(void)json;
+	(void)stressors;
+	(void)procs;
+}
+
+void stress_cgroup_free(void)
+{
+}
+#endif
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "stress-ng.h"
+
+static const char *option = "compare";
+
+#define COMPARE_RATE_KEY	"bogo-ops-per-second-real-time"
+
+/* a numeric per stressor value of the metrics or perfstats YAML */
+typedef struct {
+	char section[16];		/* metrics or perfstats */
+	char stressor[64];
+	char key[64];
+	double value;
+} compare_value_t;
+
+typedef struct {
+	compare_value_t *values;
+	size_t count;
+	size_t size;
+} compare_set_t;
+
+static const char *compare_file;		/* baseline YAML file */
+static uint64_t compare_threshold = DEFAULT_COMPARE_THRESHOLD;
+static compare_set_t compare_baseline;
+
+/*
+ *  stress_set_compare()
+ *	compare the run against a YAML file saved by --yaml
+ */
+void stress_set_compare(const char *optarg)
+{
+	compare_file = optarg;
+	opt_flags |= OPT_FLAGS_METRICS;
+}
+
+/*
+ *  stress_set_compare_threshold()
+ *	set the % drop in bogo ops/s that is a regression
+ */
+void stress_set_compare_threshold(const char *optarg)
+{
+	compare_threshold = get_uint64(optarg);
+	check_range("compare-threshold", compare_threshold,
+		MIN_COMPARE_THRESHOLD, MAX_COMPARE_THRESHOLD);
+}
+
+/*
+ *  stress_compare_enabled()
+ *	true if the run is compared to a baseline
+ */
+bool stress_compare_enabled(void)
+{
+	return compare_file != NULL;
+}
+
+/*
+ *  compare_strip()
+ *	copy the text after "key: " up to the end of the line
+ */
+static void compare_strip(char *dst, const size_t len, const char *src)
+{
+	size_t n = strcspn(src, "\r\n");
+
+	if (n >= len)
+		n = len - 1;
+	memcpy(dst, src, n);
+	dst[n] = '\0';
+}
+
+/*
+ *  compare_load()
+ *	read the numeric per stressor values of the metrics and
+ *	perfstats sections of stress-ng YAML output, nested
+ *	lists such as the misc-metrics are skipped
+ */
+static int compare_load(FILE *fp, compare_set_t *set)
+{
+	char buf[4096], section[16] = "", stressor[64] = "";
+
+	while (fgets(buf, sizeof(buf), fp)) {
+		compare_value_t *v;
+		char *colon, *end;
+		double value;
+
+		if (*buf == '\n')
+			continue;
+		if ((*buf != ' ') && (*buf != '-') && (*buf != '.')) {
+			/* A new top level section */
+			colon = strchr(buf, ':');
+			*stressor = '\0';
+			*section = '\0';
+			if (colon && ((size_t)(colon - buf) < sizeof(section))) {
+				*colon = '\0';
+				(void)strcpy(section, buf);
+			}
+			continue;
+		}
+		if (strcmp(section, "metrics") && strcmp(section, "perfstats"))
+			continue;
+		if (!strncmp(buf, "    - stressor: ", 16)) {
+			compare_strip(stressor, sizeof(stressor), buf + 16);
+			continue;
+		}
+		if (!*stressor || strncmp(buf, "      ", 6) || (buf[6] == ' '))
+			continue;
+		colon = strstr(buf + 6, ": ");
+		if (!colon)
+			continue;
+		*colon = '\0';
+		value = strtod(colon + 2, &end);
+		if ((end == colon + 2) || ((*end != '\n') && (*end != '\0')))
+			continue;
+
+		if (set->count == set->size) {
+			const size_t size = set->size ? set->size * 2 : 256;
+			compare_value_t *values;
+
+			values = realloc(set->values, size * sizeof(*values));
+			if (!values)
+				return -1;
+			set->values = values;
+			set->size = size;
+		}
+		v = &set->values[set->count++];
+		(void)strcpy(v->section, section);
+		(void)strcpy(v->stressor, stressor);
+		compare_strip(v->key, sizeof(v->key), buf + 6);
+		v->value = value;
+	}
+	return 0;
+}
+
+/*
+ *  compare_find()
+ *	find a value in a set, NULL if it is not there
+ */
+static const compare_value_t *compare_find(
+	const compare_set_t *set,
+	const compare_value_t *v)
+{
+	size_t i;
+
+	for (i = 0; i < set->count; i++) {
+		const compare_value_t *b = &set->values[i];
+
+		if (!strcmp(b->key, v->key) &&
+		    !strcmp(b->stressor, v->stressor) &&
+		    !strcmp(b->section, v->section))
+			return b;
+	}
+	return NULL;
+}
+
+/*
+ *  compare_ran()
+ *	true if the stressor of a metrics value ran, the metrics
+ *	list every stressor unless --metrics-brief is used
+ */
+static bool compare_ran(const compare_set_t *set, const compare_value_t *v)
+{
+	compare_value_t wall = *v;
+	const compare_value_t *w;
+
+	(void)strcpy(wall.key, "wall-clock-time");
+	w = compare_find(set, &wall);
+	return w && (w->value > 0.0);
+}
+
+/*
+ *  stress_compare_init()
+ *	load the baseline before the run so a bad file fails early
+ */
+int stress_compare_init(void)
+{
+	FILE *fp;
+	int ret;
+
+	if (!compare_file)
+		return 0;
+	fp = fopen(compare_file, "r");
+	if (!fp) {
+		pr_err(stderr, "%s: cannot open %s: errno=%d (%s)\n",
+			option, compare_file, errno, strerror(errno));
+		return -1;
+	}
+	ret = compare_load(fp, &compare_baseline);
+	(void)fclose(fp);
+	if (ret < 0) {
+		pr_err(stderr, "%s: out of memory reading %s\n",
+			option, compare_file);
+		return -1;
+	}
+	if (!compare_baseline.count) {
+		pr_err(stderr, "%s: no metrics found in %s, it must be the "
+			"output of --yaml with --metrics\n", option, compare_file);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_compare()
+ *	compare the YAML output of this run to the baseline, the
+ *	bogo ops/s of each stressor in both are reported and any
+ *	perf metric that moved by more than the threshold. Returns
+ *	the number of stressors that regressed beyond the threshold
+ */
+int stress_compare(FILE *yaml)
+{
+	compare_set_t current;
+	size_t i;
+	int regressions = 0;
+	bool header = false;
+
+	if (!compare_file || !yaml)
+		return 0;
+
+	memset(&current, 0, sizeof(current));
+	fflush(yaml);
+	rewind(yaml);
+	if (compare_load(yaml, &current) < 0) {
+		pr_err(stderr, "%s: out of memory reading the run results\n",
+			option);
+		free(current.values);
+		return 0;
+	}
+
+	for (i = 0; i < current.count; i++) {
+		const compare_value_t *v = &current.values[i];
+		const compare_value_t *b;
+		double delta;
+		bool regressed;
+
+		if (strcmp(v->section, "metrics") || strcmp(v->key, COMPARE_RATE_KEY) ||
+		    !compare_ran(&current, v))
+			continue;
+		b = compare_find(&compare_baseline, v);
+		if (b && !compare_ran(&compare_baseline, b))
+			b = NULL;
+		if (!header) {
+			pr_inf(stdout, "%s: %-13s %14s %14s %9s\n", option,
+				"stressor", "baseline ops/s", "ops/s", "change");
+			header = true;
+		}
+		if (!b || (b->value <= 0.0)) {
+			pr_inf(stdout, "%s: %-13s %14s %14.2f %9s\n", option,
+				v->stressor, "-", v->value, "no base");
+			continue;
+		}
+		delta = 100.0 * (v->value - b->value) / b->value;
+		regressed = delta < -(double)compare_threshold;
+		if (regressed)
+			regressions++;
+		pr_inf(stdout, "%s: %-13s %14.2f %14.2f %+8.2f%%%s\n", option,
+			v->stressor, b->value, v->value, delta,
+			regressed ? " regression" : "");
+	}
+
+	/* Perf metrics only inform, which way is better depends on the metric */
+	for (header = false, i = 0; i < current.count; i++) {
+		const compare_value_t *v = &current.values[i];
+		const compare_value_t *b;
+		double delta;
+		size_t len = strlen(v->key);
+
+		if (strcmp(v->section, "perfstats") || !strcmp(v->key, "duration") ||
+		    ((len > 6) && !strcmp(v->key + len - 6, "_total")))
+			continue;
+		b = compare_find(&compare_baseline, v);
+		if (!b || (b->value == 0.0))
+			continue;
+		delta = 100.0 * (v->value - b->value) / fabs(b->value);
+		if (fabs(delta) <= (double)compare_threshold)
+			continue;
+		if (!header) {
+			pr_inf(stdout, "%s: perf metrics that changed by more "
+				"than %" PRIu64 "%%:\n", option, compare_threshold);
+			header = true;
+		}
+		pr_inf(stdout, "%s: %-13s %-40s %14.3f %14.3f %+8.2f%%\n",
+			option, v->stressor, v->key, b->value, v->value, delta);
+	}
+
+	if (regressions)
+		pr_inf(stdout, "%s: %d stressor%s regressed by more than %"
+			PRIu64 "%% against %s\n", option, regressions,
+			regressions == 1 ? "" : "s", compare_threshold,
+			compare_file);
+	free(current.values);
+
+	return regressions;
+}
+
+/*
+ *  stress_compare_free()
+ *	free the baseline
+ */
+void stress_compare_free(void)
+{
+	free(compare_baseline.values);
+	compare_baseline.values = NULL;
+	compare_baseline.count = 0;
+	compare_baseline.size = 0;
+}
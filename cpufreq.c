@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "stress-ng.h"
+
+#if defined(STRESS_CPUFREQ)
+
+#define CPUFREQ_SYSFS	"/sys/devices/system/cpu"
+
+static uint32_t cpufreq_cstates;	/* idle states of CPU 0 */
+static char cpufreq_cstate_name[STRESS_CPUFREQ_CSTATES_MAX][16];
+
+/* Run start values of the instance, per thread for --threads */
+static __thread int cpufreq_fd_cycles = -1;
+static __thread int cpufreq_fd_ref = -1;
+static __thread uint64_t cpufreq_cycles;
+static __thread uint64_t cpufreq_ref;
+static __thread double cpufreq_cpu_time;
+static __thread double cpufreq_wall;
+static __thread double cpufreq_khz;
+static __thread uint64_t cpufreq_idle[STRESS_CPUFREQ_CSTATES_MAX];
+static __thread cpu_set_t cpufreq_cpus;
+
+/*
+ *  cpufreq_init()
+ *	gather the idle state names, these are the same
+ *	on all CPUs as they come from the one cpuidle driver
+ */
+void cpufreq_init(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < STRESS_CPUFREQ_CSTATES_MAX; i++) {
+		char path[PATH_MAX];
+		char *name = cpufreq_cstate_name[i];
+
+		snprintf(path, sizeof(path),
+			CPUFREQ_SYSFS "/cpu0/cpuidle/state%" PRIu32 "/name", i);
+		if (system_read(path, name, sizeof(cpufreq_cstate_name[i]) - 1) <= 0)
+			break;
+		name[strcspn(name, "\n")] = '\0';
+	}
+	cpufreq_cstates = i;
+}
+
+/*
+ *  cpufreq_read_u64()
+ *	read a number from a sysfs file, false if not readable
+ */
+static bool cpufreq_read_u64(const char *path, uint64_t *val)
+{
+	char buf[32];
+
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return false;
+	return sscanf(buf, "%" SCNu64, val) == 1;
+}
+
+/*
+ *  cpufreq_sample()
+ *	sum the idle state residency in usecs of the CPUs in
+ *	cpufreq_cpus and return the mean scaling_cur_freq of
+ *	those CPUs in kHz, 0 if cpufreq is not available
+ */
+static double cpufreq_sample(uint64_t idle[STRESS_CPUFREQ_CSTATES_MAX])
+{
+	int cpu;
+	uint64_t khz = 0;
+	uint32_t n = 0;
+
+	memset(idle, 0, sizeof(cpufreq_idle));
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		char path[PATH_MAX];
+		uint64_t val;
+		uint32_t i;
+
+		if (!CPU_ISSET(cpu, &cpufreq_cpus))
+			continue;
+		for (i = 0; i < cpufreq_cstates; i++) {
+			snprintf(path, sizeof(path),
+				CPUFREQ_SYSFS "/cpu%d/cpuidle/state%" PRIu32 "/time",
+				cpu, i);
+			if (cpufreq_read_u64(path, &val))
+				idle[i] += val;
+		}
+		snprintf(path, sizeof(path),
+			CPUFREQ_SYSFS "/cpu%d/cpufreq/scaling_cur_freq", cpu);
+		if (cpufreq_read_u64(path, &val)) {
+			khz += val;
+			n++;
+		}
+	}
+	return n ? (double)khz / n : 0.0;
+}
+
+/*
+ *  cpufreq_cpu_time_now()
+ *	user and system time of the instance and its reaped children,
+ *	an instance run as a thread only counts its own thread
+ */
+static double cpufreq_cpu_time_now(void)
+{
+	struct rusage self, children;
+
+#if defined(RUSAGE_THREAD)
+	if (stress_thread_instance) {
+		if (getrusage(RUSAGE_THREAD, &self) < 0)
+			return 0.0;
+		return timeval_to_double(&self.ru_utime) +
+		       timeval_to_double(&self.ru_stime);
+	}
+#endif
+	if ((getrusage(RUSAGE_SELF, &self) < 0) ||
+	    (getrusage(RUSAGE_CHILDREN, &children) < 0))
+		return 0.0;
+	return timeval_to_double(&self.ru_utime) +
+	       timeval_to_double(&self.ru_stime) +
+	       timeval_to_double(&children.ru_utime) +
+	       timeval_to_double(&children.ru_stime);
+}
+
+/*
+ *  cpufreq_start()
+ *	take the run start values of a stressor instance, the
+ *	cycles and reference cycles counters are the perf view
+ *	of APERF and MPERF and follow the instance over CPUs
+ */
+void cpufreq_start(stress_cpufreq_t *cf)
+{
+	memset(cf, 0, sizeof(*cf));
+	if (sched_getaffinity(0, sizeof(cpufreq_cpus), &cpufreq_cpus) < 0)
+		CPU_ZERO(&cpufreq_cpus);
+
+#if defined(STRESS_PERF_STATS)
+	cpufreq_fd_cycles = perf_open_by_id(STRESS_PERF_HW_CPU_CYCLES);
+	cpufreq_fd_ref = perf_open_by_id(STRESS_PERF_HW_REF_CPU_CYCLES);
+	(void)perf_read_by_fd(cpufreq_fd_cycles, &cpufreq_cycles);
+	(void)perf_read_by_fd(cpufreq_fd_ref, &cpufreq_ref);
+#endif
+	cpufreq_khz = cpufreq_sample(cpufreq_idle);
+	cpufreq_cpu_time = cpufreq_cpu_time_now();
+	cpufreq_wall = time_now();
+}
+
+/*
+ *  cpufreq_stop()
+ *	store the run deltas of a stressor instance
+ */
+void cpufreq_stop(stress_cpufreq_t *cf)
+{
+	uint64_t idle[STRESS_CPUFREQ_CSTATES_MAX];
+	uint64_t cycles = 0, ref = 0;
+	double khz;
+	uint32_t i;
+
+	cf->wall = time_now() - cpufreq_wall;
+	cf->cpu_time = cpufreq_cpu_time_now() - cpufreq_cpu_time;
+	khz = cpufreq_sample(idle);
+#if defined(STRESS_PERF_STATS)
+	if ((perf_read_by_fd(cpufreq_fd_cycles, &cycles) == 0) &&
+	    (cycles >= cpufreq_cycles))
+		cf->cycles = cycles - cpufreq_cycles;
+	if ((perf_read_by_fd(cpufreq_fd_ref, &ref) == 0) &&
+	    (ref >= cpufreq_ref))
+		cf->ref_cycles = ref - cpufreq_ref;
+	if (cpufreq_fd_cycles >= 0)
+		(void)close(cpufreq_fd_cycles);
+	if (cpufreq_fd_ref >= 0)
+		(void)close(cpufreq_fd_ref);
+	cpufreq_fd_cycles = cpufreq_fd_ref = -1;
+#else
+	(void)cycles;
+	(void)ref;
+#endif
+	/* Frequency changes during the run, use the mid-point */
+	if ((khz > 0.0) && (cpufreq_khz > 0.0))
+		cf->sysfs_khz = (khz + cpufreq_khz) / 2.0;
+	else
+		cf->sysfs_khz = khz + cpufreq_khz;
+
+	cf->cpus = CPU_COUNT(&cpufreq_cpus);
+	for (i = 0; i < cpufreq_cstates; i++)
+		cf->idle_usec[i] = (idle[i] >= cpufreq_idle[i]) ?
+			idle[i] - cpufreq_idle[i] : 0;
+}
+
+/*
+ *  cpufreq_dump()
+ *	dump the effective CPU frequency and idle state residency
+ *	of each stressor, cycles are summed over the instances so
+ *	busy instances weigh more than mostly sleeping ones
+ */
+void cpufreq_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	uint32_t i;
+	bool no_cpufreq_stats = true;
+
+	pr_yaml(yaml, "cpufreq:\n");
+	json_array_begin(json, "cpufreq");
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		int32_t j;
+		uint64_t cycles = 0, ref_cycles = 0;
+		uint64_t idle[STRESS_CPUFREQ_CSTATES_MAX];
+		double cpu_time = 0.0, cpu_wall = 0.0, khz = 0.0;
+		uint32_t k, khz_count = 0;
+		char *munged;
+
+		if (!procs[i].started_procs)
+			continue;
+
+		memset(idle, 0, sizeof(idle));
+		for (j = 0; j < procs[i].started_procs; j++) {
+			const stress_cpufreq_t *cf =
+				&shared->stats[procs[i].stats_index + j].cpufreq;
+
+			cycles += cf->cycles;
+			ref_cycles += cf->ref_cycles;
+			cpu_time += cf->cpu_time;
+			cpu_wall += cf->wall * 1000000.0 * cf->cpus;
+			if (cf->sysfs_khz > 0.0) {
+				khz += cf->sysfs_khz;
+				khz_count++;
+			}
+			for (k = 0; k < cpufreq_cstates; k++)
+				idle[k] += cf->idle_usec[k];
+		}
+		if (!cpufreq_cstates)
+			cpu_wall = 0.0;
+		if (!(cycles && cpu_time > 0.0) && !khz_count && !(cpu_wall > 0.0))
+			continue;
+
+		munged = munge_underscore(stressors[i].name);
+		pr_inf(stdout, "%s:\n", munged);
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		no_cpufreq_stats = false;
+
+		if (cycles && (cpu_time > 0.0)) {
+			const double mhz = (double)cycles / cpu_time / 1000000.0;
+
+			pr_inf(stdout, "%20s %9.2f MHz\n", "effective", mhz);
+			pr_yaml(yaml, "      effective-mhz: %.2f\n", mhz);
+			json_double(json, "effective-mhz", mhz);
+		}
+		if (cycles && ref_cycles) {
+			const double pct = 100.0 * (double)cycles / (double)ref_cycles;
+
+			pr_inf(stdout, "%20s %9.2f %% of base\n", "cycles/ref-cycles", pct);
+			pr_yaml(yaml, "      base-percent: %.2f\n", pct);
+			json_double(json, "base-percent", pct);
+		}
+		if (khz_count) {
+			const double mhz = khz / khz_count / 1000.0;
+
+			pr_inf(stdout, "%20s %9.2f MHz\n", "scaling_cur_freq", mhz);
+			pr_yaml(yaml, "      scaling-cur-freq-mhz: %.2f\n", mhz);
+			json_double(json, "scaling-cur-freq-mhz", mhz);
+		}
+		if (cpu_wall > 0.0) {
+			double busy = 100.0;
+
+			for (k = 0; k < cpufreq_cstates; k++) {
+				char key[32];
+				const double pct = 100.0 * (double)idle[k] / cpu_wall;
+
+				busy -= pct;
+				snprintf(key, sizeof(key), "idle-%s", cpufreq_cstate_name[k]);
+				pr_inf(stdout, "%20s %9.2f %%\n", cpufreq_cstate_name[k], pct);
+				pr_yaml(yaml, "      %s: %.2f\n", key, pct);
+				json_double(json, key, pct);
+			}
+			if (busy < 0.0)
+				busy = 0.0;
+			pr_inf(stdout, "%20s %9.2f %%\n", "busy", busy);
+			pr_yaml(yaml, "      busy: %.2f\n", busy);
+			json_double(json, "busy", busy);
+		}
+		pr_yaml(yaml, "\n");
+		json_obj_end(json);
+	}
+	json_array_end(json);
+
+	if (no_cpufreq_stats)
+		pr_inf(stdout, "CPU frequency and idle state residency not available\n");
+}
+
+#endif
@@ -0,0 +1,382 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(__linux__)
+
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <inttypes.h>
+
+#define ENERGY_SOURCES_MAX	(16)	/* packages or powercap zones */
+#define POWERCAP_PATH		"/sys/class/powercap"
+
+/* A RAPL energy domain, as a perf power event or powercap zone */
+typedef struct {
+	const char *event;		/* perf power PMU event */
+	const char *zone;		/* powercap zone name prefix */
+	const char *label;		/* YAML and JSON label */
+} energy_domain_t;
+
+static const energy_domain_t energy_domains[] = {
+	{ "energy-pkg",		"package",	"pkg" },
+	{ "energy-cores",	"core",		"cores" },
+	{ "energy-ram",		"dram",		"ram" },
+	{ "energy-gpu",		"uncore",	"gpu" },
+	{ "energy-psys",	"psys",		"psys" },
+};
+
+#define ENERGY_DOMAINS	SIZEOF_ARRAY(energy_domains)
+#define ENERGY_PKG	(0)
+#define ENERGY_RAM	(2)
+#define ENERGY_PSYS	(4)
+
+/* The counters of one domain, one per package */
+typedef struct {
+	int n;				/* counters in use */
+	bool perf;			/* perf counters, else powercap */
+	double scale;			/* joules per perf count */
+	int fds[ENERGY_SOURCES_MAX];	/* perf counters */
+	char *paths[ENERGY_SOURCES_MAX]; /* powercap energy_uj files */
+	uint64_t range[ENERGY_SOURCES_MAX]; /* powercap wrap, uJ */
+	uint64_t start[ENERGY_SOURCES_MAX]; /* raw counts at run start */
+} energy_source_t;
+
+static energy_source_t energy_sources[ENERGY_DOMAINS];
+static double energy_time_start;
+static double energy_joules[STRESS_MAX][ENERGY_DOMAINS];
+static double energy_secs[STRESS_MAX];
+
+#if defined(STRESS_PERF_STATS)
+/*
+ *  energy_perf_init()
+ *	open the perf power event of a domain on the first CPU
+ *	of each package, as listed in the power PMU cpumask
+ */
+static bool energy_perf_init(energy_source_t *src, const energy_domain_t *domain)
+{
+	char buf[256];
+	cpu_set_t set;
+	int i, cpu;
+
+	if (system_read("/sys/bus/event_source/devices/power/cpumask",
+			buf, sizeof(buf) - 1) <= 0)
+		return false;
+	if (stress_parse_cpulist(NULL, buf, &set) <= 0)
+		return false;
+
+	for (cpu = 0; (cpu < CPU_SETSIZE) && (src->n < ENERGY_SOURCES_MAX); cpu++) {
+		int fd;
+
+		if (!CPU_ISSET(cpu, &set))
+			continue;
+		fd = perf_open_pmu_event("power", domain->event, cpu, &src->scale);
+		if (fd < 0)
+			goto fail;
+		src->fds[src->n++] = fd;
+	}
+	src->perf = (src->n > 0);
+	return src->perf;
+
+fail:
+	for (i = 0; i < src->n; i++)
+		(void)close(src->fds[i]);
+	src->n = 0;
+	return false;
+}
+#endif
+
+/*
+ *  energy_powercap_init()
+ *	find the powercap zones of a domain, e.g. intel-rapl:0
+ *	is package-0 and intel-rapl:0:1 is its dram zone
+ */
+static bool energy_powercap_init(energy_source_t *src, const energy_domain_t *domain)
+{
+	DIR *dir;
+	struct dirent *d;
+
+	dir = opendir(POWERCAP_PATH);
+	if (!dir)
+		return false;
+
+	while (((d = readdir(dir)) != NULL) && (src->n < ENERGY_SOURCES_MAX)) {
+		char path[PATH_MAX], buf[64];
+		uint64_t range = 0;
+
+		if (d->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), POWERCAP_PATH "/%s/name", d->d_name);
+		if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+			continue;
+		if (strncmp(buf, domain->zone, strlen(domain->zone)))
+			continue;
+		snprintf(path, sizeof(path), POWERCAP_PATH "/%s/max_energy_range_uj",
+			d->d_name);
+		if (system_read(path, buf, sizeof(buf) - 1) > 0)
+			range = strtoull(buf, NULL, 10);
+		snprintf(path, sizeof(path), POWERCAP_PATH "/%s/energy_uj", d->d_name);
+		if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+			continue;
+		if ((src->paths[src->n] = strdup(path)) == NULL)
+			break;
+		src->range[src->n++] = range;
+	}
+	(void)closedir(dir);
+
+	return src->n > 0;
+}
+
+/*
+ *  energy_read()
+ *	read the raw counters of a domain, joules are perf
+ *	counts * scale or powercap microjoules
+ */
+static void energy_read(const energy_source_t *src, uint64_t raw[ENERGY_SOURCES_MAX])
+{
+	int i;
+
+	for (i = 0; i < src->n; i++) {
+		raw[i] = 0;
+#if defined(STRESS_PERF_STATS)
+		if (src->perf) {
+			(void)perf_read_by_fd(src->fds[i], &raw[i]);
+			continue;
+		}
+#endif
+		if (src->paths[i]) {
+			char buf[64];
+
+			if (system_read(src->paths[i], buf, sizeof(buf) - 1) > 0)
+				raw[i] = strtoull(buf, NULL, 10);
+		}
+	}
+}
+
+/*
+ *  stress_energy_init()
+ *	find the RAPL energy counters, perf power events are
+ *	used where permitted and the powercap sysfs otherwise
+ */
+void stress_energy_init(void)
+{
+	size_t d;
+	bool found = false;
+
+	if (!(opt_flags & OPT_FLAGS_ENERGY))
+		return;
+
+	for (d = 0; d < ENERGY_DOMAINS; d++) {
+		energy_source_t *src = &energy_sources[d];
+
+#if defined(STRESS_PERF_STATS)
+		if (energy_perf_init(src, &energy_domains[d])) {
+			found = true;
+			continue;
+		}
+#endif
+		if (energy_powercap_init(src, &energy_domains[d]))
+			found = true;
+	}
+	if (!found)
+		pr_inf(stderr, "energy: no RAPL energy counters available\n");
+	for (d = 0; d < ENERGY_DOMAINS; d++) {
+		if (energy_sources[d].n)
+			pr_dbg(stderr, "energy: %s from %d %s counter%s\n",
+				energy_domains[d].label, energy_sources[d].n,
+				energy_sources[d].perf ? "perf" : "powercap",
+				energy_sources[d].n == 1 ? "" : "s");
+	}
+}
+
+/*
+ *  stress_energy_start()
+ *	take the energy counters at the start of a run
+ */
+void stress_energy_start(void)
+{
+	size_t d;
+
+	if (!(opt_flags & OPT_FLAGS_ENERGY))
+		return;
+
+	for (d = 0; d < ENERGY_DOMAINS; d++)
+		energy_read(&energy_sources[d], energy_sources[d].start);
+	energy_time_start = time_now();
+}
+
+/*
+ *  stress_energy_stop()
+ *	charge the energy used since stress_energy_start() to
+ *	each of the stressors of the run. RAPL counts for the
+ *	whole package, so stressors run together share it
+ */
+void stress_energy_stop(const proc_info_t procs[STRESS_MAX])
+{
+	double joules[ENERGY_DOMAINS];
+	double secs;
+	size_t d;
+	int32_t i;
+
+	if (!(opt_flags & OPT_FLAGS_ENERGY))
+		return;
+
+	secs = time_now() - energy_time_start;
+	for (d = 0; d < ENERGY_DOMAINS; d++) {
+		const energy_source_t *src = &energy_sources[d];
+		uint64_t raw[ENERGY_SOURCES_MAX];
+		int k;
+
+		joules[d] = 0.0;
+		energy_read(src, raw);
+		for (k = 0; k < src->n; k++) {
+			if (src->perf) {
+				joules[d] += (double)(raw[k] - src->start[k]) * src->scale;
+			} else {
+				/* energy_uj wraps at max_energy_range_uj */
+				const uint64_t uj = (raw[k] >= src->start[k]) ?
+					raw[k] - src->start[k] :
+					raw[k] + src->range[k] - src->start[k];
+
+				joules[d] += (double)uj / 1000000.0;
+			}
+		}
+	}
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		if (!procs[i].num_procs)
+			continue;
+		for (d = 0; d < ENERGY_DOMAINS; d++)
+			energy_joules[i][d] += joules[d];
+		energy_secs[i] += secs;
+	}
+}
+
+/*
+ *  stress_energy_get()
+ *	the energy used while a stressor ran, package plus
+ *	DRAM where available, otherwise platform (psys)
+ */
+bool stress_energy_get(const int32_t i, double *joules, double *watts)
+{
+	if (!(opt_flags & OPT_FLAGS_ENERGY) || (energy_secs[i] <= 0.0))
+		return false;
+
+	if (energy_sources[ENERGY_PKG].n)
+		*joules = energy_joules[i][ENERGY_PKG] + energy_joules[i][ENERGY_RAM];
+	else if (energy_sources[ENERGY_PSYS].n)
+		*joules = energy_joules[i][ENERGY_PSYS];
+	else
+		return false;
+	*watts = *joules / energy_secs[i];
+
+	return true;
+}
+
+/*
+ *  stress_energy_domains_dump()
+ *	add the joules of each domain of a stressor to the
+ *	metrics YAML and JSON
+ */
+void stress_energy_domains_dump(FILE *yaml, json_t *json, const int32_t i)
+{
+	size_t d;
+
+	if (!(opt_flags & OPT_FLAGS_ENERGY))
+		return;
+
+	for (d = 0; d < ENERGY_DOMAINS; d++) {
+		char key[32];
+
+		if (!energy_sources[d].n)
+			continue;
+		snprintf(key, sizeof(key), "energy-%s-joules", energy_domains[d].label);
+		pr_yaml(yaml, "      %s: %f\n", key, energy_joules[i][d]);
+		json_double(json, key, energy_joules[i][d]);
+	}
+}
+
+/*
+ *  stress_energy_free()
+ *	close the energy counters
+ */
+void stress_energy_free(void)
+{
+	size_t d;
+
+	for (d = 0; d < ENERGY_DOMAINS; d++) {
+		energy_source_t *src = &energy_sources[d];
+		int k;
+
+		for (k = 0; k < src->n; k++) {
+			if (src->perf)
+				(void)close(src->fds[k]);
+			free(src->paths[k]);
+			src->paths[k] = NULL;
+		}
+		src->n = 0;
+	}
+}
+
+#else
+void stress_energy_init(void)
+{
+	if (opt_flags & OPT_FLAGS_ENERGY)
+		pr_inf(stderr, "energy: RAPL energy counters not supported\n");
+}
+
+void stress_energy_start(void)
+{
+}
+
+void stress_energy_stop(const proc_info_t procs[STRESS_MAX])
+{
+	(void)procs;
+}
+
+bool stress_energy_get(const int32_t i, double *joules, double *watts)
+{
+	(void)i;
+	(void)joules;
+	(void)watts;
+
+	return false;
+}
+
+void stress_energy_domains_dump(FILE *yaml, json_t *json, const int32_t i)
+{
+	(void)yaml;
+	(void)json;
+	(void)i;
+}
+
+void stress_energy_free(void)
+{
+}
+#endif
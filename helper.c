@@ -372,6 +372,15 @@ uint64_t uint64_zero(void)
 	return 0ULL;
 }
 
+/*
+ *  stress_get_temp_path()
+ *	get the temporary file path
+ */
+const char *stress_get_temp_path(void)
+{
+	return stress_temp_path;
+}
+
 /*
  *  stress_set_temp_path()
  *	set temporary file path, default
@@ -529,6 +538,27 @@ void stress_strnrnd(char *str, const size_t len)
 	*str = '\0';
 }
 
+/*
+ *  stress_target_clone()
+ *	the TARGET_CLONES variant the ifunc resolvers pick on
+ *	this CPU, they take the highest priority ISA supported
+ */
+const char *stress_target_clone(void)
+{
+#if defined(HAVE_TARGET_CLONES)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return "avx512f";
+	if (__builtin_cpu_supports("avx2"))
+		return "avx2";
+	if (__builtin_cpu_supports("sse4.2"))
+		return "sse4.2";
+	return "default";
+#else
+	return "none";
+#endif
+}
+
 /*
  *  pr_yaml_runinfo()
  *	log info about the system we are running stress-ng on
@@ -581,9 +611,123 @@ void pr_yaml_runinfo(FILE *yaml)
 	pr_yaml(yaml, "      cpus: %" PRId32 "\n", stress_get_processors_configured());
 	pr_yaml(yaml, "      cpus-online: %" PRId32 "\n", stress_get_processors_online());
 	pr_yaml(yaml, "      ticks-per-second: %" PRId32 "\n", stress_get_ticks_per_second());
+	pr_yaml(yaml, "      target-clones: %s\n", stress_target_clone());
 	pr_yaml(yaml, "\n");
 }
 
+#if defined(__linux__)
+/*
+ *  stress_get_cpu_model()
+ *	get the CPU model name from /proc/cpuinfo
+ */
+static bool stress_get_cpu_model(char *model, const size_t len)
+{
+	FILE *fp;
+	char buffer[256];
+	bool found = false;
+
+	fp = fopen("/proc/cpuinfo", "r");
+	if (!fp)
+		return false;
+
+	while (fgets(buffer, sizeof(buffer), fp)) {
+		char *ptr;
+
+		if (strncmp(buffer, "model name", 10) &&
+		    strncmp(buffer, "Processor", 9) &&
+		    strncmp(buffer, "cpu\t", 4))
+			continue;
+		ptr = strchr(buffer, ':');
+		if (!ptr)
+			continue;
+		for (ptr++; *ptr == ' '; ptr++)
+			;
+		ptr[strcspn(ptr, "\n")] = '\0';
+		strncpy(model, ptr, len - 1);
+		model[len - 1] = '\0';
+		found = true;
+		break;
+	}
+	(void)fclose(fp);
+
+	return found;
+}
+#endif
+
+/*
+ *  json_runinfo()
+ *	log info about the system we are running stress-ng on
+ *	as a JSON object, the same info as pr_yaml_runinfo()
+ *	plus the build commit and CPU model
+ */
+void json_runinfo(json_t *json)
+{
+#if defined(__linux__)
+	struct utsname uts;
+	struct sysinfo info;
+	char model[256];
+#endif
+	time_t t;
+	struct tm *tm = NULL;
+	char hostname[128];
+	char *user;
+
+	if (!json)
+		return;
+
+	user = getlogin();
+	json_obj_begin(json, "system-info");
+	if (time(&t) != ((time_t)-1))
+		tm = localtime(&t);
+
+	json_str(json, "stress-ng-version", VERSION);
+#if defined(GIT_COMMIT)
+	json_str(json, "git-commit", GIT_COMMIT);
+#else
+	json_str(json, "git-commit", "unknown");
+#endif
+	json_str(json, "run-by", user ? user : "unknown");
+	if (tm) {
+		char buffer[32];
+
+		snprintf(buffer, sizeof(buffer), "%4.4d:%2.2d:%2.2d",
+			tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+		json_str(json, "date-yyyy-mm-dd", buffer);
+		snprintf(buffer, sizeof(buffer), "%2.2d:%2.2d:%2.2d",
+			tm->tm_hour, tm->tm_min, tm->tm_sec);
+		json_str(json, "time-hh-mm-ss", buffer);
+		json_int(json, "epoch-secs", (int64_t)t);
+	}
+	if (!gethostname(hostname, sizeof(hostname)))
+		json_str(json, "hostname", hostname);
+#if defined(__linux__)
+	if (uname(&uts) == 0) {
+		json_str(json, "sysname", uts.sysname);
+		json_str(json, "nodename", uts.nodename);
+		json_str(json, "release", uts.release);
+		json_str(json, "version", uts.version);
+		json_str(json, "machine", uts.machine);
+	}
+	if (stress_get_cpu_model(model, sizeof(model)))
+		json_str(json, "cpu-model", model);
+	if (sysinfo(&info) == 0) {
+		json_int(json, "uptime", info.uptime);
+		json_uint(json, "totalram", info.totalram);
+		json_uint(json, "freeram", info.freeram);
+		json_uint(json, "sharedram", info.sharedram);
+		json_uint(json, "bufferram", info.bufferram);
+		json_uint(json, "totalswap", info.totalswap);
+		json_uint(json, "freeswap", info.freeswap);
+	}
+#endif
+	json_int(json, "pagesize", stress_get_pagesize());
+	json_int(json, "cpus", stress_get_processors_configured());
+	json_int(json, "cpus-online", stress_get_processors_online());
+	json_int(json, "ticks-per-second", stress_get_ticks_per_second());
+	json_str(json, "target-clones", stress_target_clone());
+	json_obj_end(json);
+}
+
 
 /*
  *  stress_cache_alloc()
@@ -727,6 +871,23 @@ int system_read(
 	return ret;
 }
 
+/*
+ *  stress_drop_caches()
+ *	sync and drop the dentry and inode caches so the next
+ *	metadata access is cold, needs root, returns 0 or -errno
+ */
+int stress_drop_caches(void)
+{
+	int ret;
+
+	if (geteuid() != 0)
+		return -EPERM;
+	sync();
+	ret = system_write("/proc/sys/vm/drop_caches", "2", 1);
+
+	return (ret < 0) ? ret : 0;
+}
+
 
 /*
  *  stress_is_prime64()
@@ -847,3 +1008,37 @@ unsigned int stress_get_cpu(void)
 	return 0;
 #endif
 }
+
+/*
+ *  stress_misc_metric_set()
+ *	set a stressor specific metric of the current stressor
+ *	instance, idx is the metric slot, description should
+ *	name the metric and units, e.g. "libc copy rate (MB/sec)"
+ */
+void stress_misc_metric_set(
+	const size_t idx,
+	const char *description,
+	const double value)
+{
+	stress_misc_metric_t *metric;
+
+	if (!stress_stats || (idx >= STRESS_MISC_METRICS_MAX))
+		return;
+
+	metric = &stress_stats->misc[idx];
+	(void)snprintf(metric->description, sizeof(metric->description),
+		"%s", description);
+	metric->value = value;
+}
+
+/*
+ *  stress_units_per_op()
+ *	set the normalised work units, in the unit the stressor
+ *	declares in the stressor table, done by each bogo op of
+ *	the current stressor instance
+ */
+void stress_units_per_op(const double units)
+{
+	if (stress_stats)
+		stress_stats->units_per_op = units;
+}
@@ -31,12 +31,15 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <signal.h>
 
 #include "stress-ng.h"
 
+static const char *option = "ignite-cpu";
+
 typedef struct {
-	const char *path;		/* Path of /sys control */
+	char *path;			/* Path of /sys control */
 	const char *default_setting;	/* Default maximizing setting to use */
 	size_t default_setting_len;	/* Length of default setting */
 	char *setting;			/* Original setting to restore it */
@@ -44,76 +47,270 @@ typedef struct {
 	bool ignore;			/* true to ignore using this */
 } settings_t;
 
+/* System wide controls */
+static const struct {
+	const char *path;
+	const char *default_setting;
+} global_settings[] = {
+#if defined(__linux__) && defined(STRESS_X86)
+	/* x86 Intel P-State maximizing settings */
+	{ "/sys/devices/system/cpu/intel_pstate/max_perf_pct", "100" },
+	{ "/sys/devices/system/cpu/intel_pstate/no_turbo", "0" },
+#endif
+	{ NULL, NULL }
+};
+
+/* Per CPU controls, relative to /sys/devices/system/cpu/cpuN */
+static const struct {
+	const char *path;
+	const char *default_setting;
+} cpu_settings[] = {
+#if defined(__linux__)
+	{ "cpufreq/scaling_governor", "performance" },
+	{ "cpufreq/energy_performance_preference", "performance" },
+	{ "power/energy_perf_bias", "0" },
+#endif
+	{ NULL, NULL }
+};
+
+/* Per CPU frequency sampled by the ignite daemon */
+typedef struct {
+	uint64_t before_khz;		/* sum of samples before ignition */
+	uint64_t before_n;		/* number of samples */
+	uint64_t after_khz;		/* sum of samples after ignition */
+	uint64_t after_n;
+} ignite_freq_t;
+
+/* Shared with the ignite daemon */
+typedef struct {
+	double time;			/* when CPUs were ignited, < 0 = not */
+	uint64_t counter[STRESS_MAX];	/* bogo ops of each stressor then */
+	ignite_freq_t freq[0];		/* frequency of each CPU */
+} ignite_shared_t;
+
+static settings_t *settings;
+static size_t settings_count;
 static pid_t pid;
 static bool enabled;
+static uint64_t opt_ignite_cpu_baseline;	/* seconds */
+static int32_t ignite_cpus;
+static ignite_shared_t *ignite;
+static size_t ignite_size;
+static double ignite_time_start;
 
-#define SETTING(path, default_setting)	\
-	{ path, default_setting, 0, NULL, 0, false }
+/* Results of all the runs, for ignite_cpu_dump() */
+static ignite_freq_t *ignite_freq;
+static double ignite_ops_before[STRESS_MAX];
+static double ignite_secs_before[STRESS_MAX];
+static double ignite_ops_after[STRESS_MAX];
+static double ignite_secs_after[STRESS_MAX];
 
-settings_t settings[] = {
-#if defined(__linux__) && defined(STRESS_X86)
-	/* x86 Intel P-State maximizing settings */
-	SETTING("/sys/devices/system/cpu/intel_pstate/max_perf_pct", "100"),
-	SETTING("/sys/devices/system/cpu/intel_pstate/no_turbo", "0"),
+#if defined(__linux__)
+static cpu_set_t ignite_set;			/* CPUs to ignite */
+static bool ignite_set_valid;			/* --ignite-cpu-list given */
 #endif
-	SETTING(NULL, NULL)
-};
+
+void stress_set_ignite_cpu_list(const char *optarg)
+{
+#if defined(__linux__)
+	char *list = strdup(optarg);
+
+	if (!list) {
+		fprintf(stderr, "%s: cannot allocate CPU list\n", option);
+		exit(EXIT_FAILURE);
+	}
+	if (stress_parse_cpulist(option, list, &ignite_set) < 0) {
+		free(list);
+		exit(EXIT_FAILURE);
+	}
+	free(list);
+	ignite_set_valid = true;
+#else
+	(void)optarg;
+#endif
+	opt_flags |= OPT_FLAGS_IGNITE_CPU;
+}
+
+void stress_set_ignite_cpu_baseline(const char *optarg)
+{
+	opt_ignite_cpu_baseline = get_uint64_time(optarg);
+	opt_flags |= OPT_FLAGS_IGNITE_CPU;
+}
 
 /*
- *  ignite_cpu_start()
- *	crank up the CPUs, start a child process to continually
- *	set the most demanding CPU settings
+ *  ignite_cpu_selected()
+ *	true if a CPU is one of the CPUs to ignite
  */
-void ignite_cpu_start(void)
+static bool ignite_cpu_selected(const int32_t cpu)
 {
-	size_t i, n = 0;
+#if defined(__linux__)
+	return CPU_ISSET(cpu, &ignite_set);
+#else
+	(void)cpu;
 
-	if (enabled)
+	return false;
+#endif
+}
+
+/*
+ *  ignite_setting_add()
+ *	add a control if it exists and can be written, the
+ *	check writes back the current setting so nothing is
+ *	changed until the CPUs are ignited
+ */
+static void ignite_setting_add(const char *path, const char *default_setting)
+{
+	settings_t *setting = &settings[settings_count];
+	char buf[4096];
+	int ret;
+	size_t len;
+
+	ret = system_read(path, buf, sizeof(buf) - 1);
+	if (ret <= 0)
+		return;
+	buf[ret] = '\0';
+	len = strlen(buf);
+	if (len == 0)
 		return;
 
-	pid = -1;
-	for (i = 0; settings[i].path; i++) {
-		char buf[4096];
-		int ret;
-		size_t len;
-
-		settings[i].ignore = true;
-		ret = system_read(settings[i].path, buf, sizeof(buf) - 1);
-		if (ret < 0)
+	ret = system_write(path, buf, len);
+	if (ret < 0) {
+		pr_dbg(stderr, "%s: cannot set %s, errno=%d (%s)\n",
+			option, path, -ret, strerror(-ret));
+		return;
+	}
+	setting->path = strdup(path);
+	setting->setting = strdup(buf);
+	if (!setting->path || !setting->setting) {
+		free(setting->path);
+		free(setting->setting);
+		return;
+	}
+	setting->default_setting = default_setting;
+	setting->default_setting_len = strlen(default_setting);
+	setting->setting_len = len;
+	setting->ignore = false;
+	settings_count++;
+}
+
+/*
+ *  ignite_sample()
+ *	add the scaling_cur_freq of each selected CPU to the
+ *	before or after ignition samples
+ */
+static void ignite_sample(const bool after)
+{
+	int32_t cpu;
+
+	for (cpu = 0; cpu < ignite_cpus; cpu++) {
+		char path[PATH_MAX], buf[32];
+		ignite_freq_t *freq = &ignite->freq[cpu];
+		uint64_t khz;
+
+		if (!ignite_cpu_selected(cpu))
 			continue;
-		buf[ret] = '\0';
-		len = strlen(buf);
-		if (len == 0)
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%"
+			PRId32 "/cpufreq/scaling_cur_freq", cpu);
+		if (system_read(path, buf, sizeof(buf) - 1) <= 0)
 			continue;
-	
-		settings[i].default_setting_len =
-			strlen(settings[i].default_setting);
-		/* If we can't update the setting, skip it */
-		ret = system_write(settings[i].path,
-			settings[i].default_setting,
-			settings[i].default_setting_len);
-		if (ret < 0) {
-			pr_dbg(stderr, "ignite-cpu: cannot set %s to %s, "
-				"errno=%d (%s)\n",
-				settings[i].path, settings[i].default_setting,
-				-ret, strerror(-ret));
+		if (sscanf(buf, "%" SCNu64, &khz) != 1)
 			continue;
+		if (after) {
+			freq->after_khz += khz;
+			freq->after_n++;
+		} else {
+			freq->before_khz += khz;
+			freq->before_n++;
 		}
+	}
+}
 
-		settings[i].setting = calloc(1, len + 1);
-		if (!settings[i].setting)
-			continue;
+/*
+ *  ignite_counters()
+ *	the bogo ops of each stressor so far
+ */
+static void ignite_counters(
+	const proc_info_t procs[STRESS_MAX],
+	uint64_t counter[STRESS_MAX])
+{
+	int32_t i;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		int32_t j;
 
-		strncpy(settings[i].setting, buf, len);
-		settings[i].setting_len = len;
-		settings[i].ignore = false;
-		n++;
+		counter[i] = 0;
+		for (j = 0; j < procs[i].started_procs; j++)
+			counter[i] += shared->counters[procs[i].stats_index + j].counter;
 	}
+}
+
+/*
+ *  ignite_cpu_start()
+ *	crank up the CPUs, start a child process to continually
+ *	set the most demanding CPU settings. With a baseline the
+ *	stressors first run for the baseline time without the
+ *	settings so the bogo op rate gain can be measured
+ */
+void ignite_cpu_start(const proc_info_t procs[STRESS_MAX])
+{
+	size_t i;
+	int32_t cpu;
 
-	if (n == 0)
+	if (enabled)
 		return;
 
+	pid = -1;
+	ignite_cpus = stress_get_processors_configured();
+	if (ignite_cpus < 1)
+		ignite_cpus = 1;
+#if defined(__linux__)
+	if (!ignite_set_valid) {
+		CPU_ZERO(&ignite_set);
+		for (cpu = 0; (cpu < ignite_cpus) && (cpu < CPU_SETSIZE); cpu++)
+			CPU_SET(cpu, &ignite_set);
+		ignite_set_valid = true;
+	}
+#endif
+	settings = calloc(SIZEOF_ARRAY(global_settings) +
+		(size_t)ignite_cpus * SIZEOF_ARRAY(cpu_settings), sizeof(*settings));
+	if (!settings)
+		return;
+	settings_count = 0;
+
+	for (i = 0; global_settings[i].path; i++)
+		ignite_setting_add(global_settings[i].path,
+			global_settings[i].default_setting);
+	for (cpu = 0; cpu < ignite_cpus; cpu++) {
+		if (!ignite_cpu_selected(cpu))
+			continue;
+		for (i = 0; cpu_settings[i].path; i++) {
+			char path[PATH_MAX];
+
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%"
+				PRId32 "/%s", cpu, cpu_settings[i].path);
+			ignite_setting_add(path, cpu_settings[i].default_setting);
+		}
+	}
+	if (settings_count == 0) {
+		free(settings);
+		settings = NULL;
+		return;
+	}
+
+	ignite_size = sizeof(*ignite) + (size_t)ignite_cpus * sizeof(ignite_freq_t);
+	ignite = mmap(NULL, ignite_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (ignite == MAP_FAILED) {
+		ignite = NULL;
+		pr_dbg(stderr, "%s: cannot mmap results, errno=%d (%s)\n",
+			option, errno, strerror(errno));
+	} else {
+		memset(ignite, 0, ignite_size);
+		ignite->time = -1.0;
+	}
+
 	enabled = true;
+	ignite_time_start = time_now();
 
 	pid = fork();
 	if (pid < 0) {
@@ -122,18 +319,33 @@ void ignite_cpu_start(void)
 		return;
 	} else if (pid == 0) {
 		/* Child */
+		bool ignited = false;
+
 		(void)setpgid(0, pgrp);
 		stress_parent_died_alarm();
 
 		for (;;) {
-			for (i = 0; settings[i].path; i++) {
-				if (settings[i].ignore)
-					continue;
-				(void)system_write(settings[i].path,
-					settings[i].default_setting,
-					settings[i].default_setting_len);
+			if (!ignited &&
+			    (time_now() - ignite_time_start >= (double)opt_ignite_cpu_baseline)) {
+				if (ignite) {
+					ignite_sample(false);
+					ignite_counters(procs, ignite->counter);
+					ignite->time = time_now();
+				}
+				ignited = true;
+			}
+			if (ignited) {
+				for (i = 0; i < settings_count; i++) {
+					if (settings[i].ignore)
+						continue;
+					(void)system_write(settings[i].path,
+						settings[i].default_setting,
+						settings[i].default_setting_len);
+				}
 			}
 			sleep(1);
+			if (ignite)
+				ignite_sample(ignited);
 		}
 	} else {
 		/* Parent */
@@ -143,28 +355,142 @@ void ignite_cpu_start(void)
 
 /*
  *  ignite_cpu_stop()
- *	stop updating settings and restore to original settings
+ *	stop updating settings and restore to original settings,
+ *	the bogo op rates before and after ignition are added to
+ *	the stressors of this run
  */
-void ignite_cpu_stop(void)
+void ignite_cpu_stop(const proc_info_t procs[STRESS_MAX])
 {
 	size_t i;
 	int status;
 
+	if (!enabled)
+		return;
+
 	if (pid > -1) {
 		(void)kill(pid, SIGTERM);
 		(void)kill(pid, SIGKILL);
 		(void)waitpid(pid, &status, 0);
 	}
 
-	for (i = 0; settings[i].path; i++) {
+	for (i = 0; i < settings_count; i++) {
 		if (settings[i].ignore)
 			continue;
 
 		(void)system_write(settings[i].path, settings[i].setting,
 			settings[i].setting_len);
+		free(settings[i].path);
 		free(settings[i].setting);
-		settings[i].setting = NULL;
-		settings[i].ignore = true;
+	}
+	free(settings);
+	settings = NULL;
+	settings_count = 0;
+
+	if (ignite) {
+		const double now = time_now();
+		uint64_t counter[STRESS_MAX];
+		int32_t cpu;
+
+		if (!ignite_freq)
+			ignite_freq = calloc((size_t)ignite_cpus, sizeof(*ignite_freq));
+		for (cpu = 0; ignite_freq && (cpu < ignite_cpus); cpu++) {
+			ignite_freq[cpu].before_khz += ignite->freq[cpu].before_khz;
+			ignite_freq[cpu].before_n += ignite->freq[cpu].before_n;
+			ignite_freq[cpu].after_khz += ignite->freq[cpu].after_khz;
+			ignite_freq[cpu].after_n += ignite->freq[cpu].after_n;
+		}
+
+		ignite_counters(procs, counter);
+		for (i = 0; (ignite->time > 0.0) && (i < STRESS_MAX); i++) {
+			if (!procs[i].num_procs)
+				continue;
+			ignite_ops_before[i] += (double)ignite->counter[i];
+			ignite_secs_before[i] += ignite->time - ignite_time_start;
+			ignite_ops_after[i] += (double)(counter[i] - ignite->counter[i]);
+			ignite_secs_after[i] += now - ignite->time;
+		}
+		(void)munmap((void *)ignite, ignite_size);
+		ignite = NULL;
 	}
 	enabled = false;
 }
+
+/*
+ *  ignite_cpu_dump()
+ *	dump the frequency of the ignited CPUs before and after
+ *	ignition and the bogo op rate gain of each stressor
+ */
+void ignite_cpu_dump(FILE *yaml, json_t *json, const stress_t stressors[])
+{
+	int32_t cpu;
+	size_t i;
+	bool heading = false;
+
+	for (cpu = 0; ignite_freq && (cpu < ignite_cpus); cpu++) {
+		const ignite_freq_t *freq = &ignite_freq[cpu];
+		double before, after;
+
+		if (!freq->before_n || !freq->after_n)
+			continue;
+		before = (double)freq->before_khz / freq->before_n / 1000.0;
+		after = (double)freq->after_khz / freq->after_n / 1000.0;
+		if (!heading) {
+			pr_inf(stdout, "%s: %5s %12s %12s\n", option,
+				"CPU", "before MHz", "after MHz");
+			pr_yaml(yaml, "ignite-cpu-frequency:\n");
+			json_array_begin(json, "ignite-cpu-frequency");
+			heading = true;
+		}
+		pr_inf(stdout, "%s: %5" PRId32 " %12.2f %12.2f\n", option,
+			cpu, before, after);
+		pr_yaml(yaml, "    - cpu: %" PRId32 "\n", cpu);
+		pr_yaml(yaml, "      before-mhz: %.2f\n", before);
+		pr_yaml(yaml, "      after-mhz: %.2f\n", after);
+		json_obj_begin(json, NULL);
+		json_int(json, "cpu", cpu);
+		json_double(json, "before-mhz", before);
+		json_double(json, "after-mhz", after);
+		json_obj_end(json);
+	}
+	if (heading) {
+		pr_yaml(yaml, "\n");
+		json_array_end(json);
+	}
+
+	for (heading = false, i = 0; i < STRESS_MAX; i++) {
+		const char *munged;
+		double before, after, gain;
+
+		if ((ignite_secs_before[i] <= 0.0) || (ignite_secs_after[i] <= 0.0))
+			continue;
+		before = ignite_ops_before[i] / ignite_secs_before[i];
+		after = ignite_ops_after[i] / ignite_secs_after[i];
+		gain = (before > 0.0) ? 100.0 * (after - before) / before : 0.0;
+		munged = munge_underscore(stressors[i].name);
+		if (!heading) {
+			pr_inf(stdout, "%s: %-13s %14s %14s %8s\n", option,
+				"stressor", "ops/s before", "ops/s after", "gain %");
+			pr_yaml(yaml, "ignite-cpu-gain:\n");
+			json_array_begin(json, "ignite-cpu-gain");
+			heading = true;
+		}
+		pr_inf(stdout, "%s: %-13s %14.2f %14.2f %8.2f\n", option,
+			munged, before, after, gain);
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      bogo-ops-per-second-before: %f\n", before);
+		pr_yaml(yaml, "      bogo-ops-per-second-after: %f\n", after);
+		pr_yaml(yaml, "      gain-percent: %f\n", gain);
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_double(json, "bogo-ops-per-second-before", before);
+		json_double(json, "bogo-ops-per-second-after", after);
+		json_double(json, "gain-percent", gain);
+		json_obj_end(json);
+	}
+	if (heading) {
+		pr_yaml(yaml, "\n");
+		json_array_end(json);
+	}
+	free(ignite_freq);
+	ignite_freq = NULL;
+}
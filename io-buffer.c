@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+#include "stress-ng.h"
+
+#define IO_ALIGN_DEFAULT	(4096)	/* when the device can't be asked */
+
+#if defined(__linux__) && defined(__NR_statx) && defined(STATX_DIOALIGN)
+#define IO_HAVE_STATX_DIOALIGN
+#endif
+
+/*
+ *  io_align_sysfs()
+ *	read a queue attribute of the block device dev, partitions
+ *	have no queue of their own so use that of the whole disk
+ */
+#if defined(__linux__)
+static size_t io_align_sysfs(const dev_t dev, const char *attr)
+{
+	static const char *queues[] = { "queue", "../queue" };
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(queues); i++) {
+		char path[PATH_MAX];
+		unsigned long val;
+		FILE *fp;
+		int n;
+
+		(void)snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/%s/%s",
+			major(dev), minor(dev), queues[i], attr);
+		fp = fopen(path, "r");
+		if (!fp)
+			continue;
+		n = fscanf(fp, "%lu", &val);
+		(void)fclose(fp);
+		if (n == 1)
+			return (size_t)val;
+	}
+	return 0;
+}
+#endif
+
+/*
+ *  io_align_pow2()
+ *	sanity check an alignment, it must be a power of 2
+ *	no bigger than 64K to be believable
+ */
+static inline bool io_align_pow2(const size_t align)
+{
+	return align && !(align & (align - 1)) && (align <= 64 * KB);
+}
+
+/*
+ *  io_direct_align()
+ *	the O_DIRECT buffer address alignment and the I/O size and
+ *	offset alignment of the file or directory path. statx(2)
+ *	STATX_DIOALIGN answers for regular files on Linux 6.1 and
+ *	later, otherwise the dma_alignment and logical_block_size of
+ *	the device queue in sysfs are used, so 512e and 4Kn devices
+ *	get what they need. Falls back to 4K when neither is known
+ */
+void io_direct_align(const char *path, size_t *mem_align, size_t *io_align)
+{
+	*mem_align = 0;
+	*io_align = 0;
+
+#if defined(IO_HAVE_STATX_DIOALIGN)
+	{
+		struct statx stx;
+
+		(void)memset(&stx, 0, sizeof(stx));
+		if ((syscall(__NR_statx, AT_FDCWD, path, 0, STATX_DIOALIGN, &stx) == 0) &&
+		    (stx.stx_mask & STATX_DIOALIGN) && stx.stx_dio_offset_align) {
+			*mem_align = stx.stx_dio_mem_align;
+			*io_align = stx.stx_dio_offset_align;
+		}
+	}
+#endif
+#if defined(__linux__)
+	if (!*io_align) {
+		struct stat statbuf;
+
+		if ((stat(path, &statbuf) == 0) && major(statbuf.st_dev)) {
+			const size_t dma = io_align_sysfs(statbuf.st_dev, "dma_alignment");
+
+			*io_align = io_align_sysfs(statbuf.st_dev, "logical_block_size");
+			/* dma_alignment is a mask */
+			*mem_align = dma ? dma + 1 : *io_align;
+		}
+	}
+#else
+	(void)path;
+#endif
+	if (!io_align_pow2(*io_align))
+		*io_align = IO_ALIGN_DEFAULT;
+	if (!io_align_pow2(*mem_align))
+		*mem_align = *io_align;
+}
+
+/*
+ *  io_buffers_alloc()
+ *	map count buffers of size bytes, rounded up to the I/O
+ *	alignment of path, for O_DIRECT I/O. The buffers are
+ *	contiguous so they can be registered with io_uring in one
+ *	go, are backed as --hugepages asks and are pre-faulted so
+ *	the first I/Os don't take page faults. Returns -errno on
+ *	failure
+ */
+int io_buffers_alloc(
+	io_buffers_t *bufs,
+	const char *path,
+	const size_t size,
+	const uint32_t count)
+{
+	const hugepages_t mode = stress_get_hugepages();
+	const size_t page_size = stress_get_pagesize();
+	size_t align;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void *ptr;
+
+	(void)memset(bufs, 0, sizeof(*bufs));
+	io_direct_align(path, &bufs->mem_align, &bufs->io_align);
+	align = STRESS_MAXIMUM(bufs->mem_align, bufs->io_align);
+	bufs->size = size;
+	bufs->count = count;
+	bufs->stride = (size + align - 1) & ~(align - 1);
+
+	/* mmap is page aligned, so only bigger alignments need slack */
+	bufs->map_size = hugepages_round(mode, (bufs->stride * count) +
+		((align > page_size) ? align : 0));
+#if defined(MAP_POPULATE)
+	flags |= MAP_POPULATE;
+#endif
+	ptr = mmap_hugepages(mode, bufs->map_size, PROT_READ | PROT_WRITE, flags, -1);
+	if (ptr == MAP_FAILED) {
+		const int err = errno;
+
+		(void)memset(bufs, 0, sizeof(*bufs));
+		return -err;
+	}
+	bufs->map = ptr;
+	bufs->base = (uint8_t *)(((uintptr_t)ptr + align - 1) & ~(uintptr_t)(align - 1));
+
+	return 0;
+}
+
+/*
+ *  io_buffers_free()
+ *	unmap the buffers
+ */
+void io_buffers_free(io_buffers_t *bufs)
+{
+	if (bufs->map)
+		(void)munmap(bufs->map, bufs->map_size);
+	(void)memset(bufs, 0, sizeof(*bufs));
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#include "stress-ng.h"
+
+#if defined(__linux__)
+/*
+ *  io_stats_task()
+ *	read the I/O accounting of this process from
+ *	/proc/self/io, needs CONFIG_TASK_IO_ACCOUNTING
+ */
+static bool io_stats_task(stress_io_stats_t *s)
+{
+	char buf[128];
+	FILE *fp;
+	int n = 0;
+
+	fp = fopen("/proc/self/io", "r");
+	if (!fp)
+		return false;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (sscanf(buf, "rchar: %" SCNu64, &s->rchar) == 1)
+			n++;
+		else if (sscanf(buf, "wchar: %" SCNu64, &s->wchar) == 1)
+			n++;
+		else if (sscanf(buf, "read_bytes: %" SCNu64, &s->read_bytes) == 1)
+			n++;
+		else if (sscanf(buf, "write_bytes: %" SCNu64, &s->write_bytes) == 1)
+			n++;
+		else if (sscanf(buf, "cancelled_write_bytes: %" SCNu64,
+				&s->cancelled_write_bytes) == 1)
+			n++;
+	}
+	(void)fclose(fp);
+	return n == 5;
+}
+
+/*
+ *  io_stats_vm()
+ *	read the system wide paging and dirty page
+ *	counts from /proc/vmstat
+ */
+static bool io_stats_vm(stress_io_stats_t *s)
+{
+	char buf[128];
+	FILE *fp;
+	int n = 0;
+
+	fp = fopen("/proc/vmstat", "r");
+	if (!fp)
+		return false;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (sscanf(buf, "nr_dirty %" SCNu64, &s->nr_dirty) == 1)
+			n++;
+		else if (sscanf(buf, "nr_writeback %" SCNu64, &s->nr_writeback) == 1)
+			n++;
+		else if (sscanf(buf, "pgpgin %" SCNu64, &s->pgpgin) == 1)
+			n++;
+		else if (sscanf(buf, "pgpgout %" SCNu64, &s->pgpgout) == 1)
+			n++;
+	}
+	(void)fclose(fp);
+	return n == 4;
+}
+#endif
+
+/*
+ *  io_stats_begin()
+ *	snapshot the process and system I/O counters
+ *	before a file stressor starts its work
+ */
+void io_stats_begin(stress_io_stats_t *start)
+{
+	memset(start, 0, sizeof(*start));
+#if defined(__linux__)
+	start->task_ok = io_stats_task(start);
+	start->vm_ok = io_stats_vm(start);
+#endif
+}
+
+/*
+ *  io_stats_get()
+ *	read the I/O accounting of this process, returns
+ *	false if it is not available
+ */
+bool io_stats_get(stress_io_stats_t *s)
+{
+	memset(s, 0, sizeof(*s));
+#if defined(__linux__)
+	s->task_ok = io_stats_task(s);
+#endif
+	return s->task_ok;
+}
+
+/*
+ *  io_stats_end()
+ *	compare the counters against the start snapshot and
+ *	report the device I/O per bogo op, how much of the
+ *	syscall I/O never reached the device, the system
+ *	paging and the change in dirty and writeback memory
+ *	as stressor metrics
+ */
+void io_stats_end(const stress_io_stats_t *start, const uint64_t ops)
+{
+#if defined(__linux__)
+	stress_io_stats_t end;
+	const size_t idx = STRESS_MISC_METRIC_IO;
+
+	memset(&end, 0, sizeof(end));
+	if (start->task_ok && io_stats_task(&end)) {
+		const uint64_t written = end.write_bytes - start->write_bytes;
+		const uint64_t cancelled = end.cancelled_write_bytes -
+			start->cancelled_write_bytes;
+		const uint64_t device = (end.read_bytes - start->read_bytes) +
+			((written > cancelled) ? written - cancelled : 0);
+		const uint64_t syscall = (end.rchar - start->rchar) +
+			(end.wchar - start->wchar);
+
+		if (ops)
+			stress_misc_metric_set(idx, "device bytes per bogo op",
+				(double)device / (double)ops);
+		if (syscall)
+			stress_misc_metric_set(idx + 1, "page cache absorbed (%)",
+				(device >= syscall) ? 0.0 :
+				100.0 * (double)(syscall - device) / (double)syscall);
+	}
+	if (start->vm_ok && io_stats_vm(&end)) {
+		const double page_mb = (double)stress_get_pagesize() / (double)MB;
+		const double before = (double)(start->nr_dirty + start->nr_writeback);
+		const double after = (double)(end.nr_dirty + end.nr_writeback);
+
+		stress_misc_metric_set(idx + 2, "system paged in+out (MB)",
+			(double)((end.pgpgin - start->pgpgin) +
+				 (end.pgpgout - start->pgpgout)) / (double)KB);
+		stress_misc_metric_set(idx + 3, "dirty+writeback change (MB)",
+			(after - before) * page_mb);
+	}
+#else
+	(void)start;
+	(void)ops;
+#endif
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_URING)
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/*
+ *  Minimal raw io_uring helpers for the stressors, driven
+ *  directly by the system calls so there is no liburing
+ *  dependency
+ */
+
+#define URING_SQ_IDLE		(10)		/* SQPOLL idle time (ms) */
+
+/*
+ *  uring_setup()
+ *	create and map a ring of at least entries SQEs,
+ *	returns -errno on failure
+ */
+int uring_setup(stress_uring_t *r, const unsigned entries, const bool sqpoll)
+{
+	struct io_uring_params p;
+	unsigned *sq_array, i;
+	uint8_t *sq, *cq;
+
+	memset(r, 0, sizeof(*r));
+	memset(&p, 0, sizeof(p));
+	if (sqpoll) {
+		p.flags = IORING_SETUP_SQPOLL;
+		p.sq_thread_idle = URING_SQ_IDLE;
+	}
+	r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+	if (r->fd < 0)
+		return -errno;
+	r->sqpoll = sqpoll;
+
+	r->sq_ring_sz = p.sq_off.array + (p.sq_entries * sizeof(unsigned));
+	r->cq_ring_sz = p.cq_off.cqes +
+		(p.cq_entries * sizeof(struct io_uring_cqe));
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cq_ring_sz > r->sq_ring_sz)
+			r->sq_ring_sz = r->cq_ring_sz;
+		r->cq_ring_sz = r->sq_ring_sz;
+	}
+	r->sq_ring = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED)
+		goto err_close;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ring = r->sq_ring;
+	} else {
+		r->cq_ring = mmap(NULL, r->cq_ring_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+		if (r->cq_ring == MAP_FAILED)
+			goto err_unmap_sq;
+	}
+	r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED)
+		goto err_unmap_cq;
+
+	sq = (uint8_t *)r->sq_ring;
+	cq = (uint8_t *)r->cq_ring;
+	r->sq_head = (unsigned *)(sq + p.sq_off.head);
+	r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	r->sq_flags = (unsigned *)(sq + p.sq_off.flags);
+	r->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+	r->sq_entries = p.sq_entries;
+	r->cq_head = (unsigned *)(cq + p.cq_off.head);
+	r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	r->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	/* SQ slots map 1:1 onto the SQE array, so fill it in once */
+	sq_array = (unsigned *)(sq + p.sq_off.array);
+	for (i = 0; i < p.sq_entries; i++)
+		sq_array[i] = i;
+	r->sqe_tail = r->sqe_head = *r->sq_tail;
+
+	return 0;
+
+err_unmap_cq:
+	if (r->cq_ring != r->sq_ring)
+		(void)munmap(r->cq_ring, r->cq_ring_sz);
+err_unmap_sq:
+	(void)munmap(r->sq_ring, r->sq_ring_sz);
+err_close:
+	i = (unsigned)errno;
+	(void)close(r->fd);
+	return -(int)i;
+}
+
+/*
+ *  uring_free()
+ *	unmap and close a ring
+ */
+void uring_free(stress_uring_t *r)
+{
+	(void)munmap(r->sqes, r->sqes_sz);
+	if (r->cq_ring != r->sq_ring)
+		(void)munmap(r->cq_ring, r->cq_ring_sz);
+	(void)munmap(r->sq_ring, r->sq_ring_sz);
+	(void)close(r->fd);
+}
+
+/*
+ *  uring_submit()
+ *	publish the queued SQEs and optionally wait for
+ *	wait_nr completions, all in one io_uring_enter call;
+ *	with SQPOLL the call is skipped unless we need to
+ *	wait or the kernel thread has gone idle
+ */
+int uring_submit(stress_uring_t *r, const unsigned wait_nr)
+{
+	const unsigned to_submit = r->sqe_tail - r->sqe_head;
+	unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+	int ret;
+
+	if (to_submit) {
+		__atomic_store_n(r->sq_tail, r->sqe_tail, __ATOMIC_RELEASE);
+		r->sqe_head = r->sqe_tail;
+		r->submits++;
+		r->submitted += to_submit;
+	}
+	if (r->sqpoll) {
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (to_submit &&
+		    (__atomic_load_n(r->sq_flags, __ATOMIC_RELAXED) &
+		     IORING_SQ_NEED_WAKEUP))
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		if (!flags)
+			return 0;
+		ret = (int)syscall(__NR_io_uring_enter, r->fd, 0,
+			wait_nr, flags, NULL, 0);
+	} else {
+		if (!to_submit && !wait_nr)
+			return 0;
+		ret = (int)syscall(__NR_io_uring_enter, r->fd, to_submit,
+			wait_nr, flags, NULL, 0);
+	}
+	r->enters++;
+
+	return (ret < 0) ? -errno : ret;
+}
+
+/*
+ *  uring_sqe()
+ *	get a zeroed SQE, flushing the SQ if it is full
+ */
+struct io_uring_sqe *uring_sqe(stress_uring_t *r)
+{
+	struct io_uring_sqe *sqe;
+
+	while (r->sqe_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >=
+	       r->sq_entries) {
+		if (uring_submit(r, 0) < 0)
+			return NULL;
+	}
+	sqe = &r->sqes[r->sqe_tail & r->sq_mask];
+	r->sqe_tail++;
+	memset(sqe, 0, sizeof(*sqe));
+
+	return sqe;
+}
+
+/*
+ *  uring_prep_rw()
+ *	queue a read/write style op, returns the SQE so
+ *	the caller can fill in any op specific fields
+ */
+struct io_uring_sqe *uring_prep_rw(
+	stress_uring_t *r,
+	const uint8_t opcode,
+	const int fd,
+	const void *addr,
+	const uint32_t len,
+	const uint64_t off,
+	const uint64_t user_data)
+{
+	struct io_uring_sqe *sqe = uring_sqe(r);
+
+	if (!sqe)
+		return NULL;
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)addr;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->user_data = user_data;
+
+	return sqe;
+}
+
+/*
+ *  uring_register_buffer()
+ *	register buf as fixed buffer 0
+ */
+int uring_register_buffer(stress_uring_t *r, void *buf, const size_t len)
+{
+	struct iovec iov;
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	if (syscall(__NR_io_uring_register, r->fd,
+			IORING_REGISTER_BUFFERS, &iov, 1) < 0)
+		return -errno;
+	return 0;
+}
+
+/*
+ *  uring_register_files()
+ *	register fds as fixed files 0..n-1, 0 ends any
+ *	previous registration
+ */
+int uring_register_files(stress_uring_t *r, const int *fds, const unsigned n)
+{
+	if (n) {
+		if (syscall(__NR_io_uring_register, r->fd,
+				IORING_REGISTER_FILES, fds, n) < 0)
+			return -errno;
+	} else {
+		if (syscall(__NR_io_uring_register, r->fd,
+				IORING_UNREGISTER_FILES, NULL, 0) < 0)
+			return -errno;
+	}
+	return 0;
+}
+
+#endif
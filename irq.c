@@ -0,0 +1,628 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+static const char *option = "irq-stats";
+
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include <signal.h>
+#include <time.h>
+
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+
+#define IRQ_SAMPLE_INTERVAL	(250)	/* ms between samples of instance CPUs */
+#define IRQ_NAME_LEN		(48)	/* source name, e.g. 33:virtio1-input.0 */
+#define IRQ_SOURCES_MAX		(2048)	/* interrupt and softirq sources */
+#define IRQ_HEAVY_RATE		(5000.0) /* interrupts/sec, floor for a heavy CPU */
+#define IRQ_HEAVY_SHARE		(50)	/* % of samples on heavy CPUs to flag */
+
+/* Interrupt counts per source and CPU */
+typedef struct {
+	size_t n;			/* sources */
+	char (*names)[IRQ_NAME_LEN];	/* source names */
+	uint64_t *counts;		/* n * irq_cpus counts */
+} irq_snapshot_t;
+
+/* CPUs an instance was seen on */
+typedef struct {
+	uint32_t samples;		/* samples the instance was running */
+	uint32_t heavy;			/* samples on a heavy interrupt CPU */
+	double exposure;		/* sum of interrupts/sec of the CPUs sampled */
+} irq_instance_t;
+
+static int32_t irq_top;			/* sources reported, 0 = disabled */
+static bool irq_available;
+static size_t irq_cpus;
+static irq_snapshot_t irq_start;	/* counts at the start of a phase */
+static irq_snapshot_t irq_total;	/* counts over all the phases */
+static double irq_time_start;
+static double irq_secs;			/* time of all the phases */
+static uint32_t *irq_cpu_samples;	/* slots * irq_cpus samples of the phase */
+static irq_instance_t *irq_instances;	/* per stats slot */
+static int32_t irq_slots;
+static const proc_info_t *irq_procs;
+
+#if defined(HAVE_LIB_PTHREAD)
+static pthread_t irq_pthread;
+static pthread_mutex_t irq_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t irq_cond = PTHREAD_COND_INITIALIZER;
+static bool irq_keep_sampling;
+static bool irq_pthread_running;
+#endif
+
+/*
+ *  stress_set_irq_stats()
+ *	report the top N interrupt sources per run
+ */
+void stress_set_irq_stats(const char *opt)
+{
+	irq_top = (int32_t)get_uint64(opt);
+	check_range(option, (uint64_t)irq_top, 1, 100);
+}
+
+/*
+ *  irq_timer()
+ *	local timer interrupts and softirqs tick on every busy
+ *	CPU whatever the device interrupt load is, so are not
+ *	counted as interrupt load
+ */
+static bool irq_timer(const char *name)
+{
+	return !strcmp(name, "LOC") || !strcmp(name, "softirq:TIMER") ||
+	       !strcmp(name, "softirq:HRTIMER");
+}
+
+/*
+ *  irq_snapshot_alloc()
+ *	allocate an empty snapshot
+ */
+static bool irq_snapshot_alloc(irq_snapshot_t *s)
+{
+	s->n = 0;
+	s->names = calloc(IRQ_SOURCES_MAX, sizeof(*s->names));
+	s->counts = calloc(IRQ_SOURCES_MAX * irq_cpus, sizeof(*s->counts));
+	return s->names && s->counts;
+}
+
+static void irq_snapshot_free(irq_snapshot_t *s)
+{
+	free(s->names);
+	free(s->counts);
+	s->names = NULL;
+	s->counts = NULL;
+	s->n = 0;
+}
+
+/*
+ *  irq_snapshot_find()
+ *	index of a source, added if it is new, or -1 if the
+ *	snapshot is full. The sources are nearly always in the
+ *	same order, so the hint is tried first
+ */
+static ssize_t irq_snapshot_find(irq_snapshot_t *s, const char *name, const size_t hint)
+{
+	size_t i;
+
+	if ((hint < s->n) && !strcmp(s->names[hint], name))
+		return (ssize_t)hint;
+	for (i = 0; i < s->n; i++)
+		if (!strcmp(s->names[i], name))
+			return (ssize_t)i;
+	if (s->n >= IRQ_SOURCES_MAX)
+		return -1;
+	(void)snprintf(s->names[s->n], IRQ_NAME_LEN, "%s", name);
+	(void)memset(&s->counts[s->n * irq_cpus], 0, irq_cpus * sizeof(*s->counts));
+	return (ssize_t)s->n++;
+}
+
+/*
+ *  irq_read()
+ *	add the per CPU counts of /proc/interrupts or
+ *	/proc/softirqs to a snapshot, the columns are the
+ *	online CPUs named in the header line
+ */
+static bool irq_read(irq_snapshot_t *s, const char *path, const char *prefix)
+{
+	FILE *fp;
+	char line[4096];
+	int cols[1024];
+	size_t ncols = 0;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return false;
+	if (fgets(line, sizeof(line), fp)) {
+		char *tok, *saveptr = NULL;
+
+		for (tok = strtok_r(line, " \t\n", &saveptr); tok && (ncols < SIZEOF_ARRAY(cols));
+		     tok = strtok_r(NULL, " \t\n", &saveptr)) {
+			int cpu;
+
+			if (sscanf(tok, "CPU%d", &cpu) == 1)
+				cols[ncols++] = cpu;
+		}
+	}
+	while (fgets(line, sizeof(line), fp)) {
+		char *ptr = line + strspn(line, " "), *colon, *end, *desc;
+		char name[IRQ_NAME_LEN];
+		uint64_t counts[SIZEOF_ARRAY(cols)];
+		size_t c;
+		ssize_t idx;
+
+		if ((colon = strchr(ptr, ':')) == NULL)
+			continue;
+		*colon = '\0';
+		for (c = 0, end = colon + 1; c < ncols; c++) {
+			char *next;
+
+			counts[c] = strtoull(end, &next, 10);
+			if (next == end)
+				break;
+			end = next;
+		}
+		/* ERR and MIS are a single system wide count */
+		if (c < ncols)
+			continue;
+
+		/* Numbered interrupts are named after their device */
+		desc = end + strspn(end, " \t");
+		for (c = strcspn(desc, "\n"); c && isspace((unsigned char)desc[c - 1]); c--)
+			;
+		desc[c] = '\0';
+		if (isdigit((unsigned char)*ptr) && *desc) {
+			const char *dev = strrchr(desc, ' ');
+
+			(void)snprintf(name, sizeof(name), "%s:%s", ptr, dev ? dev + 1 : desc);
+		} else {
+			(void)snprintf(name, sizeof(name), "%s%s", prefix, ptr);
+		}
+		idx = irq_snapshot_find(s, name, s->n);
+		if (idx < 0)
+			break;
+		for (c = 0; c < ncols; c++)
+			if ((cols[c] >= 0) && ((size_t)cols[c] < irq_cpus))
+				s->counts[(size_t)idx * irq_cpus + (size_t)cols[c]] = counts[c];
+	}
+	(void)fclose(fp);
+	return true;
+}
+
+/*
+ *  irq_snapshot()
+ *	take the interrupt and softirq counts
+ */
+static bool irq_snapshot(irq_snapshot_t *s)
+{
+	bool ok;
+
+	s->n = 0;
+	ok = irq_read(s, "/proc/interrupts", "");
+	(void)irq_read(s, "/proc/softirqs", "softirq:");
+	return ok;
+}
+
+/*
+ *  irq_sample()
+ *	count the CPU each running instance is on
+ */
+static void irq_sample(void)
+{
+	int32_t i, j;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		const proc_info_t *p = &irq_procs[i];
+
+		for (j = 0; j < p->started_procs; j++) {
+			const int32_t slot = p->stats_index + j;
+			char path[64], buf[1024], *ptr;
+			int cpu, field;
+			const pid_t pid = p->pids[j];
+
+			if ((pid <= 0) || (slot >= irq_slots))
+				continue;
+			(void)snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+			if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+				continue;
+			/* processor is field 39, counted from after the comm */
+			if ((ptr = strrchr(buf, ')')) == NULL)
+				continue;
+			for (field = 2; ptr && (field < 39); field++)
+				ptr = strchr(ptr + 1, ' ');
+			if (!ptr || (sscanf(ptr, "%d", &cpu) != 1) ||
+			    (cpu < 0) || ((size_t)cpu >= irq_cpus))
+				continue;
+			irq_cpu_samples[(size_t)slot * irq_cpus + (size_t)cpu]++;
+		}
+	}
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  irq_sample_thread()
+ *	periodically sample the instance CPUs until told to stop
+ */
+static void *irq_sample_thread(void *arg)
+{
+	static void *nowt = NULL;
+	sigset_t set;
+	struct timespec abstime;
+
+	(void)arg;
+
+	/* Leave all signal handling to the main parent thread */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+	(void)clock_gettime(CLOCK_REALTIME, &abstime);
+
+	pthread_mutex_lock(&irq_mutex);
+	while (irq_keep_sampling) {
+		abstime.tv_nsec += IRQ_SAMPLE_INTERVAL * 1000000;
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_nsec -= 1000000000;
+			abstime.tv_sec++;
+		}
+		while (irq_keep_sampling &&
+		       (pthread_cond_timedwait(&irq_cond, &irq_mutex, &abstime) == 0))
+			;
+		irq_sample();
+	}
+	pthread_mutex_unlock(&irq_mutex);
+
+	return &nowt;
+}
+#endif
+
+/*
+ *  stress_irq_init()
+ *	allocate the snapshots and the per instance CPU samples
+ */
+void stress_irq_init(const int32_t slots)
+{
+	const int32_t cpus = stress_get_processors_configured();
+
+	if (!irq_top)
+		return;
+	irq_cpus = (cpus > 0) ? (size_t)cpus : 1;
+	irq_slots = slots;
+	irq_cpu_samples = calloc((size_t)slots * irq_cpus, sizeof(*irq_cpu_samples));
+	irq_instances = calloc((size_t)slots, sizeof(*irq_instances));
+	if (!irq_cpu_samples || !irq_instances ||
+	    !irq_snapshot_alloc(&irq_start) || !irq_snapshot_alloc(&irq_total)) {
+		pr_inf(stderr, "%s: out of memory, interrupts will not be "
+			"reported\n", option);
+		stress_irq_free();
+		return;
+	}
+	irq_available = irq_snapshot(&irq_start);
+	if (!irq_available) {
+		pr_inf(stderr, "%s: cannot read /proc/interrupts\n", option);
+		stress_irq_free();
+	}
+}
+
+/*
+ *  stress_irq_start()
+ *	take the interrupt counts at the start of a phase and
+ *	start sampling the CPUs its instances run on
+ */
+void stress_irq_start(const proc_info_t procs[STRESS_MAX])
+{
+	if (!irq_available)
+		return;
+
+	irq_procs = procs;
+	(void)memset(irq_cpu_samples, 0, (size_t)irq_slots * irq_cpus * sizeof(*irq_cpu_samples));
+	(void)irq_snapshot(&irq_start);
+	irq_time_start = time_now();
+
+#if defined(HAVE_LIB_PTHREAD)
+	{
+		int ret;
+
+		irq_keep_sampling = true;
+		ret = pthread_create(&irq_pthread, NULL, irq_sample_thread, NULL);
+		if (ret) {
+			pr_err(stderr, "%s: cannot create sampling thread: "
+				"errno=%d (%s)\n", option, ret, strerror(ret));
+			return;
+		}
+		irq_pthread_running = true;
+	}
+#endif
+}
+
+/*
+ *  stress_irq_stop()
+ *	add the interrupts of the phase to the run totals and
+ *	charge each instance with the interrupt rate of the CPUs
+ *	it was sampled on. A CPU is heavy when its interrupt rate
+ *	is over IRQ_HEAVY_RATE and twice the mean of the CPUs
+ */
+void stress_irq_stop(void)
+{
+	irq_snapshot_t end;
+	double *rates, secs, mean = 0.0;
+	size_t s, c;
+	int32_t n;
+
+	if (!irq_available)
+		return;
+
+#if defined(HAVE_LIB_PTHREAD)
+	if (irq_pthread_running) {
+		pthread_mutex_lock(&irq_mutex);
+		irq_keep_sampling = false;
+		pthread_cond_signal(&irq_cond);
+		pthread_mutex_unlock(&irq_mutex);
+		(void)pthread_join(irq_pthread, NULL);
+		irq_pthread_running = false;
+	}
+#else
+	irq_sample();
+#endif
+	secs = time_now() - irq_time_start;
+	rates = calloc(irq_cpus, sizeof(*rates));
+	if (!rates || !irq_snapshot_alloc(&end) || !irq_snapshot(&end)) {
+		free(rates);
+		irq_snapshot_free(&end);
+		return;
+	}
+
+	for (s = 0; s < end.n; s++) {
+		const ssize_t st = irq_snapshot_find(&irq_start, end.names[s], s);
+		const ssize_t t = irq_snapshot_find(&irq_total, end.names[s], s);
+		const bool timer = irq_timer(end.names[s]);
+
+		for (c = 0; c < irq_cpus; c++) {
+			const uint64_t now = end.counts[s * irq_cpus + c];
+			const uint64_t then = (st >= 0) ?
+				irq_start.counts[(size_t)st * irq_cpus + c] : 0;
+			const uint64_t delta = (now > then) ? now - then : 0;
+
+			if (t >= 0)
+				irq_total.counts[(size_t)t * irq_cpus + c] += delta;
+			if (!timer && (secs > 0.0))
+				rates[c] += (double)delta / secs;
+		}
+	}
+	irq_secs += secs;
+	for (c = 0; c < irq_cpus; c++)
+		mean += rates[c];
+	mean /= (double)irq_cpus;
+
+	for (n = 0; n < irq_slots; n++) {
+		irq_instance_t *inst = &irq_instances[n];
+
+		for (c = 0; c < irq_cpus; c++) {
+			const uint32_t samples = irq_cpu_samples[(size_t)n * irq_cpus + c];
+			const bool heavy = (rates[c] >= IRQ_HEAVY_RATE) &&
+				((irq_cpus == 1) || (rates[c] >= 2.0 * mean));
+
+			inst->samples += samples;
+			inst->exposure += (double)samples * rates[c];
+			if (heavy)
+				inst->heavy += samples;
+		}
+	}
+	free(rates);
+	irq_snapshot_free(&end);
+}
+
+/* A source on a CPU, for sorting */
+typedef struct {
+	size_t source;
+	size_t cpu;
+	uint64_t count;
+} irq_top_t;
+
+/*
+ *  irq_top_cmp()
+ *	sort by descending count
+ */
+static int irq_top_cmp(const void *p1, const void *p2)
+{
+	const irq_top_t *t1 = (const irq_top_t *)p1;
+	const irq_top_t *t2 = (const irq_top_t *)p2;
+
+	if (t1->count < t2->count)
+		return 1;
+	if (t1->count > t2->count)
+		return -1;
+	return 0;
+}
+
+/*
+ *  stress_irq_dump()
+ *	report the busiest interrupt sources per CPU over the
+ *	run and the interrupt load on the CPUs each stressor's
+ *	instances ran on, flagging the instances that mostly
+ *	ran on CPUs with a heavy interrupt load
+ */
+void stress_irq_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	irq_top_t *top;
+	size_t s, c, ntop = 0, k;
+	int32_t i;
+
+	if (!irq_available || (irq_secs <= 0.0))
+		return;
+
+	top = calloc(irq_total.n * irq_cpus, sizeof(*top));
+	if (!top)
+		return;
+	for (s = 0; s < irq_total.n; s++) {
+		for (c = 0; c < irq_cpus; c++) {
+			const uint64_t count = irq_total.counts[s * irq_cpus + c];
+
+			if (!count)
+				continue;
+			top[ntop].source = s;
+			top[ntop].cpu = c;
+			top[ntop].count = count;
+			ntop++;
+		}
+	}
+	qsort(top, ntop, sizeof(*top), irq_top_cmp);
+	if (ntop > (size_t)irq_top)
+		ntop = (size_t)irq_top;
+
+	pr_yaml(yaml, "interrupts:\n");
+	json_obj_begin(json, "interrupts");
+	pr_yaml(yaml, "  top-sources:\n");
+	json_array_begin(json, "top-sources");
+	pr_inf(stdout, "%-32s %5s %12s %12s\n", "interrupt source", "CPU",
+		"count", "per sec");
+	for (k = 0; k < ntop; k++) {
+		const char *name = irq_total.names[top[k].source];
+		const double rate = (double)top[k].count / irq_secs;
+
+		pr_inf(stdout, "%-32s %5zu %12" PRIu64 " %12.1f\n",
+			name, top[k].cpu, top[k].count, rate);
+		pr_yaml(yaml, "    - source: %s\n", name);
+		pr_yaml(yaml, "      cpu: %zu\n", top[k].cpu);
+		pr_yaml(yaml, "      count: %" PRIu64 "\n", top[k].count);
+		pr_yaml(yaml, "      per-second: %f\n", rate);
+		json_obj_begin(json, NULL);
+		json_str(json, "source", name);
+		json_uint(json, "cpu", top[k].cpu);
+		json_uint(json, "count", top[k].count);
+		json_double(json, "per-second", rate);
+		json_obj_end(json);
+	}
+	json_array_end(json);
+	free(top);
+
+	pr_yaml(yaml, "  stressors:\n");
+	json_array_begin(json, "stressors");
+	pr_inf(stdout, "%-13s %9s %14s %8s\n", "stressor", "instances",
+		"CPU irqs/sec", "flagged");
+	for (i = 0; i < STRESS_MAX; i++) {
+		const char *munged;
+		uint32_t samples = 0, flagged = 0;
+		double exposure = 0.0, rate;
+		int32_t j;
+
+		if (!procs[i].started_procs)
+			continue;
+		munged = munge_underscore(stressors[i].name);
+		for (j = 0; j < procs[i].started_procs; j++) {
+			const irq_instance_t *inst = &irq_instances[procs[i].stats_index + j];
+
+			samples += inst->samples;
+			exposure += inst->exposure;
+			if (inst->samples &&
+			    (inst->heavy * 100 >= inst->samples * IRQ_HEAVY_SHARE)) {
+				flagged++;
+				pr_inf(stdout, "%s: instance %" PRId32 " ran on CPUs "
+					"with a heavy interrupt load in %.0f%% of "
+					"its samples\n", munged, j, 100.0 *
+					(double)inst->heavy / (double)inst->samples);
+			}
+		}
+		rate = samples ? exposure / (double)samples : 0.0;
+		pr_inf(stdout, "%-13s %9" PRId32 " %14.1f %8" PRIu32 "\n",
+			munged, procs[i].started_procs, rate, flagged);
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      cpu-interrupts-per-second: %f\n", rate);
+		pr_yaml(yaml, "      instances-flagged: %" PRIu32 "\n", flagged);
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_double(json, "cpu-interrupts-per-second", rate);
+		json_uint(json, "instances-flagged", flagged);
+		json_obj_end(json);
+	}
+	json_array_end(json);
+	json_obj_end(json);
+	pr_yaml(yaml, "\n");
+}
+
+/*
+ *  stress_irq_free()
+ *	free the snapshots and samples
+ */
+void stress_irq_free(void)
+{
+	irq_snapshot_free(&irq_start);
+	irq_snapshot_free(&irq_total);
+	free(irq_cpu_samples);
+	free(irq_instances);
+	irq_cpu_samples = NULL;
+	irq_instances = NULL;
+	irq_available = false;
+}
+
+#else
+void stress_set_irq_stats(const char *opt)
+{
+	(void)opt;
+
+	fprintf(stderr, "%s: interrupt statistics not supported\n", option);
+	exit(EXIT_FAILURE);
+}
+
+void stress_irq_init(const int32_t slots)
+{
+	(void)slots;
+}
+
+void stress_irq_start(const proc_info_t procs[STRESS_MAX])
+{
+	(void)procs;
+}
+
+void stress_irq_stop(void)
+{
+}
+
+void stress_irq_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	(void)yaml;
+	(void)json;
+	(void)stressors;
+	(void)procs;
+}
+
+void stress_irq_free(void)
+{
+}
+#endif
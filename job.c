@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "stress-ng.h"
+
+static const char *option = "job";
+
+#define JOB_ARGS_MAX		(4096)	/* max options from a job file */
+#define JOB_MIX_MAX		(64)	/* max named mixes in a job file */
+#define JOB_MIX_NAME_LEN	(64)	/* max length of a mix name */
+
+/*
+ *  job_args_add()
+ *	append an argument to the expanded command line
+ */
+static int job_args_add(
+	char **args,
+	int *n,
+	const char *arg)
+{
+	if (*n >= JOB_ARGS_MAX) {
+		pr_err(stderr, "%s: more than %d options\n",
+			option, JOB_ARGS_MAX);
+		return -1;
+	}
+	args[(*n)++] = strdup(arg);
+	if (!args[*n - 1]) {
+		pr_err(stderr, "%s: out of memory\n", option);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  job_mix_name()
+ *	if the line is a [name] mix header return the name,
+ *	or NULL if it is an option line
+ */
+static char *job_mix_name(char *str, const char *jobfile, const size_t line)
+{
+	char *end;
+
+	if (*str != '[')
+		return NULL;
+	end = strchr(str, ']');
+	if (!end || (end == str + 1) || (end - str > JOB_MIX_NAME_LEN)) {
+		pr_err(stderr, "%s: %s line %zu: bad mix name\n",
+			option, jobfile, line);
+		return "";
+	}
+	*end = '\0';
+	return str + 1;
+}
+
+/*
+ *  job_parse()
+ *	add the options of a job file to args, options before the
+ *	first [name] header apply to every mix, the options under
+ *	a header only when that mix is selected. Each line is an
+ *	option without the leading --, followed by its argument.
+ *	If mix is NULL the file must have at most one mix.
+ */
+static int job_parse(
+	const char *jobfile,
+	const char *mix,
+	char **args,
+	int *n)
+{
+	FILE *fp;
+	char buf[4096];
+	char mixes[JOB_MIX_MAX][JOB_MIX_NAME_LEN + 1];
+	size_t line = 0, mixes_count = 0, i;
+	bool in_mix = true, found = false;
+	int rc = 0;
+
+	fp = fopen(jobfile, "r");
+	if (!fp) {
+		pr_err(stderr, "%s: cannot open %s: errno=%d (%s)\n",
+			option, jobfile, errno, strerror(errno));
+		return -1;
+	}
+
+	/* Find the mixes first so an unnamed mix can be picked */
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *str = buf + strspn(buf, " \t"), *name;
+
+		line++;
+		name = job_mix_name(str, jobfile, line);
+		if (!name)
+			continue;
+		if (!*name || (mixes_count >= JOB_MIX_MAX)) {
+			if (*name)
+				pr_err(stderr, "%s: %s has more than %d mixes\n",
+					option, jobfile, JOB_MIX_MAX);
+			(void)fclose(fp);
+			return -1;
+		}
+		strncpy(mixes[mixes_count++], name, JOB_MIX_NAME_LEN + 1);
+	}
+	if (!mix && (mixes_count > 1)) {
+		pr_err(stderr, "%s: %s has %zu mixes, select one with "
+			"--job-mix:", option, jobfile, mixes_count);
+		for (i = 0; i < mixes_count; i++)
+			fprintf(stderr, " %s", mixes[i]);
+		fprintf(stderr, "\n");
+		(void)fclose(fp);
+		return -1;
+	}
+	if (!mix && mixes_count)
+		mix = mixes[0];
+	for (i = 0; mix && (i < mixes_count); i++)
+		if (!strcmp(mixes[i], mix))
+			found = true;
+	if (mix && !found) {
+		pr_err(stderr, "%s: %s has no mix '%s'\n",
+			option, jobfile, mix);
+		(void)fclose(fp);
+		return -1;
+	}
+
+	rewind(fp);
+	line = 0;
+	while (fgets(buf, sizeof(buf), fp)) {
+		char *str, *token, *name, *saveptr = NULL;
+		char opt[256];
+
+		line++;
+		str = buf + strspn(buf, " \t");
+		if (*str == '#' || *str == '\n' || *str == '\0')
+			continue;
+		name = job_mix_name(str, jobfile, line);
+		if (name) {
+			in_mix = !strcmp(name, mix);
+			continue;
+		}
+		if (!in_mix)
+			continue;
+
+		token = strtok_r(str, " \t\n", &saveptr);
+		if (!token)
+			continue;
+		/* Options are given without the --, but allow it anyway */
+		while (*token == '-')
+			token++;
+		if (!strcmp(token, "job") || !strcmp(token, "job-mix")) {
+			pr_err(stderr, "%s: %s line %zu: job files cannot "
+				"include other job files\n",
+				option, jobfile, line);
+			rc = -1;
+			break;
+		}
+		snprintf(opt, sizeof(opt), "--%s", token);
+		if (job_args_add(args, n, opt) < 0) {
+			rc = -1;
+			break;
+		}
+		while ((token = strtok_r(NULL, " \t\n", &saveptr)) != NULL) {
+			if (*token == '#')
+				break;
+			if (job_args_add(args, n, token) < 0) {
+				rc = -1;
+				break;
+			}
+		}
+		if (rc < 0)
+			break;
+	}
+	(void)fclose(fp);
+
+	if ((rc == 0) && mix)
+		pr_dbg(stderr, "%s: using mix '%s' of %s\n",
+			option, mix, jobfile);
+	return rc;
+}
+
+/*
+ *  stress_job_expand()
+ *	replace --job file [--job-mix name] on the command line
+ *	with the options of the job file, the options given on the
+ *	command line follow those of the job file and so override
+ *	them. Returns 0 if there is nothing to expand, 1 if the
+ *	command line was expanded and -1 on error.
+ */
+int stress_job_expand(int *argc, char ***argv)
+{
+	const char *jobfile = NULL, *mix = NULL;
+	char **args;
+	int i, n = 0;
+
+	for (i = 1; i < *argc; i++) {
+		const char *arg = (*argv)[i];
+		const char **val;
+		size_t len;
+
+		if (!strncmp(arg, "--job-mix", 9)) {
+			val = &mix;
+			len = 9;
+		} else if (!strncmp(arg, "--job", 5)) {
+			val = &jobfile;
+			len = 5;
+		} else {
+			continue;
+		}
+		if (arg[len] == '=') {
+			*val = arg + len + 1;
+		} else if (arg[len] == '\0') {
+			if (i + 1 >= *argc) {
+				fprintf(stderr, "%s: option '%s' requires "
+					"an argument\n", app_name, arg);
+				return -1;
+			}
+			*val = (*argv)[++i];
+		}
+	}
+	if (!jobfile) {
+		if (mix) {
+			fprintf(stderr, "job-mix requires a --job file\n");
+			return -1;
+		}
+		return 0;
+	}
+
+	args = calloc(JOB_ARGS_MAX + 1, sizeof(*args));
+	if (!args) {
+		pr_err(stderr, "%s: out of memory\n", option);
+		return -1;
+	}
+	args[n++] = (*argv)[0];
+	if (job_parse(jobfile, mix, args, &n) < 0)
+		return -1;
+
+	for (i = 1; i < *argc; i++) {
+		const char *arg = (*argv)[i];
+
+		if (!strcmp(arg, "--job") || !strcmp(arg, "--job-mix")) {
+			i++;
+			continue;
+		}
+		if (!strncmp(arg, "--job=", 6) || !strncmp(arg, "--job-mix=", 10))
+			continue;
+		if (n >= JOB_ARGS_MAX) {
+			pr_err(stderr, "%s: more than %d options\n",
+				option, JOB_ARGS_MAX);
+			return -1;
+		}
+		args[n++] = (*argv)[i];
+	}
+	args[n] = NULL;
+
+	/* The expanded command line lives for the whole run */
+	*argc = n;
+	*argv = args;
+	return 1;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "stress-ng.h"
+
+/*
+ *  A minimal streaming JSON writer, just enough to emit the
+ *  run results as one document. All the functions are no-ops
+ *  when json is NULL so callers need not check if JSON output
+ *  is enabled, in the same way as pr_yaml().
+ */
+struct json {
+	FILE *fp;			/* output file */
+	uint32_t depth;			/* current nesting depth */
+	bool need_comma[JSON_DEPTH_MAX]; /* item already at this depth */
+};
+
+/*
+ *  json_str_put()
+ *	write a string with the JSON escapes
+ */
+static void json_str_put(FILE *fp, const char *str)
+{
+	const unsigned char *ptr;
+
+	fputc('"', fp);
+	for (ptr = (const unsigned char *)str; *ptr; ptr++) {
+		switch (*ptr) {
+		case '"':
+			fputs("\\\"", fp);
+			break;
+		case '\\':
+			fputs("\\\\", fp);
+			break;
+		case '\n':
+			fputs("\\n", fp);
+			break;
+		case '\r':
+			fputs("\\r", fp);
+			break;
+		case '\t':
+			fputs("\\t", fp);
+			break;
+		default:
+			if (*ptr < 0x20)
+				fprintf(fp, "\\u%4.4x", *ptr);
+			else
+				fputc(*ptr, fp);
+			break;
+		}
+	}
+	fputc('"', fp);
+}
+
+/*
+ *  json_key()
+ *	start a new item at the current depth, write
+ *	the key if the item is in an object
+ */
+static void json_key(json_t *json, const char *key)
+{
+	if (json->need_comma[json->depth])
+		fputc(',', json->fp);
+	json->need_comma[json->depth] = true;
+	fprintf(json->fp, "\n%*s", (int)(json->depth * 2), "");
+	if (key) {
+		json_str_put(json->fp, key);
+		fputs(": ", json->fp);
+	}
+}
+
+/*
+ *  json_open()
+ *	open a JSON output file and start the top level object
+ */
+json_t *json_open(const char *filename)
+{
+	json_t *json;
+
+	json = calloc(1, sizeof(*json));
+	if (!json)
+		return NULL;
+	json->fp = fopen(filename, "w");
+	if (!json->fp) {
+		free(json);
+		return NULL;
+	}
+	fputc('{', json->fp);
+	json->depth = 1;
+
+	return json;
+}
+
+/*
+ *  json_close()
+ *	end the top level object and close the output file
+ */
+void json_close(json_t *json)
+{
+	if (!json)
+		return;
+	fputs("\n}\n", json->fp);
+	(void)fclose(json->fp);
+	free(json);
+}
+
+static void json_begin(json_t *json, const char *key, const char ch)
+{
+	if (!json)
+		return;
+	json_key(json, key);
+	fputc(ch, json->fp);
+	if (json->depth < JSON_DEPTH_MAX - 1)
+		json->depth++;
+	json->need_comma[json->depth] = false;
+}
+
+static void json_end(json_t *json, const char ch)
+{
+	if (!json)
+		return;
+	if (json->depth > 1)
+		json->depth--;
+	fprintf(json->fp, "\n%*s%c", (int)(json->depth * 2), "", ch);
+}
+
+/*
+ *  json_obj_begin(), json_obj_end()
+ *	start and end an object, key is NULL in arrays
+ */
+void json_obj_begin(json_t *json, const char *key)
+{
+	json_begin(json, key, '{');
+}
+
+void json_obj_end(json_t *json)
+{
+	json_end(json, '}');
+}
+
+/*
+ *  json_array_begin(), json_array_end()
+ *	start and end an array, key is NULL in arrays
+ */
+void json_array_begin(json_t *json, const char *key)
+{
+	json_begin(json, key, '[');
+}
+
+void json_array_end(json_t *json)
+{
+	json_end(json, ']');
+}
+
+/*
+ *  json_str(), json_int(), json_uint(), json_double()
+ *	write a key and value
+ */
+void json_str(json_t *json, const char *key, const char *val)
+{
+	if (!json)
+		return;
+	json_key(json, key);
+	json_str_put(json->fp, val ? val : "");
+}
+
+void json_int(json_t *json, const char *key, const int64_t val)
+{
+	if (!json)
+		return;
+	json_key(json, key);
+	fprintf(json->fp, "%" PRId64, val);
+}
+
+void json_uint(json_t *json, const char *key, const uint64_t val)
+{
+	if (!json)
+		return;
+	json_key(json, key);
+	fprintf(json->fp, "%" PRIu64, val);
+}
+
+void json_bool(json_t *json, const char *key, const bool val)
+{
+	if (!json)
+		return;
+	json_key(json, key);
+	fputs(val ? "true" : "false", json->fp);
+}
+
+void json_double(json_t *json, const char *key, const double val)
+{
+	if (!json)
+		return;
+	json_key(json, key);
+	/* JSON has no representation of NaN or infinity */
+	if (isnan(val) || isinf(val))
+		fputs("null", json->fp);
+	else
+		fprintf(json->fp, "%.6f", val);
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "stress-ng.h"
+
+#if defined(STRESS_LATENCY)
+
+__thread stress_latency_t *stress_latency;	/* NULL unless sampling latencies */
+uint64_t opt_latency = DEFAULT_LATENCY;
+
+/*
+ *  stress_set_latency()
+ *	set the op sampling rate of the latency histograms
+ */
+void stress_set_latency(const char *optarg)
+{
+	opt_latency = get_uint64(optarg);
+	check_range("latency", opt_latency,
+		MIN_LATENCY, MAX_LATENCY);
+	opt_flags |= OPT_FLAGS_LATENCY;
+}
+
+/*
+ *  latency_index()
+ *	map a latency in nanoseconds to a histogram bucket,
+ *	values below 8 have their own bucket, larger values
+ *	are split into 8 linear buckets per power of 2
+ */
+static inline size_t latency_index(const uint64_t ns)
+{
+	size_t msb, idx;
+
+	if (ns < 8)
+		return (size_t)ns;
+
+	msb = 63 - __builtin_clzll(ns);
+	idx = ((msb - 2) * 8) + ((ns >> (msb - 3)) & 7);
+
+	return (idx < LATENCY_BUCKETS) ? idx : LATENCY_BUCKETS - 1;
+}
+
+/*
+ *  latency_bucket_max()
+ *	the largest latency in nanoseconds that maps to a bucket
+ */
+static uint64_t latency_bucket_max(const size_t idx)
+{
+	size_t shift;
+
+	if (idx < 8)
+		return (uint64_t)idx;
+
+	shift = (idx / 8) - 1;
+	return ((8ULL + (idx % 8) + 1) << shift) - 1;
+}
+
+/*
+ *  latency_record()
+ *	add a latency to a histogram
+ */
+void latency_record(stress_latency_t *lat, const uint64_t ns)
+{
+	lat->bucket[latency_index(ns)]++;
+	lat->count++;
+	if (ns > lat->max)
+		lat->max = ns;
+}
+
+/*
+ *  latency_percentile()
+ *	find the latency at or below which the given
+ *	fraction of the recorded latencies fall
+ */
+uint64_t latency_percentile(
+	const stress_latency_t *lat,
+	const double fraction)
+{
+	const uint64_t target = (uint64_t)ceil(fraction * (double)lat->count);
+	uint64_t total = 0;
+	size_t i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		total += lat->bucket[i];
+		if (total >= target) {
+			const uint64_t ns = latency_bucket_max(i);
+
+			return (ns < lat->max) ? ns : lat->max;
+		}
+	}
+	return lat->max;
+}
+
+/*
+ *  latency_metrics_set()
+ *	report the p50, p99 and max of a histogram and
+ *	the number of samples as the first four metrics
+ */
+void latency_metrics_set(const stress_latency_t *lat, const char *what)
+{
+	char desc[64];
+
+	if (!lat->count)
+		return;
+	(void)snprintf(desc, sizeof(desc), "%s p50 (ns)", what);
+	stress_misc_metric_set(0, desc, (double)latency_percentile(lat, 0.50));
+	(void)snprintf(desc, sizeof(desc), "%s p99 (ns)", what);
+	stress_misc_metric_set(1, desc, (double)latency_percentile(lat, 0.99));
+	(void)snprintf(desc, sizeof(desc), "%s max (ns)", what);
+	stress_misc_metric_set(2, desc, (double)lat->max);
+	(void)snprintf(desc, sizeof(desc), "%s samples", what);
+	stress_misc_metric_set(3, desc, (double)lat->count);
+}
+
+/*
+ *  latency_percentile_usec()
+ *	latency_percentile() in microseconds
+ */
+double latency_percentile_usec(
+	const stress_latency_t *lat,
+	const double fraction)
+{
+	return (double)latency_percentile(lat, fraction) / 1000.0;
+}
+
+/*
+ *  latency_dump()
+ *	merge the latency histograms of all the instances of
+ *	each stressor and report the latency percentiles
+ */
+void latency_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+	bool no_latencies = true;
+
+	pr_yaml(yaml, "latencies:\n");
+	json_array_begin(json, "latencies");
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		stress_latency_t lat;
+		int32_t j, n = procs[i].stats_index;
+		size_t k;
+		const char *munged;
+		uint64_t p50, p99, p999;
+
+		if (!procs[i].num_procs)
+			continue;
+
+		memset(&lat, 0, sizeof(lat));
+		for (j = 0; j < procs[i].started_procs; j++, n++) {
+			const stress_latency_t *l = &shared->lat_stats[n];
+
+			for (k = 0; k < LATENCY_BUCKETS; k++)
+				lat.bucket[k] += l->bucket[k];
+			lat.count += l->count;
+			if (l->max > lat.max)
+				lat.max = l->max;
+		}
+		if (!lat.count)
+			continue;
+
+		if (no_latencies) {
+			pr_inf(stdout, "%-13s %10s %10s %10s %10s %10s\n",
+				"latency (ns):", "samples", "p50", "p99",
+				"p99.9", "max");
+			no_latencies = false;
+		}
+
+		munged = munge_underscore(stressors[i].name);
+		p50 = latency_percentile(&lat, 0.50);
+		p99 = latency_percentile(&lat, 0.99);
+		p999 = latency_percentile(&lat, 0.999);
+
+		pr_inf(stdout, "%-13s %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+			" %10" PRIu64 " %10" PRIu64 "\n",
+			munged, lat.count, p50, p99, p999, lat.max);
+
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      samples: %" PRIu64 "\n", lat.count);
+		pr_yaml(yaml, "      latency-ns-p50: %" PRIu64 "\n", p50);
+		pr_yaml(yaml, "      latency-ns-p99: %" PRIu64 "\n", p99);
+		pr_yaml(yaml, "      latency-ns-p99.9: %" PRIu64 "\n", p999);
+		pr_yaml(yaml, "      latency-ns-max: %" PRIu64 "\n", lat.max);
+		pr_yaml(yaml, "\n");
+
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_uint(json, "samples", lat.count);
+		json_uint(json, "latency-ns-p50", p50);
+		json_uint(json, "latency-ns-p99", p99);
+		json_uint(json, "latency-ns-p99.9", p999);
+		json_uint(json, "latency-ns-max", lat.max);
+		json_obj_end(json);
+	}
+	json_array_end(json);
+	if (no_latencies)
+		pr_inf(stdout, "latency: no op latencies were sampled\n");
+}
+
+#endif
@@ -28,8 +28,10 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <string.h>
 #include <errno.h>
 #include <syslog.h>
+#include <time.h>
 
 #include "stress-ng.h"
 
@@ -37,6 +39,47 @@ static uint16_t	abort_fails;	/* count of failures */
 static bool	abort_msg_emitted;
 static FILE	*log_file = NULL;
 
+#if defined(STRESS_LOG_ASYNC)
+
+#include <pthread.h>
+#include <signal.h>
+
+#define LOG_DRAIN_MS	(20)			/* parent drain interval */
+#define LOG_TEXT_MAX	(LOG_RING_SIZE / 4)	/* longer messages go direct */
+#define LOG_BATCH	(256)			/* records sorted per flush */
+
+/*
+ *  A ring is a stream of records, each a header followed by the
+ *  '\0' terminated text and padded to the header size. A record
+ *  never wraps, the tail end of the ring is skipped with a padding
+ *  record (fd 0) instead
+ */
+typedef struct {
+	uint64_t ts;			/* CLOCK_MONOTONIC ns when logged */
+	uint32_t size;			/* header + text + padding */
+	uint8_t fd;			/* 1 stdout, 2 stderr, 0 padding */
+	uint8_t debug;			/* not sent to syslog */
+	uint8_t pad[2];
+} log_record_t;
+
+/* a drained record waiting to be written out */
+typedef struct {
+	uint64_t ts;
+	uint32_t seq;			/* keeps the sort stable */
+	uint8_t fd;
+	uint8_t debug;
+	char *text;
+} log_pending_t;
+
+static __thread log_ring_t *log_ring;	/* ring of this instance, or NULL */
+
+static pthread_t log_drain_pthread;
+static pthread_mutex_t log_drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_drain_cond = PTHREAD_COND_INITIALIZER;
+static bool log_drain_keep_draining;
+static bool log_drain_pthread_running;
+#endif
+
 /*
  *  pr_yaml()
  *	print to yaml file if it is open
@@ -84,6 +127,261 @@ void pr_openlog(const char *filename)
 }
 
 
+/*
+ *  pr_msg_emit()
+ *	write a formatted message to fp and the log file and syslog
+ */
+static void pr_msg_emit(
+	FILE *fp,
+	const bool debug,
+	const char *buf,
+	const bool flush)
+{
+	if (opt_flags & OPT_FLAGS_LOG_BRIEF)
+		fputs(buf, fp);
+	else
+		fprintf(fp, "%s: %s", app_name, buf);
+	if (flush)
+		fflush(fp);
+
+	/* Log messages to log file if --log-file specified */
+	if (log_file) {
+		fprintf(log_file, "%s: %s", app_name, buf);
+		if (flush)
+			fflush(log_file);
+	}
+
+	/* Log messages if syslog requested, don't log DEBUG */
+	if ((opt_flags & OPT_FLAGS_SYSLOG) && !debug)
+		syslog(LOG_INFO, "%s", buf);
+}
+
+#if defined(STRESS_LOG_ASYNC)
+/*
+ *  pr_log_ring_attach()
+ *	queue the messages of the calling instance on ring,
+ *	the parent drains them asynchronously
+ */
+void pr_log_ring_attach(log_ring_t *ring)
+{
+	log_ring = ring;
+	if (ring)
+		ring->owner = getpid();
+}
+
+/*
+ *  pr_log_ring_put()
+ *	append a message to the ring of this instance without
+ *	blocking, false if it must be written out directly
+ */
+static bool pr_log_ring_put(
+	FILE *fp,
+	const bool debug,
+	const char *buf)
+{
+	log_ring_t *ring = log_ring;
+	log_record_t *rec;
+	struct timespec ts;
+	uint64_t head, tail, free_bytes, offset, edge, size;
+	const size_t len = strlen(buf) + 1;
+
+	/* Grandchildren inherit the pointer, only the owner may write */
+	if (!ring || (ring->owner != getpid()))
+		return false;
+	if (((fp != stdout) && (fp != stderr)) || (len > LOG_TEXT_MAX))
+		return false;
+
+	size = (sizeof(*rec) + len + sizeof(*rec) - 1) & ~(sizeof(*rec) - 1);
+	head = ring->head;
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	free_bytes = LOG_RING_SIZE - (head - tail);
+	offset = head % LOG_RING_SIZE;
+	edge = LOG_RING_SIZE - offset;
+
+	if (edge < size) {
+		/* Skip the tail end of the ring, the record goes at the start */
+		if (free_bytes < edge + size)
+			return false;
+		rec = (log_record_t *)&ring->buf[offset];
+		rec->size = (uint32_t)edge;
+		rec->fd = 0;
+		head += edge;
+		offset = 0;
+	} else if (free_bytes < size) {
+		return false;
+	}
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	rec = (log_record_t *)&ring->buf[offset];
+	rec->ts = ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+	rec->size = (uint32_t)size;
+	rec->fd = (fp == stderr) ? 2 : 1;
+	rec->debug = debug;
+	(void)memcpy(rec + 1, buf, len);
+	__atomic_store_n(&ring->head, head + size, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/*
+ *  pr_log_pending_cmp()
+ *	sort drained records into time order
+ */
+static int pr_log_pending_cmp(const void *p1, const void *p2)
+{
+	const log_pending_t *l1 = (const log_pending_t *)p1;
+	const log_pending_t *l2 = (const log_pending_t *)p2;
+
+	if (l1->ts != l2->ts)
+		return (l1->ts < l2->ts) ? -1 : 1;
+	return (l1->seq < l2->seq) ? -1 : (l1->seq > l2->seq);
+}
+
+/*
+ *  pr_log_flush()
+ *	write out a batch of drained records in time order
+ */
+static void pr_log_flush(log_pending_t *pending, const size_t n)
+{
+	size_t i;
+
+	if (!n)
+		return;
+	qsort(pending, n, sizeof(*pending), pr_log_pending_cmp);
+	for (i = 0; i < n; i++) {
+		pr_msg_emit(pending[i].fd == 2 ? stderr : stdout,
+			pending[i].debug, pending[i].text, false);
+	}
+	fflush(stdout);
+	fflush(stderr);
+	if (log_file)
+		fflush(log_file);
+}
+
+/*
+ *  pr_log_drain()
+ *	move all the queued records of all the rings to the log,
+ *	each batch is merged into time order across instances
+ */
+static void pr_log_drain(void)
+{
+	static log_pending_t pending[LOG_BATCH];
+	static char text[LOG_BATCH * LOG_TEXT_MAX];
+	size_t n = 0, used = 0;
+	uint32_t seq = 0;
+	int32_t i;
+
+	if (!shared || !shared->log_rings)
+		return;
+
+	for (i = 0; i < shared->stats_slots; i++) {
+		log_ring_t *ring = &shared->log_rings[i];
+		uint64_t tail = ring->tail;
+		const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+		while (tail != head) {
+			const log_record_t *rec = (const log_record_t *)
+				&ring->buf[tail % LOG_RING_SIZE];
+
+			if (rec->fd) {
+				const char *str = (const char *)(rec + 1);
+				const size_t len = strlen(str) + 1;
+
+				if ((n == LOG_BATCH) || (used + len > sizeof(text))) {
+					pr_log_flush(pending, n);
+					n = 0;
+					used = 0;
+				}
+				(void)memcpy(text + used, str, len);
+				pending[n].ts = rec->ts;
+				pending[n].seq = seq++;
+				pending[n].fd = rec->fd;
+				pending[n].debug = rec->debug;
+				pending[n].text = text + used;
+				used += len;
+				n++;
+			}
+			tail += rec->size;
+		}
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+	}
+	pr_log_flush(pending, n);
+}
+
+/*
+ *  pr_log_drain_thread()
+ *	drain the rings every LOG_DRAIN_MS until stopped
+ */
+static void *pr_log_drain_thread(void *arg)
+{
+	static void *nowt = NULL;
+	struct timespec abstime;
+	sigset_t set;
+
+	(void)arg;
+
+	/* Leave all signal handling to the main parent thread */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	(void)clock_gettime(CLOCK_REALTIME, &abstime);
+	pthread_mutex_lock(&log_drain_mutex);
+	while (log_drain_keep_draining) {
+		abstime.tv_nsec += LOG_DRAIN_MS * 1000000;
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_nsec -= 1000000000;
+			abstime.tv_sec++;
+		}
+		while (log_drain_keep_draining &&
+		       (pthread_cond_timedwait(&log_drain_cond, &log_drain_mutex, &abstime) == 0))
+			;
+		pr_log_drain();
+	}
+	pthread_mutex_unlock(&log_drain_mutex);
+
+	return &nowt;
+}
+
+/*
+ *  pr_log_drain_start()
+ *	start draining the stressor log rings in the background,
+ *	without a thread the rings are drained by pr_log_drain_stop()
+ */
+void pr_log_drain_start(void)
+{
+	int ret;
+
+	if (!shared || !shared->log_rings || log_drain_pthread_running)
+		return;
+
+	log_drain_keep_draining = true;
+	ret = pthread_create(&log_drain_pthread, NULL, pr_log_drain_thread, NULL);
+	if (ret) {
+		pr_dbg(stderr, "log: cannot create drain thread: "
+			"errno=%d (%s)\n", ret, strerror(ret));
+		return;
+	}
+	log_drain_pthread_running = true;
+}
+
+/*
+ *  pr_log_drain_stop()
+ *	stop the drain thread and write out anything still queued
+ */
+void pr_log_drain_stop(void)
+{
+	if (log_drain_pthread_running) {
+		pthread_mutex_lock(&log_drain_mutex);
+		log_drain_keep_draining = false;
+		pthread_cond_signal(&log_drain_cond);
+		pthread_mutex_unlock(&log_drain_mutex);
+		(void)pthread_join(log_drain_pthread, NULL);
+		log_drain_pthread_running = false;
+	}
+	pr_log_drain();
+}
+#endif
+
 /*
  *  pr_msg()
  *	print some debug or info messages
@@ -100,6 +398,7 @@ int pr_msg(
 	if ((flag & PR_FAIL) || (opt_flags & flag)) {
 		char buf[4096];
 		const char *type = "";
+		const bool debug = !!(flag & PR_DEBUG);
 
 		if (flag & PR_ERROR)
 			type = "error:";
@@ -111,14 +410,16 @@ int pr_msg(
 			type = "fail: ";
 
 		if (opt_flags & OPT_FLAGS_LOG_BRIEF) {
-			ret = vfprintf(fp, fmt, ap);
+			ret = vsnprintf(buf, sizeof(buf), fmt, ap);
 		} else {
 			int n = snprintf(buf, sizeof(buf), "%s [%i] ",
 				type, getpid());
 			ret = vsnprintf(buf + n, sizeof(buf) - n, fmt, ap);
-			fprintf(fp, "%s: %s", app_name, buf);
 		}
-		fflush(fp);
+#if defined(STRESS_LOG_ASYNC)
+		if (!pr_log_ring_put(fp, debug, buf))
+#endif
+			pr_msg_emit(fp, debug, buf, true);
 
 		if (flag & PR_FAIL) {
 			abort_fails++;
@@ -133,18 +434,6 @@ int pr_msg(
 				}
 			}
 		}
-
-		/* Log messages to log file if --log-file specified */
-		if (log_file) {
-			fprintf(log_file, "%s: %s", app_name, buf);
-			fflush(log_file);
-		}
-
-		/* Log messages if syslog requested, don't log DEBUG */
-		if ((opt_flags & OPT_FLAGS_SYSLOG) &&
-		    (!(flag & PR_DEBUG))) {
-			syslog(LOG_INFO, "%s", buf);
-		}
 	}
 	va_end(ap);
 
@@ -112,3 +112,197 @@ int madvise_random(void *addr, const size_t length)
 #endif
 	return 0;
 }
+
+#if defined(MAP_HUGETLB) && !defined(MAP_HUGE_SHIFT)
+#define MAP_HUGE_SHIFT		(26)
+#endif
+
+#define HUGEPAGE_THP_SIZE	(2 * MB)	/* x86 PMD sized THP pages */
+
+static hugepages_t opt_hugepages = HUGEPAGES_NONE;
+
+/*
+ *  stress_set_hugepages()
+ *	set the --hugepages backing of the vm, mmap, stream and
+ *	bigheap stressor buffers
+ */
+int stress_set_hugepages(const char *name)
+{
+	if (!strcmp(name, "none"))
+		opt_hugepages = HUGEPAGES_NONE;
+	else if (!strcmp(name, "thp"))
+		opt_hugepages = HUGEPAGES_THP;
+	else if (!strcmp(name, "2M"))
+		opt_hugepages = HUGEPAGES_2M;
+	else if (!strcmp(name, "1G"))
+		opt_hugepages = HUGEPAGES_1G;
+	else {
+		fprintf(stderr, "hugepages must be one of: none thp 2M 1G\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_get_hugepages()
+ *	the --hugepages backing, HUGEPAGES_NONE by default
+ */
+hugepages_t stress_get_hugepages(void)
+{
+	return opt_hugepages;
+}
+
+/*
+ *  hugepages_round()
+ *	round a mapping length up to whole huge pages, hugetlbfs
+ *	mappings can only be unmapped in whole huge pages
+ */
+size_t hugepages_round(const hugepages_t mode, const size_t length)
+{
+	size_t sz;
+
+	switch (mode) {
+	case HUGEPAGES_THP:
+	case HUGEPAGES_2M:
+		sz = HUGEPAGE_THP_SIZE;
+		break;
+	case HUGEPAGES_1G:
+		sz = GB;
+		break;
+	default:
+		return length;
+	}
+	return (length + sz - 1) & ~(sz - 1);
+}
+
+/*
+ *  madvise_hugepages()
+ *	advise a region to use transparent huge pages
+ */
+int madvise_hugepages(const hugepages_t mode, void *addr, const size_t length)
+{
+#if defined(MADV_HUGEPAGE)
+	if (mode != HUGEPAGES_NONE)
+		return madvise(addr, length, MADV_HUGEPAGE);
+#else
+	(void)mode;
+	(void)addr;
+	(void)length;
+#endif
+	return 0;
+}
+
+/*
+ *  mmap_hugepages()
+ *	mmap length bytes (which should be from hugepages_round()) with
+ *	the mode huge page backing. Explicit 2M and 1G pages come from
+ *	hugetlbfs and fall back to transparent huge pages if none are
+ *	reserved. Anonymous shared memory is only THP backed when shmem
+ *	THP is enabled, so THP mappings are made private; MAP_POPULATE
+ *	is done after the advice so the faults get huge pages
+ */
+void *mmap_hugepages(
+	const hugepages_t mode,
+	const size_t length,
+	const int prot,
+	const int flags,
+	const int fd)
+{
+	int thp_flags = flags;
+	void *ptr;
+
+	if (mode == HUGEPAGES_NONE)
+		return mmap(NULL, length, prot, flags, fd, 0);
+
+#if defined(MAP_HUGETLB)
+	if ((mode != HUGEPAGES_THP) && (flags & MAP_ANONYMOUS)) {
+		static bool warned = false;
+		const int shift = (mode == HUGEPAGES_1G) ? 30 : 21;
+
+		/* Unreserved hugetlbfs pages SIGBUS on fault, so reserve them */
+		ptr = mmap(NULL, length, prot,
+			(flags & ~MAP_NORESERVE) | MAP_HUGETLB |
+			(shift << MAP_HUGE_SHIFT), fd, 0);
+		if (ptr != MAP_FAILED)
+			return ptr;
+		if (!warned) {
+			pr_dbg(stderr, "hugepages: no %s hugetlbfs pages "
+				"available, using transparent huge pages\n",
+				(mode == HUGEPAGES_1G) ? "1G" : "2M");
+			warned = true;
+		}
+	}
+#endif
+	if (flags & MAP_ANONYMOUS)
+		thp_flags = (flags & ~MAP_SHARED) | MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+	thp_flags &= ~MAP_POPULATE;
+#endif
+	ptr = mmap(NULL, length, prot, thp_flags, fd, 0);
+	if (ptr == MAP_FAILED)
+		return ptr;
+	(void)madvise_hugepages(mode, ptr, length);
+#if defined(MAP_POPULATE)
+	if ((flags & MAP_POPULATE) && (prot & PROT_WRITE)) {
+		const size_t page_size = stress_get_pagesize();
+		volatile uint8_t *p;
+
+		for (p = ptr; p < (uint8_t *)ptr + length; p += page_size)
+			*p = 0;
+	}
+#endif
+	return ptr;
+}
+
+/*
+ *  hugepages_mapped()
+ *	count the huge pages (THP or hugetlbfs) currently backing a
+ *	region, parsed from /proc/self/smaps, 0 if it can't be read
+ */
+uint64_t hugepages_mapped(const void *addr, const size_t length)
+{
+	uint64_t pages = 0;
+#if defined(__linux__)
+	const uintptr_t start = (uintptr_t)addr, end = start + length;
+	uint64_t page_kb = 4, kb;
+	bool in = false;
+	char buf[256];
+	FILE *fp;
+
+	fp = fopen("/proc/self/smaps", "r");
+	if (!fp)
+		return 0;
+	while (fgets(buf, sizeof(buf), fp)) {
+		unsigned long lo, hi;
+
+		if (sscanf(buf, "%lx-%lx ", &lo, &hi) == 2) {
+			in = (lo < end) && (hi > start);
+			continue;
+		}
+		if (!in)
+			continue;
+		if (sscanf(buf, "KernelPageSize: %" SCNu64, &kb) == 1)
+			page_kb = kb ? kb : 4;
+		else if (sscanf(buf, "AnonHugePages: %" SCNu64, &kb) == 1)
+			pages += kb / (HUGEPAGE_THP_SIZE / KB);
+		else if ((sscanf(buf, "Shared_Hugetlb: %" SCNu64, &kb) == 1) ||
+			 (sscanf(buf, "Private_Hugetlb: %" SCNu64, &kb) == 1))
+			pages += kb / page_kb;
+	}
+	(void)fclose(fp);
+#else
+	(void)addr;
+	(void)length;
+#endif
+	return pages;
+}
+
+/*
+ *  hugepages_metric_set()
+ *	report the huge pages a stressor instance got as a stressor metric
+ */
+void hugepages_metric_set(const uint64_t pages)
+{
+	stress_misc_metric_set(STRESS_MISC_METRIC_HUGEPAGES,
+		"huge pages mapped", (double)pages);
+}
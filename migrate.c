@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+static const char *option = "migrate";
+
+#if defined(__linux__) && NEED_GLIBC(2,3,0)
+
+#include <sched.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+
+typedef enum {
+	MIGRATE_NONE = 0,
+	MIGRATE_RANDOM,		/* any allowed CPU at random */
+	MIGRATE_SOCKET,		/* ping-pong between CPUs half the CPU list apart */
+	MIGRATE_LLC,		/* rotate around the CPUs of a last level cache */
+	MIGRATE_SMT,		/* swap between the SMT siblings of a core */
+} migrate_t;
+
+/* A group of CPUs sharing a core or a last level cache */
+typedef struct {
+	uint32_t first;		/* index of first CPU in migrate_cpus[] */
+	uint32_t n;		/* number of CPUs in the group */
+} migrate_group_t;
+
+static const char *migrate_names[] = {
+	NULL, "random", "socket", "llc", "smt"
+};
+
+static migrate_t opt_migrate = MIGRATE_NONE;
+static uint64_t opt_migrate_period = 0;		/* usecs, 0 = default */
+
+static int *migrate_cpus;			/* allowed CPUs, grouped */
+static uint32_t migrate_cpus_count;
+static migrate_group_t *migrate_groups;
+static uint32_t migrate_groups_count;
+static int *migrate_last;			/* last CPU set per process */
+static uint32_t migrate_last_count;
+static uint64_t migrate_tick;
+static uint64_t migrate_count;			/* migrations carried out */
+static uint64_t migrate_failed;
+
+/*
+ *  migrate_cmp()
+ *	order CPUs by last level cache (for MIGRATE_LLC only),
+ *	package, core and then CPU number
+ */
+static int migrate_cmp(const void *p1, const void *p2)
+{
+	const cpu_t *c1 = *(const cpu_t * const *)p1;
+	const cpu_t *c2 = *(const cpu_t * const *)p2;
+
+	if ((opt_migrate == MIGRATE_LLC) && (c1->llc_id != c2->llc_id))
+		return c1->llc_id - c2->llc_id;
+	if (c1->package_id != c2->package_id)
+		return c1->package_id - c2->package_id;
+	if (c1->core_id != c2->core_id)
+		return c1->core_id - c2->core_id;
+	return c1->id - c2->id;
+}
+
+/*
+ *  stress_set_migrate()
+ *	set the migration pattern used to move the stressors around
+ */
+int stress_set_migrate(const char *name)
+{
+	size_t i;
+
+	for (i = 1; i < SIZEOF_ARRAY(migrate_names); i++) {
+		if (!strcmp(migrate_names[i], name)) {
+			opt_migrate = (migrate_t)i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "%s must be one of:", option);
+	for (i = 1; i < SIZEOF_ARRAY(migrate_names); i++)
+		fprintf(stderr, " %s", migrate_names[i]);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_migrate_period()
+ *	set the period between migrations in microseconds
+ */
+void stress_set_migrate_period(const char *optarg)
+{
+	opt_migrate_period = get_uint64(optarg);
+	check_range("migrate-period", opt_migrate_period, 100, 60000000);
+}
+
+/*
+ *  migrate_topology()
+ *	fill migrate_cpus[] with the allowed CPUs sorted by the
+ *	topology and group them by core or last level cache
+ */
+static int migrate_topology(const cpu_set_t *allowed)
+{
+	cpus_t *cpus = get_all_cpu_cache_details();
+	const cpu_t **sorted;
+	uint32_t i, n = 0;
+
+	if (!cpus)
+		return -1;
+	sorted = calloc(cpus->count, sizeof(*sorted));
+	migrate_cpus = calloc(cpus->count, sizeof(*migrate_cpus));
+	migrate_groups = calloc(cpus->count, sizeof(*migrate_groups));
+	if (!sorted || !migrate_cpus || !migrate_groups) {
+		free(sorted);
+		free_cpu_caches(cpus);
+		return -1;
+	}
+	for (i = 0; i < cpus->count; i++) {
+		const cpu_t *cpu = &cpus->cpus[i];
+
+		if (cpu->online && (cpu->id < CPU_SETSIZE) &&
+		    CPU_ISSET(cpu->id, allowed))
+			sorted[n++] = cpu;
+	}
+	qsort(sorted, n, sizeof(*sorted), migrate_cmp);
+
+	for (i = 0; i < n; i++) {
+		const cpu_t *cpu = sorted[i], *prev = i ? sorted[i - 1] : NULL;
+		bool same;
+
+		if (opt_migrate == MIGRATE_LLC)
+			same = prev && (cpu->llc_id == prev->llc_id) &&
+			       (cpu->llc_id >= 0);
+		else
+			same = prev && (cpu->package_id == prev->package_id) &&
+			       (cpu->core_id == prev->core_id) &&
+			       (cpu->core_id >= 0);
+		if (!same) {
+			migrate_groups[migrate_groups_count].first = i;
+			migrate_groups_count++;
+		}
+		migrate_groups[migrate_groups_count - 1].n++;
+		migrate_cpus[i] = cpu->id;
+	}
+	migrate_cpus_count = n;
+	free(sorted);
+	free_cpu_caches(cpus);
+
+	return n ? 0 : -1;
+}
+
+/*
+ *  stress_migrate_init()
+ *	set up the CPU list of the migration pattern, --aggressive
+ *	without --migrate uses the random pattern
+ */
+void stress_migrate_init(void)
+{
+	cpu_set_t allowed;
+	uint32_t i;
+
+	if ((opt_migrate == MIGRATE_NONE) && (opt_flags & OPT_FLAGS_AGGRESSIVE))
+		opt_migrate = MIGRATE_RANDOM;
+	if (opt_migrate == MIGRATE_NONE)
+		return;
+
+	if (!opt_migrate_period) {
+		const int32_t ticks_per_sec = stress_get_ticks_per_second() * 5;
+
+		opt_migrate_period = (ticks_per_sec > 0) ?
+			1000000 / ticks_per_sec : 1000000 / 250;
+	}
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_inf(stderr, "%s: cannot get CPU affinity, errno=%d (%s), "
+			"stressors will not be migrated\n", option,
+			errno, strerror(errno));
+		opt_migrate = MIGRATE_NONE;
+		return;
+	}
+
+	if ((opt_migrate != MIGRATE_RANDOM) && (migrate_topology(&allowed) < 0)) {
+		pr_inf(stderr, "%s: cannot read the CPU topology, using the "
+			"random migration pattern\n", option);
+		free(migrate_cpus);
+		free(migrate_groups);
+		migrate_cpus = NULL;
+		migrate_groups = NULL;
+		migrate_groups_count = 0;
+		opt_migrate = MIGRATE_RANDOM;
+	}
+	if (opt_migrate == MIGRATE_RANDOM) {
+		int cpu;
+
+		migrate_cpus = calloc(CPU_COUNT(&allowed), sizeof(*migrate_cpus));
+		if (!migrate_cpus) {
+			pr_inf(stderr, "%s: out of memory, stressors will "
+				"not be migrated\n", option);
+			opt_migrate = MIGRATE_NONE;
+			return;
+		}
+		for (migrate_cpus_count = 0, cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &allowed))
+				migrate_cpus[migrate_cpus_count++] = cpu;
+	}
+
+	if ((opt_migrate == MIGRATE_SMT) || (opt_migrate == MIGRATE_LLC)) {
+		for (i = 0; i < migrate_groups_count; i++)
+			if (migrate_groups[i].n > 1)
+				break;
+		if (i == migrate_groups_count)
+			pr_inf(stderr, "%s: no %s has more than one CPU, "
+				"the stressors will not move\n", option,
+				opt_migrate == MIGRATE_SMT ? "core" : "last level cache");
+	}
+	pr_dbg(stderr, "%s: %s pattern over %" PRIu32 " CPUs every %" PRIu64 " usecs\n",
+		option, migrate_names[opt_migrate], migrate_cpus_count,
+		opt_migrate_period);
+}
+
+/*
+ *  stress_migrate_enabled()
+ *	true if the parent should be migrating the stressors
+ */
+bool stress_migrate_enabled(void)
+{
+	return opt_migrate != MIGRATE_NONE;
+}
+
+/*
+ *  migrate_target()
+ *	the CPU the k'th stressor process moves to on this tick
+ */
+static int migrate_target(const uint32_t k)
+{
+	const uint32_t n = migrate_cpus_count;
+	const migrate_group_t *g;
+
+	switch (opt_migrate) {
+	case MIGRATE_SOCKET:
+		/*
+		 *  The CPUs are sorted by package, so CPUs half
+		 *  the list apart are on different packages on
+		 *  multi-socket systems
+		 */
+		return migrate_cpus[(k + ((migrate_tick & 1) ? n / 2 : 0)) % n];
+	case MIGRATE_LLC:
+	case MIGRATE_SMT:
+		g = &migrate_groups[k % migrate_groups_count];
+		return migrate_cpus[g->first +
+			((k / migrate_groups_count) + migrate_tick) % g->n];
+	default:
+		return migrate_cpus[mwc32() % n];
+	}
+}
+
+/*
+ *  stress_migrate_pid()
+ *	move the k'th stressor process pid according to the pattern
+ */
+void stress_migrate_pid(const pid_t pid, const uint32_t k)
+{
+	cpu_set_t mask;
+	int cpu;
+
+	if (k >= migrate_last_count) {
+		const uint32_t count = (k + 64) & ~63U;
+		int *last = realloc(migrate_last, count * sizeof(*last));
+		uint32_t i;
+
+		if (!last)
+			return;
+		for (i = migrate_last_count; i < count; i++)
+			last[i] = -1;
+		migrate_last = last;
+		migrate_last_count = count;
+	}
+
+	cpu = migrate_target(k);
+	if (cpu == migrate_last[k])
+		return;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	if (sched_setaffinity(pid, sizeof(mask), &mask) < 0) {
+		migrate_failed++;
+		return;
+	}
+	/* The first placement of a process is not a migration */
+	if (migrate_last[k] >= 0)
+		migrate_count++;
+	migrate_last[k] = cpu;
+}
+
+/*
+ *  stress_migrate_period_usec()
+ *	the period between migrations in microseconds
+ */
+uint64_t stress_migrate_period_usec(void)
+{
+	return opt_migrate_period;
+}
+
+/*
+ *  stress_migrate_tick()
+ *	advance the pattern, for callers that wait for the
+ *	next period themselves
+ */
+void stress_migrate_tick(void)
+{
+	migrate_tick++;
+}
+
+/*
+ *  stress_migrate_next()
+ *	advance the pattern and wait for the next period
+ */
+void stress_migrate_next(void)
+{
+	struct timespec ts;
+
+	stress_migrate_tick();
+	ts.tv_sec = opt_migrate_period / 1000000;
+	ts.tv_nsec = (opt_migrate_period % 1000000) * 1000;
+	(void)nanosleep(&ts, NULL);
+}
+
+/*
+ *  stress_migrate_dump()
+ *	report the number of migrations carried out
+ */
+void stress_migrate_dump(FILE *yaml, json_t *json, const double duration)
+{
+	const double rate = (duration > 0.0) ? (double)migrate_count / duration : 0.0;
+
+	if (opt_migrate == MIGRATE_NONE)
+		return;
+
+	pr_inf(stdout, "%s: %" PRIu64 " %s migrations (%.2f per second), "
+		"%" PRIu64 " failed\n", option, migrate_count,
+		migrate_names[opt_migrate], rate, migrate_failed);
+
+	pr_yaml(yaml, "migrations:\n");
+	pr_yaml(yaml, "      pattern: %s\n", migrate_names[opt_migrate]);
+	pr_yaml(yaml, "      period-usecs: %" PRIu64 "\n", opt_migrate_period);
+	pr_yaml(yaml, "      migrations: %" PRIu64 "\n", migrate_count);
+	pr_yaml(yaml, "      migrations-per-second: %f\n", rate);
+	pr_yaml(yaml, "      failed: %" PRIu64 "\n", migrate_failed);
+	pr_yaml(yaml, "\n");
+
+	json_obj_begin(json, "migrations");
+	json_str(json, "pattern", migrate_names[opt_migrate]);
+	json_uint(json, "period-usecs", opt_migrate_period);
+	json_uint(json, "migrations", migrate_count);
+	json_double(json, "migrations-per-second", rate);
+	json_uint(json, "failed", migrate_failed);
+	json_obj_end(json);
+}
+
+#else
+int stress_set_migrate(const char *name)
+{
+	(void)name;
+
+	fprintf(stderr, "%s: migrating stressors is not supported\n", option);
+	return -1;
+}
+
+void stress_set_migrate_period(const char *optarg)
+{
+	(void)optarg;
+}
+
+void stress_migrate_init(void)
+{
+}
+
+bool stress_migrate_enabled(void)
+{
+	return false;
+}
+
+void stress_migrate_pid(const pid_t pid, const uint32_t k)
+{
+	(void)pid;
+	(void)k;
+}
+
+void stress_migrate_next(void)
+{
+}
+
+void stress_migrate_dump(FILE *yaml, json_t *json, const double duration)
+{
+	(void)yaml;
+	(void)json;
+	(void)duration;
+}
+#endif
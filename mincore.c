@@ -26,8 +26,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 
 #include "stress-ng.h"
 
@@ -81,3 +84,114 @@ int mincore_touch_pages(void *buf, const size_t buf_len)
 #endif
 	return 0;
 }
+
+#define MINCORE_RESIDENCY_INTERVAL	(0.25)	/* secs between samples */
+
+/*
+ *  mincore_residency_init()
+ *	start sampling the residency of a stressor's mappings,
+ *	the fault counters are taken too so the rates can be
+ *	reported alongside
+ */
+void mincore_residency_init(mincore_residency_t *r)
+{
+	struct rusage usage;
+
+	memset(r, 0, sizeof(*r));
+	r->min = 1.0;
+	r->t_start = time_now();
+	r->t_next = r->t_start;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		r->minflt = (uint64_t)usage.ru_minflt;
+		r->majflt = (uint64_t)usage.ru_majflt;
+	}
+}
+
+/*
+ *  mincore_residency_metrics_set()
+ *	report the residency samples and the fault rates
+ */
+void mincore_residency_metrics_set(const mincore_residency_t *r)
+{
+	const size_t slot = STRESS_MISC_METRIC_RESIDENCY;
+	struct rusage usage;
+	const double secs = time_now() - r->t_start;
+
+	if (!(opt_flags & OPT_FLAGS_PAGE_RESIDENCY) || !r->samples)
+		return;
+
+	stress_misc_metric_set(slot, "resident mean %",
+		100.0 * r->sum / (double)r->samples);
+	stress_misc_metric_set(slot + 1, "resident min %", 100.0 * r->min);
+	stress_misc_metric_set(slot + 2, "resident last %", 100.0 * r->last);
+	stress_misc_metric_set(slot + 3, "samples under 50% resident %",
+		100.0 * (double)r->low / (double)r->samples);
+	stress_misc_metric_set(slot + 4, "samples 90%+ resident %",
+		100.0 * (double)r->high / (double)r->samples);
+	stress_misc_metric_set(slot + 5, "residency samples", (double)r->samples);
+	if ((secs > 0.0) && (getrusage(RUSAGE_SELF, &usage) == 0)) {
+		stress_misc_metric_set(slot + 6, "minor faults/sec",
+			(double)((uint64_t)usage.ru_minflt - r->minflt) / secs);
+		stress_misc_metric_set(slot + 7, "major faults/sec",
+			(double)((uint64_t)usage.ru_majflt - r->majflt) / secs);
+	}
+}
+
+/*
+ *  mincore_residency_sample()
+ *	with --page-residency, sample the fraction of the pages
+ *	of a mapping that are in core, at most every
+ *	MINCORE_RESIDENCY_INTERVAL seconds
+ */
+void mincore_residency_sample(mincore_residency_t *r, void *buf, const size_t buf_len)
+{
+#if !defined(__gnu_hurd__) && !defined(__minix__)
+#if defined(__FreeBSD__) || defined(__OpenBSD__) || \
+    defined(__NetBSD__) || defined(__sun__)
+	char *vec;
+#else
+	unsigned char *vec;
+#endif
+	const size_t page_size = stress_get_pagesize();
+	size_t vec_len, i, resident = 0;
+	double now, frac;
+
+	if (!(opt_flags & OPT_FLAGS_PAGE_RESIDENCY))
+		return;
+	now = time_now();
+	if (now < r->t_next)
+		return;
+	r->t_next = now + MINCORE_RESIDENCY_INTERVAL;
+
+	vec_len = buf_len / page_size;
+	if (vec_len < 1)
+		return;
+	vec = calloc(vec_len, 1);
+	if (!vec)
+		return;
+	if (mincore(buf, buf_len, vec) < 0) {
+		free(vec);
+		return;
+	}
+	for (i = 0; i < vec_len; i++)
+		resident += vec[i] & 1;
+	free(vec);
+
+	frac = (double)resident / (double)vec_len;
+	r->samples++;
+	r->sum += frac;
+	r->last = frac;
+	if (frac < r->min)
+		r->min = frac;
+	if (frac < 0.5)
+		r->low++;
+	if (frac >= 0.9)
+		r->high++;
+	/* Mapping children can be killed at the end, so report as we go */
+	mincore_residency_metrics_set(r);
+#else
+	(void)r;
+	(void)buf;
+	(void)buf_len;
+#endif
+}
@@ -33,7 +33,7 @@
 
 #include "stress-ng.h"
 
-mwc_t __mwc = {
+__thread mwc_t __mwc = {
 	MWC_SEED_W,
 	MWC_SEED_Z
 };
@@ -60,6 +60,114 @@ static const domain_t domains[] = {
 	{ NULL,		-1, ~0 }
 };
 
+static const char *net_peer;		/* --net-peer address, or NULL */
+static int net_role = NET_ROLE_BOTH;	/* --net-role */
+
+/*
+ *  stress_set_net_peer()
+ *	set the IPv4 or IPv6 address of the host the network
+ *	stressor clients connect to, rather than the loopback
+ */
+int stress_set_net_peer(const char *optarg)
+{
+	struct in6_addr addr6;
+	struct in_addr addr;
+
+	if ((inet_pton(AF_INET, optarg, &addr) != 1) &&
+	    (inet_pton(AF_INET6, optarg, &addr6) != 1)) {
+		fprintf(stderr, "net-peer must be an IPv4 or IPv6 address\n");
+		return -1;
+	}
+	net_peer = optarg;
+	return 0;
+}
+
+/*
+ *  stress_set_sock_peer()
+ *	set the socket stressor peer as host:port or [host]:port
+ *	for IPv6, the port is the socket stressor base port
+ */
+int stress_set_sock_peer(const char *optarg)
+{
+	static char host[INET6_ADDRSTRLEN];
+	const char *colon, *start = optarg, *end;
+	size_t len;
+
+	colon = strrchr(optarg, ':');
+	if (!colon || !colon[1])
+		goto bad;
+	end = colon;
+	if (*optarg == '[') {
+		start = optarg + 1;
+		if ((colon == optarg) || (colon[-1] != ']'))
+			goto bad;
+		end = colon - 1;
+	}
+	len = (size_t)(end - start);
+	if ((len == 0) || (len >= sizeof(host)))
+		goto bad;
+	memcpy(host, start, len);
+	host[len] = '\0';
+	if (stress_set_net_peer(host) < 0)
+		return -1;
+	stress_set_socket_port(colon + 1);
+	return 0;
+bad:
+	fprintf(stderr, "sock-peer must be host:port or [host]:port\n");
+	return -1;
+}
+
+/*
+ *  stress_set_net_role()
+ *	run both ends of the socket, udp and sctp stressors or
+ *	just the client or the server end for remote peers
+ */
+int stress_set_net_role(const char *optarg)
+{
+	if (!strcmp(optarg, "both")) {
+		net_role = NET_ROLE_BOTH;
+	} else if (!strcmp(optarg, "client")) {
+		net_role = NET_ROLE_CLIENT;
+	} else if (!strcmp(optarg, "server")) {
+		net_role = NET_ROLE_SERVER;
+	} else {
+		fprintf(stderr, "net-role must be one of: both client server\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_net_role()
+ *	the ends of the network stressors this host runs
+ */
+int stress_net_role(void)
+{
+	return net_role;
+}
+
+/*
+ *  stress_net_client_wait()
+ *	wait for a client only stressor's client process, the
+ *	client counts the bogo ops as there is no local server
+ */
+int stress_net_client_wait(const pid_t pid)
+{
+	int status;
+
+	(void)setpgid(pid, pgrp);
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR)
+			return EXIT_FAILURE;
+		/* The client has no alarm of its own */
+		if (!opt_do_run)
+			(void)kill(pid, SIGKILL);
+	}
+	if (WIFSIGNALED(status))
+		return EXIT_SUCCESS;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
+
 /*
  *  stress_set_net_port()
  *	set up port number from opt
@@ -125,6 +233,13 @@ void stress_set_sockaddr(
 		memset(&addr, 0, sizeof(addr));
 		addr.sin_family = domain;
 		switch (net_addr) {
+		case NET_ADDR_PEER:
+			if (net_peer) {
+				if (inet_pton(AF_INET, net_peer, &addr.sin_addr) != 1)
+					goto bad_peer;
+				break;
+			}
+			/* fall through */
 		case NET_ADDR_LOOPBACK:
 			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
 			break;
@@ -149,6 +264,13 @@ void stress_set_sockaddr(
 		memset(&addr, 0, sizeof(addr));
 		addr.sin6_family = domain;
 		switch (net_addr) {
+		case NET_ADDR_PEER:
+			if (net_peer) {
+				if (inet_pton(AF_INET6, net_peer, &addr.sin6_addr) != 1)
+					goto bad_peer;
+				break;
+			}
+			/* fall through */
 		case NET_ADDR_LOOPBACK:
 			addr.sin6_addr = in6addr_loopback;
 			break;
@@ -182,6 +304,15 @@ void stress_set_sockaddr(
 		(void)kill(getppid(), SIGALRM);
 		exit(EXIT_FAILURE);
 	}
+	return;
+
+#if defined(AF_INET) || defined(AF_INET6)
+bad_peer:
+	pr_err(stderr, "%s: net-peer %s is not an address of the "
+		"stressor's domain\n", name, net_peer);
+	(void)kill(getppid(), SIGALRM);
+	exit(EXIT_FAILURE);
+#endif
 }
 
 /*
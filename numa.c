@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+static const char *option = "numa-place";
+
+#if defined(STRESS_NUMA_BIND)
+
+#include <sched.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+
+#define NUMA_SYS_NODE_PATH	"/sys/devices/system/node"
+#define NUMA_NODES_MAX		(64)
+#define NUMA_LONG_BITS		(sizeof(unsigned long) * 8)
+
+#define MPOL_BIND		(2)
+
+typedef enum {
+	NUMA_PLACE_NONE = 0,
+	NUMA_PLACE_SPREAD,	/* round robin instances over the nodes */
+	NUMA_PLACE_PACK,	/* fill the CPUs of a node before the next */
+	NUMA_PLACE_LOCAL,	/* stay on the node the instance started on */
+} numa_place_t;
+
+typedef struct {
+	int node;		/* NUMA node number */
+	cpu_set_t cpus;		/* allowed CPUs on the node */
+	int ncpus;		/* number of CPUs in cpus */
+} numa_node_t;
+
+static numa_place_t opt_numa_place = NUMA_PLACE_NONE;
+static numa_node_t numa_nodes[NUMA_NODES_MAX];
+static int numa_nodes_count;
+
+/*
+ *  numa_node_list()
+ *	fill nodes with the numbers of the NUMA nodes in sysfs,
+ *	returns the number of nodes
+ */
+int numa_node_list(int *nodes, const int max)
+{
+	int node, n = 0;
+
+	for (node = 0; (node < NUMA_NODES_MAX) && (n < max); node++) {
+		char path[PATH_MAX];
+
+		(void)snprintf(path, sizeof(path), "%s/node%d",
+			NUMA_SYS_NODE_PATH, node);
+		if (access(path, F_OK) == 0)
+			nodes[n++] = node;
+	}
+	return n;
+}
+
+/*
+ *  numa_node_cpus()
+ *	get the CPUs of a NUMA node from its cpulist, e.g. "0-7,16-23",
+ *	only CPUs that are also in the allowed set are counted, a NULL
+ *	allowed set counts all of them
+ */
+int numa_node_cpus(
+	const int node,
+	const cpu_set_t *allowed,
+	cpu_set_t *set)
+{
+	char path[PATH_MAX], buf[4096];
+	FILE *fp;
+
+	CPU_ZERO(set);
+	(void)snprintf(path, sizeof(path), "%s/node%d/cpulist",
+		NUMA_SYS_NODE_PATH, node);
+	fp = fopen(path, "r");
+	if (!fp)
+		return 0;
+	if (!fgets(buf, sizeof(buf), fp)) {
+		(void)fclose(fp);
+		return 0;
+	}
+	(void)fclose(fp);
+
+	if (stress_parse_cpulist(NULL, buf, set) < 0) {
+		CPU_ZERO(set);
+		return 0;
+	}
+	if (allowed)
+		CPU_AND(set, set, allowed);
+	return CPU_COUNT(set);
+}
+
+/*
+ *  numa_mask()
+ *	node mask with just the given node set
+ */
+static void numa_mask(
+	unsigned long mask[NUMA_NODES_MAX / NUMA_LONG_BITS],
+	const int node)
+{
+	memset(mask, 0, (NUMA_NODES_MAX / NUMA_LONG_BITS) * sizeof(*mask));
+	mask[node / NUMA_LONG_BITS] |= 1UL << (node % NUMA_LONG_BITS);
+}
+
+/*
+ *  numa_bind()
+ *	bind the pages of a region to a NUMA node, returns -errno
+ *	on failure
+ */
+int numa_bind(void *addr, const size_t len, const int node)
+{
+	unsigned long mask[NUMA_NODES_MAX / NUMA_LONG_BITS];
+
+	if ((node < 0) || (node >= NUMA_NODES_MAX))
+		return -EINVAL;
+	numa_mask(mask, node);
+	if (syscall(__NR_mbind, addr, (unsigned long)len, MPOL_BIND,
+		    mask, (unsigned long)NUMA_NODES_MAX + 1, 0) < 0)
+		return -errno;
+	return 0;
+}
+
+/*
+ *  numa_node_of_cpu()
+ *	index into numa_nodes[] of the node a CPU is on, -1 if unknown
+ */
+static int numa_node_of_cpu(const int cpu)
+{
+	int i;
+
+	for (i = 0; i < numa_nodes_count; i++)
+		if (CPU_ISSET(cpu, &numa_nodes[i].cpus))
+			return i;
+	return -1;
+}
+
+/*
+ *  stress_set_numa_place()
+ *	set the NUMA placement policy of the stressor instances
+ */
+int stress_set_numa_place(const char *name)
+{
+	if (!strcmp(name, "spread"))
+		opt_numa_place = NUMA_PLACE_SPREAD;
+	else if (!strcmp(name, "pack"))
+		opt_numa_place = NUMA_PLACE_PACK;
+	else if (!strcmp(name, "local"))
+		opt_numa_place = NUMA_PLACE_LOCAL;
+	else {
+		fprintf(stderr, "%s must be one of: spread pack local\n", option);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_numa_place_init()
+ *	find the NUMA nodes that have CPUs the stressors are allowed
+ *	to run on, called once by the parent so that all the
+ *	instances place themselves using the same node list
+ */
+void stress_numa_place_init(void)
+{
+	cpu_set_t allowed;
+	int nodes[NUMA_NODES_MAX], count, i;
+
+	if (opt_numa_place == NUMA_PLACE_NONE)
+		return;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_inf(stderr, "%s: cannot get CPU affinity, errno=%d (%s), "
+			"instances will not be placed\n", option,
+			errno, strerror(errno));
+		opt_numa_place = NUMA_PLACE_NONE;
+		return;
+	}
+
+	numa_nodes_count = 0;
+	count = numa_node_list(nodes, NUMA_NODES_MAX);
+	for (i = 0; i < count; i++) {
+		numa_node_t *n = &numa_nodes[numa_nodes_count];
+
+		n->ncpus = numa_node_cpus(nodes[i], &allowed, &n->cpus);
+		if (n->ncpus > 0) {
+			n->node = nodes[i];
+			numa_nodes_count++;
+		}
+	}
+	if (!numa_nodes_count) {
+		pr_inf(stderr, "%s: no NUMA nodes found, instances will "
+			"not be placed\n", option);
+		opt_numa_place = NUMA_PLACE_NONE;
+		return;
+	}
+	pr_dbg(stderr, "%s: %d NUMA node%s with allowed CPUs\n", option,
+		numa_nodes_count, numa_nodes_count == 1 ? "" : "s");
+}
+
+/*
+ *  stress_numa_place()
+ *	bind the calling stressor instance to the CPUs and memory of
+ *	a NUMA node, index is the order the instance was started in
+ *	over all the stressors so that different stressors are
+ *	spread or packed together
+ */
+void stress_numa_place(const char *name, const uint32_t index)
+{
+	unsigned long mask[NUMA_NODES_MAX / NUMA_LONG_BITS];
+	const numa_node_t *n = NULL;
+	int i, cpu;
+	uint32_t slot;
+
+	switch (opt_numa_place) {
+	case NUMA_PLACE_SPREAD:
+		n = &numa_nodes[index % numa_nodes_count];
+		break;
+	case NUMA_PLACE_PACK:
+		/* One instance per CPU, wrapping when all CPUs are used */
+		for (slot = 0, i = 0; i < numa_nodes_count; i++)
+			slot += numa_nodes[i].ncpus;
+		slot = index % slot;
+		for (i = 0; i < numa_nodes_count; i++) {
+			if (slot < (uint32_t)numa_nodes[i].ncpus) {
+				n = &numa_nodes[i];
+				break;
+			}
+			slot -= numa_nodes[i].ncpus;
+		}
+		break;
+	case NUMA_PLACE_LOCAL:
+		cpu = sched_getcpu();
+		i = (cpu < 0) ? -1 : numa_node_of_cpu(cpu);
+		if (i >= 0)
+			n = &numa_nodes[i];
+		break;
+	default:
+		return;
+	}
+	if (!n) {
+		pr_dbg(stderr, "%s: cannot find a NUMA node to place "
+			"the instance on\n", name);
+		return;
+	}
+
+	if (sched_setaffinity(0, sizeof(n->cpus), &n->cpus) < 0)
+		pr_dbg(stderr, "%s: cannot set CPU affinity to node %d, "
+			"errno=%d (%s)\n", name, n->node, errno, strerror(errno));
+
+	numa_mask(mask, n->node);
+	if (syscall(__NR_set_mempolicy, MPOL_BIND, mask, NUMA_NODES_MAX + 1) < 0)
+		pr_dbg(stderr, "%s: cannot set memory policy to node %d, "
+			"errno=%d (%s)\n", name, n->node, errno, strerror(errno));
+	else
+		pr_dbg(stderr, "%s: placed on NUMA node %d\n", name, n->node);
+}
+
+#else
+int stress_set_numa_place(const char *name)
+{
+	(void)name;
+
+	fprintf(stderr, "%s: NUMA placement not supported\n", option);
+	return -1;
+}
+
+void stress_numa_place_init(void)
+{
+}
+
+void stress_numa_place(const char *name, const uint32_t index)
+{
+	(void)name;
+	(void)index;
+}
+#endif
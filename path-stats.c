@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+
+#include "stress-ng.h"
+
+#define PATH_STATS_BUCKETS	(4096)		/* hash table size */
+#define PATH_STATS_BUF_SZ	(4096)		/* read size */
+#define PATH_STATS_READ_MAX	(1 * MB)	/* stop reading a file here */
+
+/*
+ *  path_stats_hash()
+ *	FNV-1a hash of a path
+ */
+static uint32_t path_stats_hash(const char *path)
+{
+	uint32_t h = 2166136261U;
+
+	while (*path) {
+		h ^= (uint8_t)*path++;
+		h *= 16777619U;
+	}
+	return h % PATH_STATS_BUCKETS;
+}
+
+/*
+ *  path_stats_init()
+ *	set up an empty table, returns -1 if out of memory
+ */
+int path_stats_init(stress_path_stats_t *ps)
+{
+	ps->count = 0;
+	ps->table = calloc(PATH_STATS_BUCKETS, sizeof(*ps->table));
+
+	return ps->table ? 0 : -1;
+}
+
+/*
+ *  path_stats_add()
+ *	account a read of path that took secs seconds
+ */
+void path_stats_add(
+	stress_path_stats_t *ps,
+	const char *path,
+	const double secs)
+{
+	const uint32_t h = path_stats_hash(path);
+	stress_path_stat_t *p;
+
+	for (p = ps->table[h]; p; p = p->next) {
+		if (!strcmp(p->path, path))
+			break;
+	}
+	if (!p) {
+		p = calloc(1, sizeof(*p));
+		if (!p)
+			return;
+		p->path = strdup(path);
+		if (!p->path) {
+			free(p);
+			return;
+		}
+		p->next = ps->table[h];
+		ps->table[h] = p;
+		ps->count++;
+	}
+	p->reads++;
+	p->total += secs;
+	if (secs > p->max)
+		p->max = secs;
+}
+
+/*
+ *  path_stats_read()
+ *	open, read to end of file and close the file as a
+ *	monitoring agent would and account the time taken,
+ *	files that cannot be opened are not accounted
+ */
+void path_stats_read(stress_path_stats_t *ps, const char *path)
+{
+	char buf[PATH_STATS_BUF_SZ];
+	size_t total = 0;
+	double t;
+	int fd;
+
+	t = time_now();
+	if ((fd = open(path, O_RDONLY | O_NONBLOCK)) < 0)
+		return;
+	while (total < (size_t)PATH_STATS_READ_MAX) {
+		const ssize_t ret = read(fd, buf, sizeof(buf));
+
+		if (ret <= 0)
+			break;
+		total += (size_t)ret;
+	}
+	(void)close(fd);
+	path_stats_add(ps, path, time_now() - t);
+}
+
+/*
+ *  path_stats_cmp()
+ *	sort by mean read latency, slowest first
+ */
+static int path_stats_cmp(const void *p1, const void *p2)
+{
+	const stress_path_stat_t *s1 = *(const stress_path_stat_t * const *)p1;
+	const stress_path_stat_t *s2 = *(const stress_path_stat_t * const *)p2;
+	const double m1 = s1->total / (double)s1->reads;
+	const double m2 = s2->total / (double)s2->reads;
+
+	if (m1 < m2)
+		return 1;
+	if (m1 > m2)
+		return -1;
+	return strcmp(s1->path, s2->path);
+}
+
+/*
+ *  path_stats_report()
+ *	report the top slowest files by mean read latency,
+ *	the table is only printed by the first instance
+ */
+void path_stats_report(
+	const char *name,
+	const uint32_t instance,
+	const stress_path_stats_t *ps,
+	const uint32_t top)
+{
+	stress_path_stat_t **sorted;
+	double walk = 0.0;
+	size_t i, n = 0;
+
+	if (!ps->count)
+		return;
+	sorted = calloc(ps->count, sizeof(*sorted));
+	if (!sorted)
+		return;
+	for (i = 0; i < PATH_STATS_BUCKETS; i++) {
+		stress_path_stat_t *p;
+
+		for (p = ps->table[i]; p; p = p->next) {
+			sorted[n++] = p;
+			walk += p->total / (double)p->reads;
+		}
+	}
+	qsort(sorted, n, sizeof(*sorted), path_stats_cmp);
+
+	if (instance == 0) {
+		pr_inf(stderr, "%s: %" PRIu32 " slowest of %zu files read:\n",
+			name, (uint32_t)STRESS_MINIMUM(top, n), n);
+		pr_inf(stderr, "%s: %10s %10s %8s %s\n", name,
+			"mean us", "max us", "reads", "path");
+		for (i = 0; (i < n) && (i < top); i++) {
+			const stress_path_stat_t *p = sorted[i];
+
+			pr_inf(stderr, "%s: %10.1f %10.1f %8" PRIu64 " %s\n",
+				name, p->total * 1000000.0 / (double)p->reads,
+				p->max * 1000000.0,
+				p->reads, p->path);
+		}
+	}
+	stress_misc_metric_set(0, "slowest file mean latency (us)",
+		sorted[0]->total * 1000000.0 / (double)sorted[0]->reads);
+	stress_misc_metric_set(1, "slowest file max latency (us)",
+		sorted[0]->max * 1000000.0);
+	stress_misc_metric_set(2, "files timed", (double)n);
+	stress_misc_metric_set(3, "mean read time per walk (ms)",
+		walk * 1000.0);
+	free(sorted);
+}
+
+/*
+ *  path_stats_free()
+ *	free the table and all its entries
+ */
+void path_stats_free(stress_path_stats_t *ps)
+{
+	size_t i;
+
+	if (!ps->table)
+		return;
+	for (i = 0; i < PATH_STATS_BUCKETS; i++) {
+		stress_path_stat_t *p = ps->table[i];
+
+		while (p) {
+			stress_path_stat_t *next = p->next;
+
+			free(p->path);
+			free(p);
+			p = next;
+		}
+	}
+	free(ps->table);
+	ps->table = NULL;
+	ps->count = 0;
+}
@@ -37,6 +37,8 @@
 #include <locale.h>
 #include <pthread.h>
 #include <ctype.h>
+#include <signal.h>
+#include <time.h>
 
 #define THOUSAND	(1000.0)
 #define MILLION		(THOUSAND * THOUSAND)
@@ -47,8 +49,12 @@
 
 
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
+#include <sys/file.h>
 #include <linux/perf_event.h>
+#include <elf.h>
+#include <link.h>
 
 /* used for table of perf events to gather */
 typedef struct {
@@ -56,6 +62,7 @@ typedef struct {
 	unsigned long type;		/* perf types */
 	unsigned long config;		/* perf type specific config */
 	char *label;			/* human readable name for perf type */
+	double scale;			/* unit scale of the counter */
 } perf_info_t;
 
 /* perf data */
@@ -65,6 +72,14 @@ typedef struct {
 	uint64_t time_running;		/* perf time running */
 } perf_data_t;
 
+/* perf group data, PERF_FORMAT_GROUP read of a group leader */
+typedef struct {
+	uint64_t nr;			/* number of counters in group */
+	uint64_t time_enabled;		/* perf time enabled */
+	uint64_t time_running;		/* perf time running */
+	uint64_t counter[STRESS_PERF_MAX]; /* counters in group order */
+} perf_group_data_t;
+
 /* perf trace point id -> path resolution */
 typedef struct {
 	int id;				/* stress-ng perf ID */
@@ -74,12 +89,34 @@ typedef struct {
 #define PERF_TP_INFO(id, path) \
 	{ STRESS_PERF_ ## id, path }
 
+/* CPU PMU sysfs events, e.g. the top-down events */
+#define PERF_PMU_CPU_PATH	"/sys/bus/event_source/devices/cpu"
+
+/* perf CPU PMU event id -> sysfs event name resolution */
+typedef struct {
+	int id;				/* stress-ng perf ID */
+	char *name;			/* sysfs event name */
+} perf_pmu_info_t;
+
+#define PERF_PMU_INFO(id, name) \
+	{ STRESS_PERF_ ## id, name }
+
 #define PERF_INFO(type, config, label)	\
 	{ STRESS_PERF_ ## config, PERF_TYPE_ ## type, \
-	  PERF_COUNT_ ## config, label }
+	  PERF_COUNT_ ## config, label, 1.0 }
 
 #define STRESS_GOT(x) _SNG_PERF_COUNT_ ## x
 
+/* Generalized hardware cache events, cache id, op and result */
+#define PERF_HW_CACHE(cache, op, result)		\
+	((PERF_COUNT_HW_CACHE_ ## cache) |		\
+	 (PERF_COUNT_HW_CACHE_OP_ ## op << 8) |		\
+	 (PERF_COUNT_HW_CACHE_RESULT_ ## result << 16))
+
+#define PERF_COUNT_HW_CACHE_DTLB_READ_MISS	PERF_HW_CACHE(DTLB, READ, MISS)
+#define PERF_COUNT_HW_CACHE_DTLB_WRITE_MISS	PERF_HW_CACHE(DTLB, WRITE, MISS)
+#define PERF_COUNT_HW_CACHE_ITLB_READ_MISS	PERF_HW_CACHE(ITLB, READ, MISS)
+
 #define UNRESOLVED				(~0UL)
 #define PERF_COUNT_TP_SYSCALLS_ENTER		UNRESOLVED
 #define PERF_COUNT_TP_SYSCALLS_EXIT		UNRESOLVED
@@ -107,6 +144,12 @@ typedef struct {
 #define PERF_COUNT_TP_RCU_UTILIZATION		UNRESOLVED
 #define PERF_COUNT_TP_WRITEBACK_DIRTY_INODE	UNRESOLVED
 #define PERF_COUNT_TP_WRITEBACK_DIRTY_PAGE	UNRESOLVED
+#define PERF_COUNT_TP_LOCK_CONTENTION_BEGIN	UNRESOLVED
+#define PERF_COUNT_TD_TOTAL_SLOTS		UNRESOLVED
+#define PERF_COUNT_TD_SLOTS_ISSUED		UNRESOLVED
+#define PERF_COUNT_TD_SLOTS_RETIRED		UNRESOLVED
+#define PERF_COUNT_TD_FETCH_BUBBLES		UNRESOLVED
+#define PERF_COUNT_TD_RECOVERY_BUBBLES		UNRESOLVED
 
 
 /* perf counters to be read */
@@ -141,6 +184,19 @@ static perf_info_t perf_info[STRESS_PERF_MAX + 1] = {
 #if STRESS_GOT(HW_REF_CPU_CYCLES)
 	PERF_INFO(HARDWARE, HW_REF_CPU_CYCLES,		"Total Cycles"),
 #endif
+#if STRESS_GOT(HW_CACHE_DTLB)
+	PERF_INFO(HW_CACHE, HW_CACHE_DTLB_READ_MISS,	"dTLB Read Misses"),
+	PERF_INFO(HW_CACHE, HW_CACHE_DTLB_WRITE_MISS,	"dTLB Write Misses"),
+#endif
+#if STRESS_GOT(HW_CACHE_ITLB)
+	PERF_INFO(HW_CACHE, HW_CACHE_ITLB_READ_MISS,	"iTLB Read Misses"),
+#endif
+
+	PERF_INFO(RAW, TD_TOTAL_SLOTS,			"Topdown Total Slots"),
+	PERF_INFO(RAW, TD_SLOTS_ISSUED,			"Topdown Slots Issued"),
+	PERF_INFO(RAW, TD_SLOTS_RETIRED,		"Topdown Slots Retired"),
+	PERF_INFO(RAW, TD_FETCH_BUBBLES,		"Topdown Fetch Bubbles"),
+	PERF_INFO(RAW, TD_RECOVERY_BUBBLES,		"Topdown Recovery Bubbles"),
 
 #if STRESS_GOT(SW_PAGE_FAULTS_MIN)
 	PERF_INFO(SOFTWARE, SW_PAGE_FAULTS_MIN,		"Page Faults Minor"),
@@ -183,8 +239,19 @@ static perf_info_t perf_info[STRESS_PERF_MAX + 1] = {
 	PERF_INFO(TRACEPOINT, TP_SOFTIRQ_EXIT,		"Soft IRQ Exit"),
 	PERF_INFO(TRACEPOINT, TP_WRITEBACK_DIRTY_INODE,	"Writeback Dirty Inode"),
 	PERF_INFO(TRACEPOINT, TP_WRITEBACK_DIRTY_PAGE,	"Writeback Dirty Page"),
+	PERF_INFO(TRACEPOINT, TP_LOCK_CONTENTION_BEGIN,	"Lock Contentions"),
+
+	{ 0, 0, 0, NULL, 0.0 }
+};
 
-	{ 0, 0, 0, NULL }
+static const perf_pmu_info_t perf_pmu_info[] = {
+	PERF_PMU_INFO(TD_TOTAL_SLOTS,		"topdown-total-slots"),
+	PERF_PMU_INFO(TD_SLOTS_ISSUED,		"topdown-slots-issued"),
+	PERF_PMU_INFO(TD_SLOTS_RETIRED,		"topdown-slots-retired"),
+	PERF_PMU_INFO(TD_FETCH_BUBBLES,		"topdown-fetch-bubbles"),
+	PERF_PMU_INFO(TD_RECOVERY_BUBBLES,	"topdown-recovery-bubbles"),
+
+	{ 0, NULL }
 };
 
 static const perf_tp_info_t perf_tp_info[] = {
@@ -213,14 +280,41 @@ static const perf_tp_info_t perf_tp_info[] = {
 	PERF_TP_INFO(TP_SOFTIRQ_EXIT,		"irq/softirq_exit"),
 	PERF_TP_INFO(TP_WRITEBACK_DIRTY_INODE,	"writeback/writeback_dirty_inode"),
 	PERF_TP_INFO(TP_WRITEBACK_DIRTY_PAGE,	"writeback/writeback_dirty_page"),
+	PERF_TP_INFO(TP_LOCK_CONTENTION_BEGIN,	"lock/contention_begin"),
 
 	{ 0, NULL }
 };
 
-static unsigned long perf_type_tracepoint_resolve_config(const int id)
+/* tracefs mount points, newer kernels mount it outside of debugfs */
+static const char *perf_tracing_paths[] = {
+	"/sys/kernel/debug/tracing",
+	"/sys/kernel/tracing",
+};
+
+/*
+ *  perf_tracing_fopen()
+ *	open a file of a trace event, e.g. lock/contention_begin/id,
+ *	trying each tracefs mount point in turn
+ */
+static FILE *perf_tracing_fopen(const char *event, const char *file)
 {
 	char path[PATH_MAX];
 	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(perf_tracing_paths); i++) {
+		FILE *fp;
+
+		snprintf(path, sizeof(path), "%s/events/%s/%s",
+			perf_tracing_paths[i], event, file);
+		if ((fp = fopen(path, "r")) != NULL)
+			return fp;
+	}
+	return NULL;
+}
+
+static unsigned long perf_type_tracepoint_resolve_config(const int id)
+{
+	size_t i;
 	unsigned long config;
 	bool not_found = true;
 	FILE *fp;
@@ -234,9 +328,7 @@ static unsigned long perf_type_tracepoint_resolve_config(const int id)
 	if (not_found)
 		return UNRESOLVED;
 
-	snprintf(path, sizeof(path), "/sys/kernel/debug/tracing/events/%s/id",
-		perf_tp_info[i].path);
-	if ((fp = fopen(path, "r")) == NULL)
+	if ((fp = perf_tracing_fopen(perf_tp_info[i].path, "id")) == NULL)
 		return UNRESOLVED;
 	if (fscanf(fp, "%lu", &config) != 1) {
 		fclose(fp);
@@ -247,6 +339,178 @@ static unsigned long perf_type_tracepoint_resolve_config(const int id)
 	return config;
 }
 
+/* offsets of the fields in the raw contention_begin data */
+static int perf_lock_addr_offset = -1;
+static int perf_lock_flags_offset = -1;
+
+/*
+ *  perf_lock_field_offset()
+ *	parse the offset of a field from a trace event format
+ *	line such as "field:void * lock_addr; offset:8; size:8;"
+ */
+static int perf_lock_field_offset(const char *line, const char *field)
+{
+	const char *ptr;
+	int offset;
+
+	if ((ptr = strstr(line, field)) == NULL)
+		return -1;
+	if ((ptr = strstr(ptr, "offset:")) == NULL)
+		return -1;
+	if (sscanf(ptr, "offset:%d;", &offset) != 1)
+		return -1;
+	return offset;
+}
+
+/*
+ *  perf_lock_format_init()
+ *	find where lock_addr and flags live in the raw data
+ *	rather than assume the layout of the common fields
+ */
+static void perf_lock_format_init(void)
+{
+	char line[256];
+	FILE *fp;
+
+	if ((fp = perf_tracing_fopen("lock/contention_begin", "format")) == NULL)
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		int offset;
+
+		if ((offset = perf_lock_field_offset(line, " lock_addr;")) >= 0)
+			perf_lock_addr_offset = offset;
+		if ((offset = perf_lock_field_offset(line, " flags;")) >= 0)
+			perf_lock_flags_offset = offset;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  perf_pmu_format_config()
+ *	place the value of an event term into the config bits
+ *	given by the PMU format file of the term, e.g. config:0-7,21
+ *	Only terms in the config field are supported.
+ */
+static int perf_pmu_format_config(
+	const char *pmu_path,
+	const char *term,
+	uint64_t val,
+	unsigned long *config)
+{
+	char path[PATH_MAX], buffer[128], *ptr, *tok;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/format/%s", pmu_path, term);
+	if ((fp = fopen(path, "r")) == NULL)
+		return -1;
+	if (!fgets(buffer, sizeof(buffer), fp)) {
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	if (strncmp(buffer, "config:", 7))
+		return -1;
+
+	for (ptr = buffer + 7; (tok = strtok(ptr, ",\n")); ptr = NULL) {
+		unsigned int lo, hi, bit;
+
+		switch (sscanf(tok, "%u-%u", &lo, &hi)) {
+		case 1:
+			hi = lo;
+			break;
+		case 2:
+			break;
+		default:
+			return -1;
+		}
+		if ((hi < lo) || (hi >= sizeof(*config) * 8))
+			return -1;
+		for (bit = lo; bit <= hi; bit++, val >>= 1)
+			*config |= (unsigned long)(val & 1) << bit;
+	}
+	return 0;
+}
+
+/*
+ *  perf_pmu_resolve_config()
+ *	resolve a named event of a sysfs PMU into a perf
+ *	type, config and unit scale
+ */
+static unsigned long perf_pmu_resolve_config(
+	const char *pmu_path,
+	const char *event,
+	unsigned long *type,
+	double *scale)
+{
+	char path[PATH_MAX], buffer[256], *ptr, *tok;
+	unsigned long config = 0;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/type", pmu_path);
+	if ((fp = fopen(path, "r")) == NULL)
+		return UNRESOLVED;
+	if (fscanf(fp, "%lu", type) != 1) {
+		fclose(fp);
+		return UNRESOLVED;
+	}
+	fclose(fp);
+
+	snprintf(path, sizeof(path), "%s/events/%s", pmu_path, event);
+	if ((fp = fopen(path, "r")) == NULL)
+		return UNRESOLVED;
+	if (!fgets(buffer, sizeof(buffer), fp)) {
+		fclose(fp);
+		return UNRESOLVED;
+	}
+	fclose(fp);
+
+	/* Event terms, e.g. event=0x3c,umask=0x00,any=1 */
+	for (ptr = buffer; (tok = strsep(&ptr, ",\n")); ) {
+		char *eq;
+		uint64_t val = 1;
+
+		if (!*tok)
+			continue;
+		eq = strchr(tok, '=');
+		if (eq) {
+			*eq = '\0';
+			val = strtoull(eq + 1, NULL, 0);
+		}
+		if (perf_pmu_format_config(pmu_path, tok, val, &config) < 0)
+			return UNRESOLVED;
+	}
+
+	snprintf(path, sizeof(path), "%s/events/%s.scale", pmu_path, event);
+	if ((fp = fopen(path, "r")) != NULL) {
+		if ((fscanf(fp, "%lf", scale) != 1) || (*scale <= 0.0))
+			*scale = 1.0;
+		fclose(fp);
+	}
+
+	return config;
+}
+
+/*
+ *  perf_type_pmu_resolve_config()
+ *	resolve a CPU PMU sysfs event, such as a top-down
+ *	event, into a perf type, config and unit scale
+ */
+static unsigned long perf_type_pmu_resolve_config(
+	const int id,
+	unsigned long *type,
+	double *scale)
+{
+	size_t i;
+
+	for (i = 0; perf_pmu_info[i].name; i++) {
+		if (perf_pmu_info[i].id == id)
+			return perf_pmu_resolve_config(PERF_PMU_CPU_PATH,
+				perf_pmu_info[i].name, type, scale);
+	}
+	return UNRESOLVED;
+}
+
 void perf_init(void)
 {
 	size_t i;
@@ -256,7 +520,14 @@ void perf_init(void)
 			perf_info[i].config =
 				perf_type_tracepoint_resolve_config(perf_info[i].id);
 		}
+		if (perf_info[i].type == PERF_TYPE_RAW) {
+			perf_info[i].config =
+				perf_type_pmu_resolve_config(perf_info[i].id,
+					&perf_info[i].type, &perf_info[i].scale);
+		}
 	}
+	if (opt_flags & OPT_FLAGS_PERF_CONTENTION)
+		perf_lock_format_init();
 }
 
 static inline int sys_perf_event_open(
@@ -298,13 +569,39 @@ static char *perf_yaml_label(char *dst, const char *src, size_t n)
 	return dst;
 }
 
+/*
+ *  perf_counter_scale()
+ *	scale a counter by the enabled / running time ratio
+ *	to account for multiplexing of the counters
+ */
+static uint64_t perf_counter_scale(
+	const uint64_t counter,
+	const uint64_t time_enabled,
+	const uint64_t time_running)
+{
+	double scale;
+
+	/* Ensure we don't get division by zero */
+	if (time_running == 0) {
+		scale = (time_enabled == 0) ? 1.0 : 0.0;
+	} else {
+		scale = (double)time_enabled / time_running;
+	}
+	return (uint64_t)((double)counter * scale);
+}
+
 /*
  *  perf_open()
- *	open perf, get leader and perf fd's
+ *	open perf, get leader and perf fd's. The hardware events
+ *	are opened as groups so that they are all counted over the
+ *	same time window, a new group is started whenever an event
+ *	does not fit into the current group. Other events are opened
+ *	individually.
  */
 int perf_open(stress_perf_t *sp)
 {
 	size_t i;
+	int leader = -1;
 
 	if (!sp)
 		return -1;
@@ -317,23 +614,52 @@ int perf_open(stress_perf_t *sp)
 	for (i = 0; i < STRESS_PERF_MAX; i++) {
 		sp->perf_stat[i].fd = -1;
 		sp->perf_stat[i].counter = 0;
+		sp->perf_stat[i].leader = -1;
 	}
 
 	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
 		if (perf_info[i].config != UNRESOLVED) {
 			struct perf_event_attr attr;
+			int fd = -1;
 
 			memset(&attr, 0, sizeof(attr));
 			attr.type = perf_info[i].type;
 			attr.config = perf_info[i].config;
-			attr.disabled = 1;
 			attr.inherit = 1;
-			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
-					   PERF_FORMAT_TOTAL_TIME_RUNNING;
 			attr.size = sizeof(attr);
-			sp->perf_stat[i].fd =
-				sys_perf_event_open(&attr, 0, -1, -1, 0);
-			if (sp->perf_stat[i].fd > -1)
+
+			if ((perf_info[i].type != PERF_TYPE_SOFTWARE) &&
+			    (perf_info[i].type != PERF_TYPE_TRACEPOINT)) {
+				attr.read_format = PERF_FORMAT_GROUP |
+						   PERF_FORMAT_TOTAL_TIME_ENABLED |
+						   PERF_FORMAT_TOTAL_TIME_RUNNING;
+				/* Try to join the current group first */
+				if (leader > -1) {
+					attr.disabled = 0;
+					fd = sys_perf_event_open(&attr, 0, -1,
+						sp->perf_stat[leader].fd, 0);
+					if (fd > -1)
+						sp->perf_stat[i].leader = leader;
+				}
+				/* ..failing that, lead a new group */
+				if (fd < 0) {
+					attr.disabled = 1;
+					fd = sys_perf_event_open(&attr, 0, -1, -1, 0);
+					if (fd > -1) {
+						leader = i;
+						sp->perf_stat[i].leader = leader;
+					}
+				}
+			}
+			/* Not hardware or grouping unsupported, open individually */
+			if (fd < 0) {
+				attr.disabled = 1;
+				attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+						   PERF_FORMAT_TOTAL_TIME_RUNNING;
+				fd = sys_perf_event_open(&attr, 0, -1, -1, 0);
+			}
+			sp->perf_stat[i].fd = fd;
+			if (fd > -1)
 				sp->perf_opened++;
 		}
 	}
@@ -412,129 +738,769 @@ int perf_disable(stress_perf_t *sp)
 }
 
 /*
- *  perf_close()
- *	read counters and close
+ *  perf_read_group()
+ *	read all the counters of the group led by perf_stat[leader]
+ *	in one read, the counters are in the order they joined the
+ *	group, which is the order of the perf_info table
  */
-int perf_close(stress_perf_t *sp)
+static void perf_read_group(
+	const stress_perf_t *sp,
+	const int leader,
+	uint64_t counters[STRESS_PERF_MAX])
 {
-	size_t i = 0;
-	perf_data_t data;
+	size_t i, j;
+	perf_group_data_t data;
 	ssize_t ret;
-	int rc = -1;
-	double scale;
 
-	if (!sp)
-		return -1;
-	if (!sp->perf_opened)
-		goto out_ok;
+	memset(&data, 0, sizeof(data));
+	ret = read(sp->perf_stat[leader].fd, &data, sizeof(data));
 
-	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
-		int fd = sp->perf_stat[i].fd;
-		if (fd < 0 ) {
-			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
+	for (j = 0, i = leader; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if ((sp->perf_stat[i].leader != leader) ||
+		    (sp->perf_stat[i].fd < 0))
 			continue;
+		if ((ret < (ssize_t)(3 * sizeof(uint64_t))) ||
+		    (j >= data.nr)) {
+			counters[i] = STRESS_PERF_INVALID;
+		} else {
+			counters[i] = perf_counter_scale(data.counter[j],
+				data.time_enabled, data.time_running);
 		}
+		j++;
+	}
+}
 
-		memset(&data, 0, sizeof(data));
-		ret = read(fd, &data, sizeof(data));
-		if (ret != sizeof(data))
-			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
-		else {
-			/* Ensure we don't get division by zero */
-			if (data.time_running == 0) {
-				scale = (data.time_enabled == 0) ? 1.0 : 0.0;
-			} else {
-				scale = (double)data.time_enabled /
-					data.time_running;
-			}
-			sp->perf_stat[i].counter = (uint64_t)
-				((double)data.counter * scale);
-		}
-		(void)close(fd);
-		sp->perf_stat[i].fd = -1;
+/*
+ *  perf_read_counters()
+ *	read the current scaled value of all the counters,
+ *	the counters keep on running
+ */
+static void perf_read_counters(
+	const stress_perf_t *sp,
+	uint64_t counters[STRESS_PERF_MAX])
+{
+	size_t i;
+
+	for (i = 0; i < STRESS_PERF_MAX; i++)
+		counters[i] = STRESS_PERF_INVALID;
+
+	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if ((sp->perf_stat[i].fd > -1) &&
+		    (sp->perf_stat[i].leader == (int)i))
+			perf_read_group(sp, i, counters);
 	}
 
-out_ok:
-	rc = 0;
-	for (; i < STRESS_PERF_MAX; i++)
-		sp->perf_stat[i].counter = STRESS_PERF_INVALID;
+	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		const int fd = sp->perf_stat[i].fd;
+		perf_data_t data;
+
+		/* Group members, valid if read with their leader */
+		if ((fd < 0) || (sp->perf_stat[i].leader > -1))
+			continue;
+
+		memset(&data, 0, sizeof(data));
+		if (read(fd, &data, sizeof(data)) == sizeof(data))
+			counters[i] = perf_counter_scale(data.counter,
+				data.time_enabled, data.time_running);
+	}
 
-	return rc;
+	/* Some PMU events count in units, e.g. 2 top-down slots per count */
+	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if ((counters[i] != STRESS_PERF_INVALID) &&
+		    (perf_info[i].scale > 1.0))
+			counters[i] = (uint64_t)((double)counters[i] * perf_info[i].scale);
+	}
 }
 
 /*
- *  perf_get_counter_by_index()
- *	fetch counter and perf ID via index i
+ *  perf_close()
+ *	read counters and close
  */
-int perf_get_counter_by_index(
-	const stress_perf_t *sp,
-	const int i,
-	uint64_t *counter,
-	int *id)
+int perf_close(stress_perf_t *sp)
 {
-	if ((i < 0) || (i >= STRESS_PERF_MAX))
-		goto fail;
+	size_t i;
+	uint64_t counters[STRESS_PERF_MAX];
 
-	if (perf_info[i].label) {
-		*id = perf_info[i].id;
-		*counter = sp->perf_stat[i].counter;
+	if (!sp)
+		return -1;
+	if (!sp->perf_opened) {
+		for (i = 0; i < STRESS_PERF_MAX; i++)
+			sp->perf_stat[i].counter = STRESS_PERF_INVALID;
 		return 0;
 	}
 
-fail:
-	*id = -1;
-	*counter = STRESS_PERF_INVALID;
-	return -1;
+	/* Read all the counters before any of the group fds are closed */
+	perf_read_counters(sp, counters);
+	for (i = 0; i < STRESS_PERF_MAX; i++)
+		sp->perf_stat[i].counter = counters[i];
+
+	/* Close members before their group leaders */
+	for (i = STRESS_PERF_MAX; i-- > 0; ) {
+		if (sp->perf_stat[i].fd > -1) {
+			(void)close(sp->perf_stat[i].fd);
+			sp->perf_stat[i].fd = -1;
+		}
+	}
+	return 0;
 }
 
 /*
- *  perf_get_label_by_index()
- *	fetch label via index i
+ *  perf_open_by_id()
+ *	open a single enabled counter via perf ID that counts this
+ *	process and any children forked after it is opened, returns
+ *	the perf fd or -1 if it cannot be opened
  */
-const char *perf_get_label_by_index(const int i)
+int perf_open_by_id(const int id)
 {
-	if ((i < 0) || (i >= STRESS_PERF_MAX))
-		return NULL;
+	size_t i;
 
-	return perf_info[i].label;
-}
+	if (shared->perf.no_perf)
+		return -1;
+
+	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if ((perf_info[i].id == id) &&
+		    (perf_info[i].config != UNRESOLVED)) {
+			struct perf_event_attr attr;
+
+			memset(&attr, 0, sizeof(attr));
+			attr.type = perf_info[i].type;
+			attr.config = perf_info[i].config;
+			attr.inherit = 1;
+			attr.size = sizeof(attr);
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+					   PERF_FORMAT_TOTAL_TIME_RUNNING;
 
+			return sys_perf_event_open(&attr, 0, -1, -1, 0);
+		}
+	}
+	return -1;
+}
 
 /*
- *  perf_get_counter_by_id()
- *	fetch counter and index via perf ID
+ *  perf_open_cpu_by_id()
+ *	open a single enabled counter via perf ID that counts all
+ *	the tasks on one CPU, this needs privilege or a low
+ *	perf_event_paranoid. Returns the perf fd or -1 if it
+ *	cannot be opened
  */
-int perf_get_counter_by_id(
-	const stress_perf_t *sp,
-	int id,
-	uint64_t *counter,
-	int *index)
+int perf_open_cpu_by_id(const int id, const int cpu)
 {
-	int i;
+	size_t i;
 
-	for (i = 0; perf_info[i].label; i++) {
-		if (perf_info[i].id == id) {
-			*index = i;
-			*counter = sp->perf_stat[i].counter;
-			return 0;
+	if (shared->perf.no_perf)
+		return -1;
+
+	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if ((perf_info[i].id == id) &&
+		    (perf_info[i].config != UNRESOLVED)) {
+			struct perf_event_attr attr;
+
+			memset(&attr, 0, sizeof(attr));
+			attr.type = perf_info[i].type;
+			attr.config = perf_info[i].config;
+			attr.size = sizeof(attr);
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+					   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			return sys_perf_event_open(&attr, -1, cpu, -1, 0);
 		}
 	}
-
-	*index = -1;
-	*counter = 0;
 	return -1;
 }
 
 /*
- *  perf_stat_succeeded()
- *	did perf event open work OK?
+ *  perf_open_pmu_event()
+ *	open a system wide counter on one CPU for a named event
+ *	of a sysfs PMU, e.g. power/energy-pkg. These count for
+ *	all tasks so need privilege or a low perf_event_paranoid.
+ *	The counter is read with perf_read_by_fd() and multiplied
+ *	by scale to get the event unit
  */
-bool perf_stat_succeeded(const stress_perf_t *sp)
+int perf_open_pmu_event(
+	const char *pmu,
+	const char *event,
+	const int cpu,
+	double *scale)
 {
-	return sp->perf_opened > 0;
+	char pmu_path[PATH_MAX];
+	struct perf_event_attr attr;
+	unsigned long type, config;
+
+	*scale = 1.0;
+	snprintf(pmu_path, sizeof(pmu_path),
+		"/sys/bus/event_source/devices/%s", pmu);
+	config = perf_pmu_resolve_config(pmu_path, event, &type, scale);
+	if (config == UNRESOLVED)
+		return -1;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = type;
+	attr.config = config;
+	attr.size = sizeof(attr);
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+			   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return sys_perf_event_open(&attr, -1, cpu, -1, 0);
 }
 
-typedef struct {
+/*
+ *  perf_read_by_fd()
+ *	read the current scaled value of a counter opened with
+ *	perf_open_by_id(), inherited children are included
+ */
+int perf_read_by_fd(const int fd, uint64_t *counter)
+{
+	perf_data_t data;
+
+	*counter = 0;
+	if (fd < 0)
+		return -1;
+	memset(&data, 0, sizeof(data));
+	if (read(fd, &data, sizeof(data)) != sizeof(data))
+		return -1;
+	*counter = perf_counter_scale(data.counter,
+		data.time_enabled, data.time_running);
+	return 0;
+}
+
+/*
+ *  Lock contention sampling, each lock:contention_begin event
+ *  of a stressor instance is sampled with its raw trace data
+ *  and the contended lock addresses are kept in a small
+ *  heavy hitter table of the instance. Inherited per task
+ *  events cannot be mmap'd, so like perf record there is an
+ *  inherited event and ring buffer per CPU
+ */
+#define PERF_LOCK_RING_PAGES		(16)	/* power of 2 */
+#define PERF_LOCK_DRAIN_INTERVAL	(50)	/* milliseconds */
+#define PERF_LOCK_TOP			(10)	/* locks in the report */
+
+/* lock:contention_begin flags, see include/trace/events/lock.h */
+#define LCB_F_SPIN	(1U << 0)
+#define LCB_F_READ	(1U << 1)
+#define LCB_F_WRITE	(1U << 2)
+#define LCB_F_RT	(1U << 3)
+#define LCB_F_PERCPU	(1U << 4)
+#define LCB_F_MUTEX	(1U << 5)
+
+typedef struct {
+	uint32_t flags;			/* LCB_F_* flags */
+	const char *type;		/* lock type */
+} perf_lock_type_t;
+
+static const perf_lock_type_t perf_lock_types[] = {
+	{ LCB_F_SPIN,			"spinlock" },
+	{ LCB_F_SPIN | LCB_F_READ,	"rwlock:R" },
+	{ LCB_F_SPIN | LCB_F_WRITE,	"rwlock:W" },
+	{ LCB_F_READ,			"rwsem:R" },
+	{ LCB_F_WRITE,			"rwsem:W" },
+	{ LCB_F_RT,			"rt-mutex" },
+	{ LCB_F_RT | LCB_F_READ,	"rwlock-rt:R" },
+	{ LCB_F_RT | LCB_F_WRITE,	"rwlock-rt:W" },
+	{ LCB_F_PERCPU | LCB_F_READ,	"pcpu-sem:R" },
+	{ LCB_F_PERCPU | LCB_F_WRITE,	"pcpu-sem:W" },
+	{ LCB_F_MUTEX,			"mutex" },
+	{ LCB_F_MUTEX | LCB_F_SPIN,	"mutex-spin" },
+};
+
+static pthread_t perf_lock_pthread;
+static pthread_mutex_t perf_lock_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t perf_lock_cond = PTHREAD_COND_INITIALIZER;
+static bool perf_lock_keep_draining;
+static bool perf_lock_pthread_running;
+static stress_perf_t *perf_lock_sp;
+static size_t perf_lock_mmap_size;
+
+/* per CPU contention sample ring */
+typedef struct {
+	int fd;				/* perf fd */
+	struct perf_event_mmap_page *meta; /* mmap'd ring */
+} perf_lock_ring_t;
+
+static perf_lock_ring_t *perf_lock_rings;
+static int perf_lock_nrings;
+
+/*
+ *  perf_lock_type()
+ *	lock type name of contention_begin flags
+ */
+static const char *perf_lock_type(const uint32_t flags)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(perf_lock_types); i++)
+		if (perf_lock_types[i].flags == flags)
+			return perf_lock_types[i].type;
+	return (flags == 0) ? "semaphore" : "unknown";
+}
+
+/*
+ *  perf_lock_account()
+ *	count a contended lock, when the table is full the
+ *	least contended entry is taken over and inherits its
+ *	count (space saving) so the heavy hitters survive
+ */
+static void perf_lock_account(
+	stress_perf_t *sp,
+	const uint64_t addr,
+	const uint32_t flags)
+{
+	perf_lock_t *min = &sp->locks[0];
+	size_t i;
+
+	for (i = 0; i < PERF_LOCK_SITES; i++) {
+		perf_lock_t *lock = &sp->locks[i];
+
+		if (lock->count && (lock->addr == addr)) {
+			lock->count++;
+			return;
+		}
+		if (!lock->count) {
+			lock->addr = addr;
+			lock->flags = flags;
+			lock->count = 1;
+			return;
+		}
+		if (lock->count < min->count)
+			min = lock;
+	}
+	min->addr = addr;
+	min->flags = flags;
+	min->count++;
+}
+
+/*
+ *  perf_lock_drain_ring()
+ *	consume the samples in a ring buffer
+ */
+static void perf_lock_drain_ring(
+	stress_perf_t *sp,
+	struct perf_event_mmap_page *meta)
+{
+	const size_t data_size = perf_lock_mmap_size - (size_t)getpagesize();
+	uint8_t *data = (uint8_t *)meta + getpagesize();
+	uint64_t head, tail;
+
+	head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+	tail = meta->data_tail;
+
+	while (tail < head) {
+		uint8_t record[512];
+		struct perf_event_header hdr;
+		size_t i, size;
+
+		for (i = 0; i < sizeof(hdr); i++)
+			((uint8_t *)&hdr)[i] = data[(tail + i) % data_size];
+		if (hdr.size < sizeof(hdr))
+			break;
+		size = (hdr.size < sizeof(record)) ? hdr.size : sizeof(record);
+		for (i = 0; i < size; i++)
+			record[i] = data[(tail + i) % data_size];
+		tail += hdr.size;
+
+		if (hdr.type == PERF_RECORD_SAMPLE) {
+			/* PERF_SAMPLE_RAW, u32 size then the trace data */
+			const uint8_t *raw = record + sizeof(hdr) + sizeof(uint32_t);
+			uint32_t raw_size;
+			uint64_t addr;
+			uint32_t flags;
+
+			(void)memcpy(&raw_size, record + sizeof(hdr), sizeof(raw_size));
+			if ((raw + raw_size > record + size) ||
+			    ((size_t)perf_lock_addr_offset + sizeof(addr) > raw_size) ||
+			    ((size_t)perf_lock_flags_offset + sizeof(flags) > raw_size))
+				continue;
+			(void)memcpy(&addr, raw + perf_lock_addr_offset, sizeof(addr));
+			(void)memcpy(&flags, raw + perf_lock_flags_offset, sizeof(flags));
+			perf_lock_account(sp, addr, flags);
+		} else if (hdr.type == PERF_RECORD_LOST) {
+			/* u64 id then u64 lost */
+			uint64_t lost;
+
+			if (size >= sizeof(hdr) + 2 * sizeof(uint64_t)) {
+				(void)memcpy(&lost, record + sizeof(hdr) +
+					sizeof(uint64_t), sizeof(lost));
+				sp->locks_lost += lost;
+			}
+		}
+	}
+	__atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+/*
+ *  perf_lock_drain()
+ *	consume the samples of all the CPUs
+ */
+static void perf_lock_drain(stress_perf_t *sp)
+{
+	int i;
+
+	for (i = 0; i < perf_lock_nrings; i++)
+		perf_lock_drain_ring(sp, perf_lock_rings[i].meta);
+}
+
+/*
+ *  perf_lock_close()
+ *	unmap and close the per CPU rings
+ */
+static void perf_lock_close(void)
+{
+	int i;
+
+	for (i = 0; i < perf_lock_nrings; i++) {
+		(void)ioctl(perf_lock_rings[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+		(void)munmap((void *)perf_lock_rings[i].meta, perf_lock_mmap_size);
+		(void)close(perf_lock_rings[i].fd);
+	}
+	free(perf_lock_rings);
+	perf_lock_rings = NULL;
+	perf_lock_nrings = 0;
+}
+
+/*
+ *  perf_lock_thread()
+ *	drain the contention samples until told to stop
+ */
+static void *perf_lock_thread(void *arg)
+{
+	static void *nowt = NULL;
+	struct timespec abstime;
+
+	(void)arg;
+
+	(void)clock_gettime(CLOCK_REALTIME, &abstime);
+
+	pthread_mutex_lock(&perf_lock_mutex);
+	while (perf_lock_keep_draining) {
+		abstime.tv_nsec += PERF_LOCK_DRAIN_INTERVAL * 1000000;
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_nsec -= 1000000000;
+			abstime.tv_sec++;
+		}
+		while (perf_lock_keep_draining &&
+		       (pthread_cond_timedwait(&perf_lock_cond, &perf_lock_mutex, &abstime) == 0))
+			;
+		perf_lock_drain(perf_lock_sp);
+	}
+	pthread_mutex_unlock(&perf_lock_mutex);
+
+	return &nowt;
+}
+
+/*
+ *  perf_contention_start()
+ *	sample every kernel lock contention of this stressor
+ *	instance and its children
+ */
+void perf_contention_start(stress_perf_t *sp)
+{
+	struct perf_event_attr attr;
+	sigset_t set, oldset;
+	long cpu, ncpus;
+	size_t i;
+	int ret;
+
+	if (!sp || shared->perf.no_perf)
+		return;
+	if ((perf_lock_addr_offset < 0) || (perf_lock_flags_offset < 0))
+		return;
+
+	memset(&attr, 0, sizeof(attr));
+	for (i = 0; i < STRESS_PERF_MAX && perf_info[i].label; i++) {
+		if (perf_info[i].id == STRESS_PERF_TP_LOCK_CONTENTION_BEGIN) {
+			attr.config = perf_info[i].config;
+			break;
+		}
+	}
+	if (!perf_info[i].label || (attr.config == UNRESOLVED))
+		return;
+
+	attr.type = PERF_TYPE_TRACEPOINT;
+	attr.size = sizeof(attr);
+	attr.sample_period = 1;
+	attr.sample_type = PERF_SAMPLE_RAW;
+	attr.inherit = 1;
+	attr.exclude_guest = 1;
+
+	ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (ncpus < 1)
+		return;
+	perf_lock_rings = calloc((size_t)ncpus, sizeof(*perf_lock_rings));
+	if (!perf_lock_rings)
+		return;
+	perf_lock_mmap_size = (size_t)(1 + PERF_LOCK_RING_PAGES) * getpagesize();
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		perf_lock_ring_t *ring = &perf_lock_rings[perf_lock_nrings];
+
+		/* Offline CPUs just fail to open */
+		ring->fd = sys_perf_event_open(&attr, 0, (int)cpu, -1, 0);
+		if (ring->fd < 0)
+			continue;
+		ring->meta = mmap(NULL, perf_lock_mmap_size,
+			PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+		if (ring->meta == MAP_FAILED) {
+			pr_dbg(stderr, "perf: cannot mmap lock contention samples: "
+				"errno=%d (%s)\n", errno, strerror(errno));
+			(void)close(ring->fd);
+			continue;
+		}
+		perf_lock_nrings++;
+	}
+	if (!perf_lock_nrings) {
+		pr_dbg(stderr, "perf: cannot sample lock contention\n");
+		goto err_free;
+	}
+	perf_lock_sp = sp;
+	perf_lock_keep_draining = true;
+
+	/* Leave all signal handling to the stressor, the thread inherits the mask */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, &oldset);
+	ret = pthread_create(&perf_lock_pthread, NULL, perf_lock_thread, NULL);
+	(void)pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	if (ret) {
+		pr_dbg(stderr, "perf: cannot create lock contention thread: "
+			"errno=%d (%s)\n", ret, strerror(ret));
+		perf_lock_close();
+		return;
+	}
+	perf_lock_pthread_running = true;
+	return;
+
+err_free:
+	free(perf_lock_rings);
+	perf_lock_rings = NULL;
+}
+
+/*
+ *  perf_contention_stop()
+ *	stop sampling, the remaining samples are drained
+ */
+void perf_contention_stop(void)
+{
+	if (!perf_lock_pthread_running)
+		return;
+
+	pthread_mutex_lock(&perf_lock_mutex);
+	perf_lock_keep_draining = false;
+	pthread_cond_signal(&perf_lock_cond);
+	pthread_mutex_unlock(&perf_lock_mutex);
+	(void)pthread_join(perf_lock_pthread, NULL);
+	perf_lock_pthread_running = false;
+
+	perf_lock_drain(perf_lock_sp);
+	perf_lock_close();
+}
+
+#if defined(STRESS_SAMPLE)
+#define PERF_SAMPLE_MIN_INTERVAL	(10)	/* milliseconds */
+
+static pthread_t perf_sample_pthread;
+static pthread_mutex_t perf_sample_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t perf_sample_cond = PTHREAD_COND_INITIALIZER;
+static bool perf_keep_sampling;
+static bool perf_sample_pthread_running;
+static stress_perf_t *perf_sample_sp;
+
+/*
+ *  perf_sample_live()
+ *	publish the current counter values for the parent
+ *	sampling thread to pick up
+ */
+static void perf_sample_live(stress_perf_t *sp)
+{
+	uint64_t counters[STRESS_PERF_MAX];
+	size_t i;
+
+	perf_read_counters(sp, counters);
+	for (i = 0; i < STRESS_PERF_MAX; i++)
+		__atomic_store_n(&sp->live[i], counters[i], __ATOMIC_RELAXED);
+}
+
+/*
+ *  perf_sample_thread()
+ *	periodically read the perf counters of this
+ *	stressor instance until told to stop
+ */
+static void *perf_sample_thread(void *arg)
+{
+	static void *nowt = NULL;
+	struct timespec abstime;
+	/* Read more often than the parent samples to keep the lag low */
+	const uint64_t interval = (opt_sample_interval / 4) > PERF_SAMPLE_MIN_INTERVAL ?
+		(opt_sample_interval / 4) : PERF_SAMPLE_MIN_INTERVAL;
+
+	(void)arg;
+
+	(void)clock_gettime(CLOCK_REALTIME, &abstime);
+
+	pthread_mutex_lock(&perf_sample_mutex);
+	while (perf_keep_sampling) {
+		abstime.tv_sec += interval / 1000;
+		abstime.tv_nsec += (interval % 1000) * 1000000;
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_nsec -= 1000000000;
+			abstime.tv_sec++;
+		}
+		/* Sleep until the next read is due or we are stopped */
+		while (perf_keep_sampling &&
+		       (pthread_cond_timedwait(&perf_sample_cond, &perf_sample_mutex, &abstime) == 0))
+			;
+		perf_sample_live(perf_sample_sp);
+	}
+	pthread_mutex_unlock(&perf_sample_mutex);
+
+	return &nowt;
+}
+
+/*
+ *  perf_sample_start()
+ *	start reading the perf counters of a stressor
+ *	instance at the --sample interval
+ */
+void perf_sample_start(stress_perf_t *sp)
+{
+	sigset_t set, oldset;
+	size_t i;
+	int ret;
+
+	if (!sp || !sp->perf_opened)
+		return;
+
+	for (i = 0; i < STRESS_PERF_MAX; i++)
+		sp->live[i] = STRESS_PERF_INVALID;
+	perf_sample_sp = sp;
+	perf_keep_sampling = true;
+
+	/* Leave all signal handling to the stressor, the thread inherits the mask */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, &oldset);
+	ret = pthread_create(&perf_sample_pthread, NULL, perf_sample_thread, NULL);
+	(void)pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	if (ret) {
+		pr_dbg(stderr, "perf: cannot create sampling thread: "
+			"errno=%d (%s)\n", ret, strerror(ret));
+		return;
+	}
+	perf_sample_pthread_running = true;
+}
+
+/*
+ *  perf_sample_stop()
+ *	stop reading the perf counters and wait for
+ *	the thread to finish
+ */
+void perf_sample_stop(void)
+{
+	if (!perf_sample_pthread_running)
+		return;
+
+	pthread_mutex_lock(&perf_sample_mutex);
+	perf_keep_sampling = false;
+	pthread_cond_signal(&perf_sample_cond);
+	pthread_mutex_unlock(&perf_sample_mutex);
+	(void)pthread_join(perf_sample_pthread, NULL);
+	perf_sample_pthread_running = false;
+
+	/* Final counts for the last parent sample */
+	perf_sample_live(perf_sample_sp);
+}
+
+/*
+ *  perf_get_live_by_id()
+ *	fetch the last sampled value of a counter via perf ID
+ */
+int perf_get_live_by_id(
+	const stress_perf_t *sp,
+	const int id,
+	uint64_t *counter)
+{
+	int i;
+
+	for (i = 0; perf_info[i].label; i++) {
+		if (perf_info[i].id == id) {
+			*counter = __atomic_load_n(&sp->live[i], __ATOMIC_RELAXED);
+			return (*counter == STRESS_PERF_INVALID) ? -1 : 0;
+		}
+	}
+	*counter = 0;
+	return -1;
+}
+#endif
+
+/*
+ *  perf_get_counter_by_index()
+ *	fetch counter and perf ID via index i
+ */
+int perf_get_counter_by_index(
+	const stress_perf_t *sp,
+	const int i,
+	uint64_t *counter,
+	int *id)
+{
+	if ((i < 0) || (i >= STRESS_PERF_MAX))
+		goto fail;
+
+	if (perf_info[i].label) {
+		*id = perf_info[i].id;
+		*counter = sp->perf_stat[i].counter;
+		return 0;
+	}
+
+fail:
+	*id = -1;
+	*counter = STRESS_PERF_INVALID;
+	return -1;
+}
+
+/*
+ *  perf_get_label_by_index()
+ *	fetch label via index i
+ */
+const char *perf_get_label_by_index(const int i)
+{
+	if ((i < 0) || (i >= STRESS_PERF_MAX))
+		return NULL;
+
+	return perf_info[i].label;
+}
+
+
+/*
+ *  perf_get_counter_by_id()
+ *	fetch counter and index via perf ID
+ */
+int perf_get_counter_by_id(
+	const stress_perf_t *sp,
+	int id,
+	uint64_t *counter,
+	int *index)
+{
+	int i;
+
+	for (i = 0; perf_info[i].label; i++) {
+		if (perf_info[i].id == id) {
+			*index = i;
+			*counter = sp->perf_stat[i].counter;
+			return 0;
+		}
+	}
+
+	*index = -1;
+	*counter = 0;
+	return -1;
+}
+
+/*
+ *  perf_stat_succeeded()
+ *	did perf event open work OK?
+ */
+bool perf_stat_succeeded(const stress_perf_t *sp)
+{
+	return sp->perf_opened > 0;
+}
+
+typedef struct {
 	double		threshold;
 	double		scale;
 	char 		*suffix;
@@ -581,11 +1547,142 @@ const char *perf_stat_scale(const uint64_t counter, const double duration)
 	return buffer;
 }
 
+/*
+ *  perf_ratio()
+ *	ratio of two counter totals, false if either
+ *	is not available or the divisor is zero
+ */
+static bool perf_ratio(
+	const uint64_t totals[STRESS_PERF_MAX],
+	const int dividend,
+	const int divisor,
+	double *ratio)
+{
+	if ((totals[dividend] == STRESS_PERF_INVALID) ||
+	    (totals[divisor] == STRESS_PERF_INVALID) ||
+	    (totals[divisor] == 0))
+		return false;
+
+	*ratio = (double)totals[dividend] / (double)totals[divisor];
+	return true;
+}
+
+/*
+ *  perf_derived_metric()
+ *	output a derived metric
+ */
+static void perf_derived_metric(
+	FILE *yaml,
+	json_t *json,
+	const char *label,
+	const char *key,
+	const double value,
+	const bool percent)
+{
+	if (percent)
+		pr_inf(stdout, "%25.2f%% %s\n", value, label);
+	else
+		pr_inf(stdout, "%26.3f %s\n", value, label);
+	pr_yaml(yaml, "      %s: %f\n", key, value);
+	json_double(json, key, value);
+}
+
+/*
+ *  perf_stat_derived()
+ *	output metrics derived from the counter totals of
+ *	a stressor, the stalled cycles give a simple frontend
+ *	and backend bound estimate, the top-down slot events
+ *	(where the CPU has them) give the real level 1
+ *	top-down breakdown
+ */
+static void perf_stat_derived(
+	FILE *yaml,
+	json_t *json,
+	const uint64_t totals[STRESS_PERF_MAX])
+{
+	double r, total_slots;
+	bool header = false;
+
+#define PERF_DERIVED_HEADER()						\
+	do {								\
+		if (!header) {						\
+			pr_inf(stdout, "%26s derived metrics:\n", "");	\
+			header = true;					\
+		}							\
+	} while (0)
+
+	if (perf_ratio(totals, STRESS_PERF_HW_INSTRUCTIONS,
+	    STRESS_PERF_HW_CPU_CYCLES, &r)) {
+		PERF_DERIVED_HEADER();
+		perf_derived_metric(yaml, json, "Instructions Per Cycle",
+			"instructions-per-cycle", r, false);
+	}
+	if (perf_ratio(totals, STRESS_PERF_HW_STALLED_CYCLES_FRONTEND,
+	    STRESS_PERF_HW_CPU_CYCLES, &r)) {
+		PERF_DERIVED_HEADER();
+		perf_derived_metric(yaml, json, "Frontend Bound (stalls)",
+			"frontend-bound-stalls-percent", 100.0 * r, true);
+	}
+	if (perf_ratio(totals, STRESS_PERF_HW_STALLED_CYCLES_BACKEND,
+	    STRESS_PERF_HW_CPU_CYCLES, &r)) {
+		PERF_DERIVED_HEADER();
+		perf_derived_metric(yaml, json, "Backend Bound (stalls)",
+			"backend-bound-stalls-percent", 100.0 * r, true);
+	}
+	if (perf_ratio(totals, STRESS_PERF_HW_BRANCH_MISSES,
+	    STRESS_PERF_HW_BRANCH_INSTRUCTIONS, &r)) {
+		PERF_DERIVED_HEADER();
+		perf_derived_metric(yaml, json, "Branch Mispredict Rate",
+			"branch-mispredict-percent", 100.0 * r, true);
+	}
+	if (perf_ratio(totals, STRESS_PERF_HW_CACHE_MISSES,
+	    STRESS_PERF_HW_INSTRUCTIONS, &r)) {
+		PERF_DERIVED_HEADER();
+		perf_derived_metric(yaml, json, "LLC Misses Per K Instr.",
+			"llc-mpki", 1000.0 * r, false);
+	}
+
+	/* Level 1 top-down, needs all five slot events */
+	if ((totals[STRESS_PERF_TD_TOTAL_SLOTS] != STRESS_PERF_INVALID) &&
+	    (totals[STRESS_PERF_TD_TOTAL_SLOTS] > 0) &&
+	    (totals[STRESS_PERF_TD_SLOTS_ISSUED] != STRESS_PERF_INVALID) &&
+	    (totals[STRESS_PERF_TD_SLOTS_RETIRED] != STRESS_PERF_INVALID) &&
+	    (totals[STRESS_PERF_TD_FETCH_BUBBLES] != STRESS_PERF_INVALID) &&
+	    (totals[STRESS_PERF_TD_RECOVERY_BUBBLES] != STRESS_PERF_INVALID)) {
+		double frontend, bad_spec, retiring, backend;
+
+		total_slots = (double)totals[STRESS_PERF_TD_TOTAL_SLOTS];
+		frontend = (double)totals[STRESS_PERF_TD_FETCH_BUBBLES] / total_slots;
+		bad_spec = ((double)totals[STRESS_PERF_TD_SLOTS_ISSUED] -
+			    (double)totals[STRESS_PERF_TD_SLOTS_RETIRED] +
+			    (double)totals[STRESS_PERF_TD_RECOVERY_BUBBLES]) / total_slots;
+		retiring = (double)totals[STRESS_PERF_TD_SLOTS_RETIRED] / total_slots;
+		backend = 1.0 - (frontend + bad_spec + retiring);
+
+		/* Multiplexing can push the fractions slightly out of range */
+		if (bad_spec < 0.0)
+			bad_spec = 0.0;
+		if (backend < 0.0)
+			backend = 0.0;
+
+		PERF_DERIVED_HEADER();
+		perf_derived_metric(yaml, json, "Top-down Retiring",
+			"topdown-retiring-percent", 100.0 * retiring, true);
+		perf_derived_metric(yaml, json, "Top-down Bad Speculation",
+			"topdown-bad-speculation-percent", 100.0 * bad_spec, true);
+		perf_derived_metric(yaml, json, "Top-down Frontend Bound",
+			"topdown-frontend-bound-percent", 100.0 * frontend, true);
+		perf_derived_metric(yaml, json, "Top-down Backend Bound",
+			"topdown-backend-bound-percent", 100.0 * backend, true);
+	}
+#undef PERF_DERIVED_HEADER
+}
+
 void perf_stat_dump(
 	FILE *yaml,
+	json_t *json,
 	const stress_t stressors[],
 	const proc_info_t procs[STRESS_MAX],
-	const int32_t max_procs,
 	const double duration)
 {
 	int32_t i;
@@ -594,6 +1691,7 @@ void perf_stat_dump(
 	setlocale(LC_ALL, "");
 
 	pr_yaml(yaml, "perfstats:\n");
+	json_array_begin(json, "perfstats");
 
 	for (i = 0; i < STRESS_MAX; i++) {
 		int p;
@@ -601,16 +1699,21 @@ void perf_stat_dump(
 		uint64_t total_cpu_cycles = 0;
 		uint64_t total_cache_refs = 0;
 		uint64_t total_branches = 0;
+		uint64_t id_totals[STRESS_PERF_MAX];
 		int ids[STRESS_PERF_MAX];
 		bool got_data = false;
 		char *munged;
 
+		if (!procs[i].started_procs)
+			continue;
 		memset(counter_totals, 0, sizeof(counter_totals));
+		for (p = 0; p < STRESS_PERF_MAX; p++)
+			id_totals[p] = STRESS_PERF_INVALID;
 
 		/* Sum totals across all instances of the stressor */
 		for (p = 0; p < STRESS_PERF_MAX; p++) {
-			int32_t j, n = (i * max_procs);
-			stress_perf_t *sp = &shared->stats[n].sp;
+			int32_t j, n = procs[i].stats_index;
+			stress_perf_t *sp = &shared->perf_stats[n];
 
 			if (!perf_stat_succeeded(sp))
 				continue;
@@ -635,6 +1738,8 @@ void perf_stat_dump(
 				total_cache_refs = counter_totals[p];
 			if (ids[p] == STRESS_PERF_HW_BRANCH_INSTRUCTIONS)
 				total_branches = counter_totals[p];
+			if ((ids[p] >= 0) && (ids[p] < STRESS_PERF_MAX))
+				id_totals[ids[p]] = counter_totals[p];
 		}
 
 		if (!got_data)
@@ -644,6 +1749,9 @@ void perf_stat_dump(
 		pr_inf(stdout, "%s:\n", munged);
 		pr_yaml(yaml, "    - stressor: %s\n", munged);
 		pr_yaml(yaml, "      duration: %f\n", duration);
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_double(json, "duration", duration);
 
 		for (p = 0; p < STRESS_PERF_MAX; p++) {
 			const char *l = perf_get_label_by_index(p);
@@ -681,10 +1789,18 @@ void perf_stat_dump(
 					"\n", yaml_label, ct);
 				pr_yaml(yaml, "      %s_per_second: %f\n",
 					yaml_label, (double)ct / duration);
+
+				json_obj_begin(json, yaml_label);
+				json_uint(json, "total", ct);
+				json_double(json, "per-second", (double)ct / duration);
+				json_obj_end(json);
 			}
 		}
+		perf_stat_derived(yaml, json, id_totals);
 		pr_yaml(yaml, "\n");
+		json_obj_end(json);
 	}
+	json_array_end(json);
 	if (no_perf_stats) {
 		if (geteuid() != 0) {
 			char buffer[64];
@@ -710,4 +1826,1140 @@ void perf_stat_dump(
 		}
 	}
 }
+
+/* a contended lock merged across all the instances */
+typedef struct {
+	uint64_t addr;			/* kernel lock address */
+	uint32_t flags;			/* LCB_F_* flags */
+	uint64_t count;			/* samples across all stressors */
+	uint64_t top_count;		/* samples of the top stressor */
+	int32_t top;			/* stressor with the most samples */
+} perf_lock_total_t;
+
+/*
+ *  perf_lock_symbol()
+ *	resolve a lock address to the nearest kernel data
+ *	symbol, only statically allocated locks resolve
+ */
+static bool perf_lock_symbol(const uint64_t addr, char *buf, const size_t len)
+{
+	char line[256], best[128];
+	uint64_t best_addr = 0;
+	FILE *fp;
+
+	if ((fp = fopen("/proc/kallsyms", "r")) == NULL)
+		return false;
+	*best = '\0';
+	while (fgets(line, sizeof(line), fp)) {
+		unsigned long long sym_addr;
+		char type, name[128];
+
+		if (sscanf(line, "%llx %c %127s", &sym_addr, &type, name) != 3)
+			continue;
+		if (!strchr("dDbB", type))
+			continue;
+		if (((uint64_t)sym_addr <= addr) && ((uint64_t)sym_addr > best_addr)) {
+			best_addr = (uint64_t)sym_addr;
+			(void)snprintf(best, sizeof(best), "%s", name);
+		}
+	}
+	(void)fclose(fp);
+
+	/* Zeroed addresses (kptr_restrict) or a lock on the heap */
+	if (!best_addr || !*best || (addr - best_addr >= 4096))
+		return false;
+	if (addr == best_addr)
+		(void)snprintf(buf, len, "%s", best);
+	else
+		(void)snprintf(buf, len, "%s+0x%" PRIx64, best, addr - best_addr);
+	return true;
+}
+
+/*
+ *  perf_lock_total_cmp()
+ *	sort merged locks by descending samples
+ */
+static int perf_lock_total_cmp(const void *p1, const void *p2)
+{
+	const perf_lock_total_t *l1 = (const perf_lock_total_t *)p1;
+	const perf_lock_total_t *l2 = (const perf_lock_total_t *)p2;
+
+	if (l1->count < l2->count)
+		return 1;
+	if (l1->count > l2->count)
+		return -1;
+	return 0;
+}
+
+/*
+ *  perf_stressor_total()
+ *	sum a counter over the instances of a stressor
+ */
+static uint64_t perf_stressor_total(
+	const int32_t i,
+	const proc_info_t procs[STRESS_MAX],
+	const int id)
+{
+	uint64_t total = 0;
+	int32_t j;
+
+	for (j = 0; j < procs[i].started_procs; j++) {
+		const stress_perf_t *sp = &shared->perf_stats[procs[i].stats_index + j];
+		uint64_t counter;
+		int index;
+
+		if (!perf_stat_succeeded(sp) ||
+		    (perf_get_counter_by_id(sp, id, &counter, &index) < 0) ||
+		    (counter == STRESS_PERF_INVALID))
+			continue;
+		total += counter;
+	}
+	return total;
+}
+
+/*
+ *  perf_contention_dump()
+ *	report the kernel lock contention of each stressor,
+ *	busiest first, and the most contended kernel locks
+ *	across the run with the stressor that hit each most
+ */
+void perf_contention_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX],
+	const double duration)
+{
+	perf_lock_total_t *totals;
+	uint64_t *contentions, samples = 0, lost = 0;
+	int32_t *order;
+	size_t ntotals = 0, max_totals, k;
+	int32_t i, n = 0;
+
+	if (duration <= 0.0)
+		return;
+	if ((perf_lock_addr_offset < 0) || (perf_lock_flags_offset < 0)) {
+		pr_inf(stdout, "lock contention: lock:contention_begin trace "
+			"event is not available\n");
+		return;
+	}
+
+	max_totals = (size_t)shared->stats_slots * PERF_LOCK_SITES;
+	totals = calloc(max_totals, sizeof(*totals));
+	contentions = calloc(STRESS_MAX, sizeof(*contentions));
+	order = calloc(STRESS_MAX, sizeof(*order));
+	if (!totals || !contentions || !order)
+		goto out;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		int32_t j, m;
+
+		if (!procs[i].started_procs)
+			continue;
+		contentions[i] = perf_stressor_total(i, procs,
+			STRESS_PERF_TP_LOCK_CONTENTION_BEGIN);
+		if (contentions[i])
+			order[n++] = i;
+
+		for (j = 0; j < procs[i].started_procs; j++) {
+			const stress_perf_t *sp = &shared->perf_stats[procs[i].stats_index + j];
+
+			lost += sp->locks_lost;
+			for (k = 0; k < PERF_LOCK_SITES && sp->locks[k].count; k++) {
+				const perf_lock_t *lock = &sp->locks[k];
+				size_t t;
+
+				samples += lock->count;
+				for (t = 0; t < ntotals; t++)
+					if (totals[t].addr == lock->addr)
+						break;
+				if (t == ntotals) {
+					totals[t].addr = lock->addr;
+					totals[t].flags = lock->flags;
+					totals[t].top = -1;
+					ntotals++;
+				}
+				totals[t].count += lock->count;
+			}
+		}
+		/* Attribute each lock to the stressor that hit it most */
+		for (k = 0; k < ntotals; k++) {
+			uint64_t count = 0;
+
+			for (j = 0; j < procs[i].started_procs; j++) {
+				const stress_perf_t *sp = &shared->perf_stats[procs[i].stats_index + j];
+
+				for (m = 0; m < PERF_LOCK_SITES; m++)
+					if (sp->locks[m].count &&
+					    (sp->locks[m].addr == totals[k].addr))
+						count += sp->locks[m].count;
+			}
+			if (count > totals[k].top_count) {
+				totals[k].top_count = count;
+				totals[k].top = i;
+			}
+		}
+	}
+
+	/* Busiest stressors first, a simple insertion sort of few entries */
+	for (i = 1; i < n; i++) {
+		const int32_t tmp = order[i];
+		int32_t j = i;
+
+		for (; (j > 0) && (contentions[order[j - 1]] < contentions[tmp]); j--)
+			order[j] = order[j - 1];
+		order[j] = tmp;
+	}
+
+	pr_inf(stdout, "lock contention:\n");
+	pr_yaml(yaml, "lockcontention:\n");
+	pr_yaml(yaml, "  stressors:\n");
+	json_obj_begin(json, "lockcontention");
+	json_array_begin(json, "stressors");
+	pr_inf(stdout, "%-13s %14s %14s %16s\n", "stressor",
+		"contentions", "per second", "per 1K syscalls");
+	for (i = 0; i < n; i++) {
+		const int32_t s = order[i];
+		const uint64_t syscalls = perf_stressor_total(s, procs,
+			STRESS_PERF_TP_SYSCALLS_ENTER);
+		const double per_sec = (double)contentions[s] / duration;
+		const double per_ksys = syscalls ?
+			1000.0 * (double)contentions[s] / (double)syscalls : 0.0;
+		char *munged = munge_underscore(stressors[s].name);
+
+		pr_inf(stdout, "%-13s %14" PRIu64 " %14.2f %16.3f\n",
+			munged, contentions[s], per_sec, per_ksys);
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      contentions: %" PRIu64 "\n", contentions[s]);
+		pr_yaml(yaml, "      contentions-per-second: %f\n", per_sec);
+		pr_yaml(yaml, "      contentions-per-1k-syscalls: %f\n", per_ksys);
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_uint(json, "contentions", contentions[s]);
+		json_double(json, "contentions-per-second", per_sec);
+		json_double(json, "contentions-per-1k-syscalls", per_ksys);
+		json_obj_end(json);
+	}
+	json_array_end(json);
+	if (!n)
+		pr_inf(stdout, "%13s no kernel lock contention seen\n", "");
+
+	qsort(totals, ntotals, sizeof(*totals), perf_lock_total_cmp);
+	if (ntotals) {
+		pr_inf(stdout, "top contended kernel locks (%" PRIu64
+			" samples, %" PRIu64 " lost):\n", samples, lost);
+		pr_inf(stdout, "%-32s %-11s %7s %s\n", "lock", "type",
+			"share", "top stressor");
+	}
+	pr_yaml(yaml, "  toplocks:\n");
+	json_array_begin(json, "toplocks");
+	for (k = 0; (k < ntotals) && (k < PERF_LOCK_TOP); k++) {
+		const perf_lock_total_t *t = &totals[k];
+		const char *type = perf_lock_type(t->flags);
+		const double share = 100.0 * (double)t->count / (double)samples;
+		const char *top = (t->top >= 0) ?
+			munge_underscore(stressors[t->top].name) : "-";
+		char lock[64];
+
+		if (!perf_lock_symbol(t->addr, lock, sizeof(lock)))
+			(void)snprintf(lock, sizeof(lock), "0x%" PRIx64, t->addr);
+		pr_inf(stdout, "%-32s %-11s %6.2f%% %s\n", lock, type, share, top);
+		pr_yaml(yaml, "    - lock: %s\n", lock);
+		pr_yaml(yaml, "      type: %s\n", type);
+		pr_yaml(yaml, "      samples: %" PRIu64 "\n", t->count);
+		pr_yaml(yaml, "      top-stressor: %s\n", top);
+		json_obj_begin(json, NULL);
+		json_str(json, "lock", lock);
+		json_str(json, "type", type);
+		json_uint(json, "samples", t->count);
+		json_str(json, "top-stressor", top);
+		json_obj_end(json);
+	}
+	json_array_end(json);
+	json_obj_end(json);
+	pr_yaml(yaml, "\n");
+out:
+	free(order);
+	free(contentions);
+	free(totals);
+}
+
+/*
+ *  Sampling profiler, like the lock contention sampling each
+ *  stressor instance has an inherited cycles (or cpu-clock)
+ *  event and ring buffer per CPU. The call chains are counted
+ *  raw while the stressor runs and are only symbolised when
+ *  it stops, the instances then merge their folded stacks
+ *  into one file per stressor under an exclusive flock
+ */
+#define PERF_PROFILE_RING_PAGES		(64)	/* power of 2 */
+#define PERF_PROFILE_DRAIN_INTERVAL	(50)	/* milliseconds */
+#define PERF_PROFILE_FREQ		(999)	/* Hz, not in lockstep with HZ timers */
+#define PERF_PROFILE_DEPTH		(64)	/* frames kept per stack */
+#define PERF_PROFILE_STACKS		(8192)	/* distinct stacks, power of 2 */
+#define PERF_PROFILE_OBJS		(64)	/* mapped objects symbolised */
+
+/* a sampled call chain, leaf first */
+typedef struct {
+	uint64_t count;			/* samples, 0 = free slot */
+	uint64_t kernel;		/* bit n set = ips[n] is a kernel frame */
+	uint32_t depth;			/* frames in ips */
+	uint64_t ips[PERF_PROFILE_DEPTH];
+} perf_profile_stack_t;
+
+/* a function symbol */
+typedef struct {
+	uint64_t addr;			/* start address */
+	uint64_t size;			/* size, 0 = up to the next symbol */
+	const char *name;
+} perf_profile_sym_t;
+
+/* function symbols sorted by address */
+typedef struct {
+	perf_profile_sym_t *syms;
+	size_t nsyms;
+} perf_profile_symtab_t;
+
+/* an executable mapping of an object */
+typedef struct {
+	uint64_t start, end;		/* executable mapping */
+	uint64_t bias;			/* load bias of the object */
+	char path[PATH_MAX];
+	void *elf;			/* mmap'd object, names point into it */
+	size_t elf_size;
+	bool loaded;			/* symbols load attempted */
+	perf_profile_symtab_t symtab;
+} perf_profile_obj_t;
+
+/* a folded stack line */
+typedef struct {
+	char *stack;			/* frames, root first, ; separated */
+	uint64_t count;
+} perf_profile_folded_t;
+
+static pthread_t perf_profile_pthread;
+static pthread_mutex_t perf_profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t perf_profile_cond = PTHREAD_COND_INITIALIZER;
+static bool perf_profile_keep_draining;
+static bool perf_profile_pthread_running;
+static size_t perf_profile_mmap_size;
+static perf_lock_ring_t *perf_profile_rings;
+static int perf_profile_nrings;
+static perf_profile_stack_t *perf_profile_stacks;
+static uint64_t perf_profile_samples;
+static uint64_t perf_profile_dropped;	/* samples with no free stack slot */
+static uint64_t perf_profile_lost;	/* samples lost by the kernel */
+
+/* Set by the parent in perf_profile_init and inherited by the instances */
+static char perf_profile_dir[PATH_MAX];
+static uint32_t perf_profile_type = PERF_TYPE_HARDWARE;
+static uint64_t perf_profile_config = PERF_COUNT_HW_CPU_CYCLES;
+static bool perf_profile_exclude_kernel;
+static bool perf_profile_usable;
+static perf_profile_symtab_t perf_profile_kallsyms;
+static char *perf_profile_kallsyms_names;
+
+/*
+ *  perf_profile_attr()
+ *	fill in the sampling event attributes
+ */
+static void perf_profile_attr(struct perf_event_attr *attr)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->type = perf_profile_type;
+	attr->size = sizeof(*attr);
+	attr->config = perf_profile_config;
+	attr->freq = 1;
+	attr->sample_freq = PERF_PROFILE_FREQ;
+	attr->sample_type = PERF_SAMPLE_CALLCHAIN;
+	attr->exclude_kernel = perf_profile_exclude_kernel;
+	attr->exclude_hv = 1;
+	attr->exclude_guest = 1;
+}
+
+/*
+ *  perf_profile_sym_cmp()
+ *	sort symbols by address
+ */
+static int perf_profile_sym_cmp(const void *p1, const void *p2)
+{
+	const perf_profile_sym_t *s1 = (const perf_profile_sym_t *)p1;
+	const perf_profile_sym_t *s2 = (const perf_profile_sym_t *)p2;
+
+	if (s1->addr < s2->addr)
+		return -1;
+	if (s1->addr > s2->addr)
+		return 1;
+	return 0;
+}
+
+/*
+ *  perf_profile_sym_lookup()
+ *	find the symbol that holds addr, or NULL
+ */
+static const char *perf_profile_sym_lookup(
+	const perf_profile_symtab_t *symtab,
+	const uint64_t addr)
+{
+	size_t lo = 0, hi = symtab->nsyms;
+	const perf_profile_sym_t *sym;
+
+	if (!hi || (addr < symtab->syms[0].addr))
+		return NULL;
+	while (hi - lo > 1) {
+		const size_t mid = (lo + hi) / 2;
+
+		if (symtab->syms[mid].addr <= addr)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	sym = &symtab->syms[lo];
+	if (sym->size && (addr >= sym->addr + sym->size))
+		return NULL;
+	return sym->name;
+}
+
+/*
+ *  perf_profile_kallsyms_load()
+ *	load the kernel text symbols, they are not readable
+ *	(all zero) when kptr_restrict hides them
+ */
+static void perf_profile_kallsyms_load(void)
+{
+	FILE *fp;
+	char line[512];
+	size_t nsyms = 0, max = 0, names_len = 0, names_max = 0;
+	perf_profile_sym_t *syms = NULL;
+	char *names = NULL;
+
+	if ((fp = fopen("/proc/kallsyms", "r")) == NULL)
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		unsigned long long addr;
+		char type, name[256];
+		size_t len;
+
+		if (sscanf(line, "%llx %c %255s", &addr, &type, name) != 3)
+			continue;
+		if (!addr || !strchr("tT", type))
+			continue;
+		len = strlen(name) + 1;
+		if (nsyms == max) {
+			perf_profile_sym_t *tmp;
+
+			max = max ? max * 2 : 65536;
+			tmp = realloc(syms, max * sizeof(*syms));
+			if (!tmp)
+				goto err;
+			syms = tmp;
+		}
+		if (names_len + len > names_max) {
+			char *tmp;
+
+			names_max = names_max ? names_max * 2 : (1 << 21);
+			tmp = realloc(names, names_max);
+			if (!tmp)
+				goto err;
+			names = tmp;
+		}
+		(void)memcpy(names + names_len, name, len);
+		/* Names are offsets until the buffer stops moving */
+		syms[nsyms].addr = (uint64_t)addr;
+		syms[nsyms].size = 0;
+		syms[nsyms].name = (const char *)(uintptr_t)names_len;
+		names_len += len;
+		nsyms++;
+	}
+	(void)fclose(fp);
+	if (!nsyms) {
+		free(syms);
+		free(names);
+		return;
+	}
+	for (max = 0; max < nsyms; max++)
+		syms[max].name = names + (uintptr_t)syms[max].name;
+	qsort(syms, nsyms, sizeof(*syms), perf_profile_sym_cmp);
+	perf_profile_kallsyms.syms = syms;
+	perf_profile_kallsyms.nsyms = nsyms;
+	perf_profile_kallsyms_names = names;
+	return;
+err:
+	(void)fclose(fp);
+	free(syms);
+	free(names);
+}
+
+/*
+ *  perf_profile_elf_load()
+ *	load the function symbols of an ELF object from its
+ *	symbol table, or its dynamic symbol table if stripped
+ */
+static void perf_profile_elf_load(perf_profile_obj_t *obj)
+{
+	const ElfW(Ehdr) *ehdr;
+	const ElfW(Shdr) *shdrs;
+	const ElfW(Shdr) *symsh = NULL;
+	struct stat statbuf;
+	size_t i, n, nsyms = 0;
+	uint8_t *elf;
+	int fd;
+
+	obj->loaded = true;
+	if ((fd = open(obj->path, O_RDONLY)) < 0)
+		return;
+	if ((fstat(fd, &statbuf) < 0) || ((size_t)statbuf.st_size < sizeof(*ehdr))) {
+		(void)close(fd);
+		return;
+	}
+	elf = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+	if (elf == MAP_FAILED)
+		return;
+	obj->elf = elf;
+	obj->elf_size = (size_t)statbuf.st_size;
+
+	ehdr = (const ElfW(Ehdr) *)elf;
+	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+	    (ehdr->e_ident[EI_CLASS] != ((sizeof(void *) == 8) ? ELFCLASS64 : ELFCLASS32)) ||
+	    (ehdr->e_shoff + (uint64_t)ehdr->e_shnum * sizeof(*shdrs) > obj->elf_size))
+		return;
+	/* Fixed address executables are not relocated */
+	if (ehdr->e_type == ET_EXEC)
+		obj->bias = 0;
+	shdrs = (const ElfW(Shdr) *)(elf + ehdr->e_shoff);
+	for (i = 0; i < ehdr->e_shnum; i++) {
+		if (shdrs[i].sh_type == SHT_SYMTAB)
+			symsh = &shdrs[i];
+		else if ((shdrs[i].sh_type == SHT_DYNSYM) && !symsh)
+			symsh = &shdrs[i];
+	}
+	if (!symsh || (symsh->sh_link >= ehdr->e_shnum) ||
+	    (symsh->sh_offset + symsh->sh_size > obj->elf_size) ||
+	    (shdrs[symsh->sh_link].sh_offset + shdrs[symsh->sh_link].sh_size > obj->elf_size))
+		return;
+
+	n = symsh->sh_size / sizeof(ElfW(Sym));
+	obj->symtab.syms = calloc(n, sizeof(*obj->symtab.syms));
+	if (!obj->symtab.syms)
+		return;
+	for (i = 0; i < n; i++) {
+		const ElfW(Sym) *sym = (const ElfW(Sym) *)(elf + symsh->sh_offset) + i;
+		const ElfW(Shdr) *strsh = &shdrs[symsh->sh_link];
+
+		if ((ELF64_ST_TYPE(sym->st_info) != STT_FUNC) ||
+		    (sym->st_shndx == SHN_UNDEF) || !sym->st_value ||
+		    (sym->st_name >= strsh->sh_size))
+			continue;
+		obj->symtab.syms[nsyms].addr = (uint64_t)sym->st_value;
+		obj->symtab.syms[nsyms].size = (uint64_t)sym->st_size;
+		obj->symtab.syms[nsyms].name = (const char *)elf + strsh->sh_offset + sym->st_name;
+		nsyms++;
+	}
+	obj->symtab.nsyms = nsyms;
+	qsort(obj->symtab.syms, nsyms, sizeof(*obj->symtab.syms), perf_profile_sym_cmp);
+}
+
+/*
+ *  perf_profile_objs()
+ *	find the executable mappings of this process, the bias
+ *	of an object is the start of its first mapping
+ */
+static size_t perf_profile_objs(perf_profile_obj_t *objs)
+{
+	FILE *fp;
+	char line[PATH_MAX + 128];
+	size_t n = 0;
+	uint64_t base = 0;
+	char base_path[PATH_MAX] = "";
+
+	if ((fp = fopen("/proc/self/maps", "r")) == NULL)
+		return 0;
+	while ((n < PERF_PROFILE_OBJS) && fgets(line, sizeof(line), fp)) {
+		unsigned long long start, end, offset;
+		char perms[8], path[PATH_MAX];
+
+		*path = '\0';
+		if (sscanf(line, "%llx-%llx %7s %llx %*s %*s %4095s",
+			   &start, &end, perms, &offset, path) < 4)
+			continue;
+		if (*path != '/')
+			continue;
+		if (strcmp(path, base_path)) {
+			(void)snprintf(base_path, sizeof(base_path), "%s", path);
+			base = (uint64_t)(start - offset);
+		}
+		if (perms[2] != 'x')
+			continue;
+		memset(&objs[n], 0, sizeof(objs[n]));
+		objs[n].start = (uint64_t)start;
+		objs[n].end = (uint64_t)end;
+		objs[n].bias = base;
+		(void)snprintf(objs[n].path, sizeof(objs[n].path), "%s", path);
+		n++;
+	}
+	(void)fclose(fp);
+	return n;
+}
+
+/*
+ *  perf_profile_frame()
+ *	symbolise a frame, kernel frames get the _[k] suffix
+ *	that flame graph tools colour as kernel code
+ */
+static void perf_profile_frame(
+	perf_profile_obj_t *objs,
+	const size_t nobjs,
+	const uint64_t ip,
+	const bool kernel,
+	char *buf,
+	const size_t len)
+{
+	const char *name;
+	size_t i;
+
+	if (kernel) {
+		name = perf_profile_sym_lookup(&perf_profile_kallsyms, ip);
+		(void)snprintf(buf, len, "%s_[k]", name ? name : "[kernel]");
+		return;
+	}
+	for (i = 0; i < nobjs; i++) {
+		perf_profile_obj_t *obj = &objs[i];
+		const char *base;
+
+		if ((ip < obj->start) || (ip >= obj->end))
+			continue;
+		if (!obj->loaded)
+			perf_profile_elf_load(obj);
+		name = perf_profile_sym_lookup(&obj->symtab, ip - obj->bias);
+		if (name) {
+			(void)snprintf(buf, len, "%s", name);
+			return;
+		}
+		base = strrchr(obj->path, '/');
+		(void)snprintf(buf, len, "[%s]", base ? base + 1 : obj->path);
+		return;
+	}
+	(void)snprintf(buf, len, "[unknown]");
+}
+
+/*
+ *  perf_profile_hash()
+ *	FNV-1a hash of a string
+ */
+static uint32_t perf_profile_hash(const char *str)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*str) {
+		hash ^= (uint8_t)*str++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/*
+ *  perf_profile_fold()
+ *	add count samples of a folded stack to a table of
+ *	size entries (a power of 2), returns false if full
+ */
+static bool perf_profile_fold(
+	perf_profile_folded_t *folded,
+	const size_t size,
+	const char *stack,
+	const uint64_t count)
+{
+	size_t i, probe;
+
+	i = perf_profile_hash(stack) & (size - 1);
+	for (probe = 0; probe < size; probe++, i = (i + 1) & (size - 1)) {
+		if (!folded[i].stack) {
+			folded[i].stack = strdup(stack);
+			if (!folded[i].stack)
+				return false;
+			folded[i].count = count;
+			return true;
+		}
+		if (!strcmp(folded[i].stack, stack)) {
+			folded[i].count += count;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ *  perf_profile_account()
+ *	count a sampled call chain
+ */
+static void perf_profile_account(
+	const uint64_t *ips,
+	const uint64_t nr)
+{
+	perf_profile_stack_t stack;
+	uint32_t hash = 2166136261U;
+	bool kernel = false;
+	size_t i, probe;
+	uint64_t j;
+
+	memset(&stack, 0, sizeof(stack));
+	for (j = 0; (j < nr) && (stack.depth < PERF_PROFILE_DEPTH); j++) {
+		const uint64_t ip = ips[j];
+
+		/* Context markers say which side the frames that follow are on */
+		if (ip >= (uint64_t)PERF_CONTEXT_MAX) {
+			kernel = (ip == (uint64_t)PERF_CONTEXT_KERNEL);
+			continue;
+		}
+		if (kernel)
+			stack.kernel |= 1ULL << stack.depth;
+		stack.ips[stack.depth++] = ip;
+		hash = (hash ^ (uint32_t)(ip ^ (ip >> 32))) * 16777619U;
+	}
+	if (!stack.depth)
+		return;
+	perf_profile_samples++;
+
+	i = hash & (PERF_PROFILE_STACKS - 1);
+	for (probe = 0; probe < PERF_PROFILE_STACKS; probe++, i = (i + 1) & (PERF_PROFILE_STACKS - 1)) {
+		perf_profile_stack_t *s = &perf_profile_stacks[i];
+
+		if (!s->count) {
+			*s = stack;
+			s->count = 1;
+			return;
+		}
+		if ((s->depth == stack.depth) && (s->kernel == stack.kernel) &&
+		    !memcmp(s->ips, stack.ips, stack.depth * sizeof(stack.ips[0]))) {
+			s->count++;
+			return;
+		}
+	}
+	perf_profile_dropped++;
+}
+
+/*
+ *  perf_profile_drain_ring()
+ *	consume the samples in a ring buffer
+ */
+static void perf_profile_drain_ring(struct perf_event_mmap_page *meta)
+{
+	const size_t data_size = perf_profile_mmap_size - (size_t)getpagesize();
+	uint8_t *data = (uint8_t *)meta + getpagesize();
+	uint64_t head, tail;
+
+	head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+	tail = meta->data_tail;
+
+	while (tail < head) {
+		uint64_t record[256];
+		struct perf_event_header hdr;
+		size_t i, size;
+
+		for (i = 0; i < sizeof(hdr); i++)
+			((uint8_t *)&hdr)[i] = data[(tail + i) % data_size];
+		if (hdr.size < sizeof(hdr))
+			break;
+		size = (hdr.size < sizeof(record)) ? hdr.size : sizeof(record);
+		for (i = 0; i < size; i++)
+			((uint8_t *)record)[i] = data[(tail + i) % data_size];
+		tail += hdr.size;
+
+		if (hdr.type == PERF_RECORD_SAMPLE) {
+			/* PERF_SAMPLE_CALLCHAIN, u64 nr then nr ips */
+			const uint64_t *ips = (const uint64_t *)((uint8_t *)record + sizeof(hdr));
+			const uint64_t max = (size - sizeof(hdr)) / sizeof(uint64_t) - 1;
+			uint64_t nr;
+
+			if (size < sizeof(hdr) + sizeof(uint64_t))
+				continue;
+			nr = ips[0];
+			perf_profile_account(ips + 1, (nr < max) ? nr : max);
+		} else if (hdr.type == PERF_RECORD_LOST) {
+			/* u64 id then u64 lost */
+			if (size >= sizeof(hdr) + 2 * sizeof(uint64_t))
+				perf_profile_lost += record[2];
+		}
+	}
+	__atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+/*
+ *  perf_profile_drain()
+ *	consume the samples of all the CPUs
+ */
+static void perf_profile_drain(void)
+{
+	int i;
+
+	for (i = 0; i < perf_profile_nrings; i++)
+		perf_profile_drain_ring(perf_profile_rings[i].meta);
+}
+
+/*
+ *  perf_profile_close()
+ *	unmap and close the per CPU rings
+ */
+static void perf_profile_close(void)
+{
+	int i;
+
+	for (i = 0; i < perf_profile_nrings; i++) {
+		(void)ioctl(perf_profile_rings[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+		(void)munmap((void *)perf_profile_rings[i].meta, perf_profile_mmap_size);
+		(void)close(perf_profile_rings[i].fd);
+	}
+	free(perf_profile_rings);
+	perf_profile_rings = NULL;
+	perf_profile_nrings = 0;
+}
+
+/*
+ *  perf_profile_thread()
+ *	drain the call chain samples until told to stop
+ */
+static void *perf_profile_thread(void *arg)
+{
+	static void *nowt = NULL;
+	struct timespec abstime;
+
+	(void)arg;
+
+	(void)clock_gettime(CLOCK_REALTIME, &abstime);
+
+	pthread_mutex_lock(&perf_profile_mutex);
+	while (perf_profile_keep_draining) {
+		abstime.tv_nsec += PERF_PROFILE_DRAIN_INTERVAL * 1000000;
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_nsec -= 1000000000;
+			abstime.tv_sec++;
+		}
+		while (perf_profile_keep_draining &&
+		       (pthread_cond_timedwait(&perf_profile_cond, &perf_profile_mutex, &abstime) == 0))
+			;
+		perf_profile_drain();
+	}
+	pthread_mutex_unlock(&perf_profile_mutex);
+
+	return &nowt;
+}
+
+/*
+ *  perf_profile_path()
+ *	folded stacks file of a stressor
+ */
+static void perf_profile_path(const char *name, char *path, const size_t len)
+{
+	(void)snprintf(path, len, "%s/%s-%s.folded",
+		perf_profile_dir, app_name, name);
+}
+
+/*
+ *  perf_profile_init()
+ *	pick the sampling event, cycles if there is a PMU and
+ *	the cpu-clock otherwise, check if kernel stacks are
+ *	permitted and load the kernel symbols. Called once by
+ *	the parent, the instances inherit the settings
+ */
+void perf_profile_init(const stress_t stressors[], const proc_info_t procs[STRESS_MAX])
+{
+	struct perf_event_attr attr;
+	int32_t i;
+	int fd;
+
+	if (!getcwd(perf_profile_dir, sizeof(perf_profile_dir))) {
+		pr_inf(stderr, "profile: cannot get the current directory, "
+			"errno=%d (%s)\n", errno, strerror(errno));
+		return;
+	}
+
+	for (;;) {
+		perf_profile_attr(&attr);
+		fd = sys_perf_event_open(&attr, 0, -1, -1, 0);
+		if (fd >= 0)
+			break;
+		if (((errno == EACCES) || (errno == EPERM)) && !perf_profile_exclude_kernel) {
+			perf_profile_exclude_kernel = true;
+			continue;
+		}
+		if (perf_profile_type == PERF_TYPE_HARDWARE) {
+			perf_profile_type = PERF_TYPE_SOFTWARE;
+			perf_profile_config = PERF_COUNT_SW_CPU_CLOCK;
+			perf_profile_exclude_kernel = false;
+			continue;
+		}
+		pr_inf(stderr, "profile: cannot open a sampling perf event, "
+			"errno=%d (%s)\n", errno, strerror(errno));
+		return;
+	}
+	(void)close(fd);
+
+	if (!perf_profile_exclude_kernel)
+		perf_profile_kallsyms_load();
+	pr_dbg(stderr, "profile: sampling %s at %d Hz, %s\n",
+		(perf_profile_type == PERF_TYPE_HARDWARE) ? "cycles" : "cpu-clock",
+		PERF_PROFILE_FREQ, perf_profile_exclude_kernel ?
+			"user stacks only" : (perf_profile_kallsyms.nsyms ?
+			"with kernel stacks" : "with unresolved kernel stacks"));
+
+	/* Stacks of an earlier run would be merged in */
+	for (i = 0; i < STRESS_MAX; i++) {
+		char path[PATH_MAX + 64];
+
+		if (!procs[i].num_procs)
+			continue;
+		perf_profile_path(munge_underscore(stressors[i].name), path, sizeof(path));
+		(void)unlink(path);
+	}
+	perf_profile_usable = true;
+}
+
+/*
+ *  perf_profile_start()
+ *	sample the call chains of this stressor instance and
+ *	its children
+ */
+void perf_profile_start(void)
+{
+	struct perf_event_attr attr;
+	sigset_t set, oldset;
+	long cpu, ncpus;
+	int ret;
+
+	if (!perf_profile_usable)
+		return;
+
+	perf_profile_attr(&attr);
+	attr.inherit = 1;
+
+	ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (ncpus < 1)
+		return;
+	perf_profile_stacks = calloc(PERF_PROFILE_STACKS, sizeof(*perf_profile_stacks));
+	perf_profile_rings = calloc((size_t)ncpus, sizeof(*perf_profile_rings));
+	if (!perf_profile_stacks || !perf_profile_rings)
+		goto err_free;
+	perf_profile_mmap_size = (size_t)(1 + PERF_PROFILE_RING_PAGES) * getpagesize();
+	for (cpu = 0; cpu < ncpus; cpu++) {
+		perf_lock_ring_t *ring = &perf_profile_rings[perf_profile_nrings];
+
+		/* Offline CPUs just fail to open */
+		ring->fd = sys_perf_event_open(&attr, 0, (int)cpu, -1, 0);
+		if (ring->fd < 0)
+			continue;
+		ring->meta = mmap(NULL, perf_profile_mmap_size,
+			PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+		if (ring->meta == MAP_FAILED) {
+			pr_dbg(stderr, "profile: cannot mmap samples: "
+				"errno=%d (%s)\n", errno, strerror(errno));
+			(void)close(ring->fd);
+			continue;
+		}
+		perf_profile_nrings++;
+	}
+	if (!perf_profile_nrings) {
+		pr_dbg(stderr, "profile: cannot sample call chains\n");
+		goto err_free;
+	}
+	perf_profile_keep_draining = true;
+
+	/* Leave all signal handling to the stressor, the thread inherits the mask */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, &oldset);
+	ret = pthread_create(&perf_profile_pthread, NULL, perf_profile_thread, NULL);
+	(void)pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	if (ret) {
+		pr_dbg(stderr, "profile: cannot create sampling thread: "
+			"errno=%d (%s)\n", ret, strerror(ret));
+		perf_profile_close();
+		goto err_free;
+	}
+	perf_profile_pthread_running = true;
+	return;
+
+err_free:
+	free(perf_profile_rings);
+	perf_profile_rings = NULL;
+	free(perf_profile_stacks);
+	perf_profile_stacks = NULL;
+}
+
+/*
+ *  perf_profile_stop()
+ *	stop sampling, symbolise the call chains and merge
+ *	them into the folded stacks file of the stressor
+ */
+void perf_profile_stop(const char *name)
+{
+	perf_profile_obj_t *objs = NULL;
+	perf_profile_folded_t *folded = NULL;
+	const size_t folded_size = PERF_PROFILE_STACKS * 4;
+	size_t nobjs = 0, i;
+	char path[PATH_MAX + 64], *buf = NULL;
+	const size_t buf_len = PERF_PROFILE_DEPTH * 256;
+	uint64_t unmerged = 0;
+	FILE *fp;
+	int fd;
+
+	if (!perf_profile_pthread_running)
+		return;
+
+	pthread_mutex_lock(&perf_profile_mutex);
+	perf_profile_keep_draining = false;
+	pthread_cond_signal(&perf_profile_cond);
+	pthread_mutex_unlock(&perf_profile_mutex);
+	(void)pthread_join(perf_profile_pthread, NULL);
+	perf_profile_pthread_running = false;
+
+	perf_profile_drain();
+	perf_profile_close();
+	if (perf_profile_lost || perf_profile_dropped)
+		pr_dbg(stderr, "profile: %s: %" PRIu64 " samples lost, %" PRIu64
+			" dropped, more than %d distinct stacks\n", name,
+			perf_profile_lost, perf_profile_dropped, PERF_PROFILE_STACKS);
+	if (!perf_profile_samples)
+		goto out;
+
+	objs = calloc(PERF_PROFILE_OBJS, sizeof(*objs));
+	folded = calloc(folded_size, sizeof(*folded));
+	buf = malloc(buf_len);
+	if (!objs || !folded || !buf)
+		goto out;
+	nobjs = perf_profile_objs(objs);
+
+	/* Root first, the stressor is the root frame like the comm in perf script */
+	for (i = 0; i < PERF_PROFILE_STACKS; i++) {
+		const perf_profile_stack_t *s = &perf_profile_stacks[i];
+		size_t used;
+		int32_t j;
+
+		if (!s->count)
+			continue;
+		used = (size_t)snprintf(buf, buf_len, "%s", name);
+		for (j = (int32_t)s->depth - 1; (j >= 0) && (used < buf_len); j--) {
+			/* Room for an unsymbolised frame, the bracketed object path */
+			char frame[PATH_MAX + 8];
+
+			perf_profile_frame(objs, nobjs, s->ips[j],
+				!!(s->kernel & (1ULL << j)), frame, sizeof(frame));
+			/* ; and spaces are the folded format separators */
+			frame[strcspn(frame, "; ")] = '\0';
+			used += (size_t)snprintf(buf + used, buf_len - used, ";%s", frame);
+		}
+		if (!perf_profile_fold(folded, folded_size, buf, s->count))
+			unmerged += s->count;
+	}
+
+	/* Other instances of the stressor merge into the same file */
+	perf_profile_path(name, path, sizeof(path));
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		pr_inf(stderr, "profile: cannot open %s, errno=%d (%s)\n",
+			path, errno, strerror(errno));
+		goto out;
+	}
+	(void)flock(fd, LOCK_EX);
+	fp = fdopen(fd, "r+");
+	if (!fp) {
+		(void)close(fd);
+		goto out;
+	}
+	while (fgets(buf, (int)buf_len, fp)) {
+		char *count = strrchr(buf, ' ');
+
+		if (!count)
+			continue;
+		*count++ = '\0';
+		if (!perf_profile_fold(folded, folded_size, buf, strtoull(count, NULL, 10)))
+			unmerged += strtoull(count, NULL, 10);
+	}
+	rewind(fp);
+	if (ftruncate(fd, 0) < 0)
+		pr_dbg(stderr, "profile: cannot truncate %s, errno=%d (%s)\n",
+			path, errno, strerror(errno));
+	for (i = 0; i < folded_size; i++)
+		if (folded[i].stack)
+			fprintf(fp, "%s %" PRIu64 "\n", folded[i].stack, folded[i].count);
+	if (unmerged)
+		pr_dbg(stderr, "profile: %s: %" PRIu64 " samples not written, "
+			"too many distinct stacks\n", name, unmerged);
+	(void)fclose(fp);
+out:
+	if (folded) {
+		for (i = 0; i < folded_size; i++)
+			free(folded[i].stack);
+		free(folded);
+	}
+	for (i = 0; i < nobjs; i++) {
+		free(objs[i].symtab.syms);
+		if (objs[i].elf)
+			(void)munmap(objs[i].elf, objs[i].elf_size);
+	}
+	free(objs);
+	free(buf);
+	free(perf_profile_stacks);
+	perf_profile_stacks = NULL;
+}
+
+/*
+ *  perf_profile_dump()
+ *	report the folded stacks file of each stressor
+ */
+void perf_profile_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+	bool header = false;
+
+	if (!perf_profile_usable)
+		return;
+
+	pr_yaml(yaml, "profile:\n");
+	json_array_begin(json, "profile");
+	for (i = 0; i < STRESS_MAX; i++) {
+		const char *munged;
+		char path[PATH_MAX + 64], line[4096];
+		uint64_t samples = 0, stacks = 0;
+		FILE *fp;
+
+		if (!procs[i].started_procs)
+			continue;
+		munged = munge_underscore(stressors[i].name);
+		perf_profile_path(munged, path, sizeof(path));
+		if ((fp = fopen(path, "r")) == NULL)
+			continue;
+		while (fgets(line, sizeof(line), fp)) {
+			const char *count = strrchr(line, ' ');
+
+			if (count) {
+				samples += strtoull(count + 1, NULL, 10);
+				stacks++;
+			}
+		}
+		(void)fclose(fp);
+
+		if (!header) {
+			pr_inf(stdout, "%-13s %10s %8s %s\n",
+				"profile", "samples", "stacks", "folded stacks");
+			header = true;
+		}
+		pr_inf(stdout, "%-13s %10" PRIu64 " %8" PRIu64 " %s\n",
+			munged, samples, stacks, path);
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      samples: %" PRIu64 "\n", samples);
+		pr_yaml(yaml, "      stacks: %" PRIu64 "\n", stacks);
+		pr_yaml(yaml, "      folded-stacks: %s\n", path);
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_uint(json, "samples", samples);
+		json_uint(json, "stacks", stacks);
+		json_str(json, "folded-stacks", path);
+		json_obj_end(json);
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+}
 #endif
@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+static const char *option = "pin";
+
+#if defined(__linux__) && NEED_GLIBC(2,3,0)
+
+#include <sched.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+typedef enum {
+	PIN_NONE = 0,
+	PIN_CORE,	/* one CPU of each physical core */
+	PIN_THREAD,	/* each CPU, SMT siblings next to each other */
+	PIN_LLC,	/* all the CPUs sharing a last level cache */
+} pin_t;
+
+static pin_t opt_pin = PIN_NONE;
+static cpu_set_t *pin_sets;	/* CPUs of each pinning slot */
+static uint32_t pin_sets_count;
+
+/*
+ *  pin_cmp()
+ *	order CPUs by last level cache (for PIN_LLC only),
+ *	package, core and then CPU number
+ */
+static int pin_cmp(const void *p1, const void *p2)
+{
+	const cpu_t *c1 = *(const cpu_t * const *)p1;
+	const cpu_t *c2 = *(const cpu_t * const *)p2;
+
+	if ((opt_pin == PIN_LLC) && (c1->llc_id != c2->llc_id))
+		return c1->llc_id - c2->llc_id;
+	if (c1->package_id != c2->package_id)
+		return c1->package_id - c2->package_id;
+	if (c1->core_id != c2->core_id)
+		return c1->core_id - c2->core_id;
+	return c1->id - c2->id;
+}
+
+/*
+ *  stress_set_pin()
+ *	set the per instance CPU pinning policy
+ */
+int stress_set_pin(const char *name)
+{
+	if (!strcmp(name, "core"))
+		opt_pin = PIN_CORE;
+	else if (!strcmp(name, "thread"))
+		opt_pin = PIN_THREAD;
+	else if (!strcmp(name, "llc"))
+		opt_pin = PIN_LLC;
+	else {
+		fprintf(stderr, "%s must be one of: core thread llc\n", option);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_pin_init()
+ *	build the pinning slots from the sysfs CPU topology, only
+ *	CPUs allowed by --taskset are used. Called once by the parent
+ *	so all the instances and the YAML use the same map
+ */
+void stress_pin_init(void)
+{
+	cpu_set_t allowed;
+	cpus_t *cpus;
+	const cpu_t **sorted;
+	uint32_t i, n = 0;
+
+	if (opt_pin == PIN_NONE)
+		return;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_inf(stderr, "%s: cannot get CPU affinity, errno=%d (%s), "
+			"instances will not be pinned\n", option,
+			errno, strerror(errno));
+		goto disable;
+	}
+	cpus = get_all_cpu_cache_details();
+	if (!cpus) {
+		pr_inf(stderr, "%s: cannot read the CPU topology, "
+			"instances will not be pinned\n", option);
+		goto disable;
+	}
+	sorted = calloc(cpus->count, sizeof(*sorted));
+	pin_sets = calloc(cpus->count, sizeof(*pin_sets));
+	if (!sorted || !pin_sets) {
+		pr_inf(stderr, "%s: out of memory, instances will "
+			"not be pinned\n", option);
+		free(sorted);
+		free(pin_sets);
+		pin_sets = NULL;
+		free_cpu_caches(cpus);
+		goto disable;
+	}
+
+	for (i = 0; i < cpus->count; i++) {
+		const cpu_t *cpu = &cpus->cpus[i];
+
+		if (cpu->online && (cpu->id < CPU_SETSIZE) &&
+		    CPU_ISSET(cpu->id, &allowed))
+			sorted[n++] = cpu;
+	}
+	qsort(sorted, n, sizeof(*sorted), pin_cmp);
+
+	pin_sets_count = 0;
+	for (i = 0; i < n; i++) {
+		const cpu_t *cpu = sorted[i], *prev = i ? sorted[i - 1] : NULL;
+		bool new_slot;
+
+		switch (opt_pin) {
+		case PIN_CORE:
+			/* First thread of each core, the siblings stay idle */
+			if (prev && (cpu->package_id == prev->package_id) &&
+			    (cpu->core_id == prev->core_id) && (cpu->core_id >= 0))
+				continue;
+			new_slot = true;
+			break;
+		case PIN_LLC:
+			new_slot = !prev || (cpu->llc_id != prev->llc_id) ||
+				   (cpu->llc_id < 0);
+			break;
+		default:
+			new_slot = true;
+			break;
+		}
+		if (new_slot)
+			CPU_ZERO(&pin_sets[pin_sets_count++]);
+		CPU_SET(cpu->id, &pin_sets[pin_sets_count - 1]);
+	}
+	free(sorted);
+	free_cpu_caches(cpus);
+
+	if (!pin_sets_count) {
+		pr_inf(stderr, "%s: no usable CPUs found, instances will "
+			"not be pinned\n", option);
+		free(pin_sets);
+		pin_sets = NULL;
+		goto disable;
+	}
+	pr_dbg(stderr, "%s: %" PRIu32 " pinning slot%s\n", option,
+		pin_sets_count, pin_sets_count == 1 ? "" : "s");
+	return;
+
+disable:
+	opt_pin = PIN_NONE;
+}
+
+/*
+ *  stress_pin_cpulist()
+ *	format the CPUs instance is pinned to as a cpulist,
+ *	e.g. "0" or "0-3,8-11", NULL if pinning is not enabled
+ */
+static char *stress_pin_cpulist(
+	const uint32_t instance,
+	char *buf,
+	const size_t len)
+{
+	const cpu_set_t *set;
+	size_t n = 0;
+	int cpu;
+
+	if ((opt_pin == PIN_NONE) || !len)
+		return NULL;
+	set = &pin_sets[instance % pin_sets_count];
+
+	*buf = '\0';
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		int hi;
+
+		if (!CPU_ISSET(cpu, set))
+			continue;
+		for (hi = cpu; (hi + 1 < CPU_SETSIZE) && CPU_ISSET(hi + 1, set); hi++)
+			;
+		if (hi == cpu)
+			n += snprintf(buf + n, len - n, "%s%d", n ? "," : "", cpu);
+		else
+			n += snprintf(buf + n, len - n, "%s%d-%d", n ? "," : "", cpu, hi);
+		if (n >= len)
+			break;
+		cpu = hi;
+	}
+	return buf;
+}
+
+/*
+ *  stress_pin()
+ *	pin the calling stressor instance to its slot, instance j
+ *	of every stressor uses the j'th slot, wrapping around if
+ *	there are more instances than slots
+ */
+void stress_pin(const char *name, const uint32_t instance)
+{
+	char buf[256];
+
+	if (opt_pin == PIN_NONE)
+		return;
+	if (sched_setaffinity(0, sizeof(cpu_set_t),
+			      &pin_sets[instance % pin_sets_count]) < 0) {
+		pr_dbg(stderr, "%s: cannot pin to CPUs %s, errno=%d (%s)\n",
+			name, stress_pin_cpulist(instance, buf, sizeof(buf)),
+			errno, strerror(errno));
+		return;
+	}
+	pr_dbg(stderr, "%s: pinned to CPUs %s\n", name,
+		stress_pin_cpulist(instance, buf, sizeof(buf)));
+}
+
+/*
+ *  stress_pin_dump()
+ *	output the CPUs each stressor instance was pinned to
+ */
+void stress_pin_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+
+	if (opt_pin == PIN_NONE)
+		return;
+
+	pr_yaml(yaml, "pinning:\n");
+	json_array_begin(json, "pinning");
+	for (i = 0; i < STRESS_MAX; i++) {
+		int32_t j;
+		const char *munged;
+
+		if (!procs[i].started_procs)
+			continue;
+		munged = munge_underscore(stressors[i].name);
+		for (j = 0; j < procs[i].started_procs; j++) {
+			char buf[256];
+
+			(void)stress_pin_cpulist(j, buf, sizeof(buf));
+			pr_yaml(yaml, "    - stressor: %s\n", munged);
+			pr_yaml(yaml, "      instance: %" PRId32 "\n", j);
+			pr_yaml(yaml, "      cpus: %s\n", buf);
+
+			json_obj_begin(json, NULL);
+			json_str(json, "stressor", munged);
+			json_int(json, "instance", j);
+			json_str(json, "cpus", buf);
+			json_obj_end(json);
+		}
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+}
+
+#else
+int stress_set_pin(const char *name)
+{
+	(void)name;
+
+	fprintf(stderr, "%s: CPU pinning not supported\n", option);
+	return -1;
+}
+
+void stress_pin_init(void)
+{
+}
+
+void stress_pin(const char *name, const uint32_t instance)
+{
+	(void)name;
+	(void)instance;
+}
+
+void stress_pin_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	(void)yaml;
+	(void)json;
+	(void)stressors;
+	(void)procs;
+}
+#endif
@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+
+#define PSI_SAMPLE_INTERVAL	(500)	/* ms between samples of avg10 */
+
+static const char *psi_resources[] = { "cpu", "memory", "io" };
+
+#define PSI_RESOURCES	SIZEOF_ARRAY(psi_resources)
+
+/* One some or full line of a pressure file */
+typedef struct {
+	double avg10;			/* % stalled over the last 10s */
+	double avg60;			/* % stalled over the last 60s */
+	uint64_t total;			/* stall time, usec */
+	bool valid;			/* line was found */
+} psi_line_t;
+
+/* The some and full lines of a resource */
+typedef struct {
+	psi_line_t some;		/* at least one task stalled */
+	psi_line_t full;		/* all non-idle tasks stalled */
+} psi_t;
+
+/* System pressure charged to a stressor over the phases it ran in */
+typedef struct {
+	double secs;			/* time the stressor's phases ran */
+	uint64_t some_usec[PSI_RESOURCES]; /* some stall time */
+	uint64_t full_usec[PSI_RESOURCES]; /* full stall time */
+	double some_avg10[PSI_RESOURCES]; /* highest some avg10 sampled */
+	double full_avg10[PSI_RESOURCES]; /* highest full avg10 sampled */
+	double some_avg60[PSI_RESOURCES]; /* highest some avg60 at a phase end */
+	double full_avg60[PSI_RESOURCES]; /* highest full avg60 at a phase end */
+	bool full_valid[PSI_RESOURCES];	/* kernel reports full */
+} psi_stressor_t;
+
+static bool psi_available;
+static psi_t psi_start[PSI_RESOURCES];
+static double psi_time_start;
+static double psi_some_avg10[PSI_RESOURCES];	/* highest in this phase */
+static double psi_full_avg10[PSI_RESOURCES];
+static psi_stressor_t psi_stats[STRESS_MAX];
+
+#if defined(HAVE_LIB_PTHREAD)
+static pthread_t psi_pthread;
+static pthread_mutex_t psi_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t psi_cond = PTHREAD_COND_INITIALIZER;
+static bool psi_keep_sampling;
+static bool psi_pthread_running;
+#endif
+
+/*
+ *  psi_read()
+ *	parse the some and full lines of a pressure file, false
+ *	if the file cannot be read
+ */
+static bool psi_read(const char *path, psi_t *psi)
+{
+	char buf[256], *line, *saveptr = NULL;
+
+	memset(psi, 0, sizeof(*psi));
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return false;
+	for (line = strtok_r(buf, "\n", &saveptr); line;
+	     line = strtok_r(NULL, "\n", &saveptr)) {
+		char kind[8];
+		double avg300;
+		psi_line_t l;
+
+		if (sscanf(line, "%7s avg10=%lf avg60=%lf avg300=%lf total=%" SCNu64,
+			   kind, &l.avg10, &l.avg60, &avg300, &l.total) != 5)
+			continue;
+		l.valid = true;
+		if (!strcmp(kind, "some"))
+			psi->some = l;
+		else if (!strcmp(kind, "full"))
+			psi->full = l;
+	}
+	return psi->some.valid;
+}
+
+/*
+ *  psi_system_read()
+ *	read the system wide pressure of a resource
+ */
+static bool psi_system_read(const size_t r, psi_t *psi)
+{
+	char path[64];
+
+	(void)snprintf(path, sizeof(path), "/proc/pressure/%s", psi_resources[r]);
+	return psi_read(path, psi);
+}
+
+/*
+ *  psi_sample()
+ *	keep the highest avg10 of the phase
+ */
+static void psi_sample(void)
+{
+	size_t r;
+
+	for (r = 0; r < PSI_RESOURCES; r++) {
+		psi_t psi;
+
+		if (!psi_system_read(r, &psi))
+			continue;
+		if (psi.some.avg10 > psi_some_avg10[r])
+			psi_some_avg10[r] = psi.some.avg10;
+		if (psi.full.valid && (psi.full.avg10 > psi_full_avg10[r]))
+			psi_full_avg10[r] = psi.full.avg10;
+	}
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  psi_sample_thread()
+ *	periodically sample the pressure until told to stop
+ */
+static void *psi_sample_thread(void *arg)
+{
+	static void *nowt = NULL;
+	sigset_t set;
+	struct timespec abstime;
+
+	(void)arg;
+
+	/* Leave all signal handling to the main parent thread */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+	(void)clock_gettime(CLOCK_REALTIME, &abstime);
+
+	pthread_mutex_lock(&psi_mutex);
+	while (psi_keep_sampling) {
+		abstime.tv_nsec += PSI_SAMPLE_INTERVAL * 1000000;
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_nsec -= 1000000000;
+			abstime.tv_sec++;
+		}
+		while (psi_keep_sampling &&
+		       (pthread_cond_timedwait(&psi_cond, &psi_mutex, &abstime) == 0))
+			;
+		psi_sample();
+	}
+	pthread_mutex_unlock(&psi_mutex);
+
+	return &nowt;
+}
+#endif
+
+/*
+ *  stress_psi_init()
+ *	check the kernel has pressure stall information
+ */
+void stress_psi_init(void)
+{
+	psi_t psi;
+
+	if (!(opt_flags & OPT_FLAGS_PSI))
+		return;
+
+	psi_available = psi_system_read(0, &psi);
+	if (!psi_available)
+		pr_inf(stderr, "psi: /proc/pressure is not available, "
+			"the kernel needs CONFIG_PSI and psi=1\n");
+}
+
+/*
+ *  stress_psi_start()
+ *	take the stall totals at the start of a phase and start
+ *	sampling avg10 while it runs
+ */
+void stress_psi_start(void)
+{
+	size_t r;
+
+	if (!psi_available)
+		return;
+
+	for (r = 0; r < PSI_RESOURCES; r++) {
+		(void)psi_system_read(r, &psi_start[r]);
+		psi_some_avg10[r] = psi_start[r].some.avg10;
+		psi_full_avg10[r] = psi_start[r].full.avg10;
+	}
+	psi_time_start = time_now();
+
+#if defined(HAVE_LIB_PTHREAD)
+	{
+		int ret;
+
+		psi_keep_sampling = true;
+		ret = pthread_create(&psi_pthread, NULL, psi_sample_thread, NULL);
+		if (ret) {
+			pr_err(stderr, "psi: cannot create sampling thread: "
+				"errno=%d (%s)\n", ret, strerror(ret));
+			return;
+		}
+		psi_pthread_running = true;
+	}
+#endif
+}
+
+/*
+ *  stress_psi_stop()
+ *	charge the pressure of the phase to each of its stressors,
+ *	the pressure is system wide so stressors run together
+ *	share it
+ */
+void stress_psi_stop(const proc_info_t procs[STRESS_MAX])
+{
+	psi_t psi[PSI_RESOURCES];
+	double secs;
+	size_t r;
+	int32_t i;
+
+	if (!psi_available)
+		return;
+
+#if defined(HAVE_LIB_PTHREAD)
+	if (psi_pthread_running) {
+		pthread_mutex_lock(&psi_mutex);
+		psi_keep_sampling = false;
+		pthread_cond_signal(&psi_cond);
+		pthread_mutex_unlock(&psi_mutex);
+		(void)pthread_join(psi_pthread, NULL);
+		psi_pthread_running = false;
+	}
+#endif
+	psi_sample();
+	secs = time_now() - psi_time_start;
+	for (r = 0; r < PSI_RESOURCES; r++)
+		(void)psi_system_read(r, &psi[r]);
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		psi_stressor_t *ps = &psi_stats[i];
+
+		if (!procs[i].num_procs)
+			continue;
+		ps->secs += secs;
+		for (r = 0; r < PSI_RESOURCES; r++) {
+			ps->some_usec[r] += psi[r].some.total - psi_start[r].some.total;
+			ps->full_usec[r] += psi[r].full.total - psi_start[r].full.total;
+			ps->full_valid[r] = psi[r].full.valid;
+			if (psi_some_avg10[r] > ps->some_avg10[r])
+				ps->some_avg10[r] = psi_some_avg10[r];
+			if (psi_full_avg10[r] > ps->full_avg10[r])
+				ps->full_avg10[r] = psi_full_avg10[r];
+			if (psi[r].some.avg60 > ps->some_avg60[r])
+				ps->some_avg60[r] = psi[r].some.avg60;
+			if (psi[r].full.avg60 > ps->full_avg60[r])
+				ps->full_avg60[r] = psi[r].full.avg60;
+		}
+	}
+}
+
+/*
+ *  psi_cgroup_total()
+ *	sum the stall totals of the groups of a stressor's
+ *	instances, false if there are no groups
+ */
+static bool psi_cgroup_total(
+	const char *name,
+	const int32_t instances,
+	const size_t r,
+	uint64_t *some,
+	uint64_t *full)
+{
+	char prev[PATH_MAX] = "";
+	int32_t j;
+	bool ok = false;
+
+	*some = 0;
+	*full = 0;
+	for (j = 0; j < instances; j++) {
+		char leaf[PATH_MAX], path[PATH_MAX + 32];
+		psi_t psi;
+
+		if (stress_cgroup_leaf(leaf, sizeof(leaf), name, (uint32_t)j) < 0)
+			break;
+		/* All instances share one group with --cgroup stressor */
+		if (!strcmp(leaf, prev))
+			continue;
+		(void)snprintf(prev, sizeof(prev), "%s", leaf);
+		(void)snprintf(path, sizeof(path), "%s/%s.pressure",
+			leaf, psi_resources[r]);
+		if (!psi_read(path, &psi))
+			continue;
+		*some += psi.some.total;
+		*full += psi.full.total;
+		ok = true;
+	}
+	return ok;
+}
+
+/*
+ *  stress_psi_dump()
+ *	report the pressure each stressor ran under, and the stall
+ *	time of its own cgroups when --cgroup is used
+ */
+void stress_psi_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+	bool header = false;
+
+	if (!psi_available)
+		return;
+
+	pr_yaml(yaml, "pressure-stall-information:\n");
+	json_array_begin(json, "pressure-stall-information");
+	for (i = 0; i < STRESS_MAX; i++) {
+		const psi_stressor_t *ps = &psi_stats[i];
+		const char *munged;
+		size_t r;
+
+		if (!procs[i].started_procs || (ps->secs <= 0.0))
+			continue;
+		munged = munge_underscore(stressors[i].name);
+		if (!header) {
+			pr_inf(stdout, "pressure stall information, avg10 sampled "
+				"every %dms:\n", PSI_SAMPLE_INTERVAL);
+			pr_inf(stdout, "%-13s %-6s %-4s %9s %9s %10s %7s %10s\n",
+				"stressor", "psi", "", "avg10 max", "avg60 max",
+				"stall ms", "stall %", "cgroup ms");
+			header = true;
+		}
+		for (r = 0; r < PSI_RESOURCES; r++) {
+			uint64_t cg_some = 0, cg_full = 0;
+			const bool cg = psi_cgroup_total(munged,
+				procs[i].started_procs, r, &cg_some, &cg_full);
+			char cg_str[2][32];
+
+			(void)snprintf(cg_str[0], sizeof(cg_str[0]), "%.1f",
+				(double)cg_some / 1000.0);
+			(void)snprintf(cg_str[1], sizeof(cg_str[1]), "%.1f",
+				(double)cg_full / 1000.0);
+			pr_inf(stdout, "%-13s %-6s %-4s %9.2f %9.2f %10.1f %7.2f %10s\n",
+				munged, psi_resources[r], "some",
+				ps->some_avg10[r], ps->some_avg60[r],
+				(double)ps->some_usec[r] / 1000.0,
+				((double)ps->some_usec[r] / 10000.0) / ps->secs,
+				cg ? cg_str[0] : "-");
+			if (ps->full_valid[r])
+				pr_inf(stdout, "%-13s %-6s %-4s %9.2f %9.2f %10.1f %7.2f %10s\n",
+					munged, psi_resources[r], "full",
+					ps->full_avg10[r], ps->full_avg60[r],
+					(double)ps->full_usec[r] / 1000.0,
+					((double)ps->full_usec[r] / 10000.0) / ps->secs,
+					cg ? cg_str[1] : "-");
+
+			pr_yaml(yaml, "    - stressor: %s\n", munged);
+			pr_yaml(yaml, "      resource: %s\n", psi_resources[r]);
+			pr_yaml(yaml, "      some-avg10-max: %f\n", ps->some_avg10[r]);
+			pr_yaml(yaml, "      some-avg60-max: %f\n", ps->some_avg60[r]);
+			pr_yaml(yaml, "      some-stall-usec: %" PRIu64 "\n", ps->some_usec[r]);
+			if (ps->full_valid[r]) {
+				pr_yaml(yaml, "      full-avg10-max: %f\n", ps->full_avg10[r]);
+				pr_yaml(yaml, "      full-avg60-max: %f\n", ps->full_avg60[r]);
+				pr_yaml(yaml, "      full-stall-usec: %" PRIu64 "\n", ps->full_usec[r]);
+			}
+			if (cg) {
+				pr_yaml(yaml, "      cgroup-some-stall-usec: %" PRIu64 "\n", cg_some);
+				pr_yaml(yaml, "      cgroup-full-stall-usec: %" PRIu64 "\n", cg_full);
+			}
+
+			json_obj_begin(json, NULL);
+			json_str(json, "stressor", munged);
+			json_str(json, "resource", psi_resources[r]);
+			json_double(json, "some-avg10-max", ps->some_avg10[r]);
+			json_double(json, "some-avg60-max", ps->some_avg60[r]);
+			json_uint(json, "some-stall-usec", ps->some_usec[r]);
+			if (ps->full_valid[r]) {
+				json_double(json, "full-avg10-max", ps->full_avg10[r]);
+				json_double(json, "full-avg60-max", ps->full_avg60[r]);
+				json_uint(json, "full-stall-usec", ps->full_usec[r]);
+			}
+			if (cg) {
+				json_uint(json, "cgroup-some-stall-usec", cg_some);
+				json_uint(json, "cgroup-full-stall-usec", cg_full);
+			}
+			json_obj_end(json);
+		}
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+}
+
+#else
+void stress_psi_init(void)
+{
+	if (opt_flags & OPT_FLAGS_PSI)
+		pr_inf(stderr, "psi: pressure stall information not supported\n");
+}
+
+void stress_psi_start(void)
+{
+}
+
+void stress_psi_stop(const proc_info_t procs[STRESS_MAX])
+{
+	(void)procs;
+}
+
+void stress_psi_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	(void)yaml;
+	(void)json;
+	(void)stressors;
+	(void)procs;
+}
+#endif
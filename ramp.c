@@ -0,0 +1,540 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "stress-ng.h"
+
+static const char *option = "ramp";
+
+#define RAMP_MAX		(64)	/* max --ramp options */
+#define RAMP_STEPS_MAX		(1024)	/* max steps in a ramp */
+#define RAMP_STEPS_DEFAULT	(16)	/* max default steps of a --ramp */
+#define RAMP_STEP_SECS_DEFAULT	(60)	/* secs per step without --timeout */
+
+/* a --ramp S:FROM:TO[:STEPS] option */
+typedef struct {
+	char *name;			/* stressor name */
+	int32_t from, to;		/* first and last instance counts */
+	int32_t steps;			/* steps, 0 = default */
+} ramp_opt_t;
+
+/* one step of the run, num_procs < 0 leaves a stressor as given */
+typedef struct {
+	uint64_t secs;			/* duration of the step */
+	int32_t num_procs[STRESS_MAX];	/* instances of each stressor */
+} ramp_step_t;
+
+/* throughput of a stressor during a step */
+typedef struct {
+	uint32_t step;
+	int32_t stressor;		/* index into stressors[] */
+	int32_t instances;
+	uint64_t bogo_ops;
+	double rate;			/* bogo ops/sec over all instances */
+} ramp_result_t;
+
+static ramp_opt_t ramp_opts[RAMP_MAX];
+static size_t ramp_opts_count;
+static const char *ramp_file;
+static ramp_step_t *ramp_steps;
+static uint32_t ramp_steps_count;
+static ramp_result_t *ramp_results;
+static size_t ramp_results_count;
+static int32_t ramp_orig_procs[STRESS_MAX];	/* counts from the command line */
+
+/*
+ *  stress_set_ramp()
+ *	add a --ramp S:FROM:TO[:STEPS] stressor instance ramp
+ */
+int stress_set_ramp(const char *optarg)
+{
+	ramp_opt_t *opt;
+	char *str, *from, *to, *steps, *end;
+	long val;
+
+	if (ramp_opts_count >= RAMP_MAX) {
+		fprintf(stderr, "%s: no more than %d ramps allowed\n",
+			option, RAMP_MAX);
+		return -1;
+	}
+	str = strdup(optarg);
+	if (!str) {
+		fprintf(stderr, "%s: out of memory\n", option);
+		return -1;
+	}
+	opt = &ramp_opts[ramp_opts_count];
+	opt->name = str;
+	from = strchr(str, ':');
+	to = from ? strchr(from + 1, ':') : NULL;
+	if (!from || !to)
+		goto err;
+	*from++ = '\0';
+	*to++ = '\0';
+	steps = strchr(to, ':');
+	if (steps)
+		*steps++ = '\0';
+
+	val = strtol(from, &end, 10);
+	if ((end == from) || *end || (val < 0) || (val > STRESS_PROCS_MAX))
+		goto err;
+	opt->from = (int32_t)val;
+	val = strtol(to, &end, 10);
+	if ((end == to) || *end || (val < 0) || (val > STRESS_PROCS_MAX))
+		goto err;
+	opt->to = (int32_t)val;
+	opt->steps = 0;
+	if (steps) {
+		val = strtol(steps, &end, 10);
+		if ((end == steps) || *end || (val < 1) || (val > RAMP_STEPS_MAX))
+			goto err;
+		opt->steps = (int32_t)val;
+	}
+	ramp_opts_count++;
+	return 0;
+err:
+	fprintf(stderr, "%s must be STRESSOR:FROM:TO[:STEPS], with 0 to %d "
+		"instances and 1 to %d steps\n", option,
+		STRESS_PROCS_MAX, RAMP_STEPS_MAX);
+	free(str);
+	return -1;
+}
+
+/*
+ *  stress_set_ramp_file()
+ *	read the ramp steps from a file
+ */
+void stress_set_ramp_file(const char *optarg)
+{
+	ramp_file = optarg;
+}
+
+/*
+ *  stress_ramp_enabled()
+ *	true if the run is split into ramp steps
+ */
+bool stress_ramp_enabled(void)
+{
+	return ramp_opts_count || ramp_file;
+}
+
+/*
+ *  stress_ramp_steps()
+ *	number of ramp steps
+ */
+int stress_ramp_steps(void)
+{
+	return (int)ramp_steps_count;
+}
+
+/*
+ *  ramp_stressor_find()
+ *	find a stressor by name, STRESS_MAX if not found
+ */
+static int32_t ramp_stressor_find(const stress_t stressors[], const char *name)
+{
+	int32_t i;
+	char *tmp, *munged_name;
+	size_t len;
+
+	tmp = munge_underscore(name);
+	len = strlen(tmp) + 1;
+	munged_name = alloca(len);
+	strncpy(munged_name, tmp, len);
+
+	for (i = 0; stressors[i].name; i++) {
+		if (!strcmp(munge_underscore(stressors[i].name), munged_name))
+			break;
+	}
+	return stressors[i].name ? i : STRESS_MAX;
+}
+
+/*
+ *  ramp_steps_alloc()
+ *	allocate n steps, all stressors left as given
+ */
+static int ramp_steps_alloc(const uint32_t n)
+{
+	uint32_t i;
+	int32_t j;
+
+	ramp_steps = calloc(n, sizeof(*ramp_steps));
+	if (!ramp_steps) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " steps\n",
+			option, n);
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+		for (j = 0; j < STRESS_MAX; j++)
+			ramp_steps[i].num_procs[j] = -1;
+	ramp_steps_count = n;
+	return 0;
+}
+
+/*
+ *  ramp_opts_steps()
+ *	build the steps from the --ramp options, each ramp is
+ *	spread linearly over the steps of the longest one and
+ *	the --timeout is shared evenly between the steps
+ */
+static int ramp_opts_steps(const stress_t stressors[])
+{
+	uint32_t n = 1, s;
+	size_t k;
+	uint64_t secs;
+
+	for (k = 0; k < ramp_opts_count; k++) {
+		const ramp_opt_t *opt = &ramp_opts[k];
+		uint32_t steps = (uint32_t)opt->steps;
+
+		if (!steps) {
+			steps = (uint32_t)abs(opt->to - opt->from) + 1;
+			if (steps > RAMP_STEPS_DEFAULT)
+				steps = RAMP_STEPS_DEFAULT;
+		}
+		if (n < steps)
+			n = steps;
+	}
+	secs = opt_timeout ? opt_timeout / n : RAMP_STEP_SECS_DEFAULT;
+	if (!secs) {
+		pr_err(stderr, "%s: a timeout of %" PRIu64 " seconds is too "
+			"short for %" PRIu32 " steps\n", option, opt_timeout, n);
+		return -1;
+	}
+	if (ramp_steps_alloc(n) < 0)
+		return -1;
+
+	for (s = 0; s < n; s++)
+		ramp_steps[s].secs = secs;
+	for (k = 0; k < ramp_opts_count; k++) {
+		const ramp_opt_t *opt = &ramp_opts[k];
+		const int32_t i = ramp_stressor_find(stressors, opt->name);
+
+		if (i == STRESS_MAX) {
+			fprintf(stderr, "Unknown stressor: '%s', invalid "
+				"%s option\n", opt->name, option);
+			return -1;
+		}
+		for (s = 0; s < n; s++) {
+			const double frac = (n > 1) ?
+				(double)s / (double)(n - 1) : 1.0;
+
+			ramp_steps[s].num_procs[i] = opt->from + (int32_t)
+				(((double)(opt->to - opt->from) * frac) +
+				 ((opt->to >= opt->from) ? 0.5 : -0.5));
+		}
+	}
+	return 0;
+}
+
+/*
+ *  ramp_file_steps()
+ *	build the steps from a file with one step per line of
+ *	"SECS STRESSOR=N ...", stressors in the file that are
+ *	not named on a line have no instances in that step
+ */
+static int ramp_file_steps(const stress_t stressors[])
+{
+	FILE *fp;
+	char buf[4096];
+	bool used[STRESS_MAX];
+	uint32_t n = 0, s;
+	size_t line = 0;
+	int32_t i;
+
+	fp = fopen(ramp_file, "r");
+	if (!fp) {
+		pr_err(stderr, "%s: cannot open %s: errno=%d (%s)\n",
+			option, ramp_file, errno, strerror(errno));
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), fp)) {
+		const char *ptr = buf + strspn(buf, " \t");
+
+		if (*ptr != '#' && *ptr != '\n' && *ptr != '\0')
+			n++;
+	}
+	if (!n || (n > RAMP_STEPS_MAX)) {
+		pr_err(stderr, "%s: %s must have 1 to %d steps\n",
+			option, ramp_file, RAMP_STEPS_MAX);
+		(void)fclose(fp);
+		return -1;
+	}
+	if (ramp_steps_alloc(n) < 0) {
+		(void)fclose(fp);
+		return -1;
+	}
+
+	memset(used, 0, sizeof(used));
+	rewind(fp);
+	s = 0;
+	while ((s < n) && fgets(buf, sizeof(buf), fp)) {
+		char *str, *token, *end, *saveptr = NULL;
+		long val;
+
+		line++;
+		str = buf + strspn(buf, " \t");
+		if (*str == '#' || *str == '\n' || *str == '\0')
+			continue;
+
+		token = strtok_r(str, " \t\n", &saveptr);
+		val = strtol(token, &end, 10);
+		if ((end == token) || *end || (val < 1))
+			goto err;
+		ramp_steps[s].secs = (uint64_t)val;
+
+		while ((token = strtok_r(NULL, " \t\n", &saveptr)) != NULL) {
+			char *eq = strchr(token, '=');
+
+			if (!eq)
+				goto err;
+			*eq++ = '\0';
+			i = ramp_stressor_find(stressors, token);
+			if (i == STRESS_MAX) {
+				pr_err(stderr, "%s: %s line %zu: unknown "
+					"stressor '%s'\n", option, ramp_file,
+					line, token);
+				(void)fclose(fp);
+				return -1;
+			}
+			val = strtol(eq, &end, 10);
+			if ((end == eq) || *end || (val < 0) ||
+			    (val > STRESS_PROCS_MAX))
+				goto err;
+			ramp_steps[s].num_procs[i] = (int32_t)val;
+			used[i] = true;
+		}
+		s++;
+	}
+	(void)fclose(fp);
+
+	for (s = 0; s < n; s++)
+		for (i = 0; i < STRESS_MAX; i++)
+			if (used[i] && (ramp_steps[s].num_procs[i] < 0))
+				ramp_steps[s].num_procs[i] = 0;
+	return 0;
+err:
+	pr_err(stderr, "%s: %s line %zu: expecting \"SECS STRESSOR=N ...\" "
+		"with at least 1 second and 0 to %d instances\n",
+		option, ramp_file, line, STRESS_PROCS_MAX);
+	(void)fclose(fp);
+	return -1;
+}
+
+/*
+ *  stress_ramp_init()
+ *	build the ramp steps, set the instances of each stressor to
+ *	the most used by any step so the pids and stats can be sized,
+ *	and set the timeout to the shortest step for the checks that
+ *	are made against it. Returns the number of steps or -1
+ */
+int stress_ramp_init(const stress_t stressors[], proc_info_t procs[STRESS_MAX])
+{
+	uint32_t s;
+	int32_t i;
+	uint64_t secs_min = ~0ULL;
+
+	if (ramp_opts_count && ramp_file) {
+		pr_err(stderr, "%s: --ramp and --ramp-file cannot be "
+			"used together\n", option);
+		return -1;
+	}
+	if (ramp_file ? ramp_file_steps(stressors) < 0 :
+			ramp_opts_steps(stressors) < 0)
+		return -1;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		ramp_orig_procs[i] = procs[i].num_procs;
+		for (s = 0; s < ramp_steps_count; s++) {
+			const int32_t n = ramp_steps[s].num_procs[i];
+
+			if (procs[i].exclude)
+				ramp_steps[s].num_procs[i] = 0;
+			else if (n > procs[i].num_procs)
+				procs[i].num_procs = n;
+		}
+	}
+	for (s = 0; s < ramp_steps_count; s++)
+		if (secs_min > ramp_steps[s].secs)
+			secs_min = ramp_steps[s].secs;
+	opt_timeout = secs_min;
+
+	ramp_results = calloc((size_t)ramp_steps_count * STRESS_MAX,
+		sizeof(*ramp_results));
+	if (!ramp_results) {
+		pr_err(stderr, "%s: cannot allocate step results\n", option);
+		return -1;
+	}
+	return (int)ramp_steps_count;
+}
+
+/*
+ *  stress_ramp_step()
+ *	set up the stressors for a step and clear the counters and
+ *	stats of the previous step, returns the instances to start
+ */
+int32_t stress_ramp_step(
+	const uint32_t step,
+	proc_info_t procs[STRESS_MAX])
+{
+	const ramp_step_t *rs = &ramp_steps[step];
+	int32_t i, total = 0;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		const int32_t n = rs->num_procs[i];
+
+		procs[i].num_procs = (n < 0) ? ramp_orig_procs[i] : n;
+		procs[i].started_procs = 0;
+		procs[i].bogo_ops = 0;
+		if (procs[i].pids)
+			memset(procs[i].pids, 0, sizeof(pid_t) * (size_t)procs[i].stats_count);
+		total += procs[i].num_procs;
+	}
+	stress_stats_clear();
+	opt_timeout = rs->secs;
+
+	pr_inf(stdout, "%s: step %" PRIu32 " of %" PRIu32 ", %" PRIu64
+		" seconds, %" PRId32 " instances\n", option, step + 1,
+		ramp_steps_count, rs->secs, total);
+	return total;
+}
+
+/*
+ *  stress_ramp_record()
+ *	save the throughput of each stressor over a step
+ */
+void stress_ramp_record(
+	const uint32_t step,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		ramp_result_t *r;
+		uint64_t ops = 0;
+		double real = 0.0;
+		int32_t j, n = procs[i].stats_index;
+
+		if (!procs[i].started_procs)
+			continue;
+		for (j = 0; j < procs[i].started_procs; j++, n++) {
+			ops += shared->counters[n].counter;
+#if defined(STRESS_WARMUP)
+			ops -= shared->stats[n].warmup_counter;
+#endif
+			real += shared->stats[n].finish - shared->stats[n].start;
+		}
+		real /= (double)procs[i].started_procs;
+
+		r = &ramp_results[ramp_results_count++];
+		r->step = step;
+		r->stressor = i;
+		r->instances = procs[i].started_procs;
+		r->bogo_ops = ops;
+		r->rate = (real > 0.0) ? (double)ops / real : 0.0;
+
+		pr_inf(stdout, "%s: step %" PRIu32 ": %-13s %5" PRId32
+			" instances %12" PRIu64 " bogo ops %12.2f bogo ops/s "
+			"%12.2f per instance\n", option, step + 1,
+			munge_underscore(stressors[i].name), r->instances,
+			r->bogo_ops, r->rate, r->rate / (double)r->instances);
+	}
+}
+
+/*
+ *  stress_ramp_dump()
+ *	report the step with the highest throughput of each
+ *	stressor and output all the steps to the YAML/JSON
+ */
+void stress_ramp_dump(FILE *yaml, json_t *json, const stress_t stressors[])
+{
+	size_t k;
+	int32_t i;
+
+	if (!ramp_results_count)
+		return;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		const ramp_result_t *peak = NULL;
+
+		for (k = 0; k < ramp_results_count; k++) {
+			const ramp_result_t *r = &ramp_results[k];
+
+			if ((r->stressor == i) && (!peak || (r->rate > peak->rate)))
+				peak = r;
+		}
+		if (peak && (peak->rate > 0.0))
+			pr_inf(stdout, "%s: %s peak of %.2f bogo ops/s with %"
+				PRId32 " instances (step %" PRIu32 ")\n",
+				option, munge_underscore(stressors[i].name),
+				peak->rate, peak->instances, peak->step + 1);
+	}
+
+	pr_yaml(yaml, "ramp:\n");
+	json_array_begin(json, "ramp");
+	for (k = 0; k < ramp_results_count; k++) {
+		const ramp_result_t *r = &ramp_results[k];
+		const char *munged = munge_underscore(stressors[r->stressor].name);
+
+		pr_yaml(yaml, "    - step: %" PRIu32 "\n", r->step + 1);
+		pr_yaml(yaml, "      seconds: %" PRIu64 "\n", ramp_steps[r->step].secs);
+		pr_yaml(yaml, "      stressor: %s\n", munged);
+		pr_yaml(yaml, "      instances: %" PRId32 "\n", r->instances);
+		pr_yaml(yaml, "      bogo-ops: %" PRIu64 "\n", r->bogo_ops);
+		pr_yaml(yaml, "      bogo-ops-per-second-real-time: %f\n", r->rate);
+
+		json_obj_begin(json, NULL);
+		json_uint(json, "step", r->step + 1);
+		json_uint(json, "seconds", ramp_steps[r->step].secs);
+		json_str(json, "stressor", munged);
+		json_int(json, "instances", r->instances);
+		json_uint(json, "bogo-ops", r->bogo_ops);
+		json_double(json, "bogo-ops-per-second-real-time", r->rate);
+		json_obj_end(json);
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+}
+
+/*
+ *  stress_ramp_free()
+ *	free the ramp steps and results
+ */
+void stress_ramp_free(void)
+{
+	size_t k;
+
+	for (k = 0; k < ramp_opts_count; k++)
+		free(ramp_opts[k].name);
+	free(ramp_steps);
+	free(ramp_results);
+	ramp_steps = NULL;
+	ramp_results = NULL;
+}
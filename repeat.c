@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "stress-ng.h"
+
+static const char *option = "repeat";
+
+#define REPEAT_CV_NOISY		(5.0)	/* % coefficient of variation */
+
+/* two sided 95% Student's t critical values for 1..30 degrees of freedom */
+static const double repeat_t95[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static uint32_t opt_repeat = 1;		/* trials of each configuration */
+static double *repeat_rates;		/* bogo ops/s, trials per stressor */
+static uint32_t repeat_count[STRESS_MAX]; /* trials recorded per stressor */
+
+/*
+ *  stress_set_repeat()
+ *	set the number of trials of each configuration
+ */
+void stress_set_repeat(const char *optarg)
+{
+	opt_repeat = (uint32_t)get_uint64(optarg);
+	check_range(option, opt_repeat, MIN_REPEAT, MAX_REPEAT);
+}
+
+/*
+ *  stress_repeat_trials()
+ *	number of times each configuration is run
+ */
+uint32_t stress_repeat_trials(void)
+{
+	return opt_repeat;
+}
+
+/*
+ *  stress_repeat_trial()
+ *	set up the stressors with instances for another trial, the
+ *	counters and stats of the previous trial are cleared so the
+ *	other reports cover the last trial
+ */
+void stress_repeat_trial(
+	const uint32_t trial,
+	proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+
+	if (opt_repeat < 2)
+		return;
+	if (trial) {
+		for (i = 0; i < STRESS_MAX; i++) {
+			if (!procs[i].num_procs)
+				continue;
+			procs[i].started_procs = 0;
+			if (procs[i].pids)
+				memset(procs[i].pids, 0, sizeof(pid_t) * (size_t)procs[i].stats_count);
+			stress_stats_clear_slots(procs[i].stats_index, procs[i].stats_count);
+		}
+	}
+	pr_inf(stdout, "%s: trial %" PRIu32 " of %" PRIu32 "\n",
+		option, trial + 1, opt_repeat);
+}
+
+/*
+ *  stress_repeat_record()
+ *	save the throughput of each stressor run in a trial
+ */
+void stress_repeat_record(const proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+
+	if (opt_repeat < 2)
+		return;
+	if (!repeat_rates) {
+		repeat_rates = calloc((size_t)STRESS_MAX * opt_repeat,
+			sizeof(*repeat_rates));
+		if (!repeat_rates) {
+			pr_err(stderr, "%s: cannot allocate trial results\n", option);
+			opt_repeat = 1;
+			return;
+		}
+	}
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		uint64_t ops = 0;
+		double real = 0.0;
+		int32_t j, n = procs[i].stats_index;
+
+		if (!procs[i].started_procs || (repeat_count[i] >= opt_repeat))
+			continue;
+		for (j = 0; j < procs[i].started_procs; j++, n++) {
+			ops += shared->counters[n].counter;
+#if defined(STRESS_WARMUP)
+			ops -= shared->stats[n].warmup_counter;
+#endif
+			real += shared->stats[n].finish - shared->stats[n].start;
+		}
+		real /= (double)procs[i].started_procs;
+		repeat_rates[(i * opt_repeat) + repeat_count[i]++] =
+			(real > 0.0) ? (double)ops / real : 0.0;
+	}
+}
+
+/*
+ *  repeat_t95()
+ *	95% critical value of Student's t, past the table
+ *	1.96 + 2.5/df is within 0.1% of the exact value
+ */
+static double repeat_t95_value(const uint32_t df)
+{
+	if (df <= SIZEOF_ARRAY(repeat_t95))
+		return repeat_t95[df - 1];
+	return 1.96 + (2.5 / (double)df);
+}
+
+/*
+ *  stress_repeat_dump()
+ *	report the mean, standard deviation, coefficient of
+ *	variation and 95% confidence interval of the bogo ops/s
+ *	of each stressor over its trials
+ */
+void stress_repeat_dump(FILE *yaml, json_t *json, const stress_t stressors[])
+{
+	int32_t i;
+	bool header = false;
+	uint32_t noisy = 0;
+
+	if (!repeat_rates)
+		return;
+
+	pr_yaml(yaml, "repeat:\n");
+	json_array_begin(json, "repeat");
+	for (i = 0; i < STRESS_MAX; i++) {
+		const uint32_t n = repeat_count[i];
+		const double *rates = &repeat_rates[i * opt_repeat];
+		const char *munged = munge_underscore(stressors[i].name);
+		double sum = 0.0, sumsq = 0.0, mean, sd, cv, ci;
+		uint32_t k;
+
+		if (n < 2)
+			continue;
+		for (k = 0; k < n; k++)
+			sum += rates[k];
+		mean = sum / (double)n;
+		for (k = 0; k < n; k++)
+			sumsq += (rates[k] - mean) * (rates[k] - mean);
+		sd = sqrt(sumsq / (double)(n - 1));
+		cv = (mean > 0.0) ? 100.0 * sd / mean : 0.0;
+		ci = repeat_t95_value(n - 1) * sd / sqrt((double)n);
+
+		if (!header) {
+			pr_inf(stdout, "%s: %-13s %6s %12s %12s %7s %27s\n",
+				option, "stressor", "trials", "mean ops/s",
+				"stddev", "CV %", "95% confidence interval");
+			header = true;
+		}
+		pr_inf(stdout, "%s: %-13s %6" PRIu32 " %12.2f %12.2f %7.2f "
+			"%13.2f %13.2f%s\n", option, munged, n, mean, sd, cv,
+			mean - ci, mean + ci,
+			(cv > REPEAT_CV_NOISY) ? " noisy" : "");
+		if (cv > REPEAT_CV_NOISY)
+			noisy++;
+
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      trials: %" PRIu32 "\n", n);
+		pr_yaml(yaml, "      bogo-ops-per-second-mean: %f\n", mean);
+		pr_yaml(yaml, "      bogo-ops-per-second-stddev: %f\n", sd);
+		pr_yaml(yaml, "      coefficient-of-variation: %f\n", cv);
+		pr_yaml(yaml, "      ci95-low: %f\n", mean - ci);
+		pr_yaml(yaml, "      ci95-high: %f\n", mean + ci);
+		pr_yaml(yaml, "      noisy: %s\n", (cv > REPEAT_CV_NOISY) ? "true" : "false");
+
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_uint(json, "trials", n);
+		json_double(json, "bogo-ops-per-second-mean", mean);
+		json_double(json, "bogo-ops-per-second-stddev", sd);
+		json_double(json, "coefficient-of-variation", cv);
+		json_double(json, "ci95-low", mean - ci);
+		json_double(json, "ci95-high", mean + ci);
+		json_bool(json, "noisy", cv > REPEAT_CV_NOISY);
+		json_obj_end(json);
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+
+	if (noisy)
+		pr_inf(stdout, "%s: %" PRIu32 " stressor%s vary by more than "
+			"%.0f%% between trials, differences smaller than "
+			"their confidence interval are noise\n", option, noisy,
+			noisy == 1 ? "" : "s", REPEAT_CV_NOISY);
+}
+
+/*
+ *  stress_repeat_free()
+ *	free the trial results
+ */
+void stress_repeat_free(void)
+{
+	free(repeat_rates);
+	repeat_rates = NULL;
+}
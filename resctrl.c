@@ -0,0 +1,462 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+static const char *option = "resctrl";
+
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define RESCTRL_PATH		"/sys/fs/resctrl"
+#define RESCTRL_GROUPS_MAX	(16)	/* --resctrl options */
+
+/* A resctrl group of a stressor */
+typedef struct {
+	char name[64];			/* stressor, munged */
+	uint64_t l3_mask;		/* L3 way mask, 0 = not set */
+	uint32_t mba;			/* MBA throttle %, 0 = not set */
+	char path[PATH_MAX];		/* group directory, "" = not created */
+} resctrl_group_t;
+
+/* CMT and MBM counters of a group, summed over the L3 domains */
+typedef struct {
+	uint64_t llc_occupancy;		/* bytes of LLC in use */
+	uint64_t mbm_total;		/* bytes of memory bandwidth, total */
+	uint64_t mbm_local;		/* bytes of memory bandwidth, local node */
+	bool llc_valid;
+	bool mbm_valid;
+} resctrl_mon_t;
+
+static resctrl_group_t resctrl_groups[RESCTRL_GROUPS_MAX];
+static size_t resctrl_groups_n;
+
+/*
+ *  stress_set_resctrl()
+ *	add a group for a stressor from S:L3MASK[:MBA], either
+ *	the mask or the MBA % may be left empty
+ */
+int stress_set_resctrl(const char *str)
+{
+	char buf[128], *name, *mask, *mba, *end, *saveptr = NULL;
+	resctrl_group_t *g;
+
+	if (resctrl_groups_n >= RESCTRL_GROUPS_MAX) {
+		fprintf(stderr, "%s: at most %d groups can be given\n",
+			option, RESCTRL_GROUPS_MAX);
+		return -1;
+	}
+	if (strlen(str) >= sizeof(buf))
+		goto err;
+	(void)strcpy(buf, str);
+	g = &resctrl_groups[resctrl_groups_n];
+	memset(g, 0, sizeof(*g));
+
+	/* strsep keeps the empty fields that strtok_r would skip */
+	saveptr = buf;
+	name = strsep(&saveptr, ":");
+	mask = strsep(&saveptr, ":");
+	mba = strsep(&saveptr, ":");
+	if (!name || !*name || !mask || saveptr)
+		goto err;
+	(void)snprintf(g->name, sizeof(g->name), "%s", munge_underscore(name));
+	if (*mask) {
+		errno = 0;
+		g->l3_mask = strtoull(mask, &end, 16);
+		if (errno || *end || !g->l3_mask)
+			goto err;
+	}
+	if (mba && *mba) {
+		g->mba = (uint32_t)get_uint64(mba);
+		check_range("resctrl MBA %", g->mba, 1, 100);
+	}
+	if (!g->l3_mask && !g->mba)
+		goto err;
+	resctrl_groups_n++;
+	return 0;
+err:
+	fprintf(stderr, "%s must be STRESSOR:L3MASK[:MBA], e.g. cache:0x0f:50 "
+		"or stream::20, the mask in hex and MBA in %%\n", option);
+	return -1;
+}
+
+/*
+ *  resctrl_write()
+ *	write a value to a file of a group
+ */
+static int resctrl_write(const char *dir, const char *file, const char *val)
+{
+	char path[PATH_MAX + 32];
+	int fd, ret = 0;
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, file);
+	if ((fd = open(path, O_WRONLY)) < 0)
+		return -errno;
+	if (write(fd, val, strlen(val)) < 0)
+		ret = -errno;
+	(void)close(fd);
+	return ret;
+}
+
+/*
+ *  resctrl_schemata()
+ *	build the schemata of a group from the root group's, each
+ *	L3 (or L3CODE and L3DATA with CDP) and MB resource gets the
+ *	mask or throttle of the group for all of its domains
+ */
+static int resctrl_schemata(const resctrl_group_t *g, char *out, const size_t len)
+{
+	char buf[4096], *line, *saveptr = NULL;
+	size_t used = 0;
+
+	if (system_read(RESCTRL_PATH "/schemata", buf, sizeof(buf) - 1) <= 0)
+		return -1;
+	*out = '\0';
+	for (line = strtok_r(buf, "\n", &saveptr); line;
+	     line = strtok_r(NULL, "\n", &saveptr)) {
+		char *domains, *dom, *dsave = NULL;
+		const bool l3 = !strncmp(line + strspn(line, " "), "L3", 2);
+		const bool mb = !strncmp(line + strspn(line, " "), "MB:", 3);
+
+		if ((l3 && !g->l3_mask) || (mb && !g->mba) || (!l3 && !mb))
+			continue;
+		domains = strchr(line, ':');
+		if (!domains)
+			continue;
+		*domains++ = '\0';
+		used += (size_t)snprintf(out + used, len - used, "%s:",
+			line + strspn(line, " "));
+		for (dom = strtok_r(domains, ";", &dsave); dom && (used < len);
+		     dom = strtok_r(NULL, ";", &dsave)) {
+			const int id = atoi(dom);
+
+			if (l3)
+				used += (size_t)snprintf(out + used, len - used,
+					"%s%d=%" PRIx64, (out[used - 1] == ':') ? "" : ";",
+					id, g->l3_mask);
+			else
+				used += (size_t)snprintf(out + used, len - used,
+					"%s%d=%" PRIu32, (out[used - 1] == ':') ? "" : ";",
+					id, g->mba);
+		}
+		if (used < len)
+			used += (size_t)snprintf(out + used, len - used, "\n");
+		if (used >= len)
+			return -1;
+	}
+	return used ? 0 : -1;
+}
+
+/*
+ *  stress_resctrl_init()
+ *	create the resctrl group of each stressor given with
+ *	--resctrl and set its cache and bandwidth allocation.
+ *	Called once by the parent
+ */
+void stress_resctrl_init(void)
+{
+	size_t i;
+
+	if (!resctrl_groups_n)
+		return;
+	if (access(RESCTRL_PATH "/schemata", R_OK) < 0) {
+		pr_inf(stderr, "%s: %s is not mounted, stressors will not "
+			"be put into resctrl groups\n", option, RESCTRL_PATH);
+		resctrl_groups_n = 0;
+		return;
+	}
+	for (i = 0; i < resctrl_groups_n; i++) {
+		resctrl_group_t *g = &resctrl_groups[i];
+		char schemata[4096];
+		int ret;
+
+		if (resctrl_schemata(g, schemata, sizeof(schemata)) < 0) {
+			pr_inf(stderr, "%s: %s: the %s%s%s resource is not "
+				"available\n", option, g->name,
+				g->l3_mask ? "L3 CAT" : "",
+				(g->l3_mask && g->mba) ? " or " : "",
+				g->mba ? "MBA" : "");
+			continue;
+		}
+		if (snprintf(g->path, sizeof(g->path), "%s/%s-%d-%s",
+			     RESCTRL_PATH, app_name, getpid(),
+			     g->name) >= (int)sizeof(g->path)) {
+			pr_inf(stderr, "%s: %s: the group path is too long\n",
+				option, g->name);
+			*g->path = '\0';
+			continue;
+		}
+		if ((mkdir(g->path, 0755) < 0) && (errno != EEXIST)) {
+			pr_inf(stderr, "%s: cannot create %s, errno=%d (%s)%s\n",
+				option, g->path, errno, strerror(errno),
+				(errno == ENOSPC) ? ", out of CLOSIDs or RMIDs" : "");
+			*g->path = '\0';
+			continue;
+		}
+		ret = resctrl_write(g->path, "schemata", schemata);
+		if (ret < 0) {
+			char info[256];
+
+			if (system_read(RESCTRL_PATH "/info/last_cmd_status",
+					info, sizeof(info) - 1) <= 0)
+				*info = '\0';
+			info[strcspn(info, "\n")] = '\0';
+			pr_inf(stderr, "%s: %s: cannot set the schemata, "
+				"errno=%d (%s) %s\n", option, g->name,
+				-ret, strerror(-ret), info);
+			(void)rmdir(g->path);
+			*g->path = '\0';
+			continue;
+		}
+		pr_dbg(stderr, "%s: %s runs in %s\n", option, g->name, g->path);
+	}
+}
+
+/*
+ *  stress_resctrl_enter()
+ *	move the calling stressor instance into its group, the
+ *	threads it creates stay in the group
+ */
+void stress_resctrl_enter(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < resctrl_groups_n; i++) {
+		const resctrl_group_t *g = &resctrl_groups[i];
+		char pid[32];
+		int ret;
+
+		if (!*g->path || strcmp(g->name, name))
+			continue;
+		(void)snprintf(pid, sizeof(pid), "%d", getpid());
+		ret = resctrl_write(g->path, "tasks", pid);
+		if (ret < 0)
+			pr_dbg(stderr, "%s: cannot join %s, errno=%d (%s)\n",
+				option, g->path, -ret, strerror(-ret));
+		return;
+	}
+}
+
+/*
+ *  resctrl_mon()
+ *	read the CMT and MBM counters of a group, summed over
+ *	its L3 monitoring domains
+ */
+static void resctrl_mon(const resctrl_group_t *g, resctrl_mon_t *mon)
+{
+	char path[PATH_MAX + 32];
+	DIR *dir;
+	struct dirent *d;
+
+	memset(mon, 0, sizeof(*mon));
+	(void)snprintf(path, sizeof(path), "%s/mon_data", g->path);
+	if ((dir = opendir(path)) == NULL)
+		return;
+	while ((d = readdir(dir)) != NULL) {
+		char file[PATH_MAX + 320], buf[64];
+
+		if (strncmp(d->d_name, "mon_L3_", 7))
+			continue;
+		(void)snprintf(file, sizeof(file), "%s/%s/llc_occupancy",
+			path, d->d_name);
+		if (system_read(file, buf, sizeof(buf) - 1) > 0) {
+			mon->llc_occupancy += strtoull(buf, NULL, 10);
+			mon->llc_valid = true;
+		}
+		(void)snprintf(file, sizeof(file), "%s/%s/mbm_total_bytes",
+			path, d->d_name);
+		if (system_read(file, buf, sizeof(buf) - 1) > 0) {
+			mon->mbm_total += strtoull(buf, NULL, 10);
+			mon->mbm_valid = true;
+		}
+		(void)snprintf(file, sizeof(file), "%s/%s/mbm_local_bytes",
+			path, d->d_name);
+		if (system_read(file, buf, sizeof(buf) - 1) > 0)
+			mon->mbm_local += strtoull(buf, NULL, 10);
+	}
+	(void)closedir(dir);
+}
+
+/*
+ *  stress_resctrl_dump()
+ *	report the LLC occupancy and memory bandwidth of each
+ *	group next to the throughput of its stressor
+ */
+void stress_resctrl_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+	bool header = false;
+
+	if (!resctrl_groups_n)
+		return;
+
+	pr_yaml(yaml, "resctrl:\n");
+	json_array_begin(json, "resctrl");
+	for (i = 0; i < STRESS_MAX; i++) {
+		const char *munged;
+		const resctrl_group_t *g = NULL;
+		resctrl_mon_t mon;
+		uint64_t ops = 0;
+		double secs = 0.0, rate, mbm, mbm_local;
+		int32_t j, n = procs[i].stats_index;
+		size_t k;
+
+		if (!procs[i].started_procs)
+			continue;
+		munged = munge_underscore(stressors[i].name);
+		for (k = 0; k < resctrl_groups_n; k++)
+			if (*resctrl_groups[k].path && !strcmp(resctrl_groups[k].name, munged))
+				g = &resctrl_groups[k];
+		if (!g)
+			continue;
+
+		/* The counters start with the group, so are per run */
+		for (j = 0; j < procs[i].started_procs; j++, n++) {
+			ops += shared->counters[n].counter;
+			secs += shared->stats[n].finish - shared->stats[n].start;
+		}
+		secs /= (double)procs[i].started_procs;
+		rate = (secs > 0.0) ? (double)ops / secs : 0.0;
+		resctrl_mon(g, &mon);
+		mbm = (secs > 0.0) ? ((double)mon.mbm_total / (double)MB) / secs : 0.0;
+		mbm_local = (secs > 0.0) ? ((double)mon.mbm_local / (double)MB) / secs : 0.0;
+
+		if (!header) {
+			pr_inf(stdout, "%-13s %12s %5s %10s %10s %10s %12s\n",
+				"resctrl", "L3 mask", "MBA %", "LLC KB",
+				"MBM MB/s", "local MB/s", "bogo ops/s");
+			header = true;
+		}
+		pr_inf(stdout, "%-13s %12" PRIx64 " %5" PRIu32 " %10s %10s %10s %12.2f\n",
+			munged, g->l3_mask, g->mba,
+			mon.llc_valid ? "" : "-",
+			mon.mbm_valid ? "" : "-",
+			mon.mbm_valid ? "" : "-", rate);
+		if (mon.llc_valid || mon.mbm_valid)
+			pr_inf(stdout, "%-13s %12s %5s %10.1f %10.1f %10.1f\n",
+				"", "", "", (double)mon.llc_occupancy / 1024.0,
+				mbm, mbm_local);
+
+		pr_yaml(yaml, "    - stressor: %s\n", munged);
+		pr_yaml(yaml, "      l3-mask: 0x%" PRIx64 "\n", g->l3_mask);
+		pr_yaml(yaml, "      mba-percent: %" PRIu32 "\n", g->mba);
+		pr_yaml(yaml, "      bogo-ops-per-second-real-time: %f\n", rate);
+		if (mon.llc_valid)
+			pr_yaml(yaml, "      llc-occupancy: %" PRIu64 "\n", mon.llc_occupancy);
+		if (mon.mbm_valid) {
+			pr_yaml(yaml, "      mbm-total-bytes: %" PRIu64 "\n", mon.mbm_total);
+			pr_yaml(yaml, "      mbm-local-bytes: %" PRIu64 "\n", mon.mbm_local);
+		}
+
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_uint(json, "l3-mask", g->l3_mask);
+		json_uint(json, "mba-percent", g->mba);
+		json_double(json, "bogo-ops-per-second-real-time", rate);
+		if (mon.llc_valid)
+			json_uint(json, "llc-occupancy", mon.llc_occupancy);
+		if (mon.mbm_valid) {
+			json_uint(json, "mbm-total-bytes", mon.mbm_total);
+			json_uint(json, "mbm-local-bytes", mon.mbm_local);
+		}
+		json_obj_end(json);
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+}
+
+/*
+ *  stress_resctrl_free()
+ *	remove the groups once all the stressors have been reaped,
+ *	their tasks go back to the root group
+ */
+void stress_resctrl_free(void)
+{
+	size_t i;
+
+	for (i = 0; i < resctrl_groups_n; i++) {
+		resctrl_group_t *g = &resctrl_groups[i];
+
+		if (!*g->path)
+			continue;
+		if (rmdir(g->path) < 0)
+			pr_dbg(stderr, "%s: cannot remove %s, errno=%d (%s)\n",
+				option, g->path, errno, strerror(errno));
+		*g->path = '\0';
+	}
+	resctrl_groups_n = 0;
+}
+
+#else
+int stress_set_resctrl(const char *str)
+{
+	(void)str;
+
+	fprintf(stderr, "%s: resctrl not supported\n", option);
+	return -1;
+}
+
+void stress_resctrl_init(void)
+{
+}
+
+void stress_resctrl_enter(const char *name)
+{
+	(void)name;
+}
+
+void stress_resctrl_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	(void)yaml;
+	(void)json;
+	(void)stressors;
+	(void)procs;
+}
+
+void stress_resctrl_free(void)
+{
+}
+#endif
@@ -0,0 +1,700 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+
+#include "stress-ng.h"
+
+#if defined(STRESS_SAMPLE)
+
+#include <pthread.h>
+
+#define SAMPLE_CHUNK		(4096)	/* samples allocated per realloc */
+
+/* a single bogo op counter sample of one stressor */
+typedef struct {
+	double time;			/* time since start of run */
+	uint64_t counter;		/* total bogo ops of all instances */
+	double rate;			/* bogo ops/sec since last sample */
+	int32_t id;			/* index into stressors[] */
+	int32_t instances;		/* instances running */
+	/* perf counters since last sample, < 0.0 if not available */
+	double ipc;			/* instructions per cycle */
+	double cache_miss;		/* cache misses, % of references */
+	double ctxt_sw_rate;		/* context switches/sec */
+	double migration_rate;		/* CPU migrations/sec */
+} sample_t;
+
+/* perf counters sampled during the run */
+enum {
+	SAMPLE_PERF_CYCLES = 0,
+	SAMPLE_PERF_INSTRUCTIONS,
+	SAMPLE_PERF_CACHE_REFS,
+	SAMPLE_PERF_CACHE_MISSES,
+	SAMPLE_PERF_CTXT_SW,
+	SAMPLE_PERF_MIGRATIONS,
+	SAMPLE_PERF_MAX
+};
+
+#if defined(STRESS_PERF_STATS)
+static const int sample_perf_ids[SAMPLE_PERF_MAX] = {
+	STRESS_PERF_HW_CPU_CYCLES,
+	STRESS_PERF_HW_INSTRUCTIONS,
+	STRESS_PERF_HW_CACHE_REFERENCES,
+	STRESS_PERF_HW_CACHE_MISSES,
+	STRESS_PERF_SW_CONTEXT_SWITCHES,
+	STRESS_PERF_SW_CPU_MIGRATIONS,
+};
+#endif
+
+uint64_t opt_sample_interval = DEFAULT_SAMPLE_INTERVAL;
+static const char *opt_sample_file = NULL;
+static const char *opt_sample_textfile = NULL;
+
+static sample_t *samples;		/* all samples taken */
+static size_t samples_used;		/* number of samples taken */
+static size_t samples_size;		/* number of samples allocated */
+static FILE *sample_csv;		/* CSV sample output file */
+static double sample_time_start = -1.0;	/* start time of first run */
+
+static pthread_t sample_pthread;
+static pthread_mutex_t sample_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sample_cond = PTHREAD_COND_INITIALIZER;
+static bool sample_keep_sampling;
+static bool sample_pthread_running;
+
+static const stress_t *sample_stressors;
+static const proc_info_t *sample_procs;
+
+/* --converge state of each stressor, reset by sample_start() */
+typedef struct {
+	double last_rate;		/* rate of the previous window */
+	uint32_t windows;		/* windows in a row within tolerance */
+	double time;			/* time converged, < 0.0 if not */
+	double rate;			/* rate when converged */
+} converge_t;
+
+static uint64_t opt_converge;		/* tolerance %, 0 = off */
+static uint32_t opt_converge_windows = DEFAULT_CONVERGE_WINDOWS;
+static converge_t converge[STRESS_MAX];
+
+/*
+ *  stress_set_sample_interval()
+ *	set the time between counter samples in milliseconds
+ */
+void stress_set_sample_interval(const char *optarg)
+{
+	opt_sample_interval = get_uint64(optarg);
+	check_range("sample", opt_sample_interval,
+		MIN_SAMPLE_INTERVAL, MAX_SAMPLE_INTERVAL);
+	opt_flags |= OPT_FLAGS_SAMPLE;
+}
+
+/*
+ *  stress_set_sample_file()
+ *	set the CSV file that samples are written to
+ */
+void stress_set_sample_file(const char *optarg)
+{
+	opt_sample_file = optarg;
+	opt_flags |= OPT_FLAGS_SAMPLE;
+}
+
+/*
+ *  stress_set_sample_textfile()
+ *	set the node_exporter textfile the latest samples are
+ *	written to in the Prometheus text format
+ */
+void stress_set_sample_textfile(const char *optarg)
+{
+	opt_sample_textfile = optarg;
+	opt_flags |= OPT_FLAGS_SAMPLE;
+}
+
+/*
+ *  stress_set_converge()
+ *	stop each stressor once its bogo op rate stays within
+ *	the given % of the previous sample for some windows
+ */
+void stress_set_converge(const char *optarg)
+{
+	opt_converge = get_uint64(optarg);
+	check_range("converge", opt_converge, MIN_CONVERGE, MAX_CONVERGE);
+	opt_flags |= OPT_FLAGS_SAMPLE;
+}
+
+/*
+ *  stress_set_converge_windows()
+ *	set the number of sample intervals in a row the rate
+ *	must be within the --converge tolerance
+ */
+void stress_set_converge_windows(const char *optarg)
+{
+	uint64_t windows;
+
+	windows = get_uint64(optarg);
+	check_range("converge-windows", windows,
+		MIN_CONVERGE_WINDOWS, MAX_CONVERGE_WINDOWS);
+	opt_converge_windows = (uint32_t)windows;
+}
+
+/*
+ *  sample_converge()
+ *	check if the rate of stressor i has settled down and if
+ *	so tell its instances to stop, just as the --timeout does
+ */
+static void sample_converge(const int32_t i, const double t, const double rate)
+{
+	converge_t *c = &converge[i];
+	const double last = c->last_rate;
+	int32_t j;
+
+	c->last_rate = rate;
+	if (c->time >= 0.0)
+		return;
+	if ((last > 0.0) &&
+	    (fabs(rate - last) * 100.0 <= (double)opt_converge * last))
+		c->windows++;
+	else
+		c->windows = 0;
+	if (c->windows < opt_converge_windows)
+		return;
+
+	c->time = t;
+	c->rate = rate;
+	pr_inf(stdout, "converge: %s settled at %.2f bogo ops/s after %.2fs\n",
+		munge_underscore(sample_stressors[i].name), rate, t);
+	for (j = 0; j < sample_procs[i].started_procs; j++) {
+		if (sample_procs[i].pids[j] > 0)
+			(void)kill(sample_procs[i].pids[j], SIGALRM);
+	}
+}
+
+/*
+ *  sample_perf_enabled()
+ *	true if perf counters are sampled too
+ */
+static inline bool sample_perf_enabled(void)
+{
+#if defined(STRESS_PERF_STATS)
+	return !!(opt_flags & OPT_FLAGS_PERF_STATS);
+#else
+	return false;
+#endif
+}
+
+/*
+ *  sample_csv_double()
+ *	write a comma and a perf value, empty if it is not available
+ */
+static void sample_csv_double(const double val)
+{
+	if (val < 0.0)
+		fprintf(sample_csv, ",");
+	else
+		fprintf(sample_csv, ",%.3f", val);
+}
+
+/*
+ *  sample_add()
+ *	append a sample to the sample list and the CSV file
+ */
+static void sample_add(const sample_t *sample)
+{
+	if (samples_used >= samples_size) {
+		sample_t *tmp;
+
+		tmp = realloc(samples, (samples_size + SAMPLE_CHUNK) * sizeof(*samples));
+		if (!tmp)
+			return;
+		samples = tmp;
+		samples_size += SAMPLE_CHUNK;
+	}
+	samples[samples_used] = *sample;
+	samples_used++;
+
+	if (sample_csv) {
+		fprintf(sample_csv, "%.3f,%s,%" PRIu64 ",%.2f",
+			sample->time,
+			munge_underscore(sample_stressors[sample->id].name),
+			sample->counter, sample->rate);
+		if (sample_perf_enabled()) {
+			sample_csv_double(sample->ipc);
+			sample_csv_double(sample->cache_miss);
+			sample_csv_double(sample->ctxt_sw_rate);
+			sample_csv_double(sample->migration_rate);
+		}
+		fprintf(sample_csv, "\n");
+	}
+}
+
+#if defined(STRESS_PERF_STATS)
+/*
+ *  sample_perf()
+ *	sum the live perf counters of all the instances of a
+ *	stressor and work out the ratios and rates since the
+ *	previous sample
+ */
+static void sample_perf(
+	sample_t *sample,
+	const int32_t i,
+	uint64_t last_perf[SAMPLE_PERF_MAX],
+	const double dt)
+{
+	uint64_t total[SAMPLE_PERF_MAX], delta[SAMPLE_PERF_MAX];
+	bool valid[SAMPLE_PERF_MAX];
+	size_t k;
+
+	for (k = 0; k < SAMPLE_PERF_MAX; k++) {
+		int32_t j, n = sample_procs[i].stats_index;
+
+		total[k] = 0;
+		valid[k] = false;
+		for (j = 0; j < sample_procs[i].started_procs; j++, n++) {
+			uint64_t counter;
+
+			if (perf_get_live_by_id(&shared->perf_stats[n],
+			    sample_perf_ids[k], &counter) < 0)
+				continue;
+			total[k] += counter;
+			valid[k] = true;
+		}
+		/* Counters can drop when an instance restarts its counts */
+		delta[k] = (total[k] > last_perf[k]) ? total[k] - last_perf[k] : 0;
+		last_perf[k] = total[k];
+	}
+
+	sample->ipc = (valid[SAMPLE_PERF_CYCLES] && valid[SAMPLE_PERF_INSTRUCTIONS] &&
+		       delta[SAMPLE_PERF_CYCLES]) ?
+		(double)delta[SAMPLE_PERF_INSTRUCTIONS] / (double)delta[SAMPLE_PERF_CYCLES] : -1.0;
+	sample->cache_miss = (valid[SAMPLE_PERF_CACHE_REFS] && valid[SAMPLE_PERF_CACHE_MISSES] &&
+			      delta[SAMPLE_PERF_CACHE_REFS]) ?
+		100.0 * (double)delta[SAMPLE_PERF_CACHE_MISSES] / (double)delta[SAMPLE_PERF_CACHE_REFS] : -1.0;
+	sample->ctxt_sw_rate = (valid[SAMPLE_PERF_CTXT_SW] && (dt > 0.0)) ?
+		(double)delta[SAMPLE_PERF_CTXT_SW] / dt : -1.0;
+	sample->migration_rate = (valid[SAMPLE_PERF_MIGRATIONS] && (dt > 0.0)) ?
+		(double)delta[SAMPLE_PERF_MIGRATIONS] / dt : -1.0;
+}
+#endif
+
+/*
+ *  sample_textfile_family()
+ *	write one metric family of the latest samples, values
+ *	< 0.0 are not available and are left out
+ */
+static void sample_textfile_family(
+	FILE *fp,
+	const char *name,
+	const char *type,
+	const char *help,
+	const sample_t *round,
+	const size_t n,
+	const size_t offset)
+{
+	size_t k;
+	bool header = false;
+
+	for (k = 0; k < n; k++) {
+		const double val = *(const double *)((const uint8_t *)&round[k] + offset);
+
+		if (val < 0.0)
+			continue;
+		if (!header) {
+			fprintf(fp, "# HELP %s %s\n# TYPE %s %s\n",
+				name, help, name, type);
+			header = true;
+		}
+		fprintf(fp, "%s{stressor=\"%s\"} %.6g\n", name,
+			munge_underscore(sample_stressors[round[k].id].name), val);
+	}
+}
+
+/*
+ *  sample_textfile()
+ *	rewrite the textfile with the latest samples of the running
+ *	stressors, a temporary file is renamed over it so the
+ *	node_exporter textfile collector never sees a partial file
+ */
+static void sample_textfile(const sample_t *round, const size_t n, const double t)
+{
+	char tmp[PATH_MAX];
+	FILE *fp;
+	size_t k;
+
+	(void)snprintf(tmp, sizeof(tmp), "%s.%d.tmp", opt_sample_textfile, getpid());
+	fp = fopen(tmp, "w");
+	if (!fp)
+		return;
+
+	fprintf(fp, "# HELP stress_ng_run_seconds Time since the stressors started.\n"
+		"# TYPE stress_ng_run_seconds gauge\n"
+		"stress_ng_run_seconds %.3f\n", t);
+	if (n) {
+		fprintf(fp, "# HELP stress_ng_bogo_ops_total Bogo operations of all the instances.\n"
+			"# TYPE stress_ng_bogo_ops_total counter\n");
+		for (k = 0; k < n; k++)
+			fprintf(fp, "stress_ng_bogo_ops_total{stressor=\"%s\"} %" PRIu64 "\n",
+				munge_underscore(sample_stressors[round[k].id].name),
+				round[k].counter);
+		fprintf(fp, "# HELP stress_ng_instances Instances running.\n"
+			"# TYPE stress_ng_instances gauge\n");
+		for (k = 0; k < n; k++)
+			fprintf(fp, "stress_ng_instances{stressor=\"%s\"} %" PRId32 "\n",
+				munge_underscore(sample_stressors[round[k].id].name),
+				round[k].instances);
+	}
+	sample_textfile_family(fp, "stress_ng_bogo_ops_per_second", "gauge",
+		"Bogo operations per second over the last sample.",
+		round, n, offsetof(sample_t, rate));
+	sample_textfile_family(fp, "stress_ng_instructions_per_cycle", "gauge",
+		"Instructions per cycle over the last sample (--perf).",
+		round, n, offsetof(sample_t, ipc));
+	sample_textfile_family(fp, "stress_ng_cache_miss_percent", "gauge",
+		"Cache misses as a percentage of references (--perf).",
+		round, n, offsetof(sample_t, cache_miss));
+	sample_textfile_family(fp, "stress_ng_context_switches_per_second", "gauge",
+		"Context switches per second (--perf).",
+		round, n, offsetof(sample_t, ctxt_sw_rate));
+	sample_textfile_family(fp, "stress_ng_cpu_migrations_per_second", "gauge",
+		"CPU migrations per second (--perf).",
+		round, n, offsetof(sample_t, migration_rate));
+#if defined(STRESS_THERMAL_ZONES)
+	if ((opt_flags & OPT_FLAGS_THERMAL_ZONES) && shared->tz_info) {
+		stress_tz_t tz;
+		const tz_info_t *tz_info;
+
+		memset(&tz, 0, sizeof(tz));
+		(void)tz_get_temperatures(&shared->tz_info, &tz);
+		fprintf(fp, "# HELP stress_ng_thermal_zone_celsius Thermal zone temperature.\n"
+			"# TYPE stress_ng_thermal_zone_celsius gauge\n");
+		for (tz_info = shared->tz_info; tz_info; tz_info = tz_info->next)
+			fprintf(fp, "stress_ng_thermal_zone_celsius{zone=\"%s\",type=\"%s\"} %.3f\n",
+				tz_info->path, tz_info->type,
+				(double)tz.tz_stat[tz_info->index].temperature / 1000.0);
+	}
+#endif
+	if (fclose(fp) || (rename(tmp, opt_sample_textfile) < 0))
+		(void)unlink(tmp);
+}
+
+/*
+ *  sample_counters()
+ *	sum the bogo op counters of all the instances of
+ *	each running stressor and record them with the
+ *	rate since the previous sample
+ */
+static void sample_counters(
+	uint64_t last_counter[STRESS_MAX],
+	uint64_t last_perf[STRESS_MAX][SAMPLE_PERF_MAX],
+	double *last_time)
+{
+	int32_t i;
+	const double now = time_now();
+	const double t = now - sample_time_start;
+	const double dt = now - *last_time;
+	sample_t round[STRESS_MAX];
+	size_t n_round = 0;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		int32_t j, n = sample_procs[i].stats_index;
+		uint64_t total = 0;
+		sample_t sample;
+
+		if (!sample_procs[i].num_procs ||
+		    !sample_procs[i].started_procs)
+			continue;
+
+		for (j = 0; j < sample_procs[i].started_procs; j++, n++)
+			total += shared->counters[n].counter;
+
+		sample.time = t;
+		sample.id = i;
+		sample.instances = sample_procs[i].started_procs;
+		sample.counter = total;
+		sample.rate = (dt > 0.0) ?
+			(double)(total - last_counter[i]) / dt : 0.0;
+		sample.ipc = -1.0;
+		sample.cache_miss = -1.0;
+		sample.ctxt_sw_rate = -1.0;
+		sample.migration_rate = -1.0;
+		last_counter[i] = total;
+#if defined(STRESS_PERF_STATS)
+		if (sample_perf_enabled())
+			sample_perf(&sample, i, last_perf[i], dt);
+#else
+		(void)last_perf;
+#endif
+		sample_add(&sample);
+		round[n_round++] = sample;
+		if (opt_converge)
+			sample_converge(i, t, sample.rate);
+	}
+	*last_time = now;
+	if (opt_sample_textfile)
+		sample_textfile(round, n_round, t);
+}
+
+/*
+ *  sample_thread()
+ *	periodically sample the stressor bogo op counters
+ *	until told to stop
+ */
+static void *sample_thread(void *arg)
+{
+	static void *nowt = NULL;
+	uint64_t last_counter[STRESS_MAX];
+	uint64_t last_perf[STRESS_MAX][SAMPLE_PERF_MAX];
+	double last_time = time_now();
+	sigset_t set;
+	struct timespec abstime;
+
+	(void)arg;
+
+	/* Leave all signal handling to the main parent thread */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	memset(last_counter, 0, sizeof(last_counter));
+	memset(last_perf, 0, sizeof(last_perf));
+	(void)clock_gettime(CLOCK_REALTIME, &abstime);
+
+	pthread_mutex_lock(&sample_mutex);
+	while (sample_keep_sampling) {
+		abstime.tv_sec += opt_sample_interval / 1000;
+		abstime.tv_nsec += (opt_sample_interval % 1000) * 1000000;
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_nsec -= 1000000000;
+			abstime.tv_sec++;
+		}
+		/* Sleep until the next sample is due or we are stopped */
+		while (sample_keep_sampling &&
+		       (pthread_cond_timedwait(&sample_cond, &sample_mutex, &abstime) == 0))
+			;
+		sample_counters(last_counter, last_perf, &last_time);
+	}
+	pthread_mutex_unlock(&sample_mutex);
+
+	return &nowt;
+}
+
+/*
+ *  sample_start()
+ *	start sampling the counters of the given stressors,
+ *	the stressors must have been started
+ */
+int sample_start(
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	int ret;
+	int32_t i;
+
+	sample_stressors = stressors;
+	sample_procs = procs;
+	for (i = 0; i < STRESS_MAX; i++) {
+		converge[i].last_rate = 0.0;
+		converge[i].windows = 0;
+		converge[i].time = -1.0;
+		converge[i].rate = 0.0;
+	}
+
+	if (sample_time_start < 0.0)
+		sample_time_start = time_now();
+
+	if (opt_sample_file && !sample_csv) {
+		sample_csv = fopen(opt_sample_file, "w");
+		if (!sample_csv) {
+			pr_err(stderr, "Cannot output sample data to %s\n",
+				opt_sample_file);
+			opt_sample_file = NULL;
+		} else {
+			fprintf(sample_csv, "time,stressor,bogo-ops,bogo-ops-per-second%s\n",
+				sample_perf_enabled() ?
+				",instructions-per-cycle,cache-miss-percent,"
+				"context-switches-per-second,cpu-migrations-per-second" : "");
+		}
+	}
+
+	sample_keep_sampling = true;
+	ret = pthread_create(&sample_pthread, NULL, sample_thread, NULL);
+	if (ret) {
+		pr_err(stderr, "sample: cannot create sampling thread: "
+			"errno=%d (%s)\n", ret, strerror(ret));
+		return -1;
+	}
+	sample_pthread_running = true;
+
+	return 0;
+}
+
+/*
+ *  sample_stop()
+ *	stop sampling and wait for the sample thread to finish
+ */
+void sample_stop(void)
+{
+	if (!sample_pthread_running)
+		return;
+
+	pthread_mutex_lock(&sample_mutex);
+	sample_keep_sampling = false;
+	pthread_cond_signal(&sample_cond);
+	pthread_mutex_unlock(&sample_mutex);
+	(void)pthread_join(sample_pthread, NULL);
+	sample_pthread_running = false;
+
+	if (sample_csv)
+		fflush(sample_csv);
+}
+
+/*
+ *  sample_converge_dump()
+ *	dump when each stressor of the last run converged
+ */
+static void sample_converge_dump(
+	FILE *yaml,
+	json_t *json,
+	const stress_t stressors[])
+{
+	int32_t i;
+
+	pr_yaml(yaml, "converge:\n");
+	pr_yaml(yaml, "    tolerance-percent: %" PRIu64 "\n", opt_converge);
+	pr_yaml(yaml, "    windows: %" PRIu32 "\n", opt_converge_windows);
+	pr_yaml(yaml, "    stressors:\n");
+	json_obj_begin(json, "converge");
+	json_uint(json, "tolerance-percent", opt_converge);
+	json_uint(json, "windows", opt_converge_windows);
+	json_array_begin(json, "stressors");
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		const char *name;
+		const bool converged = converge[i].time >= 0.0;
+
+		if (!sample_procs || !sample_procs[i].started_procs)
+			continue;
+		name = munge_underscore(stressors[i].name);
+		if (!converged)
+			pr_inf(stdout, "converge: %s did not settle within "
+				"%" PRIu64 "%% before the timeout\n",
+				name, opt_converge);
+
+		pr_yaml(yaml, "      - stressor: %s\n", name);
+		pr_yaml(yaml, "        converged: %s\n", converged ? "true" : "false");
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", name);
+		json_bool(json, "converged", converged);
+		if (converged) {
+			pr_yaml(yaml, "        time: %f\n", converge[i].time);
+			pr_yaml(yaml, "        bogo-ops-per-second: %f\n", converge[i].rate);
+			json_double(json, "time", converge[i].time);
+			json_double(json, "bogo-ops-per-second", converge[i].rate);
+		}
+		json_obj_end(json);
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+	json_obj_end(json);
+}
+
+/*
+ *  sample_dump()
+ *	dump the samples to the yaml file
+ */
+void sample_dump(FILE *yaml, json_t *json, const stress_t stressors[])
+{
+	size_t i;
+
+	pr_inf(stdout, "%zu bogo op counter samples taken at %" PRIu64
+		"ms intervals\n", samples_used, opt_sample_interval);
+	if (opt_converge)
+		sample_converge_dump(yaml, json, stressors);
+	pr_yaml(yaml, "samples:\n");
+	json_array_begin(json, "samples");
+
+	for (i = 0; i < samples_used; i++) {
+		const char *name = munge_underscore(stressors[samples[i].id].name);
+
+		pr_yaml(yaml, "    - stressor: %s\n", name);
+		pr_yaml(yaml, "      time: %f\n", samples[i].time);
+		pr_yaml(yaml, "      bogo-ops: %" PRIu64 "\n", samples[i].counter);
+		pr_yaml(yaml, "      bogo-ops-per-second: %f\n", samples[i].rate);
+		if (samples[i].ipc >= 0.0)
+			pr_yaml(yaml, "      instructions-per-cycle: %f\n", samples[i].ipc);
+		if (samples[i].cache_miss >= 0.0)
+			pr_yaml(yaml, "      cache-miss-percent: %f\n", samples[i].cache_miss);
+		if (samples[i].ctxt_sw_rate >= 0.0)
+			pr_yaml(yaml, "      context-switches-per-second: %f\n", samples[i].ctxt_sw_rate);
+		if (samples[i].migration_rate >= 0.0)
+			pr_yaml(yaml, "      cpu-migrations-per-second: %f\n", samples[i].migration_rate);
+
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", name);
+		json_double(json, "time", samples[i].time);
+		json_uint(json, "bogo-ops", samples[i].counter);
+		json_double(json, "bogo-ops-per-second", samples[i].rate);
+		if (samples[i].ipc >= 0.0)
+			json_double(json, "instructions-per-cycle", samples[i].ipc);
+		if (samples[i].cache_miss >= 0.0)
+			json_double(json, "cache-miss-percent", samples[i].cache_miss);
+		if (samples[i].ctxt_sw_rate >= 0.0)
+			json_double(json, "context-switches-per-second", samples[i].ctxt_sw_rate);
+		if (samples[i].migration_rate >= 0.0)
+			json_double(json, "cpu-migrations-per-second", samples[i].migration_rate);
+		json_obj_end(json);
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+}
+
+/*
+ *  sample_free()
+ *	free samples and close the CSV output
+ */
+void sample_free(void)
+{
+	free(samples);
+	samples = NULL;
+	samples_used = 0;
+	samples_size = 0;
+
+	if (sample_csv) {
+		(void)fclose(sample_csv);
+		sample_csv = NULL;
+	}
+}
+
+#endif
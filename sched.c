@@ -28,6 +28,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
 #if (defined(_POSIX_PRIORITY_SCHEDULING) || defined(__linux__)) && \
     !defined(__OpenBSD__)
 #include <sched.h>
@@ -202,3 +205,67 @@ int32_t get_opt_sched(const char *const str)
 		"\n");
 	exit(EXIT_FAILURE);
 }
+
+/*
+ *  timer_jitter_sched()
+ *	run a timer stressor instance as SCHED_FIFO at the
+ *	--timer-jitter-prio priority if one was given
+ */
+void timer_jitter_sched(void)
+{
+#if defined(SCHED_FIFO)
+	if (opt_timer_jitter_prio != UNDEFINED)
+		set_sched(SCHED_FIFO, opt_timer_jitter_prio);
+#endif
+}
+
+#if defined(__linux__) && defined(__NR_sched_setattr) && defined(SCHED_DEADLINE)
+/* struct sched_attr, glibc does not provide it */
+typedef struct {
+	uint32_t size;
+	uint32_t sched_policy;
+	uint64_t sched_flags;
+	int32_t  sched_nice;
+	uint32_t sched_priority;
+	uint64_t sched_runtime;
+	uint64_t sched_deadline;
+	uint64_t sched_period;
+} shim_sched_attr_t;
+
+/*
+ *  sched_set_deadline()
+ *	make the calling thread SCHED_DEADLINE with the given
+ *	runtime, deadline and period in nanoseconds, returns
+ *	-1 with errno set if the kernel refuses, e.g. EBUSY
+ *	when admission control has no bandwidth left
+ */
+int sched_set_deadline(
+	const uint64_t runtime,
+	const uint64_t deadline,
+	const uint64_t period)
+{
+	shim_sched_attr_t attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.sched_policy = SCHED_DEADLINE;
+	attr.sched_runtime = runtime;
+	attr.sched_deadline = deadline;
+	attr.sched_period = period;
+
+	return (int)syscall(__NR_sched_setattr, 0, &attr, 0);
+}
+#else
+int sched_set_deadline(
+	const uint64_t runtime,
+	const uint64_t deadline,
+	const uint64_t period)
+{
+	(void)runtime;
+	(void)deadline;
+	(void)period;
+
+	errno = ENOSYS;
+	return -1;
+}
+#endif
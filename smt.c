@@ -0,0 +1,443 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+static const char *option = "smt-bench";
+
+#if defined(__linux__) && NEED_GLIBC(2,3,0)
+
+#include <sched.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#define SMT_STEP_SECS_DEFAULT	(60)	/* secs per step without --timeout */
+
+/*
+ *  One step of the run, the primary stressor runs one instance
+ *  on the first CPU and the partner one on the sibling CPU
+ */
+typedef struct {
+	int32_t primary;		/* index into stressors[] */
+	int32_t partner;		/* index into stressors[], -1 = alone */
+	double rate;			/* bogo ops/sec of the primary instance */
+	bool done;			/* step was run */
+} smt_step_t;
+
+static bool opt_smt_bench;
+static int32_t smt_cpus[2] = { -1, -1 };	/* first CPU and its sibling */
+static smt_step_t *smt_steps;
+static uint32_t smt_steps_count;
+static int32_t smt_primary = -1;		/* primary of the current step */
+
+/*
+ *  stress_set_smt_bench()
+ *	enable the SMT sibling interference run
+ */
+void stress_set_smt_bench(void)
+{
+	opt_smt_bench = true;
+}
+
+/*
+ *  stress_set_smt_cpus()
+ *	set the pair of CPUs to use, "X,Y"
+ */
+int stress_set_smt_cpus(const char *optarg)
+{
+	const int32_t max_cpus = stress_get_processors_configured();
+	int x, y;
+
+	if ((sscanf(optarg, "%d,%d", &x, &y) != 2) ||
+	    (x < 0) || (y < 0) || (x >= max_cpus) || (y >= max_cpus)) {
+		fprintf(stderr, "smt-cpus must be two CPUs X,Y in the range "
+			"0 to %" PRId32 "\n", max_cpus - 1);
+		return -1;
+	}
+	smt_cpus[0] = x;
+	smt_cpus[1] = y;
+	opt_smt_bench = true;
+
+	return 0;
+}
+
+/*
+ *  stress_smt_enabled()
+ *	true if the run is split into SMT interference steps
+ */
+bool stress_smt_enabled(void)
+{
+	return opt_smt_bench;
+}
+
+/*
+ *  stress_smt_steps()
+ *	number of SMT interference steps
+ */
+int stress_smt_steps(void)
+{
+	return (int)smt_steps_count;
+}
+
+/*
+ *  smt_siblings()
+ *	find the first core with two allowed online hardware threads
+ */
+static int smt_siblings(void)
+{
+	cpu_set_t allowed;
+	cpus_t *cpus;
+	uint32_t i, k;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		return -1;
+	cpus = get_all_cpu_cache_details();
+	if (!cpus)
+		return -1;
+
+	for (i = 0; (smt_cpus[0] < 0) && (i < cpus->count); i++) {
+		const cpu_t *c1 = &cpus->cpus[i];
+
+		if (!c1->online || (c1->core_id < 0) ||
+		    (c1->id >= CPU_SETSIZE) || !CPU_ISSET(c1->id, &allowed))
+			continue;
+		for (k = i + 1; k < cpus->count; k++) {
+			const cpu_t *c2 = &cpus->cpus[k];
+
+			if (c2->online && (c2->core_id == c1->core_id) &&
+			    (c2->package_id == c1->package_id) &&
+			    (c2->id < CPU_SETSIZE) && CPU_ISSET(c2->id, &allowed)) {
+				smt_cpus[0] = c1->id;
+				smt_cpus[1] = c2->id;
+				break;
+			}
+		}
+	}
+	free_cpu_caches(cpus);
+
+	return (smt_cpus[0] < 0) ? -1 : 0;
+}
+
+/*
+ *  stress_smt_init()
+ *	build the steps, for each stressor given: alone, paired
+ *	with itself and paired with each of the other stressors.
+ *	The --timeout is shared evenly between the steps and each
+ *	stressor is sized for two instances. Returns the number of
+ *	steps or -1
+ */
+int stress_smt_init(const stress_t stressors[], proc_info_t procs[STRESS_MAX])
+{
+	int32_t used[STRESS_MAX];
+	uint32_t n_used = 0, a, b, s = 0;
+	int32_t i;
+	uint64_t secs;
+
+	(void)stressors;
+
+	if ((smt_cpus[0] < 0) && (smt_siblings() < 0)) {
+		pr_err(stderr, "%s: no SMT sibling CPUs found, use --smt-cpus "
+			"to choose two CPUs\n", option);
+		return -1;
+	}
+	for (i = 0; i < STRESS_MAX; i++) {
+		if (procs[i].num_procs && !procs[i].exclude)
+			used[n_used++] = i;
+	}
+	if (!n_used) {
+		pr_err(stderr, "%s: no stressors given\n", option);
+		return -1;
+	}
+
+	smt_steps_count = n_used * (n_used + 1);
+	smt_steps = calloc(smt_steps_count, sizeof(*smt_steps));
+	if (!smt_steps) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " steps\n",
+			option, smt_steps_count);
+		return -1;
+	}
+	for (a = 0; a < n_used; a++) {
+		smt_steps[s].primary = used[a];
+		smt_steps[s++].partner = -1;
+		for (b = 0; b < n_used; b++) {
+			/* Paired with itself first, then the others */
+			const uint32_t k = (a + b) % n_used;
+
+			smt_steps[s].primary = used[a];
+			smt_steps[s++].partner = used[k];
+		}
+	}
+
+	secs = opt_timeout ? opt_timeout / smt_steps_count : SMT_STEP_SECS_DEFAULT;
+	if (!secs) {
+		pr_err(stderr, "%s: a timeout of %" PRIu64 " seconds is too "
+			"short for %" PRIu32 " steps\n", option, opt_timeout,
+			smt_steps_count);
+		return -1;
+	}
+	opt_timeout = secs;
+
+	for (a = 0; a < n_used; a++)
+		procs[used[a]].num_procs = 2;
+
+	pr_inf(stdout, "%s: CPUs %" PRId32 " and %" PRId32 ", %" PRIu32
+		" steps of %" PRIu64 " seconds\n", option, smt_cpus[0],
+		smt_cpus[1], smt_steps_count, secs);
+	return (int)smt_steps_count;
+}
+
+/*
+ *  stress_smt_step()
+ *	set up the stressors for a step and clear the counters and
+ *	stats of the previous step, returns the instances to start
+ */
+int32_t stress_smt_step(
+	const uint32_t step,
+	const stress_t stressors[],
+	proc_info_t procs[STRESS_MAX])
+{
+	const smt_step_t *ss = &smt_steps[step];
+	char primary[64];
+	int32_t i;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		procs[i].num_procs = 0;
+		procs[i].started_procs = 0;
+		procs[i].bogo_ops = 0;
+		if (procs[i].pids)
+			memset(procs[i].pids, 0, sizeof(pid_t) * (size_t)procs[i].stats_count);
+	}
+	procs[ss->primary].num_procs++;
+	if (ss->partner >= 0)
+		procs[ss->partner].num_procs++;
+	stress_stats_clear();
+	smt_primary = ss->primary;
+
+	/* munge_underscore() returns a static buffer */
+	snprintf(primary, sizeof(primary), "%s",
+		munge_underscore(stressors[ss->primary].name));
+	pr_inf(stdout, "%s: step %" PRIu32 " of %" PRIu32 ", %s%s%s\n",
+		option, step + 1, smt_steps_count, primary,
+		ss->partner < 0 ? " alone" : " with ",
+		ss->partner < 0 ? "" : munge_underscore(stressors[ss->partner].name));
+
+	return (ss->partner < 0) ? 1 : 2;
+}
+
+/*
+ *  stress_smt_pin()
+ *	pin a stressor instance of the current step, the first
+ *	instance of the primary stressor gets the first CPU and
+ *	the other instance gets the sibling
+ */
+void stress_smt_pin(const char *name, const int32_t stressor, const uint32_t instance)
+{
+	cpu_set_t set;
+	const int32_t cpu = ((stressor == smt_primary) && (instance == 0)) ?
+		smt_cpus[0] : smt_cpus[1];
+
+	if (smt_primary < 0)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		pr_dbg(stderr, "%s: cannot pin to CPU %" PRId32 ", errno=%d (%s)\n",
+			name, cpu, errno, strerror(errno));
+		return;
+	}
+	pr_dbg(stderr, "%s: pinned to CPU %" PRId32 "\n", name, cpu);
+}
+
+/*
+ *  stress_smt_record()
+ *	save the throughput of the primary instance over a step
+ */
+void stress_smt_record(const uint32_t step, const proc_info_t procs[STRESS_MAX])
+{
+	smt_step_t *ss = &smt_steps[step];
+	const int32_t n = procs[ss->primary].stats_index;
+	uint64_t ops = shared->counters[n].counter;
+	const double real = shared->stats[n].finish - shared->stats[n].start;
+
+#if defined(STRESS_WARMUP)
+	ops -= shared->stats[n].warmup_counter;
+#endif
+	ss->rate = (real > 0.0) ? (double)ops / real : 0.0;
+	ss->done = true;
+	smt_primary = -1;
+}
+
+/*
+ *  stress_smt_dump()
+ *	report the bogo op rate of each stressor alone and the
+ *	slowdown when each partner runs on the sibling CPU
+ */
+void stress_smt_dump(FILE *yaml, json_t *json, const stress_t stressors[])
+{
+	uint32_t s;
+
+	if (!smt_steps_count)
+		return;
+
+	pr_inf(stdout, "%s: %-13s %14s %-13s %14s %9s\n", option,
+		"stressor", "alone ops/s", "sibling", "paired ops/s", "slowdown");
+	pr_yaml(yaml, "smt-interference:\n");
+	pr_yaml(yaml, "    cpus: [ %" PRId32 ", %" PRId32 " ]\n",
+		smt_cpus[0], smt_cpus[1]);
+	pr_yaml(yaml, "    results:\n");
+	json_obj_begin(json, "smt-interference");
+	json_int(json, "cpu", smt_cpus[0]);
+	json_int(json, "sibling-cpu", smt_cpus[1]);
+	json_array_begin(json, "results");
+
+	for (s = 0; s < smt_steps_count; s++) {
+		const smt_step_t *alone = &smt_steps[s];
+		char munged[64];
+
+		if (alone->partner >= 0)
+			continue;
+		snprintf(munged, sizeof(munged), "%s",
+			munge_underscore(stressors[alone->primary].name));
+		pr_yaml(yaml, "      - stressor: %s\n", munged);
+		pr_yaml(yaml, "        alone: %f\n", alone->rate);
+		pr_yaml(yaml, "        paired:\n");
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_double(json, "alone", alone->rate);
+		json_array_begin(json, "paired");
+
+		for (s++; (s < smt_steps_count) && (smt_steps[s].partner >= 0); s++) {
+			const smt_step_t *ss = &smt_steps[s];
+			const char *partner = munge_underscore(stressors[ss->partner].name);
+			/* Slowdown of the primary caused by the partner, in % */
+			const double slowdown = (alone->done && ss->done &&
+				(alone->rate > 0.0)) ?
+				100.0 * (alone->rate - ss->rate) / alone->rate : 0.0;
+
+			if (!ss->done)
+				continue;
+			pr_inf(stdout, "%s: %-13s %14.2f %-13s %14.2f %8.2f%%\n",
+				option, munged, alone->rate, partner,
+				ss->rate, slowdown);
+			pr_yaml(yaml, "        - with: %s\n", partner);
+			pr_yaml(yaml, "          bogo-ops-per-second: %f\n", ss->rate);
+			pr_yaml(yaml, "          slowdown-percent: %f\n", slowdown);
+			json_obj_begin(json, NULL);
+			json_str(json, "with", partner);
+			json_double(json, "bogo-ops-per-second", ss->rate);
+			json_double(json, "slowdown-percent", slowdown);
+			json_obj_end(json);
+		}
+		s--;
+		json_array_end(json);
+		json_obj_end(json);
+	}
+	pr_yaml(yaml, "\n");
+	json_array_end(json);
+	json_obj_end(json);
+}
+
+/*
+ *  stress_smt_free()
+ *	free the steps
+ */
+void stress_smt_free(void)
+{
+	free(smt_steps);
+	smt_steps = NULL;
+	smt_steps_count = 0;
+}
+
+#else
+void stress_set_smt_bench(void)
+{
+	fprintf(stderr, "%s: SMT interference runs not supported\n", option);
+	exit(EXIT_FAILURE);
+}
+
+int stress_set_smt_cpus(const char *optarg)
+{
+	(void)optarg;
+
+	fprintf(stderr, "%s: SMT interference runs not supported\n", option);
+	return -1;
+}
+
+bool stress_smt_enabled(void)
+{
+	return false;
+}
+
+int stress_smt_steps(void)
+{
+	return 0;
+}
+
+int stress_smt_init(const stress_t stressors[], proc_info_t procs[STRESS_MAX])
+{
+	(void)stressors;
+	(void)procs;
+
+	return -1;
+}
+
+int32_t stress_smt_step(
+	const uint32_t step,
+	const stress_t stressors[],
+	proc_info_t procs[STRESS_MAX])
+{
+	(void)step;
+	(void)stressors;
+	(void)procs;
+
+	return 0;
+}
+
+void stress_smt_pin(const char *name, const int32_t stressor, const uint32_t instance)
+{
+	(void)name;
+	(void)stressor;
+	(void)instance;
+}
+
+void stress_smt_record(const uint32_t step, const proc_info_t procs[STRESS_MAX])
+{
+	(void)step;
+	(void)procs;
+}
+
+void stress_smt_dump(FILE *yaml, json_t *json, const stress_t stressors[])
+{
+	(void)yaml;
+	(void)json;
+	(void)stressors;
+}
+
+void stress_smt_free(void)
+{
+}
+#endif
@@ -33,10 +33,17 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <linux/if_alg.h>
 #include <linux/socket.h>
 
+#if defined(HAVE_LIB_CRYPTO)
+#include <openssl/evp.h>
+#endif
+
 #if !defined(SOL_ALG)
 #define SOL_ALG			(279)
 #endif
@@ -408,6 +415,546 @@ static int stress_af_alg_rng(
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  Throughput mode: MB/s of a few TLS relevant algorithms at several
+ *  buffer sizes, through sendmsg() copies, through vmsplice() and
+ *  splice() zero copy, and through OpenSSL in user space
+ */
+#define AF_ALG_TP_TIME		(0.1)	/* seconds per algorithm, size and path */
+#define AF_ALG_TP_MAX_SIZE	(64 * KB)
+
+#define AF_ALG_TP_SENDMSG	(0)
+#define AF_ALG_TP_SPLICE	(1)
+#define AF_ALG_TP_OPENSSL	(2)
+#define AF_ALG_TP_PATHS		(3)
+
+typedef struct {
+	const char *name;		/* kernel crypto API name */
+	const char *type;		/* hash or skcipher */
+	const ssize_t out_size;		/* digest size, 0 for ciphers */
+	const ssize_t key_size;		/* cipher key size */
+	const ssize_t iv_size;		/* cipher IV size */
+#if defined(HAVE_LIB_CRYPTO)
+	const EVP_MD *(*md)(void);	/* OpenSSL digest */
+	const EVP_CIPHER *(*cipher)(void); /* OpenSSL cipher */
+#endif
+} alg_tp_info_t;
+
+#if defined(HAVE_LIB_CRYPTO)
+#define AF_ALG_TP_HASH(name, size, md)	\
+	{ name, "hash", size, 0, 0, md, NULL }
+#define AF_ALG_TP_CIPHER(name, key, iv, cipher)	\
+	{ name, "skcipher", 0, key, iv, NULL, cipher }
+#else
+#define AF_ALG_TP_HASH(name, size, md)	\
+	{ name, "hash", size, 0, 0 }
+#define AF_ALG_TP_CIPHER(name, key, iv, cipher)	\
+	{ name, "skcipher", 0, key, iv }
+#endif
+
+static const alg_tp_info_t algo_tp_info[] = {
+	AF_ALG_TP_HASH("sha1",		SHA1_DIGEST_SIZE,	EVP_sha1),
+	AF_ALG_TP_HASH("sha256",	SHA256_DIGEST_SIZE,	EVP_sha256),
+	AF_ALG_TP_HASH("sha512",	SHA512_DIGEST_SIZE,	EVP_sha512),
+	AF_ALG_TP_CIPHER("cbc(aes)",	AES_MAX_KEY_SIZE, AES_BLOCK_SIZE, EVP_aes_256_cbc),
+	AF_ALG_TP_CIPHER("ctr(aes)",	AES_MAX_KEY_SIZE, AES_BLOCK_SIZE, EVP_aes_256_ctr),
+};
+
+static const size_t algo_tp_sizes[] = {
+	64, 1 * KB, 16 * KB, 64 * KB
+};
+
+static const char *algo_tp_paths[AF_ALG_TP_PATHS] = {
+	"sendmsg", "splice", "openssl"
+};
+
+#define AF_ALG_TP_ALGS		(SIZEOF_ARRAY(algo_tp_info))
+#define AF_ALG_TP_SIZES		(SIZEOF_ARRAY(algo_tp_sizes))
+
+typedef struct {
+	uint64_t bytes;			/* bytes processed */
+	double duration;		/* time taken */
+} alg_tp_stats_t;
+
+typedef struct {
+	uint8_t *in;			/* page aligned input */
+	uint8_t *out;			/* output */
+	int pipefds[2];			/* vmsplice/splice pipe */
+	alg_tp_stats_t stats[AF_ALG_TP_ALGS][AF_ALG_TP_SIZES][AF_ALG_TP_PATHS];
+	char driver[AF_ALG_TP_ALGS][64]; /* kernel driver used */
+	bool missing[AF_ALG_TP_ALGS];	/* not in this kernel */
+	bool no_af_alg;			/* no AF_ALG, user space only */
+} alg_tp_t;
+
+static bool opt_af_alg_throughput = false;
+
+void stress_set_af_alg_throughput(void)
+{
+	opt_af_alg_throughput = true;
+}
+
+/*
+ *  stress_af_alg_driver()
+ *	find the highest priority driver of an algorithm in
+ *	/proc/crypto, this is the one AF_ALG binds to and shows
+ *	whether an offload engine such as QAT or CCP is in use
+ */
+static void stress_af_alg_driver(const char *alg, char *driver, const size_t len)
+{
+	FILE *fp;
+	char line[256], name[64] = "", drv[64] = "";
+	long prio, best = -1;
+
+	(void)snprintf(driver, len, "unknown");
+	fp = fopen("/proc/crypto", "r");
+	if (!fp)
+		return;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "name : %63s", name) == 1)
+			continue;
+		if (sscanf(line, "driver : %63s", drv) == 1)
+			continue;
+		if ((sscanf(line, "priority : %ld", &prio) == 1) &&
+		    !strcmp(name, alg) && (prio > best)) {
+			best = prio;
+			(void)snprintf(driver, len, "%s", drv);
+		}
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  stress_af_alg_tp_cipher_op()
+ *	queue the encrypt operation and a fresh IV, with the
+ *	data too for the sendmsg path
+ */
+static int stress_af_alg_tp_cipher_op(
+	const int fd,
+	const ssize_t iv_size,
+	void *data,
+	const size_t len,
+	const int flags)
+{
+	__u32 *u32ptr;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	char cbuf[CMSG_SPACE(sizeof(__u32)) + CMSG_SPACE(4) + CMSG_SPACE(AES_BLOCK_SIZE)];
+	struct af_alg_iv *iv;
+	struct iovec iov;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(cbuf, 0, sizeof(cbuf));
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_OP;
+	cmsg->cmsg_len = CMSG_LEN(4);
+	u32ptr = (__u32 *)CMSG_DATA(cmsg);
+	*u32ptr = ALG_OP_ENCRYPT;
+
+	cmsg = CMSG_NXTHDR(&msg, cmsg);
+	cmsg->cmsg_level = SOL_ALG;
+	cmsg->cmsg_type = ALG_SET_IV;
+	cmsg->cmsg_len = CMSG_LEN(4) + CMSG_LEN(iv_size);
+	iv = (void *)CMSG_DATA(cmsg);
+	iv->ivlen = iv_size;
+	memset(iv->iv, 0x5a, iv_size);
+
+	iov.iov_base = data;
+	iov.iov_len = len;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	return (sendmsg(fd, &msg, flags) == (ssize_t)len) ? 0 : -1;
+}
+
+/*
+ *  stress_af_alg_tp_splice()
+ *	move a buffer into the operation socket without copying it,
+ *	vmsplice the pages into a pipe and splice them to the socket
+ */
+static int stress_af_alg_tp_splice(alg_tp_t *tp, const int fd, const size_t len)
+{
+	struct iovec iov;
+	size_t n = 0;
+
+	iov.iov_base = tp->in;
+	iov.iov_len = len;
+	if (vmsplice(tp->pipefds[1], &iov, 1, 0) != (ssize_t)len)
+		return -1;
+	while (n < len) {
+		const ssize_t ret = splice(tp->pipefds[0], NULL, fd, NULL,
+			len - n, 0);
+
+		if (ret <= 0)
+			return -1;
+		n += (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_af_alg_tp_kernel()
+ *	time one algorithm at one buffer size through AF_ALG, returns
+ *	the bytes processed or -1 on failure
+ */
+static int64_t stress_af_alg_tp_kernel(
+	const char *name,
+	alg_tp_t *tp,
+	const alg_tp_info_t *info,
+	const int fd,
+	const size_t len,
+	const int path,
+	double *duration)
+{
+	const ssize_t out_len = info->out_size ? info->out_size : (ssize_t)len;
+	const double t_start = time_now();
+	const double t_end = t_start + AF_ALG_TP_TIME;
+	int64_t bytes = 0;
+
+	do {
+		int ret;
+
+		if (info->out_size) {
+			if (path == AF_ALG_TP_SPLICE)
+				ret = stress_af_alg_tp_splice(tp, fd, len);
+			else
+				ret = (send(fd, tp->in, len, 0) == (ssize_t)len) ? 0 : -1;
+		} else {
+			if (path == AF_ALG_TP_SPLICE) {
+				ret = stress_af_alg_tp_cipher_op(fd, info->iv_size,
+					NULL, 0, MSG_MORE);
+				if (!ret)
+					ret = stress_af_alg_tp_splice(tp, fd, len);
+			} else {
+				ret = stress_af_alg_tp_cipher_op(fd, info->iv_size,
+					tp->in, len, 0);
+			}
+		}
+		if (ret < 0) {
+			pr_fail(stderr, "%s: %s %s of %zu bytes failed, errno=%d (%s)\n",
+				name, info->name, algo_tp_paths[path], len,
+				errno, strerror(errno));
+			return -1;
+		}
+		if (read(fd, tp->out, out_len) != out_len) {
+			pr_fail_err(name, "read");
+			return -1;
+		}
+		bytes += len;
+	} while (opt_do_run && (time_now() < t_end));
+	*duration = time_now() - t_start;
+
+	return bytes;
+}
+
+#if defined(HAVE_LIB_CRYPTO)
+/*
+ *  stress_af_alg_tp_openssl()
+ *	time one algorithm at one buffer size with OpenSSL, which
+ *	uses AES-NI, SHA-NI and friends when the CPU has them
+ */
+static int64_t stress_af_alg_tp_openssl(
+	const char *name,
+	alg_tp_t *tp,
+	const alg_tp_info_t *info,
+	const size_t len,
+	double *duration)
+{
+	const double t_start = time_now();
+	const double t_end = t_start + AF_ALG_TP_TIME;
+	unsigned char key[AES_MAX_KEY_SIZE], iv[AES_BLOCK_SIZE];
+	EVP_CIPHER_CTX *ctx = NULL;
+	int64_t bytes = 0;
+
+	memset(key, 0xa5, sizeof(key));
+	memset(iv, 0x5a, sizeof(iv));
+	if (info->cipher) {
+		ctx = EVP_CIPHER_CTX_new();
+		if (!ctx || !EVP_EncryptInit_ex(ctx, info->cipher(), NULL, key, iv)) {
+			pr_fail(stderr, "%s: OpenSSL %s setup failed\n",
+				name, info->name);
+			EVP_CIPHER_CTX_free(ctx);
+			return -1;
+		}
+		(void)EVP_CIPHER_CTX_set_padding(ctx, 0);
+	}
+
+	do {
+		int ok, outl;
+
+		if (ctx) {
+			/* A fresh IV per operation, as the AF_ALG paths do */
+			ok = EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv) &&
+			     EVP_EncryptUpdate(ctx, tp->out, &outl, tp->in, (int)len);
+		} else {
+			ok = EVP_Digest(tp->in, len, tp->out, NULL, info->md(), NULL);
+		}
+		if (!ok) {
+			pr_fail(stderr, "%s: OpenSSL %s of %zu bytes failed\n",
+				name, info->name, len);
+			EVP_CIPHER_CTX_free(ctx);
+			return -1;
+		}
+		bytes += len;
+	} while (opt_do_run && (time_now() < t_end));
+	*duration = time_now() - t_start;
+	EVP_CIPHER_CTX_free(ctx);
+
+	return bytes;
+}
+#endif
+
+/*
+ *  stress_af_alg_tp_alg()
+ *	measure one algorithm at all buffer sizes over all paths
+ */
+static int stress_af_alg_tp_alg(
+	uint64_t *const counter,
+	const char *name,
+	alg_tp_t *tp,
+	const size_t alg)
+{
+	const alg_tp_info_t *info = &algo_tp_info[alg];
+	struct sockaddr_alg sa;
+	int sockfd = -1, fd = -1, rc = EXIT_FAILURE;
+	size_t i;
+
+	if (tp->no_af_alg)
+		goto measure;
+	sockfd = socket(AF_ALG, SOCK_SEQPACKET, 0);
+	if (sockfd < 0) {
+		pr_fail_err(name, "socket");
+		return EXIT_FAILURE;
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.salg_family = AF_ALG;
+	strncpy((char *)sa.salg_type, info->type, sizeof(sa.salg_type) - 1);
+	strncpy((char *)sa.salg_name, info->name, sizeof(sa.salg_name) - 1);
+	if (bind(sockfd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		(void)close(sockfd);
+		if (errno == ENOENT) {
+			tp->missing[alg] = true;
+			return EXIT_SUCCESS;
+		}
+		pr_fail_err(name, "bind");
+		return EXIT_FAILURE;
+	}
+	if (info->key_size) {
+		char key[AES_MAX_KEY_SIZE];
+
+		memset(key, 0xa5, sizeof(key));
+		if (setsockopt(sockfd, SOL_ALG, ALG_SET_KEY, key, info->key_size) < 0) {
+			pr_fail_err(name, "setsockopt");
+			goto close_sock;
+		}
+	}
+	fd = accept(sockfd, NULL, 0);
+	if (fd < 0) {
+		pr_fail_err(name, "accept");
+		goto close_sock;
+	}
+
+measure:
+	for (i = 0; opt_do_run && (i < AF_ALG_TP_SIZES); i++) {
+		int path;
+
+		for (path = 0; opt_do_run && (path < AF_ALG_TP_PATHS); path++) {
+			alg_tp_stats_t *s = &tp->stats[alg][i][path];
+			double duration = 0.0;
+			int64_t bytes;
+
+			if ((fd < 0) && (path != AF_ALG_TP_OPENSSL))
+				continue;
+#if defined(HAVE_LIB_CRYPTO)
+			if (path == AF_ALG_TP_OPENSSL)
+				bytes = stress_af_alg_tp_openssl(name, tp, info,
+					algo_tp_sizes[i], &duration);
+			else
+#else
+			if (path == AF_ALG_TP_OPENSSL)
+				continue;
+#endif
+				bytes = stress_af_alg_tp_kernel(name, tp, info, fd,
+					algo_tp_sizes[i], path, &duration);
+			if (bytes < 0)
+				goto close_fd;
+			s->bytes += (uint64_t)bytes;
+			s->duration += duration;
+			(*counter)++;
+		}
+	}
+	rc = EXIT_SUCCESS;
+close_fd:
+	if (fd >= 0)
+		(void)close(fd);
+close_sock:
+	if (sockfd >= 0)
+		(void)close(sockfd);
+
+	return rc;
+}
+
+/*
+ *  stress_af_alg_tp_report()
+ *	report MB/s per algorithm, buffer size and path
+ */
+static void stress_af_alg_tp_report(
+	const char *name,
+	const uint32_t instance,
+	alg_tp_t *tp)
+{
+	size_t alg, i, idx = 0;
+
+	if (instance == 0)
+		pr_inf(stderr, "%s: %-9s %-28s %6s %10s %10s %10s\n", name,
+			"algorithm", "driver", "size", "sendmsg", "splice",
+			"openssl");
+
+	for (alg = 0; alg < AF_ALG_TP_ALGS; alg++) {
+		double rate[AF_ALG_TP_SIZES][AF_ALG_TP_PATHS];
+		char desc[40];
+		int path;
+
+		if (tp->missing[alg]) {
+			if (instance == 0)
+				pr_inf(stderr, "%s: %-9s not available\n",
+					name, algo_tp_info[alg].name);
+			continue;
+		}
+		for (i = 0; i < AF_ALG_TP_SIZES; i++) {
+			char str[AF_ALG_TP_PATHS][16], size[24];
+
+			for (path = 0; path < AF_ALG_TP_PATHS; path++) {
+				const alg_tp_stats_t *s = &tp->stats[alg][i][path];
+
+				rate[i][path] = (s->duration > 0.0) ?
+					(double)s->bytes / (s->duration * MB) : 0.0;
+				if (s->duration > 0.0)
+					(void)snprintf(str[path], sizeof(str[path]),
+						"%.2f", rate[i][path]);
+				else
+					(void)snprintf(str[path], sizeof(str[path]), "-");
+			}
+			if (algo_tp_sizes[i] < KB)
+				(void)snprintf(size, sizeof(size), "%zu", algo_tp_sizes[i]);
+			else
+				(void)snprintf(size, sizeof(size), "%zuK",
+					(size_t)(algo_tp_sizes[i] / KB));
+			if (instance == 0)
+				pr_inf(stderr, "%s: %-9s %-28s %6s %10s %10s %10s\n",
+					name, algo_tp_info[alg].name, tp->driver[alg], size,
+					str[AF_ALG_TP_SENDMSG], str[AF_ALG_TP_SPLICE],
+					str[AF_ALG_TP_OPENSSL]);
+		}
+
+		/* Kernel zero copy against user space at the largest size */
+		i = AF_ALG_TP_SIZES - 1;
+		if (!tp->no_af_alg) {
+			(void)snprintf(desc, sizeof(desc), "%s splice MB/s",
+				algo_tp_info[alg].name);
+			stress_misc_metric_set(idx++, desc, rate[i][AF_ALG_TP_SPLICE]);
+		}
+#if defined(HAVE_LIB_CRYPTO)
+		(void)snprintf(desc, sizeof(desc), "%s openssl MB/s",
+			algo_tp_info[alg].name);
+		stress_misc_metric_set(idx++, desc, rate[i][AF_ALG_TP_OPENSSL]);
+#else
+		(void)snprintf(desc, sizeof(desc), "%s sendmsg MB/s",
+			algo_tp_info[alg].name);
+		stress_misc_metric_set(idx++, desc, rate[i][AF_ALG_TP_SENDMSG]);
+#endif
+	}
+}
+
+/*
+ *  stress_af_alg_throughput()
+ *	compare kernel crypto throughput against user space
+ */
+static int stress_af_alg_throughput(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	alg_tp_t *tp;
+	size_t alg;
+	int rc = EXIT_SUCCESS;
+
+	tp = mmap(NULL, sizeof(*tp), PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (tp == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot allocate throughput state, "
+			"skipping stressor\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	tp->in = mmap(NULL, AF_ALG_TP_MAX_SIZE * 2, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (tp->in == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot allocate buffers, "
+			"skipping stressor\n", name);
+		(void)munmap(tp, sizeof(*tp));
+		return EXIT_NO_RESOURCE;
+	}
+	tp->out = tp->in + AF_ALG_TP_MAX_SIZE;
+	stress_strnrnd((char *)tp->in, AF_ALG_TP_MAX_SIZE);
+
+	if (pipe(tp->pipefds) < 0) {
+		pr_fail_err(name, "pipe");
+		rc = EXIT_FAILURE;
+		goto unmap;
+	}
+#if defined(F_SETPIPE_SZ)
+	/* Hold the largest buffer in the pipe */
+	(void)fcntl(tp->pipefds[1], F_SETPIPE_SZ, AF_ALG_TP_MAX_SIZE);
+#endif
+	rc = socket(AF_ALG, SOCK_SEQPACKET, 0);
+	if (rc < 0) {
+		if (errno != EAFNOSUPPORT) {
+			pr_fail_err(name, "socket");
+			rc = EXIT_FAILURE;
+			goto close_pipe;
+		}
+		if (instance == 0)
+			pr_inf(stderr, "%s: AF_ALG is not supported, only "
+				"measuring user space throughput\n", name);
+		tp->no_af_alg = true;
+	} else {
+		(void)close(rc);
+	}
+	rc = EXIT_SUCCESS;
+
+	for (alg = 0; alg < AF_ALG_TP_ALGS; alg++) {
+		if (tp->no_af_alg)
+			(void)snprintf(tp->driver[alg], sizeof(tp->driver[alg]), "-");
+		else
+			stress_af_alg_driver(algo_tp_info[alg].name,
+				tp->driver[alg], sizeof(tp->driver[alg]));
+	}
+
+	do {
+		for (alg = 0; opt_do_run && (alg < AF_ALG_TP_ALGS); alg++) {
+			if (tp->missing[alg])
+				continue;
+			rc = stress_af_alg_tp_alg(counter, name, tp, alg);
+			if (rc != EXIT_SUCCESS)
+				goto close_pipe;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	stress_af_alg_tp_report(name, instance, tp);
+close_pipe:
+	(void)close(tp->pipefds[0]);
+	(void)close(tp->pipefds[1]);
+unmap:
+	(void)munmap(tp->in, AF_ALG_TP_MAX_SIZE * 2);
+	(void)munmap(tp, sizeof(*tp));
+
+	return rc;
+}
+
 /*
  *  stress_af_alg()
  *	stress socket AF_ALG domain
@@ -422,7 +969,8 @@ int stress_af_alg(
 	int retries = MAX_AF_ALG_RETRIES;
 	uint64_t hashfails = 0, cipherfails = 0, rngfails = 0;
 
-	(void)instance;
+	if (opt_af_alg_throughput)
+		return stress_af_alg_throughput(counter, instance, max_ops, name);
 
 	for (;;) {
 		sockfd = socket(AF_ALG, SOCK_SEQPACKET, 0);
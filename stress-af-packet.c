@@ -0,0 +1,446 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_AF_PACKET)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
+#define AF_PACKET_BLOCK_SIZE	(1 * MB)	/* TPACKET_V3 block size */
+#define AF_PACKET_BLOCKS	(16)		/* blocks in the rx ring */
+#define AF_PACKET_FRAME_SIZE	(2048)
+#define AF_PACKET_BLOCK_TOV	(10)		/* block retire timeout, ms */
+#define AF_PACKET_PHASE_TIME	(1.0)		/* seconds per ring/socket phase */
+#define AF_PACKET_BATCH		(64)		/* datagrams per sendmmsg */
+
+#if defined(__NR_sendmmsg) && NEED_GLIBC(2,14,0)
+#define HAVE_AF_PACKET_SENDMMSG
+#endif
+
+static int opt_af_packet_port = DEFAULT_AF_PACKET_PORT;
+static size_t opt_af_packet_size = DEFAULT_AF_PACKET_SIZE;
+
+/* packets captured and dropped by the kernel for a phase */
+typedef struct {
+	uint64_t packets;
+	uint64_t drops;
+	double duration;
+} af_packet_phase_t;
+
+/*
+ *  stress_af_packet_supported()
+ *      check if we can run this as root
+ */
+int stress_af_packet_supported(void)
+{
+	if (geteuid() != 0) {
+		pr_inf(stderr, "af-packet stressor will be skipped, "
+			"need to be running as root for this stressor\n");
+		return -1;
+	}
+	return 0;
+}
+
+void stress_set_af_packet_port(const char *optarg)
+{
+	stress_set_net_port("af-packet-port", optarg,
+		MIN_AF_PACKET_PORT, MAX_AF_PACKET_PORT - STRESS_PROCS_MAX,
+		&opt_af_packet_port);
+}
+
+void stress_set_af_packet_size(const char *optarg)
+{
+	uint64_t size;
+
+	size = get_uint64_byte(optarg);
+	check_range("af-packet-size", size,
+		MIN_AF_PACKET_SIZE, MAX_AF_PACKET_SIZE);
+	opt_af_packet_size = (size_t)size;
+}
+
+/*
+ *  stress_af_packet_sender()
+ *	flood the loopback with UDP datagrams to port
+ */
+static void stress_af_packet_sender(const int port)
+{
+	struct sockaddr_in addr;
+	char buf[MAX_AF_PACKET_SIZE];
+	int fd;
+#if defined(HAVE_AF_PACKET_SENDMMSG)
+	struct mmsghdr msgs[AF_PACKET_BATCH];
+	struct iovec iov;
+	size_t i;
+#endif
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		(void)close(fd);
+		return;
+	}
+	memset(buf, 'P', sizeof(buf));
+
+#if defined(HAVE_AF_PACKET_SENDMMSG)
+	iov.iov_base = buf;
+	iov.iov_len = opt_af_packet_size;
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < AF_PACKET_BATCH; i++) {
+		msgs[i].msg_hdr.msg_iov = &iov;
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	while (opt_do_run) {
+		if ((sendmmsg(fd, msgs, AF_PACKET_BATCH, 0) < 0) &&
+		    (errno != ENOBUFS) && (errno != EAGAIN) &&
+		    (errno != ECONNREFUSED) && (errno != EINTR))
+			break;
+	}
+#else
+	while (opt_do_run) {
+		if ((send(fd, buf, opt_af_packet_size, 0) < 0) &&
+		    (errno != ENOBUFS) && (errno != EAGAIN) &&
+		    (errno != ECONNREFUSED) && (errno != EINTR))
+			break;
+	}
+#endif
+	(void)close(fd);
+}
+
+/*
+ *  stress_af_packet_socket()
+ *	open a cooked IPv4 packet socket on the loopback that
+ *	only sees incoming UDP datagrams to port, optionally
+ *	with a TPACKET_V3 rx ring that is mapped into ring
+ */
+static int stress_af_packet_socket(
+	const char *name,
+	const int port,
+	const struct tpacket_req3 *req,
+	uint8_t **ring)
+{
+	struct sock_filter code[] = {
+		/* drop the copies of our own transmitted packets */
+		BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 5, 0),
+		/* IPv4 protocol is UDP */
+		BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 3),
+		/* UDP destination port, the loopback has no IP options */
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 22),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)port, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, 0xffff),
+		BPF_STMT(BPF_RET | BPF_K, 0),
+	};
+	struct sock_fprog prog;
+	struct sockaddr_ll sll;
+	int fd;
+
+	fd = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_IP));
+	if (fd < 0) {
+		pr_fail_err(name, "socket");
+		return -1;
+	}
+	prog.len = SIZEOF_ARRAY(code);
+	prog.filter = code;
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+		pr_fail_err(name, "setsockopt SO_ATTACH_FILTER");
+		goto err;
+	}
+	if (req) {
+		const int version = TPACKET_V3;
+		void *ptr;
+
+		if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+			pr_fail_err(name, "setsockopt PACKET_VERSION");
+			goto err;
+		}
+		if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, req, sizeof(*req)) < 0) {
+			pr_fail_err(name, "setsockopt PACKET_RX_RING");
+			goto err;
+		}
+		ptr = mmap(NULL, (size_t)req->tp_block_size * req->tp_block_nr,
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+		if (ptr == MAP_FAILED)
+			ptr = mmap(NULL, (size_t)req->tp_block_size * req->tp_block_nr,
+				PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (ptr == MAP_FAILED) {
+			pr_fail_err(name, "mmap");
+			goto err;
+		}
+		*ring = ptr;
+	}
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(ETH_P_IP);
+	sll.sll_ifindex = (int)if_nametoindex("lo");
+	if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+		pr_fail_err(name, "bind");
+		if (req)
+			(void)munmap(*ring, (size_t)req->tp_block_size * req->tp_block_nr);
+		goto err;
+	}
+	return fd;
+err:
+	(void)close(fd);
+	return -1;
+}
+
+/*
+ *  stress_af_packet_ring()
+ *	consume blocks of packets from a TPACKET_V3 rx ring,
+ *	touching each packet header as a real consumer would
+ */
+static int stress_af_packet_ring(
+	const char *name,
+	const int port,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	af_packet_phase_t *phase)
+{
+	struct tpacket_req3 req;
+	struct tpacket_stats_v3 stats;
+	socklen_t len = sizeof(stats);
+	uint8_t *ring = NULL;
+	uint32_t blk = 0;
+	double t_start, t_end;
+	volatile uint32_t snaplen = 0;
+	int fd;
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = AF_PACKET_BLOCK_SIZE;
+	req.tp_block_nr = AF_PACKET_BLOCKS;
+	req.tp_frame_size = AF_PACKET_FRAME_SIZE;
+	req.tp_frame_nr = (AF_PACKET_BLOCK_SIZE / AF_PACKET_FRAME_SIZE) *
+		AF_PACKET_BLOCKS;
+	req.tp_retire_blk_tov = AF_PACKET_BLOCK_TOV;
+
+	fd = stress_af_packet_socket(name, port, &req, &ring);
+	if (fd < 0)
+		return -1;
+
+	t_start = time_now();
+	t_end = t_start + AF_PACKET_PHASE_TIME;
+	while (opt_do_run && (time_now() < t_end) &&
+	       (!max_ops || *counter < max_ops)) {
+		struct tpacket_block_desc *bd = (struct tpacket_block_desc *)
+			(ring + ((size_t)blk * AF_PACKET_BLOCK_SIZE));
+		struct tpacket3_hdr *hdr;
+		uint32_t i, n;
+
+		if (!(bd->hdr.bh1.block_status & TP_STATUS_USER)) {
+			struct pollfd pfd;
+
+			pfd.fd = fd;
+			pfd.events = POLLIN | POLLERR;
+			pfd.revents = 0;
+			(void)poll(&pfd, 1, AF_PACKET_BLOCK_TOV);
+			continue;
+		}
+		n = bd->hdr.bh1.num_pkts;
+		hdr = (struct tpacket3_hdr *)((uint8_t *)bd +
+			bd->hdr.bh1.offset_to_first_pkt);
+		for (i = 0; i < n; i++) {
+			snaplen += hdr->tp_snaplen;
+			hdr = (struct tpacket3_hdr *)((uint8_t *)hdr +
+				hdr->tp_next_offset);
+		}
+		(*counter) += n;
+		phase->packets += n;
+		__sync_synchronize();
+		bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+		blk = (blk + 1) % AF_PACKET_BLOCKS;
+	}
+	phase->duration += time_now() - t_start;
+	if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0)
+		phase->drops += stats.tp_drops;
+
+	(void)munmap(ring, (size_t)req.tp_block_size * req.tp_block_nr);
+	(void)close(fd);
+	return 0;
+}
+
+/*
+ *  stress_af_packet_recv()
+ *	receive the same traffic one packet per recv(2) through
+ *	the regular packet socket path
+ */
+static int stress_af_packet_recv(
+	const char *name,
+	const int port,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	af_packet_phase_t *phase)
+{
+	struct tpacket_stats stats;
+	socklen_t len = sizeof(stats);
+	struct timeval tv;
+	char buf[AF_PACKET_FRAME_SIZE];
+	double t_start, t_end;
+	int fd;
+
+	fd = stress_af_packet_socket(name, port, NULL, NULL);
+	if (fd < 0)
+		return -1;
+	tv.tv_sec = 0;
+	tv.tv_usec = AF_PACKET_BLOCK_TOV * 1000;
+	(void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	t_start = time_now();
+	t_end = t_start + AF_PACKET_PHASE_TIME;
+	while (opt_do_run && (time_now() < t_end) &&
+	       (!max_ops || *counter < max_ops)) {
+		if (recv(fd, buf, sizeof(buf), 0) < 0) {
+			if ((errno == EAGAIN) || (errno == EINTR))
+				continue;
+			pr_fail_err(name, "recv");
+			break;
+		}
+		(*counter)++;
+		phase->packets++;
+	}
+	phase->duration += time_now() - t_start;
+	if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == 0)
+		phase->drops += stats.tp_drops;
+
+	(void)close(fd);
+	return 0;
+}
+
+/*
+ *  stress_af_packet
+ *	capture a loopback UDP flood with an AF_PACKET TPACKET_V3
+ *	rx ring and with plain recv(2) on a packet socket in
+ *	alternating phases and compare the packet rates
+ */
+int stress_af_packet(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const int port = opt_af_packet_port + (int)instance;
+	af_packet_phase_t ring, sock;
+	struct sockaddr_in addr;
+	int sink, status, rc = EXIT_SUCCESS;
+	const int rcvbuf = 4096;
+	pid_t pid;
+
+	memset(&ring, 0, sizeof(ring));
+	memset(&sock, 0, sizeof(sock));
+
+	/* a bound sink that is never read, so there are no ICMP replies */
+	sink = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sink < 0) {
+		pr_fail_err(name, "socket");
+		return EXIT_FAILURE;
+	}
+	(void)setsockopt(sink, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(sink, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		pr_fail_err(name, "bind");
+		(void)close(sink);
+		return EXIT_FAILURE;
+	}
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (opt_do_run && (errno == EAGAIN))
+			goto again;
+		pr_fail_dbg(name, "fork");
+		(void)close(sink);
+		return EXIT_FAILURE;
+	} else if (pid == 0) {
+		(void)setpgid(0, pgrp);
+		stress_parent_died_alarm();
+		(void)close(sink);
+		stress_af_packet_sender(port);
+		_exit(EXIT_SUCCESS);
+	}
+	(void)setpgid(pid, pgrp);
+
+	do {
+		if ((stress_af_packet_ring(name, port, counter, max_ops, &ring) < 0) ||
+		    (stress_af_packet_recv(name, port, counter, max_ops, &sock) < 0)) {
+			rc = EXIT_FAILURE;
+			break;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	(void)kill(pid, SIGKILL);
+	(void)waitpid(pid, &status, 0);
+	(void)close(sink);
+
+	if ((ring.duration > 0.0) && (sock.duration > 0.0)) {
+		const double ring_rate = (double)ring.packets / ring.duration;
+		const double sock_rate = (double)sock.packets / sock.duration;
+
+		stress_misc_metric_set(0, "ring packets per second", ring_rate);
+		stress_misc_metric_set(1, "recv packets per second", sock_rate);
+		if (sock_rate > 0.0)
+			stress_misc_metric_set(2, "ring speedup (x)",
+				ring_rate / sock_rate);
+		if (ring.packets + ring.drops)
+			stress_misc_metric_set(3, "ring drops (%)",
+				100.0 * (double)ring.drops /
+				(double)(ring.packets + ring.drops));
+		if (sock.packets + sock.drops)
+			stress_misc_metric_set(4, "recv drops (%)",
+				100.0 * (double)sock.drops /
+				(double)(sock.packets + sock.drops));
+	}
+	return rc;
+}
+
+#endif
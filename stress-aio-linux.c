@@ -41,8 +41,35 @@
 
 #define BUFFER_SZ	(4096)
 
+#define AIOL_SWEEP_QD_MAX	(256)		/* deepest sweep queue */
+#define AIOL_SWEEP_SPAN		(256 * MB)	/* file span written to */
+#define AIOL_SWEEP_CELL_TIME	(0.5)		/* seconds per sweep cell */
+#define AIOL_WAIT_NS		(10000000)	/* io_getevents timeout */
+
 static uint32_t opt_aio_linux_requests = DEFAULT_AIO_LINUX_REQUESTS;
 static bool set_aio_linux_requests = false;
+static bool opt_aio_linux_sweep = false;
+static uint32_t opt_aio_linux_min_nr = DEFAULT_AIO_LINUX_MIN_NR;
+
+#if defined(STRESS_LATENCY)
+static const uint32_t aiol_sweep_sizes[] = {
+	4 * KB, 16 * KB, 64 * KB, 256 * KB, 1 * MB
+};
+
+static const uint32_t aiol_sweep_depths[] = {
+	1, 4, 16, 64, AIOL_SWEEP_QD_MAX
+};
+
+/* results of one block size x queue depth sweep cell */
+typedef struct {
+	double iops;
+	double mb_per_sec;
+	uint64_t p50;			/* completion latencies (ns) */
+	uint64_t p99;
+	uint64_t p999;
+	uint64_t errors;
+} aiol_cell_t;
+#endif
 
 void stress_set_aio_linux_requests(const char *optarg)
 {
@@ -55,6 +82,21 @@ void stress_set_aio_linux_requests(const char *optarg)
 	opt_aio_linux_requests = aio_linux_requests;
 }
 
+void stress_set_aio_linux_sweep(void)
+{
+	opt_aio_linux_sweep = true;
+}
+
+void stress_set_aio_linux_min_nr(const char *optarg)
+{
+	uint32_t min_nr;
+
+	min_nr = get_uint32(optarg);
+	check_range("aiol-min-nr", min_nr,
+		MIN_AIO_LINUX_MIN_NR, MAX_AIO_LINUX_MIN_NR);
+	opt_aio_linux_min_nr = min_nr;
+}
+
 /*
  *  aio_linux_fill_buffer()
  *	fill buffer with some known pattern
@@ -70,6 +112,236 @@ static inline void aio_linux_fill_buffer(
 		buffer[i] = (uint8_t)(request + i);
 }
 
+#if defined(STRESS_LATENCY)
+/*
+ *  aiol_getevents()
+ *	reap completions, --aiol-min-nr 0 busy polls with a
+ *	zero timeout, otherwise wait for min_nr (capped to
+ *	the number in flight) with a short timeout
+ */
+static int aiol_getevents(
+	io_context_t ctx,
+	const uint32_t inflight,
+	struct io_event *events)
+{
+	struct timespec timeout;
+	long min_nr = (long)opt_aio_linux_min_nr;
+
+	if (min_nr > (long)inflight)
+		min_nr = (long)inflight;
+	timeout.tv_sec = 0;
+	timeout.tv_nsec = min_nr ? AIOL_WAIT_NS : 0;
+
+	return io_getevents(ctx, min_nr, (long)inflight, events, &timeout);
+}
+
+/*
+ *  stress_aiol_cell()
+ *	keep qd random writes of bs bytes in flight for a
+ *	sweep cell time, measuring IOPS, bandwidth and the
+ *	completion latency percentiles
+ */
+static int stress_aiol_cell(
+	const char *name,
+	io_context_t ctx,
+	const int fd,
+	uint8_t *buffers,
+	const uint32_t bs,
+	const uint32_t qd,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	aiol_cell_t *cell)
+{
+	struct iocb cb[AIOL_SWEEP_QD_MAX];
+	struct iocb *cbs[AIOL_SWEEP_QD_MAX];
+	struct io_event events[AIOL_SWEEP_QD_MAX];
+	uint64_t t_submit[AIOL_SWEEP_QD_MAX];
+	uint32_t free_slots[AIOL_SWEEP_QD_MAX];
+	uint32_t i, nfree = qd, inflight = 0;
+	uint64_t done = 0, bytes = 0;
+	stress_latency_t lat;
+	double t_start, t_end, duration;
+	int rc = 0;
+
+	memset(&lat, 0, sizeof(lat));
+	memset(cell, 0, sizeof(*cell));
+	for (i = 0; i < qd; i++)
+		free_slots[i] = i;
+
+	t_start = time_now();
+	t_end = t_start + AIOL_SWEEP_CELL_TIME;
+	for (;;) {
+		const bool more = opt_do_run && (time_now() < t_end) &&
+			(!max_ops || (*counter + inflight) < max_ops);
+		uint32_t n = 0;
+		uint64_t now;
+		int ret;
+
+		while (more && nfree) {
+			const uint32_t slot = free_slots[--nfree];
+			const long long offset = (long long)(mwc32() %
+				(AIOL_SWEEP_SPAN / bs)) * bs;
+
+			io_prep_pwrite(&cb[slot], fd, buffers + ((size_t)slot * bs),
+				bs, offset);
+			cb[slot].data = (void *)(uintptr_t)slot;
+			cbs[n++] = &cb[slot];
+		}
+		if (n) {
+			now = time_now_ns();
+			for (i = 0; i < n; i++)
+				t_submit[(uintptr_t)cbs[i]->data] = now;
+			ret = io_submit(ctx, (long)n, cbs);
+			if (ret < 0) {
+				if (ret != -EAGAIN) {
+					errno = -ret;
+					pr_fail_err(name, "io_submit");
+					rc = -1;
+				}
+				ret = 0;
+			}
+			/* hand back whatever was not taken */
+			for (i = (uint32_t)ret; i < n; i++)
+				free_slots[nfree++] = (uint32_t)(uintptr_t)cbs[i]->data;
+			inflight += (uint32_t)ret;
+		}
+		if (!inflight || (rc < 0))
+			break;
+
+		ret = aiol_getevents(ctx, inflight, events);
+		if (ret < 0) {
+			if (ret == -EINTR)
+				continue;
+			errno = -ret;
+			pr_fail_err(name, "io_getevents");
+			rc = -1;
+			break;
+		}
+		now = time_now_ns();
+		for (i = 0; i < (uint32_t)ret; i++) {
+			const uint32_t slot = (uint32_t)(uintptr_t)events[i].data;
+
+			latency_record(&lat, now - t_submit[slot]);
+			if ((long)events[i].res < 0)
+				cell->errors++;
+			else
+				bytes += (uint64_t)events[i].res;
+			free_slots[nfree++] = slot;
+			done++;
+			(*counter)++;
+		}
+		inflight -= (uint32_t)ret;
+	}
+	duration = time_now() - t_start;
+
+	/* drain, the buffers must not be reused while still in flight */
+	while (inflight) {
+		struct timespec timeout;
+		int ret;
+
+		timeout.tv_sec = 0;
+		timeout.tv_nsec = AIOL_WAIT_NS;
+		ret = io_getevents(ctx, 1, (long)inflight, events, &timeout);
+		if ((ret < 0) && (ret != -EINTR))
+			break;
+		if (ret > 0)
+			inflight -= (uint32_t)ret;
+	}
+
+	if (duration > 0.0) {
+		cell->iops = (double)done / duration;
+		cell->mb_per_sec = ((double)bytes / duration) / (double)MB;
+	}
+	if (lat.count) {
+		cell->p50 = latency_percentile(&lat, 0.50);
+		cell->p99 = latency_percentile(&lat, 0.99);
+		cell->p999 = latency_percentile(&lat, 0.999);
+	}
+	return rc;
+}
+
+/*
+ *  stress_aiol_sweep()
+ *	sweep block sizes and queue depths, the first instance
+ *	reports a table of the first complete sweep
+ */
+static int stress_aiol_sweep(
+	const char *name,
+	const uint32_t instance,
+	io_context_t ctx,
+	const int fd,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	static aiol_cell_t cells[SIZEOF_ARRAY(aiol_sweep_sizes)]
+				[SIZEOF_ARRAY(aiol_sweep_depths)];
+	io_buffers_t bufs;
+	uint8_t *buffers;
+	bool reported = false;
+	double peak_iops = 0.0, peak_mb = 0.0;
+	size_t i, j;
+	int rc = EXIT_SUCCESS;
+
+	/* O_DIRECT buffers aligned for the device the file is on */
+	if (io_buffers_alloc(&bufs, stress_get_temp_path(), MB, AIOL_SWEEP_QD_MAX) < 0) {
+		pr_err(stderr, "%s: cannot allocate %d MB of sweep buffers\n",
+			name, AIOL_SWEEP_QD_MAX);
+		return EXIT_NO_RESOURCE;
+	}
+	buffers = io_buffer(&bufs, 0);
+	for (i = 0; i < AIOL_SWEEP_QD_MAX; i++)
+		aio_linux_fill_buffer((int)i, io_buffer(&bufs, (uint32_t)i), MB);
+
+	do {
+		for (i = 0; i < SIZEOF_ARRAY(aiol_sweep_sizes); i++) {
+			for (j = 0; j < SIZEOF_ARRAY(aiol_sweep_depths); j++) {
+				if (!opt_do_run || (max_ops && *counter >= max_ops))
+					goto done;
+				if (stress_aiol_cell(name, ctx, fd, buffers,
+						aiol_sweep_sizes[i],
+						aiol_sweep_depths[j],
+						counter, max_ops, &cells[i][j]) < 0) {
+					rc = EXIT_FAILURE;
+					goto done;
+				}
+				if (cells[i][j].iops > peak_iops)
+					peak_iops = cells[i][j].iops;
+				if (cells[i][j].mb_per_sec > peak_mb)
+					peak_mb = cells[i][j].mb_per_sec;
+			}
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %8s %5s %10s %10s %10s %10s %10s\n",
+				name, "block", "qd", "IOPS", "MB/sec",
+				"p50 usec", "p99 usec", "p99.9 usec");
+			for (i = 0; i < SIZEOF_ARRAY(aiol_sweep_sizes); i++) {
+				for (j = 0; j < SIZEOF_ARRAY(aiol_sweep_depths); j++) {
+					const aiol_cell_t *c = &cells[i][j];
+
+					pr_inf(stderr, "%s: %7" PRIu32 "K %5" PRIu32
+						" %10.0f %10.2f %10.1f %10.1f %10.1f\n",
+						name, (uint32_t)(aiol_sweep_sizes[i] / KB),
+						aiol_sweep_depths[j], c->iops,
+						c->mb_per_sec, (double)c->p50 / 1000.0,
+						(double)c->p99 / 1000.0,
+						(double)c->p999 / 1000.0);
+					if (c->errors)
+						pr_dbg(stderr, "%s: %" PRIu64 " failed "
+							"writes\n", name, c->errors);
+				}
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	stress_misc_metric_set(0, "peak IOPS", peak_iops);
+	stress_misc_metric_set(1, "peak bandwidth (MB/sec)", peak_mb);
+	io_buffers_free(&bufs);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_aiol
  *	stress asynchronous I/O using the linux specific aio ABI
@@ -84,6 +356,7 @@ int stress_aiol(
 	char filename[PATH_MAX];
 	const pid_t pid = getpid();
 	io_context_t ctx = 0;
+	io_buffers_t bufs;
 
 	if (!set_aio_linux_requests) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -96,7 +369,8 @@ int stress_aiol(
 		pr_err(stderr, "%s: iol_requests out of range", name);
 		return EXIT_FAILURE;
 	}
-	if (io_setup(opt_aio_linux_requests, &ctx) < 0) {
+	if (io_setup(opt_aio_linux_sweep ? AIOL_SWEEP_QD_MAX :
+			opt_aio_linux_requests, &ctx) < 0) {
 		pr_fail_err(name, "io_setup");
 		return EXIT_FAILURE;
 	}
@@ -108,6 +382,16 @@ int stress_aiol(
 		name, pid, instance, mwc32());
 
 	(void)umask(0077);
+#if defined(O_DIRECT)
+	/*
+	 *  The sweep characterises the device, so bypass the page
+	 *  cache if the file system allows it; buffered aio is
+	 *  synchronous
+	 */
+	fd = opt_aio_linux_sweep ?
+		open(filename, O_CREAT | O_RDWR | O_DIRECT, S_IRUSR | S_IWUSR) : -1;
+	if (fd < 0)
+#endif
 	if ((fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR)) < 0) {
 		rc = exit_status(errno);
 		pr_fail_err(name, "open");
@@ -115,22 +399,43 @@ int stress_aiol(
 	}
 	(void)unlink(filename);
 
+	if (opt_aio_linux_sweep) {
+#if defined(STRESS_LATENCY)
+		rc = stress_aiol_sweep(name, instance, ctx, fd, counter, max_ops);
+		(void)close(fd);
+		goto finish;
+#else
+		pr_inf(stderr, "%s: --aiol-sweep is not supported, "
+			"using the default mode\n", name);
+#endif
+	}
+
+	/* The buffers are set up once rather than on the stack each round */
+	ret = io_buffers_alloc(&bufs, stress_get_temp_path(), BUFFER_SZ,
+		opt_aio_linux_requests);
+	if (ret < 0) {
+		rc = exit_status(-ret);
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " buffers\n",
+			name, opt_aio_linux_requests);
+		(void)close(fd);
+		goto finish;
+	}
+
 	do {
 		struct iocb cb[opt_aio_linux_requests];
 		struct iocb *cbs[opt_aio_linux_requests];
 		struct io_event events[opt_aio_linux_requests];
-		uint8_t buffers[opt_aio_linux_requests][BUFFER_SZ];
 		uint32_t i;
 		long n;
 
 		for (i = 0; i < opt_aio_linux_requests; i++)
-			aio_linux_fill_buffer(i, buffers[i], BUFFER_SZ);
+			aio_linux_fill_buffer(i, io_buffer(&bufs, i), BUFFER_SZ);
 
 		memset(cb, 0, sizeof(cb));
 		for (i = 0; i < opt_aio_linux_requests; i++) {
 			cb[i].aio_fildes = fd;
 			cb[i].aio_lio_opcode = IO_CMD_PWRITE;
-			cb[i].u.c.buf = buffers[i];
+			cb[i].u.c.buf = io_buffer(&bufs, i);
 			cb[i].u.c.offset = mwc16() * BUFFER_SZ;
 			cb[i].u.c.nbytes = BUFFER_SZ;
 			cbs[i] = &cb[i];
@@ -172,6 +477,7 @@ int stress_aiol(
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
 	rc = EXIT_SUCCESS;
+	io_buffers_free(&bufs);
 	(void)close(fd);
 finish:
 	(void)io_destroy(ctx);
@@ -0,0 +1,660 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_ARENA)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define ARENA_PHASE_TIME	(1.0)		/* seconds per method phase */
+#define ARENA_ALIGN		(16)		/* object alignment */
+#define ARENA_BLOCK_SIZE	(64 * KB)	/* arena block and pool slab size */
+#define ARENA_TCACHE_SIZE	(64)		/* objects in a per thread cache */
+#define ARENA_TCACHE_BATCH	(ARENA_TCACHE_SIZE / 2)
+
+#define ARENA_METHOD_MALLOC	(0)	/* malloc(3) and free(3) each object */
+#define ARENA_METHOD_ARENA	(1)	/* bump pointer, reset per request */
+#define ARENA_METHOD_POOL	(2)	/* fixed size object free list */
+#define ARENA_METHOD_MAX	(3)
+#define ARENA_METHOD_ALL	(ARENA_METHOD_MAX)
+
+typedef struct {
+	const char *name;	/* User option */
+	int method;		/* ARENA_METHOD_ value */
+} arena_method_t;
+
+static const arena_method_t arena_methods[] = {
+	{ "malloc",	ARENA_METHOD_MALLOC },
+	{ "arena",	ARENA_METHOD_ARENA },
+	{ "pool",	ARENA_METHOD_POOL },
+	{ "all",	ARENA_METHOD_ALL },
+};
+
+/* Arena block, the objects follow the header */
+typedef struct arena_block {
+	struct arena_block *next;	/* next block in the arena */
+	size_t size;			/* usable bytes after the header */
+} arena_block_t;
+
+/* A bump pointer arena, the blocks are kept over resets */
+typedef struct {
+	arena_block_t *head;		/* first block */
+	arena_block_t *block;		/* block being bumped */
+	size_t used;			/* bytes used in the block */
+} arena_t;
+
+/* Free object, the link lives in the object itself */
+typedef struct arena_obj {
+	struct arena_obj *next;
+} arena_obj_t;
+
+/* Fixed size object pool shared by all the threads */
+static struct {
+	pthread_mutex_t lock;		/* protects the lists */
+	arena_obj_t *free;		/* free objects */
+	arena_block_t *slabs;		/* slabs carved into objects */
+} arena_pool;
+
+/* A worker thread */
+typedef struct {
+	pthread_t pthread;		/* the thread */
+	int ret;			/* pthread_create return */
+	uint64_t allocs;		/* objects allocated this phase */
+	uint64_t sum;			/* keeps the object reads live */
+	bool nomem;			/* an allocation failed */
+} arena_thread_t;
+
+static struct {
+	int method;			/* ARENA_METHOD_ of this phase */
+	bool run;			/* threads keep on running */
+	bool go;			/* all threads at the start line */
+	uint32_t started;		/* threads at the start line */
+} arena_ctl;
+
+static int opt_arena_method = ARENA_METHOD_ALL;
+static size_t opt_arena_size = DEFAULT_ARENA_SIZE;
+static uint32_t opt_arena_objects = DEFAULT_ARENA_OBJECTS;
+static uint32_t opt_arena_threads = DEFAULT_ARENA_THREADS;
+static bool opt_arena_tcache = false;
+
+/*
+ *  stress_set_arena_method()
+ *	set the allocation method to exercise
+ */
+int stress_set_arena_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(arena_methods); i++) {
+		if (!strcmp(name, arena_methods[i].name)) {
+			opt_arena_method = arena_methods[i].method;
+			return 0;
+		}
+	}
+	fprintf(stderr, "arena-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(arena_methods); i++)
+		fprintf(stderr, " %s", arena_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+void stress_set_arena_size(const char *optarg)
+{
+	opt_arena_size = (size_t)get_uint64_byte(optarg);
+	check_range("arena-size", opt_arena_size,
+		MIN_ARENA_SIZE, MAX_ARENA_SIZE);
+}
+
+void stress_set_arena_objects(const char *optarg)
+{
+	opt_arena_objects = (uint32_t)get_uint64(optarg);
+	check_range("arena-objects", opt_arena_objects,
+		MIN_ARENA_OBJECTS, MAX_ARENA_OBJECTS);
+}
+
+void stress_set_arena_threads(const char *optarg)
+{
+	opt_arena_threads = (uint32_t)get_uint64(optarg);
+	check_range("arena-threads", opt_arena_threads,
+		MIN_ARENA_THREADS, MAX_ARENA_THREADS);
+}
+
+void stress_set_arena_tcache(void)
+{
+	opt_arena_tcache = true;
+}
+
+/*
+ *  arena_obj_size()
+ *	object size rounded up to the object alignment
+ */
+static inline size_t arena_obj_size(void)
+{
+	return (opt_arena_size + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1);
+}
+
+/*
+ *  arena_block_new()
+ *	allocate a block with at least size usable bytes
+ */
+static arena_block_t *arena_block_new(const size_t size)
+{
+	const size_t hdr = (sizeof(arena_block_t) + ARENA_ALIGN - 1) &
+		~((size_t)ARENA_ALIGN - 1);
+	const size_t usable = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+	arena_block_t *block;
+
+	block = malloc(hdr + usable);
+	if (!block)
+		return NULL;
+	block->next = NULL;
+	block->size = usable;
+	return block;
+}
+
+/*
+ *  arena_block_data()
+ *	first object in a block
+ */
+static inline uint8_t *arena_block_data(arena_block_t *block)
+{
+	const size_t hdr = (sizeof(arena_block_t) + ARENA_ALIGN - 1) &
+		~((size_t)ARENA_ALIGN - 1);
+
+	return (uint8_t *)block + hdr;
+}
+
+/*
+ *  arena_alloc()
+ *	bump allocate size bytes, moving on to the next
+ *	block, or chaining a new one, when a block is full
+ */
+static inline void *arena_alloc(arena_t *arena, const size_t size)
+{
+	void *ptr;
+
+	if (!arena->block || (arena->used + size > arena->block->size)) {
+		arena_block_t *next = arena->block ? arena->block->next : arena->head;
+
+		if (!next) {
+			next = arena_block_new(size);
+			if (!next)
+				return NULL;
+			if (arena->block)
+				arena->block->next = next;
+			else
+				arena->head = next;
+		}
+		arena->block = next;
+		arena->used = 0;
+	}
+	ptr = arena_block_data(arena->block) + arena->used;
+	arena->used += size;
+	return ptr;
+}
+
+/*
+ *  arena_reset()
+ *	release every object at once, keeping the blocks
+ */
+static inline void arena_reset(arena_t *arena)
+{
+	arena->block = NULL;
+	arena->used = 0;
+}
+
+/*
+ *  arena_free()
+ *	free the blocks of an arena
+ */
+static void arena_free(arena_t *arena)
+{
+	arena_block_t *block = arena->head;
+
+	while (block) {
+		arena_block_t *next = block->next;
+
+		free(block);
+		block = next;
+	}
+	arena->head = NULL;
+	arena_reset(arena);
+}
+
+/*
+ *  arena_pool_grow()
+ *	carve a new slab into free objects, pool lock held
+ */
+static bool arena_pool_grow(const size_t size)
+{
+	arena_block_t *slab = arena_block_new(size);
+	uint8_t *data;
+	size_t i, n;
+
+	if (!slab)
+		return false;
+	slab->next = arena_pool.slabs;
+	arena_pool.slabs = slab;
+
+	data = arena_block_data(slab);
+	n = slab->size / size;
+	for (i = 0; i < n; i++) {
+		arena_obj_t *obj = (arena_obj_t *)(data + (i * size));
+
+		obj->next = arena_pool.free;
+		arena_pool.free = obj;
+	}
+	return true;
+}
+
+/*
+ *  arena_pool_get()
+ *	take up to n objects from the shared pool into
+ *	objs, returns the number taken
+ */
+static size_t arena_pool_get(void **objs, const size_t n, const size_t size)
+{
+	size_t i;
+
+	(void)pthread_mutex_lock(&arena_pool.lock);
+	for (i = 0; i < n; i++) {
+		arena_obj_t *obj = arena_pool.free;
+
+		if (!obj) {
+			if (!arena_pool_grow(size))
+				break;
+			obj = arena_pool.free;
+		}
+		arena_pool.free = obj->next;
+		objs[i] = obj;
+	}
+	(void)pthread_mutex_unlock(&arena_pool.lock);
+
+	return i;
+}
+
+/*
+ *  arena_pool_put()
+ *	return n objects to the shared pool
+ */
+static void arena_pool_put(void **objs, const size_t n)
+{
+	size_t i;
+
+	(void)pthread_mutex_lock(&arena_pool.lock);
+	for (i = 0; i < n; i++) {
+		arena_obj_t *obj = (arena_obj_t *)objs[i];
+
+		obj->next = arena_pool.free;
+		arena_pool.free = obj;
+	}
+	(void)pthread_mutex_unlock(&arena_pool.lock);
+}
+
+/*
+ *  arena_pool_free()
+ *	free the pool slabs
+ */
+static void arena_pool_free(void)
+{
+	arena_block_t *slab = arena_pool.slabs;
+
+	while (slab) {
+		arena_block_t *next = slab->next;
+
+		free(slab);
+		slab = next;
+	}
+	arena_pool.slabs = NULL;
+	arena_pool.free = NULL;
+}
+
+/*
+ *  arena_thread()
+ *	serve requests, each allocating, initialising and
+ *	reading opt_arena_objects short lived objects and
+ *	then releasing them with the phase method
+ */
+static void *arena_thread(void *arg)
+{
+	static void *nowt = NULL;
+	arena_thread_t *t = (arena_thread_t *)arg;
+	const size_t size = arena_obj_size();
+	const size_t n = opt_arena_objects;
+	void **objs;
+	void *tcache[ARENA_TCACHE_SIZE];
+	size_t tcached = 0;
+	arena_t arena;
+	uint64_t allocs = 0, sum = 0;
+
+	memset(&arena, 0, sizeof(arena));
+	objs = calloc(n, sizeof(*objs));
+	if (!objs)
+		t->nomem = true;
+
+	__atomic_add_fetch(&arena_ctl.started, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(&arena_ctl.go, __ATOMIC_ACQUIRE))
+		(void)sched_yield();
+
+	while (objs && __atomic_load_n(&arena_ctl.run, __ATOMIC_RELAXED)) {
+		size_t i, got = 0;
+
+		for (i = 0; i < n; i++) {
+			void *obj;
+
+			switch (arena_ctl.method) {
+			case ARENA_METHOD_ARENA:
+				obj = arena_alloc(&arena, size);
+				break;
+			case ARENA_METHOD_POOL:
+				if (opt_arena_tcache) {
+					if (!tcached)
+						tcached = arena_pool_get(tcache,
+							ARENA_TCACHE_BATCH, size);
+					obj = tcached ? tcache[--tcached] : NULL;
+				} else {
+					obj = arena_pool_get(&obj, 1, size) ? obj : NULL;
+				}
+				break;
+			default:
+				obj = malloc(opt_arena_size);
+				break;
+			}
+			if (!obj) {
+				t->nomem = true;
+				break;
+			}
+			(void)memset(obj, (int)i, opt_arena_size);
+			objs[got++] = obj;
+		}
+
+		/* The request reads its objects */
+		for (i = 0; i < got; i++)
+			sum += *(volatile uint8_t *)objs[i];
+		allocs += got;
+		__atomic_store_n(&t->allocs, allocs, __ATOMIC_RELAXED);
+
+		switch (arena_ctl.method) {
+		case ARENA_METHOD_ARENA:
+			arena_reset(&arena);
+			break;
+		case ARENA_METHOD_POOL:
+			if (!opt_arena_tcache) {
+				arena_pool_put(objs, got);
+				break;
+			}
+			for (i = 0; i < got; i++) {
+				if (tcached == ARENA_TCACHE_SIZE) {
+					/* Flush the oldest half back to the pool */
+					arena_pool_put(tcache, ARENA_TCACHE_BATCH);
+					(void)memmove(tcache, tcache + ARENA_TCACHE_BATCH,
+						(ARENA_TCACHE_SIZE - ARENA_TCACHE_BATCH) *
+						sizeof(*tcache));
+					tcached -= ARENA_TCACHE_BATCH;
+				}
+				tcache[tcached++] = objs[i];
+			}
+			break;
+		default:
+			for (i = 0; i < got; i++)
+				free(objs[i]);
+			break;
+		}
+		if (t->nomem)
+			break;
+	}
+	if (tcached)
+		arena_pool_put(tcache, tcached);
+	arena_free(&arena);
+	free(objs);
+	t->sum = sum;
+
+	return &nowt;
+}
+
+/*
+ *  arena_misses_open()
+ *	open a cache miss counter that also counts the
+ *	threads created after it, -1 if unavailable
+ */
+static int arena_misses_open(void)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_open_by_id(STRESS_PERF_HW_CACHE_MISSES);
+#else
+	return -1;
+#endif
+}
+
+/*
+ *  arena_misses_read()
+ *	read the cache miss counter, false if unavailable
+ */
+static bool arena_misses_read(const int fd, uint64_t *misses)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_read_by_fd(fd, misses) == 0;
+#else
+	(void)fd;
+
+	*misses = 0;
+	return false;
+#endif
+}
+
+/*
+ *  arena_phase()
+ *	allocate objects with one method for a phase,
+ *	returns the number of objects allocated
+ */
+static uint64_t arena_phase(
+	const char *name,
+	const int method,
+	arena_thread_t *threads,
+	const int ctr_fd,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	double *duration,
+	uint64_t *misses)
+{
+	const uint64_t base = *counter;
+	uint64_t allocs = 0, misses_start = 0, misses_end = 0;
+	uint32_t i, started = 0;
+	bool ctr_ok, nomem = false;
+	double t_start, t_end;
+
+	*duration = 0.0;
+	*misses = ~0ULL;
+	arena_ctl.method = method;
+	arena_ctl.run = true;
+	arena_ctl.go = false;
+	arena_ctl.started = 0;
+
+	for (i = 0; i < opt_arena_threads; i++) {
+		arena_thread_t *t = &threads[i];
+
+		t->allocs = 0;
+		t->sum = 0;
+		t->nomem = false;
+		t->ret = pthread_create(&t->pthread, NULL, arena_thread, t);
+		if (t->ret)
+			break;
+		started++;
+	}
+	if (!started) {
+		pr_fail_err(name, "pthread_create");
+		return 0;
+	}
+	while (__atomic_load_n(&arena_ctl.started, __ATOMIC_ACQUIRE) < started)
+		(void)sched_yield();
+
+	ctr_ok = arena_misses_read(ctr_fd, &misses_start);
+	t_start = time_now();
+	t_end = t_start + ARENA_PHASE_TIME;
+	__atomic_store_n(&arena_ctl.go, true, __ATOMIC_RELEASE);
+
+	while (opt_do_run && (time_now() < t_end)) {
+		uint64_t total = base;
+
+		(void)usleep(10000);
+		for (i = 0; i < started; i++)
+			total += __atomic_load_n(&threads[i].allocs, __ATOMIC_RELAXED);
+		*counter = total;
+		if (max_ops && (total >= max_ops))
+			break;
+	}
+	__atomic_store_n(&arena_ctl.run, false, __ATOMIC_RELEASE);
+	for (i = 0; i < started; i++)
+		(void)pthread_join(threads[i].pthread, NULL);
+	*duration = time_now() - t_start;
+	ctr_ok &= arena_misses_read(ctr_fd, &misses_end);
+
+	for (i = 0; i < started; i++) {
+		allocs += threads[i].allocs;
+		nomem |= threads[i].nomem;
+	}
+	*counter = base + allocs;
+	*misses = ctr_ok ? misses_end - misses_start : ~0ULL;
+
+	if (nomem)
+		pr_dbg(stderr, "%s: %s allocation failed, out of memory\n",
+			name, arena_methods[method].name);
+	return allocs;
+}
+
+/*
+ *  stress_arena()
+ *	compare malloc against a bump pointer arena and a fixed
+ *	size object pool for short lived objects, reports the
+ *	allocations per second and cache misses per allocation
+ */
+int stress_arena(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	arena_thread_t *threads;
+	uint64_t allocs[ARENA_METHOD_MAX], misses[ARENA_METHOD_MAX];
+	double durations[ARENA_METHOD_MAX];
+	bool misses_ok[ARENA_METHOD_MAX];
+	bool reported = false;
+	int method, ctr_fd;
+	size_t idx = 0;
+
+	threads = calloc(opt_arena_threads, sizeof(*threads));
+	if (!threads) {
+		pr_err(stderr, "%s: cannot allocate threads\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	memset(allocs, 0, sizeof(allocs));
+	memset(misses, 0, sizeof(misses));
+	memset(durations, 0, sizeof(durations));
+	for (method = 0; method < ARENA_METHOD_MAX; method++)
+		misses_ok[method] = true;
+	(void)pthread_mutex_init(&arena_pool.lock, NULL);
+
+	ctr_fd = arena_misses_open();
+	if (ctr_fd < 0)
+		pr_dbg(stderr, "%s: cannot open cache miss perf counter, "
+			"cache misses will not be reported\n", name);
+
+	do {
+		for (method = 0; method < ARENA_METHOD_MAX; method++) {
+			uint64_t phase_misses = ~0ULL;
+			double duration = 0.0;
+
+			if ((opt_arena_method != ARENA_METHOD_ALL) &&
+			    (opt_arena_method != method))
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			allocs[method] += arena_phase(name, method, threads, ctr_fd,
+				counter, max_ops, &duration, &phase_misses);
+			durations[method] += duration;
+			if (phase_misses == ~0ULL)
+				misses_ok[method] = false;
+			else
+				misses[method] += phase_misses;
+		}
+		if ((instance == 0) && !reported &&
+		    (opt_arena_method == ARENA_METHOD_ALL)) {
+			pr_inf(stderr, "%s: %zu byte objects, %" PRIu32
+				" per request, %" PRIu32 " threads%s\n", name,
+				opt_arena_size, opt_arena_objects, opt_arena_threads,
+				opt_arena_tcache ? ", per thread pool caches" : "");
+			pr_inf(stderr, "%s: %6s %14s %17s\n", name,
+				"method", "allocs/s", "cache misses/alloc");
+			for (method = 0; method < ARENA_METHOD_MAX; method++) {
+				const double rate = (durations[method] > 0.0) ?
+					(double)allocs[method] / durations[method] : 0.0;
+
+				if (misses_ok[method] && allocs[method])
+					pr_inf(stderr, "%s: %6s %14.1f %17.3f\n", name,
+						arena_methods[method].name, rate,
+						(double)misses[method] / (double)allocs[method]);
+				else
+					pr_inf(stderr, "%s: %6s %14.1f %17s\n", name,
+						arena_methods[method].name, rate, "n/a");
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (method = 0; method < ARENA_METHOD_MAX; method++) {
+		char desc[40];
+
+		if (durations[method] <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s allocs per sec",
+			arena_methods[method].name);
+		stress_misc_metric_set(idx++, desc,
+			(double)allocs[method] / durations[method]);
+		if (misses_ok[method] && allocs[method]) {
+			(void)snprintf(desc, sizeof(desc), "%s cache misses per alloc",
+				arena_methods[method].name);
+			stress_misc_metric_set(idx++, desc,
+				(double)misses[method] / (double)allocs[method]);
+		}
+	}
+	if (ctr_fd > -1)
+		(void)close(ctr_fd);
+	arena_pool_free();
+	(void)pthread_mutex_destroy(&arena_pool.lock);
+	free(threads);
+
+	return EXIT_SUCCESS;
+}
+#endif
@@ -70,6 +70,8 @@ int stress_bigheap(
 	uint32_t ooms = 0, segvs = 0, nomems = 0;
 	pid_t pid;
 	uint8_t *last_ptr_end = NULL;
+	/* realloc'd heap memory can only be advised to use THP */
+	const hugepages_t hugepages = stress_get_hugepages();
 
 	if (!set_bigheap_growth) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -169,6 +171,7 @@ again:
 					size_t sz = page_size - 1;
 					uintptr_t pg_ptr = ((uintptr_t)ptr + sz) & ~sz;
 					size_t len = size - (pg_ptr - (uintptr_t)ptr);
+					(void)madvise_hugepages(hugepages, (void *)pg_ptr, len & ~sz);
 					(void)mincore_touch_pages((void *)pg_ptr, len);
 				}
 
@@ -192,6 +195,9 @@ again:
 				last_ptr_end = u8ptr;
 			}
 			(*counter)++;
+			/* The child is usually killed, so report as it grows */
+			if ((hugepages != HUGEPAGES_NONE) && ptr && !(*counter & 63))
+				hugepages_metric_set(hugepages_mapped(ptr, size));
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
 abort:
 		free(ptr);
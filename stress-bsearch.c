@@ -27,12 +27,61 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 
 #include "stress-ng.h"
 
 static uint64_t opt_bsearch_size = DEFAULT_BSEARCH_SIZE;
 static bool set_bsearch_size = false;
 
+#define BSEARCH_METHOD_LIBC		(0)	/* libc bsearch, comparator callback */
+#define BSEARCH_METHOD_EYTZINGER	(1)	/* binary search on a BFS ordered array */
+#define BSEARCH_METHOD_BTREE		(2)	/* static B-tree, a cache line per node */
+#define BSEARCH_METHOD_HASH		(3)	/* open addressing, linear probing */
+#define BSEARCH_METHOD_MAX		(4)
+#define BSEARCH_METHOD_ALL		(BSEARCH_METHOD_MAX)
+
+#define BSEARCH_BTREE_KEYS	(16)		/* int32 keys in a 64 byte node */
+#define BSEARCH_KEYS		(64 * 1024)	/* random lookup keys */
+#define BSEARCH_SWEEP_MIN	(1 * KB)	/* smallest sweep table, elements */
+#define BSEARCH_SWEEP_MAX	(16 * MB)	/* largest sweep table, elements */
+#define BSEARCH_SWEEP_TIME	(0.2)		/* seconds per method and size */
+
+typedef struct {
+	const char *name;	/* User option */
+	int method;		/* BSEARCH_METHOD_ value */
+} bsearch_method_t;
+
+static const bsearch_method_t bsearch_methods[] = {
+	{ "libc",	BSEARCH_METHOD_LIBC },
+	{ "eytzinger",	BSEARCH_METHOD_EYTZINGER },
+	{ "btree",	BSEARCH_METHOD_BTREE },
+	{ "hash",	BSEARCH_METHOD_HASH },
+	{ "all",	BSEARCH_METHOD_ALL },
+};
+
+/* The sorted data and the search structures built from it */
+typedef struct {
+	int32_t *data;		/* sorted keys */
+	size_t n;		/* number of keys */
+	int32_t *eytz;		/* Eytzinger layout, 1 based */
+	int32_t *btree;		/* B-tree nodes of BSEARCH_BTREE_KEYS keys */
+	size_t nodes;		/* number of B-tree nodes */
+	int32_t *hash;		/* hash slots, 0 is empty */
+	size_t hash_mask;	/* hash slots - 1 */
+} bsearch_tables_t;
+
+/* Lookups and time per method */
+typedef struct {
+	uint64_t lookups;	/* lookups made */
+	double secs;		/* time spent looking up */
+} bsearch_stats_t;
+
+static int opt_bsearch_method = BSEARCH_METHOD_LIBC;
+static bool set_bsearch_method = false;
+static bool opt_bsearch_sweep = false;
+
 /*
  *  stress_set_bsearch_size()
  *	set bsearch size from given option string
@@ -45,6 +94,35 @@ void stress_set_bsearch_size(const char *optarg)
 		MIN_BSEARCH_SIZE, MAX_BSEARCH_SIZE);
 }
 
+/*
+ *  stress_set_bsearch_method()
+ *	set the search method to exercise
+ */
+int stress_set_bsearch_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(bsearch_methods); i++) {
+		if (!strcmp(name, bsearch_methods[i].name)) {
+			opt_bsearch_method = bsearch_methods[i].method;
+			set_bsearch_method = true;
+			return 0;
+		}
+	}
+	fprintf(stderr, "bsearch-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(bsearch_methods); i++)
+		fprintf(stderr, " %s", bsearch_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+void stress_set_bsearch_sweep(void)
+{
+	opt_bsearch_sweep = true;
+	if (!set_bsearch_method)
+		opt_bsearch_method = BSEARCH_METHOD_ALL;
+}
+
 /*
  *  cmp()
  *	compare int32 values for bsearch
@@ -71,6 +149,367 @@ static int cmp(const void *p1, const void *p2)
 	prev = d[i];			\
 	i++;				\
 
+/*
+ *  bsearch_eytzinger_build()
+ *	lay out the sorted keys in BFS order of the implicit
+ *	binary tree, so the first levels share cache lines
+ */
+static size_t bsearch_eytzinger_build(
+	bsearch_tables_t *t,
+	size_t i,
+	const size_t k)
+{
+	if (k <= t->n) {
+		i = bsearch_eytzinger_build(t, i, 2 * k);
+		t->eytz[k] = t->data[i++];
+		i = bsearch_eytzinger_build(t, i, (2 * k) + 1);
+	}
+	return i;
+}
+
+/*
+ *  bsearch_eytzinger()
+ *	branchless descent, prefetching the great great grandchildren
+ *	that share a cache line, then undo the final right turns
+ */
+static inline bool bsearch_eytzinger(const bsearch_tables_t *t, const int32_t key)
+{
+	const int32_t *eytz = t->eytz;
+	const size_t n = t->n;
+	size_t k = 1;
+
+	while (k <= n) {
+		__builtin_prefetch(eytz + (k * BSEARCH_BTREE_KEYS));
+		k = (2 * k) + (eytz[k] < key);
+	}
+	k >>= ffsl((long)~k);
+	return (k != 0) && (eytz[k] == key);
+}
+
+static inline size_t bsearch_btree_child(const size_t k, const size_t i)
+{
+	return (k * (BSEARCH_BTREE_KEYS + 1)) + i + 1;
+}
+
+/*
+ *  bsearch_btree_build()
+ *	fill the static B-tree nodes by an in-order walk,
+ *	unused keys are padded with INT32_MAX
+ */
+static size_t bsearch_btree_build(
+	bsearch_tables_t *t,
+	size_t i,
+	const size_t k)
+{
+	size_t j;
+
+	if (k >= t->nodes)
+		return i;
+	for (j = 0; j < BSEARCH_BTREE_KEYS; j++) {
+		i = bsearch_btree_build(t, i, bsearch_btree_child(k, j));
+		t->btree[(k * BSEARCH_BTREE_KEYS) + j] =
+			(i < t->n) ? t->data[i++] : INT32_MAX;
+	}
+	return bsearch_btree_build(t, i, bsearch_btree_child(k, BSEARCH_BTREE_KEYS));
+}
+
+/*
+ *  bsearch_btree()
+ *	count the keys less than the key in each node, a
+ *	loop the compiler can vectorize, to pick the child
+ */
+static inline bool bsearch_btree(const bsearch_tables_t *t, const int32_t key)
+{
+	size_t k = 0;
+
+	while (k < t->nodes) {
+		const int32_t *node = t->btree + (k * BSEARCH_BTREE_KEYS);
+		size_t i, less = 0;
+
+		for (i = 0; i < BSEARCH_BTREE_KEYS; i++)
+			less += (node[i] < key);
+		if ((less < BSEARCH_BTREE_KEYS) && (node[less] == key))
+			return true;
+		k = bsearch_btree_child(k, less);
+	}
+	return false;
+}
+
+static inline size_t bsearch_hash_slot(const bsearch_tables_t *t, const int32_t key)
+{
+	return (size_t)(((uint32_t)key * 0x9e3779b1U) >> 7) & t->hash_mask;
+}
+
+/*
+ *  bsearch_hash()
+ *	linear probe from the hashed slot until the key
+ *	or an empty slot is found
+ */
+static inline bool bsearch_hash(const bsearch_tables_t *t, const int32_t key)
+{
+	size_t slot = bsearch_hash_slot(t, key);
+
+	for (;;) {
+		const int32_t v = t->hash[slot];
+
+		if (v == key)
+			return true;
+		if (v == 0)
+			return false;
+		slot = (slot + 1) & t->hash_mask;
+	}
+}
+
+/*
+ *  bsearch_tables_free()
+ *	free the search structures
+ */
+static void bsearch_tables_free(bsearch_tables_t *t)
+{
+	free(t->hash);
+	free(t->btree);
+	free(t->eytz);
+	free(t->data);
+	memset(t, 0, sizeof(*t));
+}
+
+/*
+ *  bsearch_tables_build()
+ *	fill n ascending keys and build the search structures
+ *	from them, the hash table is kept at most half full
+ */
+static int bsearch_tables_build(bsearch_tables_t *t, const size_t n)
+{
+	int32_t prev = 0;
+	size_t i, slots;
+	void *ptr;
+
+	memset(t, 0, sizeof(*t));
+	t->n = n;
+	t->nodes = (n + BSEARCH_BTREE_KEYS - 1) / BSEARCH_BTREE_KEYS;
+	for (slots = 1; slots < 2 * n; slots <<= 1)
+		;
+	t->hash_mask = slots - 1;
+
+	t->data = calloc((n + 7) & ~7, sizeof(int32_t));
+	t->eytz = calloc(n + 1, sizeof(int32_t));
+	t->hash = calloc(slots, sizeof(int32_t));
+	if (posix_memalign(&ptr, 64, t->nodes * BSEARCH_BTREE_KEYS * sizeof(int32_t)) == 0)
+		t->btree = ptr;
+	if (!t->data || !t->eytz || !t->hash || !t->btree) {
+		bsearch_tables_free(t);
+		return -1;
+	}
+
+	for (i = 0; i < n;) {
+		uint64_t v = mwc64();
+
+		SETDATA(t->data, i, v, prev);
+		SETDATA(t->data, i, v, prev);
+		SETDATA(t->data, i, v, prev);
+		SETDATA(t->data, i, v, prev);
+		SETDATA(t->data, i, v, prev);
+		SETDATA(t->data, i, v, prev);
+		SETDATA(t->data, i, v, prev);
+		SETDATA(t->data, i, v, prev);
+	}
+	(void)bsearch_eytzinger_build(t, 0, 1);
+	(void)bsearch_btree_build(t, 0, 0);
+	for (i = 0; i < n; i++) {
+		size_t slot = bsearch_hash_slot(t, t->data[i]);
+
+		while (t->hash[slot])
+			slot = (slot + 1) & t->hash_mask;
+		t->hash[slot] = t->data[i];
+	}
+	return 0;
+}
+
+/*
+ *  bsearch_lookups()
+ *	look up each of the keys with a method, returns
+ *	the number of keys that were found
+ */
+static size_t bsearch_lookups(
+	const bsearch_tables_t *t,
+	const int method,
+	const int32_t *keys,
+	const size_t nkeys)
+{
+	size_t i, found = 0;
+
+	switch (method) {
+	case BSEARCH_METHOD_LIBC:
+		for (i = 0; i < nkeys; i++)
+			found += (bsearch(&keys[i], t->data, t->n,
+				sizeof(*t->data), cmp) != NULL);
+		break;
+	case BSEARCH_METHOD_EYTZINGER:
+		for (i = 0; i < nkeys; i++)
+			found += bsearch_eytzinger(t, keys[i]);
+		break;
+	case BSEARCH_METHOD_BTREE:
+		for (i = 0; i < nkeys; i++)
+			found += bsearch_btree(t, keys[i]);
+		break;
+	default:
+		for (i = 0; i < nkeys; i++)
+			found += bsearch_hash(t, keys[i]);
+		break;
+	}
+	return found;
+}
+
+/*
+ *  bsearch_time_method()
+ *	look up random keys with a method for at least the given
+ *	time, or one batch of keys, adding to the method stats
+ */
+static void bsearch_time_method(
+	const char *name,
+	const bsearch_tables_t *t,
+	const int method,
+	int32_t *keys,
+	const double duration,
+	bsearch_stats_t *stats)
+{
+	const double t_start = time_now();
+	double t_now;
+
+	do {
+		size_t i, found;
+		double t1;
+
+		/* Picking random keys touches the data, so keep it untimed */
+		for (i = 0; i < BSEARCH_KEYS; i++)
+			keys[i] = t->data[mwc32() % t->n];
+		t1 = time_now();
+		found = bsearch_lookups(t, method, keys, BSEARCH_KEYS);
+		t_now = time_now();
+		stats->secs += t_now - t1;
+		stats->lookups += BSEARCH_KEYS;
+
+		if ((opt_flags & OPT_FLAGS_VERIFY) && (found != BSEARCH_KEYS))
+			pr_fail(stderr, "%s: %s found %zu of %d keys\n",
+				name, bsearch_methods[method].name,
+				found, BSEARCH_KEYS);
+	} while (opt_do_run && (t_now - t_start < duration));
+}
+
+static inline double bsearch_rate(const bsearch_stats_t *s)
+{
+	return (s->secs > 0.0) ? (double)s->lookups / s->secs / 1000000.0 : 0.0;
+}
+
+/*
+ *  stress_bsearch_methods()
+ *	compare random lookups in the libc bsearch with cache aware
+ *	search structures, at the --bsearch-size or sweeping the table
+ *	size from L1 cache to DRAM sized, reporting lookups per second
+ */
+static int stress_bsearch_methods(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const size_t size)
+{
+	const size_t min = opt_bsearch_sweep ? BSEARCH_SWEEP_MIN : size;
+	const size_t max = opt_bsearch_sweep ? BSEARCH_SWEEP_MAX : size;
+	const double duration = opt_bsearch_sweep ? BSEARCH_SWEEP_TIME : 0.0;
+	bsearch_stats_t first[BSEARCH_METHOD_MAX], last[BSEARCH_METHOD_MAX];
+	bsearch_tables_t t;
+	int32_t *keys;
+	bool reported = false;
+	int method;
+
+	keys = calloc(BSEARCH_KEYS, sizeof(*keys));
+	if (!keys) {
+		pr_fail_dbg(name, "malloc");
+		return EXIT_NO_RESOURCE;
+	}
+	memset(first, 0, sizeof(first));
+	memset(last, 0, sizeof(last));
+
+	do {
+		size_t n;
+
+		if ((instance == 0) && !reported) {
+			char hdr[80];
+
+			*hdr = '\0';
+			for (method = 0; method < BSEARCH_METHOD_MAX; method++) {
+				if ((opt_bsearch_method == BSEARCH_METHOD_ALL) ||
+				    (opt_bsearch_method == method))
+					(void)snprintf(hdr + strlen(hdr), sizeof(hdr) - strlen(hdr),
+						" %10s", bsearch_methods[method].name);
+			}
+			pr_inf(stderr, "%s: %10s%s (Mlookups/s)\n", name, "table KB", hdr);
+		}
+		for (n = min; n <= max; n *= 4) {
+			char row[80];
+
+			if (bsearch_tables_build(&t, n) < 0) {
+				pr_inf(stderr, "%s: cannot allocate %zu element "
+					"search tables, skipping\n", name, n);
+				break;
+			}
+			*row = '\0';
+			for (method = 0; method < BSEARCH_METHOD_MAX; method++) {
+				bsearch_stats_t s;
+
+				if ((opt_bsearch_method != BSEARCH_METHOD_ALL) &&
+				    (opt_bsearch_method != method))
+					continue;
+				memset(&s, 0, sizeof(s));
+				bsearch_time_method(name, &t, method, keys, duration, &s);
+				(void)snprintf(row + strlen(row), sizeof(row) - strlen(row),
+					" %10.2f", bsearch_rate(&s));
+				if (n == min) {
+					first[method].lookups += s.lookups;
+					first[method].secs += s.secs;
+				}
+				if (n * 4 > max) {
+					last[method].lookups += s.lookups;
+					last[method].secs += s.secs;
+				}
+				(*counter)++;
+				if (!opt_do_run || (max_ops && *counter >= max_ops))
+					break;
+			}
+			bsearch_tables_free(&t);
+			if ((instance == 0) && !reported)
+				pr_inf(stderr, "%s: %10zu%s\n", name,
+					(size_t)((n * sizeof(int32_t)) / KB), row);
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				break;
+		}
+		reported = true;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	for (method = 0; method < BSEARCH_METHOD_MAX; method++) {
+		char desc[40];
+
+		if (!first[method].lookups)
+			continue;
+		if (opt_bsearch_sweep) {
+			(void)snprintf(desc, sizeof(desc), "%s Mlookups/s smallest",
+				bsearch_methods[method].name);
+			stress_misc_metric_set(method * 2, desc, bsearch_rate(&first[method]));
+			(void)snprintf(desc, sizeof(desc), "%s Mlookups/s largest",
+				bsearch_methods[method].name);
+			stress_misc_metric_set((method * 2) + 1, desc, bsearch_rate(&last[method]));
+		} else {
+			(void)snprintf(desc, sizeof(desc), "%s Mlookups/s",
+				bsearch_methods[method].name);
+			stress_misc_metric_set(method, desc, bsearch_rate(&first[method]));
+		}
+	}
+	free(keys);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_bsearch()
  *	stress bsearch
@@ -82,17 +521,20 @@ int stress_bsearch(
 	const char *name)
 {
 	int32_t *data, *ptr, prev = 0;
+	uint64_t bsearch_size = opt_bsearch_size;
 	size_t n, n8, i;
 
-	(void)instance;
-
 	if (!set_bsearch_size) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
-			opt_bsearch_size = MAX_BSEARCH_SIZE;
+			bsearch_size = MAX_BSEARCH_SIZE;
 		if (opt_flags & OPT_FLAGS_MINIMIZE)
-			opt_bsearch_size = MIN_BSEARCH_SIZE;
+			bsearch_size = MIN_BSEARCH_SIZE;
 	}
-	n = (size_t)opt_bsearch_size;
+	if (set_bsearch_method || opt_bsearch_sweep)
+		return stress_bsearch_methods(counter, instance, max_ops, name,
+			(size_t)bsearch_size);
+
+	n = (size_t)bsearch_size;
 	n8 = (n + 7) & ~7;
 
 	/* allocate in multiples of 8 */
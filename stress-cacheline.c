@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "stress-ng.h"
+
+#if defined(HAVE_LIB_PTHREAD) && defined(__linux__) && NEED_GLIBC(2,3,0)
+#define STRESS_CACHELINE_MATRIX	(1)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#define CACHELINE_LOOPS		(1024)	/* ops per bogo op */
+#define CACHELINE_PINGPONGS	(10000)	/* round trips per CPU pair */
+#define CACHELINE_WORDS_PER_LINE (CACHELINE_SIZE / sizeof(uint64_t))
+
+typedef enum {
+	CACHELINE_LAYOUT_SHARED = 0,	/* all instances on one word */
+	CACHELINE_LAYOUT_SAME,		/* own word, all on the same line */
+	CACHELINE_LAYOUT_ADJACENT,	/* own line, lines next to each other */
+	CACHELINE_LAYOUT_PADDED,	/* own line, lines padded apart */
+	CACHELINE_LAYOUT_MAX,
+	CACHELINE_LAYOUT_ALL = CACHELINE_LAYOUT_MAX
+} cacheline_layout_t;
+
+typedef enum {
+	CACHELINE_OP_STORE = 0,		/* plain stores */
+	CACHELINE_OP_RMW,		/* atomic fetch and add */
+	CACHELINE_OP_CAS,		/* compare and swap loop */
+	CACHELINE_OP_MAX,
+} cacheline_op_t;
+
+static const char *cacheline_layouts[] = {
+	"shared", "same", "adjacent", "padded", "all"
+};
+
+static const char *cacheline_ops[] = {
+	"store", "rmw", "cas"
+};
+
+static cacheline_layout_t opt_cacheline_layout = CACHELINE_LAYOUT_ALL;
+static cacheline_op_t opt_cacheline_op = CACHELINE_OP_RMW;
+static uint32_t opt_cacheline_matrix = 0;	/* CPUs in matrix, 0 = off */
+
+/*
+ *  stress_set_cacheline_layout()
+ *	set how the per instance counters are laid out
+ */
+int stress_set_cacheline_layout(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(cacheline_layouts); i++) {
+		if (!strcmp(cacheline_layouts[i], name)) {
+			opt_cacheline_layout = (cacheline_layout_t)i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "cacheline-layout must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(cacheline_layouts); i++)
+		fprintf(stderr, " %s", cacheline_layouts[i]);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_cacheline_op()
+ *	set the operation used to update the counters
+ */
+int stress_set_cacheline_op(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(cacheline_ops); i++) {
+		if (!strcmp(cacheline_ops[i], name)) {
+			opt_cacheline_op = (cacheline_op_t)i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "cacheline-op must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(cacheline_ops); i++)
+		fprintf(stderr, " %s", cacheline_ops[i]);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_cacheline_matrix()
+ *	measure the latency matrix of up to N CPUs
+ */
+void stress_set_cacheline_matrix(const char *optarg)
+{
+	uint64_t n = get_uint64(optarg);
+
+	check_range("cacheline-matrix", n, 2, CACHELINE_MATRIX_MAX);
+	opt_cacheline_matrix = (uint32_t)n;
+}
+
+/*
+ *  cacheline_counter()
+ *	the counter of an instance for a layout, instances beyond
+ *	CACHELINE_SLOTS wrap around and share the slots
+ */
+static uint64_t *cacheline_counter(
+	const cacheline_layout_t layout,
+	const uint32_t instance)
+{
+	const uint32_t slot = instance % CACHELINE_SLOTS;
+	uint64_t *lines = shared->cacheline;
+
+	switch (layout) {
+	case CACHELINE_LAYOUT_SHARED:
+		return &lines[0];
+	case CACHELINE_LAYOUT_SAME:
+		/* 8 instances per line, contiguous words */
+		return &lines[slot];
+	case CACHELINE_LAYOUT_ADJACENT:
+		return &lines[slot * CACHELINE_WORDS_PER_LINE];
+	default:
+		return &lines[slot * CACHELINE_PAD_LINES * CACHELINE_WORDS_PER_LINE];
+	}
+}
+
+/*
+ *  cacheline_update()
+ *	CACHELINE_LOOPS updates of a counter
+ */
+static void OPTIMIZE3 cacheline_update(
+	uint64_t *counter,
+	const cacheline_op_t op)
+{
+	volatile uint64_t *vcounter = counter;
+	uint64_t val = *vcounter;
+	int i;
+
+	switch (op) {
+	case CACHELINE_OP_STORE:
+		for (i = 0; i < CACHELINE_LOOPS; i++)
+			*vcounter = val++;
+		break;
+	case CACHELINE_OP_RMW:
+		for (i = 0; i < CACHELINE_LOOPS; i++)
+			(void)__sync_fetch_and_add(counter, 1);
+		break;
+	default:
+		for (i = 0; i < CACHELINE_LOOPS; i++) {
+			uint64_t old;
+
+			do {
+				old = *vcounter;
+			} while (!__sync_bool_compare_and_swap(counter, old, old + 1));
+		}
+		break;
+	}
+}
+
+#if defined(STRESS_CACHELINE_MATRIX)
+typedef struct {
+	uint64_t seq;				/* ping-pong sequence number */
+	uint8_t pad[CACHELINE_SIZE - sizeof(uint64_t)];
+} cacheline_pingpong_t;
+
+typedef struct {
+	cacheline_pingpong_t *line;		/* the line to bounce */
+	int cpu;				/* CPU of the pong thread */
+	volatile bool ready;			/* pong thread is pinned */
+} cacheline_pong_t;
+
+/*
+ *  cacheline_pin()
+ *	pin the calling thread to a CPU
+ */
+static int cacheline_pin(const int cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	return sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/*
+ *  cacheline_pong()
+ *	answer each odd sequence number with the next even one
+ */
+static void *cacheline_pong(void *arg)
+{
+	cacheline_pong_t *pong = (cacheline_pong_t *)arg;
+	uint64_t seq = 1;
+	static void *nowt = NULL;
+
+	(void)cacheline_pin(pong->cpu);
+	pong->ready = true;
+
+	while (opt_do_run && (seq < 2 * CACHELINE_PINGPONGS)) {
+		if (__atomic_load_n(&pong->line->seq, __ATOMIC_ACQUIRE) == seq) {
+			__atomic_store_n(&pong->line->seq, seq + 1, __ATOMIC_RELEASE);
+			seq += 2;
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  cacheline_pingpong()
+ *	one way latency in nanoseconds of bouncing a cache line
+ *	between the calling thread on CPU a and a thread on CPU b,
+ *	returns a negative value on failure
+ */
+static double cacheline_pingpong(const char *name, const int a, const int b)
+{
+	static cacheline_pingpong_t line ALIGN64;
+	cacheline_pong_t pong;
+	pthread_t pthread;
+	uint64_t seq;
+	double t = 0.0;
+	int ret;
+
+	if (cacheline_pin(a) < 0) {
+		pr_fail_dbg(name, "sched_setaffinity");
+		return -1.0;
+	}
+	line.seq = 0;
+	pong.line = &line;
+	pong.cpu = b;
+	pong.ready = false;
+
+	ret = pthread_create(&pthread, NULL, cacheline_pong, &pong);
+	if (ret) {
+		pr_fail_errno(name, "pthread create", ret);
+		return -1.0;
+	}
+	while (opt_do_run && !pong.ready)
+		;
+
+	/* The first round trips warm up the line and the threads */
+	for (seq = 1; opt_do_run && (seq < 2 * CACHELINE_PINGPONGS); seq += 2) {
+		if (seq == CACHELINE_PINGPONGS / 8 * 2 + 1)
+			t = time_now();
+		__atomic_store_n(&line.seq, seq, __ATOMIC_RELEASE);
+		while (opt_do_run &&
+		       (__atomic_load_n(&line.seq, __ATOMIC_ACQUIRE) != seq + 1))
+			;
+	}
+	t = time_now() - t;
+	(void)pthread_join(pthread, NULL);
+
+	if (!opt_do_run)
+		return -1.0;
+	/* Each round trip is two one way transfers of the line */
+	return (t * 1000000000.0) /
+		(2.0 * (CACHELINE_PINGPONGS - (CACHELINE_PINGPONGS / 8)));
+}
+
+/*
+ *  stress_cacheline_matrix()
+ *	measure the cache to cache latency between every pair of
+ *	up to opt_cacheline_matrix CPUs, sampled evenly from the
+ *	allowed CPUs on bigger machines, one bogo op per pair
+ */
+static int stress_cacheline_matrix(
+	uint64_t *const counter,
+	const char *name)
+{
+	cpu_set_t mask;
+	int allowed[CPU_SETSIZE];
+	uint32_t n_allowed = 0, n, i, j;
+	int cpu;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask) < 0) {
+		pr_fail_err(name, "sched_getaffinity");
+		return EXIT_FAILURE;
+	}
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET(cpu, &mask))
+			allowed[n_allowed++] = cpu;
+	if (n_allowed < 2) {
+		pr_inf(stderr, "%s: need at least 2 CPUs to measure the "
+			"latency matrix\n", name);
+		return EXIT_SUCCESS;
+	}
+
+	n = (n_allowed < opt_cacheline_matrix) ? n_allowed : opt_cacheline_matrix;
+	for (i = 0; i < n; i++)
+		shared->cacheline_matrix.cpus[i] = allowed[(i * n_allowed) / n];
+
+	for (i = 0; opt_do_run && (i < n); i++) {
+		for (j = 0; opt_do_run && (j < n); j++) {
+			double nsec = 0.0;
+
+			if (i != j) {
+				nsec = cacheline_pingpong(name,
+					shared->cacheline_matrix.cpus[i],
+					shared->cacheline_matrix.cpus[j]);
+				if (nsec < 0.0)
+					break;
+				(*counter)++;
+			}
+			shared->cacheline_matrix.nsec[i][j] = (float)nsec;
+		}
+	}
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+
+	if (!opt_do_run) {
+		pr_inf(stderr, "%s: run time too short to measure the "
+			"whole latency matrix\n", name);
+		return EXIT_SUCCESS;
+	}
+	shared->cacheline_matrix.n = n;
+	return EXIT_SUCCESS;
+}
+#endif
+
+/*
+ *  stress_cacheline_matrix_dump()
+ *	output the cache to cache latency matrix
+ */
+void stress_cacheline_matrix_dump(FILE *yaml, json_t *json)
+{
+	const uint32_t n = shared->cacheline_matrix.n;
+	char buf[16];
+	uint32_t i, j;
+
+	if (!n)
+		return;
+
+	pr_inf(stdout, "cache to cache one way latency (nanoseconds):\n");
+	pr_inf(stdout, "%s", "   CPU");
+	for (j = 0; j < n; j++)
+		pr_inf(stdout, " %6" PRId32, shared->cacheline_matrix.cpus[j]);
+	pr_inf(stdout, "\n");
+	for (i = 0; i < n; i++) {
+		pr_inf(stdout, "%6" PRId32, shared->cacheline_matrix.cpus[i]);
+		for (j = 0; j < n; j++) {
+			(void)snprintf(buf, sizeof(buf), "%.1f",
+				shared->cacheline_matrix.nsec[i][j]);
+			pr_inf(stdout, " %6s", i == j ? "-" : buf);
+		}
+		pr_inf(stdout, "\n");
+	}
+
+	pr_yaml(yaml, "cache-to-cache-latency:\n");
+	pr_yaml(yaml, "    cpus: [");
+	for (j = 0; j < n; j++)
+		pr_yaml(yaml, "%s%" PRId32, j ? ", " : "", shared->cacheline_matrix.cpus[j]);
+	pr_yaml(yaml, "]\n");
+	pr_yaml(yaml, "    latency-nanoseconds:\n");
+	for (i = 0; i < n; i++) {
+		pr_yaml(yaml, "      - [");
+		for (j = 0; j < n; j++)
+			pr_yaml(yaml, "%s%.1f", j ? ", " : "",
+				shared->cacheline_matrix.nsec[i][j]);
+		pr_yaml(yaml, "]\n");
+	}
+	pr_yaml(yaml, "\n");
+
+	json_obj_begin(json, "cache-to-cache-latency");
+	json_array_begin(json, "cpus");
+	for (j = 0; j < n; j++)
+		json_int(json, NULL, shared->cacheline_matrix.cpus[j]);
+	json_array_end(json);
+	json_array_begin(json, "latency-nanoseconds");
+	for (i = 0; i < n; i++) {
+		json_array_begin(json, NULL);
+		for (j = 0; j < n; j++)
+			json_double(json, NULL, shared->cacheline_matrix.nsec[i][j]);
+		json_array_end(json);
+	}
+	json_array_end(json);
+	json_obj_end(json);
+}
+
+/*
+ *  stress_cacheline()
+ *	stress cache coherency by updating per instance counters
+ *	that share a word, share a line or are on separate lines.
+ *	With --cacheline-layout all the layouts take turns in
+ *	wall clock aligned time slices so all the instances use
+ *	the same layout at the same time
+ */
+int stress_cacheline(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	uint64_t ops[CACHELINE_LAYOUT_MAX];
+	double duration[CACHELINE_LAYOUT_MAX];
+	size_t i, k;
+
+	if (opt_cacheline_matrix) {
+#if defined(STRESS_CACHELINE_MATRIX)
+		/* Other instances would disturb the measurements */
+		if (!instance)
+			return stress_cacheline_matrix(counter, name);
+		pr_dbg(stderr, "%s: only instance 0 measures the latency "
+			"matrix, exiting\n", name);
+		return EXIT_SUCCESS;
+#else
+		if (!instance)
+			pr_inf(stderr, "%s: latency matrix not supported, "
+				"ignoring --cacheline-matrix\n", name);
+#endif
+	}
+
+	if (!instance)
+		pr_dbg(stderr, "%s: using %s operations on %s layout\n",
+			name, cacheline_ops[opt_cacheline_op],
+			cacheline_layouts[opt_cacheline_layout]);
+
+	memset(ops, 0, sizeof(ops));
+	memset(duration, 0, sizeof(duration));
+
+	do {
+		const double t = time_now();
+		const cacheline_layout_t layout =
+			(opt_cacheline_layout == CACHELINE_LAYOUT_ALL) ?
+			(cacheline_layout_t)((uint64_t)(t * 10.0) % CACHELINE_LAYOUT_MAX) :
+			opt_cacheline_layout;
+
+		cacheline_update(cacheline_counter(layout, instance), opt_cacheline_op);
+		duration[layout] += time_now() - t;
+		ops[layout] += CACHELINE_LOOPS;
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	for (k = 0, i = 0; i < CACHELINE_LAYOUT_MAX; i++) {
+		char description[32];
+
+		if (duration[i] <= 0.0)
+			continue;
+		(void)snprintf(description, sizeof(description),
+			"%s %s ops/sec", cacheline_layouts[i],
+			cacheline_ops[opt_cacheline_op]);
+		stress_misc_metric_set(k++, description,
+			(double)ops[i] / duration[i]);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -36,6 +36,24 @@
 
 #if defined(STRESS_CLOCK)
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#if defined(STRESS_X86)
+#include <cpuid.h>
+#endif
+
+#define CLOCK_COST_CALLS	(10000)		/* calls per timed batch */
+#define CLOCK_COST_ROUNDS	(16)		/* batches before reporting */
+#define CLOCK_COST_SOURCE	"/sys/devices/system/clocksource/clocksource0/current_clocksource"
+
+static bool opt_clock_cost = false;
+
+void stress_set_clock_cost(void)
+{
+	opt_clock_cost = true;
+}
+
 typedef struct {
 	int	id;		/* Clock ID */
 	char 	*name;		/* Clock name */
@@ -104,6 +122,286 @@ static char *stress_clock_name(int id)
 	return "(unknown clock)";
 }
 
+typedef struct {
+	double best;		/* fastest batch in nanoseconds */
+	uint64_t batches;	/* number of timed batches */
+} clock_cost_t;
+
+/*
+ *  clock_cost_ns()
+ *	nanoseconds per call of the fastest batch, the least
+ *	disturbed by interrupts and preemption, 0.0 if never
+ *	measured
+ */
+static inline double clock_cost_ns(const clock_cost_t *c)
+{
+	return c->batches ? c->best / (double)CLOCK_COST_CALLS : 0.0;
+}
+
+/*
+ *  clock_cost_add()
+ *	account a timed batch
+ */
+static inline void clock_cost_add(clock_cost_t *c, const double ns)
+{
+	if (!c->batches || (ns < c->best))
+		c->best = ns;
+	c->batches++;
+}
+
+/*
+ *  clock_cost_libc()
+ *	n clock_gettime() calls through libc, using the vDSO
+ *	when the kernel provides one for the clock
+ */
+static int clock_cost_libc(const int id, const uint32_t n)
+{
+	struct timespec t;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		if (clock_gettime(id, &t) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ *  clock_cost_syscall()
+ *	n clock_gettime() system calls, bypassing the vDSO
+ */
+static int clock_cost_syscall(const int id, const uint32_t n)
+{
+#if defined(__NR_clock_gettime)
+	struct timespec t;
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		if (syscall(__NR_clock_gettime, id, &t) < 0)
+			return -1;
+	}
+	return 0;
+#else
+	(void)id;
+	(void)n;
+	return -1;
+#endif
+}
+
+typedef struct {
+	const char *name;		/* counter instruction name */
+	void (*read)(const uint32_t n);	/* n reads of the counter */
+	bool supported;			/* CPU supports it */
+} clock_counter_t;
+
+static volatile uint64_t clock_counter_sink;
+
+#if defined(STRESS_X86)
+static void clock_cost_rdtsc(const uint32_t n)
+{
+	uint32_t i, lo, hi;
+
+	for (i = 0; i < n; i++) {
+		asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+		clock_counter_sink = ((uint64_t)hi << 32) | lo;
+	}
+}
+
+static void clock_cost_rdtscp(const uint32_t n)
+{
+	uint32_t i, lo, hi;
+
+	for (i = 0; i < n; i++) {
+		asm volatile("rdtscp" : "=a"(lo), "=d"(hi) : : "%ecx");
+		clock_counter_sink = ((uint64_t)hi << 32) | lo;
+	}
+}
+#endif
+
+#if defined(__aarch64__)
+static void clock_cost_cntvct(const uint32_t n)
+{
+	uint32_t i;
+	uint64_t v;
+
+	for (i = 0; i < n; i++) {
+		asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+		clock_counter_sink = v;
+	}
+}
+#endif
+
+static clock_counter_t clock_counters[] = {
+#if defined(STRESS_X86)
+	{ "rdtsc",	clock_cost_rdtsc,	false },
+	{ "rdtscp",	clock_cost_rdtscp,	false },
+#endif
+#if defined(__aarch64__)
+	{ "cntvct_el0",	clock_cost_cntvct,	true },
+#endif
+	{ NULL,		NULL,			false },
+};
+
+/*
+ *  clock_counters_probe()
+ *	find which counter instructions the CPU has
+ */
+static void clock_counters_probe(void)
+{
+#if defined(STRESS_X86)
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		clock_counters[0].supported = !!(edx & (1U << 4));
+	if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx))
+		clock_counters[1].supported = !!(edx & (1U << 27));
+#endif
+}
+
+/*
+ *  clock_cost_time()
+ *	time a batch of calls or counter reads, returns < 0.0
+ *	if the clock could not be read
+ */
+static double clock_cost_time(
+	const int id,
+	const int how,
+	const clock_counter_t *counter)
+{
+	double t = time_now();
+
+	if (counter)
+		counter->read(CLOCK_COST_CALLS);
+	else if ((how ? clock_cost_syscall : clock_cost_libc)(id, CLOCK_COST_CALLS) < 0)
+		return -1.0;
+	return (time_now() - t) * 1000000000.0;
+}
+
+/*
+ *  stress_clock_cost()
+ *	measure the cost of reading each clock through libc
+ *	and as a system call, and of the raw counter reads.
+ *	A libc read that costs as much as the system call means
+ *	the vDSO is not used, e.g. the clocksource cannot be
+ *	read from user space
+ */
+static int stress_clock_cost(
+	const char *name,
+	const uint32_t instance,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	clock_cost_t costs[SIZEOF_ARRAY(clocks)][2];
+	clock_cost_t counter_costs[SIZEOF_ARRAY(clock_counters)];
+	bool reported = false;
+	uint32_t rounds = 0;
+	size_t i;
+	int how;
+
+	clock_counters_probe();
+	(void)memset(costs, 0, sizeof(costs));
+	(void)memset(counter_costs, 0, sizeof(counter_costs));
+
+	do {
+		for (i = 0; i < SIZEOF_ARRAY(clocks); i++) {
+			for (how = 0; how < 2; how++) {
+				double ns;
+
+				if (!opt_do_run || (max_ops && *counter >= max_ops))
+					goto done;
+				ns = clock_cost_time(clocks[i].id, how, NULL);
+				if (ns < 0.0)
+					continue;
+				clock_cost_add(&costs[i][how], ns);
+				(*counter)++;
+			}
+		}
+		for (i = 0; clock_counters[i].name; i++) {
+			if (!clock_counters[i].supported)
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			clock_cost_add(&counter_costs[i],
+				clock_cost_time(0, 0, &clock_counters[i]));
+			(*counter)++;
+		}
+		rounds++;
+
+		if ((instance == 0) && !reported && (rounds >= CLOCK_COST_ROUNDS)) {
+			char source[64];
+			bool fallback = false;
+
+			if (system_read(CLOCK_COST_SOURCE, source, sizeof(source)) > 0)
+				source[strcspn(source, "\n")] = '\0';
+			else
+				(void)snprintf(source, sizeof(source), "unknown");
+
+			pr_inf(stderr, "%s: clocksource %s\n", name, source);
+			pr_inf(stderr, "%s: %-24s %9s %11s %5s\n", name,
+				"clock", "libc ns", "syscall ns", "vdso");
+			for (i = 0; i < SIZEOF_ARRAY(clocks); i++) {
+				const double libc_ns = clock_cost_ns(&costs[i][0]);
+				const double sys_ns = clock_cost_ns(&costs[i][1]);
+				const bool vdso = (sys_ns > 0.0) && (libc_ns < sys_ns / 2.0);
+
+				pr_inf(stderr, "%s: %-24s %9.1f %11.1f %5s\n", name,
+					clocks[i].name, libc_ns, sys_ns,
+					(sys_ns > 0.0) ? (vdso ? "yes" : "no") : "-");
+#if defined(CLOCK_MONOTONIC) && defined(CLOCK_REALTIME)
+				if (!vdso && (sys_ns > 0.0) &&
+				    ((clocks[i].id == CLOCK_MONOTONIC) ||
+				     (clocks[i].id == CLOCK_REALTIME)))
+					fallback = true;
+#endif
+			}
+			for (i = 0; clock_counters[i].name; i++) {
+				if (clock_counters[i].supported)
+					pr_inf(stderr, "%s: %-24s %9.1f\n", name,
+						clock_counters[i].name,
+						clock_cost_ns(&counter_costs[i]));
+			}
+			if (fallback)
+				pr_inf(stderr, "%s: WARNING: clock_gettime() is not "
+					"using the vDSO, every timestamp is a system "
+					"call, check clocksource %s\n", name, source);
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (i = 0; i < SIZEOF_ARRAY(clocks); i++) {
+#if defined(CLOCK_MONOTONIC)
+		if (clocks[i].id == CLOCK_MONOTONIC) {
+			const double libc_ns = clock_cost_ns(&costs[i][0]);
+			const double sys_ns = clock_cost_ns(&costs[i][1]);
+
+			stress_misc_metric_set(0, "CLOCK_MONOTONIC ns per call",
+				libc_ns);
+			stress_misc_metric_set(1, "syscall ns per call", sys_ns);
+			if (sys_ns > 0.0)
+				stress_misc_metric_set(2, "vDSO in use (1 = yes)",
+					(libc_ns < sys_ns / 2.0) ? 1.0 : 0.0);
+		}
+#endif
+#if defined(CLOCK_REALTIME)
+		if (clocks[i].id == CLOCK_REALTIME)
+			stress_misc_metric_set(3, "CLOCK_REALTIME ns per call",
+				clock_cost_ns(&costs[i][0]));
+#endif
+	}
+	for (i = 0; clock_counters[i].name; i++) {
+		char desc[48];
+
+		if (!counter_costs[i].batches)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s ns per read",
+			clock_counters[i].name);
+		stress_misc_metric_set(4 + i, desc,
+			clock_cost_ns(&counter_costs[i]));
+	}
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_clock()
  *	stress system by rapid clocking system calls
@@ -114,7 +412,8 @@ int stress_clock(
 	const uint64_t max_ops,
 	const char *name)
 {
-	(void)instance;
+	if (opt_clock_cost)
+		return stress_clock_cost(name, instance, counter, max_ops);
 
 	do {
 		size_t i;
@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_COMPACT)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define COMPACT_THP_SIZE	(2 * MB)	/* x86 PMD sized THP pages */
+#define COMPACT_1GB_SIZE	(1 * GB)	/* hugetlbfs 1G pages */
+
+/* /proc/vmstat compaction and THP fault counters */
+typedef struct {
+	uint64_t compact_stall;		/* direct compaction attempts */
+	uint64_t compact_success;	/* direct compactions freeing a page */
+	uint64_t compact_fail;		/* direct compactions that failed */
+	uint64_t thp_fault_alloc;	/* THP faults that got a huge page */
+	uint64_t thp_fault_fallback;	/* THP faults that fell back to 4K */
+} compact_vmstat_t;
+
+static uint64_t opt_compact_bytes = DEFAULT_COMPACT_BYTES;
+static bool set_compact_bytes = false;
+static uint32_t opt_compact_keep = DEFAULT_COMPACT_KEEP;
+static uint32_t opt_compact_pin = DEFAULT_COMPACT_PIN;
+
+void stress_set_compact_bytes(const char *optarg)
+{
+	set_compact_bytes = true;
+	opt_compact_bytes = get_uint64_byte(optarg);
+	check_range("compact-bytes", opt_compact_bytes,
+		MIN_COMPACT_BYTES, MAX_COMPACT_BYTES);
+}
+
+void stress_set_compact_keep(const char *optarg)
+{
+	opt_compact_keep = (uint32_t)get_uint64(optarg);
+	check_range("compact-keep", opt_compact_keep,
+		MIN_COMPACT_KEEP, MAX_COMPACT_KEEP);
+}
+
+void stress_set_compact_pin(const char *optarg)
+{
+	opt_compact_pin = (uint32_t)get_uint64(optarg);
+	check_range("compact-pin", opt_compact_pin,
+		MIN_COMPACT_PIN, MAX_COMPACT_PIN);
+}
+
+/*
+ *  compact_vmstat()
+ *	read the compaction and THP fault counters
+ *	from /proc/vmstat, false if they are missing
+ */
+static bool compact_vmstat(compact_vmstat_t *v)
+{
+	char buf[128];
+	FILE *fp;
+	int n = 0;
+
+	memset(v, 0, sizeof(*v));
+	fp = fopen("/proc/vmstat", "r");
+	if (!fp)
+		return false;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (sscanf(buf, "compact_stall %" SCNu64, &v->compact_stall) == 1)
+			n++;
+		else if (sscanf(buf, "compact_success %" SCNu64, &v->compact_success) == 1)
+			n++;
+		else if (sscanf(buf, "compact_fail %" SCNu64, &v->compact_fail) == 1)
+			n++;
+		else if (sscanf(buf, "thp_fault_alloc %" SCNu64, &v->thp_fault_alloc) == 1)
+			n++;
+		else if (sscanf(buf, "thp_fault_fallback %" SCNu64, &v->thp_fault_fallback) == 1)
+			n++;
+	}
+	(void)fclose(fp);
+	return n == 5;
+}
+
+/*
+ *  compact_fragment()
+ *	fault in every page of the fragment region, then free a
+ *	random selection leaving --compact-keep percent of the
+ *	pages scattered over physical memory, and mlock a
+ *	--compact-pin percent of the pages kept
+ */
+static uint64_t compact_fragment(
+	uint8_t *frag,
+	const size_t frag_len,
+	const size_t page_size)
+{
+	const uint32_t keep = opt_compact_keep * 100;
+	const uint32_t pin = opt_compact_pin * 100;
+	uint64_t pinned = 0;
+	size_t i;
+
+	(void)munlock(frag, frag_len);
+	for (i = 0; i < frag_len; i += page_size) {
+		if (!opt_do_run)
+			return pinned;
+		frag[i] = (uint8_t)i;
+	}
+	for (i = 0; i < frag_len; i += page_size) {
+		if ((mwc32() % 10000) >= keep) {
+			(void)madvise(frag + i, page_size, MADV_DONTNEED);
+		} else if ((mwc32() % 10000) < pin) {
+			if (stress_mlock_region(frag + i, frag + i + page_size) == 0)
+				pinned++;
+		}
+	}
+	return pinned;
+}
+
+/*
+ *  compact_huge_map()
+ *	map a huge page region, hugetlbfs when --hugepages 2M or 1G
+ *	is used (falling back to THP), otherwise an aligned
+ *	MADV_HUGEPAGE region, NULL on failure
+ */
+static uint8_t *compact_huge_map(const hugepages_t mode, const size_t len)
+{
+	uint8_t *ptr, *aligned;
+
+	if (mode != HUGEPAGES_NONE) {
+		ptr = mmap_hugepages(mode, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1);
+		return (ptr == MAP_FAILED) ? NULL : ptr;
+	}
+
+	ptr = mmap(NULL, len + COMPACT_THP_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	aligned = (uint8_t *)(((uintptr_t)ptr + COMPACT_THP_SIZE - 1) &
+		~((uintptr_t)COMPACT_THP_SIZE - 1));
+	if (aligned > ptr)
+		(void)munmap(ptr, (size_t)(aligned - ptr));
+	if (aligned < ptr + COMPACT_THP_SIZE)
+		(void)munmap(aligned + len, (size_t)((ptr + COMPACT_THP_SIZE) - aligned));
+	(void)madvise_hugepages(HUGEPAGES_THP, aligned, len);
+	return aligned;
+}
+
+/*
+ *  stress_compact()
+ *	fragment physical memory with scattered and pinned pages
+ *	then ask for huge pages, reporting how many were granted,
+ *	how often and for how long the allocations were stalled
+ *	in direct compaction and the allocation latency
+ */
+int stress_compact(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t page_size = stress_get_pagesize();
+	const hugepages_t mode = (stress_get_hugepages() == HUGEPAGES_1G) ?
+		HUGEPAGES_1G : (stress_get_hugepages() == HUGEPAGES_2M) ?
+		HUGEPAGES_2M : HUGEPAGES_NONE;
+	const size_t huge_size = (mode == HUGEPAGES_1G) ?
+		COMPACT_1GB_SIZE : COMPACT_THP_SIZE;
+	size_t frag_len, huge_len;
+	uint8_t *frag;
+	compact_vmstat_t start, end;
+	stress_latency_t lat;
+	uint64_t requested = 0, granted = 0, stalled = 0, pinned = 0;
+	uint64_t stall_ns = 0, alloc_ns = 0;
+	bool vmstat_ok;
+
+	(void)instance;
+
+	if (!set_compact_bytes) {
+		if (opt_flags & OPT_FLAGS_MAXIMIZE)
+			opt_compact_bytes = MAX_COMPACT_BYTES;
+		if (opt_flags & OPT_FLAGS_MINIMIZE)
+			opt_compact_bytes = MIN_COMPACT_BYTES;
+	}
+	opt_compact_bytes /= stressor_instances(STRESS_COMPACT);
+	if (opt_compact_bytes < MIN_COMPACT_BYTES)
+		opt_compact_bytes = MIN_COMPACT_BYTES;
+
+	/* Fragment half of the memory, ask for huge pages in the other half */
+	frag_len = (size_t)(opt_compact_bytes / 2) & ~(page_size - 1);
+	huge_len = (size_t)(opt_compact_bytes / 2) & ~(huge_size - 1);
+	if (!huge_len)
+		huge_len = huge_size;
+
+	/* Make sure this is killable by OOM killer */
+	set_oom_adjustment(name, true);
+
+	frag = mmap(NULL, frag_len, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (frag == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot mmap %zu byte fragment region, "
+			"errno=%d (%s), skipping stressor\n",
+			name, frag_len, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+#if defined(MADV_NOHUGEPAGE)
+	/* The fragmenting pages must be small pages */
+	(void)madvise(frag, frag_len, MADV_NOHUGEPAGE);
+#endif
+
+	memset(&lat, 0, sizeof(lat));
+	vmstat_ok = compact_vmstat(&start);
+	if (!vmstat_ok)
+		pr_dbg(stderr, "%s: cannot read compaction counters from "
+			"/proc/vmstat, compaction stalls not reported\n", name);
+
+	do {
+		uint8_t *huge;
+		size_t i;
+
+		pinned += compact_fragment(frag, frag_len, page_size);
+		if (!opt_do_run)
+			break;
+
+		huge = compact_huge_map(mode, huge_len);
+		if (!huge) {
+			/* hugetlbfs reservations fail as a whole */
+			requested += huge_len / huge_size;
+			(*counter)++;
+			continue;
+		}
+		for (i = 0; i < huge_len; i += huge_size) {
+			compact_vmstat_t before, after;
+			uint64_t t, ns;
+
+			if (!opt_do_run)
+				break;
+			if (vmstat_ok)
+				(void)compact_vmstat(&before);
+			t = time_now_ns();
+			huge[i] = 1;
+			ns = time_now_ns() - t;
+			latency_record(&lat, ns);
+			alloc_ns += ns;
+			requested++;
+			if (vmstat_ok) {
+				(void)compact_vmstat(&after);
+				if (after.compact_stall > before.compact_stall) {
+					stalled++;
+					stall_ns += ns;
+				}
+			}
+		}
+		granted += hugepages_mapped(huge, huge_len);
+		(void)munmap(huge, huge_len);
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	(void)munlock(frag, frag_len);
+	(void)munmap(frag, frag_len);
+
+	if (requested) {
+		stress_misc_metric_set(0, "huge page success %",
+			100.0 * (double)granted / (double)requested);
+		stress_misc_metric_set(1, "alloc latency mean us",
+			(double)alloc_ns / (double)requested / 1000.0);
+		stress_misc_metric_set(2, "alloc latency p99 us",
+			(double)latency_percentile(&lat, 0.99) / 1000.0);
+		stress_misc_metric_set(3, "alloc latency max us",
+			(double)lat.max / 1000.0);
+		stress_misc_metric_set(4, "pages pinned per round",
+			(double)pinned / (double)*counter);
+	}
+	if (vmstat_ok && compact_vmstat(&end) && requested) {
+		const uint64_t stalls = end.compact_stall - start.compact_stall;
+		const uint64_t ok = end.compact_success - start.compact_success;
+		const uint64_t fail = end.compact_fail - start.compact_fail;
+
+		stress_misc_metric_set(5, "compaction stalled allocs %",
+			100.0 * (double)stalled / (double)requested);
+		stress_misc_metric_set(6, "compaction stall ms",
+			(double)stall_ns / 1000000.0);
+		stress_misc_metric_set(7, "system compact stalls",
+			(double)stalls);
+		stress_misc_metric_set(8, "system compact success %",
+			(ok + fail) ? 100.0 * (double)ok / (double)(ok + fail) : 0.0);
+		stress_misc_metric_set(9, "system thp fault fallbacks",
+			(double)(end.thp_fault_fallback - start.thp_fault_fallback));
+	}
+
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -23,6 +23,11 @@
  *
  */
 #define _GNU_SOURCE
+/*
+ *  The setjmp/longjmp coroutines jump between stacks, which the
+ *  fortified longjmp takes for a jump into a dead stack frame
+ */
+#undef _FORTIFY_SOURCE
 
 #include "stress-ng.h"
 
@@ -32,9 +37,32 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <setjmp.h>
 #include <ucontext.h>
 
 #define STACK_SIZE	(16384)
+#define COMPARE_SWITCHES (10000)	/* round trips per timed method */
+
+/* the coroutine switches --context-compare times */
+typedef enum {
+	COMPARE_SWAPCONTEXT = 0,	/* glibc, a sigprocmask syscall each */
+	COMPARE_SETJMP,			/* setjmp/longjmp, no signal mask */
+	COMPARE_ASM,			/* callee saved registers and sp only */
+	COMPARE_MAX
+} compare_method_t;
+
+static const char *compare_names[COMPARE_MAX] = {
+	"swapcontext",
+	"setjmp/longjmp",
+	"asm",
+};
+
+static bool opt_context_compare = false;
+
+void stress_set_context_compare(void)
+{
+	opt_context_compare = true;
+}
 
 #if !defined(__gnu_hurd__) && !defined(__minix__)
 uint8_t stack_sig[SIGSTKSZ] ALIGN64;	/* ensure we have a sig stack */
@@ -67,6 +95,141 @@ static void thread3(void)
 	} while (opt_do_run && (!__max_ops || __counter < __max_ops));
 }
 
+static ucontext_t uctx_cmp_main, uctx_cmp_swap, uctx_cmp_setjmp;
+static jmp_buf jmp_cmp_main, jmp_cmp_fiber;
+static uint8_t stack_cmp[COMPARE_MAX][STACK_SIZE] ALIGN64;
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#define HAVE_CONTEXT_ASM
+
+static void *sp_cmp_main, *sp_cmp_fiber;
+
+/*
+ *  stress_context_fiber_switch(from, to)
+ *	save the callee saved registers on the stack, store the stack
+ *	pointer in *from and resume the stack to, as its registers were
+ *	saved the same way. Nothing else, no signal mask or FP control.
+ */
+extern void stress_context_fiber_switch(void **from, void *to);
+
+#if defined(__x86_64__)
+/* a new fiber stack has 6 registers and then its entry to ret to */
+#define FIBER_FRAME	(6 * sizeof(void *))
+#define FIBER_RET	(6)
+
+__asm__(
+	".text\n"
+	".p2align 4\n"
+	".globl stress_context_fiber_switch\n"
+	".hidden stress_context_fiber_switch\n"
+	"stress_context_fiber_switch:\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	movq %rsp, (%rdi)\n"
+	"	movq %rsi, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n");
+#else
+/* a new fiber stack has x19..x29, x30 = entry, then d8..d15 */
+#define FIBER_FRAME	(22 * sizeof(void *))
+#define FIBER_RET	(11)
+
+__asm__(
+	".text\n"
+	".p2align 4\n"
+	".globl stress_context_fiber_switch\n"
+	".hidden stress_context_fiber_switch\n"
+	"stress_context_fiber_switch:\n"
+	"	sub sp, sp, #176\n"
+	"	stp x19, x20, [sp, #0]\n"
+	"	stp x21, x22, [sp, #16]\n"
+	"	stp x23, x24, [sp, #32]\n"
+	"	stp x25, x26, [sp, #48]\n"
+	"	stp x27, x28, [sp, #64]\n"
+	"	stp x29, x30, [sp, #80]\n"
+	"	stp d8, d9, [sp, #96]\n"
+	"	stp d10, d11, [sp, #112]\n"
+	"	stp d12, d13, [sp, #128]\n"
+	"	stp d14, d15, [sp, #144]\n"
+	"	mov x2, sp\n"
+	"	str x2, [x0]\n"
+	"	mov sp, x1\n"
+	"	ldp x19, x20, [sp, #0]\n"
+	"	ldp x21, x22, [sp, #16]\n"
+	"	ldp x23, x24, [sp, #32]\n"
+	"	ldp x25, x26, [sp, #48]\n"
+	"	ldp x27, x28, [sp, #64]\n"
+	"	ldp x29, x30, [sp, #80]\n"
+	"	ldp d8, d9, [sp, #96]\n"
+	"	ldp d10, d11, [sp, #112]\n"
+	"	ldp d12, d13, [sp, #128]\n"
+	"	ldp d14, d15, [sp, #144]\n"
+	"	add sp, sp, #176\n"
+	"	ret\n");
+#endif
+
+static void compare_asm_fiber(void)
+{
+	for (;;)
+		stress_context_fiber_switch(&sp_cmp_fiber, sp_cmp_main);
+}
+
+/*
+ *  compare_asm_init()
+ *	lay out a new fiber stack as if it had switched out just
+ *	before entering compare_asm_fiber, the entry is 16 byte
+ *	aligned so the fiber starts with the stack the ABI expects
+ */
+static void compare_asm_init(void)
+{
+	uintptr_t top = ((uintptr_t)stack_cmp[COMPARE_ASM] + STACK_SIZE) & ~15UL;
+	void **frame;
+
+#if defined(__x86_64__)
+	top -= 16;
+#else
+	top -= 176 - FIBER_FRAME;
+#endif
+	frame = (void **)(top - FIBER_FRAME);
+	(void)memset(frame, 0, FIBER_FRAME);
+	frame[FIBER_RET] = (void *)compare_asm_fiber;
+	sp_cmp_fiber = frame;
+}
+#endif
+
+static void compare_swap_fiber(void)
+{
+	for (;;)
+		(void)swapcontext(&uctx_cmp_swap, &uctx_cmp_main);
+}
+
+static void compare_setjmp_fiber(void)
+{
+	for (;;) {
+		if (!setjmp(jmp_cmp_fiber))
+			longjmp(jmp_cmp_main, 1);
+	}
+}
+
+/*
+ *  compare_setjmp_start()
+ *	start the setjmp fiber, it parks itself and jumps back
+ */
+static void compare_setjmp_start(void)
+{
+	if (!setjmp(jmp_cmp_main))
+		(void)swapcontext(&uctx_cmp_main, &uctx_cmp_setjmp);
+}
+
 static int stress_context_init(
 	const char *name,
 	void (*func)(void),
@@ -88,6 +251,86 @@ static int stress_context_init(
 	return 0;
 }
 
+/*
+ *  compare_time()
+ *	ns per switch of COMPARE_SWITCHES round trips of two
+ *	switches between this and a parked fiber
+ */
+static double compare_time(const compare_method_t method)
+{
+	static volatile int i;
+	double t;
+
+	t = time_now();
+	switch (method) {
+	case COMPARE_SWAPCONTEXT:
+		for (i = 0; i < COMPARE_SWITCHES; i++)
+			(void)swapcontext(&uctx_cmp_main, &uctx_cmp_swap);
+		break;
+	case COMPARE_SETJMP:
+		for (i = 0; i < COMPARE_SWITCHES; i++) {
+			if (!setjmp(jmp_cmp_main))
+				longjmp(jmp_cmp_fiber, 1);
+		}
+		break;
+	default:
+#if defined(HAVE_CONTEXT_ASM)
+		for (i = 0; i < COMPARE_SWITCHES; i++)
+			stress_context_fiber_switch(&sp_cmp_main, sp_cmp_fiber);
+#endif
+		break;
+	}
+	t = time_now() - t;
+
+	return (t * 1000000000.0) / (2.0 * COMPARE_SWITCHES);
+}
+
+/*
+ *  stress_context_compare()
+ *	time coroutine switches done by swapcontext, setjmp/longjmp
+ *	and a register only asm switch, one bogo op per round of all
+ */
+static int stress_context_compare(
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const char *name)
+{
+	double nsec[COMPARE_MAX];
+	uint64_t rounds = 0;
+	int i, methods = COMPARE_MAX;
+
+	if (stress_context_init(name, compare_swap_fiber, NULL, &uctx_cmp_swap,
+				stack_cmp[COMPARE_SWAPCONTEXT], STACK_SIZE) < 0)
+		return EXIT_FAILURE;
+	if (stress_context_init(name, compare_setjmp_fiber, NULL, &uctx_cmp_setjmp,
+				stack_cmp[COMPARE_SETJMP], STACK_SIZE) < 0)
+		return EXIT_FAILURE;
+	compare_setjmp_start();
+#if defined(HAVE_CONTEXT_ASM)
+	compare_asm_init();
+#else
+	methods = COMPARE_ASM;
+	pr_inf(stderr, "%s: no asm switch for this architecture\n", name);
+#endif
+
+	(void)memset(nsec, 0, sizeof(nsec));
+	do {
+		for (i = 0; i < methods; i++)
+			nsec[i] += compare_time(i);
+		rounds++;
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	for (i = 0; i < methods; i++) {
+		char desc[32];
+
+		(void)snprintf(desc, sizeof(desc), "%s ns per switch",
+			compare_names[i]);
+		stress_misc_metric_set(i, desc, nsec[i] / rounds);
+	}
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_context()
  *	stress that exercises CPU context save/restore
@@ -126,6 +369,9 @@ int stress_context(
                 return EXIT_FAILURE;
         }
 #endif
+	if (opt_context_compare)
+		return stress_context_compare(counter, max_ops, name);
+
 	__counter = 0;
 	__max_ops = max_ops * 1000;
 
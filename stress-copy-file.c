@@ -31,13 +31,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#if defined(FS_IOC_FIEMAP)
+#include <linux/fiemap.h>
+#endif
+
+#define COPY_FILE_PROBE_SIZE		(4 * MB)	/* reflink probe copy */
+#define COPY_FILE_SWEEP_SPAN		(64 * MB)	/* data filled sweep span */
+#define COPY_FILE_SWEEP_CELL_TIME	(0.5)		/* seconds per sweep cell */
+#define COPY_FILE_FIEMAP_EXTENTS	(32)
 
 static uint64_t opt_copy_file_bytes = DEFAULT_COPY_FILE_BYTES;
 static bool set_copy_file_bytes;
+static bool opt_copy_file_sweep = false;
+
+static const size_t copy_file_sweep_sizes[] = {
+	4 * KB, 16 * KB, 64 * KB, 256 * KB, 1 * MB, 4 * MB
+};
 
 static int sys_copy_file_range(
 	int fd_in,
@@ -72,6 +88,253 @@ void stress_set_copy_file_bytes(const char *optarg)
 		MIN_COPY_FILE_BYTES, MAX_COPY_FILE_BYTES);
 }
 
+void stress_set_copy_file_sweep(void)
+{
+	opt_copy_file_sweep = true;
+}
+
+/*
+ *  stress_copy_file_fill()
+ *	fill len bytes from offset 0 with random data
+ */
+static int stress_copy_file_fill(const int fd, const size_t len)
+{
+	char buf[64 * KB];
+	size_t i;
+	off_t off;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = mwc8();
+	for (off = 0; off < (off_t)len; off += sizeof(buf)) {
+		if (pwrite(fd, buf, sizeof(buf), off) != (ssize_t)sizeof(buf))
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_copy_file_range_all()
+ *	copy len bytes, retrying short copies
+ */
+static int stress_copy_file_range_all(
+	const int fd_in,
+	loff_t off_in,
+	const int fd_out,
+	loff_t off_out,
+	size_t len)
+{
+	while (len > 0) {
+		ssize_t ret;
+
+		ret = sys_copy_file_range(fd_in, &off_in, fd_out, &off_out, len, 0);
+		if (ret <= 0)
+			return -1;
+		len -= (size_t)ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_copy_file_shared()
+ *	true if FIEMAP reports that any extent of the first
+ *	len bytes of the file shares its blocks, e.g. a reflink
+ */
+static bool stress_copy_file_shared(const int fd, const size_t len)
+{
+#if defined(FS_IOC_FIEMAP) && defined(FIEMAP_EXTENT_SHARED)
+	char buf[sizeof(struct fiemap) +
+		 (COPY_FILE_FIEMAP_EXTENTS * sizeof(struct fiemap_extent))];
+	struct fiemap *fm = (struct fiemap *)buf;
+	uint32_t i;
+
+	memset(buf, 0, sizeof(buf));
+	fm->fm_start = 0;
+	fm->fm_length = len;
+	fm->fm_flags = FIEMAP_FLAG_SYNC;
+	fm->fm_extent_count = COPY_FILE_FIEMAP_EXTENTS;
+	if (ioctl(fd, FS_IOC_FIEMAP, fm) < 0)
+		return false;
+	for (i = 0; i < fm->fm_mapped_extents; i++) {
+		if (fm->fm_extents[i].fe_flags & FIEMAP_EXTENT_SHARED)
+			return true;
+	}
+#else
+	(void)fd;
+	(void)len;
+#endif
+	return false;
+}
+
+/*
+ *  stress_copy_file_detect()
+ *	find out if copy_file_range() on this file system really
+ *	copies the data. A reflink shows up as shared extents, a
+ *	server-side or other offloaded copy as a copy that does not
+ *	dirty any local pages, measured with the write_bytes of
+ *	/proc/self/io against a normal write of the same data
+ */
+static void stress_copy_file_detect(
+	const char *name,
+	const uint32_t instance,
+	const int fd_in,
+	const int fd_out)
+{
+	const size_t len = COPY_FILE_PROBE_SIZE;
+	stress_io_stats_t s0, s1, s2;
+	uint64_t written, copied;
+	const char *how;
+
+	io_stats_begin(&s0);
+	if ((stress_copy_file_fill(fd_in, len) < 0) || (fsync(fd_in) < 0))
+		return;
+	io_stats_begin(&s1);
+	if (stress_copy_file_range_all(fd_in, 0, fd_out, 0, len) < 0) {
+		pr_dbg(stderr, "%s: copy_file_range probe failed: errno=%d (%s)\n",
+			name, errno, strerror(errno));
+		return;
+	}
+	(void)fsync(fd_out);
+	io_stats_begin(&s2);
+
+	written = s1.write_bytes - s0.write_bytes;
+	copied = s2.write_bytes - s1.write_bytes;
+
+	if (stress_copy_file_shared(fd_out, len)) {
+		how = "reflink, the blocks are shared";
+		copied = 0;
+	} else if (!s0.task_ok || !s2.task_ok || (written < len / 2)) {
+		how = "unknown, no per-task write accounting";
+	} else if (copied < len / 8) {
+		how = "offloaded, no local data was written";
+	} else {
+		how = "a data copy";
+	}
+	if (s0.task_ok && s2.task_ok)
+		stress_misc_metric_set(1, "copy device writes (%)",
+			100.0 * (double)copied / (double)len);
+	if (instance == 0)
+		pr_inf(stderr, "%s: copy_file_range is %s\n", name, how);
+}
+
+/*
+ *  stress_copy_file_cell()
+ *	copy chunk sized pieces between random offsets in the
+ *	sweep span for a sweep cell time with copy_file_range()
+ *	or, if buf is non-null, pread(2) and pwrite(2), returning
+ *	the rate in bytes per second
+ */
+static double stress_copy_file_cell(
+	const int fd_in,
+	const int fd_out,
+	const size_t chunk,
+	char *buf,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const uint32_t chunks = COPY_FILE_SWEEP_SPAN / chunk;
+	const double t_start = time_now();
+	const double t_end = t_start + COPY_FILE_SWEEP_CELL_TIME;
+	uint64_t bytes = 0;
+	double duration;
+
+	do {
+		loff_t off_in = (loff_t)(mwc32() % chunks) * chunk;
+		loff_t off_out = (loff_t)(mwc32() % chunks) * chunk;
+		ssize_t ret;
+
+		if (buf) {
+			ret = pread(fd_in, buf, chunk, off_in);
+			if ((ret > 0) && (pwrite(fd_out, buf, (size_t)ret, off_out) != ret))
+				ret = -1;
+		} else {
+			ret = sys_copy_file_range(fd_in, &off_in, fd_out,
+				&off_out, chunk, 0);
+		}
+		if (ret < 0) {
+			if ((errno == EAGAIN) || (errno == EINTR))
+				continue;
+			return -1.0;
+		}
+		bytes += (uint64_t)ret;
+		(*counter)++;
+	} while (opt_do_run && (time_now() < t_end) &&
+		 (!max_ops || *counter < max_ops));
+
+	duration = time_now() - t_start;
+	return (duration > 0.0) ? (double)bytes / duration : 0.0;
+}
+
+/*
+ *  stress_copy_file_sweep()
+ *	sweep chunk sizes, comparing copy_file_range() with a
+ *	user space copy, the first instance reports a table of
+ *	the first complete sweep
+ */
+static int stress_copy_file_sweep(
+	const char *name,
+	const uint32_t instance,
+	const int fd_in,
+	const int fd_out,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	double rates[SIZEOF_ARRAY(copy_file_sweep_sizes)][2];
+	double peak = 0.0;
+	bool reported = false;
+	char *buf;
+	size_t i;
+	int rc = EXIT_SUCCESS;
+
+	if (stress_copy_file_fill(fd_in, COPY_FILE_SWEEP_SPAN) < 0) {
+		pr_fail_err(name, "pwrite");
+		return EXIT_NO_RESOURCE;
+	}
+	buf = malloc(copy_file_sweep_sizes[SIZEOF_ARRAY(copy_file_sweep_sizes) - 1]);
+	if (!buf) {
+		pr_err(stderr, "%s: cannot allocate sweep buffer\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	memset(rates, 0, sizeof(rates));
+
+	do {
+		for (i = 0; i < SIZEOF_ARRAY(copy_file_sweep_sizes); i++) {
+			const size_t chunk = copy_file_sweep_sizes[i];
+
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			rates[i][0] = stress_copy_file_cell(fd_in, fd_out,
+				chunk, NULL, counter, max_ops);
+			rates[i][1] = stress_copy_file_cell(fd_in, fd_out,
+				chunk, buf, counter, max_ops);
+			if ((rates[i][0] < 0.0) || (rates[i][1] < 0.0)) {
+				pr_fail_err(name, "copy_file_range");
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			if (rates[i][0] > peak)
+				peak = rates[i][0];
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %8s %15s %15s %8s\n", name, "chunk",
+				"copy_range MB/s", "read+write MB/s", "speedup");
+			for (i = 0; i < SIZEOF_ARRAY(copy_file_sweep_sizes); i++)
+				pr_inf(stderr, "%s: %7zuK %15.1f %15.1f %8.2f\n",
+					name, (size_t)(copy_file_sweep_sizes[i] / KB),
+					rates[i][0] / (double)MB,
+					rates[i][1] / (double)MB,
+					(rates[i][1] > 0.0) ?
+						rates[i][0] / rates[i][1] : 0.0);
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	stress_misc_metric_set(0, "peak copy rate (MB/sec)",
+		peak / (double)MB);
+	free(buf);
+
+	return rc;
+}
+
 /*
  *  stress_copy_file
  *	stress reading chunks of file using copy_file_range()
@@ -85,6 +348,8 @@ int stress_copy_file(
 	int fd_in, fd_out, rc = EXIT_FAILURE;
 	char filename[PATH_MAX], tmp[PATH_MAX];
 	pid_t pid = getpid();
+	uint64_t bytes = 0;
+	double t_start, duration;
 
 	if (!set_copy_file_bytes) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -125,6 +390,14 @@ int stress_copy_file(
 	}
 	(void)unlink(tmp);
 
+	stress_copy_file_detect(name, instance, fd_in, fd_out);
+	if (opt_copy_file_sweep) {
+		rc = stress_copy_file_sweep(name, instance, fd_in, fd_out,
+			counter, max_ops);
+		goto tidy_out;
+	}
+
+	t_start = time_now();
 	do {
 		ssize_t ret;
 		loff_t off_in, off_out;
@@ -142,8 +415,13 @@ int stress_copy_file(
 			goto tidy_out;
 		}
 		(void)fsync(fd_out);
+		bytes += (uint64_t)ret;
 		(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
+	duration = time_now() - t_start;
+	if (duration > 0.0)
+		stress_misc_metric_set(0, "copy rate (MB/sec)",
+			((double)bytes / duration) / (double)MB);
 	rc = EXIT_SUCCESS;
 
 tidy_out:
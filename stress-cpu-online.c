@@ -31,11 +31,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#define CPU_ONLINE_HOLD		(0.1)	/* secs offline with --cpu-online-impact */
+
+/* offline and online latencies of one CPU */
+typedef struct {
+	uint64_t toggles;		/* offline/online cycles */
+	double offline_total;		/* total time to offline, secs */
+	double offline_max;		/* slowest offline, secs */
+	double online_total;		/* total time to online, secs */
+	double online_max;		/* slowest online, secs */
+} cpu_online_lat_t;
+
+/* disruption of the other stressors by taking CPUs away */
+typedef struct {
+	uint64_t events;		/* offline events measured */
+	double base_rate;		/* other ops/sec, all CPUs online */
+	double offline_rate;		/* other ops/sec, a CPU offline */
+	double worst_dip;		/* largest dip of one event, % */
+	uint64_t migrations;		/* task migrations, all CPUs */
+	int *fds;			/* per CPU migration counters */
+	uint64_t closed;		/* migrations of closed counters */
+} cpu_online_impact_t;
+
+static bool opt_cpu_online_impact = false;
+
+void stress_set_cpu_online_impact(void)
+{
+	opt_cpu_online_impact = true;
+}
+
 /*
  *  stress_cpu_online_set()
  *	set a specified CPUs online or offline
@@ -74,6 +104,216 @@ static int stress_cpu_online_set(
 	return rc;
 }
 
+/*
+ *  stress_cpu_online_other_ops()
+ *	bogo ops of all the other stressor instances so far
+ */
+static uint64_t stress_cpu_online_other_ops(const uint64_t *const counter)
+{
+	uint64_t ops = 0;
+	int32_t i;
+
+	for (i = 0; i < shared->stats_slots; i++)
+		ops += shared->counters[i].counter;
+	return ops - *counter;
+}
+
+/*
+ *  stress_cpu_online_migrations()
+ *	task migrations on all the CPUs so far, 0 without perf
+ */
+static uint64_t stress_cpu_online_migrations(
+	cpu_online_impact_t *impact,
+	const int32_t cpus)
+{
+	uint64_t total = impact->closed;
+	int32_t i;
+
+	for (i = 0; impact->fds && (i < cpus); i++) {
+		uint64_t count;
+
+		if (perf_read_by_fd(impact->fds[i], &count) == 0)
+			total += count;
+	}
+	return total;
+}
+
+/*
+ *  stress_cpu_online_perf_open()
+ *	(re)open the migration counter of a CPU, a counter stops
+ *	counting when its CPU is offlined so it is reopened once
+ *	the CPU is back and what it counted is kept
+ */
+static void stress_cpu_online_perf_open(
+	cpu_online_impact_t *impact,
+	const int32_t cpu)
+{
+#if defined(STRESS_PERF_STATS)
+	if (!impact->fds)
+		return;
+	if (impact->fds[cpu] >= 0) {
+		uint64_t count;
+
+		if (perf_read_by_fd(impact->fds[cpu], &count) == 0)
+			impact->closed += count;
+		(void)close(impact->fds[cpu]);
+	}
+	impact->fds[cpu] = perf_open_cpu_by_id(STRESS_PERF_SW_CPU_MIGRATIONS, cpu);
+#else
+	(void)impact;
+	(void)cpu;
+#endif
+}
+
+/*
+ *  stress_cpu_online_hold()
+ *	sleep for the hold time, returns the other stressor
+ *	bogo ops/sec over it or -1 if the run was stopped
+ */
+static double stress_cpu_online_hold(const uint64_t *const counter)
+{
+	const uint64_t ops = stress_cpu_online_other_ops(counter);
+	const double t = time_now();
+	double duration;
+
+	while (opt_do_run && (time_now() - t < CPU_ONLINE_HOLD))
+		(void)usleep(10000);
+	duration = time_now() - t;
+	if (!opt_do_run || (duration <= 0.0))
+		return -1.0;
+	return (double)(stress_cpu_online_other_ops(counter) - ops) / duration;
+}
+
+/*
+ *  stress_cpu_online_toggle()
+ *	offline and then online a CPU and note the latencies, with
+ *	--cpu-online-impact the other stressors' bogo op rate is
+ *	sampled with all the CPUs online and then with the CPU held
+ *	offline, along with the task migrations this causes
+ */
+static int stress_cpu_online_toggle(
+	const char *name,
+	const int32_t cpu,
+	const int32_t cpus,
+	const uint64_t *const counter,
+	cpu_online_lat_t *lat,
+	stress_latency_t *offline_lat,
+	stress_latency_t *online_lat,
+	cpu_online_impact_t *impact)
+{
+	double t, offline_t, online_t, base_rate = -1.0, offline_rate = -1.0;
+	uint64_t migrations = 0;
+	int rc;
+
+	if (impact) {
+		base_rate = stress_cpu_online_hold(counter);
+		if (base_rate < 0.0)
+			return EXIT_SUCCESS;
+		migrations = stress_cpu_online_migrations(impact, cpus);
+	}
+
+	t = time_now();
+	rc = stress_cpu_online_set(name, cpu, 0);
+	offline_t = time_now() - t;
+	if (rc != EXIT_SUCCESS)
+		return rc;
+	if (impact)
+		offline_rate = stress_cpu_online_hold(counter);
+	t = time_now();
+	rc = stress_cpu_online_set(name, cpu, 1);
+	online_t = time_now() - t;
+	if (rc != EXIT_SUCCESS)
+		return rc;
+
+	lat[cpu].toggles++;
+	lat[cpu].offline_total += offline_t;
+	lat[cpu].online_total += online_t;
+	if (lat[cpu].offline_max < offline_t)
+		lat[cpu].offline_max = offline_t;
+	if (lat[cpu].online_max < online_t)
+		lat[cpu].online_max = online_t;
+	latency_record(offline_lat, (uint64_t)(offline_t * 1000000000.0));
+	latency_record(online_lat, (uint64_t)(online_t * 1000000000.0));
+
+	if (impact) {
+		stress_cpu_online_perf_open(impact, cpu);
+		if ((offline_rate >= 0.0) && (base_rate > 0.0)) {
+			const double dip = 100.0 * (1.0 - (offline_rate / base_rate));
+
+			impact->events++;
+			impact->base_rate += base_rate;
+			impact->offline_rate += offline_rate;
+			if (impact->worst_dip < dip)
+				impact->worst_dip = dip;
+			impact->migrations +=
+				stress_cpu_online_migrations(impact, cpus) - migrations;
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_cpu_online_report()
+ *	report the offline and online latencies of each CPU
+ *	and the disruption to the other stressors
+ */
+static void stress_cpu_online_report(
+	const char *name,
+	const int32_t cpus,
+	const cpu_online_lat_t *lat,
+	const stress_latency_t *offline_lat,
+	const stress_latency_t *online_lat,
+	const cpu_online_impact_t *impact)
+{
+	double offline_total = 0.0, online_total = 0.0;
+	uint64_t toggles = 0;
+	int32_t i;
+
+	pr_inf(stderr, "%s:   CPU  toggles  offline ms   max ms   online ms   max ms\n", name);
+	for (i = 0; i < cpus; i++) {
+		if (!lat[i].toggles)
+			continue;
+		pr_inf(stderr, "%s: %5" PRId32 " %8" PRIu64 " %11.3f %8.3f %11.3f %8.3f\n",
+			name, i, lat[i].toggles,
+			1000.0 * lat[i].offline_total / (double)lat[i].toggles,
+			1000.0 * lat[i].offline_max,
+			1000.0 * lat[i].online_total / (double)lat[i].toggles,
+			1000.0 * lat[i].online_max);
+		toggles += lat[i].toggles;
+		offline_total += lat[i].offline_total;
+		online_total += lat[i].online_total;
+	}
+	if (!toggles)
+		return;
+
+	stress_misc_metric_set(0, "offline mean ms",
+		1000.0 * offline_total / (double)toggles);
+	stress_misc_metric_set(1, "offline p99 ms",
+		(double)latency_percentile(offline_lat, 0.99) / 1000000.0);
+	stress_misc_metric_set(2, "online mean ms",
+		1000.0 * online_total / (double)toggles);
+	stress_misc_metric_set(3, "online p99 ms",
+		(double)latency_percentile(online_lat, 0.99) / 1000000.0);
+
+	if (!impact || !impact->events || (impact->base_rate <= 0.0))
+		return;
+	pr_inf(stderr, "%s: other stressors %.1f bogo ops/sec with all CPUs "
+		"online, %.1f with a CPU offline, a %.1f%% dip (worst %.1f%%)\n",
+		name, impact->base_rate / (double)impact->events,
+		impact->offline_rate / (double)impact->events,
+		100.0 * (1.0 - (impact->offline_rate / impact->base_rate)),
+		impact->worst_dip);
+	stress_misc_metric_set(4, "other ops dip %",
+		100.0 * (1.0 - (impact->offline_rate / impact->base_rate)));
+	stress_misc_metric_set(5, "worst other ops dip %", impact->worst_dip);
+	if (impact->fds) {
+		pr_inf(stderr, "%s: %.1f task migrations per offline/online\n",
+			name, (double)impact->migrations / (double)impact->events);
+		stress_misc_metric_set(6, "migrations per offline",
+			(double)impact->migrations / (double)impact->events);
+	}
+}
+
 /*
  *  stress_cpu_online
  *	stress twiddling CPUs online/offline
@@ -88,8 +328,9 @@ int stress_cpu_online(
 	int32_t i, cpu_online_count = 0;
 	bool *cpu_online;
 	int rc = EXIT_SUCCESS;
-
-	(void)instance;
+	cpu_online_lat_t *lat;
+	stress_latency_t offline_lat, online_lat;
+	cpu_online_impact_t impact;
 
 	if (geteuid() != 0) {
 		if (instance == 0)
@@ -109,6 +350,15 @@ int stress_cpu_online(
 		pr_err(stderr, "%s: out of memory\n", name);
 		return EXIT_FAILURE;
 	}
+	lat = calloc(cpus, sizeof(*lat));
+	if (!lat) {
+		pr_err(stderr, "%s: out of memory\n", name);
+		free(cpu_online);
+		return EXIT_FAILURE;
+	}
+	memset(&offline_lat, 0, sizeof(offline_lat));
+	memset(&online_lat, 0, sizeof(online_lat));
+	memset(&impact, 0, sizeof(impact));
 
 	/*
 	 *  Determine how many CPUs we can online/offline via
@@ -128,20 +378,42 @@ int stress_cpu_online(
 	}
 	if (cpu_online_count == 0) {
 		pr_inf(stderr, "%s: no CPUs can be set online/offline\n", name);
+		free(lat);
 		free(cpu_online);
 		return EXIT_FAILURE;
 	}
 
+	/*
+	 *  Count the task migrations of all the CPUs, if none of the
+	 *  counters can be opened the migrations are not reported
+	 */
+#if defined(STRESS_PERF_STATS)
+	if (opt_cpu_online_impact) {
+		bool opened = false;
+
+		impact.fds = calloc(cpus, sizeof(*impact.fds));
+		for (i = 0; impact.fds && (i < cpus); i++) {
+			impact.fds[i] = -1;
+			stress_cpu_online_perf_open(&impact, i);
+			if (impact.fds[i] >= 0)
+				opened = true;
+		}
+		if (!opened) {
+			free(impact.fds);
+			impact.fds = NULL;
+		}
+	}
+#endif
+
 	/*
 	 *  Now randomly offline/online them all
 	 */
 	do {
 		unsigned long cpu = mwc32() % cpus;
 		if (cpu_online[cpu]) {
-			rc = stress_cpu_online_set(name, cpu, 0);
-			if (rc != EXIT_SUCCESS)
-				break;
-			rc = stress_cpu_online_set(name, cpu, 1);
+			rc = stress_cpu_online_toggle(name, (int32_t)cpu, cpus,
+				counter, lat, &offline_lat, &online_lat,
+				opt_cpu_online_impact ? &impact : NULL);
 			if (rc != EXIT_SUCCESS)
 				break;
 			(*counter)++;
@@ -155,6 +427,16 @@ int stress_cpu_online(
 		if (cpu_online[i])
 			(void)stress_cpu_online_set(name, i, 1);
 	}
+	if (instance == 0)
+		stress_cpu_online_report(name, cpus, lat, &offline_lat,
+			&online_lat, opt_cpu_online_impact ? &impact : NULL);
+
+	for (i = 0; impact.fds && (i < cpus); i++) {
+		if (impact.fds[i] >= 0)
+			(void)close(impact.fds[i]);
+	}
+	free(impact.fds);
+	free(lat);
 	free(cpu_online);
 
 	return EXIT_SUCCESS;
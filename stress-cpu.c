@@ -27,12 +27,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <errno.h>
+#include <time.h>
 #include <math.h>
 #include <complex.h>
+#include <string.h>
+#include <signal.h>
+#include <sched.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include "stress-ng.h"
 
+#if defined(STRESS_VECMATH) && defined(__linux__) && NEED_GLIBC(2,3,0)
+#define STRESS_CPU_AVX_INTERFERE	(1)
+#endif
+
 #define GAMMA 	(0.57721566490153286060651209008240243104215933593992L)
 #define OMEGA	(0.5671432904097838729999686622L)
 #define PSI	(3.35988566624317755317201130291892717968890513373L)
@@ -82,9 +92,47 @@ typedef struct {
  */
 static int32_t opt_cpu_load_slice = -64;
 static int32_t opt_cpu_load = 100;
+
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+#define STRESS_CPU_LOAD_CONTROL	(1)
+#endif
+
+#define MIN_CPU_LOAD_PERIOD	(100)		/* usecs */
+#define MAX_CPU_LOAD_PERIOD	(1000000)
+#define DEFAULT_CPU_LOAD_PERIOD	(1000)
+#define CPU_LOAD_WINDOW		(1.0)		/* secs per error sample */
+
+/* --cpu-load-profile shape */
+typedef enum {
+	CPU_LOAD_PROFILE_NONE = 0,	/* open loop --cpu-load */
+	CPU_LOAD_PROFILE_FLAT,		/* closed loop --cpu-load */
+	CPU_LOAD_PROFILE_RAMP,		/* lo to hi over period, repeated */
+	CPU_LOAD_PROFILE_SQUARE,	/* lo then hi for half a period each */
+	CPU_LOAD_PROFILE_TRACE,		/* steps replayed from a file */
+} cpu_load_profile_type_t;
+
+/* one step of a replayed load trace */
+typedef struct {
+	double end;			/* end time of step from trace start */
+	double load;			/* load percent during step */
+} cpu_load_step_t;
+
+static struct {
+	cpu_load_profile_type_t type;
+	double lo, hi;			/* ramp and square loads, percent */
+	double period;			/* ramp and square period, secs */
+	cpu_load_step_t *steps;		/* trace steps */
+	size_t n_steps;
+} opt_cpu_load_profile;
+static uint32_t opt_cpu_load_period = DEFAULT_CPU_LOAD_PERIOD;
 static const stress_cpu_stressor_info_t *opt_cpu_stressor;
+static bool opt_cpu_avx_interfere = false;
 static const stress_cpu_stressor_info_t cpu_methods[];
 
+/* --cpu-method all bogo ops and run time per method of this instance */
+static uint64_t cpu_method_ops[STRESS_CPU_METHODS_MAX];
+static double cpu_method_time[STRESS_CPU_METHODS_MAX];
+
 /* Don't make this static to ensure dithering does not get optimised out */
 uint8_t pixels[STRESS_CPU_DITHER_X][STRESS_CPU_DITHER_Y];
 
@@ -105,6 +153,129 @@ void stress_set_cpu_load_slice(const char *optarg)
 	}
 }
 
+void stress_set_cpu_load_period(const char *optarg)
+{
+	uint64_t period;
+
+	period = get_uint64(optarg);
+	check_range("cpu-load-period", period,
+		MIN_CPU_LOAD_PERIOD, MAX_CPU_LOAD_PERIOD);
+	opt_cpu_load_period = (uint32_t)period;
+}
+
+/*
+ *  stress_cpu_load_trace()
+ *	read a load trace, one step per line of either
+ *	"seconds load" or just "load" for a 1 second step,
+ *	blank lines and lines starting with # are ignored
+ */
+static int stress_cpu_load_trace(const char *path)
+{
+	FILE *fp;
+	char buf[256];
+	double end = 0.0;
+	size_t max_steps = 0, line = 0;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "cpu-load-profile: cannot open %s: %s\n",
+			path, strerror(errno));
+		return -1;
+	}
+	while (fgets(buf, sizeof(buf), fp)) {
+		double secs, load;
+		char *ptr = buf;
+		int n;
+
+		line++;
+		while (*ptr == ' ' || *ptr == '\t')
+			ptr++;
+		if (*ptr == '#' || *ptr == '\n' || *ptr == '\0')
+			continue;
+		n = sscanf(ptr, "%lf %lf", &secs, &load);
+		if (n == 1) {
+			load = secs;
+			secs = 1.0;
+		}
+		if ((n < 1) || (secs <= 0.0) || (load < 0.0) || (load > 100.0)) {
+			fprintf(stderr, "cpu-load-profile: %s line %zu: expecting "
+				"\"seconds load\" or \"load\" with a load "
+				"of 0 to 100\n", path, line);
+			(void)fclose(fp);
+			return -1;
+		}
+		if (opt_cpu_load_profile.n_steps == max_steps) {
+			cpu_load_step_t *steps;
+
+			max_steps = max_steps ? max_steps * 2 : 64;
+			steps = realloc(opt_cpu_load_profile.steps,
+				max_steps * sizeof(*steps));
+			if (!steps) {
+				fprintf(stderr, "cpu-load-profile: out of memory "
+					"reading %s\n", path);
+				(void)fclose(fp);
+				return -1;
+			}
+			opt_cpu_load_profile.steps = steps;
+		}
+		end += secs;
+		opt_cpu_load_profile.steps[opt_cpu_load_profile.n_steps].end = end;
+		opt_cpu_load_profile.steps[opt_cpu_load_profile.n_steps].load = load;
+		opt_cpu_load_profile.n_steps++;
+	}
+	(void)fclose(fp);
+
+	if (!opt_cpu_load_profile.n_steps) {
+		fprintf(stderr, "cpu-load-profile: no load steps in %s\n", path);
+		return -1;
+	}
+	opt_cpu_load_profile.period = end;
+	opt_cpu_load_profile.type = CPU_LOAD_PROFILE_TRACE;
+	return 0;
+}
+
+/*
+ *  stress_set_cpu_load_profile()
+ *	flat, ramp:LO:HI:SECS, square:LO:HI:SECS or the
+ *	path of a load trace file
+ */
+int stress_set_cpu_load_profile(const char *name)
+{
+	cpu_load_profile_type_t type = CPU_LOAD_PROFILE_NONE;
+	double lo, hi, secs;
+	char c;
+
+	if (!strcmp(name, "flat")) {
+		opt_cpu_load_profile.type = CPU_LOAD_PROFILE_FLAT;
+		return 0;
+	}
+	if (!strncmp(name, "ramp:", 5))
+		type = CPU_LOAD_PROFILE_RAMP;
+	else if (!strncmp(name, "square:", 7))
+		type = CPU_LOAD_PROFILE_SQUARE;
+	else
+		return stress_cpu_load_trace(name);
+
+	if ((sscanf(strchr(name, ':') + 1, "%lf:%lf:%lf%c", &lo, &hi, &secs, &c) != 3) ||
+	    (lo < 0.0) || (lo > 100.0) || (hi < 0.0) || (hi > 100.0) ||
+	    (secs <= 0.0)) {
+		fprintf(stderr, "cpu-load-profile must be one of: flat, "
+			"ramp:LO:HI:SECS, square:LO:HI:SECS or a trace file, "
+			"with loads of 0 to 100\n");
+		return -1;
+	}
+	opt_cpu_load_profile.type = type;
+	opt_cpu_load_profile.lo = lo;
+	opt_cpu_load_profile.hi = hi;
+	opt_cpu_load_profile.period = secs;
+	return 0;
+}
+
+void stress_set_cpu_avx_interfere(void)
+{
+	opt_cpu_avx_interfere = true;
+}
+
 /*
  *  stress_cpu_sqrt()
  *	stress CPU on square roots
@@ -688,7 +859,7 @@ static void stress_cpu_sdbm(const char *name)
  *  stress_cpu_idct()
  *	compute 8x8 Inverse Discrete Cosine Transform
  */
-static void HOT OPTIMIZE3 stress_cpu_idct(const char *name)
+static void HOT OPTIMIZE3 TARGET_CLONES stress_cpu_idct(const char *name)
 {
 	const double invsqrt2 = 1.0 / sqrt(2.0);
 	const double pi_over_16 = M_PI / 16.0;
@@ -1086,7 +1257,7 @@ static void HOT OPTIMIZE3 stress_cpu_rgb(const char *name)
  *  stress_cpu_matrix_prod(void)
  *	matrix product
  */
-static void HOT OPTIMIZE3 stress_cpu_matrix_prod(const char *name)
+static void HOT OPTIMIZE3 TARGET_CLONES stress_cpu_matrix_prod(const char *name)
 {
 	int i, j, k;
 	const int n = 128;
@@ -1420,7 +1591,7 @@ static void HOT OPTIMIZE3 stress_cpu_gamma(const char *name)
  *  Introduction to Signal Processing,
  *  Prentice-Hall, 1995, ISBN: 0-13-209172-0.
  */
-static void HOT OPTIMIZE3 stress_cpu_correlate(const char *name)
+static void HOT OPTIMIZE3 TARGET_CLONES stress_cpu_correlate(const char *name)
 {
 	const size_t data_len = 16384;
 	const size_t corr_len = data_len / 16;
@@ -2085,12 +2256,310 @@ static void stress_cpu_queens(const char *name)
 static HOT OPTIMIZE3 void stress_cpu_all(const char *name)
 {
 	static int i = 1;	/* Skip over stress_cpu_all */
+	const double t = time_now();
 
-	cpu_methods[i++].func(name);
+	cpu_methods[i].func(name);
+	if (i < STRESS_CPU_METHODS_MAX) {
+		cpu_method_time[i] += time_now() - t;
+		cpu_method_ops[i]++;
+	}
+	i++;
 	if (!cpu_methods[i].func)
 		i = 1;
 }
 
+/*
+ *  stress_cpu_method_flush()
+ *	add the per method bogo ops and run times of
+ *	this instance to the totals of all instances
+ */
+static void stress_cpu_method_flush(void)
+{
+	size_t i;
+
+	for (i = 0; i < STRESS_CPU_METHODS_MAX; i++) {
+		if (!cpu_method_ops[i])
+			continue;
+		__sync_fetch_and_add(&shared->cpu_method.ops[i], cpu_method_ops[i]);
+		__sync_fetch_and_add(&shared->cpu_method.nsec[i],
+			(uint64_t)(cpu_method_time[i] * 1000000000.0));
+	}
+}
+
+/*
+ *  stress_cpu_method_dump()
+ *	report the bogo ops rate of each method of a
+ *	--cpu-method all run, the rate is per instance
+ *	as the run time is the total of all instances
+ */
+void stress_cpu_method_dump(FILE *yaml, json_t *json)
+{
+	size_t i;
+	bool dumped_heading = false;
+
+	for (i = 1; i < STRESS_CPU_METHODS_MAX && cpu_methods[i].func; i++) {
+		const uint64_t ops = shared->cpu_method.ops[i];
+		const double secs = (double)shared->cpu_method.nsec[i] / 1000000000.0;
+		const double rate = (secs > 0.0) ? (double)ops / secs : 0.0;
+
+		if (!ops)
+			continue;
+		if (!dumped_heading) {
+			pr_inf(stdout, "%-13s %12s %9s %12s\n",
+				"cpu-method", "bogo ops", "time", "bogo ops/s");
+			pr_inf(stdout, "%-13s %12s %9s %12s\n",
+				"", "", "(secs) ", "(per instance)");
+			pr_yaml(yaml, "cpu-methods:\n");
+			json_array_begin(json, "cpu-methods");
+			dumped_heading = true;
+		}
+		pr_inf(stdout, "%-13s %12" PRIu64 " %9.2f %12.2f\n",
+			cpu_methods[i].name, ops, secs, rate);
+		pr_yaml(yaml, "    - method: %s\n", cpu_methods[i].name);
+		pr_yaml(yaml, "      bogo-ops: %" PRIu64 "\n", ops);
+		pr_yaml(yaml, "      run-time: %f\n", secs);
+		pr_yaml(yaml, "      bogo-ops-per-second: %f\n", rate);
+
+		json_obj_begin(json, NULL);
+		json_str(json, "method", cpu_methods[i].name);
+		json_uint(json, "bogo-ops", ops);
+		json_double(json, "run-time", secs);
+		json_double(json, "bogo-ops-per-second", rate);
+		json_obj_end(json);
+	}
+	if (dumped_heading) {
+		pr_yaml(yaml, "\n");
+		json_array_end(json);
+	}
+}
+
+#if defined(STRESS_CPU_AVX_INTERFERE)
+/* bogo ops, run time and cycle counts of one --cpu-avx-interfere phase */
+typedef struct {
+	uint64_t ops;
+	double secs;
+	uint64_t cycles;		/* 0 = not available */
+	uint64_t ref_cycles;
+} stress_cpu_phase_t;
+
+/*
+ *  stress_cpu_phase()
+ *	run the cpu method until phase_ops bogo ops or the
+ *	end time t_end are reached (0 = no limit), also
+ *	counting cycles and reference cycles with --perf
+ */
+static void stress_cpu_phase(
+	uint64_t *const counter,
+	const uint64_t phase_ops,
+	const double t_end,
+	const char *name,
+	stress_cpu_phase_t *phase)
+{
+	const stress_cpu_func func = opt_cpu_stressor->func;
+	const uint64_t ops = *counter;
+	double t;
+#if defined(STRESS_PERF_STATS)
+	stress_perf_t sp;
+	bool perf = false;
+
+	if ((opt_flags & OPT_FLAGS_PERF_STATS) && !perf_open(&sp)) {
+		(void)perf_enable(&sp);
+		perf = true;
+	}
+#endif
+	memset(phase, 0, sizeof(*phase));
+
+	t = time_now();
+	do {
+		(void)func(name);
+		(*counter)++;
+	} while (opt_do_run &&
+		 (!phase_ops || *counter < phase_ops) &&
+		 ((t_end <= 0.0) || (time_now() < t_end)));
+	phase->secs = time_now() - t;
+	phase->ops = *counter - ops;
+
+#if defined(STRESS_PERF_STATS)
+	if (perf) {
+		uint64_t cycles, ref_cycles;
+		int idx;
+
+		(void)perf_disable(&sp);
+		(void)perf_close(&sp);
+		if (!perf_get_counter_by_id(&sp, STRESS_PERF_HW_CPU_CYCLES, &cycles, &idx) &&
+		    !perf_get_counter_by_id(&sp, STRESS_PERF_HW_REF_CPU_CYCLES, &ref_cycles, &idx) &&
+		    (cycles != STRESS_PERF_INVALID) && cycles &&
+		    (ref_cycles != STRESS_PERF_INVALID) && ref_cycles) {
+			phase->cycles = cycles;
+			phase->ref_cycles = ref_cycles;
+		}
+	}
+#endif
+}
+
+/*
+ *  stress_cpu_nth()
+ *	the n'th CPU, modulo the number of CPUs, in mask
+ */
+static int stress_cpu_nth(const cpu_set_t *mask, const int n)
+{
+	const int count = CPU_COUNT(mask);
+	int cpu, i = n % count;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, mask) && (i-- == 0))
+			return cpu;
+	}
+	return 0;
+}
+
+/*
+ *  stress_cpu_avx_interfere()
+ *	measure the cpu method for the first half of the run, then
+ *	run the widest FMA kernel on a sibling CPU for the second
+ *	half and measure again.  Instance i is pinned to the
+ *	(2 * i)'th CPU and its FMA process to the (2 * i + 1)'th CPU
+ *	so the integer work runs on different cores from the wide
+ *	SIMD work. Returns -1 if this mode cannot be used.
+ */
+static int stress_cpu_avx_interfere(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const char *fma = stress_vecmath_fma_name();
+	cpu_set_t mask, set;
+	stress_cpu_phase_t phase[2];
+	int cpu, fma_cpu, status, i;
+	pid_t pid;
+
+	if (!fma) {
+		if (!instance)
+			pr_inf(stderr, "%s: CPU has no FMA support, "
+				"ignoring --cpu-avx-interfere\n", name);
+		return -1;
+	}
+	if ((sched_getaffinity(0, sizeof(mask), &mask) < 0) ||
+	    !CPU_COUNT(&mask)) {
+		pr_fail_dbg(name, "sched_getaffinity");
+		return -1;
+	}
+	if ((CPU_COUNT(&mask) < 2) && !instance)
+		pr_inf(stderr, "%s: only one CPU available, the %s kernel "
+			"will time share it with the cpu method\n", name, fma);
+
+	cpu = stress_cpu_nth(&mask, 2 * instance);
+	fma_cpu = stress_cpu_nth(&mask, (2 * instance) + 1);
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	(void)sched_setaffinity(0, sizeof(set), &set);
+	pr_dbg(stderr, "%s: cpu method on CPU %d, %s kernel on CPU %d\n",
+		name, cpu, fma, fma_cpu);
+
+	stress_cpu_phase(counter, max_ops ? (max_ops + 1) / 2 : 0,
+		time_now() + ((double)opt_timeout / 2.0), name, &phase[0]);
+	if (!opt_do_run || (max_ops && *counter >= max_ops))
+		goto restore;
+
+	pid = fork();
+	if (pid < 0) {
+		pr_fail_dbg(name, "fork");
+		goto restore;
+	}
+	if (pid == 0) {
+		stress_parent_died_alarm();
+		CPU_ZERO(&set);
+		CPU_SET(fma_cpu, &set);
+		(void)sched_setaffinity(0, sizeof(set), &set);
+		stress_vecmath_fma_run();
+		_exit(EXIT_SUCCESS);
+	}
+	stress_cpu_phase(counter, max_ops, 0.0, name, &phase[1]);
+	(void)kill(pid, SIGKILL);
+	(void)waitpid(pid, &status, 0);
+
+	for (i = 0; i < 2; i++) {
+		__sync_fetch_and_add(&shared->cpu_interfere.ops[i], phase[i].ops);
+		__sync_fetch_and_add(&shared->cpu_interfere.nsec[i],
+			(uint64_t)(phase[i].secs * 1000000000.0));
+	}
+	if (phase[0].cycles && phase[1].cycles) {
+		for (i = 0; i < 2; i++) {
+			__sync_fetch_and_add(&shared->cpu_interfere.cycles[i],
+				phase[i].cycles);
+			__sync_fetch_and_add(&shared->cpu_interfere.ref_cycles[i],
+				phase[i].ref_cycles);
+		}
+		__sync_fetch_and_add(&shared->cpu_interfere.perf_instances, 1);
+	}
+	if (!instance)
+		(void)strncpy(shared->cpu_interfere.fma_method, fma,
+			sizeof(shared->cpu_interfere.fma_method) - 1);
+restore:
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+	return 0;
+}
+#endif
+
+/*
+ *  stress_cpu_interfere_dump()
+ *	report the drop in the cpu method bogo ops rate when
+ *	sibling CPUs run wide FMA instructions and, with --perf,
+ *	the change in the ref-cpu-cycles / cpu-cycles ratio
+ */
+void stress_cpu_interfere_dump(FILE *yaml, json_t *json)
+{
+	static const char *phases[] = { "baseline", "fma-loaded" };
+	double rate[2], ratio[2], drop;
+	bool has_ratio;
+	size_t i;
+
+	if (!shared->cpu_interfere.nsec[0] || !shared->cpu_interfere.nsec[1])
+		return;
+
+	has_ratio = shared->cpu_interfere.perf_instances > 0;
+	for (i = 0; i < 2; i++) {
+		const double secs = (double)shared->cpu_interfere.nsec[i] / 1000000000.0;
+
+		rate[i] = (double)shared->cpu_interfere.ops[i] / secs;
+		ratio[i] = has_ratio ? (double)shared->cpu_interfere.ref_cycles[i] /
+			(double)shared->cpu_interfere.cycles[i] : 0.0;
+	}
+	drop = (rate[0] > 0.0) ? 100.0 * (rate[0] - rate[1]) / rate[0] : 0.0;
+
+	pr_inf(stdout, "cpu-avx-interfere: %s kernel on sibling CPUs\n",
+		shared->cpu_interfere.fma_method);
+	pr_inf(stdout, "%-13s %14s %18s\n", "phase", "bogo ops/s", "ref-cycles/cycles");
+	pr_inf(stdout, "%-13s %14s\n", "", "(per instance)");
+	for (i = 0; i < 2; i++) {
+		if (has_ratio)
+			pr_inf(stdout, "%-13s %14.2f %18.4f\n", phases[i], rate[i], ratio[i]);
+		else
+			pr_inf(stdout, "%-13s %14.2f %18s\n", phases[i], rate[i], "n/a");
+	}
+	pr_inf(stdout, "bogo ops/s drop: %.2f%%\n", drop);
+
+	pr_yaml(yaml, "cpu-avx-interfere:\n");
+	pr_yaml(yaml, "    fma-method: %s\n", shared->cpu_interfere.fma_method);
+	json_obj_begin(json, "cpu-avx-interfere");
+	json_str(json, "fma-method", shared->cpu_interfere.fma_method);
+	for (i = 0; i < 2; i++) {
+		pr_yaml(yaml, "    %s-bogo-ops-per-second: %f\n", phases[i], rate[i]);
+		if (has_ratio)
+			pr_yaml(yaml, "    %s-ref-cycles-per-cycle: %f\n", phases[i], ratio[i]);
+		json_obj_begin(json, phases[i]);
+		json_double(json, "bogo-ops-per-second", rate[i]);
+		if (has_ratio)
+			json_double(json, "ref-cycles-per-cycle", ratio[i]);
+		json_obj_end(json);
+	}
+	pr_yaml(yaml, "    bogo-ops-per-second-drop: %f\n", drop);
+	pr_yaml(yaml, "\n");
+	json_double(json, "bogo-ops-per-second-drop", drop);
+	json_obj_end(json);
+}
+
 /*
  * Table of cpu stress methods
  */
@@ -2202,6 +2671,151 @@ int HOT OPTIMIZE3 stress_set_cpu_method(const char *name)
 	return -1;
 }
 
+#if defined(STRESS_CPU_LOAD_CONTROL)
+/*
+ *  stress_cpu_thread_time()
+ *	CPU time consumed by this thread in seconds
+ */
+static inline double stress_cpu_thread_time(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+		return 0.0;
+	return (double)ts.tv_sec + ((double)ts.tv_nsec / 1000000000.0);
+}
+
+/*
+ *  stress_cpu_load_target()
+ *	target load fraction at t seconds into the run
+ */
+static double stress_cpu_load_target(const double t)
+{
+	static size_t step = 0;
+	const double period = opt_cpu_load_profile.period;
+	const double lo = opt_cpu_load_profile.lo;
+	const double hi = opt_cpu_load_profile.hi;
+	double tp;
+
+	switch (opt_cpu_load_profile.type) {
+	case CPU_LOAD_PROFILE_RAMP:
+		tp = fmod(t, period);
+		return (lo + ((hi - lo) * tp / period)) / 100.0;
+	case CPU_LOAD_PROFILE_SQUARE:
+		tp = fmod(t, period);
+		return ((tp < period / 2.0) ? lo : hi) / 100.0;
+	case CPU_LOAD_PROFILE_TRACE:
+		/* time only moves forward, so walk on from the last step */
+		tp = fmod(t, period);
+		if ((step > 0) && (tp < opt_cpu_load_profile.steps[step - 1].end))
+			step = 0;
+		while ((step < opt_cpu_load_profile.n_steps - 1) &&
+		       (tp >= opt_cpu_load_profile.steps[step].end))
+			step++;
+		return opt_cpu_load_profile.steps[step].load / 100.0;
+	default:
+		return (double)opt_cpu_load / 100.0;
+	}
+}
+
+/*
+ *  stress_cpu_load_control()
+ *	closed loop load control. Each period is split into busy
+ *	and idle time, and the busy part runs until the thread
+ *	has used its CPU time for the slice as measured by
+ *	CLOCK_THREAD_CPUTIME_ID, so time lost to other tasks is
+ *	made up rather than counted as load. The shortfall or
+ *	excess of each slice is carried into the next one,
+ *	bounded to one period so a long stall does not turn
+ *	into a long burst.
+ */
+static void stress_cpu_load_control(
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const char *name,
+	const stress_cpu_func func)
+{
+	const double period = (double)opt_cpu_load_period / 1000000.0;
+	const double start = time_now();
+	double slice = start, debt = 0.0;
+	double cpu = stress_cpu_thread_time();
+	double win_start = start, win_cpu = cpu, win_target = 0.0;
+	double target_sum = 0.0, error_sum = 0.0, cpu_start = cpu, dt;
+	uint64_t win_slices = 0, windows = 0, slices = 0;
+
+	do {
+		const double load = stress_cpu_load_target(slice - start);
+		double busy = (load * period) + debt;
+		double now, cpu_now;
+
+		if (busy > period)
+			busy = period;
+		if (busy > 0.0) {
+			const double slice_end = slice + period;
+
+			do {
+				(void)func(name);
+				(*counter)++;
+				cpu_now = stress_cpu_thread_time();
+			} while ((cpu_now - cpu < busy) &&
+				 (time_now() < slice_end) &&
+				 opt_do_run && (!max_ops || *counter < max_ops));
+		} else {
+			cpu_now = stress_cpu_thread_time();
+		}
+		debt += (load * period) - (cpu_now - cpu);
+		if (debt > period)
+			debt = period;
+		else if (debt < -period)
+			debt = -period;
+		cpu = cpu_now;
+
+		win_target += load;
+		win_slices++;
+		slices++;
+		slice += period;
+		now = time_now();
+		if (now < slice) {
+			const double delay = slice - now;
+			struct timespec ts;
+
+			ts.tv_sec = (time_t)delay;
+			ts.tv_nsec = (long)((delay - (double)ts.tv_sec) * 1000000000.0);
+			(void)nanosleep(&ts, NULL);
+			now = time_now();
+		} else if (now - slice > period) {
+			/* Too far behind, don't try to catch up */
+			slice = now;
+		}
+
+		if (now - win_start >= CPU_LOAD_WINDOW) {
+			const double achieved = (cpu - win_cpu) / (now - win_start);
+			const double target = win_target / (double)win_slices;
+
+			error_sum += fabs(achieved - target);
+			target_sum += target;
+			windows++;
+			win_start = now;
+			win_cpu = cpu;
+			win_target = 0.0;
+			win_slices = 0;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	dt = time_now() - start;
+	if ((dt > 0.0) && slices) {
+		stress_misc_metric_set(0, "achieved load (%)",
+			100.0 * (stress_cpu_thread_time() - cpu_start) / dt);
+	}
+	if (windows) {
+		stress_misc_metric_set(1, "target load (%)",
+			100.0 * target_sum / (double)windows);
+		stress_misc_metric_set(2, "mean load error (%)",
+			100.0 * error_sum / (double)windows);
+	}
+}
+#endif
+
 /*
  *  stress_cpu()
  *	stress CPU by doing floating point math ops
@@ -2217,6 +2831,30 @@ int stress_cpu(
 
 	(void)instance;
 
+#if defined(STRESS_CPU_AVX_INTERFERE)
+	if (opt_cpu_avx_interfere &&
+	    !stress_cpu_avx_interfere(counter, instance, max_ops, name)) {
+		stress_cpu_method_flush();
+		return EXIT_SUCCESS;
+	}
+#else
+	if (opt_cpu_avx_interfere && !instance)
+		pr_inf(stderr, "%s: --cpu-avx-interfere is not supported "
+			"on this system\n", name);
+#endif
+
+	if (opt_cpu_load_profile.type != CPU_LOAD_PROFILE_NONE) {
+#if defined(STRESS_CPU_LOAD_CONTROL)
+		stress_cpu_load_control(counter, max_ops, name, func);
+		stress_cpu_method_flush();
+		return EXIT_SUCCESS;
+#else
+		if (!instance)
+			pr_inf(stderr, "%s: --cpu-load-profile is not supported "
+				"on this system, using --cpu-load\n", name);
+#endif
+	}
+
 	/*
 	 * Normal use case, 100% load, simple spinning on CPU
 	 */
@@ -2225,6 +2863,7 @@ int stress_cpu(
 			(void)func(name);
 			(*counter)++;
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
+		stress_cpu_method_flush();
 		return EXIT_SUCCESS;
 	}
 
@@ -2289,6 +2928,7 @@ int stress_cpu(
 		/* Bias takes account of the time to do the delay */
 		bias = (t3 - t2) - delay;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
+	stress_cpu_method_flush();
 
 	return EXIT_SUCCESS;
 }
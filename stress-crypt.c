@@ -32,42 +32,153 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #if defined (__linux__)
 #include <crypt.h>
 #endif
 
+typedef struct {
+	const char *name;	/* --crypt-method name */
+	const char *prefix;	/* salt prefix */
+	const bool rounds;	/* takes --crypt-rounds */
+	const bool classic;	/* hashed when no method is given */
+} stress_crypt_method_t;
+
+static const stress_crypt_method_t crypt_methods[] = {
+	{ "md5",	"$1$",	false,	true },
+#if NEED_GLIBC(2,7,0)
+	{ "sha-256",	"$5$",	true,	true },
+	{ "sha-512",	"$6$",	true,	true },
+#endif
+	{ "bcrypt",	"$2b$",	true,	false },
+	{ "yescrypt",	"$y$",	true,	false },
+};
+
+#define CRYPT_METHODS	(SIZEOF_ARRAY(crypt_methods))
+
+static const char *opt_crypt_method = NULL;
+static uint64_t opt_crypt_rounds = 0;
+
 /*
- *  stress_crypt_id()
- *	crypt a password with given seed and id
+ *  stress_set_crypt_method()
+ *	hash with just the named method, or all that libcrypt
+ *	supports
  */
-static int stress_crypt_id(
-	const char *name,
-	const char id,
-	const char *method,
-	const char *passwd,
-	char *salt)
+int stress_set_crypt_method(const char *name)
 {
-	salt[1] = id;
-	char *crypted;
+	size_t i;
+
+	if (!strcmp(name, "all")) {
+		opt_crypt_method = name;
+		return 0;
+	}
+	for (i = 0; i < CRYPT_METHODS; i++) {
+		if (!strcmp(crypt_methods[i].name, name)) {
+			opt_crypt_method = name;
+			return 0;
+		}
+	}
+	fprintf(stderr, "crypt-method must be one of: all");
+	for (i = 0; i < CRYPT_METHODS; i++)
+		fprintf(stderr, " %s", crypt_methods[i].name);
+	fprintf(stderr, "\n");
+
+	return -1;
+}
+
+void stress_set_crypt_rounds(const char *optarg)
+{
+	opt_crypt_rounds = get_uint64(optarg);
+	check_range("crypt-rounds", opt_crypt_rounds,
+		MIN_CRYPT_ROUNDS, MAX_CRYPT_ROUNDS);
+}
+
+/*
+ *  stress_crypt_salt()
+ *	make a random salt for a method with the --crypt-rounds
+ *	cost, 0 is the default cost of the method
+ */
+static int stress_crypt_salt(
+	const stress_crypt_method_t *method,
+	char *salt,
+	const size_t len)
+{
+	static const char seedchars[] =
+		"./0123456789ABCDEFGHIJKLMNOPQRST"
+		"UVWXYZabcdefghijklmnopqrstuvwxyz";
+	const uint64_t rounds = method->rounds ? opt_crypt_rounds : 0;
+#if defined(CRYPT_GENSALT_OUTPUT_SIZE)
+	char rbytes[16];
+	size_t i;
+
+	/* libxcrypt knows the salt format of every method */
+	for (i = 0; i < sizeof(rbytes); i++)
+		rbytes[i] = (char)mwc8();
+	if (!crypt_gensalt_rn(method->prefix, (unsigned long)rounds,
+	    rbytes, (int)sizeof(rbytes), salt, (int)len))
+		return -1;
+	(void)seedchars;
+#else
+	size_t i, n;
+
+	if (!strcmp(method->prefix, "$2b$") || !strcmp(method->prefix, "$y$"))
+		return -1;
+	if (rounds)
+		n = (size_t)snprintf(salt, len, "%srounds=%" PRIu64 "$",
+			method->prefix, rounds);
+	else
+		n = (size_t)snprintf(salt, len, "%s", method->prefix);
+	for (i = 0; (i < 16) && (n < len - 1); i++)
+		salt[n++] = seedchars[mwc8() & 0x3f];
+	salt[n] = '\0';
+#endif
+	return 0;
+}
+
+/*
+ *  stress_crypt_hash()
+ *	crypt a random password with a method, returns the time
+ *	taken or a -ve value if the method failed
+ */
+static double stress_crypt_hash(const stress_crypt_method_t *method)
+{
+	static const char seedchars[] =
+		"./0123456789ABCDEFGHIJKLMNOPQRST"
+		"UVWXYZabcdefghijklmnopqrstuvwxyz";
 #if defined (__linux__)
-	struct crypt_data data;
+	static struct crypt_data data;
+#endif
+	char passwd[16];
+	char salt[256];
+	char *crypted;
+	double t;
+	size_t i;
+
+	if (stress_crypt_salt(method, salt, sizeof(salt)) < 0)
+		return -1.0;
+	for (i = 0; i < sizeof(passwd) - 1; i++)
+		passwd[i] = seedchars[mwc32() % (sizeof(seedchars) - 1)];
+	passwd[i] = '\0';
 
-	memset(&data, 0, sizeof(data));
+	t = time_now();
+#if defined (__linux__)
 	crypted = crypt_r(passwd, salt, &data);
 #else
 	crypted = crypt(passwd, salt);
 #endif
-	if (!crypted) {
-		pr_fail(stderr, "%s: cannot encrypt with %s", name, method);
-		return -1;
-	}
-	return 0;
+	t = time_now() - t;
+
+	/* libxcrypt returns a hash starting with * on failure */
+	if (!crypted || (*crypted == '*'))
+		return -1.0;
+	return t;
 }
 
 /*
  *  stress_crypt()
- *	stress libc crypt
+ *	stress libc crypt, reporting the hashes per second of
+ *	each method
  */
 int stress_crypt(
 	uint64_t *const counter,
@@ -75,39 +186,64 @@ int stress_crypt(
 	const uint64_t max_ops,
 	const char *name)
 {
-	(void)instance;
+	const stress_crypt_method_t *methods[CRYPT_METHODS];
+	uint64_t hashes[CRYPT_METHODS];
+	double duration[CRYPT_METHODS];
+	size_t i, n = 0;
+	int rc = EXIT_SUCCESS;
+
+	/* Pick the methods and drop those libcrypt does not support */
+	for (i = 0; i < CRYPT_METHODS; i++) {
+		const stress_crypt_method_t *method = &crypt_methods[i];
+		const bool all = opt_crypt_method && !strcmp(opt_crypt_method, "all");
+
+		if (opt_crypt_method ? (!all && strcmp(opt_crypt_method, method->name)) :
+		    !method->classic)
+			continue;
+		if (stress_crypt_hash(method) < 0.0) {
+			if (!all) {
+				if (instance == 0)
+					pr_inf(stderr, "%s: %s with %" PRIu64 " rounds "
+						"is not supported by libcrypt, skipping "
+						"stressor\n", name, method->name,
+						opt_crypt_rounds);
+				return EXIT_NO_RESOURCE;
+			}
+			pr_dbg(stderr, "%s: %s is not supported by libcrypt\n",
+				name, method->name);
+			continue;
+		}
+		methods[n] = method;
+		hashes[n] = 0;
+		duration[n] = 0.0;
+		n++;
+	}
 
 	do {
-		static const char seedchars[] =
-			"./0123456789ABCDEFGHIJKLMNOPQRST"
-			"UVWXYZabcdefghijklmnopqrstuvwxyz";
-		char passwd[16];
-		char salt[] = "$x$........";
-		uint64_t seed[2];
-		size_t i;
-
-		seed[0] = mwc64();
-		seed[1] = mwc64();
-
-		for (i = 0; i < 8; i++)
-			salt[i + 3] = seedchars[(seed[i / 5] >> (i % 5) * 6) & 0x3f];
-		for (i = 0; i < sizeof(passwd) - 1; i++)
-			passwd[i] = seedchars[mwc32() % sizeof(seedchars)];
-		passwd[i] = '\0';
-
-		if (stress_crypt_id(name, '1', "MD5", passwd, salt) < 0)
-			break;
-#if NEED_GLIBC(2,7,0)
-		if (stress_crypt_id(name, '5', "SHA-256", passwd, salt) < 0)
-			break;
-		if (stress_crypt_id(name, '6', "SHA-512", passwd, salt) < 0)
-			break;
-#endif
+		for (i = 0; i < n; i++) {
+			const double t = stress_crypt_hash(methods[i]);
 
+			if (t < 0.0) {
+				pr_fail(stderr, "%s: cannot encrypt with %s\n",
+					name, methods[i]->name);
+				rc = EXIT_FAILURE;
+				goto report;
+			}
+			hashes[i]++;
+			duration[i] += t;
+		}
 		(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
-	return EXIT_SUCCESS;
+report:
+	for (i = 0; (i < n) && (i < STRESS_MISC_METRICS_MAX); i++) {
+		char desc[32];
+
+		snprintf(desc, sizeof(desc), "%s hashes/sec", methods[i]->name);
+		stress_misc_metric_set(i, desc, duration[i] > 0.0 ?
+			(double)hashes[i] / duration[i] : 0.0);
+	}
+	return rc;
 }
 
 #endif
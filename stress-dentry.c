@@ -29,6 +29,7 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <fcntl.h>
@@ -58,9 +59,20 @@ static const dentry_removal_t dentry_removals[] = {
 	{ NULL,		ORDER_NONE },
 };
 
+#define DENTRY_NEG_BATCH	(1024)		/* lookups between clock checks */
+
+/* system wide dentry cache and slab usage, -1 if unknown */
+typedef struct {
+	int64_t nr_dentry;		/* dentry-state allocated dentries */
+	int64_t nr_negative;		/* dentry-state negative dentries */
+	int64_t sreclaimable;		/* meminfo reclaimable slab (KB) */
+	int64_t dentry_slab;		/* slabinfo dentry cache (KB) */
+} dentry_state_t;
+
 static dentry_order_t order = ORDER_RANDOM;
 static uint64_t opt_dentries = DEFAULT_DENTRIES;
 static bool set_dentries = false;
+static bool opt_dentry_negative = false;
 
 void stress_set_dentries(const char *optarg)
 {
@@ -94,6 +106,11 @@ int stress_set_dentry_order(const char *optarg)
 	return -1;
 }
 
+void stress_set_dentry_negative(void)
+{
+	opt_dentry_negative = true;
+}
+
 /*
  *  stress_dentry_unlink()
  *	remove all dentries
@@ -152,6 +169,192 @@ static void stress_dentry_unlink(
 	sync();
 }
 
+#if defined(STRESS_LATENCY)
+/*
+ *  stress_dentry_state()
+ *	read the dentry cache size and slab usage, the negative
+ *	count needs Linux 5.0 and slabinfo is only readable by root
+ */
+static void stress_dentry_state(dentry_state_t *ds)
+{
+	FILE *fp;
+	char buf[256];
+	long long v[5];
+
+	ds->nr_dentry = -1;
+	ds->nr_negative = -1;
+	ds->sreclaimable = -1;
+	ds->dentry_slab = -1;
+
+	fp = fopen("/proc/sys/fs/dentry-state", "r");
+	if (fp) {
+		const int n = fscanf(fp, "%lld %lld %lld %lld %lld",
+			&v[0], &v[1], &v[2], &v[3], &v[4]);
+
+		if (n >= 1)
+			ds->nr_dentry = v[0];
+		if (n >= 5)
+			ds->nr_negative = v[4];
+		(void)fclose(fp);
+	}
+
+	fp = fopen("/proc/meminfo", "r");
+	if (fp) {
+		while (fgets(buf, sizeof(buf), fp)) {
+			if (sscanf(buf, "SReclaimable: %lld", &v[0]) == 1) {
+				ds->sreclaimable = v[0];
+				break;
+			}
+		}
+		(void)fclose(fp);
+	}
+
+	fp = fopen("/proc/slabinfo", "r");
+	if (fp) {
+		while (fgets(buf, sizeof(buf), fp)) {
+			/* name active_objs num_objs objsize ... */
+			if (strncmp(buf, "dentry ", 7))
+				continue;
+			if (sscanf(buf + 7, "%lld %lld %lld",
+					&v[0], &v[1], &v[2]) == 3)
+				ds->dentry_slab = (v[1] * v[2]) / 1024;
+			break;
+		}
+		(void)fclose(fp);
+	}
+}
+
+/*
+ *  dentry_val_str()
+ *	format a dentry_state_t value, n/a if unknown
+ */
+static const char *dentry_val_str(char *buf, const size_t len, const int64_t val)
+{
+	if (val < 0)
+		(void)snprintf(buf, len, "n/a");
+	else
+		(void)snprintf(buf, len, "%" PRId64, val);
+	return buf;
+}
+
+/*
+ *  stress_dentry_negative_row()
+ *	report the dcache growth and the lookup latencies
+ *	of the last interval
+ */
+static void stress_dentry_negative_row(
+	const char *name,
+	const double t,
+	const dentry_state_t *ds,
+	const stress_latency_t *lat)
+{
+	char neg[24], total[24], srec[24], slab[24];
+
+	pr_inf(stderr, "%s: %7.1f %12s %12s %10s %10s %8.2f %8.2f %10.2f\n",
+		name, t,
+		dentry_val_str(neg, sizeof(neg), ds->nr_negative),
+		dentry_val_str(total, sizeof(total), ds->nr_dentry),
+		dentry_val_str(srec, sizeof(srec), ds->sreclaimable / 1024),
+		dentry_val_str(slab, sizeof(slab), ds->dentry_slab / 1024),
+		(double)latency_percentile(lat, 0.50) / 1000.0,
+		(double)latency_percentile(lat, 0.99) / 1000.0,
+		(double)lat->max / 1000.0);
+}
+
+/*
+ *  stress_dentry_negative()
+ *	look up names that do not exist as fast as possible,
+ *	each one leaves a new negative dentry behind, and
+ *	watch the dcache and slab grow and what that does to
+ *	the lookup latency. The first instance reports a row
+ *	at 1, 2, 4, 8.. seconds
+ */
+static int stress_dentry_negative(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const pid_t pid = getpid();
+	dentry_state_t start, now;
+	stress_latency_t lat, lat_all;
+	uint64_t seq = 0, hits = 0;
+	double t_start, t_next = 1.0, duration;
+
+	memset(&lat, 0, sizeof(lat));
+	memset(&lat_all, 0, sizeof(lat_all));
+	stress_dentry_state(&start);
+	if (instance == 0) {
+		pr_inf(stderr, "%s: %7s %12s %12s %10s %10s %8s %8s %10s\n",
+			name, "secs", "negative", "dentries", "SReclm MB",
+			"slab MB", "p50 us", "p99 us", "max us");
+		stress_dentry_negative_row(name, 0.0, &start, &lat);
+	}
+
+	t_start = time_now();
+	do {
+		int i;
+
+		for (i = 0; i < DENTRY_NEG_BATCH; i++) {
+			char path[PATH_MAX];
+			struct stat statbuf;
+			uint64_t t;
+
+			(void)stress_temp_filename(path, sizeof(path),
+				name, pid, instance, seq++);
+			t = time_now_ns();
+			if (stat(path, &statbuf) == 0)
+				hits++;
+			t = time_now_ns() - t;
+			latency_record(&lat, t);
+			latency_record(&lat_all, t);
+			(*counter)++;
+			if (max_ops && *counter >= max_ops)
+				break;
+		}
+		duration = time_now() - t_start;
+		if ((instance == 0) && (duration >= t_next)) {
+			stress_dentry_state(&now);
+			stress_dentry_negative_row(name, duration, &now, &lat);
+			memset(&lat, 0, sizeof(lat));
+			while (t_next <= duration)
+				t_next *= 2.0;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	duration = time_now() - t_start;
+	stress_dentry_state(&now);
+	if ((instance == 0) && lat.count)
+		stress_dentry_negative_row(name, duration, &now, &lat);
+	if (hits)
+		pr_dbg(stderr, "%s: %" PRIu64 " names unexpectedly existed\n",
+			name, hits);
+
+	if ((start.nr_negative >= 0) && (now.nr_negative >= 0))
+		stress_misc_metric_set(0, "negative dentries added",
+			(double)(now.nr_negative - start.nr_negative));
+	if ((start.nr_dentry >= 0) && (now.nr_dentry >= 0))
+		stress_misc_metric_set(1, "dentries added",
+			(double)(now.nr_dentry - start.nr_dentry));
+	if ((start.sreclaimable >= 0) && (now.sreclaimable >= 0))
+		stress_misc_metric_set(2, "SReclaimable growth (MB)",
+			(double)(now.sreclaimable - start.sreclaimable) / 1024.0);
+	if ((start.dentry_slab >= 0) && (now.dentry_slab >= 0))
+		stress_misc_metric_set(3, "dentry slab growth (MB)",
+			(double)(now.dentry_slab - start.dentry_slab) / 1024.0);
+	if (lat_all.count) {
+		stress_misc_metric_set(4, "lookup p50 (usec)",
+			(double)latency_percentile(&lat_all, 0.50) / 1000.0);
+		stress_misc_metric_set(5, "lookup p99 (usec)",
+			(double)latency_percentile(&lat_all, 0.99) / 1000.0);
+		stress_misc_metric_set(6, "lookup max (usec)",
+			(double)lat_all.max / 1000.0);
+	}
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 /*
  *  stress_dentry
  *	stress dentries
@@ -176,6 +379,18 @@ int stress_dentry(
 	if (ret < 0)
 		return exit_status(-ret);
 
+	if (opt_dentry_negative) {
+#if defined(STRESS_LATENCY)
+		ret = stress_dentry_negative(counter, instance, max_ops, name);
+		/* removing the directory drops its negative dentries */
+		(void)stress_temp_dir_rm(name, pid, instance);
+		return ret;
+#else
+		pr_inf(stderr, "%s: --dentry-negative is not supported, "
+			"using the default mode\n", name);
+#endif
+	}
+
 	do {
 		uint64_t i, n = opt_dentries;
 
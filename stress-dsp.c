@@ -0,0 +1,755 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_DSP)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#define DSP_STEP_TIME		(0.1)		/* seconds per method and size */
+#define DSP_SIZES_MAX		(16)		/* max --dsp-sizes */
+#define DSP_ALIGN		(64)
+
+typedef double complex dsp_cplx_t;
+
+#if defined(HAVE_VECMATH)
+typedef double dsp_v4df_t __attribute__ ((vector_size (32)));
+#endif
+
+/* The buffers and twiddle tables of the size being transformed */
+typedef struct {
+	size_t n;		/* transform size */
+	dsp_cplx_t *x;		/* input */
+	dsp_cplx_t *y;		/* second input of correlate */
+	dsp_cplx_t *out;	/* output, the simd fft keeps re then im here */
+	dsp_cplx_t *tmp;	/* scratch, the simd fft twiddles */
+	dsp_cplx_t *tw;		/* W_n^k = exp(-2 pi i k / n), k < n */
+	dsp_cplx_t *dct_tw;	/* exp(-i pi k / 2n), k < n */
+} dsp_buf_t;
+
+typedef struct {
+	const char *name;	/* --dsp-method name */
+	bool pow2;		/* only power of 2 sizes */
+	void (*setup)(dsp_buf_t *buf);
+	void (*transform)(dsp_buf_t *buf);
+	double (*flops)(const double n);
+	bool (*verify)(const dsp_buf_t *buf);
+} dsp_method_t;
+
+static size_t opt_dsp_sizes[DSP_SIZES_MAX] = {
+	64, 256, 1024, 4096, 16384, 65536, 262144, 1048576
+};
+static size_t opt_dsp_nsizes = 8;
+static const char *opt_dsp_method = "all";
+
+/*
+ *  dsp_mul()
+ *	complex multiply, without the C99 NaN and infinity
+ *	recovery that the * operator drags in with __muldc3
+ */
+static inline dsp_cplx_t dsp_mul(const dsp_cplx_t a, const dsp_cplx_t b)
+{
+	dsp_cplx_t r;
+
+	__real__ r = __real__ a * __real__ b - __imag__ a * __imag__ b;
+	__imag__ r = __real__ a * __imag__ b + __imag__ a * __real__ b;
+	return r;
+}
+
+/*
+ *  dsp_mul_negi()
+ *	multiply by -i
+ */
+static inline dsp_cplx_t dsp_mul_negi(const dsp_cplx_t a)
+{
+	dsp_cplx_t r;
+
+	__real__ r = __imag__ a;
+	__imag__ r = -__real__ a;
+	return r;
+}
+
+/*
+ *  dsp_smooth()
+ *	true if n only has the factors 2, 3 and 5 that the mixed
+ *	radix fft has butterflies for
+ */
+static bool dsp_smooth(size_t n)
+{
+	static const size_t factors[] = { 2, 3, 5 };
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(factors); i++)
+		while (n && !(n % factors[i]))
+			n /= factors[i];
+	return n == 1;
+}
+
+/*
+ *  dsp_fft_flops()
+ *	the usual 5 n log2 n flops of a complex fft, used as the
+ *	nominal count whatever the radix or size
+ */
+static double dsp_fft_flops(const double n)
+{
+	return 5.0 * n * log2(n);
+}
+
+/*
+ *  dsp_dct_flops()
+ *	nominal 2.5 n log2 n flops of a real input transform
+ */
+static double dsp_dct_flops(const double n)
+{
+	return 2.5 * n * log2(n);
+}
+
+/*
+ *  dsp_correlate_flops()
+ *	three ffts, the spectra product and the 1/n scaling
+ */
+static double dsp_correlate_flops(const double n)
+{
+	return 3.0 * dsp_fft_flops(n) + 8.0 * n;
+}
+
+/*
+ *  dsp_energy()
+ *	sum of |x|^2
+ */
+static double dsp_energy(const dsp_cplx_t *x, const size_t n)
+{
+	double sum = 0.0;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		sum += __real__ x[i] * __real__ x[i] + __imag__ x[i] * __imag__ x[i];
+	return sum;
+}
+
+static inline bool dsp_close(const double a, const double b)
+{
+	return fabs(a - b) <= 1E-6 * fabs(b);
+}
+
+/*
+ *  dsp_fft_verify()
+ *	Parseval, the energy of the spectrum is n times the energy
+ *	of the signal
+ */
+static bool dsp_fft_verify(const dsp_buf_t *buf)
+{
+	return dsp_close(dsp_energy(buf->out, buf->n),
+		(double)buf->n * dsp_energy(buf->x, buf->n));
+}
+
+/*
+ *  dsp_fft_radix2()
+ *	iterative in place radix-2 decimation in time fft
+ */
+static void HOT OPTIMIZE3 dsp_fft_radix2(dsp_buf_t *buf)
+{
+	const size_t n = buf->n;
+	dsp_cplx_t *out = buf->out;
+	const dsp_cplx_t *tw = buf->tw;
+	size_t i, j, len;
+
+	/* Bit reversed copy of the input */
+	for (i = 0, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+
+		out[j] = buf->x[i];
+		while (j & bit) {
+			j ^= bit;
+			bit >>= 1;
+		}
+		j |= bit;
+	}
+
+	for (len = 2; len <= n; len <<= 1) {
+		const size_t half = len >> 1, step = n / len;
+
+		for (i = 0; i < n; i += len) {
+			size_t k;
+
+			for (k = 0; k < half; k++) {
+				const dsp_cplx_t u = out[i + k];
+				const dsp_cplx_t v = dsp_mul(out[i + k + half], tw[k * step]);
+
+				out[i + k] = u + v;
+				out[i + k + half] = u - v;
+			}
+		}
+	}
+}
+
+/*
+ *  dsp_fft_split_r()
+ *	split radix fft, an n/2 transform of the even samples and
+ *	two n/4 transforms of the odd samples combined with an L
+ *	shaped butterfly. W_n^k is tw[k * stride] as stride is N/n
+ */
+static void HOT OPTIMIZE3 dsp_fft_split_r(
+	const dsp_cplx_t *in,
+	dsp_cplx_t *out,
+	const size_t n,
+	const size_t stride,
+	const dsp_cplx_t *tw)
+{
+	const size_t n2 = n >> 1, n4 = n >> 2;
+	size_t k;
+
+	if (n == 1) {
+		out[0] = in[0];
+		return;
+	}
+	if (n == 2) {
+		out[0] = in[0] + in[stride];
+		out[1] = in[0] - in[stride];
+		return;
+	}
+	dsp_fft_split_r(in, out, n2, stride << 1, tw);
+	dsp_fft_split_r(in + stride, out + n2, n4, stride << 2, tw);
+	dsp_fft_split_r(in + 3 * stride, out + n2 + n4, n4, stride << 2, tw);
+
+	for (k = 0; k < n4; k++) {
+		const dsp_cplx_t a = dsp_mul(out[n2 + k], tw[k * stride]);
+		const dsp_cplx_t b = dsp_mul(out[n2 + n4 + k], tw[3 * k * stride]);
+		const dsp_cplx_t s = a + b;
+		const dsp_cplx_t d = dsp_mul_negi(a - b);
+		const dsp_cplx_t u0 = out[k];
+		const dsp_cplx_t u1 = out[k + n4];
+
+		out[k] = u0 + s;
+		out[k + n2] = u0 - s;
+		out[k + n4] = u1 + d;
+		out[k + n2 + n4] = u1 - d;
+	}
+}
+
+static void dsp_fft_split(dsp_buf_t *buf)
+{
+	dsp_fft_split_r(buf->x, buf->out, buf->n, 1, buf->tw);
+}
+
+/*
+ *  dsp_fft_mixed_r()
+ *	mixed radix decimation in time fft with radix 4, 2, 3 and 5
+ *	butterflies, n must be a product of 2, 3 and 5. W_n^k is
+ *	tw[k * stride] of the N point table as stride is N/n
+ */
+static void HOT OPTIMIZE3 dsp_fft_mixed_r(
+	const dsp_cplx_t *in,
+	dsp_cplx_t *out,
+	const size_t n,
+	const size_t stride,
+	const dsp_cplx_t *tw)
+{
+	size_t p, m, r, k;
+
+	if (n == 1) {
+		out[0] = in[0];
+		return;
+	}
+	if (!(n & 3))
+		p = 4;
+	else if (!(n & 1))
+		p = 2;
+	else if (!(n % 3))
+		p = 3;
+	else
+		p = 5;
+	m = n / p;
+
+	for (r = 0; r < p; r++)
+		dsp_fft_mixed_r(in + r * stride, out + r * m, m, stride * p, tw);
+
+	for (k = 0; k < m; k++) {
+		dsp_cplx_t t[5];
+
+		t[0] = out[k];
+		for (r = 1; r < p; r++)
+			t[r] = dsp_mul(out[r * m + k], tw[r * k * stride]);
+
+		switch (p) {
+		case 2:
+			out[k] = t[0] + t[1];
+			out[k + m] = t[0] - t[1];
+			break;
+		case 4: {
+				const dsp_cplx_t a0 = t[0] + t[2];
+				const dsp_cplx_t a1 = t[0] - t[2];
+				const dsp_cplx_t a2 = t[1] + t[3];
+				const dsp_cplx_t a3 = dsp_mul_negi(t[1] - t[3]);
+
+				out[k] = a0 + a2;
+				out[k + m] = a1 + a3;
+				out[k + 2 * m] = a0 - a2;
+				out[k + 3 * m] = a1 - a3;
+			}
+			break;
+		default: {
+				/* W_p^rq is W_N^((rq mod p) N/p) */
+				const size_t wstep = stride * m;
+				size_t q;
+
+				for (q = 0; q < p; q++) {
+					dsp_cplx_t s = t[0];
+
+					for (r = 1; r < p; r++)
+						s += dsp_mul(t[r], tw[((r * q) % p) * wstep]);
+					out[k + q * m] = s;
+				}
+			}
+			break;
+		}
+	}
+}
+
+static void dsp_fft_mixed(dsp_buf_t *buf)
+{
+	dsp_fft_mixed_r(buf->x, buf->out, buf->n, 1, buf->tw);
+}
+
+#if defined(HAVE_VECMATH)
+/*
+ *  dsp_fft_simd_setup()
+ *	twiddles of each stage of the simd fft in the scratch
+ *	buffer, re then im, the W_2h^k of the stage with half
+ *	size h are at [h, 2h) so that they load as vectors
+ */
+static void dsp_fft_simd_setup(dsp_buf_t *buf)
+{
+	const size_t n = buf->n;
+	double *tw_re = (double *)buf->tmp, *tw_im = tw_re + n;
+	size_t h, k;
+
+	for (h = 1; h < n; h <<= 1) {
+		for (k = 0; k < h; k++) {
+			const dsp_cplx_t w = buf->tw[k * (n / (h << 1))];
+
+			tw_re[h + k] = __real__ w;
+			tw_im[h + k] = __imag__ w;
+		}
+	}
+}
+
+/*
+ *  dsp_fft_simd()
+ *	radix-2 fft on split real and imaginary arrays with the
+ *	butterflies 4 wide in vectors, the output is left as the
+ *	real then the imaginary parts in the output buffer
+ */
+static void HOT OPTIMIZE3 TARGET_CLONES dsp_fft_simd(dsp_buf_t *buf)
+{
+	const size_t n = buf->n;
+	double *re = (double *)buf->out, *im = re + n;
+	const double *tw_re = (const double *)buf->tmp, *tw_im = tw_re + n;
+	size_t i, j, h;
+
+	for (i = 0, j = 0; i < n; i++) {
+		size_t bit = n >> 1;
+
+		re[j] = __real__ buf->x[i];
+		im[j] = __imag__ buf->x[i];
+		while (j & bit) {
+			j ^= bit;
+			bit >>= 1;
+		}
+		j |= bit;
+	}
+
+	for (h = 1; h < n; h <<= 1) {
+		const double *wr = tw_re + h, *wi = tw_im + h;
+
+		for (i = 0; i < n; i += h << 1) {
+			size_t k;
+
+			if (h < 4) {
+				for (k = 0; k < h; k++) {
+					const size_t u = i + k, v = u + h;
+					const double tr = re[v] * wr[k] - im[v] * wi[k];
+					const double ti = re[v] * wi[k] + im[v] * wr[k];
+
+					re[v] = re[u] - tr;
+					im[v] = im[u] - ti;
+					re[u] += tr;
+					im[u] += ti;
+				}
+				continue;
+			}
+			for (k = 0; k < h; k += 4) {
+				dsp_v4df_t *ur = (dsp_v4df_t *)(re + i + k);
+				dsp_v4df_t *ui = (dsp_v4df_t *)(im + i + k);
+				dsp_v4df_t *vr = (dsp_v4df_t *)(re + i + k + h);
+				dsp_v4df_t *vi = (dsp_v4df_t *)(im + i + k + h);
+				const dsp_v4df_t w_r = *(const dsp_v4df_t *)(wr + k);
+				const dsp_v4df_t w_i = *(const dsp_v4df_t *)(wi + k);
+				const dsp_v4df_t tr = *vr * w_r - *vi * w_i;
+				const dsp_v4df_t ti = *vr * w_i + *vi * w_r;
+
+				*vr = *ur - tr;
+				*vi = *ui - ti;
+				*ur += tr;
+				*ui += ti;
+			}
+		}
+	}
+}
+
+static bool dsp_fft_simd_verify(const dsp_buf_t *buf)
+{
+	const double *re = (const double *)buf->out, *im = re + buf->n;
+	double sum = 0.0;
+	size_t i;
+
+	for (i = 0; i < buf->n; i++)
+		sum += re[i] * re[i] + im[i] * im[i];
+	return dsp_close(sum, (double)buf->n * dsp_energy(buf->x, buf->n));
+}
+#endif
+
+/*
+ *  dsp_dct()
+ *	DCT-II of the real part of the input by Makhoul's method,
+ *	the even samples then the odd ones reversed go through an
+ *	n point fft and X_k = Re(exp(-i pi k / 2n) V_k)
+ */
+static void HOT OPTIMIZE3 dsp_dct(dsp_buf_t *buf)
+{
+	const size_t n = buf->n;
+	dsp_cplx_t *v = buf->tmp, *out = buf->out;
+	size_t k;
+
+	for (k = 0; k < (n + 1) / 2; k++)
+		v[k] = __real__ buf->x[2 * k];
+	for (k = 0; k < n / 2; k++)
+		v[n - 1 - k] = __real__ buf->x[2 * k + 1];
+	dsp_fft_mixed_r(v, out, n, 1, buf->tw);
+	for (k = 0; k < n; k++)
+		out[k] = __real__ dsp_mul(out[k], buf->dct_tw[k]);
+}
+
+/*
+ *  dsp_dct_verify()
+ *	Parseval of the DCT-II, sum x^2 = (X_0^2 + 2 sum X_k^2) / n
+ */
+static bool dsp_dct_verify(const dsp_buf_t *buf)
+{
+	const size_t n = buf->n;
+	double sx = 0.0, sX;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		sx += __real__ buf->x[i] * __real__ buf->x[i];
+	sX = 2.0 * dsp_energy(buf->out, n) -
+		__real__ buf->out[0] * __real__ buf->out[0];
+	return dsp_close(sX / (double)n, sx);
+}
+
+/*
+ *  dsp_correlate()
+ *	circular cross correlation of x and y by fft, the inverse
+ *	transform is the conjugate of the fft of the conjugate
+ */
+static void HOT OPTIMIZE3 dsp_correlate(dsp_buf_t *buf)
+{
+	const size_t n = buf->n;
+	const double scale = 1.0 / (double)n;
+	dsp_cplx_t *out = buf->out, *tmp = buf->tmp;
+	size_t k;
+
+	dsp_fft_mixed_r(buf->x, out, n, 1, buf->tw);
+	dsp_fft_mixed_r(buf->y, tmp, n, 1, buf->tw);
+	for (k = 0; k < n; k++)
+		tmp[k] = dsp_mul(conj(out[k]), tmp[k]);
+	dsp_fft_mixed_r(tmp, out, n, 1, buf->tw);
+	for (k = 0; k < n; k++)
+		out[k] = conj(out[k]) * scale;
+}
+
+/*
+ *  dsp_correlate_verify()
+ *	the zero lag is the sum of x conj(y)
+ */
+static bool dsp_correlate_verify(const dsp_buf_t *buf)
+{
+	dsp_cplx_t sum = 0.0;
+	size_t i;
+
+	for (i = 0; i < buf->n; i++)
+		sum += dsp_mul(buf->x[i], conj(buf->y[i]));
+	return dsp_close(__real__ buf->out[0], __real__ sum) &&
+	       dsp_close(__imag__ buf->out[0], __imag__ sum);
+}
+
+static const dsp_method_t dsp_methods[] = {
+	{ "fft-radix2",	true,	NULL,	dsp_fft_radix2,	dsp_fft_flops,	dsp_fft_verify },
+	{ "fft-split",	true,	NULL,	dsp_fft_split,	dsp_fft_flops,	dsp_fft_verify },
+	{ "fft-mixed",	false,	NULL,	dsp_fft_mixed,	dsp_fft_flops,	dsp_fft_verify },
+#if defined(HAVE_VECMATH)
+	{ "fft-simd",	true,	dsp_fft_simd_setup, dsp_fft_simd, dsp_fft_flops, dsp_fft_simd_verify },
+#endif
+	{ "dct",	false,	NULL,	dsp_dct,	dsp_dct_flops,	dsp_dct_verify },
+	{ "correlate",	false,	NULL,	dsp_correlate,	dsp_correlate_flops, dsp_correlate_verify },
+};
+
+#define DSP_METHODS	(SIZEOF_ARRAY(dsp_methods))
+
+/*
+ *  stress_set_dsp_method()
+ *	set the transform to run, or all of them
+ */
+int stress_set_dsp_method(const char *name)
+{
+	size_t i;
+
+	if (!strcmp(name, "all")) {
+		opt_dsp_method = name;
+		return 0;
+	}
+	for (i = 0; i < DSP_METHODS; i++) {
+		if (!strcmp(name, dsp_methods[i].name)) {
+			opt_dsp_method = name;
+			return 0;
+		}
+	}
+	fprintf(stderr, "dsp-method must be one of: all");
+	for (i = 0; i < DSP_METHODS; i++)
+		fprintf(stderr, " %s", dsp_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_dsp_sizes()
+ *	set the comma separated transform sizes
+ */
+int stress_set_dsp_sizes(const char *optarg)
+{
+	char *str, *token, *ptr;
+
+	str = strdup(optarg);
+	if (!str) {
+		fprintf(stderr, "dsp-sizes: out of memory\n");
+		return -1;
+	}
+	opt_dsp_nsizes = 0;
+	for (ptr = str; (token = strsep(&ptr, ",")) != NULL; ) {
+		uint64_t n;
+
+		if (!*token)
+			continue;
+		if (opt_dsp_nsizes >= DSP_SIZES_MAX) {
+			fprintf(stderr, "dsp-sizes: more than %d sizes\n",
+				DSP_SIZES_MAX);
+			free(str);
+			return -1;
+		}
+		n = get_uint64_byte(token);
+		check_range("dsp-sizes", n, MIN_DSP_SIZE, MAX_DSP_SIZE);
+		if (!dsp_smooth((size_t)n)) {
+			fprintf(stderr, "dsp-sizes: %" PRIu64 " is not a product "
+				"of 2, 3 and 5\n", n);
+			free(str);
+			return -1;
+		}
+		opt_dsp_sizes[opt_dsp_nsizes++] = (size_t)n;
+	}
+	free(str);
+	if (!opt_dsp_nsizes) {
+		fprintf(stderr, "dsp-sizes: no sizes given\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  dsp_buf_size()
+ *	make the twiddle tables and random inputs for size n
+ */
+static void dsp_buf_size(dsp_buf_t *buf, const size_t n)
+{
+	const double scale = 1.0 / 2147483648.0;
+	size_t k;
+
+	buf->n = n;
+	for (k = 0; k < n; k++) {
+		buf->tw[k] = cexp(-2.0 * M_PI * I * (double)k / (double)n);
+		buf->dct_tw[k] = cexp(-M_PI * I * (double)k / (2.0 * (double)n));
+		__real__ buf->x[k] = ((double)mwc32() * scale) - 1.0;
+		__imag__ buf->x[k] = ((double)mwc32() * scale) - 1.0;
+		__real__ buf->y[k] = ((double)mwc32() * scale) - 1.0;
+		__imag__ buf->y[k] = ((double)mwc32() * scale) - 1.0;
+	}
+}
+
+/*
+ *  stress_dsp()
+ *	run fft, dct and correlation kernels over a range of sizes,
+ *	DSP_STEP_TIME seconds per method and size, and report the
+ *	GFLOP/s of each
+ */
+int stress_dsp(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	static double flops[DSP_METHODS][DSP_SIZES_MAX];
+	static double durations[DSP_METHODS][DSP_SIZES_MAX];
+	dsp_cplx_t **bufs[] = { NULL, NULL, NULL, NULL, NULL, NULL };
+	dsp_buf_t buf;
+	bool reported = false, verified[DSP_METHODS][DSP_SIZES_MAX];
+	size_t i, m, s, n_max = 0, idx = 0;
+	int rc = EXIT_SUCCESS;
+
+	for (s = 0; s < opt_dsp_nsizes; s++)
+		n_max = STRESS_MAXIMUM(n_max, opt_dsp_sizes[s]);
+
+	memset(&buf, 0, sizeof(buf));
+	bufs[0] = &buf.x;
+	bufs[1] = &buf.y;
+	bufs[2] = &buf.out;
+	bufs[3] = &buf.tmp;
+	bufs[4] = &buf.tw;
+	bufs[5] = &buf.dct_tw;
+	for (i = 0; i < SIZEOF_ARRAY(bufs); i++) {
+		void *ptr;
+
+		if (posix_memalign(&ptr, DSP_ALIGN, n_max * sizeof(dsp_cplx_t))) {
+			pr_inf(stderr, "%s: cannot allocate %zu byte buffers, "
+				"skipping stressor\n", name,
+				n_max * sizeof(dsp_cplx_t));
+			rc = EXIT_NO_RESOURCE;
+			goto free_bufs;
+		}
+		*bufs[i] = ptr;
+	}
+	memset(verified, 0, sizeof(verified));
+
+	do {
+		for (s = 0; s < opt_dsp_nsizes; s++) {
+			const size_t n = opt_dsp_sizes[s];
+
+			if (!opt_do_run || (max_ops && (*counter >= max_ops)))
+				goto done;
+			dsp_buf_size(&buf, n);
+
+			for (m = 0; m < DSP_METHODS; m++) {
+				const dsp_method_t *method = &dsp_methods[m];
+				uint64_t ops = 0;
+				double t;
+
+				if (strcmp(opt_dsp_method, "all") &&
+				    strcmp(opt_dsp_method, method->name))
+					continue;
+				if (method->pow2 && (n & (n - 1)))
+					continue;
+				if (method->setup)
+					method->setup(&buf);
+
+				t = time_now();
+				do {
+					method->transform(&buf);
+					ops++;
+					(*counter)++;
+				} while (opt_do_run && (time_now() - t < DSP_STEP_TIME) &&
+					 (!max_ops || (*counter < max_ops)));
+				durations[m][s] += time_now() - t;
+				flops[m][s] += (double)ops * method->flops((double)n);
+
+				if ((opt_flags & OPT_FLAGS_VERIFY) && !verified[m][s]) {
+					verified[m][s] = true;
+					if (!method->verify(&buf)) {
+						pr_fail(stderr, "%s: %s of size %zu "
+							"gave the wrong result\n",
+							name, method->name, n);
+						rc = EXIT_FAILURE;
+					}
+				}
+			}
+		}
+		if ((instance == 0) && !reported) {
+			char line[256];
+			int len;
+
+			len = snprintf(line, sizeof(line), "%9s %9s", "size", "KB");
+			for (m = 0; m < DSP_METHODS; m++)
+				if (!strcmp(opt_dsp_method, "all") ||
+				    !strcmp(opt_dsp_method, dsp_methods[m].name))
+					len += snprintf(line + len, sizeof(line) - len,
+						" %10s", dsp_methods[m].name);
+			pr_inf(stderr, "%s: GFLOP/s per transform size\n", name);
+			pr_inf(stderr, "%s: %s\n", name, line);
+			for (s = 0; s < opt_dsp_nsizes; s++) {
+				len = snprintf(line, sizeof(line), "%9zu %9zu",
+					opt_dsp_sizes[s],
+					(opt_dsp_sizes[s] * sizeof(dsp_cplx_t)) / 1024);
+				for (m = 0; m < DSP_METHODS; m++) {
+					if (strcmp(opt_dsp_method, "all") &&
+					    strcmp(opt_dsp_method, dsp_methods[m].name))
+						continue;
+					if (durations[m][s] > 0.0)
+						len += snprintf(line + len, sizeof(line) - len,
+							" %10.3f", flops[m][s] /
+							(durations[m][s] * 1E9));
+					else
+						len += snprintf(line + len, sizeof(line) - len,
+							" %10s", "-");
+				}
+				pr_inf(stderr, "%s: %s\n", name, line);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (m = 0; m < DSP_METHODS; m++) {
+		for (s = 0; s < opt_dsp_nsizes; s++) {
+			char desc[40];
+
+			if ((durations[m][s] <= 0.0) || (idx >= STRESS_MISC_METRICS_MAX))
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s %zu GFLOP/s",
+				dsp_methods[m].name, opt_dsp_sizes[s]);
+			stress_misc_metric_set(idx++, desc,
+				flops[m][s] / (durations[m][s] * 1E9));
+		}
+	}
+free_bufs:
+	for (i = 0; i < SIZEOF_ARRAY(bufs); i++)
+		free(*bufs[i]);
+
+	return rc;
+}
+
+#endif
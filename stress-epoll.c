@@ -54,12 +54,40 @@
 #if defined(_POSIX_PRIORITY_SCHEDULING)
 #include <sched.h>
 #endif
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
 
 #define MAX_EPOLL_EVENTS 	(1024)
 #define MAX_SERVERS		(4)
 
+#if defined(HAVE_LIB_PTHREAD) && defined(SO_REUSEPORT) && \
+    defined(MSG_NOSIGNAL) && defined(STRESS_LATENCY)
+#define EPOLL_PERSISTENT	(1)
+#define EPOLL_REQ_SIZE		(64)	/* request/response size */
+#define EPOLL_FD_SPARE		(16)	/* fds kept back from --epoll-conns */
+
+/* a long-lived client connection */
+typedef struct {
+	int fd;				/* socket, -1 once closed */
+	uint32_t got;			/* bytes of response received */
+	uint64_t t_sent;		/* time request was sent (ns) */
+} epoll_conn_t;
+
+/* a SO_REUSEPORT server thread */
+typedef struct {
+	const char *name;
+	pthread_t pthread;
+	int sfd;			/* listening socket */
+	int efd;			/* this thread's epoll instance */
+	uint64_t *counter;		/* bogo ops, server role only */
+} epoll_conn_server_t;
+#endif
+
 static int opt_epoll_domain = AF_UNIX;
 static int opt_epoll_port = DEFAULT_EPOLL_PORT;
+static uint32_t opt_epoll_conns = 0;
+static uint32_t opt_epoll_threads = DEFAULT_EPOLL_THREADS;
 static int max_servers = 1;
 static timer_t epoll_timerid;
 
@@ -107,6 +135,34 @@ int stress_set_epoll_domain(const char *name)
 	return ret;
 }
 
+/*
+ *  stress_set_epoll_conns()
+ *	set the number of persistent client connections
+ */
+void stress_set_epoll_conns(const char *optarg)
+{
+	uint64_t conns;
+
+	conns = get_uint64(optarg);
+	check_range("epoll-conns", conns,
+		MIN_EPOLL_CONNS, MAX_EPOLL_CONNS);
+	opt_epoll_conns = (uint32_t)conns;
+}
+
+/*
+ *  stress_set_epoll_threads()
+ *	set the number of persistent connection server threads
+ */
+void stress_set_epoll_threads(const char *optarg)
+{
+	uint64_t threads;
+
+	threads = get_uint64(optarg);
+	check_range("epoll-threads", threads,
+		MIN_EPOLL_THREADS, MAX_EPOLL_THREADS);
+	opt_epoll_threads = (uint32_t)threads;
+}
+
 /*
  * epoll_timer_handler()
  *	catch timer signal and cancel if no more runs flagged
@@ -337,7 +393,7 @@ retry:
 		}
 
 		stress_set_sockaddr(name, instance, ppid,
-			opt_epoll_domain, port, &addr, &addr_len, NET_ADDR_ANY);
+			opt_epoll_domain, port, &addr, &addr_len, NET_ADDR_PEER);
 
 		errno = 0;
 		ret = connect(fd, addr, addr_len);
@@ -367,7 +423,9 @@ retry:
 			usleep(100000);	/* Twiddle fingers for a moment */
 
 			retries++;
-			if (retries > 1000) {
+			/* A remote server may start later, keep trying */
+			if ((retries > 1000) &&
+			    (stress_net_role() != NET_ROLE_CLIENT)) {
 				/* Sigh, give up.. */
 				errno = saved_errno;
 				pr_fail_dbg(name, "too many connects");
@@ -511,9 +569,13 @@ static void epoll_server(
 					break;
 			} else {
 				/*
-				 *  The fd has data available, so read it
+				 *  The fd has data available, so read it,
+				 *  without a local client count the reads
 				 */
 				epoll_recv_data(events[i].data.fd);
+				if (stress_net_role() == NET_ROLE_SERVER)
+					(void)__atomic_add_fetch(counter, 1,
+						__ATOMIC_RELAXED);
 			}
 		}
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
@@ -535,6 +597,433 @@ die:
 	exit(rc);
 }
 
+#if defined(EPOLL_PERSISTENT)
+/*
+ *  epoll_echo_data()
+ *	echo everything readable on fd back to the sender
+ */
+static void epoll_echo_data(const int fd)
+{
+	while (opt_do_run) {
+		char buf[8192];
+		ssize_t n;
+
+		n = recv(fd, buf, sizeof(buf), 0);
+		if (n == -1) {
+			if (errno != EAGAIN)
+				(void)close(fd);
+			break;
+		} else if (n == 0) {
+			(void)close(fd);
+			break;
+		}
+		/*
+		 *  Requests are small and only one is in flight per
+		 *  connection, so the send buffer never fills up
+		 */
+		if (send(fd, buf, (size_t)n, MSG_NOSIGNAL) < 0) {
+			if (errno != EAGAIN)
+				(void)close(fd);
+			break;
+		}
+	}
+}
+
+/*
+ *  epoll_conn_server_thread()
+ *	serve the connections accepted on this thread's
+ *	own listening socket using its own epoll instance
+ */
+static void *epoll_conn_server_thread(void *arg)
+{
+	epoll_conn_server_t *srv = (epoll_conn_server_t *)arg;
+	static void *nowt = NULL;
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+
+	while (opt_do_run) {
+		int n, i;
+
+		n = epoll_wait(srv->efd, events, MAX_EPOLL_EVENTS, 100);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			pr_fail_err(srv->name, "epoll_wait");
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			const int fd = events[i].data.fd;
+
+			if (fd == srv->sfd) {
+				if (epoll_notification(srv->name,
+						srv->efd, srv->sfd) < 0)
+					return &nowt;
+			} else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+				(void)close(fd);
+			} else if (events[i].events & EPOLLIN) {
+				epoll_echo_data(fd);
+				if (stress_net_role() == NET_ROLE_SERVER)
+					(void)__atomic_add_fetch(srv->counter,
+						1, __ATOMIC_RELAXED);
+			}
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  epoll_conn_server()
+ *	spin up the persistent connection server threads; for
+ *	inet domains each thread binds its own SO_REUSEPORT
+ *	listener to the same port so the kernel shards the
+ *	incoming connections across the threads
+ */
+static void epoll_conn_server(
+	const int child,
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const pid_t ppid)
+{
+	epoll_conn_server_t srvs[MAX_EPOLL_THREADS];
+	const uint32_t threads = (opt_epoll_domain == AF_UNIX) ?
+		1 : opt_epoll_threads;
+	const int port = opt_epoll_port + (max_servers * instance);
+	uint32_t i, started = 0;
+	int rc = EXIT_SUCCESS;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+
+	(void)child;
+	(void)max_ops;
+
+	if (stress_sighandler(name, SIGALRM, handle_socket_sigalrm, NULL) < 0)
+		exit(EXIT_FAILURE);
+
+	memset(srvs, 0, sizeof(srvs));
+	for (i = 0; i < threads; i++) {
+		srvs[i].name = name;
+		srvs[i].counter = counter;
+		srvs[i].sfd = -1;
+		srvs[i].efd = -1;
+	}
+	for (i = 0; i < threads; i++) {
+		epoll_conn_server_t *srv = &srvs[i];
+		int one = 1;
+
+		if ((srv->sfd = socket(opt_epoll_domain, SOCK_STREAM, 0)) < 0) {
+			pr_fail_err(name, "socket");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if (setsockopt(srv->sfd, SOL_SOCKET, SO_REUSEADDR,
+				&one, sizeof(one)) < 0) {
+			pr_fail_err(name, "setsockopt");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if ((opt_epoll_domain != AF_UNIX) &&
+		    (setsockopt(srv->sfd, SOL_SOCKET, SO_REUSEPORT,
+				&one, sizeof(one)) < 0)) {
+			pr_fail_err(name, "setsockopt SO_REUSEPORT");
+			rc = EXIT_FAILURE;
+			break;
+		}
+
+		stress_set_sockaddr(name, instance, ppid,
+			opt_epoll_domain, port, &addr, &addr_len, NET_ADDR_ANY);
+
+		if (bind(srv->sfd, addr, addr_len) < 0) {
+			pr_fail_err(name, "bind");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if (epoll_set_fd_nonblock(srv->sfd) < 0) {
+			pr_fail_err(name, "setting socket to non-blocking");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if (listen(srv->sfd, SOMAXCONN) < 0) {
+			pr_fail_err(name, "listen");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if ((srv->efd = epoll_create1(0)) < 0) {
+			pr_fail_err(name, "epoll_create1");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if (epoll_ctl_add(srv->efd, srv->sfd) < 0) {
+			pr_fail_err(name, "epoll ctl add");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		if (pthread_create(&srv->pthread, NULL,
+				epoll_conn_server_thread, srv) != 0) {
+			pr_fail_err(name, "pthread_create");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		started++;
+	}
+
+	/* On a setup failure don't wait, the client sees no server */
+	if (rc == EXIT_SUCCESS) {
+		for (i = 0; i < started; i++)
+			(void)pthread_join(srvs[i].pthread, NULL);
+	}
+
+	for (i = 0; i < threads; i++) {
+		if (srvs[i].efd >= 0)
+			(void)close(srvs[i].efd);
+		if (srvs[i].sfd >= 0)
+			(void)close(srvs[i].sfd);
+	}
+#ifdef AF_UNIX
+	if (addr && (opt_epoll_domain == AF_UNIX)) {
+		struct sockaddr_un *addr_un = (struct sockaddr_un *)addr;
+		(void)unlink(addr_un->sun_path);
+	}
+#endif
+	exit(rc);
+}
+
+/*
+ *  epoll_conn_request()
+ *	send a request on a persistent connection
+ */
+static int epoll_conn_request(epoll_conn_t *conn, const uint64_t counter)
+{
+	char buf[EPOLL_REQ_SIZE];
+
+	memset(buf, 'A' + (counter % 26), sizeof(buf));
+	conn->got = 0;
+	conn->t_sent = time_now_ns();
+	if (send(conn->fd, buf, sizeof(buf), MSG_NOSIGNAL) != sizeof(buf))
+		return -1;
+	return 0;
+}
+
+/*
+ *  epoll_conn_client()
+ *	hold many long-lived connections open, multiplexed
+ *	with epoll, each doing back to back request/response
+ *	round trips; one bogo op is one round trip
+ */
+static int epoll_conn_client(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const pid_t ppid)
+{
+	const int port = opt_epoll_port + (max_servers * instance);
+	const size_t fd_limit = stress_get_file_limit();
+	const uint32_t threads = (opt_epoll_domain == AF_UNIX) ?
+		1 : opt_epoll_threads;
+	uint32_t i, conns = opt_epoll_conns, active = 0, opened;
+	int efd, rc = EXIT_SUCCESS;
+	epoll_conn_t *conn;
+	struct epoll_event *events;
+	struct sockaddr *addr = NULL;
+	socklen_t addr_len = 0;
+	stress_latency_t lat;
+	double t_start, duration;
+
+	if (fd_limit < EPOLL_FD_SPARE + 1) {
+		pr_inf(stderr, "%s: too few free file descriptors "
+			"for persistent connections\n", name);
+		return EXIT_FAILURE;
+	}
+	if (conns > fd_limit - EPOLL_FD_SPARE) {
+		conns = (uint32_t)(fd_limit - EPOLL_FD_SPARE);
+		pr_inf(stderr, "%s: file descriptor limit allows only "
+			"%" PRIu32 " of the %" PRIu32 " connections\n",
+			name, conns, opt_epoll_conns);
+	}
+
+	if ((conn = calloc(conns, sizeof(*conn))) == NULL) {
+		pr_fail_err(name, "calloc");
+		return EXIT_FAILURE;
+	}
+	if ((events = calloc(MAX_EPOLL_EVENTS,
+				sizeof(struct epoll_event))) == NULL) {
+		pr_fail_err(name, "calloc");
+		free(conn);
+		return EXIT_FAILURE;
+	}
+	if ((efd = epoll_create1(0)) < 0) {
+		pr_fail_err(name, "epoll_create1");
+		free(events);
+		free(conn);
+		return EXIT_FAILURE;
+	}
+
+	stress_set_sockaddr(name, instance, ppid,
+		opt_epoll_domain, port, &addr, &addr_len, NET_ADDR_PEER);
+
+	for (i = 0; i < conns; i++)
+		conn[i].fd = -1;
+
+	/*
+	 *  Open all the connections up front, the server
+	 *  may take a moment to start listening
+	 */
+	for (i = 0; opt_do_run && (i < conns); i++) {
+		struct epoll_event event;
+		int retries = 0;
+
+retry:
+		if ((conn[i].fd = socket(opt_epoll_domain, SOCK_STREAM, 0)) < 0) {
+			if ((errno == EMFILE) || (errno == ENFILE))
+				break;
+			pr_fail_dbg(name, "socket");
+			rc = EXIT_FAILURE;
+			goto tidy;
+		}
+		if (connect(conn[i].fd, addr, addr_len) < 0) {
+			const int saved_errno = errno;
+
+			(void)close(conn[i].fd);
+			conn[i].fd = -1;
+			if ((saved_errno == EADDRNOTAVAIL) && i)
+				break;
+			if (!opt_do_run)
+				break;
+			if ((++retries > 1000) &&
+			    (stress_net_role() != NET_ROLE_CLIENT)) {
+				errno = saved_errno;
+				pr_fail_dbg(name, "too many connects");
+				rc = EXIT_FAILURE;
+				goto tidy;
+			}
+			usleep(10000);
+			goto retry;
+		}
+		if (epoll_set_fd_nonblock(conn[i].fd) < 0) {
+			pr_fail_err(name, "setting socket to non-blocking");
+			rc = EXIT_FAILURE;
+			goto tidy;
+		}
+		memset(&event, 0, sizeof(event));
+		event.data.u32 = i;
+		event.events = EPOLLIN;
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, conn[i].fd, &event) < 0) {
+			pr_fail_err(name, "epoll ctl add");
+			rc = EXIT_FAILURE;
+			goto tidy;
+		}
+		active++;
+	}
+	if (active < conns)
+		pr_inf(stderr, "%s: only managed to open %" PRIu32
+			" of the %" PRIu32 " connections\n",
+			name, active, conns);
+	if (instance == 0)
+		pr_dbg(stderr, "%s: %" PRIu32 " persistent connections "
+			"over %" PRIu32 " server thread%s\n",
+			name, active, threads, threads == 1 ? "" : "s");
+
+	opened = active;
+	memset(&lat, 0, sizeof(lat));
+	t_start = time_now();
+	for (i = 0; i < active; i++) {
+		if (epoll_conn_request(&conn[i], *counter) < 0) {
+			pr_fail_err(name, "send");
+			rc = EXIT_FAILURE;
+			goto tidy;
+		}
+	}
+
+	while (active && opt_do_run && (!max_ops || *counter < max_ops)) {
+		int n, j;
+
+		n = epoll_wait(efd, events, MAX_EPOLL_EVENTS, 100);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			pr_fail_err(name, "epoll_wait");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		for (j = 0; j < n; j++) {
+			epoll_conn_t *c = &conn[events[j].data.u32];
+			char buf[EPOLL_REQ_SIZE];
+			ssize_t ret;
+
+			if (c->fd < 0)
+				continue;
+			ret = recv(c->fd, buf, sizeof(buf) - c->got, 0);
+			if (ret < 0) {
+				if (errno == EAGAIN)
+					continue;
+			}
+			if (ret <= 0) {
+				/* server went away or connection reset */
+				(void)close(c->fd);
+				c->fd = -1;
+				active--;
+				continue;
+			}
+			c->got += (uint32_t)ret;
+			if (c->got < EPOLL_REQ_SIZE)
+				continue;
+
+			latency_record(&lat, time_now_ns() - c->t_sent);
+			(*counter)++;
+			if (epoll_conn_request(c, *counter) < 0) {
+				(void)close(c->fd);
+				c->fd = -1;
+				active--;
+			}
+		}
+	}
+	duration = time_now() - t_start;
+
+	if (!active && opt_do_run && (!max_ops || *counter < max_ops)) {
+		pr_fail(stderr, "%s: all persistent connections "
+			"were closed by the server\n", name);
+		rc = EXIT_FAILURE;
+	}
+	if ((duration > 0.0) && lat.count) {
+		stress_misc_metric_set(0, "requests per second",
+			(double)lat.count / duration);
+		stress_misc_metric_set(1, "p50 latency (usec)",
+			(double)latency_percentile(&lat, 0.50) / 1000.0);
+		stress_misc_metric_set(2, "p99 latency (usec)",
+			(double)latency_percentile(&lat, 0.99) / 1000.0);
+		stress_misc_metric_set(3, "connections", (double)opened);
+		stress_misc_metric_set(4, "server threads", (double)threads);
+	}
+tidy:
+	for (i = 0; i < conns; i++) {
+		if (conn[i].fd >= 0)
+			(void)close(conn[i].fd);
+	}
+	(void)close(efd);
+	free(events);
+	free(conn);
+#ifdef AF_UNIX
+	if (addr && (opt_epoll_domain == AF_UNIX)) {
+		struct sockaddr_un *addr_un = (struct sockaddr_un *)addr;
+		(void)unlink(addr_un->sun_path);
+	}
+#endif
+	return rc;
+}
+#endif
+
+/*
+ *  epoll_server_wait()
+ *	server role has no local client, just let the
+ *	servers handle remote clients until the run ends
+ */
+static void epoll_server_wait(void)
+{
+	while (opt_do_run)
+		(void)sleep(1);
+}
+
 /*
  *  stress_epoll
  *	stress by heavy socket I/O
@@ -546,8 +1035,43 @@ int stress_epoll(
 	const char *name)
 {
 	pid_t pids[MAX_SERVERS], ppid = getppid();
+	const int role = stress_net_role();
 	int i, rc = EXIT_SUCCESS;
 
+	if (opt_epoll_conns) {
+#if defined(EPOLL_PERSISTENT)
+		int status;
+
+		pr_dbg(stderr, "%s: process [%d] using socket port %d\n",
+			name, getpid(),
+			opt_epoll_port + (max_servers * instance));
+
+		if (role == NET_ROLE_CLIENT)
+			return epoll_conn_client(counter, instance,
+					max_ops, name, ppid);
+
+		pids[0] = epoll_spawn(epoll_conn_server, 0,
+				counter, instance, max_ops, name, ppid);
+		if (pids[0] < 0) {
+			pr_fail_dbg(name, "fork");
+			return EXIT_FAILURE;
+		}
+		if (role == NET_ROLE_SERVER)
+			epoll_server_wait();
+		else
+			rc = epoll_conn_client(counter, instance,
+					max_ops, name, ppid);
+		(void)kill(pids[0], SIGKILL);
+		if (waitpid(pids[0], &status, 0) < 0)
+			pr_fail_dbg(name, "waitpid");
+		return rc;
+#else
+		if (instance == 0)
+			pr_inf(stderr, "%s: persistent connections are not "
+				"supported, ignoring --epoll-conns\n", name);
+#endif
+	}
+
 	if (max_servers == 1) {
 		pr_dbg(stderr, "%s: process [%d] using socket port %d\n",
 			name, getpid(),
@@ -573,6 +1097,9 @@ int stress_epoll(
 	 *  Typically, we are limited to ~500 connections per second
 	 *  on a default Linux configuration.
 	 */
+	if (role == NET_ROLE_CLIENT)
+		return epoll_client(counter, instance, max_ops, name, ppid);
+
 	memset(pids, 0, sizeof(pids));
 	for (i = 0; i < max_servers; i++) {
 		pids[i] = epoll_spawn(epoll_server, i,
@@ -583,7 +1110,10 @@ int stress_epoll(
 		}
 	}
 
-	epoll_client(counter, instance, max_ops, name, ppid);
+	if (role == NET_ROLE_SERVER)
+		epoll_server_wait();
+	else
+		epoll_client(counter, instance, max_ops, name, ppid);
 reap:
 	for (i = 0; i < max_servers; i++) {
 		int status;
@@ -27,7 +27,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -35,8 +39,52 @@
 
 #if defined(STRESS_EXEC)
 
+#define EXEC_TARGETS_MAX	(16)	/* max --exec-targets */
+#define EXEC_TARGET_ARGS_MAX	(16)	/* max arguments of a target */
+#define EXEC_TARGET_RUNS	(16)	/* execs of a target per variant per round */
+
+/* how a target is exec'd */
+enum {
+	EXEC_VARIANT_DEFAULT = 0,	/* as is, lazy binding */
+	EXEC_VARIANT_BIND_NOW,		/* LD_BIND_NOW=1, resolve all at load */
+	EXEC_VARIANT_NO_CACHE,		/* ld.so --inhibit-cache, no ld.so.cache */
+	EXEC_VARIANTS,
+};
+
+static const char *exec_variant_names[EXEC_VARIANTS] = {
+	"default", "bind-now", "no-cache"
+};
+
+#if UINTPTR_MAX == MAX_32
+#define EXEC_ELFCLASS	ELFCLASS32
+typedef Elf32_Ehdr exec_ehdr_t;
+typedef Elf32_Phdr exec_phdr_t;
+typedef Elf32_Dyn exec_dyn_t;
+#else
+#define EXEC_ELFCLASS	ELFCLASS64
+typedef Elf64_Ehdr exec_ehdr_t;
+typedef Elf64_Phdr exec_phdr_t;
+typedef Elf64_Dyn exec_dyn_t;
+#endif
+
+/* an exec target and its latencies */
+typedef struct {
+	char *cmd;				/* copy of the command line */
+	char *argv[EXEC_TARGET_ARGS_MAX + 1];	/* command line split */
+	bool self;				/* stress-ng, reports main() */
+	const char *type;			/* static, pie, dynamic.. */
+	char interp[PATH_MAX];			/* ELF interpreter, "" if none */
+	int needed;				/* DT_NEEDED libraries */
+	bool usable[EXEC_VARIANTS];		/* variant can be run */
+	uint64_t fails[EXEC_VARIANTS];		/* execs that failed */
+	stress_latency_t exited[EXEC_VARIANTS];	/* fork to reaped */
+	stress_latency_t main[EXEC_VARIANTS];	/* fork to main(), self only */
+} exec_target_t;
+
 static uint64_t opt_exec_max = DEFAULT_EXECS;
 static bool set_exec_max = false;
+static char *opt_exec_targets[EXEC_TARGETS_MAX];
+static size_t opt_exec_ntargets;
 
 /*
  *  stress_set_exec_max()
@@ -50,6 +98,300 @@ void stress_set_exec_max(const char *optarg)
 		MIN_EXECS, MAX_EXECS);
 }
 
+/*
+ *  stress_set_exec_targets()
+ *	set the colon separated commands to compare the exec
+ *	cost of, each an absolute path with optional space
+ *	separated arguments, or self for stress-ng itself
+ */
+int stress_set_exec_targets(const char *optarg)
+{
+	char *str, *cmd, *ptr;
+
+	str = strdup(optarg);
+	if (!str) {
+		fprintf(stderr, "exec-targets: out of memory\n");
+		return -1;
+	}
+	for (ptr = str; (cmd = strsep(&ptr, ":")) != NULL; ) {
+		char path[PATH_MAX];
+
+		cmd += strspn(cmd, " ");
+		if (!*cmd)
+			continue;
+		if (opt_exec_ntargets >= EXEC_TARGETS_MAX) {
+			fprintf(stderr, "exec-targets: more than %d targets\n",
+				EXEC_TARGETS_MAX);
+			return -1;
+		}
+		(void)snprintf(path, sizeof(path), "%.*s",
+			(int)strcspn(cmd, " "), cmd);
+		if (strcmp(path, "self") &&
+		    ((*path != '/') || (access(path, X_OK) < 0))) {
+			fprintf(stderr, "exec-targets: '%s' must be self or "
+				"the absolute path of an executable\n", path);
+			return -1;
+		}
+		opt_exec_targets[opt_exec_ntargets++] = cmd;
+	}
+	if (!opt_exec_ntargets) {
+		fprintf(stderr, "exec-targets: no targets given\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_exec_classify()
+ *	read the ELF headers of a target for its type, its
+ *	interpreter and the number of libraries it needs
+ */
+static void stress_exec_classify(exec_target_t *t)
+{
+	exec_ehdr_t ehdr;
+	char magic[2];
+	int fd, i;
+
+	t->type = "unknown";
+	fd = open(t->argv[0], O_RDONLY);
+	if (fd < 0)
+		return;
+	if (pread(fd, &ehdr, sizeof(ehdr), 0) != sizeof(ehdr) ||
+	    memcmp(ehdr.e_ident, ELFMAG, SELFMAG)) {
+		if ((pread(fd, magic, sizeof(magic), 0) == sizeof(magic)) &&
+		    (magic[0] == '#') && (magic[1] == '!'))
+			t->type = "script";
+		(void)close(fd);
+		return;
+	}
+	if (ehdr.e_ident[EI_CLASS] != EXEC_ELFCLASS) {
+		(void)close(fd);
+		return;
+	}
+
+	for (i = 0; i < ehdr.e_phnum; i++) {
+		exec_phdr_t phdr;
+		const off_t off = (off_t)ehdr.e_phoff + (off_t)i * ehdr.e_phentsize;
+
+		if (pread(fd, &phdr, sizeof(phdr), off) != sizeof(phdr))
+			break;
+		if (phdr.p_type == PT_INTERP) {
+			const size_t n = STRESS_MINIMUM(phdr.p_filesz,
+				sizeof(t->interp) - 1);
+			const ssize_t ret = pread(fd, t->interp, n, (off_t)phdr.p_offset);
+
+			t->interp[(ret > 0) ? (size_t)ret : 0] = '\0';
+		} else if (phdr.p_type == PT_DYNAMIC) {
+			exec_dyn_t dyn;
+			size_t j;
+
+			for (j = 0; j < phdr.p_filesz / sizeof(dyn); j++) {
+				if ((pread(fd, &dyn, sizeof(dyn), (off_t)(phdr.p_offset +
+				     j * sizeof(dyn))) != sizeof(dyn)) ||
+				    (dyn.d_tag == DT_NULL))
+					break;
+				if (dyn.d_tag == DT_NEEDED)
+					t->needed++;
+			}
+		}
+	}
+	(void)close(fd);
+
+	if (*t->interp)
+		t->type = (ehdr.e_type == ET_DYN) ? "pie" : "dynamic";
+	else
+		t->type = (ehdr.e_type == ET_DYN) ? "static-pie" : "static";
+}
+
+/*
+ *  stress_exec_target_run()
+ *	fork and exec a target once with a variant, recording
+ *	the time until it is reaped and, for self, until its
+ *	main() was reached
+ */
+static void stress_exec_target_run(
+	exec_target_t *t,
+	const int variant,
+	const int fd_out,
+	const int fds_main[2])
+{
+	char *env_default[] = { NULL };
+	char *env_bind_now[] = { "LD_BIND_NOW=1", NULL };
+	char *argv[EXEC_TARGET_ARGS_MAX + 3];
+	char **env = env_default;
+	uint64_t t_start, t_mono, t_main;
+	pid_t pid;
+	int status;
+	size_t i = 0, j;
+
+	if (variant == EXEC_VARIANT_NO_CACHE) {
+		argv[i++] = t->interp;
+		argv[i++] = "--inhibit-cache";
+	} else if (variant == EXEC_VARIANT_BIND_NOW) {
+		env = env_bind_now;
+	}
+	for (j = 0; t->argv[j]; j++)
+		argv[i++] = t->argv[j];
+	argv[i] = NULL;
+
+	/* the child's main() stamp can only be compared to CLOCK_MONOTONIC */
+	t_mono = time_mono_ns();
+	t_start = time_now_ns();
+	pid = fork();
+	if (pid < 0)
+		return;
+	if (pid == 0) {
+		(void)setpgid(0, pgrp);
+		(void)dup2(t->self ? fds_main[1] : fd_out, STDOUT_FILENO);
+		(void)dup2(fd_out, STDERR_FILENO);
+		(void)execve(argv[0], argv, env);
+		_exit(EXIT_FAILURE);
+	}
+	(void)setpgid(pid, pgrp);
+	if (waitpid(pid, &status, 0) < 0)
+		return;
+	latency_record(&t->exited[variant], time_now_ns() - t_start);
+	if (!WIFEXITED(status) || (t->self && (WEXITSTATUS(status) != EXIT_SUCCESS)))
+		t->fails[variant]++;
+	if (t->self &&
+	    (read(fds_main[0], &t_main, sizeof(t_main)) == sizeof(t_main)) &&
+	    (t_main >= t_mono))
+		latency_record(&t->main[variant], t_main - t_mono);
+}
+
+/*
+ *  stress_exec_targets()
+ *	compare the exec cost of the --exec-targets, each run as
+ *	is, with LD_BIND_NOW=1 so every symbol is bound at load,
+ *	and for glibc dynamic binaries via ld.so --inhibit-cache
+ *	so the libraries are searched for without ld.so.cache
+ */
+static int stress_exec_targets(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const char *self_path)
+{
+	exec_target_t *targets;
+	int fds[2], fd_out, rc = EXIT_SUCCESS;
+	size_t i;
+
+	targets = calloc(opt_exec_ntargets, sizeof(*targets));
+	if (!targets) {
+		pr_err(stderr, "%s: out of memory\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < opt_exec_ntargets; i++) {
+		exec_target_t *t = &targets[i];
+		char *arg, *saveptr = NULL;
+		size_t n = 0;
+
+		t->cmd = strdup(opt_exec_targets[i]);
+		if (!t->cmd) {
+			pr_err(stderr, "%s: out of memory\n", name);
+			rc = EXIT_NO_RESOURCE;
+			goto free_targets;
+		}
+		for (arg = strtok_r(t->cmd, " ", &saveptr); arg && (n < EXEC_TARGET_ARGS_MAX);
+		     arg = strtok_r(NULL, " ", &saveptr))
+			t->argv[n++] = arg;
+		if (!strcmp(t->argv[0], "self")) {
+			t->self = true;
+			t->argv[0] = (char *)self_path;
+			t->argv[1] = "--exec-exit-ts";
+			t->argv[2] = NULL;
+		}
+		stress_exec_classify(t);
+		t->usable[EXEC_VARIANT_DEFAULT] = true;
+		t->usable[EXEC_VARIANT_BIND_NOW] = (*t->interp != '\0');
+		/* only the glibc loader has --inhibit-cache */
+		t->usable[EXEC_VARIANT_NO_CACHE] = (strstr(t->interp, "ld-linux") != NULL);
+	}
+
+	fd_out = open("/dev/null", O_WRONLY);
+	if (fd_out < 0) {
+		pr_fail_err(name, "open /dev/null");
+		rc = EXIT_FAILURE;
+		goto free_targets;
+	}
+	if (pipe(fds) < 0) {
+		pr_fail_err(name, "pipe");
+		(void)close(fd_out);
+		rc = EXIT_FAILURE;
+		goto free_targets;
+	}
+	/* A failed exec must not leave us blocked on the read */
+	(void)fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+	do {
+		for (i = 0; i < opt_exec_ntargets; i++) {
+			int v, n;
+
+			for (v = 0; v < EXEC_VARIANTS; v++) {
+				if (!targets[i].usable[v])
+					continue;
+				for (n = 0; n < EXEC_TARGET_RUNS; n++) {
+					if (!opt_do_run || (max_ops && *counter >= max_ops))
+						goto done;
+					stress_exec_target_run(&targets[i], v,
+						fd_out, fds);
+					(*counter)++;
+				}
+			}
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	(void)close(fds[0]);
+	(void)close(fds[1]);
+	(void)close(fd_out);
+
+	if (instance == 0)
+		pr_inf(stderr, "%s: %-16s %-10s %6s %-8s %9s %9s %9s %9s %6s\n",
+			name, "target", "type", "needed", "variant", "exit p50",
+			"exit p99", "main p50", "main p99", "fails");
+	for (i = 0; i < opt_exec_ntargets; i++) {
+		const exec_target_t *t = &targets[i];
+		const char *base = strrchr(t->argv[0], '/');
+		int v;
+
+		base = t->self ? "self" : (base ? base + 1 : t->argv[0]);
+		for (v = 0; v < EXEC_VARIANTS; v++) {
+			const double p50 = (double)latency_percentile(&t->exited[v], 0.50) / 1000.0;
+			char main_p50[16], main_p99[16], desc[32];
+			const size_t idx = (i * EXEC_VARIANTS) + (size_t)v;
+
+			if (!t->exited[v].count)
+				continue;
+			if (t->main[v].count) {
+				(void)snprintf(main_p50, sizeof(main_p50), "%.1f",
+					(double)latency_percentile(&t->main[v], 0.50) / 1000.0);
+				(void)snprintf(main_p99, sizeof(main_p99), "%.1f",
+					(double)latency_percentile(&t->main[v], 0.99) / 1000.0);
+			} else {
+				(void)snprintf(main_p50, sizeof(main_p50), "-");
+				(void)snprintf(main_p99, sizeof(main_p99), "-");
+			}
+			if (instance == 0)
+				pr_inf(stderr, "%s: %-16.16s %-10s %6d %-8s %9.1f %9.1f %9s %9s %6" PRIu64 "\n",
+					name, base, t->type, t->needed,
+					exec_variant_names[v], p50,
+					(double)latency_percentile(&t->exited[v], 0.99) / 1000.0,
+					main_p50, main_p99, t->fails[v]);
+			(void)snprintf(desc, sizeof(desc), "%.10s %s p50 usec",
+				base, exec_variant_names[v]);
+			if (idx < STRESS_MISC_METRICS_MAX)
+				stress_misc_metric_set(idx, desc, p50);
+		}
+	}
+
+free_targets:
+	for (i = 0; i < opt_exec_ntargets; i++)
+		free(targets[i].cmd);
+	free(targets);
+	return rc;
+}
+
 /*
  *  stress_exec()
  *	stress by forking and exec'ing
@@ -90,6 +432,9 @@ int stress_exec(
 	path[len] = '\0';
 	argv_new[0] = path;
 
+	if (opt_exec_ntargets)
+		return stress_exec_targets(counter, instance, max_ops, name, path);
+
 	do {
 		unsigned int i;
 
@@ -33,13 +33,26 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#if defined(__linux__) && defined(FS_IOC_FIEMAP)
+#include <linux/fiemap.h>
+#define FALLOCATE_HAVE_FIEMAP
+#endif
+
+#define FALLOCATE_MATRIX_SPAN	(64 * MB)	/* default matrix file size */
+#define FALLOCATE_MATRIX_IO	(1 * MB)	/* fill and read chunk size */
 
 static off_t opt_fallocate_bytes = DEFAULT_FALLOCATE_BYTES;
 static bool set_fallocate_bytes = false;
+static bool opt_fallocate_matrix = false;
+static off_t opt_fallocate_gran = DEFAULT_FALLOCATE_GRAN;
 
 void stress_set_fallocate_bytes(const char *optarg)
 {
@@ -49,6 +62,22 @@ void stress_set_fallocate_bytes(const char *optarg)
 		MIN_FALLOCATE_BYTES, MAX_FALLOCATE_BYTES);
 }
 
+void stress_set_fallocate_matrix(void)
+{
+	opt_fallocate_matrix = true;
+}
+
+void stress_set_fallocate_gran(const char *optarg)
+{
+	opt_fallocate_gran = (off_t)get_uint64_byte(optarg);
+	check_range("fallocate-gran", opt_fallocate_gran,
+		MIN_FALLOCATE_GRAN, MAX_FALLOCATE_GRAN);
+	if (opt_fallocate_gran & (opt_fallocate_gran - 1)) {
+		fprintf(stderr, "fallocate-gran must be a power of 2\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
 #if defined(__linux__)
 static const int modes[] = {
 	0,
@@ -68,6 +97,316 @@ static const int modes[] = {
 	FALLOC_FL_INSERT_RANGE,
 #endif
 };
+
+typedef struct {
+	const char *name;	/* matrix mode name */
+	int mode;		/* fallocate() mode */
+} fallocate_matrix_mode_t;
+
+/*
+ *  Modes that reshape an already written file, each cell keeps
+ *  the file size constant and fully written so the sequential
+ *  read rates of the cells can be compared with each other
+ */
+static const fallocate_matrix_mode_t matrix_modes[] = {
+#if defined(FALLOC_FL_KEEP_SIZE) && defined(FALLOC_FL_PUNCH_HOLE)
+	{ "punch",	FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE },
+#endif
+#if defined(FALLOC_FL_ZERO_RANGE)
+	{ "zero",	FALLOC_FL_ZERO_RANGE },
+#endif
+#if defined(FALLOC_FL_COLLAPSE_RANGE)
+	{ "collapse",	FALLOC_FL_COLLAPSE_RANGE },
+#endif
+#if defined(FALLOC_FL_INSERT_RANGE)
+	{ "insert",	FALLOC_FL_INSERT_RANGE },
+#endif
+};
+
+typedef struct {
+	bool supported;		/* false if the filesystem said no */
+	bool valid;		/* true once a cell has completed */
+	double ops_rate;	/* fallocate + refill ops per second */
+	uint64_t extents[2];	/* extents before and after */
+	double read_rate[2];	/* read bytes per sec before and after */
+} fallocate_matrix_cell_t;
+
+#define MATRIX_MODES	(SIZEOF_ARRAY(matrix_modes))
+
+/*
+ *  stress_fallocate_extents()
+ *	number of extents mapped by the file, 0 if FIEMAP
+ *	is not available
+ */
+static uint64_t stress_fallocate_extents(const int fd)
+{
+#if defined(FALLOCATE_HAVE_FIEMAP)
+	struct fiemap fm;
+
+	/* A zero extent count just returns the number of extents */
+	(void)memset(&fm, 0, sizeof(fm));
+	fm.fm_start = 0;
+	fm.fm_length = ~0ULL;
+	fm.fm_flags = FIEMAP_FLAG_SYNC;
+	fm.fm_extent_count = 0;
+	if (ioctl(fd, FS_IOC_FIEMAP, &fm) < 0)
+		return 0;
+	return (uint64_t)fm.fm_mapped_extents;
+#else
+	(void)fd;
+	return 0;
+#endif
+}
+
+/*
+ *  stress_fallocate_read_rate()
+ *	sequential read rate of the first len bytes of the file
+ *	with the page cache for the file dropped beforehand,
+ *	returns < 0.0 on a read failure
+ */
+static double stress_fallocate_read_rate(
+	const int fd,
+	char *buf,
+	const off_t len)
+{
+	off_t off;
+	double t;
+
+	(void)fsync(fd);
+#if defined(POSIX_FADV_DONTNEED) && !defined(__gnu_hurd__)
+	(void)posix_fadvise(fd, 0, len, POSIX_FADV_DONTNEED);
+#endif
+	t = time_now();
+	for (off = 0; off < len; off += FALLOCATE_MATRIX_IO) {
+		if (pread(fd, buf, FALLOCATE_MATRIX_IO, off) < 0)
+			return -1.0;
+	}
+	t = time_now() - t;
+
+	return (t > 0.0) ? (double)len / t : 0.0;
+}
+
+/*
+ *  stress_fallocate_fill()
+ *	write len bytes of data at offset off
+ */
+static int stress_fallocate_fill(
+	const int fd,
+	const char *buf,
+	off_t off,
+	off_t len)
+{
+	while (len > 0) {
+		const size_t n = (len > (off_t)FALLOCATE_MATRIX_IO) ?
+			FALLOCATE_MATRIX_IO : (size_t)len;
+		ssize_t ret;
+
+		ret = pwrite(fd, buf, n, off);
+		if (ret <= 0)
+			return -1;
+		off += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/*
+ *  stress_fallocate_cell()
+ *	write the file, then reshape a quarter of its granules
+ *	with the given fallocate() mode, rewriting the data each
+ *	operation removed as a thin provisioned image sees when
+ *	a guest trims and later reuses blocks. Returns 0 if done,
+ *	1 if the mode is not supported, -1 on an I/O error
+ */
+static int stress_fallocate_cell(
+	const int fd,
+	char *buf,
+	const off_t span,
+	const fallocate_matrix_mode_t *m,
+	fallocate_matrix_cell_t *cell,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const off_t gran = opt_fallocate_gran;
+	const uint64_t granules = (uint64_t)(span / gran);
+	uint64_t i, ops = 0;
+	double t;
+
+	if ((ftruncate(fd, 0) < 0) ||
+	    (stress_fallocate_fill(fd, buf, 0, span) < 0))
+		return -1;
+	(void)fsync(fd);
+	cell->extents[0] = stress_fallocate_extents(fd);
+	cell->read_rate[0] = stress_fallocate_read_rate(fd, buf, span);
+	if (cell->read_rate[0] < 0.0)
+		return -1;
+
+	t = time_now();
+	for (i = 0; i < granules / 4; i++) {
+		/* Never the last granule, collapse must end before EOF */
+		const off_t off = (off_t)(mwc64() % (granules - 1)) * gran;
+		int ret;
+
+		if (!opt_do_run || (max_ops && *counter >= max_ops))
+			return 0;
+		if (fallocate(fd, m->mode, off, gran) < 0) {
+			if ((errno == EOPNOTSUPP) || (errno == EINVAL) ||
+			    (errno == ENOSYS)) {
+				cell->supported = false;
+				return 1;
+			}
+			if (errno == ENOSPC)
+				break;
+			return -1;
+		}
+		switch (m->mode) {
+#if defined(FALLOC_FL_COLLAPSE_RANGE)
+		case FALLOC_FL_COLLAPSE_RANGE:
+			/* Data shifted down, append to restore the size */
+			ret = stress_fallocate_fill(fd, buf, span - gran, gran);
+			break;
+#endif
+#if defined(FALLOC_FL_INSERT_RANGE)
+		case FALLOC_FL_INSERT_RANGE:
+			/* Fill the inserted hole and drop the shifted tail */
+			ret = stress_fallocate_fill(fd, buf, off, gran);
+			if ((ret == 0) && (ftruncate(fd, span) < 0))
+				ret = -1;
+			break;
+#endif
+		default:
+			ret = stress_fallocate_fill(fd, buf, off, gran);
+			break;
+		}
+		if (ret < 0)
+			return -1;
+		ops++;
+		(*counter)++;
+	}
+	(void)fsync(fd);
+	t = time_now() - t;
+
+	cell->ops_rate = (t > 0.0) ? (double)ops / t : 0.0;
+	cell->extents[1] = stress_fallocate_extents(fd);
+	cell->read_rate[1] = stress_fallocate_read_rate(fd, buf, span);
+	if (cell->read_rate[1] < 0.0)
+		return -1;
+	cell->valid = true;
+
+	return 0;
+}
+
+/*
+ *  stress_fallocate_matrix()
+ *	run each reshaping fallocate() mode at the chosen granularity
+ *	and report how the extent count and the sequential read rate
+ *	degrade, the first instance reports the first complete pass
+ */
+static int stress_fallocate_matrix(
+	const char *name,
+	const uint32_t instance,
+	const int fd,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	fallocate_matrix_cell_t cells[MATRIX_MODES];
+	const off_t span = (set_fallocate_bytes ?
+		opt_fallocate_bytes : (off_t)FALLOCATE_MATRIX_SPAN) &
+		~(opt_fallocate_gran - 1);
+	bool reported = false;
+	size_t i;
+	char *buf;
+	int rc = EXIT_SUCCESS;
+
+	if (MATRIX_MODES == 0) {
+		pr_inf(stderr, "%s: no fallocate() reshaping modes "
+			"available, skipping stressor\n", name);
+		return EXIT_SUCCESS;
+	}
+	if (span < opt_fallocate_gran * 8) {
+		pr_inf(stderr, "%s: fallocate-bytes must be at least 8 "
+			"times fallocate-gran, skipping stressor\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	buf = malloc(FALLOCATE_MATRIX_IO);
+	if (!buf) {
+		pr_err(stderr, "%s: cannot allocate I/O buffer\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < FALLOCATE_MATRIX_IO; i++)
+		buf[i] = (char)mwc8();
+	(void)memset(cells, 0, sizeof(cells));
+	for (i = 0; i < MATRIX_MODES; i++)
+		cells[i].supported = true;
+
+	do {
+		for (i = 0; i < MATRIX_MODES; i++) {
+			fallocate_matrix_cell_t cell = cells[i];
+			int ret;
+
+			if (!cells[i].supported)
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			ret = stress_fallocate_cell(fd, buf, span,
+				&matrix_modes[i], &cell, counter, max_ops);
+			if (ret < 0) {
+				pr_fail_err(name, matrix_modes[i].name);
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			/* Only keep cells that ran to completion */
+			if ((ret == 1) || cell.valid)
+				cells[i] = cell;
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %lldK granules over a %lldM file\n",
+				name, (long long)(opt_fallocate_gran / KB),
+				(long long)(span / MB));
+			pr_inf(stderr, "%s: %8s %9s %15s %19s\n", name, "mode",
+				"ops/sec", "extents", "seq read MB/s");
+			for (i = 0; i < MATRIX_MODES; i++) {
+				const fallocate_matrix_cell_t *cell = &cells[i];
+
+				if (!cell->valid) {
+					pr_inf(stderr, "%s: %8s %9s\n", name,
+						matrix_modes[i].name,
+						cell->supported ? "-" : "n/a");
+					continue;
+				}
+				pr_inf(stderr, "%s: %8s %9.0f %6" PRIu64
+					" -> %6" PRIu64 " %8.1f -> %8.1f\n",
+					name, matrix_modes[i].name, cell->ops_rate,
+					cell->extents[0], cell->extents[1],
+					cell->read_rate[0] / (double)MB,
+					cell->read_rate[1] / (double)MB);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (i = 0; i < MATRIX_MODES; i++) {
+		const fallocate_matrix_cell_t *cell = &cells[i];
+		char desc[48];
+
+		if (!cell->valid)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s extents after",
+			matrix_modes[i].name);
+		stress_misc_metric_set(i * 2, desc, (double)cell->extents[1]);
+		(void)snprintf(desc, sizeof(desc), "%s seq read MB/sec",
+			matrix_modes[i].name);
+		stress_misc_metric_set((i * 2) + 1, desc,
+			cell->read_rate[1] / (double)MB);
+		if (i == 0)
+			stress_misc_metric_set(MATRIX_MODES * 2,
+				"unfragmented seq read MB/sec",
+				cell->read_rate[0] / (double)MB);
+	}
+	free(buf);
+
+	return rc;
+}
 #endif
 
 /*
@@ -84,6 +423,7 @@ int stress_fallocate(
 	int fd, ret;
 	char filename[PATH_MAX];
 	uint64_t ftrunc_errs = 0;
+	stress_io_stats_t iostats;
 
 	if (!set_fallocate_bytes) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -95,6 +435,7 @@ int stress_fallocate(
 	ret = stress_temp_dir_mk(name, pid, instance);
 	if (ret < 0)
 		return exit_status(-ret);
+	io_stats_begin(&iostats);
 
 	(void)stress_temp_filename(filename, sizeof(filename),
 		name, pid, instance, mwc32());
@@ -107,6 +448,21 @@ int stress_fallocate(
 	}
 	(void)unlink(filename);
 
+#if defined(__linux__)
+	if (opt_fallocate_matrix) {
+		ret = stress_fallocate_matrix(name, instance, fd,
+			counter, max_ops);
+		(void)close(fd);
+		io_stats_end(&iostats, *counter);
+		(void)stress_temp_dir_rm(name, pid, instance);
+		return ret;
+	}
+#else
+	if (opt_fallocate_matrix && (instance == 0))
+		pr_inf(stderr, "%s: fallocate-matrix needs Linux fallocate() "
+			"modes, using the default mode\n", name);
+#endif
+
 	do {
 		(void)posix_fallocate(fd, (off_t)0, opt_fallocate_bytes);
 		if (!opt_do_run)
@@ -181,6 +537,7 @@ int stress_fallocate(
 		pr_dbg(stderr, "%s: %" PRIu64
 			" ftruncate errors occurred.\n", name, ftrunc_errs);
 	(void)close(fd);
+	io_stats_end(&iostats, *counter);
 	(void)stress_temp_dir_rm(name, pid, instance);
 
 	return EXIT_SUCCESS;
@@ -27,17 +27,418 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <setjmp.h>
+#include <unistd.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 
 #include "stress-ng.h"
 
+#define FAULT_CLASS_BYTES	(16 * MB)	/* region faulted per pass */
+#define FAULT_MAJOR_BYTES	(4 * MB)	/* file faulted per major pass */
+#define FAULT_THP_SIZE		(2 * MB)	/* transparent huge page size */
+#define FAULT_CLASS_TIME	(0.5)		/* seconds per class */
+
+#define FAULT_CLASS_MINOR	(0)	/* anonymous write fault */
+#define FAULT_CLASS_MAJOR	(1)	/* file read fault, page cache dropped */
+#define FAULT_CLASS_COW		(2)	/* write to a page shared after fork */
+#define FAULT_CLASS_THP		(3)	/* anonymous huge page write fault */
+#define FAULT_CLASS_ZERO	(4)	/* anonymous read, maps the zero page */
+#define FAULT_CLASS_MAX		(5)
+#define FAULT_CLASS_ALL		(FAULT_CLASS_MAX)
+#define FAULT_CLASS_NONE	(-1)
+
+typedef struct {
+	const char *name;	/* User option */
+	int class;		/* FAULT_CLASS_ value */
+} fault_class_t;
+
+static const fault_class_t fault_classes[] = {
+	{ "minor",	FAULT_CLASS_MINOR },
+	{ "major",	FAULT_CLASS_MAJOR },
+	{ "cow",	FAULT_CLASS_COW },
+	{ "thp",	FAULT_CLASS_THP },
+	{ "zero",	FAULT_CLASS_ZERO },
+	{ "all",	FAULT_CLASS_ALL },
+};
+
+/* Results of one pass over a region */
+typedef struct {
+	uint64_t touches;	/* pages touched */
+	uint64_t minflt;	/* minor faults counted */
+	uint64_t majflt;	/* major faults counted */
+	double secs;		/* time spent touching */
+} fault_pass_t;
+
+static int opt_fault_class = FAULT_CLASS_NONE;
+
+/*
+ *  stress_set_fault_class()
+ *	set the page fault class to measure
+ */
+int stress_set_fault_class(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(fault_classes); i++) {
+		if (!strcmp(name, fault_classes[i].name)) {
+			opt_fault_class = fault_classes[i].class;
+			return 0;
+		}
+	}
+	fprintf(stderr, "fault-class must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(fault_classes); i++)
+		fprintf(stderr, " %s", fault_classes[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  fault_counters_open()
+ *	open the minor and major page fault perf counters of this
+ *	process, -1 fds if perf is not available
+ */
+static void fault_counters_open(int *fd_min, int *fd_maj)
+{
+#if defined(STRESS_PERF_STATS)
+	*fd_min = perf_open_by_id(STRESS_PERF_SW_PAGE_FAULTS_MIN);
+	*fd_maj = perf_open_by_id(STRESS_PERF_SW_PAGE_FAULTS_MAJ);
+#else
+	*fd_min = -1;
+	*fd_maj = -1;
+#endif
+}
+
+/*
+ *  fault_counters_read()
+ *	read the page fault counts, falling back to
+ *	getrusage() if the perf counters are not open
+ */
+static void fault_counters_read(
+	const int fd_min,
+	const int fd_maj,
+	uint64_t *minflt,
+	uint64_t *majflt)
+{
+	struct rusage usage;
+
+#if defined(STRESS_PERF_STATS)
+	if ((fd_min >= 0) && (fd_maj >= 0) &&
+	    (perf_read_by_fd(fd_min, minflt) == 0) &&
+	    (perf_read_by_fd(fd_maj, majflt) == 0))
+		return;
+#else
+	(void)fd_min;
+	(void)fd_maj;
+#endif
+	*minflt = 0;
+	*majflt = 0;
+	if (!getrusage(RUSAGE_SELF, &usage)) {
+		*minflt = (uint64_t)usage.ru_minflt;
+		*majflt = (uint64_t)usage.ru_majflt;
+	}
+}
+
+static void fault_counters_close(const int fd_min, const int fd_maj)
+{
+	if (fd_min >= 0)
+		(void)close(fd_min);
+	if (fd_maj >= 0)
+		(void)close(fd_maj);
+}
+
+/*
+ *  fault_touch()
+ *	touch every stride bytes of a region, by writing or
+ *	reading, counting and timing the faults taken
+ */
+static void fault_touch(
+	uint8_t *ptr,
+	const size_t len,
+	const size_t stride,
+	const bool write,
+	const int fd_min,
+	const int fd_maj,
+	fault_pass_t *pass)
+{
+	uint64_t min_start, maj_start, min_end, maj_end;
+	uint8_t sum = 0;
+	size_t i;
+	double t;
+
+	fault_counters_read(fd_min, fd_maj, &min_start, &maj_start);
+	t = time_now();
+	if (write) {
+		for (i = 0; i < len; i += stride)
+			*(volatile uint8_t *)(ptr + i) = (uint8_t)i;
+	} else {
+		for (i = 0; i < len; i += stride)
+			sum += *(volatile uint8_t *)(ptr + i);
+	}
+	pass->secs = time_now() - t;
+	fault_counters_read(fd_min, fd_maj, &min_end, &maj_end);
+
+	(void)sum;
+	pass->touches = len / stride;
+	pass->minflt = min_end - min_start;
+	pass->majflt = maj_end - maj_start;
+}
+
+/*
+ *  fault_anon_map()
+ *	map an anonymous region aligned to align bytes,
+ *	returns NULL on failure
+ */
+static uint8_t *fault_anon_map(const size_t len, const size_t align)
+{
+	uint8_t *ptr, *aligned;
+
+	ptr = mmap(NULL, len + align, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+	aligned = (uint8_t *)(((uintptr_t)ptr + align - 1) & ~((uintptr_t)align - 1));
+	if (aligned > ptr)
+		(void)munmap(ptr, (size_t)(aligned - ptr));
+	if (aligned + len < ptr + len + align)
+		(void)munmap(aligned + len, (size_t)((ptr + len + align) - (aligned + len)));
+	return aligned;
+}
+
+/*
+ *  fault_class_pass()
+ *	set up a fresh region for a fault class and take
+ *	one fault per page, or huge page, of it
+ */
+static int fault_class_pass(
+	const char *name,
+	const int class,
+	const char *filename,
+	const size_t page_size,
+	const int fd_min,
+	const int fd_maj,
+	volatile fault_pass_t *cow_pass,
+	fault_pass_t *pass)
+{
+	const size_t len = FAULT_CLASS_BYTES;
+	uint8_t *ptr;
+
+	memset(pass, 0, sizeof(*pass));
+
+	switch (class) {
+	case FAULT_CLASS_MAJOR: {
+		const size_t flen = FAULT_MAJOR_BYTES;
+		int fd;
+
+		fd = open(filename, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+		if (fd < 0) {
+			pr_err(stderr, "%s: open failed: errno=%d (%s)\n",
+				name, errno, strerror(errno));
+			return -1;
+		}
+		if (ftruncate(fd, (off_t)flen) < 0) {
+			pr_err(stderr, "%s: ftruncate failed: errno=%d (%s)\n",
+				name, errno, strerror(errno));
+			(void)close(fd);
+			return -1;
+		}
+		ptr = mmap(NULL, flen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (ptr == MAP_FAILED) {
+			(void)close(fd);
+			return -1;
+		}
+		/* Dirty, write back and drop the pages from the page cache */
+		(void)memset(ptr, 0xaa, flen);
+		(void)msync(ptr, flen, MS_SYNC);
+		(void)munmap(ptr, flen);
+		(void)fsync(fd);
+#if defined(POSIX_FADV_DONTNEED) && !defined(__gnu_hurd__)
+		(void)posix_fadvise(fd, 0, (off_t)flen, POSIX_FADV_DONTNEED);
+#endif
+		ptr = mmap(NULL, flen, PROT_READ, MAP_SHARED, fd, 0);
+		(void)close(fd);
+		if (ptr == MAP_FAILED)
+			return -1;
+		/* Stop read-around turning one fault into many pages */
+		(void)madvise(ptr, flen, MADV_RANDOM);
+		fault_touch(ptr, flen, page_size, false, fd_min, fd_maj, pass);
+		(void)munmap(ptr, flen);
+		(void)unlink(filename);
+		return 0;
+	}
+	case FAULT_CLASS_COW: {
+		pid_t pid;
+		int status;
+
+		ptr = fault_anon_map(len, page_size);
+		if (!ptr)
+			return -1;
+#if defined(MADV_NOHUGEPAGE)
+		(void)madvise(ptr, len, MADV_NOHUGEPAGE);
+#endif
+		(void)memset(ptr, 0xaa, len);
+		cow_pass->touches = 0;
+		pid = fork();
+		if (pid < 0) {
+			(void)munmap(ptr, len);
+			return -1;
+		}
+		if (pid == 0) {
+			fault_pass_t child_pass;
+			int cfd_min, cfd_maj;
+
+			/* Count just this child, the parent's fds are inherited */
+			fault_counters_open(&cfd_min, &cfd_maj);
+			fault_touch(ptr, len, page_size, true, cfd_min, cfd_maj,
+				&child_pass);
+			fault_counters_close(cfd_min, cfd_maj);
+			*cow_pass = child_pass;
+			_exit(0);
+		}
+		(void)waitpid(pid, &status, 0);
+		*pass = *(fault_pass_t *)cow_pass;
+		(void)munmap(ptr, len);
+		return pass->touches ? 0 : -1;
+	}
+	case FAULT_CLASS_THP:
+		ptr = fault_anon_map(len, FAULT_THP_SIZE);
+		if (!ptr)
+			return -1;
+#if defined(MADV_HUGEPAGE)
+		(void)madvise(ptr, len, MADV_HUGEPAGE);
+#endif
+		fault_touch(ptr, len, FAULT_THP_SIZE, true, fd_min, fd_maj, pass);
+		(void)munmap(ptr, len);
+		return 0;
+	default:
+		/* Minor and zero page faults */
+		ptr = fault_anon_map(len, page_size);
+		if (!ptr)
+			return -1;
+#if defined(MADV_NOHUGEPAGE)
+		(void)madvise(ptr, len, MADV_NOHUGEPAGE);
+#endif
+		fault_touch(ptr, len, page_size, class == FAULT_CLASS_MINOR,
+			fd_min, fd_maj, pass);
+		(void)munmap(ptr, len);
+		return 0;
+	}
+}
+
+/*
+ *  stress_fault_class()
+ *	take page faults of one class at a time and report
+ *	the cost per fault, cross checked against the page
+ *	fault counts from perf (or getrusage)
+ */
+static int stress_fault_class(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const char *filename)
+{
+	const size_t page_size = stress_get_pagesize();
+	fault_pass_t totals[FAULT_CLASS_MAX];
+	volatile fault_pass_t *cow_pass;
+	bool reported = false;
+	int class, fd_min, fd_maj, rc = EXIT_SUCCESS;
+	size_t idx = 0;
+
+	cow_pass = mmap(NULL, sizeof(*cow_pass), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (cow_pass == MAP_FAILED) {
+		pr_err(stderr, "%s: mmap failed: errno=%d (%s)\n",
+			name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	memset(totals, 0, sizeof(totals));
+	fault_counters_open(&fd_min, &fd_maj);
+	if ((fd_min < 0) || (fd_maj < 0))
+		pr_dbg(stderr, "%s: cannot open page fault perf counters, "
+			"using getrusage fault counts\n", name);
+
+	do {
+		for (class = 0; class < FAULT_CLASS_MAX; class++) {
+			double t_end;
+
+			if ((opt_fault_class != FAULT_CLASS_ALL) &&
+			    (opt_fault_class != class))
+				continue;
+			t_end = time_now() + FAULT_CLASS_TIME;
+			do {
+				fault_pass_t pass;
+
+				if (fault_class_pass(name, class, filename,
+				    page_size, fd_min, fd_maj, cow_pass, &pass) < 0) {
+					pr_fail(stderr, "%s: %s fault pass failed\n",
+						name, fault_classes[class].name);
+					rc = EXIT_FAILURE;
+					goto done;
+				}
+				totals[class].touches += pass.touches;
+				totals[class].minflt += pass.minflt;
+				totals[class].majflt += pass.majflt;
+				totals[class].secs += pass.secs;
+				(*counter) += pass.touches;
+			} while (opt_do_run && (time_now() < t_end) &&
+				 (!max_ops || *counter < max_ops));
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %5s %12s %10s %10s %12s %12s\n", name,
+				"class", "touches", "minor/pg", "major/pg",
+				"ns/touch", "ns/fault");
+			for (class = 0; class < FAULT_CLASS_MAX; class++) {
+				const fault_pass_t *t = &totals[class];
+				const uint64_t faults = t->minflt + t->majflt;
+
+				if (!t->touches)
+					continue;
+				pr_inf(stderr, "%s: %5s %12" PRIu64 " %10.3f %10.3f "
+					"%12.1f %12.1f\n", name,
+					fault_classes[class].name, t->touches,
+					(double)t->minflt / (double)t->touches,
+					(double)t->majflt / (double)t->touches,
+					1000000000.0 * t->secs / (double)t->touches,
+					faults ? 1000000000.0 * t->secs / (double)faults : 0.0);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (class = 0; class < FAULT_CLASS_MAX; class++) {
+		const fault_pass_t *t = &totals[class];
+		const uint64_t faults = t->minflt + t->majflt;
+		char desc[40];
+
+		if (!t->touches)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s ns per fault",
+			fault_classes[class].name);
+		stress_misc_metric_set(idx++, desc, faults ?
+			1000000000.0 * t->secs / (double)faults : 0.0);
+		(void)snprintf(desc, sizeof(desc), "%s faults per touch",
+			fault_classes[class].name);
+		stress_misc_metric_set(idx++, desc,
+			(double)faults / (double)t->touches);
+	}
+	fault_counters_close(fd_min, fd_maj);
+	(void)munmap((void *)cow_pass, sizeof(*cow_pass));
+	(void)unlink(filename);
+
+	return rc;
+}
+
 static sigjmp_buf jmp_env;
 static volatile bool do_jmp = true;
 
@@ -76,6 +477,12 @@ int stress_fault(
 		name, pid, instance, mwc32());
 	(void)umask(0077);
 
+	if (opt_fault_class != FAULT_CLASS_NONE) {
+		ret = stress_fault_class(counter, instance, max_ops, name, filename);
+		(void)stress_temp_dir_rm(name, pid, instance);
+		return ret;
+	}
+
 	i = 0;
 
 	if (stress_sighandler(name, SIGSEGV, stress_segvhandler, NULL) < 0)
@@ -32,13 +32,378 @@
 #include <sys/file.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <inttypes.h>
 #if defined(_POSIX_PRIORITY_SCHEDULING) || defined(__linux__)
 #include <sched.h>
 #endif
 
 #include "stress-ng.h"
 
+#define CONTEND_STEP_TIME	(1.0)	/* secs per lock type and layout */
+#define CONTEND_SAMPLES		(4096)	/* wait samples per contender */
+
+#define CONTEND_FLOCK		(0)	/* flock(2), whole file */
+#define CONTEND_LOCKF		(1)	/* lockf(3) */
+#define CONTEND_POSIX		(2)	/* fcntl(2) F_SETLKW */
+#define CONTEND_OFD		(3)	/* fcntl(2) F_OFD_SETLKW */
+#define CONTEND_TYPES		(4)
+
+#define CONTEND_SHARED		(0)	/* all contend byte 0 */
+#define CONTEND_DISJOINT	(1)	/* contender i locks byte i */
+#define CONTEND_LAYOUTS		(2)
+
+/* Per contender results, in memory shared with the worker */
+typedef struct {
+	uint64_t acquired;		/* locks acquired */
+	uint64_t waits;			/* waits seen, for sampling */
+	uint64_t wait_max;		/* longest wait, ns */
+	uint64_t samples[CONTEND_SAMPLES];	/* sampled waits, ns */
+} flock_contender_t;
+
+typedef struct {
+	volatile bool go;		/* contenders start when set */
+	volatile bool stop;		/* contenders exit when set */
+	flock_contender_t contender[MAX_FLOCK_CONTENDERS];
+} flock_contend_t;
+
+/* Results of one lock type and layout step */
+typedef struct {
+	double	rate;			/* acquisitions per sec */
+	double	p50, p99, max;		/* wait times, usecs */
+	double	jain;			/* Jain's fairness index */
+	double	min_max;		/* least / most acquisitions */
+	bool	valid;
+} flock_step_t;
+
+static const char *contend_type_names[CONTEND_TYPES] = {
+	"flock", "lockf", "posix", "ofd"
+};
+
+static const char *contend_layout_names[CONTEND_LAYOUTS] = {
+	"shared", "disjoint"
+};
+
+static uint32_t opt_flock_contenders = 0;	/* 0 = plain flock loop */
+
+void stress_set_flock_contenders(const char *optarg)
+{
+	opt_flock_contenders = (uint32_t)get_uint64(optarg);
+	check_range("flock-contenders", opt_flock_contenders,
+		MIN_FLOCK_CONTENDERS, MAX_FLOCK_CONTENDERS);
+}
+
+/*
+ *  contend_lock()
+ *	take (lock true) or drop a lock of the given type on
+ *	one byte at offset, blocking until it is granted
+ */
+static int contend_lock(
+	const int fd,
+	const int type,
+	const off_t offset,
+	const bool lock)
+{
+	struct flock f;
+
+	switch (type) {
+	case CONTEND_FLOCK:
+		return flock(fd, lock ? LOCK_EX : LOCK_UN);
+	case CONTEND_LOCKF:
+		if (lseek(fd, offset, SEEK_SET) < 0)
+			return -1;
+		return lockf(fd, lock ? F_LOCK : F_ULOCK, 1);
+	default:
+		(void)memset(&f, 0, sizeof(f));
+		f.l_type = lock ? F_WRLCK : F_UNLCK;
+		f.l_whence = SEEK_SET;
+		f.l_start = offset;
+		f.l_len = 1;
+#if defined(F_OFD_SETLKW)
+		if (type == CONTEND_OFD)
+			return fcntl(fd, F_OFD_SETLKW, &f);
+#endif
+		return fcntl(fd, F_SETLKW, &f);
+	}
+}
+
+/*
+ *  contend_run()
+ *	a contender, open the file and take and drop the lock
+ *	until told to stop, sampling the wait times
+ */
+static void contend_run(
+	const char *filename,
+	flock_contend_t *contend,
+	const uint32_t id,
+	const int type,
+	const int layout)
+{
+	flock_contender_t *c = &contend->contender[id];
+	const off_t offset = (layout == CONTEND_DISJOINT) ? (off_t)id : 0;
+	int fd;
+
+	fd = open(filename, O_RDWR);
+	if (fd < 0)
+		_exit(EXIT_FAILURE);
+	while (!contend->go && !contend->stop)
+		(void)usleep(1000);
+
+	while (!contend->stop && opt_do_run) {
+		const uint64_t t = time_now_ns();
+		uint64_t wait;
+
+		if (contend_lock(fd, type, offset, true) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		wait = time_now_ns() - t;
+		c->acquired++;
+		c->waits++;
+		if (wait > c->wait_max)
+			c->wait_max = wait;
+		/* Reservoir sample so long runs are evenly represented */
+		if (c->waits <= CONTEND_SAMPLES) {
+			c->samples[c->waits - 1] = wait;
+		} else {
+			const uint64_t j = mwc64() % c->waits;
+
+			if (j < CONTEND_SAMPLES)
+				c->samples[j] = wait;
+		}
+#if defined(_POSIX_PRIORITY_SCHEDULING) && !defined(__minix__)
+		sched_yield();
+#endif
+		(void)contend_lock(fd, type, offset, false);
+	}
+	(void)close(fd);
+	_exit(EXIT_SUCCESS);
+}
+
+static int contend_cmp(const void *p1, const void *p2)
+{
+	const uint64_t v1 = *(const uint64_t *)p1;
+	const uint64_t v2 = *(const uint64_t *)p2;
+
+	return (v1 > v2) - (v1 < v2);
+}
+
+/*
+ *  contend_step()
+ *	run opt_flock_contenders contenders with one lock type
+ *	and layout for a step, returns -1 if none could start
+ */
+static int contend_step(
+	const char *filename,
+	flock_contend_t *contend,
+	uint64_t *samples,
+	const int type,
+	const int layout,
+	flock_step_t *step,
+	uint64_t *const counter)
+{
+	pid_t pids[MAX_FLOCK_CONTENDERS];
+	uint64_t acquired = 0, min = ~0ULL, max = 0, wait_max = 0;
+	double sum = 0.0, sum_sq = 0.0, t;
+	size_t n = 0;
+	uint32_t i, started = 0;
+
+	(void)memset(step, 0, sizeof(*step));
+	(void)memset(contend, 0, sizeof(*contend));
+	for (i = 0; i < opt_flock_contenders; i++) {
+		pids[i] = fork();
+		if (pids[i] == 0)
+			contend_run(filename, contend, i, type, layout);
+		if (pids[i] > 0)
+			started++;
+	}
+	if (!started)
+		return -1;
+
+	t = time_now();
+	contend->go = true;
+	while (opt_do_run && (time_now() - t < CONTEND_STEP_TIME))
+		(void)usleep(10000);
+	contend->stop = true;
+	t = time_now() - t;
+	for (i = 0; i < opt_flock_contenders; i++) {
+		int status;
+
+		if (pids[i] <= 0)
+			continue;
+		if (!opt_do_run)
+			(void)kill(pids[i], SIGKILL);
+		(void)waitpid(pids[i], &status, 0);
+	}
+
+	for (i = 0; i < opt_flock_contenders; i++) {
+		const flock_contender_t *c = &contend->contender[i];
+		const size_t k = (c->waits < CONTEND_SAMPLES) ?
+			(size_t)c->waits : CONTEND_SAMPLES;
+
+		if (pids[i] <= 0)
+			continue;
+		acquired += c->acquired;
+		sum += (double)c->acquired;
+		sum_sq += (double)c->acquired * (double)c->acquired;
+		if (c->acquired < min)
+			min = c->acquired;
+		if (c->acquired > max)
+			max = c->acquired;
+		if (c->wait_max > wait_max)
+			wait_max = c->wait_max;
+		(void)memcpy(samples + n, c->samples, k * sizeof(*samples));
+		n += k;
+	}
+	*counter += acquired;
+	if (!n || (t <= 0.0))
+		return 0;
+
+	qsort(samples, n, sizeof(*samples), contend_cmp);
+	step->rate = (double)acquired / t;
+	step->p50 = (double)samples[n / 2] / 1000.0;
+	step->p99 = (double)samples[(n * 99) / 100] / 1000.0;
+	step->max = (double)wait_max / 1000.0;
+	step->jain = (sum_sq > 0.0) ? (sum * sum) / ((double)started * sum_sq) : 0.0;
+	step->min_max = max ? (double)min / (double)max : 0.0;
+	step->valid = true;
+
+	return 0;
+}
+
+/*
+ *  stress_flock_contend()
+ *	contend each lock type for one byte and for disjoint
+ *	bytes of one file, the first instance reports the
+ *	first complete sweep
+ */
+static int stress_flock_contend(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	flock_step_t steps[CONTEND_TYPES][CONTEND_LAYOUTS], step;
+	const pid_t pid = getpid();
+	flock_contend_t *contend;
+	char filename[PATH_MAX];
+	uint64_t *samples;
+	bool reported = false;
+	double jain_min = 1.0;
+	int fd, type, layout, rc = EXIT_SUCCESS;
+	size_t idx = 0;
+
+	if (stress_temp_dir_mk(name, pid, instance) < 0)
+		return EXIT_FAILURE;
+	(void)stress_temp_filename(filename, sizeof(filename),
+		name, pid, instance, 0);
+	fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		rc = exit_status(errno);
+		pr_fail_err(name, "open");
+		goto tidy_dir;
+	}
+	(void)close(fd);
+
+	contend = mmap(NULL, sizeof(*contend), PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (contend == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot mmap contender state\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_file;
+	}
+	samples = calloc((size_t)opt_flock_contenders * CONTEND_SAMPLES,
+		sizeof(*samples));
+	if (!samples) {
+		pr_inf(stderr, "%s: cannot allocate wait samples\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto tidy_mmap;
+	}
+	(void)memset(steps, 0, sizeof(steps));
+
+	do {
+		for (type = 0; type < CONTEND_TYPES; type++) {
+#if !defined(F_OFD_SETLKW)
+			if (type == CONTEND_OFD)
+				continue;
+#endif
+			for (layout = 0; layout < CONTEND_LAYOUTS; layout++) {
+				/* flock only locks whole files */
+				if ((type == CONTEND_FLOCK) &&
+				    (layout == CONTEND_DISJOINT))
+					continue;
+				if (!opt_do_run || (max_ops && *counter >= max_ops))
+					goto done;
+				if (contend_step(filename, contend, samples,
+						 type, layout, &step, counter) < 0) {
+					pr_fail_err(name, "fork");
+					rc = EXIT_FAILURE;
+					goto done;
+				}
+				/* Keep only steps that ran their full time */
+				if (opt_do_run)
+					steps[type][layout] = step;
+			}
+		}
+		if ((instance == 0) && !reported && opt_do_run) {
+			pr_inf(stderr, "%s: %" PRIu32 " contenders, %-8s %10s "
+				"%9s %9s %9s %7s %7s\n", name, opt_flock_contenders,
+				"layout", "acquire/s", "wait p50", "wait p99",
+				"wait max", "jain", "min/max");
+			for (type = 0; type < CONTEND_TYPES; type++) {
+				for (layout = 0; layout < CONTEND_LAYOUTS; layout++) {
+					const flock_step_t *step = &steps[type][layout];
+
+					if (!step->valid)
+						continue;
+					pr_inf(stderr, "%s: %-15s %-8s %10.0f "
+						"%7.1fus %7.1fus %7.1fus %7.3f %7.3f\n",
+						name, contend_type_names[type],
+						contend_layout_names[layout], step->rate,
+						step->p50, step->p99, step->max,
+						step->jain, step->min_max);
+				}
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (type = 0; type < CONTEND_TYPES; type++) {
+		char desc[40];
+		const flock_step_t *step = &steps[type][CONTEND_SHARED];
+
+		if (!step->valid)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s acquire/s",
+			contend_type_names[type]);
+		stress_misc_metric_set(idx++, desc, step->rate);
+		(void)snprintf(desc, sizeof(desc), "%s wait p99 (usecs)",
+			contend_type_names[type]);
+		stress_misc_metric_set(idx++, desc, step->p99);
+		for (layout = 0; layout < CONTEND_LAYOUTS; layout++) {
+			if (steps[type][layout].valid &&
+			    (steps[type][layout].jain < jain_min))
+				jain_min = steps[type][layout].jain;
+		}
+	}
+	if (idx)
+		stress_misc_metric_set(idx++, "worst jain fairness index", jain_min);
+	free(samples);
+tidy_mmap:
+	(void)munmap((void *)contend, sizeof(*contend));
+tidy_file:
+	(void)unlink(filename);
+tidy_dir:
+	(void)stress_temp_dir_rm(name, pid, instance);
+
+	return rc;
+}
+
 /*
  *  stress_flock
  *	stress file locking
@@ -54,6 +419,9 @@ int stress_flock(
 	char filename[PATH_MAX];
 	char dirname[PATH_MAX];
 
+	if (opt_flock_contenders)
+		return stress_flock_contend(counter, instance, max_ops, name);
+
 	/*
 	 *  There will be a race to create the directory
 	 *  so EEXIST is expected on all but one instance
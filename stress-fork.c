@@ -27,9 +27,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 
 #include "stress-ng.h"
 
@@ -66,6 +74,370 @@ void stress_set_vfork_max(const char *optarg)
 }
 #endif
 
+#if defined(STRESS_LATENCY)
+#define FORK_LATENCY_PHASE_TIME	(1.0)		/* seconds per method */
+#define FORK_LATENCY_STACK_SIZE	(64 * KB)	/* clone-vm child stack */
+
+#define FORK_METHOD_FORK	(0)	/* fork(2) */
+#define FORK_METHOD_VFORK	(1)	/* vfork(2) */
+#define FORK_METHOD_CLONE_VM	(2)	/* clone(2) with CLONE_VM */
+#define FORK_METHOD_SPAWN	(3)	/* posix_spawn(3) of stress-ng */
+#define FORK_METHOD_EXEC	(4)	/* fork(2) then execve(2) of stress-ng */
+#define FORK_METHOD_MAX		(5)
+#define FORK_METHOD_ALL		(FORK_METHOD_MAX)
+
+#define FORK_LAT_RUNNING	(0)	/* creation to child running */
+#define FORK_LAT_REAPED		(1)	/* creation to exit reaped */
+#define FORK_LAT_MAIN		(2)	/* creation to main() after exec */
+#define FORK_LAT_MAX		(3)
+
+typedef struct {
+	const char *name;	/* User option */
+	int method;		/* FORK_METHOD_ value */
+} fork_method_t;
+
+static const fork_method_t fork_methods[] = {
+	{ "fork",	FORK_METHOD_FORK },
+	{ "vfork",	FORK_METHOD_VFORK },
+	{ "clone-vm",	FORK_METHOD_CLONE_VM },
+	{ "spawn",	FORK_METHOD_SPAWN },
+	{ "exec",	FORK_METHOD_EXEC },
+	{ "all",	FORK_METHOD_ALL },
+};
+
+static bool fork_latency_mode = false;
+static int opt_fork_method = FORK_METHOD_ALL;
+static uint64_t opt_fork_rss = 0;
+
+/*
+ *  stress_set_fork_latency()
+ *	measure process creation latencies
+ */
+void stress_set_fork_latency(void)
+{
+	fork_latency_mode = true;
+}
+
+/*
+ *  stress_set_fork_method()
+ *	set the process creation method(s) to measure
+ */
+int stress_set_fork_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(fork_methods); i++) {
+		if (!strcmp(name, fork_methods[i].name)) {
+			opt_fork_method = fork_methods[i].method;
+			fork_latency_mode = true;
+			return 0;
+		}
+	}
+	fprintf(stderr, "fork-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(fork_methods); i++)
+		fprintf(stderr, " %s", fork_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_fork_rss()
+ *	set the size of the resident memory the parent
+ *	touches before the measurements
+ */
+void stress_set_fork_rss(const char *optarg)
+{
+	opt_fork_rss = get_uint64_byte(optarg);
+	check_range("fork-rss", opt_fork_rss, MIN_FORK_RSS, MAX_FORK_RSS);
+	fork_latency_mode = true;
+}
+
+/*
+ *  stress_fork_clone_vm_child()
+ *	clone-vm child, shares our memory so just stamp it
+ */
+static int stress_fork_clone_vm_child(void *arg)
+{
+	*(volatile uint64_t *)arg = time_now_ns();
+	return 0;
+}
+
+/*
+ *  stress_fork_create()
+ *	create a child with the given method, the child stamps
+ *	*running when it first runs and exec'd children write
+ *	the time main() was reached down the pipe, returns the
+ *	child pid or -1
+ */
+static pid_t stress_fork_create(
+	const int method,
+	volatile uint64_t *running,
+	char *const argv[],
+	const int fd,
+	void *stack)
+{
+	char *const env[] = { NULL };
+	pid_t pid = -1;
+
+	switch (method) {
+	case FORK_METHOD_FORK:
+		pid = fork();
+		if (pid == 0) {
+			*running = time_now_ns();
+			_exit(0);
+		}
+		break;
+	case FORK_METHOD_VFORK:
+		pid = vfork();
+		if (pid == 0) {
+			*running = time_now_ns();
+			_exit(0);
+		}
+		break;
+	case FORK_METHOD_CLONE_VM:
+		pid = clone(stress_fork_clone_vm_child,
+			(uint8_t *)stack + FORK_LATENCY_STACK_SIZE,
+			CLONE_VM | SIGCHLD, (void *)running);
+		break;
+	case FORK_METHOD_SPAWN: {
+			posix_spawn_file_actions_t actions;
+
+			if (posix_spawn_file_actions_init(&actions))
+				return -1;
+			(void)posix_spawn_file_actions_adddup2(&actions,
+				fd, STDOUT_FILENO);
+			if (posix_spawn(&pid, argv[0], &actions, NULL, argv, env))
+				pid = -1;
+			(void)posix_spawn_file_actions_destroy(&actions);
+		}
+		break;
+	case FORK_METHOD_EXEC:
+		pid = fork();
+		if (pid == 0) {
+			*running = time_now_ns();
+			(void)dup2(fd, STDOUT_FILENO);
+			(void)execve(argv[0], argv, env);
+			_exit(EXIT_FAILURE);
+		}
+		break;
+	}
+	return pid;
+}
+
+/*
+ *  stress_fork_latency_phase()
+ *	create and reap children one at a time for a phase,
+ *	recording the latencies of each
+ */
+static int stress_fork_latency_phase(
+	const char *name,
+	const int method,
+	stress_latency_t lat[FORK_LAT_MAX],
+	char *const argv[],
+	volatile uint64_t *running,
+	void *stack,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const double t_end = time_now() + FORK_LATENCY_PHASE_TIME;
+	int fds[2];
+
+	if (pipe(fds) < 0) {
+		pr_fail_err(name, "pipe");
+		return -1;
+	}
+	/* A failed exec must not leave us blocked on the read */
+	(void)fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+	do {
+		uint64_t t_start, t_mono, t_main;
+		pid_t pid;
+		int status;
+
+		*running = 0;
+		/* the exec'd main() stamp can only be compared to CLOCK_MONOTONIC */
+		t_mono = time_mono_ns();
+		t_start = time_now_ns();
+		pid = stress_fork_create(method, running, argv, fds[1], stack);
+		if (pid < 0) {
+			if ((errno == EAGAIN) || (errno == ENOMEM))
+				continue;
+			pr_fail(stderr, "%s: %s failed: errno=%d (%s)\n",
+				name, fork_methods[method].name,
+				errno, strerror(errno));
+			break;
+		}
+		(void)setpgid(pid, pgrp);
+		if (waitpid(pid, &status, __WALL) < 0)
+			continue;
+		latency_record(&lat[FORK_LAT_REAPED], time_now_ns() - t_start);
+		if (*running >= t_start)
+			latency_record(&lat[FORK_LAT_RUNNING], *running - t_start);
+		if ((read(fds[0], &t_main, sizeof(t_main)) == sizeof(t_main)) &&
+		    (t_main >= t_mono))
+			latency_record(&lat[FORK_LAT_MAIN], t_main - t_mono);
+		(*counter)++;
+	} while (opt_do_run && (time_now() < t_end) &&
+		 (!max_ops || *counter < max_ops));
+
+	(void)close(fds[0]);
+	(void)close(fds[1]);
+	return 0;
+}
+
+/*
+ *  stress_fork_latency()
+ *	break down the process creation latency of each
+ *	method, optionally from a parent with a large RSS
+ *	so fork has many page tables to copy
+ */
+static int stress_fork_latency(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	static const char *lat_names[FORK_LAT_MAX] = {
+		"running", "reaped", "to main"
+	};
+	const size_t page_size = stress_get_pagesize();
+	stress_latency_t (*lats)[FORK_LAT_MAX];
+	bool available[FORK_METHOD_MAX];
+	char path[PATH_MAX + 1];
+	char *argv[] = { path, "--exec-exit-ts", NULL };
+	volatile uint64_t *running;
+	uint8_t *rss = MAP_FAILED;
+	void *stack;
+	ssize_t len;
+	bool reported = false;
+	int method, rc = EXIT_SUCCESS;
+	size_t idx = 0;
+
+	for (method = 0; method < FORK_METHOD_MAX; method++)
+		available[method] = (opt_fork_method == FORK_METHOD_ALL) ||
+				    (opt_fork_method == method);
+
+	/* Same policy as the exec and spawn stressors */
+	len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+	if ((geteuid() == 0) || (len < 0) || (len > PATH_MAX)) {
+		if ((instance == 0) && (available[FORK_METHOD_SPAWN] ||
+		    available[FORK_METHOD_EXEC]))
+			pr_inf(stderr, "%s: %s, skipping the spawn and exec "
+				"methods\n", name, (geteuid() == 0) ?
+				"running as root" : "cannot find own executable");
+		available[FORK_METHOD_SPAWN] = false;
+		available[FORK_METHOD_EXEC] = false;
+		len = 0;
+	}
+	path[len] = '\0';
+
+	running = mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	stack = mmap(NULL, FORK_LATENCY_STACK_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	lats = calloc(FORK_METHOD_MAX, sizeof(*lats));
+	if ((running == MAP_FAILED) || (stack == MAP_FAILED) || !lats) {
+		pr_err(stderr, "%s: cannot allocate latency state\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_state;
+	}
+
+	if (opt_fork_rss) {
+		rss = mmap(NULL, (size_t)opt_fork_rss, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (rss == MAP_FAILED) {
+			pr_inf(stderr, "%s: cannot allocate %" PRIu64
+				" bytes of parent RSS, continuing without it\n",
+				name, opt_fork_rss);
+		} else {
+			uint64_t i;
+
+			/* Populate every page, fork has to copy their page tables */
+			for (i = 0; i < opt_fork_rss; i += page_size)
+				rss[i] = (uint8_t)i;
+		}
+	}
+
+	do {
+		for (method = 0; method < FORK_METHOD_MAX; method++) {
+			if (!available[method])
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			if (stress_fork_latency_phase(name, method, lats[method],
+					argv, running, stack, counter, max_ops) < 0) {
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+		}
+		if ((instance == 0) && !reported) {
+			int l;
+
+			pr_inf(stderr, "%s: latencies in usec with a %" PRIu64
+				"K parent RSS\n", name,
+				(uint64_t)((rss == MAP_FAILED) ? 0 : opt_fork_rss / KB));
+			pr_inf(stderr, "%s: %8s %9s %9s %9s %9s %9s %9s\n", name,
+				"method", "run p50", "run p99", "reap p50",
+				"reap p99", "main p50", "main p99");
+			for (method = 0; method < FORK_METHOD_MAX; method++) {
+				char buf[FORK_LAT_MAX][2][16];
+
+				if (!available[method])
+					continue;
+				for (l = 0; l < FORK_LAT_MAX; l++) {
+					const stress_latency_t *lat = &lats[method][l];
+
+					if (!lat->count) {
+						(void)snprintf(buf[l][0], sizeof(buf[l][0]), "-");
+						(void)snprintf(buf[l][1], sizeof(buf[l][1]), "-");
+						continue;
+					}
+					(void)snprintf(buf[l][0], sizeof(buf[l][0]), "%.1f",
+						latency_percentile_usec(lat, 0.50));
+					(void)snprintf(buf[l][1], sizeof(buf[l][1]), "%.1f",
+						latency_percentile_usec(lat, 0.99));
+				}
+				pr_inf(stderr, "%s: %8s %9s %9s %9s %9s %9s %9s\n",
+					name, fork_methods[method].name,
+					buf[0][0], buf[0][1], buf[1][0],
+					buf[1][1], buf[2][0], buf[2][1]);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	/* Child running or, for exec'd children, main() and reaped p50 */
+	for (method = 0; method < FORK_METHOD_MAX; method++) {
+		const int l = lats[method][FORK_LAT_MAIN].count ?
+			FORK_LAT_MAIN : FORK_LAT_RUNNING;
+		char desc[40];
+
+		if (!lats[method][FORK_LAT_REAPED].count)
+			continue;
+		if (lats[method][l].count) {
+			(void)snprintf(desc, sizeof(desc), "%s %s p50 (usec)",
+				fork_methods[method].name, lat_names[l]);
+			stress_misc_metric_set(idx++, desc,
+				latency_percentile_usec(&lats[method][l], 0.50));
+		}
+		(void)snprintf(desc, sizeof(desc), "%s reaped p50 (usec)",
+			fork_methods[method].name);
+		stress_misc_metric_set(idx++, desc,
+			latency_percentile_usec(&lats[method][FORK_LAT_REAPED], 0.50));
+	}
+	if (rss != MAP_FAILED)
+		(void)munmap((void *)rss, (size_t)opt_fork_rss);
+free_state:
+	free(lats);
+	if (stack != MAP_FAILED)
+		(void)munmap(stack, FORK_LATENCY_STACK_SIZE);
+	if (running != MAP_FAILED)
+		(void)munmap((void *)running, page_size);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_fork_fn()
  *	stress by forking and exiting using
@@ -136,6 +508,10 @@ int stress_fork(
 		if (opt_flags & OPT_FLAGS_MINIMIZE)
 			opt_fork_max = MIN_FORKS;
 	}
+#if defined(STRESS_LATENCY)
+	if (fork_latency_mode)
+		return stress_fork_latency(counter, instance, max_ops, name);
+#endif
 
 	return stress_fork_fn(counter, instance, max_ops,
 		name, fork, opt_fork_max);
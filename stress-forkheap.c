@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define FORKHEAP_STEP_TIME	(0.5)	/* seconds of forks per RSS step */
+#define FORKHEAP_STEPS		(6)	/* RSS doubles up to the full heap */
+
+/* CoW results written back by each child */
+typedef struct {
+	uint64_t faults;		/* minor faults of the CoW writes */
+	uint64_t cow_ns;		/* time taken by the CoW writes */
+} forkheap_cow_t;
+
+/* per RSS step results */
+typedef struct {
+	uint64_t rss;			/* populated bytes */
+	uint64_t forks;			/* forks measured */
+	uint64_t faults;		/* CoW faults in the children */
+	double fork_secs;		/* total fork(2) time in the parent */
+	double cow_secs;		/* total CoW write time in the children */
+} forkheap_step_t;
+
+static uint64_t opt_forkheap_bytes = DEFAULT_FORKHEAP_BYTES;
+static bool set_forkheap_bytes = false;
+static uint32_t opt_forkheap_vmas = DEFAULT_FORKHEAP_VMAS;
+static uint32_t opt_forkheap_cow = DEFAULT_FORKHEAP_COW;
+static bool opt_forkheap_thp = false;
+
+void stress_set_forkheap_bytes(const char *optarg)
+{
+	set_forkheap_bytes = true;
+	opt_forkheap_bytes = get_uint64_byte(optarg);
+	check_range("forkheap-bytes", opt_forkheap_bytes,
+		MIN_FORKHEAP_BYTES, MAX_FORKHEAP_BYTES);
+}
+
+void stress_set_forkheap_vmas(const char *optarg)
+{
+	opt_forkheap_vmas = (uint32_t)get_uint64(optarg);
+	check_range("forkheap-vmas", opt_forkheap_vmas,
+		MIN_FORKHEAP_VMAS, MAX_FORKHEAP_VMAS);
+}
+
+void stress_set_forkheap_cow(const char *optarg)
+{
+	opt_forkheap_cow = (uint32_t)get_uint64(optarg);
+	check_range("forkheap-cow", opt_forkheap_cow,
+		MIN_FORKHEAP_COW, MAX_FORKHEAP_COW);
+}
+
+void stress_set_forkheap_thp(void)
+{
+	opt_forkheap_thp = true;
+}
+
+/*
+ *  forkheap_addr()
+ *	address of a heap offset, each VMA sized chunk is
+ *	followed by an unmapped page so the chunks cannot merge
+ */
+static inline uint8_t *forkheap_addr(
+	uint8_t *heap,
+	const size_t chunk,
+	const size_t page_size,
+	const uint64_t offset)
+{
+	return heap + ((offset / chunk) * (chunk + page_size)) + (offset % chunk);
+}
+
+/*
+ *  forkheap_child()
+ *	write to a share of the populated pages, each write
+ *	takes a CoW fault, and report the cost to the parent
+ */
+static void forkheap_child(
+	uint8_t *heap,
+	const size_t chunk,
+	const size_t page_size,
+	const uint64_t rss,
+	volatile forkheap_cow_t *cow)
+{
+	const uint64_t pages = rss / page_size;
+	const uint64_t stride = opt_forkheap_cow ? 100 / opt_forkheap_cow : 0;
+	struct rusage before, after;
+	double t;
+	uint64_t i;
+
+	if (!stride)
+		_exit(0);
+
+	(void)getrusage(RUSAGE_SELF, &before);
+	t = time_now();
+	for (i = 0; i < pages; i += stride)
+		(*forkheap_addr(heap, chunk, page_size, i * page_size))++;
+	cow->cow_ns = (uint64_t)((time_now() - t) * 1000000000.0);
+	(void)getrusage(RUSAGE_SELF, &after);
+	cow->faults = (uint64_t)(after.ru_minflt - before.ru_minflt);
+	_exit(0);
+}
+
+/*
+ *  forkheap_step()
+ *	fork from a parent with rss bytes populated for a
+ *	step time, returns -1 if fork fails outright
+ */
+static int forkheap_step(
+	const char *name,
+	uint8_t *heap,
+	const size_t chunk,
+	const size_t page_size,
+	forkheap_step_t *step,
+	volatile forkheap_cow_t *cow,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const double t_end = time_now() + FORKHEAP_STEP_TIME;
+
+	do {
+		double t;
+		pid_t pid;
+		int status;
+
+		cow->faults = 0;
+		cow->cow_ns = 0;
+		t = time_now();
+		pid = fork();
+		if (pid < 0) {
+			if ((errno == EAGAIN) || (errno == ENOMEM))
+				continue;
+			pr_fail_err(name, "fork");
+			return -1;
+		}
+		if (pid == 0) {
+			stress_parent_died_alarm();
+			set_oom_adjustment(name, true);
+			forkheap_child(heap, chunk, page_size, step->rss, cow);
+		}
+		step->fork_secs += time_now() - t;
+		(void)setpgid(pid, pgrp);
+		if (waitpid(pid, &status, 0) < 0) {
+			(void)kill(pid, SIGKILL);
+			(void)waitpid(pid, &status, 0);
+			continue;
+		}
+		step->forks++;
+		step->faults += cow->faults;
+		step->cow_secs += (double)cow->cow_ns / 1000000000.0;
+		(*counter)++;
+	} while (opt_do_run && (time_now() < t_end) &&
+		 (!max_ops || *counter < max_ops));
+
+	return 0;
+}
+
+/*
+ *  stress_forkheap()
+ *	fork from a parent with a growing resident heap,
+ *	measuring the fork page table copy cost and the
+ *	CoW fault cost of the first writes in the child
+ */
+int stress_forkheap(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t page_size = stress_get_pagesize();
+	forkheap_step_t steps[FORKHEAP_STEPS];
+	volatile forkheap_cow_t *cow;
+	uint8_t *heap;
+	uint64_t bytes, populated;
+	size_t chunk, heap_size;
+	bool reported = false;
+	int i, rc = EXIT_SUCCESS;
+
+	if (!set_forkheap_bytes) {
+		if (opt_flags & OPT_FLAGS_MAXIMIZE)
+			opt_forkheap_bytes = MAX_FORKHEAP_BYTES;
+		if (opt_flags & OPT_FLAGS_MINIMIZE)
+			opt_forkheap_bytes = MIN_FORKHEAP_BYTES;
+	}
+
+	/* Whole pages per VMA, the heap is the sum of the chunks */
+	chunk = (size_t)(opt_forkheap_bytes / opt_forkheap_vmas);
+	chunk = (chunk / page_size) * page_size;
+	if (chunk < page_size)
+		chunk = page_size;
+	bytes = (uint64_t)chunk * opt_forkheap_vmas;
+	heap_size = (size_t)(chunk + page_size) * opt_forkheap_vmas;
+
+	cow = mmap(NULL, sizeof(*cow), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (cow == MAP_FAILED) {
+		pr_fail_err(name, "mmap");
+		return EXIT_NO_RESOURCE;
+	}
+	heap = mmap(NULL, heap_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (heap == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot allocate a %" PRIu64 "K heap\n",
+			name, (uint64_t)(bytes / KB));
+		(void)munmap((void *)cow, sizeof(*cow));
+		return EXIT_NO_RESOURCE;
+	}
+	/* Punch a hole after each chunk to fragment the heap into VMAs */
+	for (i = 0; i < (int)opt_forkheap_vmas; i++) {
+		uint8_t *hole = heap + ((size_t)i * (chunk + page_size)) + chunk;
+
+		(void)munmap((void *)hole, page_size);
+#if defined(MADV_HUGEPAGE)
+		if (opt_forkheap_thp)
+			(void)madvise((void *)(hole - chunk), chunk, MADV_HUGEPAGE);
+#endif
+	}
+#if !defined(MADV_HUGEPAGE)
+	if (opt_forkheap_thp && (instance == 0))
+		pr_inf(stderr, "%s: transparent huge pages not supported, "
+			"ignoring --forkheap-thp\n", name);
+#endif
+	memset(steps, 0, sizeof(steps));
+	for (i = 0; i < FORKHEAP_STEPS; i++) {
+		/* Halve from the full heap down, whole pages only */
+		uint64_t rss = (bytes >> (FORKHEAP_STEPS - 1 - i));
+
+		rss = (rss / page_size) * page_size;
+		steps[i].rss = rss ? rss : page_size;
+	}
+
+	do {
+		/* Start each pass from an empty heap */
+		for (i = 0; i < (int)opt_forkheap_vmas; i++)
+			(void)madvise((void *)(heap + ((size_t)i * (chunk + page_size))),
+				chunk, MADV_DONTNEED);
+		populated = 0;
+
+		for (i = 0; i < FORKHEAP_STEPS; i++) {
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			for (; populated < steps[i].rss; populated += page_size)
+				*forkheap_addr(heap, chunk, page_size, populated) = 1;
+			if (forkheap_step(name, heap, chunk, page_size,
+					&steps[i], cow, counter, max_ops) < 0) {
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %" PRIu32 " VMA%s%s, CoW writes to "
+				"%" PRIu32 "%% of the pages\n", name,
+				opt_forkheap_vmas, (opt_forkheap_vmas > 1) ? "s" : "",
+				opt_forkheap_thp ? ", THP" : "", opt_forkheap_cow);
+			pr_inf(stderr, "%s: %9s %7s %10s %10s %14s %11s\n", name,
+				"RSS MB", "forks", "fork ms", "ms per GB",
+				"CoW faults/s", "usec/fault");
+			for (i = 0; i < FORKHEAP_STEPS; i++) {
+				const forkheap_step_t *s = &steps[i];
+				const double fork_ms = s->forks ?
+					1000.0 * s->fork_secs / (double)s->forks : 0.0;
+
+				pr_inf(stderr, "%s: %9.1f %7" PRIu64 " %10.3f %10.2f "
+					"%14.1f %11.3f\n", name,
+					(double)s->rss / (double)MB, s->forks, fork_ms,
+					fork_ms * (double)GB / (double)s->rss,
+					(s->cow_secs > 0.0) ?
+						(double)s->faults / s->cow_secs : 0.0,
+					s->faults ? 1000000.0 * s->cow_secs /
+						(double)s->faults : 0.0);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	/* Report the full heap step, the largest RSS */
+	for (i = FORKHEAP_STEPS - 1; i >= 0; i--) {
+		const forkheap_step_t *s = &steps[i];
+		double fork_ms;
+
+		if (!s->forks)
+			continue;
+		fork_ms = 1000.0 * s->fork_secs / (double)s->forks;
+		stress_misc_metric_set(0, "RSS at the largest step (MB)",
+			(double)s->rss / (double)MB);
+		stress_misc_metric_set(1, "fork time (ms)", fork_ms);
+		stress_misc_metric_set(2, "fork time per GB RSS (ms)",
+			fork_ms * (double)GB / (double)s->rss);
+		if (s->cow_secs > 0.0)
+			stress_misc_metric_set(3, "CoW faults per sec",
+				(double)s->faults / s->cow_secs);
+		break;
+	}
+	(void)munmap((void *)heap, heap_size);
+	(void)munmap((void *)cow, sizeof(*cow));
+
+	return rc;
+}
@@ -0,0 +1,652 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+
+#include "stress-ng.h"
+
+#if defined(STRESS_FRONTEND)
+
+#define FRONTEND_TIME		(0.05)		/* seconds per mode and size */
+#define FRONTEND_BLOCK		(64)		/* bytes of code per block */
+#define FRONTEND_BATCH		(64 * KB)	/* blocks run between clock reads */
+#define FRONTEND_BITS		(4 * MB)	/* max bytes of branch outcomes */
+#define FRONTEND_MODE_ALL	(-1)
+
+/* Generated code is called as uint64_t fn(const uint8_t *bits) */
+typedef uint64_t (*frontend_func_t)(const uint8_t *bits);
+
+/* Code footprints swept, across L1i, the uop cache, L2 and the iTLB */
+static const size_t frontend_sizes[] = {
+	4 * KB, 8 * KB, 16 * KB, 32 * KB, 64 * KB, 128 * KB,
+	256 * KB, 512 * KB, 1 * MB, 4 * MB, 16 * MB
+};
+
+#define FRONTEND_SIZES		(SIZEOF_ARRAY(frontend_sizes))
+
+/* Generated code of one mode at one footprint */
+typedef struct {
+	uint8_t *code;			/* mapped code */
+	size_t code_len;		/* size of the mapping */
+	frontend_func_t func;		/* entry point */
+	uint8_t *bits;			/* branch outcomes, variants * blocks */
+	size_t blocks;			/* blocks run per call */
+	size_t variants;		/* sets of branch outcomes */
+} frontend_code_t;
+
+typedef struct {
+	const char *name;		/* --frontend-mode name */
+	int (*generate)(frontend_code_t *fc, const size_t size);
+} frontend_mode_t;
+
+/* Perf counters read around each measurement */
+enum {
+	FRONTEND_CYCLES = 0,
+	FRONTEND_INSTRUCTIONS,
+	FRONTEND_BRANCHES,
+	FRONTEND_BRANCH_MISSES,
+	FRONTEND_ITLB_MISSES,
+	FRONTEND_COUNTERS
+};
+
+/* Accumulated results of one mode at one footprint */
+typedef struct {
+	uint64_t blocks;		/* blocks or calls run */
+	uint64_t counters[FRONTEND_COUNTERS];
+	bool have[FRONTEND_COUNTERS];	/* counter was readable */
+	double duration;		/* time taken */
+} frontend_stats_t;
+
+static int opt_frontend_mode = FRONTEND_MODE_ALL;
+static size_t opt_frontend_size = 0;	/* 0 = sweep all sizes */
+static uint32_t opt_frontend_entropy = DEFAULT_FRONTEND_ENTROPY;
+
+/*
+ *  frontend_permute()
+ *	shuffle the order the blocks are run in so consecutive
+ *	blocks are not neighbours and next line prefetch can't help
+ */
+static void frontend_permute(size_t *order, const size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		order[i] = i;
+	for (i = n - 1; i > 0; i--) {
+		const size_t j = (size_t)(mwc64() % (i + 1));
+		const size_t tmp = order[i];
+
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+}
+
+/*
+ *  frontend_rel32()
+ *	store a rel32 displacement from the end of the instruction
+ *	at insn_end to target
+ */
+static inline void frontend_rel32(
+	uint8_t *ptr,
+	const uint8_t *insn_end,
+	const uint8_t *target)
+{
+	const int32_t rel = (int32_t)(target - insn_end);
+
+	(void)memcpy(ptr, &rel, sizeof(rel));
+}
+
+/*
+ *  frontend_map()
+ *	map writable code, filled with int3 so a bad jump traps
+ */
+static int frontend_map(frontend_code_t *fc, const size_t len)
+{
+	const size_t page_size = stress_get_pagesize();
+
+	fc->code_len = (len + page_size - 1) & ~(page_size - 1);
+	fc->code = mmap(NULL, fc->code_len, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (fc->code == MAP_FAILED) {
+		fc->code = NULL;
+		return -1;
+	}
+	(void)memset(fc->code, 0xcc, fc->code_len);
+	return 0;
+}
+
+/*
+ *  frontend_seal()
+ *	make the generated code executable and read only
+ */
+static int frontend_seal(frontend_code_t *fc)
+{
+	if (mprotect(fc->code, fc->code_len, PROT_READ | PROT_EXEC) < 0)
+		return -1;
+	fc->func = (frontend_func_t)(uintptr_t)fc->code;
+	return 0;
+}
+
+/*
+ *  frontend_gen_branches()
+ *	a maze of 64 byte blocks in shuffled order, each block
+ *	tests its branch outcome byte, conditionally skips an add
+ *	and jumps to the next block:
+ *
+ *	test byte [rdi + step], 1
+ *	jnz  1f
+ *	add  rax, 1
+ *  1:	jmp  next_block		(ret on the last block)
+ *
+ *	--frontend-entropy percent of the blocks take a random
+ *	direction on each call, the rest always go the same way
+ */
+static int frontend_gen_branches(frontend_code_t *fc, const size_t size)
+{
+	const size_t blocks = STRESS_MAXIMUM((size_t)2, size / FRONTEND_BLOCK);
+	uint8_t *entry, *fixed;
+	size_t *order, i, v;
+
+	order = malloc(blocks * sizeof(*order));
+	fixed = malloc(blocks);
+	if (!order || !fixed)
+		goto err;
+	if (frontend_map(fc, (blocks + 1) * FRONTEND_BLOCK) < 0)
+		goto err;
+	frontend_permute(order, blocks);
+
+	/* Entry, xor eax, eax; jmp first block */
+	entry = fc->code;
+	entry[0] = 0x31;
+	entry[1] = 0xc0;
+	entry[2] = 0xe9;
+	frontend_rel32(entry + 3, entry + 7,
+		fc->code + (order[0] + 1) * FRONTEND_BLOCK);
+
+	for (i = 0; i < blocks; i++) {
+		uint8_t *b = fc->code + (order[i] + 1) * FRONTEND_BLOCK;
+		const uint32_t disp = (uint32_t)i;
+
+		b[0] = 0xf6;		/* test byte [rdi + disp32], 1 */
+		b[1] = 0x87;
+		(void)memcpy(b + 2, &disp, sizeof(disp));
+		b[6] = 0x01;
+		b[7] = 0x75;		/* jnz +4 */
+		b[8] = 0x04;
+		b[9] = 0x48;		/* add rax, 1 */
+		b[10] = 0x83;
+		b[11] = 0xc0;
+		b[12] = 0x01;
+		if (i == blocks - 1) {
+			b[13] = 0xc3;	/* ret */
+		} else {
+			b[13] = 0xe9;	/* jmp rel32 */
+			frontend_rel32(b + 14, b + 18,
+				fc->code + (order[i + 1] + 1) * FRONTEND_BLOCK);
+		}
+		/* 0xff marks a block with a random outcome */
+		fixed[i] = (mwc32() % 100 < opt_frontend_entropy) ?
+			0xff : (mwc8() & 1);
+	}
+	if (frontend_seal(fc) < 0)
+		goto err;
+
+	/*
+	 *  Enough sets of outcomes that the random blocks don't
+	 *  repeat a pattern short enough for the predictor to learn
+	 */
+	fc->blocks = blocks;
+	fc->variants = STRESS_MAXIMUM((size_t)16, FRONTEND_BITS / blocks);
+	fc->bits = malloc(fc->variants * blocks);
+	if (!fc->bits)
+		goto err;
+	for (v = 0; v < fc->variants; v++) {
+		uint8_t *bits = fc->bits + (v * blocks);
+
+		for (i = 0; i < blocks; i++)
+			bits[i] = (fixed[i] == 0xff) ? (mwc8() & 1) : fixed[i];
+	}
+	free(fixed);
+	free(order);
+	return 0;
+err:
+	free(fixed);
+	free(order);
+	return -1;
+}
+
+/*
+ *  frontend_gen_calls()
+ *	a chain of calls to tiny functions 64 bytes apart in
+ *	shuffled order, each function is add rax, 1; ret
+ */
+static int frontend_gen_calls(frontend_code_t *fc, const size_t size)
+{
+	const size_t funcs = STRESS_MAXIMUM((size_t)2, size / FRONTEND_BLOCK);
+	const size_t caller_len = 2 + (funcs * 5) + 1;
+	uint8_t *caller, *p;
+	size_t *order, i;
+
+	order = malloc(funcs * sizeof(*order));
+	if (!order)
+		return -1;
+	if (frontend_map(fc, caller_len + (funcs * FRONTEND_BLOCK)) < 0) {
+		free(order);
+		return -1;
+	}
+	frontend_permute(order, funcs);
+
+	/* Functions first, the caller follows them */
+	for (i = 0; i < funcs; i++) {
+		uint8_t *f = fc->code + (i * FRONTEND_BLOCK);
+
+		f[0] = 0x48;		/* add rax, 1 */
+		f[1] = 0x83;
+		f[2] = 0xc0;
+		f[3] = 0x01;
+		f[4] = 0xc3;		/* ret */
+	}
+	caller = fc->code + (funcs * FRONTEND_BLOCK);
+	p = caller;
+	*p++ = 0x31;			/* xor eax, eax */
+	*p++ = 0xc0;
+	for (i = 0; i < funcs; i++) {
+		*p = 0xe8;		/* call rel32 */
+		frontend_rel32(p + 1, p + 5,
+			fc->code + (order[i] * FRONTEND_BLOCK));
+		p += 5;
+	}
+	*p = 0xc3;			/* ret */
+	free(order);
+
+	if (frontend_seal(fc) < 0)
+		return -1;
+	fc->func = (frontend_func_t)(uintptr_t)caller;
+	fc->blocks = funcs;
+	fc->variants = 1;
+	fc->bits = calloc(1, 1);
+	return fc->bits ? 0 : -1;
+}
+
+static const frontend_mode_t frontend_modes[] = {
+	{ "calls",	frontend_gen_calls },
+	{ "branches",	frontend_gen_branches },
+};
+
+#define FRONTEND_MODES		(SIZEOF_ARRAY(frontend_modes))
+
+/*
+ *  stress_set_frontend_mode()
+ *	set the code shape to run, or all of them
+ */
+int stress_set_frontend_mode(const char *name)
+{
+	size_t i;
+
+	if (!strcmp(name, "all")) {
+		opt_frontend_mode = FRONTEND_MODE_ALL;
+		return 0;
+	}
+	for (i = 0; i < FRONTEND_MODES; i++) {
+		if (!strcmp(name, frontend_modes[i].name)) {
+			opt_frontend_mode = (int)i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "frontend-mode must be one of: all");
+	for (i = 0; i < FRONTEND_MODES; i++)
+		fprintf(stderr, " %s", frontend_modes[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+void stress_set_frontend_size(const char *optarg)
+{
+	const uint64_t size = get_uint64_byte(optarg);
+
+	check_range("frontend-size", size,
+		MIN_FRONTEND_SIZE, MAX_FRONTEND_SIZE);
+	opt_frontend_size = (size_t)size;
+}
+
+void stress_set_frontend_entropy(const char *optarg)
+{
+	opt_frontend_entropy = (uint32_t)get_uint64(optarg);
+	check_range("frontend-entropy", opt_frontend_entropy,
+		MIN_FRONTEND_ENTROPY, MAX_FRONTEND_ENTROPY);
+}
+
+/*
+ *  frontend_free()
+ *	unmap generated code
+ */
+static void frontend_free(frontend_code_t *fc)
+{
+	if (fc->code)
+		(void)munmap(fc->code, fc->code_len);
+	free(fc->bits);
+	(void)memset(fc, 0, sizeof(*fc));
+}
+
+/*
+ *  frontend_perf_open()
+ *	open the perf counters, -1 for those that are unavailable
+ */
+static void frontend_perf_open(int fds[FRONTEND_COUNTERS])
+{
+#if defined(STRESS_PERF_STATS)
+	static const int ids[FRONTEND_COUNTERS] = {
+		STRESS_PERF_HW_CPU_CYCLES,
+		STRESS_PERF_HW_INSTRUCTIONS,
+		STRESS_PERF_HW_BRANCH_INSTRUCTIONS,
+		STRESS_PERF_HW_BRANCH_MISSES,
+		STRESS_PERF_HW_CACHE_ITLB_READ_MISS,
+	};
+#endif
+	size_t i;
+
+	for (i = 0; i < FRONTEND_COUNTERS; i++) {
+#if defined(STRESS_PERF_STATS)
+		fds[i] = perf_open_by_id(ids[i]);
+#else
+		fds[i] = -1;
+#endif
+	}
+}
+
+/*
+ *  frontend_perf_read()
+ *	read the perf counters, ok[i] false if unavailable
+ */
+static void frontend_perf_read(
+	const int fds[FRONTEND_COUNTERS],
+	uint64_t values[FRONTEND_COUNTERS],
+	bool ok[FRONTEND_COUNTERS])
+{
+	size_t i;
+
+	for (i = 0; i < FRONTEND_COUNTERS; i++) {
+#if defined(STRESS_PERF_STATS)
+		ok[i] = perf_read_by_fd(fds[i], &values[i]) == 0;
+#else
+		(void)fds;
+		values[i] = 0;
+		ok[i] = false;
+#endif
+	}
+}
+
+/*
+ *  frontend_measure()
+ *	run the generated code for FRONTEND_TIME seconds, cycling
+ *	through the sets of branch outcomes
+ */
+static void frontend_measure(
+	const frontend_code_t *fc,
+	const int fds[FRONTEND_COUNTERS],
+	frontend_stats_t *stats,
+	uint64_t *sink)
+{
+	const size_t batch = STRESS_MAXIMUM((size_t)1, FRONTEND_BATCH / fc->blocks);
+	uint64_t v1[FRONTEND_COUNTERS], v2[FRONTEND_COUNTERS];
+	bool ok1[FRONTEND_COUNTERS], ok2[FRONTEND_COUNTERS];
+	uint64_t sum = 0, blocks = 0;
+	double t_start, t_end, t;
+	size_t i, v = 0;
+
+	/* Warm up, faults in the code and outcome pages */
+	for (i = 0; i < fc->variants; i++)
+		sum += fc->func(fc->bits + (i * fc->blocks));
+
+	frontend_perf_read(fds, v1, ok1);
+	t_start = time_now();
+	t_end = t_start + FRONTEND_TIME;
+	do {
+		for (i = 0; i < batch; i++) {
+			sum += fc->func(fc->bits + (v * fc->blocks));
+			if (++v >= fc->variants)
+				v = 0;
+		}
+		blocks += batch * fc->blocks;
+		t = time_now();
+	} while (opt_do_run && (t < t_end));
+	frontend_perf_read(fds, v2, ok2);
+
+	stats->blocks += blocks;
+	stats->duration += t - t_start;
+	for (i = 0; i < FRONTEND_COUNTERS; i++) {
+		if (ok1[i] && ok2[i] && (v2[i] >= v1[i])) {
+			stats->counters[i] += v2[i] - v1[i];
+			stats->have[i] = true;
+		}
+	}
+	*sink += sum;
+}
+
+/*
+ *  frontend_verify()
+ *	the maze adds one for each block whose outcome byte is
+ *	zero and the call chain one per call
+ */
+static int frontend_verify(
+	const char *name,
+	const frontend_mode_t *mode,
+	const frontend_code_t *fc)
+{
+	const uint8_t *bits = fc->bits + ((fc->variants - 1) * fc->blocks);
+	uint64_t expected = 0, got;
+	size_t i;
+
+	if (!strcmp(mode->name, "calls")) {
+		expected = fc->blocks;
+	} else {
+		for (i = 0; i < fc->blocks; i++)
+			expected += !(bits[i] & 1);
+	}
+	got = fc->func(bits);
+	if (got != expected) {
+		pr_fail(stderr, "%s: %s code over %zu blocks returned %" PRIu64
+			", expected %" PRIu64 "\n", name, mode->name,
+			fc->blocks, got, expected);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  frontend_size()
+ *	code footprint of the j'th measurement
+ */
+static inline size_t frontend_size(const size_t j)
+{
+	return opt_frontend_size ? opt_frontend_size : frontend_sizes[j];
+}
+
+/*
+ *  frontend_size_str()
+ *	footprint as NK or NM
+ */
+static void frontend_size_str(char *str, const size_t len, const size_t size)
+{
+	if (size < MB)
+		(void)snprintf(str, len, "%zuK", (size_t)(size / KB));
+	else
+		(void)snprintf(str, len, "%zuM", (size_t)(size / MB));
+}
+
+/*
+ *  frontend_ratio()
+ *	format a counter ratio, or - if the counters were unavailable
+ */
+static void frontend_ratio(
+	char *str,
+	const size_t len,
+	const frontend_stats_t *s,
+	const int num,
+	const int denom,
+	const double scale)
+{
+	if ((num >= 0) && !s->have[num])
+		(void)snprintf(str, len, "%s", "-");
+	else if (denom >= 0 && (!s->have[denom] || !s->counters[denom]))
+		(void)snprintf(str, len, "%s", "-");
+	else
+		(void)snprintf(str, len, "%.3f", scale *
+			(double)s->counters[num] / (denom >= 0 ?
+			(double)s->counters[denom] : (double)s->blocks));
+}
+
+/*
+ *  stress_frontend()
+ *	sweep generated call chains and branch mazes across code
+ *	footprints to pressure the instruction cache, iTLB and
+ *	branch predictors
+ */
+int stress_frontend(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	frontend_stats_t (*stats)[FRONTEND_SIZES];
+	const size_t sizes = opt_frontend_size ? 1 : FRONTEND_SIZES;
+	int fds[FRONTEND_COUNTERS];
+	uint64_t sink = 0;
+	size_t i, j, idx = 0;
+	bool have_perf = false, verify = (opt_flags & OPT_FLAGS_VERIFY);
+	int rc = EXIT_SUCCESS;
+
+	stats = calloc(FRONTEND_MODES, sizeof(*stats));
+	if (!stats) {
+		pr_inf(stderr, "%s: cannot allocate statistics, skipping stressor\n",
+			name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	frontend_perf_open(fds);
+	do {
+		for (i = 0; opt_do_run && (i < FRONTEND_MODES); i++) {
+			const frontend_mode_t *m = &frontend_modes[i];
+
+			if ((opt_frontend_mode != FRONTEND_MODE_ALL) &&
+			    (opt_frontend_mode != (int)i))
+				continue;
+			for (j = 0; opt_do_run && (j < sizes); j++) {
+				frontend_code_t fc;
+
+				(void)memset(&fc, 0, sizeof(fc));
+				if (m->generate(&fc, frontend_size(j)) < 0) {
+					pr_inf(stderr, "%s: cannot map executable "
+						"code, skipping stressor\n", name);
+					frontend_free(&fc);
+					rc = EXIT_NO_RESOURCE;
+					goto done;
+				}
+				if (verify && (frontend_verify(name, m, &fc) < 0)) {
+					frontend_free(&fc);
+					rc = EXIT_FAILURE;
+					goto done;
+				}
+				frontend_measure(&fc, fds, &stats[i][j], &sink);
+				frontend_free(&fc);
+				(*counter)++;
+				if (max_ops && (*counter >= max_ops))
+					goto done;
+			}
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (i = 0; i < FRONTEND_COUNTERS; i++)
+		if (fds[i] >= 0)
+			(void)close(fds[i]);
+	for (i = 0; i < FRONTEND_MODES; i++)
+		for (j = 0; j < FRONTEND_SIZES; j++)
+			have_perf |= stats[i][j].have[FRONTEND_CYCLES];
+
+	if ((instance == 0) && (rc == EXIT_SUCCESS)) {
+		pr_inf(stderr, "%s: %-8s %5s %8s %6s %8s %9s\n", name,
+			"mode", "size", "ns/blk", "IPC", "brmiss%", "iTLB/Kblk");
+		for (i = 0; i < FRONTEND_MODES; i++) {
+			for (j = 0; j < sizes; j++) {
+				const frontend_stats_t *s = &stats[i][j];
+				char size[24], ipc[24], miss[24], itlb[24];
+
+				if (!s->blocks)
+					continue;
+				frontend_size_str(size, sizeof(size), frontend_size(j));
+				frontend_ratio(ipc, sizeof(ipc), s,
+					FRONTEND_INSTRUCTIONS, FRONTEND_CYCLES, 1.0);
+				frontend_ratio(miss, sizeof(miss), s,
+					FRONTEND_BRANCH_MISSES, FRONTEND_BRANCHES, 100.0);
+				frontend_ratio(itlb, sizeof(itlb), s,
+					FRONTEND_ITLB_MISSES, -1, 1000.0);
+				pr_inf(stderr, "%s: %-8s %5s %8.3f %6s %8s %9s\n",
+					name, frontend_modes[i].name, size,
+					(s->duration * 1000000000.0) /
+					(double)s->blocks, ipc, miss, itlb);
+			}
+		}
+		if (!have_perf)
+			pr_inf(stderr, "%s: perf hardware counters not available, "
+				"IPC, branch and iTLB misses not reported\n", name);
+	}
+
+	/* Smallest and largest footprint of each mode */
+	for (i = 0; i < FRONTEND_MODES; i++) {
+		for (j = 0; j < sizes; j += STRESS_MAXIMUM((size_t)1, sizes - 1)) {
+			const frontend_stats_t *s = &stats[i][j];
+			const char *mname = frontend_modes[i].name;
+			char size[24], desc[64];
+
+			if (!s->blocks)
+				continue;
+			frontend_size_str(size, sizeof(size), frontend_size(j));
+			(void)snprintf(desc, sizeof(desc), "%s ns per block at %s",
+				mname, size);
+			stress_misc_metric_set(idx++, desc,
+				(s->duration * 1000000000.0) / (double)s->blocks);
+			if (s->have[FRONTEND_CYCLES] && s->counters[FRONTEND_CYCLES]) {
+				(void)snprintf(desc, sizeof(desc), "%s IPC at %s",
+					mname, size);
+				stress_misc_metric_set(idx++, desc,
+					(double)s->counters[FRONTEND_INSTRUCTIONS] /
+					(double)s->counters[FRONTEND_CYCLES]);
+			}
+		}
+	}
+	pr_dbg(stderr, "%s: sum %" PRIu64 "\n", name, sink);
+	free(stats);
+
+	return rc;
+}
+
+#endif
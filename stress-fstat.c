@@ -35,16 +35,71 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <inttypes.h>
 
 #include "stress-ng.h"
 
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+
+#if defined(__linux__) && defined(__NR_statx) && defined(STATX_TYPE)
+#define FSTAT_HAVE_STATX
+#endif
+
+#define FSTAT_STAT		(0)	/* stat(2) */
+#define FSTAT_LSTAT		(1)	/* lstat(2) */
+#define FSTAT_FSTAT		(2)	/* fstat(2) on an open fd */
+#define FSTAT_STATX		(3)	/* statx(2), basic stats */
+#define FSTAT_STATX_MIN		(4)	/* statx(2), type only, don't sync */
+#define FSTAT_CALLS		(5)
+
+#define FSTAT_SAMPLE_TIME	(0.1)	/* thread ops sample period, secs */
+
+static const char *fstat_call_names[FSTAT_CALLS] = {
+	"stat", "lstat", "fstat", "statx", "statx-min"
+};
+
+/* A file to stat, shared by all the threads */
+typedef struct {
+	char	*path;
+	bool	ignore;
+	bool	noaccess;
+} fstat_file_t;
+
+/* Per thread stat call counts and times */
+typedef struct {
+	uint64_t calls[FSTAT_CALLS];	/* calls made */
+	double	duration[FSTAT_CALLS];	/* time in each call */
+	uint64_t ops;			/* files stat'd */
+} fstat_stats_t;
+
 static const char *opt_fstat_dir = "/dev";
+#if defined(HAVE_LIB_PTHREAD)
+static uint32_t opt_fstat_pthreads = DEFAULT_FSTAT_PTHREADS;
+#endif
+
+static fstat_file_t *fstat_files;	/* files in opt_fstat_dir */
+static size_t fstat_nfiles;		/* number of files */
+static volatile bool fstat_stop;	/* tells threads to stop */
+static uint64_t fstat_thread_ops;	/* ops by all threads */
+static uint64_t fstat_max_ops;		/* thread ops limit, 0 = none */
 
 void stress_set_fstat_dir(const char *optarg)
 {
 	opt_fstat_dir = optarg;
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+void stress_set_fstat_pthreads(const char *optarg)
+{
+	opt_fstat_pthreads = (uint32_t)get_uint64(optarg);
+	check_range("fstat-pthreads", opt_fstat_pthreads,
+		MIN_FSTAT_PTHREADS, MAX_FSTAT_PTHREADS);
+}
+#endif
+
 static const char *blacklist[] = {
 	"/dev/watchdog"
 };
@@ -64,9 +119,243 @@ static bool do_not_stat(const char *filename)
 	return false;
 }
 
+#if defined(FSTAT_HAVE_STATX)
+static inline int sys_statx(
+	const int dfd,
+	const char *filename,
+	const int flags,
+	const unsigned int mask,
+	struct statx *buffer)
+{
+	return syscall(__NR_statx, dfd, filename, flags, mask, buffer);
+}
+#endif
+
+/*
+ *  fstat_account()
+ *	account a call that started at t
+ */
+static inline void fstat_account(
+	fstat_stats_t *stats,
+	const int call,
+	const double t)
+{
+	stats->duration[call] += time_now() - t;
+	stats->calls[call]++;
+}
+
+/*
+ *  stress_fstat_file()
+ *	stat a file every way we can, false if it can no longer
+ *	be stat'd
+ */
+static bool stress_fstat_file(fstat_file_t *file, fstat_stats_t *stats)
+{
+	int fd, ret;
+	struct stat buf;
+	double t;
+#if defined(FSTAT_HAVE_STATX)
+	struct statx bufx;
+#endif
+
+	t = time_now();
+	ret = stat(file->path, &buf);
+	fstat_account(stats, FSTAT_STAT, t);
+	if ((ret < 0) && (errno != ENOMEM))
+		return false;
+
+	t = time_now();
+	ret = lstat(file->path, &buf);
+	fstat_account(stats, FSTAT_LSTAT, t);
+	if ((ret < 0) && (errno != ENOMEM))
+		return false;
+
+#if defined(FSTAT_HAVE_STATX)
+	t = time_now();
+	ret = sys_statx(AT_FDCWD, file->path, AT_STATX_SYNC_AS_STAT,
+		STATX_BASIC_STATS, &bufx);
+	if (ret == 0)
+		fstat_account(stats, FSTAT_STATX, t);
+
+	/*
+	 *  What a build system wants, the type and size without
+	 *  forcing remote filesystems to revalidate
+	 */
+	t = time_now();
+	ret = sys_statx(AT_FDCWD, file->path, AT_STATX_DONT_SYNC,
+		STATX_TYPE | STATX_SIZE, &bufx);
+	if (ret == 0)
+		fstat_account(stats, FSTAT_STATX_MIN, t);
+#endif
+	if (file->noaccess)
+		return true;
+
+	fd = open(file->path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0) {
+		file->noaccess = true;
+		return true;
+	}
+	t = time_now();
+	ret = fstat(fd, &buf);
+	fstat_account(stats, FSTAT_FSTAT, t);
+	(void)close(fd);
+
+	return (ret == 0) || (errno == ENOMEM);
+}
+
+/*
+ *  stress_fstat_pass()
+ *	stat all the files once, starting at file start,
+ *	false if there was nothing left to stat
+ */
+static bool stress_fstat_pass(
+	fstat_stats_t *stats,
+	const size_t start,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	bool stat_some = false;
+	size_t i;
+
+	for (i = 0; i < fstat_nfiles; i++) {
+		fstat_file_t *file = &fstat_files[(start + i) % fstat_nfiles];
+
+		if (file->ignore)
+			continue;
+		if (!stress_fstat_file(file, stats)) {
+			file->ignore = true;
+			continue;
+		}
+		stat_some = true;
+		stats->ops++;
+		if (counter)
+			(*counter)++;
+		else if (fstat_max_ops &&
+			 (__sync_add_and_fetch(&fstat_thread_ops, 1) >= fstat_max_ops))
+			fstat_stop = true;
+		if (!opt_do_run || fstat_stop ||
+		    (counter && max_ops && *counter >= max_ops))
+			break;
+	}
+	return stat_some;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+typedef struct {
+	pthread_t pthread;		/* thread handle */
+	int ret;			/* pthread_create return */
+	size_t start;			/* first file to stat */
+	volatile bool done;		/* thread has finished */
+	fstat_stats_t stats;		/* calls made by the thread */
+} fstat_thread_t;
+
+/*
+ *  stress_fstat_thread()
+ *	stat the shared file set until told to stop
+ */
+static void *stress_fstat_thread(void *arg)
+{
+	fstat_thread_t *thread = (fstat_thread_t *)arg;
+
+	while (opt_do_run && !fstat_stop) {
+		if (!stress_fstat_pass(&thread->stats, thread->start, NULL, 0))
+			break;
+	}
+	thread->done = true;
+
+	return NULL;
+}
+
+/*
+ *  stress_fstat_pthreads()
+ *	stat the file set from opt_fstat_pthreads threads, each
+ *	starting at a different file, adding their calls to stats
+ */
+static int stress_fstat_pthreads(
+	fstat_stats_t *stats,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const char *name)
+{
+	fstat_thread_t *threads;
+	const uint64_t base = *counter;
+	uint32_t i, started = 0;
+	int j;
+
+	threads = calloc(opt_fstat_pthreads, sizeof(*threads));
+	if (!threads) {
+		pr_inf(stderr, "%s: cannot allocate thread state\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	fstat_stop = false;
+	fstat_thread_ops = 0;
+	fstat_max_ops = (max_ops > base) ? max_ops - base : 0;
+	if (max_ops && !fstat_max_ops)
+		fstat_stop = true;
+	for (i = 0; i < opt_fstat_pthreads; i++) {
+		threads[i].start = (fstat_nfiles * i) / opt_fstat_pthreads;
+		threads[i].ret = pthread_create(&threads[i].pthread,
+			NULL, stress_fstat_thread, &threads[i]);
+		if (threads[i].ret == 0)
+			started++;
+	}
+	if (!started) {
+		pr_fail_err(name, "pthread_create");
+		free(threads);
+		return EXIT_FAILURE;
+	}
+
+	do {
+		uint64_t ops = 0;
+		bool running = false;
+
+		(void)usleep((useconds_t)(FSTAT_SAMPLE_TIME * 1000000.0));
+		for (i = 0; i < opt_fstat_pthreads; i++) {
+			ops += threads[i].stats.ops;
+			running |= (threads[i].ret == 0) && !threads[i].done;
+		}
+		*counter = base + ops;
+		if (!running)
+			break;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	fstat_stop = true;
+	*counter = base;
+	for (i = 0; i < opt_fstat_pthreads; i++) {
+		if (threads[i].ret)
+			continue;
+		(void)pthread_join(threads[i].pthread, NULL);
+		for (j = 0; j < FSTAT_CALLS; j++) {
+			stats->calls[j] += threads[i].stats.calls[j];
+			stats->duration[j] += threads[i].stats.duration[j];
+		}
+		stats->ops += threads[i].stats.ops;
+		*counter += threads[i].stats.ops;
+	}
+	free(threads);
+
+	return EXIT_SUCCESS;
+}
+#endif
+
+/*
+ *  fstat_calls()
+ *	total stat calls made
+ */
+static uint64_t fstat_calls(const fstat_stats_t *stats)
+{
+	uint64_t calls = 0;
+	int i;
+
+	for (i = 0; i < FSTAT_CALLS; i++)
+		calls += stats->calls[i];
+	return calls;
+}
+
 /*
  *  stress_fstat()
- *	stress system with fstat
+ *	stress system with fstat, lstat, stat and statx
  */
 int stress_fstat(
 	uint64_t *const counter,
@@ -74,20 +363,20 @@ int stress_fstat(
 	const uint64_t max_ops,
 	const char *name)
 {
-	typedef struct dir_info {
-		char	*path;
-		bool	ignore;
-		bool	noaccess;
-		struct dir_info *next;
-	} dir_info_t;
-
 	DIR *dp;
-	dir_info_t *dir_info = NULL, *di;
 	struct dirent *d;
 	int ret = EXIT_FAILURE;
-	bool stat_some;
+	size_t i, max_files = 0;
+	fstat_stats_t stats, cold;
+	double t, cold_rate = -1.0, warm_rate;
+	uint32_t threads = 0;
+	size_t idx;
 
-	(void)instance;
+#if defined(HAVE_LIB_PTHREAD)
+	threads = opt_fstat_pthreads;
+#endif
+	(void)memset(&stats, 0, sizeof(stats));
+	(void)memset(&cold, 0, sizeof(cold));
 
 	if ((dp = opendir(opt_fstat_dir)) == NULL) {
 		pr_err(stderr, "%s: opendir on %s failed: errno=%d: (%s)\n",
@@ -96,82 +385,111 @@ int stress_fstat(
 	}
 
 	/* Cache all the directory entries */
+	fstat_files = NULL;
+	fstat_nfiles = 0;
 	while ((d = readdir(dp)) != NULL) {
 		char path[PATH_MAX];
+		fstat_file_t *file;
 
 		snprintf(path, sizeof(path), "%s/%s", opt_fstat_dir, d->d_name);
 		if (do_not_stat(path))
 			continue;
-		if ((di = calloc(1, sizeof(*di))) == NULL) {
-			pr_err(stderr, "%s: out of memory\n", name);
-			(void)closedir(dp);
-			goto free_cache;
+		if (fstat_nfiles == max_files) {
+			const size_t n = max_files ? max_files * 2 : 64;
+
+			file = realloc(fstat_files, n * sizeof(*fstat_files));
+			if (!file) {
+				pr_err(stderr, "%s: out of memory\n", name);
+				(void)closedir(dp);
+				goto free_cache;
+			}
+			fstat_files = file;
+			max_files = n;
 		}
-		if ((di->path = strdup(path)) == NULL) {
+		file = &fstat_files[fstat_nfiles];
+		if ((file->path = strdup(path)) == NULL) {
 			pr_err(stderr, "%s: out of memory\n", name);
-			free(di);
 			(void)closedir(dp);
 			goto free_cache;
 		}
-		di->ignore = false;
-		di->noaccess = false;
-		di->next = dir_info;
-		dir_info = di;
+		file->ignore = false;
+		file->noaccess = false;
+		fstat_nfiles++;
 	}
 	(void)closedir(dp);
 
-	do {
-		stat_some = false;
-
-		for (di = dir_info; di; di = di->next) {
-			int fd;
-			struct stat buf;
-
-			if (di->ignore)
-				continue;
+	/*
+	 *  One pass with cold dentry and inode caches, instance 0
+	 *  only as dropping the caches stalls all the instances
+	 */
+	if ((instance == 0) && (stress_drop_caches() == 0)) {
+		t = time_now();
+		(void)stress_fstat_pass(&cold, 0, counter, max_ops);
+		t = time_now() - t;
+		if (t > 0.0)
+			cold_rate = (double)fstat_calls(&cold) / t;
+	}
 
-			if ((stat(di->path, &buf) < 0) &&
-			    (errno != ENOMEM)) {
-				di->ignore = true;
-				continue;
-			}
-			if ((lstat(di->path, &buf) < 0) &&
-			    (errno != ENOMEM)) {
-				di->ignore = true;
-				continue;
-			}
-			if (di->noaccess)
-				continue;
+	t = time_now();
+#if defined(HAVE_LIB_PTHREAD)
+	if (threads) {
+		ret = stress_fstat_pthreads(&stats, counter, max_ops, name);
+		if (ret != EXIT_SUCCESS)
+			goto free_cache;
+	} else
+#endif
+	{
+		while (opt_do_run && (!max_ops || *counter < max_ops)) {
+			if (!stress_fstat_pass(&stats, 0, counter, max_ops))
+				break;
+		}
+	}
+	t = time_now() - t;
+	warm_rate = (t > 0.0) ? (double)fstat_calls(&stats) / t : 0.0;
 
-			fd = open(di->path, O_RDONLY | O_NONBLOCK);
-			if (fd < 0) {
-				di->noaccess = true;
+	if (instance == 0) {
+		pr_inf(stderr, "%s: %-10s %12s %10s\n", name,
+			"call", "calls", "ns/call");
+		for (i = 0; i < FSTAT_CALLS; i++) {
+			if (!stats.calls[i])
 				continue;
-			}
-
-			if ((fstat(fd, &buf) < 0) &&
-			    (errno != ENOMEM))
-				di->ignore = true;
-			(void)close(fd);
-
-			stat_some = true;
-
-			(*counter)++;
-			if (!opt_do_run || (max_ops && *counter >= max_ops))
-				break;
+			pr_inf(stderr, "%s: %-10s %12" PRIu64 " %10.1f\n", name,
+				fstat_call_names[i], stats.calls[i],
+				stats.duration[i] * 1000000000.0 /
+				(double)stats.calls[i]);
 		}
-	} while (stat_some && opt_do_run && (!max_ops || *counter < max_ops));
+		pr_inf(stderr, "%s: %.0f stat calls/sec warm with %" PRIu32
+			" thread%s over %zu files\n", name, warm_rate,
+			threads ? threads : 1, threads > 1 ? "s" : "",
+			fstat_nfiles);
+		if (cold_rate >= 0.0)
+			pr_inf(stderr, "%s: %.0f stat calls/sec cold, first pass "
+				"after dropping caches\n", name, cold_rate);
+		else
+			pr_inf(stderr, "%s: cannot drop caches (needs root), "
+				"no cold pass\n", name);
+	}
+	for (idx = 0, i = 0; i < FSTAT_CALLS; i++) {
+		char desc[32];
+
+		if (!stats.calls[i])
+			continue;
+		(void)snprintf(desc, sizeof(desc), "ns per %s call",
+			fstat_call_names[i]);
+		stress_misc_metric_set(idx++, desc,
+			stats.duration[i] * 1000000000.0 / (double)stats.calls[i]);
+	}
+	stress_misc_metric_set(idx++, "warm stat calls per sec", warm_rate);
+	if (cold_rate >= 0.0)
+		stress_misc_metric_set(idx++, "cold stat calls per sec", cold_rate);
 
 	ret = EXIT_SUCCESS;
 free_cache:
 	/* Free cache */
-	for (di = dir_info; di; ) {
-		dir_info_t *next = di->next;
-
-		free(di->path);
-		free(di);
-		di = next;
-	}
+	for (i = 0; i < fstat_nfiles; i++)
+		free(fstat_files[i].path);
+	free(fstat_files);
+	fstat_files = NULL;
 
 	return ret;
 }
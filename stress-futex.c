@@ -42,6 +42,11 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/syscall.h>
+#include <limits.h>
+#include <sched.h>
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
 
 #define THRESHOLD	(100000)
 
@@ -66,6 +71,350 @@ static inline int futex_wait(
 	return syscall(SYS_futex, futex, FUTEX_WAIT, val, timeout, NULL, 0);
 }
 
+#define FUTEX_MODE_WAKE		(0)	/* FUTEX_WAKE of the waiters */
+#define FUTEX_MODE_REQUEUE	(1)	/* FUTEX_CMP_REQUEUE then FUTEX_WAKE */
+#define FUTEX_MODE_WAKE_OP	(2)	/* FUTEX_WAKE_OP across two futexes */
+#define FUTEX_MODE_PI		(3)	/* PI lock hand-offs */
+
+typedef struct {
+	const char *name;	/* User option */
+	int mode;		/* FUTEX_MODE_ value */
+} futex_mode_t;
+
+static const futex_mode_t futex_modes[] = {
+	{ "wake",	FUTEX_MODE_WAKE },
+	{ "requeue",	FUTEX_MODE_REQUEUE },
+	{ "wake-op",	FUTEX_MODE_WAKE_OP },
+	{ "pi",		FUTEX_MODE_PI },
+};
+
+static int opt_futex_mode = FUTEX_MODE_WAKE;
+static uint32_t opt_futex_waiters = DEFAULT_FUTEX_WAITERS;
+static uint32_t opt_futex_wake = 0;	/* 0 = wake all */
+static bool futex_herd_mode = false;
+
+/*
+ *  stress_set_futex_mode()
+ *	set the waiter herd futex operations
+ */
+int stress_set_futex_mode(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(futex_modes); i++) {
+		if (!strcmp(name, futex_modes[i].name)) {
+			opt_futex_mode = futex_modes[i].mode;
+			futex_herd_mode = true;
+			return 0;
+		}
+	}
+	fprintf(stderr, "futex-mode must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(futex_modes); i++)
+		fprintf(stderr, " %s", futex_modes[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_futex_waiters()
+ *	set the number of waiter threads on one futex
+ */
+void stress_set_futex_waiters(const char *optarg)
+{
+	opt_futex_waiters = (uint32_t)get_uint64(optarg);
+	check_range("futex-waiters", opt_futex_waiters,
+		MIN_FUTEX_WAITERS, MAX_FUTEX_WAITERS);
+	futex_herd_mode = true;
+}
+
+/*
+ *  stress_set_futex_wake()
+ *	set the number of waiters woken by each wake
+ */
+void stress_set_futex_wake(const char *optarg)
+{
+	opt_futex_wake = (uint32_t)get_uint64(optarg);
+	check_range("futex-wake", opt_futex_wake,
+		1, MAX_FUTEX_WAITERS);
+	futex_herd_mode = true;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+
+#define FUTEX_HERD_POLL_NS	(100000000)	/* waiter stop check period */
+
+/* A waiter thread */
+typedef struct {
+	pthread_t pthread;		/* waiter thread */
+	uint32_t index;			/* waiter number */
+	int ret;			/* pthread_create return */
+	stress_latency_t lat;		/* wake to run latencies */
+} futex_waiter_t;
+
+/* State shared by the waker and the waiter threads */
+static struct {
+	uint32_t word[2];		/* wake futexes, word[1] for requeue/wake-op */
+	uint32_t pi_lock;		/* PI futex, owner TID or 0 */
+	uint32_t ready;			/* waiters armed, all rounds */
+	uint32_t woken;			/* waiters woken, all rounds */
+	uint64_t t_wake;		/* time of the last wake, ns */
+	bool stop;			/* waiters should exit */
+} futex_herd;
+
+static inline long futex_herd_call(
+	uint32_t *futex,
+	const int op,
+	const uint32_t val,
+	const void *timeout_or_val2,
+	uint32_t *futex2,
+	const uint32_t val3)
+{
+	return syscall(SYS_futex, futex, op, val, timeout_or_val2, futex2, val3);
+}
+
+/*
+ *  futex_herd_pi_waiter()
+ *	hand a PI lock from waiter to waiter, the time from
+ *	an unlock to a blocked waiter owning the lock is the
+ *	wake to run latency
+ */
+static void futex_herd_pi_waiter(futex_waiter_t *w)
+{
+	const uint32_t tid = (uint32_t)syscall(SYS_gettid);
+
+	while (!__atomic_load_n(&futex_herd.stop, __ATOMIC_ACQUIRE)) {
+		uint32_t unlocked = 0;
+		bool blocked = false;
+
+		if (!__atomic_compare_exchange_n(&futex_herd.pi_lock, &unlocked,
+		    tid, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			struct timespec ts;
+
+			/* FUTEX_LOCK_PI takes an absolute CLOCK_REALTIME timeout */
+			(void)clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += FUTEX_HERD_POLL_NS;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_nsec -= 1000000000;
+				ts.tv_sec++;
+			}
+			if (futex_herd_call(&futex_herd.pi_lock,
+			    FUTEX_LOCK_PI_PRIVATE, 0, &ts, NULL, 0) < 0)
+				continue;
+			blocked = true;
+		}
+		if (blocked)
+			latency_record(&w->lat, time_now_ns() -
+				__atomic_load_n(&futex_herd.t_wake, __ATOMIC_RELAXED));
+		__atomic_add_fetch(&futex_herd.woken, 1, __ATOMIC_RELAXED);
+
+		__atomic_store_n(&futex_herd.t_wake, time_now_ns(), __ATOMIC_RELAXED);
+		unlocked = tid;
+		if (!__atomic_compare_exchange_n(&futex_herd.pi_lock, &unlocked,
+		    0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			(void)futex_herd_call(&futex_herd.pi_lock,
+				FUTEX_UNLOCK_PI_PRIVATE, 0, NULL, NULL, 0);
+	}
+}
+
+/*
+ *  futex_herd_waiter()
+ *	arm, wait for the round to change and record the
+ *	time from the wake up to running again
+ */
+static void *futex_herd_waiter(void *arg)
+{
+	futex_waiter_t *w = (futex_waiter_t *)arg;
+	uint32_t *word = &futex_herd.word[0];
+	uint32_t seen;
+	static void *nowt = NULL;
+
+	if (opt_futex_mode == FUTEX_MODE_PI) {
+		futex_herd_pi_waiter(w);
+		return &nowt;
+	}
+	if (opt_futex_mode == FUTEX_MODE_WAKE_OP)
+		word = &futex_herd.word[w->index & 1];
+
+	seen = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+	while (!__atomic_load_n(&futex_herd.stop, __ATOMIC_ACQUIRE)) {
+		const struct timespec t = { .tv_sec = 0, .tv_nsec = FUTEX_HERD_POLL_NS };
+
+		__atomic_add_fetch(&futex_herd.ready, 1, __ATOMIC_RELEASE);
+		while ((__atomic_load_n(word, __ATOMIC_ACQUIRE) == seen) &&
+		       !__atomic_load_n(&futex_herd.stop, __ATOMIC_ACQUIRE))
+			(void)futex_herd_call(word, FUTEX_WAIT_PRIVATE, seen, &t, NULL, 0);
+
+		latency_record(&w->lat, time_now_ns() -
+			__atomic_load_n(&futex_herd.t_wake, __ATOMIC_RELAXED));
+		seen = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+		__atomic_add_fetch(&futex_herd.woken, 1, __ATOMIC_RELEASE);
+	}
+	return &nowt;
+}
+
+/*
+ *  futex_herd_round()
+ *	wake all the armed waiters, nr at a time, returns the
+ *	number of futex calls it took
+ */
+static uint64_t futex_herd_round(const uint32_t target, const uint32_t nr)
+{
+	const int op = FUTEX_OP(FUTEX_OP_ADD, 1, FUTEX_OP_CMP_GE, 0);
+	uint64_t calls = 1;
+	uint32_t val;
+
+	val = __atomic_add_fetch(&futex_herd.word[0], 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&futex_herd.t_wake, time_now_ns(), __ATOMIC_RELAXED);
+
+	switch (opt_futex_mode) {
+	case FUTEX_MODE_REQUEUE:
+		/* Wake nr, move the rest over to word[1] */
+		(void)futex_herd_call(&futex_herd.word[0], FUTEX_CMP_REQUEUE_PRIVATE,
+			nr, (void *)(uintptr_t)INT_MAX, &futex_herd.word[1], val);
+		break;
+	case FUTEX_MODE_WAKE_OP:
+		/* Wake nr on word[0], bump word[1] and wake nr on it */
+		(void)futex_herd_call(&futex_herd.word[0], FUTEX_WAKE_OP_PRIVATE,
+			nr, (void *)(uintptr_t)nr, &futex_herd.word[1], op);
+		break;
+	default:
+		(void)futex_herd_call(&futex_herd.word[0], FUTEX_WAKE_PRIVATE,
+			nr, NULL, NULL, 0);
+		break;
+	}
+
+	/* Waiters that were armed but not asleep see the new value */
+	while (opt_do_run &&
+	       (__atomic_load_n(&futex_herd.woken, __ATOMIC_ACQUIRE) < target)) {
+		long n = 0;
+
+		if (opt_futex_mode != FUTEX_MODE_WAKE)
+			n += futex_herd_call(&futex_herd.word[1], FUTEX_WAKE_PRIVATE,
+				nr, NULL, NULL, 0);
+		if (opt_futex_mode != FUTEX_MODE_REQUEUE)
+			n += futex_herd_call(&futex_herd.word[0], FUTEX_WAKE_PRIVATE,
+				nr, NULL, NULL, 0);
+		calls++;
+		if (n <= 0)
+			(void)sched_yield();
+	}
+	return calls;
+}
+
+/*
+ *  stress_futex_herd()
+ *	N waiter threads on one futex woken nr at a time, or
+ *	handing a PI futex between them, reports the wake ups
+ *	per second and the wake to run latencies
+ */
+static int stress_futex_herd(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const uint32_t n = opt_futex_waiters;
+	const uint32_t nr = (opt_futex_wake && (opt_futex_wake < n)) ?
+		opt_futex_wake : n;
+	futex_waiter_t *waiters;
+	stress_latency_t *lat;
+	uint64_t rounds = 0, calls = 0;
+	uint32_t i, started = 0;
+	double t_start, duration;
+	int rc = EXIT_SUCCESS;
+
+	waiters = calloc(n, sizeof(*waiters));
+	lat = calloc(1, sizeof(*lat));
+	if (!waiters || !lat) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " waiters\n",
+			name, n);
+		free(waiters);
+		free(lat);
+		return EXIT_NO_RESOURCE;
+	}
+	memset(&futex_herd, 0, sizeof(futex_herd));
+
+	for (i = 0; i < n; i++) {
+		waiters[i].index = i;
+		waiters[i].ret = pthread_create(&waiters[i].pthread, NULL,
+			futex_herd_waiter, &waiters[i]);
+		if (waiters[i].ret)
+			break;
+		started++;
+	}
+	if (started < n) {
+		pr_inf(stderr, "%s: only %" PRIu32 " of %" PRIu32
+			" waiter threads started\n", name, started, n);
+		if (!started) {
+			rc = EXIT_NO_RESOURCE;
+			goto free_waiters;
+		}
+	}
+
+	t_start = time_now();
+	do {
+		if (opt_futex_mode == FUTEX_MODE_PI) {
+			/* The waiters hand the lock around themselves */
+			(void)usleep(10000);
+			*counter = __atomic_load_n(&futex_herd.woken, __ATOMIC_RELAXED);
+			continue;
+		}
+		/* Wait for all the waiters to arm for this round */
+		while (opt_do_run && (__atomic_load_n(&futex_herd.ready,
+		       __ATOMIC_ACQUIRE) < (rounds + 1) * started))
+			(void)sched_yield();
+		if (!opt_do_run)
+			break;
+		calls += futex_herd_round((uint32_t)((rounds + 1) * started), nr);
+		rounds++;
+		*counter = __atomic_load_n(&futex_herd.woken, __ATOMIC_RELAXED);
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+	duration = time_now() - t_start;
+
+	__atomic_store_n(&futex_herd.stop, true, __ATOMIC_RELEASE);
+	(void)__atomic_add_fetch(&futex_herd.word[0], 1, __ATOMIC_RELEASE);
+	(void)__atomic_add_fetch(&futex_herd.word[1], 1, __ATOMIC_RELEASE);
+	(void)futex_herd_call(&futex_herd.word[0], FUTEX_WAKE_PRIVATE,
+		INT_MAX, NULL, NULL, 0);
+	(void)futex_herd_call(&futex_herd.word[1], FUTEX_WAKE_PRIVATE,
+		INT_MAX, NULL, NULL, 0);
+
+	for (i = 0; i < started; i++) {
+		size_t j;
+
+		(void)pthread_join(waiters[i].pthread, NULL);
+		for (j = 0; j < LATENCY_BUCKETS; j++)
+			lat->bucket[j] += waiters[i].lat.bucket[j];
+		lat->count += waiters[i].lat.count;
+		if (waiters[i].lat.max > lat->max)
+			lat->max = waiters[i].lat.max;
+	}
+	*counter = futex_herd.woken;
+
+	if (duration > 0.0)
+		stress_misc_metric_set(0, "wakeups per sec",
+			(double)futex_herd.woken / duration);
+	if (lat->count) {
+		stress_misc_metric_set(1, "wake to run p50 (usec)",
+			(double)latency_percentile(lat, 0.50) / 1000.0);
+		stress_misc_metric_set(2, "wake to run p99 (usec)",
+			(double)latency_percentile(lat, 0.99) / 1000.0);
+	}
+	if (rounds)
+		stress_misc_metric_set(3, "futex calls per round",
+			(double)calls / (double)rounds);
+	if (instance == 0)
+		pr_dbg(stderr, "%s: %" PRIu32 " waiters, waking %" PRIu32
+			" at a time\n", name, started, nr);
+
+free_waiters:
+	free(waiters);
+	free(lat);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_fuxex()
  *	stress system by futex calls. The intention is not to
@@ -82,6 +431,16 @@ int stress_futex(
 	uint32_t *futex = &shared->futex.futex[instance];
 	pid_t pid;
 
+	if (futex_herd_mode) {
+#if defined(HAVE_LIB_PTHREAD)
+		return stress_futex_herd(counter, instance, max_ops, name);
+#else
+		if (instance == 0)
+			pr_inf(stderr, "%s: waiter herd modes need pthreads, "
+				"using the waiter/waker pair\n", name);
+#endif
+	}
+
 again:
 	pid = fork();
 	if (pid < 0) {
@@ -128,12 +487,14 @@ again:
 		do {
 			/* Small timeout to force rapid timer wakeups */
 			const struct timespec t = { .tv_sec = 0, .tv_nsec = 5000 };
+			uint64_t t_lat;
 			int ret;
 
 			/* Break early before potential long wait */
 			if (!opt_do_run)
 				break;
 
+			t_lat = latency_begin(*counter);
 			ret = futex_wait(futex, 0, &t);
 
 			/* timeout, re-do, stress on stupid fast polling */
@@ -152,6 +513,7 @@ again:
 						"failed: errno=%d (%s)\n",
 						name, errno, strerror(errno));
 				}
+				latency_end(t_lat);
 				(*counter)++;
 			}
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
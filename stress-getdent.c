@@ -30,6 +30,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -38,6 +40,23 @@
 #include <sys/types.h>
 
 #define BUF_SIZE	(256 * 1024)
+#define LARGE_ORDER_MAX	(1024 * 1024)	/* max entries in the order test */
+#define LARGE_PATH_MAX	(PATH_MAX + 16)	/* dir + "/f" + 8 hex digits */
+
+/* getdents64 buffer sizes swept over a large directory */
+static const size_t large_buf_sizes[] = {
+	1 * KB, 4 * KB, 16 * KB, 64 * KB, 256 * KB, 1 * MB
+};
+
+#define LARGE_BUF_SIZES	(SIZEOF_ARRAY(large_buf_sizes))
+
+/* An entry of a large directory in getdents order */
+typedef struct {
+	uint64_t ino;			/* inode number */
+	uint32_t idx;			/* file number, from the name */
+} large_entry_t;
+
+static uint64_t opt_getdent_entries = 0;	/* 0 = walk system dirs */
 
 struct linux_dirent {
 	unsigned long  d_ino;     	/* Inode number */
@@ -295,6 +314,287 @@ exit_close:
 }
 #endif
 
+void stress_set_getdent_entries(const char *optarg)
+{
+	opt_getdent_entries = get_uint64(optarg);
+	check_range("getdent-entries", opt_getdent_entries,
+		MIN_GETDENT_ENTRIES, MAX_GETDENT_ENTRIES);
+}
+
+/*
+ *  large_filename()
+ *	name of the n'th file of the large directory
+ */
+static inline void large_filename(
+	char *path,
+	const size_t len,
+	const char *dir,
+	const uint32_t n)
+{
+	(void)snprintf(path, len, "%s/f%08" PRIx32, dir, n);
+}
+
+/*
+ *  large_read()
+ *	read the whole directory with a buf_sz getdents64 buffer,
+ *	returns the entries read or -1 on error, optionally saving
+ *	the order of up to LARGE_ORDER_MAX entries
+ */
+static int64_t large_read(
+	const int fd,
+	char *buf,
+	const size_t buf_sz,
+	uint64_t *calls,
+	large_entry_t *order,
+	size_t *n_order)
+{
+	int64_t entries = 0;
+
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		return -1;
+	*calls = 0;
+	for (;;) {
+		int nread;
+		char *ptr;
+
+		nread = sys_getdents64(fd, (struct linux_dirent64 *)buf, buf_sz);
+		if (nread < 0)
+			return -1;
+		(*calls)++;
+		if (nread == 0)
+			break;
+		for (ptr = buf; ptr < buf + nread; entries++) {
+			const struct linux_dirent64 *d = (struct linux_dirent64 *)ptr;
+
+			if (order && (*n_order < LARGE_ORDER_MAX) &&
+			    (d->d_name[0] == 'f')) {
+				order[*n_order].ino = (uint64_t)d->d_ino;
+				order[*n_order].idx =
+					(uint32_t)strtoul(d->d_name + 1, NULL, 16);
+				(*n_order)++;
+			}
+			ptr += d->d_reclen;
+		}
+		if (!opt_do_run)
+			return -1;
+	}
+	return entries;
+}
+
+static int large_ino_cmp(const void *p1, const void *p2)
+{
+	const large_entry_t *e1 = (const large_entry_t *)p1;
+	const large_entry_t *e2 = (const large_entry_t *)p2;
+
+	return (e1->ino > e2->ino) - (e1->ino < e2->ino);
+}
+
+/*
+ *  large_stat_rate()
+ *	stat the entries in the given order, entries per second
+ */
+static double large_stat_rate(
+	const char *dir,
+	const large_entry_t *order,
+	const size_t n)
+{
+	double t;
+	size_t i;
+
+	t = time_now();
+	for (i = 0; opt_do_run && (i < n); i++) {
+		char path[LARGE_PATH_MAX];
+		struct stat statbuf;
+
+		large_filename(path, sizeof(path), dir, order[i].idx);
+		(void)stat(path, &statbuf);
+	}
+	t = time_now() - t;
+	return (t > 0.0) ? (double)i / t : 0.0;
+}
+
+/*
+ *  large_unlink()
+ *	remove the first n files of the large directory
+ */
+static void large_unlink(const char *dir, const uint64_t n)
+{
+	uint64_t i;
+
+	for (i = 0; i < n; i++) {
+		char path[LARGE_PATH_MAX];
+
+		large_filename(path, sizeof(path), dir, (uint32_t)i);
+		(void)unlink(path);
+	}
+}
+
+/*
+ *  stress_getdent_large()
+ *	build a directory of --getdent-entries files then time
+ *	reading it with a range of getdents64 buffer sizes, the
+ *	first read after dropping caches and stat in getdents
+ *	(hash) order against inode order
+ */
+static int stress_getdent_large(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const pid_t pid = getpid();
+	char dir[PATH_MAX], *buf;
+	large_entry_t *order;
+	size_t n_order = 0, i, idx = 0;
+	uint64_t n, calls, calls_total[LARGE_BUF_SIZES];
+	double duration[LARGE_BUF_SIZES], cold = -1.0, t;
+	uint64_t entries_total[LARGE_BUF_SIZES];
+	double inversions = 0.0, stat_hash = 0.0, stat_ino = 0.0;
+	bool cold_caches = false;
+	int fd, ret, rc = EXIT_SUCCESS;
+	int64_t entries;
+
+	ret = stress_temp_dir_mk(name, pid, instance);
+	if (ret < 0)
+		return exit_status(-ret);
+	(void)stress_temp_dir(dir, sizeof(dir), name, pid, instance);
+
+	buf = malloc(large_buf_sizes[LARGE_BUF_SIZES - 1]);
+	order = calloc(STRESS_MINIMUM(opt_getdent_entries, LARGE_ORDER_MAX),
+		sizeof(*order));
+	if (!buf || !order) {
+		pr_inf(stderr, "%s: cannot allocate buffers, skipping stressor\n",
+			name);
+		rc = EXIT_NO_RESOURCE;
+		n = 0;
+		goto tidy;
+	}
+
+	for (n = 0; opt_do_run && (n < opt_getdent_entries); n++) {
+		char path[LARGE_PATH_MAX];
+
+		large_filename(path, sizeof(path), dir, (uint32_t)n);
+		fd = open(path, O_CREAT | O_EXCL | O_WRONLY, S_IRUSR | S_IWUSR);
+		if (fd < 0) {
+			if ((errno != ENOSPC) && (errno != EDQUOT)) {
+				pr_fail_err(name, "open");
+				rc = EXIT_FAILURE;
+			}
+			break;
+		}
+		(void)close(fd);
+	}
+	if (!opt_do_run || (rc != EXIT_SUCCESS))
+		goto tidy;
+	if ((n < opt_getdent_entries) && (instance == 0))
+		pr_inf(stderr, "%s: filesystem full, using %" PRIu64
+			" entries\n", name, n);
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (fd < 0) {
+		pr_fail_err(name, "open");
+		rc = EXIT_FAILURE;
+		goto tidy;
+	}
+
+	/* First read with cold dentry and inode caches */
+	cold_caches = (stress_drop_caches() == 0);
+	t = time_now();
+	entries = large_read(fd, buf, 32 * KB, &calls, order, &n_order);
+	if (entries < 0)
+		goto close_dir;
+	if (cold_caches)
+		cold = time_now() - t;
+
+	/*
+	 *  Fraction of neighbouring entries that go backwards in
+	 *  inode order, ~0.5 for a hash ordered directory
+	 */
+	for (i = 1; i < n_order; i++)
+		inversions += (order[i].ino < order[i - 1].ino);
+	if (n_order > 1)
+		inversions /= (double)(n_order - 1);
+	(void)stress_drop_caches();
+	stat_hash = large_stat_rate(dir, order, n_order);
+	qsort(order, n_order, sizeof(*order), large_ino_cmp);
+	(void)stress_drop_caches();
+	stat_ino = large_stat_rate(dir, order, n_order);
+
+	(void)memset(calls_total, 0, sizeof(calls_total));
+	(void)memset(entries_total, 0, sizeof(entries_total));
+	(void)memset(duration, 0, sizeof(duration));
+	do {
+		for (i = 0; opt_do_run && (i < LARGE_BUF_SIZES); i++) {
+			t = time_now();
+			entries = large_read(fd, buf, large_buf_sizes[i],
+				&calls, NULL, NULL);
+			if (entries < 0)
+				goto close_dir;
+			duration[i] += time_now() - t;
+			entries_total[i] += (uint64_t)entries;
+			calls_total[i] += calls;
+			(*counter)++;
+			if (max_ops && (*counter >= max_ops))
+				goto close_dir;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+close_dir:
+	(void)close(fd);
+
+	if (instance == 0) {
+		pr_inf(stderr, "%s: directory of %" PRIu64 " entries\n", name, n);
+		pr_inf(stderr, "%s: %-8s %12s %12s\n",
+			name, "buffer", "Mentries/s", "calls/read");
+		for (i = 0; i < LARGE_BUF_SIZES; i++) {
+			char size[24];
+
+			if (duration[i] <= 0.0)
+				continue;
+			(void)snprintf(size, sizeof(size), "%zuK",
+				(size_t)(large_buf_sizes[i] / KB));
+			pr_inf(stderr, "%s: %-8s %12.3f %12.1f\n", name, size,
+				(double)entries_total[i] / (duration[i] * 1000000.0),
+				(double)calls_total[i] * (double)n /
+				(double)entries_total[i]);
+		}
+		if (cold_caches)
+			pr_inf(stderr, "%s: cold read %.3f ms\n", name, cold * 1000.0);
+		else
+			pr_inf(stderr, "%s: cannot drop caches (needs root), cold "
+				"read and stat times are with warm caches\n", name);
+		pr_inf(stderr, "%s: %.1f%% of %zu entries out of inode order, stat "
+			"%.0f/s in getdents order, %.0f/s in inode order\n",
+			name, inversions * 100.0, n_order, stat_hash, stat_ino);
+	}
+	for (i = 0; i < LARGE_BUF_SIZES; i++) {
+		char desc[48];
+
+		if (duration[i] <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "Mentries/s with %zuK buffer",
+			(size_t)(large_buf_sizes[i] / KB));
+		stress_misc_metric_set(idx++, desc,
+			(double)entries_total[i] / (duration[i] * 1000000.0));
+	}
+	if (cold_caches)
+		stress_misc_metric_set(idx++, "cold read ms", cold * 1000.0);
+	if (n_order > 1) {
+		stress_misc_metric_set(idx++, "% entries out of inode order",
+			inversions * 100.0);
+		stress_misc_metric_set(idx++, "stat/s in getdents order", stat_hash);
+		stress_misc_metric_set(idx++, "stat/s in inode order", stat_ino);
+	}
+tidy:
+	pr_tidy(stderr, "%s: removing %" PRIu64 " entries\n", name, n);
+	large_unlink(dir, n);
+	(void)stress_temp_dir_rm(name, pid, instance);
+	free(order);
+	free(buf);
+
+	return rc;
+}
+
 /*
  *  stress_getdent
  *	stress reading directories
@@ -310,6 +610,9 @@ int stress_getdent(
 
 	size_t page_size = stress_get_pagesize();
 
+	if (opt_getdent_entries)
+		return stress_getdent_large(counter, instance, max_ops, name);
+
 	do {
 		int ret;
 
@@ -31,6 +31,55 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+
+#define SWEEP_SLICE		(0.01)		/* secs timed per size */
+#define SWEEP_THREAD_SLICE	(0.05)		/* secs timed per thread count */
+#define SWEEP_THREAD_SIZE	(256)		/* bytes per threaded getrandom */
+#define SWEEP_THREADS_MAX	(64)		/* max threads in the sweep */
+#define SWEEP_BUF_SIZE		(1 * MB)	/* largest block size */
+
+/* the devices and APIs the block size sweep times */
+typedef enum {
+	SWEEP_GETRANDOM = 0,
+	SWEEP_URANDOM,
+	SWEEP_ZERO,
+	SWEEP_NULL,
+	SWEEP_APIS
+} sweep_api_t;
+
+static const char *sweep_apis[SWEEP_APIS] = {
+	"getrandom",
+	"/dev/urandom",
+	"/dev/zero",
+	"/dev/null",
+};
+
+static const size_t sweep_sizes[] = {
+	1, 16, 256, 4 * KB, 64 * KB, 1 * MB
+};
+
+#if defined(HAVE_LIB_PTHREAD)
+/* a thread of the concurrency sweep */
+typedef struct {
+	pthread_t pthread;
+	volatile bool *stop;		/* set when the slice is over */
+	uint64_t bytes;			/* bytes fetched by this thread */
+	int ret;			/* pthread_create return */
+} sweep_thread_t;
+#endif
+
+static bool opt_getrandom_sweep = false;
+
+void stress_set_getrandom_sweep(void)
+{
+	opt_getrandom_sweep = true;
+}
 
 /*
  *  getrandom() syscall
@@ -45,6 +94,191 @@ static inline int sys_getrandom(void *buff, size_t buflen, unsigned int flags)
 #endif
 }
 
+/*
+ *  sweep_rate()
+ *	MB/s of SWEEP_SLICE seconds of sz byte calls of one API
+ */
+static double sweep_rate(
+	const sweep_api_t api,
+	const int fd,
+	uint8_t *buf,
+	const size_t sz)
+{
+	uint64_t bytes = 0;
+	double t, t0 = time_now();
+	int i;
+
+	do {
+		/* Check the time every few calls, small calls are fast */
+		for (i = 0; i < 16; i++) {
+			ssize_t ret;
+
+			switch (api) {
+			case SWEEP_GETRANDOM:
+				ret = sys_getrandom(buf, sz, 0);
+				break;
+			case SWEEP_NULL:
+				ret = write(fd, buf, sz);
+				break;
+			default:
+				ret = read(fd, buf, sz);
+				break;
+			}
+			if (ret < 0) {
+				if ((errno == EAGAIN) || (errno == EINTR))
+					continue;
+				return -1.0;
+			}
+			bytes += ret;
+		}
+		t = time_now() - t0;
+	} while (opt_do_run && (t < SWEEP_SLICE));
+
+	return (t > 0.0) ? (double)bytes / (t * 1000000.0) : 0.0;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+static void *sweep_thread(void *arg)
+{
+	static void *nowt = NULL;
+	sweep_thread_t *thread = (sweep_thread_t *)arg;
+	uint8_t buf[SWEEP_THREAD_SIZE];
+
+	while (!*thread->stop) {
+		const ssize_t ret = sys_getrandom(buf, sizeof(buf), 0);
+
+		if (ret > 0)
+			thread->bytes += ret;
+	}
+	return &nowt;
+}
+
+/*
+ *  sweep_threads()
+ *	total MB/s of n threads all calling getrandom at once
+ */
+static double sweep_threads(const uint32_t n)
+{
+	sweep_thread_t threads[SWEEP_THREADS_MAX];
+	volatile bool stop = false;
+	uint64_t bytes = 0;
+	uint32_t i;
+	double t;
+
+	t = time_now();
+	for (i = 0; i < n; i++) {
+		threads[i].stop = &stop;
+		threads[i].bytes = 0;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			sweep_thread, &threads[i]);
+	}
+	(void)usleep((useconds_t)(SWEEP_THREAD_SLICE * 1000000.0));
+	stop = true;
+	for (i = 0; i < n; i++) {
+		if (threads[i].ret)
+			return -1.0;
+		(void)pthread_join(threads[i].pthread, NULL);
+		bytes += threads[i].bytes;
+	}
+	t = time_now() - t;
+
+	return (double)bytes / (t * 1000000.0);
+}
+#endif
+
+/*
+ *  stress_getrandom_sweep()
+ *	MB/s of getrandom, /dev/urandom, /dev/zero and /dev/null at
+ *	block sizes from 1 byte to 1MB, and of getrandom with 1, 2, 4
+ *	.. threads up to twice the CPUs to show how the CRNG scales.
+ *	One bogo op per sweep.
+ */
+static int stress_getrandom_sweep(
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const int32_t cpus = stress_get_processors_online();
+	uint32_t max_threads = (cpus > 0) ? 2 * (uint32_t)cpus : 1;
+	double rates[SWEEP_APIS][SIZEOF_ARRAY(sweep_sizes)];
+	double thread_rates[7];
+	int fds[SWEEP_APIS];
+	uint64_t sweeps = 0;
+	uint8_t *buf;
+	size_t i, j;
+	uint32_t n;
+
+	if (max_threads > SWEEP_THREADS_MAX)
+		max_threads = SWEEP_THREADS_MAX;
+	buf = calloc(1, SWEEP_BUF_SIZE);
+	if (!buf) {
+		pr_inf(stderr, "%s: cannot allocate the sweep buffer, "
+			"skipping stressor\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	fds[SWEEP_GETRANDOM] = -1;
+	fds[SWEEP_URANDOM] = open("/dev/urandom", O_RDONLY);
+	fds[SWEEP_ZERO] = open("/dev/zero", O_RDONLY);
+	fds[SWEEP_NULL] = open("/dev/null", O_WRONLY);
+	(void)memset(rates, 0, sizeof(rates));
+	(void)memset(thread_rates, 0, sizeof(thread_rates));
+
+	do {
+		for (i = 0; i < SWEEP_APIS; i++) {
+			if ((i != SWEEP_GETRANDOM) && (fds[i] < 0))
+				continue;
+			for (j = 0; j < SIZEOF_ARRAY(sweep_sizes); j++)
+				rates[i][j] += sweep_rate(i, fds[i], buf, sweep_sizes[j]);
+		}
+#if defined(HAVE_LIB_PTHREAD)
+		for (i = 0, n = 1; opt_do_run && (n <= max_threads) &&
+		     (i < SIZEOF_ARRAY(thread_rates)); i++, n *= 2)
+			thread_rates[i] += sweep_threads(n);
+#endif
+		if (!opt_do_run && sweeps)
+			break;
+		sweeps++;
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	for (i = 0; i < SWEEP_APIS; i++) {
+		if ((i != SWEEP_GETRANDOM) && (fds[i] < 0))
+			continue;
+		for (j = 0; j < SIZEOF_ARRAY(sweep_sizes); j++) {
+			char desc[32], size[16];
+
+			(void)snprintf(size, sizeof(size), "%zu%s",
+				(size_t)((sweep_sizes[j] >= MB) ? sweep_sizes[j] / MB :
+					 (sweep_sizes[j] >= KB) ? sweep_sizes[j] / KB :
+					 sweep_sizes[j]),
+				(sweep_sizes[j] >= MB) ? "M" :
+				(sweep_sizes[j] >= KB) ? "K" : "B");
+			(void)snprintf(desc, sizeof(desc), "%s %s MB/sec",
+				sweep_apis[i], size);
+			stress_misc_metric_set((i * SIZEOF_ARRAY(sweep_sizes)) + j,
+				desc, rates[i][j] / sweeps);
+		}
+	}
+	for (i = 0, n = 1; (n <= max_threads) &&
+	     (i < SIZEOF_ARRAY(thread_rates)); i++, n *= 2) {
+		char desc[32];
+
+		if (thread_rates[i] <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc),
+			"getrandom %" PRIu32 " threads MB/sec", n);
+		stress_misc_metric_set((SWEEP_APIS * SIZEOF_ARRAY(sweep_sizes)) + i,
+			desc, thread_rates[i] / sweeps);
+	}
+
+	for (i = 0; i < SWEEP_APIS; i++)
+		if (fds[i] >= 0)
+			(void)close(fds[i]);
+	free(buf);
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_getrandom
  *	stress reading random values using getrandom()
@@ -57,6 +291,9 @@ int stress_getrandom(
 {
 	(void)instance;
 
+	if (opt_getrandom_sweep)
+		return stress_getrandom_sweep(counter, max_ops, name);
+
 	do {
 		char buffer[8192];
 		ssize_t ret;
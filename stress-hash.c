@@ -0,0 +1,732 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "stress-ng.h"
+
+#if defined(__GNUC__) && !defined(__clang__) &&			\
+    (defined(__x86_64__) || defined(__i386__)) && NEED_GNUC(4,9,0)
+#define HASH_X86		(1)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define HASH_ARM_CRC		(1)
+#include <arm_acle.h>
+#endif
+
+#define HASH_TIME		(0.05)		/* seconds per method and size */
+#define HASH_BUF_SIZE		(64 * KB)	/* largest hashed buffer */
+#define HASH_BATCH_BYTES	(64 * KB)	/* bytes hashed between clock reads */
+#define HASH_METHOD_ALL		(-1)
+
+typedef uint32_t (*hash_func_t)(const uint8_t *data, const size_t len);
+
+typedef struct {
+	const char *name;		/* --hash-method name */
+	bool (*supported)(void);	/* true if the CPU can use it */
+	hash_func_t func;		/* the hash */
+} hash_method_t;
+
+/* Buffer sizes hashed, 8 bytes to 64K */
+static const size_t hash_sizes[] = {
+	8, 32, 128, 512, 2 * KB, 8 * KB, 32 * KB, 64 * KB
+};
+
+#define HASH_SIZES		(SIZEOF_ARRAY(hash_sizes))
+
+static int opt_hash_method = HASH_METHOD_ALL;
+
+static bool hash_always_supported(void)
+{
+	return true;
+}
+
+/*
+ *  The classic byte at a time hashes of the cpu stressor, taking a
+ *  length rather than a NUL terminated string
+ */
+
+/*
+ *  hash_crc16()
+ *	naive CCITT CRC16, bit at a time
+ */
+static uint32_t HOT OPTIMIZE3 hash_crc16(const uint8_t *data, const size_t len)
+{
+	const uint16_t polynomial = 0x8408;
+	uint16_t crc = ~0;
+	size_t n;
+
+	for (n = len; n; n--) {
+		uint8_t i;
+		uint8_t val = *data++;
+
+		for (i = 8; i; --i, val >>= 1) {
+			bool do_xor = 1 & (val ^ crc);
+			crc >>= 1;
+			crc ^= do_xor ? polynomial : 0;
+		}
+	}
+	crc = ~crc;
+	return (uint16_t)((crc << 8) | (crc >> 8));
+}
+
+/*
+ *  hash_djb2a()
+ *	Dan Bernstein's hash, xor version
+ */
+static uint32_t HOT OPTIMIZE3 hash_djb2a(const uint8_t *data, const size_t len)
+{
+	register uint32_t hash = 5381;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		hash = ((hash << 5) + hash) ^ data[i];
+	return hash;
+}
+
+/*
+ *  hash_fnv1a()
+ *	32 bit FNV-1a
+ */
+static uint32_t HOT OPTIMIZE3 hash_fnv1a(const uint8_t *data, const size_t len)
+{
+	register uint32_t hash = 5381;
+	const uint32_t fnv_prime = 16777619; /* 2^24 + 2^9 + 0x93 */
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= fnv_prime;
+	}
+	return hash;
+}
+
+/*
+ *  hash_jenkin()
+ *	Jenkin's one at a time hash
+ */
+static uint32_t HOT OPTIMIZE3 hash_jenkin(const uint8_t *data, const size_t len)
+{
+	register uint32_t h = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h += data[i];
+		h += h << 10;
+		h ^= h >> 6;
+	}
+	h += h << 3;
+	h ^= h >> 11;
+	h += h << 15;
+
+	return h;
+}
+
+/*
+ *  hash_pjw()
+ *	Aho, Sethi, Ullman, Compiling Techniques
+ */
+static uint32_t HOT OPTIMIZE3 hash_pjw(const uint8_t *data, const size_t len)
+{
+	register uint32_t h = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		uint32_t g;
+
+		h = (h << 4) + data[i];
+		if (0 != (g = h & 0xf0000000)) {
+			h = h ^ (g >> 24);
+			h = h ^ g;
+		}
+	}
+	return h;
+}
+
+/*
+ *  hash_sdbm()
+ *	sdbm data base hash
+ */
+static uint32_t HOT OPTIMIZE3 hash_sdbm(const uint8_t *data, const size_t len)
+{
+	register uint32_t hash = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		hash = data[i] + (hash << 6) + (hash << 16) - hash;
+	return hash;
+}
+
+/*
+ *  CRC32C (Castagnoli), the software version is table driven a
+ *  byte at a time, the hardware version uses the SSE4.2 or ARMv8
+ *  CRC32C instructions 8 bytes at a time
+ */
+static uint32_t hash_crc32c_table[256];
+#if defined(HAVE_LIB_PTHREAD)
+static pthread_once_t hash_crc32c_once = PTHREAD_ONCE_INIT;
+#endif
+
+static void hash_crc32c_init(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		int j;
+
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+		hash_crc32c_table[i] = crc;
+	}
+}
+
+static uint32_t HOT OPTIMIZE3 hash_crc32c_sw(const uint8_t *data, const size_t len)
+{
+	register uint32_t crc = ~0U;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		crc = hash_crc32c_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+#if defined(HASH_X86)
+static bool hash_sse42_supported(void)
+{
+	return __builtin_cpu_supports("sse4.2");
+}
+
+static uint32_t __attribute__((target("sse4.2"))) hash_crc32c(
+	const uint8_t *data,
+	const size_t len)
+{
+	size_t i = 0;
+#if defined(__x86_64__)
+	uint64_t crc = ~0U;
+
+	for (; i + 8 <= len; i += 8) {
+		uint64_t v;
+
+		(void)memcpy(&v, data + i, sizeof(v));
+		crc = _mm_crc32_u64(crc, v);
+	}
+#else
+	uint32_t crc = ~0U;
+#endif
+	for (; i < len; i++)
+		crc = _mm_crc32_u8((uint32_t)crc, data[i]);
+	return ~(uint32_t)crc;
+}
+#endif
+
+#if defined(HASH_ARM_CRC)
+static uint32_t hash_crc32c(const uint8_t *data, const size_t len)
+{
+	uint32_t crc = ~0U;
+	size_t i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		uint64_t v;
+
+		(void)memcpy(&v, data + i, sizeof(v));
+		crc = __crc32cd(crc, v);
+	}
+	for (; i < len; i++)
+		crc = __crc32cb(crc, data[i]);
+	return ~crc;
+}
+#endif
+
+/*
+ *  xxHash style hashes, XXH64 with four independent 64 bit lanes,
+ *  and XXH32 rounds on 16 lanes with AVX2 32 bit multiplies
+ */
+#define XXH_P64_1	(0x9e3779b185ebca87ULL)
+#define XXH_P64_2	(0xc2b2ae3d27d4eb4fULL)
+#define XXH_P64_3	(0x165667b19e3779f9ULL)
+#define XXH_P64_4	(0x85ebca77c2b2ae63ULL)
+#define XXH_P64_5	(0x27d4eb2f165667c5ULL)
+#define XXH_P32_1	(0x9e3779b1U)
+#define XXH_P32_2	(0x85ebca77U)
+#define XXH_P32_3	(0xc2b2ae3dU)
+
+static inline uint64_t xxh_rotl64(const uint64_t x, const int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, const uint64_t in)
+{
+	acc += in * XXH_P64_2;
+	acc = xxh_rotl64(acc, 31);
+	return acc * XXH_P64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, const uint64_t v)
+{
+	acc ^= xxh64_round(0, v);
+	return acc * XXH_P64_1 + XXH_P64_4;
+}
+
+/*
+ *  xxh64_tail()
+ *	mix in the last bytes and avalanche
+ */
+static inline uint64_t xxh64_tail(uint64_t h, const uint8_t *p, size_t n)
+{
+	for (; n >= 8; n -= 8, p += 8) {
+		uint64_t v;
+
+		(void)memcpy(&v, p, sizeof(v));
+		h ^= xxh64_round(0, v);
+		h = xxh_rotl64(h, 27) * XXH_P64_1 + XXH_P64_4;
+	}
+	for (; n; n--, p++) {
+		h ^= (*p) * XXH_P64_5;
+		h = xxh_rotl64(h, 11) * XXH_P64_1;
+	}
+	h ^= h >> 33;
+	h *= XXH_P64_2;
+	h ^= h >> 29;
+	h *= XXH_P64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+static uint32_t HOT OPTIMIZE3 hash_xxh64(const uint8_t *data, const size_t len)
+{
+	const uint8_t *p = data;
+	size_t n = len;
+	uint64_t h;
+
+	if (n >= 32) {
+		uint64_t v1 = XXH_P64_1 + XXH_P64_2;
+		uint64_t v2 = XXH_P64_2;
+		uint64_t v3 = 0;
+		uint64_t v4 = -XXH_P64_1;
+
+		do {
+			uint64_t in[4];
+
+			(void)memcpy(in, p, sizeof(in));
+			v1 = xxh64_round(v1, in[0]);
+			v2 = xxh64_round(v2, in[1]);
+			v3 = xxh64_round(v3, in[2]);
+			v4 = xxh64_round(v4, in[3]);
+			p += 32;
+			n -= 32;
+		} while (n >= 32);
+		h = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) +
+		    xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+		h = xxh64_merge(h, v1);
+		h = xxh64_merge(h, v2);
+		h = xxh64_merge(h, v3);
+		h = xxh64_merge(h, v4);
+	} else {
+		h = XXH_P64_5;
+	}
+	h += len;
+
+	return (uint32_t)xxh64_tail(h, p, n);
+}
+
+#if defined(HASH_X86)
+static bool hash_avx2_supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+/*
+ *  hash_xxh32_round8()
+ *	one XXH32 round on eight 32 bit lanes
+ */
+static inline __m256i __attribute__((target("avx2"))) hash_xxh32_round8(
+	__m256i acc,
+	const uint8_t *p)
+{
+	const __m256i in = _mm256_loadu_si256((const __m256i *)p);
+
+	acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(in,
+		_mm256_set1_epi32((int)XXH_P32_2)));
+	acc = _mm256_or_si256(_mm256_slli_epi32(acc, 13),
+			      _mm256_srli_epi32(acc, 19));
+	return _mm256_mullo_epi32(acc, _mm256_set1_epi32((int)XXH_P32_1));
+}
+
+/*
+ *  hash_xxh32x8()
+ *	XXH32 rounds on two sets of eight lanes, 64 bytes per
+ *	iteration so the multiply latency of one set is hidden
+ *	by the other, then folded and finished with the XXH64 tail
+ */
+static uint32_t __attribute__((target("avx2"))) hash_xxh32x8(
+	const uint8_t *data,
+	const size_t len)
+{
+	const uint8_t *p = data;
+	size_t n = len;
+	uint64_t h = XXH_P64_5 + len;
+
+	if (n >= 32) {
+		__m256i acc0 = _mm256_set_epi32(1, 2, 3, 4, 5, 6, 7, 8);
+		__m256i acc1 = _mm256_set_epi32(9, 10, 11, 12, 13, 14, 15, 16);
+		uint32_t lanes[16];
+		int i;
+
+		for (; n >= 64; p += 64, n -= 64) {
+			acc0 = hash_xxh32_round8(acc0, p);
+			acc1 = hash_xxh32_round8(acc1, p + 32);
+		}
+		if (n >= 32) {
+			acc0 = hash_xxh32_round8(acc0, p);
+			p += 32;
+			n -= 32;
+		}
+		_mm256_storeu_si256((__m256i *)lanes, acc0);
+		_mm256_storeu_si256((__m256i *)(lanes + 8), acc1);
+		for (i = 0; i < 16; i++)
+			h = xxh64_merge(h, lanes[i]);
+	}
+	return (uint32_t)xxh64_tail(h, p, n);
+}
+#endif
+
+static const hash_method_t hash_methods[] = {
+	{ "crc16",	hash_always_supported,	hash_crc16 },
+	{ "djb2a",	hash_always_supported,	hash_djb2a },
+	{ "fnv1a",	hash_always_supported,	hash_fnv1a },
+	{ "jenkin",	hash_always_supported,	hash_jenkin },
+	{ "pjw",	hash_always_supported,	hash_pjw },
+	{ "sdbm",	hash_always_supported,	hash_sdbm },
+	{ "crc32c-sw",	hash_always_supported,	hash_crc32c_sw },
+#if defined(HASH_X86)
+	{ "crc32c",	hash_sse42_supported,	hash_crc32c },
+#elif defined(HASH_ARM_CRC)
+	{ "crc32c",	hash_always_supported,	hash_crc32c },
+#endif
+	{ "xxh64",	hash_always_supported,	hash_xxh64 },
+#if defined(HASH_X86)
+	{ "xxh32x8",	hash_avx2_supported,	hash_xxh32x8 },
+#endif
+};
+
+#define HASH_METHODS		(SIZEOF_ARRAY(hash_methods))
+
+/*
+ *  stress_set_hash_method()
+ *	set the hash to benchmark, or all of them
+ */
+int stress_set_hash_method(const char *name)
+{
+	size_t i;
+
+	if (!strcmp(name, "all")) {
+		opt_hash_method = HASH_METHOD_ALL;
+		return 0;
+	}
+	for (i = 0; i < HASH_METHODS; i++) {
+		if (!strcmp(name, hash_methods[i].name)) {
+			opt_hash_method = (int)i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "hash-method must be one of: all");
+	for (i = 0; i < HASH_METHODS; i++)
+		fprintf(stderr, " %s", hash_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  hash_cycles_open()
+ *	open a CPU cycle counter, -1 if unavailable
+ */
+static int hash_cycles_open(void)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_open_by_id(STRESS_PERF_HW_CPU_CYCLES);
+#else
+	return -1;
+#endif
+}
+
+/*
+ *  hash_cycles_read()
+ *	read the cycle counter, false if unavailable
+ */
+static bool hash_cycles_read(const int fd, uint64_t *cycles)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_read_by_fd(fd, cycles) == 0;
+#else
+	(void)fd;
+	*cycles = 0;
+	return false;
+#endif
+}
+
+/* Accumulated results of one method at one size */
+typedef struct {
+	uint64_t bytes;			/* bytes hashed */
+	uint64_t cycles;		/* CPU cycles taken */
+	double duration;		/* time taken */
+} hash_stats_t;
+
+/*
+ *  hash_measure()
+ *	hash the buffer at one size for HASH_TIME seconds
+ */
+static void hash_measure(
+	const hash_method_t *method,
+	const uint8_t *buf,
+	const size_t size,
+	const int fd,
+	hash_stats_t *stats,
+	uint32_t *sink)
+{
+	const size_t batch = STRESS_MAXIMUM((size_t)1, HASH_BATCH_BYTES / size);
+	const size_t offsets = HASH_BUF_SIZE / size;
+	uint64_t c1 = 0, c2 = 0, bytes = 0;
+	double t_start, t_end, t;
+	uint32_t sum = 0;
+	bool ok;
+
+	ok = hash_cycles_read(fd, &c1);
+	t_start = time_now();
+	t_end = t_start + HASH_TIME;
+	do {
+		size_t i;
+
+		/* Walk the buffer so small sizes don't hash the same bytes */
+		for (i = 0; i < batch; i++)
+			sum += method->func(buf + ((i % offsets) * size), size);
+		bytes += batch * size;
+		t = time_now();
+	} while (opt_do_run && (t < t_end));
+	ok &= hash_cycles_read(fd, &c2);
+
+	stats->bytes += bytes;
+	stats->duration += t - t_start;
+	if (ok && (c2 > c1))
+		stats->cycles += c2 - c1;
+	*sink += sum;
+}
+
+/*
+ *  hash_verify()
+ *	check the CRC32C hashes against the standard check value
+ *	and each other, a wrong hardware CRC is a CPU fault
+ */
+static int hash_verify(const char *name, const uint8_t *buf)
+{
+	const uint8_t check[] = "123456789";
+	size_t i;
+
+	if (hash_crc32c_sw(check, 9) != 0xe3069283) {
+		pr_fail(stderr, "%s: crc32c-sw check value is 0x%8.8" PRIx32
+			", expected 0xe3069283\n", name,
+			hash_crc32c_sw(check, 9));
+		return -1;
+	}
+	for (i = 0; i < HASH_METHODS; i++) {
+		const hash_method_t *m = &hash_methods[i];
+		size_t j;
+
+		if (strcmp(m->name, "crc32c") || !m->supported())
+			continue;
+		for (j = 0; j < HASH_SIZES; j++) {
+			const size_t len = hash_sizes[j] - (j & 7);
+
+			if (m->func(buf, len) != hash_crc32c_sw(buf, len)) {
+				pr_fail(stderr, "%s: crc32c of %zu bytes differs "
+					"from crc32c-sw\n", name, len);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ *  hash_size_str()
+ *	buffer size as N or NK
+ */
+static void hash_size_str(char *str, const size_t len, const size_t size)
+{
+	if (size < KB)
+		(void)snprintf(str, len, "%zu", size);
+	else
+		(void)snprintf(str, len, "%zuK", (size_t)(size / KB));
+}
+
+/*
+ *  stress_hash()
+ *	benchmark hash throughput from 8 bytes to 64K
+ */
+int stress_hash(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	hash_stats_t (*stats)[HASH_SIZES];
+	uint8_t *buf;
+	uint32_t sink = 0;
+	size_t i, j, idx = 0;
+	bool have_cycles = false;
+	int fd, rc = EXIT_SUCCESS;
+
+	buf = malloc(HASH_BUF_SIZE);
+	stats = calloc(HASH_METHODS, sizeof(*stats));
+	if (!buf || !stats) {
+		pr_inf(stderr, "%s: cannot allocate buffers, skipping stressor\n",
+			name);
+		free(stats);
+		free(buf);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < HASH_BUF_SIZE; i++)
+		buf[i] = mwc8();
+	/* Threaded instances share the table, so build it just once */
+#if defined(HAVE_LIB_PTHREAD)
+	(void)pthread_once(&hash_crc32c_once, hash_crc32c_init);
+#else
+	hash_crc32c_init();
+#endif
+
+	if ((opt_flags & OPT_FLAGS_VERIFY) && (hash_verify(name, buf) < 0)) {
+		free(stats);
+		free(buf);
+		return EXIT_FAILURE;
+	}
+
+	fd = hash_cycles_open();
+	do {
+		for (i = 0; opt_do_run && (i < HASH_METHODS); i++) {
+			const hash_method_t *m = &hash_methods[i];
+
+			if ((opt_hash_method != HASH_METHOD_ALL) &&
+			    (opt_hash_method != (int)i))
+				continue;
+			if (!m->supported())
+				continue;
+			for (j = 0; opt_do_run && (j < HASH_SIZES); j++) {
+				hash_measure(m, buf, hash_sizes[j], fd,
+					&stats[i][j], &sink);
+				(*counter)++;
+				if (max_ops && (*counter >= max_ops))
+					goto done;
+			}
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	if (fd >= 0)
+		(void)close(fd);
+	for (i = 0; i < HASH_METHODS; i++)
+		for (j = 0; j < HASH_SIZES; j++)
+			have_cycles |= (stats[i][j].cycles > 0);
+
+	if (instance == 0) {
+		char line[256];
+		int n;
+
+		n = snprintf(line, sizeof(line), "%-9s", "GB/s");
+		for (j = 0; j < HASH_SIZES; j++) {
+			char size[24];
+
+			hash_size_str(size, sizeof(size), hash_sizes[j]);
+			n += snprintf(line + n, sizeof(line) - n, " %8s", size);
+		}
+		if (have_cycles)
+			(void)snprintf(line + n, sizeof(line) - n, " %11s %11s",
+				"cyc/B 8", "cyc/B 64K");
+		pr_inf(stderr, "%s: %s\n", name, line);
+		for (i = 0; i < HASH_METHODS; i++) {
+			const hash_stats_t *s = stats[i];
+
+			if (!s[HASH_SIZES - 1].duration)
+				continue;
+			n = snprintf(line, sizeof(line), "%-9s", hash_methods[i].name);
+			for (j = 0; j < HASH_SIZES; j++)
+				n += snprintf(line + n, sizeof(line) - n, " %8.3f",
+					(double)s[j].bytes / (s[j].duration * GB));
+			if (have_cycles)
+				(void)snprintf(line + n, sizeof(line) - n,
+					" %11.3f %11.3f",
+					(double)s[0].cycles / (double)s[0].bytes,
+					(double)s[HASH_SIZES - 1].cycles /
+					(double)s[HASH_SIZES - 1].bytes);
+			pr_inf(stderr, "%s: %s\n", name, line);
+		}
+		if (!have_cycles)
+			pr_inf(stderr, "%s: CPU cycle counter not available, "
+				"cycles per byte not reported\n", name);
+	}
+
+	for (i = 0; i < HASH_METHODS; i++) {
+		const hash_stats_t *s = stats[i];
+		char desc[40];
+
+		if (!s[HASH_SIZES - 1].duration)
+			continue;
+		if (opt_hash_method == HASH_METHOD_ALL) {
+			/* Large buffer throughput of each hash */
+			(void)snprintf(desc, sizeof(desc), "%s GB/s at 64K",
+				hash_methods[i].name);
+			stress_misc_metric_set(idx++, desc,
+				(double)s[HASH_SIZES - 1].bytes /
+				(s[HASH_SIZES - 1].duration * GB));
+			continue;
+		}
+		/* One hash, throughput at each size and cycles per byte */
+		for (j = 0; j < HASH_SIZES; j++) {
+			char size[24];
+
+			hash_size_str(size, sizeof(size), hash_sizes[j]);
+			(void)snprintf(desc, sizeof(desc), "GB/s at %s", size);
+			stress_misc_metric_set(idx++, desc,
+				(double)s[j].bytes / (s[j].duration * GB));
+		}
+		if (have_cycles) {
+			stress_misc_metric_set(idx++, "cycles per byte at 8 bytes",
+				(double)s[0].cycles / (double)s[0].bytes);
+			stress_misc_metric_set(idx++, "cycles per byte at 64K",
+				(double)s[HASH_SIZES - 1].cycles /
+				(double)s[HASH_SIZES - 1].bytes);
+		}
+	}
+	pr_dbg(stderr, "%s: hash sum 0x%8.8" PRIx32 "\n", name, sink);
+	free(stats);
+	free(buf);
+
+	return rc;
+}
@@ -0,0 +1,574 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_HASHMAP)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <math.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define HASHMAP_PHASE_TIME	(1.0)	/* seconds per method and thread count */
+#define HASHMAP_STRIPES		(256)	/* locks of the striped method */
+#define HASHMAP_BATCH		(256)	/* ops between progress updates */
+
+#define HASHMAP_METHOD_STRIPED	(0)	/* chained buckets, striped mutexes */
+#define HASHMAP_METHOD_LOCKFREE	(1)	/* open addressing, CAS claimed keys */
+#define HASHMAP_METHOD_MAX	(2)
+#define HASHMAP_METHOD_ALL	(HASHMAP_METHOD_MAX)
+
+typedef struct {
+	const char *name;	/* User option */
+	int method;		/* HASHMAP_METHOD_ value */
+} hashmap_method_t;
+
+static const hashmap_method_t hashmap_methods[] = {
+	{ "striped",	HASHMAP_METHOD_STRIPED },
+	{ "lockfree",	HASHMAP_METHOD_LOCKFREE },
+	{ "all",	HASHMAP_METHOD_ALL },
+};
+
+/* Chained entry of the striped map */
+typedef struct hashmap_node {
+	struct hashmap_node *next;	/* next in the bucket */
+	uint64_t key;			/* session key */
+	uint64_t value;			/* session value */
+} hashmap_node_t;
+
+/* Slot of the lock-free map, a claimed key is never released */
+typedef struct {
+	uint64_t key;			/* 0 if unclaimed */
+	uint64_t value;			/* 0 if deleted */
+} hashmap_slot_t;
+
+/* A worker thread */
+typedef struct {
+	pthread_t pthread;		/* the thread */
+	int ret;			/* pthread_create return */
+	uint64_t seed;			/* xorshift state */
+	uint64_t ops;			/* operations this phase */
+	uint64_t hits;			/* lookups that found the key */
+} hashmap_thread_t;
+
+static struct {
+	int method;			/* HASHMAP_METHOD_ of this phase */
+	bool run;			/* threads keep on running */
+	bool go;			/* all threads at the start line */
+	uint32_t started;		/* threads at the start line */
+	hashmap_node_t **buckets;	/* striped map buckets */
+	pthread_mutex_t locks[HASHMAP_STRIPES]; /* striped map locks */
+	hashmap_slot_t *slots;		/* lock-free map slots */
+	uint64_t mask;			/* buckets or slots - 1 */
+	double zeta2, zetan;		/* Zipfian constants */
+	double alpha, eta;
+} hashmap_ctl;
+
+static int opt_hashmap_method = HASHMAP_METHOD_ALL;
+static uint64_t opt_hashmap_keys = DEFAULT_HASHMAP_KEYS;
+static uint32_t opt_hashmap_reads = DEFAULT_HASHMAP_READS;
+static uint32_t opt_hashmap_threads = DEFAULT_HASHMAP_THREADS;
+static uint32_t opt_hashmap_zipf = DEFAULT_HASHMAP_ZIPF;
+
+/*
+ *  stress_set_hashmap_method()
+ *	set the hash map method to exercise
+ */
+int stress_set_hashmap_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(hashmap_methods); i++) {
+		if (!strcmp(name, hashmap_methods[i].name)) {
+			opt_hashmap_method = hashmap_methods[i].method;
+			return 0;
+		}
+	}
+	fprintf(stderr, "hashmap-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(hashmap_methods); i++)
+		fprintf(stderr, " %s", hashmap_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+void stress_set_hashmap_keys(const char *optarg)
+{
+	opt_hashmap_keys = get_uint64_byte(optarg);
+	check_range("hashmap-keys", opt_hashmap_keys,
+		MIN_HASHMAP_KEYS, MAX_HASHMAP_KEYS);
+}
+
+void stress_set_hashmap_reads(const char *optarg)
+{
+	opt_hashmap_reads = (uint32_t)get_uint64(optarg);
+	check_range("hashmap-reads", opt_hashmap_reads,
+		MIN_HASHMAP_READS, MAX_HASHMAP_READS);
+}
+
+void stress_set_hashmap_threads(const char *optarg)
+{
+	opt_hashmap_threads = (uint32_t)get_uint64(optarg);
+	check_range("hashmap-threads", opt_hashmap_threads,
+		MIN_HASHMAP_THREADS, MAX_HASHMAP_THREADS);
+}
+
+void stress_set_hashmap_zipf(const char *optarg)
+{
+	opt_hashmap_zipf = (uint32_t)get_uint64(optarg);
+	check_range("hashmap-zipf", opt_hashmap_zipf,
+		MIN_HASHMAP_ZIPF, MAX_HASHMAP_ZIPF);
+}
+
+/*
+ *  hashmap_rand()
+ *	per thread xorshift64*, mwc is not thread safe
+ */
+static inline uint64_t hashmap_rand(uint64_t *seed)
+{
+	uint64_t x = *seed;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*seed = x;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+static inline uint64_t hashmap_hash(const uint64_t key)
+{
+	return (key * 0x9e3779b97f4a7c15ULL) >> 17;
+}
+
+/*
+ *  hashmap_zipf_init()
+ *	precompute the constants of Gray's Zipfian generator
+ *	for theta = --hashmap-zipf / 100 over the key space
+ */
+static void hashmap_zipf_init(void)
+{
+	const double theta = (double)opt_hashmap_zipf / 100.0;
+	const uint64_t n = opt_hashmap_keys;
+	uint64_t i;
+
+	hashmap_ctl.zetan = 0.0;
+	for (i = 1; i <= n; i++)
+		hashmap_ctl.zetan += 1.0 / pow((double)i, theta);
+	hashmap_ctl.zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+	hashmap_ctl.alpha = 1.0 / (1.0 - theta);
+	hashmap_ctl.eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) /
+		(1.0 - hashmap_ctl.zeta2 / hashmap_ctl.zetan);
+}
+
+/*
+ *  hashmap_key()
+ *	pick a key 1..N, Zipfian by rank or uniform for a zero
+ *	skew, with the ranks scattered over the key space so
+ *	the hot keys don't share buckets or cache lines
+ */
+static inline uint64_t hashmap_key(uint64_t *seed)
+{
+	const uint64_t n = opt_hashmap_keys;
+	const double u = (double)(hashmap_rand(seed) >> 11) / 9007199254740992.0;
+	const double uz = u * hashmap_ctl.zetan;
+	uint64_t rank;
+
+	if (!opt_hashmap_zipf)
+		rank = (uint64_t)(u * (double)n);
+	else if (uz < 1.0)
+		rank = 0;
+	else if (uz < hashmap_ctl.zeta2)
+		rank = 1;
+	else
+		rank = (uint64_t)((double)n *
+			pow((hashmap_ctl.eta * u) - hashmap_ctl.eta + 1.0, hashmap_ctl.alpha));
+	if (rank >= n)
+		rank = n - 1;
+	return ((rank * 0x9e3779b1ULL) % n) + 1;
+}
+
+/*
+ *  hashmap_striped_op()
+ *	look up, insert or delete a key with the bucket's stripe
+ *	lock held, returns true if the key was found
+ */
+static bool hashmap_striped_op(const uint64_t key, const int op)
+{
+	const uint64_t b = hashmap_hash(key) & hashmap_ctl.mask;
+	pthread_mutex_t *lock = &hashmap_ctl.locks[b % HASHMAP_STRIPES];
+	hashmap_node_t **prev, *node, *unused = NULL;
+	bool found = false;
+
+	/* Allocate outside the lock, as a session cache would */
+	if (op == 1) {
+		unused = malloc(sizeof(*unused));
+		if (!unused)
+			return false;
+	}
+	(void)pthread_mutex_lock(lock);
+	for (prev = &hashmap_ctl.buckets[b]; (node = *prev) != NULL; prev = &node->next) {
+		if (node->key == key) {
+			found = true;
+			break;
+		}
+	}
+	switch (op) {
+	case 1:
+		if (found) {
+			node->value = key;
+		} else {
+			unused->key = key;
+			unused->value = key;
+			unused->next = hashmap_ctl.buckets[b];
+			hashmap_ctl.buckets[b] = unused;
+			unused = NULL;
+		}
+		break;
+	case 2:
+		if (found)
+			*prev = node->next;
+		else
+			node = NULL;
+		break;
+	default:
+		node = NULL;
+		break;
+	}
+	(void)pthread_mutex_unlock(lock);
+	free(unused);
+	if (op == 2)
+		free(node);
+	return found;
+}
+
+/*
+ *  hashmap_lockfree_op()
+ *	look up, insert or delete a key, keys claim slots with a
+ *	CAS and keep them, a delete zeroes the value
+ */
+static bool hashmap_lockfree_op(const uint64_t key, const int op)
+{
+	uint64_t i = hashmap_hash(key) & hashmap_ctl.mask;
+
+	for (;;) {
+		hashmap_slot_t *slot = &hashmap_ctl.slots[i];
+		uint64_t k = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+
+		if (!k) {
+			if (op != 1)
+				return false;
+			if (__atomic_compare_exchange_n(&slot->key, &k, key, false,
+			    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				k = key;
+		}
+		if (k == key) {
+			switch (op) {
+			case 1:
+				return __atomic_exchange_n(&slot->value, key,
+					__ATOMIC_RELEASE) != 0;
+			case 2:
+				return __atomic_exchange_n(&slot->value, 0,
+					__ATOMIC_RELEASE) != 0;
+			default:
+				return __atomic_load_n(&slot->value,
+					__ATOMIC_ACQUIRE) != 0;
+			}
+		}
+		i = (i + 1) & hashmap_ctl.mask;
+	}
+}
+
+/*
+ *  hashmap_thread()
+ *	run the read, insert and delete mix on Zipfian keys,
+ *	the writes are split evenly so the map size is stable
+ */
+static void *hashmap_thread(void *arg)
+{
+	static void *nowt = NULL;
+	hashmap_thread_t *t = (hashmap_thread_t *)arg;
+	const uint64_t reads = opt_hashmap_reads;
+	uint64_t ops = 0, hits = 0;
+
+	__atomic_add_fetch(&hashmap_ctl.started, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(&hashmap_ctl.go, __ATOMIC_ACQUIRE))
+		(void)sched_yield();
+
+	while (__atomic_load_n(&hashmap_ctl.run, __ATOMIC_RELAXED)) {
+		int i;
+
+		for (i = 0; i < HASHMAP_BATCH; i++) {
+			const uint64_t r = hashmap_rand(&t->seed) % 200;
+			const uint64_t key = hashmap_key(&t->seed);
+			const int op = (r < reads * 2) ? 0 : (r & 1) + 1;
+			bool found;
+
+			if (hashmap_ctl.method == HASHMAP_METHOD_LOCKFREE)
+				found = hashmap_lockfree_op(key, op);
+			else
+				found = hashmap_striped_op(key, op);
+			hits += (op == 0) && found;
+		}
+		ops += HASHMAP_BATCH;
+		__atomic_store_n(&t->ops, ops, __ATOMIC_RELAXED);
+	}
+	t->hits = hits;
+
+	return &nowt;
+}
+
+/*
+ *  hashmap_phase()
+ *	run the mix with one method and a number of threads for
+ *	a phase, returns the operations per second
+ */
+static double hashmap_phase(
+	const char *name,
+	const int method,
+	const uint32_t nthreads,
+	hashmap_thread_t *threads,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const uint64_t base = *counter;
+	uint64_t ops = 0;
+	uint32_t i, started = 0;
+	double t_start, t_end, duration;
+
+	hashmap_ctl.method = method;
+	hashmap_ctl.run = true;
+	hashmap_ctl.go = false;
+	hashmap_ctl.started = 0;
+
+	for (i = 0; i < nthreads; i++) {
+		hashmap_thread_t *t = &threads[i];
+
+		t->ops = 0;
+		t->hits = 0;
+		t->seed = mwc64() | 1;
+		t->ret = pthread_create(&t->pthread, NULL, hashmap_thread, t);
+		if (t->ret)
+			break;
+		started++;
+	}
+	if (!started) {
+		pr_fail_errno(name, "pthread_create", threads[0].ret);
+		return 0.0;
+	}
+	if (started < nthreads)
+		pr_dbg(stderr, "%s: only %" PRIu32 " of %" PRIu32
+			" threads started\n", name, started, nthreads);
+	while (__atomic_load_n(&hashmap_ctl.started, __ATOMIC_ACQUIRE) < started)
+		(void)sched_yield();
+
+	t_start = time_now();
+	t_end = t_start + HASHMAP_PHASE_TIME;
+	__atomic_store_n(&hashmap_ctl.go, true, __ATOMIC_RELEASE);
+
+	while (opt_do_run && (time_now() < t_end)) {
+		uint64_t total = base;
+
+		(void)usleep(10000);
+		for (i = 0; i < started; i++)
+			total += __atomic_load_n(&threads[i].ops, __ATOMIC_RELAXED);
+		*counter = total;
+		if (max_ops && (total >= max_ops))
+			break;
+	}
+	__atomic_store_n(&hashmap_ctl.run, false, __ATOMIC_RELEASE);
+	for (i = 0; i < started; i++)
+		(void)pthread_join(threads[i].pthread, NULL);
+	duration = time_now() - t_start;
+
+	for (i = 0; i < started; i++)
+		ops += threads[i].ops;
+	*counter = base + ops;
+
+	return (duration > 0.0) ? (double)ops / duration : 0.0;
+}
+
+/*
+ *  hashmap_populate()
+ *	insert half of the keys, so lookups hit about half the time
+ */
+static void hashmap_populate(void)
+{
+	uint64_t key;
+
+	for (key = 1; key <= opt_hashmap_keys; key += 2) {
+		hashmap_ctl.method == HASHMAP_METHOD_LOCKFREE ?
+			(void)hashmap_lockfree_op(key, 1) :
+			(void)hashmap_striped_op(key, 1);
+	}
+}
+
+/*
+ *  hashmap_free()
+ *	free the maps
+ */
+static void hashmap_free(void)
+{
+	uint64_t b;
+
+	if (hashmap_ctl.buckets) {
+		for (b = 0; b <= hashmap_ctl.mask; b++) {
+			hashmap_node_t *node = hashmap_ctl.buckets[b];
+
+			while (node) {
+				hashmap_node_t *next = node->next;
+
+				free(node);
+				node = next;
+			}
+		}
+	}
+	free(hashmap_ctl.buckets);
+	free(hashmap_ctl.slots);
+	hashmap_ctl.buckets = NULL;
+	hashmap_ctl.slots = NULL;
+}
+
+/*
+ *  stress_hashmap()
+ *	run a read, insert and delete mix on Zipfian keys over a
+ *	striped lock and a lock-free concurrent hash map, with one
+ *	and with N threads, reporting the ops per second and the
+ *	scaling efficiency of N threads against one
+ */
+int stress_hashmap(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	hashmap_thread_t *threads;
+	double rate1[HASHMAP_METHOD_MAX], raten[HASHMAP_METHOD_MAX], r1;
+	uint64_t phases[HASHMAP_METHOD_MAX], size, i;
+	bool reported = false;
+	int method;
+	size_t idx = 0;
+
+	/* Buckets and slots at least twice the keys, so probes stay short */
+	for (size = 1; size < opt_hashmap_keys * 2; size <<= 1)
+		;
+	hashmap_ctl.mask = size - 1;
+
+	threads = calloc(opt_hashmap_threads, sizeof(*threads));
+	hashmap_ctl.buckets = calloc(size, sizeof(*hashmap_ctl.buckets));
+	hashmap_ctl.slots = calloc(size, sizeof(*hashmap_ctl.slots));
+	if (!threads || !hashmap_ctl.buckets || !hashmap_ctl.slots) {
+		pr_inf(stderr, "%s: cannot allocate the hash maps, "
+			"skipping stressor\n", name);
+		hashmap_free();
+		free(threads);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < HASHMAP_STRIPES; i++)
+		(void)pthread_mutex_init(&hashmap_ctl.locks[i], NULL);
+	hashmap_zipf_init();
+	for (method = 0; method < HASHMAP_METHOD_MAX; method++) {
+		hashmap_ctl.method = method;
+		hashmap_populate();
+		rate1[method] = 0.0;
+		raten[method] = 0.0;
+		phases[method] = 0;
+	}
+
+	do {
+		for (method = 0; method < HASHMAP_METHOD_MAX; method++) {
+			if ((opt_hashmap_method != HASHMAP_METHOD_ALL) &&
+			    (opt_hashmap_method != method))
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			r1 = hashmap_phase(name, method, 1,
+				threads, counter, max_ops);
+			if (opt_hashmap_threads > 1) {
+				/* Only account for complete pairs of phases */
+				if (!opt_do_run || (max_ops && *counter >= max_ops))
+					goto done;
+				raten[method] += hashmap_phase(name, method,
+					opt_hashmap_threads, threads, counter, max_ops);
+			}
+			rate1[method] += r1;
+			phases[method]++;
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %" PRIu64 " keys, %" PRIu32
+				"%% reads, zipf %.2f\n", name, opt_hashmap_keys,
+				opt_hashmap_reads, (double)opt_hashmap_zipf / 100.0);
+			pr_inf(stderr, "%s: %8s %14s %14s %11s\n", name,
+				"method", "1 thread ops/s", "N thread ops/s",
+				"efficiency");
+			for (method = 0; method < HASHMAP_METHOD_MAX; method++) {
+				if (!phases[method])
+					continue;
+				if (opt_hashmap_threads > 1)
+					pr_inf(stderr, "%s: %8s %14.0f %14.0f %10.1f%%\n",
+						name, hashmap_methods[method].name,
+						rate1[method], raten[method],
+						100.0 * raten[method] /
+						(rate1[method] * opt_hashmap_threads));
+				else
+					pr_inf(stderr, "%s: %8s %14.0f %14s %11s\n",
+						name, hashmap_methods[method].name,
+						rate1[method], "-", "-");
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (method = 0; method < HASHMAP_METHOD_MAX; method++) {
+		char desc[40];
+
+		if (!phases[method])
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s 1 thread ops/s",
+			hashmap_methods[method].name);
+		stress_misc_metric_set(idx++, desc, rate1[method] / phases[method]);
+		if (opt_hashmap_threads < 2)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s %" PRIu32 " thread ops/s",
+			hashmap_methods[method].name, opt_hashmap_threads);
+		stress_misc_metric_set(idx++, desc, raten[method] / phases[method]);
+		(void)snprintf(desc, sizeof(desc), "%s scaling efficiency %%",
+			hashmap_methods[method].name);
+		stress_misc_metric_set(idx++, desc, (rate1[method] > 0.0) ?
+			100.0 * raten[method] / (rate1[method] * opt_hashmap_threads) : 0.0);
+	}
+	for (i = 0; i < HASHMAP_STRIPES; i++)
+		(void)pthread_mutex_destroy(&hashmap_ctl.locks[i]);
+	hashmap_free();
+	free(threads);
+
+	return EXIT_SUCCESS;
+}
+#endif
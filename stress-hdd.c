@@ -27,16 +27,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
 #include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+#if defined(__linux__)
+#include <sys/sysmacros.h>
+#endif
 
 #include "stress-ng.h"
 
-#define BUF_ALIGNMENT		(4096)
+#if defined(STRESS_URING)
+#include <linux/io_uring.h>
+#endif
+#if defined(STRESS_AIO_LINUX)
+#include <libaio.h>
+#endif
+
 #define HDD_IO_VEC_MAX		(16)		/* Must be power of 2 */
 
 /* Write and read stress modes */
@@ -70,6 +85,27 @@
 #define HDD_OPT_FDATASYNC	(0x00800000)
 #define HDD_OPT_SYNCFS		(0x01000000)
 
+/* I/O engines */
+#define HDD_ENGINE_SYNC		(0)
+#define HDD_ENGINE_IO_URING	(1)
+#define HDD_ENGINE_LIBAIO	(2)
+
+/* Random offset distributions */
+#define HDD_DIST_UNIFORM	(0)
+#define HDD_DIST_ZIPF		(1)
+#define HDD_DIST_HOTSPOT	(2)
+
+#define HDD_ZIPF_THETA		(0.99)	/* YCSB default skew */
+#define HDD_ZIPF_EXACT		(100000)/* terms summed exactly for zeta(n) */
+#define HDD_HOTSPOT_PERCENT	(10)	/* hot region, % of the file */
+#define HDD_HOTSPOT_HITS	(90)	/* % of I/Os hitting the hot region */
+
+/* Internal mode, mixed random reads and writes */
+#define HDD_MODE_MIX		(0x10000000)
+
+#define HDD_PATHS_MAX		(64)	/* --hdd-paths directories */
+#define HDD_MOUNTS_MAX		(256)	/* mounts searched for a path */
+
 static uint64_t opt_hdd_bytes = DEFAULT_HDD_BYTES;
 static uint64_t opt_hdd_write_size = DEFAULT_HDD_WRITE_SIZE;
 static bool set_hdd_bytes = false;
@@ -77,6 +113,21 @@ static bool set_hdd_write_size = false;
 static bool opts_set = false;
 static int opt_hdd_flags = 0;
 static int opt_hdd_oflags = 0;
+static int opt_hdd_engine = HDD_ENGINE_SYNC;
+static uint32_t opt_hdd_qd = DEFAULT_HDD_QD;
+static int opt_hdd_dist = HDD_DIST_UNIFORM;
+static uint32_t opt_hdd_rw_mix = 0;
+static bool set_hdd_rw_mix = false;
+static char *opt_hdd_paths[HDD_PATHS_MAX];
+static size_t opt_hdd_npaths = 0;
+static uint64_t opt_hdd_stripe = DEFAULT_HDD_STRIPE;
+
+/* Per worker block distribution state */
+static uint64_t hdd_nblocks;		/* write size blocks in the file */
+static uint64_t hdd_offset_align = 512;	/* random offset alignment */
+static double hdd_zipf_zetan;		/* zeta(hdd_nblocks, theta) */
+static double hdd_zipf_eta;
+static double hdd_zipf_alpha;
 
 typedef struct {
 	const char *opt;	/* User option */
@@ -148,6 +199,64 @@ static const hdd_opts_t hdd_opts[] = {
 	{ "utimes",	HDD_OPT_UTIMES, 0, 0, 0 },
 };
 
+typedef struct {
+	const char *name;	/* User option */
+	int engine;		/* HDD_ENGINE_ value */
+} hdd_engine_t;
+
+static const hdd_engine_t hdd_engines[] = {
+	{ "sync",	HDD_ENGINE_SYNC },
+#if defined(STRESS_URING)
+	{ "io_uring",	HDD_ENGINE_IO_URING },
+#endif
+#if defined(STRESS_AIO_LINUX)
+	{ "libaio",	HDD_ENGINE_LIBAIO },
+#endif
+};
+
+typedef struct {
+	const char *name;	/* User option */
+	int dist;		/* HDD_DIST_ value */
+} hdd_dist_t;
+
+static const hdd_dist_t hdd_dists[] = {
+	{ "uniform",	HDD_DIST_UNIFORM },
+	{ "zipf",	HDD_DIST_ZIPF },
+	{ "hotspot",	HDD_DIST_HOTSPOT },
+};
+
+#if defined(STRESS_URING) || defined(STRESS_AIO_LINUX)
+#define HDD_ASYNC		(1)
+
+/* asynchronous engine state */
+typedef struct {
+	const char *name;
+	int engine;
+	int fd;
+	uint32_t qd;		/* I/Os kept in flight */
+	uint32_t inflight;
+	io_buffers_t io_bufs;	/* the slot buffers */
+	size_t stride;		/* aligned distance between slot buffers */
+	uint8_t *bufs;		/* qd slot buffers */
+	uint32_t *free;		/* stack of free slots */
+	uint32_t nfree;
+	off_t *offset;		/* file offset of each slot's I/O */
+	bool *write;		/* slot's I/O is a write */
+#if defined(STRESS_URING)
+	stress_uring_t ring;
+	bool fixed_bufs;	/* bufs is registered buffer 0 */
+	bool fixed_file;	/* fd is registered file 0 */
+#endif
+#if defined(STRESS_AIO_LINUX)
+	io_context_t ctx;
+	struct iocb *cbs;	/* one control block per slot */
+	struct iocb **pending;	/* control blocks yet to be submitted */
+	uint32_t npending;
+	struct io_event *events;
+#endif
+} hdd_async_t;
+#endif
+
 void stress_set_hdd_bytes(const char *optarg)
 {
 	set_hdd_bytes = true;
@@ -164,6 +273,235 @@ void stress_set_hdd_write_size(const char *optarg)
 		MIN_HDD_WRITE_SIZE, MAX_HDD_WRITE_SIZE);
 }
 
+/*
+ *  stress_set_hdd_engine()
+ *	set the I/O engine
+ */
+int stress_set_hdd_engine(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(hdd_engines); i++) {
+		if (!strcmp(name, hdd_engines[i].name)) {
+			opt_hdd_engine = hdd_engines[i].engine;
+			return 0;
+		}
+	}
+	fprintf(stderr, "hdd-engine must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(hdd_engines); i++)
+		fprintf(stderr, " %s", hdd_engines[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_hdd_qd()
+ *	set the queue depth of the asynchronous engines
+ */
+void stress_set_hdd_qd(const char *optarg)
+{
+	uint64_t qd;
+
+	qd = get_uint64(optarg);
+	check_range("hdd-qd", qd, MIN_HDD_QD, MAX_HDD_QD);
+	opt_hdd_qd = (uint32_t)qd;
+}
+
+/*
+ *  stress_set_hdd_dist()
+ *	set the random offset distribution
+ */
+int stress_set_hdd_dist(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(hdd_dists); i++) {
+		if (!strcmp(name, hdd_dists[i].name)) {
+			opt_hdd_dist = hdd_dists[i].dist;
+			return 0;
+		}
+	}
+	fprintf(stderr, "hdd-dist must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(hdd_dists); i++)
+		fprintf(stderr, " %s", hdd_dists[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_hdd_rw_mix()
+ *	set the percentage of reads in the mixed read/write pass
+ */
+void stress_set_hdd_rw_mix(const char *optarg)
+{
+	uint64_t mix;
+
+	set_hdd_rw_mix = true;
+	mix = get_uint64(optarg);
+	check_range("hdd-rw-mix", mix, MIN_HDD_RW_MIX, MAX_HDD_RW_MIX);
+	opt_hdd_rw_mix = (uint32_t)mix;
+}
+
+/*
+ *  stress_set_hdd_paths()
+ *	set the colon separated directories the instances are
+ *	spread across, or that each instance stripes across
+ */
+int stress_set_hdd_paths(const char *optarg)
+{
+	char *str, *path, *ptr;
+	struct stat statbuf;
+
+	str = strdup(optarg);
+	if (!str) {
+		fprintf(stderr, "hdd-paths: out of memory\n");
+		return -1;
+	}
+	for (ptr = str; (path = strsep(&ptr, ":")) != NULL; ) {
+		if (!*path)
+			continue;
+		if (opt_hdd_npaths >= HDD_PATHS_MAX) {
+			fprintf(stderr, "hdd-paths: more than %d paths\n",
+				HDD_PATHS_MAX);
+			return -1;
+		}
+		if ((stat(path, &statbuf) < 0) || !S_ISDIR(statbuf.st_mode) ||
+		    (access(path, R_OK | W_OK) < 0)) {
+			fprintf(stderr, "hdd-paths: '%s' must be a readable "
+				"and writeable directory\n", path);
+			return -1;
+		}
+		opt_hdd_paths[opt_hdd_npaths++] = path;
+	}
+	if (!opt_hdd_npaths) {
+		fprintf(stderr, "hdd-paths: no paths given\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_set_hdd_stripe()
+ *	set the stripe size, this enables the striped mode
+ */
+void stress_set_hdd_stripe(const char *optarg)
+{
+	opt_hdd_stripe = get_uint64_byte(optarg);
+	check_range("hdd-stripe", opt_hdd_stripe,
+		MIN_HDD_STRIPE, MAX_HDD_STRIPE);
+}
+
+/*
+ *  stress_hdd_zeta()
+ *	zeta(n, theta) = sum 1/i^theta for i = 1..n, the
+ *	tail beyond HDD_ZIPF_EXACT terms is integrated
+ */
+static double stress_hdd_zeta(const uint64_t n, const double theta)
+{
+	const uint64_t m = (n < HDD_ZIPF_EXACT) ? n : HDD_ZIPF_EXACT;
+	double sum = 0.0;
+	uint64_t i;
+
+	for (i = 1; i <= m; i++)
+		sum += 1.0 / pow((double)i, theta);
+	if (n > m)
+		sum += (pow((double)n + 0.5, 1.0 - theta) -
+			pow((double)m + 0.5, 1.0 - theta)) / (1.0 - theta);
+	return sum;
+}
+
+/*
+ *  stress_hdd_dist_init()
+ *	set up the block distribution once the file and
+ *	I/O sizes are known
+ */
+static void stress_hdd_dist_init(const char *name)
+{
+	const double theta = HDD_ZIPF_THETA;
+
+	hdd_nblocks = opt_hdd_bytes / opt_hdd_write_size;
+	if (hdd_nblocks < 1)
+		hdd_nblocks = 1;
+	if ((opt_hdd_dist != HDD_DIST_ZIPF) || (hdd_nblocks < 2))
+		return;
+
+	hdd_zipf_zetan = stress_hdd_zeta(hdd_nblocks, theta);
+	hdd_zipf_alpha = 1.0 / (1.0 - theta);
+	hdd_zipf_eta = (1.0 - pow(2.0 / (double)hdd_nblocks, 1.0 - theta)) /
+		(1.0 - stress_hdd_zeta(2, theta) / hdd_zipf_zetan);
+	pr_dbg(stderr, "%s: zipf distribution over %" PRIu64
+		" blocks, theta %.2f\n", name, hdd_nblocks, theta);
+}
+
+/*
+ *  stress_hdd_block()
+ *	pick a write size block of the file using the
+ *	selected distribution.  Zipf ranks (Gray et al.) are
+ *	hashed so the popular blocks are spread over the file,
+ *	the hotspot is the start of the file.
+ */
+static uint64_t stress_hdd_block(void)
+{
+	switch (opt_hdd_dist) {
+	case HDD_DIST_ZIPF:
+		if (hdd_nblocks > 1) {
+			const double u = (double)mwc64() / 18446744073709551616.0;
+			const double uz = u * hdd_zipf_zetan;
+			uint64_t rank, h;
+
+			if (uz < 1.0)
+				rank = 0;
+			else if (uz < 1.0 + pow(0.5, HDD_ZIPF_THETA))
+				rank = 1;
+			else
+				rank = (uint64_t)((double)hdd_nblocks *
+					pow(hdd_zipf_eta * u - hdd_zipf_eta + 1.0,
+					    hdd_zipf_alpha));
+			/* 64 bit finalizer mix of the rank */
+			h = rank + 0x9e3779b97f4a7c15ULL;
+			h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+			h ^= h >> 31;
+			return h % hdd_nblocks;
+		}
+		return 0;
+	case HDD_DIST_HOTSPOT:
+		{
+			uint64_t hot = (hdd_nblocks * HDD_HOTSPOT_PERCENT) / 100;
+
+			if (hot < 1)
+				hot = 1;
+			if ((hot >= hdd_nblocks) ||
+			    ((mwc32() % 100) < HDD_HOTSPOT_HITS))
+				return mwc64() % hot;
+			return hot + (mwc64() % (hdd_nblocks - hot));
+		}
+	default:
+		return mwc64() % hdd_nblocks;
+	}
+}
+
+/*
+ *  stress_hdd_rnd_offset()
+ *	random I/O offset below range, uniform offsets are
+ *	512 byte aligned, skewed ones are block aligned
+ */
+static off_t stress_hdd_rnd_offset(const uint64_t range)
+{
+	if (opt_hdd_dist == HDD_DIST_UNIFORM)
+		return (off_t)((mwc64() % range) & ~(hdd_offset_align - 1));
+	return (off_t)(stress_hdd_block() * opt_hdd_write_size);
+}
+
+/*
+ *  stress_hdd_mix_write()
+ *	decide if the next mixed pass I/O is a write
+ */
+static inline bool stress_hdd_mix_write(void)
+{
+	return (mwc32() % 100) >= opt_hdd_rw_mix;
+}
+
 /*
  *  stress_hdd_write()
  *	write with writev or write depending on mode
@@ -321,6 +659,836 @@ static int stress_hdd_advise(const char *name, const int fd, const int flags)
 #endif
 	return 0;
 }
+#if defined(HDD_ASYNC)
+/*
+ *  stress_hdd_async_init()
+ *	set up the queue and qd aligned I/O buffers,
+ *	returns -errno on failure
+ */
+static int stress_hdd_async_init(
+	hdd_async_t *a,
+	const char *name,
+	const int engine,
+	const uint32_t qd)
+{
+	uint32_t i;
+	int ret;
+
+	memset(a, 0, sizeof(*a));
+	a->name = name;
+	a->engine = engine;
+	a->fd = -1;
+	a->qd = qd;
+
+	ret = io_buffers_alloc(&a->io_bufs, stress_get_temp_path(),
+		(size_t)opt_hdd_write_size, qd);
+	if (ret < 0)
+		return -ENOMEM;
+	a->bufs = a->io_bufs.base;
+	a->stride = a->io_bufs.stride;
+	a->free = calloc(qd, sizeof(*a->free));
+	a->offset = calloc(qd, sizeof(*a->offset));
+	a->write = calloc(qd, sizeof(*a->write));
+	if (!a->free || !a->offset || !a->write)
+		goto err_free;
+	for (i = 0; i < qd; i++) {
+		stress_strnrnd((char *)(a->bufs + (a->stride * i)),
+			opt_hdd_write_size);
+		a->free[i] = i;
+	}
+	a->nfree = qd;
+
+	switch (engine) {
+#if defined(STRESS_URING)
+	case HDD_ENGINE_IO_URING:
+		ret = uring_setup(&a->ring, qd, false);
+		if (ret < 0)
+			goto err_free_ret;
+		/*
+		 *  Registered buffers are capped in size, so just
+		 *  use plain reads and writes if this fails
+		 */
+		a->fixed_bufs = (uring_register_buffer(&a->ring,
+			a->bufs, a->stride * qd) == 0);
+		if (!a->fixed_bufs)
+			pr_dbg(stderr, "%s: cannot register the I/O buffers, "
+				"not using fixed buffers\n", name);
+		break;
+#endif
+#if defined(STRESS_AIO_LINUX)
+	case HDD_ENGINE_LIBAIO:
+		a->cbs = calloc(qd, sizeof(*a->cbs));
+		a->pending = calloc(qd, sizeof(*a->pending));
+		a->events = calloc(qd, sizeof(*a->events));
+		if (!a->cbs || !a->pending || !a->events) {
+			ret = -ENOMEM;
+			goto err_free_aio;
+		}
+		ret = io_setup((int)qd, &a->ctx);
+		if (ret < 0)
+			goto err_free_aio;
+		break;
+#endif
+	default:
+		break;
+	}
+	return 0;
+
+#if defined(STRESS_AIO_LINUX)
+err_free_aio:
+	free(a->events);
+	free(a->pending);
+	free(a->cbs);
+#endif
+#if defined(STRESS_URING)
+err_free_ret:
+#endif
+	free(a->write);
+	free(a->offset);
+	free(a->free);
+	io_buffers_free(&a->io_bufs);
+	return ret;
+err_free:
+	free(a->write);
+	free(a->offset);
+	free(a->free);
+	io_buffers_free(&a->io_bufs);
+	return -ENOMEM;
+}
+
+/*
+ *  stress_hdd_async_free()
+ *	tear down the queue
+ */
+static void stress_hdd_async_free(hdd_async_t *a)
+{
+	switch (a->engine) {
+#if defined(STRESS_URING)
+	case HDD_ENGINE_IO_URING:
+		uring_free(&a->ring);
+		break;
+#endif
+#if defined(STRESS_AIO_LINUX)
+	case HDD_ENGINE_LIBAIO:
+		(void)io_destroy(a->ctx);
+		free(a->events);
+		free(a->pending);
+		free(a->cbs);
+		break;
+#endif
+	default:
+		break;
+	}
+	free(a->write);
+	free(a->offset);
+	free(a->free);
+	io_buffers_free(&a->io_bufs);
+}
+
+/*
+ *  stress_hdd_async_open()
+ *	start using fd, io_uring registers it as a fixed file
+ */
+static void stress_hdd_async_open(hdd_async_t *a, const int fd)
+{
+	a->fd = fd;
+#if defined(STRESS_URING)
+	if (a->engine == HDD_ENGINE_IO_URING)
+		a->fixed_file = (uring_register_files(&a->ring, &a->fd, 1) == 0);
+#endif
+}
+
+/*
+ *  stress_hdd_async_close()
+ *	stop using the current fd
+ */
+static void stress_hdd_async_close(hdd_async_t *a)
+{
+#if defined(STRESS_URING)
+	if ((a->engine == HDD_ENGINE_IO_URING) && a->fixed_file) {
+		(void)uring_register_files(&a->ring, NULL, 0);
+		a->fixed_file = false;
+	}
+#endif
+	a->fd = -1;
+}
+
+/*
+ *  stress_hdd_async_queue()
+ *	queue a read or write of a slot's buffer at offset,
+ *	it is not submitted until stress_hdd_async_reap()
+ */
+static int stress_hdd_async_queue(
+	hdd_async_t *a,
+	const uint32_t slot,
+	const bool wr,
+	const off_t offset)
+{
+	uint8_t *buf = a->bufs + (a->stride * slot);
+	const size_t size = (size_t)opt_hdd_write_size;
+	const uint64_t sz = opt_hdd_write_size / HDD_IO_VEC_MAX;
+	const bool iovec = !!(opt_hdd_flags & HDD_OPT_IOVEC);
+	static struct iovec iovs[MAX_HDD_QD][HDD_IO_VEC_MAX];
+	struct iovec *iov = iovs[slot];
+	size_t i;
+
+	a->offset[slot] = offset;
+	a->write[slot] = wr;
+	if (iovec) {
+		for (i = 0; i < HDD_IO_VEC_MAX; i++) {
+			iov[i].iov_base = (void *)(buf + (sz * i));
+			iov[i].iov_len = (size_t)sz;
+		}
+	}
+
+	switch (a->engine) {
+#if defined(STRESS_URING)
+	case HDD_ENGINE_IO_URING:
+		{
+			struct io_uring_sqe *sqe;
+			uint8_t opcode;
+
+			if (iovec)
+				opcode = wr ? IORING_OP_WRITEV : IORING_OP_READV;
+			else if (a->fixed_bufs)
+				opcode = wr ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+			else
+				opcode = wr ? IORING_OP_WRITE : IORING_OP_READ;
+
+			sqe = uring_prep_rw(&a->ring, opcode,
+				a->fixed_file ? 0 : a->fd,
+				iovec ? (void *)iov : (void *)buf,
+				iovec ? HDD_IO_VEC_MAX : (uint32_t)size,
+				(uint64_t)offset, slot);
+			if (!sqe)
+				return -1;
+			if (a->fixed_file)
+				sqe->flags |= IOSQE_FIXED_FILE;
+		}
+		break;
+#endif
+#if defined(STRESS_AIO_LINUX)
+	case HDD_ENGINE_LIBAIO:
+		{
+			struct iocb *cb = &a->cbs[slot];
+
+			if (iovec) {
+				if (wr)
+					io_prep_pwritev(cb, a->fd, iov, HDD_IO_VEC_MAX, offset);
+				else
+					io_prep_preadv(cb, a->fd, iov, HDD_IO_VEC_MAX, offset);
+			} else {
+				if (wr)
+					io_prep_pwrite(cb, a->fd, buf, size, offset);
+				else
+					io_prep_pread(cb, a->fd, buf, size, offset);
+			}
+			cb->data = (void *)(uintptr_t)slot;
+			a->pending[a->npending++] = cb;
+		}
+		break;
+#endif
+	default:
+		return -1;
+	}
+	a->inflight++;
+	return 0;
+}
+
+/*
+ *  stress_hdd_async_reap()
+ *	submit the queued I/Os and wait for at least one
+ *	to complete, returns the number of completions
+ *	filled into slots[] and res[] or -errno
+ */
+static int stress_hdd_async_reap(
+	hdd_async_t *a,
+	uint32_t *slots,
+	int64_t *res)
+{
+	int n = 0;
+
+	switch (a->engine) {
+#if defined(STRESS_URING)
+	case HDD_ENGINE_IO_URING:
+		{
+			stress_uring_t *r = &a->ring;
+			unsigned head = *r->cq_head;
+			unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+			int ret;
+
+			ret = uring_submit(r, (head == tail) ? 1 : 0);
+			if ((ret < 0) && (ret != -EINTR) && (ret != -EBUSY))
+				return ret;
+			tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+			for (; head != tail; head++, n++) {
+				const struct io_uring_cqe *cqe =
+					&r->cqes[head & r->cq_mask];
+
+				slots[n] = (uint32_t)cqe->user_data;
+				res[n] = cqe->res;
+			}
+			__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+		}
+		break;
+#endif
+#if defined(STRESS_AIO_LINUX)
+	case HDD_ENGINE_LIBAIO:
+		{
+			int i, ret;
+
+			while (a->npending) {
+				ret = io_submit(a->ctx, (long)a->npending, a->pending);
+				if (ret == -EAGAIN)
+					break;
+				if (ret < 0)
+					return ret;
+				a->npending -= (uint32_t)ret;
+				memmove(a->pending, a->pending + ret,
+					a->npending * sizeof(*a->pending));
+			}
+			ret = io_getevents(a->ctx, 1, (long)a->qd, a->events, NULL);
+			if (ret == -EINTR)
+				return 0;
+			if (ret < 0)
+				return ret;
+			for (i = 0; i < ret; i++) {
+				slots[i] = (uint32_t)(uintptr_t)a->events[i].data;
+				res[i] = (int64_t)a->events[i].res;
+			}
+			n = ret;
+		}
+		break;
+#endif
+	default:
+		return -EINVAL;
+	}
+	a->inflight -= (uint32_t)n;
+	return n;
+}
+
+/*
+ *  stress_hdd_async_rw()
+ *	one write or read pass over the file keeping up to
+ *	qd I/Os in flight; mode is one of HDD_OPT_WR_SEQ,
+ *	HDD_OPT_WR_RND, HDD_OPT_RD_SEQ, HDD_OPT_RD_RND or
+ *	HDD_MODE_MIX for random reads and writes mixed by
+ *	--hdd-rw-mix.  The sync hdd-opts are applied once per
+ *	batch of completions rather than per write, returns
+ *	-1 on failure
+ */
+static int stress_hdd_async_rw(
+	hdd_async_t *a,
+	const int mode,
+	const uint64_t size,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const bool mix = (mode == HDD_MODE_MIX);
+	const bool wr = !!(mode & HDD_OPT_WR_MASK);
+	const bool rnd = mix || !!(mode & (HDD_OPT_WR_RND | HDD_OPT_RD_RND));
+	uint64_t i = 0, misreads = 0, baddata = 0;
+	uint32_t slots[MAX_HDD_QD];
+	int64_t res[MAX_HDD_QD];
+	bool full = false;
+	int rc = 0;
+
+	for (;;) {
+		int n, k;
+		bool written = false;
+
+		/* keep the queue topped up */
+		while ((i < size) && a->nfree && opt_do_run &&
+		       (!max_ops || (*counter + a->inflight) < max_ops)) {
+			const uint32_t slot = a->free[--a->nfree];
+			uint8_t *buf = a->bufs + (a->stride * slot);
+			const bool wr_io = mix ? stress_hdd_mix_write() : wr;
+			off_t offset;
+
+			if (wr_io && full) {
+				/* out of space, no more writes this pass */
+				a->free[a->nfree++] = slot;
+				if (!mix)
+					break;
+				i += opt_hdd_write_size;
+				continue;
+			}
+			if (mix)
+				offset = (off_t)(stress_hdd_block() * opt_hdd_write_size);
+			else if (!rnd)
+				offset = (off_t)i;
+			else if (wr)
+				offset = (i == 0) ? (off_t)opt_hdd_bytes :
+					stress_hdd_rnd_offset(opt_hdd_bytes);
+			else
+				offset = stress_hdd_rnd_offset(opt_hdd_bytes -
+					opt_hdd_write_size);
+
+			if (wr_io) {
+				size_t j;
+
+				if (rnd) {
+					for (j = 0; j < opt_hdd_write_size; j++)
+						buf[j] = (offset + j) & 0xff;
+				} else {
+					for (j = 0; j < opt_hdd_write_size; j += 512)
+						buf[j] = (offset + j) & 0xff;
+				}
+			}
+			if (stress_hdd_async_queue(a, slot, wr_io, offset) < 0) {
+				a->free[a->nfree++] = slot;
+				pr_fail(stderr, "%s: cannot queue I/O\n", a->name);
+				rc = -1;
+				break;
+			}
+			i += opt_hdd_write_size;
+		}
+		if (!a->inflight)
+			break;
+
+		n = stress_hdd_async_reap(a, slots, res);
+		if (n < 0) {
+			errno = -n;
+			pr_fail_err(a->name, mix ? "async I/O" :
+				(wr ? "async write" : "async read"));
+			return -1;
+		}
+		for (k = 0; k < n; k++) {
+			const uint32_t slot = slots[k];
+			const uint8_t *buf = a->bufs + (a->stride * slot);
+			const bool wr_io = a->write[slot];
+
+			a->free[a->nfree++] = slot;
+			if (res[k] < 0) {
+				if ((res[k] == -EAGAIN) || (res[k] == -EINTR))
+					continue;
+				if (wr_io && (res[k] == -ENOSPC)) {
+					full = true;
+					continue;
+				}
+				errno = (int)-res[k];
+				pr_fail_err(a->name, wr_io ? "write" : "read");
+				rc = -1;
+				continue;
+			}
+			if (wr_io) {
+				written = true;
+			} else {
+				if (res[k] != (int64_t)opt_hdd_write_size)
+					misreads++;
+				if (res[k] && (opt_flags & OPT_FLAGS_VERIFY)) {
+					const uint8_t v = a->offset[slot] & 0xff;
+
+					if (!mix && (opt_hdd_flags & HDD_OPT_WR_SEQ)) {
+						if (buf[0] != v)
+							baddata++;
+					} else {
+						if ((buf[0] != 0) && (buf[0] != v))
+							baddata++;
+					}
+				}
+			}
+			(*counter)++;
+		}
+		if (written) {
+#if _BSD_SOURCE || _XOPEN_SOURCE || _POSIX_C_SOURCE >= 200112L
+			if (opt_hdd_flags & HDD_OPT_FSYNC)
+				(void)fsync(a->fd);
+#endif
+#if _POSIX_C_SOURCE >= 199309L || _XOPEN_SOURCE >= 500
+			if (opt_hdd_flags & HDD_OPT_FDATASYNC)
+				(void)fdatasync(a->fd);
+#endif
+#if defined(_GNU_SOURCE) && NEED_GLIBC(2,14,0) && defined(__linux__)
+			if (opt_hdd_flags & HDD_OPT_SYNCFS)
+				(void)syncfs(a->fd);
+#endif
+		}
+#if !defined(__sun__)
+		if (n && (opt_hdd_flags & HDD_OPT_UTIMES))
+			(void)futimes(a->fd, NULL);
+#endif
+		if (rc < 0)
+			break;
+	}
+
+	/* drain anything still in flight so no slot is left busy */
+	while (a->inflight) {
+		const int n = stress_hdd_async_reap(a, slots, res);
+		int k;
+
+		if (n < 0)
+			break;
+		for (k = 0; k < n; k++)
+			a->free[a->nfree++] = slots[k];
+	}
+
+	if (misreads)
+		pr_dbg(stderr, "%s: %" PRIu64 " incomplete %s reads\n",
+			a->name, misreads, rnd ? "random" : "sequential");
+	if (baddata)
+		pr_fail(stderr, "%s: incorrect data found %"
+			PRIu64 " times\n", a->name, baddata);
+	return rc;
+}
+#endif
+
+/* One file of a striped stream, each is driven by its own thread */
+typedef struct {
+	const char *name;		/* stressor name */
+	const char *path;		/* --hdd-paths directory */
+	char mount[PATH_MAX];		/* mount point the path is on */
+	char filename[PATH_MAX];
+	dev_t dev;			/* device the path is on */
+	uint32_t index;			/* position in the stripe set */
+	uint32_t files;			/* files in the stripe set */
+	uint64_t *counter;		/* bogo ops, shared by the set */
+	uint64_t max_ops;
+	uint64_t wr_bytes, rd_bytes;	/* bytes moved */
+	double wr_time, rd_time;	/* time in the write and read passes */
+	uint64_t baddata;		/* --verify mismatches */
+	int ret;			/* EXIT_ status */
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_t pthread;
+	int pthread_ret;		/* pthread_create return */
+#endif
+} hdd_stripe_t;
+
+/*
+ *  stress_hdd_stripe_mount()
+ *	find the mount point a directory is on, the longest
+ *	mount point that prefixes its real path
+ */
+static void stress_hdd_stripe_mount(hdd_stripe_t *s)
+{
+	char real[PATH_MAX], *mnts[HDD_MOUNTS_MAX];
+	size_t best = 0;
+	int i, n;
+
+	(void)snprintf(s->mount, sizeof(s->mount), "%s", s->path);
+	if (!realpath(s->path, real))
+		return;
+	n = mount_get(mnts, HDD_MOUNTS_MAX);
+	for (i = 0; i < n; i++) {
+		const size_t len = strlen(mnts[i]);
+
+		if ((len <= best) && best)
+			continue;
+		if (!strcmp(mnts[i], "/") ||
+		    (!strncmp(real, mnts[i], len) &&
+		     ((real[len] == '/') || (real[len] == '\0')))) {
+			(void)snprintf(s->mount, sizeof(s->mount), "%s", mnts[i]);
+			best = len;
+		}
+	}
+	mount_free(mnts, n);
+}
+
+/*
+ *  stress_hdd_stripe_keep_running()
+ *	true until the run ends or the set has done max_ops
+ */
+static inline bool stress_hdd_stripe_keep_running(const hdd_stripe_t *s)
+{
+	return opt_do_run && (!s->max_ops || *s->counter < s->max_ops);
+}
+
+/*
+ *  stress_hdd_stripe_io()
+ *	write or read the stripes of the logical stream that live in
+ *	this file, block by block, the first 8 bytes of each 512 byte
+ *	sector hold its logical offset so misplaced stripes are found
+ */
+static int stress_hdd_stripe_io(
+	hdd_stripe_t *s,
+	const int fd,
+	uint8_t *buf,
+	const bool wr)
+{
+	const uint64_t stripes = (opt_hdd_bytes + opt_hdd_stripe - 1) / opt_hdd_stripe;
+	const double t = time_now();
+	uint64_t stripe, *bytes = wr ? &s->wr_bytes : &s->rd_bytes;
+
+	for (stripe = s->index; stripe < stripes; stripe += s->files) {
+		const off_t base = (off_t)((stripe / s->files) * opt_hdd_stripe);
+		uint64_t i;
+
+		for (i = 0; i < opt_hdd_stripe; i += opt_hdd_write_size) {
+			const uint64_t logical = (stripe * opt_hdd_stripe) + i;
+			ssize_t ret;
+			size_t j;
+
+			if (logical >= opt_hdd_bytes)
+				break;
+			if (!stress_hdd_stripe_keep_running(s))
+				goto done;
+			if (wr) {
+				for (j = 0; j + sizeof(uint64_t) <= opt_hdd_write_size; j += 512)
+					*(uint64_t *)(buf + j) = logical + j;
+				ret = pwrite(fd, buf, (size_t)opt_hdd_write_size,
+					base + (off_t)i);
+			} else {
+				ret = pread(fd, buf, (size_t)opt_hdd_write_size,
+					base + (off_t)i);
+			}
+			if (ret < 0) {
+				if ((errno == EAGAIN) || (errno == EINTR))
+					continue;
+				if (wr && (errno == ENOSPC))
+					goto done;
+				pr_fail(stderr, "%s: %s %s failed: errno=%d (%s)\n",
+					s->name, wr ? "pwrite to" : "pread from",
+					s->filename, errno, strerror(errno));
+				s->ret = EXIT_FAILURE;
+				return -1;
+			}
+			*bytes += (uint64_t)ret;
+			if (!wr && (opt_flags & OPT_FLAGS_VERIFY)) {
+				/* Zero is a hole left by a short write pass */
+				for (j = 0; j + sizeof(uint64_t) <= (size_t)ret; j += 512) {
+					const uint64_t v = *(uint64_t *)(buf + j);
+
+					if ((v != 0) && (v != logical + j))
+						s->baddata++;
+				}
+			}
+			(void)__sync_fetch_and_add(s->counter, 1);
+		}
+	}
+done:
+	if (wr)
+		s->wr_time += time_now() - t;
+	else
+		s->rd_time += time_now() - t;
+	return 0;
+}
+
+/*
+ *  stress_hdd_stripe_file()
+ *	write then read back the stripes of one file until the end
+ *	of the run, the file is unlinked as soon as it is open
+ */
+static void *stress_hdd_stripe_file(void *arg)
+{
+	static void *nowt = NULL;
+	hdd_stripe_t *s = (hdd_stripe_t *)arg;
+	io_buffers_t bufs;
+	uint8_t *buf;
+	int fd;
+#if defined(HAVE_LIB_PTHREAD)
+	sigset_t set;
+
+	/* Leave all signal handling to the instance thread */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+#endif
+
+	s->ret = EXIT_FAILURE;
+	if (io_buffers_alloc(&bufs, s->path, (size_t)opt_hdd_write_size, 1) < 0) {
+		pr_err(stderr, "%s: cannot allocate buffer\n", s->name);
+		s->ret = EXIT_NO_RESOURCE;
+		return &nowt;
+	}
+	buf = io_buffer(&bufs, 0);
+	(void)umask(0077);
+	fd = open(s->filename, O_CREAT | O_RDWR | O_TRUNC | opt_hdd_oflags,
+		S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		pr_fail(stderr, "%s: cannot open %s: errno=%d (%s)\n",
+			s->name, s->filename, errno, strerror(errno));
+		io_buffers_free(&bufs);
+		return &nowt;
+	}
+	(void)unlink(s->filename);
+
+	s->ret = EXIT_SUCCESS;
+	while (stress_hdd_stripe_keep_running(s)) {
+		if (ftruncate(fd, (off_t)0) < 0) {
+			pr_fail(stderr, "%s: ftruncate of %s failed: errno=%d (%s)\n",
+				s->name, s->filename, errno, strerror(errno));
+			s->ret = EXIT_FAILURE;
+			break;
+		}
+		if (stress_hdd_stripe_io(s, fd, buf, true) < 0)
+			break;
+		if ((opt_hdd_flags & HDD_OPT_FSYNC) && (fsync(fd) < 0))
+			pr_dbg(stderr, "%s: fsync of %s failed: errno=%d (%s)\n",
+				s->name, s->filename, errno, strerror(errno));
+		if (stress_hdd_stripe_io(s, fd, buf, false) < 0)
+			break;
+	}
+	(void)close(fd);
+	io_buffers_free(&bufs);
+
+	return &nowt;
+}
+
+/*
+ *  stress_hdd_stripe()
+ *	stripe a logical stream of --hdd-bytes across one file in
+ *	each --hdd-paths directory in --hdd-stripe sized stripes,
+ *	each file is driven by its own thread so that all the
+ *	devices are busy at once, as with RAID 0
+ */
+static int stress_hdd_stripe(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const pid_t pid = getpid();
+	const uint32_t files = opt_hdd_npaths ? (uint32_t)opt_hdd_npaths : 1;
+	hdd_stripe_t *stripes;
+	double wr_total = 0.0, rd_total = 0.0;
+	uint64_t baddata = 0;
+	int rc = EXIT_SUCCESS;
+	uint32_t i, dirs = 0;
+
+	/* Each stripe must be a whole number of I/Os */
+	if (opt_hdd_stripe % opt_hdd_write_size) {
+		opt_hdd_stripe += opt_hdd_write_size - (opt_hdd_stripe % opt_hdd_write_size);
+		if (instance == 0)
+			pr_inf(stderr, "%s: increasing stripe size to %" PRIu64
+				" bytes, a multiple of the write size\n",
+				name, opt_hdd_stripe);
+	}
+	if ((files < 2) && (instance == 0))
+		pr_inf(stderr, "%s: striping across one file, use --hdd-paths "
+			"to stripe across devices\n", name);
+
+	stripes = calloc(files, sizeof(*stripes));
+	if (!stripes) {
+		pr_err(stderr, "%s: cannot allocate stripes\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < files; i++) {
+		hdd_stripe_t *s = &stripes[i];
+		struct stat statbuf;
+		int ret;
+
+		s->name = name;
+		s->path = opt_hdd_npaths ? opt_hdd_paths[i] : stress_get_temp_path();
+		s->index = i;
+		s->files = files;
+		s->counter = counter;
+		s->max_ops = max_ops;
+		stress_hdd_stripe_mount(s);
+		if (stat(s->path, &statbuf) == 0)
+			s->dev = statbuf.st_dev;
+
+		/* The temp helpers work on the current temp path */
+		if (stress_set_temp_path((char *)s->path) < 0) {
+			rc = EXIT_FAILURE;
+			goto tidy;
+		}
+		ret = stress_temp_dir_mk(name, pid, instance);
+		if (ret < 0) {
+			rc = exit_status(-ret);
+			goto tidy;
+		}
+		dirs++;
+		(void)stress_temp_filename(s->filename, sizeof(s->filename),
+			name, pid, instance, mwc32());
+	}
+
+#if defined(HAVE_LIB_PTHREAD)
+	for (i = 0; i < files; i++)
+		stripes[i].pthread_ret = pthread_create(&stripes[i].pthread, NULL,
+			stress_hdd_stripe_file, &stripes[i]);
+	for (i = 0; i < files; i++) {
+		if (stripes[i].pthread_ret) {
+			pr_fail(stderr, "%s: cannot create thread for %s: errno=%d (%s)\n",
+				name, stripes[i].path, stripes[i].pthread_ret,
+				strerror(stripes[i].pthread_ret));
+			stripes[i].ret = EXIT_FAILURE;
+			continue;
+		}
+		(void)pthread_join(stripes[i].pthread, NULL);
+	}
+#else
+	/* No threads, the files take turns so the devices are not overlapped */
+	for (i = 0; i < files; i++)
+		(void)stress_hdd_stripe_file(&stripes[i]);
+#endif
+
+	for (i = 0; i < files; i++) {
+		const hdd_stripe_t *s = &stripes[i];
+		const double wr_rate = (s->wr_time > 0.0) ?
+			(double)s->wr_bytes / (s->wr_time * MB) : 0.0;
+		const double rd_rate = (s->rd_time > 0.0) ?
+			(double)s->rd_bytes / (s->rd_time * MB) : 0.0;
+		char desc[32];
+
+		if (s->ret != EXIT_SUCCESS)
+			rc = s->ret;
+		baddata += s->baddata;
+		wr_total += wr_rate;
+		rd_total += rd_rate;
+		if (instance == 0) {
+#if defined(__linux__)
+			pr_inf(stderr, "%s: %s on %s (%u:%u), write %.2f MB/s, "
+				"read %.2f MB/s\n", name, s->path, s->mount,
+				major(s->dev), minor(s->dev), wr_rate, rd_rate);
+#else
+			pr_inf(stderr, "%s: %s on %s, write %.2f MB/s, "
+				"read %.2f MB/s\n", name, s->path, s->mount,
+				wr_rate, rd_rate);
+#endif
+		}
+		/* Two metrics per file, after the two aggregate ones */
+		if (2 + (2 * (i + 1)) > STRESS_MISC_METRIC_HUGEPAGES)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "path %" PRIu32 " write MB/s", i);
+		stress_misc_metric_set(2 + (2 * i), desc, wr_rate);
+		(void)snprintf(desc, sizeof(desc), "path %" PRIu32 " read MB/s", i);
+		stress_misc_metric_set(3 + (2 * i), desc, rd_rate);
+	}
+	/* The files are on their own threads, so their rates add up */
+	stress_misc_metric_set(0, "aggregate write MB/s", wr_total);
+	stress_misc_metric_set(1, "aggregate read MB/s", rd_total);
+	pr_dbg(stderr, "%s: %" PRIu32 " files, %" PRIu64 " byte stripes, "
+		"aggregate write %.2f MB/s, read %.2f MB/s (instance %"
+		PRIu32 ")\n", name, files, opt_hdd_stripe, wr_total,
+		rd_total, instance);
+	if (baddata) {
+		pr_fail(stderr, "%s: incorrect data found %" PRIu64 " times\n",
+			name, baddata);
+		rc = EXIT_FAILURE;
+	}
+
+tidy:
+	for (i = 0; i < dirs; i++) {
+		if (stress_set_temp_path((char *)stripes[i].path) == 0)
+			(void)stress_temp_dir_rm(name, pid, instance);
+	}
+	free(stripes);
+
+	return rc;
+}
+
+/*
+ *  stress_hdd_io_align()
+ *	the O_DIRECT I/O alignment of the directories this instance
+ *	writes to, the largest if it stripes across several
+ */
+static uint64_t stress_hdd_io_align(const uint32_t instance)
+{
+	size_t mem_align, io_align, i;
+	uint64_t align = 0;
+
+	if (!opt_hdd_npaths) {
+		io_direct_align(stress_get_temp_path(), &mem_align, &io_align);
+		return io_align;
+	}
+	for (i = 0; i < opt_hdd_npaths; i++) {
+		if (!opt_hdd_stripe && (i != instance % opt_hdd_npaths))
+			continue;
+		io_direct_align(opt_hdd_paths[i], &mem_align, &io_align);
+		align = STRESS_MAXIMUM(align, io_align);
+	}
+	return align;
+}
+
 /*
  *  stress_hdd
  *	stress I/O via writes
@@ -333,6 +1501,9 @@ int stress_hdd(
 {
 	uint8_t *buf = NULL;
 	uint64_t i, min_size, remainder;
+	const uint64_t io_align = stress_hdd_io_align(instance);
+	const bool direct = (opt_hdd_flags & HDD_OPT_O_DIRECT) ||
+		(!opts_set && (opt_flags & OPT_FLAGS_AGGRESSIVE));
 	const pid_t pid = getpid();
 	int rc = EXIT_FAILURE;
 	ssize_t ret;
@@ -340,6 +1511,12 @@ int stress_hdd(
 	int flags = O_CREAT | O_RDWR | O_TRUNC | opt_hdd_oflags;
 	int fadvise_flags = opt_hdd_flags & HDD_OPT_FADV_MASK;
 	size_t opt_index = 0;
+	stress_io_stats_t iostats;
+	io_buffers_t bufs;
+#if defined(HDD_ASYNC)
+	hdd_async_t async;
+	bool use_async = false;
+#endif
 
 	if (!set_hdd_bytes) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -355,9 +1532,10 @@ int stress_hdd(
 			opt_hdd_write_size = MIN_HDD_WRITE_SIZE;
 	}
 
-	if (opt_hdd_flags & HDD_OPT_O_DIRECT) {
+	if (direct) {
+		/* Each iovec chunk must be a whole number of device blocks */
 		min_size = (opt_hdd_flags & HDD_OPT_IOVEC) ?
-			HDD_IO_VEC_MAX * BUF_ALIGNMENT : MIN_HDD_WRITE_SIZE;
+			HDD_IO_VEC_MAX * io_align : io_align;
 	} else {
 		min_size = (opt_hdd_flags & HDD_OPT_IOVEC) ?
 			HDD_IO_VEC_MAX * MIN_HDD_WRITE_SIZE : MIN_HDD_WRITE_SIZE;
@@ -378,6 +1556,20 @@ int stress_hdd(
 			name, opt_hdd_write_size);
 	}
 
+	/* O_DIRECT sizes and offsets must be whole device blocks */
+	if (direct) {
+		remainder = opt_hdd_write_size % min_size;
+		if (remainder) {
+			opt_hdd_write_size += min_size - remainder;
+			pr_inf(stderr, "%s: increasing read/write size to %"
+				PRIu64 " bytes, a multiple of the %" PRIu64
+				" byte O_DIRECT alignment\n",
+				name, opt_hdd_write_size, min_size);
+		}
+		opt_hdd_bytes &= ~(io_align - 1);
+		hdd_offset_align = STRESS_MAXIMUM(hdd_offset_align, io_align);
+	}
+
 	/* Ensure complete file size is not less than the I/O size */
 	if (opt_hdd_bytes < opt_hdd_write_size) {
 		opt_hdd_bytes = opt_hdd_write_size;
@@ -385,11 +1577,19 @@ int stress_hdd(
 			PRIu64 " bytes\n",
 			name, opt_hdd_bytes);
 	}
+	stress_hdd_dist_init(name);
 
+	if (opt_hdd_stripe)
+		return stress_hdd_stripe(counter, instance, max_ops, name);
+	/* Spread the instances across the --hdd-paths directories */
+	if (opt_hdd_npaths &&
+	    (stress_set_temp_path(opt_hdd_paths[instance % opt_hdd_npaths]) < 0))
+		return EXIT_FAILURE;
 
 	ret = stress_temp_dir_mk(name, pid, instance);
 	if (ret < 0)
 		return exit_status(-ret);
+	io_stats_begin(&iostats);
 
 	/* Must have some write option */
 	if ((opt_hdd_flags & HDD_OPT_WR_MASK) == 0)
@@ -398,22 +1598,49 @@ int stress_hdd(
 	if ((opt_hdd_flags & HDD_OPT_RD_MASK) == 0)
 		opt_hdd_flags |= HDD_OPT_RD_SEQ;
 
-	ret = posix_memalign((void **)&buf, BUF_ALIGNMENT, (size_t)opt_hdd_write_size);
-	if (ret || !buf) {
-		rc = exit_status(errno);
+	ret = io_buffers_alloc(&bufs, stress_get_temp_path(),
+		(size_t)opt_hdd_write_size, 1);
+	if (ret < 0) {
+		rc = exit_status(-ret);
 		pr_err(stderr, "%s: cannot allocate buffer\n", name);
 		(void)stress_temp_dir_rm(name, pid, instance);
 		return rc;
 	}
+	buf = io_buffer(&bufs, 0);
 
 	stress_strnrnd((char *)buf, opt_hdd_write_size);
 
+#if defined(HDD_ASYNC)
+	if (opt_hdd_engine != HDD_ENGINE_SYNC) {
+		const char *engine = (opt_hdd_engine == HDD_ENGINE_IO_URING) ?
+			"io_uring" : "libaio";
+
+		ret = stress_hdd_async_init(&async, name, opt_hdd_engine, opt_hdd_qd);
+		if (ret == -ENOMEM) {
+			pr_err(stderr, "%s: cannot allocate %" PRIu32
+				" I/O buffers\n", name, opt_hdd_qd);
+			io_buffers_free(&bufs);
+			(void)stress_temp_dir_rm(name, pid, instance);
+			return EXIT_NO_RESOURCE;
+		} else if (ret < 0) {
+			if (instance == 0)
+				pr_inf(stderr, "%s: cannot set up %s: errno=%d (%s), "
+					"using the sync engine\n", name, engine,
+					(int)-ret, strerror((int)-ret));
+		} else {
+			use_async = true;
+			pr_dbg(stderr, "%s: using %s engine with queue depth %"
+				PRIu32 "\n", name, engine, opt_hdd_qd);
+		}
+	}
+#endif
+
 	(void)stress_temp_filename(filename, sizeof(filename),
 		name, pid, instance, mwc32());
 	do {
 		int fd;
 		struct stat statbuf;
-		uint64_t hdd_read_size;
+		uint64_t hdd_read_size = 0;
 
 		/*
 		 * aggressive option with no other option enables
@@ -449,14 +1676,60 @@ int stress_hdd(
 			goto finish;
 		}
 
+#if defined(HDD_ASYNC)
+		if (use_async) {
+			static const int modes[] = {
+				HDD_OPT_WR_RND, HDD_OPT_WR_SEQ,
+				HDD_OPT_RD_SEQ, HDD_OPT_RD_RND
+			};
+			size_t k;
+
+			stress_hdd_async_open(&async, fd);
+			for (k = 0; k < SIZEOF_ARRAY(modes); k++) {
+				if (!(opt_hdd_flags & modes[k]))
+					continue;
+				/* the mixed pass replaces the read passes */
+				if (set_hdd_rw_mix && (modes[k] & HDD_OPT_RD_MASK))
+					continue;
+				if (modes[k] & HDD_OPT_RD_MASK) {
+					if (fstat(fd, &statbuf) < 0) {
+						pr_fail_err(name, "fstat");
+						break;
+					}
+					/* Round to write size to get no partial reads */
+					hdd_read_size = (uint64_t)statbuf.st_size -
+						(statbuf.st_size % opt_hdd_write_size);
+				}
+				if (stress_hdd_async_rw(&async, modes[k],
+						(modes[k] & HDD_OPT_WR_MASK) ?
+						opt_hdd_bytes : hdd_read_size,
+						counter, max_ops) < 0) {
+					stress_hdd_async_close(&async);
+					(void)close(fd);
+					goto finish;
+				}
+			}
+			if (set_hdd_rw_mix &&
+			    (stress_hdd_async_rw(&async, HDD_MODE_MIX,
+					opt_hdd_bytes, counter, max_ops) < 0)) {
+				stress_hdd_async_close(&async);
+				(void)close(fd);
+				goto finish;
+			}
+			stress_hdd_async_close(&async);
+			(void)close(fd);
+			continue;
+		}
+#endif
+
 		/* Random Write */
 		if (opt_hdd_flags & HDD_OPT_WR_RND) {
 			for (i = 0; i < opt_hdd_bytes; i += opt_hdd_write_size) {
 				size_t j;
 
 				off_t offset = (i == 0) ?
-					opt_hdd_bytes :
-					(mwc64() % opt_hdd_bytes) & ~511;
+					(off_t)opt_hdd_bytes :
+					stress_hdd_rnd_offset(opt_hdd_bytes);
 
 				if (lseek(fd, offset, SEEK_SET) < 0) {
 					pr_fail_err(name, "lseek");
@@ -522,6 +1795,68 @@ seq_wr_retry:
 		hdd_read_size = (uint64_t)statbuf.st_size -
 			(statbuf.st_size % opt_hdd_write_size);
 
+		/* Mixed random reads and writes replace the read passes */
+		if (set_hdd_rw_mix) {
+			uint64_t misreads = 0;
+			uint64_t baddata = 0;
+
+			for (i = 0; i < opt_hdd_bytes; i += opt_hdd_write_size) {
+				const bool wr = stress_hdd_mix_write();
+				const off_t offset = (off_t)(stress_hdd_block() *
+					opt_hdd_write_size);
+
+				if (lseek(fd, offset, SEEK_SET) < 0) {
+					pr_fail_err(name, "lseek");
+					(void)close(fd);
+					goto finish;
+				}
+mix_retry:
+				if (!opt_do_run || (max_ops && *counter >= max_ops))
+					break;
+
+				errno = 0;
+				if (wr) {
+					size_t j;
+
+					for (j = 0; j < opt_hdd_write_size; j++)
+						buf[j] = (offset + j) & 0xff;
+					ret = stress_hdd_write(fd, buf, (size_t)opt_hdd_write_size);
+				} else {
+					ret = stress_hdd_read(fd, buf, (size_t)opt_hdd_write_size);
+				}
+				if (ret <= 0) {
+					if ((errno == EAGAIN) || (errno == EINTR))
+						goto mix_retry;
+					if (wr && (errno == ENOSPC))
+						continue;
+					if (errno) {
+						pr_fail_err(name, wr ? "write" : "read");
+						(void)close(fd);
+						goto finish;
+					}
+					continue;
+				}
+				if (!wr) {
+					if (ret != (ssize_t)opt_hdd_write_size)
+						misreads++;
+					/* block starts are either unwritten or hold the offset */
+					if ((opt_flags & OPT_FLAGS_VERIFY) &&
+					    (buf[0] != 0) && (buf[0] != (offset & 0xff)))
+						baddata++;
+				}
+				(*counter)++;
+			}
+			if (misreads)
+				pr_dbg(stderr, "%s: %" PRIu64
+					" incomplete mixed reads\n",
+					name, misreads);
+			if (baddata)
+				pr_fail(stderr, "%s: incorrect data found %"
+					PRIu64 " times\n", name, baddata);
+			(void)close(fd);
+			continue;
+		}
+
 		/* Sequential Read */
 		if (opt_hdd_flags & HDD_OPT_RD_SEQ) {
 			uint64_t misreads = 0;
@@ -583,7 +1918,8 @@ seq_rd_retry:
 			uint64_t baddata = 0;
 
 			for (i = 0; i < hdd_read_size; i += opt_hdd_write_size) {
-				off_t offset = (mwc64() % (opt_hdd_bytes - opt_hdd_write_size)) & ~511;
+				off_t offset = stress_hdd_rnd_offset(opt_hdd_bytes -
+					opt_hdd_write_size);
 
 				if (lseek(fd, offset, SEEK_SET) < 0) {
 					pr_fail_err(name, "lseek");
@@ -637,7 +1973,12 @@ rnd_rd_retry:
 
 	rc = EXIT_SUCCESS;
 finish:
-	free(buf);
+	io_stats_end(&iostats, *counter);
+#if defined(HDD_ASYNC)
+	if (use_async)
+		stress_hdd_async_free(&async);
+#endif
+	io_buffers_free(&bufs);
 	(void)stress_temp_dir_rm(name, pid, instance);
 	return rc;
 }
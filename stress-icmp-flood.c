@@ -37,6 +37,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 
 #include <arpa/inet.h>
@@ -46,6 +47,56 @@
 
 
 #define MAX_PAYLOAD_SIZE	(1000)
+#define MAX_PKT_SIZE		(1500)	/* largest packet of the sweep */
+#define ICMP_STEP_TIME		(0.5)	/* secs per size of the sweep */
+
+#if defined(__NR_sendmmsg) && NEED_GLIBC(2,14,0)
+#define HAVE_ICMP_SENDMMSG
+#endif
+
+/* IP packet sizes of --icmp-flood-sweep */
+static const size_t icmp_sweep_sizes[] = {
+	64, 128, 256, 512, 1024, MAX_PKT_SIZE
+};
+
+#define ICMP_SIZES	(SIZEOF_ARRAY(icmp_sweep_sizes))
+
+/* packets sent and echo replies received per packet size */
+typedef struct {
+	uint64_t packets;
+	uint64_t bytes;
+	double duration;
+	volatile uint64_t replies;	/* counted by the receiver */
+} icmp_size_stats_t;
+
+typedef struct {
+	volatile bool stop;		/* tell the receiver to stop */
+	icmp_size_stats_t stats[ICMP_SIZES];
+} icmp_shared_t;
+
+static size_t opt_icmp_flood_batch = 1;
+static bool opt_icmp_flood_recv = false;
+static bool opt_icmp_flood_sweep = false;
+
+void stress_set_icmp_flood_batch(const char *optarg)
+{
+	uint64_t batch;
+
+	batch = get_uint64(optarg);
+	check_range("icmp-flood-batch", batch,
+		MIN_ICMP_FLOOD_BATCH, MAX_ICMP_FLOOD_BATCH);
+	opt_icmp_flood_batch = (size_t)batch;
+}
+
+void stress_set_icmp_flood_recv(void)
+{
+	opt_icmp_flood_recv = true;
+}
+
+void stress_set_icmp_flood_sweep(void)
+{
+	opt_icmp_flood_sweep = true;
+}
 
 /*
  *  stress_icmp_flood_supported()
@@ -79,6 +130,131 @@ static inline uint32_t checksum(uint16_t *ptr, size_t n)
 	return ~sum;
 }
 
+/*
+ *  stress_icmp_fill()
+ *	make an ICMP echo request of pkt_len bytes, the id of a
+ *	request is the id the receiver looks for in the replies
+ */
+static void stress_icmp_fill(
+	char *pkt,
+	const size_t pkt_len,
+	const unsigned long addr,
+	const uint16_t id,
+	const bool new_payload)
+{
+	struct iphdr *ip_hdr = (struct iphdr *)pkt;
+	struct icmphdr *icmp_hdr = (struct icmphdr *)(pkt + sizeof(struct iphdr));
+	const size_t payload_len = pkt_len - sizeof(struct iphdr) - sizeof(struct icmphdr);
+
+	memset(pkt, 0, sizeof(struct iphdr) + sizeof(struct icmphdr));
+
+	ip_hdr->version = 4;
+	ip_hdr->ihl = 5;
+	ip_hdr->tos = 0;
+	ip_hdr->tot_len = htons(pkt_len);
+	ip_hdr->id = mwc32();
+	ip_hdr->frag_off = 0;
+	ip_hdr->ttl = 64;
+	ip_hdr->protocol = IPPROTO_ICMP;
+	ip_hdr->saddr = addr;
+	ip_hdr->daddr = addr;
+
+	icmp_hdr->type = ICMP_ECHO;
+	icmp_hdr->code = 0;
+	icmp_hdr->un.echo.sequence = mwc32();
+	icmp_hdr->un.echo.id = id;
+
+	/*
+	 * Generating random data is expensive so only do it when asked to
+	 */
+	if (new_payload)
+		stress_strnrnd(pkt + sizeof(struct iphdr) +
+			sizeof(struct icmphdr), payload_len);
+	icmp_hdr->checksum = checksum((uint16_t *)icmp_hdr,
+		sizeof(struct icmphdr) + payload_len);
+}
+
+/*
+ *  stress_icmp_snmp()
+ *	read an Icmp counter from /proc/net/snmp, -1 if there is
+ *	no such counter
+ */
+static int64_t stress_icmp_snmp(const char *field)
+{
+	FILE *fp;
+	char hdr[1024], val[1024];
+	int64_t ret = -1;
+
+	fp = fopen("/proc/net/snmp", "r");
+	if (!fp)
+		return -1;
+	while (fgets(hdr, sizeof(hdr), fp)) {
+		char *h, *v, *hsave = NULL, *vsave = NULL;
+
+		if (strncmp(hdr, "Icmp: ", 6))
+			continue;
+		if (!fgets(val, sizeof(val), fp))
+			break;
+		for (h = strtok_r(hdr, " \n", &hsave), v = strtok_r(val, " \n", &vsave);
+		     h && v;
+		     h = strtok_r(NULL, " \n", &hsave), v = strtok_r(NULL, " \n", &vsave)) {
+			if (!strcmp(h, field)) {
+				ret = (int64_t)strtoll(v, NULL, 10);
+				break;
+			}
+		}
+		break;
+	}
+	(void)fclose(fp);
+	return ret;
+}
+
+/*
+ *  stress_icmp_recv()
+ *	receive the echo replies to our requests and count them
+ *	by packet size
+ */
+static void stress_icmp_recv(icmp_shared_t *sh, const uint16_t id)
+{
+	const int rcvbuf = 4 * MB;
+	const struct timeval tv = { 0, 100000 };
+	char buf[MAX_PKT_SIZE + 64];
+	int fd;
+
+	fd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+	if (fd < 0)
+		return;
+	(void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	(void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	while (!sh->stop) {
+		const ssize_t len = recv(fd, buf, sizeof(buf), 0);
+		const struct iphdr *ip_hdr = (struct iphdr *)buf;
+		const struct icmphdr *icmp_hdr;
+		size_t i, hdr_len;
+
+		if (len < (ssize_t)(sizeof(struct iphdr) + sizeof(struct icmphdr)))
+			continue;
+		hdr_len = ip_hdr->ihl * 4;
+		if (hdr_len + sizeof(struct icmphdr) > (size_t)len)
+			continue;
+		icmp_hdr = (struct icmphdr *)(buf + hdr_len);
+		if ((icmp_hdr->type != ICMP_ECHOREPLY) || (icmp_hdr->un.echo.id != id))
+			continue;
+		if (!opt_icmp_flood_sweep) {
+			sh->stats[0].replies++;
+			continue;
+		}
+		for (i = 0; i < ICMP_SIZES; i++) {
+			if (icmp_sweep_sizes[i] == (size_t)len) {
+				sh->stats[i].replies++;
+				break;
+			}
+		}
+	}
+	(void)close(fd);
+}
+
 /*
  *  stress_icmp_flood
  *	stress local host with ICMP flood
@@ -92,10 +268,21 @@ int stress_icmp_flood(
 	int fd, rc = EXIT_FAILURE;
 	const int set_on = 1;
 	const unsigned long addr = inet_addr("127.0.0.1");
+	const uint16_t id = (uint16_t)getpid();
 	struct sockaddr_in servaddr;
 	uint64_t sendto_fails = 0;
-
-	(void)instance;
+	const size_t sizes = opt_icmp_flood_sweep ? ICMP_SIZES : 1;
+	int64_t out_echo_reps, rate_limit_global, rate_limit_host;
+	icmp_shared_t *sh = MAP_FAILED;
+	char *pkts = NULL;
+	struct iovec *iov = NULL;
+#if defined(HAVE_ICMP_SENDMMSG)
+	struct mmsghdr *msgs = NULL;
+#endif
+	pid_t pid = -1;
+	bool iov_ok = true;
+	double t_start;
+	size_t i, s, idx;
 
 	fd = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
 	if (fd < 0) {
@@ -117,48 +304,167 @@ int stress_icmp_flood(
 	servaddr.sin_addr.s_addr = addr;
 	memset(&servaddr.sin_zero, 0, sizeof(servaddr.sin_zero));
 
+	/*
+	 *  The batch of packets to send, one buffer per packet as the
+	 *  packets of a sendmmsg batch differ in id and sequence
+	 */
+	pkts = calloc(opt_icmp_flood_batch, MAX_PKT_SIZE);
+	iov = calloc(opt_icmp_flood_batch, sizeof(*iov));
+	sh = (icmp_shared_t *)mmap(NULL, sizeof(*sh), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+#if defined(HAVE_ICMP_SENDMMSG)
+	msgs = calloc(opt_icmp_flood_batch, sizeof(*msgs));
+	if (!msgs)
+		iov_ok = false;
+#endif
+	if (!pkts || !iov || !iov_ok || (sh == MAP_FAILED)) {
+		pr_inf(stderr, "%s: cannot allocate packet buffers, "
+			"skipping stressor\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto err_free;
+	}
+	for (i = 0; i < opt_icmp_flood_batch; i++) {
+		iov[i].iov_base = pkts + (i * MAX_PKT_SIZE);
+#if defined(HAVE_ICMP_SENDMMSG)
+		msgs[i].msg_hdr.msg_name = &servaddr;
+		msgs[i].msg_hdr.msg_namelen = sizeof(servaddr);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+#endif
+	}
+
+	if (opt_icmp_flood_recv) {
+		pid = fork();
+		if (pid == 0) {
+			(void)setpgid(0, pgrp);
+			stress_parent_died_alarm();
+			stress_icmp_recv(sh, id);
+			_exit(0);
+		}
+		if (pid > 0)
+			(void)setpgid(pid, pgrp);
+		else
+			pr_dbg(stderr, "%s: cannot fork receiver, errno=%d (%s)\n",
+				name, errno, strerror(errno));
+	}
+	out_echo_reps = stress_icmp_snmp("OutEchoReps");
+	rate_limit_global = stress_icmp_snmp("OutRateLimitGlobal");
+	rate_limit_host = stress_icmp_snmp("OutRateLimitHost");
+	t_start = time_now();
+
 	do {
-		const size_t payload_len = (mwc32() % MAX_PAYLOAD_SIZE) + 1;
-		const size_t pkt_len =
-			sizeof(struct iphdr) + sizeof(struct icmphdr) + payload_len;
-		char pkt[pkt_len];
-		struct iphdr *ip_hdr = (struct iphdr *)pkt;
-		struct icmphdr *icmp_hdr = (struct icmphdr *)(pkt + sizeof(struct iphdr));
-
-		memset(pkt, 0, sizeof(pkt));
-
-		ip_hdr->version = 4;
-		ip_hdr->ihl = 5;
-		ip_hdr->tos = 0;
-		ip_hdr->tot_len = htons(pkt_len);
-		ip_hdr->id = mwc32();
-		ip_hdr->frag_off = 0;
-		ip_hdr->ttl = 64;
-		ip_hdr->protocol = IPPROTO_ICMP;
-		ip_hdr->saddr = addr;
-		ip_hdr->daddr = addr;
-
-		icmp_hdr->type = ICMP_ECHO;
-		icmp_hdr->code = 0;
-		icmp_hdr->un.echo.sequence = mwc32();
-		icmp_hdr->un.echo.id = mwc32();
-
-		/*
-		 * Generating random data is expensive so do it every 64 packets
-		 */
-		if ((*counter & 0x3f) == 0)
-			stress_strnrnd(pkt + sizeof(struct iphdr) +
-				sizeof(struct icmphdr), payload_len);
-		icmp_hdr->checksum = checksum((uint16_t *)icmp_hdr,
-			sizeof(struct icmphdr) + payload_len);
-
-		if ((sendto(fd, pkt, pkt_len, 0,
-			   (struct sockaddr*)&servaddr, sizeof(servaddr))) < 1) {
-			sendto_fails++;
+		for (s = 0; opt_do_run && (s < sizes); s++) {
+			icmp_size_stats_t *stats = &sh->stats[s];
+			const double t = time_now();
+
+			do {
+				size_t batch_bytes = 0;
+				ssize_t sent;
+
+				for (i = 0; i < opt_icmp_flood_batch; i++) {
+					const size_t pkt_len = opt_icmp_flood_sweep ?
+						icmp_sweep_sizes[s] :
+						sizeof(struct iphdr) + sizeof(struct icmphdr) +
+						(mwc32() % MAX_PAYLOAD_SIZE) + 1;
+
+					stress_icmp_fill(iov[i].iov_base, pkt_len, addr, id,
+						((*counter + i) & 0x3f) == 0);
+					iov[i].iov_len = pkt_len;
+					batch_bytes += pkt_len;
+				}
+#if defined(HAVE_ICMP_SENDMMSG)
+				if (opt_icmp_flood_batch > 1) {
+					const int ret = sendmmsg(fd, msgs, opt_icmp_flood_batch, 0);
+
+					sent = (ret < 0) ? 0 : ret;
+					for (i = (size_t)sent; i < opt_icmp_flood_batch; i++)
+						batch_bytes -= iov[i].iov_len;
+				} else
+#endif
+				{
+					sent = 0;
+					for (i = 0; i < opt_icmp_flood_batch; i++) {
+						if ((sendto(fd, iov[i].iov_base, iov[i].iov_len, 0,
+						     (struct sockaddr*)&servaddr, sizeof(servaddr))) < 1)
+							batch_bytes -= iov[i].iov_len;
+						else
+							sent++;
+					}
+				}
+				sendto_fails += opt_icmp_flood_batch - (size_t)sent;
+				stats->packets += (uint64_t)sent;
+				stats->bytes += batch_bytes;
+				(*counter) += opt_icmp_flood_batch;
+			} while (opt_do_run && (!max_ops || *counter < max_ops) &&
+				 (!opt_icmp_flood_sweep || (time_now() - t < ICMP_STEP_TIME)));
+			stats->duration += time_now() - t;
 		}
-		(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
+	t_start = time_now() - t_start;
+	if (pid > 0) {
+		int status;
+
+		/* Give the last replies time to arrive */
+		(void)usleep(100000);
+		sh->stop = true;
+		(void)waitpid(pid, &status, 0);
+	}
+
+	for (s = 0, idx = 0; s < sizes; s++) {
+		const icmp_size_stats_t *stats = &sh->stats[s];
+		const double duration = stats->duration > 0.0 ? stats->duration : 1.0;
+		char prefix[16], desc[32];
+
+		if (opt_icmp_flood_sweep)
+			snprintf(prefix, sizeof(prefix), "%zu byte ", icmp_sweep_sizes[s]);
+		else
+			*prefix = '\0';
+		if (idx + 3 > STRESS_MISC_METRICS_MAX)
+			break;
+		snprintf(desc, sizeof(desc), "%spackets/sec", prefix);
+		stress_misc_metric_set(idx++, desc, (double)stats->packets / duration);
+		snprintf(desc, sizeof(desc), "%sMbits/sec", prefix);
+		stress_misc_metric_set(idx++, desc,
+			((double)stats->bytes * 8.0) / (duration * 1000000.0));
+		if (pid > 0) {
+			snprintf(desc, sizeof(desc), "%sreplies %%", prefix);
+			stress_misc_metric_set(idx++, desc, stats->packets ?
+				100.0 * (double)stats->replies / (double)stats->packets : 0.0);
+		}
+	}
+
+	/*
+	 *  The kernel echo reply counters are system wide, so only the
+	 *  first instance reports them, with the rate limit settings
+	 */
+	if ((instance == 0) && opt_icmp_flood_recv && (t_start > 0.0)) {
+		char ratelimit[32], ratemask[32], msgs_per_sec[32];
+
+		if (system_read("/proc/sys/net/ipv4/icmp_ratelimit", ratelimit, sizeof(ratelimit)) < 0)
+			(void)snprintf(ratelimit, sizeof(ratelimit), "?");
+		if (system_read("/proc/sys/net/ipv4/icmp_ratemask", ratemask, sizeof(ratemask)) < 0)
+			(void)snprintf(ratemask, sizeof(ratemask), "?");
+		if (system_read("/proc/sys/net/ipv4/icmp_msgs_per_sec", msgs_per_sec, sizeof(msgs_per_sec)) < 0)
+			(void)snprintf(msgs_per_sec, sizeof(msgs_per_sec), "?");
+		ratelimit[strcspn(ratelimit, "\n")] = '\0';
+		ratemask[strcspn(ratemask, "\n")] = '\0';
+		msgs_per_sec[strcspn(msgs_per_sec, "\n")] = '\0';
+
+		pr_inf(stderr, "%s: icmp_ratelimit %s ms, icmp_ratemask %s, "
+			"icmp_msgs_per_sec %s\n", name,
+			ratelimit, ratemask, msgs_per_sec);
+		if (out_echo_reps >= 0)
+			pr_inf(stderr, "%s: kernel sent %.2f echo replies/sec\n",
+				name, (double)(stress_icmp_snmp("OutEchoReps") -
+				out_echo_reps) / t_start);
+		if ((rate_limit_global >= 0) && (rate_limit_host >= 0))
+			pr_inf(stderr, "%s: %" PRId64 " ICMP messages rate limited "
+				"globally, %" PRId64 " per host\n", name,
+				stress_icmp_snmp("OutRateLimitGlobal") - rate_limit_global,
+				stress_icmp_snmp("OutRateLimitHost") - rate_limit_host);
+	}
+
 	pr_dbg(stderr, "%s: %.2f%% of %" PRIu64 " sendto messages succeeded.\n",
 		name,
 		100.0 * (float)(*counter - sendto_fails) / *counter,
@@ -166,6 +472,14 @@ int stress_icmp_flood(
 
 	rc = EXIT_SUCCESS;
 
+err_free:
+	if (sh != MAP_FAILED)
+		(void)munmap((void *)sh, sizeof(*sh));
+#if defined(HAVE_ICMP_SENDMMSG)
+	free(msgs);
+#endif
+	free(iov);
+	free(pkts);
 err_socket:
 	(void)close(fd);
 err:
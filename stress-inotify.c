@@ -45,6 +45,13 @@
 #include <sys/stat.h>
 #include <sys/select.h>
 #include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <poll.h>
+#if NEED_GLIBC(2,13,0)
+#include <sys/fanotify.h>
+#endif
 
 
 #define DIR_FLAGS	(S_IRWXU | S_IRWXG)
@@ -53,6 +60,41 @@
 #define TIME_OUT	(10)	/* Secs for inotify to report back */
 #define BUF_SIZE	(4096)
 
+#if defined(FAN_REPORT_DFID_NAME) && defined(FAN_EVENT_INFO_TYPE_DFID_NAME)
+#define INOTIFY_HAVE_FANOTIFY
+#endif
+
+#define INOTIFY_API_INOTIFY	(0)	/* drain with inotify(7) */
+#define INOTIFY_API_FANOTIFY	(1)	/* drain with fanotify(7) */
+
+#define RATE_STEP_TIME		(1.0)	/* secs per writer count step */
+#define RATE_DRAIN_TIME		(2.0)	/* max secs to drain after a step */
+#define RATE_LAT_SAMPLES	(65536)	/* latency samples per step */
+#define RATE_EVENT_BUF		(64 * 1024)
+#define RATE_STEPS		(10)	/* 1, 2, 4 .. 512 writers */
+
+/* Writer state shared with the reader */
+typedef struct {
+	volatile bool stop;		/* writers exit when set */
+	uint64_t generated[MAX_INOTIFY_WRITERS];	/* events per writer */
+} inotify_rate_shared_t;
+
+/* Results of one writer count step */
+typedef struct {
+	uint32_t writers;		/* number of writers */
+	uint64_t generated;		/* events the writers caused */
+	uint64_t received;		/* events the reader drained */
+	uint64_t overflows;		/* queue overflow events */
+	double	duration;		/* time the writers ran */
+	double	drained;		/* time to drain all the events */
+	double	lat_mean;		/* create event latency, usecs */
+	double	lat_p99;
+	double	lat_max;
+} inotify_rate_step_t;
+
+static uint32_t opt_inotify_writers = 0;	/* 0 = exercise event types */
+static int opt_inotify_api = INOTIFY_API_INOTIFY;
+
 typedef int (*inotify_helper)(const char *name, const char *path, const void *private);
 typedef void (*inotify_func)(const char *name, const char *path);
 
@@ -697,6 +739,434 @@ static const inotify_stress_t inotify_stressors[] = {
 	{ NULL,				NULL }
 };
 
+void stress_set_inotify_writers(const char *optarg)
+{
+	opt_inotify_writers = (uint32_t)get_uint64(optarg);
+	check_range("inotify-writers", opt_inotify_writers,
+		MIN_INOTIFY_WRITERS, MAX_INOTIFY_WRITERS);
+}
+
+int stress_set_inotify_api(const char *name)
+{
+	if (!strcmp(name, "inotify")) {
+		opt_inotify_api = INOTIFY_API_INOTIFY;
+		return 0;
+	}
+#if defined(INOTIFY_HAVE_FANOTIFY)
+	if (!strcmp(name, "fanotify")) {
+		opt_inotify_api = INOTIFY_API_FANOTIFY;
+		return 0;
+	}
+	fprintf(stderr, "inotify-api must be one of: inotify fanotify\n");
+#else
+	fprintf(stderr, "inotify-api must be one of: inotify\n");
+#endif
+	return -1;
+}
+
+/*
+ *  rate_writer()
+ *	create, write and unlink time stamped files in dir,
+ *	3 events per loop, until told to stop
+ */
+static void rate_writer(
+	const char *dir,
+	inotify_rate_shared_t *shared_rate,
+	const uint32_t writer)
+{
+	while (!shared_rate->stop && opt_do_run) {
+		char path[PATH_MAX + 40];
+		int fd;
+
+		(void)snprintf(path, sizeof(path), "%s/%016" PRIx64,
+			dir, time_now_ns());
+		fd = open(path, O_CREAT | O_WRONLY, FILE_FLAGS);
+		if (fd < 0)
+			continue;
+		if (write(fd, "x", 1) < 0) {
+			/* Ignore, the create and unlink still count */
+		}
+		(void)close(fd);
+		(void)unlink(path);
+		shared_rate->generated[writer] += 3;
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  rate_sample()
+ *	record the latency of a create event for a stamped name
+ */
+static inline void rate_sample(
+	const char *filename,
+	const uint64_t now,
+	uint64_t *lat,
+	size_t *n_lat,
+	uint64_t *lat_sum,
+	uint64_t *lat_n)
+{
+	char *end;
+	const uint64_t stamp = (uint64_t)strtoull(filename, &end, 16);
+	uint64_t delta;
+
+	if ((end == filename) || (*end != '\0') || (stamp > now))
+		return;
+	delta = now - stamp;
+	*lat_sum += delta;
+	(*lat_n)++;
+	if (*n_lat < RATE_LAT_SAMPLES)
+		lat[(*n_lat)++] = delta;
+}
+
+/*
+ *  rate_drain()
+ *	read and account the pending events, returns the events
+ *	read or -1 on error
+ */
+static ssize_t rate_drain(
+	const int fd,
+	char *buf,
+	inotify_rate_step_t *step,
+	uint64_t *lat,
+	size_t *n_lat,
+	uint64_t *lat_sum,
+	uint64_t *lat_n)
+{
+	const ssize_t len = read(fd, buf, RATE_EVENT_BUF);
+	const uint64_t now = time_now_ns();
+	ssize_t i = 0, events = 0;
+
+	if (len < 0)
+		return ((errno == EAGAIN) || (errno == EINTR)) ? 0 : -1;
+
+#if defined(INOTIFY_HAVE_FANOTIFY)
+	if (opt_inotify_api == INOTIFY_API_FANOTIFY) {
+		struct fanotify_event_metadata *meta =
+			(struct fanotify_event_metadata *)buf;
+		ssize_t left = len;
+
+		for (; FAN_EVENT_OK(meta, left); meta = FAN_EVENT_NEXT(meta, left)) {
+			const struct fanotify_event_info_fid *fid =
+				(const struct fanotify_event_info_fid *)(meta + 1);
+
+			if (meta->fd >= 0)
+				(void)close(meta->fd);
+			if (meta->mask & FAN_Q_OVERFLOW) {
+				step->overflows++;
+				continue;
+			}
+			/* Events on the same name are merged into one */
+			events += __builtin_popcount(meta->mask &
+				(FAN_CREATE | FAN_MODIFY | FAN_DELETE));
+			if ((meta->mask & FAN_CREATE) &&
+			    (meta->event_len > sizeof(*meta) + sizeof(*fid)) &&
+			    (fid->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME)) {
+				const struct file_handle *handle =
+					(const struct file_handle *)fid->handle;
+
+				rate_sample((const char *)handle->f_handle +
+					handle->handle_bytes, now,
+					lat, n_lat, lat_sum, lat_n);
+			}
+		}
+		step->received += events;
+		return events;
+	}
+#endif
+	while (i < len) {
+		const struct inotify_event *event =
+			(const struct inotify_event *)(buf + i);
+
+		if (event->mask & IN_Q_OVERFLOW) {
+			step->overflows++;
+		} else {
+			events++;
+			if ((event->mask & IN_CREATE) && event->len)
+				rate_sample(event->name, now,
+					lat, n_lat, lat_sum, lat_n);
+		}
+		i += sizeof(struct inotify_event) + event->len;
+	}
+	step->received += events;
+	return events;
+}
+
+static int rate_cmp(const void *p1, const void *p2)
+{
+	const uint64_t v1 = *(const uint64_t *)p1;
+	const uint64_t v2 = *(const uint64_t *)p2;
+
+	return (v1 > v2) - (v1 < v2);
+}
+
+/*
+ *  rate_step()
+ *	watch the writer directories, run writers writers for a
+ *	step and drain the events, -1 on a setup failure
+ */
+static int rate_step(
+	const char *name,
+	const char *dirname,
+	inotify_rate_shared_t *shared_rate,
+	const uint32_t writers,
+	char *buf,
+	uint64_t *lat,
+	inotify_rate_step_t *step,
+	uint64_t *const counter)
+{
+	pid_t pids[MAX_INOTIFY_WRITERS];
+	uint64_t lat_sum = 0, lat_n = 0;
+	size_t n_lat = 0;
+	double t_start, t_end;
+	uint32_t i;
+	int fd, rc = 0;
+
+	(void)memset(step, 0, sizeof(*step));
+	step->writers = writers;
+#if defined(INOTIFY_HAVE_FANOTIFY)
+	if (opt_inotify_api == INOTIFY_API_FANOTIFY)
+		fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME |
+			FAN_NONBLOCK, O_RDONLY);
+	else
+#endif
+		fd = inotify_init1(IN_NONBLOCK);
+	if (fd < 0) {
+		pr_err(stderr, "%s: %s failed: errno=%d (%s)\n", name,
+			opt_inotify_api == INOTIFY_API_FANOTIFY ?
+			"fanotify_init" : "inotify_init1", errno, strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < writers; i++) {
+		char path[PATH_MAX + 16];
+		int ret;
+
+		(void)snprintf(path, sizeof(path), "%s/w%" PRIu32, dirname, i);
+#if defined(INOTIFY_HAVE_FANOTIFY)
+		if (opt_inotify_api == INOTIFY_API_FANOTIFY)
+			ret = fanotify_mark(fd, FAN_MARK_ADD, FAN_CREATE |
+				FAN_DELETE | FAN_MODIFY | FAN_EVENT_ON_CHILD,
+				AT_FDCWD, path);
+		else
+#endif
+			ret = inotify_add_watch(fd, path,
+				IN_CREATE | IN_DELETE | IN_MODIFY);
+		if (ret < 0) {
+			pr_err(stderr, "%s: cannot watch %s: errno=%d (%s)\n",
+				name, path, errno, strerror(errno));
+			(void)close(fd);
+			return -1;
+		}
+	}
+
+	shared_rate->stop = false;
+	for (i = 0; i < writers; i++) {
+		shared_rate->generated[i] = 0;
+		pids[i] = fork();
+		if (pids[i] == 0) {
+			char path[PATH_MAX + 16];
+
+			(void)close(fd);
+			(void)snprintf(path, sizeof(path), "%s/w%" PRIu32, dirname, i);
+			rate_writer(path, shared_rate, i);
+		}
+	}
+
+	t_start = time_now();
+	t_end = t_start + RATE_STEP_TIME;
+	while (opt_do_run && (time_now() < t_end)) {
+		struct pollfd pfd;
+		ssize_t n;
+
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, 10) <= 0)
+			continue;
+		n = rate_drain(fd, buf, step, lat, &n_lat, &lat_sum, &lat_n);
+		if (n < 0) {
+			pr_fail_err(name, "read");
+			rc = -1;
+			break;
+		}
+		*counter += (uint64_t)n;
+	}
+	shared_rate->stop = true;
+	for (i = 0; i < writers; i++) {
+		int status;
+
+		if (pids[i] < 0)
+			continue;
+		if (!opt_do_run)
+			(void)kill(pids[i], SIGKILL);
+		(void)waitpid(pids[i], &status, 0);
+	}
+	step->duration = time_now() - t_start;
+
+	/* Events still queued when the writers stopped */
+	t_end = time_now() + RATE_DRAIN_TIME;
+	while ((rc == 0) && (time_now() < t_end)) {
+		const uint64_t overflows = step->overflows;
+		const ssize_t n = rate_drain(fd, buf, step, lat,
+			&n_lat, &lat_sum, &lat_n);
+
+		if ((n <= 0) && (step->overflows == overflows))
+			break;
+		*counter += (uint64_t)n;
+	}
+	step->drained = time_now() - t_start;
+	(void)close(fd);
+
+	for (i = 0; i < writers; i++)
+		step->generated += shared_rate->generated[i];
+	if (lat_n) {
+		step->lat_mean = (double)lat_sum / (double)lat_n / 1000.0;
+		qsort(lat, n_lat, sizeof(*lat), rate_cmp);
+		step->lat_p99 = (double)lat[(n_lat * 99) / 100] / 1000.0;
+		step->lat_max = (double)lat[n_lat - 1] / 1000.0;
+	}
+	return rc;
+}
+
+/*
+ *  stress_inotify_rate()
+ *	step the number of writers creating, modifying and
+ *	deleting files in a watched tree from 1 to
+ *	opt_inotify_writers while draining the events, instance
+ *	0 reports the first complete sweep
+ */
+static int stress_inotify_rate(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const char *dirname)
+{
+	inotify_rate_step_t steps[RATE_STEPS];
+	inotify_rate_shared_t *shared_rate;
+	uint64_t *lat;
+	char *buf;
+	uint32_t i, n_steps = 0, writers, peak = 0;
+	uint64_t overflows = 0;
+	bool reported = false;
+	int rc = EXIT_SUCCESS;
+
+	for (i = 0; i < opt_inotify_writers; i++) {
+		char path[PATH_MAX + 16];
+
+		(void)snprintf(path, sizeof(path), "%s/w%" PRIu32, dirname, i);
+		if (mk_dir(name, path) < 0)
+			return EXIT_FAILURE;
+	}
+	for (writers = 1; ; writers <<= 1) {
+		if (writers > opt_inotify_writers)
+			writers = opt_inotify_writers;
+		n_steps++;
+		if (writers == opt_inotify_writers)
+			break;
+	}
+
+	shared_rate = mmap(NULL, sizeof(*shared_rate), PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (shared_rate == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot mmap shared writer state\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto rm_dirs;
+	}
+	buf = malloc(RATE_EVENT_BUF);
+	lat = calloc(RATE_LAT_SAMPLES, sizeof(*lat));
+	if (!buf || !lat) {
+		pr_inf(stderr, "%s: cannot allocate event buffers\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_bufs;
+	}
+	(void)memset(steps, 0, sizeof(steps));
+
+	do {
+		for (i = 0, writers = 1; i < n_steps; i++, writers <<= 1) {
+			if (writers > opt_inotify_writers)
+				writers = opt_inotify_writers;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			if (rate_step(name, dirname, shared_rate, writers,
+				      buf, lat, &steps[i], counter) < 0) {
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			if (!opt_do_run)
+				goto done;
+			overflows += steps[i].overflows;
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %s, %7s %10s %10s %6s %9s %9s %9s %9s\n",
+				name, opt_inotify_api == INOTIFY_API_FANOTIFY ?
+				"fanotify" : "inotify", "writers", "events/s",
+				"caused/s", "lost%", "overflows", "lat mean",
+				"lat p99", "lat max");
+			for (i = 0; i < n_steps; i++) {
+				const inotify_rate_step_t *step = &steps[i];
+
+				pr_inf(stderr, "%s: %*s %7" PRIu32 " %10.0f %10.0f "
+					"%6.2f %9" PRIu64 " %7.1fus %7.1fus %7.1fus\n",
+					name, (int)strlen(opt_inotify_api ==
+					INOTIFY_API_FANOTIFY ? "fanotify," :
+					"inotify,"), "", step->writers,
+					(double)step->received / step->drained,
+					(double)step->generated / step->duration,
+					step->generated > step->received ?
+						100.0 * (double)(step->generated -
+						step->received) /
+						(double)step->generated : 0.0,
+					step->overflows, step->lat_mean,
+					step->lat_p99, step->lat_max);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (i = 0; i < n_steps; i++) {
+		if (steps[i].drained <= 0.0)
+			continue;
+		if ((double)steps[i].received / steps[i].drained >
+		    (double)steps[peak].received / steps[peak].drained)
+			peak = i;
+	}
+	if (steps[peak].drained > 0.0) {
+		stress_misc_metric_set(0, "peak events per sec",
+			(double)steps[peak].received / steps[peak].drained);
+		stress_misc_metric_set(1, "writers at peak events per sec",
+			(double)steps[peak].writers);
+		stress_misc_metric_set(2, "1 writer p99 latency (usecs)",
+			steps[0].lat_p99);
+		stress_misc_metric_set(3, "queue overflows", (double)overflows);
+	}
+free_bufs:
+	free(lat);
+	free(buf);
+	(void)munmap((void *)shared_rate, sizeof(*shared_rate));
+rm_dirs:
+	for (i = 0; i < opt_inotify_writers; i++) {
+		char path[PATH_MAX + 16];
+		struct dirent *d;
+		DIR *dp;
+
+		(void)snprintf(path, sizeof(path), "%s/w%" PRIu32, dirname, i);
+		/* Files left by writers killed mid loop */
+		if ((dp = opendir(path)) != NULL) {
+			while ((d = readdir(dp)) != NULL) {
+				char filename[PATH_MAX + 288];
+
+				if (d->d_name[0] == '.')
+					continue;
+				mk_filename(filename, sizeof(filename), path, d->d_name);
+				(void)unlink(filename);
+			}
+			(void)closedir(dp);
+		}
+		(void)rmdir(path);
+	}
+	return rc;
+}
+
 /*
  *  stress_inotify()
  *	stress inotify
@@ -715,6 +1185,12 @@ int stress_inotify(
 	ret = stress_temp_dir_mk(name, pid, instance);
 	if (ret < 0)
 		return exit_status(-ret);
+	if (opt_inotify_writers) {
+		ret = stress_inotify_rate(counter, instance, max_ops,
+			name, dirname);
+		(void)stress_temp_dir_rm(name, pid, instance);
+		return ret;
+	}
 	do {
 		for (i = 0; opt_do_run && inotify_stressors[i].func; i++)
 			inotify_stressors[i].func(name, dirname);
@@ -0,0 +1,731 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_IO_URING_NET)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+
+#define IO_URING_NET_ENTRIES	(1024)		/* SQ entries per ring */
+#define IO_URING_NET_BUFS	(1024)		/* server provided buffers */
+#define IO_URING_NET_BUF_SIZE	(4 * KB)	/* size of each of these */
+#define IO_URING_NET_BGID	(0)		/* provided buffer group id */
+
+/* user_data is tag:8 id:24 fd:32 */
+#define TAG_ACCEPT		(1)
+#define TAG_RECV		(2)
+#define TAG_SEND		(3)
+#define TAG_WRITE		(4)
+#define TAG_READ		(5)
+#define TAG_PROBE		(6)
+
+#define UD(tag, id, fd)		(((uint64_t)(tag) << 56) | \
+				 ((uint64_t)(id) << 32) | (uint32_t)(fd))
+#define UD_TAG(ud)		((uint32_t)((ud) >> 56))
+#define UD_ID(ud)		((uint32_t)(((ud) >> 32) & 0xffffff))
+#define UD_FD(ud)		((int)((ud) & 0xffffffff))
+
+/* server start up states */
+#define SERVER_STARTING		(0)
+#define SERVER_READY		(1)
+#define SERVER_FAILED		(2)
+#define SERVER_UNSUPPORTED	(3)
+
+/* server statistics, shared with the client for the metrics */
+typedef struct {
+	volatile int state;		/* SERVER_* start up state */
+	uint64_t enters;
+	uint64_t submits;
+	uint64_t submitted;
+} io_uring_net_shared_t;
+
+/* a client connection */
+typedef struct {
+	int fd;				/* socket, -1 when closed */
+	uint8_t *tx;			/* request, in the fixed buffer */
+	uint8_t *rx;			/* response, in the fixed buffer */
+	uint32_t sent;			/* request bytes sent */
+	uint32_t got;			/* response bytes received */
+} io_uring_net_conn_t;
+
+static int opt_io_uring_net_domain = AF_INET;
+static int opt_io_uring_net_port = DEFAULT_IO_URING_NET_PORT;
+static int opt_io_uring_net_proto = SOCK_STREAM;
+static uint32_t opt_io_uring_net_conns = DEFAULT_IO_URING_NET_CONNS;
+static uint32_t opt_io_uring_net_size = DEFAULT_IO_URING_NET_SIZE;
+static bool opt_io_uring_net_sqpoll = false;
+
+/*
+ *  stress_set_io_uring_net_conns()
+ *	set the number of concurrent client connections
+ */
+void stress_set_io_uring_net_conns(const char *optarg)
+{
+	uint64_t conns;
+
+	conns = get_uint64(optarg);
+	check_range("io-uring-net-conns", conns,
+		MIN_IO_URING_NET_CONNS, MAX_IO_URING_NET_CONNS);
+	opt_io_uring_net_conns = (uint32_t)conns;
+}
+
+/*
+ *  stress_set_io_uring_net_domain()
+ *	set the socket domain option
+ */
+int stress_set_io_uring_net_domain(const char *name)
+{
+	return stress_set_net_domain(DOMAIN_INET_ALL, "io-uring-net-domain",
+		name, &opt_io_uring_net_domain);
+}
+
+/*
+ *  stress_set_io_uring_net_port()
+ *	set the port base
+ */
+void stress_set_io_uring_net_port(const char *optarg)
+{
+	stress_set_net_port("io-uring-net-port", optarg,
+		MIN_IO_URING_NET_PORT, MAX_IO_URING_NET_PORT - STRESS_PROCS_MAX,
+		&opt_io_uring_net_port);
+}
+
+/*
+ *  stress_set_io_uring_net_proto()
+ *	echo over tcp or udp
+ */
+int stress_set_io_uring_net_proto(const char *name)
+{
+	if (!strcmp(name, "tcp")) {
+		opt_io_uring_net_proto = SOCK_STREAM;
+		return 0;
+	}
+	if (!strcmp(name, "udp")) {
+		opt_io_uring_net_proto = SOCK_DGRAM;
+		return 0;
+	}
+	fprintf(stderr, "io-uring-net-proto must be tcp or udp\n");
+	return -1;
+}
+
+/*
+ *  stress_set_io_uring_net_size()
+ *	set the request/response size
+ */
+void stress_set_io_uring_net_size(const char *optarg)
+{
+	uint64_t size;
+
+	size = get_uint64_byte(optarg);
+	check_range("io-uring-net-size", size,
+		MIN_IO_URING_NET_SIZE, MAX_IO_URING_NET_SIZE);
+	opt_io_uring_net_size = (uint32_t)size;
+}
+
+/*
+ *  stress_set_io_uring_net_sqpoll()
+ *	use kernel SQ polling threads
+ */
+void stress_set_io_uring_net_sqpoll(void)
+{
+	opt_io_uring_net_sqpoll = true;
+}
+
+/*
+ *  uring_prep_multishot()
+ *	queue a multishot accept, recv or recvmsg, the
+ *	recvs draw their buffers from the provided ring
+ */
+static int uring_prep_multishot(
+	stress_uring_t *r,
+	const uint8_t opcode,
+	const int fd,
+	const void *addr,
+	const uint64_t user_data)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_prep_rw(r, opcode, fd, addr, 0, 0, user_data);
+	if (!sqe)
+		return -1;
+	if (opcode == IORING_OP_ACCEPT) {
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	} else {
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = IO_URING_NET_BGID;
+		if (opcode == IORING_OP_RECVMSG)
+			sqe->len = 1;
+	}
+	return 0;
+}
+
+/*
+ *  io_uring_net_buf_add()
+ *	hand a buffer back to the kernel's provided buffer ring
+ */
+static inline void io_uring_net_buf_add(
+	struct io_uring_buf_ring *br,
+	uint16_t *tail,
+	uint8_t *bufs,
+	const uint16_t bid)
+{
+	struct io_uring_buf *buf = &br->bufs[*tail & (IO_URING_NET_BUFS - 1)];
+
+	buf->addr = (uintptr_t)(bufs + ((size_t)bid * IO_URING_NET_BUF_SIZE));
+	buf->len = IO_URING_NET_BUF_SIZE;
+	buf->bid = bid;
+	(*tail)++;
+	__atomic_store_n(&br->tail, *tail, __ATOMIC_RELEASE);
+}
+
+/*
+ *  io_uring_net_server()
+ *	echo everything back with multishot accept and recv,
+ *	the provided buffers live in the registered buffer so
+ *	the echo can use WRITE_FIXED; udp uses multishot
+ *	recvmsg and replies with sendmsg
+ */
+static int io_uring_net_server(
+	const char *name,
+	const uint32_t instance,
+	const pid_t ppid,
+	io_uring_net_shared_t *shared,
+	const bool sqpoll)
+{
+	const bool tcp = (opt_io_uring_net_proto == SOCK_STREAM);
+	const size_t bufs_sz = (size_t)IO_URING_NET_BUFS * IO_URING_NET_BUF_SIZE;
+	const size_t br_sz = IO_URING_NET_BUFS * sizeof(struct io_uring_buf);
+	stress_uring_t r;
+	struct io_uring_buf_ring *br;
+	struct io_uring_buf_reg reg;
+	struct sockaddr *addr;
+	socklen_t addr_len;
+	struct msghdr recv_mh;
+	static uint32_t buf_len[IO_URING_NET_BUFS];
+	static uint32_t buf_off[IO_URING_NET_BUFS];
+	static struct msghdr send_mh[IO_URING_NET_BUFS];
+	static struct iovec send_iov[IO_URING_NET_BUFS];
+	uint8_t *bufs;
+	uint16_t br_tail = 0;
+	int sfd, so_reuseaddr = 1, ret, rc = EXIT_FAILURE;
+	unsigned i;
+
+	if ((sfd = socket(opt_io_uring_net_domain, opt_io_uring_net_proto, 0)) < 0) {
+		pr_fail_dbg(name, "socket");
+		return EXIT_FAILURE;
+	}
+	if (setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR,
+			&so_reuseaddr, sizeof(so_reuseaddr)) < 0) {
+		pr_fail_dbg(name, "setsockopt");
+		goto die_close;
+	}
+	stress_set_sockaddr(name, instance, ppid, opt_io_uring_net_domain,
+		opt_io_uring_net_port + instance, &addr, &addr_len, NET_ADDR_ANY);
+	if (bind(sfd, addr, addr_len) < 0) {
+		pr_fail_dbg(name, "bind");
+		goto die_close;
+	}
+	if (tcp && (listen(sfd, SOMAXCONN) < 0)) {
+		pr_fail_dbg(name, "listen");
+		goto die_close;
+	}
+
+	if ((ret = uring_setup(&r, IO_URING_NET_ENTRIES, sqpoll)) < 0) {
+		errno = -ret;
+		pr_fail_dbg(name, "io_uring_setup");
+		goto die_close;
+	}
+	bufs = mmap(NULL, bufs_sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (bufs == MAP_FAILED) {
+		pr_fail_dbg(name, "mmap");
+		goto die_uring;
+	}
+	br = mmap(NULL, br_sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (br == MAP_FAILED) {
+		pr_fail_dbg(name, "mmap");
+		goto die_bufs;
+	}
+	if ((ret = uring_register_buffer(&r, bufs, bufs_sz)) < 0) {
+		errno = -ret;
+		pr_fail_dbg(name, "io_uring_register buffers");
+		goto die_br;
+	}
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uintptr_t)br;
+	reg.ring_entries = IO_URING_NET_BUFS;
+	reg.bgid = IO_URING_NET_BGID;
+	if (syscall(__NR_io_uring_register, r.fd,
+			IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		/* provided buffer rings arrived in Linux 5.19 */
+		shared->state = SERVER_UNSUPPORTED;
+		rc = EXIT_SUCCESS;
+		goto die_br;
+	}
+	for (i = 0; i < IO_URING_NET_BUFS; i++)
+		io_uring_net_buf_add(br, &br_tail, bufs, (uint16_t)i);
+
+	memset(&recv_mh, 0, sizeof(recv_mh));
+	recv_mh.msg_namelen = sizeof(struct sockaddr_storage);
+
+	/*
+	 *  Multishot recv is checked for by trying it on the
+	 *  listening socket: kernels without it reject the flag
+	 *  with -EINVAL, newer ones fail with -ENOTCONN
+	 */
+	if (tcp) {
+		(void)uring_prep_multishot(&r, IORING_OP_RECV, sfd, NULL,
+			UD(TAG_PROBE, 0, sfd));
+		(void)uring_prep_multishot(&r, IORING_OP_ACCEPT, sfd, NULL,
+			UD(TAG_ACCEPT, 0, sfd));
+	} else {
+		(void)uring_prep_multishot(&r, IORING_OP_RECVMSG, sfd, &recv_mh,
+			UD(TAG_RECV, 0, sfd));
+	}
+	(void)uring_submit(&r, 0);
+	shared->state = SERVER_READY;
+
+	while (opt_do_run) {
+		unsigned head = *r.cq_head;
+		const unsigned tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+		const bool idle = (head == tail);
+
+		for (; head != tail; head++) {
+			const struct io_uring_cqe *cqe = &r.cqes[head & r.cq_mask];
+			const int fd = UD_FD(cqe->user_data);
+			const bool more = !!(cqe->flags & IORING_CQE_F_MORE);
+			const uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+			uint8_t *buf = bufs + ((size_t)bid * IO_URING_NET_BUF_SIZE);
+
+			switch (UD_TAG(cqe->user_data)) {
+			case TAG_PROBE:
+				if (cqe->res == -EINVAL) {
+					shared->state = SERVER_UNSUPPORTED;
+					rc = EXIT_SUCCESS;
+					goto die_br;
+				}
+				break;
+			case TAG_ACCEPT:
+				if (cqe->res >= 0)
+					(void)uring_prep_multishot(&r, IORING_OP_RECV,
+						cqe->res, NULL, UD(TAG_RECV, 0, cqe->res));
+				if (cqe->res == -EINVAL) {
+					shared->state = SERVER_UNSUPPORTED;
+					rc = EXIT_SUCCESS;
+					goto die_br;
+				}
+				if (!more)
+					(void)uring_prep_multishot(&r, IORING_OP_ACCEPT,
+						sfd, NULL, UD(TAG_ACCEPT, 0, sfd));
+				break;
+			case TAG_RECV:
+				if (cqe->res > 0) {
+					if (tcp) {
+						buf_len[bid] = (uint32_t)cqe->res;
+						buf_off[bid] = 0;
+						(void)uring_prep_rw(&r, IORING_OP_WRITE_FIXED,
+							fd, buf, buf_len[bid], 0,
+							UD(TAG_SEND, bid, fd));
+					} else {
+						const struct io_uring_recvmsg_out *out =
+							(const struct io_uring_recvmsg_out *)buf;
+						struct msghdr *mh = &send_mh[bid];
+
+						send_iov[bid].iov_base = buf + sizeof(*out) +
+							recv_mh.msg_namelen;
+						send_iov[bid].iov_len = out->payloadlen;
+						memset(mh, 0, sizeof(*mh));
+						mh->msg_name = (void *)(buf + sizeof(*out));
+						mh->msg_namelen = out->namelen;
+						mh->msg_iov = &send_iov[bid];
+						mh->msg_iovlen = 1;
+						(void)uring_prep_rw(&r, IORING_OP_SENDMSG, fd,
+							mh, 1, 0, UD(TAG_SEND, bid, fd));
+					}
+				} else if (cqe->res != -ENOBUFS) {
+					/* peer closed or connection error */
+					if (tcp)
+						(void)close(fd);
+					break;
+				}
+				if (!more) {
+					(void)uring_prep_multishot(&r,
+						tcp ? IORING_OP_RECV : IORING_OP_RECVMSG,
+						fd, tcp ? NULL : &recv_mh,
+						UD(TAG_RECV, 0, fd));
+				}
+				break;
+			case TAG_SEND:
+				{
+					const uint16_t id = (uint16_t)UD_ID(cqe->user_data);
+					uint8_t *b = bufs + ((size_t)id * IO_URING_NET_BUF_SIZE);
+
+					/* finish off short tcp writes */
+					if (tcp && (cqe->res > 0)) {
+						buf_off[id] += (uint32_t)cqe->res;
+						if (buf_off[id] < buf_len[id]) {
+							(void)uring_prep_rw(&r,
+								IORING_OP_WRITE_FIXED, fd,
+								b + buf_off[id],
+								buf_len[id] - buf_off[id],
+								0, cqe->user_data);
+							break;
+						}
+					}
+					io_uring_net_buf_add(br, &br_tail, bufs, id);
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		__atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+
+		ret = uring_submit(&r, idle ? 1 : 0);
+		if ((ret < 0) && (ret != -EINTR) && (ret != -EBUSY)) {
+			errno = -ret;
+			pr_fail_dbg(name, "io_uring_enter");
+			goto die_br;
+		}
+		shared->enters = r.enters;
+		shared->submits = r.submits;
+		shared->submitted = r.submitted;
+	}
+	rc = EXIT_SUCCESS;
+
+die_br:
+	(void)munmap(br, br_sz);
+die_bufs:
+	(void)munmap(bufs, bufs_sz);
+die_uring:
+	uring_free(&r);
+die_close:
+	(void)close(sfd);
+	if (rc != EXIT_SUCCESS)
+		shared->state = SERVER_FAILED;
+	return rc;
+}
+
+/*
+ *  io_uring_net_request()
+ *	queue a request write linked to the read of its response
+ */
+static int io_uring_net_request(
+	stress_uring_t *r,
+	io_uring_net_conn_t *conn,
+	const uint32_t id)
+{
+	const uint32_t size = opt_io_uring_net_size;
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_prep_rw(r, IORING_OP_WRITE_FIXED, conn->fd,
+		conn->tx + conn->sent, size - conn->sent, 0,
+		UD(TAG_WRITE, id, conn->fd));
+	if (!sqe)
+		return -1;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe = uring_prep_rw(r, IORING_OP_READ_FIXED, conn->fd,
+		conn->rx + conn->got, size - conn->got, 0,
+		UD(TAG_READ, id, conn->fd));
+
+	return sqe ? 0 : -1;
+}
+
+/*
+ *  io_uring_net_connect()
+ *	open the client sockets once the server is ready
+ */
+static int io_uring_net_connect(
+	const char *name,
+	const uint32_t instance,
+	const pid_t ppid,
+	io_uring_net_shared_t *shared,
+	io_uring_net_conn_t *conn,
+	const uint32_t conns)
+{
+	struct sockaddr *addr;
+	socklen_t addr_len;
+	uint32_t i;
+	int retries = 0;
+
+	while (opt_do_run && (shared->state == SERVER_STARTING)) {
+		if (++retries > 1000) {
+			pr_fail(stderr, "%s: server did not start\n", name);
+			return -1;
+		}
+		(void)usleep(10000);
+	}
+	if (shared->state != SERVER_READY)
+		return -1;
+
+	stress_set_sockaddr(name, instance, ppid, opt_io_uring_net_domain,
+		opt_io_uring_net_port + instance, &addr, &addr_len,
+		NET_ADDR_LOOPBACK);
+
+	for (i = 0; opt_do_run && (i < conns); i++) {
+		conn[i].fd = socket(opt_io_uring_net_domain,
+			opt_io_uring_net_proto, 0);
+		if (conn[i].fd < 0) {
+			pr_fail_dbg(name, "socket");
+			return -1;
+		}
+		if (connect(conn[i].fd, addr, addr_len) < 0) {
+			pr_fail_dbg(name, "connect");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  stress_io_uring_net
+ *	stress io_uring with an echo server and clients
+ */
+int stress_io_uring_net(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const uint32_t conns = opt_io_uring_net_conns;
+	const uint32_t size = opt_io_uring_net_size;
+	const size_t fixed_sz = (size_t)conns * size * 2;
+	const pid_t ppid = getppid();
+	bool sqpoll = opt_io_uring_net_sqpoll;
+	io_uring_net_shared_t *shared;
+	io_uring_net_conn_t *conn;
+	uint8_t *fixed;
+	stress_uring_t r;
+	uint32_t i, active;
+	pid_t pid;
+	int ret, status, rc = EXIT_FAILURE;
+	double t_start, duration;
+
+	/* check now so any SQPOLL fall back is the same for both ends */
+	ret = uring_setup(&r, IO_URING_NET_ENTRIES, sqpoll);
+	if ((ret == -EPERM) && sqpoll) {
+		if (instance == 0)
+			pr_inf(stderr, "%s: no permission to use SQPOLL, "
+				"continuing without it\n", name);
+		sqpoll = false;
+		ret = uring_setup(&r, IO_URING_NET_ENTRIES, sqpoll);
+	}
+	if (ret < 0) {
+		if (ret == -ENOSYS) {
+			pr_inf(stderr, "%s: io_uring is not supported, "
+				"skipping stressor\n", name);
+			return EXIT_SUCCESS;
+		}
+		errno = -ret;
+		pr_fail_err(name, "io_uring_setup");
+		return EXIT_FAILURE;
+	}
+
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		pr_fail_err(name, "mmap");
+		goto free_uring;
+	}
+	fixed = mmap(NULL, fixed_sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (fixed == MAP_FAILED) {
+		pr_fail_err(name, "mmap");
+		goto free_shared;
+	}
+	if ((ret = uring_register_buffer(&r, fixed, fixed_sz)) < 0) {
+		errno = -ret;
+		pr_fail_err(name, "io_uring_register buffers");
+		goto free_fixed;
+	}
+	if ((conn = calloc(conns, sizeof(*conn))) == NULL) {
+		pr_fail_err(name, "calloc");
+		goto free_fixed;
+	}
+	for (i = 0; i < conns; i++) {
+		conn[i].fd = -1;
+		conn[i].tx = fixed + ((size_t)i * size * 2);
+		conn[i].rx = conn[i].tx + size;
+		memset(conn[i].tx, 'A' + (i % 26), size);
+	}
+
+	shared->state = SERVER_STARTING;
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (opt_do_run && (errno == EAGAIN))
+			goto again;
+		pr_fail_dbg(name, "fork");
+		goto free_conn;
+	} else if (pid == 0) {
+		(void)setpgid(0, pgrp);
+		stress_parent_died_alarm();
+		uring_free(&r);
+		_exit(io_uring_net_server(name, instance, ppid, shared, sqpoll));
+	}
+	(void)setpgid(pid, pgrp);
+
+	if (io_uring_net_connect(name, instance, ppid, shared, conn, conns) < 0) {
+		if (shared->state == SERVER_UNSUPPORTED) {
+			if (instance == 0)
+				pr_inf(stderr, "%s: kernel lacks multishot "
+					"accept/recv or provided buffer rings, "
+					"skipping stressor\n", name);
+			rc = EXIT_SUCCESS;
+		}
+		goto reap;
+	}
+
+	pr_dbg(stderr, "%s: %" PRIu32 " %s connections of %" PRIu32
+		" bytes on port %d%s\n", name, conns,
+		opt_io_uring_net_proto == SOCK_STREAM ? "tcp" : "udp",
+		size, opt_io_uring_net_port + instance,
+		sqpoll ? " using SQPOLL" : "");
+
+	t_start = time_now();
+	for (i = 0; i < conns; i++)
+		(void)io_uring_net_request(&r, &conn[i], i);
+	active = conns;
+
+	rc = EXIT_SUCCESS;
+	while (active && opt_do_run && (!max_ops || *counter < max_ops)) {
+		unsigned head = *r.cq_head;
+		const unsigned tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+		const bool idle = (head == tail);
+
+		for (; head != tail; head++) {
+			const struct io_uring_cqe *cqe = &r.cqes[head & r.cq_mask];
+			const uint32_t id = UD_ID(cqe->user_data);
+			io_uring_net_conn_t *c = &conn[id];
+
+			if (c->fd < 0)
+				continue;
+			if (UD_TAG(cqe->user_data) == TAG_WRITE) {
+				if (cqe->res > 0) {
+					c->sent += (uint32_t)cqe->res;
+					/* a short write cancels the linked read */
+					if (c->sent < size)
+						(void)io_uring_net_request(&r, c, id);
+				} else {
+					(void)close(c->fd);
+					c->fd = -1;
+					active--;
+				}
+				continue;
+			}
+			/* TAG_READ */
+			if (cqe->res == -ECANCELED)
+				continue;
+			if (cqe->res <= 0) {
+				(void)close(c->fd);
+				c->fd = -1;
+				active--;
+				continue;
+			}
+			c->got += (uint32_t)cqe->res;
+			if (c->got < size) {
+				(void)uring_prep_rw(&r, IORING_OP_READ_FIXED,
+					c->fd, c->rx + c->got, size - c->got, 0,
+					UD(TAG_READ, id, c->fd));
+				continue;
+			}
+			(*counter)++;
+			c->sent = 0;
+			c->got = 0;
+			(void)io_uring_net_request(&r, c, id);
+		}
+		__atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+
+		ret = uring_submit(&r, idle ? 1 : 0);
+		if ((ret < 0) && (ret != -EINTR) && (ret != -EBUSY)) {
+			errno = -ret;
+			pr_fail_err(name, "io_uring_enter");
+			rc = EXIT_FAILURE;
+			break;
+		}
+	}
+	duration = time_now() - t_start;
+
+	if (!active) {
+		pr_fail(stderr, "%s: all connections were closed\n", name);
+		rc = EXIT_FAILURE;
+	}
+	if ((duration > 0.0) && *counter) {
+		const double ops = (double)*counter;
+		const uint64_t enters = r.enters + shared->enters;
+		const uint64_t submits = r.submits + shared->submits;
+		const uint64_t submitted = r.submitted + shared->submitted;
+
+		stress_misc_metric_set(0, "round trips per second",
+			ops / duration);
+		stress_misc_metric_set(1, "SQEs per submit",
+			submits ? (double)submitted / (double)submits : 0.0);
+		stress_misc_metric_set(2, "syscalls per round trip",
+			(double)enters / ops);
+		stress_misc_metric_set(3, "SQEs per round trip",
+			(double)submitted / ops);
+	}
+
+reap:
+	(void)kill(pid, SIGKILL);
+	if (waitpid(pid, &status, 0) < 0)
+		pr_fail_dbg(name, "waitpid");
+	for (i = 0; i < conns; i++) {
+		if (conn[i].fd >= 0)
+			(void)close(conn[i].fd);
+	}
+free_conn:
+	free(conn);
+free_fixed:
+	(void)munmap(fixed, fixed_sz);
+free_shared:
+	(void)munmap(shared, sizeof(*shared));
+free_uring:
+	uring_free(&r);
+
+	return rc;
+}
+
+#endif
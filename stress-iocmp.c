@@ -0,0 +1,750 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_IOCMP)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+
+#if defined(HAVE_LIB_RT)
+#include <aio.h>
+#define IOCMP_POSIX_AIO		(1)
+#endif
+#if defined(STRESS_AIO_LINUX)
+#include <libaio.h>
+#endif
+#if defined(STRESS_URING)
+#include <linux/io_uring.h>
+#endif
+
+#define IOCMP_SLICE_TIME	(0.5)		/* seconds per engine per round */
+#define IOCMP_WAIT_NS		(10000000)	/* completion wait timeout */
+#define IOCMP_FILL_SZ		(1 * MB)	/* file fill chunk */
+
+static uint32_t opt_iocmp_bs = DEFAULT_IOCMP_BS;
+static uint32_t opt_iocmp_qd = DEFAULT_IOCMP_QD;
+static uint32_t opt_iocmp_read_pct = DEFAULT_IOCMP_READ_PCT;
+static uint64_t opt_iocmp_size = DEFAULT_IOCMP_SIZE;
+
+/* one comparison run: the file, buffers and engine state */
+typedef struct {
+	int fd;
+	uint32_t qd;			/* I/Os kept in flight */
+	size_t bs;			/* bytes per I/O */
+	io_buffers_t bufs;		/* one buffer per slot */
+#if defined(IOCMP_POSIX_AIO)
+	struct aiocb *aiocbs;
+	const struct aiocb **aiolist;	/* in flight, NULL if slot is free */
+#endif
+#if defined(STRESS_AIO_LINUX)
+	io_context_t ctx;
+	struct iocb *cbs;
+	struct iocb **pending;		/* queued, not yet submitted */
+	uint32_t npending;
+	struct io_event *events;
+#endif
+#if defined(STRESS_URING)
+	stress_uring_t ring;
+	bool fixed;			/* use the registered buffer */
+#endif
+} iocmp_t;
+
+/* an I/O engine, all issue the same workload */
+typedef struct {
+	const char *name;
+	int (*init)(iocmp_t *io);
+	int (*queue)(iocmp_t *io, const uint32_t slot, const bool wr,
+		const off_t offset);
+	int (*reap)(iocmp_t *io, uint32_t *slots, int64_t *res);
+	void (*deinit)(iocmp_t *io);
+} iocmp_engine_t;
+
+/* results accumulated over all the slices of one engine */
+typedef struct {
+	uint64_t ios;
+	uint64_t bytes;
+	uint64_t errors;
+	double duration;		/* wall clock seconds */
+	double cpu;			/* process user + system seconds */
+	stress_latency_t lat;		/* submit to completion latencies */
+	bool skipped;			/* engine is not usable here */
+} iocmp_stats_t;
+
+void stress_set_iocmp_bs(const char *optarg)
+{
+	uint64_t bs;
+
+	bs = get_uint64_byte(optarg);
+	check_range("iocmp-bs", bs, MIN_IOCMP_BS, MAX_IOCMP_BS);
+	opt_iocmp_bs = (uint32_t)bs;
+}
+
+void stress_set_iocmp_qd(const char *optarg)
+{
+	uint32_t qd;
+
+	qd = get_uint32(optarg);
+	check_range("iocmp-qd", qd, MIN_IOCMP_QD, MAX_IOCMP_QD);
+	opt_iocmp_qd = qd;
+}
+
+void stress_set_iocmp_read_pct(const char *optarg)
+{
+	uint32_t pct;
+
+	pct = get_uint32(optarg);
+	check_range("iocmp-read-pct", pct, 0, 100);
+	opt_iocmp_read_pct = pct;
+}
+
+void stress_set_iocmp_size(const char *optarg)
+{
+	uint64_t size;
+
+	size = get_uint64_byte(optarg);
+	check_range("iocmp-size", size, MIN_IOCMP_SIZE, MAX_IOCMP_SIZE);
+	opt_iocmp_size = size;
+}
+
+#if defined(IOCMP_POSIX_AIO)
+/*
+ *  POSIX AIO, glibc runs the requests on its own helper
+ *  threads. Completion is polled with aio_suspend() rather
+ *  than signalled so all the engines wait the same way
+ */
+static int iocmp_posix_init(iocmp_t *io)
+{
+	io->aiocbs = calloc(io->qd, sizeof(*io->aiocbs));
+	io->aiolist = calloc(io->qd, sizeof(*io->aiolist));
+	if (!io->aiocbs || !io->aiolist) {
+		free(io->aiolist);
+		free(io->aiocbs);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static int iocmp_posix_queue(
+	iocmp_t *io,
+	const uint32_t slot,
+	const bool wr,
+	const off_t offset)
+{
+	struct aiocb *cb = &io->aiocbs[slot];
+
+	memset(cb, 0, sizeof(*cb));
+	cb->aio_fildes = io->fd;
+	cb->aio_buf = io_buffer(&io->bufs, slot);
+	cb->aio_nbytes = io->bs;
+	cb->aio_offset = offset;
+	cb->aio_sigevent.sigev_notify = SIGEV_NONE;
+	if ((wr ? aio_write(cb) : aio_read(cb)) < 0)
+		return -errno;
+	io->aiolist[slot] = cb;
+	return 0;
+}
+
+static int iocmp_posix_reap(iocmp_t *io, uint32_t *slots, int64_t *res)
+{
+	struct timespec timeout;
+	uint32_t i;
+	int n = 0;
+
+	timeout.tv_sec = 0;
+	timeout.tv_nsec = IOCMP_WAIT_NS;
+	if ((aio_suspend(io->aiolist, (int)io->qd, &timeout) < 0) &&
+	    (errno != EAGAIN) && (errno != EINTR))
+		return -errno;
+
+	/* POSIX AIO has no completion queue, so scan every slot */
+	for (i = 0; i < io->qd; i++) {
+		struct aiocb *cb = (struct aiocb *)io->aiolist[i];
+		int err;
+
+		if (!cb)
+			continue;
+		err = aio_error(cb);
+		if (err == EINPROGRESS)
+			continue;
+		slots[n] = i;
+		res[n] = err ? -(int64_t)err : (int64_t)aio_return(cb);
+		io->aiolist[i] = NULL;
+		n++;
+	}
+	return n;
+}
+
+static void iocmp_posix_deinit(iocmp_t *io)
+{
+	free(io->aiolist);
+	free(io->aiocbs);
+}
+#endif
+
+#if defined(STRESS_AIO_LINUX)
+/*
+ *  Linux native AIO, requests are batched into one io_submit()
+ *  per reap
+ */
+static int iocmp_libaio_init(iocmp_t *io)
+{
+	int ret;
+
+	io->ctx = 0;
+	io->npending = 0;
+	io->cbs = calloc(io->qd, sizeof(*io->cbs));
+	io->pending = calloc(io->qd, sizeof(*io->pending));
+	io->events = calloc(io->qd, sizeof(*io->events));
+	if (!io->cbs || !io->pending || !io->events) {
+		ret = -ENOMEM;
+		goto err_free;
+	}
+	ret = io_setup((int)io->qd, &io->ctx);
+	if (ret < 0)
+		goto err_free;
+	return 0;
+
+err_free:
+	free(io->events);
+	free(io->pending);
+	free(io->cbs);
+	return ret;
+}
+
+static int iocmp_libaio_queue(
+	iocmp_t *io,
+	const uint32_t slot,
+	const bool wr,
+	const off_t offset)
+{
+	struct iocb *cb = &io->cbs[slot];
+
+	if (wr)
+		io_prep_pwrite(cb, io->fd, io_buffer(&io->bufs, slot), io->bs, offset);
+	else
+		io_prep_pread(cb, io->fd, io_buffer(&io->bufs, slot), io->bs, offset);
+	cb->data = (void *)(uintptr_t)slot;
+	io->pending[io->npending++] = cb;
+	return 0;
+}
+
+static int iocmp_libaio_reap(iocmp_t *io, uint32_t *slots, int64_t *res)
+{
+	struct timespec timeout;
+	int i, ret;
+
+	while (io->npending) {
+		ret = io_submit(io->ctx, (long)io->npending, io->pending);
+		if (ret == -EAGAIN)
+			break;
+		if (ret < 0)
+			return ret;
+		io->npending -= (uint32_t)ret;
+		memmove(io->pending, io->pending + ret,
+			io->npending * sizeof(*io->pending));
+	}
+	timeout.tv_sec = 0;
+	timeout.tv_nsec = IOCMP_WAIT_NS;
+	ret = io_getevents(io->ctx, 1, (long)io->qd, io->events, &timeout);
+	if (ret == -EINTR)
+		return 0;
+	if (ret < 0)
+		return ret;
+	for (i = 0; i < ret; i++) {
+		slots[i] = (uint32_t)(uintptr_t)io->events[i].data;
+		res[i] = (int64_t)(long)io->events[i].res;
+	}
+	return ret;
+}
+
+static void iocmp_libaio_deinit(iocmp_t *io)
+{
+	(void)io_destroy(io->ctx);
+	free(io->events);
+	free(io->pending);
+	free(io->cbs);
+}
+#endif
+
+#if defined(STRESS_URING)
+/*
+ *  io_uring, plain, with a kernel SQ polling thread, or
+ *  with the slot buffers registered as one fixed buffer
+ */
+static int iocmp_uring_setup(iocmp_t *io, const bool sqpoll, const bool fixed)
+{
+	int ret;
+
+	ret = uring_setup(&io->ring, io->qd, sqpoll);
+	if (ret < 0)
+		return ret;
+	io->fixed = false;
+	if (fixed) {
+		ret = uring_register_buffer(&io->ring, io->bufs.base,
+			(size_t)io->bufs.stride * io->bufs.count);
+		if (ret < 0) {
+			uring_free(&io->ring);
+			return ret;
+		}
+		io->fixed = true;
+	}
+	return 0;
+}
+
+static int iocmp_uring_init(iocmp_t *io)
+{
+	return iocmp_uring_setup(io, false, false);
+}
+
+static int iocmp_uring_sqpoll_init(iocmp_t *io)
+{
+	return iocmp_uring_setup(io, true, false);
+}
+
+static int iocmp_uring_fixed_init(iocmp_t *io)
+{
+	return iocmp_uring_setup(io, false, true);
+}
+
+static int iocmp_uring_queue(
+	iocmp_t *io,
+	const uint32_t slot,
+	const bool wr,
+	const off_t offset)
+{
+	uint8_t opcode;
+
+	if (io->fixed)
+		opcode = wr ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+	else
+		opcode = wr ? IORING_OP_WRITE : IORING_OP_READ;
+
+	/* buf_index is 0 as there is just the one registered buffer */
+	if (!uring_prep_rw(&io->ring, opcode, io->fd, io_buffer(&io->bufs, slot),
+			(uint32_t)io->bs, (uint64_t)offset, slot))
+		return -EBUSY;
+	return 0;
+}
+
+static int iocmp_uring_reap(iocmp_t *io, uint32_t *slots, int64_t *res)
+{
+	stress_uring_t *r = &io->ring;
+	unsigned head = *r->cq_head;
+	unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+	int ret, n = 0;
+
+	ret = uring_submit(r, (head == tail) ? 1 : 0);
+	if ((ret < 0) && (ret != -EINTR) && (ret != -EBUSY))
+		return ret;
+	tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++, n++) {
+		const struct io_uring_cqe *cqe = &r->cqes[head & r->cq_mask];
+
+		slots[n] = (uint32_t)cqe->user_data;
+		res[n] = cqe->res;
+	}
+	__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+	return n;
+}
+
+static void iocmp_uring_deinit(iocmp_t *io)
+{
+	uring_free(&io->ring);
+}
+#endif
+
+static const iocmp_engine_t iocmp_engines[] = {
+#if defined(IOCMP_POSIX_AIO)
+	{ "posix-aio",		iocmp_posix_init,	iocmp_posix_queue,
+	  iocmp_posix_reap,	iocmp_posix_deinit },
+#endif
+#if defined(STRESS_AIO_LINUX)
+	{ "libaio",		iocmp_libaio_init,	iocmp_libaio_queue,
+	  iocmp_libaio_reap,	iocmp_libaio_deinit },
+#endif
+#if defined(STRESS_URING)
+	{ "io_uring",		iocmp_uring_init,	iocmp_uring_queue,
+	  iocmp_uring_reap,	iocmp_uring_deinit },
+	{ "io_uring-sqpoll",	iocmp_uring_sqpoll_init, iocmp_uring_queue,
+	  iocmp_uring_reap,	iocmp_uring_deinit },
+	{ "io_uring-fixed",	iocmp_uring_fixed_init,	iocmp_uring_queue,
+	  iocmp_uring_reap,	iocmp_uring_deinit },
+#endif
+};
+
+/*
+ *  iocmp_cpu()
+ *	user + system time of the whole process, this includes
+ *	the glibc AIO threads and the io_uring SQPOLL and io-wq
+ *	threads as these all belong to the thread group
+ */
+static double iocmp_cpu(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0.0;
+	return (double)usage.ru_utime.tv_sec +
+	       ((double)usage.ru_utime.tv_usec / 1000000.0) +
+	       (double)usage.ru_stime.tv_sec +
+	       ((double)usage.ru_stime.tv_usec / 1000000.0);
+}
+
+/*
+ *  stress_iocmp_slice()
+ *	keep qd random reads and writes in flight through one
+ *	engine for a slice or slice_ops I/Os (0 = no limit),
+ *	adding the results to stats. The
+ *	in flight I/Os are drained inside the timed region so
+ *	every engine is charged for the same work
+ */
+static int stress_iocmp_slice(
+	const char *name,
+	iocmp_t *io,
+	const iocmp_engine_t *engine,
+	const uint64_t span,
+	iocmp_stats_t *stats,
+	const uint64_t slice_ops,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	uint32_t slots[MAX_IOCMP_QD], free_slots[MAX_IOCMP_QD];
+	uint64_t t_submit[MAX_IOCMP_QD];
+	int64_t res[MAX_IOCMP_QD];
+	uint32_t i, nfree = io->qd, inflight = 0;
+	uint64_t done = 0;
+	const uint64_t blocks = span / io->bs;
+	double t_start, t_end, cpu_start;
+	int ret, rc = 0;
+
+	ret = engine->init(io);
+	if (ret < 0) {
+		pr_inf(stderr, "%s: %s is not available, errno=%d (%s), "
+			"skipping it\n", name, engine->name, -ret, strerror(-ret));
+		stats->skipped = true;
+		return 0;
+	}
+	for (i = 0; i < io->qd; i++)
+		free_slots[i] = i;
+
+	cpu_start = iocmp_cpu();
+	t_start = time_now();
+	t_end = t_start + IOCMP_SLICE_TIME;
+	for (;;) {
+		const bool more = opt_do_run && (time_now() < t_end) &&
+			(!slice_ops || (done + inflight) < slice_ops) &&
+			(!max_ops || (*counter + inflight) < max_ops);
+		int n;
+
+		while (more && nfree) {
+			const uint32_t slot = free_slots[--nfree];
+			const bool wr = (mwc32() % 100) >= opt_iocmp_read_pct;
+			const off_t offset = (off_t)((mwc64() % blocks) * io->bs);
+
+			t_submit[slot] = time_now_ns();
+			ret = engine->queue(io, slot, wr, offset);
+			if (ret < 0) {
+				free_slots[nfree++] = slot;
+				if (ret == -EAGAIN)
+					break;
+				errno = -ret;
+				pr_fail_err(name, engine->name);
+				rc = -1;
+				break;
+			}
+			inflight++;
+		}
+		if (!inflight)
+			break;
+
+		n = engine->reap(io, slots, res);
+		if (n < 0) {
+			errno = -n;
+			pr_fail_err(name, engine->name);
+			rc = -1;
+			break;
+		}
+		if (n) {
+			const uint64_t now = time_now_ns();
+			int j;
+
+			for (j = 0; j < n; j++) {
+				latency_record(&stats->lat, now - t_submit[slots[j]]);
+				if (res[j] < 0)
+					stats->errors++;
+				else
+					stats->bytes += (uint64_t)res[j];
+				free_slots[nfree++] = slots[j];
+				stats->ios++;
+				done++;
+				(*counter)++;
+			}
+			inflight -= (uint32_t)n;
+		}
+		if (rc < 0)
+			break;
+	}
+	/* the buffers must not be reused while still in flight */
+	while (inflight) {
+		const int n = engine->reap(io, slots, res);
+
+		if (n < 0)
+			break;
+		inflight -= (uint32_t)n;
+	}
+	stats->duration += time_now() - t_start;
+	stats->cpu += iocmp_cpu() - cpu_start;
+	engine->deinit(io);
+
+	return rc;
+}
+
+/*
+ *  stress_iocmp_fill()
+ *	write the whole span so reads hit allocated blocks,
+ *	this goes through the page cache, it is not timed
+ */
+static int stress_iocmp_fill(const char *name, const char *filename, const uint64_t span)
+{
+	uint8_t *buf;
+	uint64_t off;
+	int fd, rc = 0;
+
+	buf = malloc(IOCMP_FILL_SZ);
+	if (!buf) {
+		pr_err(stderr, "%s: cannot allocate fill buffer\n", name);
+		return -1;
+	}
+	stress_strnrnd((char *)buf, IOCMP_FILL_SZ);
+
+	fd = open(filename, O_WRONLY);
+	if (fd < 0) {
+		pr_fail_err(name, "open");
+		free(buf);
+		return -1;
+	}
+	for (off = 0; opt_do_run && (off < span); off += IOCMP_FILL_SZ) {
+		const size_t len = (span - off > IOCMP_FILL_SZ) ?
+			IOCMP_FILL_SZ : (size_t)(span - off);
+
+		if (pwrite(fd, buf, len, (off_t)off) < 0) {
+			if (errno == ENOSPC)
+				pr_inf(stderr, "%s: no space for the %" PRIu64
+					" MB file, skipping stressor\n",
+					name, (uint64_t)(span / MB));
+			else
+				pr_fail_err(name, "pwrite");
+			rc = -1;
+			break;
+		}
+	}
+	(void)fdatasync(fd);
+	(void)close(fd);
+	free(buf);
+
+	return rc;
+}
+
+/*
+ *  stress_iocmp_report()
+ *	table of the engines, the first instance only
+ */
+static void stress_iocmp_report(
+	const char *name,
+	const iocmp_stats_t stats[],
+	const size_t n,
+	const bool direct,
+	const size_t bs,
+	const uint32_t qd)
+{
+	size_t i, idx = 0;
+
+	pr_inf(stderr, "%s: %zu byte %s I/Os, queue depth %" PRIu32 ", "
+		"%" PRIu32 "%% reads\n", name, bs,
+		direct ? "O_DIRECT" : "buffered", qd, opt_iocmp_read_pct);
+	pr_inf(stderr, "%s: %-15s %10s %9s %9s %9s %11s\n", name,
+		"engine", "IOPS", "MB/sec", "p50 usec", "p99 usec", "CPU usec/IO");
+	for (i = 0; i < n; i++) {
+		const iocmp_stats_t *s = &stats[i];
+		char desc[32];
+		double iops, mb_per_sec, cpu_per_io;
+
+		if (s->skipped || !s->ios || (s->duration <= 0.0)) {
+			pr_inf(stderr, "%s: %-15s %10s\n", name,
+				iocmp_engines[i].name, "n/a");
+			continue;
+		}
+		iops = (double)s->ios / s->duration;
+		mb_per_sec = ((double)s->bytes / s->duration) / (double)MB;
+		cpu_per_io = (s->cpu * 1000000.0) / (double)s->ios;
+
+		pr_inf(stderr, "%s: %-15s %10.0f %9.2f %9.1f %9.1f %11.2f\n",
+			name, iocmp_engines[i].name, iops, mb_per_sec,
+			(double)latency_percentile(&s->lat, 0.50) / 1000.0,
+			(double)latency_percentile(&s->lat, 0.99) / 1000.0,
+			cpu_per_io);
+		if (s->errors)
+			pr_dbg(stderr, "%s: %s: %" PRIu64 " failed I/Os\n",
+				name, iocmp_engines[i].name, s->errors);
+
+		(void)snprintf(desc, sizeof(desc), "%s IOPS",
+			iocmp_engines[i].name);
+		stress_misc_metric_set(idx++, desc, iops);
+		(void)snprintf(desc, sizeof(desc), "%s p99 usec",
+			iocmp_engines[i].name);
+		stress_misc_metric_set(idx++, desc,
+			(double)latency_percentile(&s->lat, 0.99) / 1000.0);
+		(void)snprintf(desc, sizeof(desc), "%s CPU usec/IO",
+			iocmp_engines[i].name);
+		stress_misc_metric_set(idx++, desc, cpu_per_io);
+	}
+}
+
+/*
+ *  stress_iocmp
+ *	issue the same random read/write workload through each
+ *	of the asynchronous I/O engines in turn, in short slices
+ *	so that they all see the same device and cache state,
+ *	and compare their IOPS, latency and CPU cost per I/O
+ */
+int stress_iocmp(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	static iocmp_stats_t stats[SIZEOF_ARRAY(iocmp_engines)];
+	const pid_t pid = getpid();
+	const size_t n_engines = SIZEOF_ARRAY(iocmp_engines);
+	char filename[PATH_MAX];
+	iocmp_t io;
+	uint64_t span, slice_ops = 0;
+	size_t i;
+	bool direct = true, usable = true;
+	int ret, rc = EXIT_FAILURE;
+
+	memset(&io, 0, sizeof(io));
+	memset(stats, 0, sizeof(stats));
+	io.qd = opt_iocmp_qd;
+
+	ret = stress_temp_dir_mk(name, pid, instance);
+	if (ret < 0)
+		return exit_status(-ret);
+	(void)stress_temp_filename(filename, sizeof(filename),
+		name, pid, instance, mwc32());
+
+	(void)umask(0077);
+	/* Compare the engines on the device, not on the page cache */
+	io.fd = open(filename, O_CREAT | O_RDWR | O_DIRECT, S_IRUSR | S_IWUSR);
+	if (io.fd < 0) {
+		direct = false;
+		io.fd = open(filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+		if (io.fd < 0) {
+			rc = exit_status(errno);
+			pr_fail_err(name, "open");
+			goto finish;
+		}
+		if (instance == 0)
+			pr_inf(stderr, "%s: O_DIRECT is not supported on %s, "
+				"using buffered I/O\n", name, stress_get_temp_path());
+	}
+
+	ret = io_buffers_alloc(&io.bufs, stress_get_temp_path(),
+		opt_iocmp_bs, io.qd);
+	if (ret < 0) {
+		rc = exit_status(-ret);
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " buffers\n",
+			name, io.qd);
+		goto close_fd;
+	}
+	io.bs = opt_iocmp_bs;
+	if (direct)
+		io.bs = (io.bs + io.bufs.io_align - 1) & ~(io.bufs.io_align - 1);
+	for (i = 0; i < io.qd; i++)
+		stress_strnrnd((char *)io_buffer(&io.bufs, (uint32_t)i), io.bs);
+
+	span = opt_iocmp_size - (opt_iocmp_size % io.bs);
+	if (span < io.bs)
+		span = io.bs;
+	if (stress_iocmp_fill(name, filename, span) < 0) {
+		rc = EXIT_NO_RESOURCE;
+		goto free_bufs;
+	}
+	(void)unlink(filename);
+
+	/* With --iocmp-ops share the I/Os over a few rounds of all engines */
+	if (max_ops) {
+		slice_ops = max_ops / (n_engines * 4);
+		if (slice_ops < io.qd)
+			slice_ops = io.qd;
+	}
+
+	do {
+		for (i = 0; i < n_engines; i++) {
+			if (stats[i].skipped)
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				break;
+			if (stress_iocmp_slice(name, &io, &iocmp_engines[i],
+					span, &stats[i], slice_ops, counter, max_ops) < 0)
+				goto report;
+		}
+		usable = false;
+		for (i = 0; i < n_engines; i++)
+			usable |= !stats[i].skipped;
+	} while (usable && opt_do_run && (!max_ops || *counter < max_ops));
+
+	rc = usable ? EXIT_SUCCESS : EXIT_NO_RESOURCE;
+report:
+	if (instance == 0)
+		stress_iocmp_report(name, stats, n_engines, direct, io.bs, io.qd);
+	if (rc == EXIT_NO_RESOURCE) {
+		pr_inf(stderr, "%s: none of the I/O engines could be used, "
+			"skipping stressor\n", name);
+	}
+free_bufs:
+	(void)unlink(filename);
+	io_buffers_free(&io.bufs);
+close_fd:
+	(void)close(io.fd);
+finish:
+	(void)stress_temp_dir_rm(name, pid, instance);
+
+	return rc;
+}
+
+#endif
@@ -37,6 +37,11 @@ static uint64_t opt_itimer_freq = DEFAULT_TIMER_FREQ;
 static bool set_itimer_freq = false;
 static double rate_us;
 static double start;
+#if defined(STRESS_LATENCY)
+static stress_latency_t jitter;		/* expiry lateness histogram */
+static uint64_t jitter_start;		/* CPU time the timer was set, ns */
+static uint64_t jitter_period;		/* timer interval, ns */
+#endif
 
 /*
  *  stress_set_itimer_freq()
@@ -76,6 +81,20 @@ static void stress_itimer_set(struct itimerval *timer)
 	timer->it_interval.tv_usec = timer->it_value.tv_usec;
 }
 
+#if defined(STRESS_LATENCY)
+/*
+ *  stress_itimer_cpu_ns()
+ *	process CPU time in nanoseconds, the ITIMER_PROF clock
+ */
+static inline uint64_t stress_itimer_cpu_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+#endif
+
 /*
  *  stress_itimer_handler()
  *	catch itimer signal and cancel if no more runs flagged
@@ -88,6 +107,19 @@ static void stress_itimer_handler(int sig)
 	(void)sig;
 
 	itimer_counter++;
+#if defined(STRESS_LATENCY)
+	/*
+	 *  Each expiry moves the timer on by one interval of
+	 *  process CPU time, so the Nth expiry is due N intervals
+	 *  of CPU time after the timer was set
+	 */
+	if (opt_flags & OPT_FLAGS_TIMER_JITTER) {
+		const uint64_t due = jitter_start + (itimer_counter * jitter_period);
+		const uint64_t now = stress_itimer_cpu_ns();
+
+		latency_record(&jitter, (now > due) ? now - due : 0);
+	}
+#endif
 
 	if (sigpending(&mask) == 0)
 		if (sigismember(&mask, SIGINT))
@@ -126,6 +158,7 @@ int stress_itimer(
 	sigemptyset(&mask);
 	sigaddset(&mask, SIGINT);
 	sigprocmask(SIG_SETMASK, &mask, NULL);
+	timer_jitter_sched();
 
 	if (!set_itimer_freq) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -139,6 +172,11 @@ int stress_itimer(
 		return EXIT_FAILURE;
 
 	stress_itimer_set(&timer);
+#if defined(STRESS_LATENCY)
+	jitter_period = ((uint64_t)timer.it_interval.tv_sec * 1000000000ULL) +
+		((uint64_t)timer.it_interval.tv_usec * 1000);
+	jitter_start = stress_itimer_cpu_ns();
+#endif
 	if (setitimer(ITIMER_PROF, &timer, NULL) < 0) {
 		pr_fail_err(name, "setitimer");
 		return EXIT_FAILURE;
@@ -153,5 +191,9 @@ int stress_itimer(
 
 	memset(&timer, 0, sizeof(timer));
 	(void)setitimer(ITIMER_PROF, &timer, NULL);
+#if defined(STRESS_LATENCY)
+	if (opt_flags & OPT_FLAGS_TIMER_JITTER)
+		latency_metrics_set(&jitter, "expiry lateness");
+#endif
 	return EXIT_SUCCESS;
 }
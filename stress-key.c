@@ -32,12 +32,30 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <keyutils.h>
 #include <stdarg.h>
 
 #define MAX_KEYS 	(256)
 
+#define KEY_SCALE_TIME		(0.25)	/* secs of lookups per keyring size */
+#define KEY_SCALE_TIMEOUT	(60)	/* secs before leftover keys expire */
+
+static uint64_t opt_key_max = DEFAULT_KEY_MAX;
+static bool opt_key_scale = false;
+
+void stress_set_key_max(const char *optarg)
+{
+	opt_key_max = get_uint64(optarg);
+	check_range("key-max", opt_key_max, MIN_KEY_MAX, MAX_KEY_MAX);
+}
+
+void stress_set_key_scale(void)
+{
+	opt_key_scale = true;
+}
+
 static long sys_keyctl(int cmd, ...)
 {
 	va_list args;
@@ -76,6 +94,170 @@ static key_serial_t sys_request_key(
 }
 #endif
 
+#if defined(KEYCTL_SEARCH)
+static key_serial_t sys_keyctl_search(
+	key_serial_t keyring,
+	const char *type,
+	const char *description)
+{
+	return (key_serial_t)syscall(__NR_keyctl, KEYCTL_SEARCH,
+		keyring, type, description, 0);
+}
+#endif
+
+/*
+ *  stress_key_lookup_err()
+ *	a key may expire or be reaped under a long lookup phase,
+ *	anything else is a failure
+ */
+static inline void stress_key_lookup_err(const char *name, const char *what)
+{
+	if ((errno != ENOKEY) && (errno != EKEYEXPIRED) && (errno != EKEYREVOKED))
+		pr_fail_err(name, what);
+}
+
+/*
+ *  stress_key_scale()
+ *	fill the session keyring with keys, 16 and growing by 4x up
+ *	to --key-max or the key quota, and time adding keys, keyctl
+ *	KEYCTL_SEARCH of the keyring and request_key of random keys
+ *	at each size. All instances share the session keyring so
+ *	with more than one instance the lookups contend on it
+ */
+static int stress_key_scale(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const pid_t ppid = getppid();
+	key_serial_t *keys;
+	bool reported = false;
+
+	keys = calloc((size_t)opt_key_max, sizeof(*keys));
+	if (!keys) {
+		pr_err(stderr, "%s: out of memory\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	do {
+		size_t i, n = 0, step, idx = 0;
+		char description[64];
+		char payload[64];
+
+		if ((instance == 0) && !reported)
+			pr_inf(stderr, "%s: %8s %12s %12s %12s %12s %12s\n",
+				name, "keys", "add p99 us", "search p50",
+				"search p99", "request p50", "request p99");
+
+		for (step = 16; opt_do_run && (step <= opt_key_max); step *= 4) {
+			stress_latency_t add_lat, search_lat, request_lat;
+			bool full = false;
+			double t;
+
+			memset(&add_lat, 0, sizeof(add_lat));
+			memset(&search_lat, 0, sizeof(search_lat));
+			memset(&request_lat, 0, sizeof(request_lat));
+
+			/* Grow the keyring up to this size */
+			for (; opt_do_run && (n < step); n++) {
+				uint64_t t_ns;
+
+				snprintf(description, sizeof(description),
+					"stress-ng-key-%u-%" PRIu32
+					"-%zu", ppid, instance, n);
+				snprintf(payload, sizeof(payload),
+					"somedata-%zu", n);
+				t_ns = time_now_ns();
+				keys[n] = sys_add_key("user", description,
+					payload, strlen(payload),
+					KEY_SPEC_SESSION_KEYRING);
+				if (keys[n] < 0) {
+					if ((errno != ENOMEM) && (errno != EDQUOT))
+						pr_fail_err(name, "add_key");
+					full = true;
+					break;
+				}
+				latency_record(&add_lat, time_now_ns() - t_ns);
+#if defined(KEYCTL_SET_TIMEOUT)
+				(void)sys_keyctl(KEYCTL_SET_TIMEOUT, keys[n], KEY_SCALE_TIMEOUT);
+#endif
+			}
+			if (!opt_do_run || !n)
+				break;
+			if (full && (instance == 0) && !reported)
+				pr_inf(stderr, "%s: key quota reached at %zu keys\n",
+					name, n);
+
+			/* Look up random keys, they are all in the keyring */
+			t = time_now();
+			while (opt_do_run && (time_now() - t < KEY_SCALE_TIME)) {
+				uint64_t t_ns;
+
+				i = (size_t)(mwc32() % n);
+				snprintf(description, sizeof(description),
+					"stress-ng-key-%u-%" PRIu32
+					"-%zu", ppid, instance, i);
+#if defined(KEYCTL_SEARCH)
+				t_ns = time_now_ns();
+				if (sys_keyctl_search(KEY_SPEC_SESSION_KEYRING,
+				    "user", description) < 0)
+					stress_key_lookup_err(name, "keyctl KEYCTL_SEARCH");
+				else
+					latency_record(&search_lat, time_now_ns() - t_ns);
+#endif
+#if defined(__NR_request_key)
+				t_ns = time_now_ns();
+				if (sys_request_key("user", description, NULL, 0) < 0)
+					stress_key_lookup_err(name, "request_key");
+				else
+					latency_record(&request_lat, time_now_ns() - t_ns);
+#endif
+			}
+			if (!opt_do_run)
+				break;
+
+			if ((instance == 0) && !reported)
+				pr_inf(stderr, "%s: %8zu %12.2f %12.2f %12.2f %12.2f %12.2f\n",
+					name, n,
+					(double)latency_percentile(&add_lat, 0.99) / 1000.0,
+					(double)latency_percentile(&search_lat, 0.50) / 1000.0,
+					(double)latency_percentile(&search_lat, 0.99) / 1000.0,
+					(double)latency_percentile(&request_lat, 0.50) / 1000.0,
+					(double)latency_percentile(&request_lat, 0.99) / 1000.0);
+			if (idx + 3 <= STRESS_MISC_METRICS_MAX) {
+				char desc[32];
+
+				snprintf(desc, sizeof(desc), "%u keys add p99 usec", (unsigned int)n);
+				stress_misc_metric_set(idx++, desc,
+					(double)latency_percentile(&add_lat, 0.99) / 1000.0);
+				snprintf(desc, sizeof(desc), "%u keys search p99 usec", (unsigned int)n);
+				stress_misc_metric_set(idx++, desc,
+					(double)latency_percentile(&search_lat, 0.99) / 1000.0);
+				snprintf(desc, sizeof(desc), "%u keys reqkey p99 usec", (unsigned int)n);
+				stress_misc_metric_set(idx++, desc,
+					(double)latency_percentile(&request_lat, 0.99) / 1000.0);
+			}
+			(*counter)++;
+			if (full || (max_ops && (*counter >= max_ops)))
+				break;
+		}
+		reported = true;
+
+		/* Empty the keyring for the next round */
+		for (i = 0; i < n; i++) {
+#if defined(KEYCTL_INVALIDATE)
+			(void)sys_keyctl(KEYCTL_INVALIDATE, keys[i]);
+#elif defined(KEYCTL_REVOKE)
+			(void)sys_keyctl(KEYCTL_REVOKE, keys[i]);
+#endif
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	free(keys);
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_key
  *	stress key operations
@@ -89,6 +271,9 @@ int stress_key(
 	key_serial_t keys[MAX_KEYS];
 	pid_t ppid = getppid();
 
+	if (opt_key_scale)
+		return stress_key_scale(counter, instance, max_ops, name);
+
 	do {
 		size_t i, n = 0;
 		char description[64];
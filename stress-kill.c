@@ -49,6 +49,8 @@ int stress_kill(
 
 	if (stress_sighandler(name, SIGUSR1, SIG_IGN, NULL) < 0)
 		return EXIT_FAILURE;
+	/* kill(pid, SIGUSR1), kill(pid, 0) and kill(-1, 0) */
+	stress_units_per_op(3.0);
 
 	do {
 		int ret;
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_KSM)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define KSM_PATH		"/sys/kernel/mm/ksm"
+#define KSM_PATTERNS		(16)	/* distinct contents of duplicate pages */
+#define KSM_POLL_USECS		(50000)	/* sysfs sample interval */
+#define KSM_SCANS_MIN		(3)	/* checksum, unstable then stable tree pass */
+#define KSM_SCANS_MAX		(32)	/* give up on merging the rest */
+#define KSM_SCANS_IDLE		(2)	/* passes merging nothing new */
+
+/* The global KSM counters of interest */
+typedef struct {
+	uint64_t full_scans;		/* completed ksmd passes */
+	uint64_t pages_shared;		/* KSM pages in use */
+	uint64_t pages_sharing;		/* sites sharing them, pages saved */
+	uint64_t ksmd_ticks;		/* ksmd utime + stime */
+	double time;			/* when sampled */
+} ksm_stats_t;
+
+static uint64_t opt_ksm_bytes = DEFAULT_KSM_BYTES;
+static uint32_t opt_ksm_dup = DEFAULT_KSM_DUP;
+
+void stress_set_ksm_bytes(const char *optarg)
+{
+	opt_ksm_bytes = get_uint64_byte(optarg);
+	check_range("ksm-bytes", opt_ksm_bytes, MIN_KSM_BYTES, MAX_KSM_BYTES);
+}
+
+void stress_set_ksm_dup(const char *optarg)
+{
+	opt_ksm_dup = (uint32_t)get_uint64(optarg);
+	check_range("ksm-dup", opt_ksm_dup, MIN_KSM_DUP, MAX_KSM_DUP);
+}
+
+/*
+ *  ksm_read()
+ *	read a /sys/kernel/mm/ksm counter
+ */
+static uint64_t ksm_read(const char *counter)
+{
+	char path[PATH_MAX], buf[32];
+
+	(void)snprintf(path, sizeof(path), KSM_PATH "/%s", counter);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return 0;
+	return strtoull(buf, NULL, 10);
+}
+
+/*
+ *  ksm_ksmd_pid()
+ *	find the ksmd kernel thread, -1 if not found
+ */
+static pid_t ksm_ksmd_pid(void)
+{
+	DIR *dir;
+	struct dirent *d;
+	pid_t pid = -1;
+
+	dir = opendir("/proc");
+	if (!dir)
+		return -1;
+	while ((d = readdir(dir)) != NULL) {
+		char path[PATH_MAX], buf[32];
+
+		if ((d->d_name[0] < '1') || (d->d_name[0] > '9'))
+			continue;
+		(void)snprintf(path, sizeof(path), "/proc/%s/comm", d->d_name);
+		if ((system_read(path, buf, sizeof(buf) - 1) > 0) &&
+		    !strncmp(buf, "ksmd\n", 5)) {
+			pid = (pid_t)atoi(d->d_name);
+			break;
+		}
+	}
+	(void)closedir(dir);
+
+	return pid;
+}
+
+/*
+ *  ksm_ksmd_ticks()
+ *	CPU time of ksmd in clock ticks
+ */
+static uint64_t ksm_ksmd_ticks(const pid_t pid)
+{
+	char path[PATH_MAX], buf[512], *ptr;
+	unsigned long utime, stime;
+
+	if (pid < 0)
+		return 0;
+	(void)snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return 0;
+	/* utime and stime are the 12th and 13th fields after the comm */
+	ptr = strrchr(buf, ')');
+	if (!ptr || (sscanf(ptr + 2, "%*c %*d %*d %*d %*d %*d %*u %*u "
+			"%*u %*u %*u %lu %lu", &utime, &stime) != 2))
+		return 0;
+	return (uint64_t)utime + stime;
+}
+
+static void ksm_stats(const pid_t ksmd, ksm_stats_t *stats)
+{
+	stats->full_scans = ksm_read("full_scans");
+	stats->pages_shared = ksm_read("pages_shared");
+	stats->pages_sharing = ksm_read("pages_sharing");
+	stats->ksmd_ticks = ksm_ksmd_ticks(ksmd);
+	stats->time = time_now();
+}
+
+/*
+ *  ksm_fill()
+ *	fill the region, dup percent of the pages hold one of
+ *	a few patterns, the rest are unique to this cycle
+ */
+static size_t ksm_fill(
+	uint8_t *buf,
+	const size_t pages,
+	const size_t page_size,
+	const uint64_t cycle)
+{
+	size_t i, dups = 0;
+
+	for (i = 0; i < pages; i++) {
+		uint64_t *ptr = (uint64_t *)(buf + (i * page_size));
+		uint64_t *end = (uint64_t *)((uint8_t *)ptr + page_size);
+		const bool dup = (i % 100) < opt_ksm_dup;
+		const uint64_t val = dup ?
+			0x5a5a5a5a00000001ULL + (i % KSM_PATTERNS) :
+			(cycle << 32) ^ (i + 1) ^ (uint64_t)getpid() << 48;
+
+		while (ptr < end)
+			*ptr++ = val;
+		dups += dup;
+	}
+	return dups;
+}
+
+/*
+ *  stress_ksm
+ *	fill memory with duplicate pages, let ksmd merge them
+ *	and then write to them to unmerge them again
+ */
+int stress_ksm(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t page_size = stress_get_pagesize();
+	const size_t sz = (size_t)opt_ksm_bytes & ~(page_size - 1);
+	const size_t pages = sz / page_size;
+	const double clk_tck = (double)sysconf(_SC_CLK_TCK);
+	const pid_t ksmd = ksm_ksmd_pid();
+	uint64_t saved = 0, merged = 0, ksmd_ticks = 0, cow_faults = 0;
+	double merge_secs = 0.0, cow_secs = 0.0;
+	bool enabled = false;
+	uint8_t *buf;
+
+	if (ksm_read("run") != 1) {
+		/* ksmd is off, turn it on for the run if we may */
+		if (system_write(KSM_PATH "/run", "1", 1) < 0) {
+			if (instance == 0)
+				pr_inf(stderr, "%s: KSM is not running and cannot "
+					"be enabled, skipping stressor\n", name);
+			return EXIT_NO_RESOURCE;
+		}
+		enabled = true;
+	}
+
+	buf = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot mmap %zu bytes, errno=%d (%s), "
+			"skipping stressor\n", name, sz, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+#if defined(MADV_NOHUGEPAGE)
+	/* ksmd only merges small pages */
+	(void)madvise(buf, sz, MADV_NOHUGEPAGE);
+#endif
+
+	do {
+		ksm_stats_t begin, now;
+		struct rusage usage;
+		uint64_t scans, scan_sharing, idle, low_sharing, low_total;
+		long minflt;
+		size_t i, dups;
+		double t;
+
+		dups = ksm_fill(buf, pages, page_size, *counter);
+		if (madvise(buf, sz, MADV_MERGEABLE) < 0) {
+			pr_fail_err(name, "madvise MADV_MERGEABLE");
+			break;
+		}
+
+		/*
+		 *  A page merges on the third ksmd pass that sees it at
+		 *  the earliest, smart scan may skip it for a few more,
+		 *  so wait until full passes merge nothing new. The
+		 *  counters still hold the last cycle's merges until
+		 *  ksmd drops their stale rmap items, so the baseline
+		 *  is the lowest count seen while waiting
+		 */
+		ksm_stats(ksmd, &begin);
+		scan_sharing = begin.pages_sharing;
+		low_sharing = begin.pages_sharing;
+		low_total = begin.pages_shared + begin.pages_sharing;
+		scans = begin.full_scans;
+		idle = 0;
+		do {
+			(void)usleep(KSM_POLL_USECS);
+			ksm_stats(ksmd, &now);
+			low_sharing = STRESS_MINIMUM(low_sharing, now.pages_sharing);
+			low_total = STRESS_MINIMUM(low_total,
+				now.pages_shared + now.pages_sharing);
+			if (now.full_scans == scans)
+				continue;
+			scans = now.full_scans;
+			idle = (now.pages_sharing <= scan_sharing) ? idle + 1 : 0;
+			if ((scans >= begin.full_scans + KSM_SCANS_MIN) &&
+			    (idle >= KSM_SCANS_IDLE))
+				break;
+			scan_sharing = now.pages_sharing;
+		} while (opt_do_run && (scans < begin.full_scans + KSM_SCANS_MAX));
+		saved += now.pages_sharing - low_sharing;
+		merged += (now.pages_shared + now.pages_sharing) - low_total;
+		ksmd_ticks += now.ksmd_ticks - begin.ksmd_ticks;
+		merge_secs += now.time - begin.time;
+
+		/* Each write to a merged page is a CoW fault unmerging it */
+		(void)getrusage(RUSAGE_SELF, &usage);
+		minflt = usage.ru_minflt;
+		t = time_now();
+		for (i = 0; i < pages; i++) {
+			if ((i % 100) < opt_ksm_dup)
+				buf[i * page_size]++;
+		}
+		cow_secs += time_now() - t;
+		(void)getrusage(RUSAGE_SELF, &usage);
+		cow_faults += usage.ru_minflt - minflt;
+
+		(void)madvise(buf, sz, MADV_UNMERGEABLE);
+		(*counter)++;
+
+		if ((instance == 0) && (*counter == 1)) {
+			const double secs = now.time - begin.time;
+
+			pr_inf(stderr, "%s: %zu of %zu pages duplicate, %" PRIu64
+				" pages saved in %.2f secs, ksmd %.1f%% CPU\n",
+				name, dups, pages,
+				now.pages_sharing - low_sharing, secs,
+				(secs > 0.0) ? 100.0 * (double)(now.ksmd_ticks -
+					begin.ksmd_ticks) / clk_tck / secs : 0.0);
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	if (merge_secs > 0.0) {
+		stress_misc_metric_set(0, "merge rate pages/sec",
+			(double)merged / merge_secs);
+		stress_misc_metric_set(1, "memory saved MB per pass",
+			(double)saved * page_size / (double)MB / (double)*counter);
+		if (ksmd >= 0) {
+			stress_misc_metric_set(2, "ksmd CPU percent",
+				100.0 * (double)ksmd_ticks / clk_tck / merge_secs);
+			if (merged)
+				stress_misc_metric_set(3, "ksmd usec per merged page",
+					1000000.0 * (double)ksmd_ticks / clk_tck /
+					(double)merged);
+		}
+	}
+	if (cow_faults)
+		stress_misc_metric_set(4, "CoW unmerge fault ns",
+			cow_secs * 1000000000.0 / (double)cow_faults);
+
+	(void)munmap(buf, sz);
+	if (enabled && (instance == 0))
+		(void)system_write(KSM_PATH "/run", "0", 1);
+
+	return EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,712 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_LFQUEUE)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define LFQUEUE_PHASE_TIME	(1.0)		/* seconds per queue phase */
+#define LFQUEUE_RING_SIZE	(1024)		/* ring slots, power of 2 */
+#define LFQUEUE_RING_MASK	(LFQUEUE_RING_SIZE - 1)
+#define LFQUEUE_MS_NODES	(4096)		/* Michael-Scott node pool */
+#define LFQUEUE_NIL		(0xffffffffU)	/* no node */
+
+#define LFQUEUE_SPSC		(0)	/* single producer/consumer ring */
+#define LFQUEUE_MPSC		(1)	/* sequenced ring, 1 consumer */
+#define LFQUEUE_MPMC		(2)	/* sequenced ring */
+#define LFQUEUE_MS		(3)	/* Michael-Scott linked queue */
+#define LFQUEUE_MAX		(4)
+#define LFQUEUE_ALL		(LFQUEUE_MAX)
+
+typedef struct {
+	const char *name;	/* User option */
+	int type;		/* LFQUEUE_ value */
+} lfqueue_type_t;
+
+static const lfqueue_type_t lfqueue_types[] = {
+	{ "spsc",	LFQUEUE_SPSC },
+	{ "mpsc",	LFQUEUE_MPSC },
+	{ "mpmc",	LFQUEUE_MPMC },
+	{ "ms",		LFQUEUE_MS },
+	{ "all",	LFQUEUE_ALL },
+};
+
+/* Sequenced ring slot, the sequence says whose turn the slot is */
+typedef struct {
+	uint64_t seq;
+	uint64_t value;
+} lfqueue_slot_t;
+
+/* Michael-Scott node, links are index << 32 | modification tag */
+typedef struct {
+	uint64_t next;			/* tagged next node */
+	uint64_t value;
+	uint32_t free_next;		/* free list link */
+} lfqueue_node_t;
+
+/* A producer or consumer thread */
+typedef struct {
+	pthread_t pthread;		/* the thread */
+	int ret;			/* pthread_create return */
+	int cpu;			/* CPU to pin to, -1 = none */
+	bool producer;			/* producer or consumer */
+	uint64_t items;			/* items moved this phase */
+	uint64_t sum;			/* sum of the values moved */
+} lfqueue_thread_t;
+
+/* The queues, indices and tags on their own cache lines */
+static struct {
+	uint64_t head __attribute__((aligned(64)));
+	uint64_t tail __attribute__((aligned(64)));
+	uint64_t free_top __attribute__((aligned(64)));
+	uint64_t spsc[LFQUEUE_RING_SIZE] __attribute__((aligned(64)));
+	lfqueue_slot_t ring[LFQUEUE_RING_SIZE];
+	lfqueue_node_t nodes[LFQUEUE_MS_NODES];
+	int type;			/* LFQUEUE_ of this phase */
+	bool run;			/* producers keep on producing */
+	bool go;			/* all threads at the start line */
+	uint32_t started;		/* threads at the start line */
+	uint32_t producing;		/* producers still running */
+} lfq;
+
+static int opt_lfqueue_type = LFQUEUE_ALL;
+static uint32_t opt_lfqueue_producers = DEFAULT_LFQUEUE_THREADS;
+static uint32_t opt_lfqueue_consumers = DEFAULT_LFQUEUE_THREADS;
+static bool opt_lfqueue_pin = false;
+
+/*
+ *  stress_set_lfqueue_type()
+ *	set the queue to exercise
+ */
+int stress_set_lfqueue_type(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(lfqueue_types); i++) {
+		if (!strcmp(name, lfqueue_types[i].name)) {
+			opt_lfqueue_type = lfqueue_types[i].type;
+			return 0;
+		}
+	}
+	fprintf(stderr, "lfqueue-type must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(lfqueue_types); i++)
+		fprintf(stderr, " %s", lfqueue_types[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+void stress_set_lfqueue_producers(const char *optarg)
+{
+	opt_lfqueue_producers = (uint32_t)get_uint64(optarg);
+	check_range("lfqueue-producers", opt_lfqueue_producers,
+		MIN_LFQUEUE_THREADS, MAX_LFQUEUE_THREADS);
+}
+
+void stress_set_lfqueue_consumers(const char *optarg)
+{
+	opt_lfqueue_consumers = (uint32_t)get_uint64(optarg);
+	check_range("lfqueue-consumers", opt_lfqueue_consumers,
+		MIN_LFQUEUE_THREADS, MAX_LFQUEUE_THREADS);
+}
+
+void stress_set_lfqueue_pin(void)
+{
+	opt_lfqueue_pin = true;
+}
+
+static inline void lfqueue_relax(void)
+{
+#if defined(STRESS_X86)
+	__builtin_ia32_pause();
+#else
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline uint64_t lfqueue_pack(const uint32_t idx, const uint64_t old)
+{
+	return ((uint64_t)idx << 32) | (uint32_t)(old + 1);
+}
+
+static inline uint32_t lfqueue_idx(const uint64_t link)
+{
+	return (uint32_t)(link >> 32);
+}
+
+/*
+ *  SPSC ring, head and tail are free running counters
+ */
+static bool lfqueue_spsc_push(const uint64_t value)
+{
+	const uint64_t tail = __atomic_load_n(&lfq.tail, __ATOMIC_RELAXED);
+
+	if (tail - __atomic_load_n(&lfq.head, __ATOMIC_ACQUIRE) >= LFQUEUE_RING_SIZE)
+		return false;
+	lfq.spsc[tail & LFQUEUE_RING_MASK] = value;
+	__atomic_store_n(&lfq.tail, tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+static bool lfqueue_spsc_pop(uint64_t *value)
+{
+	const uint64_t head = __atomic_load_n(&lfq.head, __ATOMIC_RELAXED);
+
+	if (head == __atomic_load_n(&lfq.tail, __ATOMIC_ACQUIRE))
+		return false;
+	*value = lfq.spsc[head & LFQUEUE_RING_MASK];
+	__atomic_store_n(&lfq.head, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/*
+ *  Sequenced ring, a slot is free for position pos when its
+ *  sequence is pos and full when it is pos + 1
+ */
+static bool lfqueue_ring_push(const uint64_t value)
+{
+	uint64_t pos = __atomic_load_n(&lfq.tail, __ATOMIC_RELAXED);
+
+	for (;;) {
+		lfqueue_slot_t *slot = &lfq.ring[pos & LFQUEUE_RING_MASK];
+		const uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		const int64_t diff = (int64_t)(seq - pos);
+
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&lfq.tail, &pos, pos + 1,
+			    true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				slot->value = value;
+				__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+				return true;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = __atomic_load_n(&lfq.tail, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+static bool lfqueue_ring_pop(uint64_t *value)
+{
+	uint64_t pos = __atomic_load_n(&lfq.head, __ATOMIC_RELAXED);
+
+	for (;;) {
+		lfqueue_slot_t *slot = &lfq.ring[pos & LFQUEUE_RING_MASK];
+		const uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		const int64_t diff = (int64_t)(seq - (pos + 1));
+
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&lfq.head, &pos, pos + 1,
+			    true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				*value = slot->value;
+				__atomic_store_n(&slot->seq, pos + LFQUEUE_RING_SIZE,
+					__ATOMIC_RELEASE);
+				return true;
+			}
+		} else if (diff < 0) {
+			return false;
+		} else {
+			pos = __atomic_load_n(&lfq.head, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+/*
+ *  Michael-Scott queue over a node pool with a tagged free
+ *  list, the tags stop ABA on recycled nodes
+ */
+static uint32_t lfqueue_ms_alloc(void)
+{
+	uint64_t top = __atomic_load_n(&lfq.free_top, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		const uint32_t idx = lfqueue_idx(top);
+		uint32_t next;
+
+		if (idx == LFQUEUE_NIL)
+			return LFQUEUE_NIL;
+		next = __atomic_load_n(&lfq.nodes[idx].free_next, __ATOMIC_RELAXED);
+		if (__atomic_compare_exchange_n(&lfq.free_top, &top,
+		    lfqueue_pack(next, top), true,
+		    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return idx;
+	}
+}
+
+static void lfqueue_ms_free(const uint32_t idx)
+{
+	uint64_t top = __atomic_load_n(&lfq.free_top, __ATOMIC_ACQUIRE);
+
+	do {
+		__atomic_store_n(&lfq.nodes[idx].free_next, lfqueue_idx(top),
+			__ATOMIC_RELAXED);
+	} while (!__atomic_compare_exchange_n(&lfq.free_top, &top,
+		 lfqueue_pack(idx, top), true,
+		 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+static bool lfqueue_ms_push(const uint64_t value)
+{
+	const uint32_t idx = lfqueue_ms_alloc();
+	lfqueue_node_t *node;
+	uint64_t tail;
+
+	if (idx == LFQUEUE_NIL)
+		return false;
+	node = &lfq.nodes[idx];
+	node->value = value;
+	__atomic_store_n(&node->next,
+		lfqueue_pack(LFQUEUE_NIL, __atomic_load_n(&node->next, __ATOMIC_RELAXED)),
+		__ATOMIC_RELEASE);
+
+	for (;;) {
+		uint64_t next;
+
+		tail = __atomic_load_n(&lfq.tail, __ATOMIC_ACQUIRE);
+		next = __atomic_load_n(&lfq.nodes[lfqueue_idx(tail)].next, __ATOMIC_ACQUIRE);
+		if (tail != __atomic_load_n(&lfq.tail, __ATOMIC_ACQUIRE))
+			continue;
+		if (lfqueue_idx(next) == LFQUEUE_NIL) {
+			if (__atomic_compare_exchange_n(&lfq.nodes[lfqueue_idx(tail)].next,
+			    &next, lfqueue_pack(idx, next), false,
+			    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				break;
+		} else {
+			/* Tail is lagging, help it along */
+			(void)__atomic_compare_exchange_n(&lfq.tail, &tail,
+				lfqueue_pack(lfqueue_idx(next), tail), false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+		}
+	}
+	(void)__atomic_compare_exchange_n(&lfq.tail, &tail,
+		lfqueue_pack(idx, tail), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	return true;
+}
+
+static bool lfqueue_ms_pop(uint64_t *value)
+{
+	uint64_t head;
+
+	for (;;) {
+		uint64_t tail, next;
+
+		head = __atomic_load_n(&lfq.head, __ATOMIC_ACQUIRE);
+		tail = __atomic_load_n(&lfq.tail, __ATOMIC_ACQUIRE);
+		next = __atomic_load_n(&lfq.nodes[lfqueue_idx(head)].next, __ATOMIC_ACQUIRE);
+		if (head != __atomic_load_n(&lfq.head, __ATOMIC_ACQUIRE))
+			continue;
+		if (lfqueue_idx(head) == lfqueue_idx(tail)) {
+			if (lfqueue_idx(next) == LFQUEUE_NIL)
+				return false;
+			(void)__atomic_compare_exchange_n(&lfq.tail, &tail,
+				lfqueue_pack(lfqueue_idx(next), tail), false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+		} else {
+			/* The node may be recycled under us, the CAS catches it */
+			*value = __atomic_load_n(&lfq.nodes[lfqueue_idx(next)].value,
+				__ATOMIC_RELAXED);
+			if (__atomic_compare_exchange_n(&lfq.head, &head,
+			    lfqueue_pack(lfqueue_idx(next), head), false,
+			    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				break;
+		}
+	}
+	lfqueue_ms_free(lfqueue_idx(head));
+	return true;
+}
+
+static inline bool lfqueue_push(const int type, const uint64_t value)
+{
+	switch (type) {
+	case LFQUEUE_SPSC:
+		return lfqueue_spsc_push(value);
+	case LFQUEUE_MS:
+		return lfqueue_ms_push(value);
+	default:
+		return lfqueue_ring_push(value);
+	}
+}
+
+static inline bool lfqueue_pop(const int type, uint64_t *value)
+{
+	switch (type) {
+	case LFQUEUE_SPSC:
+		return lfqueue_spsc_pop(value);
+	case LFQUEUE_MS:
+		return lfqueue_ms_pop(value);
+	default:
+		return lfqueue_ring_pop(value);
+	}
+}
+
+/*
+ *  lfqueue_reset()
+ *	empty the queues for a new phase
+ */
+static void lfqueue_reset(const int type)
+{
+	uint32_t i;
+
+	lfq.type = type;
+	lfq.head = 0;
+	lfq.tail = 0;
+	for (i = 0; i < LFQUEUE_RING_SIZE; i++)
+		lfq.ring[i].seq = i;
+
+	/* Node 0 is the initial dummy, the rest are free */
+	for (i = 0; i < LFQUEUE_MS_NODES; i++) {
+		lfq.nodes[i].next = lfqueue_pack(LFQUEUE_NIL, 0);
+		lfq.nodes[i].free_next = (i + 1 < LFQUEUE_MS_NODES) ? i + 1 : LFQUEUE_NIL;
+	}
+	if (type == LFQUEUE_MS) {
+		lfq.head = lfqueue_pack(0, 0);
+		lfq.tail = lfqueue_pack(0, 0);
+		lfq.free_top = lfqueue_pack(1, 0);
+	}
+}
+
+/*
+ *  lfqueue_thread()
+ *	produce until told to stop, or consume until the
+ *	producers are done and the queue is empty
+ */
+static void *lfqueue_thread(void *arg)
+{
+	lfqueue_thread_t *t = (lfqueue_thread_t *)arg;
+	const int type = lfq.type;
+	static void *nowt = NULL;
+
+#if defined(__linux__)
+	if (t->cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(t->cpu, &set);
+		(void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+#endif
+	__atomic_add_fetch(&lfq.started, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(&lfq.go, __ATOMIC_ACQUIRE))
+		(void)sched_yield();
+
+	if (t->producer) {
+		uint64_t value = (uint64_t)(uintptr_t)t;
+
+		while (__atomic_load_n(&lfq.run, __ATOMIC_RELAXED)) {
+			value++;
+			while (!lfqueue_push(type, value)) {
+				if (!__atomic_load_n(&lfq.run, __ATOMIC_RELAXED))
+					goto done;
+				lfqueue_relax();
+				(void)sched_yield();
+			}
+			t->sum += value;
+			t->items++;
+		}
+done:
+		__atomic_sub_fetch(&lfq.producing, 1, __ATOMIC_RELEASE);
+	} else {
+		for (;;) {
+			uint64_t value;
+
+			if (lfqueue_pop(type, &value)) {
+				t->sum += value;
+				__atomic_store_n(&t->items, t->items + 1, __ATOMIC_RELAXED);
+				continue;
+			}
+			if (!__atomic_load_n(&lfq.producing, __ATOMIC_ACQUIRE) &&
+			    !lfqueue_pop(type, &value))
+				break;
+			lfqueue_relax();
+			(void)sched_yield();
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  lfqueue_cpus()
+ *	fill cpus[] with the allowed CPUs, returns the count
+ */
+static uint32_t lfqueue_cpus(int *cpus, const uint32_t max)
+{
+	uint32_t n = 0;
+#if defined(__linux__)
+	cpu_set_t allowed;
+	int cpu;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		return 0;
+	for (cpu = 0; (cpu < CPU_SETSIZE) && (n < max); cpu++)
+		if (CPU_ISSET(cpu, &allowed))
+			cpus[n++] = cpu;
+#else
+	(void)cpus;
+	(void)max;
+#endif
+	return n;
+}
+
+/*
+ *  lfqueue_misses_open()
+ *	open a cache miss counter that also counts the
+ *	threads created after it, -1 if unavailable
+ */
+static int lfqueue_misses_open(void)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_open_by_id(STRESS_PERF_HW_CACHE_MISSES);
+#else
+	return -1;
+#endif
+}
+
+/*
+ *  lfqueue_misses_read()
+ *	read the cache miss counter, false if unavailable
+ */
+static bool lfqueue_misses_read(const int fd, uint64_t *misses)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_read_by_fd(fd, misses) == 0;
+#else
+	(void)fd;
+
+	*misses = 0;
+	return false;
+#endif
+}
+
+/*
+ *  lfqueue_phase()
+ *	move items through one queue type for a phase, returns
+ *	the number of items consumed
+ */
+static uint64_t lfqueue_phase(
+	const char *name,
+	const int type,
+	lfqueue_thread_t *threads,
+	const int ctr_fd,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	double *duration,
+	uint64_t *misses)
+{
+	const uint32_t producers = (type == LFQUEUE_SPSC) ? 1 : opt_lfqueue_producers;
+	const uint32_t consumers = (type == LFQUEUE_MPMC) || (type == LFQUEUE_MS) ?
+		opt_lfqueue_consumers : 1;
+	const uint64_t base = *counter;
+	uint64_t produced = 0, consumed = 0, sum_in = 0, sum_out = 0;
+	uint64_t misses_start = 0, misses_end = 0;
+	int cpus[MAX_LFQUEUE_THREADS * 2];
+	uint32_t i, ncpus, started = 0;
+	bool ctr_ok;
+	double t_start, t_end;
+
+	*duration = 0.0;
+	*misses = ~0ULL;
+	ncpus = opt_lfqueue_pin ? lfqueue_cpus(cpus, SIZEOF_ARRAY(cpus)) : 0;
+	lfqueue_reset(type);
+	lfq.run = true;
+	lfq.go = false;
+	lfq.started = 0;
+	lfq.producing = producers;
+
+	for (i = 0; i < producers + consumers; i++) {
+		lfqueue_thread_t *t = &threads[i];
+
+		t->producer = (i < producers);
+		t->cpu = ncpus ? cpus[i % ncpus] : -1;
+		t->items = 0;
+		t->sum = 0;
+		t->ret = pthread_create(&t->pthread, NULL, lfqueue_thread, t);
+		if (t->ret)
+			break;
+		started++;
+	}
+	if (started < producers + consumers) {
+		/* Not enough threads, unwind what was started */
+		pr_dbg(stderr, "%s: could only start %" PRIu32 " threads\n",
+			name, started);
+		lfq.run = false;
+		lfq.producing = 0;
+		lfq.go = true;
+		for (i = 0; i < started; i++)
+			(void)pthread_join(threads[i].pthread, NULL);
+		return 0;
+	}
+	while (__atomic_load_n(&lfq.started, __ATOMIC_ACQUIRE) < started)
+		(void)sched_yield();
+
+	ctr_ok = lfqueue_misses_read(ctr_fd, &misses_start);
+	t_start = time_now();
+	t_end = t_start + LFQUEUE_PHASE_TIME;
+	__atomic_store_n(&lfq.go, true, __ATOMIC_RELEASE);
+
+	while (opt_do_run && (time_now() < t_end)) {
+		uint64_t total = base;
+
+		(void)usleep(10000);
+		for (i = producers; i < started; i++)
+			total += __atomic_load_n(&threads[i].items, __ATOMIC_RELAXED);
+		*counter = total;
+		if (max_ops && (total >= max_ops))
+			break;
+	}
+	__atomic_store_n(&lfq.run, false, __ATOMIC_RELEASE);
+	for (i = 0; i < started; i++)
+		(void)pthread_join(threads[i].pthread, NULL);
+	*duration = time_now() - t_start;
+	ctr_ok &= lfqueue_misses_read(ctr_fd, &misses_end);
+
+	for (i = 0; i < started; i++) {
+		if (threads[i].producer) {
+			produced += threads[i].items;
+			sum_in += threads[i].sum;
+		} else {
+			consumed += threads[i].items;
+			sum_out += threads[i].sum;
+		}
+	}
+	*counter = base + consumed;
+	*misses = ctr_ok ? misses_end - misses_start : ~0ULL;
+
+	if ((opt_flags & OPT_FLAGS_VERIFY) &&
+	    ((produced != consumed) || (sum_in != sum_out)))
+		pr_fail(stderr, "%s: %s queue lost or corrupted items, "
+			"%" PRIu64 " produced, %" PRIu64 " consumed\n",
+			name, lfqueue_types[type].name, produced, consumed);
+	return consumed;
+}
+
+/*
+ *  stress_lfqueue()
+ *	move items through lock-free queues between producer
+ *	and consumer threads, reports items per second and
+ *	cache misses per item of each queue type
+ */
+int stress_lfqueue(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	lfqueue_thread_t *threads;
+	uint64_t items[LFQUEUE_MAX], misses[LFQUEUE_MAX];
+	double durations[LFQUEUE_MAX];
+	bool misses_ok[LFQUEUE_MAX];
+	bool reported = false;
+	int type, ctr_fd;
+	size_t idx = 0;
+
+	threads = calloc((size_t)opt_lfqueue_producers + opt_lfqueue_consumers,
+		sizeof(*threads));
+	if (!threads) {
+		pr_err(stderr, "%s: cannot allocate threads\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	memset(items, 0, sizeof(items));
+	memset(misses, 0, sizeof(misses));
+	memset(durations, 0, sizeof(durations));
+	for (type = 0; type < LFQUEUE_MAX; type++)
+		misses_ok[type] = true;
+
+	ctr_fd = lfqueue_misses_open();
+	if (ctr_fd < 0)
+		pr_dbg(stderr, "%s: cannot open cache miss perf counter, "
+			"cache misses will not be reported\n", name);
+
+	do {
+		for (type = 0; type < LFQUEUE_MAX; type++) {
+			uint64_t phase_misses = ~0ULL;
+			double duration = 0.0;
+
+			if ((opt_lfqueue_type != LFQUEUE_ALL) &&
+			    (opt_lfqueue_type != type))
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			items[type] += lfqueue_phase(name, type, threads, ctr_fd,
+				counter, max_ops, &duration, &phase_misses);
+			durations[type] += duration;
+			if (phase_misses == ~0ULL)
+				misses_ok[type] = false;
+			else
+				misses[type] += phase_misses;
+		}
+		if ((instance == 0) && !reported &&
+		    (opt_lfqueue_type == LFQUEUE_ALL)) {
+			pr_inf(stderr, "%s: %5s %14s %16s\n", name,
+				"queue", "items/s", "cache misses/item");
+			for (type = 0; type < LFQUEUE_MAX; type++) {
+				const double rate = (durations[type] > 0.0) ?
+					(double)items[type] / durations[type] : 0.0;
+
+				if (misses_ok[type] && items[type])
+					pr_inf(stderr, "%s: %5s %14.1f %16.3f\n", name,
+						lfqueue_types[type].name, rate,
+						(double)misses[type] / (double)items[type]);
+				else
+					pr_inf(stderr, "%s: %5s %14.1f %16s\n", name,
+						lfqueue_types[type].name, rate, "n/a");
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (type = 0; type < LFQUEUE_MAX; type++) {
+		char desc[40];
+
+		if (durations[type] <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s items per sec",
+			lfqueue_types[type].name);
+		stress_misc_metric_set(idx++, desc,
+			(double)items[type] / durations[type]);
+		if (misses_ok[type] && items[type]) {
+			(void)snprintf(desc, sizeof(desc), "%s cache misses per item",
+				lfqueue_types[type].name);
+			stress_misc_metric_set(idx++, desc,
+				(double)misses[type] / (double)items[type]);
+		}
+	}
+	if (ctr_fd > -1)
+		(void)close(ctr_fd);
+	free(threads);
+
+	return EXIT_SUCCESS;
+}
+#endif
@@ -33,12 +33,23 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <sched.h>
 #include <inttypes.h>
 #include <sys/mman.h>
+#include <sys/wait.h>
 
 #define BUFFER_SIZE	(1024 * 1024 * 16)
 #define CHUNK_SIZE	(64 * 4)
 
+#define LOCKBUS_TIMED_OPS	(4096)		/* locked ops per timed sample */
+#define LOCKBUS_SAMPLE_LOOPS	(1024)		/* loops between timed samples */
+#define LOCKBUS_SAMPLE_NS	(10000000)	/* max time of a timed sample */
+#define LOCKBUS_THROTTLED_NS	(100000)	/* split lock this slow is throttled */
+#define LOCKBUS_PHASE		(1.0)		/* secs per victim phase */
+#define LOCKBUS_VICTIM_SIZE	(4 * MB)	/* victim streams over this */
+
 #if defined(__GNUC__) && NEED_GNUC(4,7,0)
 #define LOCK_AND_INC(ptr, inc)					       \
 	__atomic_add_fetch(ptr, inc, __ATOMIC_SEQ_CST);		       \
@@ -61,9 +72,170 @@
 	LOCK_AND_INC(ptr, inc)		\
 	LOCK_AND_INC(ptr, inc)
 
+/* the kinds of locked op timed, splits are x86 only */
+typedef enum {
+	LOCKBUS_ALIGNED = 0,		/* within one cache line */
+	LOCKBUS_CROSS_LINE,		/* straddles two cache lines */
+	LOCKBUS_CROSS_PAGE,		/* straddles two pages */
+	LOCKBUS_KINDS
+} lockbus_kind_t;
+
+static const char *lockbus_kinds[LOCKBUS_KINDS] = {
+	"aligned",
+	"cross-line",
+	"cross-page",
+};
+
+/* victim throughput, counted by the victim, timed by the stressor */
+typedef struct {
+	volatile int phase;		/* 0 = aligned locks, 1 = split locks */
+	volatile uint64_t ops[2];	/* victim passes in each phase */
+} lockbus_victim_t;
+
+static bool opt_lockbus_victim = false;
+
+static sigjmp_buf jmp_env;
+static volatile bool split_ok;
+
+void stress_set_lockbus_victim(void)
+{
+	opt_lockbus_victim = true;
+}
+
+/*
+ *  stress_lockbus_sigbus()
+ *	split lock detection is fatal, the kernel sent SIGBUS
+ */
+static void MLOCKED stress_lockbus_sigbus(int dummy)
+{
+	(void)dummy;
+
+	split_ok = false;
+	siglongjmp(jmp_env, 1);
+}
+
+/*
+ *  lock_inc()
+ *	locked increment of a possibly misaligned 32 bit value
+ */
+static inline void lock_inc(uint8_t *ptr)
+{
+#if defined(STRESS_X86)
+	asm volatile("lock addl %1,%0" : "+m" (*(uint32_t *)ptr) : "ir" (1));
+#else
+	__atomic_add_fetch((uint32_t *)ptr, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+/*
+ *  lockbus_addr()
+ *	address in buffer of a locked op of the given kind
+ */
+static uint8_t *lockbus_addr(uint8_t *buffer, const lockbus_kind_t kind)
+{
+	const size_t page_size = stress_get_pagesize();
+	const size_t page = (mwc32() % ((BUFFER_SIZE / page_size) - 1)) * page_size;
+
+	switch (kind) {
+	case LOCKBUS_CROSS_LINE:
+		/* not across a page, that is the next kind */
+		return buffer + page + ((mwc8() % 63) * 64) + 62;
+	case LOCKBUS_CROSS_PAGE:
+		return buffer + page + page_size - 2;
+	default:
+		return buffer + page + ((mwc8() % 64) * 4);
+	}
+}
+
+/*
+ *  lockbus_time()
+ *	ns per locked op of one kind, in doubling runs of ops until
+ *	LOCKBUS_TIMED_OPS or LOCKBUS_SAMPLE_NS so that split locks
+ *	the kernel throttles do not stall the stressor
+ */
+static double lockbus_time(uint8_t *buffer, const lockbus_kind_t kind)
+{
+	uint8_t *ptr = lockbus_addr(buffer, kind);
+	uint64_t t, t0, ops = 0, chunk, i;
+
+	t0 = time_ticks();
+	for (chunk = 1; ops < LOCKBUS_TIMED_OPS; chunk *= 2) {
+		for (i = 0; i < chunk; i++)
+			lock_inc(ptr);
+		ops += chunk;
+		t = time_ticks_to_ns(time_ticks() - t0);
+		if (t > LOCKBUS_SAMPLE_NS)
+			break;
+	}
+	return (double)t / ops;
+}
+
+/*
+ *  lockbus_split_detect()
+ *	report the kernel split lock detection mode, from the
+ *	boot command line or the CPU flags, and if throttling is on
+ */
+static void lockbus_split_detect(const char *name)
+{
+	char buf[4096], *ptr;
+	const char *mode = "off";
+	char mitigate[16] = "n/a";
+
+	(void)memset(buf, 0, sizeof(buf));
+	if (system_read("/proc/cpuinfo", buf, sizeof(buf) - 1) > 0 &&
+	    (strstr(buf, " split_lock_detect") || strstr(buf, " bus_lock_detect")))
+		mode = "warn";
+	(void)memset(buf, 0, sizeof(buf));
+	if (system_read("/proc/cmdline", buf, sizeof(buf) - 1) > 0 &&
+	    (ptr = strstr(buf, "split_lock_detect=")) != NULL) {
+		mode = ptr + 18;
+		ptr[18 + strcspn(mode, " \n")] = '\0';
+	}
+	if (system_read("/proc/sys/kernel/split_lock_mitigate",
+	    mitigate, sizeof(mitigate) - 1) > 0)
+		mitigate[strcspn(mitigate, "\n")] = '\0';
+
+	pr_inf(stderr, "%s: split lock detection: %s, "
+		"split_lock_mitigate: %s\n", name, mode, mitigate);
+}
+
+/*
+ *  lockbus_victim()
+ *	stream over a buffer on another CPU, counting passes in
+ *	each phase of the stressor, until killed
+ */
+static void lockbus_victim(lockbus_victim_t *victim, const int cpu)
+{
+	const size_t n = LOCKBUS_VICTIM_SIZE / sizeof(uint64_t);
+	uint64_t *buf;
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+
+	buf = calloc(n, sizeof(*buf));
+	if (!buf)
+		_exit(EXIT_NO_RESOURCE);
+
+	for (;;) {
+		register size_t i;
+		register uint64_t sum = 0;
+
+		for (i = 0; i < n; i += 8)
+			sum += buf[i]++;
+		uint64_put(sum);
+		victim->ops[victim->phase]++;
+	}
+}
+
 /*
  *  stress_lockbus()
- *      stress memory with lock and increment
+ *      stress memory with lock and increment, timing aligned,
+ *      cross-line and cross-page locked ops as it goes. With
+ *      --lockbus-victim the stressor alternates between aligned
+ *      and split locks while a victim on another CPU measures
+ *      the slowdown the split locks cause it.
  */
 int stress_lockbus(
         uint64_t *const counter,
@@ -73,8 +245,21 @@ int stress_lockbus(
 {
 	uint32_t *buffer;
 	int flags = MAP_ANONYMOUS | MAP_SHARED;
+	static double nsec[LOCKBUS_KINDS];
+	static uint64_t samples[LOCKBUS_KINDS];
+	static double phase_time[2], phase_start;
+	static lockbus_victim_t *victim;
+	static pid_t pid = -1;
+	static uint64_t loops;
+	size_t i;
 
-	(void)instance;
+#if defined(STRESS_X86)
+	split_ok = true;
+#else
+	split_ok = false;
+#endif
+	if (instance == 0)
+		lockbus_split_detect(name);
 
 #if defined(MAP_POPULATE)
 	flags |= MAP_POPULATE;
@@ -86,22 +271,122 @@ int stress_lockbus(
 		return rc;
 	}
 
+	if (opt_lockbus_victim && split_ok) {
+		const int32_t cpus = stress_get_processors_online();
+		const int cpu = sched_getcpu();
+
+		victim = mmap(NULL, sizeof(*victim), PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+		if (victim == MAP_FAILED) {
+			pr_inf(stderr, "%s: cannot mmap victim counters, "
+				"skipping the victim\n", name);
+			victim = NULL;
+		} else {
+			if (cpus < 2)
+				pr_inf(stderr, "%s: only one CPU, the victim "
+					"shares it with the stressor\n", name);
+			pid = fork();
+			if (pid == 0)
+				lockbus_victim(victim, (cpus > 1 && cpu >= 0) ?
+					(cpu + 1) % cpus : 0);
+			if (pid < 0) {
+				pr_fail_dbg(name, "fork");
+				(void)munmap(victim, sizeof(*victim));
+				victim = NULL;
+			}
+		}
+		phase_start = time_now();
+	}
+
+	if (stress_sighandler(name, SIGBUS, stress_lockbus_sigbus, NULL) < 0) {
+		(void)munmap(buffer, BUFFER_SIZE);
+		return EXIT_FAILURE;
+	}
+	if (sigsetjmp(jmp_env, 1)) {
+		pr_inf(stderr, "%s: split lock detection is fatal (SIGBUS), "
+			"only timing aligned locked ops\n", name);
+		if (victim)
+			victim->phase = 0;
+	}
+
 	do {
 		uint32_t *ptr = buffer + ((mwc32() % (BUFFER_SIZE - CHUNK_SIZE)) >> 2);
 		const uint32_t inc = 1;
 
-		LOCK_AND_INCx8(ptr, inc);
-		LOCK_AND_INCx8(ptr, inc);
-		LOCK_AND_INCx8(ptr, inc);
-		LOCK_AND_INCx8(ptr, inc);
-		LOCK_AND_INCx8(ptr, inc);
-		LOCK_AND_INCx8(ptr, inc);
-		LOCK_AND_INCx8(ptr, inc);
-		LOCK_AND_INCx8(ptr, inc);
+		if (victim && victim->phase) {
+			/* Split lock phase, as many locked ops as usual */
+			for (i = 0; opt_do_run && (i < 64); i++)
+				lock_inc(lockbus_addr((uint8_t *)buffer,
+					LOCKBUS_CROSS_LINE));
+		} else {
+			LOCK_AND_INCx8(ptr, inc);
+			LOCK_AND_INCx8(ptr, inc);
+			LOCK_AND_INCx8(ptr, inc);
+			LOCK_AND_INCx8(ptr, inc);
+			LOCK_AND_INCx8(ptr, inc);
+			LOCK_AND_INCx8(ptr, inc);
+			LOCK_AND_INCx8(ptr, inc);
+			LOCK_AND_INCx8(ptr, inc);
+		}
+
+		if ((++loops % LOCKBUS_SAMPLE_LOOPS) == 0) {
+			for (i = 0; i < LOCKBUS_KINDS; i++) {
+				if ((i != LOCKBUS_ALIGNED) && !split_ok)
+					break;
+				nsec[i] += lockbus_time((uint8_t *)buffer, i);
+				samples[i]++;
+			}
+		}
+		if (victim) {
+			const double now = time_now();
+
+			if (now - phase_start >= LOCKBUS_PHASE) {
+				phase_time[victim->phase] += now - phase_start;
+				phase_start = now;
+				victim->phase = split_ok ? !victim->phase : 0;
+			}
+		}
 
 		(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
+	for (i = 0; i < LOCKBUS_KINDS; i++) {
+		char desc[32];
+
+		if (!samples[i])
+			continue;
+		(void)snprintf(desc, sizeof(desc), "ns per %s lock op",
+			lockbus_kinds[i]);
+		stress_misc_metric_set(i, desc, nsec[i] / samples[i]);
+		if ((i != LOCKBUS_ALIGNED) &&
+		    (nsec[i] / samples[i] > LOCKBUS_THROTTLED_NS))
+			pr_inf(stderr, "%s: %s split locks take %.2f ms, the "
+				"kernel is throttling them\n", name,
+				lockbus_kinds[i],
+				nsec[i] / (samples[i] * 1000000.0));
+	}
+
+	if (victim) {
+		int status;
+
+		(void)kill(pid, SIGKILL);
+		(void)waitpid(pid, &status, 0);
+
+		if ((phase_time[0] > 0.0) && (phase_time[1] > 0.0) &&
+		    victim->ops[0]) {
+			const double aligned = victim->ops[0] / phase_time[0];
+			const double split = victim->ops[1] / phase_time[1];
+
+			stress_misc_metric_set(LOCKBUS_KINDS,
+				"victim slowdown %",
+				100.0 * (1.0 - (split / aligned)));
+		} else {
+			pr_inf(stderr, "%s: run too short to measure the "
+				"victim slowdown, need at least %.0f seconds\n",
+				name, 2.0 * LOCKBUS_PHASE);
+		}
+		(void)munmap(victim, sizeof(*victim));
+	}
 	(void)munmap(buffer, BUFFER_SIZE);
 
 	return EXIT_SUCCESS;
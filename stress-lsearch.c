@@ -70,13 +70,13 @@ int stress_lsearch(
 
 	(void)instance;
 
+	max = (size_t)opt_lsearch_size;
 	if (!set_lsearch_size) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
-			opt_lsearch_size = MAX_LSEARCH_SIZE;
+			max = MAX_LSEARCH_SIZE;
 		if (opt_flags & OPT_FLAGS_MINIMIZE)
-			opt_lsearch_size = MIN_LSEARCH_SIZE;
+			max = MIN_LSEARCH_SIZE;
 	}
-	max = (size_t)opt_lsearch_size;
 
 	if ((data = calloc(max, sizeof(int32_t))) == NULL) {
 		pr_fail_dbg(name, "malloc");
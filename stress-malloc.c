@@ -37,10 +37,33 @@
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
 #if defined(STRESS_MALLOPT)
 #include <malloc.h>
 #endif
 
+#define MALLOC_DIST_UNIFORM	(0)	/* 1..malloc-bytes */
+#define MALLOC_DIST_SMALL	(1)	/* small object size classes */
+#define MALLOC_DIST_MIXED	(2)	/* objects, buffers and a few large blocks */
+#define MALLOC_DIST_BIMODAL	(3)	/* tiny objects mixed with large blocks */
+
+#define MALLOC_INBOX_SIZE	(1024)	/* cross thread frees in flight */
+#define MALLOC_SAMPLE_TIME	(0.1)	/* seconds between RSS samples */
+
+typedef struct {
+	const char *name;	/* distribution name */
+	int dist;		/* MALLOC_DIST_ value */
+} malloc_dist_t;
+
+static const malloc_dist_t malloc_dists[] = {
+	{ "uniform",	MALLOC_DIST_UNIFORM },
+	{ "small",	MALLOC_DIST_SMALL },
+	{ "mixed",	MALLOC_DIST_MIXED },
+	{ "bimodal",	MALLOC_DIST_BIMODAL },
+};
+
 static size_t opt_malloc_bytes = DEFAULT_MALLOC_BYTES;
 static bool set_malloc_bytes = false;
 
@@ -52,6 +75,13 @@ static int opt_malloc_threshold = DEFAULT_MALLOC_THRESHOLD;
 static bool set_malloc_threshold = false;
 #endif
 
+static int opt_malloc_dist = MALLOC_DIST_UNIFORM;
+
+#if defined(HAVE_LIB_PTHREAD)
+static uint32_t opt_malloc_pthreads = DEFAULT_MALLOC_PTHREADS;
+static uint32_t opt_malloc_xfree = DEFAULT_MALLOC_XFREE;
+#endif
+
 void stress_set_malloc_bytes(const char *optarg)
 {
 	set_malloc_bytes = true;
@@ -68,6 +98,43 @@ void stress_set_malloc_max(const char *optarg)
 		MIN_MALLOC_MAX, MAX_MALLOC_MAX);
 }
 
+/*
+ *  stress_set_malloc_dist()
+ *	set the allocation size distribution
+ */
+int stress_set_malloc_dist(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(malloc_dists); i++) {
+		if (!strcmp(name, malloc_dists[i].name)) {
+			opt_malloc_dist = malloc_dists[i].dist;
+			return 0;
+		}
+	}
+	fprintf(stderr, "malloc-dist must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(malloc_dists); i++)
+		fprintf(stderr, " %s", malloc_dists[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+void stress_set_malloc_pthreads(const char *optarg)
+{
+	opt_malloc_pthreads = (uint32_t)get_uint64(optarg);
+	check_range("malloc-pthreads", opt_malloc_pthreads,
+		MIN_MALLOC_PTHREADS, MAX_MALLOC_PTHREADS);
+}
+
+void stress_set_malloc_xfree(const char *optarg)
+{
+	opt_malloc_xfree = (uint32_t)get_uint64(optarg);
+	check_range("malloc-xfree", opt_malloc_xfree,
+		MIN_MALLOC_XFREE, MAX_MALLOC_XFREE);
+}
+#endif
+
 #if defined(STRESS_MALLOPT)
 void stress_set_malloc_threshold(const char *optarg)
 {
@@ -78,18 +145,361 @@ void stress_set_malloc_threshold(const char *optarg)
 }
 #endif
 
+/*
+ *  stress_alloc_class_size()
+ *	pick a power of two size class from 2^lo to 2^hi,
+ *	each class half as likely as the one below it, and
+ *	a random size within that class
+ */
+static inline size_t stress_alloc_class_size(
+	const unsigned int lo,
+	const unsigned int hi)
+{
+	uint32_t rnd = mwc32();
+	unsigned int shift = lo;
+
+	while ((shift < hi) && (rnd & 1)) {
+		shift++;
+		rnd >>= 1;
+	}
+	return ((size_t)1 << shift) + (mwc32() % ((size_t)1 << shift));
+}
+
+/*
+ *  stress_alloc_range_size()
+ *	pick a size from lo to hi bytes, uniformly
+ */
+static inline size_t stress_alloc_range_size(
+	const size_t lo,
+	const size_t hi)
+{
+	return (hi > lo) ? lo + (size_t)(mwc64() % (hi - lo)) : hi;
+}
+
 /*
  *  stress_alloc_size()
- *	get a new allocation size, ensuring
- *	it is never zero bytes.
+ *	get a new allocation size from the selected
+ *	distribution, ensuring it is never zero bytes
+ *	and never more than --malloc-bytes.
  */
 static inline size_t stress_alloc_size(void)
 {
-	size_t len = mwc64() % opt_malloc_bytes;
+	size_t len;
+	uint32_t pct;
 
+	switch (opt_malloc_dist) {
+	case MALLOC_DIST_SMALL:
+		/* 8..511 bytes, mostly at the small end */
+		len = stress_alloc_class_size(3, 8);
+		break;
+	case MALLOC_DIST_MIXED:
+		/* 85% objects, 12% buffers up to 16K, 3% large blocks */
+		pct = mwc32() % 100;
+		if (pct < 85)
+			len = stress_alloc_class_size(4, 8);
+		else if (pct < 97)
+			len = stress_alloc_class_size(9, 13);
+		else
+			len = stress_alloc_range_size(16 * KB, opt_malloc_bytes);
+		break;
+	case MALLOC_DIST_BIMODAL:
+		/* 90% 16..128 byte objects, 10% 64K or larger blocks */
+		if ((mwc32() % 10) != 0)
+			len = stress_alloc_range_size(16, 128);
+		else
+			len = stress_alloc_range_size(64 * KB, opt_malloc_bytes);
+		break;
+	default:
+		len = mwc64() % opt_malloc_bytes;
+		break;
+	}
+	if (len > opt_malloc_bytes)
+		len = opt_malloc_bytes;
 	return len ? len : 1;
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+/* an allocation in flight to be freed by another thread */
+typedef struct {
+	void *ptr;		/* allocation */
+	size_t len;		/* requested size */
+} malloc_block_t;
+
+/* per thread state */
+typedef struct {
+	pthread_t pthread;	/* thread handle */
+	int ret;		/* pthread_create return */
+	pthread_mutex_t lock;	/* protects the inbox */
+	malloc_block_t inbox[MALLOC_INBOX_SIZE];	/* blocks to free */
+	size_t inbox_count;	/* blocks in the inbox */
+	malloc_block_t *slots;	/* live allocations owned by this thread */
+	size_t nslots;		/* number of slots */
+	volatile uint64_t ops;	/* successful malloc, realloc and free calls */
+	volatile uint64_t xfrees;	/* blocks freed by this thread for another */
+	volatile int64_t live;	/* requested bytes alive in the slots */
+} malloc_thread_t;
+
+static malloc_thread_t *malloc_threads;
+static volatile bool malloc_threads_stop;
+
+/*
+ *  stress_malloc_rss()
+ *	current resident set size in bytes, 0 if unknown
+ */
+static uint64_t stress_malloc_rss(void)
+{
+	FILE *fp;
+	unsigned long size, resident;
+	uint64_t rss = 0;
+
+	fp = fopen("/proc/self/statm", "r");
+	if (!fp)
+		return 0;
+	if (fscanf(fp, "%lu %lu", &size, &resident) == 2)
+		rss = (uint64_t)resident * stress_get_pagesize();
+	(void)fclose(fp);
+
+	return rss;
+}
+
+/*
+ *  stress_malloc_inbox_drain()
+ *	free the blocks other threads handed to this thread
+ */
+static void stress_malloc_inbox_drain(malloc_thread_t *self)
+{
+	malloc_block_t blocks[MALLOC_INBOX_SIZE];
+	size_t i, n;
+
+	(void)pthread_mutex_lock(&self->lock);
+	n = self->inbox_count;
+	(void)memcpy(blocks, self->inbox, n * sizeof(*blocks));
+	self->inbox_count = 0;
+	(void)pthread_mutex_unlock(&self->lock);
+
+	for (i = 0; i < n; i++) {
+		free(blocks[i].ptr);
+		self->ops++;
+		self->xfrees++;
+	}
+}
+
+/*
+ *  stress_malloc_inbox_post()
+ *	hand a block to another thread to free,
+ *	returns false if its inbox is full
+ */
+static bool stress_malloc_inbox_post(
+	malloc_thread_t *peer,
+	const malloc_block_t *block)
+{
+	bool posted = false;
+
+	(void)pthread_mutex_lock(&peer->lock);
+	if (peer->inbox_count < MALLOC_INBOX_SIZE) {
+		peer->inbox[peer->inbox_count++] = *block;
+		posted = true;
+	}
+	(void)pthread_mutex_unlock(&peer->lock);
+
+	return posted;
+}
+
+/*
+ *  stress_malloc_thread()
+ *	allocate into this thread's slots, freeing some
+ *	locally and handing the rest to the next thread
+ */
+static void *stress_malloc_thread(void *arg)
+{
+	static void *nowt = NULL;
+	malloc_thread_t *self = (malloc_thread_t *)arg;
+	const size_t id = (size_t)(self - malloc_threads);
+	malloc_thread_t *peer = &malloc_threads[(id + 1) % opt_malloc_pthreads];
+
+	while (!malloc_threads_stop) {
+		const uint32_t rnd = mwc32();
+		malloc_block_t *slot = &self->slots[rnd % self->nslots];
+
+		if ((rnd & 0xff) == 0)
+			stress_malloc_inbox_drain(self);
+
+		if (slot->ptr) {
+			if (((rnd >> 12) & 1) == 0) {
+				void *tmp;
+				size_t len = stress_alloc_size();
+
+				tmp = realloc(slot->ptr, len);
+				if (tmp) {
+					self->live += (int64_t)len - (int64_t)slot->len;
+					slot->ptr = tmp;
+					slot->len = len;
+					(void)mincore_touch_pages(tmp, len);
+					self->ops++;
+				}
+				continue;
+			}
+			if ((peer != self) &&
+			    ((mwc32() % 100) < opt_malloc_xfree) &&
+			    stress_malloc_inbox_post(peer, slot)) {
+				/* no longer live once handed over */
+				self->live -= (int64_t)slot->len;
+			} else {
+				free(slot->ptr);
+				self->live -= (int64_t)slot->len;
+				self->ops++;
+			}
+			slot->ptr = NULL;
+		} else if ((rnd >> 12) & 1) {
+			size_t len = stress_alloc_size();
+
+			if (((rnd >> 14) & 0x1f) == 0) {
+				size_t n = ((rnd >> 19) % 17) + 1;
+
+				slot->ptr = calloc(n, len / n);
+				len = n * (len / n);
+			} else {
+				slot->ptr = malloc(len);
+			}
+			if (slot->ptr) {
+				slot->len = len;
+				self->live += (int64_t)len;
+				(void)mincore_touch_pages(slot->ptr, len);
+				self->ops++;
+			}
+		}
+	}
+	stress_malloc_inbox_drain(self);
+
+	return &nowt;
+}
+
+/*
+ *  stress_malloc_pthreads()
+ *	allocate and free from opt_malloc_pthreads threads with
+ *	cross thread frees, sampling RSS against the live bytes
+ *	to report the allocator throughput and fragmentation
+ */
+static void stress_malloc_pthreads(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t nslots = opt_malloc_max / opt_malloc_pthreads;
+	uint64_t rss_base, rss_peak = 0, ops = 0, xfrees = 0;
+	double t_start, t, frag_sum = 0.0;
+	uint64_t frag_samples = 0;
+	uint32_t i, started = 0;
+
+	malloc_threads = calloc(opt_malloc_pthreads, sizeof(*malloc_threads));
+	if (!malloc_threads) {
+		pr_inf(stderr, "%s: cannot allocate thread state\n", name);
+		return;
+	}
+	for (i = 0; i < opt_malloc_pthreads; i++) {
+		malloc_thread_t *thread = &malloc_threads[i];
+
+		(void)pthread_mutex_init(&thread->lock, NULL);
+		thread->nslots = nslots ? nslots : 1;
+		thread->slots = calloc(thread->nslots, sizeof(*thread->slots));
+		if (!thread->slots) {
+			pr_inf(stderr, "%s: cannot allocate slots\n", name);
+			goto free_slots;
+		}
+	}
+
+	rss_base = stress_malloc_rss();
+	malloc_threads_stop = false;
+	for (i = 0; i < opt_malloc_pthreads; i++) {
+		malloc_threads[i].ret = pthread_create(&malloc_threads[i].pthread,
+			NULL, stress_malloc_thread, &malloc_threads[i]);
+		if (malloc_threads[i].ret == 0)
+			started++;
+	}
+	if (!started) {
+		pr_fail_err(name, "pthread_create");
+		goto free_slots;
+	}
+
+	t_start = time_now();
+	do {
+		uint64_t rss;
+		int64_t live = 0;
+
+		(void)usleep((useconds_t)(MALLOC_SAMPLE_TIME * 1000000.0));
+		ops = 0;
+		for (i = 0; i < opt_malloc_pthreads; i++) {
+			ops += malloc_threads[i].ops;
+			live += malloc_threads[i].live;
+		}
+		*counter = ops;
+
+		rss = stress_malloc_rss();
+		if (rss > rss_base) {
+			rss -= rss_base;
+			if (rss > rss_peak)
+				rss_peak = rss;
+			if (live > 0) {
+				frag_sum += (double)rss / (double)live;
+				frag_samples++;
+			}
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+	t = time_now() - t_start;
+
+	malloc_threads_stop = true;
+	for (i = 0; i < opt_malloc_pthreads; i++) {
+		if (malloc_threads[i].ret == 0)
+			(void)pthread_join(malloc_threads[i].pthread, NULL);
+	}
+	/* Blocks posted after a peer's final drain */
+	for (i = 0; i < opt_malloc_pthreads; i++)
+		stress_malloc_inbox_drain(&malloc_threads[i]);
+	ops = 0;
+	for (i = 0; i < opt_malloc_pthreads; i++) {
+		ops += malloc_threads[i].ops;
+		xfrees += malloc_threads[i].xfrees;
+	}
+	*counter = ops;
+
+	if (instance == 0) {
+		const char *preload = getenv("LD_PRELOAD");
+
+		pr_inf(stderr, "%s: allocator %s, %" PRIu32 " threads, "
+			"%.0f ops/sec, %.1f%% cross thread frees, peak RSS "
+			"growth %.1f MB, fragmentation ratio %.2f\n",
+			name, (preload && *preload) ? preload : "libc",
+			started, t > 0.0 ? (double)ops / t : 0.0,
+			ops ? 100.0 * (double)xfrees / (double)ops : 0.0,
+			(double)rss_peak / (double)MB,
+			frag_samples ? frag_sum / (double)frag_samples : 0.0);
+	}
+	stress_misc_metric_set(0, "malloc ops per sec",
+		t > 0.0 ? (double)ops / t : 0.0);
+	stress_misc_metric_set(1, "cross thread frees per sec",
+		t > 0.0 ? (double)xfrees / t : 0.0);
+	stress_misc_metric_set(2, "peak RSS growth (MB)",
+		(double)rss_peak / (double)MB);
+	stress_misc_metric_set(3, "fragmentation ratio",
+		frag_samples ? frag_sum / (double)frag_samples : 0.0);
+
+free_slots:
+	for (i = 0; i < opt_malloc_pthreads; i++) {
+		malloc_thread_t *thread = &malloc_threads[i];
+		size_t j;
+
+		if (thread->slots) {
+			for (j = 0; j < thread->nslots; j++)
+				free(thread->slots[j].ptr);
+			free(thread->slots);
+		}
+		(void)pthread_mutex_destroy(&thread->lock);
+	}
+	free(malloc_threads);
+}
+#endif
+
 /*
  *  stress_malloc()
  *	stress malloc by performing a mix of
@@ -138,6 +548,11 @@ again:
 
 		/* Parent, wait for child */
 		ret = waitpid(pid, &status, 0);
+		if ((ret < 0) && (errno == EINTR)) {
+			/* Pass the stop on to the child and let it report */
+			(void)kill(pid, SIGALRM);
+			ret = waitpid(pid, &status, 0);
+		}
 		if (ret < 0) {
 			if (errno != EINTR)
 				pr_dbg(stderr, "%s: waitpid(): errno=%d (%s)\n",
@@ -170,6 +585,12 @@ again:
 		/* Make sure this is killable by OOM killer */
 		set_oom_adjustment(name, true);
 
+#if defined(HAVE_LIB_PTHREAD)
+		if (opt_malloc_pthreads) {
+			stress_malloc_pthreads(counter, instance, max_ops, name);
+			goto abort;
+		}
+#endif
 		do {
 			unsigned int rnd = mwc32();
 			unsigned int i = rnd % opt_malloc_max;
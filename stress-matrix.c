@@ -28,9 +28,14 @@
 #include <stdlib.h>
 #include <math.h>
 #include <complex.h>
+#include <signal.h>
 #include <sys/time.h>
 #include "stress-ng.h"
 
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+
 typedef float	matrix_type_t;
 
 /*
@@ -45,12 +50,21 @@ typedef void (*stress_matrix_func)(
 typedef struct {
 	const char		*name;	/* human readable form of stressor */
 	const stress_matrix_func	func;	/* the stressor function */
+	const double		flops_n2; /* flops per op, times n squared */
+	const double		flops_n3; /* flops per op, times n cubed */
 } stress_matrix_stressor_info_t;
 
+#define MATRIX_TILE_MIN		(16)		/* smallest tile size */
+#define MATRIX_L1_SIZE		(32 * KB)	/* L1 size, if unknown */
+#define MATRIX_L2_SIZE		(256 * KB)	/* L2 size, if unknown */
+
 static const stress_matrix_stressor_info_t *opt_matrix_stressor;
 static const stress_matrix_stressor_info_t matrix_methods[];
 static size_t opt_matrix_size = 128;
 static bool set_matrix_size = false;
+static size_t matrix_prod_tile = MATRIX_TILE_MIN;
+static size_t matrix_trans_tile = MATRIX_TILE_MIN;
+static uint32_t opt_matrix_threads = DEFAULT_MATRIX_THREADS;
 
 void stress_set_matrix_size(const char *optarg)
 {
@@ -63,11 +77,21 @@ void stress_set_matrix_size(const char *optarg)
 	opt_matrix_size = (size_t)size;
 }
 
+void stress_set_matrix_threads(const char *optarg)
+{
+	uint64_t threads;
+
+	threads = get_uint64(optarg);
+	check_range("matrix-threads", threads,
+		MIN_MATRIX_THREADS, MAX_MATRIX_THREADS);
+	opt_matrix_threads = (uint32_t)threads;
+}
+
 /*
  *  stress_matrix_prod(void)
  *	matrix product
  */
-static void OPTIMIZE3 stress_matrix_prod(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_prod(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],
@@ -90,11 +114,55 @@ static void OPTIMIZE3 stress_matrix_prod(
 	}
 }
 
+/*
+ *  stress_matrix_prod_blocked(void)
+ *	cache blocked matrix product, works on tiles of
+ *	the matrices that fit in the L2 cache
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_prod_blocked(
+	const size_t n,
+	matrix_type_t a[n][n],
+	matrix_type_t b[n][n],
+	matrix_type_t r[n][n])
+{
+	const size_t t = matrix_prod_tile;
+	size_t ii;
+
+	for (ii = 0; ii < n; ii += t) {
+		const size_t i_end = (ii + t < n) ? ii + t : n;
+		size_t kk;
+
+		for (kk = 0; kk < n; kk += t) {
+			const size_t k_end = (kk + t < n) ? kk + t : n;
+			size_t jj;
+
+			for (jj = 0; jj < n; jj += t) {
+				const size_t j_end = (jj + t < n) ? jj + t : n;
+				register size_t i;
+
+				for (i = ii; i < i_end; i++) {
+					register size_t k;
+
+					for (k = kk; k < k_end; k++) {
+						const matrix_type_t v = a[i][k];
+						register size_t j;
+
+						for (j = jj; j < j_end; j++)
+							r[i][j] += v * b[k][j];
+					}
+				}
+			}
+		}
+		if (!opt_do_run)
+			return;
+	}
+}
+
 /*
  *  stress_matrix_add(void)
  *	matrix addition
  */
-static void OPTIMIZE3 stress_matrix_add(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_add(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],
@@ -117,7 +185,7 @@ static void OPTIMIZE3 stress_matrix_add(
  *  stress_matrix_sub(void)
  *	matrix subtraction
  */
-static void OPTIMIZE3 stress_matrix_sub(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_sub(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],
@@ -140,7 +208,7 @@ static void OPTIMIZE3 stress_matrix_sub(
  *  stress_matrix_trans(void)
  *	matrix transpose
  */
-static void OPTIMIZE3 stress_matrix_trans(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_trans(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],	/* Ignored */
@@ -161,11 +229,47 @@ static void OPTIMIZE3 stress_matrix_trans(
 	}
 }
 
+/*
+ *  stress_matrix_trans_blocked(void)
+ *	cache blocked matrix transpose, works on tiles
+ *	of the matrices that fit in the L1 cache
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_trans_blocked(
+	const size_t n,
+	matrix_type_t a[n][n],
+	matrix_type_t b[n][n],	/* Ignored */
+	matrix_type_t r[n][n])
+{
+	const size_t t = matrix_trans_tile;
+	size_t ii;
+
+	(void)b;
+
+	for (ii = 0; ii < n; ii += t) {
+		const size_t i_end = (ii + t < n) ? ii + t : n;
+		size_t jj;
+
+		for (jj = 0; jj < n; jj += t) {
+			const size_t j_end = (jj + t < n) ? jj + t : n;
+			register size_t i;
+
+			for (i = ii; i < i_end; i++) {
+				register size_t j;
+
+				for (j = jj; j < j_end; j++)
+					r[i][j] = a[j][i];
+			}
+		}
+		if (!opt_do_run)
+			return;
+	}
+}
+
 /*
  *  stress_matrix_mult(void)
  *	matrix scalar multiply
  */
-static void OPTIMIZE3 stress_matrix_mult(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_mult(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],
@@ -191,7 +295,7 @@ static void OPTIMIZE3 stress_matrix_mult(
  *  stress_matrix_div(void)
  *	matrix scalar divide
  */
-static void OPTIMIZE3 stress_matrix_div(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_div(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],
@@ -218,7 +322,7 @@ static void OPTIMIZE3 stress_matrix_div(
  *	matrix hadamard product
  *	(A o B)ij = AijBij
  */
-static void OPTIMIZE3 stress_matrix_hadamard(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_hadamard(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],
@@ -242,7 +346,7 @@ static void OPTIMIZE3 stress_matrix_hadamard(
  *	matrix frobenius product
  *	A : B = Sum(AijBij)
  */
-static void OPTIMIZE3 stress_matrix_frobenius(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_frobenius(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],
@@ -269,7 +373,7 @@ static void OPTIMIZE3 stress_matrix_frobenius(
  *  stress_matrix_copy(void)
  *	naive matrix copy, r = a
  */
-static void OPTIMIZE3 stress_matrix_copy(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_copy(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],
@@ -294,7 +398,7 @@ static void OPTIMIZE3 stress_matrix_copy(
  *  stress_matrix_mean(void)
  *	arithmetic mean
  */
-static void OPTIMIZE3 stress_matrix_mean(
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_mean(
 	const size_t n,
 	matrix_type_t a[n][n],
 	matrix_type_t b[n][n],
@@ -335,19 +439,21 @@ static void OPTIMIZE3 stress_matrix_all(
  * Table of cpu stress methods
  */
 static const stress_matrix_stressor_info_t matrix_methods[] = {
-	{ "all",		stress_matrix_all },	/* Special "all" test */
-
-	{ "add",		stress_matrix_add },
-	{ "copy",		stress_matrix_copy },
-	{ "div",		stress_matrix_div },
-	{ "frobenius",		stress_matrix_frobenius },
-	{ "hadamard",		stress_matrix_hadamard },
-	{ "mean",		stress_matrix_mean },
-	{ "mult",		stress_matrix_mult },
-	{ "prod",		stress_matrix_prod },
-	{ "sub",		stress_matrix_sub },
-	{ "trans",		stress_matrix_trans },
-	{ NULL,			NULL }
+	{ "all",		stress_matrix_all,		0.0, 0.0 },	/* Special "all" test */
+
+	{ "add",		stress_matrix_add,		1.0, 0.0 },
+	{ "copy",		stress_matrix_copy,		0.0, 0.0 },
+	{ "div",		stress_matrix_div,		1.0, 0.0 },
+	{ "frobenius",		stress_matrix_frobenius,	2.0, 0.0 },
+	{ "hadamard",		stress_matrix_hadamard,		1.0, 0.0 },
+	{ "mean",		stress_matrix_mean,		2.0, 0.0 },
+	{ "mult",		stress_matrix_mult,		1.0, 0.0 },
+	{ "prod",		stress_matrix_prod,		0.0, 2.0 },
+	{ "prod-blocked",	stress_matrix_prod_blocked,	0.0, 2.0 },
+	{ "sub",		stress_matrix_sub,		1.0, 0.0 },
+	{ "trans",		stress_matrix_trans,		0.0, 0.0 },
+	{ "trans-blocked",	stress_matrix_trans_blocked,	0.0, 0.0 },
+	{ NULL,			NULL,				0.0, 0.0 }
 };
 
 /*
@@ -374,6 +480,319 @@ int stress_set_matrix_method(const char *name)
 	return -1;
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+
+/*
+ *  Per thread deque of product tiles, the owner takes tiles
+ *  from the tail and idle threads steal from the head
+ */
+typedef struct {
+	pthread_mutex_t lock;
+	uint32_t *tiles;		/* tile numbers */
+	uint32_t head;			/* next tile to steal */
+	uint32_t tail;			/* one past the owner's next tile */
+	uint64_t executed;		/* tiles computed by this thread */
+	uint64_t steals;		/* tiles stolen by this thread */
+} matrix_deque_t;
+
+/* state shared by the threads of a matrix instance */
+typedef struct {
+	size_t n;			/* matrix size */
+	void *a, *b, *r;		/* n x n matrices */
+	size_t tile;			/* tile size */
+	uint32_t tiles_per_row;		/* tiles along each side */
+	bool blocked;			/* true for prod-blocked */
+	uint32_t threads;		/* threads sharing the tiles */
+	matrix_deque_t *deques;		/* one deque per thread */
+	uint32_t ndeques;		/* number of initialised deques */
+	pthread_barrier_t barrier;	/* op start and end */
+	pthread_mutex_t mutex;		/* start up gate lock */
+	pthread_cond_t cond;		/* start up gate */
+	bool go;			/* start up gate open */
+	bool run;			/* false to stop the threads */
+} matrix_threads_t;
+
+typedef struct {
+	matrix_threads_t *ctx;
+	uint32_t id;			/* thread number, 0 is the instance */
+} matrix_thread_t;
+
+/*
+ *  stress_matrix_prod_tile()
+ *	compute one tile of the product r = a * b
+ */
+static void OPTIMIZE3 TARGET_CLONES stress_matrix_prod_tile(
+	const matrix_threads_t *ctx,
+	const uint32_t tile)
+{
+	const size_t n = ctx->n, t = ctx->tile;
+	matrix_type_t (*a)[n] = ctx->a;
+	matrix_type_t (*b)[n] = ctx->b;
+	matrix_type_t (*r)[n] = ctx->r;
+	const size_t ii = (tile / ctx->tiles_per_row) * t;
+	const size_t jj = (tile % ctx->tiles_per_row) * t;
+	const size_t i_end = (ii + t < n) ? ii + t : n;
+	const size_t j_end = (jj + t < n) ? jj + t : n;
+	register size_t i;
+
+	if (!ctx->blocked) {
+		for (i = ii; i < i_end; i++) {
+			register size_t j;
+
+			for (j = jj; j < j_end; j++) {
+				register size_t k;
+
+				for (k = 0; k < n; k++)
+					r[i][j] += a[i][k] * b[k][j];
+			}
+		}
+		return;
+	}
+
+	for (i = ii; i < i_end; i++) {
+		register size_t k;
+
+		for (k = 0; k < n; k++) {
+			const matrix_type_t v = a[i][k];
+			register size_t j;
+
+			for (j = jj; j < j_end; j++)
+				r[i][j] += v * b[k][j];
+		}
+	}
+}
+
+/*
+ *  stress_matrix_tile_get()
+ *	take a tile from the thread's own deque, or steal one
+ *	from another thread, returns false when no tiles are left
+ */
+static bool stress_matrix_tile_get(
+	matrix_threads_t *ctx,
+	const uint32_t id,
+	uint32_t *tile)
+{
+	matrix_deque_t *dq = &ctx->deques[id];
+	uint32_t i;
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->tail > dq->head) {
+		*tile = dq->tiles[--dq->tail];
+		pthread_mutex_unlock(&dq->lock);
+		return true;
+	}
+	pthread_mutex_unlock(&dq->lock);
+
+	for (i = 1; i < ctx->threads; i++) {
+		matrix_deque_t *victim = &ctx->deques[(id + i) % ctx->threads];
+
+		pthread_mutex_lock(&victim->lock);
+		if (victim->tail > victim->head) {
+			*tile = victim->tiles[victim->head++];
+			pthread_mutex_unlock(&victim->lock);
+			dq->steals++;
+			return true;
+		}
+		pthread_mutex_unlock(&victim->lock);
+	}
+	return false;
+}
+
+/*
+ *  stress_matrix_tiles_run()
+ *	compute tiles until there are none left
+ */
+static void stress_matrix_tiles_run(matrix_threads_t *ctx, const uint32_t id)
+{
+	uint32_t tile;
+
+	while (stress_matrix_tile_get(ctx, id, &tile)) {
+		stress_matrix_prod_tile(ctx, tile);
+		ctx->deques[id].executed++;
+	}
+}
+
+/*
+ *  stress_matrix_thread()
+ *	helper thread, computes tiles of each product until told to stop
+ */
+static void *stress_matrix_thread(void *arg)
+{
+	static void *nowt = NULL;
+	matrix_thread_t *thread = (matrix_thread_t *)arg;
+	matrix_threads_t *ctx = thread->ctx;
+	sigset_t set;
+
+	/* Leave all signal handling to the instance thread */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	pthread_mutex_lock(&ctx->mutex);
+	while (!ctx->go)
+		pthread_cond_wait(&ctx->cond, &ctx->mutex);
+	pthread_mutex_unlock(&ctx->mutex);
+
+	for (;;) {
+		(void)pthread_barrier_wait(&ctx->barrier);
+		if (!ctx->run)
+			break;
+		stress_matrix_tiles_run(ctx, thread->id);
+		(void)pthread_barrier_wait(&ctx->barrier);
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_matrix_prod_threaded()
+ *	one matrix product shared by all the threads, the tiles are
+ *	dealt round robin to the thread deques, threads that run out
+ *	steal from the others
+ */
+static void stress_matrix_prod_threaded(
+	matrix_threads_t *ctx,
+	const bool blocked)
+{
+	const uint32_t tiles = ctx->tiles_per_row * ctx->tiles_per_row;
+	uint32_t i;
+
+	ctx->blocked = blocked;
+	for (i = 0; i < ctx->threads; i++)
+		ctx->deques[i].head = ctx->deques[i].tail = 0;
+	for (i = 0; i < tiles; i++) {
+		matrix_deque_t *dq = &ctx->deques[i % ctx->threads];
+
+		dq->tiles[dq->tail++] = i;
+	}
+	(void)pthread_barrier_wait(&ctx->barrier);
+	stress_matrix_tiles_run(ctx, 0);
+	(void)pthread_barrier_wait(&ctx->barrier);
+}
+
+/*
+ *  stress_matrix_threads_start()
+ *	start the helper threads, returns the number of
+ *	threads sharing the work, 1 if none could be started
+ */
+static uint32_t stress_matrix_threads_start(
+	const char *name,
+	matrix_threads_t *ctx,
+	matrix_thread_t *args,
+	pthread_t *pthreads,
+	const uint32_t threads)
+{
+	const uint32_t tiles = ctx->tiles_per_row * ctx->tiles_per_row;
+	uint32_t i, started = 0;
+
+	for (i = 0; i < threads; i++) {
+		ctx->deques[i].tiles = calloc(tiles, sizeof(*ctx->deques[i].tiles));
+		if (!ctx->deques[i].tiles) {
+			pr_inf(stderr, "%s: cannot allocate tile deque, "
+				"using %" PRIu32 " threads\n", name, i ? i : 1);
+			break;
+		}
+		(void)pthread_mutex_init(&ctx->deques[i].lock, NULL);
+	}
+	ctx->ndeques = i;
+	ctx->threads = i ? i : 1;
+
+	(void)pthread_mutex_init(&ctx->mutex, NULL);
+	(void)pthread_cond_init(&ctx->cond, NULL);
+	ctx->go = false;
+	ctx->run = true;
+	for (i = 1; i < ctx->threads; i++) {
+		args[i].ctx = ctx;
+		args[i].id = i;
+		if (pthread_create(&pthreads[i], NULL, stress_matrix_thread, &args[i]))
+			break;
+		started++;
+	}
+	if (started + 1 < ctx->threads)
+		pr_inf(stderr, "%s: only %" PRIu32 " of %" PRIu32
+			" threads started\n", name, started + 1, ctx->threads);
+	ctx->threads = started + 1;
+	(void)pthread_barrier_init(&ctx->barrier, NULL, ctx->threads);
+
+	/* All the threads know how many there are, let them go */
+	pthread_mutex_lock(&ctx->mutex);
+	ctx->go = true;
+	pthread_cond_broadcast(&ctx->cond);
+	pthread_mutex_unlock(&ctx->mutex);
+
+	return ctx->threads;
+}
+
+/*
+ *  stress_matrix_threads_stop()
+ *	stop and reap the helper threads
+ */
+static void stress_matrix_threads_stop(
+	matrix_threads_t *ctx,
+	pthread_t *pthreads)
+{
+	uint32_t i;
+
+	ctx->run = false;
+	(void)pthread_barrier_wait(&ctx->barrier);
+	for (i = 1; i < ctx->threads; i++)
+		(void)pthread_join(pthreads[i], NULL);
+	(void)pthread_barrier_destroy(&ctx->barrier);
+	(void)pthread_cond_destroy(&ctx->cond);
+	(void)pthread_mutex_destroy(&ctx->mutex);
+	for (i = 0; i < ctx->ndeques; i++) {
+		free(ctx->deques[i].tiles);
+		(void)pthread_mutex_destroy(&ctx->deques[i].lock);
+	}
+}
+#endif
+
+/*
+ *  stress_matrix_tile()
+ *	largest multiple of MATRIX_TILE_MIN sized tile where
+ *	tiles of the matrices fit in half of the cache size
+ */
+static size_t stress_matrix_tile(const uint64_t cache_size, const size_t tiles)
+{
+	const double elements = (double)cache_size / 2.0 /
+		(double)(tiles * sizeof(matrix_type_t));
+	size_t t = (size_t)sqrt(elements);
+
+	t -= t % MATRIX_TILE_MIN;
+	return (t < MATRIX_TILE_MIN) ? MATRIX_TILE_MIN : t;
+}
+
+/*
+ *  stress_matrix_tiles()
+ *	set the blocked method tile sizes from the L1 and L2 cache sizes
+ */
+static void stress_matrix_tiles(const char *name, const uint32_t instance)
+{
+	uint64_t l1 = MATRIX_L1_SIZE, l2 = MATRIX_L2_SIZE;
+#if defined(__linux__)
+	cpus_t *cpu_caches;
+
+	cpu_caches = get_all_cpu_cache_details();
+	if (cpu_caches) {
+		cpu_cache_t *cache;
+
+		cache = get_cpu_cache(cpu_caches, 1);
+		if (cache && cache->size)
+			l1 = cache->size;
+		cache = get_cpu_cache(cpu_caches, 2);
+		if (cache && cache->size)
+			l2 = cache->size;
+		free_cpu_caches(cpu_caches);
+	}
+#endif
+	/* product works on 3 tiles, transpose on 2 */
+	matrix_prod_tile = stress_matrix_tile(l2, 3);
+	matrix_trans_tile = stress_matrix_tile(l1, 2);
+
+	if (instance == 0)
+		pr_dbg(stderr, "%s: blocked tile sizes: prod %zu (L2 %" PRIu64
+			"K), trans %zu (L1 %" PRIu64 "K)\n", name,
+			matrix_prod_tile, l2 / 1024, matrix_trans_tile, l1 / 1024);
+}
+
 /*
  *  stress_matrix()
  *	stress CPU by doing floating point math ops
@@ -384,12 +803,29 @@ int stress_matrix(
 	const uint64_t max_ops,
 	const char *name)
 {
-	stress_matrix_func func = opt_matrix_stressor->func;
-	size_t n;
+	const stress_matrix_stressor_info_t *info = opt_matrix_stressor;
+	const bool all = (info->func == stress_matrix_all);
+	size_t n, m, k;
 	const matrix_type_t v = 1 / (matrix_type_t)((uint32_t)~0);
+	double duration[SIZEOF_ARRAY(matrix_methods)];
+	uint64_t ops[SIZEOF_ARRAY(matrix_methods)];
+	uint32_t threads = opt_matrix_threads;
+#if defined(HAVE_LIB_PTHREAD)
+	matrix_threads_t ctx;
+	matrix_thread_t *args = NULL;
+	pthread_t *pthreads = NULL;
+	matrix_deque_t *deques = NULL;
+#else
+	if (threads > 1) {
+		if (!instance)
+			pr_inf(stderr, "%s: no pthread support, using 1 thread\n", name);
+		threads = 1;
+	}
+#endif
 
-	(void)instance;
-	(void)name;
+	stress_matrix_tiles(name, instance);
+	memset(duration, 0, sizeof(duration));
+	memset(ops, 0, sizeof(ops));
 
 	if (!set_matrix_size) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -415,13 +851,106 @@ int stress_matrix(
 			}
 		}
 
+#if defined(HAVE_LIB_PTHREAD)
+		if (threads > 1) {
+			pthreads = calloc(threads, sizeof(*pthreads));
+			args = calloc(threads, sizeof(*args));
+			deques = calloc(threads, sizeof(*deques));
+			if (!pthreads || !args || !deques) {
+				pr_inf(stderr, "%s: cannot allocate thread information, "
+					"using 1 thread\n", name);
+				free(deques);
+				free(args);
+				free(pthreads);
+				threads = 1;
+			}
+		}
+		if (threads > 1) {
+			/* Aim for at least 4 tiles per thread */
+			size_t t = n / (size_t)ceil(sqrt(4.0 * threads));
+
+			t -= t % MATRIX_TILE_MIN;
+			if (t < MATRIX_TILE_MIN)
+				t = MATRIX_TILE_MIN;
+			if (t > matrix_prod_tile)
+				t = matrix_prod_tile;
+
+			memset(&ctx, 0, sizeof(ctx));
+			ctx.n = n;
+			ctx.a = a;
+			ctx.b = b;
+			ctx.r = r;
+			ctx.tile = t;
+			ctx.tiles_per_row = (uint32_t)((n + t - 1) / t);
+			ctx.deques = deques;
+			threads = stress_matrix_threads_start(name, &ctx, args, pthreads, threads);
+		}
+#endif
+
 		/*
-		 * Normal use case, 100% load, simple spinning on CPU
+		 * Normal use case, 100% load, simple spinning on CPU,
+		 * "all" is cycled through here so each method is timed
 		 */
 		do {
-			(void)func(n, a, b, r);
+			double t;
+
+			if (all) {
+				info++;
+				if (!info->func)
+					info = &matrix_methods[1];
+			}
+			t = time_now();
+#if defined(HAVE_LIB_PTHREAD)
+			if ((threads > 1) && (info->func == stress_matrix_prod))
+				stress_matrix_prod_threaded(&ctx, false);
+			else if ((threads > 1) && (info->func == stress_matrix_prod_blocked))
+				stress_matrix_prod_threaded(&ctx, true);
+			else
+#endif
+				(void)info->func(n, a, b, r);
+			m = info - matrix_methods;
+			duration[m] += time_now() - t;
+			ops[m]++;
 			(*counter)++;
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+#if defined(HAVE_LIB_PTHREAD)
+		if (pthreads) {
+			uint64_t executed = 0, steals = 0;
+			uint32_t j;
+
+			stress_matrix_threads_stop(&ctx, pthreads);
+			for (j = 0; (threads > 1) && (j < threads); j++) {
+				pr_inf(stderr, "%s: thread %" PRIu32 ": %" PRIu64
+					" tiles, %" PRIu64 " steals (instance %" PRIu32 ")\n",
+					name, j, deques[j].executed, deques[j].steals, instance);
+				executed += deques[j].executed;
+				steals += deques[j].steals;
+			}
+			if (executed) {
+				stress_misc_metric_set(STRESS_MISC_METRICS_MAX - 1,
+					"tile steal rate (%)",
+					100.0 * (double)steals / (double)executed);
+			}
+			free(deques);
+			free(args);
+			free(pthreads);
+		}
+#endif
+	}
+
+	/* Effective GFLOP/sec of each method that does floating point ops */
+	for (k = 0, m = 1; matrix_methods[m].func; m++) {
+		const double flops = (matrix_methods[m].flops_n2 * (double)n * (double)n) +
+			(matrix_methods[m].flops_n3 * (double)n * (double)n * (double)n);
+		char description[32];
+
+		if ((duration[m] <= 0.0) || (flops <= 0.0))
+			continue;
+		(void)snprintf(description, sizeof(description),
+			"%s GFLOP/sec", matrix_methods[m].name);
+		stress_misc_metric_set(k++, description,
+			(flops * (double)ops[m]) / duration[m] / 1.0E9);
 	}
 
 	return EXIT_SUCCESS;
@@ -31,20 +31,103 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
 #include <unistd.h>
+#include <sched.h>
 #include <pthread.h>
 #include <signal.h>
 
 #define MAX_MEMBARRIER_THREADS	(4)
 
+#define MEMBARRIER_SYNC_PHASE_TIME	(1.0)	/* seconds per mechanism */
+#define MEMBARRIER_SYNC_POISON		(~0ULL)	/* value of a retired slot */
+
+#define MEMBARRIER_SYNC_NONE		(-1)	/* plain membarrier calls */
+#define MEMBARRIER_SYNC_FENCE		(0)	/* reader and writer fences */
+#define MEMBARRIER_SYNC_EXPEDITED	(1)	/* private expedited membarrier */
+#define MEMBARRIER_SYNC_SHARED		(2)	/* shared membarrier */
+#define MEMBARRIER_SYNC_MAX		(3)
+#define MEMBARRIER_SYNC_ALL		(MEMBARRIER_SYNC_MAX)
+
 static volatile bool keep_running;
 static sigset_t set;
 
 enum membarrier_cmd {
 	MEMBARRIER_CMD_QUERY = 0,
 	MEMBARRIER_CMD_SHARED = (1 << 0),
+	MEMBARRIER_CMD_PRIVATE_EXPEDITED = (1 << 3),
+	MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED = (1 << 4),
 };
 
+typedef struct {
+	const char *name;	/* User option */
+	int method;		/* MEMBARRIER_SYNC_ value */
+} membarrier_sync_t;
+
+static const membarrier_sync_t membarrier_syncs[] = {
+	{ "fence",	MEMBARRIER_SYNC_FENCE },
+	{ "expedited",	MEMBARRIER_SYNC_EXPEDITED },
+	{ "shared",	MEMBARRIER_SYNC_SHARED },
+	{ "all",	MEMBARRIER_SYNC_ALL },
+};
+
+/* per reader state, one cache line each */
+typedef struct {
+	uint64_t ctr ALIGN64;	/* grace period snapshot, 0 = quiescent */
+	uint64_t reads;		/* read side critical sections */
+	uint64_t stale;		/* retired slots seen by this reader */
+	pthread_t pthread;
+	int ret;
+} membarrier_reader_t;
+
+/* RCU style state shared between the writer and the readers */
+static struct {
+	uint64_t gp_ctr ALIGN64;	/* current grace period */
+	uint64_t *current;		/* published slot */
+	uint64_t slot[2] ALIGN64;	/* writer alternates between slots */
+	bool go;			/* release readers together */
+	bool stop;			/* end of phase */
+	int method;			/* MEMBARRIER_SYNC_ of the phase */
+} membarrier_rcu;
+
+static int opt_membarrier_sync = MEMBARRIER_SYNC_NONE;
+static uint32_t opt_membarrier_readers = DEFAULT_MEMBARRIER_READERS;
+
+/*
+ *  stress_set_membarrier_sync()
+ *	set the grace period mechanism(s) to compare
+ */
+int stress_set_membarrier_sync(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(membarrier_syncs); i++) {
+		if (!strcmp(name, membarrier_syncs[i].name)) {
+			opt_membarrier_sync = membarrier_syncs[i].method;
+			return 0;
+		}
+	}
+	fprintf(stderr, "membarrier-sync must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(membarrier_syncs); i++)
+		fprintf(stderr, " %s", membarrier_syncs[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_membarrier_readers()
+ *	set the number of RCU reader threads
+ */
+void stress_set_membarrier_readers(const char *optarg)
+{
+	opt_membarrier_readers = (uint32_t)get_uint64(optarg);
+	check_range("membarrier-readers", opt_membarrier_readers,
+		MIN_MEMBARRIER_READERS, MAX_MEMBARRIER_READERS);
+	if (opt_membarrier_sync == MEMBARRIER_SYNC_NONE)
+		opt_membarrier_sync = MEMBARRIER_SYNC_ALL;
+}
+
 static int sys_membarrier(int cmd, int flags)
 {
 #if defined(__NR_membarrier)
@@ -94,6 +177,302 @@ static void *stress_membarrier_thread(void *ctxt)
 	return &nowt;
 }
 
+/*
+ *  membarrier_reader_fence()
+ *	the fence method pays for a full fence on every read
+ *	side entry and exit, the membarrier methods only need
+ *	to stop the compiler reordering as the writer forces
+ *	the barrier onto the readers
+ */
+static inline void membarrier_reader_fence(const int method)
+{
+	if (method == MEMBARRIER_SYNC_FENCE)
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	else
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+/*
+ *  membarrier_writer_fence()
+ *	full barrier on the writer side, or on every thread
+ *	of the process for the membarrier methods
+ */
+static inline int membarrier_writer_fence(const int method)
+{
+	switch (method) {
+	case MEMBARRIER_SYNC_EXPEDITED:
+		return sys_membarrier(MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+	case MEMBARRIER_SYNC_SHARED:
+		return sys_membarrier(MEMBARRIER_CMD_SHARED, 0);
+	default:
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		return 0;
+	}
+}
+
+/*
+ *  stress_membarrier_reader()
+ *	hot read loop of RCU read side critical sections
+ */
+static void *stress_membarrier_reader(void *ctxt)
+{
+	static void *nowt = NULL;
+	membarrier_reader_t *r = (membarrier_reader_t *)ctxt;
+	const int method = membarrier_rcu.method;
+
+	sigprocmask(SIG_BLOCK, &set, NULL);
+
+	while (!__atomic_load_n(&membarrier_rcu.go, __ATOMIC_ACQUIRE))
+		sched_yield();
+
+	while (!__atomic_load_n(&membarrier_rcu.stop, __ATOMIC_RELAXED)) {
+		const uint64_t *p;
+
+		__atomic_store_n(&r->ctr,
+			__atomic_load_n(&membarrier_rcu.gp_ctr, __ATOMIC_RELAXED),
+			__ATOMIC_RELAXED);
+		membarrier_reader_fence(method);
+		p = __atomic_load_n(&membarrier_rcu.current, __ATOMIC_CONSUME);
+		if (__atomic_load_n(p, __ATOMIC_RELAXED) == MEMBARRIER_SYNC_POISON)
+			r->stale++;
+		membarrier_reader_fence(method);
+		__atomic_store_n(&r->ctr, 0, __ATOMIC_RELAXED);
+		r->reads++;
+	}
+	return &nowt;
+}
+
+/*
+ *  membarrier_synchronize()
+ *	wait for a grace period, every reader must either be
+ *	quiescent or have entered after the counter flip
+ */
+static int membarrier_synchronize(
+	membarrier_reader_t *readers,
+	const uint32_t nreaders,
+	const int method)
+{
+	uint64_t gp;
+	uint32_t i;
+
+	if (membarrier_writer_fence(method) < 0)
+		return -1;
+	gp = __atomic_add_fetch(&membarrier_rcu.gp_ctr, 1, __ATOMIC_RELAXED);
+	if (membarrier_writer_fence(method) < 0)
+		return -1;
+	for (i = 0; i < nreaders; i++) {
+		for (;;) {
+			const uint64_t ctr =
+				__atomic_load_n(&readers[i].ctr, __ATOMIC_RELAXED);
+
+			if (!ctr || (ctr == gp))
+				break;
+			sched_yield();
+		}
+	}
+	return membarrier_writer_fence(method);
+}
+
+/*
+ *  membarrier_sync_phase()
+ *	run readers against a writer that publishes a new slot
+ *	and retires the old one after each grace period for a
+ *	phase, returns the number of readers started
+ */
+static uint32_t membarrier_sync_phase(
+	const char *name,
+	const int method,
+	membarrier_reader_t *readers,
+	stress_latency_t *lat,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	double *duration,
+	uint64_t *reads,
+	uint64_t *stale)
+{
+	uint32_t i, started = 0;
+	uint64_t value = 0;
+	double t_start, t_end;
+	int which = 0;
+
+	*duration = 0.0;
+	*reads = 0;
+	*stale = 0;
+
+	membarrier_rcu.method = method;
+	membarrier_rcu.go = false;
+	membarrier_rcu.stop = false;
+	membarrier_rcu.gp_ctr = 1;
+	membarrier_rcu.slot[0] = value;
+	membarrier_rcu.current = &membarrier_rcu.slot[0];
+
+	for (i = 0; i < opt_membarrier_readers; i++) {
+		memset(&readers[i], 0, sizeof(readers[i]));
+		readers[i].ret = pthread_create(&readers[i].pthread, NULL,
+			stress_membarrier_reader, &readers[i]);
+		if (readers[i].ret)
+			break;
+		started++;
+	}
+	if (!started)
+		return 0;
+
+	__atomic_store_n(&membarrier_rcu.go, true, __ATOMIC_RELEASE);
+	t_start = time_now();
+	t_end = t_start + MEMBARRIER_SYNC_PHASE_TIME;
+	do {
+		uint64_t *old = &membarrier_rcu.slot[which];
+		uint64_t *new = &membarrier_rcu.slot[which ^ 1];
+		uint64_t t;
+
+		*new = ++value;
+		__atomic_store_n(&membarrier_rcu.current, new, __ATOMIC_RELEASE);
+		t = time_now_ns();
+		if (membarrier_synchronize(readers, started, method) < 0) {
+			pr_err(stderr, "%s: membarrier failed: errno=%d: (%s)\n",
+				name, errno, strerror(errno));
+			break;
+		}
+		latency_record(lat, time_now_ns() - t);
+		/* No reader can still hold the old slot */
+		*old = MEMBARRIER_SYNC_POISON;
+		which ^= 1;
+		(*counter)++;
+	} while (opt_do_run && (time_now() < t_end) &&
+		 (!max_ops || *counter < max_ops));
+	*duration = time_now() - t_start;
+
+	__atomic_store_n(&membarrier_rcu.stop, true, __ATOMIC_RELAXED);
+	for (i = 0; i < started; i++) {
+		(void)pthread_join(readers[i].pthread, NULL);
+		*reads += readers[i].reads;
+		*stale += readers[i].stale;
+	}
+	return started;
+}
+
+/*
+ *  stress_membarrier_sync()
+ *	compare the read side throughput and the grace period
+ *	latency of fence and membarrier based RCU
+ */
+static int stress_membarrier_sync(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const int supported)
+{
+	membarrier_reader_t *readers;
+	stress_latency_t *lats;
+	uint64_t reads[MEMBARRIER_SYNC_MAX], syncs[MEMBARRIER_SYNC_MAX];
+	double durations[MEMBARRIER_SYNC_MAX];
+	bool available[MEMBARRIER_SYNC_MAX];
+	bool reported = false;
+	int method, rc = EXIT_SUCCESS;
+	size_t idx = 0;
+
+	available[MEMBARRIER_SYNC_FENCE] = true;
+	available[MEMBARRIER_SYNC_EXPEDITED] =
+		(supported & MEMBARRIER_CMD_PRIVATE_EXPEDITED) &&
+		(sys_membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0);
+	available[MEMBARRIER_SYNC_SHARED] = !!(supported & MEMBARRIER_CMD_SHARED);
+	for (method = 0; method < MEMBARRIER_SYNC_MAX; method++) {
+		if (available[method] ||
+		    ((opt_membarrier_sync != MEMBARRIER_SYNC_ALL) &&
+		     (opt_membarrier_sync != method)))
+			continue;
+		if (instance == 0)
+			pr_inf(stderr, "%s: membarrier %s method not supported, "
+				"skipping it\n", name, membarrier_syncs[method].name);
+		if (opt_membarrier_sync == method)
+			return EXIT_FAILURE;
+	}
+
+	readers = calloc(opt_membarrier_readers, sizeof(*readers));
+	lats = calloc(MEMBARRIER_SYNC_MAX, sizeof(*lats));
+	if (!readers || !lats) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " readers\n",
+			name, opt_membarrier_readers);
+		free(readers);
+		free(lats);
+		return EXIT_NO_RESOURCE;
+	}
+	sigfillset(&set);
+	memset(reads, 0, sizeof(reads));
+	memset(syncs, 0, sizeof(syncs));
+	memset(durations, 0, sizeof(durations));
+
+	do {
+		for (method = 0; method < MEMBARRIER_SYNC_MAX; method++) {
+			const uint64_t before = *counter;
+			uint64_t phase_reads, stale;
+			double duration;
+
+			if (!available[method] ||
+			    ((opt_membarrier_sync != MEMBARRIER_SYNC_ALL) &&
+			     (opt_membarrier_sync != method)))
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			if (!membarrier_sync_phase(name, method, readers,
+					&lats[method], counter, max_ops,
+					&duration, &phase_reads, &stale)) {
+				pr_inf(stderr, "%s: cannot create any reader "
+					"threads\n", name);
+				rc = EXIT_NO_RESOURCE;
+				goto done;
+			}
+			if ((opt_flags & OPT_FLAGS_VERIFY) && stale) {
+				pr_fail(stderr, "%s: %s readers saw %" PRIu64
+					" retired slots after a grace period\n",
+					name, membarrier_syncs[method].name, stale);
+				rc = EXIT_FAILURE;
+			}
+			reads[method] += phase_reads;
+			syncs[method] += *counter - before;
+			durations[method] += duration;
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %9s %14s %12s %10s %10s\n", name,
+				"method", "reads/s", "syncs/s",
+				"p50 usec", "p99 usec");
+			for (method = 0; method < MEMBARRIER_SYNC_MAX; method++) {
+				if (durations[method] <= 0.0)
+					continue;
+				pr_inf(stderr, "%s: %9s %14.1f %12.1f %10.2f %10.2f\n",
+					name, membarrier_syncs[method].name,
+					(double)reads[method] / durations[method],
+					(double)syncs[method] / durations[method],
+					(double)latency_percentile(&lats[method], 0.50) / 1000.0,
+					(double)latency_percentile(&lats[method], 0.99) / 1000.0);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (method = 0; method < MEMBARRIER_SYNC_MAX; method++) {
+		const char *mname = membarrier_syncs[method].name;
+		char desc[40];
+
+		if (durations[method] <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s reads per sec", mname);
+		stress_misc_metric_set(idx++, desc,
+			(double)reads[method] / durations[method]);
+		(void)snprintf(desc, sizeof(desc), "%s sync p50 (usec)", mname);
+		stress_misc_metric_set(idx++, desc,
+			(double)latency_percentile(&lats[method], 0.50) / 1000.0);
+		(void)snprintf(desc, sizeof(desc), "%s sync p99 (usec)", mname);
+		stress_misc_metric_set(idx++, desc,
+			(double)latency_percentile(&lats[method], 0.99) / 1000.0);
+	}
+	free(lats);
+	free(readers);
+
+	return rc;
+}
+
 /*
  *  stress on membarrier()
  *	stress system by IO sync calls
@@ -117,6 +496,9 @@ int stress_membarrier(
 			name, errno, strerror(errno));
 		return EXIT_FAILURE;
 	}
+	if (opt_membarrier_sync != MEMBARRIER_SYNC_NONE)
+		return stress_membarrier_sync(counter, instance, max_ops,
+			name, ret);
 	if (!(ret & MEMBARRIER_CMD_SHARED)) {
 		pr_inf(stderr, "%s: membarrier MEMBARRIER_CMD_SHARED "
 			"not supported\n", name);
@@ -27,10 +27,396 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <sys/mman.h>
 
 #include "stress-ng.h"
 
-static uint8_t buffer[STR_SHARED_SIZE] ALIGN64;
+#if defined(__GNUC__) && !defined(__clang__) &&			\
+    (defined(__x86_64__) || defined(__i386__)) && NEED_GNUC(4,9,0)
+#define MEMCPY_X86		(1)
+#include <immintrin.h>
+#if NEED_GNUC(5,0,0)
+#define MEMCPY_X86_AVX512	(1)
+#endif
+#endif
+
+#define MEMCPY_SWEEP_MIN	(64)		/* smallest sweep copy size */
+#define MEMCPY_SWEEP_BYTES	(8 * MB)	/* bytes copied per size per pass */
+#define MEMCPY_SWEEP_SIZES	(32)		/* max number of sweep sizes */
+#define MEMCPY_SWEEP_ALIGNS	(2)		/* aligned and misaligned */
+#define MEMCPY_BW_QUANTUM	(256 * KB)	/* bytes per paced copy */
+
+/* sweep copy src and dst offsets from a 64 byte boundary */
+static const size_t memcpy_sweep_offset[MEMCPY_SWEEP_ALIGNS][2] = {
+	{ 0, 0 },	/* aligned */
+	{ 1, 3 },	/* misaligned */
+};
+
+typedef void (*memcpy_func_t)(void *RESTRICT dst, const void *RESTRICT src, size_t n);
+
+typedef struct {
+	const char *name;		/* --memcpy-method name */
+	bool (*supported)(void);	/* true if the CPU can use it */
+	memcpy_func_t func;		/* the copy engine */
+} stress_memcpy_method_info_t;
+
+static bool opt_memcpy_sweep = false;
+static uint64_t opt_memcpy_bw = 0;		/* 0 = unpaced */
+static const stress_memcpy_method_info_t *opt_memcpy_method = NULL;
+
+void stress_set_memcpy_sweep(void)
+{
+	opt_memcpy_sweep = true;
+}
+
+void stress_set_memcpy_bw(const char *optarg)
+{
+	opt_memcpy_bw = get_uint64_byte(optarg);
+	check_range("memcpy-bw", opt_memcpy_bw,
+		MIN_BW_RATE, MAX_BW_RATE);
+}
+
+static bool memcpy_always_supported(void)
+{
+	return true;
+}
+
+/*
+ *  memcpy_libc()
+ *	the C library memcpy
+ */
+static void memcpy_libc(void *RESTRICT dst, const void *RESTRICT src, size_t n)
+{
+	(void)memcpy(dst, src, n);
+}
+
+/*
+ *  memcpy_byte()
+ *	naive byte at a time copy as a baseline, the empty asm
+ *	stops the compiler turning the loop back into a memcpy
+ */
+static void memcpy_byte(void *RESTRICT dst, const void *RESTRICT src, size_t n)
+{
+	uint8_t *RESTRICT d = (uint8_t *)dst;
+	const uint8_t *RESTRICT s = (const uint8_t *)src;
+
+	while (n--) {
+		*d++ = *s++;
+		FORCE_DO_NOTHING();
+	}
+}
+
+#if defined(MEMCPY_X86)
+/*
+ *  memcpy_rep_movsb()
+ *	copy with rep movsb, fast on CPUs with ERMS or FSRM
+ */
+static void memcpy_rep_movsb(void *RESTRICT dst, const void *RESTRICT src, size_t n)
+{
+	__asm__ __volatile__("rep movsb"
+		: "+D" (dst), "+S" (src), "+c" (n)
+		:
+		: "memory");
+}
+
+static bool memcpy_avx2_supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+/*
+ *  memcpy_avx2()
+ *	copy 32 bytes at a time with AVX2 unaligned loads and stores
+ */
+static void __attribute__((target("avx2"))) memcpy_avx2(
+	void *RESTRICT dst,
+	const void *RESTRICT src,
+	size_t n)
+{
+	uint8_t *RESTRICT d = (uint8_t *)dst;
+	const uint8_t *RESTRICT s = (const uint8_t *)src;
+
+	for (; n >= 128; n -= 128, s += 128, d += 128) {
+		const __m256i v0 = _mm256_loadu_si256((const __m256i *)(s + 0));
+		const __m256i v1 = _mm256_loadu_si256((const __m256i *)(s + 32));
+		const __m256i v2 = _mm256_loadu_si256((const __m256i *)(s + 64));
+		const __m256i v3 = _mm256_loadu_si256((const __m256i *)(s + 96));
+
+		_mm256_storeu_si256((__m256i *)(d + 0), v0);
+		_mm256_storeu_si256((__m256i *)(d + 32), v1);
+		_mm256_storeu_si256((__m256i *)(d + 64), v2);
+		_mm256_storeu_si256((__m256i *)(d + 96), v3);
+	}
+	for (; n >= 32; n -= 32, s += 32, d += 32)
+		_mm256_storeu_si256((__m256i *)d, _mm256_loadu_si256((const __m256i *)s));
+	while (n--)
+		*d++ = *s++;
+}
+
+#if defined(MEMCPY_X86_AVX512)
+static bool memcpy_avx512_supported(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+/*
+ *  memcpy_avx512()
+ *	copy 64 bytes at a time with AVX-512 unaligned loads and stores
+ */
+static void __attribute__((target("avx512f"))) memcpy_avx512(
+	void *RESTRICT dst,
+	const void *RESTRICT src,
+	size_t n)
+{
+	uint8_t *RESTRICT d = (uint8_t *)dst;
+	const uint8_t *RESTRICT s = (const uint8_t *)src;
+
+	for (; n >= 256; n -= 256, s += 256, d += 256) {
+		const __m512i v0 = _mm512_loadu_si512((const void *)(s + 0));
+		const __m512i v1 = _mm512_loadu_si512((const void *)(s + 64));
+		const __m512i v2 = _mm512_loadu_si512((const void *)(s + 128));
+		const __m512i v3 = _mm512_loadu_si512((const void *)(s + 192));
+
+		_mm512_storeu_si512((void *)(d + 0), v0);
+		_mm512_storeu_si512((void *)(d + 64), v1);
+		_mm512_storeu_si512((void *)(d + 128), v2);
+		_mm512_storeu_si512((void *)(d + 192), v3);
+	}
+	for (; n >= 64; n -= 64, s += 64, d += 64)
+		_mm512_storeu_si512((void *)d, _mm512_loadu_si512((const void *)s));
+	while (n--)
+		*d++ = *s++;
+}
+#endif
+
+static bool memcpy_sse2_supported(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+/*
+ *  memcpy_nt()
+ *	copy with SSE2 non-temporal stores that bypass the
+ *	caches, the destination is aligned to 16 bytes first
+ */
+static void __attribute__((target("sse2"))) memcpy_nt(
+	void *RESTRICT dst,
+	const void *RESTRICT src,
+	size_t n)
+{
+	uint8_t *RESTRICT d = (uint8_t *)dst;
+	const uint8_t *RESTRICT s = (const uint8_t *)src;
+
+	for (; n && ((uintptr_t)d & 15); n--)
+		*d++ = *s++;
+	for (; n >= 64; n -= 64, s += 64, d += 64) {
+		const __m128i v0 = _mm_loadu_si128((const __m128i *)(s + 0));
+		const __m128i v1 = _mm_loadu_si128((const __m128i *)(s + 16));
+		const __m128i v2 = _mm_loadu_si128((const __m128i *)(s + 32));
+		const __m128i v3 = _mm_loadu_si128((const __m128i *)(s + 48));
+
+		_mm_stream_si128((__m128i *)(d + 0), v0);
+		_mm_stream_si128((__m128i *)(d + 16), v1);
+		_mm_stream_si128((__m128i *)(d + 32), v2);
+		_mm_stream_si128((__m128i *)(d + 48), v3);
+	}
+	for (; n >= 16; n -= 16, s += 16, d += 16)
+		_mm_stream_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+	_mm_sfence();
+	while (n--)
+		*d++ = *s++;
+}
+#endif
+
+/*
+ *  Copy engines, "all" exercises each supported engine in turn
+ */
+static const stress_memcpy_method_info_t memcpy_methods[] = {
+	{ "all",	memcpy_always_supported,	NULL },
+	{ "libc",	memcpy_always_supported,	memcpy_libc },
+	{ "byte",	memcpy_always_supported,	memcpy_byte },
+#if defined(MEMCPY_X86)
+	{ "rep-movsb",	memcpy_always_supported,	memcpy_rep_movsb },
+	{ "avx2",	memcpy_avx2_supported,		memcpy_avx2 },
+#if defined(MEMCPY_X86_AVX512)
+	{ "avx512",	memcpy_avx512_supported,	memcpy_avx512 },
+#endif
+	{ "nt",		memcpy_sse2_supported,		memcpy_nt },
+#endif
+	{ NULL,		NULL,				NULL }
+};
+
+/*
+ *  stress_set_memcpy_method()
+ *	set the memcpy copy engine
+ */
+int stress_set_memcpy_method(const char *name)
+{
+	stress_memcpy_method_info_t const *info;
+
+	for (info = memcpy_methods; info->name; info++) {
+		if (!strcmp(info->name, name)) {
+			opt_memcpy_method = info;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "memcpy-method must be one of:");
+	for (info = memcpy_methods; info->name; info++)
+		fprintf(stderr, " %s", info->name);
+	fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stress_memcpy_llc_size()
+ *	get the size of the last level cache, or a built-in
+ *	default if it can't be determined
+ */
+static uint64_t stress_memcpy_llc_size(void)
+{
+	uint64_t size = MEM_CACHE_SIZE;
+#if defined(__linux__)
+	cpus_t *cpu_caches;
+	cpu_cache_t *cache;
+
+	cpu_caches = get_all_cpu_cache_details();
+	if (!cpu_caches)
+		return size;
+	cache = get_cpu_cache(cpu_caches, get_max_cache_level(cpu_caches));
+	if (cache && cache->size)
+		size = cache->size;
+	free_cpu_caches(cpu_caches);
+#endif
+	return size;
+}
+
+/*
+ *  stress_memcpy_sweep()
+ *	copy sizes from 64 bytes to several times the size of
+ *	the last level cache with aligned and misaligned buffers
+ *	and report the copy bandwidth of each size
+ */
+static int stress_memcpy_sweep(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const memcpy_func_t func)
+{
+	double duration[MEMCPY_SWEEP_SIZES][MEMCPY_SWEEP_ALIGNS];
+	uint64_t bytes[MEMCPY_SWEEP_SIZES][MEMCPY_SWEEP_ALIGNS];
+	uint64_t max_size, sz;
+	size_t i, j, n_sizes, buf_sz;
+	uint8_t *src, *dst;
+
+	/* Go well beyond the LLC so the larger sizes hit memory */
+	max_size = stress_memcpy_llc_size() * 4;
+	if (max_size > MAX_MEMCPY_SWEEP_SIZE)
+		max_size = MAX_MEMCPY_SWEEP_SIZE;
+	for (n_sizes = 0, sz = MEMCPY_SWEEP_MIN;
+	     (sz <= max_size) && (n_sizes < MEMCPY_SWEEP_SIZES); sz <<= 1)
+		n_sizes++;
+	max_size = (uint64_t)MEMCPY_SWEEP_MIN << (n_sizes - 1);
+
+	buf_sz = (size_t)max_size + 64;
+	src = mmap(NULL, buf_sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (src == MAP_FAILED) {
+		pr_err(stderr, "%s: cannot allocate %zu bytes\n", name, buf_sz);
+		return EXIT_NO_RESOURCE;
+	}
+	dst = mmap(NULL, buf_sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (dst == MAP_FAILED) {
+		pr_err(stderr, "%s: cannot allocate %zu bytes\n", name, buf_sz);
+		(void)munmap(src, buf_sz);
+		return EXIT_NO_RESOURCE;
+	}
+	memset(src, 0xa5, buf_sz);
+	memset(dst, 0x5a, buf_sz);
+	memset(duration, 0, sizeof(duration));
+	memset(bytes, 0, sizeof(bytes));
+
+	if (instance == 0)
+		pr_dbg(stderr, "%s: sweeping copy sizes from %d to %" PRIu64
+			" bytes\n", name, MEMCPY_SWEEP_MIN, max_size);
+
+	do {
+		for (i = 0, sz = MEMCPY_SWEEP_MIN; opt_do_run && (i < n_sizes); i++, sz <<= 1) {
+			const uint64_t loops = (sz < MEMCPY_SWEEP_BYTES) ?
+				MEMCPY_SWEEP_BYTES / sz : 1;
+
+			for (j = 0; j < MEMCPY_SWEEP_ALIGNS; j++) {
+				uint8_t *s = src + memcpy_sweep_offset[j][0];
+				uint8_t *d = dst + memcpy_sweep_offset[j][1];
+				uint64_t l;
+				double t;
+
+				t = time_now();
+				for (l = 0; l < loops; l++)
+					func(d, s, (size_t)sz);
+				duration[i][j] += time_now() - t;
+				bytes[i][j] += loops * sz;
+			}
+		}
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	if (*counter) {
+		uint64_t total = 0;
+
+		for (i = 0; i < n_sizes; i++)
+			for (j = 0; j < MEMCPY_SWEEP_ALIGNS; j++)
+				total += bytes[i][j];
+		stress_units_per_op((double)total / (double)*counter);
+	}
+
+	if (instance == 0) {
+		pr_inf(stderr, "%s: %12s %12s %12s\n", name,
+			"size (bytes)", "aligned", "misaligned");
+		for (i = 0, sz = MEMCPY_SWEEP_MIN; i < n_sizes; i++, sz <<= 1) {
+			double rate[MEMCPY_SWEEP_ALIGNS];
+
+			if (!bytes[i][0])
+				break;
+			for (j = 0; j < MEMCPY_SWEEP_ALIGNS; j++)
+				rate[j] = (duration[i][j] > 0.0) ?
+					(double)bytes[i][j] / duration[i][j] / (double)GB : 0.0;
+			pr_inf(stderr, "%s: %12" PRIu64 " %7.2f GB/s %7.2f GB/s\n",
+				name, sz, rate[0], rate[1]);
+		}
+	}
+
+	(void)munmap(dst, buf_sz);
+	(void)munmap(src, buf_sz);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_memcpy_paced()
+ *	copy n bytes with func, in quanta paced to the
+ *	--memcpy-bw rate when pacing
+ */
+static void stress_memcpy_paced(
+	const memcpy_func_t func,
+	uint8_t *RESTRICT dst,
+	const uint8_t *RESTRICT src,
+	const size_t n,
+	bw_pace_t *pace)
+{
+	const size_t quantum = (pace->rate > 0.0) ? MEMCPY_BW_QUANTUM : n;
+	size_t i;
+
+	for (i = 0; i < n; i += quantum) {
+		const size_t len = (n - i < quantum) ? n - i : quantum;
+
+		func(dst + i, src + i, len);
+		bw_pace(pace, len);
+	}
+}
 
 /*
  *  stress_memcpy()
@@ -43,18 +429,107 @@ int stress_memcpy(
 	const char *name)
 {
 	uint8_t *str_shared = shared->str_shared;
+	const stress_memcpy_method_info_t *method = opt_memcpy_method;
+	const stress_memcpy_method_info_t *info;
+	double duration[SIZEOF_ARRAY(memcpy_methods)];
+	uint64_t bytes[SIZEOF_ARRAY(memcpy_methods)];
+	bw_pace_t pace;
+	double t1, total = 0.0;
+	size_t i, k;
+	uint8_t *buffer;
+	void *ptr;
+
+	if (!method)
+		method = &memcpy_methods[1];	/* libc */
+	if (!method->supported()) {
+		if (instance == 0)
+			pr_inf(stderr, "%s: CPU does not support memcpy method %s, "
+				"using libc instead\n", name, method->name);
+		method = &memcpy_methods[1];
+	}
+
+	if (opt_memcpy_sweep) {
+		if (opt_memcpy_bw && (instance == 0))
+			pr_inf(stderr, "%s: --memcpy-bw is ignored when "
+				"sweeping copy sizes\n", name);
+		return stress_memcpy_sweep(counter, instance, max_ops, name,
+			method->func ? method->func : memcpy_libc);
+	}
+
+	/* Per instance, threaded instances must not share the copy */
+	if (posix_memalign(&ptr, 64, STR_SHARED_SIZE)) {
+		pr_inf(stderr, "%s: cannot allocate buffer, skipping stressor\n",
+			name);
+		return EXIT_NO_RESOURCE;
+	}
+	buffer = ptr;
+	memset(buffer, 0, STR_SHARED_SIZE);
 
-	(void)instance;
-	(void)name;
+	memset(duration, 0, sizeof(duration));
+	memset(bytes, 0, sizeof(bytes));
+	info = method->func ? method : &memcpy_methods[0];
+	if (opt_memcpy_bw && (instance == 0))
+		pr_inf(stderr, "%s: pacing each instance to %.2f MB/sec\n",
+			name, (double)opt_memcpy_bw / (double)MB);
+
+	bw_pace_init(&pace, (double)opt_memcpy_bw);
+	t1 = time_now();
 
 	do {
-		memcpy(buffer, str_shared, STR_SHARED_SIZE);
-		memcpy(str_shared, buffer, STR_SHARED_SIZE);
-		memmove(buffer, buffer + 64, STR_SHARED_SIZE - 64);
-		memmove(buffer + 64, buffer, STR_SHARED_SIZE - 64);
-		memmove(buffer + 1, buffer, STR_SHARED_SIZE - 1);
+		double t;
+
+		if (!method->func) {
+			/* all: next supported engine, skipping "all" */
+			do {
+				info++;
+				if (!info->name)
+					info = &memcpy_methods[1];
+			} while (!info->supported());
+		}
+		i = info - memcpy_methods;
+
+		t = time_now();
+		stress_memcpy_paced(info->func, buffer, str_shared, STR_SHARED_SIZE, &pace);
+		stress_memcpy_paced(info->func, str_shared, buffer, STR_SHARED_SIZE, &pace);
+		bytes[i] += 2 * STR_SHARED_SIZE;
+		if (info->func == memcpy_libc) {
+			memmove(buffer, buffer + 64, STR_SHARED_SIZE - 64);
+			bw_pace(&pace, STR_SHARED_SIZE - 64);
+			memmove(buffer + 64, buffer, STR_SHARED_SIZE - 64);
+			bw_pace(&pace, STR_SHARED_SIZE - 64);
+			memmove(buffer + 1, buffer, STR_SHARED_SIZE - 1);
+			bw_pace(&pace, STR_SHARED_SIZE - 1);
+			bytes[i] += (3 * STR_SHARED_SIZE) - 129;
+		}
+		duration[i] += time_now() - t;
 		(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
+	t1 = time_now() - t1;
+
+	for (k = 0, i = 1; memcpy_methods[i].name; i++) {
+		char description[32];
+
+		total += (double)bytes[i];
+		if (duration[i] <= 0.0)
+			continue;
+		(void)snprintf(description, sizeof(description),
+			"%s copy rate (MB/sec)", memcpy_methods[i].name);
+		stress_misc_metric_set(k++, description,
+			(double)bytes[i] / duration[i] / (double)MB);
+	}
+	if (*counter)
+		stress_units_per_op(total / (double)*counter);
+	if (opt_memcpy_bw && (t1 > 0.0)) {
+		const double rate = total / t1;
+
+		stress_misc_metric_set(k, "paced copy rate (MB/sec)", rate / (double)MB);
+		pr_dbg(stderr, "%s: paced to %.2f MB/sec, achieved %.1f%% of "
+			"target (instance %" PRIu32 ")\n", name,
+			(double)opt_memcpy_bw / (double)MB,
+			100.0 * rate / (double)opt_memcpy_bw, instance);
+	}
+	free(buffer);
+
 	return EXIT_SUCCESS;
 }
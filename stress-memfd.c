@@ -37,14 +37,65 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <signal.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <fcntl.h>
 
 #define MAX_MEM_FDS 	(256)
 
+#if !defined(MFD_ALLOW_SEALING)
+#define MFD_ALLOW_SEALING	(0x0002)
+#endif
+#if !defined(MFD_HUGETLB)
+#define MFD_HUGETLB		(0x0004)
+#endif
+#if !defined(F_ADD_SEALS)
+#define F_ADD_SEALS		(1024 + 9)
+#endif
+#if !defined(F_SEAL_SEAL)
+#define F_SEAL_SEAL		(0x0001)
+#endif
+#if !defined(F_SEAL_SHRINK)
+#define F_SEAL_SHRINK		(0x0002)
+#endif
+#if !defined(F_SEAL_GROW)
+#define F_SEAL_GROW		(0x0004)
+#endif
+
+#define MEMFD_IPC_PHASE_TIME	(1.0)		/* seconds per segment kind */
+#define MEMFD_IPC_SEG_SIZE	(4 * MB)	/* two 2MB huge pages */
+#define MEMFD_IPC_DATA_OFFSET	(64 * KB)	/* ring after the header */
+#define MEMFD_IPC_SLOT_SIZE	(64 * KB)	/* bytes per ring slot */
+#define MEMFD_IPC_SLOTS		(32)		/* 2MB ring */
+
+#define MEMFD_IPC_MEMFD		(0)	/* sealed memfd_create(2) */
+#define MEMFD_IPC_MEMFD_HUGE	(1)	/* memfd_create(2) with MFD_HUGETLB */
+#define MEMFD_IPC_SHM_POSIX	(2)	/* shm_open(3) */
+#define MEMFD_IPC_SHM_SYSV	(3)	/* shmget(2) */
+#define MEMFD_IPC_MAX		(4)
+
+static const char *memfd_ipc_names[MEMFD_IPC_MAX] = {
+	"memfd", "memfd-huge", "shm-posix", "shm-sysv"
+};
+
+/* Ring state at the start of the shared segment */
+typedef struct {
+	uint64_t head ALIGN64;		/* slots the producer has filled */
+	bool stop ALIGN64;		/* consumers exit */
+	struct {
+		uint64_t tail ALIGN64;	/* slots this consumer has read */
+	} consumer[MAX_MEMFD_CONSUMERS];
+} memfd_ring_t;
+
 static size_t opt_memfd_bytes = DEFAULT_MEMFD_BYTES;
 static bool set_memfd_bytes;
+static bool memfd_ipc_mode = false;
+static uint32_t opt_memfd_consumers = DEFAULT_MEMFD_CONSUMERS;
 
 void stress_set_memfd_bytes(const char *optarg)
 {
@@ -54,6 +105,23 @@ void stress_set_memfd_bytes(const char *optarg)
 		MIN_MEMFD_BYTES, MAX_MEMFD_BYTES);
 }
 
+/*
+ *  stress_set_memfd_ipc()
+ *	stream through a ring in each kind of shared segment
+ */
+void stress_set_memfd_ipc(void)
+{
+	memfd_ipc_mode = true;
+}
+
+void stress_set_memfd_consumers(const char *optarg)
+{
+	opt_memfd_consumers = (uint32_t)get_uint64(optarg);
+	check_range("memfd-consumers", opt_memfd_consumers,
+		MIN_MEMFD_CONSUMERS, MAX_MEMFD_CONSUMERS);
+	memfd_ipc_mode = true;
+}
+
 /*
  *  Ugly hack until glibc defines this
  */
@@ -213,6 +281,332 @@ clean:
 }
 
 
+/*
+ *  memfd_ipc_map()
+ *	create and map a shared segment of a kind, the
+ *	segment is gone once it is unmapped
+ */
+static void *memfd_ipc_map(const char *name, const int kind)
+{
+	void *ptr = MAP_FAILED;
+	char shm_name[64];
+	int fd = -1, shm_id;
+
+	switch (kind) {
+	case MEMFD_IPC_MEMFD:
+		fd = sys_memfd_create(name, MFD_ALLOW_SEALING);
+		if (fd < 0)
+			return MAP_FAILED;
+		if (ftruncate(fd, MEMFD_IPC_SEG_SIZE) < 0)
+			break;
+		/* As a zero-copy IPC layer hands it out, fixed size */
+		(void)fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+		ptr = mmap(NULL, MEMFD_IPC_SEG_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+		break;
+	case MEMFD_IPC_MEMFD_HUGE:
+		fd = sys_memfd_create(name, MFD_HUGETLB);
+		if (fd < 0)
+			return MAP_FAILED;
+		if (ftruncate(fd, MEMFD_IPC_SEG_SIZE) < 0)
+			break;
+		ptr = mmap(NULL, MEMFD_IPC_SEG_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, 0);
+		break;
+	case MEMFD_IPC_SHM_POSIX:
+#if defined(HAVE_LIB_RT)
+		(void)snprintf(shm_name, sizeof(shm_name), "/%s-ipc-%i",
+			name, (int)getpid());
+		fd = shm_open(shm_name, O_CREAT | O_RDWR | O_EXCL, S_IRUSR | S_IWUSR);
+		if (fd < 0)
+			return MAP_FAILED;
+		(void)shm_unlink(shm_name);
+		if (ftruncate(fd, MEMFD_IPC_SEG_SIZE) < 0)
+			break;
+		ptr = mmap(NULL, MEMFD_IPC_SEG_SIZE, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+#else
+		(void)shm_name;
+#endif
+		break;
+	case MEMFD_IPC_SHM_SYSV:
+		shm_id = shmget(IPC_PRIVATE, MEMFD_IPC_SEG_SIZE,
+			IPC_CREAT | S_IRUSR | S_IWUSR);
+		if (shm_id < 0)
+			return MAP_FAILED;
+		ptr = shmat(shm_id, NULL, 0);
+		/* Destroyed once the last attach is gone */
+		(void)shmctl(shm_id, IPC_RMID, NULL);
+		return (ptr == (void *)-1) ? MAP_FAILED : ptr;
+	}
+	if (fd >= 0)
+		(void)close(fd);
+	return ptr;
+}
+
+static void memfd_ipc_unmap(const int kind, void *ptr)
+{
+	if (kind == MEMFD_IPC_SHM_SYSV)
+		(void)shmdt(ptr);
+	else
+		(void)munmap(ptr, MEMFD_IPC_SEG_SIZE);
+}
+
+/*
+ *  memfd_ipc_misses_open()
+ *	open a cache miss counter that also counts the
+ *	consumers forked after it, -1 if unavailable
+ */
+static int memfd_ipc_misses_open(void)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_open_by_id(STRESS_PERF_HW_CACHE_MISSES);
+#else
+	return -1;
+#endif
+}
+
+static bool memfd_ipc_misses_read(const int fd, uint64_t *misses)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_read_by_fd(fd, misses) == 0;
+#else
+	(void)fd;
+
+	*misses = 0;
+	return false;
+#endif
+}
+
+/*
+ *  memfd_ipc_consumer()
+ *	read every slot the producer fills, all the consumers
+ *	see all of the stream
+ */
+static void MLOCKED memfd_ipc_consumer(
+	memfd_ring_t *ring,
+	const uint8_t *data,
+	const uint32_t n)
+{
+	uint64_t tail = 0, sum = 0;
+
+	while (!__atomic_load_n(&ring->stop, __ATOMIC_ACQUIRE)) {
+		const uint64_t *ptr, *end;
+
+		if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+			(void)sched_yield();
+			continue;
+		}
+		ptr = (const uint64_t *)(data + (tail % MEMFD_IPC_SLOTS) * MEMFD_IPC_SLOT_SIZE);
+		end = ptr + (MEMFD_IPC_SLOT_SIZE / sizeof(*ptr));
+		while (ptr < end)
+			sum += *ptr++;
+		tail++;
+		__atomic_store_n(&ring->consumer[n].tail, tail, __ATOMIC_RELEASE);
+	}
+	uint64_put(sum);
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  memfd_ipc_phase()
+ *	stream through the ring of one kind of segment for a
+ *	phase, 0 if done, 1 if the kind is not available here
+ */
+static int memfd_ipc_phase(
+	const char *name,
+	const int kind,
+	uint64_t *bytes,
+	double *secs,
+	uint64_t *misses,
+	bool *have_misses,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	pid_t pids[MAX_MEMFD_CONSUMERS];
+	memfd_ring_t *ring;
+	uint8_t *seg, *data;
+	uint64_t head = 0, misses_begin = 0, misses_end;
+	uint32_t i, started = 0;
+	double t_start, t_end;
+	int fd, status;
+
+	seg = memfd_ipc_map(name, kind);
+	if (seg == MAP_FAILED)
+		return 1;
+	ring = (memfd_ring_t *)seg;
+	data = seg + MEMFD_IPC_DATA_OFFSET;
+	memset(ring, 0, sizeof(*ring));
+
+	fd = memfd_ipc_misses_open();
+	if (fd >= 0)
+		(void)memfd_ipc_misses_read(fd, &misses_begin);
+
+	for (i = 0; i < opt_memfd_consumers; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			pr_dbg(stderr, "%s: fork failed: errno=%d (%s)\n",
+				name, errno, strerror(errno));
+			break;
+		} else if (pids[i] == 0) {
+			(void)setpgid(0, pgrp);
+			stress_parent_died_alarm();
+			memfd_ipc_consumer(ring, data, i);
+		}
+		(void)setpgid(pids[i], pgrp);
+		started++;
+	}
+
+	t_start = time_now();
+	t_end = t_start + MEMFD_IPC_PHASE_TIME;
+	while (started && opt_do_run && (!max_ops || *counter < max_ops)) {
+		uint64_t *ptr, *end, oldest = head;
+
+		/* Wait for the slowest consumer to free a slot */
+		for (i = 0; i < started; i++) {
+			const uint64_t tail = __atomic_load_n(&ring->consumer[i].tail,
+				__ATOMIC_ACQUIRE);
+
+			if (tail < oldest)
+				oldest = tail;
+		}
+		if (head - oldest >= MEMFD_IPC_SLOTS) {
+			if (time_now() >= t_end)
+				break;
+			(void)sched_yield();
+			continue;
+		}
+		ptr = (uint64_t *)(data + (head % MEMFD_IPC_SLOTS) * MEMFD_IPC_SLOT_SIZE);
+		end = ptr + (MEMFD_IPC_SLOT_SIZE / sizeof(*ptr));
+		while (ptr < end)
+			*ptr++ = head;
+		head++;
+		__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+		(*counter)++;
+		if (!(head & 15) && (time_now() >= t_end))
+			break;
+	}
+
+	/* Let the consumers catch up, they are in the transfer cost */
+	for (;;) {
+		uint64_t oldest = head;
+
+		for (i = 0; i < started; i++) {
+			const uint64_t tail = __atomic_load_n(&ring->consumer[i].tail,
+				__ATOMIC_ACQUIRE);
+
+			if (tail < oldest)
+				oldest = tail;
+		}
+		if ((oldest == head) || !opt_do_run)
+			break;
+		(void)sched_yield();
+	}
+	*secs += time_now() - t_start;
+	*bytes += head * MEMFD_IPC_SLOT_SIZE;
+	if ((fd >= 0) && memfd_ipc_misses_read(fd, &misses_end)) {
+		*misses += misses_end - misses_begin;
+		*have_misses = true;
+	}
+	if (fd >= 0)
+		(void)close(fd);
+
+	__atomic_store_n(&ring->stop, true, __ATOMIC_RELEASE);
+	for (i = 0; i < started; i++)
+		(void)waitpid(pids[i], &status, 0);
+	memfd_ipc_unmap(kind, seg);
+
+	return 0;
+}
+
+/*
+ *  stress_memfd_ipc()
+ *	the bandwidth of one producer streaming to N consumers
+ *	through a ring in each kind of shared segment and the
+ *	time and cache misses per transferred 64 byte line
+ */
+static int stress_memfd_ipc(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	uint64_t bytes[MEMFD_IPC_MAX], misses[MEMFD_IPC_MAX];
+	double secs[MEMFD_IPC_MAX];
+	bool available[MEMFD_IPC_MAX], have_misses[MEMFD_IPC_MAX];
+	bool reported = false;
+	int kind;
+	size_t idx = 0;
+
+	memset(bytes, 0, sizeof(bytes));
+	memset(misses, 0, sizeof(misses));
+	memset(secs, 0, sizeof(secs));
+	memset(have_misses, 0, sizeof(have_misses));
+	for (kind = 0; kind < MEMFD_IPC_MAX; kind++)
+		available[kind] = true;
+
+	do {
+		for (kind = 0; kind < MEMFD_IPC_MAX; kind++) {
+			if (!available[kind])
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			if (memfd_ipc_phase(name, kind, &bytes[kind], &secs[kind],
+					&misses[kind], &have_misses[kind],
+					counter, max_ops) > 0) {
+				if (instance == 0)
+					pr_inf(stderr, "%s: cannot create a %s segment, "
+						"skipping it\n", name, memfd_ipc_names[kind]);
+				available[kind] = false;
+			}
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: 1 producer, %" PRIu32 " consumer%s, "
+				"%" PRIu64 "K ring\n", name, opt_memfd_consumers,
+				(opt_memfd_consumers == 1) ? "" : "s",
+				(uint64_t)((MEMFD_IPC_SLOTS * MEMFD_IPC_SLOT_SIZE) / KB));
+			pr_inf(stderr, "%s: %10s %8s %8s %11s\n", name,
+				"segment", "GB/sec", "ns/line", "misses/line");
+			for (kind = 0; kind < MEMFD_IPC_MAX; kind++) {
+				/* Each consumer reads every line the producer writes */
+				const double lines = (double)bytes[kind] *
+					opt_memfd_consumers / CACHELINE_SIZE;
+				char buf[16];
+
+				if (!available[kind] || !bytes[kind] || (secs[kind] <= 0.0))
+					continue;
+				if (have_misses[kind])
+					(void)snprintf(buf, sizeof(buf), "%.3f",
+						(double)misses[kind] / lines);
+				else
+					(void)snprintf(buf, sizeof(buf), "-");
+				pr_inf(stderr, "%s: %10s %8.2f %8.2f %11s\n", name,
+					memfd_ipc_names[kind],
+					(double)bytes[kind] / secs[kind] / (double)GB,
+					secs[kind] * 1000000000.0 / lines, buf);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (kind = 0; kind < MEMFD_IPC_MAX; kind++) {
+		char desc[40];
+
+		if (!bytes[kind] || (secs[kind] <= 0.0))
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s GB/sec", memfd_ipc_names[kind]);
+		stress_misc_metric_set(idx++, desc,
+			(double)bytes[kind] / secs[kind] / (double)GB);
+		if (!have_misses[kind])
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s misses per line",
+			memfd_ipc_names[kind]);
+		stress_misc_metric_set(idx++, desc, (double)misses[kind] /
+			((double)bytes[kind] * opt_memfd_consumers / CACHELINE_SIZE));
+	}
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_memfd()
  *	stress memfd
@@ -226,6 +620,8 @@ int stress_memfd(
 	pid_t pid;
 	uint32_t ooms = 0, segvs = 0, nomems = 0;
 
+	if (memfd_ipc_mode)
+		return stress_memfd_ipc(counter, instance, max_ops, name);
 	if (!set_memfd_bytes) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
 			opt_memfd_bytes = MAX_MEMFD_BYTES;
@@ -130,6 +130,7 @@ int stress_mergesort(
 			opt_mergesort_size = MIN_MERGESORT_SIZE;
 	}
 	n = (size_t)opt_mergesort_size;
+	stress_units_per_op((double)n);
 
 	if ((data = calloc(n, sizeof(int32_t))) == NULL) {
 		pr_fail_dbg(name, "malloc");
@@ -0,0 +1,514 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "stress-ng.h"
+
+#define METADATA_TREE_DEPTH	(4)	/* directory levels of the tree */
+#define METADATA_TREE_FANOUT	(4)	/* sub directories per level */
+#define METADATA_LAYOUT_ALL	(-1)
+
+enum {
+	LAYOUT_PRIVATE = 0,		/* a directory per instance */
+	LAYOUT_SHARED,			/* one directory for all instances */
+	LAYOUT_TREE,			/* a deep tree shared by all instances */
+};
+
+enum {
+	PHASE_CREATE = 0,
+	PHASE_STAT,
+	PHASE_RENAME,
+	PHASE_UNLINK,
+};
+
+static const char *metadata_layouts[METADATA_LAYOUTS] = {
+	"private", "shared", "tree"
+};
+
+static const char *metadata_phases[METADATA_PHASES] = {
+	"create", "stat", "rename", "unlink"
+};
+
+static int opt_metadata_layout = METADATA_LAYOUT_ALL;
+static uint64_t opt_metadata_files = DEFAULT_METADATA_FILES;
+
+/*
+ *  stress_set_metadata_layout()
+ *	set the directory layout, or all of them
+ */
+int stress_set_metadata_layout(const char *name)
+{
+	size_t i;
+
+	if (!strcmp(name, "all")) {
+		opt_metadata_layout = METADATA_LAYOUT_ALL;
+		return 0;
+	}
+	for (i = 0; i < METADATA_LAYOUTS; i++) {
+		if (!strcmp(name, metadata_layouts[i])) {
+			opt_metadata_layout = (int)i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "metadata-layout must be one of: all");
+	for (i = 0; i < METADATA_LAYOUTS; i++)
+		fprintf(stderr, " %s", metadata_layouts[i]);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+void stress_set_metadata_files(const char *optarg)
+{
+	opt_metadata_files = get_uint64(optarg);
+	check_range("metadata-files", opt_metadata_files,
+		MIN_METADATA_FILES, MAX_METADATA_FILES);
+}
+
+/*
+ *  metadata_tree_path()
+ *	path of the n'th directory of a tree level, level 0 is
+ *	the top of the tree
+ */
+static void metadata_tree_path(
+	char *path,
+	const size_t len,
+	const char *shared_dir,
+	const size_t level,
+	uint64_t n)
+{
+	size_t i, used;
+
+	used = (size_t)snprintf(path, len, "%s/t", shared_dir);
+	for (i = 0; (i < level) && (used < len); i++) {
+		used += (size_t)snprintf(path + used, len - used, "/%" PRIu64,
+			n % METADATA_TREE_FANOUT);
+		n /= METADATA_TREE_FANOUT;
+	}
+}
+
+/*
+ *  metadata_tree_mk()
+ *	create the tree, all instances race to do this so an
+ *	existing directory is fine
+ */
+static int metadata_tree_mk(const char *name, const char *shared_dir)
+{
+	size_t level;
+	uint64_t n, dirs = 1;
+
+	for (level = 0; level <= METADATA_TREE_DEPTH; level++) {
+		for (n = 0; n < dirs; n++) {
+			char path[PATH_MAX];
+
+			metadata_tree_path(path, sizeof(path), shared_dir, level, n);
+			if ((mkdir(path, S_IRWXU) < 0) && (errno != EEXIST)) {
+				pr_fail_err(name, "mkdir");
+				return -1;
+			}
+		}
+		dirs *= METADATA_TREE_FANOUT;
+	}
+	return 0;
+}
+
+/*
+ *  metadata_tree_rm()
+ *	remove the tree from the leaves up, directories other
+ *	instances still use are not empty and are left alone
+ */
+static void metadata_tree_rm(const char *shared_dir)
+{
+	size_t level;
+	uint64_t n, dirs = 1;
+
+	for (level = 0; level < METADATA_TREE_DEPTH; level++)
+		dirs *= METADATA_TREE_FANOUT;
+	for (level = METADATA_TREE_DEPTH + 1; level-- > 0; ) {
+		for (n = 0; n < dirs; n++) {
+			char path[PATH_MAX];
+
+			metadata_tree_path(path, sizeof(path), shared_dir, level, n);
+			(void)rmdir(path);
+		}
+		dirs /= METADATA_TREE_FANOUT;
+	}
+}
+
+/*
+ *  metadata_filename()
+ *	name of file i of an instance in a layout, renamed files
+ *	get a .r suffix
+ */
+static void metadata_filename(
+	char *path,
+	const size_t len,
+	const int layout,
+	const char *private_dir,
+	const char *shared_dir,
+	const uint32_t instance,
+	const uint64_t i,
+	const bool renamed)
+{
+	const char *suffix = renamed ? ".r" : "";
+	size_t used;
+
+	switch (layout) {
+	case LAYOUT_PRIVATE:
+		(void)snprintf(path, len, "%s/f%" PRIu64 "%s",
+			private_dir, i, suffix);
+		break;
+	case LAYOUT_SHARED:
+		(void)snprintf(path, len, "%s/i%" PRIu32 "-f%" PRIu64 "%s",
+			shared_dir, instance, i, suffix);
+		break;
+	default:
+		/* Spread each instance's files over all of the leaves */
+		metadata_tree_path(path, len, shared_dir,
+			METADATA_TREE_DEPTH, i + instance);
+		used = strlen(path);
+		(void)snprintf(path + used, len - used, "/i%" PRIu32 "-f%" PRIu64 "%s",
+			instance, i, suffix);
+		break;
+	}
+}
+
+/*
+ *  metadata_barrier()
+ *	wait for all instances to arrive before starting the next
+ *	phase so the phases run concurrently, false if the run is
+ *	over or another instance has finished
+ */
+static bool metadata_barrier(uint32_t *barriers, const uint32_t instances)
+{
+	const uint32_t target = ++(*barriers) * instances;
+
+	__sync_add_and_fetch(&shared->metadata.arrived, 1);
+	while (opt_do_run && !shared->metadata.departed &&
+	       (shared->metadata.arrived < target))
+		(void)usleep(100);
+
+	return opt_do_run && !shared->metadata.departed;
+}
+
+/*
+ *  metadata_phase()
+ *	run one phase over the first n files, returns the number
+ *	of files done, fewer than n if the run stopped
+ */
+static uint64_t metadata_phase(
+	const char *name,
+	const int layout,
+	const int phase,
+	const char *private_dir,
+	const char *shared_dir,
+	const uint32_t instance,
+	uint64_t n,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	uint64_t i;
+
+	for (i = 0; i < n; i++) {
+		char path[PATH_MAX], newpath[PATH_MAX];
+		struct stat statbuf;
+		int fd;
+
+		if (!opt_do_run || (max_ops && *counter >= max_ops))
+			break;
+		metadata_filename(path, sizeof(path), layout, private_dir,
+			shared_dir, instance, i, phase == PHASE_UNLINK);
+
+		switch (phase) {
+		case PHASE_CREATE:
+			fd = open(path, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+			if (fd < 0) {
+				if ((errno != ENOSPC) && (errno != EDQUOT))
+					pr_fail_err(name, "open");
+				return i;
+			}
+			(void)close(fd);
+			break;
+		case PHASE_STAT:
+			if (stat(path, &statbuf) < 0)
+				pr_fail_err(name, "stat");
+			break;
+		case PHASE_RENAME:
+			metadata_filename(newpath, sizeof(newpath), layout,
+				private_dir, shared_dir, instance, i, true);
+			if (rename(path, newpath) < 0)
+				pr_fail_err(name, "rename");
+			break;
+		default:
+			if (unlink(path) < 0)
+				pr_fail_err(name, "unlink");
+			break;
+		}
+		(*counter)++;
+	}
+	return i;
+}
+
+/*
+ *  metadata_record()
+ *	add an instance's phase ops and the phase wall clock time
+ *	to the shared totals
+ */
+static void metadata_record(
+	const int layout,
+	const int phase,
+	const uint64_t ops,
+	const double duration)
+{
+	metadata_phase_t *mp = &shared->metadata.phase[layout][phase];
+
+	__sync_fetch_and_add(&mp->ops, ops);
+	__sync_fetch_and_add(&mp->nsec, (uint64_t)(duration * 1000000000.0));
+	__sync_fetch_and_add(&mp->records, 1);
+}
+
+/*
+ *  metadata_cleanup()
+ *	remove any files left by an interrupted round
+ */
+static void metadata_cleanup(
+	const int layout,
+	const char *private_dir,
+	const char *shared_dir,
+	const uint32_t instance,
+	const uint64_t n)
+{
+	uint64_t i;
+
+	for (i = 0; i < n; i++) {
+		char path[PATH_MAX];
+
+		metadata_filename(path, sizeof(path), layout, private_dir,
+			shared_dir, instance, i, false);
+		(void)unlink(path);
+		metadata_filename(path, sizeof(path), layout, private_dir,
+			shared_dir, instance, i, true);
+		(void)unlink(path);
+	}
+}
+
+/*
+ *  stress_metadata()
+ *	mdtest style create, stat, rename and unlink phases with
+ *	all instances in lock step, in private directories, one
+ *	shared directory or a shared deep directory tree
+ */
+int stress_metadata(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const pid_t pid = getpid();
+	const uint32_t instances = (uint32_t)stressor_instances(STRESS_METADATA);
+	char private_dir[PATH_MAX], shared_dir[PATH_MAX];
+	double rate[METADATA_LAYOUTS][METADATA_PHASES];
+	uint32_t rounds[METADATA_LAYOUTS], barriers = 0;
+	int layout, phase, ret, rc = EXIT_SUCCESS;
+	uint64_t n = 0;
+	size_t idx = 0;
+	bool done = false;
+
+	(void)memset(rate, 0, sizeof(rate));
+	(void)memset(rounds, 0, sizeof(rounds));
+	if (instance == 0)
+		shared->metadata.instances = instances;
+
+	ret = stress_temp_dir_mk(name, pid, instance);
+	if (ret < 0)
+		return exit_status(-ret);
+	(void)stress_temp_dir(private_dir, sizeof(private_dir), name, pid, instance);
+
+	/* The stress-ng parent pid names the directory all instances use */
+	(void)stress_temp_dir(shared_dir, sizeof(shared_dir), name, getppid(), 0);
+	if ((mkdir(shared_dir, S_IRWXU) < 0) && (errno != EEXIST)) {
+		pr_fail_err(name, "mkdir");
+		rc = exit_status(errno);
+		goto tidy_private;
+	}
+	if (((opt_metadata_layout == METADATA_LAYOUT_ALL) ||
+	     (opt_metadata_layout == LAYOUT_TREE)) &&
+	    (metadata_tree_mk(name, shared_dir) < 0)) {
+		rc = EXIT_FAILURE;
+		goto tidy;
+	}
+
+	while (!done) {
+		for (layout = 0; layout < METADATA_LAYOUTS; layout++) {
+			if ((opt_metadata_layout != METADATA_LAYOUT_ALL) &&
+			    (opt_metadata_layout != layout))
+				continue;
+
+			double r[METADATA_PHASES];
+
+			n = opt_metadata_files;
+			for (phase = 0; phase < METADATA_PHASES; phase++) {
+				double t;
+				uint64_t done_ops;
+
+				if (!metadata_barrier(&barriers, instances)) {
+					done = true;
+					break;
+				}
+				t = time_now();
+				done_ops = metadata_phase(name, layout, phase,
+					private_dir, shared_dir, instance, n,
+					counter, max_ops);
+				if (!opt_do_run || (max_ops && *counter >= max_ops)) {
+					done = true;
+					break;
+				}
+				/*
+				 *  The phase is over when the slowest instance
+				 *  finishes, so time it to the next barrier
+				 */
+				if (!metadata_barrier(&barriers, instances)) {
+					done = true;
+					break;
+				}
+				t = time_now() - t;
+				/* Later phases work on the files created */
+				n = done_ops;
+				metadata_record(layout, phase, done_ops, t);
+				r[phase] = (t > 0.0) ? (double)done_ops / t : 0.0;
+			}
+			if (done) {
+				metadata_cleanup(layout, private_dir, shared_dir,
+					instance, opt_metadata_files);
+				break;
+			}
+			for (phase = 0; phase < METADATA_PHASES; phase++)
+				rate[layout][phase] += r[phase];
+			rounds[layout]++;
+		}
+	}
+	/* Release any instances waiting for this one at a barrier */
+	__sync_add_and_fetch(&shared->metadata.departed, 1);
+
+	for (layout = 0; layout < METADATA_LAYOUTS; layout++) {
+		if (!rounds[layout])
+			continue;
+		for (phase = 0; phase < METADATA_PHASES; phase++) {
+			char desc[40];
+
+			/* Keep within the metrics slots when running all */
+			if ((opt_metadata_layout == METADATA_LAYOUT_ALL) &&
+			    (phase != PHASE_CREATE) && (phase != PHASE_UNLINK))
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s %s ops/s",
+				metadata_layouts[layout], metadata_phases[phase]);
+			stress_misc_metric_set(idx++, desc,
+				rate[layout][phase] / (double)rounds[layout]);
+		}
+	}
+tidy:
+	metadata_tree_rm(shared_dir);
+	(void)rmdir(shared_dir);
+tidy_private:
+	(void)stress_temp_dir_rm(name, pid, instance);
+
+	return rc;
+}
+
+/*
+ *  stress_metadata_dump()
+ *	report the ops/s of all instances together for each phase,
+ *	shared directory rates well below the private ones show
+ *	the filesystem serialising on the directory
+ */
+void stress_metadata_dump(FILE *yaml, json_t *json)
+{
+	const uint32_t instances = shared->metadata.instances;
+	bool dumped_heading = false;
+	size_t layout, phase;
+
+	for (layout = 0; layout < METADATA_LAYOUTS; layout++) {
+		double rate[METADATA_PHASES];
+		char line[128];
+		int len;
+
+		for (phase = 0; phase < METADATA_PHASES; phase++) {
+			const metadata_phase_t *mp =
+				&shared->metadata.phase[layout][phase];
+
+			/* All ops over the mean phase wall clock time */
+			rate[phase] = mp->nsec ? (double)mp->ops *
+				(double)mp->records * 1000000000.0 /
+				(double)mp->nsec : 0.0;
+		}
+		if (rate[PHASE_CREATE] <= 0.0)
+			continue;
+
+		if (!dumped_heading) {
+			pr_inf(stdout, "%-13s %-8s %12s %12s %12s %12s\n",
+				"metadata", "layout", "create/s", "stat/s",
+				"rename/s", "unlink/s");
+			pr_inf(stdout, "%-13s %-8s %12s\n", "", "",
+				"(total)");
+			pr_yaml(yaml, "metadata:\n");
+			json_array_begin(json, "metadata");
+			dumped_heading = true;
+		}
+		len = snprintf(line, sizeof(line), "%-13s %-8s", "",
+			metadata_layouts[layout]);
+		pr_yaml(yaml, "    - layout: %s\n", metadata_layouts[layout]);
+		pr_yaml(yaml, "      instances: %" PRIu32 "\n", instances);
+		json_obj_begin(json, NULL);
+		json_str(json, "layout", metadata_layouts[layout]);
+		json_uint(json, "instances", instances);
+		for (phase = 0; phase < METADATA_PHASES; phase++) {
+			char key[32];
+
+			len += snprintf(line + len, sizeof(line) - len, " %12.1f",
+				rate[phase]);
+			(void)snprintf(key, sizeof(key), "%s-ops-per-second",
+				metadata_phases[phase]);
+			pr_yaml(yaml, "      %s: %f\n", key, rate[phase]);
+			json_double(json, key, rate[phase]);
+		}
+		json_obj_end(json);
+		pr_inf(stdout, "%s\n", line);
+	}
+	if (dumped_heading) {
+		pr_yaml(yaml, "\n");
+		json_array_end(json);
+	}
+}
@@ -32,15 +32,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <signal.h>
 
 #define MLOCK_MAX	(256*1024)
 
+#define MLOCK_HOLD_TIME		(1.0)		/* secs held locked or not */
+#define MLOCK_FUTURE_MAPS	(256)		/* maps timed per mlockall mode */
+#define MLOCK_FUTURE_SIZE	(64 * KB)	/* size of each of these */
+
+/* system wide memory stall and direct reclaim counters */
+typedef struct {
+	uint64_t psi_some;		/* memory some stall, usec */
+	uint64_t allocstall;		/* direct reclaim entries */
+	uint64_t pgscan_direct;		/* pages scanned by direct reclaim */
+} mlock_pressure_t;
+
+static uint64_t opt_mlock_bytes = DEFAULT_MLOCK_BYTES;
+static bool opt_mlock_cost = false;
+
+void stress_set_mlock_bytes(const char *optarg)
+{
+	opt_mlock_bytes = get_uint64_byte(optarg);
+	check_range("mlock-bytes", opt_mlock_bytes,
+		MIN_MLOCK_BYTES, MAX_MLOCK_BYTES);
+}
+
+void stress_set_mlock_cost(void)
+{
+	opt_mlock_cost = true;
+}
+
 #if defined(__NR_mlock2)
 
 #ifndef MLOCK_ONFAULT
@@ -92,6 +120,239 @@ static inline int mlock_shim(const void *addr, size_t len)
 #endif
 
 
+#if defined(__linux__) && !defined(__gnu_hurd__)
+/*
+ *  mlock_pressure()
+ *	read the memory PSI stall time and the direct reclaim
+ *	counters, fields that cannot be read are left as 0
+ */
+static void mlock_pressure(mlock_pressure_t *p)
+{
+	char buf[256];
+	FILE *fp;
+	const char *ptr;
+
+	memset(p, 0, sizeof(*p));
+	if ((system_read("/proc/pressure/memory", buf, sizeof(buf) - 1) > 0) &&
+	    ((ptr = strstr(buf, "total=")) != NULL))
+		(void)sscanf(ptr + 6, "%" SCNu64, &p->psi_some);
+
+	fp = fopen("/proc/vmstat", "r");
+	if (!fp)
+		return;
+	while (fgets(buf, sizeof(buf), fp)) {
+		uint64_t val;
+
+		/* allocstall_dma, allocstall_normal.. and pgscan_direct */
+		if ((sscanf(buf, "allocstall%*[_a-z] %" SCNu64, &val) == 1) ||
+		    (sscanf(buf, "allocstall %" SCNu64, &val) == 1))
+			p->allocstall += val;
+		else if (sscanf(buf, "pgscan_direct %" SCNu64, &val) == 1)
+			p->pgscan_direct += val;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  mlock_hold()
+ *	wait for a hold period and return the system memory
+ *	stalls and direct reclaim during it, per second
+ */
+static bool mlock_hold(double *psi_ms, double *stalls)
+{
+	mlock_pressure_t before, after;
+	double t_start, duration;
+
+	mlock_pressure(&before);
+	t_start = time_now();
+	while (opt_do_run && (time_now() - t_start < MLOCK_HOLD_TIME))
+		(void)usleep(10000);
+	duration = time_now() - t_start;
+	mlock_pressure(&after);
+	if (!opt_do_run || (duration <= 0.0))
+		return false;
+
+	*psi_ms = ((double)(after.psi_some - before.psi_some) / 1000.0) / duration;
+	*stalls = (double)(after.allocstall - before.allocstall) / duration;
+	return true;
+}
+
+/*
+ *  mlock_future_maps()
+ *	time to map, touch and unmap small regions, with
+ *	mlockall(MCL_FUTURE) each map is populated and locked
+ */
+static double mlock_future_maps(const size_t page_size)
+{
+	double t_start;
+	size_t i, j;
+
+	t_start = time_now();
+	for (i = 0; i < MLOCK_FUTURE_MAPS; i++) {
+		uint8_t *ptr;
+
+		ptr = (uint8_t *)mmap(NULL, MLOCK_FUTURE_SIZE,
+			PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED)
+			return -1.0;
+		for (j = 0; j < MLOCK_FUTURE_SIZE; j += page_size)
+			ptr[j] = (uint8_t)j;
+		(void)munmap((void *)ptr, MLOCK_FUTURE_SIZE);
+	}
+	return (time_now() - t_start) / (double)MLOCK_FUTURE_MAPS;
+}
+
+/*
+ *  stress_mlock_cost()
+ *	measure what locking memory costs: the time to mlock
+ *	and munlock --mlock-bytes, mlock2(MLOCK_ONFAULT) and
+ *	then faulting the pages in, the system memory stalls
+ *	and direct reclaim while the memory is held locked
+ *	compared with not locked, and the mmap overhead of
+ *	mlockall(MCL_FUTURE). The metrics are updated every
+ *	round as the parent kills this child at the end
+ */
+static void stress_mlock_cost(
+	const char *name,
+	const uint32_t instance,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const size_t page_size = stress_get_pagesize();
+	size_t len = (size_t)opt_mlock_bytes & ~(page_size - 1);
+	struct rlimit rlim;
+	bool reported = false;
+
+	/* unprivileged locking is capped by RLIMIT_MEMLOCK */
+	if ((geteuid() != 0) && (getrlimit(RLIMIT_MEMLOCK, &rlim) == 0) &&
+	    (rlim.rlim_cur != RLIM_INFINITY) && (rlim.rlim_cur < len)) {
+		rlim.rlim_cur = rlim.rlim_max;
+		(void)setrlimit(RLIMIT_MEMLOCK, &rlim);
+		if ((getrlimit(RLIMIT_MEMLOCK, &rlim) == 0) &&
+		    (rlim.rlim_cur != RLIM_INFINITY) && (rlim.rlim_cur < len)) {
+			len = (size_t)rlim.rlim_cur & ~(page_size - 1);
+			if (instance == 0)
+				pr_inf(stderr, "%s: RLIMIT_MEMLOCK limits "
+					"locking to %zu KB\n", name, (size_t)(len / KB));
+		}
+	}
+	if (len < page_size) {
+		pr_inf(stderr, "%s: cannot lock any memory, skipping "
+			"the cost measurements\n", name);
+		return;
+	}
+
+	do {
+		double t, lock_t, unlock_t, onfault_t = 0.0, fault_t = 0.0;
+		double psi_locked, psi_unlocked, stalls_locked, stalls_unlocked;
+		double map_plain, map_future, map_onfault = -1.0;
+		uint8_t *buf;
+		size_t i;
+
+		/* mlock populates and locks all the pages up front */
+		buf = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+			break;
+		t = time_now();
+		if (mlock((void *)buf, len) < 0) {
+			pr_inf(stderr, "%s: mlock of %zu KB failed: errno=%d (%s)\n",
+				name, (size_t)(len / KB), errno, strerror(errno));
+			(void)munmap((void *)buf, len);
+			break;
+		}
+		lock_t = time_now() - t;
+
+		/* hold it locked, then unlocked, and watch the system */
+		if (!mlock_hold(&psi_locked, &stalls_locked)) {
+			(void)munmap((void *)buf, len);
+			break;
+		}
+		t = time_now();
+		(void)munlock((void *)buf, len);
+		unlock_t = time_now() - t;
+		if (!mlock_hold(&psi_unlocked, &stalls_unlocked)) {
+			(void)munmap((void *)buf, len);
+			break;
+		}
+		(void)munmap((void *)buf, len);
+
+#if defined(__NR_mlock2)
+		/* MLOCK_ONFAULT only marks the VMA, the faults lock */
+		buf = (uint8_t *)mmap(NULL, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+			break;
+		t = time_now();
+		if (sys_mlock2(buf, len, MLOCK_ONFAULT) == 0) {
+			onfault_t = time_now() - t;
+			t = time_now();
+			for (i = 0; i < len; i += page_size)
+				buf[i] = (uint8_t)i;
+			fault_t = time_now() - t;
+			(void)munlock((void *)buf, len);
+		}
+		(void)munmap((void *)buf, len);
+#endif
+
+		map_plain = mlock_future_maps(page_size);
+		map_future = -1.0;
+		if (mlockall(MCL_FUTURE) == 0) {
+			map_future = mlock_future_maps(page_size);
+			(void)munlockall();
+		}
+#if defined(MCL_ONFAULT)
+		if (mlockall(MCL_FUTURE | MCL_ONFAULT) == 0) {
+			map_onfault = mlock_future_maps(page_size);
+			(void)munlockall();
+		}
+#endif
+		(*counter)++;
+
+		if ((instance == 0) && !reported) {
+			const double mb = (double)len / (double)MB;
+
+			pr_inf(stderr, "%s: mlock %.1f MB %.2f ms (%.2f MB/sec), "
+				"munlock %.2f ms\n", name, mb, lock_t * 1000.0,
+				lock_t > 0.0 ? mb / lock_t : 0.0, unlock_t * 1000.0);
+			if (onfault_t > 0.0)
+				pr_inf(stderr, "%s: mlock2 MLOCK_ONFAULT %.2f us, "
+					"faulting in %.2f ms (%.2f MB/sec)\n", name,
+					onfault_t * 1000000.0, fault_t * 1000.0,
+					fault_t > 0.0 ? mb / fault_t : 0.0);
+			pr_inf(stderr, "%s: memory stalls %.2f ms/sec and %.1f "
+				"direct reclaims/sec with %.1f MB locked, "
+				"%.2f ms/sec and %.1f/sec without\n", name,
+				psi_locked, stalls_locked, mb,
+				psi_unlocked, stalls_unlocked);
+			pr_inf(stderr, "%s: map+touch+unmap of %zu KB %.2f us, "
+				"%.2f us with MCL_FUTURE, %.2f us with "
+				"MCL_FUTURE|MCL_ONFAULT\n", name,
+				(size_t)(MLOCK_FUTURE_SIZE / KB),
+				map_plain * 1000000.0, map_future * 1000000.0,
+				map_onfault * 1000000.0);
+			reported = true;
+		}
+
+		if (lock_t > 0.0)
+			stress_misc_metric_set(0, "mlock MB per sec",
+				((double)len / (double)MB) / lock_t);
+		if (unlock_t > 0.0)
+			stress_misc_metric_set(1, "munlock MB per sec",
+				((double)len / (double)MB) / unlock_t);
+		if (fault_t > 0.0)
+			stress_misc_metric_set(2, "MLOCK_ONFAULT fault MB per sec",
+				((double)len / (double)MB) / fault_t);
+		stress_misc_metric_set(3, "mem stall ms/sec locked", psi_locked);
+		stress_misc_metric_set(4, "mem stall ms/sec unlocked", psi_unlocked);
+		if ((map_plain > 0.0) && (map_future > 0.0))
+			stress_misc_metric_set(5, "MCL_FUTURE mmap slowdown x",
+				map_future / map_plain);
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+}
+#endif
+
 /*
  *  stress_mlock()
  *	stress mlock with pages being locked/unlocked
@@ -163,6 +424,16 @@ again:
 		/* Make sure this is killable by OOM killer */
 		set_oom_adjustment(name, true);
 
+		if (opt_mlock_cost) {
+#if defined(__linux__) && !defined(__gnu_hurd__)
+			stress_mlock_cost(name, instance, counter, max_ops);
+			goto free_mappings;
+#else
+			pr_inf(stderr, "%s: --mlock-cost is not supported, "
+				"using the default mode\n", name);
+#endif
+		}
+
 		do {
 			for (n = 0; opt_do_run && (n < max); n++) {
 				int ret;
@@ -229,6 +500,9 @@ again:
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
 	}
 
+#if defined(__linux__) && !defined(__gnu_hurd__)
+free_mappings:
+#endif
 	free(mappings);
 
 	return EXIT_SUCCESS;
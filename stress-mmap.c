@@ -43,6 +43,42 @@
 static size_t opt_mmap_bytes = DEFAULT_MMAP_BYTES;
 static bool set_mmap_bytes = false;
 
+#define MMAP_PREFAULT_LAZY		(0)	/* fault pages in on first touch */
+#define MMAP_PREFAULT_POPULATE		(1)	/* mmap with MAP_POPULATE */
+#define MMAP_PREFAULT_WILLNEED		(2)	/* madvise MADV_WILLNEED */
+#define MMAP_PREFAULT_POPULATE_WRITE	(3)	/* madvise MADV_POPULATE_WRITE */
+#define MMAP_PREFAULT_MLOCK		(4)	/* mlock the mapping */
+#define MMAP_PREFAULT_MAX		(5)
+#define MMAP_PREFAULT_ALL		(MMAP_PREFAULT_MAX)
+#define MMAP_PREFAULT_NONE		(-1)
+
+#define MMAP_PREFAULT_STEADY_PASSES	(3)	/* passes after the first */
+
+typedef struct {
+	const char *name;	/* User option */
+	int strategy;		/* MMAP_PREFAULT_ value */
+} mmap_prefault_t;
+
+static const mmap_prefault_t mmap_prefaults[] = {
+	{ "lazy",		MMAP_PREFAULT_LAZY },
+	{ "populate",		MMAP_PREFAULT_POPULATE },
+	{ "willneed",		MMAP_PREFAULT_WILLNEED },
+	{ "populate-write",	MMAP_PREFAULT_POPULATE_WRITE },
+	{ "mlock",		MMAP_PREFAULT_MLOCK },
+	{ "all",		MMAP_PREFAULT_ALL },
+};
+
+/* Accumulated timings of a prefault strategy */
+typedef struct {
+	uint64_t rounds;	/* rounds measured */
+	double setup;		/* mmap and prefault time */
+	double first;		/* mmap until the end of the first pass */
+	double steady;		/* time of the passes after the first */
+	bool skipped;		/* strategy not supported here */
+} mmap_prefault_stats_t;
+
+static int opt_mmap_prefault = MMAP_PREFAULT_NONE;
+
 /* Misc randomly chosen mmap flags */
 static int mmap_flags[] = {
 #if defined(MAP_HUGE_2MB) && defined(MAP_HUGETLB)
@@ -78,6 +114,39 @@ void stress_set_mmap_bytes(const char *optarg)
 		MIN_MMAP_BYTES, MAX_MMAP_BYTES);
 }
 
+/*
+ *  stress_set_mmap_prefault()
+ *	set the strategy used to prefault the mapping
+ */
+int stress_set_mmap_prefault(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(mmap_prefaults); i++) {
+		if (!strcmp(name, mmap_prefaults[i].name)) {
+			opt_mmap_prefault = mmap_prefaults[i].strategy;
+			return 0;
+		}
+	}
+	fprintf(stderr, "mmap-prefault must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(mmap_prefaults); i++)
+		fprintf(stderr, " %s", mmap_prefaults[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_mmap_hugepages()
+ *	the pages are unmapped and remapped one by one, which
+ *	hugetlbfs mappings can't do, so --hugepages 2M and 1G
+ *	use transparent huge pages here
+ */
+static inline hugepages_t stress_mmap_hugepages(void)
+{
+	return (stress_get_hugepages() == HUGEPAGES_NONE) ?
+		HUGEPAGES_NONE : HUGEPAGES_THP;
+}
+
 /*
  *  stress_mmap_check()
  *	check if mmap'd data is sane
@@ -147,6 +216,165 @@ static void stress_mmap_mprotect(const char *name, void *addr, const size_t len)
 #endif
 }
 
+/*
+ *  stress_mmap_prefault_map()
+ *	map sz bytes and prefault them with the given strategy,
+ *	returns MAP_FAILED if the strategy can't be used
+ */
+static uint8_t *stress_mmap_prefault_map(
+	const char *name,
+	const int strategy,
+	const int fd,
+	const int flags,
+	const size_t sz)
+{
+	uint8_t *buf;
+	int map_flags = flags;
+
+#if defined(MAP_POPULATE)
+	map_flags &= ~MAP_POPULATE;
+	if (strategy == MMAP_PREFAULT_POPULATE)
+		map_flags |= MAP_POPULATE;
+#else
+	if (strategy == MMAP_PREFAULT_POPULATE)
+		return MAP_FAILED;
+#endif
+	buf = (uint8_t *)mmap(NULL, sz, PROT_READ | PROT_WRITE, map_flags, fd, 0);
+	if (buf == MAP_FAILED)
+		return MAP_FAILED;
+
+	switch (strategy) {
+	case MMAP_PREFAULT_WILLNEED:
+#if defined(MADV_WILLNEED)
+		if (madvise(buf, sz, MADV_WILLNEED) == 0)
+			return buf;
+#endif
+		break;
+	case MMAP_PREFAULT_POPULATE_WRITE:
+#if defined(MADV_POPULATE_WRITE)
+		if (madvise(buf, sz, MADV_POPULATE_WRITE) == 0)
+			return buf;
+#endif
+		break;
+	case MMAP_PREFAULT_MLOCK:
+#if !defined(__gnu_hurd__)
+		if (mlock(buf, sz) == 0)
+			return buf;
+#endif
+		break;
+	default:
+		return buf;
+	}
+	pr_dbg(stderr, "%s: prefault with %s failed, errno=%d (%s), skipping it\n",
+		name, mmap_prefaults[strategy].name, errno, strerror(errno));
+	(void)munmap((void *)buf, sz);
+	return MAP_FAILED;
+}
+
+/*
+ *  stress_mmap_prefault()
+ *	compare ways of prefaulting a mapping: for each strategy
+ *	measure the time from mmap until the first full write pass
+ *	completes and the time of the passes that follow
+ */
+static void stress_mmap_prefault(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const int fd,
+	const int flags,
+	const size_t sz)
+{
+	mmap_prefault_stats_t stats[MMAP_PREFAULT_MAX];
+	bool reported = false;
+	int strategy;
+
+	memset(stats, 0, sizeof(stats));
+	do {
+		for (strategy = 0; strategy < MMAP_PREFAULT_MAX; strategy++) {
+			mmap_prefault_stats_t *s = &stats[strategy];
+			uint8_t *buf;
+			double t_start, t_setup, t_first, t_end;
+			int i;
+
+			if ((opt_mmap_prefault != MMAP_PREFAULT_ALL) &&
+			    (opt_mmap_prefault != strategy))
+				continue;
+			if (s->skipped)
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				break;
+
+			if (fd >= 0) {
+				/* Start each strategy with a cold page cache */
+				(void)fdatasync(fd);
+#if defined(POSIX_FADV_DONTNEED)
+				(void)posix_fadvise(fd, 0, (off_t)sz, POSIX_FADV_DONTNEED);
+#endif
+			}
+			t_start = time_now();
+			buf = stress_mmap_prefault_map(name, strategy, fd, flags, sz);
+			if (buf == MAP_FAILED) {
+				s->skipped = true;
+				continue;
+			}
+			t_setup = time_now();
+			memset(buf, 0xff, sz);
+			t_first = time_now();
+			for (i = 0; i < MMAP_PREFAULT_STEADY_PASSES; i++)
+				memset(buf, i, sz);
+			t_end = time_now();
+			(void)munmap((void *)buf, sz);
+
+			s->setup += t_setup - t_start;
+			s->first += t_first - t_start;
+			s->steady += (t_end - t_first) / MMAP_PREFAULT_STEADY_PASSES;
+			s->rounds++;
+			(*counter)++;
+		}
+
+		/*
+		 *  The parent kills this child when the run ends,
+		 *  so keep the metrics up to date after each round
+		 */
+		for (strategy = 0; strategy < MMAP_PREFAULT_MAX; strategy++) {
+			const mmap_prefault_stats_t *s = &stats[strategy];
+			char desc[40];
+
+			if (!s->rounds)
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s first pass ms",
+				mmap_prefaults[strategy].name);
+			stress_misc_metric_set(strategy * 2, desc,
+				1000.0 * s->first / (double)s->rounds);
+			(void)snprintf(desc, sizeof(desc), "%s steady pass ms",
+				mmap_prefaults[strategy].name);
+			stress_misc_metric_set((strategy * 2) + 1, desc,
+				1000.0 * s->steady / (double)s->rounds);
+		}
+
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %14s %10s %14s %14s (%zu MB %s)\n",
+				name, "prefault", "setup ms", "first pass ms",
+				"steady pass ms", (size_t)(sz / MB),
+				(fd >= 0) ? "file" : "anonymous");
+			for (strategy = 0; strategy < MMAP_PREFAULT_MAX; strategy++) {
+				const mmap_prefault_stats_t *s = &stats[strategy];
+
+				if (!s->rounds)
+					continue;
+				pr_inf(stderr, "%s: %14s %10.2f %14.2f %14.2f\n",
+					name, mmap_prefaults[strategy].name,
+					1000.0 * s->setup / (double)s->rounds,
+					1000.0 * s->first / (double)s->rounds,
+					1000.0 * s->steady / (double)s->rounds);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+}
+
 static void stress_mmap_child(
 	uint64_t *const counter,
 	const uint64_t max_ops,
@@ -158,10 +386,14 @@ static void stress_mmap_child(
 	const size_t pages4k)
 {
 	int no_mem_retries = 0;
+	const hugepages_t hugepages = stress_mmap_hugepages();
 #if !defined(__gnu_hurd__) && !defined(__minix__)
 	const int ms_flags = (opt_flags & OPT_FLAGS_MMAP_ASYNC) ?
 		MS_ASYNC : MS_SYNC;
 #endif
+	mincore_residency_t residency;
+
+	mincore_residency_init(&residency);
 
 	do {
 		uint8_t mapped[pages4k];
@@ -179,8 +411,8 @@ static void stress_mmap_child(
 
 		if (!opt_do_run)
 			break;
-		buf = (uint8_t *)mmap(NULL, sz,
-			PROT_READ | PROT_WRITE, *flags | rnd_flag, fd, 0);
+		buf = (uint8_t *)mmap_hugepages(hugepages, sz,
+			PROT_READ | PROT_WRITE, *flags | rnd_flag, fd);
 		if (buf == MAP_FAILED) {
 			/* Force MAP_POPULATE off, just in case */
 #ifdef MAP_POPULATE
@@ -198,7 +430,7 @@ static void stress_mmap_child(
 #endif
 		}
 		(void)madvise_random(buf, sz);
-		(void)mincore_touch_pages(buf, opt_mmap_bytes);
+		(void)mincore_touch_pages(buf, sz);
 		stress_mmap_mprotect(name, buf, sz);
 		memset(mapped, PAGE_MAPPED, sizeof(mapped));
 		for (n = 0; n < pages4k; n++)
@@ -206,16 +438,19 @@ static void stress_mmap_child(
 
 		/* Ensure we can write to the mapped pages */
 		stress_mmap_set(buf, sz, page_size);
+		if (hugepages != HUGEPAGES_NONE)
+			hugepages_metric_set(hugepages_mapped(buf, sz));
 		if (opt_flags & OPT_FLAGS_VERIFY) {
 			if (stress_mmap_check(buf, sz, page_size) < 0)
 				pr_fail(stderr, "%s: mmap'd region of %zu bytes does "
 					"not contain expected data\n", name, sz);
 		}
+		mincore_residency_sample(&residency, buf, sz);
 
 		/*
 		 *  Step #1, unmap all pages in random order
 		 */
-		(void)mincore_touch_pages(buf, opt_mmap_bytes);
+		(void)mincore_touch_pages(buf, sz);
 		for (n = pages4k; n; ) {
 			uint64_t j, i = mwc64() % pages4k;
 			for (j = 0; j < n; j++) {
@@ -292,6 +527,8 @@ cleanup:
 		}
 		(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	mincore_residency_metrics_set(&residency);
 }
 
 /*
@@ -305,7 +542,7 @@ int stress_mmap(
 	const char *name)
 {
 	const size_t page_size = stress_get_pagesize();
-	size_t sz, pages4k;
+	size_t sz, pages4k, mmap_bytes = opt_mmap_bytes;
 	const pid_t mypid = getpid();
 	pid_t pid;
 	int fd = -1, flags = MAP_PRIVATE | MAP_ANONYMOUS;
@@ -317,11 +554,12 @@ int stress_mmap(
 #endif
 	if (!set_mmap_bytes) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
-			opt_mmap_bytes = MAX_MMAP_BYTES;
+			mmap_bytes = MAX_MMAP_BYTES;
 		if (opt_flags & OPT_FLAGS_MINIMIZE)
-			opt_mmap_bytes = MIN_MMAP_BYTES;
+			mmap_bytes = MIN_MMAP_BYTES;
 	}
-	sz = opt_mmap_bytes & ~(page_size - 1);
+	sz = hugepages_round(stress_mmap_hugepages(),
+		mmap_bytes & ~(page_size - 1));
 	pages4k = sz / page_size;
 
 	/* Make sure this is killable by OOM killer */
@@ -371,6 +609,18 @@ redo:
 		flags |= MAP_SHARED;
 	}
 
+	if (stress_thread_instance) {
+		/*
+		 *  A thread shares the mm of its siblings, there is no
+		 *  child to restart on OOM, SIGSEGV or SIGBUS
+		 */
+		if (opt_mmap_prefault != MMAP_PREFAULT_NONE)
+			stress_mmap_prefault(counter, instance, max_ops,
+				name, fd, flags, sz);
+		else
+			stress_mmap_child(counter, max_ops, name, fd, &flags, page_size, sz, pages4k);
+		goto cleanup;
+	}
 again:
 	if (!opt_do_run)
 		goto cleanup;
@@ -431,7 +681,11 @@ again:
 		/* Make sure this is killable by OOM killer */
 		set_oom_adjustment(name, true);
 
-		stress_mmap_child(counter, max_ops, name, fd, &flags, page_size, sz, pages4k);
+		if (opt_mmap_prefault != MMAP_PREFAULT_NONE)
+			stress_mmap_prefault(counter, instance, max_ops,
+				name, fd, flags, sz);
+		else
+			stress_mmap_child(counter, max_ops, name, fd, &flags, page_size, sz, pages4k);
 	}
 
 cleanup:
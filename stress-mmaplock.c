@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_MMAPLOCK)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+
+#define MMAPLOCK_PHASE_TIME	(1.0)	/* seconds per thread count */
+#define MMAPLOCK_FAULT_PAGES	(64)	/* pages faulted per thread sweep */
+#define MMAPLOCK_MAP_PAGES	(4)	/* pages of each mmap/mprotect/munmap */
+#define MMAPLOCK_PHASES_MAX	(16)	/* 1, 2, 4 .. threads */
+
+/* A worker thread, faulting and mapping its own ranges */
+typedef struct {
+	pthread_t pthread;		/* the thread */
+	int ret;			/* pthread_create return */
+	uint8_t *slice;			/* pages of the shared region */
+	uint64_t faults;		/* pages faulted in this phase */
+	uint64_t maps;			/* map cycles in this phase */
+	uint64_t errors;		/* failed mmap/mprotect calls */
+} mmaplock_thread_t;
+
+/* Throughput of one thread count */
+typedef struct {
+	uint32_t threads;		/* threads of the phase */
+	double faults;			/* page faults per second */
+	double maps;			/* map cycles per second */
+	uint32_t runs;			/* phases summed */
+} mmaplock_phase_t;
+
+static struct {
+	bool run;			/* threads keep on running */
+	bool go;			/* all threads at the start line */
+	uint32_t started;		/* threads at the start line */
+	size_t page_size;
+} mmaplock_ctl;
+
+static uint32_t opt_mmaplock_threads = DEFAULT_MMAPLOCK_THREADS;
+
+void stress_set_mmaplock_threads(const char *optarg)
+{
+	opt_mmaplock_threads = (uint32_t)get_uint64(optarg);
+	check_range("mmaplock-threads", opt_mmaplock_threads,
+		MIN_MMAPLOCK_THREADS, MAX_MMAPLOCK_THREADS);
+}
+
+/*
+ *  mmaplock_thread()
+ *	fault in a slice of the shared region after dropping it,
+ *	a read side (or per-VMA) fault per page, then map, split
+ *	with mprotect and unmap a private range, write side ops
+ *	on the mmap_lock of the one mm all the threads share
+ */
+static void *mmaplock_thread(void *arg)
+{
+	static void *nowt = NULL;
+	mmaplock_thread_t *t = (mmaplock_thread_t *)arg;
+	const size_t page_size = mmaplock_ctl.page_size;
+	const size_t slice_size = MMAPLOCK_FAULT_PAGES * page_size;
+	const size_t map_size = MMAPLOCK_MAP_PAGES * page_size;
+	uint64_t faults = 0, maps = 0, errors = 0;
+
+	__atomic_add_fetch(&mmaplock_ctl.started, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(&mmaplock_ctl.go, __ATOMIC_ACQUIRE))
+		(void)sched_yield();
+
+	while (__atomic_load_n(&mmaplock_ctl.run, __ATOMIC_RELAXED)) {
+		uint8_t *ptr;
+		size_t i;
+
+		/* Drop the slice so every write below faults again */
+		(void)madvise(t->slice, slice_size, MADV_DONTNEED);
+		for (i = 0; i < slice_size; i += page_size)
+			t->slice[i] = (uint8_t)i;
+		faults += MMAPLOCK_FAULT_PAGES;
+
+		ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED) {
+			errors++;
+		} else {
+			*ptr = 1;
+			/* Split the VMA in three and merge it back */
+			if (mprotect(ptr + page_size, page_size, PROT_READ) < 0)
+				errors++;
+			(void)mprotect(ptr + page_size, page_size,
+				PROT_READ | PROT_WRITE);
+			(void)munmap(ptr, map_size);
+			maps++;
+		}
+		__atomic_store_n(&t->faults, faults, __ATOMIC_RELAXED);
+		__atomic_store_n(&t->maps, maps, __ATOMIC_RELAXED);
+	}
+	t->errors = errors;
+
+	return &nowt;
+}
+
+/*
+ *  mmaplock_phase()
+ *	run a number of threads for a phase, the bogo op
+ *	counter is the number of fault sweeps plus map cycles
+ */
+static void mmaplock_phase(
+	const char *name,
+	const uint32_t nthreads,
+	mmaplock_thread_t *threads,
+	uint8_t *region,
+	mmaplock_phase_t *phase,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const uint64_t base = *counter;
+	const size_t slice_size = MMAPLOCK_FAULT_PAGES * mmaplock_ctl.page_size;
+	uint64_t faults = 0, maps = 0, errors = 0;
+	uint32_t i, started = 0;
+	double t_start, t_end, duration;
+
+	mmaplock_ctl.run = true;
+	mmaplock_ctl.go = false;
+	mmaplock_ctl.started = 0;
+
+	for (i = 0; i < nthreads; i++) {
+		mmaplock_thread_t *t = &threads[i];
+
+		t->faults = 0;
+		t->maps = 0;
+		t->errors = 0;
+		t->slice = region + (i * slice_size);
+		t->ret = pthread_create(&t->pthread, NULL, mmaplock_thread, t);
+		if (t->ret)
+			break;
+		started++;
+	}
+	if (!started) {
+		pr_fail_errno(name, "pthread_create", threads[0].ret);
+		return;
+	}
+	if (started < nthreads)
+		pr_dbg(stderr, "%s: only %" PRIu32 " of %" PRIu32
+			" threads started\n", name, started, nthreads);
+	while (__atomic_load_n(&mmaplock_ctl.started, __ATOMIC_ACQUIRE) < started)
+		(void)sched_yield();
+
+	t_start = time_now();
+	t_end = t_start + MMAPLOCK_PHASE_TIME;
+	__atomic_store_n(&mmaplock_ctl.go, true, __ATOMIC_RELEASE);
+
+	while (opt_do_run && (time_now() < t_end)) {
+		uint64_t total = base;
+
+		(void)usleep(10000);
+		for (i = 0; i < started; i++) {
+			total += __atomic_load_n(&threads[i].faults, __ATOMIC_RELAXED) /
+				MMAPLOCK_FAULT_PAGES;
+			total += __atomic_load_n(&threads[i].maps, __ATOMIC_RELAXED);
+		}
+		*counter = total;
+		if (max_ops && (total >= max_ops))
+			break;
+	}
+	__atomic_store_n(&mmaplock_ctl.run, false, __ATOMIC_RELEASE);
+	for (i = 0; i < started; i++)
+		(void)pthread_join(threads[i].pthread, NULL);
+	duration = time_now() - t_start;
+
+	for (i = 0; i < started; i++) {
+		faults += threads[i].faults;
+		maps += threads[i].maps;
+		errors += threads[i].errors;
+	}
+	*counter = base + (faults / MMAPLOCK_FAULT_PAGES) + maps;
+	if (errors)
+		pr_dbg(stderr, "%s: %" PRIu64 " mmap or mprotect failures "
+			"with %" PRIu32 " threads\n", name, errors, started);
+
+	if (duration > 0.0) {
+		phase->faults += (double)faults / duration;
+		phase->maps += (double)maps / duration;
+		phase->runs++;
+	}
+}
+
+/*
+ *  mmaplock_vma_stats()
+ *	read the per-VMA lock fault counters, only in /proc/vmstat
+ *	with CONFIG_PER_VMA_LOCK_STATS, false if not available
+ */
+static bool mmaplock_vma_stats(uint64_t *success, uint64_t *retry)
+{
+	FILE *fp;
+	char buf[128];
+	bool found = false;
+
+	*success = 0;
+	*retry = 0;
+	fp = fopen("/proc/vmstat", "r");
+	if (!fp)
+		return false;
+	while (fgets(buf, sizeof(buf), fp)) {
+		uint64_t val;
+
+		if (sscanf(buf, "vma_lock_success %" SCNu64, &val) == 1) {
+			*success = val;
+			found = true;
+		} else if (sscanf(buf, "vma_lock_retry %" SCNu64, &val) == 1) {
+			*retry = val;
+		}
+	}
+	(void)fclose(fp);
+
+	return found;
+}
+
+/*
+ *  mmaplock_vma_kernel()
+ *	per-VMA locks for anonymous faults arrived in Linux 6.4
+ */
+static bool mmaplock_vma_kernel(void)
+{
+	struct utsname u;
+	int major, minor;
+
+	if (uname(&u) < 0)
+		return false;
+	if (sscanf(u.release, "%d.%d", &major, &minor) != 2)
+		return false;
+	return (major > 6) || ((major == 6) && (minor >= 4));
+}
+
+/*
+ *  stress_mmaplock()
+ *	stress the mmap_lock of one mm with 1, 2, 4 .. N threads
+ *	faulting and mapping disjoint ranges concurrently, reporting
+ *	the fault and map throughput of each thread count
+ */
+int stress_mmaplock(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	mmaplock_thread_t *threads;
+	mmaplock_phase_t phases[MMAPLOCK_PHASES_MAX];
+	uint32_t nphases = 0, n, p;
+	uint64_t vma_success[2], vma_retry[2];
+	bool vma_stats;
+	size_t region_size;
+	uint8_t *region;
+	const mmaplock_phase_t *first, *last;
+
+	mmaplock_ctl.page_size = stress_get_pagesize();
+	region_size = (size_t)opt_mmaplock_threads * MMAPLOCK_FAULT_PAGES *
+		mmaplock_ctl.page_size;
+
+	/* Thread counts 1, 2, 4 .. ending with opt_mmaplock_threads */
+	memset(phases, 0, sizeof(phases));
+	for (n = 1; nphases < MMAPLOCK_PHASES_MAX; n <<= 1) {
+		if (n > opt_mmaplock_threads)
+			n = opt_mmaplock_threads;
+		phases[nphases++].threads = n;
+		if (n == opt_mmaplock_threads)
+			break;
+	}
+
+	threads = calloc(opt_mmaplock_threads, sizeof(*threads));
+	if (!threads) {
+		pr_inf(stderr, "%s: cannot allocate %" PRIu32 " threads, "
+			"skipping stressor\n", name, opt_mmaplock_threads);
+		return EXIT_NO_RESOURCE;
+	}
+	region = mmap(NULL, region_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot mmap %zu bytes, skipping stressor\n",
+			name, region_size);
+		free(threads);
+		return EXIT_NO_RESOURCE;
+	}
+
+	vma_stats = mmaplock_vma_stats(&vma_success[0], &vma_retry[0]);
+	do {
+		for (p = 0; p < nphases; p++) {
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			mmaplock_phase(name, phases[p].threads, threads,
+				region, &phases[p], counter, max_ops);
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	(void)mmaplock_vma_stats(&vma_success[1], &vma_retry[1]);
+
+	first = &phases[0];
+	last = &phases[nphases - 1];
+	if (instance == 0) {
+		pr_inf(stderr, "%s: %7s %14s %14s %11s\n", name,
+			"threads", "faults/s", "maps/s", "efficiency");
+		for (p = 0; p < nphases; p++) {
+			const mmaplock_phase_t *ph = &phases[p];
+
+			if (!ph->runs)
+				continue;
+			/* Fault rate against N times the single thread rate */
+			pr_inf(stderr, "%s: %7" PRIu32 " %14.0f %14.0f %10.1f%%\n",
+				name, ph->threads, ph->faults / ph->runs,
+				ph->maps / ph->runs, (first->faults > 0.0) ?
+				100.0 * (ph->faults / ph->runs) /
+				((first->faults / first->runs) * ph->threads) : 0.0);
+		}
+		if (vma_stats)
+			pr_inf(stderr, "%s: per-VMA locking active, %" PRIu64
+				" faults took the VMA lock, %" PRIu64 " retried "
+				"under mmap_lock\n", name,
+				vma_success[1] - vma_success[0],
+				vma_retry[1] - vma_retry[0]);
+		else
+			pr_inf(stderr, "%s: per-VMA locking %s\n", name,
+				mmaplock_vma_kernel() ?
+				"probably active (Linux 6.4 or later, no vma_lock stats)" :
+				"not available (kernel before Linux 6.4)");
+	}
+
+	if (first->runs && last->runs) {
+		char desc[40];
+
+		stress_misc_metric_set(0, "faults/s 1 thread",
+			first->faults / first->runs);
+		stress_misc_metric_set(1, "maps/s 1 thread",
+			first->maps / first->runs);
+		(void)snprintf(desc, sizeof(desc), "faults/s %" PRIu32 " threads",
+			last->threads);
+		stress_misc_metric_set(2, desc, last->faults / last->runs);
+		(void)snprintf(desc, sizeof(desc), "maps/s %" PRIu32 " threads",
+			last->threads);
+		stress_misc_metric_set(3, desc, last->maps / last->runs);
+		stress_misc_metric_set(4, "fault scaling efficiency %",
+			(first->faults > 0.0) ?
+			100.0 * (last->faults / last->runs) /
+			((first->faults / first->runs) * last->threads) : 0.0);
+		if (vma_stats)
+			stress_misc_metric_set(5, "per-VMA lock faults",
+				(double)(vma_success[1] - vma_success[0]));
+	}
+	(void)munmap(region, region_size);
+	free(threads);
+
+	return EXIT_SUCCESS;
+}
+#endif
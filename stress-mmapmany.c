@@ -27,7 +27,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -37,6 +39,219 @@
 
 #define MMAP_MAX	(256*1024)
 
+#define SCALE_VMAS_MIN		(1024)		/* first VMA count step */
+#define SCALE_VMAS_MAX		(4 * 1024 * 1024) /* cap on max_map_count */
+#define SCALE_SAMPLES		(1024)		/* timed ops per step */
+#define SCALE_HEADROOM		(256)		/* VMAs left for libc etc */
+
+static bool opt_mmapmany_scale = false;
+
+void stress_set_mmapmany_scale(void)
+{
+	opt_mmapmany_scale = true;
+}
+
+#if defined(STRESS_LATENCY)
+/*
+ *  mmapmany_maps()
+ *	read all of /proc/self/maps, returns the time taken
+ *	in nanoseconds and the number of VMAs in *vmas
+ */
+static uint64_t mmapmany_maps(size_t *vmas)
+{
+	static char buf[64 * 1024];
+	uint64_t t;
+	ssize_t n;
+	int fd;
+
+	*vmas = 0;
+	t = time_now_ns();
+	fd = open("/proc/self/maps", O_RDONLY);
+	if (fd < 0)
+		return 0;
+	while ((n = read(fd, buf, sizeof(buf))) > 0) {
+		const char *ptr, *end = buf + n;
+
+		for (ptr = buf; (ptr = memchr(ptr, '\n', (size_t)(end - ptr))) != NULL; ptr++)
+			(*vmas)++;
+	}
+	(void)close(fd);
+
+	return time_now_ns() - t;
+}
+
+/*
+ *  mmapmany_max_map_count()
+ *	the per process VMA limit
+ */
+static size_t mmapmany_max_map_count(void)
+{
+	FILE *fp;
+	unsigned long val = 65530;
+
+	fp = fopen("/proc/sys/vm/max_map_count", "r");
+	if (fp) {
+		if (fscanf(fp, "%lu", &val) != 1)
+			val = 65530;
+		(void)fclose(fp);
+	}
+	return (val > SCALE_VMAS_MAX) ? SCALE_VMAS_MAX : (size_t)val;
+}
+
+/*
+ *  stress_mmapmany_scale()
+ *	hold the VMA count at 1K, 2K, 4K.. up to max_map_count
+ *	and at each step time page faults, mmap and munmap of
+ *	a page and a read of /proc/self/maps to show how the
+ *	cost of the VMA tree grows with the number of VMAs.
+ *	The VMAs are made by making every other page of one
+ *	PROT_NONE reservation writable, each page splits off
+ *	two more VMAs
+ */
+static void stress_mmapmany_scale(
+	const char *name,
+	const uint32_t instance,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const size_t page_size = stress_get_pagesize();
+	const size_t max_vmas = mmapmany_max_map_count();
+	size_t vmas, base_vmas, pages, made = 0, target, step = 0, max_seen = 0;
+	uint64_t maps_ns, fault_1k = 0, fault_max = 0;
+	uint8_t *region;
+	bool reported = false;
+
+	(void)mmapmany_maps(&base_vmas);
+	vmas = base_vmas;
+	if (max_vmas <= base_vmas + SCALE_HEADROOM + SCALE_VMAS_MIN) {
+		pr_inf(stderr, "%s: max_map_count %zu is too low for the "
+			"VMA scaling steps\n", name, max_vmas);
+		return;
+	}
+	/* two VMAs per writable page */
+	pages = max_vmas - base_vmas - SCALE_HEADROOM;
+	region = (uint8_t *)mmap(NULL, pages * page_size, PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (region == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot reserve %zu pages for the VMA "
+			"scaling steps\n", name, pages);
+		return;
+	}
+
+	if (instance == 0)
+		pr_inf(stderr, "%s: %8s %10s %10s %10s %10s %10s %10s\n",
+			name, "VMAs", "fault p50", "fault p99", "mmap p50",
+			"munmap p50", "maps ms", "maps us/1K");
+
+	do {
+		for (target = SCALE_VMAS_MIN; ; target *= 2) {
+			stress_latency_t fault_lat, mmap_lat, munmap_lat;
+			const size_t want = (target >= max_vmas) ? max_vmas : target;
+			size_t i, n, writable;
+
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+
+			/* grow the VMA count up to this step */
+			while ((base_vmas + (made * 2) < want) &&
+			       ((made * 2) < pages)) {
+				if (mprotect(region + (made * 2 * page_size),
+						page_size, PROT_READ | PROT_WRITE) < 0)
+					break;
+				made++;
+				(*counter)++;
+			}
+			writable = made;
+			if (!writable)
+				break;
+
+			/* first touch of writable pages spread over the tree */
+			memset(&fault_lat, 0, sizeof(fault_lat));
+			n = (writable < SCALE_SAMPLES) ? writable : SCALE_SAMPLES;
+			for (i = 0; i < n; i++) {
+				uint8_t *ptr = region +
+					((((i * writable) / n) * 2) * page_size);
+				uint64_t t;
+
+				t = time_now_ns();
+				*(volatile uint8_t *)ptr = 1;
+				latency_record(&fault_lat, time_now_ns() - t);
+			}
+			for (i = 0; i < n; i++)
+				(void)madvise(region + ((((i * writable) / n) * 2) * page_size),
+					page_size, MADV_DONTNEED);
+
+			/*
+			 *  PROT_READ does not match the neighbouring VMAs
+			 *  so each mmap inserts a VMA rather than merging
+			 */
+			memset(&mmap_lat, 0, sizeof(mmap_lat));
+			memset(&munmap_lat, 0, sizeof(munmap_lat));
+			for (i = 0; i < SCALE_SAMPLES; i++) {
+				void *ptr;
+				uint64_t t;
+
+				t = time_now_ns();
+				ptr = mmap(NULL, page_size, PROT_READ,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				latency_record(&mmap_lat, time_now_ns() - t);
+				if (ptr == MAP_FAILED)
+					break;
+				t = time_now_ns();
+				(void)munmap(ptr, page_size);
+				latency_record(&munmap_lat, time_now_ns() - t);
+			}
+
+			maps_ns = mmapmany_maps(&vmas);
+			if (step == 0)
+				fault_1k = latency_percentile(&fault_lat, 0.50);
+			fault_max = latency_percentile(&fault_lat, 0.50);
+
+			/*
+			 *  The parent kills this child when the run ends,
+			 *  so keep the metrics up to date as we go
+			 */
+			if (vmas > max_seen) {
+				max_seen = vmas;
+				stress_misc_metric_set(0, "max VMAs", (double)vmas);
+				stress_misc_metric_set(1, "fault p50 ns at 1K VMAs",
+					(double)fault_1k);
+				stress_misc_metric_set(2, "fault p50 ns at max VMAs",
+					(double)fault_max);
+			}
+
+			if ((instance == 0) && !reported)
+				pr_inf(stderr, "%s: %8zu %10" PRIu64 " %10" PRIu64
+					" %10" PRIu64 " %10" PRIu64 " %10.2f %10.2f\n",
+					name, vmas,
+					latency_percentile(&fault_lat, 0.50),
+					latency_percentile(&fault_lat, 0.99),
+					latency_percentile(&mmap_lat, 0.50),
+					latency_percentile(&munmap_lat, 0.50),
+					(double)maps_ns / 1000000.0,
+					vmas ? ((double)maps_ns / 1000.0) /
+						((double)vmas / 1024.0) : 0.0);
+			step++;
+			if ((want >= max_vmas) || ((made * 2) >= pages) ||
+			    (base_vmas + (made * 2) < want))
+				break;
+		}
+		reported = true;
+
+		/* drop back to the base VMA count and go again */
+		(void)munmap(region, pages * page_size);
+		region = (uint8_t *)mmap(NULL, pages * page_size, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (region == MAP_FAILED)
+			return;
+		made = 0;
+		step = 0;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	(void)munmap(region, pages * page_size);
+}
+#endif
+
 /*
  *  stress_mmapmany()
  *	stress mmap with many pages being mapped
@@ -104,12 +319,24 @@ again:
 		}
 	} else if (pid == 0) {
 		ssize_t i, n;
+		mincore_residency_t residency;
 
 		(void)setpgid(0, pgrp);
 		stress_parent_died_alarm();
 
 		/* Make sure this is killable by OOM killer */
 		set_oom_adjustment(name, true);
+		mincore_residency_init(&residency);
+
+		if (opt_mmapmany_scale) {
+#if defined(STRESS_LATENCY)
+			stress_mmapmany_scale(name, instance, counter, max_ops);
+			goto free_mappings;
+#else
+			pr_inf(stderr, "%s: --mmapmany-scale is not supported, "
+				"using the default mode\n", name);
+#endif
+		}
 
 		do {
 			for (n = 0; opt_do_run && (n < max); n++) {
@@ -126,6 +353,15 @@ again:
 					break;
 				(*counter)++;
 			}
+			/*
+			 *  The mappings are not contiguous, so sample the
+			 *  first page of a random one, the mean of the
+			 *  samples estimates the fraction resident
+			 */
+			if (n > 0) {
+				i = (ssize_t)(mwc32() % (uint32_t)n);
+				mincore_residency_sample(&residency, mappings[i], page_size);
+			}
 
 			for (i = 0; i < n;  i++) {
 				munmap((void *)mappings[i], page_size);
@@ -133,8 +369,12 @@ again:
 				munmap((void *)(mappings[i] + page_size + page_size), page_size);
 			}
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
+		mincore_residency_metrics_set(&residency);
 	}
 
+#if defined(STRESS_LATENCY)
+free_mappings:
+#endif
 	free(mappings);
 
 	return EXIT_SUCCESS;
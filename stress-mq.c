@@ -43,6 +43,10 @@
 #include <fcntl.h>
 #include <mqueue.h>
 #include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
 
 typedef struct {
 	uint64_t	value;
@@ -51,6 +55,9 @@ typedef struct {
 
 static int opt_mq_size = DEFAULT_MQ_SIZE;
 static bool set_mq_size = false;
+static bool mq_sweep_mode = false;
+static uint32_t opt_mq_producers = DEFAULT_MQ_PROCS;
+static uint32_t opt_mq_consumers = DEFAULT_MQ_PROCS;
 
 void stress_set_mq_size(const char *optarg)
 {
@@ -63,11 +70,375 @@ void stress_set_mq_size(const char *optarg)
                 MIN_MQ_SIZE, MAX_MQ_SIZE);
 }
 
+/*
+ *  stress_set_mq_sweep()
+ *	compare POSIX and SysV queues over message sizes
+ *	and queue depths
+ */
+void stress_set_mq_sweep(void)
+{
+	mq_sweep_mode = true;
+}
+
+void stress_set_mq_producers(const char *optarg)
+{
+	opt_mq_producers = (uint32_t)get_uint64(optarg);
+	check_range("mq-producers", opt_mq_producers,
+		MIN_MQ_PROCS, MAX_MQ_PROCS);
+	mq_sweep_mode = true;
+}
+
+void stress_set_mq_consumers(const char *optarg)
+{
+	opt_mq_consumers = (uint32_t)get_uint64(optarg);
+	check_range("mq-consumers", opt_mq_consumers,
+		MIN_MQ_PROCS, MAX_MQ_PROCS);
+	mq_sweep_mode = true;
+}
+
 static void stress_mq_notify_func(union sigval s)
 {
 	(void)s;
 }
 
+#if defined(STRESS_LATENCY)
+#define MQ_SWEEP_PHASE_TIME	(0.25)	/* seconds per API, size and depth */
+
+#define MQ_API_POSIX		(0)	/* mq_send(3) and mq_receive(3) */
+#define MQ_API_SYSV		(1)	/* msgsnd(2) and msgrcv(2) */
+#define MQ_API_MAX		(2)
+
+static const char *mq_api_names[MQ_API_MAX] = { "posix", "sysv" };
+static const size_t mq_sweep_sizes[] = { 16, 128, 1024, 8192 };
+static const int mq_sweep_depths[] = { 1, 4, 10 };
+
+#define MQ_SWEEP_SIZES		SIZEOF_ARRAY(mq_sweep_sizes)
+#define MQ_SWEEP_DEPTHS		SIZEOF_ARRAY(mq_sweep_depths)
+
+/* Leads every message, the rest of it is payload */
+typedef struct {
+	uint64_t t_send;		/* ns when the producer sent it */
+	uint64_t seq;			/* producer's message number */
+} mq_sweep_hdr_t;
+
+/* SysV message, mtext sized for the largest sweep message */
+typedef struct {
+	long mtype;
+	char mtext[8192];
+} mq_sweep_msg_t;
+
+/* Shared with the producer and consumer processes of a step */
+typedef struct {
+	bool go;			/* all processes forked */
+	uint64_t msgs[MAX_MQ_PROCS];	/* messages each consumer received */
+	stress_latency_t lat[MAX_MQ_PROCS]; /* send to receive latencies */
+} mq_sweep_shared_t;
+
+/* Throughput and latency of one API, size and depth */
+typedef struct {
+	uint64_t msgs;			/* messages received */
+	double secs;			/* time spent sending */
+	int depth;			/* queue depth actually used */
+	stress_latency_t lat;		/* send to receive latencies */
+} mq_sweep_result_t;
+
+/*
+ *  mq_proc_int()
+ *	read an integer IPC limit from /proc
+ */
+static int mq_proc_int(const char *path, const int default_val)
+{
+	char buf[32];
+
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return default_val;
+	return atoi(buf);
+}
+
+/*
+ *  stress_mq_sweep_child()
+ *	a producer sending or a consumer receiving messages
+ *	of one size until killed by the parent
+ */
+static void MLOCKED stress_mq_sweep_child(
+	const int api,
+	const bool producer,
+	const uint32_t n,
+	const size_t size,
+	const mqd_t mq,
+	const int msgq_id,
+	mq_sweep_shared_t *shared)
+{
+	mq_sweep_msg_t msg;
+	mq_sweep_hdr_t hdr;
+	uint64_t seq = 0;
+
+	(void)setpgid(0, pgrp);
+	stress_parent_died_alarm();
+
+	memset(&msg, 0, sizeof(msg));
+	msg.mtype = 1;
+	while (!__atomic_load_n(&shared->go, __ATOMIC_ACQUIRE))
+		(void)sched_yield();
+
+	while (opt_do_run) {
+		int ret;
+
+		if (producer) {
+			hdr.t_send = time_now_ns();
+			hdr.seq = seq++;
+			memcpy(msg.mtext, &hdr, sizeof(hdr));
+			if (api == MQ_API_POSIX)
+				ret = mq_send(mq, msg.mtext, size, 1);
+			else
+				ret = msgsnd(msgq_id, &msg, size, 0);
+		} else {
+			if (api == MQ_API_POSIX)
+				ret = (mq_receive(mq, msg.mtext, size, NULL) < 0) ? -1 : 0;
+			else
+				ret = (msgrcv(msgq_id, &msg, size, 0, 0) < 0) ? -1 : 0;
+			if (ret == 0) {
+				const uint64_t t = time_now_ns();
+
+				memcpy(&hdr, msg.mtext, sizeof(hdr));
+				latency_record(&shared->lat[n], t - hdr.t_send);
+				__atomic_add_fetch(&shared->msgs[n], 1, __ATOMIC_RELAXED);
+			}
+		}
+		if ((ret < 0) && (errno != EINTR))
+			break;
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_mq_sweep_step()
+ *	run the producers and consumers over one queue for
+ *	a phase, 0 if done, 1 if the size or depth cannot
+ *	be used and -1 on failure
+ */
+static int stress_mq_sweep_step(
+	const char *name,
+	const int api,
+	const size_t size,
+	const int depth,
+	mq_sweep_shared_t *shared,
+	mq_sweep_result_t *result)
+{
+	const uint32_t n_procs = opt_mq_producers + opt_mq_consumers;
+	pid_t pids[2 * MAX_MQ_PROCS];
+	mqd_t mq = (mqd_t)-1;
+	int msgq_id = -1, status, rc = 0;
+	uint32_t i, started = 0;
+	char mq_name[64];
+	double t_start;
+
+	if (api == MQ_API_POSIX) {
+		struct mq_attr attr;
+
+		if (size > (size_t)mq_proc_int("/proc/sys/fs/mqueue/msgsize_max", 8192))
+			return 1;
+		memset(&attr, 0, sizeof(attr));
+		attr.mq_maxmsg = STRESS_MINIMUM(depth,
+			mq_proc_int("/proc/sys/fs/mqueue/msg_max", 10));
+		attr.mq_msgsize = size;
+		(void)snprintf(mq_name, sizeof(mq_name), "/%s-sweep-%i",
+			name, (int)getpid());
+		mq = mq_open(mq_name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR, &attr);
+		if (mq == (mqd_t)-1)
+			return 1;
+		result->depth = (int)attr.mq_maxmsg;
+	} else {
+		struct msqid_ds buf;
+		size_t qbytes;
+
+		if (size > (size_t)mq_proc_int("/proc/sys/kernel/msgmax", 8192))
+			return 1;
+		msgq_id = msgget(IPC_PRIVATE, S_IRUSR | S_IWUSR | IPC_CREAT | IPC_EXCL);
+		if (msgq_id < 0) {
+			pr_fail_dbg(name, "msgget");
+			return -1;
+		}
+		/* SysV queues are sized in bytes, only root may grow them */
+		if (msgctl(msgq_id, IPC_STAT, &buf) == 0) {
+			qbytes = STRESS_MINIMUM((size_t)buf.msg_qbytes, size * (size_t)depth);
+			buf.msg_qbytes = qbytes;
+			(void)msgctl(msgq_id, IPC_SET, &buf);
+			if (msgctl(msgq_id, IPC_STAT, &buf) == 0)
+				qbytes = buf.msg_qbytes;
+		} else {
+			qbytes = size * (size_t)depth;
+		}
+		if (qbytes < size) {
+			(void)msgctl(msgq_id, IPC_RMID, NULL);
+			return 1;
+		}
+		result->depth = (int)(qbytes / size);
+	}
+
+	memset(shared, 0, sizeof(*shared));
+	for (i = 0; i < n_procs; i++) {
+		const bool producer = (i < opt_mq_producers);
+
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			pr_fail_dbg(name, "fork");
+			rc = -1;
+			break;
+		} else if (pids[i] == 0) {
+			stress_mq_sweep_child(api, producer,
+				producer ? i : i - opt_mq_producers,
+				size, mq, msgq_id, shared);
+		}
+		(void)setpgid(pids[i], pgrp);
+		started++;
+	}
+
+	t_start = time_now();
+	__atomic_store_n(&shared->go, true, __ATOMIC_RELEASE);
+	while ((rc == 0) && opt_do_run && (time_now() < t_start + MQ_SWEEP_PHASE_TIME))
+		(void)usleep(10000);
+	result->secs += time_now() - t_start;
+
+	/* Blocked senders and receivers are killed, nothing has to drain */
+	for (i = 0; i < started; i++)
+		(void)kill(pids[i], SIGKILL);
+	for (i = 0; i < started; i++)
+		(void)waitpid(pids[i], &status, 0);
+
+	for (i = 0; i < opt_mq_consumers; i++) {
+		const stress_latency_t *lat = &shared->lat[i];
+		size_t b;
+
+		result->msgs += shared->msgs[i];
+		result->lat.count += lat->count;
+		if (lat->max > result->lat.max)
+			result->lat.max = lat->max;
+		for (b = 0; b < LATENCY_BUCKETS; b++)
+			result->lat.bucket[b] += lat->bucket[b];
+	}
+
+	if (api == MQ_API_POSIX) {
+		(void)mq_close(mq);
+		(void)mq_unlink(mq_name);
+	} else {
+		(void)msgctl(msgq_id, IPC_RMID, NULL);
+	}
+	return rc;
+}
+
+/*
+ *  stress_mq_sweep()
+ *	POSIX and SysV message queue throughput and latency
+ *	side by side for each message size and queue depth
+ */
+static int stress_mq_sweep(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	mq_sweep_result_t (*results)[MQ_SWEEP_SIZES][MQ_SWEEP_DEPTHS];
+	mq_sweep_shared_t *shared;
+	bool reported = false, skipped[MQ_API_MAX][MQ_SWEEP_SIZES];
+	int api, rc = EXIT_SUCCESS;
+	size_t s, d, idx = 0;
+
+	memset(skipped, 0, sizeof(skipped));
+	shared = mmap(NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	results = calloc(MQ_API_MAX, sizeof(*results));
+	if ((shared == MAP_FAILED) || !results) {
+		pr_err(stderr, "%s: cannot allocate sweep state\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_state;
+	}
+
+	do {
+		for (s = 0; s < MQ_SWEEP_SIZES; s++) {
+			for (d = 0; d < MQ_SWEEP_DEPTHS; d++) {
+				for (api = 0; api < MQ_API_MAX; api++) {
+					mq_sweep_result_t *result = &results[api][s][d];
+					const uint64_t msgs = result->msgs;
+					int ret;
+
+					if (skipped[api][s])
+						continue;
+					if (!opt_do_run || (max_ops && *counter >= max_ops))
+						goto done;
+					ret = stress_mq_sweep_step(name, api,
+						mq_sweep_sizes[s], mq_sweep_depths[d],
+						shared, result);
+					if (ret < 0) {
+						rc = EXIT_FAILURE;
+						goto done;
+					}
+					if (ret > 0)
+						skipped[api][s] = true;
+					*counter += result->msgs - msgs;
+				}
+			}
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %" PRIu32 " producer%s, %" PRIu32
+				" consumer%s\n", name,
+				opt_mq_producers, (opt_mq_producers == 1) ? "" : "s",
+				opt_mq_consumers, (opt_mq_consumers == 1) ? "" : "s");
+			pr_inf(stderr, "%s: %5s %5s %5s %10s %9s %9s %9s\n",
+				name, "api", "bytes", "depth", "msgs/sec",
+				"MB/sec", "p50 usec", "p99 usec");
+			for (s = 0; s < MQ_SWEEP_SIZES; s++) {
+				for (d = 0; d < MQ_SWEEP_DEPTHS; d++) {
+					for (api = 0; api < MQ_API_MAX; api++) {
+						const mq_sweep_result_t *result = &results[api][s][d];
+						double rate;
+
+						if (!result->lat.count || (result->secs <= 0.0))
+							continue;
+						rate = (double)result->msgs / result->secs;
+						pr_inf(stderr, "%s: %5s %5zu %5d %10.0f %9.2f %9.1f %9.1f\n",
+							name, mq_api_names[api], mq_sweep_sizes[s],
+							result->depth, rate,
+							rate * (double)mq_sweep_sizes[s] / (double)MB,
+							latency_percentile_usec(&result->lat, 0.50),
+							latency_percentile_usec(&result->lat, 0.99));
+					}
+				}
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	/* Rate of each size at the deepest queue and the shallow queue latency */
+	for (api = 0; api < MQ_API_MAX; api++) {
+		const mq_sweep_result_t *result;
+		char desc[40];
+
+		for (s = 0; s < MQ_SWEEP_SIZES; s++) {
+			result = &results[api][s][MQ_SWEEP_DEPTHS - 1];
+			if (result->secs <= 0.0)
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s %zu byte msgs/sec",
+				mq_api_names[api], mq_sweep_sizes[s]);
+			stress_misc_metric_set(idx++, desc,
+				(double)result->msgs / result->secs);
+		}
+		result = &results[api][0][0];
+		if (!result->lat.count)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s %zu byte p50 (usec)",
+			mq_api_names[api], mq_sweep_sizes[0]);
+		stress_misc_metric_set(idx++, desc, latency_percentile_usec(&result->lat, 0.50));
+	}
+free_state:
+	free(results);
+	if (shared != MAP_FAILED)
+		(void)munmap((void *)shared, sizeof(*shared));
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_mq
  *	stress POSIX message queues
@@ -88,6 +459,12 @@ int stress_mq(
 	time_t time_start;
 	struct timespec abs_timeout;
 
+	/* Every bogo op, sweep or not, is one message sent */
+	stress_units_per_op(1.0);
+#if defined(STRESS_LATENCY)
+	if (mq_sweep_mode)
+		return stress_mq_sweep(counter, instance, max_ops, name);
+#endif
 	if (!set_mq_size) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
 			opt_mq_size = MAX_MQ_SIZE;
@@ -214,6 +591,7 @@ again:
 
 		do {
 			int ret;
+			uint64_t t_lat;
 			const uint64_t timed = (i & 1);
 
 			memset(&msg, 0, sizeof(msg));
@@ -227,6 +605,7 @@ again:
 			/*
 			 * toggle between timedsend and send
 			 */
+			t_lat = latency_begin(*counter);
 			if (do_timed && (timed))
 				ret = mq_timedsend(mq, (char *)&msg, sizeof(msg), 1, &abs_timeout);
 			else
@@ -237,6 +616,7 @@ again:
 					pr_fail_dbg(name, timed ? "mq_timedsend" : "mq_send");
 				break;
 			}
+			latency_end(t_lat);
 			i++;
 			(*counter)++;
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
@@ -40,8 +40,20 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#define MREMAP_GROW_START	(4 * KB)	/* grow buffers from this size */
+
+#define MREMAP_GROW_MREMAP	(0)	/* mremap(2) MREMAP_MAYMOVE */
+#define MREMAP_GROW_COPY	(1)	/* malloc(3), memcpy(3), free(3) */
+#define MREMAP_GROW_MAX		(2)
+
+static const char *mremap_grow_names[MREMAP_GROW_MAX] = {
+	"mremap",
+	"copy",
+};
+
 static size_t opt_mremap_bytes = DEFAULT_MREMAP_BYTES;
 static bool set_mremap_bytes = false;
+static bool opt_mremap_grow = false;
 
 void stress_set_mremap_bytes(const char *optarg)
 {
@@ -51,6 +63,11 @@ void stress_set_mremap_bytes(const char *optarg)
 		MIN_MREMAP_BYTES, MAX_MREMAP_BYTES);
 }
 
+void stress_set_mremap_grow(void)
+{
+	opt_mremap_grow = true;
+}
+
 #if defined(MREMAP_FIXED)
 /*
  *  rand_mremap_addr()
@@ -194,6 +211,208 @@ static void stress_mremap_set(
 	}
 }
 
+/*
+ *  stress_mremap_hwm_reset()
+ *	reset the peak RSS of this process, false
+ *	if the kernel does not support this
+ */
+static bool stress_mremap_hwm_reset(void)
+{
+	int fd;
+	bool ok;
+
+	fd = open("/proc/self/clear_refs", O_WRONLY);
+	if (fd < 0)
+		return false;
+	ok = (write(fd, "5", 1) == 1);
+	(void)close(fd);
+
+	return ok;
+}
+
+/*
+ *  stress_mremap_proc_kb()
+ *	read a size in KB from a field in /proc/self/status,
+ *	returns 0 if it cannot be read
+ */
+static uint64_t stress_mremap_proc_kb(const char *field)
+{
+	FILE *fp;
+	char buf[128];
+	const size_t len = strlen(field);
+	uint64_t kb = 0;
+
+	fp = fopen("/proc/self/status", "r");
+	if (!fp)
+		return 0;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (!strncmp(buf, field, len)) {
+			(void)sscanf(buf + len, "%" SCNu64, &kb);
+			break;
+		}
+	}
+	(void)fclose(fp);
+
+	return kb;
+}
+
+/*
+ *  stress_mremap_grow_one()
+ *	grow a buffer from MREMAP_GROW_START bytes to max_sz by
+ *	doubling, appending to the new half after each step as a
+ *	growable vector would. Returns the time taken, or a negative
+ *	value if the grow failed or was interrupted
+ */
+static double stress_mremap_grow_one(
+	const char *name,
+	const int method,
+	const size_t max_sz,
+	uint64_t *peak_kb,
+	uint32_t *moves)
+{
+	uint8_t *buf;
+	size_t sz = MREMAP_GROW_START;
+	const bool hwm = stress_mremap_hwm_reset();
+	const uint64_t base_kb = stress_mremap_proc_kb("VmRSS:");
+	double t;
+
+	*peak_kb = 0;
+	*moves = 0;
+	t = time_now();
+	if (method == MREMAP_GROW_MREMAP) {
+		buf = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+			return -1.0;
+	} else {
+		buf = malloc(sz);
+		if (!buf)
+			return -1.0;
+	}
+	(void)memset(buf, 0x5a, sz);
+
+	while (opt_do_run && (sz < max_sz)) {
+		const size_t new_sz = (sz << 1) > max_sz ? max_sz : sz << 1;
+		uint8_t *new_buf;
+
+		if (method == MREMAP_GROW_MREMAP) {
+			new_buf = mremap(buf, sz, new_sz, MREMAP_MAYMOVE);
+			if (new_buf == MAP_FAILED) {
+				pr_fail(stderr, "%s: mremap grow to %zu bytes "
+					"failed, errno = %d (%s)\n",
+					name, new_sz, errno, strerror(errno));
+				(void)munmap(buf, sz);
+				return -1.0;
+			}
+		} else {
+			new_buf = malloc(new_sz);
+			if (!new_buf) {
+				free(buf);
+				return -1.0;
+			}
+			(void)memcpy(new_buf, buf, sz);
+			free(buf);
+		}
+		if (new_buf != buf)
+			(*moves)++;
+		buf = new_buf;
+		(void)memset(buf + sz, 0x5a, new_sz - sz);
+		sz = new_sz;
+	}
+	t = time_now() - t;
+
+	if (hwm) {
+		const uint64_t hwm_kb = stress_mremap_proc_kb("VmHWM:");
+
+		*peak_kb = hwm_kb > base_kb ? hwm_kb - base_kb : 0;
+	}
+	if ((opt_flags & OPT_FLAGS_VERIFY) && (buf[0] != 0x5a || buf[sz - 1] != 0x5a))
+		pr_fail(stderr, "%s: %s grown buffer does not contain expected data\n",
+			name, mremap_grow_names[method]);
+
+	if (method == MREMAP_GROW_MREMAP)
+		(void)munmap(buf, sz);
+	else
+		free(buf);
+
+	return (sz < max_sz) ? -1.0 : t;
+}
+
+/*
+ *  stress_mremap_grow()
+ *	compare growing a buffer by doubling with mremap(2)
+ *	against malloc, memcpy and free, reporting the total
+ *	grow time and the peak RSS of each
+ */
+static int stress_mremap_grow(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	double secs[MREMAP_GROW_MAX];
+	uint64_t peak_kb[MREMAP_GROW_MAX];
+	uint32_t moves[MREMAP_GROW_MAX];
+	uint64_t grows = 0;
+	int method;
+
+	memset(secs, 0, sizeof(secs));
+	memset(peak_kb, 0, sizeof(peak_kb));
+	memset(moves, 0, sizeof(moves));
+
+	do {
+		double t[MREMAP_GROW_MAX];
+		uint64_t kb[MREMAP_GROW_MAX];
+		uint32_t mv[MREMAP_GROW_MAX];
+
+		for (method = 0; method < MREMAP_GROW_MAX; method++) {
+			t[method] = stress_mremap_grow_one(name, method,
+				opt_mremap_bytes, &kb[method], &mv[method]);
+			if (t[method] < 0.0)
+				break;
+		}
+		if (method < MREMAP_GROW_MAX) {
+			if (!opt_do_run)
+				break;
+			return EXIT_FAILURE;
+		}
+
+		grows++;
+		for (method = 0; method < MREMAP_GROW_MAX; method++) {
+			char desc[40];
+
+			secs[method] += t[method];
+			moves[method] += mv[method];
+			if (kb[method] > peak_kb[method])
+				peak_kb[method] = kb[method];
+
+			/* The child is killed at the end, so update as we go */
+			(void)snprintf(desc, sizeof(desc), "%s grow time (ms)",
+				mremap_grow_names[method]);
+			stress_misc_metric_set(method * 2, desc,
+				1000.0 * secs[method] / (double)grows);
+			(void)snprintf(desc, sizeof(desc), "%s peak RSS (MB)",
+				mremap_grow_names[method]);
+			stress_misc_metric_set((method * 2) + 1, desc,
+				(double)peak_kb[method] / 1024.0);
+		}
+		if ((instance == 0) && (grows == 1)) {
+			pr_inf(stderr, "%s: growing %zu bytes to %zu bytes by doubling\n",
+				name, (size_t)MREMAP_GROW_START, opt_mremap_bytes);
+			pr_inf(stderr, "%s: %6s %12s %14s %6s\n", name,
+				"method", "grow ms", "peak RSS MB", "moves");
+			for (method = 0; method < MREMAP_GROW_MAX; method++)
+				pr_inf(stderr, "%s: %6s %12.3f %14.1f %6" PRIu32 "\n",
+					name, mremap_grow_names[method],
+					1000.0 * t[method], (double)kb[method] / 1024.0,
+					mv[method]);
+		}
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	return EXIT_SUCCESS;
+}
+
 static int stress_mremap_child(
 	uint64_t *const counter,
 	const uint64_t max_ops,
@@ -366,8 +585,11 @@ again:
 		/* Make sure this is killable by OOM killer */
 		set_oom_adjustment(name, true);
 
-		rc = stress_mremap_child(counter, max_ops, name, sz,
-			new_sz, page_size, &flags);
+		if (opt_mremap_grow)
+			rc = stress_mremap_grow(counter, instance, max_ops, name);
+		else
+			rc = stress_mremap_child(counter, max_ops, name, sz,
+				new_sz, page_size, &flags);
 		exit(rc);
 	}
 
@@ -93,6 +93,7 @@ int stress_msg(
 
 	(void)instance;
 
+	stress_units_per_op(1.0);
 	msgq_id = msgget(IPC_PRIVATE, S_IRUSR | S_IWUSR | IPC_CREAT | IPC_EXCL);
 	if (msgq_id < 0) {
 		pr_fail_dbg(name, "msgget");
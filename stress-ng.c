@@ -31,6 +31,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <getopt.h>
@@ -46,6 +47,8 @@
 #if defined(__linux__)
 #include <sys/utsname.h>
 #include <sys/sysinfo.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 #endif
 #if defined(__sun__)
 #include <alloca.h>
@@ -56,6 +59,9 @@
 #if defined(__linux__) && NEED_GLIBC(2,3,0)
 #include <sched.h>
 #endif
+#if defined(__linux__) && defined(__NR_futex)
+#include <linux/futex.h>
+#endif
 
 typedef struct {
 	const stress_id str_id;
@@ -78,12 +84,16 @@ static proc_info_t procs[STRESS_MAX]; 		/* Per stressor process information */
 /* Various option settings and flags */
 int32_t opt_sequential = DEFAULT_SEQUENTIAL;	/* Number of sequential workers */
 int32_t opt_all = 0;				/* Number of concurrent workers */
+int32_t opt_timer_jitter_prio = UNDEFINED;	/* SCHED_FIFO priority of timer stressors */
 uint64_t opt_timeout = 0;			/* timeout in seconds */
+static double opt_sync_start_at = 0.0;		/* --sync-start-at epoch secs */
 uint64_t opt_flags = PR_ERROR | PR_INFO | OPT_FLAGS_MMAP_MADVISE;
 volatile bool opt_do_run = true;		/* false to exit stressor */
 volatile bool opt_do_wait = true;		/* false to exit run waiter loop */
 volatile bool opt_sigint = false;		/* true if stopped by SIGINT */
 pid_t pgrp;					/* proceess group leader */
+__thread proc_stats_t *stress_stats;		/* stats of this stressor instance */
+__thread bool stress_thread_instance;		/* instance runs as a thread */
 
 /* Scheduler options */
 
@@ -105,7 +115,10 @@ static const unsupported_t unsupported[] = {
 	{ STRESS_APPARMOR,	stress_apparmor_supported },
 #endif
 #if defined(STRESS_ICMP_FLOOD)
-	{ STRESS_ICMP_FLOOD,	stress_icmp_flood_supported }
+	{ STRESS_ICMP_FLOOD,	stress_icmp_flood_supported },
+#endif
+#if defined(STRESS_AF_PACKET)
+	{ STRESS_AF_PACKET,	stress_af_packet_supported },
 #endif
 };
 
@@ -205,7 +218,51 @@ static const int signals[] = {
 		OPT_ ## upper_name,		\
 		OPT_ ## upper_name  ## _OPS,	\
 		# lower_name,			\
-		class				\
+		class,				\
+		false,				\
+		NULL				\
+	}
+
+/* A stressor whose instances can share one process as threads */
+#define STRESSOR_THREADED(lower_name, upper_name, class) \
+	{					\
+		stress_ ## lower_name,		\
+		STRESS_ ## upper_name,		\
+		OPT_ ## upper_name,		\
+		OPT_ ## upper_name  ## _OPS,	\
+		# lower_name,			\
+		class,				\
+		true,				\
+		NULL				\
+	}
+
+/*
+ * A stressor that also counts its work in a normalised unit, such
+ * as bytes or elements, that compares across architectures where
+ * the size of a bogo op does not
+ */
+#define STRESSOR_UNIT(lower_name, upper_name, class, unit) \
+	{					\
+		stress_ ## lower_name,		\
+		STRESS_ ## upper_name,		\
+		OPT_ ## upper_name,		\
+		OPT_ ## upper_name  ## _OPS,	\
+		# lower_name,			\
+		class,				\
+		false,				\
+		unit				\
+	}
+
+#define STRESSOR_THREADED_UNIT(lower_name, upper_name, class, unit) \
+	{					\
+		stress_ ## lower_name,		\
+		STRESS_ ## upper_name,		\
+		OPT_ ## upper_name,		\
+		OPT_ ## upper_name  ## _OPS,	\
+		# lower_name,			\
+		class,				\
+		true,				\
+		unit				\
 	}
 
 /* Human readable stress test names */
@@ -216,6 +273,9 @@ static const stress_t stressors[] = {
 #if defined(STRESS_AF_ALG)
 	STRESSOR(af_alg, AF_ALG, CLASS_CPU | CLASS_OS),
 #endif
+#if defined(STRESS_AF_PACKET)
+	STRESSOR(af_packet, AF_PACKET, CLASS_NETWORK | CLASS_OS),
+#endif
 #if defined(STRESS_AIO)
 	STRESSOR(aio, AIO, CLASS_IO | CLASS_INTERRUPT | CLASS_OS),
 #endif
@@ -225,16 +285,20 @@ static const stress_t stressors[] = {
 #if defined(STRESS_APPARMOR)
 	STRESSOR(apparmor, APPARMOR, CLASS_OS | CLASS_SECURITY),
 #endif
+#if defined(STRESS_ARENA)
+	STRESSOR(arena, ARENA, CLASS_CPU_CACHE | CLASS_MEMORY),
+#endif
 #if defined(STRESS_ATOMIC)
-	STRESSOR(atomic, ATOMIC, CLASS_CPU | CLASS_MEMORY),
+	STRESSOR_THREADED(atomic, ATOMIC, CLASS_CPU | CLASS_MEMORY),
 #endif
 	STRESSOR(bigheap, BIGHEAP, CLASS_OS | CLASS_VM),
 #if defined(STRESS_BIND_MOUNT)
 	STRESSOR(bind_mount, BIND_MOUNT, CLASS_FILESYSTEM | CLASS_OS | CLASS_PATHOLOGICAL),
 #endif
 	STRESSOR(brk, BRK, CLASS_OS | CLASS_VM),
-	STRESSOR(bsearch, BSEARCH, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
+	STRESSOR_THREADED(bsearch, BSEARCH, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
 	STRESSOR(cache, CACHE, CLASS_CPU_CACHE),
+	STRESSOR(cacheline, CACHELINE, CLASS_CPU_CACHE),
 #if defined(STRESS_CAP)
 	STRESSOR(cap, CAP, CLASS_OS),
 #endif
@@ -247,6 +311,9 @@ static const stress_t stressors[] = {
 #if defined(STRESS_CLONE)
 	STRESSOR(clone, CLONE, CLASS_SCHEDULER | CLASS_OS),
 #endif
+#if defined(STRESS_COMPACT)
+	STRESSOR(compact, COMPACT, CLASS_VM | CLASS_OS),
+#endif
 #if defined(STRESS_CONTEXT)
 	STRESSOR(context, CONTEXT, CLASS_MEMORY | CLASS_CPU),
 #endif
@@ -265,6 +332,9 @@ static const stress_t stressors[] = {
 	STRESSOR(dir, DIR, CLASS_FILESYSTEM | CLASS_OS),
 #if defined(STRESS_DNOTIFY)
 	STRESSOR(dnotify, DNOTIFY, CLASS_FILESYSTEM | CLASS_SCHEDULER | CLASS_OS),
+#endif
+#if defined(STRESS_DSP)
+	STRESSOR(dsp, DSP, CLASS_CPU | CLASS_CPU_CACHE | CLASS_MEMORY),
 #endif
 	STRESSOR(dup, DUP, CLASS_FILESYSTEM | CLASS_OS),
 #if defined(STRESS_EPOLL)
@@ -288,7 +358,11 @@ static const stress_t stressors[] = {
 	STRESSOR(filename, FILENAME, CLASS_FILESYSTEM | CLASS_OS),
 	STRESSOR(flock, FLOCK, CLASS_FILESYSTEM | CLASS_OS),
 	STRESSOR(fork, FORK, CLASS_SCHEDULER | CLASS_OS),
+	STRESSOR(forkheap, FORKHEAP, CLASS_VM | CLASS_OS),
 	STRESSOR(fp_error, FP_ERROR, CLASS_CPU),
+#if defined(STRESS_FRONTEND)
+	STRESSOR(frontend, FRONTEND, CLASS_CPU | CLASS_CPU_CACHE),
+#endif
 	STRESSOR(fstat, FSTAT, CLASS_FILESYSTEM | CLASS_OS),
 #if defined(STRESS_FULL)
 	STRESSOR(full, FULL, CLASS_DEV | CLASS_MEMORY | CLASS_OS),
@@ -298,17 +372,21 @@ static const stress_t stressors[] = {
 #endif
 	STRESSOR(get, GET, CLASS_OS),
 #if defined(STRESS_GETRANDOM)
-	STRESSOR(getrandom, GETRANDOM, CLASS_OS | CLASS_CPU),
+	STRESSOR_THREADED(getrandom, GETRANDOM, CLASS_OS | CLASS_CPU),
 #endif
 #if defined(STRESS_GETDENT)
 	STRESSOR(getdent, GETDENT, CLASS_FILESYSTEM | CLASS_OS),
 #endif
 #if defined(STRESS_HANDLE)
 	STRESSOR(handle, HANDLE, CLASS_FILESYSTEM | CLASS_OS),
+#endif
+	STRESSOR_THREADED(hash, HASH, CLASS_CPU | CLASS_CPU_CACHE),
+#if defined(STRESS_HASHMAP)
+	STRESSOR(hashmap, HASHMAP, CLASS_CPU_CACHE | CLASS_MEMORY),
 #endif
 	STRESSOR(hdd, HDD, CLASS_IO | CLASS_OS),
 #if defined(STRESS_HEAPSORT)
-	STRESSOR(heapsort, HEAPSORT, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
+	STRESSOR_UNIT(heapsort, HEAPSORT, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY, "elements"),
 #endif
 	STRESSOR(hsearch, HSEARCH, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
 #if defined(STRESS_ICACHE)
@@ -318,6 +396,12 @@ static const stress_t stressors[] = {
 	STRESSOR(icmp_flood, ICMP_FLOOD, CLASS_OS | CLASS_NETWORK),
 #endif
 	STRESSOR(io, IOSYNC, CLASS_FILESYSTEM | CLASS_OS),
+#if defined(STRESS_IO_URING_NET)
+	STRESSOR(io_uring_net, IO_URING_NET, CLASS_NETWORK | CLASS_OS),
+#endif
+#if defined(STRESS_IOCMP)
+	STRESSOR(iocmp, IOCMP, CLASS_FILESYSTEM | CLASS_OS),
+#endif
 #if defined(STRESS_IOPRIO)
 	STRESSOR(ioprio, IOPRIO, CLASS_FILESYSTEM | CLASS_OS),
 #endif
@@ -331,12 +415,18 @@ static const stress_t stressors[] = {
 #if defined(STRESS_KEY)
 	STRESSOR(key, KEY, CLASS_OS),
 #endif
-	STRESSOR(kill, KILL, CLASS_INTERRUPT | CLASS_SCHEDULER | CLASS_OS),
+	STRESSOR_UNIT(kill, KILL, CLASS_INTERRUPT | CLASS_SCHEDULER | CLASS_OS, "syscalls"),
 #if defined(STRESS_KLOG)
 	STRESSOR(klog, KLOG, CLASS_OS),
 #endif
+#if defined(STRESS_KSM)
+	STRESSOR(ksm, KSM, CLASS_VM | CLASS_OS),
+#endif
 #if defined(STRESS_LEASE)
 	STRESSOR(lease, LEASE, CLASS_FILESYSTEM | CLASS_OS),
+#endif
+#if defined(STRESS_LFQUEUE)
+	STRESSOR(lfqueue, LFQUEUE, CLASS_CPU | CLASS_CPU_CACHE),
 #endif
 	STRESSOR(link, LINK, CLASS_FILESYSTEM | CLASS_OS),
 #if defined(STRESS_LOCKBUS)
@@ -352,7 +442,7 @@ static const stress_t stressors[] = {
 	STRESSOR(lockofd, LOCKOFD, CLASS_FILESYSTEM | CLASS_OS),
 #endif
 	STRESSOR(longjmp, LONGJMP, CLASS_CPU),
-	STRESSOR(lsearch, LSEARCH, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
+	STRESSOR_THREADED(lsearch, LSEARCH, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
 #if defined(STRESS_MADVISE)
 	STRESSOR(madvise, MADVISE, CLASS_VM | CLASS_OS),
 #endif
@@ -361,39 +451,43 @@ static const stress_t stressors[] = {
 #if defined(STRESS_MEMBARRIER)
 	STRESSOR(membarrier, MEMBARRIER, CLASS_CPU_CACHE | CLASS_MEMORY),
 #endif
-	STRESSOR(memcpy, MEMCPY, CLASS_CPU_CACHE | CLASS_MEMORY),
+	STRESSOR_THREADED_UNIT(memcpy, MEMCPY, CLASS_CPU_CACHE | CLASS_MEMORY, "bytes"),
 #if defined(STRESS_MEMFD)
 	STRESSOR(memfd, MEMFD, CLASS_OS | CLASS_MEMORY),
 #endif
 #if defined(STRESS_MERGESORT)
-	STRESSOR(mergesort, MERGESORT, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
+	STRESSOR_UNIT(mergesort, MERGESORT, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY, "elements"),
 #endif
+	STRESSOR(metadata, METADATA, CLASS_FILESYSTEM | CLASS_OS),
 #if defined(STRESS_MINCORE)
-	STRESSOR(mincore, MINCORE, CLASS_OS | CLASS_MEMORY),
+	STRESSOR_THREADED(mincore, MINCORE, CLASS_OS | CLASS_MEMORY),
 #endif
 	STRESSOR(mknod, MKNOD, CLASS_FILESYSTEM | CLASS_OS),
 #if defined(STRESS_MLOCK)
 	STRESSOR(mlock, MLOCK, CLASS_VM | CLASS_OS),
 #endif
-	STRESSOR(mmap, MMAP, CLASS_VM | CLASS_OS),
+	STRESSOR_THREADED(mmap, MMAP, CLASS_VM | CLASS_OS),
 #if defined(STRESS_MMAPFORK)
 	STRESSOR(mmapfork, MMAPFORK, CLASS_SCHEDULER | CLASS_VM | CLASS_OS),
+#endif
+#if defined(STRESS_MMAPLOCK)
+	STRESSOR(mmaplock, MMAPLOCK, CLASS_VM | CLASS_OS),
 #endif
 	STRESSOR(mmapmany, MMAPMANY, CLASS_VM | CLASS_OS),
 #if defined(STRESS_MREMAP)
 	STRESSOR(mremap, MREMAP, CLASS_VM | CLASS_OS),
 #endif
 #if defined(STRESS_MSG)
-	STRESSOR(msg, MSG, CLASS_SCHEDULER | CLASS_OS),
+	STRESSOR_UNIT(msg, MSG, CLASS_SCHEDULER | CLASS_OS, "messages"),
 #endif
 #if defined(STRESS_MSYNC)
 	STRESSOR(msync, MSYNC, CLASS_VM | CLASS_OS),
 #endif
 #if defined(STRESS_MQ)
-	STRESSOR(mq, MQ, CLASS_SCHEDULER | CLASS_OS),
+	STRESSOR_UNIT(mq, MQ, CLASS_SCHEDULER | CLASS_OS, "messages"),
 #endif
 	STRESSOR(nice, NICE, CLASS_SCHEDULER | CLASS_OS),
-	STRESSOR(null, NULL, CLASS_DEV | CLASS_MEMORY | CLASS_OS),
+	STRESSOR_THREADED_UNIT(null, NULL, CLASS_DEV | CLASS_MEMORY | CLASS_OS, "bytes"),
 #if defined(STRESS_NUMA)
 	STRESSOR(numa, NUMA, CLASS_CPU | CLASS_MEMORY | CLASS_OS),
 #endif
@@ -407,7 +501,7 @@ static const stress_t stressors[] = {
 #if defined(STRESS_PERSONALITY)
 	STRESSOR(personality, PERSONALITY, CLASS_OS),
 #endif
-	STRESSOR(pipe, PIPE, CLASS_PIPE_IO | CLASS_MEMORY | CLASS_OS),
+	STRESSOR_UNIT(pipe, PIPE, CLASS_PIPE_IO | CLASS_MEMORY | CLASS_OS, "bytes"),
 	STRESSOR(poll, POLL, CLASS_SCHEDULER | CLASS_OS),
 #if defined(STRESS_PROCFS)
 	STRESSOR(procfs, PROCFS, CLASS_FILESYSTEM | CLASS_OS),
@@ -421,7 +515,7 @@ static const stress_t stressors[] = {
 #if defined(STRESS_PTY)
 	STRESSOR(pty, PTY, CLASS_OS),
 #endif
-	STRESSOR(qsort, QSORT, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
+	STRESSOR_UNIT(qsort, QSORT, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY, "elements"),
 #if defined(STRESS_QUOTA)
 	STRESSOR(quota, QUOTA, CLASS_OS),
 #endif
@@ -445,6 +539,9 @@ static const stress_t stressors[] = {
 #if defined(STRESS_RTC)
 	STRESSOR(rtc, RTC, CLASS_OS),
 #endif
+#if defined(STRESS_SCHEDLAT)
+	STRESSOR(schedlat, SCHEDLAT, CLASS_SCHEDULER | CLASS_OS),
+#endif
 #if defined(STRESS_SCTP)
 	STRESSOR(sctp, SCTP, CLASS_NETWORK),
 #endif
@@ -486,6 +583,7 @@ static const stress_t stressors[] = {
 	STRESSOR(sockfd, SOCKET_FD, CLASS_NETWORK | CLASS_OS),
 #endif
 	STRESSOR(sockpair, SOCKET_PAIR, CLASS_NETWORK | CLASS_OS),
+	STRESSOR(sort, SORT, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
 #if defined(STRESS_SPAWN)
 	STRESSOR(spawn, SPAWN, CLASS_SCHEDULER | CLASS_OS),
 #endif
@@ -496,13 +594,17 @@ static const stress_t stressors[] = {
 #if defined(STRESS_STACKMMAP)
 	STRESSOR(stackmmap, STACKMMAP, CLASS_VM | CLASS_MEMORY),
 #endif
-	STRESSOR(str, STR, CLASS_CPU | CLASS_CPU_CACHE | CLASS_MEMORY),
-	STRESSOR(stream, STREAM, CLASS_CPU | CLASS_CPU_CACHE | CLASS_MEMORY),
+	STRESSOR_THREADED(str, STR, CLASS_CPU | CLASS_CPU_CACHE | CLASS_MEMORY),
+	STRESSOR_UNIT(stream, STREAM, CLASS_CPU | CLASS_CPU_CACHE | CLASS_MEMORY, "bytes"),
+#if defined(STRESS_SWAP)
+	STRESSOR(swap, SWAP, CLASS_VM | CLASS_OS),
+#endif
 	STRESSOR(switch, SWITCH, CLASS_SCHEDULER | CLASS_OS),
 	STRESSOR(symlink, SYMLINK, CLASS_FILESYSTEM | CLASS_OS),
 #if defined(STRESS_SYNC_FILE)
 	STRESSOR(sync_file, SYNC_FILE, CLASS_IO | CLASS_FILESYSTEM | CLASS_OS),
 #endif
+	STRESSOR(syscall, SYSCALL, CLASS_OS | CLASS_CPU),
 	STRESSOR(sysinfo, SYSINFO, CLASS_OS),
 #if defined(STRESS_SYSFS)
 	STRESSOR(sysfs, SYSFS, CLASS_OS),
@@ -516,29 +618,35 @@ static const stress_t stressors[] = {
 #if defined(STRESS_TIMERFD)
 	STRESSOR(timerfd, TIMERFD, CLASS_INTERRUPT | CLASS_OS),
 #endif
+#if defined(STRESS_TLB)
+	STRESSOR(tlb, TLB, CLASS_CPU_CACHE | CLASS_MEMORY),
+#endif
 #if defined(STRESS_TLB_SHOOTDOWN)
 	STRESSOR(tlb_shootdown, TLB_SHOOTDOWN, CLASS_OS | CLASS_MEMORY),
 #endif
 #if defined(STRESS_TSC)
 	STRESSOR(tsc, TSC, CLASS_CPU),
 #endif
-	STRESSOR(tsearch, TSEARCH, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
+	STRESSOR_THREADED(tsearch, TSEARCH, CLASS_CPU_CACHE | CLASS_CPU | CLASS_MEMORY),
 	STRESSOR(udp, UDP, CLASS_NETWORK | CLASS_OS),
 #if defined(STRESS_UDP_FLOOD)
 	STRESSOR(udp_flood, UDP_FLOOD, CLASS_NETWORK | CLASS_OS),
 #endif
+#if defined(STRESS_ULOCK)
+	STRESSOR(ulock, ULOCK, CLASS_CPU | CLASS_CPU_CACHE),
+#endif
 #if defined(STRESS_UNSHARE)
 	STRESSOR(unshare, UNSHARE, CLASS_OS),
 #endif
 #if defined(STRESS_URANDOM)
-	STRESSOR(urandom, URANDOM, CLASS_DEV | CLASS_OS),
+	STRESSOR_THREADED(urandom, URANDOM, CLASS_DEV | CLASS_OS),
 #endif
 #if defined(STRESS_USERFAULTFD)
 	STRESSOR(userfaultfd, USERFAULTFD, CLASS_VM | CLASS_OS),
 #endif
 	STRESSOR(utime, UTIME, CLASS_FILESYSTEM | CLASS_OS),
 #if defined(STRESS_VECMATH)
-	STRESSOR(vecmath, VECMATH, CLASS_CPU | CLASS_CPU_CACHE),
+	STRESSOR_THREADED(vecmath, VECMATH, CLASS_CPU | CLASS_CPU_CACHE),
 #endif
 #if defined(STRESS_VFORK)
 	STRESSOR(vfork, VFORK, CLASS_SCHEDULER | CLASS_OS),
@@ -552,6 +660,9 @@ static const stress_t stressors[] = {
 #endif
 #if defined(STRESS_WAIT)
 	STRESSOR(wait, WAIT, CLASS_SCHEDULER | CLASS_OS),
+#endif
+#if defined(STRESS_WAKEUP)
+	STRESSOR(wakeup, WAKEUP, CLASS_SCHEDULER | CLASS_OS),
 #endif
 	STRESSOR(wcs, WCS, CLASS_CPU | CLASS_CPU_CACHE | CLASS_MEMORY),
 #if defined(STRESS_XATTR)
@@ -560,12 +671,12 @@ static const stress_t stressors[] = {
 #if defined(STRESS_YIELD)
 	STRESSOR(yield, YIELD, CLASS_SCHEDULER | CLASS_OS),
 #endif
-	STRESSOR(zero, ZERO, CLASS_DEV | CLASS_MEMORY | CLASS_OS),
+	STRESSOR_THREADED_UNIT(zero, ZERO, CLASS_DEV | CLASS_MEMORY | CLASS_OS, "bytes"),
 #if defined(STRESS_ZLIB)
 	STRESSOR(zlib, ZLIB, CLASS_CPU | CLASS_CPU_CACHE | CLASS_MEMORY),
 #endif
 	STRESSOR(zombie, ZOMBIE, CLASS_SCHEDULER | CLASS_OS),
-	{ stress_noop, STRESS_MAX, 0, 0, NULL, 0 }
+	{ stress_noop, STRESS_MAX, 0, 0, NULL, 0, false, NULL }
 };
 
 STRESS_ASSERT(SIZEOF_ARRAY(stressors) != STRESS_MAX)
@@ -597,6 +708,13 @@ static const struct option long_options[] = {
 #if defined(STRESS_AF_ALG)
 	{ "af-alg",	1,	0,	OPT_AF_ALG },
 	{ "af-alg-ops",	1,	0,	OPT_AF_ALG_OPS },
+	{ "af-alg-throughput",0,0,	OPT_AF_ALG_THROUGHPUT },
+#endif
+#if defined(STRESS_AF_PACKET)
+	{ "af-packet",	1,	0,	OPT_AF_PACKET },
+	{ "af-packet-ops",1,	0,	OPT_AF_PACKET_OPS },
+	{ "af-packet-port",1,	0,	OPT_AF_PACKET_PORT },
+	{ "af-packet-size",1,	0,	OPT_AF_PACKET_SIZE },
 #endif
 	{ "aggressive",	0,	0,	OPT_AGGRESSIVE },
 #if defined(STRESS_AIO)
@@ -608,12 +726,23 @@ static const struct option long_options[] = {
 	{ "aiol",	1,	0,	OPT_AIO_LINUX },
 	{ "aiol-ops",	1,	0,	OPT_AIO_LINUX_OPS },
 	{ "aiol-requests",1,	0,	OPT_AIO_LINUX_REQUESTS },
+	{ "aiol-sweep",	0,	0,	OPT_AIO_LINUX_SWEEP },
+	{ "aiol-min-nr",1,	0,	OPT_AIO_LINUX_MIN_NR },
 #endif
 	{ "all",	1,	0,	OPT_ALL },
 #if defined(STRESS_APPARMOR)
 	{ "apparmor",	1,	0,	OPT_APPARMOR },
 	{ "apparmor-ops",1,	0,	OPT_APPARMOR_OPS },
 #endif
+#if defined(STRESS_ARENA)
+	{ "arena",	1,	0,	OPT_ARENA },
+	{ "arena-ops",	1,	0,	OPT_ARENA_OPS },
+	{ "arena-method",1,	0,	OPT_ARENA_METHOD },
+	{ "arena-objects",1,	0,	OPT_ARENA_OBJECTS },
+	{ "arena-size",	1,	0,	OPT_ARENA_SIZE },
+	{ "arena-tcache",0,	0,	OPT_ARENA_TCACHE },
+	{ "arena-threads",1,	0,	OPT_ARENA_THREADS },
+#endif
 #if defined(STRESS_ATOMIC)
 	{ "atomic",	1,	0,	OPT_ATOMIC },
 	{ "atomic-ops",	1,	0,	OPT_ATOMIC_OPS },
@@ -632,6 +761,8 @@ static const struct option long_options[] = {
 	{ "bsearch",	1,	0,	OPT_BSEARCH },
 	{ "bsearch-ops",1,	0,	OPT_BSEARCH_OPS },
 	{ "bsearch-size",1,	0,	OPT_BSEARCH_SIZE },
+	{ "bsearch-method",1,	0,	OPT_BSEARCH_METHOD },
+	{ "bsearch-sweep",0,	0,	OPT_BSEARCH_SWEEP },
 	{ "cache",	1,	0, 	OPT_CACHE },
 	{ "cache-ops",	1,	0,	OPT_CACHE_OPS },
 	{ "cache-prefetch",0,	0,	OPT_CACHE_PREFETCH },
@@ -640,6 +771,11 @@ static const struct option long_options[] = {
 	{ "cache-level",1,	0,	OPT_CACHE_LEVEL},
 	{ "cache-ways",1,	0,	OPT_CACHE_WAYS},
 	{ "cache-no-affinity",0,	0,	OPT_CACHE_NO_AFFINITY },
+	{ "cacheline",	1,	0,	OPT_CACHELINE },
+	{ "cacheline-ops",1,	0,	OPT_CACHELINE_OPS },
+	{ "cacheline-layout",1,	0,	OPT_CACHELINE_LAYOUT },
+	{ "cacheline-op",1,	0,	OPT_CACHELINE_OP },
+	{ "cacheline-matrix",1,	0,	OPT_CACHELINE_MATRIX },
 #if defined(STRESS_CAP)
 	{ "cap",	1,	0, 	OPT_CAP },
 	{ "cap-ops",	1,	0, 	OPT_CAP_OPS },
@@ -650,37 +786,62 @@ static const struct option long_options[] = {
 	{ "chmod-ops",	1,	0,	OPT_CHMOD_OPS },
 	{ "chown",	1,	0, 	OPT_CHOWN},
 	{ "chown-ops",	1,	0,	OPT_CHOWN_OPS },
+	{ "cgroup",	1,	0,	OPT_CGROUP },
+	{ "cgroup-cpu-max",1,	0,	OPT_CGROUP_CPU_MAX },
+	{ "cgroup-memory-max",1,0,	OPT_CGROUP_MEMORY_MAX },
+	{ "cgroup-io-max",1,	0,	OPT_CGROUP_IO_MAX },
+	{ "resctrl",	1,	0,	OPT_RESCTRL },
+	{ "irq-stats",	1,	0,	OPT_IRQ_STATS },
 	{ "class",	1,	0,	OPT_CLASS },
+	{ "compare",	1,	0,	OPT_COMPARE },
+	{ "compare-threshold",1,0,	OPT_COMPARE_THRESHOLD },
+	{ "cpufreq",	0,	0,	OPT_CPUFREQ },
 #if defined(STRESS_CLOCK)
 	{ "clock",	1,	0,	OPT_CLOCK },
 	{ "clock-ops",	1,	0,	OPT_CLOCK_OPS },
+	{ "clock-cost",	0,	0,	OPT_CLOCK_COST },
 #endif
 #if defined(STRESS_CLONE)
 	{ "clone",	1,	0,	OPT_CLONE },
 	{ "clone-ops",	1,	0,	OPT_CLONE_OPS },
 	{ "clone-max",	1,	0,	OPT_CLONE_MAX },
 #endif
+#if defined(STRESS_COMPACT)
+	{ "compact",	1,	0,	OPT_COMPACT },
+	{ "compact-ops",1,	0,	OPT_COMPACT_OPS },
+	{ "compact-bytes",1,	0,	OPT_COMPACT_BYTES },
+	{ "compact-keep",1,	0,	OPT_COMPACT_KEEP },
+	{ "compact-pin",1,	0,	OPT_COMPACT_PIN },
+#endif
 #if defined(STRESS_CONTEXT)
 	{ "context",	1,	0,	OPT_CONTEXT },
 	{ "context-ops",1,	0,	OPT_CONTEXT_OPS },
+	{ "context-compare",0,	0,	OPT_CONTEXT_COMPARE },
 #endif
 #if defined(STRESS_COPY_FILE)
 	{ "copy-file",	1,	0,	OPT_COPY_FILE },
 	{ "copy-file-ops", 1,	0,	OPT_COPY_FILE_OPS },
 	{ "copy-file-bytes", 1, 0,	OPT_COPY_FILE_BYTES },
+	{ "copy-file-sweep", 0, 0,	OPT_COPY_FILE_SWEEP },
 #endif
 	{ "cpu",	1,	0,	OPT_CPU },
 	{ "cpu-ops",	1,	0,	OPT_CPU_OPS },
+	{ "cpu-avx-interfere",0,0,	OPT_CPU_AVX_INTERFERE },
 	{ "cpu-load",	1,	0,	OPT_CPU_LOAD },
 	{ "cpu-load-slice",1,	0,	OPT_CPU_LOAD_SLICE },
+	{ "cpu-load-period",1,	0,	OPT_CPU_LOAD_PERIOD },
+	{ "cpu-load-profile",1,	0,	OPT_CPU_LOAD_PROFILE },
 	{ "cpu-method",	1,	0,	OPT_CPU_METHOD },
 #if defined(STRESS_CPU_ONLINE)
 	{ "cpu-online",	1,	0,	OPT_CPU_ONLINE },
 	{ "cpu-online-ops",1,	0,	OPT_CPU_ONLINE_OPS },
+	{ "cpu-online-impact",0,0,	OPT_CPU_ONLINE_IMPACT },
 #endif
 #if defined(STRESS_CRYPT)
 	{ "crypt",	1,	0,	OPT_CRYPT },
 	{ "crypt-ops",	1,	0,	OPT_CRYPT_OPS },
+	{ "crypt-method",1,	0,	OPT_CRYPT_METHOD },
+	{ "crypt-rounds",1,	0,	OPT_CRYPT_ROUNDS },
 #endif
 	{ "daemon",	1,	0,	OPT_DAEMON },
 	{ "daemon-ops",	1,	0,	OPT_DAEMON_OPS },
@@ -688,20 +849,30 @@ static const struct option long_options[] = {
 	{ "dentry-ops",	1,	0,	OPT_DENTRY_OPS },
 	{ "dentries",	1,	0,	OPT_DENTRIES },
 	{ "dentry-order",1,	0,	OPT_DENTRY_ORDER },
+	{ "dentry-negative",0,	0,	OPT_DENTRY_NEGATIVE },
 	{ "dir",	1,	0,	OPT_DIR },
 	{ "dir-ops",	1,	0,	OPT_DIR_OPS },
 	{ "dry-run",	0,	0,	OPT_DRY_RUN },
 #if defined(STRESS_DNOTIFY)
 	{ "dnotify",	1,	0,	OPT_DNOTIFY },
 	{ "dnotify-ops",1,	0,	OPT_DNOTIFY_OPS },
+#endif
+#if defined(STRESS_DSP)
+	{ "dsp",	1,	0,	OPT_DSP },
+	{ "dsp-ops",	1,	0,	OPT_DSP_OPS },
+	{ "dsp-method",	1,	0,	OPT_DSP_METHOD },
+	{ "dsp-sizes",	1,	0,	OPT_DSP_SIZES },
 #endif
 	{ "dup",	1,	0,	OPT_DUP },
 	{ "dup-ops",	1,	0,	OPT_DUP_OPS },
+	{ "energy",	0,	0,	OPT_ENERGY },
 #if defined(STRESS_EPOLL)
 	{ "epoll",	1,	0,	OPT_EPOLL },
 	{ "epoll-ops",	1,	0,	OPT_EPOLL_OPS },
 	{ "epoll-port",	1,	0,	OPT_EPOLL_PORT },
 	{ "epoll-domain",1,	0,	OPT_EPOLL_DOMAIN },
+	{ "epoll-conns",1,	0,	OPT_EPOLL_CONNS },
+	{ "epoll-threads",1,	0,	OPT_EPOLL_THREADS },
 #endif
 #if defined(STRESS_EVENTFD)
 	{ "eventfd",	1,	0,	OPT_EVENTFD },
@@ -712,14 +883,18 @@ static const struct option long_options[] = {
 	{ "exec",	1,	0,	OPT_EXEC },
 	{ "exec-ops",	1,	0,	OPT_EXEC_OPS },
 	{ "exec-max",	1,	0,	OPT_EXEC_MAX },
+	{ "exec-targets",1,	0,	OPT_EXEC_TARGETS },
 #endif
 #if defined(STRESS_FALLOCATE)
 	{ "fallocate",	1,	0,	OPT_FALLOCATE },
 	{ "fallocate-ops",1,	0,	OPT_FALLOCATE_OPS },
 	{ "fallocate-bytes",1,	0,	OPT_FALLOCATE_BYTES },
+	{ "fallocate-matrix",0,	0,	OPT_FALLOCATE_MATRIX },
+	{ "fallocate-gran",1,	0,	OPT_FALLOCATE_GRAN },
 #endif
 	{ "fault",	1,	0,	OPT_FAULT },
 	{ "fault-ops",	1,	0,	OPT_FAULT_OPS },
+	{ "fault-class",1,	0,	OPT_FAULT_CLASS },
 	{ "fcntl",	1,	0,	OPT_FCNTL},
 	{ "fcntl-ops",	1,	0,	OPT_FCNTL_OPS },
 #if defined(STRESS_FIEMAP)
@@ -735,14 +910,36 @@ static const struct option long_options[] = {
 	{ "filename-opts",1,	0,	OPT_FILENAME_OPTS },
 	{ "flock",	1,	0,	OPT_FLOCK },
 	{ "flock-ops",	1,	0,	OPT_FLOCK_OPS },
+	{ "flock-contenders",1,	0,	OPT_FLOCK_CONTENDERS },
 	{ "fork",	1,	0,	OPT_FORK },
 	{ "fork-ops",	1,	0,	OPT_FORK_OPS },
 	{ "fork-max",	1,	0,	OPT_FORK_MAX },
+#if defined(STRESS_LATENCY)
+	{ "fork-latency",0,	0,	OPT_FORK_LATENCY },
+	{ "fork-method",1,	0,	OPT_FORK_METHOD },
+	{ "fork-rss",	1,	0,	OPT_FORK_RSS },
+#endif
+	{ "forkheap",	1,	0,	OPT_FORKHEAP },
+	{ "forkheap-ops",1,	0,	OPT_FORKHEAP_OPS },
+	{ "forkheap-bytes",1,	0,	OPT_FORKHEAP_BYTES },
+	{ "forkheap-cow",1,	0,	OPT_FORKHEAP_COW },
+	{ "forkheap-thp",0,	0,	OPT_FORKHEAP_THP },
+	{ "forkheap-vmas",1,	0,	OPT_FORKHEAP_VMAS },
 	{ "fp-error",	1,	0,	OPT_FP_ERROR},
 	{ "fp-error-ops",1,	0,	OPT_FP_ERROR_OPS },
+#if defined(STRESS_FRONTEND)
+	{ "frontend",	1,	0,	OPT_FRONTEND },
+	{ "frontend-ops",1,	0,	OPT_FRONTEND_OPS },
+	{ "frontend-mode",1,	0,	OPT_FRONTEND_MODE },
+	{ "frontend-size",1,	0,	OPT_FRONTEND_SIZE },
+	{ "frontend-entropy",1,	0,	OPT_FRONTEND_ENTROPY },
+#endif
 	{ "fstat",	1,	0,	OPT_FSTAT },
 	{ "fstat-ops",	1,	0,	OPT_FSTAT_OPS },
 	{ "fstat-dir",	1,	0,	OPT_FSTAT_DIR },
+#if defined(HAVE_LIB_PTHREAD)
+	{ "fstat-pthreads",1,	0,	OPT_FSTAT_PTHREADS },
+#endif
 #if defined(STRESS_FULL)
 	{ "full",	1,	0,	OPT_FULL },
 	{ "full-ops",	1,	0,	OPT_FULL_OPS },
@@ -750,26 +947,49 @@ static const struct option long_options[] = {
 #if defined(STRESS_FUTEX)
 	{ "futex",	1,	0,	OPT_FUTEX },
 	{ "futex-ops",	1,	0,	OPT_FUTEX_OPS },
+	{ "futex-mode",	1,	0,	OPT_FUTEX_MODE },
+	{ "futex-waiters",1,	0,	OPT_FUTEX_WAITERS },
+	{ "futex-wake",	1,	0,	OPT_FUTEX_WAKE },
 #endif
 	{ "get",	1,	0,	OPT_GET },
 	{ "get-ops",	1,	0,	OPT_GET_OPS },
 #if defined(STRESS_GETRANDOM)
 	{ "getrandom",	1,	0,	OPT_GETRANDOM },
 	{ "getrandom-ops",1,	0,	OPT_GETRANDOM_OPS },
+	{ "getrandom-sweep",0,	0,	OPT_GETRANDOM_SWEEP },
 #endif
 #if defined(STRESS_GETDENT)
 	{ "getdent",	1,	0,	OPT_GETDENT },
 	{ "getdent-ops",1,	0,	OPT_GETDENT_OPS },
+	{ "getdent-entries",1,	0,	OPT_GETDENT_ENTRIES },
 #endif
 #if defined(STRESS_HANDLE)
 	{ "handle",	1,	0,	OPT_HANDLE },
 	{ "handle-ops",	1,	0,	OPT_HANDLE_OPS },
+#endif
+	{ "hash",	1,	0,	OPT_HASH },
+	{ "hash-ops",	1,	0,	OPT_HASH_OPS },
+	{ "hash-method",1,	0,	OPT_HASH_METHOD },
+#if defined(STRESS_HASHMAP)
+	{ "hashmap",	1,	0,	OPT_HASHMAP },
+	{ "hashmap-ops",1,	0,	OPT_HASHMAP_OPS },
+	{ "hashmap-method",1,	0,	OPT_HASHMAP_METHOD },
+	{ "hashmap-keys",1,	0,	OPT_HASHMAP_KEYS },
+	{ "hashmap-reads",1,	0,	OPT_HASHMAP_READS },
+	{ "hashmap-threads",1,	0,	OPT_HASHMAP_THREADS },
+	{ "hashmap-zipf",1,	0,	OPT_HASHMAP_ZIPF },
 #endif
 	{ "hdd",	1,	0,	OPT_HDD },
 	{ "hdd-ops",	1,	0,	OPT_HDD_OPS },
 	{ "hdd-bytes",	1,	0,	OPT_HDD_BYTES },
 	{ "hdd-write-size", 1,	0,	OPT_HDD_WRITE_SIZE },
 	{ "hdd-opts",	1,	0,	OPT_HDD_OPTS },
+	{ "hdd-engine",	1,	0,	OPT_HDD_ENGINE },
+	{ "hdd-qd",	1,	0,	OPT_HDD_QD },
+	{ "hdd-dist",	1,	0,	OPT_HDD_DIST },
+	{ "hdd-rw-mix",	1,	0,	OPT_HDD_RW_MIX },
+	{ "hdd-paths",	1,	0,	OPT_HDD_PATHS },
+	{ "hdd-stripe",	1,	0,	OPT_HDD_STRIPE },
 #if defined(STRESS_HEAPSORT)
 	{ "heapsort",	1,	0,	OPT_HEAPSORT },
 	{ "heapsort-ops",1,	0,	OPT_HEAPSORT_OPS },
@@ -779,6 +999,7 @@ static const struct option long_options[] = {
 	{ "hsearch",	1,	0,	OPT_HSEARCH },
 	{ "hsearch-ops",1,	0,	OPT_HSEARCH_OPS },
 	{ "hsearch-size",1,	0,	OPT_HSEARCH_SIZE },
+	{ "hugepages",	1,	0,	OPT_HUGEPAGES },
 #if defined(STRESS_ICACHE)
 	{ "icache",	1,	0,	OPT_ICACHE },
 	{ "icache-ops",	1,	0,	OPT_ICACHE_OPS },
@@ -786,11 +1007,18 @@ static const struct option long_options[] = {
 #if defined(STRESS_ICMP_FLOOD)
 	{ "icmp-flood",	1,	0,	OPT_ICMP_FLOOD },
 	{ "icmp-flood-ops",1,	0,	OPT_ICMP_FLOOD_OPS },
+	{ "icmp-flood-batch",1,	0,	OPT_ICMP_FLOOD_BATCH },
+	{ "icmp-flood-recv",0,	0,	OPT_ICMP_FLOOD_RECV },
+	{ "icmp-flood-sweep",0,	0,	OPT_ICMP_FLOOD_SWEEP },
 #endif
 	{ "ignite-cpu",	0,	0, 	OPT_IGNITE_CPU },
+	{ "ignite-cpu-list",1,	0, 	OPT_IGNITE_CPU_LIST },
+	{ "ignite-cpu-baseline",1,0, 	OPT_IGNITE_CPU_BASELINE },
 #if defined(STRESS_INOTIFY)
 	{ "inotify",	1,	0,	OPT_INOTIFY },
 	{ "inotify-ops",1,	0,	OPT_INOTIFY_OPS },
+	{ "inotify-writers",1,	0,	OPT_INOTIFY_WRITERS },
+	{ "inotify-api",1,	0,	OPT_INOTIFY_API },
 #endif
 	{ "io",		1,	0,	OPT_IOSYNC },
 	{ "io-ops",	1,	0,	OPT_IOSYNC_OPS },
@@ -798,6 +1026,24 @@ static const struct option long_options[] = {
 	{ "ionice-class",1,	0,	OPT_IONICE_CLASS },
 	{ "ionice-level",1,	0,	OPT_IONICE_LEVEL },
 #endif
+#if defined(STRESS_IO_URING_NET)
+	{ "io-uring-net",1,	0,	OPT_IO_URING_NET },
+	{ "io-uring-net-ops",1,	0,	OPT_IO_URING_NET_OPS },
+	{ "io-uring-net-conns",1,0,	OPT_IO_URING_NET_CONNS },
+	{ "io-uring-net-domain",1,0,	OPT_IO_URING_NET_DOMAIN },
+	{ "io-uring-net-port",1,0,	OPT_IO_URING_NET_PORT },
+	{ "io-uring-net-proto",1,0,	OPT_IO_URING_NET_PROTO },
+	{ "io-uring-net-size",1,0,	OPT_IO_URING_NET_SIZE },
+	{ "io-uring-net-sqpoll",0,0,	OPT_IO_URING_NET_SQPOLL },
+#endif
+#if defined(STRESS_IOCMP)
+	{ "iocmp",	1,	0,	OPT_IOCMP },
+	{ "iocmp-ops",	1,	0,	OPT_IOCMP_OPS },
+	{ "iocmp-bs",	1,	0,	OPT_IOCMP_BS },
+	{ "iocmp-qd",	1,	0,	OPT_IOCMP_QD },
+	{ "iocmp-read-pct",1,	0,	OPT_IOCMP_READ_PCT },
+	{ "iocmp-size",	1,	0,	OPT_IOCMP_SIZE },
+#endif
 #if defined(STRESS_IOPRIO)
 	{ "ioprio",	1,	0,	OPT_IOPRIO },
 	{ "ioprio-ops",	1,	0,	OPT_IOPRIO_OPS },
@@ -805,6 +1051,7 @@ static const struct option long_options[] = {
 	{ "itimer",	1,	0,	OPT_ITIMER },
 	{ "itimer-ops",	1,	0,	OPT_ITIMER_OPS },
 	{ "itimer-freq",1,	0,	OPT_ITIMER_FREQ },
+	{ "json",	1,	0,	OPT_JSON },
 #if defined(STRESS_KCMP)
 	{ "kcmp",	1,	0,	OPT_KCMP },
 	{ "kcmp-ops",	1,	0,	OPT_KCMP_OPS },
@@ -812,6 +1059,8 @@ static const struct option long_options[] = {
 #if defined(STRESS_KEY)
 	{ "key",	1,	0,	OPT_KEY },
 	{ "key-ops",	1,	0,	OPT_KEY_OPS },
+	{ "key-max",	1,	0,	OPT_KEY_MAX },
+	{ "key-scale",	0,	0,	OPT_KEY_SCALE },
 #endif
 	{ "keep-name",	0,	0,	OPT_KEEP_NAME },
 	{ "kill",	1,	0,	OPT_KILL },
@@ -820,16 +1069,34 @@ static const struct option long_options[] = {
 	{ "klog",	1,	0,	OPT_KLOG },
 	{" klog-ops",	1,	0,	OPT_KLOG_OPS },
 #endif
+#if defined(STRESS_KSM)
+	{ "ksm",	1,	0,	OPT_KSM },
+	{ "ksm-ops",	1,	0,	OPT_KSM_OPS },
+	{ "ksm-bytes",	1,	0,	OPT_KSM_BYTES },
+	{ "ksm-dup",	1,	0,	OPT_KSM_DUP },
+#endif
+#if defined(STRESS_LATENCY)
+	{ "latency",	1,	0,	OPT_LATENCY },
+#endif
 #if defined(STRESS_LEASE)
 	{ "lease",	1,	0,	OPT_LEASE },
 	{ "lease-ops",	1,	0,	OPT_LEASE_OPS },
 	{ "lease-breakers",1,	0,	OPT_LEASE_BREAKERS },
+#endif
+#if defined(STRESS_LFQUEUE)
+	{ "lfqueue",	1,	0,	OPT_LFQUEUE },
+	{ "lfqueue-ops",1,	0,	OPT_LFQUEUE_OPS },
+	{ "lfqueue-consumers",1,0,	OPT_LFQUEUE_CONSUMERS },
+	{ "lfqueue-pin",0,	0,	OPT_LFQUEUE_PIN },
+	{ "lfqueue-producers",1,0,	OPT_LFQUEUE_PRODUCERS },
+	{ "lfqueue-type",1,	0,	OPT_LFQUEUE_TYPE },
 #endif
 	{ "link",	1,	0,	OPT_LINK },
 	{ "link-ops",	1,	0,	OPT_LINK_OPS },
 #if defined(STRESS_LOCKBUS)
 	{ "lockbus",	1,	0,	OPT_LOCKBUS },
 	{ "lockbus-ops",1,	0,	OPT_LOCKBUS_OPS },
+	{ "lockbus-victim",0,	0,	OPT_LOCKBUS_VICTIM },
 #endif
 #if defined(STRESS_LOCKA)
 	{ "locka",	1,	0,	OPT_LOCKA },
@@ -843,6 +1110,9 @@ static const struct option long_options[] = {
 #if defined(STRESS_LOCKOFD)
 	{ "lockofd",	1,	0,	OPT_LOCKOFD },
 	{ "lockofd-ops",1,	0,	OPT_LOCKOFD_OPS },
+#endif
+#if defined(STRESS_LOG_ASYNC)
+	{ "log-async",	0,	0,	OPT_LOG_ASYNC },
 #endif
 	{ "log-brief",	0,	0,	OPT_LOG_BRIEF },
 	{ "log-file",	1,	0,	OPT_LOG_FILE },
@@ -857,36 +1127,57 @@ static const struct option long_options[] = {
 #endif
 	{ "malloc",	1,	0,	OPT_MALLOC },
 	{ "malloc-bytes",1,	0,	OPT_MALLOC_BYTES },
+	{ "malloc-dist",1,	0,	OPT_MALLOC_DIST },
 	{ "malloc-max",	1,	0,	OPT_MALLOC_MAX },
 	{ "malloc-ops",	1,	0,	OPT_MALLOC_OPS },
+#if defined(HAVE_LIB_PTHREAD)
+	{ "malloc-pthreads",1,	0,	OPT_MALLOC_PTHREADS },
+#endif
 #if defined(STRESS_MALLOPT)
 	{ "malloc-thresh",1,	0,	OPT_MALLOC_THRESHOLD },
+#endif
+#if defined(HAVE_LIB_PTHREAD)
+	{ "malloc-xfree",1,	0,	OPT_MALLOC_XFREE },
 #endif
 	{ "matrix",	1,	0,	OPT_MATRIX },
 	{ "matrix-ops",	1,	0,	OPT_MATRIX_OPS },
 	{ "matrix-method",1,	0,	OPT_MATRIX_METHOD },
 	{ "matrix-size",1,	0,	OPT_MATRIX_SIZE },
+	{ "matrix-threads",1,	0,	OPT_MATRIX_THREADS },
 	{ "maximize",	0,	0,	OPT_MAXIMIZE },
 #if defined(STRESS_MEMBARRIER)
 	{ "membarrier",	1,	0,	OPT_MEMBARRIER },
 	{ "membarrier-ops",1,	0,	OPT_MEMBARRIER_OPS },
+	{ "membarrier-readers",1,0,	OPT_MEMBARRIER_READERS },
+	{ "membarrier-sync",1,	0,	OPT_MEMBARRIER_SYNC },
 #endif
 	{ "memcpy",	1,	0,	OPT_MEMCPY },
 	{ "memcpy",	1,	0,	OPT_MEMCPY },
 	{ "memcpy",	1,	0,	OPT_MEMCPY },
 	{ "memcpy-ops",	1,	0,	OPT_MEMCPY_OPS },
+	{ "memcpy-bw",	1,	0,	OPT_MEMCPY_BW },
+	{ "memcpy-method",1,	0,	OPT_MEMCPY_METHOD },
+	{ "memcpy-sweep",0,	0,	OPT_MEMCPY_SWEEP },
 #if defined(STRESS_MEMFD)
 	{ "memfd",	1,	0,	OPT_MEMFD },
 	{ "memfd-ops",	1,	0,	OPT_MEMFD_OPS },
 	{ "memfd-bytes",1,	0,	OPT_MEMFD_BYTES },
+	{ "memfd-ipc",	0,	0,	OPT_MEMFD_IPC },
+	{ "memfd-consumers",1,	0,	OPT_MEMFD_CONSUMERS },
 #endif
 #if defined(STRESS_MERGESORT)
 	{ "mergesort",	1,	0,	OPT_MERGESORT },
 	{ "mergesort-ops",1,	0,	OPT_MERGESORT_OPS },
 	{ "mergesort-size",1,	0,	OPT_MERGESORT_INTEGERS },
 #endif
+	{ "metadata",	1,	0,	OPT_METADATA },
+	{ "metadata-ops",1,	0,	OPT_METADATA_OPS },
+	{ "metadata-layout",1,	0,	OPT_METADATA_LAYOUT },
+	{ "metadata-files",1,	0,	OPT_METADATA_FILES },
 	{ "metrics",	0,	0,	OPT_METRICS },
 	{ "metrics-brief",0,	0,	OPT_METRICS_BRIEF },
+	{ "migrate",	1,	0,	OPT_MIGRATE },
+	{ "migrate-period",1,	0,	OPT_MIGRATE_PERIOD },
 #if defined(STRESS_MINCORE)
 	{ "mincore",	1,	0,	OPT_MINCORE },
 	{ "mincore-ops",1,	0,	OPT_MINCORE_OPS },
@@ -898,6 +1189,8 @@ static const struct option long_options[] = {
 #if defined(STRESS_MLOCK)
 	{ "mlock",	1,	0,	OPT_MLOCK },
 	{ "mlock-ops",	1,	0,	OPT_MLOCK_OPS },
+	{ "mlock-bytes",1,	0,	OPT_MLOCK_BYTES },
+	{ "mlock-cost",	0,	0,	OPT_MLOCK_COST },
 #endif
 	{ "mmap",	1,	0,	OPT_MMAP },
 	{ "mmap-ops",	1,	0,	OPT_MMAP_OPS },
@@ -905,16 +1198,24 @@ static const struct option long_options[] = {
 	{ "mmap-bytes",	1,	0,	OPT_MMAP_BYTES },
 	{ "mmap-file",	0,	0,	OPT_MMAP_FILE },
 	{ "mmap-mprotect",0,	0,	OPT_MMAP_MPROTECT },
+	{ "mmap-prefault",1,	0,	OPT_MMAP_PREFAULT },
 #if defined(STRESS_MMAPFORK)
 	{ "mmapfork",	1,	0,	OPT_MMAPFORK },
 	{ "mmapfork-ops",1,	0,	OPT_MMAPFORK_OPS },
+#endif
+#if defined(STRESS_MMAPLOCK)
+	{ "mmaplock",	1,	0,	OPT_MMAPLOCK },
+	{ "mmaplock-ops",1,	0,	OPT_MMAPLOCK_OPS },
+	{ "mmaplock-threads",1,	0,	OPT_MMAPLOCK_THREADS },
 #endif
 	{ "mmapmany",	1,	0,	OPT_MMAPMANY },
 	{ "mmapmany-ops",1,	0,	OPT_MMAPMANY_OPS },
+	{ "mmapmany-scale",0,	0,	OPT_MMAPMANY_SCALE },
 #if defined(STRESS_MREMAP)
 	{ "mremap",	1,	0,	OPT_MREMAP },
 	{ "mremap-ops",	1,	0,	OPT_MREMAP_OPS },
 	{ "mremap-bytes",1,	0,	OPT_MREMAP_BYTES },
+	{ "mremap-grow",0,	0,	OPT_MREMAP_GROW },
 #endif
 #if defined(STRESS_MSG)
 	{ "msg",	1,	0,	OPT_MSG },
@@ -929,16 +1230,25 @@ static const struct option long_options[] = {
 	{ "mq",		1,	0,	OPT_MQ },
 	{ "mq-ops",	1,	0,	OPT_MQ_OPS },
 	{ "mq-size",	1,	0,	OPT_MQ_SIZE },
+	{ "mq-sweep",	0,	0,	OPT_MQ_SWEEP },
+	{ "mq-producers",1,	0,	OPT_MQ_PRODUCERS },
+	{ "mq-consumers",1,	0,	OPT_MQ_CONSUMERS },
 #endif
+	{ "net-peer",	1,	0,	OPT_NET_PEER },
+	{ "net-role",	1,	0,	OPT_NET_ROLE },
 	{ "nice",	1,	0,	OPT_NICE },
 	{ "nice-ops",	1,	0,	OPT_NICE_OPS },
+	{ "nice-levels",1,	0,	OPT_NICE_LEVELS },
 	{ "no-madvise",	0,	0,	OPT_NO_MADVISE },
 	{ "no-rand-seed", 0,	0,	OPT_NO_RAND_SEED },
+	{ "numa-place",	1,	0,	OPT_NUMA_PLACE },
 	{ "null",	1,	0,	OPT_NULL },
 	{ "null-ops",	1,	0,	OPT_NULL_OPS },
 #if defined(STRESS_NUMA)
 	{ "numa",	1,	0,	OPT_NUMA },
 	{ "numa-ops",	1,	0,	OPT_NUMA_OPS },
+	{ "numa-bytes",	1,	0,	OPT_NUMA_BYTES },
+	{ "numa-migrate",0,	0,	OPT_NUMA_MIGRATE },
 #endif
 #if defined(STRESS_OOM_PIPE)
 	{ "oom-pipe",	1,	0,	OPT_OOM_PIPE },
@@ -952,11 +1262,15 @@ static const struct option long_options[] = {
 	{ "open-ops",	1,	0,	OPT_OPEN_OPS },
 #if defined(STRESS_PAGE_IN)
 	{ "page-in",	0,	0,	OPT_PAGE_IN },
+	{ "page-residency",0,	0,	OPT_PAGE_RESIDENCY },
 #endif
 	{ "pathological",0,	0,	OPT_PATHOLOGICAL },
 #if defined(STRESS_PERF_STATS)
 	{ "perf",	0,	0,	OPT_PERF_STATS },
+	{ "perf-contention",0,	0,	OPT_PERF_CONTENTION },
+	{ "profile",	0,	0,	OPT_PROFILE },
 #endif
+	{ "pin",	1,	0,	OPT_PIN },
 #if defined(STRESS_PERSONALITY)
 	{ "personality",1,	0,	OPT_PERSONALITY },
 	{ "personality-ops",1,	0,	OPT_PERSONALITY_OPS },
@@ -966,17 +1280,23 @@ static const struct option long_options[] = {
 	{ "pipe-data-size",1,	0,	OPT_PIPE_DATA_SIZE },
 #if defined(F_SETPIPE_SZ)
 	{ "pipe-size",	1,	0,	OPT_PIPE_SIZE },
+	{ "pipe-sweep",	0,	0,	OPT_PIPE_SWEEP },
 #endif
 	{ "poll",	1,	0,	OPT_POLL },
 	{ "poll-ops",	1,	0,	OPT_POLL_OPS },
+	{ "poll-scale",	1,	0,	OPT_POLL_SCALE },
+	{ "psi",	0,	0,	OPT_PSI },
 #if defined(STRESS_PROCFS)
 	{ "procfs",	1,	0,	OPT_PROCFS },
 	{ "procfs-ops",	1,	0,	OPT_PROCFS_OPS },
+	{ "procfs-top",	1,	0,	OPT_PROCFS_TOP },
 #endif
 #if defined(STRESS_PTHREAD)
 	{ "pthread",	1,	0,	OPT_PTHREAD },
 	{ "pthread-ops",1,	0,	OPT_PTHREAD_OPS },
 	{ "pthread-max",1,	0,	OPT_PTHREAD_MAX },
+	{ "pthread-method",1,	0,	OPT_PTHREAD_METHOD },
+	{ "pthread-stack",1,	0,	OPT_PTHREAD_STACK },
 #endif
 #if defined(STRESS_PTRACE)
 	{ "ptrace",	1,	0,	OPT_PTRACE },
@@ -985,6 +1305,8 @@ static const struct option long_options[] = {
 #if defined(STRESS_PTY)
 	{ "pty",	1,	0,	OPT_PTY },
 	{ "pty-ops",	1,	0,	OPT_PTY_OPS },
+	{ "pty-data",	0,	0,	OPT_PTY_DATA },
+	{ "pty-max",	1,	0,	OPT_PTY_MAX },
 #endif
 	{ "qsort",	1,	0,	OPT_QSORT },
 	{ "qsort-ops",	1,	0,	OPT_QSORT_OPS },
@@ -994,15 +1316,21 @@ static const struct option long_options[] = {
 	{ "quota",	1,	0,	OPT_QUOTA },
 	{ "quota-ops",	1,	0,	OPT_QUOTA_OPS },
 #endif
+	{ "ramp",	1,	0,	OPT_RAMP },
+	{ "ramp-file",	1,	0,	OPT_RAMP_FILE },
+	{ "repeat",	1,	0,	OPT_REPEAT },
 	{ "random",	1,	0,	OPT_RANDOM },
 #if defined(STRESS_RDRAND)
 	{ "rdrand",	1,	0,	OPT_RDRAND },
 	{ "rdrand-ops",	1,	0,	OPT_RDRAND_OPS },
+	{ "rdrand-method",1,	0,	OPT_RDRAND_METHOD },
+	{ "rdrand-scale",0,	0,	OPT_RDRAND_SCALE },
 #endif
 #if defined(STRESS_READAHEAD)
 	{ "readahead",	1,	0,	OPT_READAHEAD },
 	{ "readahead-ops",1,	0,	OPT_READAHEAD_OPS },
 	{ "readahead-bytes",1,	0,	OPT_READAHEAD_BYTES },
+	{ "readahead-sweep",0,	0,	OPT_READAHEAD_SWEEP },
 #endif
 #if defined(STRESS_REMAP_FILE_PAGES)
 	{ "remap",	1,	0,	OPT_REMAP_FILE_PAGES },
@@ -1019,18 +1347,35 @@ static const struct option long_options[] = {
 #if defined(STRESS_RMAP)
 	{ "rmap",	1,	0,	OPT_RMAP },
 	{ "rmap-ops",	1,	0,	OPT_RMAP_OPS },
+	{ "rmap-sharers",1,	0,	OPT_RMAP_SHARERS },
+	{ "rmap-scale",	0,	0,	OPT_RMAP_SCALE },
 #endif
 #if defined(STRESS_RTC)
 	{ "rtc",	1,	0,	OPT_RTC },
 	{ "rtc-ops",	1,	0,	OPT_RTC_OPS },
+#endif
+#if defined(STRESS_SAMPLE)
+	{ "sample",	1,	0,	OPT_SAMPLE },
+	{ "sample-file",1,	0,	OPT_SAMPLE_FILE },
+	{ "sample-textfile",1,	0,	OPT_SAMPLE_TEXTFILE },
+	{ "converge",	1,	0,	OPT_CONVERGE },
+	{ "converge-windows",1,	0,	OPT_CONVERGE_WINDOWS },
 #endif
 	{ "sched",	1,	0,	OPT_SCHED },
 	{ "sched-prio",	1,	0,	OPT_SCHED_PRIO },
+#if defined(STRESS_SCHEDLAT)
+	{ "schedlat",	1,	0,	OPT_SCHEDLAT },
+	{ "schedlat-ops",1,	0,	OPT_SCHEDLAT_OPS },
+	{ "schedlat-policy",1,	0,	OPT_SCHEDLAT_POLICY },
+	{ "schedlat-messengers",1,0,	OPT_SCHEDLAT_MESSENGERS },
+	{ "schedlat-think",1,	0,	OPT_SCHEDLAT_THINK },
+#endif
 #if defined(STRESS_SCTP)
 	{ "sctp",	1,	0,	OPT_SCTP },
 	{ "sctp-ops",	1,	0,	OPT_SCTP_OPS },
 	{ "sctp-domain",1,	0,	OPT_SCTP_DOMAIN },
 	{ "sctp-port",	1,	0,	OPT_SCTP_PORT },
+	{ "sctp-streams",1,	0,	OPT_SCTP_STREAMS },
 #endif
 #if defined(STRESS_SEAL)
 	{ "seal",	1,	0,	OPT_SEAL },
@@ -1039,6 +1384,7 @@ static const struct option long_options[] = {
 #if defined(STRESS_SECCOMP)
 	{ "seccomp",	1,	0,	OPT_SECCOMP },
 	{ "seccomp-ops",1,	0,	OPT_SECCOMP_OPS },
+	{ "seccomp-rules",1,	0,	OPT_SECCOMP_RULES },
 #endif
 	{ "seek",	1,	0,	OPT_SEEK },
 	{ "seek-ops",	1,	0,	OPT_SEEK_OPS },
@@ -1060,8 +1406,11 @@ static const struct option long_options[] = {
 	{ "sendfile",	1,	0,	OPT_SENDFILE },
 	{ "sendfile-ops",1,	0,	OPT_SENDFILE_OPS },
 	{ "sendfile-size",1,	0,	OPT_SENDFILE_SIZE },
+	{ "sendfile-sweep",0,	0,	OPT_SENDFILE_SWEEP },
 #endif
 	{ "sequential",	1,	0,	OPT_SEQUENTIAL },
+	{ "smt-bench",	0,	0,	OPT_SMT_BENCH },
+	{ "smt-cpus",	1,	0,	OPT_SMT_CPUS },
 #if defined(STRESS_SHM_POSIX)
 	{ "shm",	1,	0,	OPT_SHM_POSIX },
 	{ "shm-ops",	1,	0,	OPT_SHM_POSIX_OPS },
@@ -1087,6 +1436,7 @@ static const struct option long_options[] = {
 #if defined(STRESS_SIGQUEUE)
 	{ "sigq",	1,	0,	OPT_SIGQUEUE },
 	{ "sigq-ops",	1,	0,	OPT_SIGQUEUE_OPS },
+	{ "sigq-method",1,	0,	OPT_SIGQUEUE_METHOD },
 #endif
 #if defined(STRESS_SLEEP)
 	{ "sleep",	1,	0,	OPT_SLEEP },
@@ -1098,15 +1448,27 @@ static const struct option long_options[] = {
 	{ "sock-nodelay",0,	0,	OPT_SOCKET_NODELAY },
 	{ "sock-ops",	1,	0,	OPT_SOCKET_OPS },
 	{ "sock-opts",	1,	0,	OPT_SOCKET_OPTS },
+	{ "sock-peer",	1,	0,	OPT_SOCKET_PEER },
 	{ "sock-port",	1,	0,	OPT_SOCKET_PORT },
+	{ "sock-role",	1,	0,	OPT_SOCKET_ROLE },
 	{ "sock-type",	1,	0,	OPT_SOCKET_TYPE },
+	{ "sock-msg-size",1,	0,	OPT_SOCKET_MSG_SIZE },
+	{ "sock-mmsg-batch",1,	0,	OPT_SOCKET_MMSG_BATCH },
 #if defined(STRESS_SOCKET_FD)
 	{ "sockfd",	1,	0,	OPT_SOCKET_FD },
 	{ "sockfd-ops",1,	0,	OPT_SOCKET_FD_OPS },
 	{ "sockfd-port",1,	0,	OPT_SOCKET_FD_PORT },
+	{ "sockfd-batch",1,	0,	OPT_SOCKET_FD_BATCH },
+	{ "sockfd-sweep",0,	0,	OPT_SOCKET_FD_SWEEP },
 #endif
 	{ "sockpair",	1,	0,	OPT_SOCKET_PAIR },
 	{ "sockpair-ops",1,	0,	OPT_SOCKET_PAIR_OPS },
+	{ "sort",	1,	0,	OPT_SORT },
+	{ "sort-ops",	1,	0,	OPT_SORT_OPS },
+	{ "sort-dist",	1,	0,	OPT_SORT_DIST },
+	{ "sort-method",1,	0,	OPT_SORT_METHOD },
+	{ "sort-size",	1,	0,	OPT_SORT_SIZE },
+	{ "sort-threads",1,	0,	OPT_SORT_THREADS },
 #if defined(STRESS_SPAWN)
 	{ "spawn",	1,	0,	OPT_SPAWN },
 	{ "spawn-ops",	1,	0,	OPT_SPAWN_OPS },
@@ -1114,10 +1476,13 @@ static const struct option long_options[] = {
 #if defined(STRESS_SPLICE)
 	{ "splice",	1,	0,	OPT_SPLICE },
 	{ "splice-bytes",1,	0,	OPT_SPLICE_BYTES },
+	{ "splice-consumers",1,	0,	OPT_SPLICE_CONSUMERS },
+	{ "splice-mode",1,	0,	OPT_SPLICE_MODE },
 	{ "splice-ops",	1,	0,	OPT_SPLICE_OPS },
 #endif
 	{ "stack",	1,	0,	OPT_STACK},
 	{ "stack-fill",	0,	0,	OPT_STACK_FILL },
+	{ "stack-cost",	0,	0,	OPT_STACK_COST },
 	{ "stack-ops",	1,	0,	OPT_STACK_OPS },
 #if defined(STRESS_STACKMMAP)
 	{ "stackmmap",	1,	0,	OPT_STACKMMAP },
@@ -1126,25 +1491,47 @@ static const struct option long_options[] = {
 	{ "str",	1,	0,	OPT_STR },
 	{ "str-ops",	1,	0,	OPT_STR_OPS },
 	{ "str-method",	1,	0,	OPT_STR_METHOD },
+	{ "str-search",	0,	0,	OPT_STR_SEARCH },
+	{ "str-search-size",1,	0,	OPT_STR_SEARCH_SIZE },
 	{ "stressors",	0,	0,	OPT_STRESSORS },
+	{ "stressor-offset",1,	0,	OPT_STRESSOR_OFFSET },
+	{ "stressor-time",1,	0,	OPT_STRESSOR_TIME },
 	{ "stream",	1,	0,	OPT_STREAM },
 	{ "stream-ops",	1,	0,	OPT_STREAM_OPS },
+	{ "stream-bw",	1,	0,	OPT_STREAM_BW },
+	{ "stream-isa",	1,	0,	OPT_STREAM_ISA },
 	{ "stream-l3-size" ,1,	0,	OPT_STREAM_L3_SIZE },
+	{ "stream-numa",0,	0,	OPT_STREAM_NUMA },
+	{ "stream-threads",1,	0,	OPT_STREAM_THREADS },
+#if defined(STRESS_SWAP)
+	{ "swap",	1,	0,	OPT_SWAP },
+	{ "swap-ops",	1,	0,	OPT_SWAP_OPS },
+	{ "swap-bytes",	1,	0,	OPT_SWAP_BYTES },
+	{ "swap-limit",	1,	0,	OPT_SWAP_LIMIT },
+#endif
 	{ "switch",	1,	0,	OPT_SWITCH },
 	{ "switch-ops",	1,	0,	OPT_SWITCH_OPS },
+	{ "switch-method",1,	0,	OPT_SWITCH_METHOD },
+	{ "switch-pin",	1,	0,	OPT_SWITCH_PIN },
 	{ "symlink",	1,	0,	OPT_SYMLINK },
 	{ "symlink-ops",1,	0,	OPT_SYMLINK_OPS },
 #if defined(STRESS_SYNC_FILE)
 	{ "sync-file",	1,	0,	OPT_SYNC_FILE },
 	{ "sync-file-ops", 1,	0,	OPT_SYNC_FILE_OPS },
 	{ "sync-file-bytes", 1,	0,	OPT_SYNC_FILE_BYTES },
+	{ "sync-file-wal", 0,	0,	OPT_SYNC_FILE_WAL },
 #endif
+	{ "syscall",	1,	0,	OPT_SYSCALL },
+	{ "syscall-ops",1,	0,	OPT_SYSCALL_OPS },
 	{ "sysinfo",	1,	0,	OPT_SYSINFO },
 	{ "sysinfo-ops",1,	0,	OPT_SYSINFO_OPS },
 #if defined(STRESS_SYSFS)
 	{ "sysfs",	1,	0,	OPT_SYSFS },
 	{ "sysfs-ops",1,	0,	OPT_SYSFS_OPS },
+	{ "sysfs-top",1,	0,	OPT_SYSFS_TOP },
 #endif
+	{ "sync-start",	0,	0,	OPT_SYNC_START },
+	{ "sync-start-at",1,	0,	OPT_SYNC_START_AT },
 	{ "syslog",	0,	0,	OPT_SYSLOG },
 	{ "taskset",	1,	0,	OPT_TASKSET },
 #if defined(STRESS_TEE)
@@ -1164,23 +1551,39 @@ static const struct option long_options[] = {
 	{ "timerfd-ops",1,	0,	OPT_TIMERFD_OPS },
 	{ "timerfd-freq",1,	0,	OPT_TIMERFD_FREQ },
 	{ "timerfd-rand",0,	0,	OPT_TIMERFD_RAND },
+	{ "timerfd-mass",1,	0,	OPT_TIMERFD_MASS },
 #endif
 #if defined(PRCTL_TIMER_SLACK)
 	{ "timer-slack",1,	0,	OPT_TIMER_SLACK },
+#endif
+	{ "timer-jitter",0,	0,	OPT_TIMER_JITTER },
+	{ "timer-jitter-prio",1,0,	OPT_TIMER_JITTER_PRIO },
+#if defined(STRESS_TLB)
+	{ "tlb",	1,	0,	OPT_TLB },
+	{ "tlb-ops",	1,	0,	OPT_TLB_OPS },
+	{ "tlb-pages",	1,	0,	OPT_TLB_PAGES },
+	{ "tlb-page-size",1,	0,	OPT_TLB_PAGE_SIZE },
 #endif
 #if defined(STRESS_TLB_SHOOTDOWN)
 	{ "tlb-shootdown",1,	0,	OPT_TLB_SHOOTDOWN },
 	{ "tlb-shootdown-ops",1,0,	OPT_TLB_SHOOTDOWN_OPS },
+	{ "tlb-shootdown-threads",1,0,	OPT_TLB_SHOOTDOWN_THREADS },
 #endif
 #if defined(STRESS_TSC)
 	{ "tsc",	1,	0,	OPT_TSC },
 	{ "tsc-ops",	1,	0,	OPT_TSC_OPS },
+	{ "tsc-skew",	0,	0,	OPT_TSC_SKEW },
 #endif
 	{ "tsearch",	1,	0,	OPT_TSEARCH },
 	{ "tsearch-ops",1,	0,	OPT_TSEARCH_OPS },
 	{ "tsearch-size",1,	0,	OPT_TSEARCH_SIZE },
+#if defined(STRESS_THREADS)
+	{ "threads",	0,	0,	OPT_THREADS },
+#endif
 #if defined(STRESS_THRASH)
 	{ "thrash",	0,	0,	OPT_THRASH },
+	{ "thrash-reclaim",1,	0,	OPT_THRASH_RECLAIM },
+	{ "thrash-reclaim-cold",0,0,	OPT_THRASH_RECLAIM_COLD },
 #endif
 	{ "times",	0,	0,	OPT_TIMES },
 #if defined(STRESS_THERMAL_ZONES)
@@ -1189,6 +1592,9 @@ static const struct option long_options[] = {
 	{ "udp",	1,	0,	OPT_UDP },
 	{ "udp-ops",	1,	0,	OPT_UDP_OPS },
 	{ "udp-domain",1,	0,	OPT_UDP_DOMAIN },
+	{ "udp-batch",	1,	0,	OPT_UDP_BATCH },
+	{ "udp-gro",	0,	0,	OPT_UDP_GRO },
+	{ "udp-gso",	1,	0,	OPT_UDP_GSO },
 #if defined(OPT_UDP_LITE)
 	{ "udp-lite",	0,	0,	OPT_UDP_LITE },
 #endif
@@ -1202,13 +1608,27 @@ static const struct option long_options[] = {
 	{ "userfaultfd",1,	0,	OPT_USERFAULTFD },
 	{ "userfaultfd-ops",1,	0,	OPT_USERFAULTFD_OPS },
 	{ "userfaultfd-bytes",1,0,	OPT_USERFAULTFD_BYTES },
+#if defined(HAVE_LIB_PTHREAD)
+	{ "userfaultfd-faulters",1,0,	OPT_USERFAULTFD_FAULTERS },
+	{ "userfaultfd-handlers",1,0,	OPT_USERFAULTFD_HANDLERS },
+	{ "userfaultfd-mode",1,	0,	OPT_USERFAULTFD_MODE },
+	{ "userfaultfd-prefault",1,0,	OPT_USERFAULTFD_PREFAULT },
+#endif
 #endif
 	{ "utime",	1,	0,	OPT_UTIME },
 	{ "utime-ops",	1,	0,	OPT_UTIME_OPS },
 	{ "utime-fsync",0,	0,	OPT_UTIME_FSYNC },
+#if defined(STRESS_ULOCK)
+	{ "ulock",	1,	0,	OPT_ULOCK },
+	{ "ulock-ops",	1,	0,	OPT_ULOCK_OPS },
+	{ "ulock-cs",	1,	0,	OPT_ULOCK_CS },
+	{ "ulock-method",1,	0,	OPT_ULOCK_METHOD },
+	{ "ulock-threads",1,	0,	OPT_ULOCK_THREADS },
+#endif
 #if defined(STRESS_UNSHARE)
 	{ "unshare",	1,	0,	OPT_UNSHARE },
 	{ "unshare-ops",1,	0,	OPT_UNSHARE_OPS },
+	{ "unshare-container",1,0,	OPT_UNSHARE_CONTAINER },
 #endif
 #if defined(STRESS_URANDOM)
 	{ "urandom",	1,	0,	OPT_URANDOM },
@@ -1217,6 +1637,7 @@ static const struct option long_options[] = {
 #if defined(STRESS_VECMATH)
 	{ "vecmath",	1,	0,	OPT_VECMATH },
 	{ "vecmath-ops",1,	0,	OPT_VECMATH_OPS },
+	{ "vecmath-method",1,	0,	OPT_VECMATH_METHOD },
 #endif
 	{ "verbose",	0,	0,	OPT_VERBOSE },
 	{ "verify",	0,	0,	OPT_VERIFY },
@@ -1236,12 +1657,16 @@ static const struct option long_options[] = {
 #ifdef MAP_LOCKED
 	{ "vm-locked",	0,	0,	OPT_VM_MMAP_LOCKED },
 #endif
+	{ "vm-hugepage",0,	0,	OPT_VM_HUGEPAGE },
 	{ "vm-ops",	1,	0,	OPT_VM_OPS },
 	{ "vm-method",	1,	0,	OPT_VM_METHOD },
+	{ "vm-threads",	1,	0,	OPT_VM_THREADS },
+	{ "vm-hammer-rate",1,	0,	OPT_VM_HAMMER_RATE },
 #if defined(STRESS_VM_RW)
 	{ "vm-rw",	1,	0,	OPT_VM_RW },
 	{ "vm-rw-bytes",1,	0,	OPT_VM_RW_BYTES },
 	{ "vm-rw-ops",	1,	0,	OPT_VM_RW_OPS },
+	{ "vm-rw-sweep",0,	0,	OPT_VM_RW_SWEEP },
 #endif
 #if defined(STRESS_VM_SPLICE)
 	{ "vm-splice",	1,	0,	OPT_VM_SPLICE },
@@ -1255,9 +1680,19 @@ static const struct option long_options[] = {
 	{ "wait",	1,	0,	OPT_WAIT },
 	{ "wait-ops",	1,	0,	OPT_WAIT_OPS },
 #endif
+#if defined(STRESS_WAKEUP)
+	{ "wakeup",	1,	0,	OPT_WAKEUP },
+	{ "wakeup-ops",	1,	0,	OPT_WAKEUP_OPS },
+	{ "wakeup-method",1,	0,	OPT_WAKEUP_METHOD },
+	{ "wakeup-cpus",1,	0,	OPT_WAKEUP_CPUS },
+#endif
+#if defined(STRESS_WARMUP)
+	{ "warmup",	1,	0,	OPT_WARMUP },
+#endif
 #if defined(STRESS_XATTR)
 	{ "xattr",	1,	0,	OPT_XATTR },
 	{ "xattr-ops",	1,	0,	OPT_XATTR_OPS },
+	{ "xattr-sweep",0,	0,	OPT_XATTR_SWEEP },
 #endif
 	{ "yaml",	1,	0,	OPT_YAML },
 #if defined(STRESS_YIELD)
@@ -1269,10 +1704,16 @@ static const struct option long_options[] = {
 #if defined(STRESS_ZLIB)
 	{ "zlib",	1,	0,	OPT_ZLIB },
 	{ "zlib-ops",	1,	0,	OPT_ZLIB_OPS },
+	{ "zlib-block-size",1,	0,	OPT_ZLIB_BLOCK_SIZE },
+	{ "zlib-engine",1,	0,	OPT_ZLIB_ENGINE },
+	{ "zlib-level",	1,	0,	OPT_ZLIB_LEVEL },
+	{ "zlib-rand-data",1,	0,	OPT_ZLIB_RAND_DATA },
+	{ "zlib-threads",1,	0,	OPT_ZLIB_THREADS },
 #endif
 	{ "zombie",	1,	0,	OPT_ZOMBIE },
 	{ "zombie-ops",	1,	0,	OPT_ZOMBIE_OPS },
 	{ "zombie-max",	1,	0,	OPT_ZOMBIE_MAX },
+	{ "zombie-reap",0,	0,	OPT_ZOMBIE_REAP },
 	{ NULL,		0,	0,	0 }
 };
 
@@ -1283,40 +1724,97 @@ static const help_t help_generic[] = {
 	{ NULL,		"aggressive",		"enable all aggressive options" },
 	{ "a N",	"all N",		"start N workers of each stress test" },
 	{ "b N",	"backoff N",		"wait of N microseconds before work starts" },
+	{ NULL,		"cgroup G",		"run each stressor or instance in its own cgroup, G = stressor or instance" },
+	{ NULL,		"cgroup-cpu-max Q",	"set cgroup cpu.max to Q[/P], Q usecs every P usecs" },
+	{ NULL,		"cgroup-memory-max",	"set cgroup memory.max in bytes (4M to 1024G)" },
+	{ NULL,		"cgroup-io-max L",	"set cgroup io.max of the temp path disk, L = rbps=N,wbps=N,.." },
+	{ NULL,		"resctrl S:M[:B]",	"run stressor S in a resctrl group with L3 way mask M and MBA B%" },
 	{ NULL,		"class name",		"specify a class of stressors, use with --sequential" },
+	{ NULL,		"compare file",		"compare bogo ops/s to a --yaml file, exit 4 on a regression" },
+	{ NULL,		"compare-threshold",	"percent drop in bogo ops/s that is a regression" },
+	{ NULL,		"cpufreq",		"report CPU frequency and idle state residency (Linux only)" },
 	{ "n",		"dry-run",		"do not run" },
+	{ NULL,		"energy",		"report RAPL energy and bogo ops per joule in the metrics" },
 	{ "h",		"help",			"show help" },
+	{ NULL,		"hugepages P",		"back vm, mmap, stream, bigheap with P = none, thp, 2M or 1G pages" },
 	{ NULL,		"ignite-cpu",		"alter kernel controls to make CPU run hot" },
+	{ NULL,		"ignite-cpu-list L",	"only ignite the CPUs in list L, e.g. 0,2-3" },
+	{ NULL,		"ignite-cpu-baseline N", "run N seconds before igniting and report the gain" },
+	{ NULL,		"irq-stats N",		"report the top N interrupt sources and irq load per stressor" },
+	{ NULL,		"job file",		"read options and workload mixes from a job file" },
+	{ NULL,		"job-mix name",		"run the workload mix name of the job file" },
+	{ NULL,		"json filename",	"output results to a JSON formatted file" },
 	{ "k",		"keep-name",		"keep stress worker names to be 'stress-ng'" },
+#if defined(STRESS_LATENCY)
+	{ NULL,		"latency N",		"sample the latency of every Nth op of some stressors" },
+#endif
+#if defined(STRESS_LOG_ASYNC)
+	{ NULL,		"log-async",		"stressors queue log messages for the parent to write" },
+#endif
 	{ NULL,		"log-brief",		"less verbose log messages" },
 	{ NULL,		"log-file filename",	"log messages to a log file" },
 	{ NULL,		"maximize",		"enable maximum stress options" },
 	{ "M",		"metrics",		"print pseudo metrics of activity" },
 	{ NULL,		"metrics-brief",	"enable metrics and only show non-zero results" },
+	{ NULL,		"migrate P",		"migrate stressors between CPUs, P = random, socket, llc or smt" },
+	{ NULL,		"migrate-period N",	"migrate stressors every N microseconds" },
 	{ NULL,		"minimize",		"enable minimal stress options" },
+	{ NULL,		"net-peer A",		"network stressor clients connect to address A" },
+	{ NULL,		"net-role R",		"run the network stressor ends R = both, client or server" },
 	{ NULL,		"no-madvise",		"don't use random madvise options for each mmap" },
 	{ NULL,		"no-rand-seed",		"seed random numbers with the same constant" },
+	{ NULL,		"numa-place P",		"place instances on NUMA nodes, P = spread, pack or local" },
 #if defined(STRESS_PAGE_IN)
 	{ NULL,		"page-in",		"touch allocated pages that are not in core" },
+	{ NULL,		"page-residency",	"report the fraction of mmap stressor pages in core" },
 #endif
 	{ NULL,		"pathological",		"enable stressors that are known to hang a machine" },
 #if defined(STRESS_PERF_STATS)
 	{ NULL,		"perf",			"display perf statistics" },
+	{ NULL,		"perf-contention",	"report kernel lock contention per stressor" },
+#endif
+	{ NULL,		"pin P",		"pin instances to CPUs, P = core, thread or llc" },
+#if defined(STRESS_PERF_STATS)
+	{ NULL,		"profile",		"sample call chains and write folded stacks per stressor" },
 #endif
+	{ NULL,		"psi",			"report the pressure stall information of each stressor" },
 	{ "q",		"quiet",		"quiet output" },
+	{ NULL,		"ramp S:F:T[:N]",	"ramp stressor S from F to T instances in N steps" },
+	{ NULL,		"ramp-file file",	"run steps of stressor instances read from file" },
+	{ NULL,		"repeat N",		"run each configuration N times and report the variance" },
 	{ "r",		"random N",		"start N random workers" },
+#if defined(STRESS_SAMPLE)
+	{ NULL,		"sample N",		"sample bogo op counters every N milliseconds" },
+	{ NULL,		"sample-file file",	"write bogo op counter samples to a CSV file" },
+	{ NULL,		"sample-textfile F",	"keep the latest samples in Prometheus textfile F" },
+	{ NULL,		"converge P",		"stop each stressor once its bogo ops/s settles within P%" },
+	{ NULL,		"converge-windows K",	"settled means K sample intervals in a row (default 5)" },
+#endif
 	{ NULL,		"sched type",		"set scheduler type" },
 	{ NULL,		"sched-prio N",		"set scheduler priority level N" },
 	{ NULL,		"sequential N",		"run all stressors one by one, invoking N of them" },
+	{ NULL,		"smt-bench",		"run each stressor alone and paired on SMT sibling CPUs" },
+	{ NULL,		"smt-cpus X,Y",		"use CPUs X and Y as the SMT sibling pair" },
 	{ NULL,		"stressors",		"show available stress tests" },
+	{ NULL,		"stressor-offset",	"S:T = start the instances of stressor S T seconds late" },
+	{ NULL,		"stressor-time S:T",	"stop the instances of stressor S after T seconds" },
+	{ NULL,		"sync-start",		"fork all stressors first then start them together" },
+	{ NULL,		"sync-start-at T",	"start the stressors at epoch time T or +T seconds from now" },
 	{ NULL,		"syslog",		"log messages to the syslog" },
 	{ NULL,		"taskset",		"use specific CPUs (set CPU affinity)" },
 	{ NULL,		"temp-path",		"specify path for temporary directories and files" },
+#if defined(STRESS_THREADS)
+	{ NULL,		"threads",		"run instances of thread safe stressors as threads" },
+#endif
 #if defined(STRESS_THRASH)
 	{ NULL,		"thrash",		"force all pages in causing swap thrashing" },
+	{ NULL,		"thrash-reclaim N",	"instead reclaim stressor memory at N MB/sec" },
+	{ NULL,		"thrash-reclaim-cold",	"deactivate with MADV_COLD rather than MADV_PAGEOUT" },
 #endif
 	{ "t N",	"timeout N",		"timeout after N seconds" },
 	{ NULL,		"timer-slack",		"enable timer slack mode" },
+	{ NULL,		"timer-jitter",		"report timer and sleep expiry lateness p50, p99 and max" },
+	{ NULL,		"timer-jitter-prio",	"SCHED_FIFO priority of the timer and sleep stressors" },
 	{ NULL,		"times",		"show run time summary at end of the run" },
 #if defined(STRESS_THERMAL_ZONES)
 	{ NULL,		"tz",			"collect temperatures from thermal zones (Linux only)" },
@@ -1324,6 +1822,9 @@ static const help_t help_generic[] = {
 	{ "v",		"verbose",		"verbose output" },
 	{ NULL,		"verify",		"verify results (not available on all tests)" },
 	{ "V",		"version",		"show version" },
+#if defined(STRESS_WARMUP)
+	{ NULL,		"warmup N",		"exclude the first N seconds of each stressor from the metrics" },
+#endif
 	{ "Y",		"yaml",			"output results to YAML formatted filed" },
 	{ "x",		"exclude",		"list of stressors to exclude (not run)" },
 	{ NULL,		NULL,			NULL }
@@ -1341,6 +1842,13 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_AF_ALG)
 	{ NULL,		"af-alg N",		"start N workers that stress AF_ALG socket domain" },
 	{ NULL,		"af-alg-ops N",		"stop after N af-alg bogo operations" },
+	{ NULL,		"af-alg-throughput",	"report AF_ALG MB/s against splice and OpenSSL" },
+#endif
+#if defined(STRESS_AF_PACKET)
+	{ NULL,		"af-packet N",		"start N workers capturing loopback UDP with packet rings" },
+	{ NULL,		"af-packet-ops N",	"stop after N captured packets" },
+	{ NULL,		"af-packet-port P",	"use ports P to P + number of workers - 1" },
+	{ NULL,		"af-packet-size N",	"send N byte UDP payloads" },
 #endif
 #if defined(STRESS_AIO)
 	{ NULL,		"aio N",		"start N workers that issue async I/O requests" },
@@ -1351,11 +1859,22 @@ static const help_t help_stressors[] = {
 	{ NULL,		"aiol N",		"start N workers that issue async I/O requests via Linux aio" },
 	{ NULL,		"aiol-ops N",		"stop after N bogo Linux aio async I/O requests" },
 	{ NULL,		"aiol-requests N",	"number of Linux aio async I/O requests per worker" },
+	{ NULL,		"aiol-sweep",		"sweep block size and queue depth reporting IOPS and latency" },
+	{ NULL,		"aiol-min-nr N",	"wait for N sweep completions per io_getevents, 0 polls" },
 #endif
 #if defined(STRESS_APPARMOR)
 	{ NULL,		"apparmor",		"start N workers exercising AppArmor interfaces" },
 	{ NULL,		"apparmor-ops",		"stop after N bogo AppArmor worker bogo operations" },
 #endif
+#if defined(STRESS_ARENA)
+	{ NULL,		"arena N",		"start N workers comparing malloc, arena and pool allocation" },
+	{ NULL,		"arena-ops N",		"stop after N objects allocated" },
+	{ NULL,		"arena-method M",	"M = malloc, arena, pool or all" },
+	{ NULL,		"arena-objects N",	"allocate N objects per request" },
+	{ NULL,		"arena-size N",		"allocate objects of N bytes" },
+	{ NULL,		"arena-tcache",		"put a per thread cache in front of the pool" },
+	{ NULL,		"arena-threads N",	"allocate from N threads" },
+#endif
 #if defined(STRESS_ATOMIC)
 	{ NULL,		"atomic",		"start N workers exercising GCC atomic operations" },
 	{ NULL,		"atomic-ops",		"stop after N bogo atomic bogo operations" },
@@ -1373,6 +1892,8 @@ static const help_t help_stressors[] = {
 	{ NULL,		"bsearch N",		"start N workers that exercise a binary search" },
 	{ NULL,		"bsearch-ops N",	"stop after N binary search bogo operations" },
 	{ NULL,		"bsearch-size N",	"number of 32 bit integers to bsearch" },
+	{ NULL,		"bsearch-method M",	"M = libc, eytzinger, btree, hash or all random lookups" },
+	{ NULL,		"bsearch-sweep",	"sweep table sizes from L1 cache to DRAM sized" },
 	{ "C N",	"cache N",		"start N CPU cache thrashing workers" },
 	{ NULL,		"cache-ops N",		"stop after N cache bogo operations" },
 	{ NULL,		"cache-prefetch",	"prefetch on memory reads/writes" },
@@ -1380,6 +1901,11 @@ static const help_t help_stressors[] = {
 	{ NULL,		"cache-fence",		"serialize stores" },
 	{ NULL,		"cache-level N",	"only exercise specified cache" },
 	{ NULL,		"cache-ways N",		"only fill specified number of cache ways" },
+	{ NULL,		"cacheline N",		"start N workers contending on shared cache lines" },
+	{ NULL,		"cacheline-ops N",	"stop after N cacheline bogo operations" },
+	{ NULL,		"cacheline-layout L",	"specify counter layout, L = shared, same, adjacent, padded or all" },
+	{ NULL,		"cacheline-op O",	"specify counter update, O = store, rmw or cas" },
+	{ NULL,		"cacheline-matrix N",	"measure cache to cache latency between N CPUs" },
 #if defined(STRESS_CAP)
 	{ NULL,		"cap N",		"start N workers exercsing capget" },
 	{ NULL,		"cap-ops N",		"stop cap workers after N bogo capget operations" },
@@ -1393,45 +1919,68 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_CLOCK)
 	{ NULL,		"clock N",		"start N workers thrashing clocks and POSIX timers" },
 	{ NULL,		"clock-ops N",		"stop clock workers after N bogo operations" },
+	{ NULL,		"clock-cost",		"measure ns per clock read, flag clocks not using the vDSO" },
 #endif
 #if defined(STRESS_CLONE)
 	{ NULL,		"clone N",		"start N workers that rapidly create and reap clones" },
 	{ NULL,		"clone-ops N",		"stop after N bogo clone operations" },
 	{ NULL,		"clone-max N",		"set upper limit of N clones per worker" },
 #endif
+#if defined(STRESS_COMPACT)
+	{ NULL,		"compact N",		"start N workers fragmenting memory and allocating huge pages" },
+	{ NULL,		"compact-ops N",	"stop after N compact bogo rounds" },
+	{ NULL,		"compact-bytes N",	"fragment and allocate huge pages in N bytes" },
+	{ NULL,		"compact-keep P",	"keep P percent of the fragmenting pages" },
+	{ NULL,		"compact-pin P",	"mlock P percent of the kept pages" },
+#endif
 #if defined(STRESS_CONTEXT)
 	{ NULL,		"context N",		"start N workers exercising user context" },
 	{ NULL,		"context-ops N",	"stop context workers after N bogo operations" },
+	{ NULL,		"context-compare",	"time swapcontext, setjmp/longjmp and asm coroutine switches" },
 #endif
 #if defined(STRESS_COPY_FILE)
 	{ NULL,		"copy-file N",		"start N workers that copy file data" },
 	{ NULL,		"copy-file-ops N",	"stop after N copy bogo operations" },
 	{ NULL,		"copy-file-bytes N",	"specify size of file to be copied" },
+	{ NULL,		"copy-file-sweep",	"sweep chunk sizes against a read/write copy" },
 #endif
 	{ "c N",	"cpu N",		"start N workers spinning on sqrt(rand())" },
 	{ NULL,		"cpu-ops N",		"stop after N cpu bogo operations" },
+	{ NULL,		"cpu-avx-interfere",	"measure cpu slowdown while sibling CPUs run FMA" },
 	{ "l P",	"cpu-load P",		"load CPU by P %%, 0=sleep, 100=full load (see -c)" },
 	{ NULL,		"cpu-load-slice S",	"specify time slice during busy load" },
+	{ NULL,		"cpu-load-period N",	"closed loop load control period in microseconds" },
+	{ NULL,		"cpu-load-profile P",	"closed loop load of flat, ramp:LO:HI:SECS, square:LO:HI:SECS or a trace file" },
 	{ NULL,		"cpu-method m",		"specify stress cpu method m, default is all" },
 #if defined(STRESS_CPU_ONLINE)
 	{ NULL,		"cpu-online N",		"start N workers offlining/onlining the CPUs" },
 	{ NULL,		"cpu-online-ops N",	"stop after N offline/online operations" },
+	{ NULL,		"cpu-online-impact",	"measure the disruption of offlining CPUs to other stressors" },
 #endif
 #if defined(STRESS_CRYPT)
 	{ NULL,		"crypt N",		"start N workers performing password encryption" },
 	{ NULL,		"crypt-ops N",		"stop after N bogo crypt operations" },
+	{ NULL,		"crypt-method M",	"hash with method M, e.g. sha-512, bcrypt, all" },
+	{ NULL,		"crypt-rounds N",	"set the cost factor of the hash method" },
 #endif
 	{ NULL,		"daemon N",		"start N workers creating multiple daemons" },
 	{ NULL,		"daemon-ops N",		"stop when N daemons have been created" },
 	{ "D N",	"dentry N",		"start N dentry thrashing stressors" },
 	{ NULL,		"dentry-ops N",		"stop after N dentry bogo operations" },
 	{ NULL,		"dentry-order O",	"specify dentry unlink order (reverse, forward, stride)" },
+	{ NULL,		"dentry-negative",	"look up non-existent names, growing the negative dcache" },
 	{ NULL,		"dentries N",		"create N dentries per iteration" },
 	{ NULL,		"dir N",		"start N directory thrashing stressors" },
 	{ NULL,		"dir-ops N",		"stop after N directory bogo operations" },
 #if defined(STRESS_DNOTIFY)
 	{ NULL,		"dnotify N",		"start N workers exercising dnotify events" },
 	{ NULL,		"dnotify-ops N",	"stop dnotify workers after N bogo operations" },
+#endif
+#if defined(STRESS_DSP)
+	{ NULL,		"dsp N",		"start N workers running fft, dct and correlation kernels" },
+	{ NULL,		"dsp-ops N",		"stop after N transforms" },
+	{ NULL,		"dsp-method M",		"M = fft-radix2, fft-split, fft-mixed, fft-simd, dct, correlate or all" },
+	{ NULL,		"dsp-sizes L",		"comma separated list of transform sizes" },
 #endif
 	{ NULL,		"dup N",		"start N workers exercising dup/close" },
 	{ NULL,		"dup-ops N",		"stop after N dup/close bogo operations" },
@@ -1440,6 +1989,8 @@ static const help_t help_stressors[] = {
 	{ NULL,		"epoll-ops N",		"stop after N epoll bogo operations" },
 	{ NULL,		"epoll-port P",		"use socket ports P upwards" },
 	{ NULL,		"epoll-domain D",	"specify socket domain, default is unix" },
+	{ NULL,		"epoll-conns N",	"hold N persistent request/response connections" },
+	{ NULL,		"epoll-threads N",	"use N SO_REUSEPORT server threads with --epoll-conns" },
 #endif
 #if defined(STRESS_EVENTFD)
 	{ NULL,		"eventfd N",		"start N workers stressing eventfd read/writes" },
@@ -1449,14 +2000,18 @@ static const help_t help_stressors[] = {
 	{ NULL,		"exec N",		"start N workers spinning on fork() and exec()" },
 	{ NULL,		"exec-ops N",		"stop after N exec bogo operations" },
 	{ NULL,		"exec-max P",		"create P workers per iteration, default is 1" },
+	{ NULL,		"exec-targets L",	"compare the exec cost of the colon separated commands L" },
 #endif
 #if defined(STRESS_FALLOCATE)
 	{ NULL,		"fallocate N",		"start N workers fallocating 16MB files" },
 	{ NULL,		"fallocate-ops N",	"stop after N fallocate bogo operations" },
 	{ NULL,		"fallocate-bytes N",	"specify size of file to allocate" },
+	{ NULL,		"fallocate-matrix",	"report extent growth from punch, zero, collapse and insert" },
+	{ NULL,		"fallocate-gran N",	"granularity of fallocate-matrix operations, default 64K" },
 #endif
 	{ NULL,		"fault N",		"start N workers producing page faults" },
 	{ NULL,		"fault-ops N",		"stop after N page fault bogo operations" },
+	{ NULL,		"fault-class C",	"measure cost of C faults: minor, major, cow, thp, zero or all" },
 #if defined(STRESS_FIEMAP)
 	{ NULL,		"fiemap N",		"start N workers exercising the FIEMAP ioctl" },
 	{ NULL,		"fiemap-ops N",		"stop after N FIEMAP ioctl bogo operations" },
@@ -1472,14 +2027,36 @@ static const help_t help_stressors[] = {
 	{ NULL,		"fcntl-ops N",		"stop after N fcntl bogo operations" },
 	{ NULL,		"flock N",		"start N workers locking a single file" },
 	{ NULL,		"flock-ops N",		"stop after N flock bogo operations" },
+	{ NULL,		"flock-contenders N",	"contend flock, lockf, posix and OFD locks with N processes" },
 	{ "f N",	"fork N",		"start N workers spinning on fork() and exit()" },
 	{ NULL,		"fork-ops N",		"stop after N fork bogo operations" },
 	{ NULL,		"fork-max P",		"create P workers per iteration, default is 1" },
+#if defined(STRESS_LATENCY)
+	{ NULL,		"fork-latency",		"measure process creation latencies" },
+	{ NULL,		"fork-method M",	"M = fork, vfork, clone-vm, spawn, exec or all latency mode" },
+	{ NULL,		"fork-rss N",		"touch N bytes of parent memory in the latency mode" },
+#endif
+	{ NULL,		"forkheap N",		"start N workers forking from a parent with a large heap" },
+	{ NULL,		"forkheap-ops N",	"stop after N forkheap forks" },
+	{ NULL,		"forkheap-bytes N",	"grow the parent heap up to N bytes" },
+	{ NULL,		"forkheap-cow P",	"child writes to P percent of the heap pages" },
+	{ NULL,		"forkheap-thp",		"use transparent huge pages for the heap" },
+	{ NULL,		"forkheap-vmas N",	"split the heap into N VMAs" },
 	{ NULL,		"fp-error N",		"start N workers exercising floating point errors" },
 	{ NULL,		"fp-error-ops N",	"stop after N fp-error bogo operations" },
+#if defined(STRESS_FRONTEND)
+	{ NULL,		"frontend N",		"start N workers pressuring the icache and branch predictor" },
+	{ NULL,		"frontend-ops N",	"stop after N code mode and size measurements" },
+	{ NULL,		"frontend-mode M",	"code mode M = calls, branches or all" },
+	{ NULL,		"frontend-size N",	"use N bytes of code rather than sweep 4K to 16M" },
+	{ NULL,		"frontend-entropy P",	"make P% of the branches random (default 10)" },
+#endif
 	{ NULL,		"fstat N",		"start N workers exercising fstat on files" },
 	{ NULL,		"fstat-ops N",		"stop after N fstat bogo operations" },
 	{ NULL,		"fstat-dir path",	"fstat files in the specified directory" },
+#if defined(HAVE_LIB_PTHREAD)
+	{ NULL,		"fstat-pthreads N",	"stat the files from N threads" },
+#endif
 #if defined(STRESS_FULL)
 	{ NULL,		"full N",		"start N workers exercising /dev/full" },
 	{ NULL,		"full-ops N",		"stop after N /dev/full bogo I/O operations" },
@@ -1487,25 +2064,48 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_FUTEX)
 	{ NULL,		"futex N",		"start N workers exercising a fast mutex" },
 	{ NULL,		"futex-ops N",		"stop after N fast mutex bogo operations" },
+	{ NULL,		"futex-mode M",		"M = wake, requeue, wake-op or pi waiter herd mode" },
+	{ NULL,		"futex-waiters N",	"start N waiter threads on one futex" },
+	{ NULL,		"futex-wake N",		"wake N waiters per FUTEX_WAKE, default all" },
 #endif
 	{ NULL,		"get N",		"start N workers exercising the get*() system calls" },
 	{ NULL,		"get-ops N",		"stop after N get bogo operations" },
 #if defined(STRESS_GETDENT)
 	{ NULL,		"getdent N",		"start N workers reading directories using getdents" },
 	{ NULL,		"getdent-ops N",	"stop after N getdents bogo operations" },
+	{ NULL,		"getdent-entries N",	"read a directory of N files at a range of buffer sizes" },
 #endif
 #if defined(STRESS_GETRANDOM)
 	{ NULL,		"getrandom N",		"start N workers fetching random data via getrandom()" },
 	{ NULL,		"getrandom-ops N",	"stop after N getrandom bogo operations" },
+	{ NULL,		"getrandom-sweep",	"MB/s of random and null devices by block size and threads" },
 #endif
 #if defined(STRESS_HANDLE)
 	{ NULL,		"handle N",		"start N workers exercising name_to_handle_at" },
 	{ NULL,		"handle-ops N",		"stop after N handle bogo operations" },
+#endif
+	{ NULL,		"hash N",		"start N workers measuring hash function throughput" },
+	{ NULL,		"hash-ops N",		"stop after N hash method and size measurements" },
+	{ NULL,		"hash-method M",	"hash M = crc32c, xxh64, fnv1a, ... or all" },
+#if defined(STRESS_HASHMAP)
+	{ NULL,		"hashmap N",		"start N workers exercising concurrent hash maps" },
+	{ NULL,		"hashmap-ops N",	"stop after N hash map operations" },
+	{ NULL,		"hashmap-method M",	"hash map M = striped, lockfree or all" },
+	{ NULL,		"hashmap-keys N",	"use a key space of N keys (default 64K)" },
+	{ NULL,		"hashmap-reads P",	"make P% of the operations lookups (default 90)" },
+	{ NULL,		"hashmap-threads N",	"compare 1 thread against N threads (default 4)" },
+	{ NULL,		"hashmap-zipf T",	"Zipfian key skew theta of T/100, 0 is uniform" },
 #endif
 	{ "d N",	"hdd N",		"start N workers spinning on write()/unlink()" },
 	{ NULL,		"hdd-ops N",		"stop after N hdd bogo operations" },
 	{ NULL,		"hdd-bytes N",		"write N bytes per hdd worker (default is 1GB)" },
+	{ NULL,		"hdd-dist D",		"random offsets with D = uniform, zipf or hotspot" },
+	{ NULL,		"hdd-engine E",		"do I/O with E = sync, io_uring or libaio" },
 	{ NULL,		"hdd-opts list",	"specify list of various stressor options" },
+	{ NULL,		"hdd-paths P",		"spread or stripe hdd files across the : separated paths P" },
+	{ NULL,		"hdd-qd N",		"keep N I/Os in flight with the async engines" },
+	{ NULL,		"hdd-rw-mix N",		"replace read passes with N% read random I/O mix" },
+	{ NULL,		"hdd-stripe N",		"stripe each hdd stream across the paths in N byte stripes" },
 	{ NULL,		"hdd-write-size N",	"set the default write size to N bytes" },
 #if defined(STRESS_HEAPSORT)
 	{ NULL,		"heapsort N",		"start N workers heap sorting 32 bit random integers" },
@@ -1522,10 +2122,15 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_ICMP_FLOOD)
 	{ NULL,		"icmp-flood N",		"start N ICMP packet flood workers" },
 	{ NULL,		"icmp-flood-ops N",	"stop after N ICMP bogo operations (ICMP packets)" },
+	{ NULL,		"icmp-flood-batch N",	"send N ICMP packets per sendmmsg call" },
+	{ NULL,		"icmp-flood-recv",	"receive and count the ICMP echo replies" },
+	{ NULL,		"icmp-flood-sweep",	"sweep the ICMP packet size from 64 to 1500 bytes" },
 #endif
 #if defined(STRESS_INOTIFY)
 	{ NULL,		"inotify N",		"start N workers exercising inotify events" },
 	{ NULL,		"inotify-ops N",	"stop inotify workers after N bogo operations" },
+	{ NULL,		"inotify-writers N",	"drain events from 1 to N file writers" },
+	{ NULL,		"inotify-api A",	"drain events with A = inotify or fanotify" },
 #endif
 	{ "i N",	"io N",			"start N workers spinning on sync()" },
 	{ NULL,		"io-ops N",		"stop after N io bogo operations" },
@@ -1533,6 +2138,24 @@ static const help_t help_stressors[] = {
 	{ NULL,		"ionice-class C",	"specify ionice class (idle, besteffort, realtime)" },
 	{ NULL,		"ionice-level L",	"specify ionice level (0 max, 7 min)" },
 #endif
+#if defined(STRESS_IO_URING_NET)
+	{ NULL,		"io-uring-net N",	"start N workers doing io_uring socket echo round trips" },
+	{ NULL,		"io-uring-net-ops N",	"stop after N io_uring echo round trips" },
+	{ NULL,		"io-uring-net-conns N",	"use N concurrent client connections" },
+	{ NULL,		"io-uring-net-domain D","specify domain, default is ipv4" },
+	{ NULL,		"io-uring-net-port P",	"use ports P to P + number of workers - 1" },
+	{ NULL,		"io-uring-net-proto P",	"echo over P = tcp or udp" },
+	{ NULL,		"io-uring-net-size N",	"send N byte requests" },
+	{ NULL,		"io-uring-net-sqpoll",	"use kernel SQ polling threads" },
+#endif
+#if defined(STRESS_IOCMP)
+	{ NULL,		"iocmp N",		"start N workers comparing POSIX AIO, libaio and io_uring" },
+	{ NULL,		"iocmp-ops N",		"stop after N bogo I/Os" },
+	{ NULL,		"iocmp-bs N",		"issue N byte I/Os" },
+	{ NULL,		"iocmp-qd N",		"keep N I/Os in flight" },
+	{ NULL,		"iocmp-read-pct N",	"make N% of the I/Os reads" },
+	{ NULL,		"iocmp-size N",		"spread the I/Os over an N byte file" },
+#endif
 #if defined(STRESS_IOPRIO)
 	{ NULL,		"ioprio N",		"start N workers exercising set/get iopriority" },
 	{ NULL,		"ioprio-ops N",		"stop after N io bogo iopriority operations" },
@@ -1546,6 +2169,8 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_KEY)
 	{ NULL,		"key N",		"start N workers exercising key operations" },
 	{ NULL,		"key-ops N",		"stop after N key bogo operations" },
+	{ NULL,		"key-max N",		"grow the --key-scale keyring up to N keys" },
+	{ NULL,		"key-scale",		"measure key lookup latency as the keyring grows" },
 #endif
 	{ NULL,		"kill N",		"start N workers killing with SIGUSR1" },
 	{ NULL,		"kill-ops N",		"stop after N kill bogo operations" },
@@ -1553,16 +2178,31 @@ static const help_t help_stressors[] = {
 	{ NULL,		"klog N",		"start N workers exercising kernel syslog interface" },
 	{ NULL,		"klog -ops N",		"stop after N klog bogo operations" },
 #endif
+#if defined(STRESS_KSM)
+	{ NULL,		"ksm N",		"start N workers measuring KSM merging and unmerging" },
+	{ NULL,		"ksm-ops N",		"stop after N ksm merge and unmerge passes" },
+	{ NULL,		"ksm-bytes N",		"fill N bytes of mergeable memory (default 16MB)" },
+	{ NULL,		"ksm-dup P",		"make P percent of the pages duplicates (default 50)" },
+#endif
 #if defined(STRESS_LEASE)
 	{ NULL,		"lease N",		"start N workers holding and breaking a lease" },
 	{ NULL,		"lease-ops N",		"stop after N lease bogo operations" },
 	{ NULL,		"lease-breakers N",	"number of lease breaking workers to start" },
+#endif
+#if defined(STRESS_LFQUEUE)
+	{ NULL,		"lfqueue N",		"start N workers moving items through lock-free queues" },
+	{ NULL,		"lfqueue-ops N",	"stop after N items consumed" },
+	{ NULL,		"lfqueue-consumers N",	"use N consumer threads on the multi-consumer queues" },
+	{ NULL,		"lfqueue-pin",		"pin the producers and consumers to separate CPUs" },
+	{ NULL,		"lfqueue-producers N",	"use N producer threads on the multi-producer queues" },
+	{ NULL,		"lfqueue-type T",	"T = spsc, mpsc, mpmc, ms or all" },
 #endif
 	{ NULL,		"link N",		"start N workers creating hard links" },
 	{ NULL,		"link-ops N",		"stop after N link bogo operations" },
 #if defined(STRESS_LOCKBUS)
 	{ NULL,		"lockbus N",		"start N workers locking a memory increment" },
 	{ NULL,		"lockbus-ops N",	"stop after N lockbus bogo operations" },
+	{ NULL,		"lockbus-victim",	"measure split lock slowdown of a victim on another CPU" },
 #endif
 #if defined(STRESS_LOCKA)
 	{ NULL,		"locka N",		"start N workers locking a single file via advisory locks" },
@@ -1588,30 +2228,49 @@ static const help_t help_stressors[] = {
 #endif
 	{ NULL,		"malloc N",		"start N workers exercising malloc/realloc/free" },
 	{ NULL,		"malloc-bytes N",	"allocate up to N bytes per allocation" },
+	{ NULL,		"malloc-dist D",	"allocation size distribution: uniform, small, mixed, bimodal" },
 	{ NULL,		"malloc-max N",		"keep up to N allocations at a time" },
 	{ NULL,		"malloc-ops N",		"stop after N malloc bogo operations" },
+#if defined(HAVE_LIB_PTHREAD)
+	{ NULL,		"malloc-pthreads N",	"allocate and free from N threads" },
+#endif
 #if defined(STRESS_MALLOPT)
 	{ NULL,		"malloc-thresh N",	"threshold where malloc uses mmap instead of sbrk" },
+#endif
+#if defined(HAVE_LIB_PTHREAD)
+	{ NULL,		"malloc-xfree P",	"free P% of allocations on another thread" },
 #endif
 	{ NULL,		"matrix N",		"start N workers exercising matrix operations" },
 	{ NULL,		"matrix-ops N",		"stop after N maxtrix bogo operations" },
 	{ NULL,		"matrix-method m",	"specify matrix stress method m, default is all" },
 	{ NULL,		"matrix-size N",	"specify the size of the N x N matrix" },
+	{ NULL,		"matrix-threads N",	"use N threads to compute matrix products" },
 #if defined(STRESS_MEMBARRIER)
 	{ NULL,		"membarrier N",		"start N workers performing membarrier system calls" },
 	{ NULL,		"membarrier-ops N",	"stop after N membarrier bogo operations" },
+	{ NULL,		"membarrier-readers N",	"run N RCU reader threads in the sync mode" },
+	{ NULL,		"membarrier-sync M",	"M = fence, expedited, shared or all RCU grace period mode" },
 #endif
 	{ NULL,		"memcpy N",		"start N workers performing memory copies" },
 	{ NULL,		"memcpy-ops N",		"stop after N memcpy bogo operations" },
+	{ NULL,		"memcpy-bw N",		"pace each memcpy instance to copy N bytes/sec" },
+	{ NULL,		"memcpy-method M",	"specify memcpy copy engine" },
+	{ NULL,		"memcpy-sweep",		"report memcpy bandwidth over a range of sizes" },
 #if defined(STRESS_MEMFD)
 	{ NULL,		"memfd N",		"start N workers allocating memory with memfd_create" },
 	{ NULL,		"memfd-bytes N",	"allocate N bytes for each stress iteration" },
+	{ NULL,		"memfd-ipc",		"stream through a ring in memfd, shm and SysV shm segments" },
+	{ NULL,		"memfd-consumers N",	"stream to N consumers in --memfd-ipc (default 1)" },
 	{ NULL,		"memfd-ops N",		"stop after N memfd bogo operations" },
 #endif
 #if defined(STRESS_MERGESORT)
 	{ NULL,		"mergesort N",		"start N workers merge sorting 32 bit random integers" },
 	{ NULL,		"mergesort-ops N",	"stop after N merge sort bogo operations" },
 	{ NULL,		"mergesort-size N",	"number of 32 bit integers to sort" },
+	{ NULL,		"metadata N",		"start N workers timing create, stat, rename and unlink phases" },
+	{ NULL,		"metadata-ops N",	"stop after N metadata operations" },
+	{ NULL,		"metadata-layout L",	"layout L = private, shared, tree or all directories" },
+	{ NULL,		"metadata-files N",	"use N files per worker in each phase (default 1024)" },
 #endif
 #if defined(STRESS_MINCORE)
 	{ NULL,		"mincore N",		"start N workers exercising mincore" },
@@ -1623,6 +2282,8 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_MLOCK)
 	{ NULL,		"mlock N",		"start N workers exercising mlock/munlock" },
 	{ NULL,		"mlock-ops N",		"stop after N mlock bogo operations" },
+	{ NULL,		"mlock-bytes N",	"lock N bytes in the --mlock-cost measurements" },
+	{ NULL,		"mlock-cost",		"measure mlock, MLOCK_ONFAULT and MCL_FUTURE costs" },
 #endif
 	{ NULL,		"mmap N",		"start N workers stressing mmap and munmap" },
 	{ NULL,		"mmap-ops N",		"stop after N mmap bogo operations" },
@@ -1630,16 +2291,24 @@ static const help_t help_stressors[] = {
 	{ NULL,		"mmap-bytes N",		"mmap and munmap N bytes for each stress iteration" },
 	{ NULL,		"mmap-file",		"mmap onto a file using synchronous msyncs" },
 	{ NULL,		"mmap-mprotect",	"enable mmap mprotect stressing" },
+	{ NULL,		"mmap-prefault S",	"time prefault strategy S: lazy, populate, willneed, populate-write, mlock or all" },
 #if defined(STRESS_MMAPFORK)
 	{ NULL,		"mmapfork N",		"start N workers stressing many forked mmaps/munmaps" },
 	{ NULL,		"mmapfork-ops N",	"stop after N mmapfork bogo operations" },
+#endif
+#if defined(STRESS_MMAPLOCK)
+	{ NULL,		"mmaplock N",		"start N workers contending on the mmap_lock of one mm" },
+	{ NULL,		"mmaplock-ops N",	"stop after N mmaplock bogo operations" },
+	{ NULL,		"mmaplock-threads N",	"fault and map with 1, 2, 4 .. N threads (default 8)" },
 #endif
 	{ NULL,		"mmapmany N",		"start N workers stressing many mmaps and munmaps" },
 	{ NULL,		"mmapmany-ops N",	"stop after N mmapmany bogo operations" },
+	{ NULL,		"mmapmany-scale",	"time faults, mmap and munmap at growing VMA counts" },
 #if defined(STRESS_MREMAP)
 	{ NULL,		"mremap N",		"start N workers stressing mremap" },
 	{ NULL,		"mremap-ops N",		"stop after N mremap bogo operations" },
 	{ NULL,		"mremap-bytes N",	"mremap N bytes maximum for each stress iteration" },
+	{ NULL,		"mremap-grow",		"compare growing to N bytes with mremap and memcpy" },
 #endif
 #if defined(STRESS_MSG)
 	{ NULL,		"msg N",		"start N workers stressing System V messages" },
@@ -1654,14 +2323,20 @@ static const help_t help_stressors[] = {
 	{ NULL,		"mq N",			"start N workers passing messages using POSIX messages" },
 	{ NULL,		"mq-ops N",		"stop mq workers after N bogo messages" },
 	{ NULL,		"mq-size N",		"specify the size of the POSIX message queue" },
+	{ NULL,		"mq-sweep",		"compare POSIX and SysV queues over sizes and depths" },
+	{ NULL,		"mq-producers N",	"send with N producers in --mq-sweep (default 1)" },
+	{ NULL,		"mq-consumers N",	"receive with N consumers in --mq-sweep (default 1)" },
 #endif
 	{ NULL,		"nice N",		"start N workers that randomly re-adjust nice levels" },
 	{ NULL,		"nice-ops N",		"stop after N nice bogo operations" },
+	{ NULL,		"nice-levels L",	"compare CPU shares of busy instances at nice levels L" },
 	{ NULL,		"null N",		"start N workers writing to /dev/null" },
 	{ NULL,		"null-ops N",		"stop after N /dev/null bogo write operations" },
 #if defined(STRESS_NUMA)
 	{ NULL,		"numa N",		"start N workers stressing NUMA interfaces" },
 	{ NULL,		"numa-ops N",		"stop after N NUMA bogo operations" },
+	{ NULL,		"numa-bytes N",		"migrate N bytes in the numa-migrate mode" },
+	{ NULL,		"numa-migrate",		"measure move_pages throughput between memory nodes" },
 #endif
 #if defined(STRESS_OOM_PIPE)
 	{ NULL,		"oom-pipe N",		"start N workers exercising large pipes" },
@@ -1682,17 +2357,22 @@ static const help_t help_stressors[] = {
 	{ NULL,		"pipe-data-size N",	"set pipe size of each pipe write to N bytes" },
 #if defined(F_SETPIPE_SZ)
 	{ NULL,		"pipe-size N",		"set pipe size to N bytes" },
+	{ NULL,		"pipe-sweep",		"sweep pipe sizes against write sizes" },
 #endif
 	{ "P N",	"poll N",		"start N workers exercising zero timeout polling" },
 	{ NULL,		"poll-ops N",		"stop after N poll bogo operations" },
+	{ NULL,		"poll-scale N",		"time select/poll/epoll/io_uring wakeups with up to N idle fds" },
 #if defined(STRESS_PROCFS)
 	{ NULL,		"procfs N",		"start N workers reading portions of /proc" },
 	{ NULL,		"procfs-ops N",		"stop procfs workers after N bogo read operations" },
+	{ NULL,		"procfs-top N",		"time each file read and report the N slowest files" },
 #endif
 #if defined(STRESS_PTHREAD)
 	{ NULL,		"pthread N",		"start N workers that create multiple threads" },
 	{ NULL,		"pthread-ops N",	"stop pthread workers after N bogo threads created" },
 	{ NULL,		"pthread-max P",	"create P threads at a time by each worker" },
+	{ NULL,		"pthread-method M",	"create and join threads or dispatch to a pool" },
+	{ NULL,		"pthread-stack N",	"create threads with N byte stacks" },
 #endif
 #if defined(STRESS_PTRACE)
 	{ NULL,		"ptrace N",		"start N workers that trace a child using ptrace" },
@@ -1701,6 +2381,8 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_PTY)
 	{ NULL,		"pty N",		"start N workers that exercise pseudoterminals" },
 	{ NULL,		"pty-ops N",		"stop pty workers after N pty bogo operations" },
+	{ NULL,		"pty-data",		"measure PTY throughput and echo latency" },
+	{ NULL,		"pty-max N",		"grow the --pty-data PTYs up to N, default 64" },
 #endif
 	{ "Q",		"qsort N",		"start N workers qsorting 32 bit random integers" },
 	{ NULL,		"qsort-ops N",		"stop after N qsort bogo operations" },
@@ -1710,12 +2392,15 @@ static const help_t help_stressors[] = {
 	{ NULL,		"quota -ops N",		"stop after N quotactl bogo operations" },
 #endif
 #if defined(STRESS_RDRAND)
-	{ NULL,		"rdrand N",		"start N workers exercising rdrand (x86 only)" },
+	{ NULL,		"rdrand N",		"start N workers exercising rdrand, rdseed or rndr" },
 	{ NULL,		"rdrand-ops N",		"stop after N rdrand bogo operations" },
+	{ NULL,		"rdrand-method M",	"method M = rdrand, rdseed (x86), rndr, rndrrs (arm) or all" },
+	{ NULL,		"rdrand-scale",		"step the active instances 1, 2, 4 .. N" },
 #endif
 #if defined(STRESS_READAHEAD)
 	{ NULL,		"readahead N",		"start N workers exercising file readahead" },
 	{ NULL,		"readahead-bytes N",	"size of file to readahead on (default is 1GB)" },
+	{ NULL,		"readahead-sweep",	"compare readahead methods over access patterns and windows" },
 	{ NULL,		"readahead-ops N",	"stop after N readahead bogo operations" },
 #endif
 #if defined(STRESS_REMAP_FILE_PAGES)
@@ -1733,16 +2418,26 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_RMAP)
 	{ NULL,		"rmap N",		"start N workers that stress reverse mappings" },
 	{ NULL,		"rmap-ops N",		"stop after N rmap bogo operations" },
+	{ NULL,		"rmap-sharers N",	"use N processes sharing the file mappings" },
+	{ NULL,		"rmap-scale",		"time faults, munmap and truncate as sharers grow" },
 #endif
 #if defined(STRESS_RTC)
 	{ NULL,		"rtc N",		"start N workers that exercise the RTC interfaces" },
 	{ NULL,		"rtc-ops N",		"stop after N RTC bogo operations" },
 #endif
+#if defined(STRESS_SCHEDLAT)
+	{ NULL,		"schedlat N",		"start N workers measuring wakeup latency as runqueues deepen" },
+	{ NULL,		"schedlat-ops N",	"stop after N worker wakeups" },
+	{ NULL,		"schedlat-policy P",	"policy P = other, batch, deadline or all" },
+	{ NULL,		"schedlat-messengers N","use N message threads (default 2)" },
+	{ NULL,		"schedlat-think N",	"busy N microseconds per wakeup (default 100)" },
+#endif
 #if defined(STRESS_SCTP)
 	{ NULL,		"sctp N",		"start N workers performing SCTP send/receives " },
 	{ NULL,		"sctp-ops N",		"stop after N SCTP bogo operations" },
 	{ NULL,		"sctp-domain D",	"specify sctp domain, default is ipv4" },
 	{ NULL,		"sctp-port P",		"use SCTP ports P to P + number of workers - 1" },
+	{ NULL,		"sctp-streams N",	"spread messages over N streams, report per stream stats" },
 #endif
 #if defined(STRESS_SEAL)
 	{ NULL,		"seal N",		"start N workers performing fcntl SEAL commands" },
@@ -1751,6 +2446,7 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_SECCOMP)
 	{ NULL,		"seccomp N",		"start N workers performing seccomp call filtering" },
 	{ NULL,		"seccomp-ops N",	"stop after N seccomp bogo operations" },
+	{ NULL,		"seccomp-rules N",	"time syscalls under seccomp filters of N rules" },
 #endif
 	{ NULL,		"seek N",		"start N workers performing random seek r/w IO" },
 	{ NULL,		"seek-ops N",		"stop after N seek bogo operations" },
@@ -1772,6 +2468,7 @@ static const help_t help_stressors[] = {
 	{ NULL,		"sendfile N",		"start N workers exercising sendfile" },
 	{ NULL,		"sendfile-ops N",	"stop after N bogo sendfile operations" },
 	{ NULL,		"sendfile-size N",	"size of data to be sent with sendfile" },
+	{ NULL,		"sendfile-sweep",	"sweep chunk sizes against a read/write copy" },
 #endif
 #if defined(STRESS_SHM_POSIX)
 	{ NULL,		"shm N",		"start N workers that exercise POSIX shared memory" },
@@ -1794,6 +2491,7 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_SIGQUEUE)
 	{ NULL,		"sigq N",		"start N workers sending sigqueue signals" },
 	{ NULL,		"sigq-ops N",		"stop after N siqqueue bogo operations" },
+	{ NULL,		"sigq-method M",	"M = flood, or handler, sigwaitinfo, signalfd, pidfd or all round trips" },
 #endif
 	{ NULL,		"sigsegv N",		"start N workers generating segmentation faults" },
 	{ NULL,		"sigsegv-ops N",	"stop after N bogo segmentation faults" },
@@ -1808,16 +2506,28 @@ static const help_t help_stressors[] = {
 	{ NULL,		"sock-domain D",	"specify socket domain, default is ipv4" },
 	{ NULL,		"sock-nodelay",		"disable Nagle algorithm, send data immediately" },
 	{ NULL,		"sock-ops N",		"stop after N socket bogo operations" },
-	{ NULL,		"sock-opts option",	"socket options [send|sendmsg|sendmmsg]" },
+	{ NULL,		"sock-opts option",	"socket options [send|sendmsg|sendmmsg|zerocopy]" },
+	{ NULL,		"sock-peer H:P",		"socket clients connect to host H base port P" },
 	{ NULL,		"sock-port P",		"use socket ports P to P + number of workers - 1" },
+	{ NULL,		"sock-role R",		"same as --net-role R" },
 	{ NULL,		"sock-type T",		"socket type (stream, seqpacket)" },
+	{ NULL,		"sock-msg-size N",	"send messages of N bytes, or sweep 64 bytes to 64K" },
+	{ NULL,		"sock-mmsg-batch N",	"send N messages per sendmmsg call" },
 #if defined(STRESS_SOCKET_FD)
 	{ NULL,		"sockfd N",		"start N workers sending file descriptors over sockets" },
 	{ NULL,		"sockfd-ops N",		"stop after N sockfd bogo operations" },
 	{ NULL,		"sockfd-port P",	"use socket fd ports P to P + number of workers - 1" },
+	{ NULL,		"sockfd-batch N",	"pass N fds per message and time each handoff" },
+	{ NULL,		"sockfd-sweep",		"sweep fds per message reporting fds/sec and latency" },
 #endif
 	{ NULL,		"sockpair N",		"start N workers exercising socket pair I/O activity" },
 	{ NULL,		"sockpair-ops N",	"stop after N socket pair bogo operations" },
+	{ NULL,		"sort N",		"start N workers sorting 32 bit integers" },
+	{ NULL,		"sort-ops N",		"stop after N sort bogo operations" },
+	{ NULL,		"sort-dist D",		"D = random, sorted, reverse or few-unique input" },
+	{ NULL,		"sort-method M",	"M = qsort, introsort, radix, pmerge or all" },
+	{ NULL,		"sort-size N",		"number of 32 bit integers to sort" },
+	{ NULL,		"sort-threads N",	"use N threads for the pmerge method" },
 #if defined(STRESS_SPAWN)
 	{ NULL,		"spawn",		"start N workers spawning stress-ng using posix_spawn" },
 	{ NULL,		"spawn-ops N",		"stop after N spawn bogo operations" },
@@ -1826,10 +2536,13 @@ static const help_t help_stressors[] = {
 	{ NULL,		"splice N",		"start N workers reading/writing using splice" },
 	{ NULL,		"splice-ops N",		"stop after N bogo splice operations" },
 	{ NULL,		"splice-bytes N",	"number of bytes to transfer per splice call" },
+	{ NULL,		"splice-consumers N",	"tee the pipeline mode data to N consumers" },
+	{ NULL,		"splice-mode M",	"M = copy or pipeline (file to sockets vs read/write)" },
 #endif
 	{ NULL,		"stack N",		"start N workers generating stack overflows" },
 	{ NULL,		"stack-ops N",		"stop after N bogo stack overflows" },
 	{ NULL,		"stack-fill",		"fill stack, touches all new pages " },
+	{ NULL,		"stack-cost",		"time stack growth faults and thread stack set up" },
 #if defined(STRESS_STACKMMAP)
 	{ NULL,		"stackmmap N",		"start N workers exercising a filebacked stack" },
 	{ NULL,		"stackmmap-ops N",	"stop after N bogo stackmmap operations" },
@@ -1837,23 +2550,41 @@ static const help_t help_stressors[] = {
 	{ NULL,		"str N",		"start N workers exercising lib C string functions" },
 	{ NULL,		"str-method func",	"specify the string function to stress" },
 	{ NULL,		"str-ops N",		"stop after N bogo string operations" },
+	{ NULL,		"str-search",		"measure GB/s of memchr, strlen, memmem, strstr on 4K..16M" },
+	{ NULL,		"str-search-size N",	"only search haystacks of N bytes" },
 	{ NULL,		"stream N",		"start N workers exercising memory bandwidth" },
 	{ NULL,		"stream-ops N",		"stop after N bogo stream operations" },
+	{ NULL,		"stream-bw N",		"pace each stream instance to N bytes/sec" },
+	{ NULL,		"stream-isa I",		"specify the instruction set of the stream kernels" },
 	{ NULL,		"stream-l3-size N",	"specify the L3 cache size of the CPU" },
+	{ NULL,		"stream-numa",		"bind each stream instance to a NUMA node" },
+	{ NULL,		"stream-threads N",	"use N threads per stream instance" },
+#if defined(STRESS_SWAP)
+	{ NULL,		"swap N",		"start N workers measuring swap-out and swap-in rates" },
+	{ NULL,		"swap-ops N",		"stop after N swap-out and swap-in passes" },
+	{ NULL,		"swap-bytes N",		"swap a working set of N bytes (default 256MB)" },
+	{ NULL,		"swap-limit N",		"set memory.max to N bytes (default swap-bytes / 4)" },
+#endif
 	{ "s N",	"switch N",		"start N workers doing rapid context switches" },
 	{ NULL,		"switch-ops N",		"stop after N context switch bogo operations" },
+	{ NULL,		"switch-method M",	"M = pipe, eventfd or futex wake ups" },
+	{ NULL,		"switch-pin P",		"P = none, same, smt, core or socket CPU placement" },
 	{ NULL,		"symlink N",		"start N workers creating symbolic links" },
 	{ NULL,		"symlink-ops N",	"stop after N symbolic link bogo operations" },
 #if defined(STRESS_SYNC_FILE)
 	{ NULL,		"sync-file N",		"start N workers exercise sync_file_range" },
 	{ NULL,		"sync-file-ops N",	"stop after N sync_file_range bogo operations" },
 	{ NULL,		"sync-file-bytes N",	"size of file to be sync'd" },
+	{ NULL,		"sync-file-wal",	"time syncs after WAL style appends" },
 #endif
+	{ NULL,		"syscall N",		"start N workers timing the cheapest system calls" },
+	{ NULL,		"syscall-ops N",	"stop after N syscall bogo operations" },
 	{ NULL,		"sysinfo N",		"start N workers reading system information" },
 	{ NULL,		"sysinfo-ops N",	"stop after sysinfo bogo operations" },
 #if defined(STRESS_SYSFS)
 	{ NULL,		"sysfs N",		"start N workers reading files from /sys" },
 	{ NULL,		"sysfs-ops N",		"stop after sysfs bogo operations" },
+	{ NULL,		"sysfs-top N",		"time each file read and report the N slowest files" },
 #endif
 #if defined(STRESS_TEE)
 	{ NULL,		"tee N",		"start N workers exercising the tee system call" },
@@ -1870,14 +2601,23 @@ static const help_t help_stressors[] = {
 	{ NULL,		"timerfd-ops N",	"stop after N timerfd bogo events" },
 	{ NULL,		"timerfd-freq F",	"run timer(s) at F Hz, range 1 to 1000000000" },
 	{ NULL,		"timerfd-rand",		"enable random timerfd frequency" },
+	{ NULL,		"timerfd-mass N",	"keep N one shot timerfds armed with random expiries" },
+#endif
+#if defined(STRESS_TLB)
+	{ NULL,		"tlb N",		"start N workers measuring TLB miss and page walk cost" },
+	{ NULL,		"tlb-ops N",		"stop after N TLB sweep point bogo ops" },
+	{ NULL,		"tlb-pages N",		"sweep up to N pages" },
+	{ NULL,		"tlb-page-size S",	"access S = 4K, 2M or 1G pages" },
 #endif
 #if defined(STRESS_TLB_SHOOTDOWN)
 	{ NULL,		"tlb-shootdown N",	"start N wrokers that force TLB shootdowns" },
 	{ NULL,		"tlb-shootdown-opts N",	"stop after N TLB shootdown bogo ops" },
+	{ NULL,		"tlb-shootdown-threads N","use up to N threads sharing one mm" },
 #endif
 #if defined(STRESS_TSC)
 	{ NULL,		"tsc N",		"start N workers reading the TSC (x86 only)" },
 	{ NULL,		"tsc-ops N",		"stop after N TSC bogo operations" },
+	{ NULL,		"tsc-skew",		"measure the TSC offset between every pair of CPUs" },
 #endif
 	{ NULL,		"tsearch N",		"start N workers that exercise a tree search" },
 	{ NULL,		"tsearch-ops N",	"stop after N tree search bogo operations" },
@@ -1885,6 +2625,9 @@ static const help_t help_stressors[] = {
 	{ NULL,		"udp N",		"start N workers performing UDP send/receives " },
 	{ NULL,		"udp-ops N",		"stop after N udp bogo operations" },
 	{ NULL,		"udp-domain D",		"specify domain, default is ipv4" },
+	{ NULL,		"udp-batch N",		"send and receive N datagrams per sendmmsg/recvmmsg" },
+	{ NULL,		"udp-gro",		"enable UDP_GRO receive coalescing" },
+	{ NULL,		"udp-gso N",		"send with UDP_SEGMENT GSO using N byte segments" },
 #if defined(OPT_UDP_LITE)
 	{ NULL,		"udp-lite",		"use the UDP-Lite (RFC 3828) protocol" },
 #endif
@@ -1894,9 +2637,17 @@ static const help_t help_stressors[] = {
 	{ NULL,		"udp-flood-ops N",	"stop after N udp flood bogo operations" },
 	{ NULL,		"udp-flood-domain D",	"specify domain, default is ipv4" },
 #endif
+#if defined(STRESS_ULOCK)
+	{ NULL,		"ulock N",		"start N workers contending on user space locks" },
+	{ NULL,		"ulock-ops N",		"stop after N lock acquisitions" },
+	{ NULL,		"ulock-cs N",		"make each critical section N data updates" },
+	{ NULL,		"ulock-method M",	"M = mutex, spin, ticket, mcs, rwlock or all" },
+	{ NULL,		"ulock-threads N",	"contend with N threads per worker" },
+#endif
 #if defined(STRESS_UNSHARE)
 	{ NULL,		"unshare N",		"start N workers exercising resource unsharing" },
 	{ NULL,		"unshare-ops N",	"stop after N bogo unshare operations" },
+	{ NULL,		"unshare-container N",	"build containers, up to N at once, timing each step" },
 #endif
 #if defined(STRESS_URANDOM)
 	{ "u N",	"urandom N",		"start N workers reading /dev/urandom" },
@@ -1905,6 +2656,12 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_USERFAULTFD)
 	{ NULL,		"userfaultfd N",	"start N page faulting workers with userspace handling" },
 	{ NULL,		"userfaultfd-ops N",	"stop after N page faults have been handled" },
+#if defined(HAVE_LIB_PTHREAD)
+	{ NULL,		"userfaultfd-faulters N","fault from N threads in the handler pool mode" },
+	{ NULL,		"userfaultfd-handlers N","resolve faults with a pool of N handler threads" },
+	{ NULL,		"userfaultfd-mode M",	"M = copy, zeropage, wp or continue fault resolution" },
+	{ NULL,		"userfaultfd-prefault N","resolve N pages per fault in one ioctl" },
+#endif
 #endif
 	{ NULL,		"utime N",		"start N workers updating file timestamps" },
 	{ NULL,		"utime-ops N",		"stop after N utime bogo operations" },
@@ -1912,6 +2669,7 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_VECMATH)
 	{ NULL,		"vecmath N",		"start N workers performing vector math ops" },
 	{ NULL,		"vecmath-ops N",	"stop after N vector math bogo operations" },
+	{ NULL,		"vecmath-method M",	"specify the vector maths kernel to run" },
 #endif
 #if defined(STRESS_VFORK)
 	{ NULL,		"vfork N",		"start N workers spinning on vfork() and exit()" },
@@ -1922,6 +2680,7 @@ static const help_t help_stressors[] = {
 	{ NULL,		"vm-bytes N",		"allocate N bytes per vm worker (default 256MB)" },
 	{ NULL,		"vm-hang N",		"sleep N seconds before freeing memory" },
 	{ NULL,		"vm-keep",		"redirty memory instead of reallocating" },
+	{ NULL,		"vm-hugepage",		"back the mapped region with huge pages" },
 	{ NULL,		"vm-ops N",		"stop after N vm bogo operations" },
 #ifdef MAP_LOCKED
 	{ NULL,		"vm-locked",		"lock the pages of the mapped region into memory" },
@@ -1930,10 +2689,13 @@ static const help_t help_stressors[] = {
 #ifdef MAP_POPULATE
 	{ NULL,		"vm-populate",		"populate (prefault) page tables for a mapping" },
 #endif
+	{ NULL,		"vm-hammer-rate N",	"rowhammer at N row activations per second" },
+	{ NULL,		"vm-threads N",		"run N threads over slices of one mapping per worker" },
 #if defined(STRESS_VM_RW)
 	{ NULL,		"vm-rw N",		"start N vm read/write process_vm* copy workers" },
 	{ NULL,		"vm-rw-bytes N",	"transfer N bytes of memory per bogo operation" },
 	{ NULL,		"vm-rw-ops N",		"stop after N vm process_vm* copy bogo operations" },
+	{ NULL,		"vm-rw-sweep",		"sweep process_vm_readv iovec counts and sizes vs memcpy" },
 #endif
 #if defined(STRESS_VM_SPLICE)
 	{ NULL,		"vm-splice N",		"start N workers reading/writing using vmsplice" },
@@ -1947,6 +2709,12 @@ static const help_t help_stressors[] = {
 	{ NULL,		"wait N",		"start N workers waiting on child being stop/resumed" },
 	{ NULL,		"wait-ops N",		"stop after N bogo wait operations" },
 #endif
+#if defined(STRESS_WAKEUP)
+	{ NULL,		"wakeup N",		"start N workers comparing cross thread wakeup mechanisms" },
+	{ NULL,		"wakeup-ops N",		"stop after N wakeup round trips" },
+	{ NULL,		"wakeup-method M",	"M = eventfd, eventfd-sem, pipe, futex, sem-posix, sem-sysv or all" },
+	{ NULL,		"wakeup-cpus X,Y",	"pin the notifier to CPU X and the waiter to CPU Y" },
+#endif
 #if defined(STRESS_YIELD)
 	{ "y N",	"yield N",		"start N workers doing sched_yield() calls" },
 	{ NULL,		"yield-ops N",		"stop after N bogo yield operations" },
@@ -1954,33 +2722,116 @@ static const help_t help_stressors[] = {
 #if defined(STRESS_XATTR)
 	{ NULL,		"xattr N",		"start N workers stressing file extended attributes" },
 	{ NULL,		"xattr-ops N",		"stop after N bogo xattr operations" },
+	{ NULL,		"xattr-sweep",		"sweep xattr value sizes and counts per inode" },
 #endif
 	{ NULL,		"zero N",		"start N workers reading /dev/zero" },
 	{ NULL,		"zero-ops N",		"stop after N /dev/zero bogo read operations" },
 #if defined(STRESS_ZLIB)
 	{ NULL,		"zlib N",		"start N workers compressing data with zlib" },
 	{ NULL,		"zlib-ops N",		"stop after N zlib bogo compression operations" },
+	{ NULL,		"zlib-block-size N",	"compress blocks of N bytes (default 64K)" },
+	{ NULL,		"zlib-engine E",	"compress with E = zlib, lz4, zstd or all" },
+	{ NULL,		"zlib-level N",		"set the compression level (default 9)" },
+	{ NULL,		"zlib-rand-data D",	"compress data D = binary, text, 01, digits, ... or all" },
+	{ NULL,		"zlib-threads N",	"compress and decompress blocks in parallel with N threads" },
 #endif
 	{ NULL,		"zombie N",		"start N workers that rapidly create and reap zombies" },
 	{ NULL,		"zombie-ops N",		"stop after N bogo zombie fork operations" },
 	{ NULL,		"zombie-max N",		"set upper limit of N zombies per worker" },
+	{ NULL,		"zombie-reap",		"compare wait, waitid and pidfd zombie reap rates" },
 	{ NULL,		NULL,			NULL }
 };
 
+#define STRESSOR_HASH_SIZE	(1024)	/* power of 2, > 2 x STRESS_MAX */
+
+/* Option and stressor lookup tables, see stressor_index_init() */
+typedef struct {
+	const char *name;	/* long option name */
+	int16_t stressor;	/* stressor of the option, or -1 */
+	bool ops;		/* true for the stressor's -ops option */
+} opt_index_t;
+
+static opt_index_t opt_index[OPT_MAX];
+static int32_t stressors_count;			/* the "NULL" entry index */
+static int32_t stressor_by_id[STRESS_MAX];	/* stress_id to index */
+static int16_t stressor_hash[STRESSOR_HASH_SIZE]; /* name to index + 1 */
+static char *stressor_munged[STRESS_MAX];	/* names, '_' as '-' */
+
 /*
- *  stressor_id_find()
- *  	Find index into stressors by id
+ *  stressor_name_hash()
+ *	FNV-1a hash of a stressor name, '_' hashes as '-'
  */
-static inline int32_t stressor_id_find(const stress_id id)
+static inline uint32_t stressor_name_hash(const char *name)
+{
+	uint32_t h = 2166136261U;
+
+	for (; *name; name++) {
+		h ^= (uint8_t)(*name == '_' ? '-' : *name);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/*
+ *  stressor_index_init()
+ *	build the stressor id, name and option lookup tables
+ *	once at startup, the option parser runs a lookup per
+ *	option and job files can give thousands of options
+ */
+static void stressor_index_init(void)
 {
 	int32_t i;
 
+	for (i = 0; i < OPT_MAX; i++)
+		opt_index[i].stressor = -1;
+	for (i = 0; long_options[i].name; i++) {
+		const int val = long_options[i].val;
+
+		/* Keep the first name of options with aliases */
+		if ((val >= 0) && (val < OPT_MAX) && !opt_index[val].name)
+			opt_index[val].name = long_options[i].name;
+	}
+	for (i = 0; i < STRESS_MAX; i++)
+		stressor_by_id[i] = STRESS_MAX;
+
 	for (i = 0; stressors[i].name; i++) {
-		if (stressors[i].id == id)
-			break;
+		const int sc = stressors[i].short_getopt;
+		const int op = (int)stressors[i].op;
+		uint32_t h;
+
+		stressor_by_id[stressors[i].id] = i;
+		if ((sc >= 0) && (sc < OPT_MAX))
+			opt_index[sc].stressor = (int16_t)i;
+		if ((op >= 0) && (op < OPT_MAX)) {
+			opt_index[op].stressor = (int16_t)i;
+			opt_index[op].ops = true;
+		}
+
+		stressor_munged[i] = strdup(munge_underscore(stressors[i].name));
+		if (!stressor_munged[i]) {
+			pr_err(stderr, "cannot allocate stressor name index\n");
+			exit(EXIT_FAILURE);
+		}
+		h = stressor_name_hash(stressors[i].name);
+		while (stressor_hash[h & (STRESSOR_HASH_SIZE - 1)])
+			h++;
+		stressor_hash[h & (STRESSOR_HASH_SIZE - 1)] = (int16_t)(i + 1);
 	}
+	stressors_count = i;
+	for (i = 0; i < STRESS_MAX; i++)
+		if (stressor_by_id[i] == STRESS_MAX)
+			stressor_by_id[i] = stressors_count;
+}
 
-	return i;	/* End of array is a special "NULL" entry */
+/*
+ *  stressor_id_find()
+ *  	Find index into stressors by id
+ */
+static inline int32_t stressor_id_find(const stress_id id)
+{
+	if ((int)id < 0 || id >= STRESS_MAX)
+		return stressors_count;
+	return stressor_by_id[id];	/* "NULL" entry if not found */
 }
 
 /*
@@ -1989,24 +2840,21 @@ static inline int32_t stressor_id_find(const stress_id id)
  */
 static inline int32_t stressor_name_find(const char *name)
 {
-	int32_t i;
-	char *tmp, *munged_name;
-	size_t len;
-
-	tmp = munge_underscore(name);
-	len = strlen(tmp) + 1;
-
-	munged_name = alloca(len);
-	strncpy(munged_name, tmp, len);
+	uint32_t h = stressor_name_hash(name);
+	int16_t i;
 
-	for (i = 0; stressors[i].name; i++) {
-		const char *munged_stressor_name = munge_underscore(stressors[i].name);
+	while ((i = stressor_hash[h & (STRESSOR_HASH_SIZE - 1)]) != 0) {
+		const char *s1 = name, *s2 = stressor_munged[i - 1];
 
-		if (!strcmp(munged_stressor_name, munged_name))
-			break;
+		while (*s1 && ((*s1 == '_' ? '-' : *s1) == *s2)) {
+			s1++;
+			s2++;
+		}
+		if (!*s1 && !*s2)
+			return i - 1;
+		h++;
 	}
-
-	return i;	/* End of array is a special "NULL" entry */
+	return stressors_count;	/* End of array is a special "NULL" entry */
 }
 
 
@@ -2076,6 +2924,39 @@ static int stress_exclude(char *const opt_exclude)
 	return 0;
 }
 
+/*
+ *  stress_set_stressor_time()
+ *	parse --stressor-offset and --stressor-time S:T
+ */
+static int stress_set_stressor_time(
+	const char *optarg,
+	const char *opt,
+	const bool offset)
+{
+	char *str, *colon;
+	int32_t i;
+
+	str = alloca(strlen(optarg) + 1);
+	strcpy(str, optarg);
+	colon = strchr(str, ':');
+	if (!colon || !colon[1]) {
+		fprintf(stderr, "%s must be stressor:time\n", opt);
+		return -1;
+	}
+	*colon = '\0';
+	i = stressor_name_find(str);
+	if (!stressors[i].name) {
+		fprintf(stderr, "Unknown stressor: '%s', invalid %s option\n",
+			str, opt);
+		return -1;
+	}
+	if (offset)
+		procs[i].start_offset = get_uint64_time(colon + 1);
+	else
+		procs[i].run_time = get_uint64_time(colon + 1);
+	return 0;
+}
+
 /*
  *  Catch signals and set flag to break out of stress loops
  */
@@ -2141,8 +3022,13 @@ static void usage_help(const help_t help_info[])
 
 		if (help_info[i].opt_s)
 			snprintf(opt_s, sizeof(opt_s), "-%s,", help_info[i].opt_s);
-		printf("%-6s--%-19s%s\n", opt_s,
-			help_info[i].opt_l, help_info[i].description);
+		/* options too wide for the column go on a line of their own */
+		if (strlen(help_info[i].opt_l) > 18)
+			printf("%-6s--%s\n%27s%s\n", opt_s,
+				help_info[i].opt_l, "", help_info[i].description);
+		else
+			printf("%-6s--%-19s%s\n", opt_s,
+				help_info[i].opt_l, help_info[i].description);
 	}
 }
 
@@ -2151,8 +3037,7 @@ static void show_stressors(void)
 	size_t i;
 
 	for (i = 0; stressors[i].name; i++)
-		printf("%s%s", i ? " " : "",
-			munge_underscore(stressors[i].name));
+		printf("%s%s", i ? " " : "", stressor_munged[i]);
 	putchar('\n');
 }
 
@@ -2179,13 +3064,9 @@ static void usage(void)
  */
 static const char *opt_name(const int opt_val)
 {
-	int i;
-
-	for (i = 0; long_options[i].name; i++)
-		if (long_options[i].val == opt_val)
-			return long_options[i].name;
-
-	return "<unknown>";
+	if ((opt_val < 0) || (opt_val >= OPT_MAX) || !opt_index[opt_val].name)
+		return "<unknown>";
+	return opt_index[opt_val].name;
 }
 
 /*
@@ -2238,6 +3119,223 @@ static void kill_procs(const int sig)
 	}
 }
 
+/*
+ *  proc_reaped()
+ *	report how a reaped stressor process exited and mark it done
+ */
+static void MLOCKED proc_reaped(
+	const int i,
+	const int j,
+	const pid_t ret,
+	const int status,
+	bool *success,
+	bool *resource_success)
+{
+	if (WIFSIGNALED(status)) {
+#if defined(WTERMSIG)
+#if NEED_GLIBC(2,1,0)
+		const char *signame = strsignal(WTERMSIG(status));
+
+		pr_dbg(stderr, "process %d (stress-ng-%s) terminated on signal: %d (%s)\n",
+			ret, stressors[i].name, WTERMSIG(status), signame);
+#else
+		pr_dbg(stderr, "process %d (stress-ng-%s) terminated on signal: %d\n",
+			ret, stressors[i].name, WTERMSIG(status));
+#endif
+#else
+		pr_dbg(stderr, "process %d (stress-ng-%s) terminated on signal\n",
+			ret, stressors[i].name);
+#endif
+		*success = false;
+	}
+	switch (WEXITSTATUS(status)) {
+	case EXIT_SUCCESS:
+		break;
+	case EXIT_NO_RESOURCE:
+		pr_err(stderr, "process [%d] (stress-ng-%s) aborted early, out of system resources\n",
+			ret, stressors[i].name);
+		*resource_success = false;
+		break;
+	default:
+		pr_err(stderr, "process %d (stress-ng-%s) terminated with an error, exit status=%d\n",
+			ret, stressors[i].name, WEXITSTATUS(status));
+		*success = false;
+		break;
+	}
+	proc_finished(&procs[i].pids[j]);
+	pr_dbg(stderr, "process [%d] terminated\n", ret);
+}
+
+/*
+ *  migrate_procs()
+ *	move the running stressor processes to their CPUs of
+ *	this tick of the migrate pattern
+ */
+static void MLOCKED migrate_procs(void)
+{
+	uint32_t k = 0;
+	int i;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		int j;
+
+		for (j = 0; j < procs[i].started_procs; j++, k++) {
+			const pid_t pid = procs[i].pids[j];
+
+			if (pid)
+				stress_migrate_pid(pid, k);
+		}
+	}
+}
+
+#if defined(__linux__) && defined(__NR_pidfd_open)
+/* a stressor process being waited for on a pidfd */
+typedef struct {
+	int fd;				/* its pidfd */
+	int i;				/* stressor */
+	int j;				/* instance */
+} reap_fd_t;
+
+#define REAP_TIMER	(~0U)		/* epoll data of the migrate timer */
+
+/*
+ *  wait_procs_pidfd()
+ *	reap each stressor as soon as it exits by waiting on a
+ *	pidfd per process with epoll, rather than in order with
+ *	a blocking waitpid. With --migrate a timerfd on the same
+ *	epoll set paces the pattern, so processes keep being
+ *	migrated until the last one has been reaped. Returns
+ *	false if pidfds cannot be used, the remaining processes
+ *	are then reaped by waitpid
+ */
+static bool MLOCKED wait_procs_pidfd(bool *success, bool *resource_success)
+{
+	struct epoll_event ev;
+	reap_fd_t *reap;
+	size_t nreap = 0, live = 0, n;
+	int epfd, timerfd = -1, i;
+	bool ok = false;
+
+	for (i = 0; i < STRESS_MAX; i++)
+		nreap += (size_t)procs[i].started_procs;
+	if (!nreap)
+		return true;
+	reap = calloc(nreap, sizeof(*reap));
+	if (!reap)
+		return false;
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		free(reap);
+		return false;
+	}
+
+	for (n = 0, i = 0; i < STRESS_MAX; i++) {
+		int j;
+
+		for (j = 0; j < procs[i].started_procs; j++) {
+			const pid_t pid = procs[i].pids[j];
+			int fd;
+
+			if (!pid)
+				continue;
+			fd = (int)syscall(__NR_pidfd_open, pid, 0);
+			if (fd < 0)
+				goto close_fds;
+			reap[n].fd = fd;
+			reap[n].i = i;
+			reap[n].j = j;
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN;
+			ev.data.u32 = (uint32_t)n;
+			n++;
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+				goto close_fds;
+		}
+	}
+	live = n;
+
+	if (stress_migrate_enabled()) {
+		const uint64_t usec = stress_migrate_period_usec();
+		struct itimerspec its;
+
+		timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+		if (timerfd < 0)
+			goto close_fds;
+		its.it_value.tv_sec = (time_t)(usec / 1000000);
+		its.it_value.tv_nsec = (long)((usec % 1000000) * 1000);
+		its.it_interval = its.it_value;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.u32 = REAP_TIMER;
+		if ((timerfd_settime(timerfd, 0, &its, NULL) < 0) ||
+		    (epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev) < 0))
+			goto close_fds;
+		migrate_procs();
+	}
+	ok = true;
+
+	while (live > 0) {
+		struct epoll_event events[16];
+		int k, ret;
+
+		ret = epoll_wait(epfd, events, (int)SIZEOF_ARRAY(events), -1);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (k = 0; k < ret; k++) {
+			reap_fd_t *r;
+			pid_t pid;
+			int status;
+
+			if (events[k].data.u32 == REAP_TIMER) {
+				uint64_t expirations;
+
+				if (read(timerfd, &expirations, sizeof(expirations)) < 0)
+					continue;
+				if (opt_do_wait) {
+					stress_migrate_tick();
+					migrate_procs();
+				}
+				continue;
+			}
+			r = &reap[events[k].data.u32];
+			pid = procs[r->i].pids[r->j];
+			if (pid) {
+				pid_t wret;
+
+				wret = waitpid(pid, &status, WNOHANG);
+				if (wret == 0)
+					continue;
+				if (wret > 0)
+					proc_reaped(r->i, r->j, wret, status,
+						success, resource_success);
+				else if (errno == ECHILD)
+					proc_finished(&procs[r->i].pids[r->j]);
+				else
+					continue;
+			}
+			(void)epoll_ctl(epfd, EPOLL_CTL_DEL, r->fd, NULL);
+			(void)close(r->fd);
+			r->fd = -1;
+			live--;
+		}
+	}
+
+close_fds:
+	for (i = 0; i < (int)n; i++) {
+		if (reap[i].fd >= 0)
+			(void)close(reap[i].fd);
+	}
+	if (timerfd >= 0)
+		(void)close(timerfd);
+	(void)close(epfd);
+	free(reap);
+	return ok;
+}
+#endif
+
 /*
  *  wait_procs()
  * 	wait for procs
@@ -2246,56 +3344,30 @@ static void MLOCKED wait_procs(bool *success, bool *resource_success)
 {
 	int i;
 
-	if (opt_flags & OPT_FLAGS_IGNITE_CPU)
-		ignite_cpu_start();
+#if defined(__linux__) && defined(__NR_pidfd_open)
+	/*
+	 *  Reap with pidfds where the kernel has them, anything
+	 *  left over is reaped by the waitpid loop below
+	 */
+	if (wait_procs_pidfd(success, resource_success))
+		goto reap;
+#endif
 
-#if defined(__linux__) && NEED_GLIBC(2,3,0)
 	/*
 	 *  On systems that support changing CPU affinity
-	 *  we keep on moving processed between processors
+	 *  we keep on moving processes between processors
 	 *  to impact on memory locality (e.g. NUMA) to
-	 *  try to thrash the system when in aggressive mode
+	 *  try to thrash the system with --aggressive or
+	 *  the --migrate pattern
 	 */
-	if (opt_flags & OPT_FLAGS_AGGRESSIVE) {
-		cpu_set_t proc_mask;
-		unsigned long int cpu = 0;
-		const uint32_t ticks_per_sec = stress_get_ticks_per_second() * 5;
-		const useconds_t usec_sleep = ticks_per_sec ? 1000000 / ticks_per_sec : 1000000 / 250;
-
+	if (stress_migrate_enabled()) {
 		while (opt_do_wait) {
-			const int32_t cpus = stress_get_processors_configured();
-
-			/* If we can't get the mask, don't do affinity twiddling */
-			if (sched_getaffinity(0, sizeof(proc_mask), &proc_mask) < 0)
-				goto do_wait;
-			if (!CPU_COUNT(&proc_mask))	/* Highly unlikely */
-				goto do_wait;
-
-			for (i = 0; i < STRESS_MAX; i++) {
-				int j;
-
-				for (j = 0; j < procs[i].started_procs; j++) {
-					const pid_t pid = procs[i].pids[j];
-					if (pid) {
-						cpu_set_t mask;
-						int32_t cpu_num;
-
-						do {
-							cpu_num = mwc32() % cpus;
-						} while (!(CPU_ISSET(cpu_num, &proc_mask)));
-
-						CPU_ZERO(&mask);
-						CPU_SET(cpu_num, &mask);
-						if (sched_setaffinity(pid, sizeof(mask), &mask) < 0)
-							goto do_wait;
-					}
-				}
-			}
-			usleep(usec_sleep);
-			cpu++;
+			migrate_procs();
+			stress_migrate_next();
 		}
 	}
-do_wait:
+#if defined(__linux__) && defined(__NR_pidfd_open)
+reap:
 #endif
 	for (i = 0; i < STRESS_MAX; i++) {
 		int j;
@@ -2309,39 +3381,8 @@ redo:
 
 				ret = waitpid(pid, &status, 0);
 				if (ret > 0) {
-					if (WIFSIGNALED(status)) {
-#if defined(WTERMSIG)
-#if NEED_GLIBC(2,1,0)
-						const char *signame = strsignal(WTERMSIG(status));
-
-						pr_dbg(stderr, "process %d (stress-ng-%s) terminated on signal: %d (%s)\n",
-							ret, stressors[i].name, WTERMSIG(status), signame);
-#else
-						pr_dbg(stderr, "process %d (stress-ng-%s) terminated on signal: %d\n",
-							ret, stressors[i].name, WTERMSIG(status));
-#endif
-#else
-						pr_dbg(stderr, "process %d (stress-ng-%s) terminated on signal\n",
-							ret, stressors[i].name);
-#endif
-						*success = false;
-					}
-					switch (WEXITSTATUS(status)) {
-					case EXIT_SUCCESS:
-						break;
-					case EXIT_NO_RESOURCE:
-						pr_err(stderr, "process [%d] (stress-ng-%s) aborted early, out of system resources\n",
-							ret, stressors[i].name);
-						*resource_success = false;
-						break;
-					default:
-						pr_err(stderr, "process %d (stress-ng-%s) terminated with an error, exit status=%d\n",
-							ret, stressors[i].name, WEXITSTATUS(status));
-						*success = false;
-						break;
-					}
-					proc_finished(&procs[i].pids[j]);
-					pr_dbg(stderr, "process [%d] terminated\n", ret);
+					proc_reaped(i, j, ret, status,
+						success, resource_success);
 				} else if (ret == -1) {
 					/* Somebody interrupted the wait */
 					if (errno == EINTR)
@@ -2353,8 +3394,6 @@ redo:
 			}
 		}
 	}
-	if (opt_flags & OPT_FLAGS_IGNITE_CPU)
-		ignite_cpu_stop();
 }
 
 
@@ -2383,27 +3422,307 @@ static void free_procs(void)
 }
 
 /*
- *  stress_run ()
- *	kick off and run stressors
+ *  sync_start_wait()
+ *	wait in a newly forked child until the parent has forked
+ *	all the stressors and releases them together
  */
-static void MLOCKED stress_run(
-	const int total_procs,
-	const int32_t max_procs,
-	const uint64_t opt_backoff,
-	const int32_t opt_ionice_class,
-	const int32_t opt_ionice_level,
-	proc_stats_t stats[],
-	double *duration,
-	bool *success,
-	bool *resource_success
-)
+static void MLOCKED sync_start_wait(void)
 {
-	double time_start, time_finish;
-	int32_t n_procs, i, j, n;
+	while (opt_do_run && !__atomic_load_n(&shared->sync_start.go, __ATOMIC_ACQUIRE)) {
+#if defined(__linux__) && defined(__NR_futex)
+		(void)syscall(__NR_futex, &shared->sync_start.go,
+			FUTEX_WAIT, 0, NULL, NULL, 0);
+#else
+		(void)usleep(1000);
+#endif
+	}
+}
 
-	opt_do_wait = true;
-	time_start = time_now();
-	pr_dbg(stderr, "starting stressors\n");
+/*
+ *  stress_set_sync_start_at()
+ *	release the --sync-start stressors at a wall clock time,
+ *	UNIX epoch seconds or +N seconds from now
+ */
+static void stress_set_sync_start_at(const char *optarg)
+{
+	char *end;
+	const bool relative = (*optarg == '+');
+	const double t = strtod(optarg + relative, &end);
+
+	if ((end == optarg + relative) || *end || (t < 0.0)) {
+		(void)fprintf(stderr, "sync-start-at must be UNIX epoch "
+			"seconds or +N seconds from now\n");
+		exit(EXIT_FAILURE);
+	}
+	opt_sync_start_at = relative ? time_now() + t : t;
+	opt_flags |= OPT_FLAGS_SYNC_START;
+}
+
+/*
+ *  sync_start_at_wait()
+ *	sleep in the parent until the --sync-start-at time, so
+ *	stress-ng runs on hosts with synchronised clocks release
+ *	their stressors together
+ */
+static void sync_start_at_wait(void)
+{
+	struct timespec ts;
+	double now = time_now();
+
+	if (now > opt_sync_start_at) {
+		pr_inf(stdout, "sync-start-at time passed %.3fs ago, "
+			"releasing the stressors now\n", now - opt_sync_start_at);
+		return;
+	}
+	pr_dbg(stderr, "waiting %.3fs for the sync-start-at time\n",
+		opt_sync_start_at - now);
+	ts.tv_sec = (time_t)opt_sync_start_at;
+	ts.tv_nsec = (long)((opt_sync_start_at - (double)ts.tv_sec) * 1000000000.0);
+	while (opt_do_run &&
+	       (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL) == EINTR))
+		;
+	pr_inf(stdout, "released stressors %.3fms after the sync-start-at time\n",
+		(time_now() - opt_sync_start_at) * 1000.0);
+}
+
+/*
+ *  sync_start_release()
+ *	release all the children waiting in sync_start_wait()
+ */
+static void MLOCKED sync_start_release(void)
+{
+	__atomic_store_n(&shared->sync_start.go, 1, __ATOMIC_RELEASE);
+#if defined(__linux__) && defined(__NR_futex)
+	(void)syscall(__NR_futex, &shared->sync_start.go,
+		FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/*
+ *  stress_run_instance()
+ *	run instance j of stressor i in the calling process
+ *	or thread, returns the exit status of the stressor
+ */
+static int MLOCKED stress_run_instance(
+	const int32_t i,
+	const uint32_t j,
+	const int32_t n_procs,
+	const uint64_t backoff,
+	proc_stats_t stats[],
+	const char *name)
+{
+	const int32_t n = procs[i].stats_index + (int32_t)j;
+	int rc = EXIT_SUCCESS;
+
+#if defined(STRESS_LOG_ASYNC)
+	if (shared->log_rings)
+		pr_log_ring_attach(&shared->log_rings[n]);
+#endif
+	stress_pin(name, j);
+	stress_smt_pin(name, i, j);
+	pr_dbg(stderr, "%s: started [%d] (instance %" PRIu32 ")\n",
+		name, getpid(), j);
+
+	stats[n].start = stats[n].finish = time_now();
+	stress_stats = &stats[n];
+#if defined(STRESS_LATENCY)
+	if (opt_flags & OPT_FLAGS_LATENCY)
+		stress_latency = &shared->lat_stats[n];
+#endif
+#if defined(STRESS_PERF_STATS)
+	if (opt_flags & OPT_FLAGS_PERF_STATS)
+		(void)perf_open(&shared->perf_stats[n]);
+#endif
+	if (opt_flags & OPT_FLAGS_SYNC_START) {
+		/* Measure from the common release, not the fork */
+		sync_start_wait();
+		(void)alarm(opt_timeout);
+		stats[n].start = stats[n].finish = time_now();
+	}
+	(void)usleep(backoff * n_procs);
+	if (procs[i].start_offset || procs[i].run_time) {
+		const uint64_t offset = procs[i].start_offset;
+
+		/* A SIGALRM ends the sleep early and the run with it */
+		if (offset)
+			(void)sleep((unsigned int)offset);
+		if (procs[i].run_time && (offset + procs[i].run_time < opt_timeout))
+			(void)alarm((unsigned int)procs[i].run_time);
+		stats[n].start = stats[n].finish = time_now();
+	}
+#if defined(STRESS_PERF_STATS)
+	if (opt_flags & OPT_FLAGS_PERF_STATS)
+		(void)perf_enable(&shared->perf_stats[n]);
+#if defined(STRESS_SAMPLE)
+	if ((opt_flags & OPT_FLAGS_PERF_STATS) &&
+	    (opt_flags & OPT_FLAGS_SAMPLE))
+		perf_sample_start(&shared->perf_stats[n]);
+#endif
+	if (opt_flags & OPT_FLAGS_PERF_CONTENTION)
+		perf_contention_start(&shared->perf_stats[n]);
+	perf_profile_start();
+#endif
+#if defined(STRESS_WARMUP)
+	warmup_start(n);
+#endif
+#if defined(STRESS_CPUFREQ)
+	if (opt_flags & OPT_FLAGS_CPUFREQ)
+		cpufreq_start(&stats[n].cpufreq);
+#endif
+	if (opt_do_run && !(opt_flags & OPT_FLAGS_DRY_RUN))
+		rc = stressors[i].stress_func(&shared->counters[n].counter, j, procs[i].bogo_ops, name);
+#if defined(STRESS_CPUFREQ)
+	if (opt_flags & OPT_FLAGS_CPUFREQ)
+		cpufreq_stop(&stats[n].cpufreq);
+#endif
+#if defined(STRESS_PERF_STATS)
+#if defined(STRESS_SAMPLE)
+	perf_sample_stop();
+#endif
+	perf_contention_stop();
+	perf_profile_stop(munge_underscore(stressors[i].name));
+	if (opt_flags & OPT_FLAGS_PERF_STATS) {
+		(void)perf_disable(&shared->perf_stats[n]);
+		(void)perf_close(&shared->perf_stats[n]);
+	}
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	if (opt_flags & OPT_FLAGS_THERMAL_ZONES)
+		(void)tz_get_temperatures(&shared->tz_info, &shared->tz_stats[n]);
+#endif
+
+	stats[n].finish = time_now();
+	/* times() covers the whole process, threads are charged after the join */
+	if (!stress_thread_instance && (times(&stats[n].tms) == (clock_t)-1)) {
+		pr_dbg(stderr, "times failed: errno=%d (%s)\n",
+			errno, strerror(errno));
+	}
+	stress_usage_get(&stats[n].usage);
+#if defined(STRESS_WARMUP)
+	warmup_stop(&stats[n]);
+#endif
+	pr_dbg(stderr, "%s: exited [%d] (instance %" PRIu32 ")\n",
+		name, getpid(), j);
+
+	return rc;
+}
+
+#if defined(STRESS_THREADS)
+/* An instance run as a thread of its stressor process */
+typedef struct {
+	pthread_t pthread;		/* the thread */
+	int rc;				/* exit status of the stressor */
+	int32_t stressor;		/* index into stressors[] */
+	uint32_t instance;		/* instance number */
+	int32_t n_procs;		/* start order for --backoff */
+	uint64_t backoff;		/* --backoff usecs */
+	proc_stats_t *stats;		/* stats of all the instances */
+	const char *name;		/* stressor process name */
+} stress_thread_t;
+
+/*
+ *  stress_thread()
+ *	run one instance as a thread
+ */
+static void *stress_thread(void *arg)
+{
+	stress_thread_t *t = (stress_thread_t *)arg;
+
+	stress_thread_instance = true;
+	mwc_reseed();
+	t->rc = stress_run_instance(t->stressor, t->instance, t->n_procs,
+		t->backoff, t->stats, t->name);
+
+	return NULL;
+}
+
+/*
+ *  stress_run_threads()
+ *	run all the instances of stressor i as threads of the
+ *	calling process, sharing the one mm rather than each
+ *	having its own page tables and mappings. Returns the
+ *	first failing exit status of the instances
+ */
+static int stress_run_threads(
+	const int32_t i,
+	const int32_t n_procs,
+	const uint64_t backoff,
+	proc_stats_t stats[],
+	const char *name)
+{
+	const uint32_t instances = (uint32_t)procs[i].num_procs;
+	stress_thread_t *threads;
+	uint32_t j, created;
+	int rc = EXIT_SUCCESS;
+
+	threads = calloc(instances, sizeof(*threads));
+	if (!threads) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " threads\n",
+			name, instances);
+		return EXIT_NO_RESOURCE;
+	}
+	for (created = 0; created < instances; created++) {
+		stress_thread_t *t = &threads[created];
+		int ret;
+
+		t->stressor = i;
+		t->instance = created;
+		t->n_procs = n_procs;
+		t->backoff = backoff;
+		t->stats = stats;
+		t->name = name;
+		ret = pthread_create(&t->pthread, NULL, stress_thread, t);
+		if (ret) {
+			pr_err(stderr, "%s: cannot create thread for instance "
+				"%" PRIu32 ": errno=%d (%s)\n", name, created,
+				ret, strerror(ret));
+			rc = EXIT_NO_RESOURCE;
+			break;
+		}
+	}
+	for (j = 0; j < created; j++) {
+		(void)pthread_join(threads[j].pthread, NULL);
+		if ((rc == EXIT_SUCCESS) && (threads[j].rc != EXIT_SUCCESS))
+			rc = threads[j].rc;
+	}
+	free(threads);
+
+	/* The process times and I/O of all the threads go to the first instance */
+	if (times(&stats[procs[i].stats_index].tms) == (clock_t)-1) {
+		pr_dbg(stderr, "times failed: errno=%d (%s)\n",
+			errno, strerror(errno));
+	}
+	stress_usage_get_io(&stats[procs[i].stats_index].usage);
+	return rc;
+}
+#endif
+
+/*
+ *  stress_run ()
+ *	kick off and run stressors
+ */
+static void MLOCKED stress_run(
+	const int total_procs,
+	const uint64_t opt_backoff,
+	const int32_t opt_ionice_class,
+	const int32_t opt_ionice_level,
+	proc_stats_t stats[],
+	double *duration,
+	bool *success,
+	bool *resource_success
+)
+{
+	double time_start, time_finish;
+	int32_t n_procs, i, j;
+	uint32_t started = 0;
+
+	opt_do_wait = true;
+	shared->sync_start.go = 0;
+	time_start = time_now();
+	stress_energy_start();
+	stress_psi_start();
+	stress_irq_start(procs);
+	pr_dbg(stderr, "starting stressors\n");
 	for (n_procs = 0; n_procs < total_procs; n_procs++) {
 		for (i = 0; i < STRESS_MAX; i++) {
 			if (time_now() - time_start > opt_timeout)
@@ -2411,7 +3730,10 @@ static void MLOCKED stress_run(
 
 			j = procs[i].started_procs;
 			if (j < procs[i].num_procs) {
-				int rc = EXIT_SUCCESS;
+				/* All the instances run as threads of the one process */
+				const bool threaded = (opt_flags & OPT_FLAGS_THREADS) &&
+					stressors[i].thread_safe;
+				int rc;
 				pid_t pid;
 				char name[64];
 again:
@@ -2439,7 +3761,9 @@ again:
 					if (opt_flags & OPT_FLAGS_TIMER_SLACK)
 						stress_set_timer_slack();
 
-					(void)alarm(opt_timeout);
+					/* --sync-start arms the alarm at the release */
+					if (!(opt_flags & OPT_FLAGS_SYNC_START))
+						(void)alarm(opt_timeout);
 					mwc_reseed();
 					snprintf(name, sizeof(name), "%s-%s", app_name,
 						munge_underscore(stressors[i].name));
@@ -2447,41 +3771,18 @@ again:
 					set_max_limits();
 					set_iopriority(opt_ionice_class, opt_ionice_level);
 					set_proc_name(name);
-
-					pr_dbg(stderr, "%s: started [%d] (instance %" PRIu32 ")\n",
-						name, getpid(), j);
-
-					n = (i * max_procs) + j;
-					stats[n].start = stats[n].finish = time_now();
-#if defined(STRESS_PERF_STATS)
-					if (opt_flags & OPT_FLAGS_PERF_STATS)
-						(void)perf_open(&stats[n].sp);
-#endif
-					(void)usleep(opt_backoff * n_procs);
-#if defined(STRESS_PERF_STATS)
-					if (opt_flags & OPT_FLAGS_PERF_STATS)
-						(void)perf_enable(&stats[n].sp);
-#endif
-					if (opt_do_run && !(opt_flags & OPT_FLAGS_DRY_RUN))
-						rc = stressors[i].stress_func(&stats[n].counter, j, procs[i].bogo_ops, name);
-#if defined(STRESS_PERF_STATS)
-					if (opt_flags & OPT_FLAGS_PERF_STATS) {
-						(void)perf_disable(&stats[n].sp);
-						(void)perf_close(&stats[n].sp);
-					}
-#endif
-#if defined(STRESS_THERMAL_ZONES)
-					if (opt_flags & OPT_FLAGS_THERMAL_ZONES)
-						(void)tz_get_temperatures(&shared->tz_info, &stats[n].tz);
-#endif
-
-					stats[n].finish = time_now();
-					if (times(&stats[n].tms) == (clock_t)-1) {
-						pr_dbg(stderr, "times failed: errno=%d (%s)\n",
-							errno, strerror(errno));
-					}
-					pr_dbg(stderr, "%s: exited [%d] (instance %" PRIu32 ")\n",
-						name, getpid(), j);
+					stress_numa_place(name, started);
+					stress_cgroup_enter(munge_underscore(stressors[i].name), j);
+					stress_resctrl_enter(munge_underscore(stressors[i].name));
+
+#if defined(STRESS_THREADS)
+					if (threaded)
+						rc = stress_run_threads(i, n_procs,
+							opt_backoff, stats, name);
+					else
+#endif
+						rc = stress_run_instance(i, j, n_procs,
+							opt_backoff, stats, name);
 #if defined(STRESS_THERMAL_ZONES)
 					tz_free(&shared->tz_info);
 #endif
@@ -2490,7 +3791,13 @@ again:
 					if (pid > -1) {
 						(void)setpgid(pid, pgrp);
 						procs[i].pids[j] = pid;
-						procs[i].started_procs++;
+						if (threaded) {
+							started += procs[i].num_procs - j;
+							procs[i].started_procs = procs[i].num_procs;
+						} else {
+							procs[i].started_procs++;
+							started++;
+						}
 					}
 
 					/* Forced early abort during startup? */
@@ -2512,7 +3819,47 @@ abort:
 		n_procs == 1 ? "" : "s");
 
 wait_for_procs:
+	if (opt_flags & OPT_FLAGS_SYNC_START) {
+		if (opt_sync_start_at > 0.0) {
+			(void)alarm(0);
+			sync_start_at_wait();
+			(void)alarm(opt_timeout);
+		}
+		pr_dbg(stderr, "releasing stressors after %.2fs startup\n",
+			time_now() - time_start);
+		sync_start_release();
+		time_start = time_now();
+	}
+#if defined(STRESS_LOG_ASYNC)
+	pr_log_drain_start();
+#endif
+#if defined(STRESS_SAMPLE)
+	if (opt_flags & OPT_FLAGS_SAMPLE)
+		(void)sample_start(stressors, procs);
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	if (opt_flags & OPT_FLAGS_THERMAL_ZONES)
+		tz_sample_start();
+#endif
+	if (opt_flags & OPT_FLAGS_IGNITE_CPU)
+		ignite_cpu_start(procs);
 	wait_procs(success, resource_success);
+	if (opt_flags & OPT_FLAGS_IGNITE_CPU)
+		ignite_cpu_stop(procs);
+	stress_energy_stop(procs);
+	stress_psi_stop(procs);
+	stress_irq_stop();
+#if defined(STRESS_THERMAL_ZONES)
+	if (opt_flags & OPT_FLAGS_THERMAL_ZONES)
+		tz_sample_stop();
+#endif
+#if defined(STRESS_SAMPLE)
+	if (opt_flags & OPT_FLAGS_SAMPLE)
+		sample_stop();
+#endif
+#if defined(STRESS_LOG_ASYNC)
+	pr_log_drain_stop();
+#endif
 	time_finish = time_now();
 
 	*duration += time_finish - time_start;
@@ -2551,7 +3898,7 @@ static int show_hogs(const uint32_t opt_class)
 
 			buffer_len = snprintf(buffer, sizeof(buffer), "%s %" PRId32 " %s",
 				previous ? "," : "", n,
-				munge_underscore(stressors[i].name));
+				stressor_munged[i]);
 			previous = true;
 			if (buffer_len >= 0) {
 				newstr = realloc(str, len + buffer_len + 1);
@@ -2573,32 +3920,76 @@ static int show_hogs(const uint32_t opt_class)
 	return 0;
 }
 
+/*
+ *  metrics_misc_mean()
+ *	get the mean of a stressor specific metric over all
+ *	the instances that set it, returns the description
+ *	of the metric or NULL if no instance set it
+ */
+static const char *metrics_misc_mean(
+	const int32_t i,
+	const size_t k,
+	double *mean)
+{
+	const char *description = NULL;
+	int32_t j, count = 0, n = procs[i].stats_index;
+	double total = 0.0;
+
+	for (j = 0; j < procs[i].started_procs; j++, n++) {
+		const stress_misc_metric_t *metric = &shared->stats[n].misc[k];
+
+		if (!*metric->description)
+			continue;
+		description = metric->description;
+		total += metric->value;
+		count++;
+	}
+	*mean = count ? total / (double)count : 0.0;
+
+	return description;
+}
+
 /*
  *  metrics_dump()
  *	output metrics
  */
 static void metrics_dump(
 	FILE *yaml,
-	const int32_t max_procs,
+	json_t *json,
 	const int32_t ticks_per_sec)
 {
 	int32_t i;
-
+	size_t k;
+	bool misc;
+	uint64_t energy_ops[STRESS_MAX];
+	double units[STRESS_MAX], units_rate[STRESS_MAX];
+
+	memset(energy_ops, 0, sizeof(energy_ops));
+	memset(units, 0, sizeof(units));
+	memset(units_rate, 0, sizeof(units_rate));
 	pr_inf(stdout, "%-13s %9.9s %9.9s %9.9s %9.9s %12s %12s\n",
 		"stressor", "bogo ops", "real time", "usr time", "sys time", "bogo ops/s", "bogo ops/s");
 	pr_inf(stdout, "%-13s %9.9s %9.9s %9.9s %9.9s %12s %12s\n",
 		"", "", "(secs) ", "(secs) ", "(secs) ", "(real time)", "(usr+sys time)");
 	pr_yaml(yaml, "metrics:\n");
+	json_array_begin(json, "metrics");
 
 	for (i = 0; i < STRESS_MAX; i++) {
 		uint64_t c_total = 0, u_total = 0, s_total = 0, us_total;
 		double   r_total = 0.0;
-		int32_t  j, n = (i * max_procs);
+		int32_t  j, n = procs[i].stats_index;
 		char *munged = munge_underscore(stressors[i].name);
 		double u_time, s_time, bogo_rate_r_time, bogo_rate;
+		double joules, watts;
 
 		for (j = 0; j < procs[i].started_procs; j++, n++) {
-			c_total += shared->stats[n].counter;
+			uint64_t c = shared->counters[n].counter;
+
+#if defined(STRESS_WARMUP)
+			c -= shared->stats[n].warmup_counter;
+#endif
+			c_total += c;
+			units[i] += (double)c * shared->stats[n].units_per_op;
 			u_total += shared->stats[n].tms.tms_utime +
 				   shared->stats[n].tms.tms_cutime;
 			s_total += shared->stats[n].tms.tms_stime +
@@ -2618,6 +4009,9 @@ static void metrics_dump(
 		s_time = (ticks_per_sec > 0) ? (double)s_total / (double)ticks_per_sec : 0.0;
 		bogo_rate_r_time = (r_total > 0.0) ? (double)c_total / r_total : 0.0;
 		bogo_rate = (us_total > 0) ? (double)c_total / ((double)us_total / (double)ticks_per_sec) : 0.0;
+		if (!stressors[i].unit)
+			units[i] = 0.0;
+		units_rate[i] = (r_total > 0.0) ? units[i] / r_total : 0.0;
 
 		pr_inf(stdout, "%-13s %9" PRIu64 " %9.2f %9.2f %9.2f %12.2f %12.2f\n",
 			munged,			/* stress test name */
@@ -2635,8 +4029,127 @@ static void metrics_dump(
 		pr_yaml(yaml, "      wall-clock-time: %f\n", r_total);
 		pr_yaml(yaml, "      user-time: %f\n", u_time);
 		pr_yaml(yaml, "      system-time: %f\n", s_time);
+		if (units[i] > 0.0) {
+			pr_yaml(yaml, "      work-unit: %s\n", stressors[i].unit);
+			pr_yaml(yaml, "      work-units: %f\n", units[i]);
+			pr_yaml(yaml, "      work-units-per-second-real-time: %f\n", units_rate[i]);
+		}
+		if (stress_energy_get(i, &joules, &watts)) {
+			pr_yaml(yaml, "      energy-joules: %f\n", joules);
+			pr_yaml(yaml, "      energy-watts: %f\n", watts);
+			pr_yaml(yaml, "      bogo-ops-per-joule: %f\n",
+				joules > 0.0 ? (double)c_total / joules : 0.0);
+			stress_energy_domains_dump(yaml, NULL, i);
+		}
+
+		json_obj_begin(json, NULL);
+		json_str(json, "stressor", munged);
+		json_uint(json, "bogo-ops", c_total);
+		json_double(json, "bogo-ops-per-second-usr-sys-time", bogo_rate);
+		json_double(json, "bogo-ops-per-second-real-time", bogo_rate_r_time);
+		json_double(json, "wall-clock-time", r_total);
+		json_double(json, "user-time", u_time);
+		json_double(json, "system-time", s_time);
+		if (units[i] > 0.0) {
+			json_str(json, "work-unit", stressors[i].unit);
+			json_double(json, "work-units", units[i]);
+			json_double(json, "work-units-per-second-real-time", units_rate[i]);
+		}
+		if (stress_energy_get(i, &joules, &watts)) {
+			json_double(json, "energy-joules", joules);
+			json_double(json, "energy-watts", watts);
+			json_double(json, "bogo-ops-per-joule",
+				joules > 0.0 ? (double)c_total / joules : 0.0);
+			stress_energy_domains_dump(NULL, json, i);
+		}
+		stress_usage_metrics(yaml, json, i, procs);
+		energy_ops[i] = c_total;
+
+		for (k = 0, misc = false; k < STRESS_MISC_METRICS_MAX; k++) {
+			double mean;
+			const char *description = metrics_misc_mean(i, k, &mean);
+
+			if (!description)
+				continue;
+			if (!misc) {
+				pr_yaml(yaml, "      misc-metrics:\n");
+				json_array_begin(json, "misc-metrics");
+				misc = true;
+			}
+			pr_yaml(yaml, "        - description: %s\n", description);
+			pr_yaml(yaml, "          value: %f\n", mean);
+
+			json_obj_begin(json, NULL);
+			json_str(json, "description", description);
+			json_double(json, "value", mean);
+			json_obj_end(json);
+		}
+		if (misc)
+			json_array_end(json);
+		json_obj_end(json);
 		pr_yaml(yaml, "\n");
 	}
+	json_array_end(json);
+
+	/* Stressor specific metrics, the mean of all the instances */
+	for (misc = false, i = 0; i < STRESS_MAX; i++) {
+		char *munged = munge_underscore(stressors[i].name);
+
+		for (k = 0; k < STRESS_MISC_METRICS_MAX; k++) {
+			double mean;
+			const char *description = metrics_misc_mean(i, k, &mean);
+
+			if (!description)
+				continue;
+			if (!misc) {
+				pr_inf(stdout, "%-13s %-32s %12s\n",
+					"stressor", "metric", "mean value");
+				misc = true;
+			}
+			pr_inf(stdout, "%-13s %-32s %12.2f\n",
+				munged, description, mean);
+		}
+	}
+
+	/* Normalised work, comparable where bogo ops are not */
+	for (misc = false, i = 0; i < STRESS_MAX; i++) {
+		if (units[i] <= 0.0)
+			continue;
+		if (!misc) {
+			pr_inf(stdout, "%-13s %-9s %15s %15s\n",
+				"stressor", "unit", "work units", "units/s");
+			misc = true;
+		}
+		pr_inf(stdout, "%-13s %-9s %15.0f %15.2f\n",
+			munge_underscore(stressors[i].name),
+			stressors[i].unit, units[i], units_rate[i]);
+	}
+
+	if (!(opt_flags & OPT_FLAGS_METRICS_BRIEF))
+		stress_usage_dump(stressors, procs);
+
+	/* RAPL energy, stressors run together share the energy used */
+	for (misc = false, i = 0; i < STRESS_MAX; i++) {
+		double joules, watts;
+
+		if (!stress_energy_get(i, &joules, &watts))
+			continue;
+		if (!misc) {
+			pr_inf(stdout, "%-13s %12s %12s %12s\n",
+				"stressor", "joules", "watts", "bogo ops/J");
+			misc = true;
+		}
+		pr_inf(stdout, "%-13s %12.2f %12.2f %12.2f\n",
+			munge_underscore(stressors[i].name), joules, watts,
+			joules > 0.0 ? (double)energy_ops[i] / joules : 0.0);
+	}
+
+	/* Per method metrics of --cpu-method all */
+	stress_cpu_method_dump(yaml, json);
+	stress_cpu_interfere_dump(yaml, json);
+	stress_rdrand_dump(yaml, json);
+	stress_metadata_dump(yaml, json);
+	stress_sync_file_dump(yaml, json);
 }
 
 /*
@@ -2645,6 +4158,7 @@ static void metrics_dump(
  */
 static void times_dump(
 	FILE *yaml,
+	json_t *json,
 	const int32_t ticks_per_sec,
 	const double duration)
 {
@@ -2694,6 +4208,22 @@ static void times_dump(
 		pr_yaml(yaml, "      load-average-5-minute: %f\n", min5);
 		pr_yaml(yaml, "      load-average-15-minute: %f\n", min15);
 	}
+
+	json_obj_begin(json, "times");
+	json_double(json, "run-time", duration);
+	json_double(json, "available-cpu-time", total_cpu_time);
+	json_double(json, "user-time", u_time);
+	json_double(json, "system-time", s_time);
+	json_double(json, "total-time", t_time);
+	json_double(json, "user-time-percent", u_pc);
+	json_double(json, "system-time-percent", s_pc);
+	json_double(json, "total-time-percent", t_pc);
+	if (!rc) {
+		json_double(json, "load-average-1-minute", min1);
+		json_double(json, "load-average-5-minute", min5);
+		json_double(json, "load-average-15-minute", min15);
+	}
+	json_obj_end(json);
 }
 
 /*
@@ -2774,12 +4304,77 @@ static void log_system_info(void)
 #endif
 }
 
+/*
+ *  stress_stats_layout()
+ *	give each stressor that can run a slot in the shared stats
+ *	for each of its instances, returns the number of slots
+ */
+static int32_t stress_stats_layout(const uint32_t opt_class)
+{
+	int32_t i, slots = 0;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		int32_t n = procs[i].num_procs;
+
+		/* Sequential runs set num_procs one stressor at a time */
+		if (opt_flags & OPT_FLAGS_SEQUENTIAL)
+			n = (procs[i].exclude || (opt_class &&
+			     !(stressors[i].class & opt_class))) ? 0 : opt_sequential;
+		procs[i].stats_index = slots;
+		procs[i].stats_count = n;
+		slots += n;
+	}
+	return slots;
+}
+
+/*
+ *  stress_shared_carve()
+ *	reserve n items of size bytes at *len of the shared
+ *	region, each array starts on a cache line
+ */
+static inline size_t stress_shared_carve(size_t *len, const size_t n, const size_t size)
+{
+	const size_t offset = (*len + sizeof(proc_counter_t) - 1) &
+		~(sizeof(proc_counter_t) - 1);
+
+	*len = offset + (n * size);
+	return offset;
+}
+
 /*
  *  stress_map_shared()
- *	mmap shared region
+ *	mmap shared region, the per instance arrays follow the
+ *	shared_t and the optional ones are only laid out when
+ *	their option is enabled
  */
-static inline void stress_map_shared(const size_t len)
+static inline void stress_map_shared(const int32_t slots)
 {
+	const size_t n = (size_t)slots;
+	size_t len = sizeof(shared_t), stats, counters;
+#if defined(STRESS_PERF_STATS)
+	const bool perf = !!(opt_flags & (OPT_FLAGS_PERF_STATS | OPT_FLAGS_PERF_CONTENTION));
+	const size_t perf_stats = perf ?
+		stress_shared_carve(&len, n, sizeof(stress_perf_t)) : 0;
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	const bool tz = !!(opt_flags & OPT_FLAGS_THERMAL_ZONES);
+	const size_t tz_stats = tz ?
+		stress_shared_carve(&len, n, sizeof(stress_tz_t)) : 0;
+#endif
+#if defined(STRESS_LATENCY)
+	const bool lat = !!(opt_flags & OPT_FLAGS_LATENCY);
+	const size_t lat_stats = lat ?
+		stress_shared_carve(&len, n, sizeof(stress_latency_t)) : 0;
+#endif
+#if defined(STRESS_LOG_ASYNC)
+	const bool log_async = !!(opt_flags & OPT_FLAGS_LOG_ASYNC);
+	const size_t log_rings = log_async ?
+		stress_shared_carve(&len, n, sizeof(log_ring_t)) : 0;
+#endif
+
+	stats = stress_shared_carve(&len, n, sizeof(proc_stats_t));
+	counters = stress_shared_carve(&len, n, sizeof(proc_counter_t));
+
 	shared = (shared_t *)mmap(NULL, len, PROT_READ | PROT_WRITE,
 		MAP_SHARED | MAP_ANON, -1, 0);
 	if (shared == MAP_FAILED) {
@@ -2790,6 +4385,63 @@ static inline void stress_map_shared(const size_t len)
 	}
 	memset(shared, 0, len);
 	shared->length = len;
+	shared->stats_slots = slots;
+	shared->stats = (proc_stats_t *)((uint8_t *)shared + stats);
+	shared->counters = (proc_counter_t *)((uint8_t *)shared + counters);
+#if defined(STRESS_PERF_STATS)
+	if (perf)
+		shared->perf_stats = (stress_perf_t *)((uint8_t *)shared + perf_stats);
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	if (tz)
+		shared->tz_stats = (stress_tz_t *)((uint8_t *)shared + tz_stats);
+#endif
+#if defined(STRESS_LATENCY)
+	if (lat)
+		shared->lat_stats = (stress_latency_t *)((uint8_t *)shared + lat_stats);
+#endif
+#if defined(STRESS_LOG_ASYNC)
+	if (log_async)
+		shared->log_rings = (log_ring_t *)((uint8_t *)shared + log_rings);
+#endif
+	pr_dbg(stderr, "%zu bytes of shared stats for %" PRId32 " instance%s\n",
+		len, slots, slots == 1 ? "" : "s");
+}
+
+/*
+ *  stress_stats_clear_slots()
+ *	zero the per instance stats and counters of count
+ *	slots from first before a rerun
+ */
+void stress_stats_clear_slots(const int32_t first, const int32_t count)
+{
+	const size_t f = (size_t)first, n = (size_t)count;
+
+	memset(&shared->stats[f], 0, n * sizeof(*shared->stats));
+	memset(&shared->counters[f], 0, n * sizeof(*shared->counters));
+	/* stream totals are summed by the instances of each run */
+	memset(&shared->stream, 0, sizeof(shared->stream));
+#if defined(STRESS_PERF_STATS)
+	if (shared->perf_stats)
+		memset(&shared->perf_stats[f], 0, n * sizeof(*shared->perf_stats));
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	if (shared->tz_stats)
+		memset(&shared->tz_stats[f], 0, n * sizeof(*shared->tz_stats));
+#endif
+#if defined(STRESS_LATENCY)
+	if (shared->lat_stats)
+		memset(&shared->lat_stats[f], 0, n * sizeof(*shared->lat_stats));
+#endif
+}
+
+/*
+ *  stress_stats_clear()
+ *	zero the per instance stats and counters before a rerun
+ */
+void stress_stats_clear(void)
+{
+	stress_stats_clear_slots(0, shared->stats_slots);
 }
 
 /*
@@ -2914,11 +4566,12 @@ static inline void set_random_stressors(const int32_t opt_random)
 int main(int argc, char **argv)
 {
 	double duration = 0.0;			/* stressor run time in secs */
-	size_t len;
 	bool success = true, resource_success = true;
 	char *opt_exclude = NULL;		/* List of stressors to exclude */
 	char *yamlfile = NULL;			/* YAML filename */
 	FILE *yaml = NULL;			/* YAML output file */
+	char *jsonfile = NULL;			/* JSON filename */
+	json_t *json = NULL;			/* JSON output file */
 	char *logfile = NULL;			/* log filename */
 	int64_t opt_backoff = DEFAULT_BACKOFF;	/* child delay */
 	int32_t ticks_per_sec;			/* clock ticks per second (jiffies) */
@@ -2928,13 +4581,27 @@ int main(int argc, char **argv)
 	int32_t opt_ionice_level = UNDEFINED;	/* ionice level */
 	uint32_t opt_class = 0;			/* Which kind of class is specified */
 	int32_t opt_random = 0, i;
-	int32_t total_procs = 0, max_procs = 0;
+	int32_t total_procs = 0;
 	int mem_cache_level = DEFAULT_CACHE_LEVEL;
 	int mem_cache_ways = 0;
+	int regressions = 0;			/* --compare regressions */
 
 	/* --exec stressor uses this to exec itself and then exit early */
 	if ((argc == 2) && !strcmp(argv[1], "--exec-exit"))
 		exit(EXIT_SUCCESS);
+	/* --fork-method exec and spawn report when main() was reached */
+	if ((argc == 2) && !strcmp(argv[1], "--exec-exit-ts")) {
+		const uint64_t ns = time_mono_ns();
+
+		exit(write(STDOUT_FILENO, &ns, sizeof(ns)) == sizeof(ns) ?
+			EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	stressor_index_init();
+
+	/* --job options are expanded in place before parsing */
+	if (stress_job_expand(&argc, &argv) < 0)
+		exit(EXIT_FAILURE);
 
 	memset(procs, 0, sizeof(procs));
 	mwc_reseed();
@@ -2968,23 +4635,19 @@ next_opt:
 			long_options, &option_index)) == -1)
 			break;
 
-		for (s_id = 0; stressors[s_id].id != STRESS_MAX; s_id++) {
-			if (stressors[s_id].short_getopt == c) {
-				const char *name = opt_name(c);
-
-				opt_flags |= OPT_FLAGS_SET;
-				procs[s_id].num_procs = get_int32(optarg);
-				stress_get_processors(&procs[s_id].num_procs);
-				check_value(name, procs[s_id].num_procs);
-
-				goto next_opt;
-			}
-			if (stressors[s_id].op == (stress_op)c) {
+		if ((c >= 0) && (c < OPT_MAX) && (opt_index[c].stressor >= 0)) {
+			s_id = (stress_id)opt_index[c].stressor;
+			if (opt_index[c].ops) {
 				procs[s_id].bogo_ops = get_uint64(optarg);
 				check_range(opt_name(c), procs[s_id].bogo_ops,
 					MIN_OPS, MAX_OPS);
-				goto next_opt;
+			} else {
+				opt_flags |= OPT_FLAGS_SET;
+				procs[s_id].num_procs = get_int32(optarg);
+				stress_get_processors(&procs[s_id].num_procs);
+				check_value(opt_name(c), procs[s_id].num_procs);
 			}
+			goto next_opt;
 		}
 
 		switch (c) {
@@ -2997,6 +4660,30 @@ next_opt:
 		case OPT_AIO_LINUX_REQUESTS:
 			stress_set_aio_linux_requests(optarg);
 			break;
+		case OPT_AIO_LINUX_SWEEP:
+			stress_set_aio_linux_sweep();
+			break;
+		case OPT_AIO_LINUX_MIN_NR:
+			stress_set_aio_linux_min_nr(optarg);
+			break;
+#endif
+#if defined(STRESS_ARENA)
+		case OPT_ARENA_METHOD:
+			if (stress_set_arena_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_ARENA_OBJECTS:
+			stress_set_arena_objects(optarg);
+			break;
+		case OPT_ARENA_SIZE:
+			stress_set_arena_size(optarg);
+			break;
+		case OPT_ARENA_TCACHE:
+			stress_set_arena_tcache();
+			break;
+		case OPT_ARENA_THREADS:
+			stress_set_arena_threads(optarg);
+			break;
 #endif
 		case OPT_ALL:
 			opt_flags |= (OPT_FLAGS_SET | OPT_FLAGS_ALL);
@@ -3008,6 +4695,19 @@ next_opt:
 		case OPT_AFFINITY_RAND:
 			opt_flags |= OPT_FLAGS_AFFINITY_RAND;
 			break;
+#endif
+#if defined(STRESS_AF_ALG)
+		case OPT_AF_ALG_THROUGHPUT:
+			stress_set_af_alg_throughput();
+			break;
+#endif
+#if defined(STRESS_AF_PACKET)
+		case OPT_AF_PACKET_PORT:
+			stress_set_af_packet_port(optarg);
+			break;
+		case OPT_AF_PACKET_SIZE:
+			stress_set_af_packet_size(optarg);
+			break;
 #endif
 		case OPT_AGGRESSIVE:
 			opt_flags |= OPT_FLAGS_AGGRESSIVE_MASK;
@@ -3024,6 +4724,13 @@ next_opt:
 		case OPT_BSEARCH_SIZE:
 			stress_set_bsearch_size(optarg);
 			break;
+		case OPT_BSEARCH_METHOD:
+			if (stress_set_bsearch_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_BSEARCH_SWEEP:
+			stress_set_bsearch_sweep();
+			break;
 		case OPT_CACHE_PREFETCH:
 			opt_flags |= OPT_FLAGS_CACHE_PREFETCH;
 			break;
@@ -3044,39 +4751,129 @@ next_opt:
 		case OPT_CACHE_NO_AFFINITY:
 			opt_flags |= OPT_FLAGS_CACHE_NOAFF;
 			break;
+		case OPT_CACHELINE_LAYOUT:
+			if (stress_set_cacheline_layout(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_CACHELINE_OP:
+			if (stress_set_cacheline_op(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_CACHELINE_MATRIX:
+			stress_set_cacheline_matrix(optarg);
+			break;
 		case OPT_CACHE_WAYS:
 			mem_cache_ways = atoi(optarg);
 			if (mem_cache_ways <= 0)
 				mem_cache_ways = 0;
 			break;
-		case OPT_CLASS:
-			opt_class = get_class(optarg);
-			if (!opt_class)
+		case OPT_CGROUP:
+			if (stress_set_cgroup(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
-#if defined(STRESS_CLONE)
-		case OPT_CLONE_MAX:
+		case OPT_CGROUP_CPU_MAX:
+			if (stress_set_cgroup_cpu_max(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_CGROUP_MEMORY_MAX:
+			stress_set_cgroup_memory_max(optarg);
+			break;
+		case OPT_CGROUP_IO_MAX:
+			if (stress_set_cgroup_io_max(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_RESCTRL:
+			if (stress_set_resctrl(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_IRQ_STATS:
+			stress_set_irq_stats(optarg);
+			break;
+		case OPT_CLASS:
+			opt_class = get_class(optarg);
+			if (!opt_class)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_COMPARE:
+			stress_set_compare(optarg);
+			break;
+		case OPT_COMPARE_THRESHOLD:
+			stress_set_compare_threshold(optarg);
+			break;
+#if defined(STRESS_CLOCK)
+		case OPT_CLOCK_COST:
+			stress_set_clock_cost();
+			break;
+#endif
+#if defined(STRESS_CLONE)
+		case OPT_CLONE_MAX:
 			stress_set_clone_max(optarg);
 			break;
 #endif
+#if defined(STRESS_COMPACT)
+		case OPT_COMPACT_BYTES:
+			stress_set_compact_bytes(optarg);
+			break;
+		case OPT_COMPACT_KEEP:
+			stress_set_compact_keep(optarg);
+			break;
+		case OPT_COMPACT_PIN:
+			stress_set_compact_pin(optarg);
+			break;
+#endif
+#if defined(STRESS_CONTEXT)
+		case OPT_CONTEXT_COMPARE:
+			stress_set_context_compare();
+			break;
+#endif
 #if defined(STRESS_COPY_FILE)
 		case OPT_COPY_FILE_BYTES:
 			stress_set_copy_file_bytes(optarg);
 			break;
+		case OPT_COPY_FILE_SWEEP:
+			stress_set_copy_file_sweep();
+			break;
 #endif
+		case OPT_CPU_AVX_INTERFERE:
+			stress_set_cpu_avx_interfere();
+			break;
 		case OPT_CPU_LOAD:
 			stress_set_cpu_load(optarg);
 			break;
 		case OPT_CPU_LOAD_SLICE:
 			stress_set_cpu_load_slice(optarg);
 			break;
+		case OPT_CPU_LOAD_PERIOD:
+			stress_set_cpu_load_period(optarg);
+			break;
+		case OPT_CPU_LOAD_PROFILE:
+			if (stress_set_cpu_load_profile(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_CPU_METHOD:
 			if (stress_set_cpu_method(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+#if defined(STRESS_CPU_ONLINE)
+		case OPT_CPU_ONLINE_IMPACT:
+			stress_set_cpu_online_impact();
+			break;
+#endif
+#if defined(STRESS_CRYPT)
+		case OPT_CRYPT_METHOD:
+			if (stress_set_crypt_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_CRYPT_ROUNDS:
+			stress_set_crypt_rounds(optarg);
+			break;
+#endif
 		case OPT_DRY_RUN:
 			opt_flags |= OPT_FLAGS_DRY_RUN;
 			break;
+		case OPT_ENERGY:
+			opt_flags |= (OPT_FLAGS_ENERGY | OPT_FLAGS_METRICS);
+			break;
 		case OPT_DENTRIES:
 			stress_set_dentries(optarg);
 			break;
@@ -3084,6 +4881,19 @@ next_opt:
 			if (stress_set_dentry_order(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+		case OPT_DENTRY_NEGATIVE:
+			stress_set_dentry_negative();
+			break;
+#if defined(STRESS_DSP)
+		case OPT_DSP_METHOD:
+			if (stress_set_dsp_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_DSP_SIZES:
+			if (stress_set_dsp_sizes(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#endif
 #if defined(STRESS_EPOLL)
 		case OPT_EPOLL_DOMAIN:
 			if (stress_set_epoll_domain(optarg) < 0)
@@ -3092,6 +4902,12 @@ next_opt:
 		case OPT_EPOLL_PORT:
 			stress_set_epoll_port(optarg);
 			break;
+		case OPT_EPOLL_CONNS:
+			stress_set_epoll_conns(optarg);
+			break;
+		case OPT_EPOLL_THREADS:
+			stress_set_epoll_threads(optarg);
+			break;
 #endif
 		case OPT_EXCLUDE:
 			opt_exclude = optarg;
@@ -3100,12 +4916,26 @@ next_opt:
 		case OPT_EXEC_MAX:
 			stress_set_exec_max(optarg);
 			break;
+		case OPT_EXEC_TARGETS:
+			if (stress_set_exec_targets(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 #endif
 #if defined(STRESS_FALLOCATE)
 		case OPT_FALLOCATE_BYTES:
 			stress_set_fallocate_bytes(optarg);
 			break;
+		case OPT_FALLOCATE_MATRIX:
+			stress_set_fallocate_matrix();
+			break;
+		case OPT_FALLOCATE_GRAN:
+			stress_set_fallocate_gran(optarg);
+			break;
 #endif
+		case OPT_FAULT_CLASS:
+			if (stress_set_fault_class(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 #if defined(STRESS_FIEMAP)
 		case OPT_FIEMAP_BYTES:
 			stress_set_fiemap_size(optarg);
@@ -3121,12 +4951,100 @@ next_opt:
 		case OPT_FORK_MAX:
 			stress_set_fork_max(optarg);
 			break;
+#if defined(STRESS_LATENCY)
+		case OPT_FORK_LATENCY:
+			stress_set_fork_latency();
+			break;
+		case OPT_FORK_METHOD:
+			if (stress_set_fork_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_FORK_RSS:
+			stress_set_fork_rss(optarg);
+			break;
+#endif
+		case OPT_FORKHEAP_BYTES:
+			stress_set_forkheap_bytes(optarg);
+			break;
+		case OPT_FORKHEAP_COW:
+			stress_set_forkheap_cow(optarg);
+			break;
+		case OPT_FORKHEAP_THP:
+			stress_set_forkheap_thp();
+			break;
+		case OPT_FORKHEAP_VMAS:
+			stress_set_forkheap_vmas(optarg);
+			break;
+#if defined(STRESS_FRONTEND)
+		case OPT_FRONTEND_MODE:
+			if (stress_set_frontend_mode(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_FRONTEND_SIZE:
+			stress_set_frontend_size(optarg);
+			break;
+		case OPT_FRONTEND_ENTROPY:
+			stress_set_frontend_entropy(optarg);
+			break;
+#endif
+		case OPT_FLOCK_CONTENDERS:
+			stress_set_flock_contenders(optarg);
+			break;
 		case OPT_FSTAT_DIR:
 			stress_set_fstat_dir(optarg);
 			break;
+#if defined(HAVE_LIB_PTHREAD)
+		case OPT_FSTAT_PTHREADS:
+			stress_set_fstat_pthreads(optarg);
+			break;
+#endif
+#if defined(STRESS_GETDENT)
+		case OPT_GETDENT_ENTRIES:
+			stress_set_getdent_entries(optarg);
+			break;
+#endif
+#if defined(STRESS_GETRANDOM)
+		case OPT_GETRANDOM_SWEEP:
+			stress_set_getrandom_sweep();
+			break;
+#endif
+#if defined(STRESS_FUTEX)
+		case OPT_FUTEX_MODE:
+			if (stress_set_futex_mode(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_FUTEX_WAITERS:
+			stress_set_futex_waiters(optarg);
+			break;
+		case OPT_FUTEX_WAKE:
+			stress_set_futex_wake(optarg);
+			break;
+#endif
 		case OPT_HELP:
 			usage();
 			break;
+		case OPT_HASH_METHOD:
+			if (stress_set_hash_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#if defined(STRESS_HASHMAP)
+		case OPT_HASHMAP_METHOD:
+			if (stress_set_hashmap_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_HASHMAP_KEYS:
+			stress_set_hashmap_keys(optarg);
+			break;
+		case OPT_HASHMAP_READS:
+			stress_set_hashmap_reads(optarg);
+			break;
+		case OPT_HASHMAP_THREADS:
+			stress_set_hashmap_threads(optarg);
+			break;
+		case OPT_HASHMAP_ZIPF:
+			stress_set_hashmap_zipf(optarg);
+			break;
+#endif
 		case OPT_HDD_BYTES:
 			stress_set_hdd_bytes(optarg);
 			break;
@@ -3137,6 +5055,27 @@ next_opt:
 		case OPT_HDD_WRITE_SIZE:
 			stress_set_hdd_write_size(optarg);
 			break;
+		case OPT_HDD_ENGINE:
+			if (stress_set_hdd_engine(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_HDD_QD:
+			stress_set_hdd_qd(optarg);
+			break;
+		case OPT_HDD_DIST:
+			if (stress_set_hdd_dist(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_HDD_RW_MIX:
+			stress_set_hdd_rw_mix(optarg);
+			break;
+		case OPT_HDD_PATHS:
+			if (stress_set_hdd_paths(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_HDD_STRIPE:
+			stress_set_hdd_stripe(optarg);
+			break;
 #if defined(STRESS_HEAPSORT)
 		case OPT_HEAPSORT_INTEGERS:
 			stress_set_heapsort_size(optarg);
@@ -3145,9 +5084,39 @@ next_opt:
 		case OPT_HSEARCH_SIZE:
 			stress_set_hsearch_size(optarg);
 			break;
+		case OPT_HUGEPAGES:
+			if (stress_set_hugepages(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_IGNITE_CPU:
 			opt_flags |= OPT_FLAGS_IGNITE_CPU;
 			break;
+		case OPT_IGNITE_CPU_LIST:
+			stress_set_ignite_cpu_list(optarg);
+			break;
+		case OPT_IGNITE_CPU_BASELINE:
+			stress_set_ignite_cpu_baseline(optarg);
+			break;
+#if defined(STRESS_ICMP_FLOOD)
+		case OPT_ICMP_FLOOD_BATCH:
+			stress_set_icmp_flood_batch(optarg);
+			break;
+		case OPT_ICMP_FLOOD_RECV:
+			stress_set_icmp_flood_recv();
+			break;
+		case OPT_ICMP_FLOOD_SWEEP:
+			stress_set_icmp_flood_sweep();
+			break;
+#endif
+#if defined(STRESS_INOTIFY)
+		case OPT_INOTIFY_API:
+			if (stress_set_inotify_api(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_INOTIFY_WRITERS:
+			stress_set_inotify_writers(optarg);
+			break;
+#endif
 #if defined(STRESS_IONICE)
 		case OPT_IONICE_CLASS:
 			opt_ionice_class = get_opt_ionice_class(optarg);
@@ -3155,38 +5124,135 @@ next_opt:
 		case OPT_IONICE_LEVEL:
 			opt_ionice_level = get_int32(optarg);
 			break;
+#endif
+#if defined(STRESS_IO_URING_NET)
+		case OPT_IO_URING_NET_CONNS:
+			stress_set_io_uring_net_conns(optarg);
+			break;
+		case OPT_IO_URING_NET_DOMAIN:
+			if (stress_set_io_uring_net_domain(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_IO_URING_NET_PORT:
+			stress_set_io_uring_net_port(optarg);
+			break;
+		case OPT_IO_URING_NET_PROTO:
+			if (stress_set_io_uring_net_proto(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_IO_URING_NET_SIZE:
+			stress_set_io_uring_net_size(optarg);
+			break;
+		case OPT_IO_URING_NET_SQPOLL:
+			stress_set_io_uring_net_sqpoll();
+			break;
+#endif
+#if defined(STRESS_IOCMP)
+		case OPT_IOCMP_BS:
+			stress_set_iocmp_bs(optarg);
+			break;
+		case OPT_IOCMP_QD:
+			stress_set_iocmp_qd(optarg);
+			break;
+		case OPT_IOCMP_READ_PCT:
+			stress_set_iocmp_read_pct(optarg);
+			break;
+		case OPT_IOCMP_SIZE:
+			stress_set_iocmp_size(optarg);
+			break;
 #endif
 		case OPT_ITIMER_FREQ:
 			stress_set_itimer_freq(optarg);
 			break;
+#if defined(STRESS_KSM)
+		case OPT_KSM_BYTES:
+			stress_set_ksm_bytes(optarg);
+			break;
+		case OPT_KSM_DUP:
+			stress_set_ksm_dup(optarg);
+			break;
+#endif
+		case OPT_JSON:
+			jsonfile = optarg;
+			break;
 		case OPT_KEEP_NAME:
 			opt_flags |= OPT_FLAGS_KEEP_NAME;
 			break;
+#if defined(STRESS_KEY)
+		case OPT_KEY_MAX:
+			stress_set_key_max(optarg);
+			break;
+		case OPT_KEY_SCALE:
+			stress_set_key_scale();
+			break;
+#endif
 #if defined(STRESS_LEASE)
 		case OPT_LEASE_BREAKERS:
 			stress_set_lease_breakers(optarg);
 			break;
 #endif
+#if defined(STRESS_LFQUEUE)
+		case OPT_LFQUEUE_CONSUMERS:
+			stress_set_lfqueue_consumers(optarg);
+			break;
+		case OPT_LFQUEUE_PIN:
+			stress_set_lfqueue_pin();
+			break;
+		case OPT_LFQUEUE_PRODUCERS:
+			stress_set_lfqueue_producers(optarg);
+			break;
+		case OPT_LFQUEUE_TYPE:
+			if (stress_set_lfqueue_type(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#endif
 #if defined(STRESS_LOCKF)
 		case OPT_LOCKF_NONBLOCK:
 			opt_flags |= OPT_FLAGS_LOCKF_NONBLK;
 			break;
+#endif
+#if defined(STRESS_LOG_ASYNC)
+		case OPT_LOG_ASYNC:
+			opt_flags |= OPT_FLAGS_LOG_ASYNC;
+			break;
 #endif
 		case OPT_LOG_BRIEF:
 			opt_flags |= OPT_FLAGS_LOG_BRIEF;
 			break;
+#if defined(STRESS_LATENCY)
+		case OPT_LATENCY:
+			stress_set_latency(optarg);
+			break;
+#endif
 		case OPT_LOG_FILE:
 			logfile = optarg;
 			break;
+#if defined(STRESS_LOCKBUS)
+		case OPT_LOCKBUS_VICTIM:
+			stress_set_lockbus_victim();
+			break;
+#endif
 		case OPT_LSEARCH_SIZE:
 			stress_set_lsearch_size(optarg);
 			break;
 		case OPT_MALLOC_BYTES:
 			stress_set_malloc_bytes(optarg);
 			break;
+		case OPT_MALLOC_DIST:
+			if (stress_set_malloc_dist(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_MALLOC_MAX:
 			stress_set_malloc_max(optarg);
 			break;
+#if defined(HAVE_LIB_PTHREAD)
+		case OPT_MALLOC_PTHREADS:
+			stress_set_malloc_pthreads(optarg);
+			break;
+		case OPT_MALLOC_XFREE:
+			stress_set_malloc_xfree(optarg);
+			break;
+#endif
 #if defined(STRESS_MALLOPT)
 		case OPT_MALLOC_THRESHOLD:
 			stress_set_malloc_threshold(optarg);
@@ -3199,13 +5265,41 @@ next_opt:
 		case OPT_MATRIX_SIZE:
 			stress_set_matrix_size(optarg);
 			break;
+		case OPT_MATRIX_THREADS:
+			stress_set_matrix_threads(optarg);
+			break;
 		case OPT_MAXIMIZE:
 			opt_flags |= OPT_FLAGS_MAXIMIZE;
 			break;
+#if defined(STRESS_MEMBARRIER)
+		case OPT_MEMBARRIER_READERS:
+			stress_set_membarrier_readers(optarg);
+			break;
+		case OPT_MEMBARRIER_SYNC:
+			if (stress_set_membarrier_sync(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#endif
+		case OPT_MEMCPY_BW:
+			stress_set_memcpy_bw(optarg);
+			break;
+		case OPT_MEMCPY_METHOD:
+			if (stress_set_memcpy_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_MEMCPY_SWEEP:
+			stress_set_memcpy_sweep();
+			break;
 #if defined(STRESS_MEMFD)
 		case OPT_MEMFD_BYTES:
 			stress_set_memfd_bytes(optarg);
 			break;
+		case OPT_MEMFD_IPC:
+			stress_set_memfd_ipc();
+			break;
+		case OPT_MEMFD_CONSUMERS:
+			stress_set_memfd_consumers(optarg);
+			break;
 #endif
 		case OPT_METRICS:
 			opt_flags |= OPT_FLAGS_METRICS;
@@ -3213,11 +5307,25 @@ next_opt:
 		case OPT_METRICS_BRIEF:
 			opt_flags |= (OPT_FLAGS_METRICS_BRIEF | OPT_FLAGS_METRICS);
 			break;
+		case OPT_MIGRATE:
+			if (stress_set_migrate(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_MIGRATE_PERIOD:
+			stress_set_migrate_period(optarg);
+			break;
 #if defined(STRESS_MERGESORT)
 		case OPT_MERGESORT_INTEGERS:
 			stress_set_mergesort_size(optarg);
 			break;
 #endif
+		case OPT_METADATA_LAYOUT:
+			if (stress_set_metadata_layout(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_METADATA_FILES:
+			stress_set_metadata_files(optarg);
+			break;
 #if defined(STRESS_MINCORE)
 		case OPT_MINCORE_RAND:
 			opt_flags |= OPT_FLAGS_MINCORE_RAND;
@@ -3232,16 +5340,39 @@ next_opt:
 		case OPT_MMAP_BYTES:
 			stress_set_mmap_bytes(optarg);
 			break;
+#if defined(STRESS_MMAPLOCK)
+		case OPT_MMAPLOCK_THREADS:
+			stress_set_mmaplock_threads(optarg);
+			break;
+#endif
 		case OPT_MMAP_FILE:
 			opt_flags |= OPT_FLAGS_MMAP_FILE;
 			break;
+#if defined(STRESS_MLOCK)
+		case OPT_MLOCK_BYTES:
+			stress_set_mlock_bytes(optarg);
+			break;
+		case OPT_MLOCK_COST:
+			stress_set_mlock_cost();
+			break;
+#endif
+		case OPT_MMAPMANY_SCALE:
+			stress_set_mmapmany_scale();
+			break;
 		case OPT_MMAP_MPROTECT:
 			opt_flags |= OPT_FLAGS_MMAP_MPROTECT;
 			break;
+		case OPT_MMAP_PREFAULT:
+			if (stress_set_mmap_prefault(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 #if defined(STRESS_MREMAP)
 		case OPT_MREMAP_BYTES:
 			stress_set_mremap_bytes(optarg);
 			break;
+		case OPT_MREMAP_GROW:
+			stress_set_mremap_grow();
+			break;
 #endif
 #if defined(STRESS_MSYNC)
 		case OPT_MSYNC_BYTES:
@@ -3252,26 +5383,75 @@ next_opt:
 		case OPT_MQ_SIZE:
 			stress_set_mq_size(optarg);
 			break;
+		case OPT_MQ_SWEEP:
+			stress_set_mq_sweep();
+			break;
+		case OPT_MQ_PRODUCERS:
+			stress_set_mq_producers(optarg);
+			break;
+		case OPT_MQ_CONSUMERS:
+			stress_set_mq_consumers(optarg);
+			break;
 #endif
 		case OPT_NO_MADVISE:
 			opt_flags &= ~OPT_FLAGS_MMAP_MADVISE;
 			break;
+		case OPT_NET_PEER:
+			if (stress_set_net_peer(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_NET_ROLE:
+			if (stress_set_net_role(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_NICE_LEVELS:
+			if (stress_set_nice_levels(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_NO_RAND_SEED:
 			opt_flags |= OPT_FLAGS_NO_RAND_SEED;
 			break;
+		case OPT_NUMA_PLACE:
+			if (stress_set_numa_place(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#if defined(STRESS_NUMA)
+		case OPT_NUMA_BYTES:
+			stress_set_numa_bytes(optarg);
+			break;
+		case OPT_NUMA_MIGRATE:
+			stress_set_numa_migrate();
+			break;
+#endif
 
 #if defined(STRESS_PAGE_IN)
 		case OPT_PAGE_IN:
 			opt_flags |= OPT_FLAGS_MMAP_MINCORE;
 			break;
+		case OPT_PAGE_RESIDENCY:
+			opt_flags |= (OPT_FLAGS_PAGE_RESIDENCY | OPT_FLAGS_METRICS);
+			break;
 #endif
 		case OPT_PATHOLOGICAL:
 			opt_flags |= OPT_FLAGS_PATHOLOGICAL;
 			break;
+		case OPT_PSI:
+			opt_flags |= OPT_FLAGS_PSI;
+			break;
+		case OPT_PIN:
+			if (stress_set_pin(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 #if defined(STRESS_PERF_STATS)
 		case OPT_PERF_STATS:
 			opt_flags |= OPT_FLAGS_PERF_STATS;
 			break;
+		case OPT_PERF_CONTENTION:
+			opt_flags |= (OPT_FLAGS_PERF_STATS | OPT_FLAGS_PERF_CONTENTION);
+			break;
+		case OPT_PROFILE:
+			opt_flags |= OPT_FLAGS_PROFILE;
+			break;
 #endif
 		case OPT_PIPE_DATA_SIZE:
 			stress_set_pipe_data_size(optarg);
@@ -3280,11 +5460,37 @@ next_opt:
 		case OPT_PIPE_SIZE:
 			stress_set_pipe_size(optarg);
 			break;
+		case OPT_PIPE_SWEEP:
+			stress_set_pipe_sweep();
+			break;
+#endif
+		case OPT_POLL_SCALE:
+			stress_set_poll_scale(optarg);
+			break;
+#if defined(STRESS_PROCFS)
+		case OPT_PROCFS_TOP:
+			stress_set_procfs_top(optarg);
+			break;
 #endif
 #if defined(STRESS_PTHREAD)
 		case OPT_PTHREAD_MAX:
 			stress_set_pthread_max(optarg);
 			break;
+		case OPT_PTHREAD_METHOD:
+			if (stress_set_pthread_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_PTHREAD_STACK:
+			stress_set_pthread_stack(optarg);
+			break;
+#endif
+#if defined(STRESS_PTY)
+		case OPT_PTY_DATA:
+			stress_set_pty_data();
+			break;
+		case OPT_PTY_MAX:
+			stress_set_pty_max(optarg);
+			break;
 #endif
 		case OPT_QSORT_INTEGERS:
 			stress_set_qsort_size(optarg);
@@ -3296,16 +5502,63 @@ next_opt:
 		case OPT_QUIET:
 			opt_flags &= ~(PR_ALL);
 			break;
+		case OPT_RAMP:
+			if (stress_set_ramp(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_RAMP_FILE:
+			stress_set_ramp_file(optarg);
+			break;
+		case OPT_REPEAT:
+			stress_set_repeat(optarg);
+			break;
 		case OPT_RANDOM:
 			opt_flags |= OPT_FLAGS_RANDOM;
 			opt_random = get_int32(optarg);
 			stress_get_processors(&opt_random);
 			check_value("random", opt_random);
 			break;
+#if defined(STRESS_RDRAND)
+		case OPT_RDRAND_METHOD:
+			if (stress_set_rdrand_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_RDRAND_SCALE:
+			stress_set_rdrand_scale();
+			break;
+#endif
 #if defined(STRESS_READAHEAD)
 		case OPT_READAHEAD_BYTES:
 			stress_set_readahead_bytes(optarg);
 			break;
+		case OPT_READAHEAD_SWEEP:
+			stress_set_readahead_sweep();
+			break;
+#endif
+#if defined(STRESS_RMAP)
+		case OPT_RMAP_SHARERS:
+			stress_set_rmap_sharers(optarg);
+			break;
+		case OPT_RMAP_SCALE:
+			stress_set_rmap_scale();
+			break;
+#endif
+#if defined(STRESS_SAMPLE)
+		case OPT_SAMPLE:
+			stress_set_sample_interval(optarg);
+			break;
+		case OPT_SAMPLE_FILE:
+			stress_set_sample_file(optarg);
+			break;
+		case OPT_SAMPLE_TEXTFILE:
+			stress_set_sample_textfile(optarg);
+			break;
+		case OPT_CONVERGE:
+			stress_set_converge(optarg);
+			break;
+		case OPT_CONVERGE_WINDOWS:
+			stress_set_converge_windows(optarg);
+			break;
 #endif
 		case OPT_SCHED:
 			opt_sched = get_opt_sched(optarg);
@@ -3313,15 +5566,35 @@ next_opt:
 		case OPT_SCHED_PRIO:
 			opt_sched_priority = get_int32(optarg);
 			break;
+#if defined(STRESS_SCHEDLAT)
+		case OPT_SCHEDLAT_POLICY:
+			if (stress_set_schedlat_policy(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_SCHEDLAT_MESSENGERS:
+			stress_set_schedlat_messengers(optarg);
+			break;
+		case OPT_SCHEDLAT_THINK:
+			stress_set_schedlat_think(optarg);
+			break;
+#endif
 #if defined(STRESS_SCTP)
 		case OPT_SCTP_PORT:
 			stress_set_sctp_port(optarg);
 			break;
+		case OPT_SCTP_STREAMS:
+			stress_set_sctp_streams(optarg);
+			break;
 		case OPT_SCTP_DOMAIN:
 			if (stress_set_sctp_domain(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
 #endif
+#if defined(STRESS_SECCOMP)
+		case OPT_SECCOMP_RULES:
+			stress_set_seccomp_rules(optarg);
+			break;
+#endif
 #if defined(OPT_SEEK_PUNCH)
 		case OPT_SEEK_PUNCH:
 			opt_flags |= OPT_FLAGS_SEEK_PUNCH;
@@ -3344,6 +5617,9 @@ next_opt:
 		case OPT_SENDFILE_SIZE:
 			stress_set_sendfile_size(optarg);
 			break;
+		case OPT_SENDFILE_SWEEP:
+			stress_set_sendfile_sweep();
+			break;
 #endif
 		case OPT_SEQUENTIAL:
 			opt_flags |= OPT_FLAGS_SEQUENTIAL;
@@ -3352,6 +5628,13 @@ next_opt:
 			check_range("sequential", opt_sequential,
 				MIN_SEQUENTIAL, MAX_SEQUENTIAL);
 			break;
+		case OPT_SMT_BENCH:
+			stress_set_smt_bench();
+			break;
+		case OPT_SMT_CPUS:
+			if (stress_set_smt_cpus(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 #if defined(STRESS_SHM_POSIX)
 		case OPT_SHM_POSIX_BYTES:
 			stress_set_shm_posix_bytes(optarg);
@@ -3366,6 +5649,12 @@ next_opt:
 		case OPT_SHM_SYSV_SEGMENTS:
 			stress_set_shm_sysv_segments(optarg);
 			break;
+#if defined(STRESS_SIGQUEUE)
+		case OPT_SIGQUEUE_METHOD:
+			if (stress_set_sigq_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#endif
 #if defined(STRESS_SLEEP)
 		case OPT_SLEEP_MAX:
 			stress_set_sleep_max(optarg);
@@ -3382,41 +5671,142 @@ next_opt:
 			if (stress_set_socket_opts(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+		case OPT_SOCKET_PEER:
+			if (stress_set_sock_peer(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_SOCKET_PORT:
 			stress_set_socket_port(optarg);
 			break;
+		case OPT_SOCKET_ROLE:
+			if (stress_set_net_role(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_SOCKET_TYPE:
 			if (stress_set_socket_type(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+		case OPT_SOCKET_MSG_SIZE:
+			stress_set_socket_msg_size(optarg);
+			break;
+		case OPT_SOCKET_MMSG_BATCH:
+			stress_set_socket_mmsg_batch(optarg);
+			break;
 #if defined(STRESS_SOCKET_FD)
 		case OPT_SOCKET_FD_PORT:
 			stress_set_socket_fd_port(optarg);
 			break;
+		case OPT_SOCKET_FD_BATCH:
+			stress_set_socket_fd_batch(optarg);
+			break;
+		case OPT_SOCKET_FD_SWEEP:
+			stress_set_socket_fd_sweep();
+			break;
 #endif
+		case OPT_SORT_DIST:
+			if (stress_set_sort_dist(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_SORT_METHOD:
+			if (stress_set_sort_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_SORT_SIZE:
+			stress_set_sort_size(optarg);
+			break;
+		case OPT_SORT_THREADS:
+			stress_set_sort_threads(optarg);
+			break;
 #if defined(STRESS_SPLICE)
 		case OPT_SPLICE_BYTES:
 			stress_set_splice_bytes(optarg);
 			break;
+		case OPT_SPLICE_CONSUMERS:
+			stress_set_splice_consumers(optarg);
+			break;
+		case OPT_SPLICE_MODE:
+			if (stress_set_splice_mode(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 #endif
 		case OPT_STACK_FILL:
 			opt_flags |= OPT_FLAGS_STACK_FILL;
 			break;
+		case OPT_STACK_COST:
+			stress_set_stack_cost();
+			break;
 		case OPT_STR_METHOD:
 			if (stress_set_str_method(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+		case OPT_STR_SEARCH:
+			stress_set_str_search();
+			break;
+		case OPT_STR_SEARCH_SIZE:
+			stress_set_str_search_size(optarg);
+			break;
+		case OPT_STREAM_BW:
+			stress_set_stream_bw(optarg);
+			break;
+		case OPT_STREAM_ISA:
+			if (stress_set_stream_isa(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 		case OPT_STREAM_L3_SIZE:
 			stress_set_stream_L3_size(optarg);
 			break;
+		case OPT_STREAM_NUMA:
+			stress_set_stream_numa();
+			break;
+		case OPT_STREAM_THREADS:
+			stress_set_stream_threads(optarg);
+			break;
+#if defined(STRESS_SWAP)
+		case OPT_SWAP_BYTES:
+			stress_set_swap_bytes(optarg);
+			break;
+		case OPT_SWAP_LIMIT:
+			stress_set_swap_limit(optarg);
+			break;
+#endif
 		case OPT_STRESSORS:
 			show_stressors();
 			exit(EXIT_SUCCESS);
+		case OPT_STRESSOR_OFFSET:
+			if (stress_set_stressor_time(optarg, "stressor-offset", true) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_STRESSOR_TIME:
+			if (stress_set_stressor_time(optarg, "stressor-time", false) < 0)
+				exit(EXIT_FAILURE);
+			break;
 #if defined(STRESS_SYNC_FILE)
 		case OPT_SYNC_FILE_BYTES:
 			stress_set_sync_file_bytes(optarg);
 			break;
+		case OPT_SYNC_FILE_WAL:
+			stress_set_sync_file_wal();
+			break;
 #endif
+#if defined(STRESS_SYSFS)
+		case OPT_SYSFS_TOP:
+			stress_set_sysfs_top(optarg);
+			break;
+#endif
+		case OPT_SWITCH_METHOD:
+			if (stress_set_switch_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_SWITCH_PIN:
+			if (stress_set_switch_pin(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_SYNC_START:
+			opt_flags |= OPT_FLAGS_SYNC_START;
+			break;
+		case OPT_SYNC_START_AT:
+			stress_set_sync_start_at(optarg);
+			break;
 		case OPT_SYSLOG:
 			opt_flags |= OPT_FLAGS_SYSLOG;
 			break;
@@ -3428,6 +5818,17 @@ next_opt:
 		case OPT_THRASH:
 			opt_flags |= OPT_FLAGS_THRASH;
 			break;
+		case OPT_THRASH_RECLAIM:
+			stress_set_thrash_reclaim(optarg);
+			break;
+		case OPT_THRASH_RECLAIM_COLD:
+			stress_set_thrash_reclaim_cold();
+			break;
+#endif
+#if defined(STRESS_THREADS)
+		case OPT_THREADS:
+			opt_flags |= OPT_FLAGS_THREADS;
+			break;
 #endif
 		case OPT_TEMP_PATH:
 			if (stress_set_temp_path(optarg) < 0)
@@ -3448,9 +5849,26 @@ next_opt:
 		case OPT_TIMERFD_FREQ:
 			stress_set_timerfd_freq(optarg);
 			break;
+#if defined(STRESS_TLB)
+		case OPT_TLB_PAGES:
+			stress_set_tlb_pages(optarg);
+			break;
+		case OPT_TLB_PAGE_SIZE:
+			if (stress_set_tlb_page_size(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#endif
+#if defined(STRESS_TLB_SHOOTDOWN)
+		case OPT_TLB_SHOOTDOWN_THREADS:
+			stress_set_tlb_shootdown_threads(optarg);
+			break;
+#endif
 		case OPT_TIMERFD_RAND:
 			opt_flags |= OPT_FLAGS_TIMERFD_RAND;
 			break;
+		case OPT_TIMERFD_MASS:
+			stress_set_timerfd_mass(optarg);
+			break;
 #endif
 #if defined(PRCTL_TIMER_SLACK)
 		case OPT_TIMER_SLACK:
@@ -3458,9 +5876,22 @@ next_opt:
 			stress_set_timer_slack_ns(optarg);
 			break;
 #endif
+		case OPT_TIMER_JITTER:
+			opt_flags |= OPT_FLAGS_TIMER_JITTER;
+			break;
+		case OPT_TIMER_JITTER_PRIO:
+			opt_timer_jitter_prio = get_int32(optarg);
+			check_range("timer-jitter-prio", opt_timer_jitter_prio,
+				MIN_TIMER_JITTER_PRIO, MAX_TIMER_JITTER_PRIO);
+			break;
 		case OPT_TIMES:
 			opt_flags |= OPT_FLAGS_TIMES;
 			break;
+#if defined(STRESS_TSC)
+		case OPT_TSC_SKEW:
+			stress_set_tsc_skew();
+			break;
+#endif
 		case OPT_TSEARCH_SIZE:
 			stress_set_tsearch_size(optarg);
 			break;
@@ -3468,6 +5899,11 @@ next_opt:
 		case OPT_THERMAL_ZONES:
 			opt_flags |= OPT_FLAGS_THERMAL_ZONES;
 			break;
+#endif
+#if defined(STRESS_CPUFREQ)
+		case OPT_CPUFREQ:
+			opt_flags |= OPT_FLAGS_CPUFREQ;
+			break;
 #endif
 		case OPT_UDP_DOMAIN:
 			if (stress_set_udp_domain(optarg) < 0)
@@ -3476,6 +5912,15 @@ next_opt:
 		case OPT_UDP_PORT:
 			stress_set_udp_port(optarg);
 			break;
+		case OPT_UDP_BATCH:
+			stress_set_udp_batch(optarg);
+			break;
+		case OPT_UDP_GSO:
+			stress_set_udp_gso(optarg);
+			break;
+		case OPT_UDP_GRO:
+			stress_set_udp_gro();
+			break;
 #if defined(OPT_UDP_LITE)
 		case OPT_UDP_LITE:
 #endif
@@ -3487,14 +5932,52 @@ next_opt:
 				exit(EXIT_FAILURE);
 			break;
 #endif
+#if defined(STRESS_ULOCK)
+		case OPT_ULOCK_CS:
+			stress_set_ulock_cs(optarg);
+			break;
+		case OPT_ULOCK_METHOD:
+			if (stress_set_ulock_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_ULOCK_THREADS:
+			stress_set_ulock_threads(optarg);
+			break;
+#endif
+#if defined(STRESS_UNSHARE)
+		case OPT_UNSHARE_CONTAINER:
+			stress_set_unshare_container(optarg);
+			break;
+#endif
 #if defined(STRESS_USERFAULTFD)
 		case OPT_USERFAULTFD_BYTES:
 			stress_set_userfaultfd_bytes(optarg);
 			break;
+#if defined(HAVE_LIB_PTHREAD)
+		case OPT_USERFAULTFD_FAULTERS:
+			stress_set_userfaultfd_faulters(optarg);
+			break;
+		case OPT_USERFAULTFD_HANDLERS:
+			stress_set_userfaultfd_handlers(optarg);
+			break;
+		case OPT_USERFAULTFD_MODE:
+			if (stress_set_userfaultfd_mode(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_USERFAULTFD_PREFAULT:
+			stress_set_userfaultfd_prefault(optarg);
+			break;
+#endif
 #endif
 		case OPT_UTIME_FSYNC:
 			opt_flags |= OPT_FLAGS_UTIME_FSYNC;
 			break;
+#if defined(STRESS_VECMATH)
+		case OPT_VECMATH_METHOD:
+			if (stress_set_vecmath_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+#endif
 		case OPT_VERBOSE:
 			opt_flags |= PR_ALL;
 			break;
@@ -3522,11 +6005,20 @@ next_opt:
 			if (stress_set_vm_method(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+		case OPT_VM_THREADS:
+			stress_set_vm_threads(optarg);
+			break;
+		case OPT_VM_HAMMER_RATE:
+			stress_set_vm_hammer_rate(optarg);
+			break;
 #ifdef MAP_LOCKED
 		case OPT_VM_MMAP_LOCKED:
 			stress_set_vm_flags(MAP_LOCKED);
 			break;
 #endif
+		case OPT_VM_HUGEPAGE:
+			stress_set_vm_hugepage();
+			break;
 #ifdef MAP_POPULATE
 		case OPT_VM_MMAP_POPULATE:
 			stress_set_vm_flags(MAP_POPULATE);
@@ -3536,22 +6028,67 @@ next_opt:
 		case OPT_VM_RW_BYTES:
 			stress_set_vm_rw_bytes(optarg);
 			break;
+		case OPT_VM_RW_SWEEP:
+			stress_set_vm_rw_sweep();
+			break;
 #endif
 #if defined(STRESS_VM_SPLICE)
 		case OPT_VM_SPLICE_BYTES:
 			stress_set_vm_splice_bytes(optarg);
 			break;
+#endif
+#if defined(STRESS_WARMUP)
+		case OPT_WARMUP:
+			stress_set_warmup(optarg);
+			break;
+#endif
+#if defined(STRESS_WAKEUP)
+		case OPT_WAKEUP_METHOD:
+			if (stress_set_wakeup_method(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_WAKEUP_CPUS:
+			if (stress_set_wakeup_cpus(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
 #endif
 		case OPT_WCS_METHOD:
 			if (stress_set_wcs_method(optarg) < 0)
 				exit(EXIT_FAILURE);
 			break;
+#if defined(STRESS_XATTR)
+		case OPT_XATTR_SWEEP:
+			stress_set_xattr_sweep();
+			break;
+#endif
 		case OPT_YAML:
 			yamlfile = optarg;
 			break;
+#if defined(STRESS_ZLIB)
+		case OPT_ZLIB_BLOCK_SIZE:
+			stress_set_zlib_block_size(optarg);
+			break;
+		case OPT_ZLIB_ENGINE:
+			if (stress_set_zlib_engine(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_ZLIB_LEVEL:
+			stress_set_zlib_level(optarg);
+			break;
+		case OPT_ZLIB_RAND_DATA:
+			if (stress_set_zlib_rand_data(optarg) < 0)
+				exit(EXIT_FAILURE);
+			break;
+		case OPT_ZLIB_THREADS:
+			stress_set_zlib_threads(optarg);
+			break;
+#endif
 		case OPT_ZOMBIE_MAX:
 			stress_set_zombie_max(optarg);
 			break;
+		case OPT_ZOMBIE_REAP:
+			stress_set_zombie_reap();
+			break;
 		default:
 			printf("Unknown option (%d)\n",c);
 			exit(EXIT_FAILURE);
@@ -3592,7 +6129,16 @@ next_opt:
 #if defined(STRESS_PERF_STATS)
 	if (opt_flags & OPT_FLAGS_PERF_STATS)
 		perf_init();
-#endif
+	if (opt_flags & OPT_FLAGS_PROFILE)
+		perf_profile_init(stressors, procs);
+#endif
+	stress_numa_place_init();
+	stress_pin_init();
+	stress_cgroup_init();
+	stress_resctrl_init();
+	stress_energy_init();
+	stress_psi_init();
+	stress_migrate_init();
 	stress_process_dumpable(false);
 	stress_cwd_readwriteable();
 	set_oom_adjustment("main", false);
@@ -3612,6 +6158,44 @@ next_opt:
 			exit(EXIT_FAILURE);
 	}
 
+	if (stress_compare_init() < 0) {
+		free_procs();
+		exit(EXIT_FAILURE);
+	}
+	if (stress_ramp_enabled()) {
+		if (opt_flags & (OPT_FLAGS_SEQUENTIAL | OPT_FLAGS_ALL)) {
+			pr_err(stderr, "ramp options cannot be used with the sequential or all options\n");
+			free_procs();
+			exit(EXIT_FAILURE);
+		}
+		/* Sizes the instances to the largest step */
+		if (stress_ramp_init(stressors, procs) < 0) {
+			stress_ramp_free();
+			free_procs();
+			exit(EXIT_FAILURE);
+		}
+	}
+	if ((stress_repeat_trials() > 1) &&
+	    (stress_ramp_enabled() || stress_smt_enabled())) {
+		pr_err(stderr, "repeat option cannot be used with the ramp or smt options\n");
+		free_procs();
+		exit(EXIT_FAILURE);
+	}
+	if (stress_smt_enabled()) {
+		if ((opt_flags & (OPT_FLAGS_SEQUENTIAL | OPT_FLAGS_ALL)) ||
+		    stress_ramp_enabled()) {
+			pr_err(stderr, "smt options cannot be used with the sequential, all or ramp options\n");
+			free_procs();
+			exit(EXIT_FAILURE);
+		}
+		/* Sizes each stressor to the two instances of a pair */
+		if (stress_smt_init(stressors, procs) < 0) {
+			stress_smt_free();
+			free_procs();
+			exit(EXIT_FAILURE);
+		}
+	}
+
 	for (i = 0; i < STRESS_MAX; i++)
 		total_procs += procs[i].num_procs;
 
@@ -3636,7 +6220,6 @@ next_opt:
 				exit(EXIT_FAILURE);
 			}
 		}
-		max_procs = opt_sequential;
 	} else if (opt_flags & OPT_FLAGS_ALL) {
 		if (total_procs) {
 			pr_err(stderr, "the all option cannot be specified with other stressors enabled\n");
@@ -3654,8 +6237,6 @@ next_opt:
 					((stressors[i].class & opt_class) ?
 						opt_all : 0) : opt_all;
 			total_procs += procs[i].num_procs;
-			if (max_procs < procs[i].num_procs)
-				max_procs = procs[i].num_procs;
 			if (procs[i].num_procs) {
 				procs[i].pids = calloc(procs[i].num_procs, sizeof(pid_t));
 				if (!procs[i].pids) {
@@ -3682,8 +6263,6 @@ next_opt:
 				procs[i].bogo_ops / procs[i].num_procs : 0;
 			procs[i].pids = NULL;
 
-			if (max_procs < procs[i].num_procs)
-				max_procs = procs[i].num_procs;
 			if (procs[i].num_procs) {
 				procs[i].pids = calloc(procs[i].num_procs, sizeof(pid_t));
 				if (!procs[i].pids) {
@@ -3695,14 +6274,40 @@ next_opt:
 		}
 	}
 
+#if defined(STRESS_WARMUP)
+	if (opt_warmup >= opt_timeout) {
+		pr_err(stderr, "warmup time must be less than the timeout\n");
+		free_procs();
+		exit(EXIT_FAILURE);
+	}
+#endif
+#if defined(STRESS_THREADS)
+	if (opt_flags & OPT_FLAGS_THREADS) {
+		/* The warm-up and perf sampling helpers are one per process */
+		if (opt_warmup || (opt_flags & (OPT_FLAGS_PERF_CONTENTION | OPT_FLAGS_PROFILE)) ||
+		    ((opt_flags & OPT_FLAGS_PERF_STATS) && (opt_flags & OPT_FLAGS_SAMPLE))) {
+			pr_err(stderr, "threads option cannot be used with the warmup, "
+				"perf-contention, profile or perf sampling options\n");
+			free_procs();
+			exit(EXIT_FAILURE);
+		}
+		for (i = 0; i < STRESS_MAX; i++) {
+			if (procs[i].num_procs && !stressors[i].thread_safe)
+				pr_inf(stdout, "threads: %s is not thread safe, running "
+					"its instances as processes\n",
+					munge_underscore(stressors[i].name));
+		}
+	}
+#endif
 	set_proc_limits();
 
 	if (show_hogs(opt_class) < 0) {
 		free_procs();
 		exit(EXIT_FAILURE);
 	}
-	len = sizeof(shared_t) + (sizeof(proc_stats_t) * STRESS_MAX * max_procs);
-	stress_map_shared(len);
+	stress_map_shared(stress_stats_layout(opt_class));
+	time_calibrate();
+	stress_irq_init(shared->stats_slots);
 #if defined(STRESS_PERF_STATS)
 	pthread_spin_init(&shared->perf.lock, 0);
 #endif
@@ -3725,6 +6330,10 @@ next_opt:
 	if (opt_flags & OPT_FLAGS_THERMAL_ZONES)
 		tz_init(&shared->tz_info);
 #endif
+#if defined(STRESS_CPUFREQ)
+	if (opt_flags & OPT_FLAGS_CPUFREQ)
+		cpufreq_init();
+#endif
 
 	proc_helper(proc_init, SIZEOF_ARRAY(proc_init));
 	if (opt_flags & OPT_FLAGS_THRASH)
@@ -3736,6 +6345,7 @@ next_opt:
 		 */
 		for (i = 0; opt_do_run && i < STRESS_MAX; i++) {
 			int32_t j;
+			uint32_t trial;
 
 			for (j = 0; opt_do_run && j < STRESS_MAX; j++)
 				procs[j].num_procs = 0;
@@ -3743,19 +6353,60 @@ next_opt:
 				procs[i].num_procs = opt_class ?
 					((stressors[i].class & opt_class) ?
 						opt_sequential : 0) : opt_sequential;
-				if (procs[i].num_procs)
-					stress_run(opt_sequential, opt_sequential,
-						opt_backoff, opt_ionice_class, opt_ionice_level,
+				for (trial = 0; procs[i].num_procs && opt_do_run &&
+				     (trial < stress_repeat_trials()); trial++) {
+					stress_repeat_trial(trial, procs);
+					stress_run(opt_sequential, opt_backoff, opt_ionice_class, opt_ionice_level,
 						shared->stats, &duration, &success, &resource_success);
+					stress_repeat_record(procs);
+				}
 			}
 		}
+	} else if (stress_ramp_enabled()) {
+		/*
+		 *  Step through the ramp, restarting the stressors
+		 *  with the instances of each step
+		 */
+		uint32_t step;
+
+		for (step = 0; opt_do_run && (int)step < stress_ramp_steps(); step++) {
+			const int32_t n = stress_ramp_step(step, procs);
+
+			if (!n) {
+				/* An idle step */
+				(void)sleep((unsigned int)opt_timeout);
+				continue;
+			}
+			stress_run(n, opt_backoff, opt_ionice_class, opt_ionice_level,
+				shared->stats, &duration, &success, &resource_success);
+			stress_ramp_record(step, stressors, procs);
+		}
+	} else if (stress_smt_enabled()) {
+		/*
+		 *  Run each stressor alone and then paired with each
+		 *  stressor on the SMT sibling CPU
+		 */
+		uint32_t step;
+
+		for (step = 0; opt_do_run && (int)step < stress_smt_steps(); step++) {
+			const int32_t n = stress_smt_step(step, stressors, procs);
+
+			stress_run(n, opt_backoff, opt_ionice_class, opt_ionice_level,
+				shared->stats, &duration, &success, &resource_success);
+			stress_smt_record(step, procs);
+		}
 	} else {
 		/*
 		 *  Run all stressors in parallel
 		 */
-		stress_run(total_procs, max_procs,
-			opt_backoff, opt_ionice_class, opt_ionice_level,
-			shared->stats, &duration, &success, &resource_success);
+		uint32_t trial;
+
+		for (trial = 0; opt_do_run && (trial < stress_repeat_trials()); trial++) {
+			stress_repeat_trial(trial, procs);
+			stress_run(total_procs, opt_backoff, opt_ionice_class, opt_ionice_level,
+				shared->stats, &duration, &success, &resource_success);
+			stress_repeat_record(procs);
+		}
 	}
 
 	if (opt_flags & OPT_FLAGS_THRASH)
@@ -3765,27 +6416,78 @@ next_opt:
 		success ? "successful" : "unsuccessful",
 		duration, duration_to_str(duration));
 	if (yamlfile) {
-		yaml = fopen(yamlfile, "w");
+		/* --compare reads back the results of the run */
+		yaml = fopen(yamlfile, stress_compare_enabled() ? "w+" : "w");
 		if (!yaml)
 			pr_err(stdout, "Cannot output YAML data to %s\n", yamlfile);
-
+	} else if (stress_compare_enabled()) {
+		yaml = tmpfile();
+		if (!yaml)
+			pr_err(stdout, "Cannot create a temporary file for the "
+				"results to compare\n");
+	}
+	if (yaml) {
 		pr_yaml(yaml, "---\n");
 		pr_yaml_runinfo(yaml);
 	}
+	if (jsonfile) {
+		json = json_open(jsonfile);
+		if (!json)
+			pr_err(stdout, "Cannot output JSON data to %s\n", jsonfile);
+
+		json_runinfo(json);
+	}
+	stress_pin_dump(yaml, json, stressors, procs);
+	stress_migrate_dump(yaml, json, duration);
+	stress_cacheline_matrix_dump(yaml, json);
+	stress_ramp_dump(yaml, json, stressors);
+	stress_smt_dump(yaml, json, stressors);
 	if (opt_flags & OPT_FLAGS_METRICS)
-		metrics_dump(yaml, max_procs, ticks_per_sec);
+		metrics_dump(yaml, json, ticks_per_sec);
+	stress_repeat_dump(yaml, json, stressors);
+	stress_cgroup_dump(yaml, json, stressors, procs);
+	stress_resctrl_dump(yaml, json, stressors, procs);
+	stress_psi_dump(yaml, json, stressors, procs);
+	stress_irq_dump(yaml, json, stressors, procs);
+#if defined(STRESS_SAMPLE)
+	if (opt_flags & OPT_FLAGS_SAMPLE) {
+		sample_dump(yaml, json, stressors);
+		sample_free();
+	}
+#endif
+#if defined(STRESS_LATENCY)
+	if (opt_flags & OPT_FLAGS_LATENCY)
+		latency_dump(yaml, json, stressors, procs);
+#endif
 #if defined(STRESS_PERF_STATS)
 	if (opt_flags & OPT_FLAGS_PERF_STATS)
-		perf_stat_dump(yaml, stressors, procs, max_procs, duration);
+		perf_stat_dump(yaml, json, stressors, procs, duration);
+	if (opt_flags & OPT_FLAGS_PERF_CONTENTION)
+		perf_contention_dump(yaml, json, stressors, procs, duration);
+	if (opt_flags & OPT_FLAGS_PROFILE)
+		perf_profile_dump(yaml, json, stressors, procs);
 #endif
 #if defined(STRESS_THERMAL_ZONES)
 	if (opt_flags & OPT_FLAGS_THERMAL_ZONES) {
-		tz_dump(yaml, stressors, procs, max_procs);
+		tz_dump(yaml, json, stressors, procs);
 		tz_free(&shared->tz_info);
 	}
 #endif
+#if defined(STRESS_CPUFREQ)
+	if (opt_flags & OPT_FLAGS_CPUFREQ)
+		cpufreq_dump(yaml, json, stressors, procs);
+#endif
+	if (opt_flags & OPT_FLAGS_IGNITE_CPU)
+		ignite_cpu_dump(yaml, json, stressors);
 	if (opt_flags & OPT_FLAGS_TIMES)
-		times_dump(yaml, ticks_per_sec, duration);
+		times_dump(yaml, json, ticks_per_sec, duration);
+	stress_ramp_free();
+	stress_smt_free();
+	stress_repeat_free();
+	stress_cgroup_free();
+	stress_resctrl_free();
+	stress_irq_free();
+	stress_energy_free();
 	free_procs();
 
 	proc_helper(proc_destroy, SIZEOF_ARRAY(proc_destroy));
@@ -3793,12 +6495,17 @@ next_opt:
 	closelog();
 	if (yaml) {
 		pr_yaml(yaml, "...\n");
+		regressions = stress_compare(yaml);
 		fclose(yaml);
 	}
+	json_close(json);
+	stress_compare_free();
 
 	if (!success)
 		exit(EXIT_NOT_SUCCESS);
 	if (!resource_success)
 		exit(EXIT_NO_RESOURCE);
+	if (regressions)
+		exit(EXIT_REGRESSION);
 	exit(EXIT_SUCCESS);
 }
@@ -40,6 +40,7 @@
 #include <signal.h>
 #include <sys/time.h>
 #include <sys/times.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
@@ -50,6 +51,7 @@
 #include <sys/syscall.h>
 #include <sys/quota.h>
 #include <sys/prctl.h>
+#include <sched.h>
 #include <netinet/in.h>
 #include <linux/fs.h>
 #include <linux/fiemap.h>
@@ -76,6 +78,7 @@ typedef unsigned long int __kernel_ulong_t;
 
 #define EXIT_NOT_SUCCESS	(2)
 #define EXIT_NO_RESOURCE	(3)
+#define EXIT_REGRESSION		(4)
 
 /*
  * STRESS_ASSERT(test)
@@ -186,6 +189,18 @@ typedef unsigned long int __kernel_ulong_t;
 #define OPT_FLAGS_PATHOLOGICAL	0x1000000000000ULL	/* --pathological */
 #define OPT_FLAGS_NO_RAND_SEED	0x2000000000000ULL	/* --no-rand-seed */
 #define OPT_FLAGS_THRASH	0x4000000000000ULL	/* --thrash */
+#define OPT_FLAGS_SAMPLE	0x8000000000000ULL	/* --sample */
+#define OPT_FLAGS_LATENCY	0x10000000000000ULL	/* --latency */
+#define OPT_FLAGS_SYNC_START	0x20000000000000ULL	/* --sync-start */
+#define OPT_FLAGS_PERF_CONTENTION 0x80000000000000ULL	/* --perf-contention */
+#define OPT_FLAGS_TIMER_JITTER	0x100000000000000ULL	/* --timer-jitter */
+#define OPT_FLAGS_CPUFREQ	0x200000000000000ULL	/* --cpufreq */
+#define OPT_FLAGS_ENERGY	0x400000000000000ULL	/* --energy */
+#define OPT_FLAGS_THREADS	0x800000000000000ULL	/* --threads */
+#define OPT_FLAGS_LOG_ASYNC	0x1000000000000000ULL	/* --log-async */
+#define OPT_FLAGS_PSI		0x2000000000000000ULL	/* --psi */
+#define OPT_FLAGS_PAGE_RESIDENCY 0x4000000000000000ULL	/* --page-residency */
+#define OPT_FLAGS_PROFILE	0x8000000000000000ULL	/* --profile */
 
 #define OPT_FLAGS_AGGRESSIVE_MASK \
 	(OPT_FLAGS_AFFINITY_RAND | OPT_FLAGS_UTIME_FSYNC | \
@@ -204,6 +219,7 @@ typedef unsigned long int __kernel_ulong_t;
 #define WARN_ONCE_CACHE_WAY	0x00000008	/* cache way too high */
 #define WARN_ONCE_CACHE_SIZE	0x00000010	/* cache size info */
 #define WARN_ONCE_CACHE_REDUCED	0x00000020	/* reduced cache */
+#define WARN_ONCE_CGROUP	0x00000040	/* cgroup limit not set */
 
 
 /* Stressor classes */
@@ -239,8 +255,27 @@ extern int pr_msg(FILE *fp, const uint64_t flag,
 extern void pr_msg_fail(const uint64_t flag, const char *name, const char *what, const int err);
 extern int pr_yaml(FILE *fp, const char *const fmt, ...) __attribute__((format(printf, 2, 3)));
 extern void pr_yaml_runinfo(FILE *fp);
+extern const char *stress_target_clone(void);
 extern void pr_openlog(const char *filename);
 
+/* JSON output helpers, all are no-ops on a NULL json handle */
+#define JSON_DEPTH_MAX		(16)
+
+typedef struct json json_t;
+
+extern json_t *json_open(const char *filename);
+extern void json_close(json_t *json);
+extern void json_obj_begin(json_t *json, const char *key);
+extern void json_obj_end(json_t *json);
+extern void json_array_begin(json_t *json, const char *key);
+extern void json_array_end(json_t *json);
+extern void json_str(json_t *json, const char *key, const char *val);
+extern void json_int(json_t *json, const char *key, const int64_t val);
+extern void json_uint(json_t *json, const char *key, const uint64_t val);
+extern void json_double(json_t *json, const char *key, const double val);
+extern void json_bool(json_t *json, const char *key, const bool val);
+extern void json_runinfo(json_t *json);
+
 #define pr_dbg(fp, fmt, args...)	pr_msg(fp, PR_DEBUG, fmt, ## args)
 #define pr_inf(fp, fmt, args...)	pr_msg(fp, PR_INFO, fmt, ## args)
 #define pr_err(fp, fmt, args...)	pr_msg(fp, PR_ERROR, fmt, ## args)
@@ -272,6 +307,22 @@ extern void pr_openlog(const char *filename);
 #define MAX_AIO_LINUX_REQUESTS	(4096)
 #define DEFAULT_AIO_LINUX_REQUESTS	(64)
 
+#define MIN_AIO_LINUX_MIN_NR	(0)
+#define MAX_AIO_LINUX_MIN_NR	(256)
+#define DEFAULT_AIO_LINUX_MIN_NR	(1)
+
+#define MIN_ARENA_SIZE		(8)
+#define MAX_ARENA_SIZE		(1 * MB)
+#define DEFAULT_ARENA_SIZE	(64)
+
+#define MIN_ARENA_OBJECTS	(1)
+#define MAX_ARENA_OBJECTS	(65536)
+#define DEFAULT_ARENA_OBJECTS	(64)
+
+#define MIN_ARENA_THREADS	(1)
+#define MAX_ARENA_THREADS	(64)
+#define DEFAULT_ARENA_THREADS	(1)
+
 #define MIN_BIGHEAP_GROWTH	(4 * KB)
 #define MAX_BIGHEAP_GROWTH	(64 * MB)
 #define DEFAULT_BIGHEAP_GROWTH	(64 * KB)
@@ -284,11 +335,41 @@ extern void pr_openlog(const char *filename);
 #define MAX_CLONES		(1000000)
 #define DEFAULT_CLONES		(8192)
 
+#define MIN_COMPACT_BYTES	(8 * MB)
+#if UINTPTR_MAX == MAX_32
+#define MAX_COMPACT_BYTES	(MAX_32)
+#else
+#define MAX_COMPACT_BYTES	(256 * GB)
+#endif
+#define DEFAULT_COMPACT_BYTES	(256 * MB)
+
+#define MIN_COMPACT_KEEP	(1)
+#define MAX_COMPACT_KEEP	(99)
+#define DEFAULT_COMPACT_KEEP	(6)
+
+#define MIN_COMPACT_PIN		(0)
+#define MAX_COMPACT_PIN		(100)
+#define DEFAULT_COMPACT_PIN	(10)
+
 #define MIN_COPY_FILE_BYTES	(128 * MB)
 #define MAX_COPY_FILE_BYTES	(256ULL * GB)
 #define DEFAULT_COPY_FILE_BYTES	(256 * MB)
 #define DEFAULT_COPY_FILE_SIZE  (2 * MB)
 
+#define MIN_AF_PACKET_PORT	(1024)
+#define MAX_AF_PACKET_PORT	(65535)
+#define DEFAULT_AF_PACKET_PORT	(12000)
+
+#define MIN_AF_PACKET_SIZE	(16)
+#define MAX_AF_PACKET_SIZE	(1472)
+#define DEFAULT_AF_PACKET_SIZE	(64)
+
+#define MIN_CRYPT_ROUNDS	(0)
+#define MAX_CRYPT_ROUNDS	(999999999)
+
+#define MIN_DSP_SIZE		(8)
+#define MAX_DSP_SIZE		(16 * MB)
+
 #define MIN_DENTRIES		(1)
 #define MAX_DENTRIES		(1000000)
 #define DEFAULT_DENTRIES	(2048)
@@ -297,6 +378,72 @@ extern void pr_openlog(const char *filename);
 #define MAX_EPOLL_PORT		(65535)
 #define DEFAULT_EPOLL_PORT	(6000)
 
+#define MIN_INOTIFY_WRITERS	(1)
+#define MAX_INOTIFY_WRITERS	(512)
+
+#define MIN_IO_URING_NET_PORT	(1024)
+#define MAX_IO_URING_NET_PORT	(65535)
+#define DEFAULT_IO_URING_NET_PORT (11000)
+
+#define MIN_IO_URING_NET_CONNS	(1)
+#define MAX_IO_URING_NET_CONNS	(256)
+#define DEFAULT_IO_URING_NET_CONNS (16)
+
+#define MIN_IO_URING_NET_SIZE	(1)
+#define MAX_IO_URING_NET_SIZE	(4 * KB)
+#define DEFAULT_IO_URING_NET_SIZE (64)
+
+#define MIN_IOCMP_BS		(512)
+#define MAX_IOCMP_BS		(1 * MB)
+#define DEFAULT_IOCMP_BS	(4 * KB)
+
+#define MIN_IOCMP_QD		(1)
+#define MAX_IOCMP_QD		(256)
+#define DEFAULT_IOCMP_QD	(16)
+
+#define DEFAULT_IOCMP_READ_PCT	(50)
+
+#define MIN_IOCMP_SIZE		(1 * MB)
+#define MAX_IOCMP_SIZE		(64ULL * GB)
+#define DEFAULT_IOCMP_SIZE	(256 * MB)
+
+#define MIN_RMAP_SHARERS	(1)
+#define MAX_RMAP_SHARERS	(4096)
+#define DEFAULT_RMAP_SHARERS	(16)
+
+#define MIN_POLL_SCALE		(10)
+#define MAX_POLL_SCALE		(100000)
+
+#define MIN_EPOLL_CONNS		(1)
+#define MAX_EPOLL_CONNS		(65536)
+
+#define MIN_EPOLL_THREADS	(1)
+#define MAX_EPOLL_THREADS	(64)
+#define DEFAULT_EPOLL_THREADS	(4)
+
+#define MIN_FRONTEND_SIZE	(4 * KB)
+#define MAX_FRONTEND_SIZE	(64 * MB)
+
+#define MIN_FRONTEND_ENTROPY	(0)
+#define MAX_FRONTEND_ENTROPY	(100)
+#define DEFAULT_FRONTEND_ENTROPY (10)
+
+#define MIN_HASHMAP_KEYS	(1 * KB)
+#define MAX_HASHMAP_KEYS	(16 * MB)
+#define DEFAULT_HASHMAP_KEYS	(64 * KB)
+
+#define MIN_HASHMAP_READS	(0)
+#define MAX_HASHMAP_READS	(100)
+#define DEFAULT_HASHMAP_READS	(90)
+
+#define MIN_HASHMAP_THREADS	(1)
+#define MAX_HASHMAP_THREADS	(64)
+#define DEFAULT_HASHMAP_THREADS	(4)
+
+#define MIN_HASHMAP_ZIPF	(0)
+#define MAX_HASHMAP_ZIPF	(99)
+#define DEFAULT_HASHMAP_ZIPF	(99)
+
 #define MIN_HDD_BYTES		(1 * MB)
 #define MAX_HDD_BYTES		(256ULL * GB)
 #define DEFAULT_HDD_BYTES	(1 * GB)
@@ -305,6 +452,17 @@ extern void pr_openlog(const char *filename);
 #define MAX_HDD_WRITE_SIZE	(4 * MB)
 #define DEFAULT_HDD_WRITE_SIZE	(64 * 1024)
 
+#define MIN_HDD_QD		(1)
+#define MAX_HDD_QD		(1024)
+#define DEFAULT_HDD_QD		(16)
+
+#define MIN_HDD_RW_MIX		(0)
+#define MAX_HDD_RW_MIX		(100)
+
+#define MIN_HDD_STRIPE		(4 * KB)
+#define MAX_HDD_STRIPE		(1 * GB)
+#define DEFAULT_HDD_STRIPE	(0)	/* not striped */
+
 #define MIN_FALLOCATE_BYTES	(1 * MB)
 #if UINTPTR_MAX == MAX_32
 #define MAX_FALLOCATE_BYTES	(MAX_32)
@@ -313,6 +471,10 @@ extern void pr_openlog(const char *filename);
 #endif
 #define DEFAULT_FALLOCATE_BYTES	(1 * GB)
 
+#define MIN_FALLOCATE_GRAN	(4 * KB)
+#define MAX_FALLOCATE_GRAN	(16 * MB)
+#define DEFAULT_FALLOCATE_GRAN	(64 * KB)
+
 #define MIN_FIEMAP_SIZE		(1 * MB)
 #if UINTPTR_MAX == MAX_32
 #define MAX_FIEMAP_SIZE		(0xffffe00)
@@ -325,14 +487,66 @@ extern void pr_openlog(const char *filename);
 #define MAX_FIFO_READERS	(64)
 #define DEFAULT_FIFO_READERS	(4)
 
+#define MIN_GETDENT_ENTRIES	(10000)
+#define MAX_GETDENT_ENTRIES	(10000000)
+
+#define MIN_FSTAT_PTHREADS	(0)
+#define MAX_FSTAT_PTHREADS	(256)
+#define DEFAULT_FSTAT_PTHREADS	(0)
+
+#define MIN_FLOCK_CONTENDERS	(1)
+#define MAX_FLOCK_CONTENDERS	(64)
+
+#define MIN_FUTEX_WAITERS	(1)
+#define MAX_FUTEX_WAITERS	(1024)
+#define DEFAULT_FUTEX_WAITERS	(8)
+
+#define MIN_LFQUEUE_THREADS	(1)
+#define MAX_LFQUEUE_THREADS	(64)
+#define DEFAULT_LFQUEUE_THREADS	(2)
+
+#define MIN_ULOCK_THREADS	(1)
+#define MAX_ULOCK_THREADS	(1024)
+#define DEFAULT_ULOCK_THREADS	(4)
+
+#define MIN_ULOCK_CS		(0)
+#define MAX_ULOCK_CS		(1000000)
+#define DEFAULT_ULOCK_CS	(100)
+
 #define MIN_ITIMER_FREQ		(1)
 #define MAX_ITIMER_FREQ		(100000000)
 #define DEFAULT_ITIMER_FREQ	(1000000)
 
+#define MIN_KSM_BYTES		(1 * MB)
+#define MAX_KSM_BYTES		(4 * GB)
+#define DEFAULT_KSM_BYTES	(16 * MB)
+
+#define MIN_KSM_DUP		(0)
+#define MAX_KSM_DUP		(100)
+#define DEFAULT_KSM_DUP		(50)
+
 #define MIN_MQ_SIZE		(1)
 #define MAX_MQ_SIZE		(32)
 #define DEFAULT_MQ_SIZE		(10)
 
+#define MIN_MQ_PROCS		(1)
+#define MAX_MQ_PROCS		(64)
+#define DEFAULT_MQ_PROCS	(1)
+
+#define MIN_NUMA_BYTES		(1 * MB)
+#if UINTPTR_MAX == MAX_32
+#define MAX_NUMA_BYTES		(MAX_32)
+#else
+#define MAX_NUMA_BYTES		(256 * GB)
+#endif
+#define DEFAULT_NUMA_BYTES	(64 * MB)
+
+#define MIN_UNSHARE_CONTAINER	(1)
+#define MAX_UNSHARE_CONTAINER	(32)
+
+#define MIN_SECCOMP_RULES	(1)
+#define MAX_SECCOMP_RULES	(1000)
+
 #define MIN_SEMAPHORE_PROCS	(2)
 #define MAX_SEMAPHORE_PROCS	(64)
 #define DEFAULT_SEMAPHORE_PROCS	(2)
@@ -345,6 +559,29 @@ extern void pr_openlog(const char *filename);
 #define MAX_FORKS		(16000)
 #define DEFAULT_FORKS		(1)
 
+#define MIN_FORKHEAP_BYTES	(4 * MB)
+#if UINTPTR_MAX == MAX_32
+#define MAX_FORKHEAP_BYTES	(MAX_32)
+#else
+#define MAX_FORKHEAP_BYTES	(256 * GB)
+#endif
+#define DEFAULT_FORKHEAP_BYTES	(256 * MB)
+
+#define MIN_FORKHEAP_VMAS	(1)
+#define MAX_FORKHEAP_VMAS	(65536)
+#define DEFAULT_FORKHEAP_VMAS	(1)
+
+#define MIN_FORKHEAP_COW	(0)
+#define MAX_FORKHEAP_COW	(100)
+#define DEFAULT_FORKHEAP_COW	(10)
+
+#define MIN_FORK_RSS		(0)
+#if UINTPTR_MAX == MAX_32
+#define MAX_FORK_RSS		(MAX_32)
+#else
+#define MAX_FORK_RSS		(256 * GB)
+#endif
+
 #define MIN_HEAPSORT_SIZE	(1 * KB)
 #define MAX_HEAPSORT_SIZE	(4 * MB)
 #define DEFAULT_HEAPSORT_SIZE	(256 * KB)
@@ -357,6 +594,10 @@ extern void pr_openlog(const char *filename);
 #define MAX_HSEARCH_SIZE	(4 * MB)
 #define DEFAULT_HSEARCH_SIZE	(8 * KB)
 
+#define MIN_KEY_MAX		(16)
+#define MAX_KEY_MAX		(1000000)
+#define DEFAULT_KEY_MAX		(4096)
+
 #define MIN_LEASE_BREAKERS	(1)
 #define MAX_LEASE_BREAKERS	(64)
 #define DEFAULT_LEASE_BREAKERS	(1)
@@ -381,10 +622,26 @@ extern void pr_openlog(const char *filename);
 #define MAX_MALLOC_THRESHOLD	(256 * MB)
 #define DEFAULT_MALLOC_THRESHOLD (128 * KB)
 
+#define MIN_MALLOC_PTHREADS	(0)
+#define MAX_MALLOC_PTHREADS	(256)
+#define DEFAULT_MALLOC_PTHREADS	(0)
+
+#define MIN_MALLOC_XFREE	(0)
+#define MAX_MALLOC_XFREE	(100)
+#define DEFAULT_MALLOC_XFREE	(25)
+
 #define MIN_MATRIX_SIZE		(16)
 #define MAX_MATRIX_SIZE		(4096)
 #define DEFAULT_MATRIX_SIZE	(256)
 
+#define MIN_MATRIX_THREADS	(1)
+#define MAX_MATRIX_THREADS	(1024)
+#define DEFAULT_MATRIX_THREADS	(1)
+
+#define MIN_MEMBARRIER_READERS	(1)
+#define MAX_MEMBARRIER_READERS	(1024)
+#define DEFAULT_MEMBARRIER_READERS (4)
+
 #define MIN_MEMFD_BYTES		(2 * MB)
 #if UINTPTR_MAX == MAX_32
 #define MAX_MEMFD_BYTES		(MAX_32)
@@ -393,6 +650,14 @@ extern void pr_openlog(const char *filename);
 #endif
 #define DEFAULT_MEMFD_BYTES	(256 * MB)
 
+#define MIN_MEMFD_CONSUMERS	(1)
+#define MAX_MEMFD_CONSUMERS	(64)
+#define DEFAULT_MEMFD_CONSUMERS	(1)
+
+
+#define MIN_METADATA_FILES	(1)
+#define MAX_METADATA_FILES	(1 * MB)
+#define DEFAULT_METADATA_FILES	(1024)
 
 #define MIN_MERGESORT_SIZE	(1 * KB)
 #define MAX_MERGESORT_SIZE	(4 * MB)
@@ -406,6 +671,10 @@ extern void pr_openlog(const char *filename);
 #endif
 #define DEFAULT_MMAP_BYTES	(256 * MB)
 
+#define MIN_MMAPLOCK_THREADS	(1)
+#define MAX_MMAPLOCK_THREADS	(1024)
+#define DEFAULT_MMAPLOCK_THREADS (8)
+
 #define MIN_MREMAP_BYTES	(4 * KB)
 #if UINTPTR_MAX == MAX_32
 #define MAX_MREMAP_BYTES	(MAX_32)
@@ -422,9 +691,16 @@ extern void pr_openlog(const char *filename);
 #endif
 #define DEFAULT_MSYNC_BYTES	(256 * MB)
 
+#define MIN_PROCFS_TOP		(1)
+#define MAX_PROCFS_TOP		(1000)
+
 #define MIN_PTHREAD		(1)
 #define MAX_PTHREAD		(30000)
 #define DEFAULT_PTHREAD		(1024)
+#define MAX_PTHREAD_POOL	(1024)
+
+#define MIN_PTHREAD_STACK	(64 * KB)
+#define MAX_PTHREAD_STACK	(64 * MB)
 
 #define MIN_QSORT_SIZE		(1 * KB)
 #define MAX_QSORT_SIZE		(4 * MB)
@@ -434,10 +710,49 @@ extern void pr_openlog(const char *filename);
 #define MAX_READAHEAD_BYTES	(256ULL * GB)
 #define DEFAULT_READAHEAD_BYTES	(1 * GB)
 
+#define MIN_COMPARE_THRESHOLD	(1)		/* percent */
+#define MAX_COMPARE_THRESHOLD	(100)
+#define DEFAULT_COMPARE_THRESHOLD (5)
+
+#define MIN_REPEAT		(1)
+#define MAX_REPEAT		(1000)
+
+#define MIN_SAMPLE_INTERVAL	(1)		/* milliseconds */
+#define MAX_SAMPLE_INTERVAL	(3600000)
+#define DEFAULT_SAMPLE_INTERVAL	(1000)
+
+#define MIN_CONVERGE		(1)		/* percent */
+#define MAX_CONVERGE		(100)
+#define MIN_CONVERGE_WINDOWS	(1)		/* sample intervals */
+#define MAX_CONVERGE_WINDOWS	(1000)
+#define DEFAULT_CONVERGE_WINDOWS (5)
+
+#define MIN_CGROUP_MEMORY_MAX	(4 * MB)
+#define MAX_CGROUP_MEMORY_MAX	(1024 * GB)
+
+#define MIN_LATENCY		(1)		/* sample every Nth op */
+#define MAX_LATENCY		(1000000)
+#define DEFAULT_LATENCY		(100)
+
+#define MIN_SCHEDLAT_MESSENGERS	(1)
+#define MAX_SCHEDLAT_MESSENGERS	(64)
+#define DEFAULT_SCHEDLAT_MESSENGERS (2)
+
+#define MIN_SCHEDLAT_THINK	(0)		/* usecs of work per wakeup */
+#define MAX_SCHEDLAT_THINK	(100000)
+#define DEFAULT_SCHEDLAT_THINK	(100)
+
 #define MIN_SCTP_PORT		(1024)
 #define MAX_SCTP_PORT		(65535)
 #define DEFAULT_SCTP_PORT	(9000)
 
+#define MIN_PTY_MAX		(1)
+#define MAX_PTY_MAX		(4096)
+#define DEFAULT_PTY_MAX		(64)
+
+#define MIN_SCTP_STREAMS	(1)
+#define MAX_SCTP_STREAMS	(1024)
+
 #define MIN_SENDFILE_SIZE	(1 * KB)
 #define MAX_SENDFILE_SIZE	(1 * GB)
 #define DEFAULT_SENDFILE_SIZE	(4 * MB)
@@ -480,14 +795,39 @@ extern void pr_openlog(const char *filename);
 #define MAX_SOCKET_PORT		(65535)
 #define DEFAULT_SOCKET_PORT	(5000)
 
+#define MIN_SOCKET_MSG_SIZE	(1)
+#define MAX_SOCKET_MSG_SIZE	(64 * KB)
+
+#define MIN_SOCKET_MMSG_BATCH	(1)
+#define MAX_SOCKET_MMSG_BATCH	(1024)
+#define DEFAULT_SOCKET_MMSG_BATCH (4)
+
 #define MIN_SOCKET_FD_PORT	(1024)
 #define MAX_SOCKET_FD_PORT	(65535)
 #define DEFAULT_SOCKET_FD_PORT	(8000)
 
+#define MIN_SOCKET_FD_BATCH	(1)
+#define MAX_SOCKET_FD_BATCH	(253)	/* kernel SCM_MAX_FD */
+
+#define MIN_SORT_SIZE		(1 * KB)
+#define MAX_SORT_SIZE		(64 * MB)
+#define DEFAULT_SORT_SIZE	(1 * MB)
+
+#define MIN_SORT_THREADS	(1)
+#define MAX_SORT_THREADS	(64)
+#define DEFAULT_SORT_THREADS	(4)
+
 #define MIN_SPLICE_BYTES	(1*KB)
 #define MAX_SPLICE_BYTES	(64*MB)
 #define DEFAULT_SPLICE_BYTES	(64*KB)
 
+#define MIN_SPLICE_CONSUMERS	(1)
+#define MAX_SPLICE_CONSUMERS	(16)
+#define DEFAULT_SPLICE_CONSUMERS (1)
+
+#define MIN_STR_SEARCH_SIZE	(4 * KB)
+#define MAX_STR_SEARCH_SIZE	(16 * MB)
+
 #define MIN_STREAM_L3_SIZE	(4 * KB)
 #if UINTPTR_MAX == MAX_32
 #define MAX_STREAM_L3_SIZE	(MAX_32)
@@ -496,6 +836,22 @@ extern void pr_openlog(const char *filename);
 #endif
 #define DEFAULT_STREAM_L3_SIZE	(4 * MB)
 
+#if UINTPTR_MAX == MAX_32
+#define MAX_MEMCPY_SWEEP_SIZE	(64 * MB)
+#else
+#define MAX_MEMCPY_SWEEP_SIZE	(1 * GB)
+#endif
+
+#define MIN_STREAM_THREADS	(1)
+#define MAX_STREAM_THREADS	(1024)
+#define DEFAULT_STREAM_THREADS	(1)
+
+#define MIN_BW_RATE		(1 * MB)	/* --stream-bw, --memcpy-bw */
+#define MAX_BW_RATE		(1024 * GB)
+
+#define STREAM_KERNELS		(4)	/* copy, scale, add, triad */
+#define STREAM_NODES_MAX	(64)	/* max NUMA nodes reported */
+
 #define MIN_SYNC_FILE_BYTES	(1 * MB)
 #if UINTPTR_MAX == MAX_32
 #define MAX_SYNC_FILE_BYTES	(MAX_32)
@@ -504,6 +860,9 @@ extern void pr_openlog(const char *filename);
 #endif
 #define DEFAULT_SYNC_FILE_BYTES	(1 * GB)
 
+#define MIN_SYSFS_TOP		(1)
+#define MAX_SYSFS_TOP		(1000)
+
 
 #define MIN_TSEARCH_SIZE	(1 * KB)
 #define MAX_TSEARCH_SIZE	(4 * MB)
@@ -517,10 +876,26 @@ extern void pr_openlog(const char *filename);
 #define MAX_TIMERFD_FREQ	(100000000)
 #define DEFAULT_TIMERFD_FREQ	(1000000)
 
+#define MIN_TIMERFD_MASS	(1)
+#define MAX_TIMERFD_MASS	(1000000)
+
+#define MIN_TIMER_JITTER_PRIO	(1)
+#define MAX_TIMER_JITTER_PRIO	(99)
+
 #define MIN_UDP_PORT		(1024)
 #define MAX_UDP_PORT		(65535)
 #define DEFAULT_UDP_PORT	(7000)
 
+#define MIN_ICMP_FLOOD_BATCH	(1)
+#define MAX_ICMP_FLOOD_BATCH	(256)
+
+#define MIN_UDP_BATCH		(1)
+#define MAX_UDP_BATCH		(256)
+#define DEFAULT_UDP_BATCH	(1)
+
+#define MIN_UDP_GSO_SIZE	(64)
+#define MAX_UDP_GSO_SIZE	(9000)
+
 #define MIN_USERFAULTFD_BYTES	(4 * KB)
 #if UINTPTR_MAX == MAX_32
 #define MAX_USERFAULTFD_BYTES	(MAX_32)
@@ -529,6 +904,22 @@ extern void pr_openlog(const char *filename);
 #endif
 #define DEFAULT_USERFAULTFD_BYTES (16 * MB)
 
+#define MIN_USERFAULTFD_HANDLERS	(1)
+#define MAX_USERFAULTFD_HANDLERS	(64)
+#define DEFAULT_USERFAULTFD_HANDLERS	(1)
+
+#define MIN_USERFAULTFD_FAULTERS	(1)
+#define MAX_USERFAULTFD_FAULTERS	(64)
+#define DEFAULT_USERFAULTFD_FAULTERS	(1)
+
+#define MIN_USERFAULTFD_PREFAULT	(1)
+#define MAX_USERFAULTFD_PREFAULT	(512)
+#define DEFAULT_USERFAULTFD_PREFAULT	(1)
+
+#define MIN_MLOCK_BYTES		(4 * KB)
+#define MAX_MLOCK_BYTES		(MAX_VM_BYTES)
+#define DEFAULT_MLOCK_BYTES	(64 * MB)
+
 #define MIN_VM_BYTES		(4 * KB)
 #if UINTPTR_MAX == MAX_32
 #define MAX_VM_BYTES		(MAX_32)
@@ -537,6 +928,14 @@ extern void pr_openlog(const char *filename);
 #endif
 #define DEFAULT_VM_BYTES	(256 * MB)
 
+#define MIN_VM_THREADS		(1)
+#define MAX_VM_THREADS		(256)
+#define DEFAULT_VM_THREADS	(1)
+
+#define MIN_VM_HAMMER_RATE	(0)
+#define MAX_VM_HAMMER_RATE	(1000000000ULL)
+#define DEFAULT_VM_HAMMER_RATE	(0)
+
 #define MIN_VM_HANG		(0)
 #define MAX_VM_HANG		(3600)
 #define DEFAULT_VM_HANG		(~0ULL)
@@ -553,6 +952,26 @@ extern void pr_openlog(const char *filename);
 #define MAX_VM_SPLICE_BYTES	(64*MB)
 #define DEFAULT_VM_SPLICE_BYTES	(64*KB)
 
+#define MIN_SWAP_BYTES		(4 * MB)
+#define MAX_SWAP_BYTES		(MAX_VM_BYTES)
+#define DEFAULT_SWAP_BYTES	(256 * MB)
+
+#define MIN_SWAP_LIMIT		(1 * MB)
+#define MAX_SWAP_LIMIT		(MAX_VM_BYTES)
+#define DEFAULT_SWAP_LIMIT	(0)	/* a quarter of --swap-bytes */
+
+#define MIN_ZLIB_LEVEL		(0)
+#define MAX_ZLIB_LEVEL		(19)
+#define DEFAULT_ZLIB_LEVEL	(9)
+
+#define MIN_ZLIB_BLOCK_SIZE	(1 * KB)
+#define MAX_ZLIB_BLOCK_SIZE	(4 * MB)
+#define DEFAULT_ZLIB_BLOCK_SIZE	(64 * KB)
+
+#define MIN_ZLIB_THREADS	(0)
+#define MAX_ZLIB_THREADS	(256)
+#define DEFAULT_ZLIB_THREADS	(0)	/* one deflater, one inflater */
+
 #define MIN_ZOMBIES		(1)
 #define MAX_ZOMBIES		(1000000)
 #define DEFAULT_ZOMBIES		(8192)
@@ -563,6 +982,18 @@ extern void pr_openlog(const char *filename);
 #define DEFAULT_DIRS		(8192)
 
 #define STR_SHARED_SIZE		(65536 * 32)
+
+#define CACHELINE_SIZE		(64)	/* cacheline stressor line size */
+#define CACHELINE_SLOTS		(64)	/* instances with their own counter */
+#define CACHELINE_PAD_LINES	(4)	/* lines per counter when padded */
+#define CACHELINE_MATRIX_MAX	(64)	/* max CPUs in the latency matrix */
+#define RDRAND_METHODS_MAX	(2)	/* rdrand, rdseed or rndr, rndrrs */
+#define RDRAND_STEPS_MAX	(12)	/* 1, 2, 4 .. 1024 instances */
+#define METADATA_LAYOUTS	(3)	/* private, shared, tree */
+#define METADATA_PHASES		(4)	/* create, stat, rename, unlink */
+#define SYNC_WAL_METHODS	(4)	/* fsync, fdatasync, sync_file_range, O_DSYNC */
+#define SYNC_WAL_SIZES		(4)	/* 512, 4K, 64K and 1M appends */
+#define SYNC_WAL_BUCKETS	(320)	/* log linear latency buckets */
 #define MEM_CACHE_SIZE		(65536 * 32)
 #define DEFAULT_CACHE_LEVEL     3
 #define UNDEFINED		(-1)
@@ -574,6 +1005,7 @@ extern void pr_openlog(const char *filename);
 
 #define STRESS_CPU_DITHER_X	(1024)
 #define STRESS_CPU_DITHER_Y	(768)
+#define STRESS_CPU_METHODS_MAX	(128)	/* max cpu-method table size */
 
 #define STRESS_NBITS(a)		(sizeof(a[0]) * 8)
 #define STRESS_GETBIT(a, i)	(a[i / STRESS_NBITS(a)] & \
@@ -601,6 +1033,9 @@ extern void pr_openlog(const char *filename);
 #define STRESS_THRASH
 #endif
 
+#define MIN_THRASH_RECLAIM	(1)	/* MB/sec */
+#define MAX_THRASH_RECLAIM	(1000000)
+
 #if defined(__ARM_ARCH_6__) || defined(__ARM_ARCH_6J__) ||     \
     defined(__ARM_ARCH_6K__) || defined(__ARM_ARCH_6Z__) ||    \
     defined(__ARM_ARCH_6ZK__) || defined(__ARM_ARCH_6T2__) ||  \
@@ -669,6 +1104,17 @@ extern void pr_openlog(const char *filename);
 #define OPTIMIZE3
 #endif
 
+/*
+ *  Function multiversioning of the hot vectorisable kernels,
+ *  a clone per ISA level is built and the widest one the CPU
+ *  supports is picked by an ifunc at load time
+ */
+#if defined(HAVE_TARGET_CLONES)
+#define TARGET_CLONES	__attribute__((target_clones("avx512f","avx2","sse4.2","default")))
+#else
+#define TARGET_CLONES
+#endif
+
 #if defined(__GNUC__)
 #define WARN_UNUSED __attribute__((warn_unused_result))
 #endif
@@ -737,6 +1183,15 @@ enum {
 	STRESS_PERF_HW_BRANCH_MISSES,
 	STRESS_PERF_HW_BUS_CYCLES,
 	STRESS_PERF_HW_REF_CPU_CYCLES,
+	STRESS_PERF_HW_CACHE_DTLB_READ_MISS,
+	STRESS_PERF_HW_CACHE_DTLB_WRITE_MISS,
+	STRESS_PERF_HW_CACHE_ITLB_READ_MISS,
+
+	STRESS_PERF_TD_TOTAL_SLOTS,
+	STRESS_PERF_TD_SLOTS_ISSUED,
+	STRESS_PERF_TD_SLOTS_RETIRED,
+	STRESS_PERF_TD_FETCH_BUBBLES,
+	STRESS_PERF_TD_RECOVERY_BUBBLES,
 
 	STRESS_PERF_SW_PAGE_FAULTS_MIN,
 	STRESS_PERF_SW_PAGE_FAULTS_MAJ,
@@ -769,7 +1224,8 @@ enum {
 	STRESS_PERF_TP_SOFTIRQ_EXIT,
 	STRESS_PERF_TP_WRITEBACK_DIRTY_INODE,
 	STRESS_PERF_TP_WRITEBACK_DIRTY_PAGE,
-	
+	STRESS_PERF_TP_LOCK_CONTENTION_BEGIN,
+
 	STRESS_PERF_MAX
 };
 
@@ -777,18 +1233,84 @@ enum {
 typedef struct {
 	uint64_t counter;		/* perf counter */
 	int	 fd;			/* perf per counter fd */
+	int	 leader;		/* index of group leader, -1 = no group */
 } perf_stat_t;
 
+#define PERF_LOCK_SITES		(16)	/* contended locks kept per instance */
+
+/* per contended kernel lock info */
+typedef struct {
+	uint64_t addr;			/* kernel lock address */
+	uint64_t count;			/* contentions sampled */
+	uint32_t flags;			/* lock:contention_begin flags */
+} perf_lock_t;
+
 /* per stressor perf info */
 typedef struct {
 	perf_stat_t	perf_stat[STRESS_PERF_MAX]; /* perf counters */
 	int		perf_opened;		/* count of opened counters */
+	uint64_t	live[STRESS_PERF_MAX];	/* counters sampled during the run */
+	perf_lock_t	locks[PERF_LOCK_SITES];	/* most contended kernel locks */
+	uint64_t	locks_lost;		/* contention samples lost */
 } stress_perf_t;
 #endif
 
 #if defined(__linux__)
 #define	STRESS_THERMAL_ZONES	 (1)
 #define STRESS_THERMAL_ZONES_MAX (31)	/* best if prime */
+#define STRESS_THERMAL_TRIPS_MAX (4)	/* trip points tracked per zone */
+#define STRESS_CPUFREQ		(1)
+#define STRESS_CPUFREQ_CSTATES_MAX (10)	/* idle states tracked */
+#endif
+
+/* periodic bogo op counter sampling */
+#if defined(HAVE_LIB_PTHREAD)
+#define STRESS_SAMPLE		(1)
+#endif
+
+/* warm-up time excluded from the metrics */
+#if defined(HAVE_LIB_PTHREAD)
+#define STRESS_WARMUP		(1)
+#endif
+
+/* instances of thread safe stressors run as pthreads */
+#if defined(HAVE_LIB_PTHREAD)
+#define STRESS_THREADS		(1)
+#endif
+
+/* NUMA node enumeration and binding helpers */
+#if defined(__linux__) && defined(__NR_set_mempolicy) && \
+    defined(__NR_mbind) && NEED_GLIBC(2,3,0)
+#define STRESS_NUMA_BIND	(1)
+#endif
+
+/* per-operation latency histograms */
+#if defined(__linux__)
+#define STRESS_LATENCY		(1)
+#define LATENCY_BUCKETS		(256)	/* 8 linear buckets per power of 2 */
+
+typedef struct {
+	uint64_t count;			/* number of latencies recorded */
+	uint64_t max;			/* maximum latency in nanoseconds */
+	uint32_t bucket[LATENCY_BUCKETS]; /* log-linear latency histogram */
+} stress_latency_t;
+#endif
+
+/* stressor log messages queued in shared memory for the parent */
+#if defined(HAVE_LIB_PTHREAD)
+#define STRESS_LOG_ASYNC	(1)
+#define LOG_RING_SIZE		(4096)	/* bytes of records per instance */
+
+typedef struct {
+	uint64_t head;			/* bytes written by the instance */
+	uint64_t tail;			/* bytes drained by the parent */
+	pid_t owner;			/* the only process that may write */
+	uint8_t buf[LOG_RING_SIZE] ALIGN64; /* records, see log.c */
+} log_ring_t;
+
+extern void pr_log_ring_attach(log_ring_t *ring);
+extern void pr_log_drain_start(void);
+extern void pr_log_drain_stop(void);
 #endif
 
 #if defined(STRESS_THERMAL_ZONES)
@@ -797,6 +1319,13 @@ typedef struct tz_info {
 	char	*path;
 	char 	*type;
 	size_t	index;
+	uint32_t trips;			/* number of valid trip points */
+	uint64_t trip_temp[STRESS_THERMAL_TRIPS_MAX]; /* trip Celsius * 1000 */
+	char	trip_type[STRESS_THERMAL_TRIPS_MAX][16]; /* passive, hot, .. */
+	double	trip_time[STRESS_THERMAL_TRIPS_MAX]; /* secs at or above trip */
+	uint64_t max_temp;		/* hottest sampled temperature */
+	uint64_t sum_temp;		/* sum of sampled temperatures */
+	uint64_t samples;		/* temperatures sampled by the parent */
 	struct tz_info *next;
 } tz_info_t;
 
@@ -809,17 +1338,96 @@ typedef struct {
 } stress_tz_t;
 #endif
 
+#if defined(STRESS_CPUFREQ)
+/* per stressor CPU frequency and idle state residency */
+typedef struct {
+	uint64_t cycles;		/* CPU cycles, as APERF */
+	uint64_t ref_cycles;		/* reference cycles, as MPERF */
+	double cpu_time;		/* user + system time in seconds */
+	double sysfs_khz;		/* mean scaling_cur_freq, 0 = none */
+	double wall;			/* idle state sampling time */
+	uint32_t cpus;			/* CPUs the instance could use */
+	uint64_t idle_usec[STRESS_CPUFREQ_CSTATES_MAX]; /* idle residency */
+} stress_cpufreq_t;
+#endif
+
+/* Stressor specific metrics, e.g. bandwidth, reported by metrics_dump */
+#define STRESS_MISC_METRICS_MAX	(48)	/* vm --vm-method all needs 34 */
+#define STRESS_MISC_METRIC_HUGEPAGES (STRESS_MISC_METRICS_MAX - 1) /* --hugepages count */
+#define STRESS_MISC_METRIC_IO	(STRESS_MISC_METRICS_MAX - 5) /* 4 io_stats_end slots */
+#define STRESS_MISC_METRIC_RESIDENCY (STRESS_MISC_METRICS_MAX - 13) /* 8 --page-residency slots */
+
+typedef struct {
+	char description[32];		/* metric name and units, "" = unused */
+	double value;			/* metric value */
+} stress_misc_metric_t;
+
+/* rdrand results of one method at one number of active instances */
+typedef struct {
+	uint64_t rate;			/* sum of bits/sec of each record */
+	uint64_t calls;			/* successful calls */
+	uint64_t fails;			/* calls that returned no data */
+	uint64_t nsec;			/* time spent calling */
+	uint64_t max_nsec;		/* slowest call, 32 call average */
+	uint32_t records;		/* instance results added */
+} rdrand_step_t;
+
+/* metadata results of one layout and phase */
+typedef struct {
+	uint64_t ops;			/* operations completed */
+	uint64_t nsec;			/* phase wall clock time */
+	uint32_t records;		/* instance results added */
+} metadata_phase_t;
+
+/* sync-file WAL latencies of one sync method and append size */
+typedef struct {
+	uint64_t syncs;			/* syncs completed */
+	uint64_t nsec;			/* time appending and syncing */
+	uint64_t max_nsec;		/* slowest sync */
+	uint64_t rate;			/* sum of syncs/sec of each record */
+	uint32_t records;		/* instance results added */
+	uint64_t hist[SYNC_WAL_BUCKETS];	/* sync latency histogram */
+} sync_wal_cell_t;
+
+/*
+ *  Per process bogo op counter, these are updated at a high rate so
+ *  each one is given a cache line of its own to stop instances
+ *  bouncing lines between CPUs
+ */
+typedef struct {
+	uint64_t counter ALIGN64;	/* number of bogo ops */
+} proc_counter_t;
+
+/* Per process scheduler, memory and I/O accounting, taken at exit */
+typedef struct {
+	bool sched_ok;			/* schedstat was read */
+	bool rusage_ok;			/* getrusage succeeded */
+	bool io_ok;			/* /proc/self/io was read */
+	uint64_t run_nsec;		/* time on a CPU */
+	uint64_t delay_nsec;		/* time runnable but waiting for a CPU */
+	uint64_t maxrss;		/* peak resident set, KB */
+	uint64_t nvcsw;			/* voluntary context switches */
+	uint64_t nivcsw;		/* involuntary context switches */
+	uint64_t minflt;		/* minor page faults */
+	uint64_t majflt;		/* major page faults */
+	uint64_t read_bytes;		/* bytes read from the device */
+	uint64_t write_bytes;		/* bytes sent to the device */
+} proc_usage_t;
+
 /* Per process statistics and accounting info */
 typedef struct {
-	uint64_t counter;		/* number of bogo ops */
 	struct tms tms;			/* run time stats of process */
+	proc_usage_t usage;		/* scheduler, memory and I/O accounting */
 	double start;			/* wall clock start time */
 	double finish;			/* wall clock stop time */
-#if defined(STRESS_PERF_STATS)
-	stress_perf_t sp;		/* perf counters */
+#if defined(STRESS_CPUFREQ)
+	stress_cpufreq_t cpufreq;	/* CPU frequency and idle states */
 #endif
-#if defined(STRESS_THERMAL_ZONES)
-	stress_tz_t tz;			/* thermal zones */
+	stress_misc_metric_t misc[STRESS_MISC_METRICS_MAX]; /* stressor metrics */
+	double units_per_op;		/* normalised work units per bogo op */
+#if defined(STRESS_WARMUP)
+	uint64_t warmup_counter;	/* bogo ops during warm-up */
+	struct tms warmup_tms;		/* run time stats during warm-up */
 #endif
 } proc_stats_t;
 
@@ -845,6 +1453,28 @@ typedef struct {
 		uint16_t val16;
 		uint8_t	 val8;
 	} atomic;					/* Shared atomic temp vars */
+	uint64_t cacheline[(CACHELINE_SLOTS * CACHELINE_PAD_LINES *
+		CACHELINE_SIZE) / sizeof(uint64_t)] ALIGN64; /* cacheline counters */
+	struct {
+		uint32_t n;				/* CPUs measured, 0 = none */
+		int32_t cpus[CACHELINE_MATRIX_MAX];	/* the CPUs measured */
+		float nsec[CACHELINE_MATRIX_MAX][CACHELINE_MATRIX_MAX]; /* one way latency */
+	} cacheline_matrix;				/* --cacheline-matrix results */
+	struct {
+		uint64_t start_ns;			/* --rdrand-scale schedule start */
+		uint32_t active[RDRAND_STEPS_MAX];	/* instances active in a step */
+		rdrand_step_t step[RDRAND_METHODS_MAX][RDRAND_STEPS_MAX];
+	} rdrand;					/* rdrand per method totals */
+	struct {
+		uint32_t instances;			/* instances taking part */
+		uint32_t arrived;			/* phase barrier arrivals */
+		uint32_t departed;			/* instances that have finished */
+		metadata_phase_t phase[METADATA_LAYOUTS][METADATA_PHASES];
+	} metadata;					/* metadata per phase totals */
+	struct {
+		uint64_t start_ns;			/* --sync-file-wal schedule start */
+		sync_wal_cell_t cell[SYNC_WAL_METHODS][SYNC_WAL_SIZES];
+	} sync_wal;					/* sync-file WAL totals */
 	struct {
 		uint32_t futex[STRESS_PROCS_MAX];	/* Shared futexes */
 		uint64_t timeout[STRESS_PROCS_MAX];	/* Shared futex timeouts */
@@ -860,6 +1490,31 @@ typedef struct {
 		int sem_id;				/* System V semaphore id */
 		bool init;				/* System V semaphore initialized */
 	} sem_sysv;
+	struct {
+		uint32_t finished;			/* instances finished */
+		uint64_t rate[STREAM_KERNELS];		/* total KB/sec per kernel */
+		uint64_t node_rate[STREAM_NODES_MAX][STREAM_KERNELS]; /* per node */
+		uint32_t node_instances[STREAM_NODES_MAX]; /* instances per node */
+	} stream;					/* stream bandwidth totals */
+	struct {
+		uint32_t go;				/* futex, 1 = all forked */
+	} sync_start;					/* --sync-start release */
+	struct {
+		uint64_t ops[STRESS_CPU_METHODS_MAX];	/* bogo ops per method */
+		uint64_t nsec[STRESS_CPU_METHODS_MAX];	/* run time per method */
+	} cpu_method;					/* --cpu-method all totals */
+	struct {
+		uint64_t ops[2];			/* bogo ops, without/with FMA load */
+		uint64_t nsec[2];			/* run time */
+		uint64_t cycles[2];			/* cpu-cycles */
+		uint64_t ref_cycles[2];			/* ref-cpu-cycles */
+		uint32_t perf_instances;		/* instances with valid cycle counts */
+		char fma_method[8];			/* FMA kernel on the sibling CPUs */
+	} cpu_interfere;				/* --cpu-avx-interfere totals */
+	struct {
+		double ns_per_tick;			/* calibrated tick period */
+		bool counter;				/* true = cycle counter, false = clock */
+	} timebase;					/* time_ticks() time base */
 #if defined(STRESS_PERF_STATS)
 	struct {
 		bool no_perf;				/* true = Perf not available */
@@ -869,7 +1524,26 @@ typedef struct {
 #if defined(STRESS_THERMAL_ZONES)
 	tz_info_t *tz_info;				/* List of valid thermal zones */
 #endif
-	proc_stats_t stats[0];				/* Shared statistics */
+	/*
+	 *  Per instance data follows in the same mapping, one slot for
+	 *  each instance of the selected stressors. The perf, thermal
+	 *  zone and latency blocks are only laid out when enabled
+	 */
+	int32_t stats_slots;				/* Slots in each array */
+	proc_stats_t *stats;				/* Shared statistics */
+	proc_counter_t *counters;			/* Bogo op counters */
+#if defined(STRESS_PERF_STATS)
+	stress_perf_t *perf_stats;			/* perf counters, or NULL */
+#endif
+#if defined(STRESS_THERMAL_ZONES)
+	stress_tz_t *tz_stats;				/* thermal zones, or NULL */
+#endif
+#if defined(STRESS_LATENCY)
+	stress_latency_t *lat_stats;			/* op latencies, or NULL */
+#endif
+#if defined(STRESS_LOG_ASYNC)
+	log_ring_t *log_rings;				/* --log-async, or NULL */
+#endif
 } shared_t;
 
 /* Stress test classes */
@@ -889,6 +1563,10 @@ typedef enum {
 	__STRESS_AF_ALG,
 #define STRESS_AF_ALG __STRESS_AF_ALG
 #endif
+#if defined(__linux__) && defined(AF_PACKET)
+	__STRESS_AF_PACKET,
+#define STRESS_AF_PACKET __STRESS_AF_PACKET
+#endif
 #if defined(HAVE_LIB_RT) && defined(__linux__) && NEED_GLIBC(2,1,0)
 	__STRESS_AIO,
 #define STRESS_AIO __STRESS_AIO
@@ -906,6 +1584,10 @@ typedef enum {
 	__STRESS_APPARMOR,
 #define STRESS_APPARMOR __STRESS_APPARMOR
 #endif
+#if defined(HAVE_LIB_PTHREAD) && defined(HAVE_ATOMIC)
+	__STRESS_ARENA,
+#define STRESS_ARENA __STRESS_ARENA
+#endif
 #if defined(HAVE_ATOMIC)
 	__STRESS_ATOMIC,
 #define STRESS_ATOMIC __STRESS_ATOMIC
@@ -918,6 +1600,7 @@ typedef enum {
 #define STRESS_BIND_MOUNT __STRESS_BIND_MOUNT
 #endif
 	STRESS_CACHE,
+	STRESS_CACHELINE,
 #if defined(__linux__) && defined(HAVE_SYS_CAP_H)
 	__STRESS_CAP,
 #define STRESS_CAP __STRESS_CAP
@@ -933,6 +1616,10 @@ typedef enum {
 	__STRESS_CLONE,
 #define STRESS_CLONE __STRESS_CLONE
 #endif
+#if defined(__linux__)
+	__STRESS_COMPACT,
+#define STRESS_COMPACT __STRESS_COMPACT
+#endif
 #if !defined(__OpenBSD__)
 	__STRESS_CONTEXT,
 #define STRESS_CONTEXT __STRESS_CONTEXT
@@ -956,6 +1643,10 @@ typedef enum {
 #if defined(__linux__)
 	__STRESS_DNOTIFY,
 #define STRESS_DNOTIFY __STRESS_DNOTIFY
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+	__STRESS_DSP,
+#define STRESS_DSP __STRESS_DSP
 #endif
 	STRESS_DUP,
 #if defined(HAVE_LIB_RT) && defined(__linux__) && NEED_GLIBC(2,3,2)
@@ -984,7 +1675,12 @@ typedef enum {
 	STRESS_FILENAME,
 	STRESS_FLOCK,
 	STRESS_FORK,
+	STRESS_FORKHEAP,
 	STRESS_FP_ERROR,
+#if defined(__linux__) && defined(__x86_64__)
+	__STRESS_FRONTEND,
+#define STRESS_FRONTEND __STRESS_FRONTEND
+#endif
 	STRESS_FSTAT,
 #if defined(__linux__)
 	__STRESS_FULL,
@@ -1007,6 +1703,11 @@ typedef enum {
     defined(__NR_open_by_handle_at) && NEED_GLIBC(2,14,0)
 	__STRESS_HANDLE,
 #define STRESS_HANDLE __STRESS_HANDLE
+#endif
+	STRESS_HASH,
+#if defined(HAVE_LIB_PTHREAD) && defined(HAVE_ATOMIC)
+	__STRESS_HASHMAP,
+#define STRESS_HASHMAP __STRESS_HASHMAP
 #endif
 	STRESS_HDD,
 #if defined(HAVE_LIB_BSD)
@@ -1027,6 +1728,17 @@ typedef enum {
 	__STRESS_INOTIFY,
 #define STRESS_INOTIFY __STRESS_INOTIFY
 #endif
+#if defined(__linux__) && defined(HAVE_IO_URING)
+	__STRESS_IO_URING_NET,
+#define STRESS_IO_URING_NET __STRESS_IO_URING_NET
+#endif
+#if defined(__linux__) &&			\
+    (defined(HAVE_LIB_RT) ||			\
+     defined(STRESS_AIO_LINUX) ||		\
+     defined(HAVE_IO_URING))
+	__STRESS_IOCMP,
+#define STRESS_IOCMP __STRESS_IOCMP
+#endif
 #if defined(__linux__) && defined(__NR_ioprio_set) && defined(__NR_ioprio_get)
 	__STRESS_IOPRIO,
 #define STRESS_IOPRIO __STRESS_IOPRIO
@@ -1046,9 +1758,17 @@ typedef enum {
 	__STRESS_KLOG,
 #define STRESS_KLOG __STRESS_KLOG
 #endif
+#if defined(__linux__) && defined(MADV_MERGEABLE) && defined(MADV_UNMERGEABLE)
+	__STRESS_KSM,
+#define STRESS_KSM __STRESS_KSM
+#endif
 #if defined(F_SETLEASE) && defined(F_WRLCK) && defined(F_UNLCK)
 	__STRESS_LEASE,
 #define STRESS_LEASE __STRESS_LEASE
+#endif
+#if defined(HAVE_LIB_PTHREAD) && defined(HAVE_ATOMIC)
+	__STRESS_LFQUEUE,
+#define STRESS_LFQUEUE __STRESS_LFQUEUE
 #endif
 	STRESS_LINK,
 #if (((defined(__GNUC__) || defined(__clang__)) && defined(STRESS_X86)) || \
@@ -1092,6 +1812,7 @@ typedef enum {
 	__STRESS_MERGESORT,
 #define STRESS_MERGESORT __STRESS_MERGESORT
 #endif
+	STRESS_METADATA,
 #if !defined(__gnu_hurd__) && NEED_GLIBC(2,2,0)
 	__STRESS_MINCORE,
 #define STRESS_MINCORE __STRESS_MINCORE
@@ -1107,6 +1828,10 @@ typedef enum {
 #define STRESS_MMAPFORK	__STRESS_MMAPFORK
 #endif
 	STRESS_MMAPMANY,
+#if defined(__linux__) && defined(HAVE_LIB_PTHREAD) && defined(MADV_DONTNEED)
+	__STRESS_MMAPLOCK,
+#define STRESS_MMAPLOCK __STRESS_MMAPLOCK
+#endif
 #if defined(__linux__) && NEED_GLIBC(2,4,0)
 	__STRESS_MREMAP,
 #define STRESS_MREMAP __STRESS_MREMAP
@@ -1175,7 +1900,8 @@ typedef enum {
 	__STRESS_QUOTA,
 #define STRESS_QUOTA __STRESS_QUOTA
 #endif
-#if defined(STRESS_X86) && !defined(__OpenBSD__) && NEED_GNUC(4,6,0)
+#if ((defined(STRESS_X86) && !defined(__OpenBSD__)) ||	\
+     (defined(__aarch64__) && defined(__linux__))) && NEED_GNUC(4,6,0)
 	__STRESS_RDRAND,
 #define STRESS_RDRAND __STRESS_RDRAND
 #endif
@@ -1201,6 +1927,10 @@ typedef enum {
 	__STRESS_RTC,
 #define STRESS_RTC __STRESS_RTC
 #endif
+#if defined(HAVE_LIB_PTHREAD) && defined(__linux__) && defined(__NR_futex)
+	__STRESS_SCHEDLAT,
+#define STRESS_SCHEDLAT __STRESS_SCHEDLAT
+#endif
 #if defined(HAVE_LIB_SCTP)
 	__STRESS_SCTP,
 #define STRESS_SCTP __STRESS_SCTP
@@ -1253,6 +1983,7 @@ typedef enum {
 #define STRESS_SOCKET_FD __STRESS_SOCKET_FD
 #endif
 	STRESS_SOCKET_PAIR,
+	STRESS_SORT,
 #if defined(__linux__)
 	__STRESS_SPAWN,
 #define STRESS_SPAWN __STRESS_SPAWN
@@ -1268,12 +1999,17 @@ typedef enum {
 #endif
 	STRESS_STR,
 	STRESS_STREAM,
+#if defined(STRESS_LATENCY)
+	__STRESS_SWAP,
+#define STRESS_SWAP __STRESS_SWAP
+#endif
 	STRESS_SWITCH,
 	STRESS_SYMLINK,
 #if defined(__linux__) && defined(__NR_sync_file_range) && NEED_GLIBC(2,10,0)
 	__STRESS_SYNC_FILE,
 #define STRESS_SYNC_FILE __STRESS_SYNC_FILE
 #endif
+	STRESS_SYSCALL,
 	STRESS_SYSINFO,
 #if defined(HAVE_LIB_PTHREAD) && defined(__linux__)
 	__STRESS_SYSFS,
@@ -1291,6 +2027,10 @@ typedef enum {
 	__STRESS_TIMERFD,
 #define STRESS_TIMERFD __STRESS_TIMERFD
 #endif
+#if defined(__linux__)
+	__STRESS_TLB,
+#define STRESS_TLB __STRESS_TLB
+#endif
 #if defined(__linux__)
 	__STRESS_TLB_SHOOTDOWN,
 #define STRESS_TLB_SHOOTDOWN __STRESS_TLB_SHOOTDOWN
@@ -1305,6 +2045,10 @@ typedef enum {
 	__STRESS_UDP_FLOOD,
 #define STRESS_UDP_FLOOD __STRESS_UDP_FLOOD
 #endif
+#if defined(HAVE_LIB_PTHREAD) && defined(HAVE_ATOMIC)
+	__STRESS_ULOCK,
+#define STRESS_ULOCK __STRESS_ULOCK
+#endif
 #if defined(__linux__) && defined(__NR_unshare)
 	__STRESS_UNSHARE,
 #define STRESS_UNSHARE __STRESS_UNSHARE
@@ -1339,6 +2083,11 @@ typedef enum {
 #if !defined(__gnu_hurd__) && !defined(__NetBSD__)
 	__STRESS_WAIT,
 #define STRESS_WAIT __STRESS_WAIT
+#endif
+#if defined(__linux__) && defined(HAVE_LIB_PTHREAD) && \
+    defined(STRESS_LATENCY) && NEED_GLIBC(2,8,0)
+	__STRESS_WAKEUP,
+#define STRESS_WAKEUP __STRESS_WAKEUP
 #endif
 	STRESS_WCS,
 #if defined(__linux__) && defined(HAVE_XATTR_H)
@@ -1415,6 +2164,14 @@ typedef enum {
 #if defined(STRESS_AF_ALG)
 	OPT_AF_ALG,
 	OPT_AF_ALG_OPS,
+	OPT_AF_ALG_THROUGHPUT,
+#endif
+
+#if defined(STRESS_AF_PACKET)
+	OPT_AF_PACKET,
+	OPT_AF_PACKET_OPS,
+	OPT_AF_PACKET_PORT,
+	OPT_AF_PACKET_SIZE,
 #endif
 
 	OPT_AGGRESSIVE,
@@ -1429,6 +2186,8 @@ typedef enum {
 	OPT_AIO_LINUX,
 	OPT_AIO_LINUX_OPS,
 	OPT_AIO_LINUX_REQUESTS,
+	OPT_AIO_LINUX_SWEEP,
+	OPT_AIO_LINUX_MIN_NR,
 #endif
 
 #if defined(STRESS_APPARMOR)
@@ -1436,6 +2195,16 @@ typedef enum {
 	OPT_APPARMOR_OPS,
 #endif
 
+#if defined(STRESS_ARENA)
+	OPT_ARENA,
+	OPT_ARENA_OPS,
+	OPT_ARENA_METHOD,
+	OPT_ARENA_OBJECTS,
+	OPT_ARENA_SIZE,
+	OPT_ARENA_TCACHE,
+	OPT_ARENA_THREADS,
+#endif
+
 #if defined(STRESS_ATOMIC)
 	OPT_ATOMIC,
 	OPT_ATOMIC_OPS,
@@ -1448,6 +2217,8 @@ typedef enum {
 	OPT_BSEARCH,
 	OPT_BSEARCH_OPS,
 	OPT_BSEARCH_SIZE,
+	OPT_BSEARCH_METHOD,
+	OPT_BSEARCH_SWEEP,
 
 	OPT_BIGHEAP_OPS,
 	OPT_BIGHEAP_GROWTH,
@@ -1457,7 +2228,17 @@ typedef enum {
 	OPT_BIND_MOUNT_OPS,
 #endif
 
+	OPT_CGROUP,
+	OPT_CGROUP_CPU_MAX,
+	OPT_CGROUP_MEMORY_MAX,
+	OPT_CGROUP_IO_MAX,
+	OPT_RESCTRL,
+	OPT_IRQ_STATS,
+
 	OPT_CLASS,
+	OPT_COMPARE,
+	OPT_COMPARE_THRESHOLD,
+	OPT_CPUFREQ,
 	OPT_CACHE_OPS,
 	OPT_CACHE_PREFETCH,
 	OPT_CACHE_FLUSH,
@@ -1466,6 +2247,12 @@ typedef enum {
 	OPT_CACHE_WAYS,
 	OPT_CACHE_NO_AFFINITY,
 
+	OPT_CACHELINE,
+	OPT_CACHELINE_OPS,
+	OPT_CACHELINE_LAYOUT,
+	OPT_CACHELINE_OP,
+	OPT_CACHELINE_MATRIX,
+
 #if defined(STRESS_CAP)
 	OPT_CAP,
 	OPT_CAP_OPS,
@@ -1483,6 +2270,7 @@ typedef enum {
 #if defined(STRESS_CLOCK)
 	OPT_CLOCK,
 	OPT_CLOCK_OPS,
+	OPT_CLOCK_COST,
 #endif
 
 #if defined(STRESS_CLONE)
@@ -1491,30 +2279,46 @@ typedef enum {
 	OPT_CLONE_MAX,
 #endif
 
+#if defined(STRESS_COMPACT)
+	OPT_COMPACT,
+	OPT_COMPACT_OPS,
+	OPT_COMPACT_BYTES,
+	OPT_COMPACT_KEEP,
+	OPT_COMPACT_PIN,
+#endif
+
 #if defined(STRESS_CONTEXT)
 	OPT_CONTEXT,
 	OPT_CONTEXT_OPS,
+	OPT_CONTEXT_COMPARE,
 #endif
 
 #if defined(STRESS_COPY_FILE)
 	OPT_COPY_FILE,
 	OPT_COPY_FILE_OPS,
 	OPT_COPY_FILE_BYTES,
+	OPT_COPY_FILE_SWEEP,
 #endif
 
 	OPT_CPU_OPS,
 	OPT_CPU_METHOD,
+	OPT_CPU_AVX_INTERFERE,
 	OPT_CPU_LOAD_SLICE,
+	OPT_CPU_LOAD_PERIOD,
+	OPT_CPU_LOAD_PROFILE,
 
 #if defined(STRESS_CPU_ONLINE)
 	OPT_CPU_ONLINE,
 	OPT_CPU_ONLINE_OPS,
+	OPT_CPU_ONLINE_IMPACT,
 #endif
 
 
 #if defined(STRESS_CRYPT)
 	OPT_CRYPT,
 	OPT_CRYPT_OPS,
+	OPT_CRYPT_METHOD,
+	OPT_CRYPT_ROUNDS,
 #endif
 
 	OPT_DAEMON,
@@ -1523,6 +2327,7 @@ typedef enum {
 	OPT_DENTRY_OPS,
 	OPT_DENTRIES,
 	OPT_DENTRY_ORDER,
+	OPT_DENTRY_NEGATIVE,
 
 	OPT_DIR,
 	OPT_DIR_OPS,
@@ -1532,14 +2337,25 @@ typedef enum {
 	OPT_DNOTIFY_OPS,
 #endif
 
+#if defined(STRESS_DSP)
+	OPT_DSP,
+	OPT_DSP_OPS,
+	OPT_DSP_METHOD,
+	OPT_DSP_SIZES,
+#endif
+
 	OPT_DUP,
 	OPT_DUP_OPS,
 
 #if defined(STRESS_EPOLL)
+	OPT_ENERGY,
+
 	OPT_EPOLL,
 	OPT_EPOLL_OPS,
 	OPT_EPOLL_PORT,
 	OPT_EPOLL_DOMAIN,
+	OPT_EPOLL_CONNS,
+	OPT_EPOLL_THREADS,
 #endif
 
 #if defined(STRESS_EVENTFD)
@@ -1551,14 +2367,18 @@ typedef enum {
 	OPT_EXEC,
 	OPT_EXEC_OPS,
 	OPT_EXEC_MAX,
+	OPT_EXEC_TARGETS,
 #endif
 
 #if defined(STRESS_FALLOCATE)
 	OPT_FALLOCATE_OPS,
 	OPT_FALLOCATE_BYTES,
+	OPT_FALLOCATE_MATRIX,
+	OPT_FALLOCATE_GRAN,
 #endif
 	OPT_FAULT,
 	OPT_FAULT_OPS,
+	OPT_FAULT_CLASS,
 
 	OPT_FCNTL,
 	OPT_FCNTL_OPS,
@@ -1579,16 +2399,36 @@ typedef enum {
 
 	OPT_FLOCK,
 	OPT_FLOCK_OPS,
+	OPT_FLOCK_CONTENDERS,
 
 	OPT_FORK_OPS,
 	OPT_FORK_MAX,
+	OPT_FORK_LATENCY,
+	OPT_FORK_METHOD,
+	OPT_FORK_RSS,
+
+	OPT_FORKHEAP,
+	OPT_FORKHEAP_OPS,
+	OPT_FORKHEAP_BYTES,
+	OPT_FORKHEAP_COW,
+	OPT_FORKHEAP_THP,
+	OPT_FORKHEAP_VMAS,
 
 	OPT_FP_ERROR,
 	OPT_FP_ERROR_OPS,
 
+#if defined(STRESS_FRONTEND)
+	OPT_FRONTEND,
+	OPT_FRONTEND_OPS,
+	OPT_FRONTEND_MODE,
+	OPT_FRONTEND_SIZE,
+	OPT_FRONTEND_ENTROPY,
+#endif
+
 	OPT_FSTAT,
 	OPT_FSTAT_OPS,
 	OPT_FSTAT_DIR,
+	OPT_FSTAT_PTHREADS,
 
 #if defined(STRESS_FULL)
 	OPT_FULL,
@@ -1597,6 +2437,9 @@ typedef enum {
 
 	OPT_FUTEX,
 	OPT_FUTEX_OPS,
+	OPT_FUTEX_MODE,
+	OPT_FUTEX_WAITERS,
+	OPT_FUTEX_WAKE,
 
 	OPT_GET,
 	OPT_GET_OPS,
@@ -1604,11 +2447,13 @@ typedef enum {
 #if defined(STRESS_GETRANDOM)
 	OPT_GETRANDOM,
 	OPT_GETRANDOM_OPS,
+	OPT_GETRANDOM_SWEEP,
 #endif
 
 #if defined(STRESS_GETDENT)
 	OPT_GETDENT,
 	OPT_GETDENT_OPS,
+	OPT_GETDENT_ENTRIES,
 #endif
 
 #if defined(STRESS_HANDLE)
@@ -1616,10 +2461,30 @@ typedef enum {
 	OPT_HANDLE_OPS,
 #endif
 
+	OPT_HASH,
+	OPT_HASH_OPS,
+	OPT_HASH_METHOD,
+
+#if defined(STRESS_HASHMAP)
+	OPT_HASHMAP,
+	OPT_HASHMAP_OPS,
+	OPT_HASHMAP_METHOD,
+	OPT_HASHMAP_KEYS,
+	OPT_HASHMAP_READS,
+	OPT_HASHMAP_THREADS,
+	OPT_HASHMAP_ZIPF,
+#endif
+
 	OPT_HDD_BYTES,
 	OPT_HDD_WRITE_SIZE,
 	OPT_HDD_OPS,
 	OPT_HDD_OPTS,
+	OPT_HDD_ENGINE,
+	OPT_HDD_QD,
+	OPT_HDD_DIST,
+	OPT_HDD_RW_MIX,
+	OPT_HDD_PATHS,
+	OPT_HDD_STRIPE,
 
 #if defined(STRESS_HEAPSORT)
 	OPT_HEAPSORT,
@@ -1631,19 +2496,28 @@ typedef enum {
 	OPT_HSEARCH_OPS,
 	OPT_HSEARCH_SIZE,
 
+	OPT_HUGEPAGES,
+
 	OPT_ICACHE,
 	OPT_ICACHE_OPS,
 
 #if defined(STRESS_ICMP_FLOOD)
 	OPT_ICMP_FLOOD,
 	OPT_ICMP_FLOOD_OPS,
+	OPT_ICMP_FLOOD_BATCH,
+	OPT_ICMP_FLOOD_RECV,
+	OPT_ICMP_FLOOD_SWEEP,
 #endif
 
 	OPT_IGNITE_CPU,
+	OPT_IGNITE_CPU_LIST,
+	OPT_IGNITE_CPU_BASELINE,
 
 #if defined(STRESS_INOTIFY)
 	OPT_INOTIFY,
 	OPT_INOTIFY_OPS,
+	OPT_INOTIFY_WRITERS,
+	OPT_INOTIFY_API,
 #endif
 
 #if defined(STRESS_IONICE)
@@ -1651,6 +2525,26 @@ typedef enum {
 	OPT_IONICE_LEVEL,
 #endif
 
+#if defined(STRESS_IO_URING_NET)
+	OPT_IO_URING_NET,
+	OPT_IO_URING_NET_OPS,
+	OPT_IO_URING_NET_CONNS,
+	OPT_IO_URING_NET_DOMAIN,
+	OPT_IO_URING_NET_PORT,
+	OPT_IO_URING_NET_PROTO,
+	OPT_IO_URING_NET_SIZE,
+	OPT_IO_URING_NET_SQPOLL,
+#endif
+
+#if defined(STRESS_IOCMP)
+	OPT_IOCMP,
+	OPT_IOCMP_OPS,
+	OPT_IOCMP_BS,
+	OPT_IOCMP_QD,
+	OPT_IOCMP_READ_PCT,
+	OPT_IOCMP_SIZE,
+#endif
+
 #if defined(STRESS_IOPRIO)
 	OPT_IOPRIO,
 	OPT_IOPRIO_OPS,
@@ -1662,6 +2556,8 @@ typedef enum {
 	OPT_ITIMER_OPS,
 	OPT_ITIMER_FREQ,
 
+	OPT_JSON,
+
 #if defined(STRESS_KCMP)
 	OPT_KCMP,
 	OPT_KCMP_OPS,
@@ -1670,6 +2566,8 @@ typedef enum {
 #if defined(STRESS_KEY)
 	OPT_KEY,
 	OPT_KEY_OPS,
+	OPT_KEY_MAX,
+	OPT_KEY_SCALE,
 #endif
 
 	OPT_KILL,
@@ -1680,18 +2578,39 @@ typedef enum {
 	OPT_KLOG_OPS,
 #endif
 
+#if defined(STRESS_KSM)
+	OPT_KSM,
+	OPT_KSM_OPS,
+	OPT_KSM_BYTES,
+	OPT_KSM_DUP,
+#endif
+
+#if defined(STRESS_LATENCY)
+	OPT_LATENCY,
+#endif
+
 #if defined(STRESS_LEASE)
 	OPT_LEASE,
 	OPT_LEASE_OPS,
 	OPT_LEASE_BREAKERS,
 #endif
 
+#if defined(STRESS_LFQUEUE)
+	OPT_LFQUEUE,
+	OPT_LFQUEUE_OPS,
+	OPT_LFQUEUE_CONSUMERS,
+	OPT_LFQUEUE_PIN,
+	OPT_LFQUEUE_PRODUCERS,
+	OPT_LFQUEUE_TYPE,
+#endif
+
 	OPT_LINK,
 	OPT_LINK_OPS,
 
 #if defined(STRESS_LOCKBUS)
 	OPT_LOCKBUS,
 	OPT_LOCKBUS_OPS,
+	OPT_LOCKBUS_VICTIM,
 #endif
 
 #if defined(STRESS_LOCKA)
@@ -1710,6 +2629,9 @@ typedef enum {
 	OPT_LOCKOFD_OPS,
 #endif
 
+#if defined(STRESS_LOG_ASYNC)
+	OPT_LOG_ASYNC,
+#endif
 	OPT_LOG_BRIEF,
 	OPT_LOG_FILE,
 
@@ -1729,6 +2651,11 @@ typedef enum {
 	OPT_MALLOC_OPS,
 	OPT_MALLOC_BYTES,
 	OPT_MALLOC_MAX,
+	OPT_MALLOC_DIST,
+#if defined(HAVE_LIB_PTHREAD)
+	OPT_MALLOC_PTHREADS,
+	OPT_MALLOC_XFREE,
+#endif
 #if defined(STRESS_MALLOPT)
 	OPT_MALLOC_THRESHOLD,
 #endif
@@ -1736,6 +2663,7 @@ typedef enum {
 	OPT_MATRIX,
 	OPT_MATRIX_OPS,
 	OPT_MATRIX_SIZE,
+	OPT_MATRIX_THREADS,
 	OPT_MATRIX_METHOD,
 
 	OPT_MAXIMIZE,
@@ -1743,15 +2671,22 @@ typedef enum {
 #if defined(STRESS_MEMBARRIER)
 	OPT_MEMBARRIER,
 	OPT_MEMBARRIER_OPS,
+	OPT_MEMBARRIER_READERS,
+	OPT_MEMBARRIER_SYNC,
 #endif
 
 	OPT_MEMCPY,
 	OPT_MEMCPY_OPS,
+	OPT_MEMCPY_METHOD,
+	OPT_MEMCPY_SWEEP,
+	OPT_MEMCPY_BW,
 
 #if defined(STRESS_MEMFD)
 	OPT_MEMFD,
 	OPT_MEMFD_OPS,
 	OPT_MEMFD_BYTES,
+	OPT_MEMFD_IPC,
+	OPT_MEMFD_CONSUMERS,
 #endif
 
 #if defined(STRESS_MERGESORT)
@@ -1760,8 +2695,16 @@ typedef enum {
 	OPT_MERGESORT_INTEGERS,
 #endif
 
+	OPT_METADATA,
+	OPT_METADATA_OPS,
+	OPT_METADATA_LAYOUT,
+	OPT_METADATA_FILES,
+
 	OPT_METRICS_BRIEF,
 
+	OPT_MIGRATE,
+	OPT_MIGRATE_PERIOD,
+
 #if defined(STRESS_MINCORE)
 	OPT_MINCORE,
 	OPT_MINCORE_OPS,
@@ -1776,6 +2719,8 @@ typedef enum {
 #if defined(STRESS_MLOCK)
 	OPT_MLOCK,
 	OPT_MLOCK_OPS,
+	OPT_MLOCK_BYTES,
+	OPT_MLOCK_COST,
 #endif
 
 	OPT_MMAP,
@@ -1784,6 +2729,7 @@ typedef enum {
 	OPT_MMAP_FILE,
 	OPT_MMAP_ASYNC,
 	OPT_MMAP_MPROTECT,
+	OPT_MMAP_PREFAULT,
 
 #if defined(__linux__)
 	OPT_MMAPFORK,
@@ -1792,11 +2738,19 @@ typedef enum {
 
 	OPT_MMAPMANY,
 	OPT_MMAPMANY_OPS,
+	OPT_MMAPMANY_SCALE,
+
+#if defined(STRESS_MMAPLOCK)
+	OPT_MMAPLOCK,
+	OPT_MMAPLOCK_OPS,
+	OPT_MMAPLOCK_THREADS,
+#endif
 
 #if defined(STRESS_MREMAP)
 	OPT_MREMAP,
 	OPT_MREMAP_OPS,
 	OPT_MREMAP_BYTES,
+	OPT_MREMAP_GROW,
 #endif
 
 	OPT_MSG,
@@ -1812,10 +2766,17 @@ typedef enum {
 	OPT_MQ,
 	OPT_MQ_OPS,
 	OPT_MQ_SIZE,
+	OPT_MQ_SWEEP,
+	OPT_MQ_PRODUCERS,
+	OPT_MQ_CONSUMERS,
 #endif
 
+	OPT_NET_PEER,
+	OPT_NET_ROLE,
+
 	OPT_NICE,
 	OPT_NICE_OPS,
+	OPT_NICE_LEVELS,
 
 	OPT_NO_MADVISE,
 	OPT_NO_RAND_SEED,
@@ -1823,9 +2784,13 @@ typedef enum {
 	OPT_NULL,
 	OPT_NULL_OPS,
 
+	OPT_NUMA_PLACE,
+
 #if defined(STRESS_NUMA)
 	OPT_NUMA,
 	OPT_NUMA_OPS,
+	OPT_NUMA_BYTES,
+	OPT_NUMA_MIGRATE,
 #endif
 
 #if defined(STRESS_OOM_PIPE)
@@ -1842,13 +2807,24 @@ typedef enum {
 
 #if defined(STRESS_PAGE_IN)
 	OPT_PAGE_IN,
+	OPT_PAGE_RESIDENCY,
 #endif
 	OPT_PATHOLOGICAL,
 
 #if defined(STRESS_PERF_STATS)
 	OPT_PERF_STATS,
+	OPT_PERF_CONTENTION,
+	OPT_PROFILE,
 #endif
 
+	OPT_PIN,
+
+	OPT_PSI,
+
+	OPT_RAMP,
+	OPT_RAMP_FILE,
+	OPT_REPEAT,
+
 #if defined(STRESS_PERSONALITY)
 	OPT_PERSONALITY,
 	OPT_PERSONALITY_OPS,
@@ -1857,20 +2833,25 @@ typedef enum {
 	OPT_PIPE_OPS,
 #if defined(F_SETPIPE_SZ)
 	OPT_PIPE_SIZE,
+	OPT_PIPE_SWEEP,
 #endif
 	OPT_PIPE_DATA_SIZE,
 
 	OPT_POLL_OPS,
+	OPT_POLL_SCALE,
 
 #if defined(STRESS_PROCFS)
 	OPT_PROCFS,
 	OPT_PROCFS_OPS,
+	OPT_PROCFS_TOP,
 #endif
 
 #if defined(STRESS_PTHREAD)
 	OPT_PTHREAD,
 	OPT_PTHREAD_OPS,
 	OPT_PTHREAD_MAX,
+	OPT_PTHREAD_METHOD,
+	OPT_PTHREAD_STACK,
 #endif
 
 	OPT_PTRACE,
@@ -1879,6 +2860,8 @@ typedef enum {
 #if defined(STRESS_PTY)
 	OPT_PTY,
 	OPT_PTY_OPS,
+	OPT_PTY_DATA,
+	OPT_PTY_MAX,
 #endif
 
 	OPT_QSORT,
@@ -1891,12 +2874,15 @@ typedef enum {
 #if defined(STRESS_RDRAND)
 	OPT_RDRAND,
 	OPT_RDRAND_OPS,
+	OPT_RDRAND_METHOD,
+	OPT_RDRAND_SCALE,
 #endif
 
 #if defined(STRESS_READAHEAD)
 	OPT_READAHEAD,
 	OPT_READAHEAD_OPS,
 	OPT_READAHEAD_BYTES,
+	OPT_READAHEAD_SWEEP,
 #endif
 
 #if defined(STRESS_REMAP_FILE_PAGES)
@@ -1917,6 +2903,8 @@ typedef enum {
 #if defined(STRESS_RMAP)
 	OPT_RMAP,
 	OPT_RMAP_OPS,
+	OPT_RMAP_SHARERS,
+	OPT_RMAP_SCALE,
 #endif
 
 #if defined(STRESS_RTC)
@@ -1924,14 +2912,31 @@ typedef enum {
 	OPT_RTC_OPS,
 #endif
 
+#if defined(STRESS_SAMPLE)
+	OPT_SAMPLE,
+	OPT_SAMPLE_FILE,
+	OPT_SAMPLE_TEXTFILE,
+	OPT_CONVERGE,
+	OPT_CONVERGE_WINDOWS,
+#endif
+
 	OPT_SCHED,
 	OPT_SCHED_PRIO,
 
+#if defined(STRESS_SCHEDLAT)
+	OPT_SCHEDLAT,
+	OPT_SCHEDLAT_OPS,
+	OPT_SCHEDLAT_POLICY,
+	OPT_SCHEDLAT_MESSENGERS,
+	OPT_SCHEDLAT_THINK,
+#endif
+
 #if defined(STRESS_SCTP)
 	OPT_SCTP,
 	OPT_SCTP_OPS,
 	OPT_SCTP_DOMAIN,
 	OPT_SCTP_PORT,
+	OPT_SCTP_STREAMS,
 #endif
 
 #if defined(STRESS_SEAL)
@@ -1942,6 +2947,7 @@ typedef enum {
 #if defined(STRESS_SECCOMP)
 	OPT_SECCOMP,
 	OPT_SECCOMP_OPS,
+	OPT_SECCOMP_RULES,
 #endif
 
 	OPT_SEEK,
@@ -1957,6 +2963,7 @@ typedef enum {
 	OPT_SENDFILE,
 	OPT_SENDFILE_OPS,
 	OPT_SENDFILE_SIZE,
+	OPT_SENDFILE_SWEEP,
 #endif
 
 	OPT_SEMAPHORE_POSIX,
@@ -1983,6 +2990,9 @@ typedef enum {
 
 	OPT_SEQUENTIAL,
 
+	OPT_SMT_BENCH,
+	OPT_SMT_CPUS,
+
 #if defined(STRESS_SIGFD)
 	OPT_SIGFD,
 	OPT_SIGFD_OPS,
@@ -1997,6 +3007,7 @@ typedef enum {
 #if defined(STRESS_SIGQUEUE)
 	OPT_SIGQUEUE,
 	OPT_SIGQUEUE_OPS,
+	OPT_SIGQUEUE_METHOD,
 #endif
 
 	OPT_SIGSEGV,
@@ -2016,18 +3027,40 @@ typedef enum {
 	OPT_SOCKET_NODELAY,
 	OPT_SOCKET_OPTS,
 	OPT_SOCKET_PORT,
+	OPT_SOCKET_PEER,
+	OPT_SOCKET_ROLE,
 	OPT_SOCKET_TYPE,
+	OPT_SOCKET_MSG_SIZE,
+	OPT_SOCKET_MMSG_BATCH,
 
 #if defined(STRESS_SOCKET_FD)
 	OPT_SOCKET_FD,
 	OPT_SOCKET_FD_OPS,
 	OPT_SOCKET_FD_PORT,
+	OPT_SOCKET_FD_BATCH,
+	OPT_SOCKET_FD_SWEEP,
 #endif
 
 	OPT_SOCKET_PAIR,
 	OPT_SOCKET_PAIR_OPS,
 
+	OPT_SORT,
+	OPT_SORT_OPS,
+	OPT_SORT_DIST,
+	OPT_SORT_METHOD,
+	OPT_SORT_SIZE,
+	OPT_SORT_THREADS,
+
+#if defined(STRESS_SWAP)
+	OPT_SWAP,
+	OPT_SWAP_OPS,
+	OPT_SWAP_BYTES,
+	OPT_SWAP_LIMIT,
+#endif
+
 	OPT_SWITCH_OPS,
+	OPT_SWITCH_METHOD,
+	OPT_SWITCH_PIN,
 
 	OPT_SPAWN,
 	OPT_SPAWN_OPS,
@@ -2036,11 +3069,14 @@ typedef enum {
 	OPT_SPLICE,
 	OPT_SPLICE_OPS,
 	OPT_SPLICE_BYTES,
+	OPT_SPLICE_MODE,
+	OPT_SPLICE_CONSUMERS,
 #endif
 
 	OPT_STACK,
 	OPT_STACK_OPS,
 	OPT_STACK_FILL,
+	OPT_STACK_COST,
 
 #if defined(STRESS_STACKMMAP)
 	OPT_STACKMMAP,
@@ -2050,12 +3086,20 @@ typedef enum {
 	OPT_STR,
 	OPT_STR_OPS,
 	OPT_STR_METHOD,
+	OPT_STR_SEARCH,
+	OPT_STR_SEARCH_SIZE,
 
 	OPT_STREAM,
 	OPT_STREAM_OPS,
+	OPT_STREAM_ISA,
 	OPT_STREAM_L3_SIZE,
+	OPT_STREAM_NUMA,
+	OPT_STREAM_THREADS,
+	OPT_STREAM_BW,
 
 	OPT_STRESSORS,
+	OPT_STRESSOR_OFFSET,
+	OPT_STRESSOR_TIME,
 
 	OPT_SYMLINK,
 	OPT_SYMLINK_OPS,
@@ -2064,16 +3108,23 @@ typedef enum {
 	OPT_SYNC_FILE,
 	OPT_SYNC_FILE_OPS,
 	OPT_SYNC_FILE_BYTES,
+	OPT_SYNC_FILE_WAL,
 #endif
 
+	OPT_SYSCALL,
+	OPT_SYSCALL_OPS,
+
 	OPT_SYSINFO,
 	OPT_SYSINFO_OPS,
 
 #if defined(STRESS_SYSFS)
 	OPT_SYSFS,
 	OPT_SYSFS_OPS,
+	OPT_SYSFS_TOP,
 #endif
 
+	OPT_SYNC_START,
+	OPT_SYNC_START_AT,
 	OPT_SYSLOG,
 
 #if defined(STRESS_TEE)
@@ -2086,13 +3137,20 @@ typedef enum {
 	OPT_TEMP_PATH,
 
 	OPT_THERMAL_ZONES,
+#if defined(STRESS_THREADS)
+	OPT_THREADS,
+#endif
 #if defined(STRESS_THRASH)
 	OPT_THRASH,
+	OPT_THRASH_RECLAIM,
+	OPT_THRASH_RECLAIM_COLD,
 #endif
 
 #if defined(PRCTL_TIMER_SLACK)
 	OPT_TIMER_SLACK,
 #endif
+	OPT_TIMER_JITTER,
+	OPT_TIMER_JITTER_PRIO,
 
 #if defined(STRESS_TIMER)
 	OPT_TIMER_OPS,
@@ -2105,17 +3163,27 @@ typedef enum {
 	OPT_TIMERFD_OPS,
 	OPT_TIMERFD_FREQ,
 	OPT_TIMERFD_RAND,
+	OPT_TIMERFD_MASS,
 #endif
 	OPT_TIMES,
 
+#if defined(STRESS_TLB)
+	OPT_TLB,
+	OPT_TLB_OPS,
+	OPT_TLB_PAGES,
+	OPT_TLB_PAGE_SIZE,
+#endif
+
 #if defined(STRESS_TLB_SHOOTDOWN)
 	OPT_TLB_SHOOTDOWN,
 	OPT_TLB_SHOOTDOWN_OPS,
+	OPT_TLB_SHOOTDOWN_THREADS,
 #endif
 
 #if defined(STRESS_TSC)
 	OPT_TSC,
 	OPT_TSC_OPS,
+	OPT_TSC_SKEW,
 #endif
 
 	OPT_TSEARCH,
@@ -2126,6 +3194,9 @@ typedef enum {
 	OPT_UDP_OPS,
 	OPT_UDP_PORT,
 	OPT_UDP_DOMAIN,
+	OPT_UDP_BATCH,
+	OPT_UDP_GSO,
+	OPT_UDP_GRO,
 #if defined(IPPROTO_UDPLITE)
 	__OPT_UDP_LITE,
 #define OPT_UDP_LITE __OPT_UDP_LITE
@@ -2137,9 +3208,18 @@ typedef enum {
 	OPT_UDP_FLOOD_DOMAIN,
 #endif
 
+#if defined(STRESS_ULOCK)
+	OPT_ULOCK,
+	OPT_ULOCK_OPS,
+	OPT_ULOCK_CS,
+	OPT_ULOCK_METHOD,
+	OPT_ULOCK_THREADS,
+#endif
+
 #if defined(STRESS_UNSHARE)
 	OPT_UNSHARE,
 	OPT_UNSHARE_OPS,
+	OPT_UNSHARE_CONTAINER,
 #endif
 
 #if defined(STRESS_URANDOM)
@@ -2150,6 +3230,12 @@ typedef enum {
 	OPT_USERFAULTFD,
 	OPT_USERFAULTFD_OPS,
 	OPT_USERFAULTFD_BYTES,
+#if defined(HAVE_LIB_PTHREAD)
+	OPT_USERFAULTFD_FAULTERS,
+	OPT_USERFAULTFD_HANDLERS,
+	OPT_USERFAULTFD_MODE,
+	OPT_USERFAULTFD_PREFAULT,
+#endif
 #endif
 
 	OPT_UTIME,
@@ -2159,6 +3245,7 @@ typedef enum {
 #if defined(STRESS_VECMATH)
 	OPT_VECMATH,
 	OPT_VECMATH_OPS,
+	OPT_VECMATH_METHOD,
 #endif
 
 	OPT_VERIFY,
@@ -2177,14 +3264,18 @@ typedef enum {
 #endif
 #ifdef MAP_LOCKED
 	OPT_VM_MMAP_LOCKED,
+	OPT_VM_HUGEPAGE,
 #endif
 	OPT_VM_OPS,
 	OPT_VM_METHOD,
+	OPT_VM_THREADS,
+	OPT_VM_HAMMER_RATE,
 
 #if defined(STRESS_VM_RW)
 	OPT_VM_RW,
 	OPT_VM_RW_OPS,
 	OPT_VM_RW_BYTES,
+	OPT_VM_RW_SWEEP,
 #endif
 
 #if defined(STRESS_VM_SPLICE)
@@ -2198,6 +3289,17 @@ typedef enum {
 	OPT_WAIT_OPS,
 #endif
 
+#if defined(STRESS_WAKEUP)
+	OPT_WAKEUP,
+	OPT_WAKEUP_OPS,
+	OPT_WAKEUP_METHOD,
+	OPT_WAKEUP_CPUS,
+#endif
+
+#if defined(STRESS_WARMUP)
+	OPT_WARMUP,
+#endif
+
 	OPT_WCS,
 	OPT_WCS_OPS,
 	OPT_WCS_METHOD,
@@ -2205,6 +3307,7 @@ typedef enum {
 #if defined(STRESS_XATTR)
 	OPT_XATTR,
 	OPT_XATTR_OPS,
+	OPT_XATTR_SWEEP,
 #endif
 
 #if defined(STRESS_YIELD)
@@ -2217,11 +3320,20 @@ typedef enum {
 #if defined(STRESS_ZLIB)
 	OPT_ZLIB,
 	OPT_ZLIB_OPS,
+	OPT_ZLIB_BLOCK_SIZE,
+	OPT_ZLIB_ENGINE,
+	OPT_ZLIB_LEVEL,
+	OPT_ZLIB_RAND_DATA,
+	OPT_ZLIB_THREADS,
 #endif
 
 	OPT_ZOMBIE,
 	OPT_ZOMBIE_OPS,
 	OPT_ZOMBIE_MAX,
+	OPT_ZOMBIE_REAP,
+
+	/* OPT_MAX must be last one */
+	OPT_MAX
 } stress_op;
 
 /* stress test metadata */
@@ -2232,13 +3344,19 @@ typedef struct {
 	const stress_op op;		/* ops option */
 	const char *name;		/* name of stress test */
 	const uint32_t class;		/* class of stress test */
+	const bool thread_safe;		/* instances can run as threads */
+	const char *unit;		/* normalised work unit, NULL if none */
 } stress_t;
 
 typedef struct {
 	pid_t	*pids;			/* process id */
 	int32_t started_procs;		/* count of started processes */
 	int32_t num_procs;		/* number of process per stressor */
+	int32_t stats_index;		/* first slot in the shared stats */
+	int32_t stats_count;		/* slots, and pids, of the stressor */
 	uint64_t bogo_ops;		/* number of bogo ops */
+	uint64_t start_offset;		/* --stressor-offset, secs */
+	uint64_t run_time;		/* --stressor-time, secs */
 	bool	exclude;		/* true if excluded */
 } proc_info_t;
 
@@ -2261,6 +3379,7 @@ typedef struct cpu_cache {
 	uint64_t           size;      /* bytes */
 	uint32_t           line_size; /* bytes */
 	uint32_t           ways;
+	int32_t            shared_cpu; /* lowest CPU sharing it, -1 = unknown */
 } cpu_cache_t;
 
 struct generic_map {
@@ -2273,6 +3392,10 @@ typedef struct cpu {
 	bool           online;
 	uint32_t       cache_count;
 	cpu_cache_t   *caches;
+	int32_t        id;         /* N of the sysfs cpuN name */
+	int32_t        core_id;    /* -1 = unknown */
+	int32_t        package_id; /* -1 = unknown */
+	int32_t        llc_id;     /* lowest CPU sharing the last level cache */
 } cpu_t;
 
 typedef struct cpus {
@@ -2287,10 +3410,13 @@ extern shared_t *shared;		/* shared memory */
 extern uint64_t	opt_timeout;		/* timeout in seconds */
 extern uint64_t	opt_flags;		/* option flags */
 extern int32_t opt_sequential;		/* Number of sequential iterations */
+extern int32_t opt_timer_jitter_prio;	/* SCHED_FIFO priority of timer stressors */
 extern volatile bool opt_do_run;	/* false to exit stressor */
 extern volatile bool opt_sigint;	/* true if stopped by SIGINT */
-extern mwc_t __mwc;			/* internal mwc random state */
+extern __thread mwc_t __mwc;		/* internal mwc random state */
 extern pid_t pgrp;			/* proceess group leader */
+extern __thread proc_stats_t *stress_stats; /* stats of this stressor instance */
+extern __thread bool stress_thread_instance; /* instance runs as a thread */
 
 /* syscall shims not provided by glibc */
 extern int sys_ioprio_set(int which, int who, int ioprio);
@@ -2417,22 +3543,218 @@ extern int perf_open(stress_perf_t *sp);
 extern int perf_enable(stress_perf_t *sp);
 extern int perf_disable(stress_perf_t *sp);
 extern int perf_close(stress_perf_t *sp);
+extern int perf_open_by_id(const int id);
+extern int perf_open_cpu_by_id(const int id, const int cpu);
+extern int perf_read_by_fd(const int fd, uint64_t *counter);
+extern int perf_open_pmu_event(const char *pmu, const char *event,
+	const int cpu, double *scale);
 extern int perf_get_counter_by_index(const stress_perf_t *sp, const int index, uint64_t *counter, int *id);
 extern int perf_get_counter_by_id(const stress_perf_t *sp, int id, uint64_t *counter, int *index);
 extern bool perf_stat_succeeded(const stress_perf_t *sp);
 extern const char *perf_get_label_by_index(const int i);
 extern const char *perf_stat_scale(const uint64_t counter, const double duration);
-extern void perf_stat_dump(FILE *yaml, const stress_t stressors[], const proc_info_t procs[STRESS_MAX],
-	const int32_t max_procs, const double duration);
+extern void perf_stat_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX], const double duration);
 extern void perf_init(void);
-#endif
+extern void perf_contention_start(stress_perf_t *sp);
+extern void perf_contention_stop(void);
+extern void perf_contention_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX], const double duration);
+extern void perf_profile_init(const stress_t stressors[], const proc_info_t procs[STRESS_MAX]);
+extern void perf_profile_start(void);
+extern void perf_profile_stop(const char *name);
+extern void perf_profile_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+#if defined(STRESS_SAMPLE)
+extern void perf_sample_start(stress_perf_t *sp);
+extern void perf_sample_stop(void);
+extern int perf_get_live_by_id(const stress_perf_t *sp, const int id, uint64_t *counter);
+#endif
+#endif
+
+/* Bandwidth pacing, holds a steady bytes/sec rate */
+typedef struct {
+	double start;			/* time pacing started */
+	double bytes;			/* bytes moved since start */
+	double rate;			/* target bytes/sec, 0 = no pacing */
+} bw_pace_t;
 
 extern double time_now(void);
+extern uint64_t time_mono_ns(void);
+extern void time_calibrate(void);
 extern const char *duration_to_str(const double duration);
+extern void bw_pace_init(bw_pace_t *pace, const double rate);
+extern void bw_pace(bw_pace_t *pace, const uint64_t bytes);
+
+/*
+ *  time_ticks()
+ *	cheap raw time stamp; invariant TSC on x86, CNTVCT on arm64,
+ *	CLOCK_MONOTONIC_RAW in ns if time_calibrate() found neither
+ */
+static inline uint64_t time_ticks(void)
+{
+	if (shared && shared->timebase.counter) {
+#if defined(STRESS_X86)
+		uint32_t lo, hi;
+
+		asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+		return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+		uint64_t v;
+
+		asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+		return v;
+#endif
+	}
+	{
+		struct timespec ts;
+
+#if defined(CLOCK_MONOTONIC_RAW)
+		if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts) < 0)
+#else
+		if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+#endif
+			return 0;
+		return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+	}
+}
+
+/*
+ *  time_ticks_to_ns()
+ *	convert a time_ticks() value or difference to nanoseconds
+ */
+static inline uint64_t time_ticks_to_ns(const uint64_t ticks)
+{
+	if (shared && shared->timebase.counter)
+		return (uint64_t)((double)ticks * shared->timebase.ns_per_tick);
+	return ticks;
+}
+
+/*
+ *  time_now_ns()
+ *	monotonic time in nanoseconds from the calibrated time base
+ */
+static inline uint64_t time_now_ns(void)
+{
+	return time_ticks_to_ns(time_ticks());
+}
+
+/* Minimal raw io_uring rings, no liburing dependency */
+#if defined(__linux__) && defined(HAVE_IO_URING)
+#define STRESS_URING		(1)
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+typedef struct {
+	int fd;				/* ring fd */
+	bool sqpoll;			/* kernel polls the SQ */
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_flags;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ring;
+	void *cq_ring;
+	size_t sq_ring_sz;
+	size_t cq_ring_sz;
+	size_t sqes_sz;
+	unsigned sqe_tail;		/* next free SQE */
+	unsigned sqe_head;		/* SQEs published to the kernel */
+	uint64_t enters;		/* io_uring_enter calls */
+	uint64_t submits;		/* io_uring_enter calls with SQEs */
+	uint64_t submitted;		/* SQEs submitted */
+} stress_uring_t;
+
+extern int uring_setup(stress_uring_t *r, const unsigned entries, const bool sqpoll);
+extern void uring_free(stress_uring_t *r);
+extern int uring_submit(stress_uring_t *r, const unsigned wait_nr);
+extern struct io_uring_sqe *uring_sqe(stress_uring_t *r);
+extern struct io_uring_sqe *uring_prep_rw(stress_uring_t *r, const uint8_t opcode,
+	const int fd, const void *addr, const uint32_t len, const uint64_t off,
+	const uint64_t user_data);
+extern int uring_register_buffer(stress_uring_t *r, void *buf, const size_t len);
+extern int uring_register_files(stress_uring_t *r, const int *fds, const unsigned n);
+#endif
+
+/* Device I/O and writeback accounting for file stressors */
+typedef struct {
+	bool task_ok;			/* /proc/self/io was read */
+	bool vm_ok;			/* /proc/vmstat was read */
+	uint64_t rchar;			/* bytes read via syscalls */
+	uint64_t wchar;			/* bytes written via syscalls */
+	uint64_t read_bytes;		/* bytes read from the device */
+	uint64_t write_bytes;		/* bytes sent to the device */
+	uint64_t cancelled_write_bytes;	/* dirty bytes dropped by truncation */
+	uint64_t pgpgin;		/* system KB paged in */
+	uint64_t pgpgout;		/* system KB paged out */
+	uint64_t nr_dirty;		/* system dirty pages */
+	uint64_t nr_writeback;		/* system pages under writeback */
+} stress_io_stats_t;
+
+extern void io_stats_begin(stress_io_stats_t *start);
+extern void io_stats_end(const stress_io_stats_t *start, const uint64_t ops);
+extern bool io_stats_get(stress_io_stats_t *s);
+
+/* Aligned, pre-faulted buffers for O_DIRECT I/O */
+typedef struct {
+	void *map;			/* the mapping */
+	size_t map_size;		/* bytes mapped */
+	uint8_t *base;			/* first buffer */
+	size_t size;			/* bytes asked for in each buffer */
+	size_t stride;			/* distance between buffers */
+	uint32_t count;			/* number of buffers */
+	size_t mem_align;		/* buffer address alignment */
+	size_t io_align;		/* I/O size and offset alignment */
+} io_buffers_t;
+
+extern void io_direct_align(const char *path, size_t *mem_align, size_t *io_align);
+extern int io_buffers_alloc(io_buffers_t *bufs, const char *path,
+	const size_t size, const uint32_t count);
+extern void io_buffers_free(io_buffers_t *bufs);
+
+/*
+ *  io_buffer()
+ *	the i'th buffer of a set from io_buffers_alloc()
+ */
+static inline uint8_t *io_buffer(const io_buffers_t *bufs, const uint32_t i)
+{
+	return bufs->base + ((size_t)i * bufs->stride);
+}
+
+/* Per file read latencies for the procfs and sysfs stressors */
+typedef struct stress_path_stat {
+	struct stress_path_stat *next;	/* next in hash chain */
+	char *path;			/* file path */
+	uint64_t reads;			/* number of timed reads */
+	double total;			/* total read time in seconds */
+	double max;			/* slowest read in seconds */
+} stress_path_stat_t;
+
+typedef struct {
+	stress_path_stat_t **table;	/* hash table of paths */
+	size_t count;			/* number of paths */
+} stress_path_stats_t;
+
+extern int path_stats_init(stress_path_stats_t *ps);
+extern void path_stats_add(stress_path_stats_t *ps, const char *path,
+	const double secs);
+extern void path_stats_read(stress_path_stats_t *ps, const char *path);
+extern void path_stats_report(const char *name, const uint32_t instance,
+	const stress_path_stats_t *ps, const uint32_t top);
+extern void path_stats_free(stress_path_stats_t *ps);
 
 /* Misc settings helpers */
 extern void set_oom_adjustment(const char *name, const bool killable);
 extern void set_sched(const int32_t sched, const int32_t sched_priority);
+extern void timer_jitter_sched(void);
+extern int sched_set_deadline(const uint64_t runtime, const uint64_t deadline,
+	const uint64_t period);
 extern void set_iopriority(const int32_t class, const int32_t level);
 extern void set_proc_name(const char *name);
 
@@ -2453,9 +3775,70 @@ extern void check_value(const char *const msg, const int val);
 extern void check_range(const char *const opt, const uint64_t val,
 	const uint64_t lo, const uint64_t hi);
 extern WARN_UNUSED int set_cpu_affinity(char *const arg);
+#if defined(__linux__)
+extern int stress_parse_cpulist(const char *opt_name, char *const arg,
+	cpu_set_t *set);
+#endif
+extern int stress_set_numa_place(const char *name);
+extern void stress_numa_place_init(void);
+extern void stress_numa_place(const char *name, const uint32_t index);
+#if defined(STRESS_NUMA_BIND)
+extern int numa_node_list(int *nodes, const int max);
+extern int numa_node_cpus(const int node, const cpu_set_t *allowed,
+	cpu_set_t *set);
+extern int numa_bind(void *addr, const size_t len, const int node);
+#endif
+extern int stress_set_migrate(const char *name);
+extern void stress_set_migrate_period(const char *optarg);
+extern void stress_migrate_init(void);
+extern bool stress_migrate_enabled(void);
+extern void stress_migrate_pid(const pid_t pid, const uint32_t k);
+extern uint64_t stress_migrate_period_usec(void);
+extern void stress_migrate_tick(void);
+extern void stress_migrate_next(void);
+extern void stress_migrate_dump(FILE *yaml, json_t *json, const double duration);
+extern int stress_set_pin(const char *name);
+extern void stress_pin_init(void);
+extern void stress_pin(const char *name, const uint32_t instance);
+extern int stress_set_ramp(const char *optarg);
+extern void stress_set_ramp_file(const char *optarg);
+extern bool stress_ramp_enabled(void);
+extern int stress_ramp_steps(void);
+extern int stress_ramp_init(const stress_t stressors[], proc_info_t procs[STRESS_MAX]);
+extern int32_t stress_ramp_step(const uint32_t step, proc_info_t procs[STRESS_MAX]);
+extern void stress_ramp_record(const uint32_t step, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+extern void stress_ramp_dump(FILE *yaml, json_t *json, const stress_t stressors[]);
+extern void stress_ramp_free(void);
+extern void stress_set_smt_bench(void);
+extern int stress_set_smt_cpus(const char *optarg);
+extern bool stress_smt_enabled(void);
+extern int stress_smt_steps(void);
+extern int stress_smt_init(const stress_t stressors[], proc_info_t procs[STRESS_MAX]);
+extern int32_t stress_smt_step(const uint32_t step, const stress_t stressors[],
+	proc_info_t procs[STRESS_MAX]);
+extern void stress_smt_pin(const char *name, const int32_t stressor, const uint32_t instance);
+extern void stress_smt_record(const uint32_t step, const proc_info_t procs[STRESS_MAX]);
+extern void stress_smt_dump(FILE *yaml, json_t *json, const stress_t stressors[]);
+extern void stress_smt_free(void);
+extern void stress_set_repeat(const char *optarg);
+extern uint32_t stress_repeat_trials(void);
+extern void stress_repeat_trial(const uint32_t trial, proc_info_t procs[STRESS_MAX]);
+extern void stress_repeat_record(const proc_info_t procs[STRESS_MAX]);
+extern void stress_repeat_dump(FILE *yaml, json_t *json, const stress_t stressors[]);
+extern void stress_repeat_free(void);
+extern int stress_job_expand(int *argc, char ***argv);
+extern void stress_set_compare(const char *optarg);
+extern void stress_set_compare_threshold(const char *optarg);
+extern bool stress_compare_enabled(void);
+extern int stress_compare_init(void);
+extern int stress_compare(FILE *yaml);
+extern void stress_compare_free(void);
 
 /* Misc helper funcs */
 extern void stress_unmap_shared(void);
+extern void stress_stats_clear(void);
+extern void stress_stats_clear_slots(const int32_t first, const int32_t count);
 extern void log_system_mem_info(void);
 extern WARN_UNUSED char *munge_underscore(const char *str);
 extern size_t stress_get_pagesize(void);
@@ -2471,20 +3854,27 @@ extern int stress_process_dumpable(const bool dumpable);
 extern void stress_set_timer_slack_ns(const char *optarg);
 extern void stress_set_timer_slack(void);
 extern WARN_UNUSED int stress_set_temp_path(char *path);
+extern const char *stress_get_temp_path(void);
 extern void stress_strnrnd(char *str, const size_t len);
 extern void stress_get_cache_size(uint64_t *l2, uint64_t *l3);
 extern WARN_UNUSED unsigned int stress_get_cpu(void);
 extern WARN_UNUSED int stress_cache_alloc(const char *name);
 extern void stress_cache_free(void);
-extern void ignite_cpu_start(void);
-extern void ignite_cpu_stop(void);
+extern void stress_set_ignite_cpu_list(const char *optarg);
+extern void stress_set_ignite_cpu_baseline(const char *optarg);
+extern void ignite_cpu_start(const proc_info_t procs[STRESS_MAX]);
+extern void ignite_cpu_stop(const proc_info_t procs[STRESS_MAX]);
+extern void ignite_cpu_dump(FILE *yaml, json_t *json, const stress_t stressors[]);
 extern int system_write(const char *path, const char *buf, const size_t buf_len);
+extern int stress_drop_caches(void);
 extern WARN_UNUSED int stress_set_nonblock(const int fd);
 extern WARN_UNUSED int system_read(const char *path, char *buf, const size_t buf_len);
 extern WARN_UNUSED uint64_t stress_get_prime64(const uint64_t n);
 extern WARN_UNUSED size_t stress_get_file_limit(void);
 extern WARN_UNUSED int stress_sighandler(const char *name, const int signum, void (*handler)(int), struct sigaction *orig_action);
 extern int stress_sigrestore(const char *name, const int signum, struct sigaction *orig_action);
+extern void stress_misc_metric_set(const size_t idx, const char *description, const double value);
+extern void stress_units_per_op(const double units);
 
 /*
  *  Indicate a stress test failed because of limited resources
@@ -2528,8 +3918,43 @@ static inline WARN_UNUSED uint32_t warn_once(const uint32_t flag)
 
 /* Memory tweaking */
 extern int madvise_random(void *addr, const size_t length);
+
+typedef enum {
+	HUGEPAGES_NONE = 0,	/* system default, THP as set in sysfs */
+	HUGEPAGES_THP,		/* madvise MADV_HUGEPAGE */
+	HUGEPAGES_2M,		/* hugetlbfs 2MB pages */
+	HUGEPAGES_1G,		/* hugetlbfs 1GB pages */
+} hugepages_t;
+
+extern int stress_set_hugepages(const char *name);
+extern hugepages_t stress_get_hugepages(void);
+extern size_t hugepages_round(const hugepages_t mode, const size_t length);
+extern int madvise_hugepages(const hugepages_t mode, void *addr, const size_t length);
+extern void *mmap_hugepages(const hugepages_t mode, const size_t length,
+	const int prot, const int flags, const int fd);
+extern uint64_t hugepages_mapped(const void *addr, const size_t length);
+extern void hugepages_metric_set(const uint64_t pages);
 extern int mincore_touch_pages(void *buf, const size_t buf_len);
 
+/* --page-residency samples of the fraction of a mapping in core */
+typedef struct {
+	double t_start;			/* time of mincore_residency_init */
+	double t_next;			/* next sample is due */
+	uint64_t samples;		/* samples taken */
+	double sum;			/* sum of the resident fractions */
+	double min;			/* lowest resident fraction */
+	double last;			/* latest resident fraction */
+	uint64_t low;			/* samples under 50% resident */
+	uint64_t high;			/* samples 90% or more resident */
+	uint64_t minflt;		/* minor faults at init */
+	uint64_t majflt;		/* major faults at init */
+} mincore_residency_t;
+
+extern void mincore_residency_init(mincore_residency_t *r);
+extern void mincore_residency_sample(mincore_residency_t *r,
+	void *buf, const size_t buf_len);
+extern void mincore_residency_metrics_set(const mincore_residency_t *r);
+
 /* Mounts */
 extern void mount_free(char *mnts[], const int n);
 extern WARN_UNUSED int mount_get(char *mnts[], const int max);
@@ -2539,14 +3964,161 @@ extern WARN_UNUSED int mount_get(char *mnts[], const int max);
 extern int tz_init(tz_info_t **tz_info_list);
 extern void tz_free(tz_info_t **tz_info_list);
 extern int tz_get_temperatures(tz_info_t **tz_info_list, stress_tz_t *tz);
-extern void tz_dump(FILE *fp, const stress_t stressors[],
-	const proc_info_t procs[STRESS_MAX], const int32_t max_procs);
+extern void tz_sample_start(void);
+extern void tz_sample_stop(void);
+extern void tz_dump(FILE *fp, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+#endif
+
+#if defined(STRESS_CPUFREQ)
+/* CPU frequency and idle state residency */
+extern void cpufreq_init(void);
+extern void cpufreq_start(stress_cpufreq_t *cf);
+extern void cpufreq_stop(stress_cpufreq_t *cf);
+extern void cpufreq_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+#endif
+
+#if defined(STRESS_SAMPLE)
+/* bogo op counter sampling */
+extern uint64_t opt_sample_interval;		/* sample interval in ms */
+
+extern void stress_set_sample_interval(const char *optarg);
+extern void stress_set_sample_file(const char *optarg);
+extern void stress_set_sample_textfile(const char *optarg);
+extern void stress_set_converge(const char *optarg);
+extern void stress_set_converge_windows(const char *optarg);
+extern int sample_start(const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+extern void sample_stop(void);
+extern void sample_dump(FILE *yaml, json_t *json, const stress_t stressors[]);
+extern void sample_free(void);
+#endif
+
+#if defined(STRESS_WARMUP)
+/* warm-up time excluded from the metrics */
+extern uint64_t opt_warmup;			/* warm-up time in seconds */
+
+extern void stress_set_warmup(const char *optarg);
+extern void warmup_start(const int32_t slot);
+extern void warmup_stop(proc_stats_t *stats);
+#endif
+
+#if defined(STRESS_LATENCY)
+/* per-operation latency sampling */
+extern __thread stress_latency_t *stress_latency; /* histogram of this instance */
+extern uint64_t opt_latency;			/* sample every Nth op */
+
+extern void stress_set_latency(const char *optarg);
+extern void latency_record(stress_latency_t *lat, const uint64_t ns);
+extern uint64_t latency_percentile(const stress_latency_t *lat,
+	const double fraction);
+extern void latency_metrics_set(const stress_latency_t *lat, const char *what);
+extern double latency_percentile_usec(const stress_latency_t *lat,
+	const double fraction);
+extern void latency_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+extern void stress_pin_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+extern int stress_set_cgroup(const char *name);
+extern int stress_set_cgroup_cpu_max(const char *str);
+extern void stress_set_cgroup_memory_max(const char *optarg);
+extern int stress_set_cgroup_io_max(const char *str);
+extern int stress_cgroup_self(char *path, const size_t len);
+extern void stress_cgroup_init(void);
+extern void stress_cgroup_enter(const char *name, const uint32_t instance);
+extern int stress_cgroup_leaf(char *path, const size_t len, const char *name,
+	const uint32_t instance);
+extern void stress_cgroup_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+extern void stress_cgroup_free(void);
+
+extern int stress_set_resctrl(const char *str);
+extern void stress_resctrl_init(void);
+extern void stress_resctrl_enter(const char *name);
+extern void stress_resctrl_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+extern void stress_resctrl_free(void);
+
+extern void stress_energy_init(void);
+extern void stress_energy_start(void);
+extern void stress_energy_stop(const proc_info_t procs[STRESS_MAX]);
+extern bool stress_energy_get(const int32_t i, double *joules, double *watts);
+extern void stress_energy_domains_dump(FILE *yaml, json_t *json, const int32_t i);
+extern void stress_energy_free(void);
+
+extern void stress_usage_get(proc_usage_t *usage);
+extern void stress_usage_get_io(proc_usage_t *usage);
+extern void stress_usage_metrics(FILE *yaml, json_t *json, const int32_t i,
+	const proc_info_t procs[STRESS_MAX]);
+extern void stress_usage_dump(const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+
+extern void stress_set_irq_stats(const char *opt);
+extern void stress_irq_init(const int32_t slots);
+extern void stress_irq_start(const proc_info_t procs[STRESS_MAX]);
+extern void stress_irq_stop(void);
+extern void stress_irq_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+extern void stress_irq_free(void);
+
+extern void stress_psi_init(void);
+extern void stress_psi_start(void);
+extern void stress_psi_stop(const proc_info_t procs[STRESS_MAX]);
+extern void stress_psi_dump(FILE *yaml, json_t *json, const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX]);
+
+/*
+ *  latency_begin()
+ *	start timing an op if latency sampling is enabled
+ *	and this is every Nth op, returns 0 if not timing
+ */
+static inline uint64_t latency_begin(const uint64_t counter)
+{
+	if (!stress_latency || (counter % opt_latency))
+		return 0;
+	return time_ticks();
+}
+
+/*
+ *  latency_end()
+ *	stop timing an op started with latency_begin()
+ */
+static inline void latency_end(const uint64_t t_start)
+{
+	if (!t_start)
+		return;
+	latency_record(stress_latency, time_ticks_to_ns(time_ticks() - t_start));
+}
+#else
+static inline uint64_t latency_begin(const uint64_t counter)
+{
+	(void)counter;
+
+	return 0;
+}
+
+static inline void latency_end(const uint64_t t_start)
+{
+	(void)t_start;
+}
 #endif
 
 /* Network helpers */
 
 #define NET_ADDR_ANY		(0)
 #define NET_ADDR_LOOPBACK	(1)
+#define NET_ADDR_PEER		(2)	/* --net-peer, else loopback */
+
+#define NET_ROLE_BOTH		(0)	/* client and server on this host */
+#define NET_ROLE_CLIENT		(1)	/* client to a --net-peer server */
+#define NET_ROLE_SERVER		(2)	/* server for remote clients */
+
+extern int stress_set_net_peer(const char *optarg);
+extern int stress_set_net_role(const char *optarg);
+extern int stress_set_sock_peer(const char *optarg);
+extern int stress_net_role(void);
+extern int stress_net_client_wait(const pid_t pid);
 
 extern void stress_set_net_port(const char *optname, const char *optarg,
 	const int min_port, const int max_port, int *port);
@@ -2572,6 +4144,8 @@ extern void free_cpu_caches(cpus_t *cpus);
 
 extern int  thrash_start(void);
 extern void thrash_stop(void);
+extern void stress_set_thrash_reclaim(const char *optarg);
+extern void stress_set_thrash_reclaim_cold(void);
 
 /* Used to set options for specific stressors */
 extern void stress_adjust_pthread_max(uint64_t max);
@@ -2579,87 +4153,282 @@ extern void stress_adjust_sleep_max(uint64_t max);
 extern int  stress_apparmor_supported(void);
 extern void stress_set_aio_requests(const char *optarg);
 extern void stress_set_aio_linux_requests(const char *optarg);
+extern void stress_set_aio_linux_sweep(void);
+extern int  stress_set_arena_method(const char *name);
+extern void stress_set_arena_objects(const char *optarg);
+extern void stress_set_arena_size(const char *optarg);
+extern void stress_set_arena_tcache(void);
+extern void stress_set_arena_threads(const char *optarg);
+extern void stress_set_aio_linux_min_nr(const char *optarg);
 extern void stress_set_bigheap_growth(const char *optarg);
 extern void stress_set_bsearch_size(const char *optarg);
+extern int  stress_set_bsearch_method(const char *name);
+extern void stress_set_bsearch_sweep(void);
+extern void stress_set_clock_cost(void);
 extern void stress_set_clone_max(const char *optarg);
+extern void stress_set_compact_bytes(const char *optarg);
+extern void stress_set_compact_keep(const char *optarg);
+extern void stress_set_compact_pin(const char *optarg);
+extern void stress_set_context_compare(void);
 extern void stress_set_copy_file_bytes(const char *optarg);
+extern void stress_set_copy_file_sweep(void);
 extern void stress_set_cpu_load(const char *optarg);
 extern void stress_set_cpu_load_slice(const char *optarg);
+extern void stress_set_cpu_load_period(const char *optarg);
+extern int  stress_set_cpu_load_profile(const char *name);
+extern int  stress_set_cacheline_layout(const char *name);
+extern int  stress_set_cacheline_op(const char *name);
+extern void stress_set_cacheline_matrix(const char *optarg);
+extern void stress_cacheline_matrix_dump(FILE *yaml, json_t *json);
 extern int  stress_set_cpu_method(const char *name);
+extern int  stress_set_crypt_method(const char *name);
+extern void stress_set_crypt_rounds(const char *optarg);
+extern void stress_set_cpu_avx_interfere(void);
+extern void stress_set_cpu_online_impact(void);
+extern void stress_cpu_method_dump(FILE *yaml, json_t *json);
+extern void stress_cpu_interfere_dump(FILE *yaml, json_t *json);
 extern void stress_set_dentries(const char *optarg);
 extern int  stress_set_dentry_order(const char *optarg);
+extern int  stress_set_dsp_method(const char *name);
+extern int  stress_set_dsp_sizes(const char *optarg);
+extern void stress_set_dentry_negative(void);
 extern void stress_set_epoll_port(const char *optarg);
 extern int  stress_set_epoll_domain(const char *optarg);
+extern void stress_set_epoll_conns(const char *optarg);
+extern void stress_set_io_uring_net_conns(const char *optarg);
+extern int  stress_set_io_uring_net_domain(const char *name);
+extern void stress_set_io_uring_net_port(const char *optarg);
+extern int  stress_set_io_uring_net_proto(const char *name);
+extern void stress_set_io_uring_net_size(const char *optarg);
+extern void stress_set_io_uring_net_sqpoll(void);
+extern void stress_set_iocmp_bs(const char *optarg);
+extern void stress_set_iocmp_qd(const char *optarg);
+extern void stress_set_iocmp_read_pct(const char *optarg);
+extern void stress_set_iocmp_size(const char *optarg);
+extern void stress_set_epoll_threads(const char *optarg);
 extern void stress_set_exec_max(const char *optarg);
+extern int  stress_set_exec_targets(const char *optarg);
 extern void stress_set_fallocate_bytes(const char *optarg);
+extern void stress_set_fallocate_gran(const char *optarg);
+extern void stress_set_fallocate_matrix(void);
+extern int stress_set_fault_class(const char *name);
 extern void stress_set_fifo_readers(const char *optarg);
 extern int  stress_filename_opts(const char *opt);
 extern void stress_set_fiemap_size(const char *optarg);
 extern void stress_set_fork_max(const char *optarg);
+extern void stress_set_fork_latency(void);
+extern int  stress_set_fork_method(const char *name);
+extern void stress_set_fork_rss(const char *optarg);
+extern void stress_set_forkheap_bytes(const char *optarg);
+extern void stress_set_forkheap_cow(const char *optarg);
+extern void stress_set_forkheap_thp(void);
+extern void stress_set_forkheap_vmas(const char *optarg);
+extern int  stress_set_frontend_mode(const char *name);
+extern void stress_set_frontend_size(const char *optarg);
+extern void stress_set_frontend_entropy(const char *optarg);
+extern void stress_set_flock_contenders(const char *optarg);
 extern void stress_set_fstat_dir(const char *optarg);
+extern void stress_set_fstat_pthreads(const char *optarg);
+extern int  stress_set_futex_mode(const char *name);
+extern void stress_set_futex_waiters(const char *optarg);
+extern void stress_set_futex_wake(const char *optarg);
+extern void stress_set_getdent_entries(const char *optarg);
+extern void stress_set_getrandom_sweep(void);
+extern int  stress_set_hash_method(const char *name);
+extern int  stress_set_hashmap_method(const char *name);
+extern void stress_set_hashmap_keys(const char *optarg);
+extern void stress_set_hashmap_reads(const char *optarg);
+extern void stress_set_hashmap_threads(const char *optarg);
+extern void stress_set_hashmap_zipf(const char *optarg);
 extern void stress_set_hdd_bytes(const char *optarg);
 extern int  stress_hdd_opts(char *opts);
 extern void stress_set_hdd_write_size(const char *optarg);
+extern int  stress_set_hdd_engine(const char *name);
+extern void stress_set_hdd_qd(const char *optarg);
+extern int  stress_set_hdd_dist(const char *name);
+extern void stress_set_hdd_rw_mix(const char *optarg);
+extern int  stress_set_hdd_paths(const char *optarg);
+extern void stress_set_hdd_stripe(const char *optarg);
 extern void stress_set_heapsort_size(const void *optarg);
 extern void stress_set_hsearch_size(const char *optarg);
+extern void stress_set_icmp_flood_batch(const char *optarg);
+extern void stress_set_icmp_flood_recv(void);
+extern void stress_set_icmp_flood_sweep(void);
+extern int  stress_set_inotify_api(const char *name);
+extern void stress_set_inotify_writers(const char *optarg);
 extern int  stress_icmp_flood_supported(void);
+extern int  stress_af_packet_supported(void);
+extern void stress_set_af_alg_throughput(void);
+extern void stress_set_af_packet_port(const char *optarg);
+extern void stress_set_af_packet_size(const char *optarg);
 extern void stress_set_itimer_freq(const char *optarg);
+extern void stress_set_key_max(const char *optarg);
+extern void stress_set_key_scale(void);
+extern void stress_set_ksm_bytes(const char *optarg);
+extern void stress_set_ksm_dup(const char *optarg);
 extern void stress_set_lease_breakers(const char *optarg);
+extern void stress_set_lfqueue_consumers(const char *optarg);
+extern void stress_set_lfqueue_pin(void);
+extern void stress_set_lfqueue_producers(const char *optarg);
+extern int  stress_set_lfqueue_type(const char *name);
+extern void stress_set_lockbus_victim(void);
 extern void stress_set_lsearch_size(const char *optarg);
 extern void stress_set_malloc_bytes(const char *optarg);
+extern int  stress_set_malloc_dist(const char *name);
 extern void stress_set_malloc_max(const char *optarg);
+extern void stress_set_malloc_pthreads(const char *optarg);
 extern void stress_set_malloc_threshold(const char *optarg);
+extern void stress_set_malloc_xfree(const char *optarg);
 extern int  stress_set_matrix_method(const char *name);
 extern void stress_set_matrix_size(const char *optarg);
+extern void stress_set_matrix_threads(const char *optarg);
+extern void stress_set_membarrier_readers(const char *optarg);
+extern int  stress_set_membarrier_sync(const char *name);
+extern void stress_set_memcpy_bw(const char *optarg);
+extern int  stress_set_memcpy_method(const char *name);
+extern void stress_set_memcpy_sweep(void);
 extern void stress_set_memfd_bytes(const char *optarg);
+extern void stress_set_memfd_ipc(void);
+extern void stress_set_memfd_consumers(const char *optarg);
 extern void stress_set_mergesort_size(const void *optarg);
+extern int  stress_set_metadata_layout(const char *name);
+extern void stress_set_metadata_files(const char *optarg);
+extern void stress_metadata_dump(FILE *yaml, json_t *json);
 extern void stress_set_mmap_bytes(const char *optarg);
+extern void stress_set_mlock_bytes(const char *optarg);
+extern void stress_set_mlock_cost(void);
+extern void stress_set_mmaplock_threads(const char *optarg);
+extern void stress_set_mmapmany_scale(void);
+extern int stress_set_mmap_prefault(const char *name);
 extern void stress_set_mq_size(const char *optarg);
+extern void stress_set_mq_sweep(void);
+extern void stress_set_mq_producers(const char *optarg);
+extern void stress_set_mq_consumers(const char *optarg);
 extern void stress_set_mremap_bytes(const char *optarg);
+extern void stress_set_mremap_grow(void);
+extern int  stress_set_nice_levels(const char *optarg);
 extern void stress_set_msync_bytes(const char *optarg);
+extern void stress_set_numa_bytes(const char *optarg);
+extern void stress_set_numa_migrate(void);
 extern void stress_set_pipe_data_size(const char *optarg);
 extern void stress_set_pipe_size(const char *optarg);
+extern void stress_set_pipe_sweep(void);
+extern void stress_set_poll_scale(const char *optarg);
+extern void stress_set_procfs_top(const char *optarg);
 extern void stress_set_pthread_max(const char *optarg);
+extern int  stress_set_pthread_method(const char *name);
+extern void stress_set_pthread_stack(const char *optarg);
+extern void stress_set_pty_data(void);
+extern void stress_set_pty_max(const char *optarg);
 extern void stress_set_qsort_size(const void *optarg);
 extern int  stress_rdrand_supported(void);
+extern int  stress_set_rdrand_method(const char *name);
+extern void stress_set_rdrand_scale(void);
+extern void stress_rdrand_dump(FILE *yaml, json_t *json);
 extern void stress_set_readahead_bytes(const char *optarg);
+extern void stress_set_readahead_sweep(void);
+extern void stress_set_rmap_sharers(const char *optarg);
+extern void stress_set_rmap_scale(void);
+extern int  stress_set_schedlat_policy(const char *name);
+extern void stress_set_schedlat_messengers(const char *optarg);
+extern void stress_set_schedlat_think(const char *optarg);
 extern int  stress_set_sctp_domain(const char *optarg);
 extern void stress_set_sctp_port(const char *optarg);
+extern void stress_set_sctp_streams(const char *optarg);
+extern void stress_set_seccomp_rules(const char *optarg);
+extern void stress_set_stack_cost(void);
 extern void stress_set_seek_size(const char *optarg);
 extern void stress_set_sendfile_size(const char *optarg);
+extern void stress_set_sendfile_sweep(void);
 extern void stress_set_semaphore_posix_procs(const char *optarg);
 extern void stress_set_semaphore_sysv_procs(const char *optarg);
 extern void stress_set_shm_posix_bytes(const char *optarg);
 extern void stress_set_shm_posix_objects(const char *optarg);
 extern void stress_set_shm_sysv_bytes(const char *optarg);
 extern void stress_set_shm_sysv_segments(const char *optarg);
+extern int  stress_set_sigq_method(const char *name);
 extern void stress_set_sleep_max(const char *optarg);
 extern int  stress_set_socket_domain(const char *name);
+extern void stress_set_socket_mmsg_batch(const char *optarg);
+extern void stress_set_socket_msg_size(const char *optarg);
 extern int  stress_set_socket_opts(const char *optarg);
 extern int  stress_set_socket_type(const char *optarg);
 extern void stress_set_socket_port(const char *optarg);
 extern void stress_set_socket_fd_port(const char *optarg);
+extern void stress_set_socket_fd_batch(const char *optarg);
+extern void stress_set_socket_fd_sweep(void);
+extern int  stress_set_sort_dist(const char *name);
+extern int  stress_set_sort_method(const char *name);
+extern void stress_set_sort_size(const char *optarg);
+extern void stress_set_sort_threads(const char *optarg);
 extern void stress_set_splice_bytes(const char *optarg);
+extern int  stress_set_splice_mode(const char *name);
+extern void stress_set_splice_consumers(const char *optarg);
 extern int  stress_set_str_method(const char *name);
+extern void stress_set_str_search(void);
+extern void stress_set_str_search_size(const char *optarg);
+extern void stress_set_stream_bw(const char *optarg);
+extern int  stress_set_stream_isa(const char *name);
 extern void stress_set_stream_L3_size(const char *optarg);
+extern void stress_set_stream_numa(void);
+extern void stress_set_stream_threads(const char *optarg);
+extern void stress_set_swap_bytes(const char *optarg);
+extern void stress_set_swap_limit(const char *optarg);
 extern void stress_set_sync_file_bytes(const char *optarg);
+extern void stress_set_sync_file_wal(void);
+extern void stress_sync_file_dump(FILE *yaml, json_t *json);
+extern void stress_set_sysfs_top(const char *optarg);
+extern int  stress_set_switch_method(const char *name);
+extern int  stress_set_switch_pin(const char *name);
 extern int  stress_set_wcs_method(const char *name);
 extern void stress_set_timer_freq(const char *optarg);
 extern void stress_set_timerfd_freq(const char *optarg);
+extern void stress_set_timerfd_mass(const char *optarg);
 extern int  stress_tsc_supported(void);
+extern void stress_set_tlb_pages(const char *optarg);
+extern int  stress_set_tlb_page_size(const char *name);
+extern void stress_set_tlb_shootdown_threads(const char *optarg);
+extern void stress_set_tsc_skew(void);
 extern void stress_set_tsearch_size(const char *optarg);
 extern int  stress_set_udp_domain(const char *name);
 extern void stress_set_udp_port(const char *optarg);
+extern void stress_set_udp_batch(const char *optarg);
+extern void stress_set_udp_gso(const char *optarg);
+extern void stress_set_udp_gro(void);
 extern int  stress_set_udp_flood_domain(const char *name);
+extern void stress_set_unshare_container(const char *optarg);
 extern void stress_set_userfaultfd_bytes(const char *optarg);
+extern void stress_set_userfaultfd_faulters(const char *optarg);
+extern void stress_set_userfaultfd_handlers(const char *optarg);
+extern int  stress_set_userfaultfd_mode(const char *name);
+extern void stress_set_userfaultfd_prefault(const char *optarg);
+extern void stress_set_ulock_cs(const char *optarg);
+extern int  stress_set_ulock_method(const char *name);
+extern void stress_set_ulock_threads(const char *optarg);
+extern int  stress_set_vecmath_method(const char *name);
+extern const char *stress_vecmath_fma_name(void);
+extern void stress_vecmath_fma_run(void);
 extern void stress_set_vfork_max(const char *optarg);
 extern void stress_set_vm_bytes(const char *optarg);
 extern void stress_set_vm_flags(const int flag);
+extern void stress_set_vm_hugepage(void);
 extern void stress_set_vm_hang(const char *optarg);
+extern void stress_set_vm_threads(const char *optarg);
+extern void stress_set_vm_hammer_rate(const char *optarg);
 extern int  stress_set_vm_method(const char *name);
 extern void stress_set_vm_rw_bytes(const char *optarg);
+extern void stress_set_vm_rw_sweep(void);
 extern void stress_set_vm_splice_bytes(const char *optarg);
+extern int  stress_set_wakeup_method(const char *name);
+extern int  stress_set_wakeup_cpus(const char *optarg);
+extern void stress_set_xattr_sweep(void);
+extern void stress_set_zlib_block_size(const char *optarg);
+extern int  stress_set_zlib_engine(const char *name);
+extern void stress_set_zlib_level(const char *optarg);
+extern int  stress_set_zlib_rand_data(const char *name);
+extern void stress_set_zlib_threads(const char *optarg);
 extern void stress_set_zombie_max(const char *optarg);
+extern void stress_set_zombie_reap(void);
 
 #define STRESS(name)							\
 extern int name(uint64_t *const counter, const uint32_t instance,	\
@@ -2668,21 +4437,25 @@ extern int name(uint64_t *const counter, const uint32_t instance,	\
 /* Stressors */
 STRESS(stress_affinity);
 STRESS(stress_af_alg);
+STRESS(stress_af_packet);
 STRESS(stress_aio);
 STRESS(stress_aiol);
 STRESS(stress_apparmor);
+STRESS(stress_arena);
 STRESS(stress_atomic);
 STRESS(stress_bigheap);
 STRESS(stress_bind_mount);
 STRESS(stress_brk);
 STRESS(stress_bsearch);
 STRESS(stress_cache);
+STRESS(stress_cacheline);
 STRESS(stress_cap);
 STRESS(stress_chdir);
 STRESS(stress_chmod);
 STRESS(stress_chown);
 STRESS(stress_clock);
 STRESS(stress_clone);
+STRESS(stress_compact);
 STRESS(stress_context);
 STRESS(stress_copy_file);
 STRESS(stress_cpu);
@@ -2692,6 +4465,7 @@ STRESS(stress_daemon);
 STRESS(stress_dentry);
 STRESS(stress_dir);
 STRESS(stress_dnotify);
+STRESS(stress_dsp);
 STRESS(stress_dup);
 STRESS(stress_epoll);
 STRESS(stress_eventfd);
@@ -2704,7 +4478,9 @@ STRESS(stress_fifo);
 STRESS(stress_filename);
 STRESS(stress_flock);
 STRESS(stress_fork);
+STRESS(stress_forkheap);
 STRESS(stress_fp_error);
+STRESS(stress_frontend);
 STRESS(stress_fstat);
 STRESS(stress_full);
 STRESS(stress_futex);
@@ -2712,6 +4488,8 @@ STRESS(stress_get);
 STRESS(stress_getrandom);
 STRESS(stress_getdent);
 STRESS(stress_handle);
+STRESS(stress_hash);
+STRESS(stress_hashmap);
 STRESS(stress_hdd);
 STRESS(stress_heapsort);
 STRESS(stress_hsearch);
@@ -2719,13 +4497,17 @@ STRESS(stress_icache);
 STRESS(stress_icmp_flood);
 STRESS(stress_inotify);
 STRESS(stress_io);
+STRESS(stress_io_uring_net);
+STRESS(stress_iocmp);
 STRESS(stress_ioprio);
 STRESS(stress_itimer);
 STRESS(stress_kcmp);
 STRESS(stress_key);
 STRESS(stress_kill);
 STRESS(stress_klog);
+STRESS(stress_ksm);
 STRESS(stress_lease);
+STRESS(stress_lfqueue);
 STRESS(stress_link);
 STRESS(stress_lockbus);
 STRESS(stress_locka);
@@ -2740,11 +4522,13 @@ STRESS(stress_membarrier);
 STRESS(stress_memcpy);
 STRESS(stress_memfd);
 STRESS(stress_mergesort);
+STRESS(stress_metadata);
 STRESS(stress_mincore);
 STRESS(stress_mknod);
 STRESS(stress_mlock);
 STRESS(stress_mmap);
 STRESS(stress_mmapfork);
+STRESS(stress_mmaplock);
 STRESS(stress_mmapmany);
 STRESS(stress_mremap);
 STRESS(stress_msg);
@@ -2774,6 +4558,7 @@ STRESS(stress_resources);
 STRESS(stress_rlimit);
 STRESS(stress_rmap);
 STRESS(stress_rtc);
+STRESS(stress_schedlat);
 STRESS(stress_sctp);
 STRESS(stress_seal);
 STRESS(stress_seccomp);
@@ -2793,25 +4578,30 @@ STRESS(stress_sleep);
 STRESS(stress_sock);
 STRESS(stress_sockfd);
 STRESS(stress_sockpair);
+STRESS(stress_sort);
 STRESS(stress_spawn);
 STRESS(stress_splice);
 STRESS(stress_stack);
 STRESS(stress_stackmmap);
 STRESS(stress_str);
 STRESS(stress_stream);
+STRESS(stress_swap);
 STRESS(stress_switch);
 STRESS(stress_symlink);
 STRESS(stress_sync_file);
+STRESS(stress_syscall);
 STRESS(stress_sysinfo);
 STRESS(stress_sysfs);
 STRESS(stress_tee);
 STRESS(stress_timer);
 STRESS(stress_timerfd);
+STRESS(stress_tlb);
 STRESS(stress_tlb_shootdown);
 STRESS(stress_tsc);
 STRESS(stress_tsearch);
 STRESS(stress_udp);
 STRESS(stress_udp_flood);
+STRESS(stress_ulock);
 STRESS(stress_unshare);
 STRESS(stress_urandom);
 STRESS(stress_userfaultfd);
@@ -2822,6 +4612,7 @@ STRESS(stress_vm);
 STRESS(stress_vm_rw);
 STRESS(stress_vm_splice);
 STRESS(stress_wait);
+STRESS(stress_wakeup);
 STRESS(stress_wcs);
 STRESS(stress_xattr);
 STRESS(stress_yield);
@@ -24,20 +24,314 @@
  */
 #define _GNU_SOURCE
 
+#include <math.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
 #include <sched.h>
 #include <errno.h>
 #include <time.h>
 #include <signal.h>
+#include <sys/mman.h>
 #include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 #include "stress-ng.h"
 
+#define NICE_LEVELS_MAX		(16)	/* max competing nice levels */
+#define NICE_FAIR_ROUND		(2.0)	/* secs each round competes */
+#define NICE_FAIR_GAP_NS	(20000)	/* shortest off CPU gap, ns */
+
+static int opt_nice_levels[NICE_LEVELS_MAX];
+static size_t opt_nice_nlevels;
+
+/*
+ *  stress_set_nice_levels()
+ *	set the comma separated nice levels of the busy
+ *	instances that compete for one CPU in the fairness mode
+ */
+int stress_set_nice_levels(const char *optarg)
+{
+	char *str, *tok, *ptr;
+
+	str = strdup(optarg);
+	if (!str) {
+		fprintf(stderr, "nice-levels: out of memory\n");
+		return -1;
+	}
+	opt_nice_nlevels = 0;
+	for (ptr = str; (tok = strsep(&ptr, ",")) != NULL; ) {
+		char *end;
+		long level;
+
+		if (!*tok)
+			continue;
+		if (opt_nice_nlevels >= NICE_LEVELS_MAX) {
+			fprintf(stderr, "nice-levels: more than %d levels\n",
+				NICE_LEVELS_MAX);
+			free(str);
+			return -1;
+		}
+		level = strtol(tok, &end, 10);
+		if (*end || (level < -20) || (level > 19)) {
+			fprintf(stderr, "nice-levels: '%s' must be a nice "
+				"level from -20 to 19\n", tok);
+			free(str);
+			return -1;
+		}
+		opt_nice_levels[opt_nice_nlevels++] = (int)level;
+	}
+	free(str);
+	if (opt_nice_nlevels < 2) {
+		fprintf(stderr, "nice-levels: at least 2 levels are needed\n");
+		return -1;
+	}
+	return 0;
+}
+
+#if defined(__linux__)
+/*
+ *  The CFS/EEVDF load weight of each nice level, -20 to 19,
+ *  from sched_prio_to_weight[] in kernel/sched/core.c
+ */
+static const uint32_t nice_weight[40] = {
+	88761, 71755, 56483, 46273, 36291,
+	29154, 23254, 18705, 14949, 11916,
+	9548, 7620, 6100, 4904, 3906,
+	3121, 2501, 1991, 1586, 1277,
+	1024, 820, 655, 526, 423,
+	335, 272, 215, 172, 137,
+	110, 87, 70, 56, 45,
+	36, 29, 23, 18, 15,
+};
+
+/* one competing busy instance, shared with the parent */
+typedef struct {
+	int nice;			/* nice level it got */
+	bool ok;			/* ran and read its schedstat */
+	uint64_t run_ns;		/* time on the CPU */
+	uint64_t wait_ns;		/* time runnable but not running */
+	uint64_t slices;		/* times it was run */
+	stress_latency_t lat;		/* off CPU gaps while runnable */
+} nice_fair_t;
+
+typedef struct {
+	volatile uint32_t ready;	/* instances ready to compete */
+	volatile bool go;		/* start competing */
+	double end;			/* time to stop competing */
+	nice_fair_t fair[NICE_LEVELS_MAX];
+} nice_fair_shared_t;
+
+/*
+ *  stress_nice_schedstat()
+ *	read the run and wait times and run count of this thread
+ */
+static bool stress_nice_schedstat(uint64_t *run, uint64_t *wait, uint64_t *slices)
+{
+	char buf[128];
+	unsigned long long r, w, s;
+
+	if ((system_read("/proc/thread-self/schedstat", buf, sizeof(buf) - 1) <= 0) ||
+	    (sscanf(buf, "%llu %llu %llu", &r, &w, &s) != 3))
+		return false;
+	*run = (uint64_t)r;
+	*wait = (uint64_t)w;
+	*slices = (uint64_t)s;
+	return true;
+}
+
+/*
+ *  stress_nice_compete()
+ *	a busy instance at a nice level pinned to the CPU, gaps
+ *	in its own clock readings are the time it was runnable
+ *	but another instance had the CPU
+ */
+static void stress_nice_compete(
+	nice_fair_shared_t *sh,
+	nice_fair_t *fair,
+	const int cpu,
+	const int level)
+{
+	cpu_set_t mask;
+	uint64_t run0, wait0, slices0, run1, wait1, slices1;
+	uint64_t prev, now;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+	(void)setpriority(PRIO_PROCESS, 0, level);
+	errno = 0;
+	fair->nice = getpriority(PRIO_PROCESS, 0);
+	if (errno)
+		fair->nice = level;
+
+	__atomic_add_fetch(&sh->ready, 1, __ATOMIC_SEQ_CST);
+	while (!sh->go && opt_do_run)
+		(void)usleep(1000);
+	if (!opt_do_run ||
+	    !stress_nice_schedstat(&run0, &wait0, &slices0))
+		return;
+
+	prev = time_now_ns();
+	while (opt_do_run && (time_now() < sh->end)) {
+		now = time_now_ns();
+		if (now - prev >= NICE_FAIR_GAP_NS)
+			latency_record(&fair->lat, now - prev);
+		prev = now;
+	}
+	if (!stress_nice_schedstat(&run1, &wait1, &slices1))
+		return;
+	fair->run_ns = run1 - run0;
+	fair->wait_ns = wait1 - wait0;
+	fair->slices = slices1 - slices0;
+	fair->ok = true;
+}
+
+/*
+ *  stress_nice_fair()
+ *	run a busy instance per nice level pinned to one CPU for
+ *	a round, and compare the CPU share each achieves with
+ *	its share of the total load weight. The latency of a
+ *	level is the time it waited runnable for the CPU
+ */
+static int stress_nice_fair(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	nice_fair_shared_t *sh;
+	nice_fair_t totals[NICE_LEVELS_MAX];
+	pid_t pids[NICE_LEVELS_MAX];
+	cpu_set_t mask;
+	int cpu = 0, ncpus = 0, i;
+	size_t j;
+
+	/* each instance competes on a CPU of its own if it can */
+	if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+		for (i = 0; i < CPU_SETSIZE; i++)
+			if (CPU_ISSET(i, &mask))
+				ncpus++;
+		for (i = 0; ncpus && (i < CPU_SETSIZE); i++) {
+			if (CPU_ISSET(i, &mask) &&
+			    ((uint32_t)cpu++ == instance % (uint32_t)ncpus)) {
+				cpu = i;
+				break;
+			}
+		}
+	}
+
+	sh = (nice_fair_shared_t *)mmap(NULL, sizeof(*sh),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sh == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot mmap shared state, "
+			"errno=%d (%s)\n", name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+	memset(totals, 0, sizeof(totals));
+
+	do {
+		memset(sh, 0, sizeof(*sh));
+		for (j = 0; j < opt_nice_nlevels; j++) {
+			pids[j] = fork();
+			if (pids[j] == 0) {
+				(void)setpgid(0, pgrp);
+				stress_parent_died_alarm();
+				stress_nice_compete(sh, &sh->fair[j], cpu,
+					opt_nice_levels[j]);
+				_exit(0);
+			}
+			if (pids[j] > 0)
+				(void)setpgid(pids[j], pgrp);
+		}
+
+		while (opt_do_run && (sh->ready < opt_nice_nlevels))
+			(void)usleep(1000);
+		sh->end = time_now() + NICE_FAIR_ROUND;
+		sh->go = true;
+
+		for (j = 0; j < opt_nice_nlevels; j++) {
+			int status;
+
+			if (pids[j] <= 0)
+				continue;
+			if (waitpid(pids[j], &status, 0) < 0) {
+				(void)kill(pids[j], SIGTERM);
+				(void)kill(pids[j], SIGKILL);
+				(void)waitpid(pids[j], &status, 0);
+			}
+		}
+
+		/* only whole rounds where every level ran are used */
+		for (j = 0; j < opt_nice_nlevels; j++)
+			if ((pids[j] <= 0) || !sh->fair[j].ok)
+				break;
+		if (j < opt_nice_nlevels)
+			continue;
+		for (j = 0; j < opt_nice_nlevels; j++) {
+			const nice_fair_t *f = &sh->fair[j];
+			size_t k;
+
+			totals[j].nice = f->nice;
+			totals[j].run_ns += f->run_ns;
+			totals[j].wait_ns += f->wait_ns;
+			totals[j].slices += f->slices;
+			totals[j].lat.count += f->lat.count;
+			if (totals[j].lat.max < f->lat.max)
+				totals[j].lat.max = f->lat.max;
+			for (k = 0; k < LATENCY_BUCKETS; k++)
+				totals[j].lat.bucket[k] += f->lat.bucket[k];
+		}
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+	(void)munmap((void *)sh, sizeof(*sh));
+
+	if (*counter) {
+		uint64_t run_total = 0, weight_total = 0;
+		double max_error = 0.0;
+
+		for (j = 0; j < opt_nice_nlevels; j++) {
+			run_total += totals[j].run_ns;
+			weight_total += nice_weight[totals[j].nice + 20];
+		}
+		if (!run_total)
+			return EXIT_SUCCESS;
+
+		if (instance == 0)
+			pr_inf(stderr, "%s: nice  weight  expected  achieved  "
+				"error  wait/run us  p99 wait us  max wait us\n", name);
+		for (j = 0; j < opt_nice_nlevels; j++) {
+			const nice_fair_t *t = &totals[j];
+			const uint32_t weight = nice_weight[t->nice + 20];
+			const double expected = 100.0 * (double)weight / (double)weight_total;
+			const double achieved = 100.0 * (double)t->run_ns / (double)run_total;
+			const double p99 = (double)latency_percentile(&t->lat, 0.99) / 1000.0;
+			char desc[40];
+
+			if (fabs(achieved - expected) > max_error)
+				max_error = fabs(achieved - expected);
+			if (instance == 0)
+				pr_inf(stderr, "%s: %4d %7" PRIu32 " %8.2f%% %8.2f%% "
+					"%+6.2f %12.1f %12.1f %12.1f\n", name,
+					t->nice, weight, expected, achieved,
+					achieved - expected,
+					t->slices ? (double)t->wait_ns / (double)t->slices / 1000.0 : 0.0,
+					p99, (double)t->lat.max / 1000.0);
+			(void)snprintf(desc, sizeof(desc), "nice %d CPU share %%", t->nice);
+			stress_misc_metric_set(1 + (2 * j), desc, achieved);
+			(void)snprintf(desc, sizeof(desc), "nice %d p99 wait usec", t->nice);
+			stress_misc_metric_set(2 + (2 * j), desc, p99);
+		}
+		stress_misc_metric_set(0, "max CPU share error %", max_error);
+	}
+	return EXIT_SUCCESS;
+}
+#endif
+
 
 /*
  *  stress on sched_nice()
@@ -51,8 +345,15 @@ int stress_nice(
 {
 	int max_prio, min_prio;
 
-	(void)instance;
-	(void)name;
+	if (opt_nice_nlevels) {
+#if defined(__linux__)
+		return stress_nice_fair(counter, instance, max_ops, name);
+#else
+		if (instance == 0)
+			pr_inf(stderr, "%s: --nice-levels is only supported "
+				"on Linux, using the default mode\n", name);
+#endif
+	}
 
 #ifdef RLIMIT_NICE
 	{
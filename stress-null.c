@@ -49,6 +49,7 @@ int stress_null(
 
 	(void)instance;
 
+	stress_units_per_op((double)sizeof(buffer));
 	if ((fd = open("/dev/null", O_WRONLY)) < 0) {
 		pr_fail_err(name, "open");
 		return EXIT_FAILURE;
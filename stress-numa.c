@@ -39,6 +39,9 @@
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
 
 #define NUMA_LONG_BITS		(sizeof(unsigned long) * 8)
@@ -59,6 +62,48 @@
 #define SYS_NODE_PATH	"/sys/devices/system/node"
 #define MMAP_SZ			(4 * MB)
 
+#define NUMA_NODES_MAX		(64)	/* memory nodes used by migrate mode */
+#define NUMA_MIGRATE_TIME	(0.5)	/* seconds of migration per batch size */
+#define NUMA_READER_IDLE_TIME	(0.1)	/* seconds of reads without migration */
+#define NUMA_READER_LOADS	(16)	/* random loads per reader latency sample */
+
+/* move_pages batch sizes in pages, smallest to largest */
+static const unsigned long numa_batches[] = { 1, 8, 64, 512, 4096 };
+
+/* Results of one move_pages batch size */
+typedef struct {
+	uint64_t bytes;		/* bytes moved to the destination node */
+	uint64_t calls;		/* move_pages calls */
+	double secs;		/* time spent in move_pages */
+} numa_migrate_t;
+
+#if defined(HAVE_LIB_PTHREAD)
+/* Reader thread loading from the region being migrated */
+typedef struct {
+	const uint8_t *buf;		/* region being migrated */
+	size_t len;			/* region size */
+	volatile bool stop;		/* stop the reader */
+	volatile bool migrating;	/* migration in progress */
+	stress_latency_t idle;		/* sample latency, no migration */
+	stress_latency_t busy;		/* sample latency during migration */
+} numa_reader_t;
+#endif
+
+static bool opt_numa_migrate = false;
+static uint64_t opt_numa_bytes = DEFAULT_NUMA_BYTES;
+
+void stress_set_numa_migrate(void)
+{
+	opt_numa_migrate = true;
+}
+
+void stress_set_numa_bytes(const char *optarg)
+{
+	opt_numa_bytes = get_uint64_byte(optarg);
+	check_range("numa-bytes", opt_numa_bytes,
+		MIN_NUMA_BYTES, MAX_NUMA_BYTES);
+}
+
 typedef struct node {
 	uint32_t	node_id;
 	struct node	*next;
@@ -218,6 +263,261 @@ static int stress_numa_get_nodes(node_t **node_ptr)
 	return n;
 }
 
+/*
+ *  stress_numa_node_list()
+ *	parse a node list such as "0-1,3" from a file in
+ *	SYS_NODE_PATH into nodes[], returns the node count
+ */
+static int stress_numa_node_list(const char *file, int *nodes, const int max)
+{
+	char path[PATH_MAX], buf[256];
+	cpu_set_t set;
+	FILE *fp;
+	int i, n = 0;
+
+	(void)snprintf(path, sizeof(path), "%s/%s", SYS_NODE_PATH, file);
+	fp = fopen(path, "r");
+	if (!fp)
+		return 0;
+	if (!fgets(buf, sizeof(buf), fp)) {
+		(void)fclose(fp);
+		return 0;
+	}
+	(void)fclose(fp);
+
+	/* a node list has the same syntax as a cpulist */
+	if (stress_parse_cpulist(NULL, buf, &set) <= 0)
+		return 0;
+	for (i = 0; (i < CPU_SETSIZE) && (n < max); i++) {
+		if (CPU_ISSET(i, &set))
+			nodes[n++] = i;
+	}
+	return n;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  stress_numa_reader()
+ *	time short runs of random loads from the region while
+ *	it is migrated, and while it is not, so the latency cost
+ *	to a concurrent user of the memory can be compared
+ */
+static void *stress_numa_reader(void *arg)
+{
+	numa_reader_t *r = (numa_reader_t *)arg;
+	const size_t lines = r->len / 64;
+	uint64_t sum = 0;
+
+	while (!r->stop) {
+		const uint64_t t = time_ticks();
+		int i;
+
+		for (i = 0; i < NUMA_READER_LOADS; i++)
+			sum += *(volatile const uint8_t *)(r->buf + ((mwc32() % lines) * 64));
+		latency_record(r->migrating ? &r->busy : &r->idle,
+			time_ticks_to_ns(time_ticks() - t));
+	}
+	(void)sum;
+	return NULL;
+}
+#endif
+
+/*
+ *  stress_numa_migrate()
+ *	measure move_pages throughput between the memory nodes,
+ *	including memory only nodes such as CXL or PMEM, for a
+ *	range of batch sizes, and the load latency seen by a
+ *	reader of the memory being migrated
+ */
+static int stress_numa_migrate(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t page_sz = stress_get_pagesize();
+	const size_t len = (size_t)opt_numa_bytes & ~(page_sz - 1);
+	const unsigned long num_pages = len / page_sz;
+	const pid_t mypid = getpid();
+	int mem_nodes[NUMA_NODES_MAX], cpu_nodes[NUMA_NODES_MAX];
+	int n_mem, n_cpu, i, node = 0, rc = EXIT_SUCCESS;
+	numa_migrate_t stats[SIZEOF_ARRAY(numa_batches)];
+	void **pages = NULL;
+	int *dest_nodes = NULL, *status = NULL;
+	uint8_t *buf;
+	unsigned long p;
+	size_t b;
+	char node_str[NUMA_NODES_MAX * 8];
+#if defined(HAVE_LIB_PTHREAD)
+	numa_reader_t reader;
+	pthread_t pthread;
+	bool reader_ok = false;
+#endif
+
+	n_mem = stress_numa_node_list("has_memory", mem_nodes, NUMA_NODES_MAX);
+	if (n_mem < 2) {
+		pr_inf(stderr, "%s: multiple NUMA nodes with memory not found, "
+			"aborting test.\n", name);
+		return EXIT_SUCCESS;
+	}
+	n_cpu = stress_numa_node_list("has_cpu", cpu_nodes, NUMA_NODES_MAX);
+
+	/* Flag the memory only (CXL, PMEM) nodes */
+	*node_str = '\0';
+	for (i = 0; i < n_mem; i++) {
+		bool has_cpu = false;
+		int j;
+
+		for (j = 0; j < n_cpu; j++)
+			has_cpu |= (cpu_nodes[j] == mem_nodes[i]);
+		(void)snprintf(node_str + strlen(node_str),
+			sizeof(node_str) - strlen(node_str), " %d%s",
+			mem_nodes[i], has_cpu ? "" : "(memory only)");
+	}
+	if (instance == 0)
+		pr_inf(stderr, "%s: migrating %zu MB between nodes%s\n",
+			name, (size_t)(len / MB), node_str);
+
+	buf = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot mmap %zu bytes, errno=%d (%s), "
+			"skipping stressor\n", name, len, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+#if defined(MADV_NOHUGEPAGE)
+	/* Batch sizes are in small pages, so keep huge pages out */
+	(void)madvise(buf, len, MADV_NOHUGEPAGE);
+#endif
+	memset(buf, 0x5a, len);
+
+	pages = calloc(num_pages, sizeof(*pages));
+	dest_nodes = calloc(num_pages, sizeof(*dest_nodes));
+	status = calloc(num_pages, sizeof(*status));
+	if (!pages || !dest_nodes || !status) {
+		pr_inf(stderr, "%s: out of memory allocating page arrays, "
+			"skipping stressor\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_pages;
+	}
+	for (p = 0; p < num_pages; p++)
+		pages[p] = buf + (p * page_sz);
+
+	/* Start with all the pages on the first memory node */
+	for (p = 0; p < num_pages; p++)
+		dest_nodes[p] = mem_nodes[0];
+	(void)sys_move_pages(mypid, num_pages, pages, dest_nodes,
+		status, MPOL_MF_MOVE);
+
+#if defined(HAVE_LIB_PTHREAD)
+	memset(&reader, 0, sizeof(reader));
+	reader.buf = buf;
+	reader.len = len;
+	reader_ok = (pthread_create(&pthread, NULL,
+		stress_numa_reader, &reader) == 0);
+	if (!reader_ok)
+		pr_dbg(stderr, "%s: cannot start reader thread, "
+			"reader latency not reported\n", name);
+#endif
+	memset(stats, 0, sizeof(stats));
+
+	do {
+		for (b = 0; b < SIZEOF_ARRAY(numa_batches); b++) {
+			const unsigned long batch = numa_batches[b];
+			const double t_end = time_now() + NUMA_MIGRATE_TIME;
+
+#if defined(HAVE_LIB_PTHREAD)
+			/* Let the reader sample the unmigrated latency */
+			if (reader_ok) {
+				reader.migrating = false;
+				(void)usleep(NUMA_READER_IDLE_TIME * 1000000);
+				reader.migrating = true;
+			}
+#endif
+			do {
+				const int dest = mem_nodes[(++node) % n_mem];
+
+				/* Move the whole region to the next node */
+				for (p = 0; p < num_pages; p += batch) {
+					const unsigned long count =
+						(num_pages - p < batch) ? num_pages - p : batch;
+					unsigned long j;
+					double t;
+					int ret;
+
+					for (j = p; j < p + count; j++)
+						dest_nodes[j] = dest;
+					t = time_now();
+					ret = sys_move_pages(mypid, count, &pages[p],
+						&dest_nodes[p], &status[p], MPOL_MF_MOVE);
+					stats[b].secs += time_now() - t;
+					if (ret < 0) {
+						pr_fail(stderr, "%s: move_pages: errno=%d (%s)\n",
+							name, errno, strerror(errno));
+						rc = EXIT_FAILURE;
+						goto stop;
+					}
+					stats[b].calls++;
+					for (j = p; j < p + count; j++)
+						if (status[j] == dest)
+							stats[b].bytes += page_sz;
+				}
+				(*counter)++;
+			} while (opt_do_run && (time_now() < t_end) &&
+				 (!max_ops || *counter < max_ops));
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto stop;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+stop:
+#if defined(HAVE_LIB_PTHREAD)
+	if (reader_ok) {
+		reader.stop = true;
+		(void)pthread_join(pthread, NULL);
+	}
+#endif
+
+	if (instance == 0)
+		pr_inf(stderr, "%s: %6s %10s %10s %12s\n", name,
+			"batch", "calls", "GB/s", "us per call");
+	for (b = 0; b < SIZEOF_ARRAY(numa_batches); b++) {
+		const numa_migrate_t *s = &stats[b];
+		const double rate = (s->secs > 0.0) ?
+			(double)s->bytes / s->secs / (double)GB : 0.0;
+		char desc[40];
+
+		if (!s->calls)
+			continue;
+		if (instance == 0)
+			pr_inf(stderr, "%s: %6lu %10" PRIu64 " %10.3f %12.2f\n",
+				name, numa_batches[b], s->calls, rate,
+				1000000.0 * s->secs / (double)s->calls);
+		(void)snprintf(desc, sizeof(desc), "%lu page batch GB/s",
+			numa_batches[b]);
+		stress_misc_metric_set(b, desc, rate);
+	}
+#if defined(HAVE_LIB_PTHREAD)
+	if (reader_ok && reader.idle.count && reader.busy.count) {
+		b = SIZEOF_ARRAY(numa_batches);
+		stress_misc_metric_set(b, "reader p50 ns idle",
+			(double)latency_percentile(&reader.idle, 0.50));
+		stress_misc_metric_set(b + 1, "reader p50 ns migrating",
+			(double)latency_percentile(&reader.busy, 0.50));
+		stress_misc_metric_set(b + 2, "reader p99 ns idle",
+			(double)latency_percentile(&reader.idle, 0.99));
+		stress_misc_metric_set(b + 3, "reader p99 ns migrating",
+			(double)latency_percentile(&reader.busy, 0.99));
+	}
+#endif
+free_pages:
+	free(status);
+	free(dest_nodes);
+	free(pages);
+	(void)munmap(buf, len);
+
+	return rc;
+}
+
 /*
  *  stress_numa()
  *	stress the Linux NUMA interfaces
@@ -237,7 +537,8 @@ int stress_numa(
 	node_t *n;
 	int rc = EXIT_FAILURE;
 
-	(void)instance;
+	if (opt_numa_migrate)
+		return stress_numa_migrate(counter, instance, max_ops, name);
 
 	numa_nodes = stress_numa_get_nodes(&n);
 	if (numa_nodes <= 1) {
@@ -33,13 +33,16 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <setjmp.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/time.h>
 
 #define PAGES		(16)
-#define TRACK_SIGCOUNT	(0)
+#define OPCODE_REPEATS	(64)		/* timed re-runs of a faulting opcode */
+#define OPCODE_MAGIC	(0x0c0dedu)	/* result written by the child */
+#define OPCODE_SIGSTACK	(64 * KB)	/* signal stack size */
 
 typedef void (*opfunc_t)(void);
 
@@ -76,28 +79,142 @@ static int sigs[] = {
 #endif
 };
 
-#if defined(NSIG)
-#define MAX_SIGS	(NSIG)
-#elif defined(_NSIG)
-#define MAX_SIGS	(_NSIG)
-#else
-#define MAX_SIGS	(256)
-#endif
+/* Outcome of running one random opcode sequence */
+enum {
+	OPCODE_CLEAN = 0,		/* returned without a signal */
+	OPCODE_SIGILL,
+	OPCODE_SIGSEGV,
+	OPCODE_SIGBUS,
+	OPCODE_SIGTRAP,
+	OPCODE_SIGFPE,
+	OPCODE_TIMEOUT,			/* looped until the itimer fired */
+	OPCODE_OTHER,			/* any other signal or a dead child */
+	OPCODE_CLASSES
+};
 
-#if TRACK_SIGCOUNT
-static uint64_t *sig_count;
-#endif
+static const char *opcode_class_names[OPCODE_CLASSES] = {
+	"clean", "SIGILL", "SIGSEGV", "SIGBUS",
+	"SIGTRAP", "SIGFPE", "timeout", "other"
+};
+
+/* Written by the child into a page shared with the parent */
+typedef struct {
+	uint32_t magic;			/* OPCODE_MAGIC once valid */
+	int32_t signo;			/* first signal, 0 = clean */
+	uint32_t faults;		/* timed faults of the same signal */
+	uint64_t nsec;			/* time taken by the timed faults */
+} opcode_result_t;
+
+/* Accumulated outcomes of one class */
+typedef struct {
+	uint64_t count;			/* children with this outcome */
+	uint64_t faults;		/* timed faults */
+	uint64_t nsec;			/* time taken by the timed faults */
+} opcode_stats_t;
+
+static sigjmp_buf opcode_env;
+static volatile int opcode_signo;
+static volatile bool opcode_done;
+static volatile uint32_t opcode_signals;
 
-static void MLOCKED stress_badhandler(int dummy)
+/*
+ *  stress_badhandler()
+ *	note the signal and bounce back to the caller, the handler
+ *	is SA_NODEFER so the signal is not left blocked
+ */
+static void MLOCKED stress_badhandler(int signum)
 {
-	(void)dummy;
+	/*
+	 *  Too late to bounce back once opcode_run() has returned,
+	 *  and give up if the random code left the CPU in a state
+	 *  where the handler itself keeps faulting
+	 */
+	if (opcode_done || (++opcode_signals > OPCODE_REPEATS + 2))
+		_exit(1);
+	opcode_signo = signum;
+	siglongjmp(opcode_env, 1);
+}
 
-#if TRACK_SIGCOUNT
-	if (dummy < MAX_SIGS)
-		sig_count[dummy]++;
+/*
+ *  opcode_class()
+ *	map a signal to its outcome class
+ */
+static int opcode_class(const int signo)
+{
+	switch (signo) {
+	case 0:
+		return OPCODE_CLEAN;
+#if defined(SIGILL)
+	case SIGILL:
+		return OPCODE_SIGILL;
 #endif
-	
-	_exit(1);
+#if defined(SIGSEGV)
+	case SIGSEGV:
+		return OPCODE_SIGSEGV;
+#endif
+#if defined(SIGBUS)
+	case SIGBUS:
+		return OPCODE_SIGBUS;
+#endif
+#if defined(SIGTRAP)
+	case SIGTRAP:
+		return OPCODE_SIGTRAP;
+#endif
+#if defined(SIGFPE)
+	case SIGFPE:
+		return OPCODE_SIGFPE;
+#endif
+#if defined(SIGALRM)
+	case SIGALRM:
+		return OPCODE_TIMEOUT;
+#endif
+	default:
+		return OPCODE_OTHER;
+	}
+}
+
+/*
+ *  opcode_run()
+ *	run the random code once to find how it ends, then if it
+ *	faulted re-run it OPCODE_REPEATS times to time the fault,
+ *	handler and return to the caller, the path a JIT trap takes
+ */
+static void opcode_run(const opfunc_t func, opcode_result_t *result)
+{
+	static volatile uint32_t runs;
+	static volatile uint64_t t_start;
+	int first;
+
+	opcode_signo = 0;
+	if (sigsetjmp(opcode_env, 0) == 0) {
+		func();
+		opcode_done = true;
+		result->signo = 0;
+		result->magic = OPCODE_MAGIC;
+		return;
+	}
+	first = opcode_signo;
+	result->signo = first;
+	result->magic = OPCODE_MAGIC;
+	if (opcode_class(first) == OPCODE_TIMEOUT) {
+		opcode_done = true;
+		return;
+	}
+
+	runs = 0;
+	t_start = time_now_ns();
+	(void)sigsetjmp(opcode_env, 0);
+	if ((opcode_signo == first) && (runs < OPCODE_REPEATS)) {
+		runs++;
+		opcode_signo = 0;
+		func();
+		/* Did not fault the second time around */
+	}
+	opcode_done = true;
+	if ((opcode_signo == first) && (runs == OPCODE_REPEATS)) {
+		result->nsec = time_now_ns() - t_start;
+		result->faults = runs;
+	}
 }
 
 /*
@@ -111,22 +228,19 @@ int stress_opcode(
 	const char *name)
 {
 	const size_t page_size = stress_get_pagesize();
+	opcode_stats_t stats[OPCODE_CLASSES];
+	opcode_result_t *result;
 	int rc = EXIT_FAILURE;
-	size_t i;
-#if TRACK_SIGCOUNT
-	const size_t sig_count_size = MAX_SIGS * sizeof(uint64_t);
-#endif
+	size_t i, idx = 0;
+	uint64_t total;
 
-	(void)instance;
-
-#if TRACK_SIGCOUNT
-	sig_count = (uint64_t *)mmap(NULL, sig_count_size, PROT_READ | PROT_WRITE,
+	result = mmap(NULL, page_size, PROT_READ | PROT_WRITE,
 		MAP_ANONYMOUS | MAP_SHARED, -1, 0);
-	if (sig_count == MAP_FAILED) {
+	if (result == MAP_FAILED) {
 		pr_fail_dbg(name, "mmap");
 		return EXIT_NO_RESOURCE;
 	}
-#endif
+	memset(stats, 0, sizeof(stats));
 
 	do {
 		pid_t pid;
@@ -135,6 +249,7 @@ int stress_opcode(
 again:
 		if (!opt_do_run)
 			break;
+		memset(result, 0, sizeof(*result));
 		pid = fork();
 		if (pid < 0) {
 			if (errno == EAGAIN)
@@ -146,14 +261,40 @@ again:
 		}
 		if (pid == 0) {
 			struct itimerval it;
+			struct sigaction action;
+			stack_t ss;
 			uint8_t *opcodes, *ops_begin, *ops_end, *ops;
 
 			/* We don't want bad ops clobbering this region */
 			stress_unmap_shared();
 
+			/*
+			 *  The random code can leave the stack pointer
+			 *  anywhere, so handle signals on a stack of
+			 *  their own
+			 */
+			ss.ss_sp = mmap(NULL, OPCODE_SIGSTACK, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (ss.ss_sp == MAP_FAILED) {
+				pr_fail_dbg(name, "mmap");
+				_exit(EXIT_NO_RESOURCE);
+			}
+			ss.ss_size = OPCODE_SIGSTACK;
+			ss.ss_flags = 0;
+			if (sigaltstack(&ss, NULL) < 0) {
+				pr_fail_dbg(name, "sigaltstack");
+				_exit(EXIT_FAILURE);
+			}
+
+			memset(&action, 0, sizeof(action));
+			action.sa_handler = stress_badhandler;
+			(void)sigemptyset(&action.sa_mask);
+			action.sa_flags = SA_NODEFER | SA_ONSTACK;
 			for (i = 0; i < SIZEOF_ARRAY(sigs); i++) {
-				if (stress_sighandler(name, sigs[i], stress_badhandler, NULL) < 0)
+				if (sigaction(sigs[i], &action, NULL) < 0) {
+					pr_fail_dbg(name, "sigaction");
 					_exit(EXIT_FAILURE);
+				}
 			}
 
 			opcodes = mmap(NULL, page_size * PAGES, PROT_READ | PROT_WRITE,
@@ -194,13 +335,13 @@ again:
 				_exit(EXIT_NO_RESOURCE);
 			}
 
-			((void (*)(void))(ops_begin + mwc8()))();
+			opcode_run((opfunc_t)(ops_begin + mwc8()), result);
 
 			(void)munmap(opcodes, page_size * PAGES);
 			_exit(0);
 		}
 		if (pid > 0) {
-			int ret, status;
+			int ret, status, class = OPCODE_OTHER;
 
 			ret = waitpid(pid, &status, 0);
 			if (ret < 0) {
@@ -211,24 +352,54 @@ again:
 				(void)kill(pid, SIGKILL);
 				(void)waitpid(pid, &status, 0);
 			}
+			/* The random code may have scribbled on the result */
+			if (result->magic == OPCODE_MAGIC)
+				class = opcode_class(result->signo);
+			stats[class].count++;
+			if (result->faults && (result->faults <= OPCODE_REPEATS)) {
+				stats[class].faults += result->faults;
+				stats[class].nsec += result->nsec;
+			}
 			(*counter)++;
 		}
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
 	rc = EXIT_SUCCESS;
 
-#if TRACK_SIGCOUNT
-	for (i = 0; i < MAX_SIGS; i++) {
-		if (sig_count[i]) {
-			pr_dbg(stderr, "%s: %-25.25s: %" PRIu64 "\n",
-				name, strsignal(i), sig_count[i]);
+	for (total = 0, i = 0; i < OPCODE_CLASSES; i++)
+		total += stats[i].count;
+	if ((instance == 0) && total) {
+		pr_inf(stderr, "%s: %-8s %10s %7s %12s\n", name,
+			"outcome", "count", "%", "ns per fault");
+		for (i = 0; i < OPCODE_CLASSES; i++) {
+			const opcode_stats_t *s = &stats[i];
+			char nsec[24];
+
+			if (!s->count)
+				continue;
+			if (s->faults)
+				(void)snprintf(nsec, sizeof(nsec), "%.1f",
+					(double)s->nsec / (double)s->faults);
+			else
+				(void)snprintf(nsec, sizeof(nsec), "-");
+			pr_inf(stderr, "%s: %-8s %10" PRIu64 " %7.3f %12s\n",
+				name, opcode_class_names[i], s->count,
+				100.0 * (double)s->count / (double)total, nsec);
 		}
 	}
-#endif
+	for (i = 0; i < OPCODE_CLASSES; i++) {
+		const opcode_stats_t *s = &stats[i];
+		char desc[40];
+
+		if (!s->faults)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s ns per fault",
+			opcode_class_names[i]);
+		stress_misc_metric_set(idx++, desc,
+			(double)s->nsec / (double)s->faults);
+	}
 err:
-#if TRACK_SIGCOUNT
-	(void)munmap(sig_count, sig_count_size);
-#endif
+	(void)munmap(result, page_size);
 	return rc;
 }
 
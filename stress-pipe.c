@@ -37,6 +37,17 @@
 
 #if defined(F_SETPIPE_SZ)
 static size_t opt_pipe_size = 0;
+static bool opt_pipe_sweep = false;
+
+#define PIPE_SWEEP_CELL_TIME	(0.5)	/* seconds per sweep cell */
+
+static const size_t pipe_sweep_pipe_sizes[] = {
+	4 * KB, 16 * KB, 64 * KB, 256 * KB, 1 * MB
+};
+
+static const size_t pipe_sweep_data_sizes[] = {
+	64, 256, 1 * KB, 4 * KB
+};
 #endif
 static size_t opt_pipe_data_size = 512;
 
@@ -53,6 +64,15 @@ void stress_set_pipe_size(const char *optarg)
         check_range("pipe-size", opt_pipe_size,
                4, 1024 * 1024);
 }
+
+/*
+ *  stress_set_pipe_sweep()
+ *	sweep pipe sizes against write sizes
+ */
+void stress_set_pipe_sweep(void)
+{
+	opt_pipe_sweep = true;
+}
 #endif
 
 /*
@@ -131,6 +151,234 @@ static void pipe_change_size(const char *name, const int fd)
 #endif
 
 
+/*
+ *  pipe_ctxsw_open()
+ *	open a context switch counter that also counts the
+ *	pipe reader children forked after it, -1 if unavailable
+ */
+static int pipe_ctxsw_open(void)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_open_by_id(STRESS_PERF_SW_CONTEXT_SWITCHES);
+#else
+	return -1;
+#endif
+}
+
+/*
+ *  pipe_ctxsw_read()
+ *	read the context switch counter, false if unavailable
+ */
+static bool pipe_ctxsw_read(const int fd, uint64_t *ctxsw)
+{
+#if defined(STRESS_PERF_STATS)
+	return perf_read_by_fd(fd, ctxsw) == 0;
+#else
+	(void)fd;
+
+	*ctxsw = 0;
+	return false;
+#endif
+}
+
+#if defined(F_SETPIPE_SZ)
+/*
+ *  stress_pipe_sweep_row()
+ *	fork a reader on a pipe of the given size and time each
+ *	write size for a sweep cell, rates are in bytes per second
+ *	and context switches per MB, the bytes written are added to
+ *	total, returns -1 if the pipe size cannot be set
+ */
+static int stress_pipe_sweep_row(
+	const char *name,
+	const size_t pipe_size,
+	const int ctxsw_fd,
+	double rates[SIZEOF_ARRAY(pipe_sweep_data_sizes)],
+	double ctxsw_per_mb[SIZEOF_ARRAY(pipe_sweep_data_sizes)],
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	uint64_t *const total)
+{
+	static char buf[4 * KB];
+	const size_t page_size = stress_get_pagesize();
+	int pipefds[2], status;
+	pid_t pid;
+	size_t i;
+
+	/*
+	 *  Plain pipes rather than O_DIRECT packet mode, this
+	 *  is what shell pipelines use
+	 */
+	if (pipe(pipefds) < 0) {
+		pr_fail_dbg(name, "pipe");
+		return -1;
+	}
+	if (fcntl(pipefds[1], F_SETPIPE_SZ, pipe_size) < 0) {
+		(void)close(pipefds[0]);
+		(void)close(pipefds[1]);
+		return -1;
+	}
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (opt_do_run && (errno == EAGAIN))
+			goto again;
+		(void)close(pipefds[0]);
+		(void)close(pipefds[1]);
+		pr_fail_dbg(name, "fork");
+		return -1;
+	} else if (pid == 0) {
+		(void)setpgid(0, pgrp);
+		stress_parent_died_alarm();
+
+		(void)close(pipefds[1]);
+		for (;;) {
+			const ssize_t n = read(pipefds[0], buf, sizeof(buf));
+
+			if (n == 0)
+				break;
+			if ((n < 0) && (errno != EINTR))
+				break;
+		}
+		(void)close(pipefds[0]);
+		_exit(EXIT_SUCCESS);
+	}
+
+	(void)setpgid(pid, pgrp);
+	(void)close(pipefds[0]);
+
+	for (i = 0; i < SIZEOF_ARRAY(pipe_sweep_data_sizes); i++) {
+		const size_t sz = pipe_sweep_data_sizes[i];
+		double t_start, t_end, duration;
+		uint64_t bytes = 0, ctxsw_start, ctxsw_end;
+		bool ctxsw_ok;
+
+		if ((sz > page_size) || (sz > sizeof(buf)))
+			break;
+		if (!opt_do_run || (max_ops && *counter >= max_ops))
+			break;
+
+		ctxsw_ok = pipe_ctxsw_read(ctxsw_fd, &ctxsw_start);
+		t_start = time_now();
+		t_end = t_start + PIPE_SWEEP_CELL_TIME;
+		do {
+			const ssize_t ret = write(pipefds[1], buf, sz);
+
+			if (ret <= 0) {
+				if ((errno == EAGAIN) || (errno == EINTR))
+					continue;
+				pr_fail_dbg(name, "write");
+				break;
+			}
+			bytes += (uint64_t)ret;
+			(*counter)++;
+		} while (opt_do_run && (time_now() < t_end) &&
+			 (!max_ops || *counter < max_ops));
+		duration = time_now() - t_start;
+		ctxsw_ok &= pipe_ctxsw_read(ctxsw_fd, &ctxsw_end);
+		*total += bytes;
+
+		rates[i] = (duration > 0.0) ? (double)bytes / duration : 0.0;
+		ctxsw_per_mb[i] = (ctxsw_ok && bytes) ?
+			(double)(ctxsw_end - ctxsw_start) * (double)MB / (double)bytes : -1.0;
+	}
+
+	/* EOF terminates the reader */
+	(void)close(pipefds[1]);
+	(void)waitpid(pid, &status, 0);
+
+	return 0;
+}
+
+/*
+ *  stress_pipe_sweep()
+ *	sweep pipe sizes against write sizes, the first instance
+ *	reports a table of the first complete sweep
+ */
+static int stress_pipe_sweep(
+	const char *name,
+	const uint32_t instance,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	double rates[SIZEOF_ARRAY(pipe_sweep_pipe_sizes)][SIZEOF_ARRAY(pipe_sweep_data_sizes)];
+	double ctxsw_per_mb[SIZEOF_ARRAY(pipe_sweep_pipe_sizes)][SIZEOF_ARRAY(pipe_sweep_data_sizes)];
+	bool usable[SIZEOF_ARRAY(pipe_sweep_pipe_sizes)];
+	double peak = 0.0;
+	uint64_t total = 0;
+	size_t i, j, peak_pipe_size = 0, peak_data_size = 0;
+	bool reported = false;
+	const int ctxsw_fd = pipe_ctxsw_open();
+
+	if (ctxsw_fd < 0)
+		pr_dbg(stderr, "%s: cannot open context switch perf "
+			"counter, context switches will not be reported\n", name);
+
+	do {
+		memset(rates, 0, sizeof(rates));
+		memset(ctxsw_per_mb, 0, sizeof(ctxsw_per_mb));
+
+		for (i = 0; i < SIZEOF_ARRAY(pipe_sweep_pipe_sizes); i++) {
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			usable[i] = stress_pipe_sweep_row(name,
+				pipe_sweep_pipe_sizes[i], ctxsw_fd,
+				rates[i], ctxsw_per_mb[i], counter, max_ops,
+				&total) == 0;
+			for (j = 0; usable[i] && (j < SIZEOF_ARRAY(pipe_sweep_data_sizes)); j++) {
+				if (rates[i][j] > peak) {
+					peak = rates[i][j];
+					peak_pipe_size = pipe_sweep_pipe_sizes[i];
+					peak_data_size = pipe_sweep_data_sizes[j];
+				}
+			}
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %9s %10s %12s %12s\n", name,
+				"pipe size", "write size", "MB/s", "ctxsw/MB");
+			for (i = 0; i < SIZEOF_ARRAY(pipe_sweep_pipe_sizes); i++) {
+				if (!usable[i]) {
+					pr_inf(stderr, "%s: %8zuK %10s %12s %12s\n",
+						name, (size_t)(pipe_sweep_pipe_sizes[i] / KB),
+						"-", "cannot set", "pipe size");
+					continue;
+				}
+				for (j = 0; j < SIZEOF_ARRAY(pipe_sweep_data_sizes); j++) {
+					if (rates[i][j] <= 0.0)
+						break;
+					if (ctxsw_per_mb[i][j] < 0.0) {
+						pr_inf(stderr, "%s: %8zuK %10zu %12.1f %12s\n",
+							name, (size_t)(pipe_sweep_pipe_sizes[i] / KB),
+							pipe_sweep_data_sizes[j],
+							rates[i][j] / (double)MB, "n/a");
+					} else {
+						pr_inf(stderr, "%s: %8zuK %10zu %12.1f %12.1f\n",
+							name, (size_t)(pipe_sweep_pipe_sizes[i] / KB),
+							pipe_sweep_data_sizes[j],
+							rates[i][j] / (double)MB,
+							ctxsw_per_mb[i][j]);
+					}
+				}
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	/* Write sizes vary across the sweep, use the mean per bogo op */
+	if (*counter)
+		stress_units_per_op((double)total / (double)*counter);
+	stress_misc_metric_set(0, "peak pipe rate (MB/sec)", peak / (double)MB);
+	stress_misc_metric_set(1, "peak pipe size (KB)",
+		(double)peak_pipe_size / (double)KB);
+	stress_misc_metric_set(2, "peak write size (bytes)",
+		(double)peak_data_size);
+	if (ctxsw_fd > -1)
+		(void)close(ctxsw_fd);
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 /*
  *  stress_pipe
  *	stress by heavy pipe I/O
@@ -142,9 +390,15 @@ int stress_pipe(
 	const char *name)
 {
 	pid_t pid;
-	int pipefds[2];
+	int pipefds[2], ctxsw_fd;
 
+#if defined(F_SETPIPE_SZ)
+	if (opt_pipe_sweep)
+		return stress_pipe_sweep(name, instance, counter, max_ops);
+#else
 	(void)instance;
+#endif
+	stress_units_per_op((double)opt_pipe_data_size);
 
 #if defined(__linux__) && NEED_GLIBC(2,9,0)
 	if (pipe2(pipefds, O_DIRECT) < 0) {
@@ -163,6 +417,7 @@ int stress_pipe(
 	pipe_change_size(name, pipefds[1]);
 #endif
 
+	ctxsw_fd = pipe_ctxsw_open();
 again:
 	pid = fork();
 	if (pid < 0) {
@@ -170,6 +425,8 @@ again:
 			goto again;
 		(void)close(pipefds[0]);
 		(void)close(pipefds[1]);
+		if (ctxsw_fd > -1)
+			(void)close(ctxsw_fd);
 		pr_fail_dbg(name, "fork");
 		return EXIT_FAILURE;
 	} else if (pid == 0) {
@@ -207,15 +464,27 @@ again:
 	} else {
 		char buf[opt_pipe_data_size];
 		int val = 0, status;
+		const bool verify = !!(opt_flags & OPT_FLAGS_VERIFY);
+		uint64_t ctxsw = 0;
+		double t_start, duration;
 
 		/* Parent */
 		(void)setpgid(pid, pgrp);
 		(void)close(pipefds[0]);
 
+		/*
+		 *  Only fill the data when it is going to be verified,
+		 *  the fill otherwise caps the pipe throughput
+		 */
+		memset(buf, 0, sizeof(buf));
+		t_start = time_now();
 		do {
 			ssize_t ret;
+			uint64_t t_lat;
 
-			pipe_memset(buf, val++, opt_pipe_data_size);
+			if (verify)
+				pipe_memset(buf, val++, opt_pipe_data_size);
+			t_lat = latency_begin(*counter);
 			ret = write(pipefds[1], buf, opt_pipe_data_size);
 			if (ret <= 0) {
 				if ((errno == EAGAIN) || (errno == EINTR))
@@ -226,8 +495,10 @@ again:
 				}
 				continue;
 			}
+			latency_end(t_lat);
 			(*counter)++;
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
+		duration = time_now() - t_start;
 
 		strncpy(buf, PIPE_STOP, opt_pipe_data_size);
 		if (write(pipefds[1], buf, sizeof(buf)) <= 0) {
@@ -237,6 +508,19 @@ again:
 		(void)kill(pid, SIGKILL);
 		(void)waitpid(pid, &status, 0);
 		(void)close(pipefds[1]);
+
+		/* The reader's context switches are folded in once it is reaped */
+		if (duration > 0.0) {
+			const double bytes = (double)*counter * (double)opt_pipe_data_size;
+
+			stress_misc_metric_set(0, "pipe rate (MB/sec)",
+				(bytes / duration) / (double)MB);
+			if ((bytes > 0.0) && pipe_ctxsw_read(ctxsw_fd, &ctxsw))
+				stress_misc_metric_set(1, "context switches per MB",
+					(double)ctxsw * (double)MB / bytes);
+		}
+		if (ctxsw_fd > -1)
+			(void)close(ctxsw_fd);
 	}
 	return EXIT_SUCCESS;
 }
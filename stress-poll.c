@@ -31,14 +31,60 @@
 #include <poll.h>
 #include <errno.h>
 #include <signal.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 
 #include "stress-ng.h"
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+#if defined(STRESS_URING)
+#include <linux/io_uring.h>
+#endif
+
 #define MAX_PIPES	(5)
 #define POLL_BUF	(4)
 
+#define POLL_SCALE_ACTIVE	(4)	/* fds made ready in turn */
+#define POLL_SCALE_WAKEUPS	(1000)	/* wakeups timed per API and fd count */
+#define POLL_SCALE_LEVELS	(6)	/* 10, 100 .. fd counts up to N */
+#define POLL_SCALE_EVENTS	(64)	/* epoll_wait events per call */
+
+/* the wait APIs --poll-scale times */
+typedef enum {
+	SCALE_SELECT = 0,
+	SCALE_POLL,
+	SCALE_PPOLL,
+	SCALE_EPOLL_LT,			/* level triggered */
+	SCALE_EPOLL_ET,			/* edge triggered */
+	SCALE_URING,			/* io_uring one shot POLL_ADD */
+	SCALE_APIS
+} poll_scale_api_t;
+
+static const char *poll_scale_apis[SCALE_APIS] = {
+	"select",
+	"poll",
+	"ppoll",
+	"epoll-lt",
+	"epoll-et",
+	"io-uring",
+};
+
+static uint32_t opt_poll_scale = 0;
+
+void stress_set_poll_scale(const char *optarg)
+{
+	uint64_t fds;
+
+	fds = get_uint64(optarg);
+	check_range("poll-scale", fds, MIN_POLL_SCALE, MAX_POLL_SCALE);
+	opt_poll_scale = (uint32_t)fds;
+}
+
 /*
  *  pipe_read()
  *	read a pipe with some verification and checking
@@ -75,6 +121,345 @@ redo:
 	return ret;
 }
 
+/*
+ *  poll_scale_ready()
+ *	read the byte written to a ready active fd
+ */
+static inline void poll_scale_ready(const int fd)
+{
+	char buf[POLL_BUF];
+
+	(void)read(fd, buf, sizeof(buf));
+}
+
+/*
+ *  poll_scale_time()
+ *	ns per wakeup of one API waiting on the nfds fds, the idle
+ *	fds first and then the active ones, each wakeup makes the
+ *	next active fd readable and waits for it, returns a
+ *	negative value if the API can't be used
+ */
+static double poll_scale_time(
+	const poll_scale_api_t api,
+	const int *fds,
+	const size_t nfds,
+	int active[POLL_SCALE_ACTIVE][2])
+{
+	static struct pollfd *pfds;
+	static size_t pfds_n;
+	const size_t idle = nfds - POLL_SCALE_ACTIVE;
+	int i, maxfd = 0, efd = -1;
+	size_t j;
+	double t, ns = -1.0;
+#if defined(STRESS_URING)
+	stress_uring_t r;
+#endif
+
+	if (pfds_n < nfds) {
+		free(pfds);
+		pfds = calloc(nfds, sizeof(*pfds));
+		if (!pfds) {
+			pfds_n = 0;
+			return -1.0;
+		}
+		pfds_n = nfds;
+	}
+	for (j = 0; j < nfds; j++) {
+		pfds[j].fd = fds[j];
+		pfds[j].events = POLLIN;
+		if (fds[j] > maxfd)
+			maxfd = fds[j];
+	}
+
+	switch (api) {
+	case SCALE_SELECT:
+		if (maxfd >= FD_SETSIZE)
+			return -1.0;
+		break;
+#if defined(__linux__)
+	case SCALE_EPOLL_LT:
+	case SCALE_EPOLL_ET:
+		efd = epoll_create1(0);
+		if (efd < 0)
+			return -1.0;
+		for (j = 0; j < nfds; j++) {
+			struct epoll_event ev;
+
+			ev.events = EPOLLIN | ((api == SCALE_EPOLL_ET) ? EPOLLET : 0);
+			ev.data.fd = fds[j];
+			if (epoll_ctl(efd, EPOLL_CTL_ADD, fds[j], &ev) < 0) {
+				(void)close(efd);
+				return -1.0;
+			}
+		}
+		break;
+#endif
+#if defined(STRESS_URING)
+	case SCALE_URING:
+		if (uring_setup(&r, 4096, false) < 0)
+			return -1.0;
+		for (j = 0; j < nfds; j++) {
+			struct io_uring_sqe *sqe = uring_prep_rw(&r,
+				IORING_OP_POLL_ADD, fds[j], NULL, 0, 0, fds[j]);
+
+			if (!sqe) {
+				uring_free(&r);
+				return -1.0;
+			}
+			sqe->poll32_events = POLLIN;
+		}
+		if (uring_submit(&r, 0) < 0) {
+			uring_free(&r);
+			return -1.0;
+		}
+		break;
+#endif
+	case SCALE_POLL:
+	case SCALE_PPOLL:
+		break;
+	default:
+		return -1.0;
+	}
+
+	t = time_now();
+	for (i = 0; i < POLL_SCALE_WAKEUPS; i++) {
+		const int a = i % POLL_SCALE_ACTIVE;
+		int ret = 0;
+
+		if (write(active[a][1], "x", 1) < 0)
+			break;
+
+		switch (api) {
+		case SCALE_SELECT: {
+			fd_set rfds;
+			struct timeval tv;
+
+			/* Legacy code rebuilds the set for every call */
+			FD_ZERO(&rfds);
+			for (j = 0; j < nfds; j++)
+				FD_SET(fds[j], &rfds);
+			tv.tv_sec = 1;
+			tv.tv_usec = 0;
+			ret = select(maxfd + 1, &rfds, NULL, NULL, &tv);
+			for (j = idle; (ret > 0) && (j < nfds); j++)
+				if (FD_ISSET(fds[j], &rfds))
+					poll_scale_ready(fds[j]);
+			break;
+		}
+		case SCALE_POLL:
+		case SCALE_PPOLL:
+			if (api == SCALE_POLL) {
+				ret = poll(pfds, nfds, 1000);
+			} else {
+#if defined(__linux__)
+				struct timespec ts;
+
+				ts.tv_sec = 1;
+				ts.tv_nsec = 0;
+				ret = ppoll(pfds, nfds, &ts, NULL);
+#endif
+			}
+			/* ..and scans the whole array for the ready fds */
+			for (j = 0; (ret > 0) && (j < nfds); j++)
+				if (pfds[j].revents & POLLIN)
+					poll_scale_ready(pfds[j].fd);
+			break;
+#if defined(__linux__)
+		case SCALE_EPOLL_LT:
+		case SCALE_EPOLL_ET: {
+			struct epoll_event events[POLL_SCALE_EVENTS];
+			int k;
+
+			ret = epoll_wait(efd, events, POLL_SCALE_EVENTS, 1000);
+			for (k = 0; k < ret; k++)
+				poll_scale_ready(events[k].data.fd);
+			break;
+		}
+#endif
+#if defined(STRESS_URING)
+		case SCALE_URING: {
+			unsigned head, tail;
+
+			/* Also submits the previous wakeup's re-arm */
+			ret = uring_submit(&r, 1);
+			head = *r.cq_head;
+			tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+			for (; head != tail; head++) {
+				const int fd = (int)r.cqes[head & r.cq_mask].user_data;
+				struct io_uring_sqe *sqe;
+
+				poll_scale_ready(fd);
+				sqe = uring_prep_rw(&r, IORING_OP_POLL_ADD,
+					fd, NULL, 0, 0, fd);
+				if (sqe)
+					sqe->poll32_events = POLLIN;
+			}
+			__atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+			break;
+		}
+#endif
+		default:
+			break;
+		}
+		if (ret < 0)
+			break;
+	}
+	t = time_now() - t;
+	if (i == POLL_SCALE_WAKEUPS)
+		ns = (t * 1000000000.0) / POLL_SCALE_WAKEUPS;
+
+	if (efd >= 0)
+		(void)close(efd);
+#if defined(STRESS_URING)
+	if (api == SCALE_URING)
+		uring_free(&r);
+#endif
+	return ns;
+}
+
+/*
+ *  poll_scale_nofile()
+ *	raise the fd limit to fit n fds, returns the fds that fit
+ */
+static uint32_t poll_scale_nofile(const uint32_t n)
+{
+	struct rlimit rlim;
+	const rlim_t want = n + (2 * POLL_SCALE_ACTIVE) + 64;
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim) < 0)
+		return n;
+	if (rlim.rlim_cur >= want)
+		return n;
+	rlim.rlim_cur = want;
+	if (rlim.rlim_max < want)
+		rlim.rlim_max = want;
+	if (setrlimit(RLIMIT_NOFILE, &rlim) == 0)
+		return n;
+	/* Not privileged to raise the hard limit, use what there is */
+	(void)getrlimit(RLIMIT_NOFILE, &rlim);
+	rlim.rlim_cur = rlim.rlim_max;
+	(void)setrlimit(RLIMIT_NOFILE, &rlim);
+	if (rlim.rlim_cur <= (2 * POLL_SCALE_ACTIVE) + 64 + 10)
+		return 0;
+	return (uint32_t)(rlim.rlim_cur - (2 * POLL_SCALE_ACTIVE) - 64);
+}
+
+/*
+ *  stress_poll_scale()
+ *	time per wakeup of select, poll, ppoll, epoll and io_uring
+ *	waiting on 10, 100 .. up to --poll-scale idle fds plus
+ *	POLL_SCALE_ACTIVE active ones. The idle fds are dups of
+ *	one pipe with nothing written to it. One bogo op per sweep.
+ */
+static int stress_poll_scale(
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const char *name)
+{
+	int active[POLL_SCALE_ACTIVE][2], idle[2];
+	int *fds, *set;
+	uint32_t levels[POLL_SCALE_LEVELS], n_levels = 0, n, i, max;
+	double ns[SCALE_APIS][POLL_SCALE_LEVELS];
+	uint64_t samples[SCALE_APIS][POLL_SCALE_LEVELS];
+	int rc = EXIT_SUCCESS;
+	size_t j;
+
+	max = poll_scale_nofile(opt_poll_scale);
+	if (max < opt_poll_scale) {
+		pr_inf(stderr, "%s: fd limit allows %" PRIu32 " idle fds, "
+			"not %" PRIu32 "\n", name, max, opt_poll_scale);
+		if (max < MIN_POLL_SCALE)
+			return EXIT_NO_RESOURCE;
+	}
+	for (n = 10; (n < max) && (n_levels < POLL_SCALE_LEVELS - 1); n *= 10)
+		levels[n_levels++] = n;
+	levels[n_levels++] = max;
+
+	fds = calloc(max, sizeof(*fds));
+	set = calloc(max + POLL_SCALE_ACTIVE, sizeof(*set));
+	if (!fds || !set) {
+		pr_inf(stderr, "%s: out of memory\n", name);
+		free(fds);
+		free(set);
+		return EXIT_NO_RESOURCE;
+	}
+	if (pipe(idle) < 0) {
+		pr_fail_dbg(name, "pipe");
+		free(fds);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < POLL_SCALE_ACTIVE; i++) {
+		if (pipe(active[i]) < 0) {
+			pr_fail_dbg(name, "pipe");
+			while (i-- > 0) {
+				(void)close(active[i][0]);
+				(void)close(active[i][1]);
+			}
+			rc = EXIT_FAILURE;
+			goto close_idle;
+		}
+	}
+	for (n = 0; n < max; n++) {
+		fds[n] = dup(idle[0]);
+		if (fds[n] < 0) {
+			pr_fail_dbg(name, "dup");
+			rc = EXIT_NO_RESOURCE;
+			goto close_fds;
+		}
+	}
+	(void)memset(ns, 0, sizeof(ns));
+	(void)memset(samples, 0, sizeof(samples));
+
+	do {
+		for (i = 0; opt_do_run && (i < n_levels); i++) {
+			int a;
+
+			/* The active fds go after the first levels[i] idle ones */
+			(void)memcpy(set, fds, levels[i] * sizeof(*set));
+			for (a = 0; a < POLL_SCALE_ACTIVE; a++)
+				set[levels[i] + a] = active[a][0];
+			for (j = 0; opt_do_run && (j < SCALE_APIS); j++) {
+				const double t = poll_scale_time(j, set,
+					levels[i] + POLL_SCALE_ACTIVE, active);
+
+				if (t >= 0.0) {
+					ns[j][i] += t;
+					samples[j][i]++;
+				}
+			}
+		}
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	for (j = 0; j < SCALE_APIS; j++) {
+		for (i = 0; i < n_levels; i++) {
+			char desc[32];
+
+			if (!samples[j][i])
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s %" PRIu32
+				" fds ns/wakeup", poll_scale_apis[j], levels[i]);
+			stress_misc_metric_set((j * POLL_SCALE_LEVELS) + i, desc,
+				ns[j][i] / samples[j][i]);
+		}
+	}
+
+close_fds:
+	for (i = 0; i < n; i++)
+		(void)close(fds[i]);
+	for (i = 0; i < POLL_SCALE_ACTIVE; i++) {
+		(void)close(active[i][0]);
+		(void)close(active[i][1]);
+	}
+close_idle:
+	(void)close(idle[0]);
+	(void)close(idle[1]);
+	free(set);
+	free(fds);
+
+	return rc;
+}
+
 /*
  *  stress_poll()
  *	stress system by rapid polling system calls
@@ -92,6 +477,9 @@ int stress_poll(
 
 	(void)instance;
 
+	if (opt_poll_scale)
+		return stress_poll_scale(counter, max_ops, name);
+
 	for (i = 0; i < MAX_PIPES; i++) {
 		if (pipe(pipefds[i]) < 0) {
 			pr_fail_dbg(name, "pipe");
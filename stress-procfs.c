@@ -50,6 +50,15 @@ typedef struct ctxt {
 
 static volatile bool keep_running;
 static sigset_t set;
+static uint32_t opt_procfs_top = 0;
+static stress_path_stats_t path_stats;
+
+void stress_set_procfs_top(const char *optarg)
+{
+	opt_procfs_top = get_uint32(optarg);
+	check_range("procfs-top", opt_procfs_top,
+		MIN_PROCFS_TOP, MAX_PROCFS_TOP);
+}
 
 /*
  *  stress_proc_rw()
@@ -242,6 +251,8 @@ static void stress_proc_dir(
 		case DT_REG:
 			snprintf(name, sizeof(name),
 				"%s/%s", path, d->d_name);
+			if (path_stats.table)
+				path_stats_read(&path_stats, name);
 			stress_proc_rw_threads(name, proc_write);
 			break;
 		default:
@@ -263,11 +274,12 @@ int stress_procfs(
 {
 	bool proc_write = true;
 
-	(void)instance;
-	(void)name;
-
 	sigfillset(&set);
 
+	if (opt_procfs_top && (path_stats_init(&path_stats) < 0))
+		pr_inf(stderr, "%s: cannot allocate file timing table, "
+			"not timing file reads\n", name);
+
 	if (geteuid() == 0)
                 proc_write = false;
 
@@ -339,6 +351,11 @@ int stress_procfs(
 			break;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
+	if (path_stats.table) {
+		path_stats_report(name, instance, &path_stats, opt_procfs_top);
+		path_stats_free(&path_stats);
+	}
+
 	return EXIT_SUCCESS;
 }
 #endif
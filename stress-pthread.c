@@ -36,6 +36,7 @@
 #include <sys/wait.h>
 #include <pthread.h>
 #include <errno.h>
+#include <string.h>
 #include <signal.h>
 #if defined(__linux__)
 /* For get_robust_list on Linux: */
@@ -46,8 +47,40 @@
 #endif
 #endif
 
+#define PTHREAD_METHOD_CREATE	(0)	/* create, wait and join */
+#define PTHREAD_METHOD_POOL	(1)	/* dispatch tasks to a thread pool */
+
+#define PTHREAD_LAT_CREATE	(0)	/* pthread_create() call */
+#define PTHREAD_LAT_START	(1)	/* pthread_create() to thread running */
+#define PTHREAD_LAT_JOIN	(2)	/* pthread_join() call */
+#define PTHREAD_LAT_MAX		(3)
+
+#define PTHREAD_POOL_QUEUE	(256)	/* tasks queued to the pool */
+#define PTHREAD_POOL_TASK	(64)	/* mwc calls per task */
+
+typedef struct {
+	const char *name;	/* User option */
+	int method;		/* PTHREAD_METHOD_ value */
+} pthread_method_t;
+
+static const pthread_method_t pthread_methods[] = {
+	{ "create",	PTHREAD_METHOD_CREATE },
+#if defined(STRESS_LATENCY)
+	{ "pool",	PTHREAD_METHOD_POOL },
+#endif
+};
+
+/* A created thread and its creation times */
+typedef struct {
+	pthread_t pthread;		/* the thread */
+	uint64_t t_create;		/* ns, before pthread_create() */
+	uint64_t t_start;		/* ns, thread running, 0 if not yet */
+} pthread_info_t;
+
 static uint64_t opt_pthread_max = DEFAULT_PTHREAD;
 static bool set_pthread_max = false;
+static uint64_t opt_pthread_stack;	/* 0 = libc default */
+static int opt_pthread_method = PTHREAD_METHOD_CREATE;
 static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static bool thread_terminate;
@@ -62,6 +95,34 @@ void stress_set_pthread_max(const char *optarg)
 		MIN_PTHREAD, MAX_PTHREAD);
 }
 
+void stress_set_pthread_stack(const char *optarg)
+{
+	opt_pthread_stack = get_uint64_byte(optarg);
+	check_range("pthread-stack", opt_pthread_stack,
+		MIN_PTHREAD_STACK, MAX_PTHREAD_STACK);
+}
+
+/*
+ *  stress_set_pthread_method()
+ *	set the thread creation or pool dispatch method
+ */
+int stress_set_pthread_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(pthread_methods); i++) {
+		if (!strcmp(name, pthread_methods[i].name)) {
+			opt_pthread_method = pthread_methods[i].method;
+			return 0;
+		}
+	}
+	fprintf(stderr, "pthread-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(pthread_methods); i++)
+		fprintf(stderr, " %s", pthread_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
 void stress_adjust_pthread_max(uint64_t max)
 {
 	if (opt_pthread_max > max) {
@@ -85,6 +146,7 @@ static inline long sys_get_robust_list(int pid, struct robust_list_head **head_p
  */
 static void *stress_pthread_func(void *ctxt)
 {
+	pthread_info_t *info = (pthread_info_t *)ctxt;
 	uint8_t stack[SIGSTKSZ];
 	stack_t ss;
 	static void *nowt = NULL;
@@ -94,7 +156,7 @@ static void *stress_pthread_func(void *ctxt)
 	size_t len_ptr;
 #endif
 
-	(void)ctxt;
+	info->t_start = time_now_ns();
 
 	/*
 	 *  Block all signals, let controlling thread
@@ -167,9 +229,190 @@ die:
 	return &nowt;
 }
 
+#if defined(STRESS_LATENCY)
+/* The task queue of the thread pool */
+typedef struct {
+	pthread_mutex_t lock;		/* guards all the fields below */
+	pthread_cond_t not_empty;	/* a task was queued */
+	pthread_cond_t not_full;	/* a task was taken */
+	uint64_t queued[PTHREAD_POOL_QUEUE]; /* ns, when each task was queued */
+	uint32_t head;			/* next task to take */
+	uint32_t count;			/* tasks in the queue */
+	bool stop;			/* workers exit when the queue drains */
+} pthread_pool_t;
+
+/* A pool worker */
+typedef struct {
+	pthread_t pthread;		/* the thread */
+	pthread_pool_t *pool;		/* the shared queue */
+	uint64_t tasks;			/* tasks run */
+	stress_latency_t lat;		/* queued to taken latency */
+} pthread_worker_t;
+
+/*
+ *  stress_pthread_pool_worker()
+ *	take tasks off the queue and run them until told to stop
+ */
+static void *stress_pthread_pool_worker(void *ctxt)
+{
+	pthread_worker_t *w = (pthread_worker_t *)ctxt;
+	pthread_pool_t *pool = w->pool;
+	static void *nowt = NULL;
+
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+	for (;;) {
+		uint64_t t_queued, sum = 0;
+		uint32_t i;
+
+		(void)pthread_mutex_lock(&pool->lock);
+		while (!pool->count && !pool->stop)
+			(void)pthread_cond_wait(&pool->not_empty, &pool->lock);
+		if (!pool->count) {
+			(void)pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		t_queued = pool->queued[pool->head];
+		pool->head = (pool->head + 1) % PTHREAD_POOL_QUEUE;
+		pool->count--;
+		(void)pthread_cond_signal(&pool->not_full);
+		(void)pthread_mutex_unlock(&pool->lock);
+
+		latency_record(&w->lat, time_now_ns() - t_queued);
+		/* A small task, the queue hand-off should dominate */
+		for (i = 0; i < PTHREAD_POOL_TASK; i++)
+			sum += mwc32();
+		uint64_put(sum);
+		w->tasks++;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_pthread_pool()
+ *	dispatch tasks through a queue to a pool of threads and
+ *	measure the queued to running latency and the task rate
+ */
+static int stress_pthread_pool(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const pthread_attr_t *attr)
+{
+	pthread_pool_t pool;
+	pthread_worker_t *workers;
+	stress_latency_t lat;
+	uint64_t i, nworkers, started = 0, tasks = 0;
+	double t_start, duration;
+	int rc = EXIT_SUCCESS;
+
+	/* One worker per CPU unless --pthread-max is given */
+	nworkers = set_pthread_max ? opt_pthread_max :
+		(uint64_t)stress_get_processors_online();
+	if (nworkers > MAX_PTHREAD_POOL)
+		nworkers = MAX_PTHREAD_POOL;
+	if (nworkers < 1)
+		nworkers = 1;
+
+	workers = calloc(nworkers, sizeof(*workers));
+	if (!workers) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu64 " pool workers\n",
+			name, nworkers);
+		return EXIT_NO_RESOURCE;
+	}
+	memset(&pool, 0, sizeof(pool));
+	(void)pthread_mutex_init(&pool.lock, NULL);
+	(void)pthread_cond_init(&pool.not_empty, NULL);
+	(void)pthread_cond_init(&pool.not_full, NULL);
+
+	for (i = 0; i < nworkers; i++) {
+		int ret;
+
+		workers[i].pool = &pool;
+		ret = pthread_create(&workers[i].pthread, attr,
+			stress_pthread_pool_worker, &workers[i]);
+		if (ret) {
+			if (!started) {
+				pr_fail_errno(name, "pthread create", ret);
+				rc = EXIT_FAILURE;
+				goto destroy;
+			}
+			pr_dbg(stderr, "%s: only %" PRIu64 " of %" PRIu64
+				" pool workers started\n", name, started, nworkers);
+			break;
+		}
+		started++;
+	}
+
+	t_start = time_now();
+	do {
+		(void)pthread_mutex_lock(&pool.lock);
+		while ((pool.count == PTHREAD_POOL_QUEUE) && opt_do_run)
+			(void)pthread_cond_wait(&pool.not_full, &pool.lock);
+		if (pool.count < PTHREAD_POOL_QUEUE) {
+			pool.queued[(pool.head + pool.count) % PTHREAD_POOL_QUEUE] =
+				time_now_ns();
+			pool.count++;
+			(void)pthread_cond_signal(&pool.not_empty);
+			(*counter)++;
+		}
+		(void)pthread_mutex_unlock(&pool.lock);
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	(void)pthread_mutex_lock(&pool.lock);
+	pool.stop = true;
+	(void)pthread_cond_broadcast(&pool.not_empty);
+	(void)pthread_mutex_unlock(&pool.lock);
+	for (i = 0; i < started; i++)
+		(void)pthread_join(workers[i].pthread, NULL);
+	duration = time_now() - t_start;
+
+	/* Merge the worker histograms */
+	memset(&lat, 0, sizeof(lat));
+	for (i = 0; i < started; i++) {
+		const stress_latency_t *wl = &workers[i].lat;
+		size_t b;
+
+		for (b = 0; b < LATENCY_BUCKETS; b++)
+			lat.bucket[b] += wl->bucket[b];
+		lat.count += wl->count;
+		if (wl->max > lat.max)
+			lat.max = wl->max;
+		tasks += workers[i].tasks;
+	}
+	if (lat.count) {
+		const double rate = (duration > 0.0) ? (double)tasks / duration : 0.0;
+
+		if (instance == 0)
+			pr_inf(stderr, "%s: %" PRIu64 " pool workers, dispatch "
+				"latency p50 %.1f, p99 %.1f, max %.1f usec, "
+				"%.0f tasks/s\n", name, started,
+				latency_percentile_usec(&lat, 0.50),
+				latency_percentile_usec(&lat, 0.99),
+				(double)lat.max / 1000.0, rate);
+		stress_misc_metric_set(0, "dispatch p50 (usec)",
+			latency_percentile_usec(&lat, 0.50));
+		stress_misc_metric_set(1, "dispatch p99 (usec)",
+			latency_percentile_usec(&lat, 0.99));
+		stress_misc_metric_set(2, "dispatch max (usec)",
+			(double)lat.max / 1000.0);
+		stress_misc_metric_set(3, "tasks/s", rate);
+	}
+destroy:
+	(void)pthread_cond_destroy(&pool.not_full);
+	(void)pthread_cond_destroy(&pool.not_empty);
+	(void)pthread_mutex_destroy(&pool.lock);
+	free(workers);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_pthread()
- *	stress by creating pthreads
+ *	stress by creating pthreads, measuring the create,
+ *	start and join latencies, or by dispatching tasks
+ *	to a thread pool
  */
 int stress_pthread(
 	uint64_t *const counter,
@@ -177,9 +420,16 @@ int stress_pthread(
 	const uint64_t max_ops,
 	const char *name)
 {
-	pthread_t pthreads[MAX_PTHREAD];
+	pthread_info_t *pthreads;
+	pthread_attr_t attr;
 	bool ok = true;
 	uint64_t limited = 0, attempted = 0;
+	int rc = EXIT_SUCCESS;
+#if defined(STRESS_LATENCY)
+	stress_latency_t lat[PTHREAD_LAT_MAX];
+
+	memset(lat, 0, sizeof(lat));
+#endif
 
 	if (!set_pthread_max) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -188,7 +438,34 @@ int stress_pthread(
 			opt_pthread_max = MIN_PTHREAD;
 	}
 
+	(void)pthread_attr_init(&attr);
+	if (opt_pthread_stack) {
+		const int ret = pthread_attr_setstacksize(&attr, (size_t)opt_pthread_stack);
+
+		if (ret) {
+			pr_inf(stderr, "%s: cannot set a %" PRIu64 " byte stack, "
+				"errno=%d (%s), using the default\n", name,
+				opt_pthread_stack, ret, strerror(ret));
+		}
+	}
+
 	sigfillset(&set);
+#if defined(STRESS_LATENCY)
+	if (opt_pthread_method == PTHREAD_METHOD_POOL) {
+		rc = stress_pthread_pool(counter, instance, max_ops, name, &attr);
+		(void)pthread_attr_destroy(&attr);
+		return rc;
+	}
+#endif
+
+	pthreads = calloc(opt_pthread_max, sizeof(*pthreads));
+	if (!pthreads) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu64 " threads\n",
+			name, opt_pthread_max);
+		(void)pthread_attr_destroy(&attr);
+		return EXIT_NO_RESOURCE;
+	}
+
 	do {
 		uint64_t i, j;
 		int ret;
@@ -197,8 +474,14 @@ int stress_pthread(
 		pthread_count = 0;
 
 		for (i = 0; (i < opt_pthread_max) && (!max_ops || *counter < max_ops); i++) {
-			ret = pthread_create(&pthreads[i], NULL,
-				stress_pthread_func, NULL);
+			pthreads[i].t_start = 0;
+			pthreads[i].t_create = time_now_ns();
+			ret = pthread_create(&pthreads[i].pthread, &attr,
+				stress_pthread_func, &pthreads[i]);
+#if defined(STRESS_LATENCY)
+			latency_record(&lat[PTHREAD_LAT_CREATE],
+				time_now_ns() - pthreads[i].t_create);
+#endif
 			if (ret) {
 				/* Out of resources, don't try any more */
 				if (ret == EAGAIN) {
@@ -262,11 +545,22 @@ int stress_pthread(
 		}
 reap:
 		for (j = 0; j < i; j++) {
-			ret = pthread_join(pthreads[j], NULL);
+			const uint64_t t_join = time_now_ns();
+
+			ret = pthread_join(pthreads[j].pthread, NULL);
 			if (ret) {
 				pr_fail_errno(name, "pthread join", ret);
 				ok = false;
+				continue;
 			}
+#if defined(STRESS_LATENCY)
+			latency_record(&lat[PTHREAD_LAT_JOIN], time_now_ns() - t_join);
+			if (pthreads[j].t_start >= pthreads[j].t_create)
+				latency_record(&lat[PTHREAD_LAT_START],
+					pthreads[j].t_start - pthreads[j].t_create);
+#else
+			(void)t_join;
+#endif
 		}
 	} while (ok && opt_do_run && (!max_ops || *counter < max_ops));
 
@@ -279,10 +573,43 @@ reap:
 			opt_pthread_max, instance);
 	}
 
+#if defined(STRESS_LATENCY)
+	if (lat[PTHREAD_LAT_JOIN].count) {
+		static const char *lat_names[PTHREAD_LAT_MAX] = {
+			"create", "start", "join"
+		};
+		size_t l, idx = 0;
+
+		if (instance == 0)
+			pr_inf(stderr, "%s: %" PRIu64 "K stack, latency p50/p99 "
+				"usec: create %.1f/%.1f, start %.1f/%.1f, "
+				"join %.1f/%.1f\n", name, (uint64_t)(opt_pthread_stack / KB),
+				latency_percentile_usec(&lat[PTHREAD_LAT_CREATE], 0.50),
+				latency_percentile_usec(&lat[PTHREAD_LAT_CREATE], 0.99),
+				latency_percentile_usec(&lat[PTHREAD_LAT_START], 0.50),
+				latency_percentile_usec(&lat[PTHREAD_LAT_START], 0.99),
+				latency_percentile_usec(&lat[PTHREAD_LAT_JOIN], 0.50),
+				latency_percentile_usec(&lat[PTHREAD_LAT_JOIN], 0.99));
+		for (l = 0; l < PTHREAD_LAT_MAX; l++) {
+			char desc[32];
+
+			if (!lat[l].count)
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s p50 (usec)", lat_names[l]);
+			stress_misc_metric_set(idx++, desc,
+				latency_percentile_usec(&lat[l], 0.50));
+			(void)snprintf(desc, sizeof(desc), "%s p99 (usec)", lat_names[l]);
+			stress_misc_metric_set(idx++, desc,
+				latency_percentile_usec(&lat[l], 0.99));
+		}
+	}
+#endif
+	free(pthreads);
+	(void)pthread_attr_destroy(&attr);
 	(void)pthread_cond_destroy(&cond);
 	(void)pthread_mutex_destroy(&mutex);
 
-	return EXIT_SUCCESS;
+	return rc;
 }
 
 #endif
@@ -31,22 +31,396 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <signal.h>
 #include <unistd.h>
 #include <termio.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #define MAX_PTYS	(65536)
 
+#define PTY_PHASE_TIME	(0.5)	/* secs of each --pty-data phase */
+#define PTY_BLOCK	(4096)	/* bytes per write */
+#define PTY_LINE	(64)	/* bytes per canonical line */
+
+/* what the slave side process of --pty-data is doing */
+enum {
+	PTY_PHASE_IDLE = 0,	/* nothing, ttys are being set up */
+	PTY_PHASE_READ,		/* read and count the bytes */
+	PTY_PHASE_ECHO,		/* write back each byte read */
+	PTY_PHASE_EXIT,		/* all done */
+};
+
 typedef struct {
 	char *slavename;
 	int master;
 	int slave;
 } pty_info_t;
 
+/* state shared with the slave side process */
+typedef struct {
+	volatile int phase;	/* PTY_PHASE_* to run */
+	volatile int ack;	/* phase the slave side is running */
+	volatile uint64_t bytes; /* bytes read by the slave side */
+} pty_data_shared_t;
+
+static uint64_t opt_pty_max = DEFAULT_PTY_MAX;
+static bool opt_pty_data = false;
+
+void stress_set_pty_data(void)
+{
+	opt_pty_data = true;
+}
+
+void stress_set_pty_max(const char *optarg)
+{
+	opt_pty_max = get_uint64(optarg);
+	check_range("pty-max", opt_pty_max, MIN_PTY_MAX, MAX_PTY_MAX);
+}
+
+/*
+ *  stress_pty_open_pair()
+ *	open a master and its slave, returns -1 and leaves both
+ *	closed on failure
+ */
+static int stress_pty_open_pair(pty_info_t *pty)
+{
+	pty->slave = -1;
+	pty->master = open("/dev/ptmx", O_RDWR | O_NOCTTY);
+	if (pty->master < 0)
+		return -1;
+	pty->slavename = ptsname(pty->master);
+	if (!pty->slavename || (grantpt(pty->master) < 0) ||
+	    (unlockpt(pty->master) < 0))
+		goto close_master;
+	pty->slave = open(pty->slavename, O_RDWR | O_NOCTTY);
+	if (pty->slave < 0)
+		goto close_master;
+	return 0;
+
+close_master:
+	(void)close(pty->master);
+	pty->master = -1;
+	return -1;
+}
+
+/*
+ *  stress_pty_set_mode()
+ *	switch all the slaves to raw or to canonical mode without
+ *	echo, dropping anything still queued from the last phase
+ */
+static void stress_pty_set_mode(pty_info_t *ptys, const size_t n, const bool canonical)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		struct termios ios;
+
+		if (tcgetattr(ptys[i].slave, &ios) < 0)
+			continue;
+		cfmakeraw(&ios);
+		if (canonical)
+			ios.c_lflag |= ICANON;
+		(void)tcsetattr(ptys[i].slave, TCSANOW, &ios);
+		(void)tcflush(ptys[i].slave, TCIOFLUSH);
+		(void)tcflush(ptys[i].master, TCIOFLUSH);
+	}
+}
+
+/*
+ *  stress_pty_slave_side()
+ *	the process at the slave end, like a shell this reads
+ *	what is typed into the terminals and in the echo phase
+ *	writes it straight back
+ */
+static void stress_pty_slave_side(
+	pty_data_shared_t *sh,
+	const pty_info_t *ptys,
+	struct pollfd *pfds,
+	const size_t n)
+{
+	char buf[PTY_BLOCK];
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		pfds[i].fd = ptys[i].slave;
+		pfds[i].events = POLLIN;
+	}
+	for (;;) {
+		const int phase = sh->phase;
+		int ret;
+
+		sh->ack = phase;
+		if (phase == PTY_PHASE_EXIT)
+			break;
+		if (phase == PTY_PHASE_IDLE) {
+			(void)usleep(1000);
+			continue;
+		}
+		ret = poll(pfds, (nfds_t)n, 10);
+		for (i = 0; (ret > 0) && (i < n); i++) {
+			ssize_t len;
+
+			if (!(pfds[i].revents & POLLIN))
+				continue;
+			len = read(pfds[i].fd, buf, sizeof(buf));
+			if (len <= 0)
+				continue;
+			if (phase == PTY_PHASE_ECHO)
+				(void)write(pfds[i].fd, buf, (size_t)len);
+			else
+				sh->bytes += (uint64_t)len;
+		}
+	}
+}
+
+/*
+ *  stress_pty_phase()
+ *	tell the slave side to run a phase and wait until it is,
+ *	a phase can only be changed from idle
+ */
+static bool stress_pty_phase(pty_data_shared_t *sh, const int phase)
+{
+	const double t = time_now();
+
+	sh->phase = phase;
+	while (sh->ack != phase) {
+		if (time_now() - t > 1.0)
+			return false;
+		(void)usleep(1000);
+	}
+	return true;
+}
+
+/*
+ *  stress_pty_throughput()
+ *	write blocks into the masters for a phase, in canonical
+ *	mode the blocks are lines, and return the MB/sec the
+ *	slave side read
+ */
+static double stress_pty_throughput(
+	pty_data_shared_t *sh,
+	const pty_info_t *ptys,
+	struct pollfd *pfds,
+	const size_t n,
+	const bool canonical)
+{
+	char buf[PTY_BLOCK];
+	uint64_t bytes;
+	double t, duration;
+	size_t i;
+
+	memset(buf, 'x', sizeof(buf));
+	if (canonical) {
+		for (i = PTY_LINE - 1; i < sizeof(buf); i += PTY_LINE)
+			buf[i] = '\n';
+	}
+	for (i = 0; i < n; i++) {
+		pfds[i].fd = ptys[i].master;
+		pfds[i].events = POLLOUT;
+	}
+
+	bytes = sh->bytes;
+	if (!stress_pty_phase(sh, PTY_PHASE_READ))
+		return -1.0;
+	t = time_now();
+	while (opt_do_run && (time_now() - t < PTY_PHASE_TIME)) {
+		int ret = poll(pfds, (nfds_t)n, 10);
+
+		for (i = 0; (ret > 0) && (i < n); i++) {
+			if (pfds[i].revents & POLLOUT)
+				(void)write(pfds[i].fd, buf, sizeof(buf));
+		}
+	}
+	duration = time_now() - t;
+	bytes = sh->bytes - bytes;
+	if (!stress_pty_phase(sh, PTY_PHASE_IDLE) || (duration <= 0.0))
+		return -1.0;
+	return ((double)bytes / (double)MB) / duration;
+}
+
+/*
+ *  stress_pty_echo()
+ *	type a byte into every master at once and time each one
+ *	coming back from the slave side, as a keystroke echoed
+ *	by a shell would
+ */
+static void stress_pty_echo(
+	pty_data_shared_t *sh,
+	const pty_info_t *ptys,
+	struct pollfd *pfds,
+	uint64_t *sent,
+	const size_t n,
+	stress_latency_t *lat)
+{
+	double t;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		pfds[i].fd = ptys[i].master;
+		pfds[i].events = POLLIN;
+	}
+	if (!stress_pty_phase(sh, PTY_PHASE_ECHO))
+		return;
+	t = time_now();
+	while (opt_do_run && (time_now() - t < PTY_PHASE_TIME)) {
+		size_t pending = 0;
+		char ch = 'e';
+
+		for (i = 0; i < n; i++) {
+			sent[i] = time_now_ns();
+			if (write(ptys[i].master, &ch, sizeof(ch)) == sizeof(ch))
+				pending++;
+			else
+				sent[i] = 0;
+		}
+		while (pending && opt_do_run) {
+			int ret = poll(pfds, (nfds_t)n, 100);
+
+			if (ret <= 0)
+				break;
+			for (i = 0; i < n; i++) {
+				if (!(pfds[i].revents & POLLIN))
+					continue;
+				if ((read(pfds[i].fd, &ch, sizeof(ch)) == sizeof(ch)) && sent[i]) {
+					latency_record(lat, time_now_ns() - sent[i]);
+					sent[i] = 0;
+					pending--;
+				}
+			}
+		}
+	}
+	(void)stress_pty_phase(sh, PTY_PHASE_IDLE);
+}
+
+/*
+ *  stress_pty_data()
+ *	push data through PTYs in raw and canonical mode and time
+ *	echoes, with the number of PTYs growing by 4x from 1 up to
+ *	--pty-max. A child process serves the slave ends
+ */
+static int stress_pty_data(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	pty_data_shared_t *sh;
+	pty_info_t *ptys;
+	struct pollfd *pfds;
+	uint64_t *sent;
+	bool reported = false;
+	int rc = EXIT_SUCCESS;
+
+	sh = (pty_data_shared_t *)mmap(NULL, sizeof(*sh), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ptys = calloc((size_t)opt_pty_max, sizeof(*ptys));
+	pfds = calloc((size_t)opt_pty_max, sizeof(*pfds));
+	sent = calloc((size_t)opt_pty_max, sizeof(*sent));
+	if ((sh == MAP_FAILED) || !ptys || !pfds || !sent) {
+		pr_err(stderr, "%s: out of memory\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_state;
+	}
+
+	do {
+		size_t n, opened = 0, idx = 0;
+
+		if ((instance == 0) && !reported)
+			pr_inf(stderr, "%s: %6s %12s %12s %12s %12s\n", name, "ptys",
+				"raw MB/sec", "canon MB/sec", "echo p50 us", "echo p99 us");
+
+		for (n = 1; opt_do_run && (n <= opt_pty_max); n *= 4) {
+			stress_latency_t lat;
+			double raw, canon;
+			pid_t pid;
+			size_t i;
+			int status;
+
+			/* Grow the PTYs to n, stop growing if there are no more */
+			for (; opened < n; opened++) {
+				if (stress_pty_open_pair(&ptys[opened]) < 0)
+					break;
+				(void)fcntl(ptys[opened].master, F_SETFL, O_NONBLOCK);
+				(void)fcntl(ptys[opened].slave, F_SETFL, O_NONBLOCK);
+			}
+			if (opened < n) {
+				if ((instance == 0) && !reported)
+					pr_inf(stderr, "%s: cannot open more than %zu "
+						"PTYs, errno=%d (%s)\n", name, opened,
+						errno, strerror(errno));
+				break;
+			}
+
+			memset(sh, 0, sizeof(*sh));
+			memset(&lat, 0, sizeof(lat));
+			stress_pty_set_mode(ptys, n, false);
+			pid = fork();
+			if (pid < 0)
+				break;
+			if (pid == 0) {
+				(void)setpgid(0, pgrp);
+				stress_parent_died_alarm();
+				stress_pty_slave_side(sh, ptys, pfds, n);
+				_exit(0);
+			}
+			(void)setpgid(pid, pgrp);
+
+			raw = stress_pty_throughput(sh, ptys, pfds, n, false);
+			stress_pty_echo(sh, ptys, pfds, sent, n, &lat);
+			stress_pty_set_mode(ptys, n, true);
+			canon = stress_pty_throughput(sh, ptys, pfds, n, true);
+
+			if (!stress_pty_phase(sh, PTY_PHASE_EXIT))
+				(void)kill(pid, SIGKILL);
+			(void)waitpid(pid, &status, 0);
+			if (!opt_do_run)
+				break;
+
+			if ((instance == 0) && !reported)
+				pr_inf(stderr, "%s: %6zu %12.2f %12.2f %12.1f %12.1f\n",
+					name, n, raw, canon,
+					(double)latency_percentile(&lat, 0.50) / 1000.0,
+					(double)latency_percentile(&lat, 0.99) / 1000.0);
+			for (i = 0; i < 3; i++) {
+				static const char *what[] = { "raw MB/sec", "canon MB/sec", "echo p99 usec" };
+				const double val[] = { raw, canon,
+					(double)latency_percentile(&lat, 0.99) / 1000.0 };
+				char desc[32];
+
+				(void)snprintf(desc, sizeof(desc), "%zu ptys %s", n, what[i]);
+				if ((val[i] >= 0.0) && (idx < STRESS_MISC_METRICS_MAX))
+					stress_misc_metric_set(idx, desc, val[i]);
+				idx++;
+			}
+			(*counter)++;
+			if (max_ops && (*counter >= max_ops))
+				break;
+		}
+		reported = true;
+
+		for (n = 0; n < opened; n++) {
+			(void)close(ptys[n].slave);
+			(void)close(ptys[n].master);
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+free_state:
+	free(sent);
+	free(pfds);
+	free(ptys);
+	if (sh != MAP_FAILED)
+		(void)munmap((void *)sh, sizeof(*sh));
+	return rc;
+}
+
 /*
  *  stress_pty
  *	stress pyt handling
@@ -59,7 +433,8 @@ int stress_pty(
 {
 	int rc = EXIT_FAILURE;
 
-	(void)instance;
+	if (opt_pty_data)
+		return stress_pty_data(counter, instance, max_ops, name);
 
 	do {
 		size_t i, n;
@@ -127,6 +127,7 @@ int stress_qsort(
 			opt_qsort_size = MIN_QSORT_SIZE;
 	}
 	n = (size_t)opt_qsort_size;
+	stress_units_per_op((double)n);
 
 	if ((data = calloc(n, sizeof(int32_t))) == NULL) {
 		pr_fail_dbg(name, "malloc");
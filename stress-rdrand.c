@@ -35,95 +35,336 @@
 
 #if defined(STRESS_RDRAND)
 
-static bool rdrand_supported = false;
-
+#if defined(STRESS_X86)
 #include <cpuid.h>
+#endif
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#if !defined(HWCAP2_RNG)
+#define HWCAP2_RNG		(1 << 16)
+#endif
+#endif
+
+#define RDRAND_SLICE		(0.25)	/* seconds per method slice */
+#define RDRAND_SCALE_STEP	(0.5)	/* seconds per --rdrand-scale step */
+#define RDRAND_METHOD_ALL	(-1)
+
+/* One hardware random read, false if the generator had no data */
+typedef bool (*rdrand_func_t)(unsigned long *val);
+
+typedef struct {
+	const char *name;		/* --rdrand-method name */
+	rdrand_func_t func;		/* the instruction */
+} rdrand_method_t;
+
+/* Results of one method over a slice or scale step */
+typedef struct {
+	uint64_t calls;			/* successful calls */
+	uint64_t fails;			/* calls returning no data */
+	uint64_t max_nsec;		/* slowest 32 call batch, per call */
+	double duration;		/* time spent calling */
+} rdrand_stats_t;
 
+static bool rdrand_supported[RDRAND_METHODS_MAX];
+static int opt_rdrand_method = RDRAND_METHOD_ALL;
+static bool opt_rdrand_scale = false;
+
+#if defined(STRESS_X86)
 /*
- *  stress_rdrand_supported()
- *	check if rdrand is supported
+ *  rdrand_rdrand()
+ *	read the DRNG, conditioned output reseeded periodically
  */
-int stress_rdrand_supported(void)
+static inline bool rdrand_rdrand(unsigned long *val)
+{
+	uint8_t ok;
+
+	asm volatile("rdrand %0; setc %1" : "=r"(*val), "=qm"(ok) : : "cc");
+	return ok;
+}
+
+/*
+ *  rdrand_rdseed()
+ *	read the DRNG entropy source, fails when it is drained
+ */
+static inline bool rdrand_rdseed(unsigned long *val)
+{
+	uint8_t ok;
+
+	asm volatile("rdseed %0; setc %1" : "=r"(*val), "=qm"(ok) : : "cc");
+	return ok;
+}
+
+static const rdrand_method_t rdrand_methods[RDRAND_METHODS_MAX] = {
+	{ "rdrand",	rdrand_rdrand },
+	{ "rdseed",	rdrand_rdseed },
+};
+
+/*
+ *  rdrand_probe()
+ *	find which instructions the CPU has
+ */
+static void rdrand_probe(void)
 {
 	uint32_t eax, ebx, ecx, edx;
 
-	/* Intel CPU? */
 	__cpuid(0, eax, ebx, ecx, edx);
-	if (!((memcmp(&ebx, "Genu", 4) == 0) &&
-	      (memcmp(&edx, "ineI", 4) == 0) &&
-	      (memcmp(&ecx, "ntel", 4) == 0))) {
-		pr_inf(stderr, "rdrand stressor will be skipped, "
-			"not a recognised Intel CPU.\n");
-		return -1;
+	if (eax >= 7) {
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		rdrand_supported[1] = !!(ebx & (1U << 18));
 	}
-	/* ..and supports rdrand? */
 	__cpuid(1, eax, ebx, ecx, edx);
-	if (!(ecx & 0x40000000)) {
+	rdrand_supported[0] = !!(ecx & (1U << 30));
+}
+#endif
+
+#if defined(__aarch64__)
+/*
+ *  rdrand_rndr()
+ *	ARMv8.5 RNDR, DRBG output reseeded periodically
+ */
+static inline bool rdrand_rndr(unsigned long *val)
+{
+	uint32_t ok;
+
+	asm volatile("mrs %0, s3_3_c2_c4_0; cset %w1, ne"
+		: "=r"(*val), "=r"(ok) : : "cc");
+	return ok;
+}
+
+/*
+ *  rdrand_rndrrs()
+ *	ARMv8.5 RNDRRS, reseeds from the entropy source on each read
+ */
+static inline bool rdrand_rndrrs(unsigned long *val)
+{
+	uint32_t ok;
+
+	asm volatile("mrs %0, s3_3_c2_c4_1; cset %w1, ne"
+		: "=r"(*val), "=r"(ok) : : "cc");
+	return ok;
+}
+
+static const rdrand_method_t rdrand_methods[RDRAND_METHODS_MAX] = {
+	{ "rndr",	rdrand_rndr },
+	{ "rndrrs",	rdrand_rndrrs },
+};
+
+/*
+ *  rdrand_probe()
+ *	RNDR and RNDRRS are both present with FEAT_RNG
+ */
+static void rdrand_probe(void)
+{
+	const bool rng = !!(getauxval(AT_HWCAP2) & HWCAP2_RNG);
+
+	rdrand_supported[0] = rng;
+	rdrand_supported[1] = rng;
+}
+#endif
+
+/*
+ *  stress_rdrand_supported()
+ *	check if the hardware random number instructions are supported
+ */
+int stress_rdrand_supported(void)
+{
+	rdrand_probe();
+	if (!rdrand_supported[0] && !rdrand_supported[1]) {
 		pr_inf(stderr, "rdrand stressor will be skipped, CPU "
-			"does not support the rdrand instruction.\n");
+			"does not support a hardware random number "
+			"instruction.\n");
 		return -1;
 	}
-	rdrand_supported = true;
 	return 0;
 }
 
 /*
- *  rdrand64()
- *	read 64 bit random value
+ *  stress_set_rdrand_method()
+ *	set the instruction to exercise, or all of them
  */
-static inline uint64_t rdrand64(void)
+int stress_set_rdrand_method(const char *name)
 {
-        uint64_t        ret;
+	size_t i;
 
-        asm volatile("1:;\n\
-        rdrand %0;\n\
-        jnc 1b;\n":"=r"(ret));
+	if (!strcmp(name, "all")) {
+		opt_rdrand_method = RDRAND_METHOD_ALL;
+		return 0;
+	}
+	for (i = 0; i < RDRAND_METHODS_MAX; i++) {
+		if (!strcmp(name, rdrand_methods[i].name)) {
+			opt_rdrand_method = (int)i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "rdrand-method must be one of: all");
+	for (i = 0; i < RDRAND_METHODS_MAX; i++)
+		fprintf(stderr, " %s", rdrand_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+void stress_set_rdrand_scale(void)
+{
+	opt_rdrand_scale = true;
+}
+
+/*
+ *  rdrand_run()
+ *	call the instruction in batches of 32 successful reads until
+ *	t_end, 1 bogo op per batch, failed reads are counted and retried
+ */
+static void rdrand_run(
+	const rdrand_method_t *method,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const double t_end,
+	rdrand_stats_t *stats)
+{
+	const rdrand_func_t func = method->func;
+	double t, t_start;
+	uint64_t fails = 0, calls = 0, max_nsec = 0;
+	unsigned long val, sum = 0;
+
+	t_start = time_now();
+	t = t_start;
+	do {
+		const double t_batch = t;
+		uint64_t nsec;
+		int i;
+
+		for (i = 0; i < 32; i++) {
+			while (!func(&val))
+				fails++;
+			sum += val;
+		}
+		calls += 32;
+		(*counter)++;
+		t = time_now();
+		nsec = (uint64_t)((t - t_batch) * (1000000000.0 / 32.0));
+		if (nsec > max_nsec)
+			max_nsec = nsec;
+	} while (opt_do_run && (t < t_end) && (!max_ops || *counter < max_ops));
+
+	stats->calls += calls;
+	stats->fails += fails;
+	stats->duration += t - t_start;
+	if (max_nsec > stats->max_nsec)
+		stats->max_nsec = max_nsec;
+	/* Stop the compiler discarding the random data */
+	if (sum == ~0UL)
+		pr_dbg(stderr, "%s: unlikely all ones sum\n", method->name);
+}
 
-        return ret;
+/*
+ *  rdrand_record()
+ *	add an instance's results to the shared per step totals
+ */
+static void rdrand_record(
+	const size_t m,
+	const size_t step,
+	const rdrand_stats_t *stats)
+{
+	const double bits = (double)stats->calls * sizeof(unsigned long) * 8.0;
+
+	if (stats->duration <= 0.0)
+		return;
+	__sync_fetch_and_add(&shared->rdrand.step[m][step].rate,
+		(uint64_t)(bits / stats->duration));
+	__sync_fetch_and_add(&shared->rdrand.step[m][step].calls, stats->calls);
+	__sync_fetch_and_add(&shared->rdrand.step[m][step].fails, stats->fails);
+	__sync_fetch_and_add(&shared->rdrand.step[m][step].nsec,
+		(uint64_t)(stats->duration * 1000000000.0));
+	__sync_fetch_and_add(&shared->rdrand.step[m][step].records, 1);
+	/* Racy max, close enough for a worst case */
+	if (stats->max_nsec > shared->rdrand.step[m][step].max_nsec)
+		shared->rdrand.step[m][step].max_nsec = stats->max_nsec;
+}
+
+/*
+ *  rdrand_methods_used()
+ *	the supported methods selected by --rdrand-method
+ */
+static size_t rdrand_methods_used(size_t *used)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < RDRAND_METHODS_MAX; i++) {
+		if (!rdrand_supported[i])
+			continue;
+		if ((opt_rdrand_method != RDRAND_METHOD_ALL) &&
+		    (opt_rdrand_method != (int)i))
+			continue;
+		used[n++] = i;
+	}
+	return n;
 }
 
 /*
- *  Unrolled 32 times
+ *  rdrand_scale()
+ *	all instances follow one schedule of fixed length steps
+ *	from a shared start time, each step runs 1, 2, 4 .. N
+ *	instances on each method while the others sleep, so the
+ *	per call latency can be compared as the load grows
  */
-#define RDRAND64x32()	\
-{			\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
-	rdrand64();	\
+static void rdrand_scale(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const size_t *used,
+	const size_t n_used)
+{
+	const uint32_t instances = (uint32_t)stressor_instances(STRESS_RDRAND);
+	uint32_t active[RDRAND_STEPS_MAX];
+	size_t steps = 0, slots;
+	double t_start;
+	uint64_t start_ns, slot;
+
+	for (active[0] = 1; (active[steps] < instances) &&
+	     (steps < RDRAND_STEPS_MAX - 1); steps++)
+		active[steps + 1] = STRESS_MINIMUM(active[steps] * 2, instances);
+	steps++;
+	slots = steps * n_used;
+	if (instance == 0)
+		(void)memcpy(shared->rdrand.active, active,
+			steps * sizeof(active[0]));
+
+	/* The first instance to get here sets the start for everyone */
+	start_ns = (uint64_t)((time_now() + 0.1) * 1000000000.0);
+	(void)__sync_val_compare_and_swap(&shared->rdrand.start_ns, 0, start_ns);
+	t_start = (double)shared->rdrand.start_ns / 1000000000.0;
+
+	for (slot = 0; opt_do_run && (!max_ops || *counter < max_ops); slot++) {
+		const double t_slot = t_start + (double)slot * RDRAND_SCALE_STEP;
+		const size_t m = used[(slot % slots) / steps];
+		const size_t step = (slot % slots) % steps;
+		rdrand_stats_t stats;
+		double now = time_now();
+
+		/* Started late or was descheduled, join the next step */
+		if (now >= t_slot + RDRAND_SCALE_STEP) {
+			slot = (uint64_t)((now - t_start) / RDRAND_SCALE_STEP);
+			continue;
+		}
+		while (opt_do_run && (now < t_slot)) {
+			(void)usleep((useconds_t)((t_slot - now) * 1000000.0));
+			now = time_now();
+		}
+		if (!opt_do_run)
+			break;
+		if (instance >= active[step])
+			continue;
+		(void)memset(&stats, 0, sizeof(stats));
+		rdrand_run(&rdrand_methods[m], counter, max_ops,
+			t_slot + RDRAND_SCALE_STEP, &stats);
+		/* Only whole steps have the intended number of instances */
+		if (opt_do_run && (!max_ops || *counter < max_ops))
+			rdrand_record(m, step, &stats);
+	}
 }
 
 /*
  *  stress_rdrand()
- *      stress Intel rdrand instruction
+ *      stress the hardware random number generator instructions
  */
 int stress_rdrand(
         uint64_t *const counter,
@@ -131,30 +372,129 @@ int stress_rdrand(
         const uint64_t max_ops,
         const char *name)
 {
-	if (rdrand_supported) {
-		double time_start, duration, billion_bits;
-
-		time_start = time_now();
-		do {
-			RDRAND64x32();
-			(*counter)++;
-		} while (opt_do_run && (!max_ops || *counter < max_ops));
-
-		duration = time_now() - time_start;
-		billion_bits = ((double)*counter * 64.0 * 32.0) / 1000000000.0;
-
-		pr_dbg(stderr, "%s: %.3f billion random bits read "
-			"(instance %" PRIu32")\n",
-			name, billion_bits, instance);
-		if (duration > 0.0) {
-			pr_dbg(stderr, "%s: %.3f billion random bits per "
-				"second (instance %" PRIu32")\n",
-				name, (double)billion_bits / duration, instance);
-		}
+	rdrand_stats_t stats[RDRAND_METHODS_MAX];
+	size_t used[RDRAND_METHODS_MAX], n_used, i, idx = 0;
+
+	rdrand_probe();
+	n_used = rdrand_methods_used(used);
+	if (!n_used) {
+		if (instance == 0)
+			pr_inf(stderr, "%s: %s is not supported by the CPU, "
+				"skipping stressor\n", name,
+				(opt_rdrand_method == RDRAND_METHOD_ALL) ?
+				"rdrand" : rdrand_methods[opt_rdrand_method].name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	if (opt_rdrand_scale) {
+		rdrand_scale(counter, instance, max_ops, used, n_used);
+		return EXIT_SUCCESS;
+	}
+
+	/*
+	 *  All instances run all the time, taking turns on
+	 *  each method in short slices
+	 */
+	(void)memset(stats, 0, sizeof(stats));
+	do {
+		for (i = 0; opt_do_run && (i < n_used); i++)
+			rdrand_run(&rdrand_methods[used[i]], counter, max_ops,
+				time_now() + RDRAND_SLICE, &stats[used[i]]);
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	shared->rdrand.active[0] = (uint32_t)stressor_instances(STRESS_RDRAND);
+	for (i = 0; i < n_used; i++) {
+		const size_t m = used[i];
+		const rdrand_stats_t *s = &stats[m];
+		const uint64_t tries = s->calls + s->fails;
+		char desc[40];
+
+		if (s->duration <= 0.0)
+			continue;
+		rdrand_record(m, 0, s);
+		(void)snprintf(desc, sizeof(desc), "%s Mbit/s",
+			rdrand_methods[m].name);
+		stress_misc_metric_set(idx++, desc, (double)s->calls *
+			sizeof(unsigned long) * 8.0 / (s->duration * 1000000.0));
+		(void)snprintf(desc, sizeof(desc), "%s ns per call",
+			rdrand_methods[m].name);
+		stress_misc_metric_set(idx++, desc,
+			(s->duration * 1000000000.0) / (double)s->calls);
+		(void)snprintf(desc, sizeof(desc), "%s %% failed calls",
+			rdrand_methods[m].name);
+		stress_misc_metric_set(idx++, desc,
+			tries ? 100.0 * (double)s->fails / (double)tries : 0.0);
 	}
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_rdrand_dump()
+ *	report the throughput of all instances together, the per
+ *	call latency and the failure rate of each method, one row
+ *	per number of active instances with --rdrand-scale
+ */
+void stress_rdrand_dump(FILE *yaml, json_t *json)
+{
+	size_t m, s;
+	bool dumped_heading = false;
+
+	for (m = 0; m < RDRAND_METHODS_MAX; m++) {
+		for (s = 0; s < RDRAND_STEPS_MAX; s++) {
+			const rdrand_step_t *st = &shared->rdrand.step[m][s];
+			const uint32_t active = shared->rdrand.active[s];
+			const uint64_t tries = st->calls + st->fails;
+			double per_instance, aggregate, nsec, fail;
+
+			if (!st->records || !st->calls || !active)
+				continue;
+			per_instance = (double)st->rate / (double)st->records / 1000000.0;
+			aggregate = per_instance * active;
+			nsec = (double)st->nsec / (double)st->calls;
+			fail = tries ? 100.0 * (double)st->fails / (double)tries : 0.0;
+
+			if (!dumped_heading) {
+				pr_inf(stdout, "%-13s %9s %12s %12s %9s %9s %7s\n",
+					"rdrand", "instances", "Mbit/s", "Mbit/s",
+					"ns/call", "max ns", "fail %");
+				pr_inf(stdout, "%-13s %9s %12s %12s\n",
+					"", "", "(total)", "(per inst)");
+				pr_yaml(yaml, "rdrand:\n");
+				json_array_begin(json, "rdrand");
+				dumped_heading = true;
+			}
+			pr_inf(stdout, "%-13s %9" PRIu32 " %12.2f %12.2f %9.2f "
+				"%9" PRIu64 " %7.3f\n", rdrand_methods[m].name,
+				active, aggregate, per_instance, nsec,
+				st->max_nsec, fail);
+			pr_yaml(yaml, "    - method: %s\n", rdrand_methods[m].name);
+			pr_yaml(yaml, "      instances: %" PRIu32 "\n", active);
+			pr_yaml(yaml, "      mbits-per-second: %f\n", aggregate);
+			pr_yaml(yaml, "      mbits-per-second-per-instance: %f\n",
+				per_instance);
+			pr_yaml(yaml, "      nsec-per-call: %f\n", nsec);
+			pr_yaml(yaml, "      max-nsec-per-call: %" PRIu64 "\n",
+				st->max_nsec);
+			pr_yaml(yaml, "      failed-percent: %f\n", fail);
+
+			json_obj_begin(json, NULL);
+			json_str(json, "method", rdrand_methods[m].name);
+			json_uint(json, "instances", active);
+			json_double(json, "mbits-per-second", aggregate);
+			json_double(json, "mbits-per-second-per-instance",
+				per_instance);
+			json_double(json, "nsec-per-call", nsec);
+			json_uint(json, "max-nsec-per-call", st->max_nsec);
+			json_double(json, "failed-percent", fail);
+			json_obj_end(json);
+		}
+	}
+	if (dumped_heading) {
+		pr_yaml(yaml, "\n");
+		json_array_end(json);
+	}
+}
+
 #else
 
 /*
@@ -185,4 +525,10 @@ int stress_rdrand(
 
 	return EXIT_SUCCESS;
 }
+
+void stress_rdrand_dump(FILE *yaml, json_t *json)
+{
+	(void)yaml;
+	(void)json;
+}
 #endif
@@ -33,16 +33,73 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
 #include <fcntl.h>
 
-#define BUF_ALIGNMENT		(4096)
+#if defined(__linux__)
+#include <sys/sysmacros.h>
+#include <linux/fs.h>
+#endif
+
+#if defined(BLKRAGET) && defined(BLKRASET)
+#define READAHEAD_HAVE_BLKRA
+#endif
+
 #define BUF_SIZE		(512)
 #define MAX_OFFSETS		(16)
 
+#define SWEEP_SPAN		(64 * MB)	/* default sweep file size */
+#define SWEEP_IO		(4096)		/* sweep read size */
+#define SWEEP_FILL		(1 * MB)	/* sweep file write size */
+#define SWEEP_CELL_TIME		(1.0)		/* max seconds per sweep cell */
+
 static uint64_t opt_readahead_bytes = DEFAULT_READAHEAD_BYTES;
 static bool set_readahead_bytes = false;
+static bool opt_readahead_sweep = false;
+
+enum {
+	RA_METHOD_KERNEL = 0,	/* plain pread, kernel readahead only */
+	RA_METHOD_READAHEAD,	/* readahead() hints ahead of preads */
+	RA_METHOD_FADVISE,	/* posix_fadvise WILLNEED ahead of preads */
+	RA_METHOD_MMAP,		/* MADV_SEQUENTIAL mapping, page faults */
+	RA_METHODS,
+};
+
+static const char *ra_method_names[RA_METHODS] = {
+	"kernel", "readahead", "fadvise", "mmap",
+};
+
+typedef struct {
+	const char *name;	/* access pattern name */
+	uint32_t stride;	/* stride in reads, 0 for random */
+} ra_pattern_t;
+
+static const ra_pattern_t ra_patterns[] = {
+	{ "seq",	1 },
+	{ "stride4",	4 },
+	{ "stride64",	64 },
+	{ "random",	0 },
+};
+
+#define RA_PATTERNS	(SIZEOF_ARRAY(ra_patterns))
+
+/* Readahead windows in KB, as blockdev --setra but in KB */
+static const uint32_t ra_windows[] = {
+	0, 128, 512, 2048
+};
+
+#define RA_WINDOWS	(SIZEOF_ARRAY(ra_windows))
+
+typedef struct {
+	double rate;		/* bytes read per second */
+	uint64_t majflt;	/* major page faults */
+	bool valid;		/* cell has been run */
+} ra_cell_t;
 
 void stress_set_readahead_bytes(const char *optarg)
 {
@@ -52,6 +109,11 @@ void stress_set_readahead_bytes(const char *optarg)
 		MIN_HDD_BYTES, MAX_HDD_BYTES);
 }
 
+void stress_set_readahead_sweep(void)
+{
+	opt_readahead_sweep = true;
+}
+
 static int do_readahead(
 	const char *name,
 	const int fd,
@@ -70,6 +132,346 @@ static int do_readahead(
 	return 0;
 }
 
+/*
+ *  stress_readahead_majflt()
+ *	major page faults of this process so far
+ */
+static uint64_t stress_readahead_majflt(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0;
+	return (uint64_t)usage.ru_majflt;
+}
+
+/*
+ *  stress_readahead_blkdev()
+ *	open the block device holding the file, via a device
+ *	node made in the temporary directory as the device may
+ *	not be in /dev, returns -1 if this is not possible
+ */
+static int stress_readahead_blkdev(
+	const char *name,
+	const uint32_t instance,
+	const int fd)
+{
+#if defined(READAHEAD_HAVE_BLKRA)
+	char path[PATH_MAX];
+	struct stat statbuf;
+	int bfd;
+
+	if ((geteuid() != 0) || (fstat(fd, &statbuf) < 0) ||
+	    (major(statbuf.st_dev) == 0))
+		return -1;
+	(void)stress_temp_filename(path, sizeof(path),
+		name, getpid(), instance, mwc32());
+	if (mknod(path, S_IFBLK | S_IRUSR | S_IWUSR, statbuf.st_dev) < 0)
+		return -1;
+	bfd = open(path, O_RDONLY);
+	(void)unlink(path);
+
+	return bfd;
+#else
+	(void)name;
+	(void)instance;
+	(void)fd;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_readahead_offsets()
+ *	fill offsets with the next batch of reads of the pattern,
+ *	returns the number of offsets, 0 when the pass is done
+ */
+static int stress_readahead_offsets(
+	const ra_pattern_t *pattern,
+	const uint64_t span,
+	uint64_t *const next,
+	off_t *offsets)
+{
+	const uint64_t pages = span / SWEEP_IO;
+	int n;
+
+	for (n = 0; n < MAX_OFFSETS; n++) {
+		if (pattern->stride) {
+			if (*next >= pages)
+				break;
+			offsets[n] = (off_t)(*next * SWEEP_IO);
+			*next += pattern->stride;
+		} else {
+			/* Random reads as many as stride64 reads */
+			if (*next >= pages / 64)
+				break;
+			offsets[n] = (off_t)((mwc64() % pages) * SWEEP_IO);
+			(*next)++;
+		}
+	}
+	return n;
+}
+
+/*
+ *  stress_readahead_hint()
+ *	hint the batch of reads with readahead() or
+ *	posix_fadvise(), adjacent reads are merged into
+ *	one hint as an application would do
+ */
+static void stress_readahead_hint(
+	const int fd,
+	const int method,
+	const off_t *offsets,
+	const int n)
+{
+	int i = 0;
+
+	while (i < n) {
+		const off_t start = offsets[i];
+		off_t end = start + SWEEP_IO;
+
+		for (i++; (i < n) && (offsets[i] == end); i++)
+			end += SWEEP_IO;
+		if (method == RA_METHOD_READAHEAD) {
+			(void)readahead(fd, start, (size_t)(end - start));
+		} else {
+#if defined(POSIX_FADV_WILLNEED)
+			(void)posix_fadvise(fd, start, end - start,
+				POSIX_FADV_WILLNEED);
+#endif
+		}
+	}
+}
+
+/*
+ *  stress_readahead_cell()
+ *	read the file with a cold page cache using the given
+ *	method and access pattern, returns -1 on a read error
+ */
+static int stress_readahead_cell(
+	const int fd,
+	uint8_t *buf,
+	const uint64_t span,
+	const int method,
+	const ra_pattern_t *pattern,
+	ra_cell_t *cell,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	off_t offsets[MAX_OFFSETS];
+	uint64_t next = 0, bytes = 0, majflt;
+	uint8_t *map = MAP_FAILED;
+	double t, t_end;
+	int n;
+
+	(void)fsync(fd);
+#if defined(POSIX_FADV_DONTNEED)
+	(void)posix_fadvise(fd, 0, (off_t)span, POSIX_FADV_DONTNEED);
+#endif
+#if defined(POSIX_FADV_NORMAL)
+	/* Picks up the current device readahead window */
+	(void)posix_fadvise(fd, 0, 0, POSIX_FADV_NORMAL);
+#endif
+	if (method == RA_METHOD_MMAP) {
+		map = mmap(NULL, (size_t)span, PROT_READ, MAP_SHARED, fd, 0);
+		if (map == MAP_FAILED)
+			return -1;
+#if defined(MADV_SEQUENTIAL)
+		(void)madvise(map, (size_t)span, MADV_SEQUENTIAL);
+#endif
+	}
+
+	majflt = stress_readahead_majflt();
+	t = time_now();
+	t_end = t + SWEEP_CELL_TIME;
+	while ((n = stress_readahead_offsets(pattern, span, &next, offsets)) > 0) {
+		int i;
+
+		if ((method == RA_METHOD_READAHEAD) ||
+		    (method == RA_METHOD_FADVISE))
+			stress_readahead_hint(fd, method, offsets, n);
+		for (i = 0; i < n; i++) {
+			if (method == RA_METHOD_MMAP) {
+				(void)memcpy(buf, map + offsets[i], SWEEP_IO);
+			} else if (pread(fd, buf, SWEEP_IO, offsets[i]) < 0) {
+				if (map != MAP_FAILED)
+					(void)munmap(map, (size_t)span);
+				return -1;
+			}
+			bytes += SWEEP_IO;
+			(*counter)++;
+		}
+		if (!opt_do_run || (max_ops && *counter >= max_ops) ||
+		    (time_now() > t_end))
+			break;
+	}
+	t = time_now() - t;
+	cell->majflt = stress_readahead_majflt() - majflt;
+	cell->rate = (t > 0.0) ? (double)bytes / t : 0.0;
+	cell->valid = true;
+	if (map != MAP_FAILED)
+		(void)munmap(map, (size_t)span);
+
+	return 0;
+}
+
+/*
+ *  stress_readahead_sweep()
+ *	compare kernel readahead, explicit readahead(), fadvise
+ *	WILLNEED and MADV_SEQUENTIAL mmap reads over access
+ *	patterns and device readahead windows, reporting a table
+ *	of the first complete sweep. The window is a setting of
+ *	the device, it is restored when the sweep ends
+ */
+static int stress_readahead_sweep(
+	const char *name,
+	const uint32_t instance,
+	const int fd,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	ra_cell_t cells[RA_WINDOWS][RA_PATTERNS][RA_METHODS];
+	const uint64_t span = set_readahead_bytes ?
+		opt_readahead_bytes & ~(uint64_t)(SWEEP_IO - 1) : SWEEP_SPAN;
+	io_buffers_t bufs;
+	uint8_t *buf;
+	uint64_t off;
+	size_t w, windows = 1;
+	long ra_orig = -1;
+	bool reported = false;
+	int bfd, rc = EXIT_SUCCESS;
+	size_t i, m;
+
+	if (io_buffers_alloc(&bufs, stress_get_temp_path(), SWEEP_FILL, 1) < 0) {
+		pr_err(stderr, "%s: cannot allocate buffer\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	buf = io_buffer(&bufs, 0);
+	for (i = 0; i < SWEEP_FILL; i++)
+		buf[i] = mwc8();
+	for (off = 0; off < span; off += SWEEP_FILL) {
+		const size_t len = (span - off > SWEEP_FILL) ?
+			SWEEP_FILL : (size_t)(span - off);
+
+		if (!opt_do_run)
+			goto free_buf;
+		if (pwrite(fd, buf, len, (off_t)off) < 0) {
+			if (errno == ENOSPC) {
+				pr_inf(stderr, "%s: no space for the sweep "
+					"file, skipping stressor\n", name);
+				rc = EXIT_NO_RESOURCE;
+			} else {
+				pr_fail_err(name, "pwrite");
+				rc = EXIT_FAILURE;
+			}
+			goto free_buf;
+		}
+	}
+
+	bfd = stress_readahead_blkdev(name, instance, fd);
+#if defined(READAHEAD_HAVE_BLKRA)
+	if ((bfd >= 0) && (ioctl(bfd, BLKRAGET, &ra_orig) == 0))
+		windows = RA_WINDOWS;
+#endif
+	if ((windows == 1) && (instance == 0))
+		pr_inf(stderr, "%s: cannot set the device readahead window, "
+			"sweeping the current window only\n", name);
+	(void)memset(cells, 0, sizeof(cells));
+
+	do {
+		for (w = 0; w < windows; w++) {
+#if defined(READAHEAD_HAVE_BLKRA)
+			/* BLKRASET is in 512 byte sectors */
+			if ((windows > 1) &&
+			    (ioctl(bfd, BLKRASET, (unsigned long)ra_windows[w] * 2) < 0)) {
+				pr_fail_err(name, "ioctl BLKRASET");
+				rc = EXIT_FAILURE;
+				goto restore;
+			}
+#endif
+			for (i = 0; i < RA_PATTERNS; i++) {
+				for (m = 0; m < RA_METHODS; m++) {
+					if (!opt_do_run || (max_ops && *counter >= max_ops))
+						goto restore;
+					if (stress_readahead_cell(fd, buf, span,
+						(int)m, &ra_patterns[i],
+						&cells[w][i][m], counter, max_ops) < 0) {
+						pr_fail_err(name, ra_method_names[m]);
+						rc = EXIT_FAILURE;
+						goto restore;
+					}
+				}
+			}
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %7s %8s %10s %10s %10s %10s %7s\n",
+				name, "window", "pattern", "kernel MB/s",
+				"rdahd MB/s", "fadv MB/s", "mmap MB/s", "majflt");
+			for (w = 0; w < windows; w++) {
+				char wstr[16];
+
+				if (windows > 1)
+					(void)snprintf(wstr, sizeof(wstr), "%" PRIu32 "K",
+						ra_windows[w]);
+				else
+					(void)snprintf(wstr, sizeof(wstr), "current");
+				for (i = 0; i < RA_PATTERNS; i++) {
+					const ra_cell_t *c = cells[w][i];
+
+					pr_inf(stderr, "%s: %7s %8s %10.1f %10.1f "
+						"%10.1f %10.1f %7" PRIu64 "\n",
+						name, wstr, ra_patterns[i].name,
+						c[RA_METHOD_KERNEL].rate / (double)MB,
+						c[RA_METHOD_READAHEAD].rate / (double)MB,
+						c[RA_METHOD_FADVISE].rate / (double)MB,
+						c[RA_METHOD_MMAP].rate / (double)MB,
+						c[RA_METHOD_MMAP].majflt);
+				}
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+restore:
+#if defined(READAHEAD_HAVE_BLKRA)
+	if ((windows > 1) && (ra_orig >= 0))
+		(void)ioctl(bfd, BLKRASET, (unsigned long)ra_orig);
+#endif
+	if (bfd >= 0)
+		(void)close(bfd);
+
+	/* Best method and window for each access pattern */
+	for (i = 0; i < RA_PATTERNS; i++) {
+		double best = 0.0;
+		size_t best_window = 0;
+		char desc[48];
+
+		for (w = 0; w < windows; w++) {
+			for (m = 0; m < RA_METHODS; m++) {
+				const ra_cell_t *c = &cells[w][i][m];
+
+				if (c->valid && (c->rate > best)) {
+					best = c->rate;
+					best_window = w;
+				}
+			}
+		}
+		if (best <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s best MB/sec",
+			ra_patterns[i].name);
+		stress_misc_metric_set(i * 2, desc, best / (double)MB);
+		if (windows == 1)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s best window (KB)",
+			ra_patterns[i].name);
+		stress_misc_metric_set((i * 2) + 1, desc,
+			(double)ra_windows[best_window]);
+	}
+free_buf:
+	io_buffers_free(&bufs);
+
+	return rc;
+}
+
 /*
  *  stress_readahead
  *	stress file system cache via readahead calls
@@ -80,7 +482,8 @@ int stress_readahead(
 	const uint64_t max_ops,
 	const char *name)
 {
-	uint8_t *buf = NULL;
+	io_buffers_t bufs;
+	uint8_t *buf;
 	uint64_t readahead_bytes, i;
 	uint64_t misreads = 0;
 	uint64_t baddata = 0;
@@ -90,6 +493,7 @@ int stress_readahead(
 	int flags = O_CREAT | O_RDWR | O_TRUNC;
 	int fd;
 	struct stat statbuf;
+	stress_io_stats_t iostats;
 
 	if (!set_readahead_bytes) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -100,14 +504,16 @@ int stress_readahead(
 
 	if (stress_temp_dir_mk(name, pid, instance) < 0)
 		return EXIT_FAILURE;
+	io_stats_begin(&iostats);
 
-	ret = posix_memalign((void **)&buf, BUF_ALIGNMENT, BUF_SIZE);
-	if (ret || !buf) {
-		rc = exit_status(errno);
+	ret = io_buffers_alloc(&bufs, stress_get_temp_path(), BUF_SIZE, 1);
+	if (ret < 0) {
+		rc = exit_status(-ret);
 		pr_err(stderr, "%s: cannot allocate buffer\n", name);
 		(void)stress_temp_dir_rm(name, pid, instance);
 		return rc;
 	}
+	buf = io_buffer(&bufs, 0);
 
 	(void)stress_temp_filename(filename, sizeof(filename),
 		name, pid, instance, mwc32());
@@ -125,6 +531,13 @@ int stress_readahead(
 	}
 	(void)unlink(filename);
 
+	/* The readahead window is per device, so only one instance sweeps */
+	if (opt_readahead_sweep && (instance == 0)) {
+		rc = stress_readahead_sweep(name, instance, fd,
+			counter, max_ops);
+		goto close_finish;
+	}
+
 #if defined(POSIX_FADV_DONTNEED)
 	if (posix_fadvise(fd, 0, opt_readahead_bytes, POSIX_FADV_DONTNEED) < 0) {
 		pr_fail_err(name, "posix_fadvise");
@@ -217,7 +630,8 @@ rnd_rd_retry:
 close_finish:
 	(void)close(fd);
 finish:
-	free(buf);
+	io_stats_end(&iostats, *counter);
+	io_buffers_free(&bufs);
 	(void)stress_temp_dir_rm(name, pid, instance);
 
 	if (misreads)
@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #include <string.h>
 #include <signal.h>
 #include <unistd.h>
@@ -39,11 +40,26 @@
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#if defined(__linux__) && defined(__NR_futex)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
-#define RMAP_CHILD_MAX		(16)
 #define MAPPINGS_MAX		(64)
 #define MAPPING_PAGES		(16)
 
+#define RMAP_SCALE_PAGES	(256)		/* pages each sharer maps */
+#define RMAP_SCALE_ROUNDS	(4)		/* truncates per sharer step */
+
+/* shared with the --rmap-scale sharers */
+typedef struct {
+	uint32_t ready;			/* sharers that have faulted in */
+	uint32_t gen;			/* futex, bumped to fault in again */
+} rmap_sync_t;
+
+static uint32_t opt_rmap_sharers = DEFAULT_RMAP_SHARERS;
+static bool opt_rmap_scale = false;
+
 /*
  *  [ MAPPING 0 ]
  *  [ page ][ MAPPING 1 ]
@@ -53,6 +69,21 @@
  *  file size = ((MAPPINGS_MAX - 1) + MAPPING_PAGES) * page_size;
  */
 
+void stress_set_rmap_sharers(const char *optarg)
+{
+	uint32_t sharers;
+
+	sharers = get_uint32(optarg);
+	check_range("rmap-sharers", sharers,
+		MIN_RMAP_SHARERS, MAX_RMAP_SHARERS);
+	opt_rmap_sharers = sharers;
+}
+
+void stress_set_rmap_scale(void)
+{
+	opt_rmap_scale = true;
+}
+
 /*
  *  stress_rmap_handler()
  *      rmap signal handler
@@ -106,6 +137,230 @@ static void stress_rmap_child(
 	exit(0);
 }
 
+#if defined(STRESS_LATENCY)
+/*
+ *  stress_rmap_sharer()
+ *	fault in every page of the shared mapping, say so and
+ *	wait until told to do it again, runs until killed
+ */
+static void stress_rmap_sharer(
+	const uint8_t *share,
+	const size_t len,
+	const size_t page_size,
+	rmap_sync_t *sync)
+{
+	uint32_t gen = __atomic_load_n(&sync->gen, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		size_t i;
+
+		for (i = 0; i < len; i += page_size)
+			(void)*(volatile const uint8_t *)(share + i);
+		__sync_fetch_and_add(&sync->ready, 1);
+		while (__atomic_load_n(&sync->gen, __ATOMIC_ACQUIRE) == gen) {
+#if defined(__linux__) && defined(__NR_futex)
+			(void)syscall(__NR_futex, &sync->gen,
+				FUTEX_WAIT, gen, NULL, NULL, 0);
+#else
+			(void)usleep(1000);
+#endif
+		}
+		gen = __atomic_load_n(&sync->gen, __ATOMIC_ACQUIRE);
+	}
+}
+
+/*
+ *  stress_rmap_refault()
+ *	have all the sharers fault the pages in again
+ */
+static void stress_rmap_refault(rmap_sync_t *sync)
+{
+	__atomic_store_n(&sync->ready, 0, __ATOMIC_RELEASE);
+	__sync_fetch_and_add(&sync->gen, 1);
+#if defined(__linux__) && defined(__NR_futex)
+	(void)syscall(__NR_futex, &sync->gen, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/*
+ *  stress_rmap_wait()
+ *	wait for n sharers to have faulted in the pages
+ */
+static bool stress_rmap_wait(const rmap_sync_t *sync, const uint32_t n)
+{
+	while (opt_do_run && (__atomic_load_n(&sync->ready, __ATOMIC_ACQUIRE) < n))
+		(void)usleep(1000);
+	return opt_do_run;
+}
+
+/*
+ *  stress_rmap_scale()
+ *	double the number of processes sharing a file mapping
+ *	from 1 up to --rmap-sharers and at each step time page
+ *	faults and munmap of a mapping of the file and truncate
+ *	of the file. Truncate has to unmap the pages from every
+ *	sharer by walking the file's i_mmap tree, the same
+ *	reverse map walk that reclaim does for a mapped page
+ */
+static int stress_rmap_scale(
+	const char *name,
+	const uint32_t instance,
+	const int fd,
+	const size_t page_size,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const size_t len = RMAP_SCALE_PAGES * page_size;
+	uint8_t *share;
+	rmap_sync_t *sync;
+	pid_t *pids;
+	uint32_t i, n = 0, step;
+	double trunc_1 = 0.0;
+	bool reported = false;
+	int rc = EXIT_SUCCESS;
+
+	pids = calloc(opt_rmap_sharers, sizeof(*pids));
+	if (!pids) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " pids\n",
+			name, opt_rmap_sharers);
+		return EXIT_NO_RESOURCE;
+	}
+	sync = (rmap_sync_t *)mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (sync == MAP_FAILED) {
+		free(pids);
+		return EXIT_NO_RESOURCE;
+	}
+	memset(sync, 0, sizeof(*sync));
+	if (ftruncate(fd, (off_t)len) < 0) {
+		pr_fail_err(name, "ftruncate");
+		rc = EXIT_FAILURE;
+		goto unmap_sync;
+	}
+	share = (uint8_t *)mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	if (share == MAP_FAILED) {
+		pr_fail_err(name, "mmap");
+		rc = EXIT_NO_RESOURCE;
+		goto unmap_sync;
+	}
+
+	if (instance == 0)
+		pr_inf(stderr, "%s: %7s %10s %10s %10s %12s %14s\n",
+			name, "sharers", "fault p50", "fault p99",
+			"munmap us", "truncate us", "truncate ns/sh");
+
+	/* double up to the maximum and then stay there */
+	for (step = 1; ; step = (step < opt_rmap_sharers) ? step * 2 : step) {
+		const uint32_t want = (step > opt_rmap_sharers) ?
+			opt_rmap_sharers : step;
+		stress_latency_t fault_lat;
+		double munmap_t = 0.0, trunc_t = 0.0;
+		uint32_t round;
+
+		/* add sharers up to this step, they fault in on start */
+		while (opt_do_run && (n < want)) {
+			pid_t pid;
+
+			pid = fork();
+			if (pid < 0) {
+				pr_inf(stderr, "%s: fork failed at %" PRIu32
+					" sharers: errno=%d (%s)\n",
+					name, n, errno, strerror(errno));
+				break;
+			} else if (pid == 0) {
+				(void)setpgid(0, pgrp);
+				stress_parent_died_alarm();
+				set_oom_adjustment(name, true);
+				stress_rmap_sharer(share, len, page_size, sync);
+			}
+			(void)setpgid(pid, pgrp);
+			pids[n++] = pid;
+		}
+		if (n < want)
+			break;
+
+		memset(&fault_lat, 0, sizeof(fault_lat));
+		for (round = 0; round < RMAP_SCALE_ROUNDS; round++) {
+			uint8_t *probe;
+			double t;
+			size_t j;
+
+			if (!stress_rmap_wait(sync, n))
+				goto done;
+
+			probe = (uint8_t *)mmap(NULL, len, PROT_READ,
+				MAP_SHARED, fd, 0);
+			if (probe == MAP_FAILED) {
+				pr_fail_err(name, "mmap");
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			for (j = 0; j < len; j += page_size) {
+				const uint64_t t0 = time_now_ns();
+
+				(void)*(volatile uint8_t *)(probe + j);
+				latency_record(&fault_lat, time_now_ns() - t0);
+			}
+			t = time_now();
+			(void)munmap((void *)probe, len);
+			munmap_t += time_now() - t;
+
+			/* zap the pages from every sharer and put the file back */
+			t = time_now();
+			if (ftruncate(fd, 0) < 0) {
+				pr_fail_err(name, "ftruncate");
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			trunc_t += time_now() - t;
+			(void)ftruncate(fd, (off_t)len);
+			(*counter)++;
+
+			stress_rmap_refault(sync);
+			if (max_ops && *counter >= max_ops)
+				goto done;
+		}
+		munmap_t /= RMAP_SCALE_ROUNDS;
+		trunc_t /= RMAP_SCALE_ROUNDS;
+		if (n == 1)
+			trunc_1 = trunc_t;
+
+		if ((instance == 0) && !reported)
+			pr_inf(stderr, "%s: %7" PRIu32 " %10" PRIu64 " %10" PRIu64
+				" %10.2f %12.2f %14.2f\n", name, n,
+				latency_percentile(&fault_lat, 0.50),
+				latency_percentile(&fault_lat, 0.99),
+				munmap_t * 1000000.0, trunc_t * 1000000.0,
+				(trunc_t * 1000000000.0) / (double)n);
+		if (n >= opt_rmap_sharers)
+			reported = true;
+
+		stress_misc_metric_set(0, "sharers", (double)n);
+		stress_misc_metric_set(1, "truncate usec at 1 sharer",
+			trunc_1 * 1000000.0);
+		stress_misc_metric_set(2, "truncate usec at max sharers",
+			trunc_t * 1000000.0);
+		stress_misc_metric_set(3, "fault p99 ns at max sharers",
+			(double)latency_percentile(&fault_lat, 0.99));
+		if (!opt_do_run)
+			break;
+	}
+done:
+	for (i = 0; i < n; i++) {
+		int status;
+
+		(void)kill(pids[i], SIGKILL);
+		(void)waitpid(pids[i], &status, 0);
+	}
+	(void)munmap((void *)share, len);
+unmap_sync:
+	(void)munmap((void *)sync, page_size);
+	free(pids);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_rmap()
  *	stress mmap
@@ -118,13 +373,14 @@ int stress_rmap(
 {
 	const size_t page_size = stress_get_pagesize();
 	const size_t sz = ((MAPPINGS_MAX - 1) + MAPPING_PAGES) * page_size;
+	const uint32_t children = opt_rmap_sharers;
 	const size_t counters_sz =
-		(page_size + sizeof(uint64_t) * RMAP_CHILD_MAX) & ~(page_size - 1);
+		(page_size + sizeof(uint64_t) * children) & ~(page_size - 1);
 	const pid_t mypid = getpid();
 	int fd = -1;
 	size_t i;
 	ssize_t rc;
-	pid_t pids[RMAP_CHILD_MAX];
+	pid_t *pids;
 	uint8_t *mappings[MAPPINGS_MAX];
 	uint8_t *paddings[MAPPINGS_MAX];
 	uint64_t *counters;
@@ -138,15 +394,24 @@ int stress_rmap(
 		exit(EXIT_FAILURE);
 	}
 	memset(counters, 0, counters_sz);
-	memset(pids, 0, sizeof(pids));
 	memset(mappings, 0, sizeof(mappings));
+	pids = calloc(children, sizeof(*pids));
+	if (!pids) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " pids\n",
+			name, children);
+		(void)munmap((void *)counters, counters_sz);
+		return EXIT_NO_RESOURCE;
+	}
 
 	/* Make sure this is killable by OOM killer */
 	set_oom_adjustment(name, true);
 
 	rc = stress_temp_dir_mk(name, mypid, instance);
-	if (rc < 0)
+	if (rc < 0) {
+		free(pids);
+		(void)munmap((void *)counters, counters_sz);
 		return exit_status(-rc);
+	}
 
 	(void)stress_temp_filename(filename, sizeof(filename),
 		name, mypid, instance, mwc32());
@@ -158,16 +423,34 @@ int stress_rmap(
 		(void)unlink(filename);
 		(void)stress_temp_dir_rm(name, mypid, instance);
 		(void)munmap((void *)counters, counters_sz);
+		free(pids);
 
 		return rc;
 	}
 	(void)unlink(filename);
 
+	if (opt_rmap_scale) {
+#if defined(STRESS_LATENCY)
+		rc = stress_rmap_scale(name, instance, fd, page_size,
+			counter, max_ops);
+		(void)close(fd);
+		(void)stress_temp_dir_rm(name, mypid, instance);
+		(void)munmap((void *)counters, counters_sz);
+		free(pids);
+
+		return rc;
+#else
+		pr_inf(stderr, "%s: --rmap-scale is not supported, "
+			"using the default mode\n", name);
+#endif
+	}
+
 	if (posix_fallocate(fd, 0, sz) < 0) {
 		pr_fail_err(name, "posix_fallocate");
 		(void)close(fd);
 		(void)stress_temp_dir_rm(name, mypid, instance);
 		(void)munmap((void *)counters, counters_sz);
+		free(pids);
 
 		return EXIT_FAILURE;
 	}
@@ -186,7 +469,7 @@ int stress_rmap(
 	/*
 	 *  Spawn of children workers
 	 */
-	for (i = 0; i < RMAP_CHILD_MAX; i++) {
+	for (i = 0; i < children; i++) {
 		pids[i] = fork();
 		if (pids[i] < 0) {
 			pr_err(stderr, "%s: fork failed: errno=%d: (%s)\n",
@@ -202,7 +485,7 @@ int stress_rmap(
 
 			/* Make sure this is killable by OOM killer */
 			set_oom_adjustment(name, true);
-			stress_rmap_child(&counters[i], max_ops / RMAP_CHILD_MAX,
+			stress_rmap_child(&counters[i], max_ops / children,
 				page_size, mappings);
 		} else {
 			(void)setpgid(pids[i], pgrp);
@@ -214,7 +497,7 @@ int stress_rmap(
 	 */
 	do {
 		(void)select(0, NULL, NULL, NULL, NULL);
-		for (i = 0; i < RMAP_CHILD_MAX; i++)
+		for (i = 0; i < children; i++)
 			*counter += counters[i];
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
@@ -222,7 +505,7 @@ cleanup:
 	/*
 	 *  Kill and wait for children
 	 */
-	for (i = 0; i < RMAP_CHILD_MAX; i++) {
+	for (i = 0; i < children; i++) {
 		int status, ret;
 
 		if (pids[i] <= 0)
@@ -241,6 +524,7 @@ cleanup:
 	}
 
 	(void)munmap((void *)counters, counters_sz);
+	free(pids);
 	(void)close(fd);
 	(void)stress_temp_dir_rm(name, mypid, instance);
 
@@ -0,0 +1,588 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_SCHEDLAT)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define SCHEDLAT_POLICY_ALL	(-1)
+#define SCHEDLAT_POLICIES	(3)	/* other, batch, deadline */
+#define SCHEDLAT_MULTS		(4)	/* 1x, 2x, 4x, 8x workers per CPU */
+#define SCHEDLAT_WORKERS_MAX	(1024)	/* worker threads per instance */
+#define SCHEDLAT_CELL_NS	(500000000ULL)	/* run time of each cell */
+#define SCHEDLAT_POLL_NS	(100000000)	/* futex wait stop check period */
+#define SCHEDLAT_RUNQ_NS	(10000000ULL)	/* runqueue sample period */
+#define SCHEDLAT_DL_PERIOD	(10000000ULL)	/* SCHED_DEADLINE period */
+#define SCHEDLAT_STACK		(64 * KB)
+
+enum {
+	POLICY_OTHER = 0,
+	POLICY_BATCH,
+	POLICY_DEADLINE,
+};
+
+static const char *schedlat_policies[SCHEDLAT_POLICIES] = {
+	"other", "batch", "deadline"
+};
+
+static const uint32_t schedlat_mults[SCHEDLAT_MULTS] = { 1, 2, 4, 8 };
+
+static int opt_schedlat_policy = SCHEDLAT_POLICY_ALL;
+static uint64_t opt_schedlat_messengers = DEFAULT_SCHEDLAT_MESSENGERS;
+static uint64_t opt_schedlat_think = DEFAULT_SCHEDLAT_THINK;
+
+/* Results of one policy and workers per CPU step */
+typedef struct {
+	stress_latency_t lat;		/* wake to run latencies */
+	uint64_t wakeups;		/* worker wakeups */
+	double duration;		/* seconds run */
+	uint64_t runq_sum;		/* sum of procs_running samples */
+	uint64_t runq_samples;		/* number of samples */
+	uint32_t runq_max;		/* deepest runqueue seen */
+	uint32_t workers;		/* worker threads used */
+} schedlat_cell_t;
+
+struct schedlat_messenger;
+
+/* A worker thread, woken by its messenger */
+typedef struct {
+	pthread_t pthread;		/* worker thread */
+	int ret;			/* pthread_create return */
+	struct schedlat_messenger *m;	/* messenger waking this worker */
+	uint32_t go;			/* futex, bumped for each wakeup */
+	uint64_t t_post;		/* time_ticks() of the wakeup */
+	stress_latency_t lat;		/* wake to run latencies */
+} schedlat_worker_t;
+
+/* A message thread, wakes its workers and waits for them all */
+typedef struct schedlat_messenger {
+	pthread_t pthread;		/* messenger thread */
+	int ret;			/* pthread_create return */
+	schedlat_worker_t **workers;	/* workers of this messenger */
+	uint32_t n;			/* number of workers */
+	uint32_t done;			/* futex, workers done this round */
+	uint64_t wakeups;		/* wakeups posted */
+	schedlat_cell_t *cell;		/* runqueue samples, messenger 0 only */
+} schedlat_messenger_t;
+
+/* State shared by all the threads of a cell */
+static struct {
+	int policy;			/* POLICY_* of the workers */
+	uint64_t think_ticks;		/* busy time per wakeup */
+	uint64_t dl_runtime;		/* SCHED_DEADLINE runtime, ns */
+	uint32_t armed;			/* workers that set their policy */
+	uint32_t failed;		/* workers that could not */
+	int err;			/* errno of the first failure */
+	bool stop;			/* threads should exit */
+} schedlat;
+
+/*
+ *  stress_set_schedlat_policy()
+ *	set the worker scheduling policy, or all of them
+ */
+int stress_set_schedlat_policy(const char *name)
+{
+	size_t i;
+
+	if (!strcmp(name, "all")) {
+		opt_schedlat_policy = SCHEDLAT_POLICY_ALL;
+		return 0;
+	}
+	for (i = 0; i < SCHEDLAT_POLICIES; i++) {
+		if (!strcmp(name, schedlat_policies[i])) {
+			opt_schedlat_policy = (int)i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "schedlat-policy must be one of: all");
+	for (i = 0; i < SCHEDLAT_POLICIES; i++)
+		fprintf(stderr, " %s", schedlat_policies[i]);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+void stress_set_schedlat_messengers(const char *optarg)
+{
+	opt_schedlat_messengers = get_uint64(optarg);
+	check_range("schedlat-messengers", opt_schedlat_messengers,
+		MIN_SCHEDLAT_MESSENGERS, MAX_SCHEDLAT_MESSENGERS);
+}
+
+void stress_set_schedlat_think(const char *optarg)
+{
+	opt_schedlat_think = get_uint64(optarg);
+	check_range("schedlat-think", opt_schedlat_think,
+		MIN_SCHEDLAT_THINK, MAX_SCHEDLAT_THINK);
+}
+
+static inline long schedlat_futex(
+	uint32_t *futex,
+	const int op,
+	const uint32_t val)
+{
+	const struct timespec t = { .tv_sec = 0, .tv_nsec = SCHEDLAT_POLL_NS };
+
+	return syscall(SYS_futex, futex, op, val,
+		(op == FUTEX_WAIT_PRIVATE) ? &t : NULL, NULL, 0);
+}
+
+/*
+ *  schedlat_policy_set()
+ *	put the calling worker thread into the policy of the cell
+ */
+static int schedlat_policy_set(void)
+{
+	struct sched_param param;
+
+	memset(&param, 0, sizeof(param));
+	switch (schedlat.policy) {
+	case POLICY_OTHER:
+		return sched_setscheduler(0, SCHED_OTHER, &param);
+	case POLICY_BATCH:
+#if defined(SCHED_BATCH)
+		return sched_setscheduler(0, SCHED_BATCH, &param);
+#else
+		errno = ENOSYS;
+		return -1;
+#endif
+	case POLICY_DEADLINE: {
+		int i, ret = -1;
+
+		/*
+		 *  The bandwidth of the workers of the previous cell
+		 *  is only released at their 0-lag time, so admission
+		 *  control can say EBUSY for a few periods
+		 */
+		for (i = 0; i < 20; i++) {
+			ret = sched_set_deadline(schedlat.dl_runtime,
+				SCHEDLAT_DL_PERIOD, SCHEDLAT_DL_PERIOD);
+			if ((ret == 0) || (errno != EBUSY))
+				break;
+			(void)usleep(SCHEDLAT_DL_PERIOD / 1000);
+		}
+		return ret;
+	}
+	}
+	errno = EINVAL;
+	return -1;
+}
+
+/*
+ *  schedlat_worker()
+ *	sleep until the messenger posts a wakeup, record how long
+ *	it took to get onto a CPU, busy for the think time and
+ *	tell the messenger it is done
+ */
+static void *schedlat_worker(void *arg)
+{
+	schedlat_worker_t *w = (schedlat_worker_t *)arg;
+	schedlat_messenger_t *m = w->m;
+	uint32_t seen = 0;
+	static void *nowt = NULL;
+
+	if (schedlat_policy_set() < 0) {
+		int err = 0;
+
+		(void)__atomic_compare_exchange_n(&schedlat.err, &err, errno,
+			false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&schedlat.failed, 1, __ATOMIC_RELEASE);
+		return &nowt;
+	}
+	__atomic_add_fetch(&schedlat.armed, 1, __ATOMIC_RELEASE);
+
+	while (!__atomic_load_n(&schedlat.stop, __ATOMIC_ACQUIRE)) {
+		uint64_t t;
+
+		while ((__atomic_load_n(&w->go, __ATOMIC_ACQUIRE) == seen) &&
+		       !__atomic_load_n(&schedlat.stop, __ATOMIC_ACQUIRE))
+			(void)schedlat_futex(&w->go, FUTEX_WAIT_PRIVATE, seen);
+		if (__atomic_load_n(&schedlat.stop, __ATOMIC_ACQUIRE))
+			break;
+
+		t = time_ticks();
+		latency_record(&w->lat, time_ticks_to_ns(t - w->t_post));
+		while (time_ticks() - t < schedlat.think_ticks)
+			;
+		seen = __atomic_load_n(&w->go, __ATOMIC_ACQUIRE);
+		if (__atomic_add_fetch(&m->done, 1, __ATOMIC_RELEASE) == m->n)
+			(void)schedlat_futex(&m->done, FUTEX_WAKE_PRIVATE, 1);
+	}
+	return &nowt;
+}
+
+/*
+ *  schedlat_runq()
+ *	number of runnable tasks, from procs_running in /proc/stat
+ */
+static int schedlat_runq(uint32_t *runq)
+{
+	FILE *fp;
+	char buf[256];
+	int ret = -1;
+
+	if ((fp = fopen("/proc/stat", "r")) == NULL)
+		return -1;
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (sscanf(buf, "procs_running %" SCNu32, runq) == 1) {
+			ret = 0;
+			break;
+		}
+	}
+	(void)fclose(fp);
+	return ret;
+}
+
+/*
+ *  schedlat_messenger()
+ *	post a wakeup to each worker in turn then wait until all
+ *	of them have run, messenger 0 also samples the runqueue
+ */
+static void *schedlat_messenger(void *arg)
+{
+	schedlat_messenger_t *m = (schedlat_messenger_t *)arg;
+	uint64_t t_runq = time_now_ns();
+	static void *nowt = NULL;
+
+	while (!__atomic_load_n(&schedlat.stop, __ATOMIC_ACQUIRE)) {
+		uint32_t i, done;
+
+		__atomic_store_n(&m->done, 0, __ATOMIC_RELEASE);
+		for (i = 0; i < m->n; i++) {
+			schedlat_worker_t *w = m->workers[i];
+
+			w->t_post = time_ticks();
+			__atomic_add_fetch(&w->go, 1, __ATOMIC_RELEASE);
+			(void)schedlat_futex(&w->go, FUTEX_WAKE_PRIVATE, 1);
+		}
+		while (((done = __atomic_load_n(&m->done, __ATOMIC_ACQUIRE)) < m->n) &&
+		       !__atomic_load_n(&schedlat.stop, __ATOMIC_ACQUIRE))
+			(void)schedlat_futex(&m->done, FUTEX_WAIT_PRIVATE, done);
+		__atomic_add_fetch(&m->wakeups, m->n, __ATOMIC_RELAXED);
+
+		if (m->cell && (time_now_ns() - t_runq >= SCHEDLAT_RUNQ_NS)) {
+			uint32_t runq;
+
+			if (schedlat_runq(&runq) == 0) {
+				m->cell->runq_sum += runq;
+				m->cell->runq_samples++;
+				if (runq > m->cell->runq_max)
+					m->cell->runq_max = runq;
+			}
+			t_runq = time_now_ns();
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  schedlat_stop()
+ *	stop and reap the threads of a cell
+ */
+static void schedlat_stop(
+	schedlat_worker_t *workers,
+	const uint32_t nworkers,
+	schedlat_messenger_t *messengers,
+	const uint32_t nmessengers)
+{
+	uint32_t i;
+
+	__atomic_store_n(&schedlat.stop, true, __ATOMIC_RELEASE);
+	for (i = 0; i < nworkers; i++) {
+		if (workers[i].ret)
+			continue;
+		__atomic_add_fetch(&workers[i].go, 1, __ATOMIC_RELEASE);
+		(void)schedlat_futex(&workers[i].go, FUTEX_WAKE_PRIVATE, INT_MAX);
+	}
+	for (i = 0; i < nmessengers; i++) {
+		if (messengers[i].ret)
+			continue;
+		__atomic_add_fetch(&messengers[i].done, 1, __ATOMIC_RELEASE);
+		(void)schedlat_futex(&messengers[i].done, FUTEX_WAKE_PRIVATE, INT_MAX);
+	}
+	for (i = 0; i < nmessengers; i++)
+		if (!messengers[i].ret)
+			(void)pthread_join(messengers[i].pthread, NULL);
+	for (i = 0; i < nworkers; i++)
+		if (!workers[i].ret)
+			(void)pthread_join(workers[i].pthread, NULL);
+}
+
+/*
+ *  schedlat_cell()
+ *	run workers_per_cpu x CPUs workers under one policy for
+ *	SCHEDLAT_CELL_NS and add the results to the cell, returns
+ *	-1 if the workers could not be given the policy
+ */
+static int schedlat_cell(
+	const char *name,
+	const uint32_t instance,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const int policy,
+	const uint32_t mult,
+	schedlat_cell_t *cell)
+{
+	const uint32_t cpus = (uint32_t)stress_get_processors_online();
+	const uint32_t instances = (uint32_t)stressor_instances(STRESS_SCHEDLAT);
+	uint32_t nworkers = mult * (cpus ? cpus : 1);
+	uint32_t nmessengers, per, i, started = 0;
+	schedlat_worker_t *workers;
+	schedlat_worker_t **slots;
+	schedlat_messenger_t *messengers;
+	pthread_attr_t attr;
+	uint64_t t_start, t_end, base = *counter, wakeups = 0;
+	int rc = 0;
+
+	if (nworkers > SCHEDLAT_WORKERS_MAX)
+		nworkers = SCHEDLAT_WORKERS_MAX;
+	nmessengers = (opt_schedlat_messengers < nworkers) ?
+		(uint32_t)opt_schedlat_messengers : nworkers;
+
+	per = (nworkers + nmessengers - 1) / nmessengers;
+
+	workers = calloc(nworkers, sizeof(*workers));
+	slots = calloc((size_t)nmessengers * per, sizeof(*slots));
+	messengers = calloc(nmessengers, sizeof(*messengers));
+	if (!workers || !slots || !messengers) {
+		free(workers);
+		free(slots);
+		free(messengers);
+		return 0;
+	}
+
+	memset(&schedlat, 0, sizeof(schedlat));
+	schedlat.policy = policy;
+	schedlat.think_ticks = (uint64_t)((double)opt_schedlat_think * 1000.0 /
+		(shared->timebase.ns_per_tick > 0.0 ? shared->timebase.ns_per_tick : 1.0));
+	/* Leave 10% of the admission control bandwidth to the rest of the system */
+	schedlat.dl_runtime = (uint64_t)((double)SCHEDLAT_DL_PERIOD * 0.95 * 0.9 *
+		(double)(cpus ? cpus : 1) / ((double)nworkers * (double)(instances ? instances : 1)));
+	if (schedlat.dl_runtime < 1024)
+		schedlat.dl_runtime = 1024;
+
+	/* Workers are dealt out to the messengers round robin */
+	for (i = 0; i < nmessengers; i++)
+		messengers[i].workers = &slots[i * per];
+	for (i = 0; i < nworkers; i++) {
+		schedlat_messenger_t *m = &messengers[i % nmessengers];
+
+		m->workers[m->n++] = &workers[i];
+		workers[i].m = m;
+	}
+	messengers[0].cell = cell;
+
+	(void)pthread_attr_init(&attr);
+	(void)pthread_attr_setstacksize(&attr, SCHEDLAT_STACK);
+
+	for (i = 0; i < nworkers; i++) {
+		workers[i].ret = pthread_create(&workers[i].pthread, &attr,
+			schedlat_worker, &workers[i]);
+		if (!workers[i].ret)
+			started++;
+	}
+	while (opt_do_run &&
+	       (__atomic_load_n(&schedlat.armed, __ATOMIC_ACQUIRE) +
+		__atomic_load_n(&schedlat.failed, __ATOMIC_ACQUIRE) < started))
+		(void)sched_yield();
+
+	if (schedlat.failed || (started < nworkers)) {
+		if (instance == 0) {
+			if (schedlat.failed)
+				pr_inf(stderr, "%s: cannot set workers to %s: "
+					"errno=%d (%s), skipping it\n", name,
+					schedlat_policies[policy], schedlat.err,
+					strerror(schedlat.err));
+			else
+				pr_inf(stderr, "%s: only %" PRIu32 " of %"
+					PRIu32 " worker threads started\n",
+					name, started, nworkers);
+		}
+		/* Messengers were never started, mark them so */
+		for (i = 0; i < nmessengers; i++)
+			messengers[i].ret = -1;
+		rc = schedlat.failed ? -1 : 0;
+		goto stop;
+	}
+
+	for (i = 0; i < nmessengers; i++)
+		messengers[i].ret = pthread_create(&messengers[i].pthread, &attr,
+			schedlat_messenger, &messengers[i]);
+
+	t_start = time_now_ns();
+	do {
+		(void)usleep(10000);
+		for (wakeups = 0, i = 0; i < nmessengers; i++)
+			wakeups += __atomic_load_n(&messengers[i].wakeups,
+				__ATOMIC_RELAXED);
+		*counter = base + wakeups;
+		t_end = time_now_ns();
+	} while (opt_do_run && (t_end - t_start < SCHEDLAT_CELL_NS) &&
+		 (!max_ops || *counter < max_ops));
+
+	cell->duration += (double)(t_end - t_start) / 1000000000.0;
+	cell->workers = nworkers;
+stop:
+	schedlat_stop(workers, nworkers, messengers, nmessengers);
+	for (wakeups = 0, i = 0; i < nmessengers; i++)
+		wakeups += messengers[i].wakeups;
+	*counter = base + wakeups;
+	cell->wakeups += wakeups;
+
+	for (i = 0; i < nworkers; i++) {
+		size_t j;
+
+		for (j = 0; j < LATENCY_BUCKETS; j++)
+			cell->lat.bucket[j] += workers[i].lat.bucket[j];
+		cell->lat.count += workers[i].lat.count;
+		if (workers[i].lat.max > cell->lat.max)
+			cell->lat.max = workers[i].lat.max;
+	}
+	(void)pthread_attr_destroy(&attr);
+	free(messengers);
+	free(slots);
+	free(workers);
+
+	return rc;
+}
+
+/*
+ *  stress_schedlat()
+ *	schbench style wakeup latency: message threads wake worker
+ *	threads, which record the time from the wakeup to running,
+ *	as the workers per CPU grow from 1x to 8x, for each policy
+ */
+int stress_schedlat(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	schedlat_cell_t *cells;
+	bool skip[SCHEDLAT_POLICIES] = { false };
+	uint64_t wakeups = 0;
+	double duration = 0.0;
+	size_t p, s, idx = 0;
+
+	cells = calloc(SCHEDLAT_POLICIES * SCHEDLAT_MULTS, sizeof(*cells));
+	if (!cells) {
+		pr_err(stderr, "%s: cannot allocate results\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	if (opt_schedlat_policy != SCHEDLAT_POLICY_ALL)
+		for (p = 0; p < SCHEDLAT_POLICIES; p++)
+			skip[p] = (p != (size_t)opt_schedlat_policy);
+
+	do {
+		p = idx / SCHEDLAT_MULTS;
+		s = idx % SCHEDLAT_MULTS;
+		idx = (idx + 1) % (SCHEDLAT_POLICIES * SCHEDLAT_MULTS);
+
+		if (skip[p])
+			continue;
+		if (schedlat_cell(name, instance, counter, max_ops, (int)p,
+		    schedlat_mults[s], &cells[(p * SCHEDLAT_MULTS) + s]) < 0)
+			skip[p] = true;
+		for (p = 0; (p < SCHEDLAT_POLICIES) && skip[p]; p++)
+			;
+		if (p == SCHEDLAT_POLICIES)
+			break;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	if (instance == 0)
+		pr_inf(stderr, "%s: %-8s %7s %7s %9s %9s %11s %10s %10s %8s\n", name,
+			"policy", "load", "workers", "p50 usec", "p99 usec",
+			"p99.9 usec", "max usec", "runq depth", "runq max");
+	for (p = 0; p < SCHEDLAT_POLICIES; p++) {
+		for (s = 0; s < SCHEDLAT_MULTS; s++) {
+			const schedlat_cell_t *c = &cells[(p * SCHEDLAT_MULTS) + s];
+			char load[16];
+
+			wakeups += c->wakeups;
+			duration += c->duration;
+			if (!c->lat.count || (instance != 0))
+				continue;
+			(void)snprintf(load, sizeof(load), "%" PRIu32 "x/cpu",
+				schedlat_mults[s]);
+			pr_inf(stderr, "%s: %-8s %7s %7" PRIu32 " %9.1f %9.1f "
+				"%11.1f %10.1f %10.2f %8" PRIu32 "\n", name,
+				schedlat_policies[p], load, c->workers,
+				(double)latency_percentile(&c->lat, 0.50) / 1000.0,
+				(double)latency_percentile(&c->lat, 0.99) / 1000.0,
+				(double)latency_percentile(&c->lat, 0.999) / 1000.0,
+				(double)c->lat.max / 1000.0,
+				c->runq_samples ? (double)c->runq_sum /
+					(double)c->runq_samples : 0.0,
+				c->runq_max);
+		}
+	}
+
+	for (p = 0; p < SCHEDLAT_POLICIES; p++) {
+		const schedlat_cell_t *lo = &cells[p * SCHEDLAT_MULTS];
+		const schedlat_cell_t *hi = &cells[(p * SCHEDLAT_MULTS) + SCHEDLAT_MULTS - 1];
+		char desc[64];
+
+		if (lo->lat.count) {
+			(void)snprintf(desc, sizeof(desc), "%s 1x p99 wake (usec)",
+				schedlat_policies[p]);
+			stress_misc_metric_set((p * 3), desc,
+				(double)latency_percentile(&lo->lat, 0.99) / 1000.0);
+		}
+		if (hi->lat.count) {
+			(void)snprintf(desc, sizeof(desc), "%s 8x p99 wake (usec)",
+				schedlat_policies[p]);
+			stress_misc_metric_set((p * 3) + 1, desc,
+				(double)latency_percentile(&hi->lat, 0.99) / 1000.0);
+		}
+		if (hi->runq_samples) {
+			(void)snprintf(desc, sizeof(desc), "%s 8x runqueue depth",
+				schedlat_policies[p]);
+			stress_misc_metric_set((p * 3) + 2, desc,
+				(double)hi->runq_sum / (double)hi->runq_samples);
+		}
+	}
+	if (duration > 0.0)
+		stress_misc_metric_set(9, "wakeups per sec",
+			(double)wakeups / duration);
+
+	free(cells);
+
+	return EXIT_SUCCESS;
+}
+
+#endif
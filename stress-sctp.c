@@ -39,6 +39,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <netinet/in.h>
 #include <netinet/sctp.h>
@@ -59,6 +60,142 @@
 
 static int opt_sctp_domain = AF_INET;
 static int opt_sctp_port = DEFAULT_SCTP_PORT;
+static uint64_t opt_sctp_streams = 1;
+static bool set_sctp_streams = false;
+
+#if defined(STRESS_LATENCY)
+/* what the client received on a stream, shared with the server */
+typedef struct {
+	uint64_t msgs;			/* messages received */
+	uint64_t bytes;			/* bytes received */
+	stress_latency_t lat;		/* send to receive latency */
+} sctp_stream_stats_t;
+
+static sctp_stream_stats_t *sctp_stats;	/* per stream, or NULL */
+#endif
+
+/*
+ *  stress_set_sctp_streams()
+ *	set the number of streams messages are spread across
+ */
+void stress_set_sctp_streams(const char *optarg)
+{
+	opt_sctp_streams = get_uint64(optarg);
+	check_range("sctp-streams", opt_sctp_streams,
+		MIN_SCTP_STREAMS, MAX_SCTP_STREAMS);
+	set_sctp_streams = true;
+}
+
+/*
+ *  stress_sctp_initmsg()
+ *	ask for --sctp-streams streams each way on an association
+ */
+static int stress_sctp_initmsg(const int fd)
+{
+	struct sctp_initmsg initmsg;
+
+	if (!set_sctp_streams)
+		return 0;
+	memset(&initmsg, 0, sizeof(initmsg));
+	initmsg.sinit_num_ostreams = (uint16_t)opt_sctp_streams;
+	initmsg.sinit_max_instreams = (uint16_t)opt_sctp_streams;
+	return setsockopt(fd, SOL_SCTP, SCTP_INITMSG, &initmsg, sizeof(initmsg));
+}
+
+#if defined(STRESS_LATENCY)
+/*
+ *  stress_sctp_retransmits()
+ *	SCTP chunks retransmitted by the whole system so far,
+ *	these show that loss was injected and recovered from
+ */
+static uint64_t stress_sctp_retransmits(void)
+{
+	char buf[256];
+	uint64_t total = 0;
+	FILE *fp;
+
+	fp = fopen("/proc/net/sctp/snmp", "r");
+	if (!fp)
+		return 0;
+	while (fgets(buf, sizeof(buf), fp)) {
+		char field[64];
+		uint64_t val;
+
+		if ((sscanf(buf, "%63s %" SCNu64, field, &val) == 2) &&
+		    strstr(field, "Retransmitted"))
+			total += val;
+	}
+	(void)fclose(fp);
+	return total;
+}
+
+/*
+ *  stress_sctp_stream_report()
+ *	report the throughput and delivery latency of each stream,
+ *	with packet loss a message on one stream only holds up
+ *	the later messages on the same stream
+ */
+static void stress_sctp_stream_report(
+	const char *name,
+	const uint32_t instance,
+	const double duration,
+	const uint64_t retransmits)
+{
+	stress_latency_t all;
+	uint64_t bytes = 0, s;
+	size_t k, idx = 5;
+
+	if (duration <= 0.0)
+		return;
+	memset(&all, 0, sizeof(all));
+	if (instance == 0)
+		pr_inf(stderr, "%s: stream %10s %10s %10s %10s %10s\n", name,
+			"msgs", "MB/sec", "p50 usec", "p99 usec", "max usec");
+	for (s = 0; s < opt_sctp_streams; s++) {
+		const sctp_stream_stats_t *st = &sctp_stats[s];
+
+		bytes += st->bytes;
+		all.count += st->lat.count;
+		if (all.max < st->lat.max)
+			all.max = st->lat.max;
+		for (k = 0; k < LATENCY_BUCKETS; k++)
+			all.bucket[k] += st->lat.bucket[k];
+		if (instance == 0)
+			pr_inf(stderr, "%s: %6" PRIu64 " %10" PRIu64 " %10.2f "
+				"%10.1f %10.1f %10.1f\n", name, s, st->msgs,
+				(double)st->bytes / (double)MB / duration,
+				(double)latency_percentile(&st->lat, 0.50) / 1000.0,
+				(double)latency_percentile(&st->lat, 0.99) / 1000.0,
+				(double)st->lat.max / 1000.0);
+		if (st->lat.count && (idx < STRESS_MISC_METRICS_MAX)) {
+			char desc[32];
+
+			(void)snprintf(desc, sizeof(desc),
+				"stream %" PRIu64 " p99 usec", s);
+			stress_misc_metric_set(idx++, desc,
+				(double)latency_percentile(&st->lat, 0.99) / 1000.0);
+		}
+	}
+	if (!all.count)
+		return;
+	if (instance == 0)
+		pr_inf(stderr, "%s: all streams %.2f MB/sec, delivery p50 %.1f "
+			"usec, p99 %.1f usec, max %.1f usec, %" PRIu64
+			" chunks retransmitted\n", name,
+			(double)bytes / (double)MB / duration,
+			(double)latency_percentile(&all, 0.50) / 1000.0,
+			(double)latency_percentile(&all, 0.99) / 1000.0,
+			(double)all.max / 1000.0, retransmits);
+	stress_misc_metric_set(0, "MB per sec",
+		(double)bytes / (double)MB / duration);
+	stress_misc_metric_set(1, "delivery p50 usec",
+		(double)latency_percentile(&all, 0.50) / 1000.0);
+	stress_misc_metric_set(2, "delivery p99 usec",
+		(double)latency_percentile(&all, 0.99) / 1000.0);
+	stress_misc_metric_set(3, "delivery max usec", (double)all.max / 1000.0);
+	stress_misc_metric_set(4, "chunks retransmitted", (double)retransmits);
+}
+#endif
 
 /*
  *  stress_set_sctp_port()
@@ -115,14 +252,22 @@ retry:
 			exit(EXIT_FAILURE);
 		}
 
+		if (stress_sctp_initmsg(fd) < 0) {
+			pr_fail_dbg(name, "setsockopt SCTP_INITMSG");
+			(void)close(fd);
+			(void)kill(getppid(), SIGALRM);
+			exit(EXIT_FAILURE);
+		}
+
 		stress_set_sockaddr(name, instance, ppid,
 			opt_sctp_domain, opt_sctp_port,
-			&addr, &addr_len, NET_ADDR_LOOPBACK);
+			&addr, &addr_len, NET_ADDR_PEER);
 		if (connect(fd, addr, addr_len) < 0) {
 			(void)close(fd);
 			usleep(10000);
 			retries++;
-			if (retries > 100) {
+			/* A remote server may start later, keep trying */
+			if ((retries > 100) && (stress_net_role() != NET_ROLE_CLIENT)) {
 				/* Give up.. */
 				pr_fail_dbg(name, "connect");
 				(void)kill(getppid(), SIGALRM);
@@ -153,9 +298,27 @@ retry:
 					pr_fail_dbg(name, "recv");
 				break;
 			}
+#if defined(STRESS_LATENCY)
+			if (sctp_stats && (n >= (ssize_t)sizeof(uint64_t)) &&
+			    (sndrcvinfo.sinfo_stream < opt_sctp_streams) &&
+			    !(flags & MSG_NOTIFICATION)) {
+				sctp_stream_stats_t *st = &sctp_stats[sndrcvinfo.sinfo_stream];
+				const uint64_t now = time_now_ns();
+				uint64_t sent;
+
+				(void)memcpy(&sent, buf, sizeof(sent));
+				st->msgs++;
+				st->bytes += (uint64_t)n;
+				if (now >= sent)
+					latency_record(&st->lat, now - sent);
+			}
+#endif
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
 		(void)shutdown(fd, SHUT_RDWR);
 		(void)close(fd);
+		/* Without a local server the client counts the connections */
+		if (stress_net_role() == NET_ROLE_CLIENT)
+			(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
 #ifdef AF_UNIX
@@ -199,6 +362,10 @@ static int stress_sctp_server(
 	struct sockaddr *addr;
 	uint64_t msgs = 0;
 	int rc = EXIT_SUCCESS;
+#if defined(STRESS_LATENCY)
+	const double t_start = time_now();
+	const uint64_t retransmits = stress_sctp_retransmits();
+#endif
 
 	(void)setpgid(pid, pgrp);
 
@@ -217,6 +384,12 @@ static int stress_sctp_server(
 		rc = EXIT_FAILURE;
 		goto die_close;
 	}
+	/* Accepted associations inherit the stream counts */
+	if (stress_sctp_initmsg(fd) < 0) {
+		pr_fail_dbg(name, "setsockopt SCTP_INITMSG");
+		rc = EXIT_FAILURE;
+		goto die_close;
+	}
 
 	stress_set_sockaddr(name, instance, ppid,
 		opt_sctp_domain, opt_sctp_port, &addr, &addr_len, NET_ADDR_ANY);
@@ -235,6 +408,7 @@ static int stress_sctp_server(
 		int sfd = accept(fd, (struct sockaddr *)NULL, NULL);
 		if (sfd >= 0) {
 			size_t i;
+			uint16_t streams = 1, stream = 0;
 #if defined(SOCKET_NODELAY)
 			int one = 1;
 
@@ -250,10 +424,34 @@ static int stress_sctp_server(
 
 			memset(buf, 'A' + (*counter % 26), sizeof(buf));
 
+			/* The peer may have agreed to fewer streams */
+			if (set_sctp_streams) {
+				struct sctp_status status;
+				socklen_t len = sizeof(status);
+
+				memset(&status, 0, sizeof(status));
+				streams = (uint16_t)opt_sctp_streams;
+				if ((getsockopt(sfd, SOL_SCTP, SCTP_STATUS, &status, &len) == 0) &&
+				    (status.sstat_outstrms > 0) &&
+				    (status.sstat_outstrms < streams))
+					streams = status.sstat_outstrms;
+			}
+
 			for (i = 16; i < sizeof(buf); i += 16) {
-				ssize_t ret = sctp_sendmsg(sfd, buf, i,
+				ssize_t ret;
+
+				if (set_sctp_streams) {
+					const uint64_t now = time_now_ns();
+
+					/* Stamped for the latency, spread round robin */
+					(void)memcpy(buf, &now, sizeof(now));
+					stream = (uint16_t)(msgs % streams);
+				} else {
+					stream = LOCALTIME_STREAM;
+				}
+				ret = sctp_sendmsg(sfd, buf, i,
 						NULL, 0, 0, 0,
-						LOCALTIME_STREAM, 0, 0);
+						stream, 0, 0);
 				if (ret < 0) {
 					if (errno != EINTR)
 						pr_fail_dbg(name, "send");
@@ -280,6 +478,11 @@ die:
 		(void)waitpid(pid, &status, 0);
 	}
 	pr_dbg(stderr, "%s: %" PRIu64 " messages sent\n", name, msgs);
+#if defined(STRESS_LATENCY)
+	if (sctp_stats)
+		stress_sctp_stream_report(name, instance, time_now() - t_start,
+			stress_sctp_retransmits() - retransmits);
+#endif
 
 	return rc;
 }
@@ -299,6 +502,28 @@ int stress_sctp(
 	pr_dbg(stderr, "%s: process [%d] using socket port %d\n",
 		name, getpid(), opt_sctp_port + instance);
 
+	if (stress_net_role() == NET_ROLE_SERVER)
+		return stress_sctp_server(counter, instance, max_ops, name, 0, ppid);
+
+#if defined(STRESS_LATENCY)
+	/*
+	 *  The per stream statistics need the client and server on
+	 *  this host, the client fills them in and the server,
+	 *  which kills the client at the end, reports them
+	 */
+	if (set_sctp_streams && (stress_net_role() == NET_ROLE_BOTH)) {
+		sctp_stats = (sctp_stream_stats_t *)mmap(NULL,
+			opt_sctp_streams * sizeof(*sctp_stats),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (sctp_stats == MAP_FAILED) {
+			pr_inf(stderr, "%s: cannot mmap per stream statistics, "
+				"errno=%d (%s)\n", name, errno, strerror(errno));
+			sctp_stats = NULL;
+		} else {
+			memset(sctp_stats, 0, opt_sctp_streams * sizeof(*sctp_stats));
+		}
+	}
+#endif
 again:
 	pid = fork();
 	if (pid < 0) {
@@ -309,8 +534,18 @@ again:
 	} else if (pid == 0) {
 		stress_sctp_client(counter, instance, max_ops, name, ppid);
 		exit(EXIT_SUCCESS);
+	} else if (stress_net_role() == NET_ROLE_CLIENT) {
+		return stress_net_client_wait(pid);
 	} else {
-		return stress_sctp_server(counter, instance, max_ops, name, pid, ppid);
+		int rc;
+
+		rc = stress_sctp_server(counter, instance, max_ops, name, pid, ppid);
+#if defined(STRESS_LATENCY)
+		if (sctp_stats)
+			(void)munmap((void *)sctp_stats,
+				opt_sctp_streams * sizeof(*sctp_stats));
+#endif
+		return rc;
 	}
 }
 
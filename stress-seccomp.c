@@ -36,6 +36,7 @@
 #include <errno.h>
 
 #include <sys/prctl.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/syscall.h>
@@ -45,6 +46,11 @@
 #include <linux/seccomp.h>
 
 #define SYSCALL_NR	(offsetof(struct seccomp_data, nr))
+#define SYSCALL_ARG0	(offsetof(struct seccomp_data, args[0]))
+
+#define SECCOMP_COST_LOOPS	(20000)		/* syscall mix loops per timing */
+#define SECCOMP_COST_NR_BASE	(0x10000)	/* first never used rule syscall */
+#define SECCOMP_COST_INSNS	(4096)		/* BPF_MAXINSNS */
 
 #define ALLOW_SYSCALL(syscall) \
 	BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K, __NR_##syscall, 0, 1), \
@@ -104,6 +110,53 @@ static struct sock_fprog prog_random = {
 	.filter = filter_random
 };
 
+/* the filters of --seccomp-rules, a no filter baseline first */
+typedef enum {
+	SECCOMP_COST_BASELINE = 0,
+	SECCOMP_COST_LINEAR,
+	SECCOMP_COST_LINEAR_NOCACHE,
+	SECCOMP_COST_TREE,
+	SECCOMP_COST_TREE_NOCACHE,
+	SECCOMP_COST_MAX
+} seccomp_cost_t;
+
+static const char *seccomp_cost_names[SECCOMP_COST_MAX] = {
+	"baseline",
+	"linear",
+	"linear-nocache",
+	"tree",
+	"tree-nocache",
+};
+
+/* the fixed syscall mix, all cheap so the filter cost shows */
+static const long seccomp_cost_mix[] = {
+#if defined(__NR_getppid)
+	__NR_getppid,
+#endif
+#if defined(__NR_getuid)
+	__NR_getuid,
+#endif
+#if defined(__NR_getgid)
+	__NR_getgid,
+#endif
+#if defined(__NR_geteuid)
+	__NR_geteuid,
+#endif
+};
+
+static uint32_t opt_seccomp_rules = 0;
+static struct sock_filter filter_cost[SECCOMP_COST_INSNS];
+
+void stress_set_seccomp_rules(const char *optarg)
+{
+	uint64_t rules;
+
+	rules = get_uint64(optarg);
+	check_range("seccomp-rules", rules,
+		MIN_SECCOMP_RULES, MAX_SECCOMP_RULES);
+	opt_seccomp_rules = (uint32_t)rules;
+}
+
 #if defined(__NR_seccomp)
 static int sys_seccomp(unsigned int operation, unsigned int flags, void *args)
 {
@@ -186,6 +239,198 @@ redo_prctl:
 }
 
 
+/*
+ *  stress_seccomp_cost_tree()
+ *	emit a binary search over the sorted rule syscalls nrs[lo..hi),
+ *	each node jumps to its right half with a JA as a conditional
+ *	jump only has an 8 bit offset, leaves are linear. Returns the
+ *	next free instruction.
+ */
+static size_t stress_seccomp_cost_tree(
+	struct sock_filter *f,
+	size_t n,
+	const uint32_t lo,
+	const uint32_t hi)
+{
+	uint32_t i, mid;
+	size_t ja;
+
+	if (hi - lo <= 2) {
+		for (i = lo; i < hi; i++) {
+			f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K,
+				SECCOMP_COST_NR_BASE + i, 0, 1);
+			f[n++] = (struct sock_filter)BPF_STMT(BPF_RET+BPF_K,
+				SECCOMP_RET_ERRNO | EPERM);
+		}
+		f[n++] = (struct sock_filter)BPF_STMT(BPF_RET+BPF_K,
+			SECCOMP_RET_ALLOW);
+		return n;
+	}
+	mid = lo + ((hi - lo) / 2);
+	f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP+BPF_JGE+BPF_K,
+		SECCOMP_COST_NR_BASE + mid, 0, 1);
+	ja = n++;
+	n = stress_seccomp_cost_tree(f, n, lo, mid);
+	f[ja] = (struct sock_filter)BPF_STMT(BPF_JMP+BPF_JA,
+		(uint32_t)(n - ja - 1));
+	return stress_seccomp_cost_tree(f, n, mid, hi);
+}
+
+/*
+ *  stress_seccomp_cost_filter()
+ *	build a filter of opt_seccomp_rules deny rules that the mix
+ *	never matches, so a linear filter checks every rule and a
+ *	tree about log2 of them. A nocache filter loads an argument
+ *	first, which stops the kernel's action cache (Linux 5.11)
+ *	from proving the mix is always allowed and skipping the
+ *	filter. Returns the filter length.
+ */
+static size_t stress_seccomp_cost_filter(const seccomp_cost_t cost)
+{
+	struct sock_filter *f = filter_cost;
+	size_t n = 0;
+	uint32_t i;
+
+	if ((cost == SECCOMP_COST_LINEAR_NOCACHE) ||
+	    (cost == SECCOMP_COST_TREE_NOCACHE))
+		f[n++] = (struct sock_filter)BPF_STMT(BPF_LD+BPF_W+BPF_ABS,
+			SYSCALL_ARG0);
+	f[n++] = (struct sock_filter)BPF_STMT(BPF_LD+BPF_W+BPF_ABS, SYSCALL_NR);
+
+	if ((cost == SECCOMP_COST_TREE) ||
+	    (cost == SECCOMP_COST_TREE_NOCACHE))
+		return stress_seccomp_cost_tree(f, n, 0, opt_seccomp_rules);
+
+	for (i = 0; i < opt_seccomp_rules; i++) {
+		f[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K,
+			SECCOMP_COST_NR_BASE + i, 0, 1);
+		f[n++] = (struct sock_filter)BPF_STMT(BPF_RET+BPF_K,
+			SECCOMP_RET_ERRNO | EPERM);
+	}
+	f[n++] = (struct sock_filter)BPF_STMT(BPF_RET+BPF_K, SECCOMP_RET_ALLOW);
+	return n;
+}
+
+/*
+ *  stress_seccomp_cost_child()
+ *	install a filter and time the syscall mix, the ns per
+ *	syscall goes back in nsec as the child must not log
+ */
+static void stress_seccomp_cost_child(
+	const seccomp_cost_t cost,
+	volatile double *nsec)
+{
+	struct sock_fprog fprog;
+	double t;
+	int i;
+	size_t j;
+
+	if (cost != SECCOMP_COST_BASELINE) {
+		fprog.len = (unsigned short)stress_seccomp_cost_filter(cost);
+		fprog.filter = filter_cost;
+		if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0)
+			_exit(EXIT_FAILURE);
+#if defined(__NR_seccomp)
+		if ((sys_seccomp(SECCOMP_SET_MODE_FILTER, 0, &fprog) < 0) &&
+		    (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog) < 0))
+#else
+		if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog) < 0)
+#endif
+			_exit(EXIT_FAILURE);
+	}
+
+	t = time_now();
+	for (i = 0; i < SECCOMP_COST_LOOPS; i++)
+		for (j = 0; j < SIZEOF_ARRAY(seccomp_cost_mix); j++)
+			(void)syscall(seccomp_cost_mix[j]);
+	t = time_now() - t;
+
+	*nsec = (t * 1000000000.0) /
+		(SECCOMP_COST_LOOPS * SIZEOF_ARRAY(seccomp_cost_mix));
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_seccomp_cost()
+ *	time the syscall mix with no filter and with linear and tree
+ *	filters of --seccomp-rules rules, with and without the action
+ *	cache, one child per filter as a filter cannot be removed.
+ *	One bogo op per round of all the filters.
+ */
+static int stress_seccomp_cost(
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const char *name)
+{
+	volatile double *nsec;
+	double total[SECCOMP_COST_MAX];
+	uint64_t rounds = 0;
+	int i;
+
+	if (!SIZEOF_ARRAY(seccomp_cost_mix)) {
+		pr_inf(stderr, "%s: no syscalls for the syscall mix, "
+			"skipping stressor\n", name);
+		return EXIT_SUCCESS;
+	}
+	nsec = mmap(NULL, sizeof(*nsec), PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (nsec == MAP_FAILED) {
+		pr_fail_dbg(name, "mmap");
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(total, 0, sizeof(total));
+
+	do {
+		for (i = 0; opt_do_run && (i < SECCOMP_COST_MAX); i++) {
+			pid_t pid;
+			int status;
+
+			*nsec = 0.0;
+			pid = fork();
+			if (pid < 0) {
+				pr_fail_dbg(name, "fork");
+				goto done;
+			}
+			if (pid == 0)
+				stress_seccomp_cost_child(i, nsec);
+			if (waitpid(pid, &status, 0) < 0) {
+				if (errno != EINTR)
+					pr_fail_dbg(name, "waitpid");
+				goto done;
+			}
+			if (WIFEXITED(status) &&
+			    (WEXITSTATUS(status) != EXIT_SUCCESS)) {
+				pr_fail(stderr, "%s: cannot install the %s "
+					"filter of %" PRIu32 " rules\n", name,
+					seccomp_cost_names[i], opt_seccomp_rules);
+				(void)munmap((void *)nsec, sizeof(*nsec));
+				return EXIT_FAILURE;
+			}
+			total[i] += *nsec;
+		}
+		if (!opt_do_run)
+			break;
+		rounds++;
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	if (rounds) {
+		stress_misc_metric_set(0, "baseline ns per syscall",
+			total[SECCOMP_COST_BASELINE] / rounds);
+		for (i = SECCOMP_COST_LINEAR; i < SECCOMP_COST_MAX; i++) {
+			char desc[32];
+
+			(void)snprintf(desc, sizeof(desc), "%s overhead ns",
+				seccomp_cost_names[i]);
+			stress_misc_metric_set(i, desc,
+				(total[i] - total[SECCOMP_COST_BASELINE]) / rounds);
+		}
+	}
+	(void)munmap((void *)nsec, sizeof(*nsec));
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_seccomp()
  *	stress seccomp
@@ -198,6 +443,9 @@ int stress_seccomp(
 {
 	(void)instance;
 
+	if (opt_seccomp_rules)
+		return stress_seccomp_cost(counter, max_ops, name);
+
 	do {
 		pid_t pid;
 		const bool allow_write = (mwc32() % 50) != 0;
@@ -106,6 +106,8 @@ static void semaphore_posix_thrash(
 		timeout.tv_sec++;
 
 		for (i = 0; i < 1000; i++) {
+			const uint64_t t_lat = latency_begin(*counter);
+
 			if (sem_timedwait(&shared->sem_posix.sem, &timeout) < 0) {
 				if (errno == ETIMEDOUT)
 					goto timed_out;
@@ -113,6 +115,7 @@ static void semaphore_posix_thrash(
 					pr_fail_dbg(name, "sem_wait");
 				break;
 			}
+			latency_end(t_lat);
 			(*counter)++;
 			if (sem_post(&shared->sem_posix.sem) < 0) {
 				pr_fail_dbg(name, "sem_post");
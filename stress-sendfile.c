@@ -32,15 +32,23 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/sendfile.h>
 
+#define SENDFILE_SWEEP_CELL_TIME	(0.5)	/* seconds per sweep cell */
 
 static int64_t opt_sendfile_size = DEFAULT_SENDFILE_SIZE;
 static bool set_sendfile_size = false;
+static bool opt_sendfile_sweep = false;
+
+static const size_t sendfile_sweep_sizes[] = {
+	4 * KB, 16 * KB, 64 * KB, 256 * KB, 1 * MB, 4 * MB
+};
 
 void stress_set_sendfile_size(const char *optarg)
 {
@@ -50,6 +58,132 @@ void stress_set_sendfile_size(const char *optarg)
 		MIN_SENDFILE_SIZE, MAX_SENDFILE_SIZE);
 }
 
+void stress_set_sendfile_sweep(void)
+{
+	opt_sendfile_sweep = true;
+}
+
+/*
+ *  stress_sendfile_cell()
+ *	send the file in chunk sized pieces for a sweep cell
+ *	time, using sendfile(2) or, if buf is non-null, pread(2)
+ *	and write(2), returning the rate in bytes per second
+ */
+static double stress_sendfile_cell(
+	const int fdin,
+	const int fdout,
+	const size_t sz,
+	const size_t chunk,
+	char *buf,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const double t_start = time_now();
+	const double t_end = t_start + SENDFILE_SWEEP_CELL_TIME;
+	uint64_t bytes = 0;
+	off_t offset = 0;
+	double duration;
+
+	do {
+		ssize_t n;
+
+		if (offset + (off_t)chunk > (off_t)sz)
+			offset = 0;
+		if (buf) {
+			n = pread(fdin, buf, chunk, offset);
+			if ((n > 0) && (write(fdout, buf, (size_t)n) != n))
+				n = -1;
+			offset += (n > 0) ? n : 0;
+		} else {
+			n = sendfile(fdout, fdin, &offset, chunk);
+		}
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1.0;
+		}
+		bytes += (uint64_t)n;
+		(*counter)++;
+	} while (opt_do_run && (time_now() < t_end) &&
+		 (!max_ops || *counter < max_ops));
+
+	duration = time_now() - t_start;
+	return (duration > 0.0) ? (double)bytes / duration : 0.0;
+}
+
+/*
+ *  stress_sendfile_sweep()
+ *	sweep chunk sizes, comparing sendfile(2) with a user
+ *	space copy, the first instance reports a table of the
+ *	first complete sweep
+ */
+static int stress_sendfile_sweep(
+	const char *name,
+	const uint32_t instance,
+	const int fdin,
+	const int fdout,
+	const size_t sz,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	double rates[SIZEOF_ARRAY(sendfile_sweep_sizes)][2];
+	double peak = 0.0;
+	bool reported = false;
+	char *buf;
+	size_t i;
+	int rc = EXIT_SUCCESS;
+
+	buf = malloc(sendfile_sweep_sizes[SIZEOF_ARRAY(sendfile_sweep_sizes) - 1]);
+	if (!buf) {
+		pr_err(stderr, "%s: cannot allocate sweep buffer\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	memset(rates, 0, sizeof(rates));
+
+	do {
+		for (i = 0; i < SIZEOF_ARRAY(sendfile_sweep_sizes); i++) {
+			const size_t chunk = sendfile_sweep_sizes[i];
+
+			if (chunk > sz)
+				break;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			rates[i][0] = stress_sendfile_cell(fdin, fdout, sz,
+				chunk, NULL, counter, max_ops);
+			rates[i][1] = stress_sendfile_cell(fdin, fdout, sz,
+				chunk, buf, counter, max_ops);
+			if ((rates[i][0] < 0.0) || (rates[i][1] < 0.0)) {
+				pr_fail_err(name, "sendfile");
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			if (rates[i][0] > peak)
+				peak = rates[i][0];
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %8s %14s %15s %8s\n", name, "chunk",
+				"sendfile MB/s", "read+write MB/s", "speedup");
+			for (i = 0; i < SIZEOF_ARRAY(sendfile_sweep_sizes); i++) {
+				if (sendfile_sweep_sizes[i] > sz)
+					break;
+				pr_inf(stderr, "%s: %7zuK %14.1f %15.1f %8.2f\n",
+					name, (size_t)(sendfile_sweep_sizes[i] / KB),
+					rates[i][0] / (double)MB,
+					rates[i][1] / (double)MB,
+					(rates[i][1] > 0.0) ?
+						rates[i][0] / rates[i][1] : 0.0);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	stress_misc_metric_set(0, "peak sendfile rate (MB/sec)",
+		peak / (double)MB);
+	free(buf);
+
+	return rc;
+}
+
 /*
  *  stress_sendfile
  *	stress reading of a temp file and writing to /dev/null via sendfile
@@ -64,6 +198,8 @@ int stress_sendfile(
 	int fdin, fdout, ret, rc = EXIT_SUCCESS;
 	size_t sz;
 	const pid_t pid = getpid();
+	uint64_t bytes = 0;
+	double t_start, duration;
 
 	if (!set_sendfile_size) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -99,17 +235,32 @@ int stress_sendfile(
 		goto close_in;
 	}
 
+	if (opt_sendfile_sweep) {
+		rc = stress_sendfile_sweep(name, instance, fdin, fdout, sz,
+			counter, max_ops);
+		goto close_out;
+	}
+
+	t_start = time_now();
 	do {
 		off_t offset = 0;
-		if (sendfile(fdout, fdin, &offset, sz) < 0) {
+		ssize_t n;
+
+		n = sendfile(fdout, fdin, &offset, sz);
+		if (n < 0) {
 			if (errno == EINTR)
 				continue;
 			pr_fail_err(name, "sendfile");
 			rc = EXIT_FAILURE;
 			goto close_out;
 		}
+		bytes += (uint64_t)n;
 		(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
+	duration = time_now() - t_start;
+	if (duration > 0.0)
+		stress_misc_metric_set(0, "sendfile rate (MB/sec)",
+			((double)bytes / duration) / (double)MB);
 
 close_out:
 	(void)close(fdout);
@@ -32,15 +32,450 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sched.h>
+#include <time.h>
 #include <sys/wait.h>
+#if defined(__linux__) && NEED_GLIBC(2,8,0)
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#endif
+
+#define SIGQ_METHOD_HANDLER	(0)	/* sigqueue(3) to a signal handler */
+#define SIGQ_METHOD_SIGWAITINFO	(1)	/* sigqueue(3) to sigwaitinfo(2) */
+#define SIGQ_METHOD_SIGNALFD	(2)	/* sigqueue(3) to a signalfd(2) read */
+#define SIGQ_METHOD_PIDFD	(3)	/* pidfd_send_signal(2) to sigwaitinfo(2) */
+#define SIGQ_METHOD_MAX		(4)
+#define SIGQ_METHOD_ALL		(SIGQ_METHOD_MAX)
+#define SIGQ_METHOD_FLOOD	(SIGQ_METHOD_MAX + 1)
+
+#define SIGQ_CPU_SAME		(0)	/* sender and receiver share a CPU */
+#define SIGQ_CPU_DIFF		(1)	/* sender and receiver on two CPUs */
+#define SIGQ_CPU_MAX		(2)
+
+typedef struct {
+	const char *name;	/* --sigq-method name */
+	int method;		/* SIGQ_METHOD_ value */
+} sigq_method_t;
+
+static const sigq_method_t sigq_methods[] = {
+	{ "flood",	 SIGQ_METHOD_FLOOD },
+#if defined(STRESS_LATENCY) && NEED_GLIBC(2,8,0)
+	{ "handler",	 SIGQ_METHOD_HANDLER },
+	{ "sigwaitinfo", SIGQ_METHOD_SIGWAITINFO },
+	{ "signalfd",	 SIGQ_METHOD_SIGNALFD },
+	{ "pidfd",	 SIGQ_METHOD_PIDFD },
+	{ "all",	 SIGQ_METHOD_ALL },
+#endif
+};
+
+static int opt_sigq_method = SIGQ_METHOD_FLOOD;
+
+/*
+ *  stress_set_sigq_method()
+ *	set the signal delivery method(s) to compare
+ */
+int stress_set_sigq_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(sigq_methods); i++) {
+		if (!strcmp(name, sigq_methods[i].name)) {
+			opt_sigq_method = sigq_methods[i].method;
+			return 0;
+		}
+	}
+	fprintf(stderr, "sigq-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(sigq_methods); i++)
+		fprintf(stderr, " %s", sigq_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
 
 static void MLOCKED stress_sigqhandler(int dummy)
 {
 	(void)dummy;
 }
 
+#if defined(STRESS_LATENCY) && NEED_GLIBC(2,8,0)
+#define SIGQ_LATENCY_PHASE_TIME	(0.5)	/* seconds per method and CPU placement */
+
+static volatile sig_atomic_t sigq_got;
+static volatile sig_atomic_t sigq_child_exited;
+
+static void MLOCKED stress_sigq_latency_handler(int dummy)
+{
+	(void)dummy;
+
+	sigq_got = 1;
+}
+
+/* Interrupts a wait on a ping-pong partner that has gone */
+static void MLOCKED stress_sigq_chld_handler(int dummy)
+{
+	(void)dummy;
+
+	sigq_child_exited = 1;
+}
+
+/*
+ *  stress_sigq_pidfd_open()
+ *	pidfd of a process, -1 if pidfds are not supported
+ */
+static int stress_sigq_pidfd_open(const pid_t pid)
+{
+#if defined(__NR_pidfd_open)
+	return (int)syscall(__NR_pidfd_open, pid, 0);
+#else
+	(void)pid;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_sigq_send()
+ *	send the ping or pong signal with the method's sender
+ */
+static int stress_sigq_send(const int method, const pid_t pid, const int pidfd)
+{
+	union sigval s;
+
+#if defined(__NR_pidfd_send_signal)
+	if (method == SIGQ_METHOD_PIDFD)
+		return (int)syscall(__NR_pidfd_send_signal, pidfd, SIGRTMIN, NULL, 0);
+#else
+	(void)pidfd;
+#endif
+	memset(&s, 0, sizeof(s));
+	return sigqueue(pid, SIGRTMIN, s);
+}
+
+/*
+ *  stress_sigq_wait()
+ *	wait for the ping or pong signal with the method's
+ *	receiver, SIGRTMIN is blocked outside of the wait
+ */
+static int stress_sigq_wait(
+	const int method,
+	const int sfd,
+	const sigset_t *mask,
+	const sigset_t *unblocked)
+{
+	siginfo_t info;
+	struct signalfd_siginfo fdsi;
+
+	switch (method) {
+	case SIGQ_METHOD_HANDLER:
+		while (!sigq_got) {
+			(void)sigsuspend(unblocked);
+			if (!opt_do_run || sigq_child_exited)
+				return -1;
+		}
+		sigq_got = 0;
+		return 0;
+	case SIGQ_METHOD_SIGNALFD:
+		if (read(sfd, &fdsi, sizeof(fdsi)) != sizeof(fdsi))
+			return -1;
+		return 0;
+	default:
+		return (sigwaitinfo(mask, &info) < 0) ? -1 : 0;
+	}
+}
+
+/*
+ *  stress_sigq_latency_phase()
+ *	ping-pong SIGRTMIN between the parent on CPU cpus[0]
+ *	and a child on CPU cpus[1] for a phase, each side
+ *	sending and receiving with the same method
+ */
+static int stress_sigq_latency_phase(
+	const char *name,
+	const int method,
+	const int cpus[2],
+	stress_latency_t *lat,
+	double *secs,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const sigset_t *unblocked;
+	sigset_t mask, old_mask, pending;
+	cpu_set_t set;
+	pid_t pid;
+	int sfd = -1, pidfd = -1, status, rc = 0;
+	double t_start;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGRTMIN);
+	if (sigprocmask(SIG_BLOCK, &mask, &old_mask) < 0) {
+		pr_fail_err(name, "sigprocmask");
+		return -1;
+	}
+	unblocked = &old_mask;
+	sigq_got = 0;
+	sigq_child_exited = 0;
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (opt_do_run && (errno == EAGAIN))
+			goto again;
+		pr_fail_dbg(name, "fork");
+		rc = -1;
+		goto restore;
+	} else if (pid == 0) {
+		const pid_t ppid = getppid();
+
+		(void)setpgid(0, pgrp);
+		stress_parent_died_alarm();
+
+		CPU_ZERO(&set);
+		CPU_SET(cpus[1], &set);
+		(void)sched_setaffinity(0, sizeof(set), &set);
+		if (method == SIGQ_METHOD_SIGNALFD)
+			sfd = signalfd(-1, &mask, 0);
+		if (method == SIGQ_METHOD_PIDFD)
+			pidfd = stress_sigq_pidfd_open(ppid);
+
+		while (opt_do_run) {
+			if (stress_sigq_wait(method, sfd, &mask, unblocked) < 0)
+				break;
+			if (stress_sigq_send(method, ppid, pidfd) < 0)
+				break;
+		}
+		_exit(0);
+	}
+
+	(void)setpgid(pid, pgrp);
+	CPU_ZERO(&set);
+	CPU_SET(cpus[0], &set);
+	(void)sched_setaffinity(0, sizeof(set), &set);
+	if (method == SIGQ_METHOD_SIGNALFD) {
+		sfd = signalfd(-1, &mask, 0);
+		if (sfd < 0) {
+			pr_fail_err(name, "signalfd");
+			rc = -1;
+			goto reap;
+		}
+	}
+	if (method == SIGQ_METHOD_PIDFD) {
+		pidfd = stress_sigq_pidfd_open(pid);
+		if (pidfd < 0) {
+			rc = (errno == ENOSYS) ? 1 : -1;
+			if (rc < 0)
+				pr_fail_err(name, "pidfd_open");
+			goto reap;
+		}
+	}
+
+	t_start = time_now();
+	do {
+		const uint64_t t = time_now_ns();
+
+		if (stress_sigq_send(method, pid, pidfd) < 0) {
+			if ((method == SIGQ_METHOD_PIDFD) && (errno == ENOSYS)) {
+				rc = 1;
+				break;
+			}
+			pr_fail_err(name, "signal send");
+			rc = -1;
+			break;
+		}
+		if (stress_sigq_wait(method, sfd, &mask, unblocked) < 0)
+			break;
+		latency_record(lat, time_now_ns() - t);
+		(*counter)++;
+	} while (opt_do_run && (time_now() < t_start + SIGQ_LATENCY_PHASE_TIME) &&
+		 (!max_ops || *counter < max_ops));
+	*secs += time_now() - t_start;
+
+reap:
+	(void)kill(pid, SIGKILL);
+	while ((waitpid(pid, &status, 0) < 0) && (errno == EINTR))
+		;
+	if (sfd >= 0)
+		(void)close(sfd);
+	if (pidfd >= 0)
+		(void)close(pidfd);
+restore:
+	/* Drop any ping or pong still queued before unblocking */
+	while ((sigpending(&pending) == 0) && sigismember(&pending, SIGRTMIN)) {
+		siginfo_t info;
+		const struct timespec ts = { 0, 0 };
+
+		if (sigtimedwait(&mask, &info, &ts) < 0)
+			break;
+	}
+	(void)sigprocmask(SIG_UNBLOCK, &mask, NULL);
+
+	return rc;
+}
+
+/*
+ *  stress_sigq_latency()
+ *	compare the round trip latency and throughput of
+ *	each signal delivery method with the sender and
+ *	receiver on the same CPU and on two different CPUs
+ */
+static int stress_sigq_latency(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	static const char *cpu_names[SIGQ_CPU_MAX] = { "same", "diff" };
+	stress_latency_t (*lats)[SIGQ_CPU_MAX];
+	double secs[SIGQ_METHOD_MAX][SIGQ_CPU_MAX];
+	bool available[SIGQ_METHOD_MAX];
+	int cpus[SIGQ_CPU_MAX][2];
+	cpu_set_t allowed;
+	struct sigaction action, old_action, old_chld_action;
+	bool reported = false;
+	int method, mode, n_cpus, rc = EXIT_SUCCESS;
+	size_t idx = 0;
+
+	for (method = 0; method < SIGQ_METHOD_MAX; method++)
+		available[method] = (opt_sigq_method == SIGQ_METHOD_ALL) ||
+				    (opt_sigq_method == method);
+	memset(secs, 0, sizeof(secs));
+
+	/* Spread the instances over the allowed CPUs */
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+		pr_fail_err(name, "sched_getaffinity");
+		return EXIT_FAILURE;
+	}
+	n_cpus = CPU_COUNT(&allowed);
+	{
+		const int first = (int)(instance % (uint32_t)n_cpus);
+		const int second = (first + 1) % n_cpus;
+		int cpu, n = 0;
+
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (!CPU_ISSET(cpu, &allowed))
+				continue;
+			if (n == first) {
+				cpus[SIGQ_CPU_SAME][0] = cpu;
+				cpus[SIGQ_CPU_SAME][1] = cpu;
+				cpus[SIGQ_CPU_DIFF][0] = cpu;
+			}
+			if (n == second)
+				cpus[SIGQ_CPU_DIFF][1] = cpu;
+			n++;
+		}
+	}
+	if ((n_cpus < 2) && (instance == 0))
+		pr_inf(stderr, "%s: only one CPU available, skipping the "
+			"different CPU measurements\n", name);
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = stress_sigq_latency_handler;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGRTMIN, &action, &old_action) < 0) {
+		pr_fail_err(name, "sigaction");
+		return EXIT_FAILURE;
+	}
+	if (stress_sighandler(name, SIGCHLD, stress_sigq_chld_handler,
+			&old_chld_action) < 0) {
+		(void)sigaction(SIGRTMIN, &old_action, NULL);
+		return EXIT_FAILURE;
+	}
+	lats = calloc(SIGQ_METHOD_MAX, sizeof(*lats));
+	if (!lats) {
+		pr_err(stderr, "%s: cannot allocate latency state\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto restore;
+	}
+
+	do {
+		for (method = 0; method < SIGQ_METHOD_MAX; method++) {
+			for (mode = 0; mode < SIGQ_CPU_MAX; mode++) {
+				int ret;
+
+				if (!available[method])
+					continue;
+				if ((mode == SIGQ_CPU_DIFF) && (n_cpus < 2))
+					continue;
+				if (!opt_do_run || (max_ops && *counter >= max_ops))
+					goto done;
+				ret = stress_sigq_latency_phase(name, method,
+					cpus[mode], &lats[method][mode],
+					&secs[method][mode], counter, max_ops);
+				if (ret < 0) {
+					rc = EXIT_FAILURE;
+					goto done;
+				}
+				if (ret > 0) {
+					if (instance == 0)
+						pr_inf(stderr, "%s: pidfd_send_signal "
+							"not supported, skipping the "
+							"pidfd method\n", name);
+					available[method] = false;
+				}
+			}
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: round trip latencies in usec, "
+				"sender on CPU %d, receiver on CPU %d or %d\n",
+				name, cpus[SIGQ_CPU_DIFF][0],
+				cpus[SIGQ_CPU_SAME][1], cpus[SIGQ_CPU_DIFF][1]);
+			pr_inf(stderr, "%s: %11s %9s %9s %10s %9s %9s %10s\n",
+				name, "method", "same p50", "same p99", "same rt/s",
+				"diff p50", "diff p99", "diff rt/s");
+			for (method = 0; method < SIGQ_METHOD_MAX; method++) {
+				char buf[SIGQ_CPU_MAX][3][16];
+
+				if (!available[method])
+					continue;
+				for (mode = 0; mode < SIGQ_CPU_MAX; mode++) {
+					const stress_latency_t *lat = &lats[method][mode];
+
+					if (!lat->count || (secs[method][mode] <= 0.0)) {
+						(void)snprintf(buf[mode][0], sizeof(buf[mode][0]), "-");
+						(void)snprintf(buf[mode][1], sizeof(buf[mode][1]), "-");
+						(void)snprintf(buf[mode][2], sizeof(buf[mode][2]), "-");
+						continue;
+					}
+					(void)snprintf(buf[mode][0], sizeof(buf[mode][0]), "%.1f",
+						latency_percentile_usec(lat, 0.50));
+					(void)snprintf(buf[mode][1], sizeof(buf[mode][1]), "%.1f",
+						latency_percentile_usec(lat, 0.99));
+					(void)snprintf(buf[mode][2], sizeof(buf[mode][2]), "%.0f",
+						(double)lat->count / secs[method][mode]);
+				}
+				/* sigq_methods[] lists flood first */
+				pr_inf(stderr, "%s: %11s %9s %9s %10s %9s %9s %10s\n",
+					name, sigq_methods[method + 1].name,
+					buf[0][0], buf[0][1], buf[0][2],
+					buf[1][0], buf[1][1], buf[1][2]);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (method = 0; method < SIGQ_METHOD_MAX; method++) {
+		for (mode = 0; mode < SIGQ_CPU_MAX; mode++) {
+			char desc[40];
+
+			if (!lats[method][mode].count)
+				continue;
+			(void)snprintf(desc, sizeof(desc), "%s %s p50 (usec)",
+				sigq_methods[method + 1].name, cpu_names[mode]);
+			stress_misc_metric_set(idx++, desc,
+				latency_percentile_usec(&lats[method][mode], 0.50));
+		}
+	}
+	free(lats);
+restore:
+	(void)sched_setaffinity(0, sizeof(allowed), &allowed);
+	(void)sigaction(SIGRTMIN, &old_action, NULL);
+	(void)sigaction(SIGCHLD, &old_chld_action, NULL);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_sigq
  *	stress by heavy sigqueue message sending
@@ -53,6 +488,10 @@ int stress_sigq(
 {
 	pid_t pid;
 
+#if defined(STRESS_LATENCY) && NEED_GLIBC(2,8,0)
+	if (opt_sigq_method != SIGQ_METHOD_FLOOD)
+		return stress_sigq_latency(counter, instance, max_ops, name);
+#endif
 	if (stress_sighandler(name, SIGUSR1, stress_sigqhandler, NULL) < 0)
 		return EXIT_FAILURE;
 
@@ -45,6 +45,40 @@ static bool set_sleep_max = false;
 static bool thread_terminate;
 static sigset_t set;
 
+#if defined(STRESS_LATENCY)
+enum {
+	SLEEP_NANOSLEEP = 0,
+	SLEEP_USLEEP,
+	SLEEP_SELECT,
+};
+
+typedef struct {
+	int how;		/* sleep call */
+	uint64_t ns;		/* requested sleep in nanoseconds */
+} sleep_jitter_t;
+
+/* The same sleeps as stress_pthread_func() */
+static const sleep_jitter_t sleep_jitters[] = {
+	{ SLEEP_NANOSLEEP,	1 },
+	{ SLEEP_NANOSLEEP,	10 },
+	{ SLEEP_NANOSLEEP,	100 },
+	{ SLEEP_USLEEP,		1000 },
+	{ SLEEP_USLEEP,		10000 },
+	{ SLEEP_USLEEP,		100000 },
+	{ SLEEP_USLEEP,		1000000 },
+	{ SLEEP_USLEEP,		10000000 },
+	{ SLEEP_SELECT,		10000 },
+	{ SLEEP_SELECT,		100000 },
+	{ SLEEP_SELECT,		1000000 },
+	{ SLEEP_SELECT,		10000000 },
+};
+
+typedef struct {
+	uint64_t *counter;	/* bogo op counter of the thread */
+	stress_latency_t lat;	/* sleep overshoot histogram */
+} sleep_jitter_ctxt_t;
+#endif
+
 void stress_set_sleep_max(const char *optarg)
 {
 	set_sleep_max = true;
@@ -143,6 +177,58 @@ die:
 	return &nowt;
 }
 
+#if defined(STRESS_LATENCY)
+/*
+ *  stress_pthread_jitter_func()
+ *	pthread that performs the same sleeps as stress_pthread_func()
+ *	and accounts how far each one overshoots the time asked for
+ */
+static void *stress_pthread_jitter_func(void *ctxt_ptr)
+{
+	static void *nowt = NULL;
+	sleep_jitter_ctxt_t *ctxt = (sleep_jitter_ctxt_t *)ctxt_ptr;
+
+	/* Let controlling thread handle signals */
+	sigprocmask(SIG_BLOCK, &set, NULL);
+
+	while (!thread_terminate) {
+		size_t i;
+
+		for (i = 0; i < SIZEOF_ARRAY(sleep_jitters); i++) {
+			const uint64_t ns = sleep_jitters[i].ns;
+			const uint64_t t = time_now_ns();
+			struct timespec tv;
+			struct timeval timeout;
+			uint64_t slept;
+			int ret;
+
+			switch (sleep_jitters[i].how) {
+			case SLEEP_NANOSLEEP:
+				tv.tv_sec = 0;
+				tv.tv_nsec = (long)ns;
+				ret = nanosleep(&tv, NULL);
+				break;
+			case SLEEP_USLEEP:
+				ret = usleep((useconds_t)(ns / 1000));
+				break;
+			default:
+				timeout.tv_sec = 0;
+				timeout.tv_usec = (suseconds_t)(ns / 1000);
+				ret = select(0, NULL, NULL, NULL, &timeout);
+				break;
+			}
+			if (ret < 0)
+				goto die;
+			slept = time_now_ns() - t;
+			latency_record(&ctxt->lat, (slept > ns) ? slept - ns : 0);
+		}
+		(*ctxt->counter)++;
+	}
+die:
+	return &nowt;
+}
+#endif
+
 /*
  *  stress_sleep()
  *	stress by many sleeping threads
@@ -158,6 +244,10 @@ int stress_sleep(
 	pthread_t pthreads[MAX_SLEEP];
 	int ret = EXIT_SUCCESS;
 	bool ok = true;
+	void *(*func)(void *) = stress_pthread_func;
+#if defined(STRESS_LATENCY)
+	sleep_jitter_ctxt_t *jitter_ctxts = NULL;
+#endif
 
 	if (!set_sleep_max) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -168,10 +258,30 @@ int stress_sleep(
 	memset(pthreads, 0, sizeof(pthreads));
 	memset(counters, 0, sizeof(counters));
 	sigfillset(&set);
+	timer_jitter_sched();
+
+#if defined(STRESS_LATENCY)
+	if (opt_flags & OPT_FLAGS_TIMER_JITTER) {
+		jitter_ctxts = calloc(opt_sleep_max, sizeof(*jitter_ctxts));
+		if (!jitter_ctxts) {
+			pr_err(stderr, "%s: cannot allocate jitter "
+				"histograms\n", name);
+			return EXIT_NO_RESOURCE;
+		}
+		func = stress_pthread_jitter_func;
+	}
+#endif
 
 	for (n = 0; n < opt_sleep_max;  n++) {
-		ret = pthread_create(&pthreads[n], NULL,
-			stress_pthread_func, &counters[n]);
+		void *arg = &counters[n];
+
+#if defined(STRESS_LATENCY)
+		if (jitter_ctxts) {
+			jitter_ctxts[n].counter = &counters[n];
+			arg = &jitter_ctxts[n];
+		}
+#endif
+		ret = pthread_create(&pthreads[n], NULL, func, arg);
 		if (ret) {
 			/* Out of resources, don't try any more */
 			if (ret == EAGAIN) {
@@ -215,6 +325,27 @@ tidy:
 			opt_sleep_max, instance);
 	}
 
+#if defined(STRESS_LATENCY)
+	if (jitter_ctxts) {
+		stress_latency_t lat;
+
+		/* Merge the histograms of all the threads */
+		memset(&lat, 0, sizeof(lat));
+		for (i = 0; i < n; i++) {
+			const stress_latency_t *l = &jitter_ctxts[i].lat;
+			size_t k;
+
+			for (k = 0; k < LATENCY_BUCKETS; k++)
+				lat.bucket[k] += l->bucket[k];
+			lat.count += l->count;
+			if (l->max > lat.max)
+				lat.max = l->max;
+		}
+		latency_metrics_set(&lat, "sleep overshoot");
+		free(jitter_ctxts);
+	}
+#endif
+
 	return ret;
 }
 
@@ -48,7 +48,24 @@
 #define MSG_ID			'M'
 #define MAX_FDS			(65536)
 
+#define SOCKET_FD_SWEEP_CELL_TIME	(0.5)	/* seconds per sweep cell */
+
 static int opt_socket_fd_port = DEFAULT_SOCKET_FD_PORT;
+static uint32_t opt_socket_fd_batch = 0;	/* 0 = one fd per connection mode */
+static bool opt_socket_fd_sweep = false;
+
+static const uint32_t socket_fd_sweep_sizes[] = {
+	1, 4, 16, 64, MAX_SOCKET_FD_BATCH
+};
+
+/* results of one batch size run */
+typedef struct {
+	uint64_t fds;
+	uint64_t msgs;
+	double duration;
+	uint64_t p50;			/* round trip latencies (ns) */
+	uint64_t p99;
+} socket_fd_cell_t;
 
 /*
  *  stress_set_socket_fd_port()
@@ -61,6 +78,25 @@ void stress_set_socket_fd_port(const char *optarg)
 		&opt_socket_fd_port);
 }
 
+/*
+ *  stress_set_socket_fd_batch()
+ *	set the number of fds passed per message
+ */
+void stress_set_socket_fd_batch(const char *optarg)
+{
+	uint64_t batch;
+
+	batch = get_uint64(optarg);
+	check_range("sockfd-batch", batch,
+		MIN_SOCKET_FD_BATCH, MAX_SOCKET_FD_BATCH);
+	opt_socket_fd_batch = (uint32_t)batch;
+}
+
+void stress_set_socket_fd_sweep(void)
+{
+	opt_socket_fd_sweep = true;
+}
+
 /*
  *  stress_socket_fd_send()
  *	send a fd (fd_send) over a socket fd
@@ -138,6 +174,84 @@ static inline int stress_socket_fd_recv(const int fd)
 	return -1;
 }
 
+/*
+ *  stress_socket_fd_send_batch()
+ *	send n fds in one SCM_RIGHTS message
+ */
+static int stress_socket_fd_send_batch(const int fd, const int *fds, const uint32_t n)
+{
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	char ctrl[CMSG_SPACE(sizeof(int) * MAX_SOCKET_FD_BATCH)];
+	static char msg_data[1] = { MSG_ID };
+
+	iov.iov_base = msg_data;
+	iov.iov_len = 1;
+
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	memset(ctrl, 0, sizeof(ctrl));
+	msg.msg_control = ctrl;
+	msg.msg_controllen = CMSG_SPACE(sizeof(int) * n);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * n);
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * n);
+
+	return sendmsg(fd, &msg, 0);
+}
+
+/*
+ *  stress_socket_fd_recv_batch()
+ *	receive a message of fds, close them all and ack the
+ *	message with a byte, returns the number of fds or
+ *	<= 0 at the end or on an error
+ */
+static int stress_socket_fd_recv_batch(const int fd)
+{
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	char msg_data[1];
+	char ctrl[CMSG_SPACE(sizeof(int) * MAX_SOCKET_FD_BATCH)];
+	int n = 0;
+	ssize_t ret;
+
+	iov.iov_base = msg_data;
+	iov.iov_len = 1;
+
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = ctrl;
+	msg.msg_controllen = sizeof(ctrl);
+
+	ret = recvmsg(fd, &msg, 0);
+	if (ret <= 0)
+		return (int)ret;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if ((cmsg->cmsg_level == SOL_SOCKET) &&
+		    (cmsg->cmsg_type == SCM_RIGHTS)) {
+			const int *ptr = (const int *)CMSG_DATA(cmsg);
+			const int nfds = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+			int i;
+
+			for (i = 0; i < nfds; i++)
+				(void)close(ptr[i]);
+			n += nfds;
+		}
+	}
+	if (write(fd, msg_data, 1) != 1)
+		return -1;
+	return n;
+}
+
 /*
  *  stress_socket_client()
  *	client reader
@@ -187,6 +301,15 @@ retry:
 			goto retry;
 		}
 
+		if (opt_socket_fd_batch || opt_socket_fd_sweep) {
+			while (stress_socket_fd_recv_batch(fd) >= 0) {
+				if (!opt_do_run)
+					break;
+			}
+			(void)close(fd);
+			continue;
+		}
+
 		for (i = 0; i < max_fd; i++)
 			fds[i] = stress_socket_fd_recv(fd);
 
@@ -216,6 +339,149 @@ static void MLOCKED handle_socket_sigalrm(int dummy)
 	opt_do_run = false;
 }
 
+/*
+ *  stress_socket_fd_cell()
+ *	pass batches of n fds and wait for each to be acked
+ *	for a duration (0 = until the end of the run)
+ */
+static int stress_socket_fd_cell(
+	const int sfd,
+	const int *fds,
+	const uint32_t n,
+	const double duration,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	socket_fd_cell_t *cell)
+{
+	const double t_start = time_now();
+	int rc = 0;
+#if defined(STRESS_LATENCY)
+	static stress_latency_t lat;
+
+	memset(&lat, 0, sizeof(lat));
+#endif
+	memset(cell, 0, sizeof(*cell));
+
+	while (opt_do_run && (!max_ops || *counter < max_ops)) {
+		const double t = time_now();
+		char ack;
+
+		if ((duration > 0.0) && (t >= t_start + duration))
+			break;
+		if ((stress_socket_fd_send_batch(sfd, fds, n) < 0) ||
+		    (read(sfd, &ack, 1) != 1)) {
+			if (errno != EINTR)
+				rc = -1;
+			break;
+		}
+#if defined(STRESS_LATENCY)
+		latency_record(&lat, (uint64_t)((time_now() - t) * 1000000000.0));
+#endif
+		cell->fds += n;
+		cell->msgs++;
+		(*counter)++;
+	}
+	cell->duration = time_now() - t_start;
+#if defined(STRESS_LATENCY)
+	if (lat.count) {
+		cell->p50 = latency_percentile(&lat, 0.50);
+		cell->p99 = latency_percentile(&lat, 0.99);
+	}
+#endif
+	return rc;
+}
+
+/*
+ *  stress_socket_fd_batches()
+ *	pass fds in batches over the connection, either at the
+ *	--sockfd-batch size or sweeping the batch sizes, the
+ *	first instance reports a table of the first full sweep
+ */
+static int stress_socket_fd_batches(
+	const char *name,
+	const uint32_t instance,
+	const int sfd,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	int fds[MAX_SOCKET_FD_BATCH];
+	socket_fd_cell_t cells[SIZEOF_ARRAY(socket_fd_sweep_sizes)];
+	double peak = 0.0;
+	bool reported = false;
+	size_t i;
+	int rc = EXIT_SUCCESS;
+
+	/* the same fds are passed each time, the receiver closes its copies */
+	for (i = 0; i < MAX_SOCKET_FD_BATCH; i++) {
+		fds[i] = open("/dev/null", O_RDWR);
+		if (fds[i] < 0) {
+			pr_fail_err(name, "open");
+			while (i-- > 0)
+				(void)close(fds[i]);
+			return EXIT_NO_RESOURCE;
+		}
+	}
+
+	if (!opt_socket_fd_sweep) {
+		const socket_fd_cell_t *c = &cells[0];
+
+		if (stress_socket_fd_cell(sfd, fds, opt_socket_fd_batch, 0.0,
+				counter, max_ops, &cells[0]) < 0) {
+			pr_fail_err(name, "sendmsg");
+			rc = EXIT_FAILURE;
+		} else if (c->duration > 0.0) {
+			stress_misc_metric_set(0, "fds per second",
+				(double)c->fds / c->duration);
+			stress_misc_metric_set(1, "p50 round trip (usec)",
+				(double)c->p50 / 1000.0);
+			stress_misc_metric_set(2, "p99 round trip (usec)",
+				(double)c->p99 / 1000.0);
+		}
+		goto close_fds;
+	}
+
+	do {
+		for (i = 0; i < SIZEOF_ARRAY(socket_fd_sweep_sizes); i++) {
+			const socket_fd_cell_t *c = &cells[i];
+
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			if (stress_socket_fd_cell(sfd, fds, socket_fd_sweep_sizes[i],
+					SOCKET_FD_SWEEP_CELL_TIME, counter,
+					max_ops, &cells[i]) < 0) {
+				pr_fail_err(name, "sendmsg");
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			if ((c->duration > 0.0) && ((double)c->fds / c->duration > peak))
+				peak = (double)c->fds / c->duration;
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %6s %12s %12s %10s %10s\n", name,
+				"batch", "fds/sec", "msgs/sec", "p50 usec", "p99 usec");
+			for (i = 0; i < SIZEOF_ARRAY(socket_fd_sweep_sizes); i++) {
+				const socket_fd_cell_t *c = &cells[i];
+
+				if (c->duration <= 0.0)
+					continue;
+				pr_inf(stderr, "%s: %6" PRIu32 " %12.0f %12.0f %10.2f %10.2f\n",
+					name, socket_fd_sweep_sizes[i],
+					(double)c->fds / c->duration,
+					(double)c->msgs / c->duration,
+					(double)c->p50 / 1000.0,
+					(double)c->p99 / 1000.0);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	stress_misc_metric_set(0, "peak fds per second", peak);
+close_fds:
+	for (i = 0; i < MAX_SOCKET_FD_BATCH; i++)
+		(void)close(fds[i]);
+	return rc;
+}
+
 /*
  *  stress_socket_server()
  *	server writer
@@ -269,6 +535,21 @@ static int stress_socket_server(
 		goto die_close;
 	}
 
+	if (opt_socket_fd_batch || opt_socket_fd_sweep) {
+		int sfd = accept(fd, (struct sockaddr *)NULL, NULL);
+
+		if (sfd < 0) {
+			if (errno != EINTR) {
+				pr_fail_dbg(name, "accept");
+				rc = EXIT_FAILURE;
+			}
+			goto die_close;
+		}
+		rc = stress_socket_fd_batches(name, instance, sfd, counter, max_ops);
+		(void)close(sfd);
+		goto die_close;
+	}
+
 	do {
 		int sfd = accept(fd, (struct sockaddr *)NULL, NULL);
 		if (sfd >= 0) {
@@ -61,11 +61,36 @@
 #define HAVE_SENDMMSG
 #endif
 
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && \
+    defined(IP_RECVERR) && defined(IPV6_RECVERR)
+#define HAVE_ZEROCOPY
+#include <poll.h>
+#include <linux/errqueue.h>
+#endif
+
 #define SOCKET_OPT_SEND		0x01
 #define SOCKET_OPT_SENDMSG	0x02
 #define SOCKET_OPT_SENDMMSG	0x03
+#define SOCKET_OPT_ZEROCOPY	0x04
+
+#define SOCKET_MSG_CONN_BYTES	(1 * MB)	/* bytes per connection, --sock-msg-size */
+#define SOCKET_SWEEP_MIN	(64)		/* smallest --sock-msg-size sweep size */
+#define SOCKET_SWEEP_SIZES	(11)		/* 64 bytes to 64K */
 
-#define MSGVEC_SIZE		(4)
+#if defined(HAVE_ZEROCOPY)
+#define ZEROCOPY_RING		(1024)	/* max zerocopy sends in flight */
+#define ZEROCOPY_WAIT_MS	(100)	/* max wait for a completion */
+
+/* zerocopy sends of a connection waiting for completion */
+typedef struct {
+	uint32_t next;			/* sequence number of next send */
+	uint32_t reaped;		/* sends completed */
+	double sent[ZEROCOPY_RING];	/* time of each send in flight */
+	double latency;			/* total completion latency */
+	uint64_t completions;		/* sends completed, all connections */
+	uint64_t copied;		/* completions the kernel copied */
+} socket_zerocopy_t;
+#endif
 
 typedef struct {
 	const char *optname;
@@ -81,12 +106,18 @@ static int opt_socket_domain = AF_INET;
 static int opt_socket_port = DEFAULT_SOCKET_PORT;
 static int opt_socket_opts = SOCKET_OPT_SEND;
 static int opt_socket_type = SOCK_STREAM;
+static size_t opt_socket_msg_size = 0;		/* 0 = 16 to 8K byte messages */
+static bool opt_socket_msg_sweep = false;
+static uint32_t opt_socket_mmsg_batch = DEFAULT_SOCKET_MMSG_BATCH;
 
 static const socket_opts_t socket_opts[] = {
 	{ "send",	SOCKET_OPT_SEND },
 	{ "sendmsg",	SOCKET_OPT_SENDMSG },
 #if defined(HAVE_SENDMMSG)
 	{ "sendmmsg",	SOCKET_OPT_SENDMMSG },
+#endif
+#if defined(HAVE_ZEROCOPY)
+	{ "zerocopy",	SOCKET_OPT_ZEROCOPY },
 #endif
 	{ NULL,		0 }
 };
@@ -147,6 +178,38 @@ int stress_set_socket_type(const char *optarg)
 	return -1;
 }
 
+/*
+ *  stress_set_socket_msg_size()
+ *	set the bytes per message, or sweep over a range of sizes
+ */
+void stress_set_socket_msg_size(const char *optarg)
+{
+	uint64_t size;
+
+	if (!strcmp(optarg, "sweep")) {
+		opt_socket_msg_sweep = true;
+		return;
+	}
+	size = get_uint64_byte(optarg);
+	check_range("sock-msg-size", size,
+		MIN_SOCKET_MSG_SIZE, MAX_SOCKET_MSG_SIZE);
+	opt_socket_msg_size = (size_t)size;
+}
+
+/*
+ *  stress_set_socket_mmsg_batch()
+ *	set the number of messages per sendmmsg call
+ */
+void stress_set_socket_mmsg_batch(const char *optarg)
+{
+	uint64_t batch;
+
+	batch = get_uint64(optarg);
+	check_range("sock-mmsg-batch", batch,
+		MIN_SOCKET_MMSG_BATCH, MAX_SOCKET_MMSG_BATCH);
+	opt_socket_mmsg_batch = (uint32_t)batch;
+}
+
 /*
  *  stress_set_socket_port()
  *	set port to use
@@ -185,7 +248,7 @@ static void stress_sctp_client(
 	stress_parent_died_alarm();
 
 	do {
-		char buf[SOCKET_BUF];
+		static char buf[MAX_SOCKET_MSG_SIZE];
 		int fd;
 		int retries = 0;
 		socklen_t addr_len = 0;
@@ -203,12 +266,13 @@ retry:
 
 		stress_set_sockaddr(name, instance, ppid,
 			opt_socket_domain, opt_socket_port,
-			&addr, &addr_len, NET_ADDR_ANY);
+			&addr, &addr_len, NET_ADDR_PEER);
 		if (connect(fd, addr, addr_len) < 0) {
 			(void)close(fd);
 			usleep(10000);
 			retries++;
-			if (retries > 100) {
+			/* A remote server may start later, keep trying */
+			if ((retries > 100) && (stress_net_role() != NET_ROLE_CLIENT)) {
 				/* Give up.. */
 				pr_fail_dbg(name, "connect");
 				(void)kill(getppid(), SIGALRM);
@@ -229,6 +293,9 @@ retry:
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
 		(void)shutdown(fd, SHUT_RDWR);
 		(void)close(fd);
+		/* Without a local server the client counts the connections */
+		if (stress_net_role() == NET_ROLE_CLIENT)
+			(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
 #ifdef AF_UNIX
@@ -253,6 +320,205 @@ static void MLOCKED handle_socket_sigalrm(int dummy)
 	opt_do_run = false;
 }
 
+#if defined(HAVE_ZEROCOPY)
+/*
+ *  socket_zerocopy_reap()
+ *	reap the zerocopy completions from the socket error queue,
+ *	recording the time from each send to its completion. With
+ *	wait set, block until all the sends in flight complete.
+ *	Returns -1 if completions could not be reaped
+ */
+static int socket_zerocopy_reap(const int fd, socket_zerocopy_t *zc, const bool wait)
+{
+	while (zc->reaped != zc->next) {
+		char control[128];
+		struct msghdr msg;
+		struct cmsghdr *cmsg;
+		double now;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			struct pollfd pfd;
+
+			if ((errno != EAGAIN) && (errno != EINTR))
+				return -1;
+			if (!wait)
+				return 0;
+			if (!opt_do_run)
+				return -1;
+			/* POLLERR is always reported, no events needed */
+			pfd.fd = fd;
+			pfd.events = 0;
+			pfd.revents = 0;
+			if (poll(&pfd, 1, ZEROCOPY_WAIT_MS) == 0)
+				return -1;
+			continue;
+		}
+		now = time_now();
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			const struct sock_extended_err *serr;
+			uint32_t seq, n;
+
+			if (!(((cmsg->cmsg_level == SOL_IP) && (cmsg->cmsg_type == IP_RECVERR)) ||
+			      ((cmsg->cmsg_level == SOL_IPV6) && (cmsg->cmsg_type == IPV6_RECVERR))))
+				continue;
+			serr = (const struct sock_extended_err *)CMSG_DATA(cmsg);
+			if ((serr->ee_errno != 0) ||
+			    (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY))
+				continue;
+			/* completions of sends ee_info..ee_data */
+			n = serr->ee_data - serr->ee_info + 1;
+			for (seq = serr->ee_info; seq != serr->ee_data + 1; seq++)
+				zc->latency += now - zc->sent[seq % ZEROCOPY_RING];
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				zc->copied += n;
+			zc->completions += n;
+			zc->reaped += n;
+		}
+	}
+	return 0;
+}
+
+/*
+ *  socket_zerocopy_send()
+ *	send len bytes of buf with MSG_ZEROCOPY, each successful
+ *	send takes the next completion sequence number
+ */
+static ssize_t socket_zerocopy_send(
+	const int fd,
+	socket_zerocopy_t *zc,
+	const char *buf,
+	const size_t len)
+{
+	for (;;) {
+		ssize_t ret;
+
+		if ((zc->next - zc->reaped >= ZEROCOPY_RING) &&
+		    (socket_zerocopy_reap(fd, zc, true) < 0)) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		zc->sent[zc->next % ZEROCOPY_RING] = time_now();
+		ret = send(fd, buf, len, MSG_ZEROCOPY);
+		if (ret >= 0) {
+			zc->next++;
+			(void)socket_zerocopy_reap(fd, zc, false);
+			return ret;
+		}
+		/* Out of optmem for pinned pages, reap and retry */
+		if ((errno != ENOBUFS) || (zc->next == zc->reaped) ||
+		    (socket_zerocopy_reap(fd, zc, true) < 0))
+			return -1;
+	}
+}
+#endif
+
+/*
+ *  stress_sock_send_sized()
+ *	send SOCKET_MSG_CONN_BYTES of size byte messages on a
+ *	connection with the --sock-opts method, returns -1 if
+ *	a send failed
+ */
+static int stress_sock_send_sized(
+	const char *name,
+	const int sfd,
+	const char *buf,
+	const size_t size,
+	void *msgvecp,
+	void *zcp,
+	uint64_t *msgs,
+	uint64_t *bytes)
+{
+	const size_t count = (SOCKET_MSG_CONN_BYTES + size - 1) / size;
+	struct iovec vec;
+	struct msghdr msg;
+	ssize_t ret;
+	size_t k;
+
+	vec.iov_base = (void *)buf;
+	vec.iov_len = size;
+
+	switch (opt_socket_opts) {
+	case SOCKET_OPT_SEND:
+		for (k = 0; opt_do_run && (k < count); k++) {
+			ret = send(sfd, buf, size, 0);
+			if (ret < 0)
+				goto err_send;
+			(*msgs)++;
+			*bytes += ret;
+		}
+		break;
+#if defined(HAVE_ZEROCOPY)
+	case SOCKET_OPT_ZEROCOPY:
+		for (k = 0; opt_do_run && (k < count); k++) {
+			ret = socket_zerocopy_send(sfd, zcp, buf, size);
+			if (ret < 0)
+				break;
+			(*msgs)++;
+			*bytes += ret;
+		}
+		(void)socket_zerocopy_reap(sfd, zcp, true);
+		if (k < count)
+			goto err_send;
+		break;
+#endif
+	case SOCKET_OPT_SENDMSG:
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &vec;
+		msg.msg_iovlen = 1;
+		for (k = 0; opt_do_run && (k < count); k++) {
+			ret = sendmsg(sfd, &msg, 0);
+			if (ret < 0)
+				goto err_sendmsg;
+			(*msgs)++;
+			*bytes += ret;
+		}
+		break;
+#if defined(HAVE_SENDMMSG)
+	case SOCKET_OPT_SENDMMSG:
+		for (k = 0; opt_do_run && (k < count); k += ret) {
+			struct mmsghdr *msgvec = (struct mmsghdr *)msgvecp;
+			const size_t n = (count - k < opt_socket_mmsg_batch) ?
+				count - k : opt_socket_mmsg_batch;
+			ssize_t i;
+
+			memset(msgvec, 0, sizeof(*msgvec) * n);
+			for (i = 0; i < (ssize_t)n; i++) {
+				msgvec[i].msg_hdr.msg_iov = &vec;
+				msgvec[i].msg_hdr.msg_iovlen = 1;
+			}
+			ret = sendmmsg(sfd, msgvec, n, 0);
+			if (ret <= 0)
+				goto err_sendmmsg;
+			*msgs += ret;
+			for (i = 0; i < ret; i++)
+				*bytes += msgvec[i].msg_len;
+		}
+		break;
+#endif
+	}
+	(void)zcp;
+	(void)msgvecp;
+	return 0;
+
+err_send:
+	if (errno != EINTR)
+		pr_fail_dbg(name, "send");
+	return -1;
+err_sendmsg:
+	if (errno != EINTR)
+		pr_fail_dbg(name, "sendmsg");
+	return -1;
+#if defined(HAVE_SENDMMSG)
+err_sendmmsg:
+	if (errno != EINTR)
+		pr_fail_dbg(name, "sendmmsg");
+	return -1;
+#endif
+}
+
 /*
  *  stress_sctp_server()
  *	server writer
@@ -265,15 +531,42 @@ static int stress_sctp_server(
 	const pid_t pid,
 	const pid_t ppid)
 {
-	char buf[SOCKET_BUF];
+	static char buf[MAX_SOCKET_MSG_SIZE];
 	int fd, status;
 	int so_reuseaddr = 1;
 	socklen_t addr_len = 0;
 	struct sockaddr *addr;
-	uint64_t msgs = 0;
+	uint64_t msgs = 0, bytes = 0;
+	uint64_t sweep_msgs[SOCKET_SWEEP_SIZES], sweep_bytes[SOCKET_SWEEP_SIZES];
+	double sweep_time[SOCKET_SWEEP_SIZES];
+	double send_time = 0.0;
 	int rc = EXIT_SUCCESS;
+	void *zcp = NULL;
+#if defined(HAVE_ZEROCOPY)
+	static socket_zerocopy_t zc;
+#endif
+#if defined(HAVE_SENDMMSG)
+	struct mmsghdr *msgvec;
+#else
+	void *msgvec = NULL;
+#endif
 
 	(void)setpgid(pid, pgrp);
+#if defined(HAVE_ZEROCOPY)
+	zcp = &zc;
+#endif
+	memset(sweep_msgs, 0, sizeof(sweep_msgs));
+	memset(sweep_bytes, 0, sizeof(sweep_bytes));
+	memset(sweep_time, 0, sizeof(sweep_time));
+#if defined(HAVE_SENDMMSG)
+	msgvec = calloc(opt_socket_mmsg_batch, sizeof(*msgvec));
+	if (!msgvec) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " sendmmsg "
+			"messages\n", name, opt_socket_mmsg_batch);
+		rc = EXIT_NO_RESOURCE;
+		goto die;
+	}
+#endif
 
 	if (stress_sighandler(name, SIGALRM, handle_socket_sigalrm, NULL) < 0) {
 		rc = EXIT_FAILURE;
@@ -309,18 +602,22 @@ static int stress_sctp_server(
 		int sfd = accept(fd, (struct sockaddr *)NULL, NULL);
 		if (sfd >= 0) {
 			size_t i, j;
+			ssize_t ret;
 			struct sockaddr saddr;
 			socklen_t len;
 			int sndbuf;
 			struct msghdr msg;
-			struct iovec vec[sizeof(buf)/16];
-#if defined(HAVE_SENDMMSG)
-			struct mmsghdr msgvec[MSGVEC_SIZE];
-			unsigned int msg_len = 0;
-#endif
-#if defined(SOCKET_NODELAY)
+			struct iovec vec[SOCKET_BUF / 16];
+			const size_t sweep = (size_t)(*counter % SOCKET_SWEEP_SIZES);
+			const size_t size = opt_socket_msg_sweep ?
+				(size_t)SOCKET_SWEEP_MIN << sweep : opt_socket_msg_size;
+			uint64_t msgs_prev = msgs, bytes_prev = bytes;
+#if defined(SOCKET_NODELAY) || defined(HAVE_ZEROCOPY)
 			int one = 1;
 #endif
+			uint64_t t_lat;
+			double t;
+
 			len = sizeof(saddr);
 			if (getsockname(fd, &saddr, &len) < 0) {
 				pr_fail_dbg(name, "getsockname");
@@ -344,50 +641,94 @@ static int stress_sctp_server(
 					}
 			}
 #endif
-			memset(buf, 'A' + (*counter % 26), sizeof(buf));
+#if defined(HAVE_ZEROCOPY)
+			if ((opt_socket_opts == SOCKET_OPT_ZEROCOPY) &&
+			    (setsockopt(sfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0)) {
+				pr_inf(stderr, "%s: setsockopt SO_ZEROCOPY failed, "
+					"errno=%d (%s), using send instead\n",
+					name, errno, strerror(errno));
+				opt_socket_opts = SOCKET_OPT_SEND;
+			}
+			zc.next = 0;
+			zc.reaped = 0;
+#endif
+			/* zerocopy completions are reaped, buf is ours again */
+			memset(buf, 'A' + (*counter % 26), size > SOCKET_BUF ? size : SOCKET_BUF);
+			t_lat = latency_begin(*counter);
+			t = time_now();
+			if (size) {
+				(void)stress_sock_send_sized(name, sfd, buf, size,
+					msgvec, zcp, &msgs, &bytes);
+				goto sent;
+			}
 			switch (opt_socket_opts) {
 			case SOCKET_OPT_SEND:
-				for (i = 16; i < sizeof(buf); i += 16) {
-					ssize_t ret = send(sfd, buf, i, 0);
+				for (i = 16; i < SOCKET_BUF; i += 16) {
+					ret = send(sfd, buf, i, 0);
 					if (ret < 0) {
 						if (errno != EINTR)
 							pr_fail_dbg(name, "send");
 						break;
-					} else
+					} else {
 						msgs++;
+						bytes += ret;
+					}
+				}
+				break;
+#if defined(HAVE_ZEROCOPY)
+			case SOCKET_OPT_ZEROCOPY:
+				for (i = 16; i < SOCKET_BUF; i += 16) {
+					ret = socket_zerocopy_send(sfd, &zc, buf, i);
+					if (ret < 0) {
+						if (errno != EINTR)
+							pr_fail_dbg(name, "send");
+						break;
+					}
+					msgs++;
+					bytes += ret;
 				}
+				(void)socket_zerocopy_reap(sfd, &zc, true);
 				break;
+#endif
 			case SOCKET_OPT_SENDMSG:
-				for (j = 0, i = 16; i < sizeof(buf); i += 16, j++) {
+				for (j = 0, i = 16; i < SOCKET_BUF; i += 16, j++) {
 					vec[j].iov_base = buf;
 					vec[j].iov_len = i;
 				}
 				memset(&msg, 0, sizeof(msg));
 				msg.msg_iov = vec;
 				msg.msg_iovlen = j;
-				if (sendmsg(sfd, &msg, 0) < 0) {
+				ret = sendmsg(sfd, &msg, 0);
+				if (ret < 0) {
 					if (errno != EINTR)
 						pr_fail_dbg(name, "sendmsg");
-				} else
+				} else {
 					msgs += j;
+					bytes += ret;
+				}
 				break;
 #if defined(HAVE_SENDMMSG)
 			case SOCKET_OPT_SENDMMSG:
-				memset(msgvec, 0, sizeof(msgvec));
-				for (j = 0, i = 16; i < sizeof(buf); i += 16, j++) {
+				memset(msgvec, 0, sizeof(*msgvec) * opt_socket_mmsg_batch);
+				for (j = 0, i = 16; i < SOCKET_BUF; i += 16, j++) {
 					vec[j].iov_base = buf;
 					vec[j].iov_len = i;
-					msg_len += i;
 				}
-				for (i = 0; i < MSGVEC_SIZE; i++) {
+				for (i = 0; i < opt_socket_mmsg_batch; i++) {
 					msgvec[i].msg_hdr.msg_iov = vec;
 					msgvec[i].msg_hdr.msg_iovlen = j;
 				}
-				if (sendmmsg(sfd, msgvec, MSGVEC_SIZE, 0) < 0) {
+				ret = sendmmsg(sfd, msgvec, opt_socket_mmsg_batch, 0);
+				if (ret < 0) {
 					if (errno != EINTR)
 						pr_fail_dbg(name, "sendmmsg");
-				} else
-					msgs += (MSGVEC_SIZE * j);
+				} else {
+					ssize_t k;
+
+					msgs += (opt_socket_mmsg_batch * j);
+					for (k = 0; k < ret; k++)
+						bytes += msgvec[k].msg_len;
+				}
 				break;
 #endif
 			default:
@@ -396,6 +737,15 @@ static int stress_sctp_server(
 				(void)close(sfd);
 				goto die_close;
 			}
+sent:
+			t = time_now() - t;
+			send_time += t;
+			if (opt_socket_msg_sweep) {
+				sweep_msgs[sweep] += msgs - msgs_prev;
+				sweep_bytes[sweep] += bytes - bytes_prev;
+				sweep_time[sweep] += t;
+			}
+			latency_end(t_lat);
 			if (getpeername(sfd, &saddr, &len) < 0) {
 				pr_fail_dbg(name, "getpeername");
 			}
@@ -407,6 +757,9 @@ static int stress_sctp_server(
 die_close:
 	(void)close(fd);
 die:
+#if defined(HAVE_SENDMMSG)
+	free(msgvec);
+#endif
 #ifdef AF_UNIX
 	if (opt_socket_domain == AF_UNIX) {
 		struct sockaddr_un *addr_un = (struct sockaddr_un *)addr;
@@ -418,6 +771,31 @@ die:
 		(void)waitpid(pid, &status, 0);
 	}
 	pr_dbg(stderr, "%s: %" PRIu64 " messages sent\n", name, msgs);
+	if (opt_socket_msg_sweep && (instance == 0)) {
+		size_t k;
+
+		pr_inf(stderr, "%s: %12s %12s %12s\n", name,
+			"size (bytes)", "MB/sec", "msgs/sec");
+		for (k = 0; k < SOCKET_SWEEP_SIZES; k++) {
+			if (sweep_time[k] <= 0.0)
+				continue;
+			pr_inf(stderr, "%s: %12d %12.2f %12.0f\n", name,
+				SOCKET_SWEEP_MIN << k,
+				(double)sweep_bytes[k] / sweep_time[k] / (double)MB,
+				(double)sweep_msgs[k] / sweep_time[k]);
+		}
+	}
+	if (send_time > 0.0)
+		stress_misc_metric_set(0, "send rate (MB/sec)",
+			(double)bytes / send_time / (double)MB);
+#if defined(HAVE_ZEROCOPY)
+	if (zc.completions) {
+		stress_misc_metric_set(1, "zerocopy completion (usec)",
+			zc.latency * 1000000.0 / (double)zc.completions);
+		stress_misc_metric_set(2, "zerocopy copied by kernel (%)",
+			100.0 * (double)zc.copied / (double)zc.completions);
+	}
+#endif
 
 	return rc;
 }
@@ -437,6 +815,8 @@ int stress_sock(
 	pr_dbg(stderr, "%s: process [%d] using socket port %d\n",
 		name, getpid(), opt_socket_port + instance);
 
+	if (stress_net_role() == NET_ROLE_SERVER)
+		return stress_sctp_server(counter, instance, max_ops, name, 0, ppid);
 again:
 	pid = fork();
 	if (pid < 0) {
@@ -447,6 +827,8 @@ again:
 	} else if (pid == 0) {
 		stress_sctp_client(counter, instance, max_ops, name, ppid);
 		exit(EXIT_SUCCESS);
+	} else if (stress_net_role() == NET_ROLE_CLIENT) {
+		return stress_net_client_wait(pid);
 	} else {
 		return stress_sctp_server(counter, instance, max_ops, name, pid, ppid);
 	}
@@ -0,0 +1,597 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "stress-ng.h"
+
+#define SORT_METHOD_QSORT	(0)	/* libc qsort, comparator callback */
+#define SORT_METHOD_INTROSORT	(1)	/* introsort, inlined compares */
+#define SORT_METHOD_RADIX	(2)	/* LSD radix sort, 8 bit digits */
+#define SORT_METHOD_PMERGE	(3)	/* multithreaded merge sort */
+#define SORT_METHOD_MAX		(4)
+#define SORT_METHOD_ALL		(SORT_METHOD_MAX)
+
+#define SORT_DIST_RANDOM	(0)	/* uniformly random */
+#define SORT_DIST_SORTED	(1)	/* already in order */
+#define SORT_DIST_REVERSE	(2)	/* in reverse order */
+#define SORT_DIST_FEW_UNIQUE	(3)	/* only 16 distinct values */
+
+#define SORT_INSERTION_MAX	(16)	/* introsort partitions smaller use insertion sort */
+#define SORT_FEW_UNIQUE		(16)	/* distinct values of the few-unique data */
+
+typedef struct {
+	const char *name;	/* User option */
+	int value;		/* SORT_METHOD_ or SORT_DIST_ value */
+} sort_opt_t;
+
+static const sort_opt_t sort_methods[] = {
+	{ "qsort",	SORT_METHOD_QSORT },
+	{ "introsort",	SORT_METHOD_INTROSORT },
+	{ "radix",	SORT_METHOD_RADIX },
+	{ "pmerge",	SORT_METHOD_PMERGE },
+	{ "all",	SORT_METHOD_ALL },
+};
+
+static const sort_opt_t sort_dists[] = {
+	{ "random",	SORT_DIST_RANDOM },
+	{ "sorted",	SORT_DIST_SORTED },
+	{ "reverse",	SORT_DIST_REVERSE },
+	{ "few-unique",	SORT_DIST_FEW_UNIQUE },
+};
+
+/* Sorted elements and time per method */
+typedef struct {
+	uint64_t elements;	/* elements sorted */
+	double secs;		/* time spent sorting */
+} sort_stats_t;
+
+/* A run of the parallel merge sort, sorted or merged by one thread */
+typedef struct {
+	int32_t *data;		/* run to sort, or first run to merge */
+	int32_t *tmp;		/* scratch space matching data */
+	size_t n;		/* elements in the first run */
+	size_t m;		/* elements in the second run, 0 to sort */
+} sort_run_t;
+
+static uint64_t opt_sort_size = DEFAULT_SORT_SIZE;
+static bool set_sort_size = false;
+static int opt_sort_method = SORT_METHOD_ALL;
+static int opt_sort_dist = SORT_DIST_RANDOM;
+static uint32_t opt_sort_threads = DEFAULT_SORT_THREADS;
+
+/*
+ *  sort_opt_find()
+ *	look up a named option value, -1 and a list of
+ *	the valid names if it is not found
+ */
+static int sort_opt_find(
+	const char *opt,
+	const char *name,
+	const sort_opt_t *opts,
+	const size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (!strcmp(name, opts[i].name))
+			return opts[i].value;
+	}
+	fprintf(stderr, "%s must be one of:", opt);
+	for (i = 0; i < n; i++)
+		fprintf(stderr, " %s", opts[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_sort_method()
+ *	set the sort method to exercise
+ */
+int stress_set_sort_method(const char *name)
+{
+	const int method = sort_opt_find("sort-method", name,
+		sort_methods, SIZEOF_ARRAY(sort_methods));
+
+	if (method < 0)
+		return -1;
+	opt_sort_method = method;
+	return 0;
+}
+
+/*
+ *  stress_set_sort_dist()
+ *	set the distribution of the data to sort
+ */
+int stress_set_sort_dist(const char *name)
+{
+	const int dist = sort_opt_find("sort-dist", name,
+		sort_dists, SIZEOF_ARRAY(sort_dists));
+
+	if (dist < 0)
+		return -1;
+	opt_sort_dist = dist;
+	return 0;
+}
+
+void stress_set_sort_size(const char *optarg)
+{
+	set_sort_size = true;
+	opt_sort_size = get_uint64_byte(optarg);
+	check_range("sort-size", opt_sort_size,
+		MIN_SORT_SIZE, MAX_SORT_SIZE);
+}
+
+void stress_set_sort_threads(const char *optarg)
+{
+	opt_sort_threads = (uint32_t)get_uint64(optarg);
+	check_range("sort-threads", opt_sort_threads,
+		MIN_SORT_THREADS, MAX_SORT_THREADS);
+}
+
+/*
+ *  sort_cmp()
+ *	qsort comparison - sort on int32 values
+ */
+static int sort_cmp(const void *p1, const void *p2)
+{
+	const int32_t i1 = *(const int32_t *)p1;
+	const int32_t i2 = *(const int32_t *)p2;
+
+	return (i1 > i2) - (i1 < i2);
+}
+
+/*
+ *  sort_fill()
+ *	fill the input data with the chosen distribution
+ */
+static void sort_fill(int32_t *data, const size_t n)
+{
+	size_t i;
+
+	switch (opt_sort_dist) {
+	case SORT_DIST_SORTED:
+		for (i = 0; i < n; i++)
+			data[i] = (int32_t)(i - (n / 2));
+		break;
+	case SORT_DIST_REVERSE:
+		for (i = 0; i < n; i++)
+			data[i] = (int32_t)((n / 2) - i);
+		break;
+	case SORT_DIST_FEW_UNIQUE:
+		for (i = 0; i < n; i++)
+			data[i] = (int32_t)(mwc32() % SORT_FEW_UNIQUE) * 0x1000000;
+		break;
+	default:
+		for (i = 0; i < n; i++)
+			data[i] = (int32_t)mwc32();
+		break;
+	}
+}
+
+static inline void sort_swap(int32_t *a, int32_t *b)
+{
+	const int32_t tmp = *a;
+
+	*a = *b;
+	*b = tmp;
+}
+
+/*
+ *  sort_insertion()
+ *	insertion sort, for the small introsort partitions
+ */
+static void sort_insertion(int32_t *data, const size_t n)
+{
+	size_t i;
+
+	for (i = 1; i < n; i++) {
+		const int32_t v = data[i];
+		size_t j = i;
+
+		while ((j > 0) && (data[j - 1] > v)) {
+			data[j] = data[j - 1];
+			j--;
+		}
+		data[j] = v;
+	}
+}
+
+/*
+ *  sort_heapsort()
+ *	heapsort, the introsort fallback once
+ *	quicksort recursion gets too deep
+ */
+static void sort_heapsort(int32_t *data, const size_t n)
+{
+	size_t i, end;
+
+	if (n < 2)
+		return;
+	for (i = n / 2; i-- > 0; ) {
+		size_t root = i, child;
+
+		while ((child = (2 * root) + 1) < n) {
+			if ((child + 1 < n) && (data[child] < data[child + 1]))
+				child++;
+			if (data[root] >= data[child])
+				break;
+			sort_swap(&data[root], &data[child]);
+			root = child;
+		}
+	}
+	for (end = n - 1; end > 0; end--) {
+		size_t root = 0, child;
+
+		sort_swap(&data[0], &data[end]);
+		while ((child = (2 * root) + 1) < end) {
+			if ((child + 1 < end) && (data[child] < data[child + 1]))
+				child++;
+			if (data[root] >= data[child])
+				break;
+			sort_swap(&data[root], &data[child]);
+			root = child;
+		}
+	}
+}
+
+/*
+ *  sort_introsort()
+ *	quicksort with a median of three pivot, falling back to
+ *	heapsort when depth runs out and insertion sort for small
+ *	partitions, the compares are inlined rather than callbacks
+ */
+static void sort_introsort(int32_t *data, size_t n, int depth)
+{
+	while (n > SORT_INSERTION_MAX) {
+		int32_t *lo = data, *hi = data + n - 1, *mid = data + (n / 2);
+		int32_t pivot;
+		size_t left;
+
+		if (depth-- == 0) {
+			sort_heapsort(data, n);
+			return;
+		}
+		if (*mid < *lo)
+			sort_swap(mid, lo);
+		if (*hi < *mid) {
+			sort_swap(hi, mid);
+			if (*mid < *lo)
+				sort_swap(mid, lo);
+		}
+		pivot = *mid;
+
+		/* Hoare partition, the sentinels at lo and hi bound the scans */
+		for (;;) {
+			while (*lo < pivot)
+				lo++;
+			while (pivot < *hi)
+				hi--;
+			if (lo >= hi)
+				break;
+			sort_swap(lo, hi);
+			lo++;
+			hi--;
+		}
+		/* Recurse into the smaller side, loop on the larger */
+		left = (size_t)(hi - data) + 1;
+		if (left < n - left) {
+			sort_introsort(data, left, depth);
+			data += left;
+			n -= left;
+		} else {
+			sort_introsort(data + left, n - left, depth);
+			n = left;
+		}
+	}
+	sort_insertion(data, n);
+}
+
+static void sort_introsort_all(int32_t *data, const size_t n)
+{
+	int depth = 0;
+	size_t i;
+
+	for (i = n; i > 1; i >>= 1)
+		depth += 2;
+	sort_introsort(data, n, depth);
+}
+
+/*
+ *  sort_radix()
+ *	LSD radix sort on 8 bit digits, the sign bit is flipped so
+ *	signed values order correctly, a digit that is the same for
+ *	all the elements is skipped
+ */
+static void sort_radix(int32_t *data, int32_t *tmp, const size_t n)
+{
+	uint32_t *src = (uint32_t *)data, *dst = (uint32_t *)tmp;
+	size_t counts[4][256];
+	size_t i;
+	int d;
+
+	memset(counts, 0, sizeof(counts));
+	for (i = 0; i < n; i++) {
+		const uint32_t v = src[i] ^ 0x80000000U;
+
+		counts[0][v & 0xff]++;
+		counts[1][(v >> 8) & 0xff]++;
+		counts[2][(v >> 16) & 0xff]++;
+		counts[3][v >> 24]++;
+	}
+	for (d = 0; d < 4; d++) {
+		const int shift = d * 8;
+		size_t offsets[256], sum = 0;
+		uint32_t *swap;
+		int b;
+
+		if (counts[d][((src[0] ^ 0x80000000U) >> shift) & 0xff] == n)
+			continue;
+		for (b = 0; b < 256; b++) {
+			offsets[b] = sum;
+			sum += counts[d][b];
+		}
+		for (i = 0; i < n; i++) {
+			const uint32_t v = src[i];
+
+			dst[offsets[((v ^ 0x80000000U) >> shift) & 0xff]++] = v;
+		}
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if (src != (uint32_t *)data)
+		memcpy(data, src, n * sizeof(*data));
+}
+
+/*
+ *  sort_merge()
+ *	merge the two adjacent sorted runs via tmp
+ */
+static void sort_merge(int32_t *data, int32_t *tmp, const size_t n, const size_t m)
+{
+	const int32_t *a = data, *a_end = data + n;
+	const int32_t *b = data + n, *b_end = data + n + m;
+	int32_t *out = tmp;
+
+	while ((a < a_end) && (b < b_end))
+		*out++ = (*b < *a) ? *b++ : *a++;
+	while (a < a_end)
+		*out++ = *a++;
+	while (b < b_end)
+		*out++ = *b++;
+	memcpy(data, tmp, (n + m) * sizeof(*data));
+}
+
+/*
+ *  sort_run()
+ *	sort, or merge, one run of the parallel merge sort
+ */
+static void *sort_run(void *arg)
+{
+	sort_run_t *run = (sort_run_t *)arg;
+
+	if (run->m)
+		sort_merge(run->data, run->tmp, run->n, run->m);
+	else
+		sort_introsort_all(run->data, run->n);
+	return NULL;
+}
+
+/*
+ *  sort_jobs()
+ *	sort or merge the runs concurrently, a thread per run with
+ *	the first run done by the caller, runs that can't get a
+ *	thread are done by the caller too
+ */
+static void sort_jobs(sort_run_t *runs, const size_t jobs)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_t pthreads[MAX_SORT_THREADS];
+	bool created[MAX_SORT_THREADS];
+	size_t t;
+
+	for (t = 1; t < jobs; t++)
+		created[t] = (pthread_create(&pthreads[t], NULL,
+			sort_run, &runs[t]) == 0);
+	(void)sort_run(&runs[0]);
+	for (t = 1; t < jobs; t++) {
+		if (created[t])
+			(void)pthread_join(pthreads[t], NULL);
+		else
+			(void)sort_run(&runs[t]);
+	}
+#else
+	size_t t;
+
+	for (t = 0; t < jobs; t++)
+		(void)sort_run(&runs[t]);
+#endif
+}
+
+/*
+ *  sort_pmerge()
+ *	split the data into a run per thread, sort the runs
+ *	concurrently and then merge pairs of runs concurrently,
+ *	doubling the run length each pass, until one run is left
+ */
+static void sort_pmerge(int32_t *data, int32_t *tmp, const size_t n)
+{
+	sort_run_t runs[MAX_SORT_THREADS];
+	size_t starts[MAX_SORT_THREADS + 1];
+	size_t t, width, nruns = opt_sort_threads;
+
+	if (nruns > n)
+		nruns = n;
+	for (t = 0; t <= nruns; t++)
+		starts[t] = (n * t) / nruns;
+
+	for (t = 0; t < nruns; t++) {
+		runs[t].data = data + starts[t];
+		runs[t].tmp = tmp + starts[t];
+		runs[t].n = starts[t + 1] - starts[t];
+		runs[t].m = 0;
+	}
+	sort_jobs(runs, nruns);
+
+	for (width = 1; width < nruns; width *= 2) {
+		size_t jobs = 0;
+
+		for (t = 0; t + width < nruns; t += 2 * width) {
+			const size_t end = (t + (2 * width) < nruns) ?
+				t + (2 * width) : nruns;
+
+			runs[jobs].data = data + starts[t];
+			runs[jobs].tmp = tmp + starts[t];
+			runs[jobs].n = starts[t + width] - starts[t];
+			runs[jobs].m = starts[end] - starts[t + width];
+			jobs++;
+		}
+		sort_jobs(runs, jobs);
+	}
+}
+
+/*
+ *  sort_check()
+ *	verify the data is in order
+ */
+static int sort_check(const int32_t *data, const size_t n)
+{
+	size_t i;
+
+	for (i = 1; i < n; i++) {
+		if (data[i - 1] > data[i])
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ *  stress_sort()
+ *	sort 32 bit integers with a choice of methods and input
+ *	distributions, reporting the elements sorted per second
+ *	of each method
+ */
+int stress_sort(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	sort_stats_t stats[SORT_METHOD_MAX];
+	int32_t *input, *data, *tmp;
+	size_t n, bytes;
+	int method;
+
+	if (!set_sort_size) {
+		if (opt_flags & OPT_FLAGS_MAXIMIZE)
+			opt_sort_size = MAX_SORT_SIZE;
+		if (opt_flags & OPT_FLAGS_MINIMIZE)
+			opt_sort_size = MIN_SORT_SIZE;
+	}
+	n = (size_t)opt_sort_size;
+	bytes = n * sizeof(int32_t);
+
+	input = malloc(bytes);
+	data = malloc(bytes);
+	tmp = malloc(bytes);
+	if (!input || !data || !tmp) {
+		pr_fail_dbg(name, "malloc");
+		free(tmp);
+		free(data);
+		free(input);
+		return EXIT_NO_RESOURCE;
+	}
+	/* This is expensive, do it once */
+	sort_fill(input, n);
+	memset(stats, 0, sizeof(stats));
+
+	do {
+		for (method = 0; method < SORT_METHOD_MAX; method++) {
+			double t;
+
+			if ((opt_sort_method != SORT_METHOD_ALL) &&
+			    (opt_sort_method != method))
+				continue;
+
+			memcpy(data, input, bytes);
+			t = time_now();
+			switch (method) {
+			case SORT_METHOD_QSORT:
+				qsort(data, n, sizeof(*data), sort_cmp);
+				break;
+			case SORT_METHOD_INTROSORT:
+				sort_introsort_all(data, n);
+				break;
+			case SORT_METHOD_RADIX:
+				sort_radix(data, tmp, n);
+				break;
+			default:
+				sort_pmerge(data, tmp, n);
+				break;
+			}
+			stats[method].secs += time_now() - t;
+			stats[method].elements += n;
+
+			if ((opt_flags & OPT_FLAGS_VERIFY) && (sort_check(data, n) < 0))
+				pr_fail(stderr, "%s: %s sort error detected, "
+					"incorrect ordering found\n",
+					name, sort_methods[method].name);
+			(*counter)++;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				break;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	if (instance == 0)
+		pr_inf(stderr, "%s: %10s %14s (%zu %s elements)\n", name,
+			"method", "Melements/s", n, sort_dists[opt_sort_dist].name);
+	for (method = 0; method < SORT_METHOD_MAX; method++) {
+		const sort_stats_t *s = &stats[method];
+		const double rate = (s->secs > 0.0) ?
+			(double)s->elements / s->secs / 1000000.0 : 0.0;
+		char desc[40];
+
+		if (!s->elements)
+			continue;
+		if (instance == 0)
+			pr_inf(stderr, "%s: %10s %14.3f\n", name,
+				sort_methods[method].name, rate);
+		(void)snprintf(desc, sizeof(desc), "%s Melements/s",
+			sort_methods[method].name);
+		stress_misc_metric_set((size_t)method, desc, rate);
+	}
+
+	free(tmp);
+	free(data);
+	free(input);
+
+	return EXIT_SUCCESS;
+}
@@ -31,13 +31,36 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define SPLICE_MODE_COPY	(0)	/* /dev/zero -> pipe -> /dev/null */
+#define SPLICE_MODE_PIPELINE	(1)	/* file -> pipe -> tee -> sockets */
+
+#define SPLICE_FILE_SIZE	(16 * MB)
+
+typedef struct {
+	const char *name;	/* User option */
+	int mode;		/* SPLICE_MODE_ value */
+} splice_mode_t;
+
+static const splice_mode_t splice_modes[] = {
+	{ "copy",	SPLICE_MODE_COPY },
+	{ "pipeline",	SPLICE_MODE_PIPELINE },
+};
 
 static size_t opt_splice_bytes = DEFAULT_SPLICE_BYTES;
 static bool set_splice_bytes = false;
+static int opt_splice_mode = SPLICE_MODE_COPY;
+static uint32_t opt_splice_consumers = DEFAULT_SPLICE_CONSUMERS;
 
 void stress_set_splice_bytes(const char *optarg)
 {
@@ -47,6 +70,289 @@ void stress_set_splice_bytes(const char *optarg)
 		MIN_SPLICE_BYTES, MAX_SPLICE_BYTES);
 }
 
+/*
+ *  stress_set_splice_mode()
+ *	set the splice stressor mode
+ */
+int stress_set_splice_mode(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(splice_modes); i++) {
+		if (!strcmp(name, splice_modes[i].name)) {
+			opt_splice_mode = splice_modes[i].mode;
+			return 0;
+		}
+	}
+	fprintf(stderr, "splice-mode must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(splice_modes); i++)
+		fprintf(stderr, " %s", splice_modes[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_splice_consumers()
+ *	set the number of tee fan-out consumers in pipeline mode
+ */
+void stress_set_splice_consumers(const char *optarg)
+{
+	uint64_t consumers;
+
+	consumers = get_uint64(optarg);
+	check_range("splice-consumers", consumers,
+		MIN_SPLICE_CONSUMERS, MAX_SPLICE_CONSUMERS);
+	opt_splice_consumers = (uint32_t)consumers;
+}
+
+/*
+ *  stress_splice_consumer()
+ *	drain and discard everything sent down a socket
+ */
+static void stress_splice_consumer(const int fd)
+{
+	static char buffer[65536];
+
+	while (opt_do_run) {
+		ssize_t ret;
+
+		ret = read(fd, buffer, sizeof(buffer));
+		if (ret == 0)
+			break;
+		if ((ret < 0) && (errno != EINTR))
+			break;
+	}
+	(void)close(fd);
+}
+
+/*
+ *  stress_splice_drain()
+ *	splice len bytes out of a pipe into a socket
+ */
+static int stress_splice_drain(const int fd_pipe, const int fd_sock, size_t len)
+{
+	while (len > 0) {
+		ssize_t n;
+
+		n = splice(fd_pipe, NULL, fd_sock, NULL, len, SPLICE_F_MOVE);
+		if (n <= 0)
+			return -1;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+/*
+ *  stress_splice_write_all()
+ *	write len bytes to a socket, retrying short writes
+ */
+static int stress_splice_write_all(const int fd, const char *buf, size_t len)
+{
+	while (len > 0) {
+		ssize_t n;
+
+		n = write(fd, buf, len);
+		if (n <= 0)
+			return -1;
+		buf += n;
+		len -= (size_t)n;
+	}
+	return 0;
+}
+
+/*
+ *  stress_splice_pipeline()
+ *	splice a file into a pipe, tee it into one pipe per extra
+ *	consumer and splice each pipe into a socket to a consumer
+ *	process. Each pass over the file is followed by a read(2)
+ *	and write(2) copy of the same data to the same consumers so
+ *	the zero copy gain can be reported as a metric.
+ */
+static int stress_splice_pipeline(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const pid_t pid = getpid();
+	const uint32_t consumers = opt_splice_consumers;
+	const size_t chunk = opt_splice_bytes;
+	int pipes[MAX_SPLICE_CONSUMERS][2];
+	int socks[MAX_SPLICE_CONSUMERS];
+	pid_t pids[MAX_SPLICE_CONSUMERS];
+	char filename[PATH_MAX];
+	char *buf;
+	int fd, ret, rc = EXIT_FAILURE;
+	uint32_t i, n_pipes = 0, n_pids = 0;
+	uint64_t splice_bytes = 0, copy_bytes = 0;
+	double splice_time = 0.0, copy_time = 0.0;
+	off_t off;
+
+	buf = malloc(chunk);
+	if (!buf) {
+		pr_fail_err(name, "malloc");
+		return EXIT_NO_RESOURCE;
+	}
+
+	ret = stress_temp_dir_mk(name, pid, instance);
+	if (ret < 0) {
+		free(buf);
+		return exit_status(-ret);
+	}
+	(void)stress_temp_filename(filename, sizeof(filename),
+		name, pid, instance, mwc32());
+	fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		rc = exit_status(errno);
+		pr_fail_err(name, "open");
+		goto tidy_dir;
+	}
+	(void)unlink(filename);
+
+	for (i = 0; i < chunk; i++)
+		buf[i] = mwc8();
+	for (off = 0; off < (off_t)SPLICE_FILE_SIZE; off += (off_t)chunk) {
+		if (stress_splice_write_all(fd, buf, chunk) < 0) {
+			rc = exit_status(errno);
+			pr_fail_err(name, "write");
+			goto tidy_fd;
+		}
+	}
+
+	for (n_pipes = 0; n_pipes < consumers; n_pipes++) {
+		if (pipe(pipes[n_pipes]) < 0) {
+			pr_fail_err(name, "pipe");
+			goto tidy_pipes;
+		}
+#if defined(F_SETPIPE_SZ)
+		/* best effort, lets a whole chunk fit in the pipe */
+		(void)fcntl(pipes[n_pipes][1], F_SETPIPE_SZ, (int)chunk);
+#endif
+	}
+
+	for (n_pids = 0; n_pids < consumers; n_pids++) {
+		int sv[2];
+
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+			pr_fail_err(name, "socketpair");
+			goto tidy_pids;
+		}
+again:
+		pids[n_pids] = fork();
+		if (pids[n_pids] < 0) {
+			if (opt_do_run && (errno == EAGAIN))
+				goto again;
+			pr_fail_err(name, "fork");
+			(void)close(sv[0]);
+			(void)close(sv[1]);
+			goto tidy_pids;
+		}
+		if (pids[n_pids] == 0) {
+			(void)setpgid(0, pgrp);
+			stress_parent_died_alarm();
+			(void)close(sv[0]);
+			stress_splice_consumer(sv[1]);
+			_exit(EXIT_SUCCESS);
+		}
+		(void)setpgid(pids[n_pids], pgrp);
+		(void)close(sv[1]);
+		socks[n_pids] = sv[0];
+	}
+
+	do {
+		uint64_t round = 0;
+		double t;
+
+		/* zero copy pass: file -> pipe -> tee -> sockets */
+		t = time_now();
+		for (off = 0; off < (off_t)SPLICE_FILE_SIZE; ) {
+			ssize_t n;
+
+			n = splice(fd, &off, pipes[0][1], NULL,
+				chunk, SPLICE_F_MOVE);
+			if (n <= 0) {
+				if ((n < 0) && (errno != EINTR))
+					pr_fail_err(name, "splice");
+				goto done;
+			}
+			for (i = 1; i < consumers; i++) {
+				ssize_t tn;
+
+				tn = tee(pipes[0][0], pipes[i][1], (size_t)n, 0);
+				if (tn != n) {
+					if ((tn < 0) && (errno == EINTR))
+						goto done;
+					pr_fail_err(name, "tee");
+					goto done;
+				}
+				if (stress_splice_drain(pipes[i][0], socks[i], (size_t)n) < 0)
+					goto done;
+			}
+			if (stress_splice_drain(pipes[0][0], socks[0], (size_t)n) < 0)
+				goto done;
+			round += (uint64_t)n;
+			(*counter)++;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				break;
+		}
+		splice_time += time_now() - t;
+		splice_bytes += round * consumers;
+
+		/* baseline pass: the same bytes via read(2) and write(2) */
+		t = time_now();
+		for (off = 0; off < (off_t)round; ) {
+			ssize_t n;
+
+			n = pread(fd, buf, chunk, off);
+			if (n <= 0)
+				goto done;
+			for (i = 0; i < consumers; i++) {
+				if (stress_splice_write_all(socks[i], buf, (size_t)n) < 0)
+					goto done;
+			}
+			off += n;
+		}
+		copy_time += time_now() - t;
+		copy_bytes += round * consumers;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	if ((splice_time > 0.0) && (copy_time > 0.0)) {
+		const double splice_rate = (double)splice_bytes / splice_time;
+		const double copy_rate = (double)copy_bytes / copy_time;
+
+		stress_misc_metric_set(0, "splice pipeline (GB/sec)",
+			splice_rate / (double)GB);
+		stress_misc_metric_set(1, "read/write copy (GB/sec)",
+			copy_rate / (double)GB);
+		if (copy_rate > 0.0)
+			stress_misc_metric_set(2, "splice speedup (x)",
+				splice_rate / copy_rate);
+		stress_misc_metric_set(3, "consumers", (double)consumers);
+	}
+	rc = EXIT_SUCCESS;
+
+tidy_pids:
+	for (i = 0; i < n_pids; i++) {
+		int status;
+
+		(void)close(socks[i]);
+		(void)kill(pids[i], SIGKILL);
+		(void)waitpid(pids[i], &status, 0);
+	}
+tidy_pipes:
+	for (i = 0; i < n_pipes; i++) {
+		(void)close(pipes[i][0]);
+		(void)close(pipes[i][1]);
+	}
+tidy_fd:
+	(void)close(fd);
+tidy_dir:
+	(void)stress_temp_dir_rm(name, pid, instance);
+	free(buf);
+
+	return rc;
+}
+
 /*
  *  stress_splice
  *	stress copying of /dev/zero to /dev/null
@@ -66,6 +372,9 @@ int stress_splice(
 			opt_splice_bytes = MIN_SPLICE_BYTES;
 	}
 
+	if (opt_splice_mode == SPLICE_MODE_PIPELINE)
+		return stress_splice_pipeline(counter, instance, max_ops, name);
+
 	(void)instance;
 
 	if (pipe(fds) < 0) {
@@ -33,13 +33,37 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #if defined(__sun__)
 #include <alloca.h>
 #endif
 
 #include "stress-ng.h"
 
+#define STACK_COST_GROW		(1 * MB)	/* stack grown per timing */
+#define STACK_COST_SKIP		(256 * KB)	/* stack that may be mapped */
+#define STACK_COST_ALLOCS	(64)		/* thread stacks per size */
+
+/* thread stack sizes timed, as pthread_attr_setstacksize would */
+static const size_t stack_cost_sizes[] = {
+	64 * KB, 256 * KB, 1 * MB, 2 * MB, 8 * MB
+};
+
+/* the results of one round of timings, from the child that grew */
+typedef struct {
+	double grow;		/* ns per page of stack grown */
+	double anon;		/* ns per page faulted in plain anon memory */
+	double growsdown;	/* ns per page grown of a MAP_GROWSDOWN mapping */
+	double alloc[SIZEOF_ARRAY(stack_cost_sizes)];	/* ns per stack */
+} stack_cost_t;
+
 static sigjmp_buf jmp_env;
+static bool opt_stack_cost = false;
+
+void stress_set_stack_cost(void)
+{
+	opt_stack_cost = true;
+}
 
 /*
  *  stress_segvhandler()
@@ -53,6 +77,201 @@ static void MLOCKED stress_segvhandler(int dummy)
 }
 
 
+/*
+ *  stack_cost_touch()
+ *	ns per page to fault in sz bytes at ptr, top page first
+ *	as a stack grows
+ */
+static double stack_cost_touch(volatile uint8_t *ptr, const size_t sz)
+{
+	const size_t page_size = stress_get_pagesize();
+	ssize_t off;
+	double t;
+
+	t = time_now();
+	for (off = (ssize_t)(sz - page_size); off >= 0; off -= page_size)
+		ptr[off] = 0;
+	t = time_now() - t;
+
+	return (t * 1000000000.0) / (sz / page_size);
+}
+
+/*
+ *  stack_cost_grow()
+ *	ns per page of growing the process stack into new pages,
+ *	below whatever the stack may have used before the fork
+ */
+static double stack_cost_grow(void)
+{
+	volatile uint8_t *ptr = alloca(STACK_COST_SKIP + STACK_COST_GROW);
+
+	return stack_cost_touch(ptr, STACK_COST_GROW);
+}
+
+/*
+ *  stack_cost_growsdown()
+ *	ns per page of growing a one page MAP_GROWSDOWN mapping down
+ *	into the free space left below it, -1 if it can't be done
+ */
+static double stack_cost_growsdown(void)
+{
+#if defined(MAP_GROWSDOWN)
+	const size_t page_size = stress_get_pagesize();
+	const size_t sz = STACK_COST_GROW + STACK_COST_SKIP;
+	uint8_t *base, *top;
+	double ns;
+
+	/* Find free space, the gap keeps the kernel's stack guard gap */
+	base = mmap(NULL, sz, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		return -1.0;
+	(void)munmap(base, sz);
+	top = mmap(base + sz - page_size, page_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_GROWSDOWN | MAP_FIXED, -1, 0);
+	if (top == MAP_FAILED)
+		return -1.0;
+	ns = stack_cost_touch(top + page_size - STACK_COST_GROW, STACK_COST_GROW);
+	(void)munmap(top + page_size - STACK_COST_GROW, STACK_COST_GROW);
+
+	return ns;
+#else
+	return -1.0;
+#endif
+}
+
+/*
+ *  stack_cost_alloc()
+ *	ns to set up and tear down a thread stack of sz bytes as
+ *	glibc does, an mmap with a guard page at the bottom, with
+ *	the top page touched as the thread would on its first call
+ */
+static double stack_cost_alloc(const size_t sz)
+{
+	const size_t page_size = stress_get_pagesize();
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	double t;
+	int i;
+
+#if defined(MAP_STACK)
+	flags |= MAP_STACK;
+#endif
+	t = time_now();
+	for (i = 0; i < STACK_COST_ALLOCS; i++) {
+		uint8_t *stack;
+
+		stack = mmap(NULL, sz + page_size, PROT_READ | PROT_WRITE,
+			flags, -1, 0);
+		if (stack == MAP_FAILED)
+			return -1.0;
+		(void)mprotect(stack, page_size, PROT_NONE);
+		*(volatile uint8_t *)(stack + sz + page_size - 1) = 0;
+		(void)munmap(stack, sz + page_size);
+	}
+	t = time_now() - t;
+
+	return (t * 1000000000.0) / STACK_COST_ALLOCS;
+}
+
+/*
+ *  stress_stack_cost()
+ *	time stack growth page faults against plain anonymous page
+ *	faults and MAP_GROWSDOWN growth, and thread stack set up at
+ *	sizes from 64K to 8M. Each round is timed in a new child so
+ *	its stack has not grown yet. One bogo op per round.
+ */
+static int stress_stack_cost(
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const char *name)
+{
+	stack_cost_t *cost, total;
+	uint64_t rounds = 0, growsdown = 0;
+	size_t i;
+
+	cost = mmap(NULL, sizeof(*cost), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (cost == MAP_FAILED) {
+		pr_fail_dbg(name, "mmap");
+		return EXIT_NO_RESOURCE;
+	}
+	(void)memset(&total, 0, sizeof(total));
+
+	do {
+		pid_t pid;
+		int status;
+
+		(void)memset(cost, 0, sizeof(*cost));
+		pid = fork();
+		if (pid < 0) {
+			if (errno == EAGAIN)
+				continue;
+			pr_fail_dbg(name, "fork");
+			break;
+		}
+		if (pid == 0) {
+			uint8_t *anon;
+
+			(void)setpgid(0, pgrp);
+			stress_parent_died_alarm();
+
+			cost->grow = stack_cost_grow();
+			anon = mmap(NULL, STACK_COST_GROW, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (anon != MAP_FAILED) {
+				cost->anon = stack_cost_touch(anon, STACK_COST_GROW);
+				(void)munmap(anon, STACK_COST_GROW);
+			}
+			for (i = 0; i < SIZEOF_ARRAY(stack_cost_sizes); i++)
+				cost->alloc[i] = stack_cost_alloc(stack_cost_sizes[i]);
+			/* Last, a failed growth may take a SIGSEGV */
+			cost->growsdown = -1.0;
+			cost->growsdown = stack_cost_growsdown();
+			_exit(EXIT_SUCCESS);
+		}
+		(void)setpgid(pid, pgrp);
+		if (waitpid(pid, &status, 0) < 0) {
+			if (errno != EINTR)
+				pr_fail_dbg(name, "waitpid");
+			break;
+		}
+		if (cost->grow <= 0.0)
+			continue;
+		total.grow += cost->grow;
+		total.anon += cost->anon;
+		for (i = 0; i < SIZEOF_ARRAY(stack_cost_sizes); i++)
+			total.alloc[i] += cost->alloc[i];
+		if (cost->growsdown > 0.0) {
+			total.growsdown += cost->growsdown;
+			growsdown++;
+		}
+		rounds++;
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	if (rounds) {
+		stress_misc_metric_set(0, "stack growth ns per page",
+			total.grow / rounds);
+		stress_misc_metric_set(1, "anon fault ns per page",
+			total.anon / rounds);
+		if (growsdown)
+			stress_misc_metric_set(2, "growsdown ns per page",
+				total.growsdown / growsdown);
+		else
+			pr_inf(stderr, "%s: MAP_GROWSDOWN mappings did not "
+				"grow\n", name);
+		for (i = 0; i < SIZEOF_ARRAY(stack_cost_sizes); i++) {
+			char desc[48];
+
+			(void)snprintf(desc, sizeof(desc), "%zuK thread stack ns",
+				(size_t)(stack_cost_sizes[i] / KB));
+			stress_misc_metric_set(3 + i, desc, total.alloc[i] / rounds);
+		}
+	}
+	(void)munmap(cost, sizeof(*cost));
+
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_stack
  *	stress by forcing stack overflows
@@ -69,6 +288,9 @@ int stress_stack(
 #endif
 	pid_t pid;
 
+	if (opt_stack_cost)
+		return stress_stack_cost(counter, max_ops, name);
+
 #if !defined(__minix__)
 	/*
 	 *  We need to create an alternative signal
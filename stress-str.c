@@ -28,7 +28,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
 #if defined(HAVE_LIB_BSD)
 #include <bsd/string.h>
 #define HAVE_STRLCPY
@@ -38,6 +40,12 @@
 #define HAVE_STRLCAT
 #endif
 
+#if defined(__GNUC__) && !defined(__clang__) &&			\
+    (defined(__x86_64__) || defined(__i386__)) && NEED_GNUC(4,9,0)
+#define STR_X86			(1)
+#include <immintrin.h>
+#endif
+
 /*
  *  the STR stress test has different classes of string stressors
  */
@@ -556,7 +564,7 @@ static void stress_str_all(
 	char *str2,
 	const size_t len2)
 {
-	static int i = 1;	/* Skip over stress_str_all */
+	static __thread int i = 1;	/* Skip over stress_str_all */
 
 	(void)libc_func;
 
@@ -622,6 +630,421 @@ int stress_set_str_method(const char *name)
 	return -1;
 }
 
+/*
+ *  Buffer scale search mode: long haystacks of random lower case
+ *  text ending in a 16 character needle, a newline and the
+ *  terminating NUL, so every search scans the whole haystack
+ */
+#define STR_SEARCH_TIME		(0.05)	/* seconds per function and size */
+#define STR_SEARCH_NEEDLE_LEN	(16)
+#define STR_SEARCH_SLACK	(64)	/* SIMD loads may read past the NUL */
+
+typedef enum {
+	STR_SEARCH_MEMCHR,
+	STR_SEARCH_STRLEN,
+	STR_SEARCH_MEMMEM,
+	STR_SEARCH_STRSTR,
+} str_search_op_t;
+
+typedef struct {
+	const char *name;		/* function and variant */
+	const str_search_op_t op;	/* what is being searched for */
+	bool (*supported)(void);	/* true if the CPU can use it */
+	size_t (*func)(const char *hay, const size_t len, const char *needle);
+} str_search_method_t;
+
+static const size_t str_search_sizes[] = {
+	4 * KB, 16 * KB, 64 * KB, 256 * KB, 1 * MB, 4 * MB, 16 * MB
+};
+
+#define STR_SEARCH_SIZES	(SIZEOF_ARRAY(str_search_sizes))
+
+static bool opt_str_search = false;
+static uint64_t opt_str_search_size = 0;
+
+void stress_set_str_search(void)
+{
+	opt_str_search = true;
+}
+
+void stress_set_str_search_size(const char *optarg)
+{
+	opt_str_search_size = get_uint64_byte(optarg);
+	check_range("str-search-size", opt_str_search_size,
+		MIN_STR_SEARCH_SIZE, MAX_STR_SEARCH_SIZE);
+	opt_str_search = true;
+}
+
+static bool str_search_always_supported(void)
+{
+	return true;
+}
+
+/*
+ *  The search functions return the offset of what was found,
+ *  or the haystack length if it was not found
+ */
+static size_t str_search_memchr_libc(const char *hay, const size_t len, const char *needle)
+{
+	const char *p = memchr(hay, '\n', len);
+
+	(void)needle;
+	return p ? (size_t)(p - hay) : len;
+}
+
+static size_t str_search_strlen_libc(const char *hay, const size_t len, const char *needle)
+{
+	(void)len;
+	(void)needle;
+	return strlen(hay);
+}
+
+static size_t str_search_memmem_libc(const char *hay, const size_t len, const char *needle)
+{
+	const char *p = memmem(hay, len, needle, STR_SEARCH_NEEDLE_LEN);
+
+	return p ? (size_t)(p - hay) : len;
+}
+
+static size_t str_search_strstr_libc(const char *hay, const size_t len, const char *needle)
+{
+	const char *p = strstr(hay, needle);
+
+	return p ? (size_t)(p - hay) : len;
+}
+
+#if defined(STR_X86)
+static bool str_search_sse42_supported(void)
+{
+	return __builtin_cpu_supports("sse4.2");
+}
+
+static bool str_search_avx2_supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+/*
+ *  str_search_memchr_avx2()
+ *	compare 32 bytes at a time against the newline
+ */
+static size_t __attribute__((target("avx2"))) str_search_memchr_avx2(
+	const char *hay,
+	const size_t len,
+	const char *needle)
+{
+	const __m256i nl = _mm256_set1_epi8('\n');
+	size_t i;
+
+	(void)needle;
+	for (i = 0; i + 32 <= len; i += 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(hay + i));
+		const uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+
+		if (mask)
+			return i + (size_t)__builtin_ctz(mask);
+	}
+	for (; i < len; i++)
+		if (hay[i] == '\n')
+			return i;
+	return len;
+}
+
+/*
+ *  str_search_strlen_sse42()
+ *	find the NUL 16 bytes at a time with pcmpistri, loads
+ *	are aligned so they never cross into an unmapped page
+ */
+static size_t __attribute__((target("sse4.2"))) str_search_strlen_sse42(
+	const char *hay,
+	const size_t len,
+	const char *needle)
+{
+	const char *p = hay;
+	const __m128i zero = _mm_setzero_si128();
+
+	(void)len;
+	(void)needle;
+	for (; (uintptr_t)p & 15; p++)
+		if (!*p)
+			return (size_t)(p - hay);
+	for (;; p += 16) {
+		const __m128i v = _mm_load_si128((const __m128i *)p);
+
+		/* ZF is set when the block holds the NUL */
+		if (_mm_cmpistrz(zero, v, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH))
+			return (size_t)(p - hay) + (size_t)_mm_cmpistri(v, v,
+				_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH |
+				_SIDD_MASKED_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT);
+	}
+}
+
+/*
+ *  str_search_strlen_avx2()
+ *	find the NUL 32 bytes at a time with aligned loads
+ */
+static size_t __attribute__((target("avx2"))) str_search_strlen_avx2(
+	const char *hay,
+	const size_t len,
+	const char *needle)
+{
+	const char *p = hay;
+	const __m256i zero = _mm256_setzero_si256();
+
+	(void)len;
+	(void)needle;
+	for (; (uintptr_t)p & 31; p++)
+		if (!*p)
+			return (size_t)(p - hay);
+	for (;; p += 32) {
+		const __m256i v = _mm256_load_si256((const __m256i *)p);
+		const uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+
+		if (mask)
+			return (size_t)(p - hay) + (size_t)__builtin_ctz(mask);
+	}
+}
+
+/*
+ *  str_search_memmem_avx2()
+ *	filter 32 candidate positions at a time on the first and
+ *	last needle characters, then compare the middle of the few
+ *	candidates that pass
+ */
+static size_t __attribute__((target("avx2"))) str_search_memmem_avx2(
+	const char *hay,
+	const size_t len,
+	const char *needle)
+{
+	const size_t n = STR_SEARCH_NEEDLE_LEN;
+	const __m256i first = _mm256_set1_epi8(needle[0]);
+	const __m256i last = _mm256_set1_epi8(needle[n - 1]);
+	size_t i;
+
+	for (i = 0; i + n - 1 + 32 <= len; i += 32) {
+		const __m256i bf = _mm256_loadu_si256((const __m256i *)(hay + i));
+		const __m256i bl = _mm256_loadu_si256((const __m256i *)(hay + i + n - 1));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(bf, first), _mm256_cmpeq_epi8(bl, last)));
+
+		while (mask) {
+			const size_t pos = i + (size_t)__builtin_ctz(mask);
+
+			if (!memcmp(hay + pos + 1, needle + 1, n - 2))
+				return pos;
+			mask &= mask - 1;
+		}
+	}
+	if (i < len) {
+		const char *p = memmem(hay + i, len - i, needle, n);
+
+		if (p)
+			return (size_t)(p - hay);
+	}
+	return len;
+}
+
+/*
+ *  str_search_strstr_sse42()
+ *	pcmpistri equal ordered finds the first full or partial
+ *	match of the needle in each 16 byte block
+ */
+static size_t __attribute__((target("sse4.2"))) str_search_strstr_sse42(
+	const char *hay,
+	const size_t len,
+	const char *needle)
+{
+	const int mode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ORDERED |
+			 _SIDD_LEAST_SIGNIFICANT;
+	const __m128i n = _mm_loadu_si128((const __m128i *)needle);
+	const char *p = hay;
+
+	(void)len;
+	for (;;) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)p);
+		const int idx = _mm_cmpistri(n, v, mode);
+
+		if (idx < 16) {
+			if (!strncmp(p + idx, needle, STR_SEARCH_NEEDLE_LEN))
+				return (size_t)(p - hay) + (size_t)idx;
+			p += idx + 1;
+		} else {
+			if (_mm_cmpistrz(n, v, mode))
+				return len;
+			p += 16;
+		}
+	}
+}
+#endif
+
+static const str_search_method_t str_search_methods[] = {
+	{ "memchr",		STR_SEARCH_MEMCHR,	str_search_always_supported,	str_search_memchr_libc },
+#if defined(STR_X86)
+	{ "memchr-avx2",	STR_SEARCH_MEMCHR,	str_search_avx2_supported,	str_search_memchr_avx2 },
+#endif
+	{ "strlen",		STR_SEARCH_STRLEN,	str_search_always_supported,	str_search_strlen_libc },
+#if defined(STR_X86)
+	{ "strlen-sse42",	STR_SEARCH_STRLEN,	str_search_sse42_supported,	str_search_strlen_sse42 },
+	{ "strlen-avx2",	STR_SEARCH_STRLEN,	str_search_avx2_supported,	str_search_strlen_avx2 },
+#endif
+	{ "memmem",		STR_SEARCH_MEMMEM,	str_search_always_supported,	str_search_memmem_libc },
+#if defined(STR_X86)
+	{ "memmem-avx2",	STR_SEARCH_MEMMEM,	str_search_avx2_supported,	str_search_memmem_avx2 },
+#endif
+	{ "strstr",		STR_SEARCH_STRSTR,	str_search_always_supported,	str_search_strstr_libc },
+#if defined(STR_X86)
+	{ "strstr-sse42",	STR_SEARCH_STRSTR,	str_search_sse42_supported,	str_search_strstr_sse42 },
+#endif
+};
+
+#define STR_SEARCH_METHODS	(SIZEOF_ARRAY(str_search_methods))
+
+/*
+ *  str_search_layout()
+ *	end a haystack of len bytes with the needle, a newline
+ *	and the NUL, returns the expected offset of each search
+ */
+static void str_search_layout(
+	char *buf,
+	const size_t len,
+	const char *needle,
+	size_t expected[])
+{
+	const size_t nl = len - 2;
+	const size_t pos = nl - STR_SEARCH_NEEDLE_LEN;
+
+	(void)memcpy(buf + pos, needle, STR_SEARCH_NEEDLE_LEN);
+	buf[nl] = '\n';
+	buf[len - 1] = '\0';
+
+	expected[STR_SEARCH_MEMCHR] = nl;
+	expected[STR_SEARCH_STRLEN] = len - 1;
+	expected[STR_SEARCH_MEMMEM] = pos;
+	expected[STR_SEARCH_STRSTR] = pos;
+}
+
+/*
+ *  stress_str_search()
+ *	benchmark memchr, strlen, memmem and strstr, libc and hand
+ *	written SIMD variants, on haystacks of 4K to 16M
+ */
+static int stress_str_search(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t buf_size = MAX_STR_SEARCH_SIZE + STR_SEARCH_SLACK;
+	size_t sizes[STR_SEARCH_SIZES], n_sizes = 0;
+	double bytes[STR_SEARCH_METHODS][STR_SEARCH_SIZES];
+	double duration[STR_SEARCH_METHODS][STR_SEARCH_SIZES];
+	char needle[STR_SEARCH_NEEDLE_LEN + 1];
+	char *buf;
+	size_t i, j, idx = 0;
+	int rc = EXIT_SUCCESS;
+
+	buf = mmap(NULL, buf_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		pr_inf(stderr, "%s: cannot allocate %zuMB haystack, "
+			"skipping stressor\n", name, (size_t)(buf_size / MB));
+		return EXIT_NO_RESOURCE;
+	}
+	if (opt_str_search_size) {
+		sizes[n_sizes++] = (size_t)opt_str_search_size;
+	} else {
+		for (j = 0; j < STR_SEARCH_SIZES; j++)
+			sizes[n_sizes++] = str_search_sizes[j];
+	}
+	(void)memset(bytes, 0, sizeof(bytes));
+	(void)memset(duration, 0, sizeof(duration));
+	stress_strnrnd(needle, sizeof(needle));
+
+	do {
+		for (j = 0; opt_do_run && (j < n_sizes); j++) {
+			const size_t len = sizes[j];
+			size_t expected[STR_SEARCH_STRSTR + 1];
+
+			stress_strnrnd(buf, len);
+			str_search_layout(buf, len, needle, expected);
+
+			for (i = 0; opt_do_run && (i < STR_SEARCH_METHODS); i++) {
+				const str_search_method_t *m = &str_search_methods[i];
+				const double t_start = time_now();
+				const double t_end = t_start + STR_SEARCH_TIME;
+				uint64_t n = 0;
+				size_t found;
+				double t;
+
+				if (!m->supported())
+					continue;
+				do {
+					found = m->func(buf, len, needle);
+					n++;
+					t = time_now();
+				} while (opt_do_run && (t < t_end));
+
+				if ((opt_flags & OPT_FLAGS_VERIFY) &&
+				    (found != expected[m->op])) {
+					pr_fail(stderr, "%s: %s found offset %zu "
+						"of a %zu byte haystack, expected %zu\n",
+						name, m->name, found, len,
+						expected[m->op]);
+					rc = EXIT_FAILURE;
+				}
+				bytes[i][j] += (double)n * (double)len;
+				duration[i][j] += t - t_start;
+				(*counter)++;
+				if (max_ops && (*counter >= max_ops))
+					goto done;
+			}
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	if (instance == 0) {
+		char line[256];
+		int n;
+
+		n = snprintf(line, sizeof(line), "%-13s", "GB/s");
+		for (j = 0; j < n_sizes; j++) {
+			if (sizes[j] < MB)
+				n += snprintf(line + n, sizeof(line) - n, " %7zuK",
+					(size_t)(sizes[j] / KB));
+			else
+				n += snprintf(line + n, sizeof(line) - n, " %7zuM",
+					(size_t)(sizes[j] / MB));
+		}
+		pr_inf(stderr, "%s: %s\n", name, line);
+		for (i = 0; i < STR_SEARCH_METHODS; i++) {
+			if (duration[i][0] <= 0.0)
+				continue;
+			n = snprintf(line, sizeof(line), "%-13s",
+				str_search_methods[i].name);
+			for (j = 0; j < n_sizes; j++)
+				n += snprintf(line + n, sizeof(line) - n, " %8.2f",
+					(duration[i][j] > 0.0) ?
+					bytes[i][j] / (duration[i][j] * GB) : 0.0);
+			pr_inf(stderr, "%s: %s\n", name, line);
+		}
+	}
+
+	/* Throughput of each function on the largest haystack */
+	j = n_sizes - 1;
+	for (i = 0; i < STR_SEARCH_METHODS; i++) {
+		char desc[40];
+
+		if (duration[i][j] <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s GB/s",
+			str_search_methods[i].name);
+		stress_misc_metric_set(idx++, desc,
+			bytes[i][j] / (duration[i][j] * GB));
+	}
+	(void)munmap(buf, buf_size);
+
+	return rc;
+}
+
 /*
  *  stress_str()
  *	stress CPU by doing various string operations
@@ -635,7 +1058,8 @@ int stress_str(
 	stress_str_func func = opt_str_stressor->func;
 	const void *libc_func = opt_str_stressor->libc_func;
 
-	(void)instance;
+	if (opt_str_search)
+		return stress_str_search(counter, instance, max_ops, name);
 
 	do {
 		char str1[256], str2[128];
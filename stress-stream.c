@@ -38,12 +38,111 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <sched.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 
 #include "stress-ng.h"
 
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+
+#if defined(STRESS_NUMA_BIND)
+#define STREAM_NUMA		(1)
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__) && 		\
+    (defined(__x86_64__) || defined(__i386__)) && NEED_GNUC(4,9,0)
+#define STREAM_X86_SIMD		(1)
+#include <immintrin.h>
+#if NEED_GNUC(5,0,0)
+#define STREAM_X86_AVX512	(1)
+#endif
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+#define STREAM_NEON_SIMD	(1)
+#include <arm_neon.h>
+#endif
+
+#define STREAM_BW_QUANTUM	(32768)	/* elements per paced kernel step */
+
+/* the STREAM_KERNELS STREAM kernels */
+enum {
+	STREAM_COPY = 0,
+	STREAM_SCALE,
+	STREAM_ADD,
+	STREAM_TRIAD,
+};
+
+static const char *stream_kernel_names[STREAM_KERNELS] = {
+	"copy", "scale", "add", "triad"
+};
+
+/* arrays touched per element by each kernel, as in STREAM */
+static const uint64_t stream_kernel_arrays[STREAM_KERNELS] = {
+	2, 2, 3, 3
+};
+
+/* a set of kernels for one instruction set */
+typedef struct {
+	const char *name;		/* --stream-isa name */
+	bool (*supported)(void);	/* true if the CPU can run them */
+	void (*copy)(double *RESTRICT c, const double *RESTRICT a,
+		const uint64_t n);
+	void (*scale)(double *RESTRICT b, const double *RESTRICT c,
+		const double q, const uint64_t n);
+	void (*add)(const double *RESTRICT a, const double *RESTRICT b,
+		double *RESTRICT c, const uint64_t n);
+	void (*triad)(double *RESTRICT a, const double *RESTRICT b,
+		const double *RESTRICT c, const double q, const uint64_t n);
+} stream_isa_t;
+
+/* per instance state shared by the threads of an instance */
+typedef struct {
+	const stream_isa_t *isa;	/* kernels to run */
+	double *a, *b, *c;		/* the STREAM arrays */
+	uint64_t n;			/* elements per array */
+	uint32_t threads;		/* threads running the kernels */
+	bool run;			/* false to stop the threads */
+	int node;			/* NUMA node, -1 = not bound */
+#if defined(__linux__)
+	cpu_set_t node_cpus;		/* CPUs of the NUMA node */
+	uint32_t node_ncpus;		/* number of CPUs in node_cpus */
+#endif
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_barrier_t barrier;	/* kernel step synchronisation */
+	pthread_mutex_t mutex;		/* start up gate lock */
+	pthread_cond_t cond;		/* start up gate */
+	bool go;			/* start up gate open */
+#endif
+} stream_ctx_t;
+
+#if defined(HAVE_LIB_PTHREAD)
+typedef struct {
+	stream_ctx_t *ctx;
+	uint32_t id;			/* thread number, 0 is the instance */
+	bw_pace_t pace;			/* --stream-bw pacing of this thread */
+} stream_thread_t;
+#endif
+
+static uint64_t opt_stream_bw = 0;			/* 0 = unpaced */
 static uint64_t opt_stream_L3_size = DEFAULT_STREAM_L3_SIZE;
 static bool     set_stream_L3_size = false;
+static uint32_t opt_stream_threads = DEFAULT_STREAM_THREADS;
+static bool     opt_stream_numa = false;
+static const stream_isa_t *opt_stream_isa = NULL;	/* NULL = auto */
+
+void stress_set_stream_bw(const char *optarg)
+{
+	opt_stream_bw = get_uint64_byte(optarg);
+	check_range("stream-bw", opt_stream_bw,
+		MIN_BW_RATE, MAX_BW_RATE);
+}
 
 void stress_set_stream_L3_size(const char *optarg)
 {
@@ -53,6 +152,21 @@ void stress_set_stream_L3_size(const char *optarg)
 		MIN_STREAM_L3_SIZE, MAX_STREAM_L3_SIZE);
 }
 
+void stress_set_stream_threads(const char *optarg)
+{
+	uint64_t threads;
+
+	threads = get_uint64(optarg);
+	check_range("stream-threads", threads,
+		MIN_STREAM_THREADS, MAX_STREAM_THREADS);
+	opt_stream_threads = (uint32_t)threads;
+}
+
+void stress_set_stream_numa(void)
+{
+	opt_stream_numa = true;
+}
+
 static inline void OPTIMIZE3 stress_stream_copy(
 	double *RESTRICT c,
 	const double *RESTRICT a,
@@ -101,6 +215,222 @@ static inline void OPTIMIZE3 stress_stream_triad(
 		a[i] = b[i] + (c[i] * q);
 }
 
+static bool stream_scalar_supported(void)
+{
+	return true;
+}
+
+/*
+ *  STREAM_SIMD_KERNELS()
+ *	generate the 4 kernels for a SIMD instruction set of
+ *	width doubles per vector; scalar loops handle the
+ *	elements before the first vector aligned store and
+ *	after the last whole vector. All the arrays have
+ *	the same alignment, so aligning the store aligns
+ *	the loads too.
+ */
+#define STREAM_SIMD_KERNELS(isa, attr, vec_t, width, load, store, set1, add, mul, fence) \
+static void attr stress_stream_copy_ ## isa(				\
+	double *RESTRICT c,						\
+	const double *RESTRICT a,					\
+	const uint64_t n)						\
+{									\
+	uint64_t i;							\
+									\
+	for (i = 0; (i < n) && ((uintptr_t)&c[i] & ((width * sizeof(double)) - 1)); i++) \
+		c[i] = a[i];						\
+	for (; i + width <= n; i += width)				\
+		store(&c[i], load(&a[i]));				\
+	for (; i < n; i++)						\
+		c[i] = a[i];						\
+	fence;								\
+}									\
+									\
+static void attr stress_stream_scale_ ## isa(				\
+	double *RESTRICT b,						\
+	const double *RESTRICT c,					\
+	const double q,							\
+	const uint64_t n)						\
+{									\
+	const vec_t vq = set1(q);					\
+	uint64_t i;							\
+									\
+	for (i = 0; (i < n) && ((uintptr_t)&b[i] & ((width * sizeof(double)) - 1)); i++) \
+		b[i] = q * c[i];					\
+	for (; i + width <= n; i += width)				\
+		store(&b[i], mul(vq, load(&c[i])));			\
+	for (; i < n; i++)						\
+		b[i] = q * c[i];					\
+	fence;								\
+}									\
+									\
+static void attr stress_stream_add_ ## isa(				\
+	const double *RESTRICT a,					\
+	const double *RESTRICT b,					\
+	double *RESTRICT c,						\
+	const uint64_t n)						\
+{									\
+	uint64_t i;							\
+									\
+	for (i = 0; (i < n) && ((uintptr_t)&c[i] & ((width * sizeof(double)) - 1)); i++) \
+		c[i] = a[i] + b[i];					\
+	for (; i + width <= n; i += width)				\
+		store(&c[i], add(load(&a[i]), load(&b[i])));		\
+	for (; i < n; i++)						\
+		c[i] = a[i] + b[i];					\
+	fence;								\
+}									\
+									\
+static void attr stress_stream_triad_ ## isa(				\
+	double *RESTRICT a,						\
+	const double *RESTRICT b,					\
+	const double *RESTRICT c,					\
+	const double q,							\
+	const uint64_t n)						\
+{									\
+	const vec_t vq = set1(q);					\
+	uint64_t i;							\
+									\
+	for (i = 0; (i < n) && ((uintptr_t)&a[i] & ((width * sizeof(double)) - 1)); i++) \
+		a[i] = b[i] + (c[i] * q);				\
+	for (; i + width <= n; i += width)				\
+		store(&a[i], add(load(&b[i]), mul(load(&c[i]), vq)));	\
+	for (; i < n; i++)						\
+		a[i] = b[i] + (c[i] * q);				\
+	fence;								\
+}
+
+#define STREAM_NO_FENCE		do { } while (0)
+
+#if defined(STREAM_X86_SIMD)
+#define STREAM_SSE2		__attribute__((target("sse2")))
+#define STREAM_AVX2		__attribute__((target("avx2")))
+
+static bool stream_sse2_supported(void)
+{
+	return __builtin_cpu_supports("sse2");
+}
+
+static bool stream_avx2_supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+STREAM_SIMD_KERNELS(sse2, STREAM_SSE2, __m128d, 2, _mm_load_pd, _mm_store_pd,
+	_mm_set1_pd, _mm_add_pd, _mm_mul_pd, STREAM_NO_FENCE)
+STREAM_SIMD_KERNELS(sse2_nt, STREAM_SSE2, __m128d, 2, _mm_load_pd, _mm_stream_pd,
+	_mm_set1_pd, _mm_add_pd, _mm_mul_pd, _mm_sfence())
+STREAM_SIMD_KERNELS(avx2, STREAM_AVX2, __m256d, 4, _mm256_load_pd, _mm256_store_pd,
+	_mm256_set1_pd, _mm256_add_pd, _mm256_mul_pd, STREAM_NO_FENCE)
+STREAM_SIMD_KERNELS(avx2_nt, STREAM_AVX2, __m256d, 4, _mm256_load_pd, _mm256_stream_pd,
+	_mm256_set1_pd, _mm256_add_pd, _mm256_mul_pd, _mm_sfence())
+
+#if defined(STREAM_X86_AVX512)
+#define STREAM_AVX512		__attribute__((target("avx512f")))
+
+static bool stream_avx512_supported(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+STREAM_SIMD_KERNELS(avx512, STREAM_AVX512, __m512d, 8, _mm512_load_pd, _mm512_store_pd,
+	_mm512_set1_pd, _mm512_add_pd, _mm512_mul_pd, STREAM_NO_FENCE)
+STREAM_SIMD_KERNELS(avx512_nt, STREAM_AVX512, __m512d, 8, _mm512_load_pd, _mm512_stream_pd,
+	_mm512_set1_pd, _mm512_add_pd, _mm512_mul_pd, _mm_sfence())
+#endif
+#endif
+
+#if defined(STREAM_NEON_SIMD)
+static bool stream_neon_supported(void)
+{
+	return true;
+}
+
+STREAM_SIMD_KERNELS(neon, , float64x2_t, 2, vld1q_f64, vst1q_f64,
+	vdupq_n_f64, vaddq_f64, vmulq_f64, STREAM_NO_FENCE)
+#endif
+
+#define STREAM_ISA(name, isa, supported)				\
+	{ name, supported, stress_stream_copy_ ## isa,			\
+	  stress_stream_scale_ ## isa, stress_stream_add_ ## isa,	\
+	  stress_stream_triad_ ## isa }
+
+/*
+ *  Kernels in order of preference for --stream-isa auto,
+ *  the non-temporal store variants are never chosen
+ *  automatically
+ */
+static const stream_isa_t stream_isas[] = {
+#if defined(STREAM_X86_AVX512)
+	STREAM_ISA("avx512",	avx512,		stream_avx512_supported),
+#endif
+#if defined(STREAM_X86_SIMD)
+	STREAM_ISA("avx2",	avx2,		stream_avx2_supported),
+	STREAM_ISA("sse2",	sse2,		stream_sse2_supported),
+#endif
+#if defined(STREAM_NEON_SIMD)
+	STREAM_ISA("neon",	neon,		stream_neon_supported),
+#endif
+	{ "scalar", stream_scalar_supported, stress_stream_copy,
+	  stress_stream_scale, stress_stream_add, stress_stream_triad },
+#if defined(STREAM_X86_AVX512)
+	STREAM_ISA("avx512-nt",	avx512_nt,	stream_avx512_supported),
+#endif
+#if defined(STREAM_X86_SIMD)
+	STREAM_ISA("avx2-nt",	avx2_nt,	stream_avx2_supported),
+	STREAM_ISA("sse2-nt",	sse2_nt,	stream_sse2_supported),
+#endif
+	{ NULL, NULL, NULL, NULL, NULL, NULL }
+};
+
+/*
+ *  stress_set_stream_isa()
+ *	set the instruction set of the stream kernels
+ */
+int stress_set_stream_isa(const char *name)
+{
+	const stream_isa_t *isa;
+
+	if (!strcmp(name, "auto")) {
+		opt_stream_isa = NULL;
+		return 0;
+	}
+	for (isa = stream_isas; isa->name; isa++) {
+		if (!strcmp(isa->name, name)) {
+			opt_stream_isa = isa;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "stream-isa must be one of: auto");
+	for (isa = stream_isas; isa->name; isa++)
+		fprintf(stderr, " %s", isa->name);
+	fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  stream_isa()
+ *	get the kernels to use, falling back to the best
+ *	supported set if the CPU can't run the chosen set
+ */
+static const stream_isa_t *stream_isa(const char *name, const uint32_t instance)
+{
+	const stream_isa_t *isa;
+
+	if (opt_stream_isa && opt_stream_isa->supported())
+		return opt_stream_isa;
+
+	for (isa = stream_isas; isa->name; isa++)
+		if (isa->supported())
+			break;
+	if (opt_stream_isa && !instance)
+		pr_inf(stderr, "%s: CPU does not support %s, using %s instead\n",
+			name, opt_stream_isa->name, isa->name);
+	return isa;
+}
+
 static void stress_stream_init_data(
 	double *RESTRICT data,
 	const uint64_t n)
@@ -111,15 +441,23 @@ static void stress_stream_init_data(
 		data[i] = (double)mwc32() / (double)mwc64();
 }
 
-static inline void *stress_stream_mmap(const char *name, uint64_t sz)
+static inline void *stress_stream_mmap(
+	const char *name,
+	const uint64_t sz,
+	const stream_ctx_t *ctx)
 {
 	void *ptr;
+	int flags = MAP_SHARED | MAP_ANONYMOUS;
 
-	ptr = mmap(NULL, (size_t)sz, PROT_READ | PROT_WRITE,
 #if defined(MAP_POPULATE)
-		MAP_POPULATE |
+	/* NUMA bound pages must not be faulted in before mbind */
+	if (ctx->node < 0)
+		flags |= MAP_POPULATE;
+#else
+	(void)ctx;
 #endif
-		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ptr = mmap_hugepages(stress_get_hugepages(), (size_t)sz,
+		PROT_READ | PROT_WRITE, flags, -1);
 	/* Coverity Scan believes NULL can be returned, doh */
 	if (!ptr || (ptr == MAP_FAILED)) {
 		pr_err(stderr, "%s: cannot allocate %" PRIu64 " bytes\n",
@@ -177,6 +515,221 @@ static inline uint64_t stream_L3_size(
 	return cache_size;
 }
 
+#if defined(STREAM_NUMA)
+/*
+ *  stream_numa_node()
+ *	pick the NUMA node of an instance, instances are spread
+ *	round robin over the nodes, returns -1 if there are no nodes
+ */
+static int stream_numa_node(const uint32_t instance)
+{
+	int nodes[STREAM_NODES_MAX];
+	const int n = numa_node_list(nodes, STREAM_NODES_MAX);
+
+	return n ? nodes[instance % n] : -1;
+}
+
+/*
+ *  stream_numa_bind()
+ *	bind the pages of an array to the NUMA node of the instance
+ */
+static void stream_numa_bind(
+	const char *name,
+	const stream_ctx_t *ctx,
+	void *addr,
+	const uint64_t sz)
+{
+	const int ret = numa_bind(addr, (size_t)sz, ctx->node);
+
+	if (ret < 0)
+		pr_dbg(stderr, "%s: mbind to node %d failed: errno=%d (%s)\n",
+			name, ctx->node, -ret, strerror(-ret));
+}
+
+/*
+ *  stream_numa_pin()
+ *	pin the calling thread to one of the CPUs of the NUMA node,
+ *	threads are spread round robin over the CPUs of the node
+ */
+static void stream_numa_pin(const stream_ctx_t *ctx, const uint32_t id)
+{
+	cpu_set_t set;
+	uint32_t i, cpu;
+
+	if ((ctx->node < 0) || !ctx->node_ncpus)
+		return;
+
+	for (i = 0, cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &ctx->node_cpus))
+			continue;
+		if (i++ == (id % ctx->node_ncpus))
+			break;
+	}
+	if (cpu >= CPU_SETSIZE)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	(void)sched_setaffinity(0, sizeof(set), &set);
+}
+#endif
+
+/*
+ *  stream_barrier()
+ *	wait for all the threads of an instance to reach this point
+ */
+static inline void stream_barrier(stream_ctx_t *ctx)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	if (ctx->threads > 1)
+		(void)pthread_barrier_wait(&ctx->barrier);
+#else
+	(void)ctx;
+#endif
+}
+
+/*
+ *  stream_kernel()
+ *	run kernel k over n elements of the arrays
+ */
+static inline void stream_kernel(
+	const stream_ctx_t *ctx,
+	const uint32_t k,
+	double *a,
+	double *b,
+	double *c,
+	const uint64_t n)
+{
+	const double q = 3.0;
+
+	switch (k) {
+	case STREAM_COPY:
+		ctx->isa->copy(c, a, n);
+		break;
+	case STREAM_SCALE:
+		ctx->isa->scale(b, c, q, n);
+		break;
+	case STREAM_ADD:
+		ctx->isa->add(c, b, a, n);
+		break;
+	case STREAM_TRIAD:
+		ctx->isa->triad(a, b, c, q, n);
+		break;
+	}
+}
+
+/*
+ *  stream_kernels()
+ *	run the 4 kernels over the slice of the arrays of
+ *	a thread; when t is non-NULL the time each kernel
+ *	took over all the threads is added to it. When
+ *	pacing, each kernel is run in quanta of the slice
+ *	so the thread never gets far ahead of its rate
+ */
+static void stream_kernels(
+	stream_ctx_t *ctx,
+	const uint32_t id,
+	bw_pace_t *pace,
+	double t[STREAM_KERNELS])
+{
+	const uint64_t lo = (ctx->n * id) / ctx->threads;
+	const uint64_t len = ((ctx->n * (id + 1)) / ctx->threads) - lo;
+	const uint64_t quantum = (pace->rate > 0.0) ? STREAM_BW_QUANTUM : len;
+	double *a = ctx->a + lo, *b = ctx->b + lo, *c = ctx->c + lo;
+	double t1, t2;
+	uint32_t k;
+
+	t1 = t ? time_now() : 0.0;
+	for (k = 0; k < STREAM_KERNELS; k++) {
+		uint64_t i;
+
+		for (i = 0; i < len; i += quantum) {
+			const uint64_t n = (len - i < quantum) ? len - i : quantum;
+
+			stream_kernel(ctx, k, a + i, b + i, c + i, n);
+			bw_pace(pace, n * sizeof(double) * stream_kernel_arrays[k]);
+		}
+		stream_barrier(ctx);
+		if (t) {
+			t2 = time_now();
+			t[k] += t2 - t1;
+			t1 = t2;
+		}
+	}
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  stream_thread()
+ *	helper thread, runs its slice of the kernels in lock
+ *	step with thread 0 until told to stop
+ */
+static void *stream_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stream_thread_t *thread = (stream_thread_t *)arg;
+	stream_ctx_t *ctx = thread->ctx;
+	sigset_t set;
+
+	/* Leave all signal handling to the instance thread */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+#if defined(STREAM_NUMA)
+	stream_numa_pin(ctx, thread->id);
+#endif
+
+	pthread_mutex_lock(&ctx->mutex);
+	while (!ctx->go)
+		pthread_cond_wait(&ctx->cond, &ctx->mutex);
+	pthread_mutex_unlock(&ctx->mutex);
+
+	bw_pace_init(&thread->pace, (double)opt_stream_bw / ctx->threads);
+	for (;;) {
+		/* Start of round, thread 0 decides if we stop */
+		stream_barrier(ctx);
+		if (!ctx->run)
+			break;
+		stream_kernels(ctx, thread->id, &thread->pace, NULL);
+	}
+	return &nowt;
+}
+#endif
+
+/*
+ *  stream_totals_dump()
+ *	the last instance to finish reports the bandwidth
+ *	aggregated over all the instances and NUMA nodes
+ */
+static void stream_totals_dump(const char *name)
+{
+	size_t i, k;
+	char buf[256];
+
+	for (*buf = '\0', k = 0; k < STREAM_KERNELS; k++) {
+		const size_t len = strlen(buf);
+
+		(void)snprintf(buf + len, sizeof(buf) - len, "%s%s %.2f",
+			k ? ", " : "", stream_kernel_names[k],
+			(double)shared->stream.rate[k] / 1024.0);
+	}
+	pr_inf(stderr, "%s: total: %s MB/sec\n", name, buf);
+
+	if (!opt_stream_numa)
+		return;
+	for (i = 0; i < STREAM_NODES_MAX; i++) {
+		if (!shared->stream.node_instances[i])
+			continue;
+		for (*buf = '\0', k = 0; k < STREAM_KERNELS; k++) {
+			const size_t len = strlen(buf);
+
+			(void)snprintf(buf + len, sizeof(buf) - len, "%s%s %.2f",
+				k ? ", " : "", stream_kernel_names[k],
+				(double)shared->stream.node_rate[i][k] / 1024.0);
+		}
+		pr_inf(stderr, "%s: node %zu: %s MB/sec (%" PRIu32 " instances)\n",
+			name, i, buf, shared->stream.node_instances[i]);
+	}
+}
+
 /*
  *  stress_stream()
  *	stress cache/memory/CPU with stream stressors
@@ -188,11 +741,47 @@ int stress_stream(
 	const char *name)
 {
 	int rc = EXIT_FAILURE;
-	double *a, *b, *c;
-	const double q = 3.0;
+	stream_ctx_t ctx;
 	double mb_rate, mb, fp_rate, fp, t1, t2, dt;
-	uint64_t L3, sz, n;
+	double t[STREAM_KERNELS];
+	bw_pace_t pace;
+	uint64_t L3, sz, map_sz, n;
+	uint32_t k;
 	bool guess = false;
+#if defined(HAVE_LIB_PTHREAD)
+	pthread_t *pthreads = NULL;
+	stream_thread_t *args = NULL;
+	uint32_t started = 0;
+#endif
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.isa = stream_isa(name, instance);
+	ctx.node = -1;
+	ctx.run = true;
+	ctx.threads = opt_stream_threads;
+#if !defined(HAVE_LIB_PTHREAD)
+	if (ctx.threads > 1) {
+		if (!instance)
+			pr_inf(stderr, "%s: no pthread support, using 1 thread "
+				"per instance\n", name);
+		ctx.threads = 1;
+	}
+#endif
+	if (opt_stream_numa) {
+#if defined(STREAM_NUMA)
+		ctx.node = stream_numa_node(instance);
+		if (ctx.node >= 0)
+			ctx.node_ncpus = (uint32_t)numa_node_cpus(ctx.node,
+				NULL, &ctx.node_cpus);
+		else if (!instance)
+			pr_inf(stderr, "%s: no NUMA nodes found, memory will "
+				"not be bound to a node\n", name);
+#else
+		if (!instance)
+			pr_inf(stderr, "%s: NUMA binding is not supported, "
+				"ignoring --stream-numa\n", name);
+#endif
+	}
 
 	L3 = (set_stream_L3_size) ? opt_stream_L3_size : stream_L3_size(name, instance);
 
@@ -215,6 +804,10 @@ int stress_stream(
 			pr_inf(stderr, "%s: Using CPU cache size of %" PRIu64 "K\n",
 				name, L3 / 1024);
 		}
+		pr_inf(stderr, "%s: using %s kernels\n", name, ctx.isa->name);
+		if (opt_stream_bw)
+			pr_inf(stderr, "%s: pacing each instance to %.2f MB/sec\n",
+				name, (double)opt_stream_bw / (double)MB);
 	}
 
 	/* ..and shared amongst all the STREAM stressor instances */
@@ -226,52 +819,162 @@ int stress_stream(
 	 */
 	sz = (L3 * 4);
 	n = sz / sizeof(double);
+	map_sz = hugepages_round(stress_get_hugepages(), sz);
 
-	a = stress_stream_mmap(name, sz);
-	if (a == MAP_FAILED)
+	ctx.a = stress_stream_mmap(name, map_sz, &ctx);
+	if (ctx.a == MAP_FAILED)
 		goto err_a;
-	b = stress_stream_mmap(name, sz);
-	if (b == MAP_FAILED)
+	ctx.b = stress_stream_mmap(name, map_sz, &ctx);
+	if (ctx.b == MAP_FAILED)
 		goto err_b;
-	c = stress_stream_mmap(name, sz);
-	if (c == MAP_FAILED)
+	ctx.c = stress_stream_mmap(name, map_sz, &ctx);
+	if (ctx.c == MAP_FAILED)
 		goto err_c;
+	ctx.n = n;
+
+#if defined(STREAM_NUMA)
+	if (ctx.node >= 0) {
+		stream_numa_bind(name, &ctx, ctx.a, map_sz);
+		stream_numa_bind(name, &ctx, ctx.b, map_sz);
+		stream_numa_bind(name, &ctx, ctx.c, map_sz);
+		stream_numa_pin(&ctx, 0);
+	}
+#endif
+	stress_stream_init_data(ctx.a, n);
+	stress_stream_init_data(ctx.b, n);
+	stress_stream_init_data(ctx.c, n);
+	if (stress_get_hugepages() != HUGEPAGES_NONE)
+		hugepages_metric_set(hugepages_mapped(ctx.a, map_sz) +
+			hugepages_mapped(ctx.b, map_sz) + hugepages_mapped(ctx.c, map_sz));
+
+#if defined(HAVE_LIB_PTHREAD)
+	if (ctx.threads > 1) {
+		uint32_t i;
+
+		pthreads = calloc(ctx.threads, sizeof(*pthreads));
+		args = calloc(ctx.threads, sizeof(*args));
+		if (!pthreads || !args) {
+			pr_inf(stderr, "%s: cannot allocate thread information, "
+				"using 1 thread\n", name);
+			ctx.threads = 1;
+		}
+		(void)pthread_mutex_init(&ctx.mutex, NULL);
+		(void)pthread_cond_init(&ctx.cond, NULL);
+		for (i = 1; i < ctx.threads; i++) {
+			args[i].ctx = &ctx;
+			args[i].id = i;
+			if (pthread_create(&pthreads[i], NULL, stream_thread, &args[i]))
+				break;
+			started++;
+		}
+		if (started + 1 < ctx.threads)
+			pr_inf(stderr, "%s: only %" PRIu32 " of %" PRIu32
+				" threads started (instance %" PRIu32 ")\n",
+				name, started + 1, ctx.threads, instance);
+		ctx.threads = started + 1;
+		if (ctx.threads > 1)
+			(void)pthread_barrier_init(&ctx.barrier, NULL, ctx.threads);
+
+		/* All the threads know how many there are, let them go */
+		pthread_mutex_lock(&ctx.mutex);
+		ctx.go = true;
+		pthread_cond_broadcast(&ctx.cond);
+		pthread_mutex_unlock(&ctx.mutex);
+	}
+#endif
 
-	stress_stream_init_data(a, n);
-	stress_stream_init_data(b, n);
-	stress_stream_init_data(c, n);
-
+	memset(t, 0, sizeof(t));
+	bw_pace_init(&pace, (double)opt_stream_bw / ctx.threads);
 	t1 = time_now();
 	do {
-		stress_stream_copy(c, a, n);
-		stress_stream_scale(b, c, q, n);
-		stress_stream_add(c, b, a, n);
-		stress_stream_triad(a, b, c, q, n);
+		/* Start of round, releases the helper threads */
+		stream_barrier(&ctx);
+		stream_kernels(&ctx, 0, &pace, t);
 		(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 	t2 = time_now();
 
+#if defined(HAVE_LIB_PTHREAD)
+	if (started) {
+		uint32_t i;
+
+		ctx.run = false;
+		stream_barrier(&ctx);
+		for (i = 1; i <= started; i++)
+			(void)pthread_join(pthreads[i], NULL);
+		(void)pthread_barrier_destroy(&ctx.barrier);
+	}
+	if (pthreads) {
+		(void)pthread_cond_destroy(&ctx.cond);
+		(void)pthread_mutex_destroy(&ctx.mutex);
+	}
+	free(args);
+	free(pthreads);
+#endif
+
+	/* Each round reads and writes 10 arrays' worth of doubles */
+	stress_units_per_op(10.0 * (double)sz);
 	mb = ((double)((*counter) * 10) * (double)sz) / (double)MB;
 	fp = ((double)((*counter) * 4) * (double)sz) / (double)MB;
 	dt = t2 - t1;
 	if (dt >= 4.5) {
+		char buf[256];
+
 		mb_rate = mb / (dt);
 		fp_rate = fp / (dt);
 		pr_inf(stderr, "%s: memory rate: %.2f MB/sec, %.2f Mflop/sec"
 			" (instance %" PRIu32 ")\n",
 			name, mb_rate, fp_rate, instance);
+		if (opt_stream_bw)
+			pr_inf(stderr, "%s: paced to %.2f MB/sec, achieved %.1f%%"
+				" of target (instance %" PRIu32 ")\n",
+				name, (double)opt_stream_bw / (double)MB,
+				100.0 * mb_rate * (double)MB / (double)opt_stream_bw,
+				instance);
+
+		for (*buf = '\0', k = 0; k < STREAM_KERNELS; k++) {
+			const size_t len = strlen(buf);
+			const double rate = (t[k] > 0.0) ?
+				((double)((*counter) * stream_kernel_arrays[k]) *
+				 (double)sz) / (double)MB / t[k] : 0.0;
+			const uint64_t kb_rate = (uint64_t)(rate * 1024.0);
+
+			(void)snprintf(buf + len, sizeof(buf) - len, "%s%s %.2f",
+				k ? ", " : "", stream_kernel_names[k], rate);
+			(void)__sync_fetch_and_add(&shared->stream.rate[k], kb_rate);
+			if ((ctx.node >= 0) && (ctx.node < STREAM_NODES_MAX))
+				(void)__sync_fetch_and_add(&shared->stream.node_rate[ctx.node][k], kb_rate);
+		}
+		if ((ctx.node >= 0) && (ctx.node < STREAM_NODES_MAX))
+			(void)__sync_fetch_and_add(&shared->stream.node_instances[ctx.node], 1);
+		if (ctx.node >= 0) {
+			pr_inf(stderr, "%s: %s MB/sec (instance %" PRIu32 ", %"
+				PRIu32 " threads, node %d)\n",
+				name, buf, instance, ctx.threads, ctx.node);
+		} else {
+			pr_inf(stderr, "%s: %s MB/sec (instance %" PRIu32 ", %"
+				PRIu32 " threads)\n",
+				name, buf, instance, ctx.threads);
+		}
 	} else {
 		if (instance == 0)
 			pr_inf(stderr, "%s: run too short to determine memory rate\n", name);
 	}
 
+	/* Last instance to finish reports the totals */
+	if ((__sync_add_and_fetch(&shared->stream.finished, 1) ==
+	     (uint32_t)stressor_instances(STRESS_STREAM)) &&
+	    ((stressor_instances(STRESS_STREAM) > 1) || opt_stream_numa) &&
+	    shared->stream.rate[STREAM_COPY])
+		stream_totals_dump(name);
+
 	rc = EXIT_SUCCESS;
 
-	(void)munmap((void *)c, sz);
+	(void)munmap((void *)ctx.c, map_sz);
 err_c:
-	(void)munmap((void *)b, sz);
+	(void)munmap((void *)ctx.b, map_sz);
 err_b:
-	(void)munmap((void *)a, sz);
+	(void)munmap((void *)ctx.a, map_sz);
 err_a:
 
 	return rc;
@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_SWAP)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/sysinfo.h>
+
+#define ZSWAP_PATH		"/sys/kernel/debug/zswap"
+
+/* The results of one swap-out and swap-in pass */
+typedef struct {
+	uint64_t out_pages;		/* pages not resident after the fill */
+	uint64_t in_pages;		/* of those, pages faulted back in */
+	double out_secs;		/* fill and push out time */
+	double in_secs;			/* fault in time */
+	uint64_t orig;			/* compressed swap, bytes stored */
+	uint64_t compr;			/* compressed swap, bytes used */
+	stress_latency_t lat;		/* swap-in fault latencies */
+} swap_pass_t;
+
+static uint64_t opt_swap_bytes = DEFAULT_SWAP_BYTES;
+static uint64_t opt_swap_limit = DEFAULT_SWAP_LIMIT;
+
+void stress_set_swap_bytes(const char *optarg)
+{
+	opt_swap_bytes = get_uint64_byte(optarg);
+	check_range("swap-bytes", opt_swap_bytes,
+		MIN_SWAP_BYTES, MAX_SWAP_BYTES);
+}
+
+void stress_set_swap_limit(const char *optarg)
+{
+	opt_swap_limit = get_uint64_byte(optarg);
+	check_range("swap-limit", opt_swap_limit,
+		MIN_SWAP_LIMIT, MAX_SWAP_LIMIT);
+}
+
+/*
+ *  swap_read_u64()
+ *	read a number from a /sys file, 0 if it cannot be read
+ */
+static uint64_t swap_read_u64(const char *path)
+{
+	char buf[32];
+
+	if (system_read(path, buf, sizeof(buf) - 1) <= 0)
+		return 0;
+	return strtoull(buf, NULL, 10);
+}
+
+/*
+ *  swap_compression()
+ *	the bytes stored in and used by zswap or by the zram
+ *	devices, system wide, returns the backend or NULL if
+ *	swap is not compressed
+ */
+static const char *swap_compression(uint64_t *orig, uint64_t *compr)
+{
+	char buf[128];
+	DIR *dir;
+	struct dirent *d;
+	const char *backend = NULL;
+
+	*orig = 0;
+	*compr = 0;
+
+	/* zswap sits in front of the swap device, zram is the device */
+	if ((system_read("/sys/module/zswap/parameters/enabled",
+			buf, sizeof(buf) - 1) > 0) && (buf[0] == 'Y')) {
+		*orig = swap_read_u64(ZSWAP_PATH "/stored_pages") *
+			stress_get_pagesize();
+		*compr = swap_read_u64(ZSWAP_PATH "/pool_total_size");
+		if (*compr)
+			return "zswap";
+	}
+
+	dir = opendir("/sys/block");
+	if (!dir)
+		return NULL;
+	while ((d = readdir(dir)) != NULL) {
+		char path[PATH_MAX];
+		uint64_t o, c;
+
+		if (strncmp(d->d_name, "zram", 4))
+			continue;
+		(void)snprintf(path, sizeof(path), "/sys/block/%s/mm_stat",
+			d->d_name);
+		if ((system_read(path, buf, sizeof(buf) - 1) > 0) &&
+		    (sscanf(buf, "%" SCNu64 " %" SCNu64, &o, &c) == 2)) {
+			*orig += o;
+			*compr += c;
+			backend = "zram";
+		}
+	}
+	(void)closedir(dir);
+
+	return backend;
+}
+
+/*
+ *  swap_device()
+ *	name of the first active swap device
+ */
+static void swap_device(char *dev, const size_t len)
+{
+	char buf[PATH_MAX + 64];
+	FILE *fp;
+
+	(void)snprintf(dev, len, "unknown");
+	if ((fp = fopen("/proc/swaps", "r")) == NULL)
+		return;
+	/* Skip the header line */
+	if (fgets(buf, sizeof(buf), fp) && fgets(buf, sizeof(buf), fp)) {
+		buf[strcspn(buf, " \t\n")] = '\0';
+		if (snprintf(dev, len, "%s", buf) >= (int)len)
+			(void)snprintf(dev, len, "unknown");
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  swap_cgroup_create()
+ *	create a cgroup v2 group with memory.max set to the limit.
+ *	A group with processes in it cannot pass controllers down,
+ *	so the group is a sibling of ours unless we are in the
+ *	root, the only group without a cgroup.type
+ */
+static bool swap_cgroup_create(
+	char *group,
+	const size_t len,
+	const uint32_t instance,
+	const uint64_t limit)
+{
+	char self[PATH_MAX], base[PATH_MAX], path[PATH_MAX + 32], buf[32];
+	char *slash;
+
+	if (stress_cgroup_self(self, sizeof(self)) < 0)
+		return false;
+	(void)snprintf(base, sizeof(base), "%s", self);
+	(void)snprintf(path, sizeof(path), "%s/cgroup.type", self);
+	if (access(path, F_OK) == 0) {
+		if ((slash = strrchr(base, '/')) == NULL)
+			return false;
+		*slash = '\0';
+	} else {
+		(void)snprintf(path, sizeof(path), "%s/cgroup.subtree_control", base);
+		(void)system_write(path, "+memory", 7);
+	}
+
+	if (snprintf(group, len, "%s/%s-swap-%d-%" PRIu32,
+		     base, app_name, (int)getppid(), instance) >= (int)len)
+		return false;
+	if ((mkdir(group, 0755) < 0) && (errno != EEXIST))
+		return false;
+	(void)snprintf(path, sizeof(path), "%s/memory.max", group);
+	(void)snprintf(buf, sizeof(buf), "%" PRIu64, limit);
+	if (system_write(path, buf, strlen(buf)) < 0) {
+		(void)rmdir(group);
+		return false;
+	}
+	return true;
+}
+
+/*
+ *  swap_pass()
+ *	child of a pass, fill the working set so that it is pushed
+ *	out to swap, then fault the pages that went out back in
+ */
+static int swap_pass(
+	const char *name,
+	const char *group,
+	const size_t sz,
+	swap_pass_t *pass)
+{
+	const size_t page_size = stress_get_pagesize();
+	const size_t pages = sz / page_size;
+	unsigned char *vec;
+	uint8_t *buf;
+	uint64_t t;
+	size_t i;
+
+	if (*group) {
+		char path[PATH_MAX + 32];
+
+		(void)snprintf(path, sizeof(path), "%s/cgroup.procs", group);
+		if (system_write(path, "0", 1) < 0) {
+			pr_fail_err(name, "join memory cgroup");
+			return EXIT_FAILURE;
+		}
+	}
+	vec = malloc(pages);
+	if (!vec)
+		return EXIT_NO_RESOURCE;
+	buf = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		free(vec);
+		return EXIT_NO_RESOURCE;
+	}
+#if defined(MADV_NOHUGEPAGE)
+	/* Huge pages are split before swap-out, keep it to small pages */
+	(void)madvise(buf, sz, MADV_NOHUGEPAGE);
+#endif
+
+	/*
+	 *  A quarter of each page is random and the rest zero, so
+	 *  pages compress to about a quarter and are never the
+	 *  same-filled pages zram and zswap store for free
+	 */
+	t = time_now_ns();
+	for (i = 0; i < pages; i++) {
+		uint64_t *ptr = (uint64_t *)(buf + (i * page_size));
+		uint64_t *end = ptr + (page_size / sizeof(*ptr) / 4);
+
+		while (ptr < end)
+			*ptr++ = mwc64();
+	}
+#if defined(MADV_PAGEOUT)
+	if (!*group)
+		(void)madvise(buf, sz, MADV_PAGEOUT);
+#endif
+	pass->out_secs = (double)(time_now_ns() - t) / 1000000000.0;
+	(void)swap_compression(&pass->orig, &pass->compr);
+
+	if (mincore(buf, sz, vec) < 0) {
+		pr_fail_err(name, "mincore");
+		(void)munmap(buf, sz);
+		free(vec);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < pages; i++)
+		pass->out_pages += !(vec[i] & 1);
+
+	/* Time each major fault, pages still resident are skipped */
+	t = time_now_ns();
+	for (i = 0; i < pages; i++) {
+		volatile uint8_t *ptr = buf + (i * page_size);
+		uint64_t t_fault;
+
+		if (vec[i] & 1)
+			continue;
+		t_fault = time_now_ns();
+		(void)*ptr;
+		latency_record(&pass->lat, time_now_ns() - t_fault);
+		pass->in_pages++;
+	}
+	pass->in_secs = (double)(time_now_ns() - t) / 1000000000.0;
+
+	(void)munmap(buf, sz);
+	free(vec);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_swap
+ *	drive a working set over a memory limit into swap and
+ *	measure the swap-out and swap-in rates, the swap-in
+ *	fault latency and the zswap or zram compression ratio
+ */
+int stress_swap(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t page_size = stress_get_pagesize();
+	const size_t sz = (size_t)opt_swap_bytes & ~(page_size - 1);
+	uint64_t limit = opt_swap_limit ? opt_swap_limit : sz / 4;
+	char group[PATH_MAX] = "", dev[PATH_MAX];
+	const char *backend;
+	struct sysinfo info;
+	swap_pass_t *pass;
+	stress_latency_t lat;
+	uint64_t out_pages = 0, in_pages = 0, orig = 0, compr = 0;
+	double out_secs = 0.0, in_secs = 0.0;
+	int rc = EXIT_SUCCESS;
+
+	if ((sysinfo(&info) < 0) || !info.totalswap) {
+		if (instance == 0)
+			pr_inf(stderr, "%s: no swap is enabled, skipping "
+				"stressor\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	if ((uint64_t)info.freeswap * info.mem_unit < sz) {
+		if (instance == 0)
+			pr_inf(stderr, "%s: less free swap than --swap-bytes "
+				"%zu, skipping stressor\n", name, sz);
+		return EXIT_NO_RESOURCE;
+	}
+	if (limit >= sz) {
+		limit = sz / 4;
+		if (instance == 0)
+			pr_inf(stderr, "%s: --swap-limit must be less than "
+				"--swap-bytes, using %" PRIu64 " bytes\n",
+				name, limit);
+	}
+
+	if (!swap_cgroup_create(group, sizeof(group), instance, limit)) {
+		*group = '\0';
+#if defined(MADV_PAGEOUT)
+		if (instance == 0)
+			pr_inf(stderr, "%s: cannot create a cgroup v2 memory "
+				"group, using MADV_PAGEOUT instead\n", name);
+#else
+		if (instance == 0)
+			pr_inf(stderr, "%s: cannot create a cgroup v2 memory "
+				"group, skipping stressor\n", name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
+
+	pass = mmap(NULL, sizeof(*pass), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (pass == MAP_FAILED) {
+		pr_fail_err(name, "mmap");
+		rc = EXIT_NO_RESOURCE;
+		goto tidy;
+	}
+	memset(&lat, 0, sizeof(lat));
+
+	do {
+		pid_t pid;
+		int status;
+		size_t i;
+
+		memset(pass, 0, sizeof(*pass));
+		pid = fork();
+		if (pid < 0) {
+			if (errno == EAGAIN)
+				continue;
+			pr_fail_err(name, "fork");
+			rc = EXIT_FAILURE;
+			break;
+		} else if (pid == 0) {
+			_exit(swap_pass(name, group, sz, pass));
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			(void)kill(pid, SIGKILL);
+			(void)waitpid(pid, &status, 0);
+			break;
+		}
+		if (WIFSIGNALED(status)) {
+			pr_inf(stderr, "%s: pass killed by signal %d, is there "
+				"enough free swap?\n", name, WTERMSIG(status));
+			rc = EXIT_NO_RESOURCE;
+			break;
+		}
+		if (WEXITSTATUS(status) != EXIT_SUCCESS) {
+			rc = WEXITSTATUS(status);
+			break;
+		}
+
+		out_pages += pass->out_pages;
+		in_pages += pass->in_pages;
+		out_secs += pass->out_secs;
+		in_secs += pass->in_secs;
+		orig = pass->orig;
+		compr = pass->compr;
+		for (i = 0; i < LATENCY_BUCKETS; i++)
+			lat.bucket[i] += pass->lat.bucket[i];
+		lat.count += pass->lat.count;
+		if (pass->lat.max > lat.max)
+			lat.max = pass->lat.max;
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	if (*counter) {
+		const double mb_out = (double)(out_pages * page_size) / (double)MB;
+		const double mb_in = (double)(in_pages * page_size) / (double)MB;
+		uint64_t o, c;
+
+		/* The ratio is from the last pass, sampled while it was out */
+		backend = swap_compression(&o, &c);
+		if (instance == 0) {
+			swap_device(dev, sizeof(dev));
+			pr_inf(stderr, "%s: %s to %s, %.1f MB out at %.1f MB/sec, "
+				"%.1f MB in at %.1f MB/sec\n", name,
+				*group ? "memory.max" : "MADV_PAGEOUT", dev,
+				mb_out, (out_secs > 0.0) ? mb_out / out_secs : 0.0,
+				mb_in, (in_secs > 0.0) ? mb_in / in_secs : 0.0);
+			if (lat.count)
+				pr_inf(stderr, "%s: swap-in fault p50 %.1f, p99 %.1f, "
+					"p99.9 %.1f usec\n", name,
+					latency_percentile_usec(&lat, 0.50),
+					latency_percentile_usec(&lat, 0.99),
+					latency_percentile_usec(&lat, 0.999));
+			if (backend && compr)
+				pr_inf(stderr, "%s: %s compression ratio %.2f\n",
+					name, backend, (double)orig / (double)compr);
+		}
+		if (out_secs > 0.0)
+			stress_misc_metric_set(0, "swap-out MB/sec", mb_out / out_secs);
+		if (in_secs > 0.0)
+			stress_misc_metric_set(1, "swap-in MB/sec", mb_in / in_secs);
+		stress_misc_metric_set(2, "MB swapped out per pass",
+			mb_out / (double)*counter);
+		if (lat.count) {
+			stress_misc_metric_set(3, "swap-in fault p50 (usec)",
+				latency_percentile_usec(&lat, 0.50));
+			stress_misc_metric_set(4, "swap-in fault p99 (usec)",
+				latency_percentile_usec(&lat, 0.99));
+			stress_misc_metric_set(5, "swap-in fault p99.9 (usec)",
+				latency_percentile_usec(&lat, 0.999));
+		}
+		if (backend && compr)
+			stress_misc_metric_set(6, "compression ratio",
+				(double)orig / (double)compr);
+	}
+	(void)munmap(pass, sizeof(*pass));
+tidy:
+	if (*group)
+		(void)rmdir(group);
+
+	return rc;
+}
+#endif
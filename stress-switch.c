@@ -27,19 +27,416 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 
 #include "stress-ng.h"
 
-#define SWITCH_STOP	'X'
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#if defined(STRESS_EVENTFD)
+#include <sys/eventfd.h>
+#endif
+#if defined(STRESS_FUTEX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define SWITCH_STOP		'X'	/* child is stopping */
+
+#define SWITCH_METHOD_PIPE	(0)	/* 1 byte messages over 2 pipes */
+#define SWITCH_METHOD_EVENTFD	(1)	/* eventfd write/read */
+#define SWITCH_METHOD_FUTEX	(2)	/* shared futex turn word */
+
+#define SWITCH_PIN_NONE		(0)	/* let the scheduler choose */
+#define SWITCH_PIN_SAME		(1)	/* both processes on one CPU */
+#define SWITCH_PIN_SMT		(2)	/* SMT siblings of one core */
+#define SWITCH_PIN_CORE		(3)	/* different cores, same package */
+#define SWITCH_PIN_SOCKET	(4)	/* different packages */
+
+#define SWITCH_PARENT		(0)	/* turn / endpoint of the parent */
+#define SWITCH_CHILD		(1)	/* turn / endpoint of the child */
+
+typedef struct {
+	const char *name;	/* User option */
+	int value;		/* SWITCH_METHOD_ or SWITCH_PIN_ value */
+} switch_opt_t;
+
+static const switch_opt_t switch_methods[] = {
+	{ "pipe",	SWITCH_METHOD_PIPE },
+#if defined(STRESS_EVENTFD)
+	{ "eventfd",	SWITCH_METHOD_EVENTFD },
+#endif
+#if defined(STRESS_FUTEX)
+	{ "futex",	SWITCH_METHOD_FUTEX },
+#endif
+};
+
+#if defined(__linux__)
+static const switch_opt_t switch_pins[] = {
+	{ "none",	SWITCH_PIN_NONE },
+	{ "same",	SWITCH_PIN_SAME },
+	{ "smt",	SWITCH_PIN_SMT },
+	{ "core",	SWITCH_PIN_CORE },
+	{ "socket",	SWITCH_PIN_SOCKET },
+};
+#endif
+
+/* Wake up channels between the parent and child */
+typedef struct {
+	int method;		/* SWITCH_METHOD_ value */
+	int rfd[2];		/* fd each endpoint waits on */
+	int wfd[2];		/* fd that wakes each endpoint */
+	uint32_t *turn;		/* futex turn word, shared */
+} switch_chan_t;
+
+static int opt_switch_method = SWITCH_METHOD_PIPE;
+#if defined(__linux__)
+static int opt_switch_pin = SWITCH_PIN_NONE;
+#endif
+
+/*
+ *  switch_opt_set()
+ *	look up a named option value from a table
+ */
+static int switch_opt_set(
+	const char *opt,
+	const char *name,
+	const switch_opt_t *opts,
+	const size_t n,
+	int *value)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (!strcmp(name, opts[i].name)) {
+			*value = opts[i].value;
+			return 0;
+		}
+	}
+	fprintf(stderr, "%s must be one of:", opt);
+	for (i = 0; i < n; i++)
+		fprintf(stderr, " %s", opts[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_switch_method()
+ *	set the wake up mechanism
+ */
+int stress_set_switch_method(const char *name)
+{
+	return switch_opt_set("switch-method", name, switch_methods,
+		SIZEOF_ARRAY(switch_methods), &opt_switch_method);
+}
+
+/*
+ *  stress_set_switch_pin()
+ *	set how the two processes are placed on the CPUs
+ */
+int stress_set_switch_pin(const char *name)
+{
+#if defined(__linux__)
+	return switch_opt_set("switch-pin", name, switch_pins,
+		SIZEOF_ARRAY(switch_pins), &opt_switch_pin);
+#else
+	(void)name;
+
+	fprintf(stderr, "switch-pin is not supported on this system\n");
+	return -1;
+#endif
+}
+
+#if defined(STRESS_FUTEX)
+static inline int switch_futex_wake(uint32_t *futex)
+{
+	return syscall(SYS_futex, futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static inline int switch_futex_wait(uint32_t *futex, const uint32_t val)
+{
+	return syscall(SYS_futex, futex, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+#endif
+
+/*
+ *  switch_chan_open()
+ *	create the wake up channels, returns -1 on failure
+ */
+static int switch_chan_open(const char *name, switch_chan_t *chan)
+{
+	int fds[4];
+
+	memset(chan, 0, sizeof(*chan));
+	chan->method = opt_switch_method;
+	chan->rfd[0] = chan->rfd[1] = -1;
+	chan->wfd[0] = chan->wfd[1] = -1;
+
+	switch (chan->method) {
+#if defined(STRESS_EVENTFD)
+	case SWITCH_METHOD_EVENTFD:
+		if ((fds[0] = eventfd(0, 0)) < 0) {
+			pr_fail_dbg(name, "eventfd");
+			return -1;
+		}
+		if ((fds[1] = eventfd(0, 0)) < 0) {
+			pr_fail_dbg(name, "eventfd");
+			(void)close(fds[0]);
+			return -1;
+		}
+		chan->rfd[SWITCH_PARENT] = chan->wfd[SWITCH_PARENT] = fds[0];
+		chan->rfd[SWITCH_CHILD] = chan->wfd[SWITCH_CHILD] = fds[1];
+		return 0;
+#endif
+#if defined(STRESS_FUTEX)
+	case SWITCH_METHOD_FUTEX:
+		chan->turn = mmap(NULL, stress_get_pagesize(),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (chan->turn == MAP_FAILED) {
+			chan->turn = NULL;
+			pr_fail_dbg(name, "mmap");
+			return -1;
+		}
+		*chan->turn = SWITCH_PARENT;
+		return 0;
+#endif
+	default:
+		if (pipe(&fds[0]) < 0) {
+			pr_fail_dbg(name, "pipe");
+			return -1;
+		}
+		if (pipe(&fds[2]) < 0) {
+			pr_fail_dbg(name, "pipe");
+			(void)close(fds[0]);
+			(void)close(fds[1]);
+			return -1;
+		}
+		chan->rfd[SWITCH_CHILD] = fds[0];
+		chan->wfd[SWITCH_CHILD] = fds[1];
+		chan->rfd[SWITCH_PARENT] = fds[2];
+		chan->wfd[SWITCH_PARENT] = fds[3];
+		return 0;
+	}
+}
+
+/*
+ *  switch_chan_close()
+ *	close the wake up channels
+ */
+static void switch_chan_close(switch_chan_t *chan)
+{
+	size_t i;
+
+	for (i = 0; i < 2; i++) {
+		if (chan->rfd[i] > -1)
+			(void)close(chan->rfd[i]);
+		if ((chan->wfd[i] > -1) && (chan->wfd[i] != chan->rfd[i]))
+			(void)close(chan->wfd[i]);
+		chan->rfd[i] = chan->wfd[i] = -1;
+	}
+	if (chan->turn) {
+		(void)munmap((void *)chan->turn, stress_get_pagesize());
+		chan->turn = NULL;
+	}
+}
+
+/*
+ *  switch_chan_endpoint()
+ *	close the pipe ends that endpoint who does not use so
+ *	that it sees EOF when the other endpoint goes away
+ */
+static void switch_chan_endpoint(switch_chan_t *chan, const int who)
+{
+	const int other = !who;
+
+	if (chan->method != SWITCH_METHOD_PIPE)
+		return;
+	(void)close(chan->rfd[other]);
+	(void)close(chan->wfd[who]);
+	chan->rfd[other] = chan->wfd[who] = -1;
+}
+
+/*
+ *  switch_wake()
+ *	wake up endpoint who with a message
+ */
+static int switch_wake(switch_chan_t *chan, const int who, const char msg)
+{
+	switch (chan->method) {
+#if defined(STRESS_EVENTFD)
+	case SWITCH_METHOD_EVENTFD: {
+		const uint64_t val = (msg == SWITCH_STOP) ? 2 : 1;
+
+		return (write(chan->wfd[who], &val, sizeof(val)) == sizeof(val)) ? 0 : -1;
+	}
+#endif
+#if defined(STRESS_FUTEX)
+	case SWITCH_METHOD_FUTEX:
+		__atomic_store_n(chan->turn, (uint32_t)who, __ATOMIC_RELEASE);
+		return (switch_futex_wake(chan->turn) < 0) ? -1 : 0;
+#endif
+	default:
+		return (write(chan->wfd[who], &msg, sizeof(msg)) == sizeof(msg)) ? 0 : -1;
+	}
+}
+
+/*
+ *  switch_wait()
+ *	wait to be woken up as endpoint who, returns 0 when woken,
+ *	1 when told to stop or interrupted when no longer running
+ *	and -1 on an error
+ */
+static int switch_wait(switch_chan_t *chan, const int who)
+{
+	for (;;) {
+		int ret;
+
+		switch (chan->method) {
+#if defined(STRESS_EVENTFD)
+		case SWITCH_METHOD_EVENTFD: {
+			uint64_t val;
+
+			ret = read(chan->rfd[who], &val, sizeof(val));
+			if (ret == sizeof(val))
+				return (val > 1) ? 1 : 0;
+			break;
+		}
+#endif
+#if defined(STRESS_FUTEX)
+		case SWITCH_METHOD_FUTEX: {
+			const uint32_t other = (uint32_t)!who;
+
+			if (__atomic_load_n(chan->turn, __ATOMIC_ACQUIRE) == (uint32_t)who)
+				return 0;
+			ret = switch_futex_wait(chan->turn, other);
+			if ((ret < 0) && (errno == EAGAIN))
+				ret = 0;
+			break;
+		}
+#endif
+		default: {
+			char msg;
+
+			ret = read(chan->rfd[who], &msg, sizeof(msg));
+			if (ret == 0)
+				return 1;
+			if (ret == sizeof(msg))
+				return (msg == SWITCH_STOP) ? 1 : 0;
+			break;
+		}
+		}
+		if (ret < 0) {
+			if (errno != EINTR)
+				return -1;
+			if (!opt_do_run)
+				return 1;
+		}
+	}
+}
+
+#if defined(__linux__)
+/*
+ *  switch_pin_cpus()
+ *	pick a CPU for the parent and child that match the
+ *	pinning mode, returns -1 if there is no such pair
+ */
+static int switch_pin_cpus(
+	const uint32_t instance,
+	int *cpu_parent,
+	int *cpu_child)
+{
+	cpu_set_t allowed;
+	cpus_t *cpus;
+	const cpu_t **usable, *base = NULL, *partner = NULL;
+	uint32_t i, n = 0;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		return -1;
+	cpus = get_all_cpu_cache_details();
+	if (!cpus)
+		return -1;
+	usable = calloc(cpus->count, sizeof(*usable));
+	if (!usable) {
+		free_cpu_caches(cpus);
+		return -1;
+	}
+	for (i = 0; i < cpus->count; i++) {
+		const cpu_t *cpu = &cpus->cpus[i];
+
+		if (cpu->online && (cpu->id < CPU_SETSIZE) &&
+		    CPU_ISSET(cpu->id, &allowed))
+			usable[n++] = cpu;
+	}
+	if (n)
+		base = usable[instance % n];
+
+	for (i = 0; base && (i < n) && !partner; i++) {
+		const cpu_t *cpu = usable[(instance + i) % n];
+		const bool same_package = (cpu->package_id == base->package_id) &&
+					  (base->package_id >= 0);
+
+		switch (opt_switch_pin) {
+		case SWITCH_PIN_SAME:
+			partner = base;
+			break;
+		case SWITCH_PIN_SMT:
+			if ((cpu != base) && same_package &&
+			    (base->core_id >= 0) && (cpu->core_id == base->core_id))
+				partner = cpu;
+			break;
+		case SWITCH_PIN_CORE:
+			if (same_package && (base->core_id >= 0) &&
+			    (cpu->core_id >= 0) && (cpu->core_id != base->core_id))
+				partner = cpu;
+			break;
+		case SWITCH_PIN_SOCKET:
+			if ((base->package_id >= 0) && (cpu->package_id >= 0) &&
+			    (cpu->package_id != base->package_id))
+				partner = cpu;
+			break;
+		default:
+			break;
+		}
+	}
+	if (partner) {
+		*cpu_parent = base->id;
+		*cpu_child = partner->id;
+	}
+	free(usable);
+	free_cpu_caches(cpus);
+
+	return partner ? 0 : -1;
+}
+
+/*
+ *  switch_pin_self()
+ *	pin the calling process to a CPU
+ */
+static void switch_pin_self(const char *name, const int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0)
+		pr_dbg(stderr, "%s: cannot pin to CPU %d, errno=%d (%s)\n",
+			name, cpu, errno, strerror(errno));
+}
+#endif
 
 /*
  *  stress_switch
- *	stress by heavy context switching
+ *	stress by heavy context switching, the parent and child
+ *	ping-pong wake ups and the round trip time is measured
  */
 int stress_switch(
 	uint64_t *const counter,
@@ -48,104 +445,108 @@ int stress_switch(
 	const char *name)
 {
 	pid_t pid;
-	int pipefds[2];
-	size_t buf_size;
-
-	(void)instance;
+	switch_chan_t chan;
+	int cpu_parent = -1, cpu_child = -1;
+	int rc = EXIT_SUCCESS;
 
-#if defined(__linux__) && NEED_GLIBC(2,9,0)
-	if (pipe2(pipefds, O_DIRECT) < 0) {
-		pr_fail_dbg(name, "pipe2");
-		return EXIT_FAILURE;
+#if defined(__linux__)
+	if (opt_switch_pin != SWITCH_PIN_NONE) {
+		if (switch_pin_cpus(instance, &cpu_parent, &cpu_child) < 0) {
+			if (instance == 0)
+				pr_inf(stderr, "%s: no CPU pair matches the "
+					"pinning mode, not pinning\n", name);
+		} else {
+			if (instance == 0)
+				pr_inf(stderr, "%s: parent on CPU %d, "
+					"child on CPU %d\n", name,
+					cpu_parent, cpu_child);
+			switch_pin_self(name, cpu_parent);
+		}
 	}
-	buf_size = 1;
 #else
-	if (pipe(pipefds) < 0) {
-		pr_fail_dbg(name, "pipe");
-		return EXIT_FAILURE;
-	}
-	buf_size = stress_get_pagesize();
+	(void)instance;
 #endif
 
-#if defined(F_SETPIPE_SZ)
-	if (fcntl(pipefds[0], F_SETPIPE_SZ, buf_size) < 0) {
-		pr_dbg(stderr, "%s: could not force pipe size to 1 page, "
-			"errno = %d (%s)\n",
-			name, errno, strerror(errno));
-	}
-	if (fcntl(pipefds[1], F_SETPIPE_SZ, buf_size) < 0) {
-		pr_dbg(stderr, "%s: could not force pipe size to 1 page, "
-			"errno = %d (%s)\n",
-			name, errno, strerror(errno));
-	}
-#endif
+	if (switch_chan_open(name, &chan) < 0)
+		return EXIT_FAILURE;
 
 again:
 	pid = fork();
 	if (pid < 0) {
 		if (opt_do_run && (errno == EAGAIN))
 			goto again;
-		(void)close(pipefds[0]);
-		(void)close(pipefds[1]);
+		switch_chan_close(&chan);
 		pr_fail_dbg(name, "fork");
 		return EXIT_FAILURE;
 	} else if (pid == 0) {
-		char buf[buf_size];
-
 		(void)setpgid(0, pgrp);
 		stress_parent_died_alarm();
-
-		(void)close(pipefds[1]);
-
-		while (opt_do_run) {
-			ssize_t ret;
-
-			ret = read(pipefds[0], buf, sizeof(buf));
-			if (ret < 0) {
-				if ((errno == EAGAIN) || (errno == EINTR))
-					continue;
-				pr_fail_dbg(name, "read");
+		switch_chan_endpoint(&chan, SWITCH_CHILD);
+#if defined(__linux__)
+		switch_pin_self(name, cpu_child);
+#endif
+		while (switch_wait(&chan, SWITCH_CHILD) == 0) {
+			if (switch_wake(&chan, SWITCH_PARENT, '_') < 0) {
+				pr_fail_dbg(name, "wake");
 				break;
 			}
-			if (ret == 0)
-				break;
-			if (*buf == SWITCH_STOP)
-				break;
 		}
-		(void)close(pipefds[0]);
-		exit(EXIT_SUCCESS);
+		/* Hand the turn back so the parent can never block forever */
+		(void)switch_wake(&chan, SWITCH_PARENT, SWITCH_STOP);
+		switch_chan_close(&chan);
+		_exit(EXIT_SUCCESS);
 	} else {
-		char buf[buf_size];
+#if defined(STRESS_LATENCY)
+		static stress_latency_t lat;
+#endif
 		int status;
 
 		/* Parent */
 		(void)setpgid(pid, pgrp);
-		(void)close(pipefds[0]);
-
-		memset(buf, '_', buf_size);
+		switch_chan_endpoint(&chan, SWITCH_PARENT);
 
 		do {
-			ssize_t ret;
-
-			ret = write(pipefds[1], buf, sizeof(buf));
-			if (ret <= 0) {
-				if ((errno == EAGAIN) || (errno == EINTR))
-					continue;
-				if (errno) {
-					pr_fail_dbg(name, "write");
-					break;
+			const uint64_t t = time_now_ns();
+			int ret;
+
+			if (switch_wake(&chan, SWITCH_CHILD, '_') < 0) {
+				pr_fail_dbg(name, "wake");
+				rc = EXIT_FAILURE;
+				break;
+			}
+			ret = switch_wait(&chan, SWITCH_PARENT);
+			if (ret) {
+				if (ret < 0) {
+					pr_fail_dbg(name, "wait");
+					rc = EXIT_FAILURE;
 				}
-				continue;
+				break;
 			}
+#if defined(STRESS_LATENCY)
+			latency_record(&lat, time_now_ns() - t);
+#else
+			(void)t;
+#endif
 			(*counter)++;
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
 
-		memset(buf, SWITCH_STOP, sizeof(buf));
-		if (write(pipefds[1], buf, sizeof(buf)) <= 0)
-			pr_fail_dbg(name, "termination write");
 		(void)kill(pid, SIGKILL);
 		(void)waitpid(pid, &status, 0);
+
+#if defined(STRESS_LATENCY)
+		if (lat.count) {
+			stress_misc_metric_set(0, "round trip p50 (nsec)",
+				(double)latency_percentile(&lat, 0.50));
+			stress_misc_metric_set(1, "round trip p99 (nsec)",
+				(double)latency_percentile(&lat, 0.99));
+			stress_misc_metric_set(2, "round trip p99.9 (nsec)",
+				(double)latency_percentile(&lat, 0.999));
+			stress_misc_metric_set(3, "round trip max (nsec)",
+				(double)lat.max);
+		}
+#endif
 	}
+	switch_chan_close(&chan);
 
-	return EXIT_SUCCESS;
+	return rc;
 }
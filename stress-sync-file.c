@@ -33,13 +33,35 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <string.h>
 #include <fcntl.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#define WAL_CELL_TIME	(0.5)		/* secs per method and size */
+#define WAL_BUF_SIZE	(1 * MB)	/* largest record */
+
+#define WAL_FSYNC	(0)
+#define WAL_FDATASYNC	(1)
+#define WAL_RANGE	(2)		/* sync_file_range, all flags */
+#define WAL_DSYNC	(3)		/* write with O_DSYNC */
+
 static off_t opt_sync_file_bytes = DEFAULT_SYNC_FILE_BYTES;
 static bool set_sync_file_bytes = false;
+static bool opt_sync_file_wal = false;
+
+static const char *wal_methods[SYNC_WAL_METHODS] = {
+	"fsync", "fdatasync", "sync_range", "O_DSYNC"
+};
+
+static const size_t wal_sizes[SYNC_WAL_SIZES] = {
+	512, 4 * KB, 64 * KB, 1 * MB
+};
+
+static const char *wal_size_names[SYNC_WAL_SIZES] = {
+	"512", "4K", "64K", "1M"
+};
 
 static const int sync_modes[] = {
 	SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE,
@@ -58,6 +80,67 @@ void stress_set_sync_file_bytes(const char *optarg)
 		MIN_SYNC_FILE_BYTES, MAX_SYNC_FILE_BYTES);
 }
 
+void stress_set_sync_file_wal(void)
+{
+	opt_sync_file_wal = true;
+}
+
+/*
+ *  wal_bucket()
+ *	log linear histogram bucket of a latency, 8 buckets per
+ *	power of 2 so a bucket is within 12.5% of its value
+ */
+static inline size_t wal_bucket(const uint64_t nsec)
+{
+	size_t bit, idx;
+
+	if (nsec < 8)
+		return (size_t)nsec;
+	bit = 63 - (size_t)__builtin_clzll(nsec);
+	idx = ((bit - 2) * 8) + (size_t)((nsec >> (bit - 3)) & 7);
+
+	return (idx < SYNC_WAL_BUCKETS) ? idx : SYNC_WAL_BUCKETS - 1;
+}
+
+/*
+ *  wal_percentile()
+ *	latency in usecs below which pct percent of the syncs
+ *	fall, the middle of the bucket it lands in
+ */
+static double wal_percentile(const sync_wal_cell_t *cell, const double pct)
+{
+	const uint64_t target = (uint64_t)((double)cell->syncs * pct / 100.0);
+	uint64_t seen = 0;
+	size_t i;
+
+	for (i = 0; i < SYNC_WAL_BUCKETS; i++) {
+		seen += cell->hist[i];
+		if (seen > target) {
+			const size_t bit = (i / 8) + 2;
+			uint64_t mid;
+
+			if (i < 8)
+				return (double)i / 1000.0;
+			mid = ((uint64_t)(8 + (i & 7)) << (bit - 3)) +
+				((1ULL << (bit - 3)) / 2);
+			if (mid > cell->max_nsec)
+				mid = cell->max_nsec;
+			return (double)mid / 1000.0;
+		}
+	}
+	return (double)cell->max_nsec / 1000.0;
+}
+
+/*
+ *  wal_rate()
+ *	syncs per second of a cell
+ */
+static inline double wal_rate(const sync_wal_cell_t *cell)
+{
+	return cell->nsec ? (double)cell->syncs * 1000000000.0 /
+		(double)cell->nsec : 0.0;
+}
+
 /*
  *  shrink and re-allocate the file to be sync'd
  *
@@ -89,6 +172,236 @@ static int stress_sync_allocate(const char *name, const int fd)
 	return 0;
 }
 
+/*
+ *  stress_sync_file_wal()
+ *	append records and sync them, stepping through the sync
+ *	methods and record sizes on a schedule shared by all the
+ *	instances so they are concurrent log writers
+ */
+static int stress_sync_file_wal(
+	const char *name,
+	const uint32_t instance,
+	const int fd,
+	const int fd_dsync,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	static sync_wal_cell_t cells[SYNC_WAL_METHODS][SYNC_WAL_SIZES];
+	const uint64_t cell_ns = (uint64_t)(WAL_CELL_TIME * 1000000000.0);
+	uint64_t start, cur = ~0ULL;
+	off_t offset = 0;
+	char *buf;
+	size_t i, j;
+	int rc = EXIT_SUCCESS;
+
+	buf = malloc(WAL_BUF_SIZE);
+	if (!buf) {
+		pr_err(stderr, "%s: cannot allocate record buffer\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < WAL_BUF_SIZE; i++)
+		buf[i] = (char)mwc8();
+	(void)memset(cells, 0, sizeof(cells));
+
+	start = time_now_ns();
+	if (!__sync_bool_compare_and_swap(&shared->sync_wal.start_ns, 0, start))
+		start = shared->sync_wal.start_ns;
+
+	do {
+		const uint64_t t = time_now_ns();
+		const uint64_t slot = (t - start) / cell_ns;
+		const size_t method = (size_t)(slot % SYNC_WAL_METHODS);
+		const size_t size_idx = (size_t)((slot / SYNC_WAL_METHODS) %
+			SYNC_WAL_SIZES);
+		const size_t size = wal_sizes[size_idx];
+		sync_wal_cell_t *cell = &cells[method][size_idx];
+		uint64_t t_sync, t_end, delta;
+		ssize_t ret;
+
+		/* A new method or size starts from an empty log */
+		if ((slot != cur) || (offset + (off_t)size > opt_sync_file_bytes)) {
+			if (ftruncate(fd, 0) < 0) {
+				pr_fail_err(name, "ftruncate");
+				rc = EXIT_FAILURE;
+				break;
+			}
+			(void)fdatasync(fd);
+			offset = 0;
+			cur = slot;
+			continue;
+		}
+
+		if (method == WAL_DSYNC) {
+			t_sync = time_now_ns();
+			ret = pwrite(fd_dsync, buf, size, offset);
+		} else {
+			ret = pwrite(fd, buf, size, offset);
+			t_sync = time_now_ns();
+			if (ret == (ssize_t)size) {
+				switch (method) {
+				case WAL_FSYNC:
+					ret = fsync(fd);
+					break;
+				case WAL_FDATASYNC:
+					ret = fdatasync(fd);
+					break;
+				default:
+					ret = sync_file_range(fd, offset, size,
+						SYNC_FILE_RANGE_WAIT_BEFORE |
+						SYNC_FILE_RANGE_WRITE |
+						SYNC_FILE_RANGE_WAIT_AFTER);
+					break;
+				}
+			}
+		}
+		t_end = time_now_ns();
+		if (ret < 0) {
+			if ((errno == ENOSPC) || (errno == EDQUOT) ||
+			    (errno == EINTR)) {
+				cur = ~0ULL;
+				continue;
+			}
+			pr_fail_err(name, "sync");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		offset += (off_t)size;
+
+		delta = t_end - t_sync;
+		cell->hist[wal_bucket(delta)]++;
+		cell->syncs++;
+		cell->nsec += t_end - t;
+		if (delta > cell->max_nsec)
+			cell->max_nsec = delta;
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	if (instance == 0) {
+		pr_inf(stderr, "%s: %-10s %6s %9s %9s %9s %9s %9s\n", name,
+			"method", "size", "syncs/s", "p50 us", "p99 us",
+			"p99.9 us", "max us");
+		for (j = 0; j < SYNC_WAL_SIZES; j++) {
+			for (i = 0; i < SYNC_WAL_METHODS; i++) {
+				const sync_wal_cell_t *cell = &cells[i][j];
+
+				if (!cell->syncs)
+					continue;
+				pr_inf(stderr, "%s: %-10s %6s %9.1f %9.1f "
+					"%9.1f %9.1f %9.1f\n", name, wal_methods[i],
+					wal_size_names[j],
+					wal_rate(cell), wal_percentile(cell, 50.0),
+					wal_percentile(cell, 99.0),
+					wal_percentile(cell, 99.9),
+					(double)cell->max_nsec / 1000.0);
+			}
+		}
+	}
+
+	/* Add to the totals of all the instances */
+	for (i = 0; i < SYNC_WAL_METHODS; i++) {
+		for (j = 0; j < SYNC_WAL_SIZES; j++) {
+			const sync_wal_cell_t *cell = &cells[i][j];
+			sync_wal_cell_t *total = &shared->sync_wal.cell[i][j];
+			size_t k;
+			uint64_t max;
+
+			if (!cell->syncs)
+				continue;
+			__sync_fetch_and_add(&total->syncs, cell->syncs);
+			__sync_fetch_and_add(&total->nsec, cell->nsec);
+			__sync_fetch_and_add(&total->rate, (uint64_t)wal_rate(cell));
+			__sync_fetch_and_add(&total->records, 1);
+			for (k = 0; k < SYNC_WAL_BUCKETS; k++) {
+				if (cell->hist[k])
+					__sync_fetch_and_add(&total->hist[k],
+						cell->hist[k]);
+			}
+			do {
+				max = total->max_nsec;
+				if (cell->max_nsec <= max)
+					break;
+			} while (!__sync_bool_compare_and_swap(&total->max_nsec,
+					max, cell->max_nsec));
+		}
+	}
+
+	/* 4K records are the common log write */
+	for (i = 0; i < SYNC_WAL_METHODS; i++) {
+		char desc[40];
+
+		(void)snprintf(desc, sizeof(desc), "%s 4K p99 (usecs)",
+			wal_methods[i]);
+		stress_misc_metric_set(i, desc, wal_percentile(&cells[i][1], 99.0));
+	}
+	stress_misc_metric_set(i++, "fdatasync 4K syncs/sec",
+		wal_rate(&cells[WAL_FDATASYNC][1]));
+	stress_misc_metric_set(i++, "O_DSYNC 4K syncs/sec",
+		wal_rate(&cells[WAL_DSYNC][1]));
+	free(buf);
+
+	return rc;
+}
+
+/*
+ *  stress_sync_file_dump()
+ *	report the syncs/s of all the instances together and the
+ *	sync latency percentiles of every sync they made
+ */
+void stress_sync_file_dump(FILE *yaml, json_t *json)
+{
+	bool dumped_heading = false;
+	size_t i, j;
+
+	for (j = 0; j < SYNC_WAL_SIZES; j++) {
+		for (i = 0; i < SYNC_WAL_METHODS; i++) {
+			const sync_wal_cell_t *cell = &shared->sync_wal.cell[i][j];
+
+			if (!cell->syncs)
+				continue;
+			if (!dumped_heading) {
+				pr_inf(stdout, "%-13s %-10s %6s %9s %9s %9s %9s %9s %9s\n",
+					"sync-file", "method", "size", "writers",
+					"syncs/s", "p50 us", "p99 us", "p99.9 us",
+					"max us");
+				pr_inf(stdout, "%-13s %-10s %6s %9s %9s\n", "", "",
+					"", "", "(total)");
+				pr_yaml(yaml, "sync-file-wal:\n");
+				json_array_begin(json, "sync-file-wal");
+				dumped_heading = true;
+			}
+			pr_inf(stdout, "%-13s %-10s %6s %9" PRIu32 " %9" PRIu64
+				" %9.1f %9.1f %9.1f %9.1f\n", "", wal_methods[i],
+				wal_size_names[j], cell->records, cell->rate,
+				wal_percentile(cell, 50.0), wal_percentile(cell, 99.0),
+				wal_percentile(cell, 99.9),
+				(double)cell->max_nsec / 1000.0);
+			pr_yaml(yaml, "    - method: %s\n", wal_methods[i]);
+			pr_yaml(yaml, "      size: %zu\n", wal_sizes[j]);
+			pr_yaml(yaml, "      writers: %" PRIu32 "\n", cell->records);
+			pr_yaml(yaml, "      syncs-per-second: %" PRIu64 "\n", cell->rate);
+			pr_yaml(yaml, "      p50-usecs: %f\n", wal_percentile(cell, 50.0));
+			pr_yaml(yaml, "      p99-usecs: %f\n", wal_percentile(cell, 99.0));
+			pr_yaml(yaml, "      p999-usecs: %f\n", wal_percentile(cell, 99.9));
+			pr_yaml(yaml, "      max-usecs: %f\n",
+				(double)cell->max_nsec / 1000.0);
+			json_obj_begin(json, NULL);
+			json_str(json, "method", wal_methods[i]);
+			json_uint(json, "size", wal_sizes[j]);
+			json_uint(json, "writers", cell->records);
+			json_uint(json, "syncs-per-second", cell->rate);
+			json_double(json, "p50-usecs", wal_percentile(cell, 50.0));
+			json_double(json, "p99-usecs", wal_percentile(cell, 99.0));
+			json_double(json, "p999-usecs", wal_percentile(cell, 99.9));
+			json_double(json, "max-usecs", (double)cell->max_nsec / 1000.0);
+			json_obj_end(json);
+		}
+	}
+	if (dumped_heading) {
+		pr_yaml(yaml, "\n");
+		json_array_end(json);
+	}
+}
+
 /*
  *  stress_sync_file
  *	stress the sync_file_range system call
@@ -102,6 +415,7 @@ int stress_sync_file(
 	const pid_t pid = getpid();
 	int fd, ret;
 	char filename[PATH_MAX];
+	stress_io_stats_t iostats;
 
 	if (!set_sync_file_bytes) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -113,6 +427,7 @@ int stress_sync_file(
 	ret = stress_temp_dir_mk(name, pid, instance);
 	if (ret < 0)
 		return exit_status(-ret);
+	io_stats_begin(&iostats);
 
 	(void)stress_temp_filename(filename, sizeof(filename),
 		name, pid, instance, mwc32());
@@ -123,6 +438,23 @@ int stress_sync_file(
 		(void)stress_temp_dir_rm(name, pid, instance);
 		return ret;
 	}
+	if (opt_sync_file_wal) {
+		int fd_dsync = open(filename, O_WRONLY | O_DSYNC);
+
+		(void)unlink(filename);
+		if (fd_dsync < 0) {
+			ret = exit_status(errno);
+			pr_fail_err(name, "open");
+		} else {
+			ret = stress_sync_file_wal(name, instance, fd, fd_dsync,
+				counter, max_ops);
+			(void)close(fd_dsync);
+		}
+		(void)close(fd);
+		io_stats_end(&iostats, *counter);
+		(void)stress_temp_dir_rm(name, pid, instance);
+		return ret;
+	}
 	(void)unlink(filename);
 
 	do {
@@ -167,8 +499,15 @@ int stress_sync_file(
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
 	(void)close(fd);
+	io_stats_end(&iostats, *counter);
 	(void)stress_temp_dir_rm(name, pid, instance);
 
 	return EXIT_SUCCESS;
 }
+#else
+void stress_sync_file_dump(FILE *yaml, json_t *json)
+{
+	(void)yaml;
+	(void)json;
+}
 #endif
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+
+#include "stress-ng.h"
+
+#define SYSCALL_LOOPS		(10000)		/* calls per timed loop */
+
+/* the cheapest calls there are, to expose the entry/exit cost */
+typedef enum {
+	SYSCALL_GETPPID = 0,		/* real syscall, no libc caching */
+	SYSCALL_CLOCK_GETTIME,		/* vDSO, no kernel entry at all */
+	SYSCALL_READ_BADFD,		/* fails at the fd lookup */
+	SYSCALL_CLOSE_BADFD,		/* fails at the fd lookup */
+	SYSCALL_MAX
+} syscall_call_t;
+
+static const char *syscall_names[SYSCALL_MAX] = {
+	"getppid",
+	"clock_gettime",
+	"read -1",
+	"close -1",
+};
+
+/*
+ *  syscall_time()
+ *	ns per call of a tight loop of one call
+ */
+static double syscall_time(const syscall_call_t call)
+{
+	uint64_t t;
+	int i;
+
+	t = time_ticks();
+	switch (call) {
+	case SYSCALL_GETPPID:
+		for (i = 0; i < SYSCALL_LOOPS; i++)
+#if defined(__NR_getppid)
+			(void)syscall(__NR_getppid);
+#else
+			(void)getppid();
+#endif
+		break;
+	case SYSCALL_CLOCK_GETTIME:
+		for (i = 0; i < SYSCALL_LOOPS; i++) {
+			struct timespec ts;
+
+			(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+		}
+		break;
+	case SYSCALL_READ_BADFD:
+		for (i = 0; i < SYSCALL_LOOPS; i++) {
+			char buf[1];
+
+			(void)read(-1, buf, sizeof(buf));
+		}
+		break;
+	default:
+		for (i = 0; i < SYSCALL_LOOPS; i++)
+			(void)close(-1);
+		break;
+	}
+	t = time_ticks() - t;
+
+	return (double)time_ticks_to_ns(t) / SYSCALL_LOOPS;
+}
+
+/*
+ *  syscall_mitigations()
+ *	report the CPU vulnerability mitigations the kernel has on,
+ *	these change the syscall entry/exit cost the most
+ */
+static void syscall_mitigations(const char *name)
+{
+	static const char *vulns = "/sys/devices/system/cpu/vulnerabilities";
+	struct dirent **namelist;
+	char buf[4096], *ptr;
+	int i, n;
+
+	(void)memset(buf, 0, sizeof(buf));
+	if ((system_read("/proc/cmdline", buf, sizeof(buf) - 1) > 0) &&
+	    ((ptr = strstr(buf, "mitigations=")) != NULL)) {
+		ptr[strcspn(ptr, " \n")] = '\0';
+		pr_inf(stderr, "%s: kernel command line %s\n", name, ptr);
+	}
+
+	n = scandir(vulns, &namelist, NULL, alphasort);
+	if (n < 0) {
+		pr_inf(stderr, "%s: cannot read %s, mitigations unknown\n",
+			name, vulns);
+		return;
+	}
+	for (i = 0; i < n; i++) {
+		char path[PATH_MAX];
+
+		if (namelist[i]->d_name[0] != '.') {
+			(void)snprintf(path, sizeof(path), "%s/%s",
+				vulns, namelist[i]->d_name);
+			(void)memset(buf, 0, sizeof(buf));
+			if (system_read(path, buf, sizeof(buf) - 1) > 0) {
+				buf[strcspn(buf, "\n")] = '\0';
+				pr_inf(stderr, "%s: %s: %s\n", name,
+					namelist[i]->d_name, buf);
+			}
+		}
+		free(namelist[i]);
+	}
+	free(namelist);
+}
+
+/*
+ *  stress_syscall()
+ *	time tight loops of the cheapest syscalls, one bogo op
+ *	per round of all of them. The minimum of the rounds is
+ *	the least disturbed, so the best canary for regressions.
+ */
+int stress_syscall(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	double total[SYSCALL_MAX], best[SYSCALL_MAX];
+	uint64_t rounds = 0;
+	int i;
+
+	if (instance == 0)
+		syscall_mitigations(name);
+
+	for (i = 0; i < SYSCALL_MAX; i++) {
+		total[i] = 0.0;
+		best[i] = -1.0;
+	}
+
+	do {
+		for (i = 0; i < SYSCALL_MAX; i++) {
+			const double ns = syscall_time(i);
+
+			total[i] += ns;
+			if ((best[i] < 0.0) || (ns < best[i]))
+				best[i] = ns;
+		}
+		rounds++;
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	for (i = 0; i < SYSCALL_MAX; i++) {
+		char desc[32];
+
+		(void)snprintf(desc, sizeof(desc), "%s ns", syscall_names[i]);
+		stress_misc_metric_set(i * 2, desc, total[i] / rounds);
+		(void)snprintf(desc, sizeof(desc), "%s min ns", syscall_names[i]);
+		stress_misc_metric_set((i * 2) + 1, desc, best[i]);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -44,6 +44,15 @@
 
 static volatile bool keep_running;
 static sigset_t set;
+static uint32_t opt_sysfs_top = 0;
+static stress_path_stats_t path_stats;
+
+void stress_set_sysfs_top(const char *optarg)
+{
+	opt_sysfs_top = get_uint32(optarg);
+	check_range("sysfs-top", opt_sysfs_top,
+		MIN_SYSFS_TOP, MAX_SYSFS_TOP);
+}
 
 typedef struct ctxt {
 	const char *name;
@@ -210,6 +219,19 @@ static void stress_sys_rw_threads(const char *name, const char *path)
 		munmap(ctxt.badbuf, SYS_BUF_SZ);
 }
 
+/*
+ *  stress_sys_world_readable()
+ *	true if the file can be read by anyone
+ */
+static bool stress_sys_world_readable(const char *path)
+{
+	struct stat buf;
+
+	if (stat(path, &buf) < 0)
+		return false;
+	return (buf.st_mode & S_IROTH) != 0;
+}
+
 /*
  *  stress_sys_dir()
  *	read directory
@@ -248,15 +270,29 @@ static void stress_sys_dir(
 			if (recurse) {
 				snprintf(filename, sizeof(filename),
 					"%s/%s", path, d->d_name);
+				/* Timed reads as root keep out of debugfs and tracefs */
+				if (!sys_rw && path_stats.table &&
+				    (!strcmp(filename, "/sys/kernel/debug") ||
+				     !strcmp(filename, "/sys/kernel/tracing")))
+					break;
 				stress_sys_dir(name, filename, recurse,
 					depth + 1, sys_rw);
 			}
 			break;
 		case DT_REG:
-			if (sys_rw) {
+			if (sys_rw || path_stats.table) {
 				snprintf(filename, sizeof(filename),
 					"%s/%s", path, d->d_name);
-				stress_sys_rw_threads(name, filename);
+				/*
+				 *  As root only time the files anyone may
+				 *  read, reading some root only attributes
+				 *  has side effects such as zram hot_add
+				 */
+				if (path_stats.table &&
+				    (sys_rw || stress_sys_world_readable(filename)))
+					path_stats_read(&path_stats, filename);
+				if (sys_rw)
+					stress_sys_rw_threads(name, filename);
 			}
 			break;
 		default:
@@ -278,12 +314,15 @@ int stress_sysfs(
 {
 	bool sys_rw = true;
 
-	(void)instance;
+	if (opt_sysfs_top && (path_stats_init(&path_stats) < 0))
+		pr_inf(stderr, "%s: cannot allocate file timing table, "
+			"not timing file reads\n", name);
 
 	if (geteuid() == 0) {
 		if (instance == 0) {
 			pr_inf(stderr, "%s: running as root, just traversing /sys "
-				"and not read/writing to /sys files.\n", name);
+				"and not read/writing to /sys files%s.\n", name,
+				path_stats.table ? " other than timed reads" : "");
 		}
 		sys_rw = false;
 	}
@@ -293,6 +332,11 @@ int stress_sysfs(
 		(*counter)++;
 	} while (opt_do_run && (!max_ops || *counter < max_ops));
 
+	if (path_stats.table) {
+		path_stats_report(name, instance, &path_stats, opt_sysfs_top);
+		path_stats_free(&path_stats);
+	}
+
 	return EXIT_SUCCESS;
 }
 #endif
@@ -41,6 +41,11 @@ static uint64_t overruns = 0;
 static bool set_timer_freq = false;
 static double rate_ns;
 static double start;
+#if defined(STRESS_LATENCY)
+static stress_latency_t jitter;		/* expiry lateness histogram */
+static uint64_t jitter_next;		/* next expiry, ns */
+static uint64_t jitter_period;		/* timer interval, ns */
+#endif
 
 /*
  *  stress_set_timer_freq()
@@ -80,6 +85,34 @@ static void stress_timer_set(struct itimerspec *timer)
 	timer->it_interval.tv_nsec = timer->it_value.tv_nsec;
 }
 
+#if defined(STRESS_LATENCY)
+/*
+ *  stress_timer_ns()
+ *	CLOCK_REALTIME in nanoseconds, the timer's clock
+ */
+static inline uint64_t stress_timer_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_REALTIME, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+ *  stress_timer_jitter()
+ *	account how late this expiry was against its schedule,
+ *	overruns are expiries that were merged into this signal
+ */
+static inline void MLOCKED stress_timer_jitter(void)
+{
+	const uint64_t now = stress_timer_ns();
+	const int ret = timer_getoverrun(timerid);
+
+	latency_record(&jitter, (now > jitter_next) ? now - jitter_next : 0);
+	jitter_next += jitter_period * (1 + ((ret > 0) ? ret : 0));
+}
+#endif
+
 /*
  *  stress_timer_handler()
  *	catch timer signal and cancel if no more runs flagged
@@ -92,6 +125,10 @@ static void MLOCKED stress_timer_handler(int sig)
 	(void)sig;
 
 	timer_counter++;
+#if defined(STRESS_LATENCY)
+	if (opt_flags & OPT_FLAGS_TIMER_JITTER)
+		stress_timer_jitter();
+#endif
 
 	if (sigpending(&mask) == 0)
 		if (sigismember(&mask, SIGINT))
@@ -128,12 +165,14 @@ int stress_timer(
 	struct sigevent sev;
 	struct itimerspec timer;
 	sigset_t mask;
+	int flags = 0;
 
 	sigemptyset(&mask);
 	sigaddset(&mask, SIGINT);
 	sigprocmask(SIG_SETMASK, &mask, NULL);
 
 	start = time_now();
+	timer_jitter_sched();
 
 	if (!set_timer_freq) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
@@ -155,7 +194,20 @@ int stress_timer(
 	}
 
 	stress_timer_set(&timer);
-	if (timer_settime(timerid, 0, &timer, NULL) < 0) {
+#if defined(STRESS_LATENCY)
+	if (opt_flags & OPT_FLAGS_TIMER_JITTER) {
+		/* An absolute first expiry gives an exact schedule */
+		jitter_period = ((uint64_t)timer.it_interval.tv_sec * 1000000000ULL) +
+			timer.it_interval.tv_nsec;
+		jitter_next = stress_timer_ns() +
+			((uint64_t)timer.it_value.tv_sec * 1000000000ULL) +
+			timer.it_value.tv_nsec;
+		timer.it_value.tv_sec = jitter_next / 1000000000ULL;
+		timer.it_value.tv_nsec = jitter_next % 1000000000ULL;
+		flags = TIMER_ABSTIME;
+	}
+#endif
+	if (timer_settime(timerid, flags, &timer, NULL) < 0) {
 		pr_fail_err(name, "timer_settime");
 		return EXIT_FAILURE;
 	}
@@ -175,6 +227,10 @@ int stress_timer(
 	}
 	pr_dbg(stderr, "%s: %" PRIu64 " timer overruns (instance %" PRIu32 ")\n",
 		name, overruns, instance);
+#if defined(STRESS_LATENCY)
+	if (opt_flags & OPT_FLAGS_TIMER_JITTER)
+		latency_metrics_set(&jitter, "expiry lateness");
+#endif
 
 	return EXIT_SUCCESS;
 }
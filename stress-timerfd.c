@@ -34,12 +34,22 @@
 #include <signal.h>
 #include <time.h>
 #include <sys/timerfd.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#define TIMERFD_MASS_EVENTS	(1024)	/* epoll_wait events per call */
+#define TIMERFD_MASS_SPAN_MS	(1000)	/* expiries are 1..span ms away */
 
 static volatile uint64_t timerfd_counter = 0;
 static int timerfd;
 static uint64_t opt_timerfd_freq = DEFAULT_TIMERFD_FREQ;
 static bool set_timerfd_freq = false;
+static uint32_t opt_timerfd_mass = 0;
 static double rate_ns;
+#if defined(STRESS_LATENCY)
+static stress_latency_t jitter;		/* expiry lateness histogram */
+#endif
 
 /*
  *  stress_set_timerfd_freq()
@@ -53,6 +63,20 @@ void stress_set_timerfd_freq(const char *optarg)
 		MIN_TIMERFD_FREQ, MAX_TIMERFD_FREQ);
 }
 
+/*
+ *  stress_set_timerfd_mass()
+ *	set the number of concurrent timerfds of the mass mode
+ */
+void stress_set_timerfd_mass(const char *optarg)
+{
+	uint64_t timers;
+
+	timers = get_uint64(optarg);
+	check_range("timerfd-mass", timers,
+		MIN_TIMERFD_MASS, MAX_TIMERFD_MASS);
+	opt_timerfd_mass = (uint32_t)timers;
+}
+
 /*
  *  stress_timerfd_set()
  *	set timerfd, ensure it is never zero
@@ -80,6 +104,214 @@ static void stress_timerfd_set(struct itimerspec *timer)
 	timer->it_interval.tv_nsec = timer->it_value.tv_nsec;
 }
 
+/*
+ *  stress_timerfd_ns()
+ *	CLOCK_REALTIME in nanoseconds, the timer's clock
+ */
+static inline uint64_t stress_timerfd_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_REALTIME, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+ *  stress_timerfd_arm()
+ *	start the timer, with --timer-jitter the first expiry
+ *	is made absolute so next holds the exact schedule
+ */
+static int stress_timerfd_arm(struct itimerspec *timer, uint64_t *next)
+{
+	int flags = 0;
+
+	stress_timerfd_set(timer);
+	if (opt_flags & OPT_FLAGS_TIMER_JITTER) {
+		*next = stress_timerfd_ns() +
+			((uint64_t)timer->it_value.tv_sec * 1000000000ULL) +
+			timer->it_value.tv_nsec;
+		timer->it_value.tv_sec = *next / 1000000000ULL;
+		timer->it_value.tv_nsec = *next % 1000000000ULL;
+		flags = TFD_TIMER_ABSTIME;
+	}
+	return timerfd_settime(timerfd, flags, timer, NULL);
+}
+
+/*
+ *  stress_timerfd_mass_arm()
+ *	arm a one shot timer a random 1..TIMERFD_MASS_SPAN_MS ms
+ *	from now at an absolute time so the deadline is exact
+ */
+static int stress_timerfd_mass_arm(const int fd, uint64_t *deadline)
+{
+	struct itimerspec timer;
+
+	*deadline = time_mono_ns() +
+		((1 + (mwc32() % TIMERFD_MASS_SPAN_MS)) * 1000000ULL) +
+		(mwc32() % 1000000);
+	timer.it_value.tv_sec = *deadline / 1000000000ULL;
+	timer.it_value.tv_nsec = *deadline % 1000000000ULL;
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_nsec = 0;
+
+	return timerfd_settime(fd, TFD_TIMER_ABSTIME, &timer, NULL);
+}
+
+/*
+ *  stress_timerfd_mass()
+ *	keep --timerfd-mass one shot timerfds armed with random
+ *	expiries, as one timeout per connection does, all waited
+ *	for with one epoll set. Each expiry is re-armed and is a
+ *	bogo op, the lateness of the expiries and the system time
+ *	spent per expiry show how the kernel timers scale.
+ */
+static int stress_timerfd_mass(
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	const char *name)
+{
+	int *fds, efd, rc = EXIT_SUCCESS;
+	uint64_t *deadlines;
+	uint32_t i, n;
+	struct rlimit rlim;
+	struct rusage ru_begin, ru_end;
+	double t_begin, t, stime;
+#if defined(STRESS_LATENCY)
+	stress_latency_t *lateness;
+#endif
+
+	/* One fd per timer, raise the fd limit to fit them all */
+	if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 &&
+	    rlim.rlim_cur < (rlim_t)opt_timerfd_mass + 64) {
+		rlim.rlim_cur = (rlim_t)opt_timerfd_mass + 64;
+		if (rlim.rlim_max < rlim.rlim_cur)
+			rlim.rlim_max = rlim.rlim_cur;
+		if (setrlimit(RLIMIT_NOFILE, &rlim) < 0) {
+			(void)getrlimit(RLIMIT_NOFILE, &rlim);
+			rlim.rlim_cur = rlim.rlim_max;
+			(void)setrlimit(RLIMIT_NOFILE, &rlim);
+		}
+	}
+
+	fds = calloc(opt_timerfd_mass, sizeof(*fds));
+	deadlines = calloc(opt_timerfd_mass, sizeof(*deadlines));
+#if defined(STRESS_LATENCY)
+	lateness = calloc(1, sizeof(*lateness));
+	if (!lateness) {
+		free(fds);
+		fds = NULL;
+	}
+#endif
+	if (!fds || !deadlines) {
+		pr_inf(stderr, "%s: out of memory\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_mem;
+	}
+	efd = epoll_create1(0);
+	if (efd < 0) {
+		pr_fail_err(name, "epoll_create1");
+		rc = EXIT_FAILURE;
+		goto free_mem;
+	}
+
+	for (n = 0; opt_do_run && (n < opt_timerfd_mass); n++) {
+		struct epoll_event ev;
+
+		fds[n] = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+		if (fds[n] < 0) {
+			pr_inf(stderr, "%s: only %" PRIu32 " of %" PRIu32
+				" timerfds could be created: errno=%d (%s)\n",
+				name, n, opt_timerfd_mass, errno, strerror(errno));
+			break;
+		}
+		ev.events = EPOLLIN;
+		ev.data.u32 = n;
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, fds[n], &ev) < 0) {
+			pr_fail_err(name, "epoll_ctl");
+			(void)close(fds[n]);
+			rc = EXIT_FAILURE;
+			goto close_fds;
+		}
+		if (stress_timerfd_mass_arm(fds[n], &deadlines[n]) < 0) {
+			pr_fail_err(name, "timerfd_settime");
+			(void)close(fds[n]);
+			rc = EXIT_FAILURE;
+			goto close_fds;
+		}
+	}
+	if (!n) {
+		rc = EXIT_NO_RESOURCE;
+		goto close_fds;
+	}
+	pr_dbg(stderr, "%s: %" PRIu32 " timerfds armed\n", name, n);
+
+	(void)getrusage(RUSAGE_SELF, &ru_begin);
+	t_begin = time_now();
+	while (opt_do_run && (!max_ops || *counter < max_ops)) {
+		struct epoll_event events[TIMERFD_MASS_EVENTS];
+		int ret, j;
+		uint64_t now;
+
+		ret = epoll_wait(efd, events, TIMERFD_MASS_EVENTS, 100);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			pr_fail_err(name, "epoll_wait");
+			rc = EXIT_FAILURE;
+			break;
+		}
+		now = time_mono_ns();
+		for (j = 0; j < ret; j++) {
+			const uint32_t idx = events[j].data.u32;
+			uint64_t exp;
+
+			if (read(fds[idx], &exp, sizeof(exp)) < 0)
+				continue;
+#if defined(STRESS_LATENCY)
+			latency_record(lateness, (now > deadlines[idx]) ?
+				now - deadlines[idx] : 0);
+#endif
+			if (stress_timerfd_mass_arm(fds[idx], &deadlines[idx]) < 0) {
+				pr_fail_err(name, "timerfd_settime");
+				rc = EXIT_FAILURE;
+				break;
+			}
+			(*counter)++;
+		}
+		if (rc != EXIT_SUCCESS)
+			break;
+	}
+	t = time_now() - t_begin;
+	(void)getrusage(RUSAGE_SELF, &ru_end);
+
+	stime = (double)(ru_end.ru_stime.tv_sec - ru_begin.ru_stime.tv_sec) +
+		((double)(ru_end.ru_stime.tv_usec - ru_begin.ru_stime.tv_usec) / 1000000.0);
+#if defined(STRESS_LATENCY)
+	latency_metrics_set(lateness, "expiry lateness");
+#endif
+	stress_misc_metric_set(4, "timerfds", (double)n);
+	if (t > 0.0) {
+		stress_misc_metric_set(5, "expiries/sec", (double)*counter / t);
+		stress_misc_metric_set(6, "sys CPU %", (stime * 100.0) / t);
+	}
+	if (*counter)
+		stress_misc_metric_set(7, "sys ns per expiry",
+			(stime * 1000000000.0) / (double)*counter);
+
+close_fds:
+	for (i = 0; i < n; i++)
+		(void)close(fds[i]);
+	(void)close(efd);
+free_mem:
+#if defined(STRESS_LATENCY)
+	free(lateness);
+#endif
+	free(deadlines);
+	free(fds);
+
+	return rc;
+}
+
 /*
  *  stress_timerfd
  *	stress timerfd
@@ -91,9 +323,15 @@ int stress_timerfd(
 	const char *name)
 {
 	struct itimerspec timer;
+	uint64_t next = 0, period;
 
 	(void)instance;
 
+	if (opt_timerfd_mass)
+		return stress_timerfd_mass(counter, max_ops, name);
+
+	timer_jitter_sched();
+
 	if (!set_timerfd_freq) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
 			opt_timerfd_freq = MAX_TIMERFD_FREQ;
@@ -108,12 +346,13 @@ int stress_timerfd(
 		(void)close(timerfd);
 		return EXIT_FAILURE;
 	}
-	stress_timerfd_set(&timer);
-	if (timerfd_settime(timerfd, 0, &timer, NULL) < 0) {
+	if (stress_timerfd_arm(&timer, &next) < 0) {
 		pr_fail_err(name, "timer_settime");
 		(void)close(timerfd);
 		return EXIT_FAILURE;
 	}
+	period = ((uint64_t)timer.it_interval.tv_sec * 1000000000ULL) +
+		timer.it_interval.tv_nsec;
 
 	do {
 		int ret;
@@ -144,21 +383,35 @@ int stress_timerfd(
 			pr_fail_err(name, "timerfd read");
 			break;
 		}
+#if defined(STRESS_LATENCY)
+		if (opt_flags & OPT_FLAGS_TIMER_JITTER) {
+			/* exp counts expiries missed while we were late */
+			const uint64_t now = stress_timerfd_ns();
+
+			latency_record(&jitter, (now > next) ? now - next : 0);
+			next += period * exp;
+		}
+#endif
 		if (timerfd_gettime(timerfd, &value) < 0) {
 			pr_fail_err(name, "timerfd_gettime");
 			break;
 		}
 		if (opt_flags & OPT_FLAGS_TIMERFD_RAND) {
-			stress_timerfd_set(&timer);
-			if (timerfd_settime(timerfd, 0, &timer, NULL) < 0) {
+			if (stress_timerfd_arm(&timer, &next) < 0) {
 				pr_fail_err(name, "timer_settime");
 				break;
 			}
+			period = ((uint64_t)timer.it_interval.tv_sec * 1000000000ULL) +
+				timer.it_interval.tv_nsec;
 		}
 		(*counter)++;
 	} while (opt_do_run && (!max_ops || timerfd_counter < max_ops));
 
 	(void)close(timerfd);
+#if defined(STRESS_LATENCY)
+	if (opt_flags & OPT_FLAGS_TIMER_JITTER)
+		latency_metrics_set(&jitter, "expiry lateness");
+#endif
 
 	return EXIT_SUCCESS;
 }
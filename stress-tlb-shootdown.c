@@ -36,11 +36,343 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <setjmp.h>
 #include <sched.h>
 
 #define MAX_TLB_PROCS	(4)
 #define MMAP_PAGES	(512)
 
+#define TLB_THREADS_MAX	(1024)		/* max --tlb-shootdown-threads */
+#define TLB_STEPS_MAX	(7)		/* thread counts swept, 2 metrics each */
+#define TLB_STEP_SECS	(0.25)		/* run time of each step slice */
+#define TLB_RANGE_PAGES	(16)		/* pages changed per operation */
+
+static uint32_t opt_tlb_shootdown_threads = 0;	/* 0 = fork variant */
+
+/*
+ *  stress_set_tlb_shootdown_threads()
+ *	use N pthreads sharing one mm instead of child processes
+ */
+void stress_set_tlb_shootdown_threads(const char *optarg)
+{
+	uint64_t n = get_uint64(optarg);
+
+	check_range("tlb-shootdown-threads", n, 2, TLB_THREADS_MAX);
+	opt_tlb_shootdown_threads = (uint32_t)n;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+
+#include <pthread.h>
+
+typedef struct {
+	uint8_t *mem;			/* region the threads touch */
+	size_t size;			/* size of the region */
+	size_t page_size;
+	volatile bool stop;		/* end of the step */
+} tlb_threads_t;
+
+typedef struct {
+	tlb_threads_t *ctx;
+	int cpu;			/* CPU to pin to */
+} tlb_thread_arg_t;
+
+typedef struct {
+	uint32_t threads;		/* threads in the step */
+	uint64_t ops;			/* mprotect/madvise/munmap rounds */
+	uint64_t munmaps;		/* munmaps timed */
+	double munmap_secs;		/* total munmap time */
+	double secs;			/* total step run time */
+	uint64_t flushes;		/* TLB flush tracepoint count */
+	bool perf;			/* flushes is valid */
+} tlb_step_t;
+
+static __thread sigjmp_buf tlb_jmp_env;
+static __thread volatile bool tlb_jmp_set;
+
+/*
+ *  stress_tlb_sigsegv_handler()
+ *	a toucher hit a range while it was unmapped, skip the page
+ */
+static void MLOCKED stress_tlb_sigsegv_handler(int signum)
+{
+	if (tlb_jmp_set)
+		siglongjmp(tlb_jmp_env, 1);
+	(void)signal(signum, SIG_DFL);
+	(void)raise(signum);
+}
+
+/*
+ *  stress_tlb_pin()
+ *	pin the calling thread to a CPU
+ */
+static void stress_tlb_pin(const int cpu)
+{
+	cpu_set_t mask;
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+/*
+ *  stress_tlb_toucher()
+ *	keep reading every page of the region so each CPU holds
+ *	TLB entries for the ranges being changed
+ */
+static void *stress_tlb_toucher(void *arg)
+{
+	static void *nowt = NULL;
+	const tlb_thread_arg_t *targ = (tlb_thread_arg_t *)arg;
+	tlb_threads_t *ctx = targ->ctx;
+	volatile size_t i = 0;
+
+	stress_tlb_pin(targ->cpu);
+	if (sigsetjmp(tlb_jmp_env, 1)) {
+		/* Skip over the unmapped page */
+		i = (i + ctx->page_size) % ctx->size;
+	}
+	tlb_jmp_set = true;
+
+	while (!ctx->stop && opt_do_run) {
+		uint8_t *ptr = ctx->mem + i;
+
+		(void)*(volatile uint8_t *)ptr;
+		i += ctx->page_size;
+		if (i >= ctx->size)
+			i = 0;
+	}
+	tlb_jmp_set = false;
+	return &nowt;
+}
+
+/*
+ *  stress_tlb_modify()
+ *	change one range of the region, each change forces the
+ *	stale TLB entries on the toucher CPUs to be shot down
+ */
+static int stress_tlb_modify(
+	const char *name,
+	tlb_threads_t *ctx,
+	uint8_t *range,
+	tlb_step_t *step)
+{
+	const size_t len = ctx->page_size * TLB_RANGE_PAGES;
+	double t;
+
+	(void)mprotect(range, len, PROT_READ);
+	(void)mprotect(range, len, PROT_READ | PROT_WRITE);
+	(void)madvise(range, len, MADV_DONTNEED);
+
+	t = time_now();
+	(void)munmap(range, len);
+	step->munmap_secs += time_now() - t;
+	step->munmaps++;
+
+	if (mmap(range, len, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+		pr_fail_err(name, "mmap MAP_FIXED");
+		return -1;
+	}
+	memset(range, 0, len);
+	step->ops++;
+	return 0;
+}
+
+/*
+ *  stress_tlb_step()
+ *	run one slice with step->threads threads, thread 0 (this
+ *	thread) changes the region and the others touch it
+ */
+static int stress_tlb_step(
+	const char *name,
+	tlb_threads_t *ctx,
+	const int *cpus,
+	const int n_cpus,
+	tlb_step_t *step,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	pthread_t pthreads[TLB_THREADS_MAX];
+	tlb_thread_arg_t args[TLB_THREADS_MAX];
+	const size_t ranges = ctx->size / (ctx->page_size * TLB_RANGE_PAGES);
+	uint32_t i, started = 0;
+	size_t r = 0;
+	double t, t_end;
+	int rc = 0;
+#if defined(STRESS_PERF_STATS)
+	stress_perf_t sp;
+	bool perf = false;
+
+	/* Opened before the threads start so they inherit the counters */
+	if ((opt_flags & OPT_FLAGS_PERF_STATS) && !perf_open(&sp)) {
+		(void)perf_enable(&sp);
+		perf = true;
+	}
+#endif
+	ctx->stop = false;
+	for (i = 1; i < step->threads; i++) {
+		args[i].ctx = ctx;
+		args[i].cpu = cpus[i % n_cpus];
+		if (pthread_create(&pthreads[i], NULL, stress_tlb_toucher, &args[i]))
+			break;
+		started++;
+	}
+	stress_tlb_pin(cpus[0]);
+
+	t = time_now();
+	t_end = t + TLB_STEP_SECS;
+	do {
+		if (stress_tlb_modify(name, ctx,
+		    ctx->mem + (r * ctx->page_size * TLB_RANGE_PAGES), step) < 0) {
+			rc = -1;
+			break;
+		}
+		r = (r + 1) % ranges;
+		(*counter)++;
+	} while (opt_do_run && (time_now() < t_end) &&
+		 (!max_ops || *counter < max_ops));
+	ctx->stop = true;
+	step->secs += time_now() - t;
+
+	for (i = 1; i <= started; i++)
+		(void)pthread_join(pthreads[i], NULL);
+
+#if defined(STRESS_PERF_STATS)
+	if (perf) {
+		uint64_t flushes;
+		int idx;
+
+		(void)perf_disable(&sp);
+		(void)perf_close(&sp);
+		if (!perf_get_counter_by_id(&sp, STRESS_PERF_TP_TLB_FLUSH, &flushes, &idx) &&
+		    (flushes != STRESS_PERF_INVALID)) {
+			step->flushes += flushes;
+			step->perf = true;
+		}
+	}
+#endif
+	if (started + 1 < step->threads)
+		pr_dbg(stderr, "%s: only started %" PRIu32 " of %" PRIu32
+			" threads\n", name, started + 1, step->threads);
+	return rc;
+}
+
+/*
+ *  stress_tlb_shootdown_threads()
+ *	pthread variant, all threads share one mm and are pinned to
+ *	the allowed CPUs in turn. The thread count is doubled each
+ *	step up to --tlb-shootdown-threads so the shootdown and munmap
+ *	costs can be seen growing with the number of CPUs involved
+ */
+static int stress_tlb_shootdown_threads(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t page_size = stress_get_pagesize();
+	tlb_threads_t ctx;
+	tlb_step_t steps[TLB_STEPS_MAX];
+	cpu_set_t mask;
+	int cpus[CPU_SETSIZE], n_cpus = 0, cpu;
+	size_t n_steps = 0, i;
+	uint32_t n;
+	int rc = EXIT_SUCCESS;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask) < 0) {
+		pr_fail_err(name, "sched_getaffinity");
+		return EXIT_FAILURE;
+	}
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET(cpu, &mask))
+			cpus[n_cpus++] = cpu;
+
+	/* Doubling thread counts ending with the maximum, the largest kept */
+	memset(steps, 0, sizeof(steps));
+	for (n = 1; ; n <<= 1) {
+		if (n > opt_tlb_shootdown_threads)
+			n = opt_tlb_shootdown_threads;
+		if (n_steps == TLB_STEPS_MAX) {
+			memmove(steps, steps + 1, sizeof(steps[0]) * (TLB_STEPS_MAX - 1));
+			n_steps--;
+		}
+		steps[n_steps++].threads = n;
+		if (n == opt_tlb_shootdown_threads)
+			break;
+	}
+
+	if (stress_sighandler(name, SIGSEGV, stress_tlb_sigsegv_handler, NULL) < 0)
+		return EXIT_FAILURE;
+
+	ctx.page_size = page_size;
+	ctx.size = page_size * MMAP_PAGES;
+	ctx.mem = mmap(NULL, ctx.size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ctx.mem == MAP_FAILED) {
+		pr_fail_err(name, "mmap");
+		return EXIT_NO_RESOURCE;
+	}
+	memset(ctx.mem, 0, ctx.size);
+
+	if (!instance)
+		pr_dbg(stderr, "%s: %" PRIu32 " threads on %d CPUs\n",
+			name, opt_tlb_shootdown_threads, n_cpus);
+
+	do {
+		for (i = 0; i < n_steps; i++) {
+			if (stress_tlb_step(name, &ctx, cpus, n_cpus, &steps[i],
+			    counter, max_ops) < 0) {
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	(void)munmap(ctx.mem, ctx.size);
+
+	for (i = 0; i < n_steps; i++) {
+		tlb_step_t *step = &steps[i];
+		char desc[64];
+
+		if (!step->munmaps || (step->secs <= 0.0))
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%" PRIu32 " threads munmap (ns)",
+			step->threads);
+		stress_misc_metric_set(i * 2, desc,
+			step->munmap_secs * 1000000000.0 / step->munmaps);
+		if (step->perf) {
+			(void)snprintf(desc, sizeof(desc), "%" PRIu32 " threads flushes/sec",
+				step->threads);
+			stress_misc_metric_set((i * 2) + 1, desc,
+				(double)step->flushes / step->secs);
+		}
+	}
+	if (!instance) {
+		pr_inf(stdout, "%s: %8s %12s %12s %14s\n", name, "threads",
+			"ops/sec", "munmap (ns)", "flushes/sec");
+		for (i = 0; i < n_steps; i++) {
+			const tlb_step_t *step = &steps[i];
+			char buf[32];
+
+			if (!step->munmaps || (step->secs <= 0.0))
+				continue;
+			if (step->perf)
+				(void)snprintf(buf, sizeof(buf), "%.0f",
+					(double)step->flushes / step->secs);
+			else
+				(void)snprintf(buf, sizeof(buf), "-");
+			pr_inf(stdout, "%s: %8" PRIu32 " %12.0f %12.0f %14s\n",
+				name, step->threads, (double)step->ops / step->secs,
+				step->munmap_secs * 1000000000.0 / step->munmaps, buf);
+		}
+	}
+	return rc;
+}
+#endif
+
 
 /*
  *  stress_tlb_shootdown()
@@ -56,7 +388,15 @@ int stress_tlb_shootdown(
 	const size_t mmap_size = page_size * MMAP_PAGES;
 	pid_t pids[MAX_TLB_PROCS];
 
-	(void)instance;
+	if (opt_tlb_shootdown_threads) {
+#if defined(HAVE_LIB_PTHREAD)
+		return stress_tlb_shootdown_threads(counter, instance, max_ops, name);
+#else
+		if (!instance)
+			pr_inf(stderr, "%s: pthreads not supported, ignoring "
+				"--tlb-shootdown-threads\n", name);
+#endif
+	}
 
 	do {
 		uint8_t *mem, *ptr;
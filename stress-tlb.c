@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_TLB)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#define TLB_MIN_PAGES		(4)		/* smallest sweep point */
+#define TLB_MAX_PAGES		(1024 * 1024)	/* largest --tlb-pages */
+#define TLB_LOADS		(1 << 20)	/* timed accesses per point */
+#define TLB_LINE		(64)		/* one cache line per page */
+#define TLB_SETS		(15)
+#define TLB_NO_MISSES		(~0ULL)		/* no dTLB miss count */
+
+typedef struct {
+	const char *name;		/* --tlb-page-size name */
+	const size_t size;		/* page size in bytes */
+	const uint64_t pages;		/* default largest sweep point */
+} tlb_page_size_t;
+
+/*
+ *  default sweeps go past the dTLB and STLB entry counts of
+ *  current x86 and arm64 parts, the 2M and 1G page sweeps are
+ *  kept smaller as one page of each gets faulted in
+ */
+static const tlb_page_size_t tlb_page_sizes[] = {
+	{ "4K",	4 * KB,	16384 },
+	{ "2M",	2 * MB,	1024 },
+	{ "1G",	GB,	16 },
+};
+
+static const tlb_page_size_t *opt_tlb_page_size = &tlb_page_sizes[0];
+static uint64_t opt_tlb_pages = 0;	/* 0 = page size default */
+
+/*
+ *  stress_set_tlb_pages()
+ *	set the largest number of pages swept
+ */
+void stress_set_tlb_pages(const char *optarg)
+{
+	opt_tlb_pages = get_uint64(optarg);
+	check_range("tlb-pages", opt_tlb_pages,
+		TLB_MIN_PAGES, TLB_MAX_PAGES);
+}
+
+/*
+ *  stress_set_tlb_page_size()
+ *	set the size of the pages accessed
+ */
+int stress_set_tlb_page_size(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(tlb_page_sizes); i++) {
+		if (!strcmp(tlb_page_sizes[i].name, name)) {
+			opt_tlb_page_size = &tlb_page_sizes[i];
+			return 0;
+		}
+	}
+	fprintf(stderr, "tlb-page-size must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(tlb_page_sizes); i++)
+		fprintf(stderr, " %s", tlb_page_sizes[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_tlb_la57()
+ *	check if the kernel uses 5-level page tables, a hint above
+ *	the 47 bit user address space can only be honoured with them
+ */
+static bool stress_tlb_la57(void)
+{
+#if defined(__x86_64__) || defined(__x86_64)
+	const size_t page_size = stress_get_pagesize();
+	void *ptr;
+	bool la57;
+
+	ptr = mmap((void *)(1ULL << 50), page_size, PROT_READ,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED)
+		return false;
+	la57 = ((uintptr_t)ptr >= (1ULL << 47));
+	(void)munmap(ptr, page_size);
+	return la57;
+#else
+	return false;
+#endif
+}
+
+/*
+ *  stress_tlb_mmap()
+ *	map enough address space for the largest sweep point, 4K
+ *	pages are advised against THP so they stay 4K, 2M pages
+ *	can fall back to THP but 1G pages must come from hugetlbfs
+ */
+static void *stress_tlb_mmap(const char *name, const size_t sz)
+{
+	const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+	void *ptr = MAP_FAILED;
+
+	switch (opt_tlb_page_size->size) {
+	case 4 * KB:
+		ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE, flags, -1, 0);
+#if defined(MADV_NOHUGEPAGE)
+		if (ptr != MAP_FAILED)
+			(void)madvise(ptr, sz, MADV_NOHUGEPAGE);
+#endif
+		break;
+	case 2 * MB:
+		ptr = mmap_hugepages(HUGEPAGES_2M, sz,
+			PROT_READ | PROT_WRITE, flags, -1);
+		break;
+	default:
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_1GB)
+		ptr = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+			(flags & ~MAP_NORESERVE) | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+#endif
+		if (ptr == MAP_FAILED)
+			pr_inf(stderr, "%s: cannot map 1G hugetlbfs pages, "
+				"see /sys/kernel/mm/hugepages/hugepages-"
+				"1048576kB/nr_hugepages\n", name);
+		return ptr;
+	}
+	if (ptr == MAP_FAILED)
+		pr_fail_err(name, "mmap");
+	return ptr;
+}
+
+/*
+ *  stress_tlb_ring()
+ *	link one cache line in each of the first n pages into a
+ *	random ring (Sattolo's shuffle, a single cycle) so every
+ *	access depends on the previous one and can't be prefetched.
+ *	The line used moves along each page so the lines spread
+ *	over the cache sets and stay cache hits, leaving the TLB
+ *	misses and page walks as the cost being measured
+ */
+static void **stress_tlb_ring(uint8_t *buf, const size_t n)
+{
+	const size_t page_sz = opt_tlb_page_size->size;
+	const size_t lines = page_sz / TLB_LINE;
+	size_t i;
+
+#define TLB_NODE(i)	((void **)(buf + ((i) * page_sz) + (((i) % lines) * TLB_LINE)))
+#define TLB_PERM(i)	(((size_t *)TLB_NODE(i))[1])
+
+	for (i = 0; i < n; i++)
+		TLB_PERM(i) = i;
+	for (i = n - 1; i > 0; i--) {
+		const size_t j = (size_t)(mwc64() % i);
+		const size_t tmp = TLB_PERM(i);
+
+		TLB_PERM(i) = TLB_PERM(j);
+		TLB_PERM(j) = tmp;
+	}
+	for (i = 0; i < n; i++)
+		*TLB_NODE(TLB_PERM(i)) = TLB_NODE(TLB_PERM((i + 1) % n));
+
+	return TLB_NODE(TLB_PERM(0));
+#undef TLB_NODE
+#undef TLB_PERM
+}
+
+#define TLB_CHASE4(p)	\
+	p = (void **)*p; p = (void **)*p; p = (void **)*p; p = (void **)*p;
+
+#define TLB_CHASE16(p)	\
+	TLB_CHASE4(p) TLB_CHASE4(p) TLB_CHASE4(p) TLB_CHASE4(p)
+
+/*
+ *  stress_tlb_chase()
+ *	time TLB_LOADS accesses around the ring, with --perf the
+ *	dTLB read misses are counted too, returns false if the
+ *	run was stopped part way
+ */
+static bool stress_tlb_chase(
+	void **p,
+	const size_t n,
+	double *nsec,
+	uint64_t *misses)
+{
+	size_t j;
+	double t;
+#if defined(STRESS_PERF_STATS)
+	stress_perf_t sp;
+	bool perf = false;
+#endif
+
+	/* One lap to fill the caches and the TLBs */
+	for (j = 0; j < n; j++)
+		p = (void **)*p;
+
+#if defined(STRESS_PERF_STATS)
+	if ((opt_flags & OPT_FLAGS_PERF_STATS) && !perf_open(&sp)) {
+		(void)perf_enable(&sp);
+		perf = true;
+	}
+#endif
+	t = time_now();
+	for (j = 0; j < TLB_LOADS; j += 16) {
+		TLB_CHASE16(p)
+		if (!(j & 0xffff) && !opt_do_run)
+			break;
+	}
+	t = time_now() - t;
+	*misses = TLB_NO_MISSES;
+#if defined(STRESS_PERF_STATS)
+	if (perf) {
+		uint64_t counter;
+		int idx;
+
+		(void)perf_disable(&sp);
+		(void)perf_close(&sp);
+		if (!perf_get_counter_by_id(&sp, STRESS_PERF_HW_CACHE_DTLB_READ_MISS,
+		    &counter, &idx) && (counter != STRESS_PERF_INVALID))
+			*misses = counter;
+	}
+#endif
+	/* Keep the chase from being optimised away */
+	if (!p)
+		return false;
+
+	*nsec = (t * 1000000000.0) / TLB_LOADS;
+	return j >= TLB_LOADS;
+}
+
+/*
+ *  stress_tlb()
+ *	measure TLB reach and page walk cost by chasing one cache
+ *	line per page, doubling the number of pages from TLB_MIN_PAGES
+ *	until --tlb-pages so the working set steps past the dTLB and
+ *	then the STLB entry counts
+ */
+int stress_tlb(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t page_sz = opt_tlb_page_size->size;
+	const uint64_t max_pages = opt_tlb_pages ?
+		opt_tlb_pages : opt_tlb_page_size->pages;
+	size_t sets[TLB_SETS], n_sets = 0, i;
+	double nsec[TLB_SETS];
+	uint64_t misses[TLB_SETS], samples[TLB_SETS];
+	bool perf = true;
+	uint8_t *buf;
+	size_t n;
+
+	for (n = TLB_MIN_PAGES; (n <= max_pages) && (n_sets < TLB_SETS); n <<= 1)
+		sets[n_sets++] = n;
+
+	buf = (uint8_t *)stress_tlb_mmap(name, max_pages * page_sz);
+	if (buf == MAP_FAILED)
+		return (page_sz == GB) ? EXIT_NO_RESOURCE : EXIT_FAILURE;
+
+	if (!instance)
+		pr_dbg(stderr, "%s: sweeping %zu to %zu %s pages, "
+			"%s page tables\n", name, sets[0],
+			sets[n_sets - 1], opt_tlb_page_size->name,
+			stress_tlb_la57() ? "5-level" : "4-level");
+
+	memset(nsec, 0, sizeof(nsec));
+	memset(misses, 0, sizeof(misses));
+	memset(samples, 0, sizeof(samples));
+
+	do {
+		for (i = 0; i < n_sets; i++) {
+			char desc[64];
+			void **p = stress_tlb_ring(buf, sets[i]);
+			double ns;
+			uint64_t miss;
+
+			if (!stress_tlb_chase(p, sets[i], &ns, &miss))
+				goto done;
+			nsec[i] += ns;
+			if (miss == TLB_NO_MISSES)
+				perf = false;
+			else
+				misses[i] += miss;
+			samples[i]++;
+			(*counter)++;
+
+			(void)snprintf(desc, sizeof(desc), "%zu %s pages (ns/access)",
+				sets[i], opt_tlb_page_size->name);
+			stress_misc_metric_set(i, desc, nsec[i] / samples[i]);
+			if (max_ops && (*counter >= max_ops))
+				goto done;
+		}
+	} while (opt_do_run);
+done:
+	if (page_sz != 4 * KB)
+		hugepages_metric_set(hugepages_mapped(buf,
+			(size_t)(max_pages * page_sz)));
+
+	if (!instance && samples[0]) {
+		pr_inf(stdout, "%s: %8s %12s %10s %14s\n", name, "pages",
+			"memory (MB)", "ns/access", "dTLB miss/acc");
+		for (i = 0; (i < n_sets) && samples[i]; i++) {
+			char buf_miss[16];
+
+			if (perf && (opt_flags & OPT_FLAGS_PERF_STATS))
+				(void)snprintf(buf_miss, sizeof(buf_miss), "%.3f",
+					(double)misses[i] / (samples[i] * (double)TLB_LOADS));
+			else
+				(void)snprintf(buf_miss, sizeof(buf_miss), "-");
+			pr_inf(stdout, "%s: %8zu %12.1f %10.2f %14s\n", name, sets[i],
+				(double)(sets[i] * page_sz) / (double)MB,
+				nsec[i] / samples[i], buf_miss);
+		}
+	}
+	(void)munmap((void *)buf, (size_t)(max_pages * page_sz));
+
+	return EXIT_SUCCESS;
+}
+
+#endif
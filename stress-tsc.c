@@ -32,13 +32,32 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <math.h>
+#include <sched.h>
+#include <time.h>
 
 #if defined(STRESS_TSC)
 
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
+
+#define TSC_SKEW_ROUNDS		(1000)	/* handshakes per CPU pair */
+
 static bool tsc_supported = false;
+static bool opt_tsc_skew = false;
 
 #include <cpuid.h>
 
+/*
+ *  stress_set_tsc_skew()
+ *	measure the TSC skew between CPUs rather than read the TSC
+ */
+void stress_set_tsc_skew(void)
+{
+	opt_tsc_skew = true;
+}
+
 /*
  *  stress_tsc_supported()
  *	check if tsc is supported
@@ -118,6 +137,240 @@ static inline void rdtsc(void)
 	rdtsc();	\
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+/* handshake between the CPUs of a pair, on one cache line */
+typedef struct {
+	volatile uint64_t seq;		/* odd: ping from a, even: pong from b */
+	volatile uint64_t t1;		/* b's TSC at the pong */
+	volatile bool stop;		/* a gave up, b should return */
+	int cpu;			/* b's CPU */
+} __attribute__((aligned(64))) tsc_skew_t;
+
+/* what a sweep over the CPU pairs found */
+typedef struct {
+	int64_t lo;			/* offset lower bound, ticks */
+	int64_t hi;			/* offset upper bound, ticks */
+	uint64_t rtt;			/* shortest round trip, ticks */
+	uint64_t backwards;		/* reads earlier than a causally prior read */
+} tsc_skew_pair_t;
+
+/*
+ *  tsc_read()
+ *	read the TSC, fenced so it is not moved across the handshake
+ */
+static inline uint64_t tsc_read(void)
+{
+	uint32_t lo, hi;
+
+	asm volatile("lfence\nrdtsc\nlfence" : "=a"(lo), "=d"(hi) : : "memory");
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ *  tsc_ns_per_tick()
+ *	time the TSC against CLOCK_MONOTONIC for 20 ms
+ */
+static double tsc_ns_per_tick(void)
+{
+	struct timespec ts0, ts1;
+	uint64_t t0, t1;
+	double ns;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts0);
+	t0 = tsc_read();
+	do {
+		(void)clock_gettime(CLOCK_MONOTONIC, &ts1);
+		ns = ((double)(ts1.tv_sec - ts0.tv_sec) * 1000000000.0) +
+			(double)(ts1.tv_nsec - ts0.tv_nsec);
+	} while (ns < 20000000.0);
+	t1 = tsc_read();
+
+	return (t1 > t0) ? ns / (double)(t1 - t0) : 1.0;
+}
+
+/*
+ *  stress_tsc_skew_pong()
+ *	b's side of the handshake, answer each ping with its TSC
+ */
+static void *stress_tsc_skew_pong(void *arg)
+{
+	tsc_skew_t *s = (tsc_skew_t *)arg;
+	cpu_set_t mask;
+	uint64_t i;
+
+	CPU_ZERO(&mask);
+	CPU_SET(s->cpu, &mask);
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+
+	for (i = 1; i <= TSC_SKEW_ROUNDS; i++) {
+		while (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != (2 * i) - 1) {
+			if (s->stop)
+				return NULL;
+		}
+		s->t1 = tsc_read();
+		__atomic_store_n(&s->seq, 2 * i, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+/*
+ *  stress_tsc_skew_pair()
+ *	ping pong between the calling thread on CPU a and a thread
+ *	on CPU b. a reads t0, pings, b reads t1 and pongs, a reads
+ *	t2, so b's offset from a is between t1 - t2 and t1 - t0.
+ *	The tightest bounds over all the rounds are kept, a read
+ *	earlier than one that causally preceded it is a backwards
+ *	step. Returns -1 if the pair could not be measured.
+ */
+static int stress_tsc_skew_pair(
+	const int a,
+	const int b,
+	tsc_skew_pair_t *pair)
+{
+	static tsc_skew_t s;
+	pthread_t pthread;
+	cpu_set_t mask;
+	uint64_t i;
+
+	CPU_ZERO(&mask);
+	CPU_SET(a, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask) < 0)
+		return -1;
+
+	s.seq = 0;
+	s.t1 = 0;
+	s.stop = false;
+	s.cpu = b;
+	if (pthread_create(&pthread, NULL, stress_tsc_skew_pong, &s) != 0)
+		return -1;
+
+	pair->lo = INT64_MIN;
+	pair->hi = INT64_MAX;
+	pair->rtt = UINT64_MAX;
+	pair->backwards = 0;
+
+	for (i = 1; i <= TSC_SKEW_ROUNDS; i++) {
+		uint64_t t0, t1, t2;
+
+		t0 = tsc_read();
+		__atomic_store_n(&s.seq, (2 * i) - 1, __ATOMIC_RELEASE);
+		while (__atomic_load_n(&s.seq, __ATOMIC_ACQUIRE) != 2 * i) {
+			if (!opt_do_run)
+				break;
+		}
+		if (!opt_do_run)
+			break;
+		t2 = tsc_read();
+		t1 = s.t1;
+
+		if ((int64_t)(t1 - t2) > pair->lo)
+			pair->lo = (int64_t)(t1 - t2);
+		if ((int64_t)(t1 - t0) < pair->hi)
+			pair->hi = (int64_t)(t1 - t0);
+		if (t2 - t0 < pair->rtt)
+			pair->rtt = t2 - t0;
+		if ((int64_t)(t1 - t0) < 0)
+			pair->backwards++;
+		if ((int64_t)(t2 - t1) < 0)
+			pair->backwards++;
+	}
+	s.stop = true;
+	(void)pthread_join(pthread, NULL);
+
+	return (i > TSC_SKEW_ROUNDS) ? 0 : -1;
+}
+
+/*
+ *  stress_tsc_skew()
+ *	measure the TSC offset of every pair of CPUs this worker
+ *	may run on and look for reads that go backwards across
+ *	CPUs, which says whether raw TSC time stamps taken on
+ *	different CPUs can be compared. One bogo op per sweep.
+ */
+static int stress_tsc_skew(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	cpu_set_t mask;
+	int cpus[CPU_SETSIZE], n = 0, i, j, worst_a = 0, worst_b = 0;
+	uint64_t pairs = 0, backwards = 0, skewed = 0, rtt = UINT64_MAX;
+	double ns_per_tick, max_offset = 0.0, max_bound = 0.0;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask) < 0) {
+		pr_fail_err(name, "sched_getaffinity");
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, &mask))
+			cpus[n++] = i;
+	if (n < 2) {
+		if (instance == 0)
+			pr_inf(stderr, "%s: --tsc-skew needs at least 2 CPUs, "
+				"only %d available\n", name, n);
+		return EXIT_NO_RESOURCE;
+	}
+	ns_per_tick = tsc_ns_per_tick();
+
+	do {
+		for (i = 0; opt_do_run && (i < n); i++) {
+			for (j = i + 1; opt_do_run && (j < n); j++) {
+				tsc_skew_pair_t pair;
+				double offset, bound;
+
+				if (stress_tsc_skew_pair(cpus[i], cpus[j], &pair) < 0)
+					continue;
+				pairs++;
+				backwards += pair.backwards;
+				if ((pair.lo > 0) || (pair.hi < 0))
+					skewed++;
+				if (pair.rtt < rtt)
+					rtt = pair.rtt;
+
+				offset = fabs(((double)pair.lo + (double)pair.hi) / 2.0) * ns_per_tick;
+				bound = (double)STRESS_MAXIMUM(llabs(pair.lo), llabs(pair.hi)) * ns_per_tick;
+				if (*counter == 0)
+					pr_dbg(stderr, "%s: CPU %d -> %d offset %.1f ns "
+						"(%.1f .. %.1f ns), %" PRIu64 " backwards\n",
+						name, cpus[i], cpus[j],
+						(((double)pair.lo + (double)pair.hi) / 2.0) * ns_per_tick,
+						(double)pair.lo * ns_per_tick,
+						(double)pair.hi * ns_per_tick, pair.backwards);
+				if (offset > max_offset) {
+					max_offset = offset;
+					worst_a = cpus[i];
+					worst_b = cpus[j];
+				}
+				if (bound > max_bound)
+					max_bound = bound;
+			}
+		}
+		(*counter)++;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	(void)sched_setaffinity(0, sizeof(mask), &mask);
+
+	if (!pairs)
+		return EXIT_SUCCESS;
+	if (instance == 0)
+		pr_inf(stderr, "%s: max TSC offset %.1f ns between CPUs %d "
+			"and %d, %" PRIu64 " backwards steps, raw TSC time "
+			"stamps %s be compared across CPUs\n",
+			name, max_offset, worst_a, worst_b, backwards,
+			(backwards || skewed) ? "cannot safely" : "can");
+
+	stress_misc_metric_set(0, "CPU pairs", (double)pairs / (double)*counter);
+	stress_misc_metric_set(1, "max offset ns", max_offset);
+	stress_misc_metric_set(2, "max offset bound ns", max_bound);
+	stress_misc_metric_set(3, "min round trip ns", (double)rtt * ns_per_tick);
+	stress_misc_metric_set(4, "backwards steps", (double)backwards);
+	stress_misc_metric_set(5, "pairs offset from 0", (double)skewed / (double)*counter);
+
+	return EXIT_SUCCESS;
+}
+#endif
+
 /*
  *  stress_tsc()
  *      stress Intel tsc instruction
@@ -131,6 +384,15 @@ int stress_tsc(
 	(void)instance;
 	(void)name;
 
+	if (tsc_supported && opt_tsc_skew) {
+#if defined(HAVE_LIB_PTHREAD)
+		return stress_tsc_skew(counter, instance, max_ops, name);
+#else
+		pr_inf(stderr, "%s: --tsc-skew needs pthreads\n", name);
+		return EXIT_NO_RESOURCE;
+#endif
+	}
+
 	if (tsc_supported) {
 		do {
 			TSCx32();
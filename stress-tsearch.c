@@ -78,13 +78,13 @@ int stress_tsearch(
 
 	(void)instance;
 
+	n = (size_t)opt_tsearch_size;
 	if (!set_tsearch_size) {
 		if (opt_flags & OPT_FLAGS_MAXIMIZE)
-			opt_tsearch_size = MAX_TSEARCH_SIZE;
+			n = MAX_TSEARCH_SIZE;
 		if (opt_flags & OPT_FLAGS_MINIMIZE)
-			opt_tsearch_size = MIN_TSEARCH_SIZE;
+			n = MIN_TSEARCH_SIZE;
 	}
-	n = (size_t)opt_tsearch_size;
 
 	if ((data = malloc(sizeof(int32_t) * n)) == NULL) {
 		pr_fail_dbg(name, "malloc");
@@ -36,6 +36,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #ifdef AF_INET6
@@ -58,8 +59,30 @@
 #define UDPLITE_RECV_CSCOV	(11)
 #endif
 
+#if defined(__linux__) && defined(__NR_sendmmsg) && NEED_GLIBC(2,14,0)
+#define HAVE_UDP_MMSG
+
+/* UDP GSO and GRO, Linux 4.18 and 5.0, see udp(7) */
+#if !defined(SOL_UDP)
+#define SOL_UDP			(17)
+#endif
+#if !defined(UDP_SEGMENT)
+#define UDP_SEGMENT		(103)
+#endif
+#if !defined(UDP_GRO)
+#define UDP_GRO			(104)
+#endif
+
+#define UDP_GSO_SEGS_MAX	(64)		/* kernel UDP_MAX_SEGMENTS */
+#define UDP_GSO_PAYLOAD_MAX	(65000)		/* below the IP datagram limit */
+#define UDP_GRO_BUF		(65536)		/* largest coalesced datagram */
+#endif
+
 static int opt_udp_domain = AF_INET;
 static int opt_udp_port = DEFAULT_SOCKET_PORT;
+static uint32_t opt_udp_batch = DEFAULT_UDP_BATCH;
+static uint32_t opt_udp_gso = 0;
+static bool opt_udp_gro = false;
 
 void stress_set_udp_port(const char *optarg)
 {
@@ -77,6 +100,218 @@ int stress_set_udp_domain(const char *name)
 	return stress_set_net_domain(DOMAIN_ALL, "udp-domain", name, &opt_udp_domain);
 }
 
+/*
+ *  stress_set_udp_batch()
+ *	set the number of datagrams per sendmmsg/recvmmsg call
+ */
+void stress_set_udp_batch(const char *optarg)
+{
+	uint64_t batch;
+
+	batch = get_uint64(optarg);
+	check_range("udp-batch", batch, MIN_UDP_BATCH, MAX_UDP_BATCH);
+	opt_udp_batch = (uint32_t)batch;
+}
+
+/*
+ *  stress_set_udp_gso()
+ *	set the UDP_SEGMENT segment size the sender uses
+ */
+void stress_set_udp_gso(const char *optarg)
+{
+	uint64_t size;
+
+	size = get_uint64_byte(optarg);
+	check_range("udp-gso", size, MIN_UDP_GSO_SIZE, MAX_UDP_GSO_SIZE);
+	opt_udp_gso = (uint32_t)size;
+}
+
+/*
+ *  stress_set_udp_gro()
+ *	enable UDP_GRO on the receiver
+ */
+void stress_set_udp_gro(void)
+{
+	opt_udp_gro = true;
+}
+
+#if defined(HAVE_UDP_MMSG)
+/*
+ *  stress_udp_client_mmsg()
+ *	send batches of datagrams with sendmmsg, with a
+ *	non-zero gso each message is a super datagram that
+ *	the kernel splits into gso sized segments
+ */
+static void stress_udp_client_mmsg(
+	const char *name,
+	const int fd,
+	struct sockaddr *addr,
+	const socklen_t addr_len,
+	uint32_t gso,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	const uint32_t batch = opt_udp_batch;
+	struct mmsghdr msgs[MAX_UDP_BATCH];
+	struct iovec iov;
+	uint32_t i, segs = 1;
+	uint64_t packets = 0, calls = 0;
+	size_t sz = UDP_BUF;
+	char *buf;
+
+	if (gso) {
+		int val = (int)gso;
+
+		if (setsockopt(fd, SOL_UDP, UDP_SEGMENT, &val, sizeof(val)) < 0) {
+			pr_dbg(stderr, "%s: setsockopt UDP_SEGMENT failed, "
+				"sending without GSO: errno=%d (%s)\n",
+				name, errno, strerror(errno));
+			gso = 0;
+		} else {
+			segs = UDP_GSO_PAYLOAD_MAX / gso;
+			if (segs > UDP_GSO_SEGS_MAX)
+				segs = UDP_GSO_SEGS_MAX;
+			sz = (size_t)segs * gso;
+		}
+	}
+	buf = malloc(sz);
+	if (!buf) {
+		pr_fail_dbg(name, "malloc");
+		return;
+	}
+	memset(buf, 'A', sz);
+	iov.iov_base = buf;
+	iov.iov_len = sz;
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < batch; i++) {
+		msgs[i].msg_hdr.msg_name = addr;
+		msgs[i].msg_hdr.msg_namelen = addr_len;
+		msgs[i].msg_hdr.msg_iov = &iov;
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do {
+		int ret;
+
+		ret = sendmmsg(fd, msgs, batch, 0);
+		if (ret < 0) {
+			/* receiver overrun, let it catch up */
+			if ((errno == ENOBUFS) || (errno == EAGAIN))
+				continue;
+			if (errno != EINTR)
+				pr_fail_dbg(name, "sendmmsg");
+			break;
+		}
+		/* Without a local server the client counts the sends */
+		if (stress_net_role() == NET_ROLE_CLIENT)
+			(*counter)++;
+		calls++;
+		packets += (uint64_t)ret * segs;
+		/* the server kills us when it is done, so update as we go */
+		if ((calls & 1023) == 0)
+			stress_misc_metric_set(2, "packets per send syscall",
+				(double)packets / (double)calls);
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	free(buf);
+}
+
+/*
+ *  stress_udp_server_mmsg()
+ *	receive batches of datagrams with recvmmsg, with gro
+ *	the kernel coalesces segments and the UDP_GRO control
+ *	message gives the segment size to count them by
+ */
+static int stress_udp_server_mmsg(
+	const char *name,
+	const int fd,
+	bool gro,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	uint64_t *calls)
+{
+	const uint32_t batch = opt_udp_batch;
+	struct mmsghdr msgs[MAX_UDP_BATCH];
+	struct iovec iov[MAX_UDP_BATCH];
+	char *cmsgs, *bufs;
+	const size_t cmsg_sz = CMSG_SPACE(sizeof(int));
+	size_t sz = (opt_udp_gso > UDP_BUF) ? opt_udp_gso : UDP_BUF;
+	uint32_t i;
+
+	if (gro) {
+		int val = 1;
+
+		if (setsockopt(fd, SOL_UDP, UDP_GRO, &val, sizeof(val)) < 0) {
+			pr_dbg(stderr, "%s: setsockopt UDP_GRO failed, "
+				"receiving without GRO: errno=%d (%s)\n",
+				name, errno, strerror(errno));
+			gro = false;
+		} else {
+			sz = UDP_GRO_BUF;
+		}
+	}
+	bufs = malloc((size_t)batch * sz);
+	cmsgs = calloc(batch, cmsg_sz);
+	if (!bufs || !cmsgs) {
+		pr_fail_dbg(name, "malloc");
+		free(cmsgs);
+		free(bufs);
+		return -1;
+	}
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < batch; i++) {
+		iov[i].iov_base = bufs + ((size_t)i * sz);
+		iov[i].iov_len = sz;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do {
+		int ret;
+
+		for (i = 0; i < batch; i++) {
+			msgs[i].msg_hdr.msg_control = gro ?
+				cmsgs + ((size_t)i * cmsg_sz) : NULL;
+			msgs[i].msg_hdr.msg_controllen = gro ? cmsg_sz : 0;
+		}
+		ret = recvmmsg(fd, msgs, batch, MSG_WAITFORONE, NULL);
+		if (ret == 0)
+			break;
+		if (ret < 0) {
+			if (errno != EINTR)
+				pr_fail_dbg(name, "recvmmsg");
+			break;
+		}
+		(*calls)++;
+		for (i = 0; i < (uint32_t)ret; i++) {
+			const uint32_t len = msgs[i].msg_len;
+			uint32_t segs = 1;
+			struct cmsghdr *cmsg;
+
+			for (cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg;
+			     cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+				if ((cmsg->cmsg_level == SOL_UDP) &&
+				    (cmsg->cmsg_type == UDP_GRO)) {
+					int seg_sz;
+
+					memcpy(&seg_sz, CMSG_DATA(cmsg), sizeof(seg_sz));
+					if (seg_sz > 0)
+						segs = (len + (uint32_t)seg_sz - 1) /
+							(uint32_t)seg_sz;
+				}
+			}
+			(*counter) += segs;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	free(cmsgs);
+	free(bufs);
+	return 0;
+}
+#endif
+
 /*
  *  handle_udp_sigalrm()
  *	catch SIGALRM
@@ -105,6 +340,26 @@ int stress_udp(
 #else
 	int proto = 0;
 #endif
+	uint32_t gso = opt_udp_gso;
+	bool gro = opt_udp_gro;
+	bool use_mmsg = false;
+	uint64_t calls = 0;
+	double t_start, duration;
+
+	if ((gso || gro) && (opt_udp_domain == AF_UNIX)) {
+		gso = 0;
+		gro = false;
+		if (instance == 0)
+			pr_inf(stderr, "%s: disabling UDP GSO and GRO as they "
+				"are not available for UNIX domain UDP\n", name);
+	}
+#if defined(HAVE_UDP_MMSG)
+	use_mmsg = (opt_udp_batch > 1) || gso || gro;
+#else
+	if (((opt_udp_batch > 1) || gso || gro) && (instance == 0))
+		pr_inf(stderr, "%s: --udp-batch, --udp-gso and --udp-gro "
+			"need sendmmsg, using sendto/recvfrom\n", name);
+#endif
 
 #if defined(OPT_UDP_LITE)
 	if ((proto == IPPROTO_UDPLITE) &&
@@ -122,13 +377,14 @@ int stress_udp(
 		name, getpid(), opt_udp_port + instance);
 
 again:
-	pid = fork();
+	/* A server only instance runs the server with no client */
+	pid = (stress_net_role() == NET_ROLE_SERVER) ? 0 : fork();
 	if (pid < 0) {
 		if (opt_do_run && (errno == EAGAIN))
 			goto again;
 		pr_fail_dbg(name, "fork");
 		return EXIT_FAILURE;
-	} else if (pid == 0) {
+	} else if ((pid == 0) && (stress_net_role() != NET_ROLE_SERVER)) {
 		/* Child, client */
 		struct sockaddr *addr = NULL;
 
@@ -152,7 +408,7 @@ again:
 			}
 			stress_set_sockaddr(name, instance, ppid,
 				opt_udp_domain, opt_udp_port,
-				&addr, &len, NET_ADDR_ANY);
+				&addr, &len, NET_ADDR_PEER);
 #if defined(OPT_UDP_LITE)
 			if (proto == IPPROTO_UDPLITE) {
 				val = 8;	/* Just the 8 byte header */
@@ -163,6 +419,14 @@ again:
 					exit(EXIT_FAILURE);
 				}
 			}
+#endif
+#if defined(HAVE_UDP_MMSG)
+			if (use_mmsg) {
+				stress_udp_client_mmsg(name, fd, addr, len,
+					gso, counter, max_ops);
+				(void)close(fd);
+				break;
+			}
 #endif
 			do {
 				size_t i;
@@ -176,6 +440,9 @@ again:
 						break;
 					}
 				}
+				/* Without a local server the client counts the sends */
+				if (stress_net_role() == NET_ROLE_CLIENT)
+					(*counter)++;
 			} while (opt_do_run && (!max_ops || *counter < max_ops));
 			(void)close(fd);
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
@@ -189,6 +456,8 @@ again:
 		/* Inform parent we're all done */
 		(void)kill(getppid(), SIGALRM);
 		exit(EXIT_SUCCESS);
+	} else if (stress_net_role() == NET_ROLE_CLIENT) {
+		return stress_net_client_wait(pid);
 	} else {
 		/* Parent, server */
 
@@ -236,6 +505,14 @@ again:
 			goto die_close;
 		}
 
+		t_start = time_now();
+#if defined(HAVE_UDP_MMSG)
+		if (use_mmsg) {
+			if (stress_udp_server_mmsg(name, fd, gro,
+					counter, max_ops, &calls) < 0)
+				rc = EXIT_FAILURE;
+		} else
+#endif
 		do {
 			socklen_t len = addr_len;
 			ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, addr, &len);
@@ -246,8 +523,17 @@ again:
 					pr_fail_dbg(name, "recvfrom");
 				break;
 			}
+			calls++;
 			(*counter)++;
 		} while (opt_do_run && (!max_ops || *counter < max_ops));
+		duration = time_now() - t_start;
+
+		if ((duration > 0.0) && calls) {
+			stress_misc_metric_set(0, "packets per second",
+				(double)*counter / duration);
+			stress_misc_metric_set(1, "packets per recv syscall",
+				(double)*counter / (double)calls);
+		}
 
 die_close:
 		(void)close(fd);
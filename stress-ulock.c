@@ -0,0 +1,458 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_ULOCK)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#define ULOCK_PHASE_TIME	(1.0)	/* seconds per method phase */
+#define ULOCK_RW_WRITE_RATIO	(8)	/* 1 in N rwlock acquisitions write */
+
+#define ULOCK_METHOD_MUTEX	(0)	/* pthread_mutex_t */
+#define ULOCK_METHOD_SPIN	(1)	/* pthread_spinlock_t */
+#define ULOCK_METHOD_TICKET	(2)	/* FIFO ticket lock */
+#define ULOCK_METHOD_MCS	(3)	/* MCS queue lock */
+#define ULOCK_METHOD_RWLOCK	(4)	/* pthread_rwlock_t */
+#define ULOCK_METHOD_MAX	(5)
+#define ULOCK_METHOD_ALL	(ULOCK_METHOD_MAX)
+
+typedef struct {
+	const char *name;	/* User option */
+	int method;		/* ULOCK_METHOD_ value */
+} ulock_method_t;
+
+static const ulock_method_t ulock_methods[] = {
+	{ "mutex",	ULOCK_METHOD_MUTEX },
+	{ "spin",	ULOCK_METHOD_SPIN },
+	{ "ticket",	ULOCK_METHOD_TICKET },
+	{ "mcs",	ULOCK_METHOD_MCS },
+	{ "rwlock",	ULOCK_METHOD_RWLOCK },
+	{ "all",	ULOCK_METHOD_ALL },
+};
+
+/* MCS queue node, one per thread, each on its own cache line */
+typedef struct ulock_mcs_node {
+	struct ulock_mcs_node *next;	/* next waiter in the queue */
+	uint32_t locked;		/* 1 whilst waiting */
+} __attribute__((aligned(64))) ulock_mcs_node_t;
+
+/* A contending thread */
+typedef struct {
+	pthread_t pthread;		/* the thread */
+	int ret;			/* pthread_create return */
+	int method;			/* lock method of this phase */
+	uint64_t acquisitions;		/* lock acquisitions this phase */
+	uint64_t writes;		/* exclusive acquisitions this phase */
+	ulock_mcs_node_t node;		/* MCS queue node */
+} ulock_thread_t;
+
+/* The locks and the data they protect */
+static struct {
+	pthread_mutex_t mutex;
+	pthread_spinlock_t spin;
+	pthread_rwlock_t rwlock;
+	uint32_t ticket_next __attribute__((aligned(64)));
+	uint32_t ticket_serving __attribute__((aligned(64)));
+	ulock_mcs_node_t *mcs_tail __attribute__((aligned(64)));
+	uint64_t data[8] __attribute__((aligned(64)));	/* critical section data */
+	uint64_t writes;		/* exclusive sections, protected */
+	bool run;			/* threads keep on contending */
+	bool go;			/* all threads at the start line */
+	uint32_t started;		/* threads at the start line */
+} ulock;
+
+static int opt_ulock_method = ULOCK_METHOD_ALL;
+static uint32_t opt_ulock_threads = DEFAULT_ULOCK_THREADS;
+static uint32_t opt_ulock_cs = DEFAULT_ULOCK_CS;
+
+/*
+ *  stress_set_ulock_method()
+ *	set the lock to contend on
+ */
+int stress_set_ulock_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(ulock_methods); i++) {
+		if (!strcmp(name, ulock_methods[i].name)) {
+			opt_ulock_method = ulock_methods[i].method;
+			return 0;
+		}
+	}
+	fprintf(stderr, "ulock-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(ulock_methods); i++)
+		fprintf(stderr, " %s", ulock_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_ulock_threads()
+ *	set the number of contending threads
+ */
+void stress_set_ulock_threads(const char *optarg)
+{
+	opt_ulock_threads = (uint32_t)get_uint64(optarg);
+	check_range("ulock-threads", opt_ulock_threads,
+		MIN_ULOCK_THREADS, MAX_ULOCK_THREADS);
+}
+
+/*
+ *  stress_set_ulock_cs()
+ *	set the critical section length in data updates
+ */
+void stress_set_ulock_cs(const char *optarg)
+{
+	opt_ulock_cs = (uint32_t)get_uint64(optarg);
+	check_range("ulock-cs", opt_ulock_cs,
+		MIN_ULOCK_CS, MAX_ULOCK_CS);
+}
+
+static inline void ulock_relax(void)
+{
+#if defined(STRESS_X86)
+	__builtin_ia32_pause();
+#else
+	__atomic_signal_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline void ulock_ticket_lock(void)
+{
+	const uint32_t ticket = __atomic_fetch_add(&ulock.ticket_next, 1,
+		__ATOMIC_RELAXED);
+
+	while (__atomic_load_n(&ulock.ticket_serving, __ATOMIC_ACQUIRE) != ticket)
+		ulock_relax();
+}
+
+static inline void ulock_ticket_unlock(void)
+{
+	const uint32_t serving = __atomic_load_n(&ulock.ticket_serving,
+		__ATOMIC_RELAXED);
+
+	__atomic_store_n(&ulock.ticket_serving, serving + 1, __ATOMIC_RELEASE);
+}
+
+static inline void ulock_mcs_lock(ulock_mcs_node_t *node)
+{
+	ulock_mcs_node_t *prev;
+
+	node->next = NULL;
+	node->locked = 1;
+	prev = __atomic_exchange_n(&ulock.mcs_tail, node, __ATOMIC_ACQ_REL);
+	if (!prev)
+		return;
+	__atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+	while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+		ulock_relax();
+}
+
+static inline void ulock_mcs_unlock(ulock_mcs_node_t *node)
+{
+	ulock_mcs_node_t *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+
+	if (!next) {
+		ulock_mcs_node_t *expected = node;
+
+		if (__atomic_compare_exchange_n(&ulock.mcs_tail, &expected,
+		    NULL, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			return;
+		/* A waiter is linking itself in */
+		while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+			ulock_relax();
+	}
+	__atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ *  ulock_critical_section()
+ *	update (or just read) the protected data
+ */
+static inline void ulock_critical_section(const bool write)
+{
+	volatile uint64_t *data = ulock.data;
+	uint64_t sum = 0;
+	uint32_t i;
+
+	if (write) {
+		for (i = 0; i < opt_ulock_cs; i++)
+			data[i & 7]++;
+		ulock.writes++;
+	} else {
+		for (i = 0; i < opt_ulock_cs; i++)
+			sum += data[i & 7];
+		(void)sum;
+	}
+}
+
+/*
+ *  ulock_thread()
+ *	contend on the lock of the current method
+ */
+static void *ulock_thread(void *arg)
+{
+	ulock_thread_t *t = (ulock_thread_t *)arg;
+	static void *nowt = NULL;
+
+	__atomic_add_fetch(&ulock.started, 1, __ATOMIC_RELEASE);
+	while (!__atomic_load_n(&ulock.go, __ATOMIC_ACQUIRE))
+		(void)sched_yield();
+	while (__atomic_load_n(&ulock.run, __ATOMIC_ACQUIRE)) {
+		switch (t->method) {
+		case ULOCK_METHOD_SPIN:
+			(void)pthread_spin_lock(&ulock.spin);
+			ulock_critical_section(true);
+			(void)pthread_spin_unlock(&ulock.spin);
+			t->writes++;
+			break;
+		case ULOCK_METHOD_TICKET:
+			ulock_ticket_lock();
+			ulock_critical_section(true);
+			ulock_ticket_unlock();
+			t->writes++;
+			break;
+		case ULOCK_METHOD_MCS:
+			ulock_mcs_lock(&t->node);
+			ulock_critical_section(true);
+			ulock_mcs_unlock(&t->node);
+			t->writes++;
+			break;
+		case ULOCK_METHOD_RWLOCK:
+			if ((t->acquisitions % ULOCK_RW_WRITE_RATIO) == 0) {
+				(void)pthread_rwlock_wrlock(&ulock.rwlock);
+				ulock_critical_section(true);
+				t->writes++;
+			} else {
+				(void)pthread_rwlock_rdlock(&ulock.rwlock);
+				ulock_critical_section(false);
+			}
+			(void)pthread_rwlock_unlock(&ulock.rwlock);
+			break;
+		default:
+			(void)pthread_mutex_lock(&ulock.mutex);
+			ulock_critical_section(true);
+			(void)pthread_mutex_unlock(&ulock.mutex);
+			t->writes++;
+			break;
+		}
+		t->acquisitions++;
+	}
+	return &nowt;
+}
+
+/*
+ *  ulock_phase()
+ *	contend on one lock method with all the threads for a
+ *	phase, returns the number of threads that ran or 0
+ */
+static uint32_t ulock_phase(
+	const char *name,
+	const int method,
+	ulock_thread_t *threads,
+	uint64_t *const counter,
+	const uint64_t max_ops,
+	double *duration)
+{
+	const uint64_t base = *counter;
+	uint32_t i, started = 0;
+	double t_start, t_end;
+	uint64_t writes = 0;
+
+	ulock.run = true;
+	ulock.go = false;
+	ulock.started = 0;
+	ulock.writes = 0;
+	for (i = 0; i < opt_ulock_threads; i++) {
+		threads[i].method = method;
+		threads[i].acquisitions = 0;
+		threads[i].writes = 0;
+		threads[i].ret = pthread_create(&threads[i].pthread, NULL,
+			ulock_thread, &threads[i]);
+		if (threads[i].ret)
+			break;
+		started++;
+	}
+	while (__atomic_load_n(&ulock.started, __ATOMIC_ACQUIRE) < started)
+		(void)sched_yield();
+	__atomic_store_n(&ulock.go, true, __ATOMIC_RELEASE);
+
+	t_start = time_now();
+	t_end = t_start + ULOCK_PHASE_TIME;
+	while (opt_do_run && (time_now() < t_end)) {
+		uint64_t total = base;
+
+		(void)usleep(10000);
+		for (i = 0; i < started; i++)
+			total += __atomic_load_n(&threads[i].acquisitions, __ATOMIC_RELAXED);
+		*counter = total;
+		if (max_ops && (total >= max_ops))
+			break;
+	}
+	__atomic_store_n(&ulock.run, false, __ATOMIC_RELEASE);
+	*duration = time_now() - t_start;
+
+	*counter = base;
+	for (i = 0; i < started; i++) {
+		(void)pthread_join(threads[i].pthread, NULL);
+		*counter += threads[i].acquisitions;
+		writes += threads[i].writes;
+	}
+
+	if ((opt_flags & OPT_FLAGS_VERIFY) && (writes != ulock.writes))
+		pr_fail(stderr, "%s: %s lock failed mutual exclusion, "
+			"%" PRIu64 " exclusive sections, %" PRIu64
+			" counted\n", name, ulock_methods[method].name,
+			writes, ulock.writes);
+	if (started < opt_ulock_threads)
+		pr_dbg(stderr, "%s: only %" PRIu32 " of %" PRIu32
+			" threads started\n", name, started, opt_ulock_threads);
+	return started;
+}
+
+/*
+ *  stress_ulock()
+ *	contend threads on user space lock implementations and
+ *	report acquisitions per second and fairness of each lock
+ */
+int stress_ulock(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	ulock_thread_t *threads;
+	uint64_t *per_thread;
+	uint64_t acquisitions[ULOCK_METHOD_MAX];
+	double durations[ULOCK_METHOD_MAX];
+	double fairness[ULOCK_METHOD_MAX];
+	uint32_t nthreads[ULOCK_METHOD_MAX];
+	bool reported = false;
+	int method, rc = EXIT_SUCCESS;
+	size_t idx = 0;
+
+	threads = calloc(opt_ulock_threads, sizeof(*threads));
+	per_thread = calloc((size_t)ULOCK_METHOD_MAX * opt_ulock_threads,
+		sizeof(*per_thread));
+	if (!threads || !per_thread) {
+		pr_err(stderr, "%s: cannot allocate %" PRIu32 " threads\n",
+			name, opt_ulock_threads);
+		free(threads);
+		free(per_thread);
+		return EXIT_NO_RESOURCE;
+	}
+	memset(acquisitions, 0, sizeof(acquisitions));
+	memset(durations, 0, sizeof(durations));
+	memset(fairness, 0, sizeof(fairness));
+	for (method = 0; method < ULOCK_METHOD_MAX; method++)
+		nthreads[method] = opt_ulock_threads;
+
+	(void)pthread_mutex_init(&ulock.mutex, NULL);
+	(void)pthread_spin_init(&ulock.spin, PTHREAD_PROCESS_PRIVATE);
+	(void)pthread_rwlock_init(&ulock.rwlock, NULL);
+
+	do {
+		for (method = 0; method < ULOCK_METHOD_MAX; method++) {
+			uint64_t *counts = &per_thread[(size_t)method * opt_ulock_threads];
+			uint64_t min = ~0ULL, max = 0;
+			const uint64_t before = *counter;
+			double duration;
+			uint32_t i, started;
+
+			if ((opt_ulock_method != ULOCK_METHOD_ALL) &&
+			    (opt_ulock_method != method))
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			started = ulock_phase(name, method, threads,
+				counter, max_ops, &duration);
+			if (!started) {
+				pr_inf(stderr, "%s: cannot create any threads\n", name);
+				rc = EXIT_NO_RESOURCE;
+				goto done;
+			}
+			if (started < nthreads[method])
+				nthreads[method] = started;
+			acquisitions[method] += *counter - before;
+			durations[method] += duration;
+
+			/* Fairness is the spread of the per-thread totals */
+			for (i = 0; i < started; i++)
+				counts[i] += threads[i].acquisitions;
+			for (i = 0; i < nthreads[method]; i++) {
+				if (counts[i] < min)
+					min = counts[i];
+				if (counts[i] > max)
+					max = counts[i];
+			}
+			fairness[method] = min ? (double)max / (double)min : 0.0;
+		}
+		if ((instance == 0) && !reported &&
+		    (opt_ulock_method == ULOCK_METHOD_ALL)) {
+			pr_inf(stderr, "%s: %7s %16s %10s\n", name,
+				"lock", "acquisitions/s", "max/min");
+			for (method = 0; method < ULOCK_METHOD_MAX; method++)
+				pr_inf(stderr, "%s: %7s %16.1f %10.2f\n", name,
+					ulock_methods[method].name,
+					(double)acquisitions[method] / durations[method],
+					fairness[method]);
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (method = 0; method < ULOCK_METHOD_MAX; method++) {
+		char desc[40];
+
+		if (durations[method] <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s acquisitions per sec",
+			ulock_methods[method].name);
+		stress_misc_metric_set(idx++, desc,
+			(double)acquisitions[method] / durations[method]);
+		(void)snprintf(desc, sizeof(desc), "%s fairness (max/min)",
+			ulock_methods[method].name);
+		stress_misc_metric_set(idx++, desc, fairness[method]);
+	}
+
+	(void)pthread_rwlock_destroy(&ulock.rwlock);
+	(void)pthread_spin_destroy(&ulock.spin);
+	(void)pthread_mutex_destroy(&ulock.mutex);
+	free(per_thread);
+	free(threads);
+
+	return rc;
+}
+#endif
@@ -32,11 +32,54 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <sched.h>
+#include <fcntl.h>
 #include <sys/wait.h>
 #include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#if defined(HAVE_SECCOMP_H)
+#include <stddef.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#endif
 
 #define MAX_PIDS	(32)
 
+/* the steps of building a container, in the order they are done */
+typedef enum {
+	CONTAINER_CGROUP = 0,		/* create and join a cgroup */
+	CONTAINER_UNSHARE,		/* all the namespaces at once */
+	CONTAINER_PIVOT_ROOT,		/* pivot_root onto a fresh tmpfs */
+	CONTAINER_SECCOMP,		/* install a seccomp filter */
+	CONTAINER_STEPS
+} container_step_t;
+
+static const char *container_steps[CONTAINER_STEPS] = {
+	"cgroup",
+	"unshare",
+	"pivot_root",
+	"seccomp",
+};
+
+/* what one container child reports back, a negative time is a failure */
+typedef struct {
+	double usec[CONTAINER_STEPS];	/* microseconds per step */
+} container_t;
+
+static uint32_t opt_unshare_container = 0;
+
+void stress_set_unshare_container(const char *optarg)
+{
+	uint64_t containers;
+
+	containers = get_uint64(optarg);
+	check_range("unshare-container", containers,
+		MIN_UNSHARE_CONTAINER, MAX_UNSHARE_CONTAINER);
+	opt_unshare_container = (uint32_t)containers;
+}
+
 #define UNSHARE(flags)	\
 	sys_unshare(name, flags, #flags);
 
@@ -58,6 +101,316 @@ static void sys_unshare(const char *name, int flags, const char *flags_name)
 	}
 }
 
+/*
+ *  container_cgroup()
+ *	create a cgroup under our own one and join it
+ */
+static int container_cgroup(const char *cgroup)
+{
+	char path[PATH_MAX], pid[32];
+	int fd, ret;
+
+	if (!*cgroup)
+		return -1;
+	if ((mkdir(cgroup, S_IRWXU) < 0) && (errno != EEXIST))
+		return -1;
+	(void)snprintf(path, sizeof(path), "%s/cgroup.procs", cgroup);
+	if ((fd = open(path, O_WRONLY)) < 0)
+		return -1;
+	(void)snprintf(pid, sizeof(pid), "%d\n", (int)getpid());
+	ret = write(fd, pid, strlen(pid));
+	(void)close(fd);
+
+	return (ret < 0) ? -1 : 0;
+}
+
+/*
+ *  container_unshare()
+ *	new namespaces of every kind, a user namespace too when
+ *	not root so that the rest of the steps are permitted
+ */
+static int container_unshare(void)
+{
+	int flags = 0;
+
+#if defined(CLONE_NEWNS)
+	flags |= CLONE_NEWNS;
+#endif
+#if defined(CLONE_NEWUTS)
+	flags |= CLONE_NEWUTS;
+#endif
+#if defined(CLONE_NEWIPC)
+	flags |= CLONE_NEWIPC;
+#endif
+#if defined(CLONE_NEWNET)
+	flags |= CLONE_NEWNET;
+#endif
+#if defined(CLONE_NEWPID)
+	flags |= CLONE_NEWPID;
+#endif
+#if defined(CLONE_NEWCGROUP)
+	flags |= CLONE_NEWCGROUP;
+#endif
+#if defined(CLONE_NEWUSER)
+	if (geteuid() != 0)
+		flags |= CLONE_NEWUSER;
+#endif
+#if NEED_GLIBC(2,14,0)
+	return unshare(flags);
+#else
+	return (int)syscall(__NR_unshare, flags);
+#endif
+}
+
+/*
+ *  container_pivot_root()
+ *	mount a tmpfs on root, pivot into it and detach the old root
+ */
+static int container_pivot_root(const char *root)
+{
+#if defined(__NR_pivot_root) && defined(MS_PRIVATE) && defined(MNT_DETACH)
+	char old[PATH_MAX];
+
+	if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) < 0)
+		return -1;
+	if (mount("tmpfs", root, "tmpfs", 0, "size=1m") < 0)
+		return -1;
+	(void)snprintf(old, sizeof(old), "%s/old", root);
+	if (mkdir(old, S_IRWXU) < 0)
+		return -1;
+	if (syscall(__NR_pivot_root, root, old) < 0)
+		return -1;
+	if (chdir("/") < 0)
+		return -1;
+	return umount2("/old", MNT_DETACH);
+#else
+	(void)root;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  container_seccomp()
+ *	install a small filter that denies a few syscalls
+ */
+static int container_seccomp(void)
+{
+#if defined(HAVE_SECCOMP_H) && defined(SECCOMP_MODE_FILTER) && \
+    defined(__NR_kexec_load) && defined(__NR_reboot)
+	static struct sock_filter filter[] = {
+		BPF_STMT(BPF_LD+BPF_W+BPF_ABS, offsetof(struct seccomp_data, nr)),
+		BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K, __NR_kexec_load, 2, 0),
+		BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K, __NR_reboot, 1, 0),
+		BPF_STMT(BPF_RET+BPF_K, SECCOMP_RET_ALLOW),
+		BPF_STMT(BPF_RET+BPF_K, SECCOMP_RET_ERRNO | EPERM),
+	};
+	struct sock_fprog prog = {
+		.len = (unsigned short)SIZEOF_ARRAY(filter),
+		.filter = filter
+	};
+
+	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0)
+		return -1;
+	return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  container_child()
+ *	build one container, timing each step, a failed step is
+ *	reported as a negative time and ends the build
+ */
+static void container_child(
+	container_t *container,
+	const char *cgroup,
+	const char *root)
+{
+	container_step_t step;
+
+	(void)setpgid(0, pgrp);
+	stress_parent_died_alarm();
+
+	for (step = 0; step < CONTAINER_STEPS; step++) {
+		double t = time_now();
+		int ret;
+
+		switch (step) {
+		case CONTAINER_CGROUP:
+			ret = container_cgroup(cgroup);
+			break;
+		case CONTAINER_UNSHARE:
+			ret = container_unshare();
+			break;
+		case CONTAINER_PIVOT_ROOT:
+			ret = container_pivot_root(root);
+			break;
+		default:
+			ret = container_seccomp();
+			break;
+		}
+		t = time_now() - t;
+		container->usec[step] = (ret < 0) ? -1.0 : t * 1000000.0;
+		if (ret < 0)
+			_exit(EXIT_FAILURE);
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/*
+ *  stress_unshare_container()
+ *	build containers as a container runtime would, 1, 2, 4 ..
+ *	at once up to --unshare-container, reporting the latency of
+ *	each step and the containers per second at each concurrency.
+ *	One bogo op per container built.
+ */
+static int stress_unshare_container(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const pid_t self = getpid();
+	const size_t sz = sizeof(container_t) * MAX_PIDS;
+	container_t *containers;
+	char cgroup_self[PATH_MAX], dir[PATH_MAX];
+	double usec[CONTAINER_STEPS], rate_time[MAX_PIDS + 1];
+	uint64_t steps[CONTAINER_STEPS], rate_count[MAX_PIDS + 1];
+	bool warned[CONTAINER_STEPS];
+	uint32_t level = 1, i, n;
+	int ret, rc = EXIT_SUCCESS;
+
+	containers = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+		MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+	if (containers == MAP_FAILED) {
+		pr_fail_dbg(name, "mmap");
+		return EXIT_NO_RESOURCE;
+	}
+	ret = stress_temp_dir_mk(name, self, instance);
+	if (ret < 0) {
+		(void)munmap(containers, sz);
+		return exit_status(-ret);
+	}
+	(void)stress_temp_dir(dir, sizeof(dir), name, self, instance);
+	if (stress_cgroup_self(cgroup_self, sizeof(cgroup_self)) < 0)
+		*cgroup_self = '\0';
+
+	(void)memset(usec, 0, sizeof(usec));
+	(void)memset(steps, 0, sizeof(steps));
+	(void)memset(warned, 0, sizeof(warned));
+	(void)memset(rate_time, 0, sizeof(rate_time));
+	(void)memset(rate_count, 0, sizeof(rate_count));
+
+	do {
+		pid_t pids[MAX_PIDS];
+		char cgroups[MAX_PIDS][PATH_MAX], roots[MAX_PIDS][PATH_MAX];
+		uint32_t built = 0;
+		double t;
+
+		/* Each container gets its own root and cgroup */
+		for (n = 0; n < level; n++) {
+			if (snprintf(roots[n], sizeof(roots[n]), "%s/c%" PRIu32,
+				     dir, n) >= (int)sizeof(roots[n]))
+				break;
+			(void)mkdir(roots[n], S_IRWXU);
+			if (!*cgroup_self ||
+			    (snprintf(cgroups[n], sizeof(cgroups[n]),
+				      "%s/stress-ng-%d-c%" PRIu32, cgroup_self,
+				      (int)self, n) >= (int)sizeof(cgroups[n])))
+				*cgroups[n] = '\0';
+		}
+		if (n < level) {
+			pr_inf(stderr, "%s: container root under %s is too "
+				"long, skipping stressor\n", name, dir);
+			for (i = 0; i < n; i++)
+				(void)rmdir(roots[i]);
+			rc = EXIT_NO_RESOURCE;
+			break;
+		}
+		(void)memset(containers, 0, sz);
+
+		t = time_now();
+		for (n = 0; n < level; n++) {
+			if (!opt_do_run)
+				break;
+			pids[n] = fork();
+			if (pids[n] < 0)
+				break;
+			if (pids[n] == 0)
+				container_child(&containers[n], cgroups[n], roots[n]);
+		}
+		for (i = 0; i < n; i++) {
+			int status;
+
+			(void)waitpid(pids[i], &status, 0);
+			if (WIFEXITED(status) &&
+			    (WEXITSTATUS(status) == EXIT_SUCCESS))
+				built++;
+		}
+		t = time_now() - t;
+
+		for (i = 0; i < n; i++) {
+			container_step_t step;
+
+			for (step = 0; step < CONTAINER_STEPS; step++) {
+				const double us = containers[i].usec[step];
+
+				if (us > 0.0) {
+					usec[step] += us;
+					steps[step]++;
+				} else if ((us < 0.0) && !warned[step]) {
+					pr_inf(stderr, "%s: container %s step "
+						"failed, containers are not "
+						"complete\n", name,
+						container_steps[step]);
+					warned[step] = true;
+				}
+			}
+			if (*cgroups[i])
+				(void)rmdir(cgroups[i]);
+			(void)rmdir(roots[i]);
+		}
+		if ((n == level) && (built == level)) {
+			rate_time[level] += t;
+			rate_count[level] += built;
+		}
+		(*counter) += built;
+		if (!built && !steps[CONTAINER_CGROUP] &&
+		    !steps[CONTAINER_UNSHARE])
+			break;
+
+		level = (level >= opt_unshare_container) ? 1 : level * 2;
+		if (level > opt_unshare_container)
+			level = opt_unshare_container;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	for (i = 0; i < CONTAINER_STEPS; i++) {
+		char desc[32];
+
+		if (!steps[i])
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s usec", container_steps[i]);
+		stress_misc_metric_set(i, desc, usec[i] / steps[i]);
+	}
+	for (n = 0, level = 1; level <= MAX_PIDS; level *= 2, n++) {
+		char desc[32];
+
+		if (rate_time[level] <= 0.0)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "containers/sec @ %" PRIu32,
+			level);
+		stress_misc_metric_set(CONTAINER_STEPS + n, desc,
+			rate_count[level] / rate_time[level]);
+	}
+	(void)stress_temp_dir_rm(name, self, instance);
+	(void)munmap(containers, sz);
+
+	return rc;
+}
+
 /*
  *  stress_unshare()
  *	stress resource unsharing
@@ -70,7 +423,8 @@ int stress_unshare(
 {
 	pid_t pids[MAX_PIDS];
 
-	(void)instance;
+	if (opt_unshare_container)
+		return stress_unshare_container(counter, instance, max_ops, name);
 
 	do {
 		size_t i, n;
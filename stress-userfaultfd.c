@@ -42,9 +42,38 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <linux/userfaultfd.h>
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
 
 #define STACK_SIZE	(64 * 1024)
 
+#define UFFD_MODE_COPY		(0)	/* UFFDIO_COPY a source page */
+#define UFFD_MODE_ZEROPAGE	(1)	/* UFFDIO_ZEROPAGE */
+#define UFFD_MODE_WP		(2)	/* write protect, UFFDIO_WRITEPROTECT */
+#define UFFD_MODE_CONTINUE	(3)	/* shmem minor faults, UFFDIO_CONTINUE */
+
+#define UFFD_MSG_BATCH		(16)	/* fault messages per read */
+
+typedef struct {
+	const char *name;	/* User option */
+	int mode;		/* UFFD_MODE_ value */
+} uffd_mode_t;
+
+static const uffd_mode_t uffd_modes[] = {
+	{ "copy",	UFFD_MODE_COPY },
+	{ "zeropage",	UFFD_MODE_ZEROPAGE },
+#if defined(UFFDIO_WRITEPROTECT) &&		\
+    defined(UFFD_FEATURE_PAGEFAULT_FLAG_WP)
+	{ "wp",		UFFD_MODE_WP },
+#endif
+#if defined(UFFDIO_CONTINUE) &&			\
+    defined(UFFD_FEATURE_MINOR_SHMEM) &&	\
+    defined(__NR_memfd_create)
+	{ "continue",	UFFD_MODE_CONTINUE },
+#endif
+};
+
 /* Context for clone */
 typedef struct {
 	uint8_t *data;
@@ -59,6 +88,13 @@ typedef struct {
 static size_t opt_userfaultfd_bytes = DEFAULT_MMAP_BYTES;
 static bool set_userfaultfd_bytes = false;
 
+/* Handler pool mode, enabled by any of the pool options */
+static bool opt_userfaultfd_pool = false;
+static int opt_userfaultfd_mode = UFFD_MODE_COPY;
+static uint32_t opt_userfaultfd_handlers = DEFAULT_USERFAULTFD_HANDLERS;
+static uint32_t opt_userfaultfd_faulters = DEFAULT_USERFAULTFD_FAULTERS;
+static uint32_t opt_userfaultfd_prefault = DEFAULT_USERFAULTFD_PREFAULT;
+
 static int sys_userfaultfd(int flags)
 {
 	return syscall(__NR_userfaultfd, flags);
@@ -72,6 +108,52 @@ void stress_set_userfaultfd_bytes(const char *optarg)
 		MIN_MMAP_BYTES, MAX_MMAP_BYTES);
 }
 
+/*
+ *  stress_set_userfaultfd_mode()
+ *	set the fault resolution mode of the handler pool
+ */
+int stress_set_userfaultfd_mode(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(uffd_modes); i++) {
+		if (!strcmp(name, uffd_modes[i].name)) {
+			opt_userfaultfd_mode = uffd_modes[i].mode;
+			opt_userfaultfd_pool = true;
+			return 0;
+		}
+	}
+	fprintf(stderr, "userfaultfd-mode must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(uffd_modes); i++)
+		fprintf(stderr, " %s", uffd_modes[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+void stress_set_userfaultfd_handlers(const char *optarg)
+{
+	opt_userfaultfd_pool = true;
+	opt_userfaultfd_handlers = (uint32_t)get_uint64(optarg);
+	check_range("userfaultfd-handlers", opt_userfaultfd_handlers,
+		MIN_USERFAULTFD_HANDLERS, MAX_USERFAULTFD_HANDLERS);
+}
+
+void stress_set_userfaultfd_faulters(const char *optarg)
+{
+	opt_userfaultfd_pool = true;
+	opt_userfaultfd_faulters = (uint32_t)get_uint64(optarg);
+	check_range("userfaultfd-faulters", opt_userfaultfd_faulters,
+		MIN_USERFAULTFD_FAULTERS, MAX_USERFAULTFD_FAULTERS);
+}
+
+void stress_set_userfaultfd_prefault(const char *optarg)
+{
+	opt_userfaultfd_pool = true;
+	opt_userfaultfd_prefault = (uint32_t)get_uint64(optarg);
+	check_range("userfaultfd-prefault", opt_userfaultfd_prefault,
+		MIN_USERFAULTFD_PREFAULT, MAX_USERFAULTFD_PREFAULT);
+}
+
 /*
  *  stress_child_alarm_handler()
  *	SIGALRM handler to terminate child immediately
@@ -159,6 +241,514 @@ static inline int handle_page_fault(
 	return 0;
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+/* Handler pool state shared by the handler and faulter threads */
+typedef struct {
+	const char *name;		/* stressor name */
+	int fd;				/* userfaultfd */
+	int mode;			/* UFFD_MODE_ of the pool */
+	uint8_t *data;			/* registered region */
+	uint8_t *alias;			/* second shmem mapping, continue mode */
+	size_t sz;			/* region size */
+	size_t page_size;		/* page size */
+	void *src_page;			/* UFFDIO_COPY source page */
+	volatile uint8_t *resolved;	/* per page, set when a handler resolved it */
+	volatile bool faulting;		/* faulters keep on faulting */
+	volatile bool handling;		/* handlers keep on handling */
+	uint64_t faults;		/* fault messages handled */
+	uint64_t pages;			/* pages resolved, including prefaults */
+	volatile bool failed;		/* a resolve ioctl failed */
+} uffd_pool_t;
+
+/* A handler or faulter thread */
+typedef struct {
+	pthread_t pthread;		/* the thread */
+	int ret;			/* pthread_create return */
+	uffd_pool_t *pool;		/* the shared pool */
+	size_t first;			/* first page of a faulter's slice */
+	size_t count;			/* pages in a faulter's slice */
+	stress_latency_t lat;		/* faulter fault resolution latencies */
+} uffd_thread_t;
+
+/*
+ *  uffd_pool_wake()
+ *	wake the threads blocked on a page that
+ *	another handler already resolved
+ */
+static void uffd_pool_wake(uffd_pool_t *pool, const unsigned long addr)
+{
+	struct uffdio_range range;
+
+	range.start = addr;
+	range.len = pool->page_size;
+	(void)ioctl(pool->fd, UFFDIO_WAKE, &range);
+}
+
+/*
+ *  uffd_pool_resolve()
+ *	resolve a fault on page addr and prefault the pages after
+ *	it in the same ioctl, returns the pages resolved or -1
+ */
+static ssize_t uffd_pool_resolve(uffd_pool_t *pool, const unsigned long addr)
+{
+	const unsigned long end = (unsigned long)pool->data + pool->sz;
+	unsigned long len = (unsigned long)opt_userfaultfd_prefault * pool->page_size;
+	int64_t done = 0;
+	int ret;
+
+	if (addr + len > end)
+		len = end - addr;
+
+	switch (pool->mode) {
+	case UFFD_MODE_ZEROPAGE: {
+		struct uffdio_zeropage zeropage;
+
+		zeropage.range.start = addr;
+		zeropage.range.len = len;
+		zeropage.mode = 0;
+		zeropage.zeropage = 0;
+		ret = ioctl(pool->fd, UFFDIO_ZEROPAGE, &zeropage);
+		done = zeropage.zeropage;
+		break;
+	}
+#if defined(UFFDIO_WRITEPROTECT) &&		\
+    defined(UFFD_FEATURE_PAGEFAULT_FLAG_WP)
+	case UFFD_MODE_WP: {
+		struct uffdio_writeprotect wp;
+
+		wp.range.start = addr;
+		wp.range.len = len;
+		wp.mode = 0;
+		ret = ioctl(pool->fd, UFFDIO_WRITEPROTECT, &wp);
+		done = (ret < 0) ? -errno : (int64_t)len;
+		break;
+	}
+#endif
+#if defined(UFFDIO_CONTINUE) &&			\
+    defined(UFFD_FEATURE_MINOR_SHMEM) &&	\
+    defined(__NR_memfd_create)
+	case UFFD_MODE_CONTINUE: {
+		struct uffdio_continue cont;
+
+		cont.range.start = addr;
+		cont.range.len = len;
+		cont.mode = 0;
+		cont.mapped = 0;
+		ret = ioctl(pool->fd, UFFDIO_CONTINUE, &cont);
+		done = cont.mapped;
+		break;
+	}
+#endif
+	default: {
+		unsigned long off;
+
+		/* One ioctl per page, the source is a single page */
+		for (ret = 0, off = 0; off < len; off += pool->page_size) {
+			struct uffdio_copy copy;
+
+			copy.dst = addr + off;
+			copy.src = (unsigned long)pool->src_page;
+			copy.len = pool->page_size;
+			copy.mode = 0;
+			copy.copy = 0;
+			ret = ioctl(pool->fd, UFFDIO_COPY, &copy);
+			if (ret < 0) {
+				if (!off)
+					done = copy.copy;
+				break;
+			}
+			done = (int64_t)(off + pool->page_size);
+		}
+		break;
+	}
+	}
+	/*
+	 *  A racing handler may have resolved the page, or the start
+	 *  of the batch, already, make sure the faulter is woken
+	 */
+	if ((ret < 0) && (done == -EEXIST || errno == EEXIST)) {
+		uffd_pool_wake(pool, addr);
+		return 0;
+	}
+	if ((ret < 0) && (done <= 0))
+		return -1;
+	return (ssize_t)(done / (int64_t)pool->page_size);
+}
+
+/*
+ *  uffd_handler()
+ *	read batches of fault messages and resolve them
+ */
+static void *uffd_handler(void *arg)
+{
+	static void *nowt = NULL;
+	uffd_thread_t *t = (uffd_thread_t *)arg;
+	uffd_pool_t *pool = t->pool;
+
+	while (pool->handling) {
+		struct uffd_msg msgs[UFFD_MSG_BATCH];
+		struct pollfd fds[1];
+		ssize_t ret, i, n;
+
+		fds[0].fd = pool->fd;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+		if (poll(fds, 1, 100) <= 0)
+			continue;
+		ret = read(pool->fd, msgs, sizeof(msgs));
+		if (ret < 0)
+			continue;	/* EAGAIN, another handler took it */
+		n = ret / (ssize_t)sizeof(msgs[0]);
+		for (i = 0; i < n; i++) {
+			const unsigned long addr =
+				(unsigned long)msgs[i].arg.pagefault.address &
+				~((unsigned long)pool->page_size - 1);
+			ssize_t pages;
+
+			if (msgs[i].event != UFFD_EVENT_PAGEFAULT)
+				continue;
+			if ((addr < (unsigned long)pool->data) ||
+			    (addr >= (unsigned long)pool->data + pool->sz)) {
+				pr_fail_err(pool->name, "userfaultfd page fault address out of range");
+				continue;
+			}
+			pages = uffd_pool_resolve(pool, addr);
+			if (pages < 0) {
+				if (!pool->failed)
+					pr_fail_err(pool->name, "userfaultfd resolve ioctl");
+				pool->failed = true;
+				uffd_pool_wake(pool, addr);
+				continue;
+			}
+			pool->resolved[(addr - (unsigned long)pool->data) / pool->page_size] = 1;
+			__atomic_add_fetch(&pool->faults, 1, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&pool->pages, (uint64_t)pages, __ATOMIC_RELAXED);
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  uffd_faulter()
+ *	write to each page of a slice, timing the writes that
+ *	a handler had to resolve, then drop or write protect
+ *	the slice again so the next pass faults once more
+ */
+static void *uffd_faulter(void *arg)
+{
+	static void *nowt = NULL;
+	uffd_thread_t *t = (uffd_thread_t *)arg;
+	uffd_pool_t *pool = t->pool;
+	uint8_t *start = pool->data + (t->first * pool->page_size);
+	const size_t len = t->count * pool->page_size;
+
+	while (pool->faulting && !pool->failed) {
+		size_t i;
+
+		for (i = 0; i < t->count; i++) {
+			const size_t idx = t->first + i;
+			const uint64_t t_start = time_now_ns();
+
+			*(volatile uint8_t *)(start + (i * pool->page_size)) = (uint8_t)i;
+			if (pool->resolved[idx]) {
+				latency_record(&t->lat, time_now_ns() - t_start);
+				pool->resolved[idx] = 0;
+			}
+			if (!pool->faulting)
+				break;
+		}
+
+#if defined(UFFDIO_WRITEPROTECT) &&		\
+    defined(UFFD_FEATURE_PAGEFAULT_FLAG_WP)
+		if (pool->mode == UFFD_MODE_WP) {
+			struct uffdio_writeprotect wp;
+
+			wp.range.start = (unsigned long)start;
+			wp.range.len = len;
+			wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+			if (ioctl(pool->fd, UFFDIO_WRITEPROTECT, &wp) < 0) {
+				pr_fail_err(pool->name, "userfaultfd write protect");
+				pool->failed = true;
+			}
+			continue;
+		}
+#endif
+		if (madvise(start, len, MADV_DONTNEED) < 0) {
+			pr_fail_err(pool->name, "userfaultfd madvise failed");
+			pool->failed = true;
+		}
+	}
+	return &nowt;
+}
+
+/*
+ *  uffd_pool_setup()
+ *	map and register the region for the pool mode,
+ *	returns an exit status
+ */
+static int uffd_pool_setup(uffd_pool_t *pool, int *memfd)
+{
+	struct uffdio_api api;
+	struct uffdio_register reg;
+	uint64_t features = 0, mode = UFFDIO_REGISTER_MODE_MISSING;
+
+	*memfd = -1;
+	pool->data = MAP_FAILED;
+	pool->alias = MAP_FAILED;
+
+#if defined(UFFDIO_CONTINUE) &&			\
+    defined(UFFD_FEATURE_MINOR_SHMEM) &&	\
+    defined(__NR_memfd_create)
+	if (pool->mode == UFFD_MODE_CONTINUE) {
+		/* Populate the page cache via an alias, fault minor via data */
+		*memfd = (int)syscall(__NR_memfd_create, "stress-userfaultfd", 0);
+		if (*memfd < 0) {
+			pr_inf(stderr, "%s: memfd_create failed, errno = %d (%s)\n",
+				pool->name, errno, strerror(errno));
+			return EXIT_NO_RESOURCE;
+		}
+		if (ftruncate(*memfd, (off_t)pool->sz) < 0) {
+			pr_inf(stderr, "%s: ftruncate failed, errno = %d (%s)\n",
+				pool->name, errno, strerror(errno));
+			return EXIT_NO_RESOURCE;
+		}
+		pool->alias = mmap(NULL, pool->sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED, *memfd, 0);
+		if (pool->alias == MAP_FAILED)
+			return EXIT_NO_RESOURCE;
+		(void)memset(pool->alias, 0xaa, pool->sz);
+		pool->data = mmap(NULL, pool->sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED, *memfd, 0);
+		features = UFFD_FEATURE_MINOR_SHMEM;
+		mode = UFFDIO_REGISTER_MODE_MINOR;
+	} else
+#endif
+	{
+		pool->data = mmap(NULL, pool->sz, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	if (pool->data == MAP_FAILED) {
+		pr_err(stderr, "%s: mmap failed\n", pool->name);
+		return EXIT_NO_RESOURCE;
+	}
+#if defined(UFFDIO_WRITEPROTECT) &&		\
+    defined(UFFD_FEATURE_PAGEFAULT_FLAG_WP)
+	if (pool->mode == UFFD_MODE_WP) {
+		/* Write protection only applies to present pages */
+		(void)memset(pool->data, 0xaa, pool->sz);
+		features = UFFD_FEATURE_PAGEFAULT_FLAG_WP;
+		mode = UFFDIO_REGISTER_MODE_WP;
+	}
+#endif
+
+	pool->fd = sys_userfaultfd(O_NONBLOCK | O_CLOEXEC);
+	if (pool->fd < 0) {
+		pr_err(stderr, "%s: userfaultfd failed, errno = %d (%s)\n",
+			pool->name, errno, strerror(errno));
+		return exit_status(errno);
+	}
+	memset(&api, 0, sizeof(api));
+	api.api = UFFD_API;
+	api.features = features;
+	if ((ioctl(pool->fd, UFFDIO_API, &api) < 0) ||
+	    ((api.features & features) != features)) {
+		pr_inf(stderr, "%s: userfaultfd %s mode is not supported "
+			"by this kernel, skipping stressor\n",
+			pool->name, uffd_modes[pool->mode].name);
+		return EXIT_NO_RESOURCE;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.range.start = (unsigned long)pool->data;
+	reg.range.len = pool->sz;
+	reg.mode = mode;
+	if (ioctl(pool->fd, UFFDIO_REGISTER, &reg) < 0) {
+		pr_inf(stderr, "%s: ioctl UFFDIO_REGISTER %s mode failed, "
+			"errno = %d (%s), skipping stressor\n",
+			pool->name, uffd_modes[pool->mode].name,
+			errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
+
+#if defined(UFFDIO_WRITEPROTECT) &&		\
+    defined(UFFD_FEATURE_PAGEFAULT_FLAG_WP)
+	if (pool->mode == UFFD_MODE_WP) {
+		struct uffdio_writeprotect wp;
+
+		wp.range.start = (unsigned long)pool->data;
+		wp.range.len = pool->sz;
+		wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+		if (ioctl(pool->fd, UFFDIO_WRITEPROTECT, &wp) < 0) {
+			pr_fail_err(pool->name, "userfaultfd write protect");
+			return EXIT_FAILURE;
+		}
+	}
+#endif
+	/* Missing and minor modes start with no pages mapped */
+	if ((pool->mode != UFFD_MODE_WP) &&
+	    (madvise(pool->data, pool->sz, MADV_DONTNEED) < 0)) {
+		pr_fail_err(pool->name, "userfaultfd madvise failed");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/*
+ *  stress_userfaultfd_pool()
+ *	fault on a region from opt_userfaultfd_faulters threads and
+ *	resolve the faults from a pool of opt_userfaultfd_handlers
+ *	threads, reporting faults per second and the fault
+ *	resolution latency seen by the faulting threads
+ */
+static int stress_userfaultfd_pool(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const size_t page_size = stress_get_pagesize();
+	const uint32_t nthreads = opt_userfaultfd_handlers + opt_userfaultfd_faulters;
+	uffd_pool_t pool;
+	uffd_thread_t *threads, *handlers, *faulters;
+	stress_latency_t lat;
+	size_t pages, i;
+	uint32_t nhandlers = 0, nfaulters = 0;
+	int memfd, rc;
+	double t_start, duration;
+
+	memset(&pool, 0, sizeof(pool));
+	pool.name = name;
+	pool.mode = opt_userfaultfd_mode;
+	pool.page_size = page_size;
+	pool.fd = -1;
+	pool.sz = opt_userfaultfd_bytes & ~(page_size - 1);
+	pages = pool.sz / page_size;
+	if (pages < opt_userfaultfd_faulters) {
+		pages = opt_userfaultfd_faulters;
+		pool.sz = pages * page_size;
+	}
+
+	threads = calloc(nthreads, sizeof(*threads));
+	pool.resolved = calloc(pages, sizeof(*pool.resolved));
+	if (!threads || !pool.resolved ||
+	    posix_memalign(&pool.src_page, page_size, page_size)) {
+		pr_err(stderr, "%s: cannot allocate handler pool\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_pool;
+	}
+	(void)memset(pool.src_page, 0x5a, page_size);
+	handlers = threads;
+	faulters = threads + opt_userfaultfd_handlers;
+
+	rc = uffd_pool_setup(&pool, &memfd);
+	if (rc != EXIT_SUCCESS)
+		goto unmap;
+
+	pool.handling = true;
+	pool.faulting = true;
+	for (i = 0; i < opt_userfaultfd_handlers; i++) {
+		handlers[i].pool = &pool;
+		handlers[i].ret = pthread_create(&handlers[i].pthread, NULL,
+			uffd_handler, &handlers[i]);
+		if (handlers[i].ret == 0)
+			nhandlers++;
+	}
+	if (!nhandlers) {
+		pr_fail_err(name, "pthread_create");
+		rc = EXIT_NO_RESOURCE;
+		goto unmap;
+	}
+
+	t_start = time_now();
+	for (i = 0; i < opt_userfaultfd_faulters; i++) {
+		const size_t slice = pages / opt_userfaultfd_faulters;
+
+		faulters[i].pool = &pool;
+		faulters[i].first = i * slice;
+		faulters[i].count = (i == opt_userfaultfd_faulters - 1) ?
+			pages - faulters[i].first : slice;
+		faulters[i].ret = pthread_create(&faulters[i].pthread, NULL,
+			uffd_faulter, &faulters[i]);
+		if (faulters[i].ret == 0)
+			nfaulters++;
+	}
+
+	while (nfaulters && opt_do_run && !pool.failed) {
+		(void)usleep(10000);
+		*counter = __atomic_load_n(&pool.faults, __ATOMIC_RELAXED);
+		if (max_ops && (*counter >= max_ops))
+			break;
+	}
+
+	/* Stop faulting first, the handlers resolve the last faults */
+	pool.faulting = false;
+	for (i = 0; i < opt_userfaultfd_faulters; i++) {
+		if (faulters[i].ret == 0)
+			(void)pthread_join(faulters[i].pthread, NULL);
+	}
+	duration = time_now() - t_start;
+	pool.handling = false;
+	for (i = 0; i < opt_userfaultfd_handlers; i++) {
+		if (handlers[i].ret == 0)
+			(void)pthread_join(handlers[i].pthread, NULL);
+	}
+	*counter = pool.faults;
+	if (pool.failed)
+		rc = EXIT_FAILURE;
+
+	memset(&lat, 0, sizeof(lat));
+	for (i = 0; i < opt_userfaultfd_faulters; i++) {
+		size_t j;
+
+		for (j = 0; j < LATENCY_BUCKETS; j++)
+			lat.bucket[j] += faulters[i].lat.bucket[j];
+		lat.count += faulters[i].lat.count;
+		if (faulters[i].lat.max > lat.max)
+			lat.max = faulters[i].lat.max;
+	}
+
+	if (duration > 0.0) {
+		const double p50 = (double)latency_percentile(&lat, 0.50) / 1000.0;
+		const double p99 = (double)latency_percentile(&lat, 0.99) / 1000.0;
+
+		if (instance == 0)
+			pr_inf(stderr, "%s: %s mode, %" PRIu32 " handlers, %" PRIu32
+				" faulters, %" PRIu32 " page batches: %.0f faults/sec, "
+				"%.0f pages/sec, fault latency p50 %.2f usec, "
+				"p99 %.2f usec, max %.2f usec\n", name,
+				uffd_modes[pool.mode].name, nhandlers, nfaulters,
+				opt_userfaultfd_prefault,
+				(double)pool.faults / duration,
+				(double)pool.pages / duration, p50, p99,
+				(double)lat.max / 1000.0);
+		stress_misc_metric_set(0, "faults per sec",
+			(double)pool.faults / duration);
+		stress_misc_metric_set(1, "pages resolved per sec",
+			(double)pool.pages / duration);
+		if (lat.count) {
+			stress_misc_metric_set(2, "fault latency p50 (usec)", p50);
+			stress_misc_metric_set(3, "fault latency p99 (usec)", p99);
+		}
+	}
+
+unmap:
+	if (pool.fd >= 0)
+		(void)close(pool.fd);
+	if (pool.data != MAP_FAILED)
+		(void)munmap(pool.data, pool.sz);
+	if (pool.alias != MAP_FAILED)
+		(void)munmap(pool.alias, pool.sz);
+	if (memfd >= 0)
+		(void)close(memfd);
+free_pool:
+	free(pool.src_page);
+	free((void *)pool.resolved);
+	free(threads);
+
+	return rc;
+}
+#endif
+
 /*
  *  stress_userfaultfd_oomable()
  *	stress userfaultfd system call, this
@@ -198,6 +788,10 @@ static int stress_userfaultfd_oomable(
 		if (opt_flags & OPT_FLAGS_MINIMIZE)
 			opt_userfaultfd_bytes = MIN_MMAP_BYTES;
 	}
+#if defined(HAVE_LIB_PTHREAD)
+	if (opt_userfaultfd_pool)
+		return stress_userfaultfd_pool(counter, instance, max_ops, name);
+#endif
 	sz = opt_userfaultfd_bytes & ~(page_size - 1);
 
 	if (posix_memalign(&zero_page, page_size, page_size)) {
@@ -406,6 +1000,11 @@ int stress_userfaultfd(
 
 		(void)setpgid(pid, pgrp);
 		ret = waitpid(pid, &status, 0);
+		if ((ret < 0) && (errno == EINTR) && opt_userfaultfd_pool) {
+			/* Pass the stop on to the child and let it report */
+			(void)kill(pid, SIGALRM);
+			ret = waitpid(pid, &status, 0);
+		}
 		if (ret < 0) {
 			if (errno != EINTR)
 				pr_dbg(stderr, "%s: waitpid(): errno=%d (%s)\n",
@@ -31,12 +31,17 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
-typedef int8_t  vint8_t  __attribute__ ((vector_size (16)));
-typedef int16_t vint16_t __attribute__ ((vector_size (16)));
-typedef int32_t vint32_t __attribute__ ((vector_size (16)));
-typedef int64_t vint64_t __attribute__ ((vector_size (16)));
+#if defined(__GNUC__) && !defined(__clang__) && 		\
+    (defined(__x86_64__) || defined(__i386__)) && NEED_GNUC(4,9,0)
+#define VECMATH_X86_SIMD	(1)
+#include <immintrin.h>
+#if NEED_GNUC(5,0,0)
+#define VECMATH_X86_AVX512	(1)
+#endif
+#endif
 
 #define OPS(a, b, c, s)	\
 	a += b;		\
@@ -56,108 +61,360 @@ typedef int64_t vint64_t __attribute__ ((vector_size (16)));
 	c = b ^ c;	\
 	b = b ^ c;	\
 
+typedef void (*vecmath_func_t)(uint64_t *const counter, const uint64_t max_ops);
+
+typedef struct {
+	const char *name;		/* --vecmath-method name */
+	bool (*supported)(void);	/* true if CPU can run it */
+	vecmath_func_t func;		/* the kernel */
+} vecmath_method_t;
+
+static const vecmath_method_t *opt_vecmath_method = NULL;	/* NULL = auto */
+
+/*
+ *  Initial integer vector values, these are replicated
+ *  across the wider vectors so the int128 kernel computes
+ *  exactly what the original 128 bit only stressor did
+ */
+static const int8_t init_b8[] = {
+	0x01, 0x23, 0x45, 0x67, (int8_t)0x89, (int8_t)0xab, (int8_t)0xcd, (int8_t)0xef,
+	0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78 };
+static const int8_t init_c8[] = {
+	0x01, 0x02, 0x03, 0x02, 0x01, 0x02, 0x03, 0x02,
+	0x03, 0x02, 0x01, 0x02, 0x03, 0x02, 0x01, 0x02 };
+static const int8_t init_s8[] = {
+	0x01, 0x01, 0x01, 0x01, 0x02, 0x02, 0x02, 0x02,
+	0x01, 0x01, 0x02, 0x02, 0x01, 0x01, 0x02, 0x02 };
+
+static const int16_t init_b16[] = {
+	0x0123, 0x4567, (int16_t)0x89ab, (int16_t)0xcdef, 0x0f1e, 0x2d3c, 0x4b5a, 0x6978 };
+static const int16_t init_c16[] = {
+	0x0102, 0x0302, 0x0102, 0x0302, 0x0302, 0x0102, 0x0302, 0x0102 };
+static const int16_t init_s16[] = {
+	0x0001, 0x0001, 0x0002, 0x0002, 0x0001, 0x0002, 0x0001, 0x0002 };
+
+static const int32_t init_b32[] = {
+	0x01234567, (int32_t)0x89abcdef, 0x0f1e2d3c, 0x4b5a6978 };
+static const int32_t init_c32[] = {
+	0x01020302, 0x01020302, 0x03020102, 0x03020102 };
+static const int32_t init_s32[] = {
+	0x00000001, 0x00000002, 0x00000002, 0x00000001 };
+
+static const int64_t init_b64[] = {
+	0x0123456789abcdefLL, 0x0f1e2d3c4b5a6979LL };
+static const int64_t init_c64[] = {
+	0x0102030201020302LL, 0x0302010203020102LL };
+static const int64_t init_s64[] = {
+	0x0000000000000001LL, 0x0000000000000002LL };
+
+#define VECMATH_INIT(bits, n)						\
+	for (i = 0; i < (sizeof(a ## bits) / sizeof(a ## bits[0])); i++) { \
+		a ## bits[i] = 0;					\
+		b ## bits[i] = init_b ## bits[i % n];			\
+		c ## bits[i] = init_c ## bits[i % n];			\
+		s ## bits[i] = init_s ## bits[i % n];			\
+	}
+
+#define VECMATH_SUM(bits)						\
+	for (sum = 0, i = 0; i < (sizeof(a ## bits) / sizeof(a ## bits[0])); i++) \
+		sum += a ## bits[i];					\
+	uint64_put(sum);
+
+/*
+ *  VECMATH_INT_KERNEL()
+ *	integer vector kernel using GCC vectors of the
+ *	given width in bytes, the compiler generates the
+ *	widest instructions the target attribute allows
+ */
+#define VECMATH_INT_KERNEL(method, attr, bytes)				\
+static void HOT OPTIMIZE3 attr stress_vecmath_ ## method(		\
+	uint64_t *const counter,					\
+	const uint64_t max_ops)						\
+{									\
+	typedef int8_t  v8_t  __attribute__ ((vector_size (bytes)));	\
+	typedef int16_t v16_t __attribute__ ((vector_size (bytes)));	\
+	typedef int32_t v32_t __attribute__ ((vector_size (bytes)));	\
+	typedef int64_t v64_t __attribute__ ((vector_size (bytes)));	\
+									\
+	v8_t a8, b8, c8, s8;						\
+	v16_t a16, b16, c16, s16;					\
+	v32_t a32, b32, c32, s32;					\
+	v64_t a64, b64, c64, s64;					\
+	uint64_t sum;							\
+	size_t i;							\
+									\
+	VECMATH_INIT(8, 16)						\
+	VECMATH_INIT(16, 8)						\
+	VECMATH_INIT(32, 4)						\
+	VECMATH_INIT(64, 2)						\
+									\
+	do {								\
+		int j;							\
+		for (j = 1000; j; j--) {				\
+			/* Good mix of vector ops */			\
+			OPS(a8, b8, c8, s8);				\
+			OPS(a16, b16, c16, s16);			\
+			OPS(a32, b32, c32, s32);			\
+			OPS(a64, b64, c64, s64);			\
+									\
+			OPS(a32, b32, c32, s32);			\
+			OPS(a16, b16, c16, s16);			\
+			OPS(a8, b8, c8, s8);				\
+			OPS(a64, b64, c64, s64);			\
+									\
+			OPS(a8, b8, c8, s8);				\
+			OPS(a8, b8, c8, s8);				\
+			OPS(a8, b8, c8, s8);				\
+			OPS(a8, b8, c8, s8);				\
+									\
+			OPS(a16, b16, c16, s16);			\
+			OPS(a16, b16, c16, s16);			\
+			OPS(a16, b16, c16, s16);			\
+			OPS(a16, b16, c16, s16);			\
+									\
+			OPS(a32, b32, c32, s32);			\
+			OPS(a32, b32, c32, s32);			\
+			OPS(a32, b32, c32, s32);			\
+			OPS(a32, b32, c32, s32);			\
+									\
+			OPS(a64, b64, c64, s64);			\
+			OPS(a64, b64, c64, s64);			\
+			OPS(a64, b64, c64, s64);			\
+			OPS(a64, b64, c64, s64);			\
+		}							\
+		(*counter)++;						\
+	} while (opt_do_run && (!max_ops || *counter < max_ops));	\
+									\
+	/* Forces the compiler to actually compute the terms */		\
+	VECMATH_SUM(8)							\
+	VECMATH_SUM(16)							\
+	VECMATH_SUM(32)							\
+	VECMATH_SUM(64)							\
+}
+
+/*
+ *  VECMATH_FMA_KERNEL()
+ *	single precision fused multiply-add kernel, eight
+ *	independent accumulator chains keep the FMA units
+ *	busy; r = r * m + k converges to k / (1 - m) so
+ *	the values never overflow or go denormal
+ */
+#define VECMATH_FMA_KERNEL(method, attr, vec_t, width, set1, fmadd, store) \
+static void HOT OPTIMIZE3 attr stress_vecmath_ ## method(		\
+	uint64_t *const counter,					\
+	const uint64_t max_ops)						\
+{									\
+	const vec_t m = set1(0.99999f);					\
+	const vec_t k = set1(0.000001f);				\
+	vec_t r0 = set1(0.0f), r1 = set1(0.1f);				\
+	vec_t r2 = set1(0.2f), r3 = set1(0.3f);				\
+	vec_t r4 = set1(0.4f), r5 = set1(0.5f);				\
+	vec_t r6 = set1(0.6f), r7 = set1(0.7f);				\
+	float v[width];							\
+	double sum = 0.0;						\
+	size_t i;							\
+									\
+	do {								\
+		int j;							\
+		for (j = 1000; j; j--) {				\
+			r0 = fmadd(r0, m, k);				\
+			r1 = fmadd(r1, m, k);				\
+			r2 = fmadd(r2, m, k);				\
+			r3 = fmadd(r3, m, k);				\
+			r4 = fmadd(r4, m, k);				\
+			r5 = fmadd(r5, m, k);				\
+			r6 = fmadd(r6, m, k);				\
+			r7 = fmadd(r7, m, k);				\
+									\
+			r0 = fmadd(r0, m, k);				\
+			r1 = fmadd(r1, m, k);				\
+			r2 = fmadd(r2, m, k);				\
+			r3 = fmadd(r3, m, k);				\
+			r4 = fmadd(r4, m, k);				\
+			r5 = fmadd(r5, m, k);				\
+			r6 = fmadd(r6, m, k);				\
+			r7 = fmadd(r7, m, k);				\
+		}							\
+		(*counter)++;						\
+	} while (opt_do_run && (!max_ops || *counter < max_ops));	\
+									\
+	/* Forces the compiler to actually compute the terms */		\
+	store(v, r0 + r1 + r2 + r3 + r4 + r5 + r6 + r7);		\
+	for (i = 0; i < width; i++)					\
+		sum += v[i];						\
+	double_put(sum);						\
+}
+
+static bool vecmath_generic_supported(void)
+{
+	return true;
+}
+
+VECMATH_INT_KERNEL(int128, , 16)
+
+#if defined(VECMATH_X86_SIMD)
+#define VECMATH_AVX2		__attribute__((target("avx2")))
+#define VECMATH_FMA		__attribute__((target("avx2,fma")))
+
+static bool vecmath_avx2_supported(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static bool vecmath_fma_supported(void)
+{
+	return __builtin_cpu_supports("avx2") &&
+	       __builtin_cpu_supports("fma");
+}
+
+VECMATH_INT_KERNEL(int256, VECMATH_AVX2, 32)
+VECMATH_FMA_KERNEL(fma128, VECMATH_FMA, __m128, 4, _mm_set1_ps,
+	_mm_fmadd_ps, _mm_storeu_ps)
+VECMATH_FMA_KERNEL(fma256, VECMATH_FMA, __m256, 8, _mm256_set1_ps,
+	_mm256_fmadd_ps, _mm256_storeu_ps)
+
+#if defined(VECMATH_X86_AVX512)
+#define VECMATH_AVX512		__attribute__((target("avx512f")))
+#define VECMATH_AVX512BW	__attribute__((target("avx512f,avx512bw")))
+
+static bool vecmath_avx512_supported(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+static bool vecmath_avx512bw_supported(void)
+{
+	return __builtin_cpu_supports("avx512f") &&
+	       __builtin_cpu_supports("avx512bw");
+}
+
+VECMATH_INT_KERNEL(int512, VECMATH_AVX512BW, 64)
+VECMATH_FMA_KERNEL(fma512, VECMATH_AVX512, __m512, 16, _mm512_set1_ps,
+	_mm512_fmadd_ps, _mm512_storeu_ps)
+#endif
+#endif
+
+/*
+ *  Kernels in order of preference for --vecmath-method auto,
+ *  widest first so auto exercises the biggest vector units
+ */
+static const vecmath_method_t vecmath_methods[] = {
+#if defined(VECMATH_X86_AVX512)
+	{ "fma512",	vecmath_avx512_supported,	stress_vecmath_fma512 },
+	{ "int512",	vecmath_avx512bw_supported,	stress_vecmath_int512 },
+#endif
+#if defined(VECMATH_X86_SIMD)
+	{ "fma256",	vecmath_fma_supported,		stress_vecmath_fma256 },
+	{ "int256",	vecmath_avx2_supported,		stress_vecmath_int256 },
+	{ "fma128",	vecmath_fma_supported,		stress_vecmath_fma128 },
+#endif
+	{ "int128",	vecmath_generic_supported,	stress_vecmath_int128 },
+	{ NULL,		NULL,				NULL }
+};
+
+/*
+ *  stress_set_vecmath_method()
+ *	set the vector maths kernel
+ */
+int stress_set_vecmath_method(const char *name)
+{
+	const vecmath_method_t *method;
+
+	if (!strcmp(name, "auto")) {
+		opt_vecmath_method = NULL;
+		return 0;
+	}
+	for (method = vecmath_methods; method->name; method++) {
+		if (!strcmp(method->name, name)) {
+			opt_vecmath_method = method;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "vecmath-method must be one of: auto");
+	for (method = vecmath_methods; method->name; method++)
+		fprintf(stderr, " %s", method->name);
+	fprintf(stderr, "\n");
+
+	return -1;
+}
+
+/*
+ *  vecmath_method()
+ *	get the kernel to use, falling back to the best
+ *	supported kernel if the CPU can't run the chosen one
+ */
+static const vecmath_method_t *vecmath_method(const char *name, const uint32_t instance)
+{
+	const vecmath_method_t *method;
+
+	if (opt_vecmath_method && opt_vecmath_method->supported())
+		return opt_vecmath_method;
+
+	for (method = vecmath_methods; method->name; method++)
+		if (method->supported())
+			break;
+	if (opt_vecmath_method && !instance)
+		pr_inf(stderr, "%s: CPU does not support %s, using %s instead\n",
+			name, opt_vecmath_method->name, method->name);
+	return method;
+}
+
+/*
+ *  vecmath_fma_method()
+ *	the widest FMA kernel the CPU supports, NULL if none
+ */
+static const vecmath_method_t *vecmath_fma_method(void)
+{
+	const vecmath_method_t *method;
+
+	for (method = vecmath_methods; method->name; method++)
+		if (!strncmp(method->name, "fma", 3) && method->supported())
+			return method;
+	return NULL;
+}
+
+/*
+ *  stress_vecmath_fma_name()
+ *	name of the FMA kernel stress_vecmath_fma_run() runs,
+ *	NULL if this CPU or build has no FMA kernel
+ */
+const char *stress_vecmath_fma_name(void)
+{
+	const vecmath_method_t *method = vecmath_fma_method();
+
+	return method ? method->name : NULL;
+}
+
+/*
+ *  stress_vecmath_fma_run()
+ *	run the widest FMA kernel until opt_do_run is cleared,
+ *	used to load sibling CPUs by --cpu-avx-interfere
+ */
+void stress_vecmath_fma_run(void)
+{
+	const vecmath_method_t *method = vecmath_fma_method();
+	uint64_t counter = 0;
+
+	if (method)
+		method->func(&counter, 0);
+}
+
 /*
  *  stress_vecmath()
  *	stress GCC vector maths
  */
-int HOT OPTIMIZE3 stress_vecmath(
+int stress_vecmath(
 	uint64_t *const counter,
 	const uint32_t instance,
 	const uint64_t max_ops,
 	const char *name)
 {
-	(void)instance;
-	(void)name;
-
-	vint8_t a8 = {
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
-	vint8_t b8 = {
-		0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
-		0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78 };
-	vint8_t c8 = {
-		0x01, 0x02, 0x03, 0x02, 0x01, 0x02, 0x03, 0x02,
-		0x03, 0x02, 0x01, 0x02, 0x03, 0x02, 0x01, 0x02 };
-	vint8_t s8 = {
-		0x01, 0x01, 0x01, 0x01, 0x02, 0x02, 0x02, 0x02,
-		0x01, 0x01, 0x02, 0x02, 0x01, 0x01, 0x02, 0x02 };
-
-	vint16_t a16 = {
-		0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 };
-	vint16_t b16 = {
-		0x0123, 0x4567, 0x89ab, 0xcdef, 0x0f1e, 0x2d3c, 0x4b5a, 0x6978 };
-	vint16_t c16 = {
-		0x0102, 0x0302, 0x0102, 0x0302, 0x0302, 0x0102, 0x0302, 0x0102 };
-	vint16_t s16 = {
-		0x0001, 0x0001, 0x0002, 0x0002, 0x0001, 0x0002, 0x0001, 0x0002 };
-
-	vint32_t a32 = {
-		0x00000000, 0x00000000, 0x00000000, 0x00000000 };
-	vint32_t b32 = {
-		0x01234567, 0x89abcdef, 0x0f1e2d3c, 0x4b5a6978 };
-	vint32_t c32 = {
-		0x01020302, 0x01020302, 0x03020102, 0x03020102 };
-	vint32_t s32 = {
-		0x00000001, 0x00000002, 0x00000002, 0000000001 };
-
-	vint64_t a64 = {
-		0x0000000000000000ULL, 0x0000000000000000ULL };
-	vint64_t b64 = {
-		0x0123456789abcdefULL, 0x0f1e2d3c4b5a6979ULL };
-	vint64_t c64 = {
-		0x0102030201020302ULL, 0x0302010203020102ULL };
-	vint64_t s64 = {
-		0x0000000000000001ULL, 0x0000000000000002ULL };
-
-	do {
-		int i;
-		for (i = 1000; i; i--) {
-			/* Good mix of vector ops */
-			OPS(a8, b8, c8, s8);
-			OPS(a16, b16, c16, s16);
-			OPS(a32, b32, c32, s32);
-			OPS(a64, b64, c64, s64);
-
-			OPS(a32, b32, c32, s32);
-			OPS(a16, b16, c16, s16);
-			OPS(a8, b8, c8, s8);
-			OPS(a64, b64, c64, s64);
-
-			OPS(a8, b8, c8, s8);
-			OPS(a8, b8, c8, s8);
-			OPS(a8, b8, c8, s8);
-			OPS(a8, b8, c8, s8);
-
-			OPS(a16, b16, c16, s16);
-			OPS(a16, b16, c16, s16);
-			OPS(a16, b16, c16, s16);
-			OPS(a16, b16, c16, s16);
-
-			OPS(a32, b32, c32, s32);
-			OPS(a32, b32, c32, s32);
-			OPS(a32, b32, c32, s32);
-			OPS(a32, b32, c32, s32);
-
-			OPS(a64, b64, c64, s64);
-			OPS(a64, b64, c64, s64);
-			OPS(a64, b64, c64, s64);
-			OPS(a64, b64, c64, s64);
-		}
-		(*counter)++;
-	} while (opt_do_run && (!max_ops || *counter < max_ops));
-
-	/* Forces the compiler to actually compute the terms */
-	uint64_put(a8[0] + a8[1] + a8[2] + a8[3] +
-		   a8[4] + a8[5] + a8[6] + a8[7] +
-		   a8[8] + a8[9] + a8[10] + a8[11] +
-		   a8[12] + a8[13] + a8[14] + a8[15]);
-
-	uint64_put(a16[0] + a16[1] + a16[2] + a16[3] +
-		   a16[4] + a16[5] + a16[6] + a16[7]);
-
-	uint64_put(a32[0] + a32[1] + a32[2] + a32[3]);
+	const vecmath_method_t *method = vecmath_method(name, instance);
 
-	uint64_put(a64[0] + a64[1]);
+	if (!instance)
+		pr_inf(stderr, "%s: using %s kernel\n", name, method->name);
+	method->func(counter, max_ops);
 
 	return EXIT_SUCCESS;
 }
@@ -38,9 +38,28 @@
 #include <sys/mman.h>
 #include <sys/uio.h>
 #include <errno.h>
+#include <string.h>
 
 #define STACK_SIZE	(64 * 1024)
 
+#define VM_RW_SWEEP_STEP_TIME	(0.1)	/* seconds per readv or memcpy step */
+#define VM_RW_SWEEP_IOV_MAX	(1024)	/* UIO_MAXIOV */
+
+static const size_t vm_rw_sweep_segs[] = { 64, 1024, 4096, 65536 };
+static const size_t vm_rw_sweep_iovs[] = { 1, 8, 64, 512, VM_RW_SWEEP_IOV_MAX };
+
+#define VM_RW_SWEEP_SEGS	SIZEOF_ARRAY(vm_rw_sweep_segs)
+#define VM_RW_SWEEP_IOVS	SIZEOF_ARRAY(vm_rw_sweep_iovs)
+
+/* process_vm_readv(2) and shared memory memcpy of one iovec layout */
+typedef struct {
+	uint64_t rv_bytes;		/* bytes read by process_vm_readv */
+	uint64_t rv_calls;		/* process_vm_readv calls */
+	double rv_secs;			/* time in process_vm_readv */
+	uint64_t mc_bytes;		/* bytes copied from shared memory */
+	double mc_secs;			/* time copying from shared memory */
+} vm_rw_sweep_t;
+
 typedef struct {
 	const char *name;
 	uint64_t *counter;
@@ -59,6 +78,7 @@ typedef struct {
 
 static size_t opt_vm_rw_bytes = DEFAULT_VM_RW_BYTES;
 static bool set_vm_rw_bytes = false;
+static bool vm_rw_sweep_mode = false;
 
 void stress_set_vm_rw_bytes(const char *optarg)
 {
@@ -68,6 +88,15 @@ void stress_set_vm_rw_bytes(const char *optarg)
 		MIN_VM_RW_BYTES, MAX_VM_RW_BYTES);
 }
 
+/*
+ *  stress_set_vm_rw_sweep()
+ *	sweep the iovec count and segment size
+ */
+void stress_set_vm_rw_sweep(void)
+{
+	vm_rw_sweep_mode = true;
+}
+
 static int stress_vm_child(void *arg)
 {
 	context_t *ctxt = (context_t *)arg;
@@ -161,6 +190,8 @@ static int stress_vm_parent(context_t *ctxt)
 	uint8_t val = 0;
 	uint8_t *localbuf;
 	addr_msg_t msg_rd, msg_wr;
+	uint64_t rd_bytes = 0, wr_bytes = 0;
+	double rd_secs = 0.0, wr_secs = 0.0;
 
 	(void)setpgid(ctxt->pid, pgrp);
 
@@ -182,7 +213,8 @@ static int stress_vm_parent(context_t *ctxt)
 	do {
 		struct iovec local[1], remote[1];
 		uint8_t *ptr, *end = localbuf + ctxt->sz;
-		int ret;
+		ssize_t ret;
+		double t;
 
 		/* Wait for address of child's buffer */
 redo_rd2:
@@ -210,10 +242,14 @@ redo_rd2:
 		local[0].iov_len = ctxt->sz;
 		remote[0].iov_base = msg_rd.addr;
 		remote[0].iov_len = ctxt->sz;
-		if (process_vm_readv(ctxt->pid, local, 1, remote, 1, 0) < 0) {
+		t = time_now();
+		ret = process_vm_readv(ctxt->pid, local, 1, remote, 1, 0);
+		if (ret < 0) {
 			pr_fail_dbg(ctxt->name, "process_vm_readv");
 			break;
 		}
+		rd_secs += time_now() - t;
+		rd_bytes += ret;
 
 		if (opt_flags & OPT_FLAGS_VERIFY) {
 			/* Check data is sane */
@@ -236,10 +272,14 @@ redo_rd2:
 		local[0].iov_len = ctxt->sz;
 		remote[0].iov_base = msg_rd.addr;
 		remote[0].iov_len = ctxt->sz;
-		if (process_vm_writev(ctxt->pid, local, 1, remote, 1, 0) < 0) {
+		t = time_now();
+		ret = process_vm_writev(ctxt->pid, local, 1, remote, 1, 0);
+		if (ret < 0) {
 			pr_fail_dbg(ctxt->name, "process_vm_writev");
 			break;
 		}
+		wr_secs += time_now() - t;
+		wr_bytes += ret;
 		msg_wr.val = val;
 		val++;
 redo_wr2:
@@ -273,9 +313,205 @@ fail:
 	(void)waitpid(ctxt->pid, &status, 0);
 	(void)munmap(localbuf, ctxt->sz);
 
+	if (rd_secs > 0.0)
+		stress_misc_metric_set(0, "readv MB/sec",
+			(double)rd_bytes / rd_secs / (double)MB);
+	if (wr_secs > 0.0)
+		stress_misc_metric_set(1, "writev MB/sec",
+			(double)wr_bytes / wr_secs / (double)MB);
+
 	return EXIT_SUCCESS;
 }
 
+/*
+ *  stress_vm_rw_sweep_step()
+ *	read one iovec layout out of a child with process_vm_readv
+ *	and then memcpy the same layout out of the shared mapping
+ *	the child has, so both copy the same pages
+ */
+static int stress_vm_rw_sweep_step(
+	const char *name,
+	const pid_t pid,
+	uint8_t *shared_buf,
+	uint8_t *localbuf,
+	struct iovec *local,
+	struct iovec *remote,
+	const size_t n,
+	const size_t seg,
+	vm_rw_sweep_t *result,
+	uint64_t *const counter)
+{
+	double t_start, t;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		local[i].iov_base = localbuf + (i * seg);
+		local[i].iov_len = seg;
+		remote[i].iov_base = shared_buf + (i * seg);
+		remote[i].iov_len = seg;
+	}
+
+	t_start = time_now();
+	do {
+		for (i = 0; i < 16; i++) {
+			const ssize_t ret = process_vm_readv(pid, local, n, remote, n, 0);
+
+			if (ret < 0) {
+				pr_fail_dbg(name, "process_vm_readv");
+				return -1;
+			}
+			result->rv_bytes += ret;
+			result->rv_calls++;
+		}
+		(*counter)++;
+		t = time_now();
+	} while (opt_do_run && (t < t_start + VM_RW_SWEEP_STEP_TIME));
+	result->rv_secs += t - t_start;
+
+	t_start = time_now();
+	do {
+		for (i = 0; i < 16 * n; i++)
+			(void)memcpy(local[i % n].iov_base, remote[i % n].iov_base, seg);
+		result->mc_bytes += 16 * n * seg;
+		t = time_now();
+	} while (opt_do_run && (t < t_start + VM_RW_SWEEP_STEP_TIME));
+	result->mc_secs += t - t_start;
+
+	return 0;
+}
+
+/*
+ *  stress_vm_rw_sweep()
+ *	process_vm_readv bandwidth and per iovec overhead over
+ *	iovec counts and segment sizes, against a memcpy of the
+ *	same data through shared memory
+ */
+static int stress_vm_rw_sweep(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name,
+	const size_t sz)
+{
+	vm_rw_sweep_t (*results)[VM_RW_SWEEP_IOVS];
+	struct iovec *local, *remote;
+	uint8_t *shared_buf, *localbuf;
+	bool reported = false;
+	int rc = EXIT_SUCCESS, status;
+	size_t s, v, idx = 0;
+	pid_t pid;
+
+	shared_buf = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	localbuf = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	results = calloc(VM_RW_SWEEP_SEGS, sizeof(*results));
+	local = calloc(VM_RW_SWEEP_IOV_MAX, sizeof(*local));
+	remote = calloc(VM_RW_SWEEP_IOV_MAX, sizeof(*remote));
+	if ((shared_buf == MAP_FAILED) || (localbuf == MAP_FAILED) ||
+	    !results || !local || !remote) {
+		pr_err(stderr, "%s: cannot allocate sweep state\n", name);
+		rc = EXIT_NO_RESOURCE;
+		goto free_state;
+	}
+	/* Populated, the sweep is about the copy and not faults */
+	(void)memset(shared_buf, 0xa5, sz);
+	(void)memset(localbuf, 0, sz);
+
+again:
+	pid = fork();
+	if (pid < 0) {
+		if (opt_do_run && (errno == EAGAIN))
+			goto again;
+		pr_fail_dbg(name, "fork");
+		rc = EXIT_FAILURE;
+		goto free_state;
+	} else if (pid == 0) {
+		(void)setpgid(0, pgrp);
+		stress_parent_died_alarm();
+		while (opt_do_run)
+			(void)pause();
+		_exit(EXIT_SUCCESS);
+	}
+	(void)setpgid(pid, pgrp);
+
+	do {
+		for (s = 0; s < VM_RW_SWEEP_SEGS; s++) {
+			for (v = 0; v < VM_RW_SWEEP_IOVS; v++) {
+				if (vm_rw_sweep_iovs[v] * vm_rw_sweep_segs[s] > sz)
+					continue;
+				if (!opt_do_run || (max_ops && *counter >= max_ops))
+					goto done;
+				if (stress_vm_rw_sweep_step(name, pid, shared_buf,
+						localbuf, local, remote,
+						vm_rw_sweep_iovs[v], vm_rw_sweep_segs[s],
+						&results[s][v], counter) < 0) {
+					rc = EXIT_FAILURE;
+					goto done;
+				}
+			}
+		}
+		if ((instance == 0) && !reported) {
+			pr_inf(stderr, "%s: %6s %6s %12s %10s %12s\n", name,
+				"iovecs", "bytes", "readv MB/s", "ns/iovec",
+				"memcpy MB/s");
+			for (s = 0; s < VM_RW_SWEEP_SEGS; s++) {
+				for (v = 0; v < VM_RW_SWEEP_IOVS; v++) {
+					const vm_rw_sweep_t *r = &results[s][v];
+
+					if (!r->rv_calls || (r->rv_secs <= 0.0) ||
+					    (r->mc_secs <= 0.0))
+						continue;
+					pr_inf(stderr, "%s: %6zu %6zu %12.1f %10.1f %12.1f\n",
+						name, vm_rw_sweep_iovs[v], vm_rw_sweep_segs[s],
+						(double)r->rv_bytes / r->rv_secs / (double)MB,
+						r->rv_secs * 1000000000.0 /
+							((double)r->rv_calls * vm_rw_sweep_iovs[v]),
+						(double)r->mc_bytes / r->mc_secs / (double)MB);
+				}
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	(void)kill(pid, SIGKILL);
+	(void)waitpid(pid, &status, 0);
+
+	/* Each segment size with the most iovecs that fit, and the 64 byte iovec cost */
+	for (s = 0; s < VM_RW_SWEEP_SEGS; s++) {
+		for (v = VM_RW_SWEEP_IOVS; v-- > 0; ) {
+			const vm_rw_sweep_t *r = &results[s][v];
+			char desc[40];
+
+			if ((r->rv_secs <= 0.0) || (r->mc_secs <= 0.0))
+				continue;
+			(void)snprintf(desc, sizeof(desc), "readv %zu byte MB/sec",
+				vm_rw_sweep_segs[s]);
+			stress_misc_metric_set(idx++, desc,
+				(double)r->rv_bytes / r->rv_secs / (double)MB);
+			(void)snprintf(desc, sizeof(desc), "memcpy %zu byte MB/sec",
+				vm_rw_sweep_segs[s]);
+			stress_misc_metric_set(idx++, desc,
+				(double)r->mc_bytes / r->mc_secs / (double)MB);
+			if (s == 0)
+				stress_misc_metric_set(idx++, "readv ns per 64 byte iovec",
+					r->rv_secs * 1000000000.0 /
+					((double)r->rv_calls * vm_rw_sweep_iovs[v]));
+			break;
+		}
+	}
+free_state:
+	free(remote);
+	free(local);
+	free(results);
+	if (localbuf != MAP_FAILED)
+		(void)munmap(localbuf, sz);
+	if (shared_buf != MAP_FAILED)
+		(void)munmap(shared_buf, sz);
+
+	return rc;
+}
+
 /*
  *  stress_vm_rw
  *	stress vm_read_v/vm_write_v
@@ -306,6 +542,9 @@ int stress_vm_rw(
 	ctxt.counter = counter;
 	ctxt.max_ops = max_ops;
 
+	if (vm_rw_sweep_mode)
+		return stress_vm_rw_sweep(counter, instance, max_ops, name, ctxt.sz);
+
 	if (pipe(ctxt.pipe_wr) < 0) {
 		pr_fail_dbg(name, "pipe");
 		return EXIT_FAILURE;
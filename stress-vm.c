@@ -27,16 +27,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <signal.h>
 #include <errno.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
 
 #include "stress-ng.h"
 
 #define VM_BOGO_SHIFT		(12)
 #define VM_ROWHAMMER_LOOPS	(1000000)
+#define VM_HAMMER_BATCH		(4096)		/* activation pairs per pacing check */
+#define VM_HAMMER_PROBES	(64)		/* timed accesses per row pair */
+#define VM_HAMMER_CANDIDATES	(1024)		/* pages timed to find conflicts */
+#define VM_CHASE_LOADS		(1 << 20)	/* timed loads per working set */
+#define VM_CHASE_LINE		(64)		/* one ring node per cache line */
+#define VM_CHASE_SETS		(8)		/* max working set sizes swept */
+#define VM_METRIC_BW		(VM_CHASE_SETS)	/* first GB/sec metric slot */
+#define VM_METHODS_MAX		(32)		/* vm_methods[] entries */
+#define VM_METRIC_HAMMER	(VM_METRIC_BW + VM_METHODS_MAX)	/* rowhammer metric slots */
 
 #define NO_MEM_RETRIES_MAX	(100)
 
@@ -47,18 +60,48 @@
 typedef size_t (*stress_vm_func)(uint8_t *buf, const size_t sz,
 		uint64_t *counter, const uint64_t max_ops);
 
+/*
+ *  reads and writes are the passes over the buffer a complete call
+ *  of the method makes, a read-modify-write pass counts as one of
+ *  each; methods with no passes get no bandwidth metric
+ */
 typedef struct {
 	const char *name;
 	const stress_vm_func func;
+	const uint8_t reads;		/* buffer read passes per call */
+	const uint8_t writes;		/* buffer write passes per call */
 } stress_vm_stressor_info_t;
 
+/* per method bandwidth of the complete calls, all in the vm child */
+typedef struct {
+	double bytes;			/* bytes read and written */
+	double duration;		/* time in the calls */
+} stress_vm_bw_t;
+
 static uint64_t opt_vm_hang = DEFAULT_VM_HANG;
 static size_t   opt_vm_bytes = DEFAULT_VM_BYTES;
 static bool	set_vm_bytes = false;
 static int      opt_vm_flags = 0;                      /* VM mmap flags */
+static bool	opt_vm_hugepage = false;		/* --vm-hugepage */
 
 static const stress_vm_stressor_info_t *opt_vm_stressor;
 static const stress_vm_stressor_info_t vm_methods[];
+static stress_vm_bw_t vm_bw[VM_METHODS_MAX];
+static uint32_t opt_vm_threads = DEFAULT_VM_THREADS;
+static uint64_t opt_vm_hammer_rate = DEFAULT_VM_HAMMER_RATE;
+
+#if defined(HAVE_LIB_PTHREAD)
+/* a thread of a --vm-threads instance and its slice of the mapping */
+typedef struct {
+	pthread_t pthread;
+	const stress_vm_stressor_info_t *info;
+	uint8_t *buf;			/* start of the slice */
+	size_t sz;			/* size of the slice */
+	uint64_t counter;		/* bogo ops of this thread */
+	uint64_t max_ops;		/* bogo ops limit of this thread */
+	int ret;			/* pthread_create return */
+} stress_vm_thread_t;
+#endif
 
 void stress_set_vm_hang(const char *optarg)
 {
@@ -75,11 +118,33 @@ void stress_set_vm_bytes(const char *optarg)
 		MIN_VM_BYTES, MAX_VM_BYTES);
 }
 
+void stress_set_vm_threads(const char *optarg)
+{
+	uint64_t threads;
+
+	threads = get_uint64(optarg);
+	check_range("vm-threads", threads,
+		MIN_VM_THREADS, MAX_VM_THREADS);
+	opt_vm_threads = (uint32_t)threads;
+}
+
+void stress_set_vm_hammer_rate(const char *optarg)
+{
+	opt_vm_hammer_rate = get_uint64(optarg);
+	check_range("vm-hammer-rate", opt_vm_hammer_rate,
+		MIN_VM_HAMMER_RATE, MAX_VM_HAMMER_RATE);
+}
+
 void stress_set_vm_flags(const int flag)
 {
 	opt_vm_flags |= flag;
 }
 
+void stress_set_vm_hugepage(void)
+{
+	opt_vm_hugepage = true;
+}
+
 /*
  *  For testing, set this to 1 to simulate random memory errors
  */
@@ -553,7 +618,7 @@ static size_t stress_vm_gray(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint8_t val;
+	static __thread uint8_t val;
 	uint8_t v, *buf_end = buf + sz;
 	volatile uint8_t *ptr;
 	size_t bit_errors = 0;
@@ -597,7 +662,7 @@ static size_t stress_vm_incdec(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static __thread uint8_t val = 0;
 	uint8_t *buf_end = buf + sz;
 	volatile uint8_t *ptr;
 	size_t bit_errors = 0;
@@ -644,7 +709,7 @@ static size_t stress_vm_prime_incdec(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static __thread uint8_t val = 0;
 	uint8_t *buf_end = buf + sz;
 	volatile uint8_t *ptr = buf;
 	size_t bit_errors = 0, i;
@@ -1239,7 +1304,7 @@ static size_t stress_vm_inc_nybble(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint8_t val = 0;
+	static __thread uint8_t val = 0;
 	volatile uint8_t *ptr;
 	uint8_t *buf_end = buf + sz;
 	size_t bit_errors = 0;
@@ -1625,7 +1690,7 @@ static size_t stress_vm_write64(
 	uint64_t *counter,
 	const uint64_t max_ops)
 {
-	static uint64_t val;
+	static __thread uint64_t val;
 	uint64_t *ptr = (uint64_t *)buf;
 	register uint64_t v = val;
 	register size_t i = 0, n = sz / (sizeof(uint64_t) * 32);
@@ -1735,9 +1800,110 @@ static size_t stress_vm_read64(
 	return 0;
 }
 
+/*
+ *  stress_vm_hammer_time()
+ *	mean ticks for an uncached access to each of a and b, if
+ *	they are in different rows of the same bank every access
+ *	has to close and open a row and so takes longer
+ */
+static uint64_t stress_vm_hammer_time(
+	volatile uint32_t *a,
+	volatile uint32_t *b)
+{
+	uint64_t t, best = ~0ULL;
+	int i, j;
+
+	/* Take the best of a few runs to ride out interrupts */
+	for (i = 0; i < 4; i++) {
+		t = time_ticks();
+		for (j = 0; j < VM_HAMMER_PROBES; j++) {
+			*a;
+			*b;
+			clflush(a);
+			clflush(b);
+			mfence();
+		}
+		t = time_ticks() - t;
+		if (t < best)
+			best = t;
+	}
+	return best / (2 * VM_HAMMER_PROBES);
+}
+
+static int stress_vm_hammer_cmp(const void *p1, const void *p2)
+{
+	const uint64_t t1 = *(const uint64_t *)p1;
+	const uint64_t t2 = *(const uint64_t *)p2;
+
+	return (t1 > t2) - (t1 < t2);
+}
+
+/*
+ *  stress_vm_hammer_calibrate()
+ *	find the pages in the same bank as the start of the buffer
+ *	by the row-conflict access time of each page against it,
+ *	the latencies fall into a fast group (other banks or the
+ *	same row) and a slow group (same bank, other row). Returns
+ *	the number of conflicting pages found, 0 if the two groups
+ *	could not be told apart.
+ */
+static size_t stress_vm_hammer_calibrate(
+	uint8_t *buf,
+	const size_t sz,
+	size_t *conflicts)
+{
+	const size_t page_size = stress_get_pagesize();
+	size_t pages = sz / page_size, step = 1, i, n = 0;
+	uint64_t ticks[VM_HAMMER_CANDIDATES], sorted[VM_HAMMER_CANDIDATES];
+	uint64_t fast, slow, threshold;
+
+	if (pages > VM_HAMMER_CANDIDATES) {
+		step = pages / VM_HAMMER_CANDIDATES;
+		pages = VM_HAMMER_CANDIDATES;
+	}
+	if (pages < 4)
+		return 0;
+
+	for (i = 1; i < pages; i++)
+		ticks[i] = stress_vm_hammer_time((uint32_t *)buf,
+			(uint32_t *)(buf + (i * step * page_size)));
+	(void)memcpy(sorted, ticks + 1, (pages - 1) * sizeof(*sorted));
+	qsort(sorted, pages - 1, sizeof(*sorted), stress_vm_hammer_cmp);
+
+	/*
+	 *  Conflicts are only about 1 in the number of banks of the
+	 *  pages, so the quartile is a fast access and the top few
+	 *  percent are conflicts; without a clear gap between them
+	 *  the timer is too coarse or the mapping too scattered
+	 */
+	fast = sorted[(pages - 1) / 4];
+	slow = sorted[((pages - 1) * 99) / 100];
+	if (slow < fast + (fast / 8) || slow == fast) {
+		pr_dbg(stderr, "rowhammer: no row conflicts found, "
+			"access times %" PRIu64 " .. %" PRIu64 " ns\n",
+			time_ticks_to_ns(fast), time_ticks_to_ns(slow));
+		return 0;
+	}
+	threshold = fast + ((slow - fast) / 2);
+
+	for (i = 1; i < pages; i++)
+		if (ticks[i] > threshold)
+			conflicts[n++] = i * step * page_size;
+
+	pr_dbg(stderr, "rowhammer: %zu of %zu pages conflict with the "
+		"first page, %" PRIu64 " vs %" PRIu64 " ns per access\n",
+		n, pages - 1, time_ticks_to_ns(slow), time_ticks_to_ns(fast));
+	return n;
+}
+
 /*
  *  stress_vm_rowhammer()
- *
+ *	double-sided hammering of same-bank rows found by timing
+ *	row conflicts, the pages in the bank are in address order
+ *	so each pair of aggressors is hammered around the row that
+ *	sits between them. Falls back to random pairs if the rows
+ *	could not be calibrated. --vm-hammer-rate paces the row
+ *	activations, the rate achieved and bit flips are metrics.
  */
 static size_t stress_vm_rowhammer(
 	uint8_t *buf,
@@ -1747,9 +1913,19 @@ static size_t stress_vm_rowhammer(
 {
 	size_t bit_errors = 0;
 	uint32_t *buf32 = (uint32_t *)buf;
-	static uint32_t val = 0xff5a00a5;
+	static __thread uint32_t val = 0xff5a00a5;
+	static __thread uint8_t *calibrated;
+	static __thread size_t n_conflicts, next;
+	static __thread size_t conflicts[VM_HAMMER_CANDIDATES + 1];
+	static __thread double activations, duration;
+	static __thread uint64_t flips;
 	const size_t n = sz / sizeof(uint32_t);
+	const uint64_t ns_per_batch = opt_vm_hammer_rate ?
+		(2ULL * VM_HAMMER_BATCH * 1000000000ULL) / opt_vm_hammer_rate : 0;
 	register size_t j;
+	register volatile uint32_t *addr0, *addr1;
+	size_t errors = 0;
+	uint64_t t0, t, loops = 0;
 
 	(void)max_ops;
 
@@ -1761,50 +1937,311 @@ static size_t stress_vm_rowhammer(
 
 	(void)mincore_touch_pages(buf, sz);
 
+	if (calibrated != buf) {
+		/* The conflict set has the first page as its first row */
+		conflicts[0] = 0;
+		n_conflicts = stress_vm_hammer_calibrate(buf, sz,
+			conflicts + 1);
+		if (n_conflicts)
+			n_conflicts++;
+		next = 0;
+		calibrated = buf;
+	}
+
 	for (j = 0; j < n; j++)
 		buf32[j] = val;
-	register volatile uint32_t *addr0, *addr1;
-	register size_t errors = 0;
-
-	/* Pick two random addresses */
-	addr0 = &buf32[(mwc64() << 12) % n];
-	addr1 = &buf32[(mwc64() << 12) % n];
-
-	/* Hammer the rows */
-	for (j = VM_ROWHAMMER_LOOPS / 4; j; j--) {
-		*addr0;
-		*addr1;
-		clflush(addr0);
-		clflush(addr1);
-		*addr0;
-		*addr1;
-		clflush(addr0);
-		clflush(addr1);
-		*addr0;
-		*addr1;
-		clflush(addr0);
-		clflush(addr1);
-		*addr0;
-		*addr1;
-		clflush(addr0);
-		clflush(addr1);
+
+	if (n_conflicts >= 3) {
+		/* Aggressors either side of the next victim row */
+		addr0 = (uint32_t *)(buf + conflicts[next]);
+		addr1 = (uint32_t *)(buf + conflicts[next + 2]);
+		next = (next + 1) % (n_conflicts - 2);
+	} else {
+		/* Pick two random addresses */
+		addr0 = &buf32[(mwc64() << 12) % n];
+		addr1 = &buf32[(mwc64() << 12) % n];
+	}
+
+	/* Hammer the rows, pacing each batch of activations */
+	t0 = time_ticks();
+	while (loops < VM_ROWHAMMER_LOOPS) {
+		for (j = VM_HAMMER_BATCH / 4; j; j--) {
+			*addr0;
+			*addr1;
+			clflush(addr0);
+			clflush(addr1);
+			*addr0;
+			*addr1;
+			clflush(addr0);
+			clflush(addr1);
+			*addr0;
+			*addr1;
+			clflush(addr0);
+			clflush(addr1);
+			*addr0;
+			*addr1;
+			clflush(addr0);
+			clflush(addr1);
+		}
+		loops += VM_HAMMER_BATCH;
+		if (ns_per_batch) {
+			const uint64_t due = (loops / VM_HAMMER_BATCH) * ns_per_batch;
+
+			while (time_ticks_to_ns(time_ticks() - t0) < due) {
+				if (!opt_do_run)
+					break;
+			}
+		}
+		if (!opt_do_run)
+			break;
 	}
-	for (j = 0; j < n; j++)
-		if (buf32[j] != val)
+	t = time_ticks_to_ns(time_ticks() - t0);
+
+	for (j = 0; j < n; j++) {
+		if (buf32[j] != val) {
+			flips += __builtin_popcount(buf32[j] ^ val);
 			errors++;
+		}
+	}
 	if (errors) {
 		bit_errors += errors;
 		pr_dbg(stderr, "rowhammer: %zu errors on addresses "
 			"%p and %p\n", errors, addr0, addr1);
 	}
-	(*counter) += VM_ROWHAMMER_LOOPS;
+	(*counter) += loops;
 	val = (val >> 31) | (val << 1);
 
+	/* Each flushed read of an aggressor is one row activation */
+	activations += 2.0 * loops;
+	duration += (double)t / 1000000000.0;
+	if (duration > 0.0)
+		stress_misc_metric_set(VM_METRIC_HAMMER,
+			"rowhammer activations/sec", activations / duration);
+	stress_misc_metric_set(VM_METRIC_HAMMER + 1,
+		"rowhammer bit flips", (double)flips);
+
 	stress_vm_check("rowhammer", bit_errors);
 
 	return bit_errors;
 }
 
+/*
+ *  stress_vm_chase_sets()
+ *	working set sizes for the ptr-chase sweep, one midway between
+ *	each pair of cache levels so it overflows the level below but
+ *	fits in the level itself, and one that is well out in DRAM
+ */
+static size_t stress_vm_chase_sets(
+	const size_t sz,
+	size_t sets[VM_CHASE_SETS],
+	char labels[VM_CHASE_SETS][8])
+{
+	uint64_t level_sz[VM_CHASE_SETS - 1] = { 32 * KB, 256 * KB, 8 * MB };
+	uint16_t levels = 3, i;
+	uint64_t prev = 0, llc;
+	size_t n = 0;
+#if defined(__linux__)
+	cpus_t *cpu_caches;
+
+	cpu_caches = get_all_cpu_cache_details();
+	if (cpu_caches) {
+		uint16_t max_level = get_max_cache_level(cpu_caches);
+
+		if (max_level > VM_CHASE_SETS - 1)
+			max_level = VM_CHASE_SETS - 1;
+		for (i = 0; i < max_level; i++) {
+			cpu_cache_t *cache = get_cpu_cache(cpu_caches, i + 1);
+
+			if (!cache || !cache->size)
+				break;
+			level_sz[i] = cache->size;
+		}
+		if (i)
+			levels = i;
+		free_cpu_caches(cpu_caches);
+	}
+#endif
+	for (i = 0; i < levels; i++) {
+		const uint64_t set = (prev + level_sz[i]) / 2;
+
+		if ((set > sz) || (level_sz[i] <= prev))
+			continue;
+		sets[n] = (size_t)set;
+		(void)snprintf(labels[n], sizeof(labels[n]), "L%" PRIu16, i + 1);
+		n++;
+		prev = level_sz[i];
+	}
+	/* DRAM, 4 times the last level cache or all of the buffer */
+	llc = level_sz[levels - 1];
+	if (sz > llc * 2) {
+		sets[n] = (sz > llc * 4) ? (size_t)(llc * 4) : sz;
+		(void)snprintf(labels[n], sizeof(labels[n]), "DRAM");
+		n++;
+	}
+	return n;
+}
+
+/*
+ *  stress_vm_chase_ring()
+ *	link the cache lines of the first sz bytes of buf into a
+ *	randomly permuted ring, Sattolo's shuffle of the line indices
+ *	gives a single cycle through every line so the prefetchers
+ *	have no pattern to follow
+ */
+static void **stress_vm_chase_ring(uint8_t *buf, const size_t sz)
+{
+	const size_t n = sz / VM_CHASE_LINE;
+	size_t i;
+
+	/* Hold the permutation in the second word of each line */
+#define CHASE_PERM(i)	(((size_t *)(buf + ((i) * VM_CHASE_LINE)))[1])
+#define CHASE_NODE(i)	((void **)(buf + ((i) * VM_CHASE_LINE)))
+
+	for (i = 0; i < n; i++)
+		CHASE_PERM(i) = i;
+	for (i = n - 1; i > 0; i--) {
+		const size_t j = (size_t)(mwc64() % i);
+		const size_t tmp = CHASE_PERM(i);
+
+		CHASE_PERM(i) = CHASE_PERM(j);
+		CHASE_PERM(j) = tmp;
+	}
+	for (i = 0; i < n; i++)
+		*CHASE_NODE(CHASE_PERM(i)) = CHASE_NODE(CHASE_PERM((i + 1) % n));
+
+	return CHASE_NODE(CHASE_PERM(0));
+#undef CHASE_PERM
+#undef CHASE_NODE
+}
+
+#define CHASE4(p)	\
+	p = (void **)*p; p = (void **)*p; p = (void **)*p; p = (void **)*p;
+
+#define CHASE16(p)	\
+	CHASE4(p) CHASE4(p) CHASE4(p) CHASE4(p)
+
+/*
+ *  stress_vm_ptr_chase()
+ *	measure load to use latency by chasing pointers around a
+ *	random ring, sweeping the working set across the cache levels
+ *	and out to DRAM, the mean ns per load at each size is
+ *	reported as a stressor metric
+ */
+static size_t stress_vm_ptr_chase(
+	uint8_t *buf,
+	const size_t sz,
+	uint64_t *counter,
+	const uint64_t max_ops)
+{
+	static __thread size_t n_sets = 0, sets[VM_CHASE_SETS];
+	static __thread char labels[VM_CHASE_SETS][8];
+	static __thread double nsec[VM_CHASE_SETS];
+	static __thread uint64_t samples[VM_CHASE_SETS];
+	size_t i;
+
+	if (!n_sets) {
+		n_sets = stress_vm_chase_sets(sz, sets, labels);
+		if (!n_sets) {
+			pr_dbg(stderr, "ptr-chase: buffer too small to chase "
+				"pointers, skipping\n");
+			return 0;
+		}
+		for (i = 0; i < n_sets; i++)
+			pr_dbg(stderr, "ptr-chase: %s working set %zuK\n",
+				labels[i], (size_t)(sets[i] / KB));
+	}
+
+	for (i = 0; i < n_sets; i++) {
+		char desc[64];
+		void **p = stress_vm_chase_ring(buf, sets[i]);
+		const size_t warm = sets[i] / VM_CHASE_LINE;
+		size_t j;
+		double t;
+
+		/* One lap to warm up the caches and TLBs */
+		for (j = 0; j < warm; j++)
+			p = (void **)*p;
+
+		t = time_now();
+		for (j = 0; j < VM_CHASE_LOADS; j += 16) {
+			CHASE16(p)
+			if (!(j & 0xffff) && !opt_do_run)
+				break;
+		}
+		t = time_now() - t;
+		/* Keep the chase from being optimised away */
+		if (!p)
+			pr_dbg(stderr, "ptr-chase: ring broken\n");
+
+		*counter += j;
+		if (j < VM_CHASE_LOADS)
+			return 0;
+
+		nsec[i] += (t * 1000000000.0) / VM_CHASE_LOADS;
+		samples[i]++;
+		(void)snprintf(desc, sizeof(desc), "%s %zuK chase (ns/load)",
+			labels[i], (size_t)(sets[i] / KB));
+		stress_misc_metric_set(i, desc, nsec[i] / samples[i]);
+		if (max_ops && (*counter >= max_ops))
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ *  stress_vm_account()
+ *	account the bytes a call of a vm method moved over sz bytes
+ *	in t seconds, a call cut short by the end of the run or
+ *	max_ops is not accounted as its passes are incomplete
+ */
+static void stress_vm_account(
+	const stress_vm_stressor_info_t *info,
+	const size_t sz,
+	const double t,
+	const uint64_t counter,
+	const uint64_t max_ops)
+{
+	const size_t i = (size_t)(info - vm_methods);
+	const unsigned int passes = info->reads + info->writes;
+	stress_vm_bw_t *bw = &vm_bw[i];
+	char desc[32];
+
+	if (!passes || (i >= SIZEOF_ARRAY(vm_bw)))
+		return;
+	if (!opt_do_run || (max_ops && (counter >= max_ops)) || (t <= 0.0))
+		return;
+
+	bw->bytes += (double)sz * passes;
+	bw->duration += t;
+	(void)snprintf(desc, sizeof(desc), "%s (GB/sec)", info->name);
+	/* "all" is vm_methods[0] so method i has slot i - 1 */
+	stress_misc_metric_set(VM_METRIC_BW + i - 1, desc,
+		bw->bytes / (bw->duration * 1000000000.0));
+}
+
+/*
+ *  stress_vm_method()
+ *	run a vm method and account the bytes it moves
+ */
+static size_t stress_vm_method(
+	const stress_vm_stressor_info_t *info,
+	uint8_t *buf,
+	const size_t sz,
+	uint64_t *counter,
+	const uint64_t max_ops)
+{
+	double t;
+	size_t bit_errors;
+
+	t = time_now();
+	bit_errors = info->func(buf, sz, counter, max_ops);
+	t = time_now() - t;
+	stress_vm_account(info, sz, t, *counter, max_ops);
+
+	return bit_errors;
+}
+
 /*
  *  stress_vm_all()
  *	work through all vm stressors sequentially
@@ -1818,7 +2255,7 @@ static size_t stress_vm_all(
 	static int i = 1;
 	size_t bit_errors = 0;
 
-	bit_errors = vm_methods[i].func(buf, sz, counter, max_ops);
+	bit_errors = stress_vm_method(&vm_methods[i], buf, sz, counter, max_ops);
 	i++;
 	if (vm_methods[i].func == NULL)
 		i = 1;
@@ -1826,34 +2263,125 @@ static size_t stress_vm_all(
 	return bit_errors;
 }
 
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  stress_vm_thread()
+ *	run a vm method over one slice of the shared mapping
+ */
+static void *stress_vm_thread(void *arg)
+{
+	static void *nowt = NULL;
+	stress_vm_thread_t *thread = (stress_vm_thread_t *)arg;
+
+	mwc_reseed();
+	(void)thread->info->func(thread->buf, thread->sz,
+		&thread->counter, thread->max_ops);
+
+	return &nowt;
+}
+
+/*
+ *  stress_vm_threads()
+ *	run the method with all of the --vm-threads at once, each
+ *	thread has its own slice of the one mapping. With method
+ *	all each round of threads runs the next method together.
+ *	Falls back to a single thread if the threads can't start.
+ */
+static void stress_vm_threads(
+	const char *name,
+	uint8_t *buf,
+	const size_t sz,
+	uint64_t *counter,
+	const uint64_t max_ops)
+{
+	static int all = 1;
+	const stress_vm_stressor_info_t *info = opt_vm_stressor;
+	const size_t page_size = stress_get_pagesize();
+	stress_vm_thread_t threads[MAX_VM_THREADS];
+	size_t slice, offset = 0;
+	uint32_t i, n = opt_vm_threads, started = 0;
+	uint64_t ops = 0;
+	double t;
+
+	if (info->func == stress_vm_all) {
+		info = &vm_methods[all++];
+		if (vm_methods[all].func == NULL)
+			all = 1;
+	}
+
+	/* Page aligned slices, the last thread gets the remainder */
+	slice = (sz / n) & ~(page_size - 1);
+	if (!slice) {
+		slice = page_size;
+		n = (uint32_t)(sz / page_size);
+	}
+
+	t = time_now();
+	for (i = 0; i < n; i++) {
+		stress_vm_thread_t *thread = &threads[i];
+
+		thread->info = info;
+		thread->buf = buf + offset;
+		thread->sz = (i == n - 1) ? sz - offset : slice;
+		thread->counter = 0;
+		thread->max_ops = max_ops ?
+			((max_ops - STRESS_MINIMUM(*counter, max_ops)) / n) + 1 : 0;
+		offset += slice;
+
+		thread->ret = pthread_create(&thread->pthread, NULL,
+			stress_vm_thread, thread);
+		if (thread->ret) {
+			if (!started)
+				pr_dbg(stderr, "%s: pthread_create failed: "
+					"errno=%d (%s)\n", name,
+					thread->ret, strerror(thread->ret));
+			/* Do the slice in this thread instead */
+			(void)stress_vm_thread(thread);
+		} else {
+			started++;
+		}
+	}
+	for (i = 0; i < n; i++) {
+		if (!threads[i].ret)
+			(void)pthread_join(threads[i].pthread, NULL);
+		ops += threads[i].counter;
+	}
+	t = time_now() - t;
+
+	*counter += ops;
+	stress_vm_account(info, sz, t, *counter, max_ops);
+}
+#endif
+
 static const stress_vm_stressor_info_t vm_methods[] = {
-	{ "all",	stress_vm_all },
-	{ "flip",	stress_vm_flip },
-	{ "galpat-0",	stress_vm_galpat_zero },
-	{ "galpat-1",	stress_vm_galpat_one },
-	{ "gray",	stress_vm_gray },
-	{ "rowhammer",	stress_vm_rowhammer },
-	{ "incdec",	stress_vm_incdec },
-	{ "inc-nybble",	stress_vm_inc_nybble },
-	{ "rand-set",	stress_vm_rand_set },
-	{ "rand-sum",	stress_vm_rand_sum },
-	{ "read64",	stress_vm_read64 },
-	{ "ror",	stress_vm_ror },
-	{ "swap",	stress_vm_swap },
-	{ "move-inv",	stress_vm_moving_inversion },
-	{ "modulo-x",	stress_vm_modulo_x },
-	{ "prime-0",	stress_vm_prime_zero },
-	{ "prime-1",	stress_vm_prime_one },
-	{ "prime-gray-0",stress_vm_prime_gray_zero },
-	{ "prime-gray-1",stress_vm_prime_gray_one },
-	{ "prime-incdec",stress_vm_prime_incdec },
-	{ "walk-0d",	stress_vm_walking_zero_data },
-	{ "walk-1d",	stress_vm_walking_one_data },
-	{ "walk-0a",	stress_vm_walking_zero_addr },
-	{ "walk-1a",	stress_vm_walking_one_addr },
-	{ "write64",	stress_vm_write64 },
-	{ "zero-one",	stress_vm_zero_one },
-	{ NULL,		NULL  }
+	{ "all",	stress_vm_all,			0, 0 },
+	{ "flip",	stress_vm_flip,			9, 9 },
+	{ "galpat-0",	stress_vm_galpat_zero,		1, 1 },
+	{ "galpat-1",	stress_vm_galpat_one,		1, 1 },
+	{ "gray",	stress_vm_gray,			1, 1 },
+	{ "rowhammer",	stress_vm_rowhammer,		1, 1 },
+	{ "incdec",	stress_vm_incdec,		3, 3 },
+	{ "inc-nybble",	stress_vm_inc_nybble,		3, 3 },
+	{ "rand-set",	stress_vm_rand_set,		1, 1 },
+	{ "rand-sum",	stress_vm_rand_sum,		1, 1 },
+	{ "read64",	stress_vm_read64,		1, 0 },
+	{ "ror",	stress_vm_ror,			2, 2 },
+	{ "swap",	stress_vm_swap,			5, 5 },
+	{ "move-inv",	stress_vm_moving_inversion,	4, 4 },
+	{ "modulo-x",	stress_vm_modulo_x,		1, 23 },
+	{ "prime-0",	stress_vm_prime_zero,		9, 9 },
+	{ "prime-1",	stress_vm_prime_one,		9, 9 },
+	{ "prime-gray-0",stress_vm_prime_gray_zero,	3, 3 },
+	{ "prime-gray-1",stress_vm_prime_gray_one,	3, 3 },
+	{ "prime-incdec",stress_vm_prime_incdec,	3, 3 },
+	{ "ptr-chase",	stress_vm_ptr_chase,		0, 0 },
+	{ "walk-0d",	stress_vm_walking_zero_data,	8, 8 },
+	{ "walk-1d",	stress_vm_walking_one_data,	8, 8 },
+	{ "walk-0a",	stress_vm_walking_zero_addr,	0, 1 },
+	{ "walk-1a",	stress_vm_walking_one_addr,	0, 1 },
+	{ "write64",	stress_vm_write64,		1, 0 },
+	{ "zero-one",	stress_vm_zero_one,		2, 2 },
+	{ NULL,		NULL,				0, 0 }
 };
 
 /*
@@ -1895,7 +2423,8 @@ int stress_vm(
 	uint8_t *buf = NULL;
 	pid_t pid;
 	const bool keep = (opt_flags & OPT_FLAGS_VM_KEEP);
-	const stress_vm_func func = opt_vm_stressor->func;
+	const hugepages_t hugepages = opt_vm_hugepage ?
+		HUGEPAGES_2M : stress_get_hugepages();
         const size_t page_size = stress_get_pagesize();
 	size_t buf_sz;
 
@@ -1906,6 +2435,7 @@ int stress_vm(
 			opt_vm_bytes = MIN_VM_BYTES;
 	}
 	buf_sz = opt_vm_bytes & ~(page_size - 1);
+	buf_sz = hugepages_round(hugepages, buf_sz);
 
 again:
 	if (!opt_do_run)
@@ -1961,10 +2491,10 @@ again:
 			if (!keep || (buf == NULL)) {
 				if (!opt_do_run)
 					return EXIT_SUCCESS;
-				buf = (uint8_t *)mmap(NULL, buf_sz,
+				buf = (uint8_t *)mmap_hugepages(hugepages, buf_sz,
 					PROT_READ | PROT_WRITE,
 					MAP_SHARED | MAP_ANONYMOUS |
-					opt_vm_flags, -1, 0);
+					opt_vm_flags, -1);
 				if (buf == MAP_FAILED) {
 					buf = NULL;
 					no_mem_retries++;
@@ -1976,7 +2506,16 @@ again:
 
 			no_mem_retries = 0;
 			(void)mincore_touch_pages(buf, buf_sz);
-			(void)func(buf, buf_sz, counter, max_ops << VM_BOGO_SHIFT);
+#if defined(HAVE_LIB_PTHREAD)
+			if (opt_vm_threads > 1)
+				stress_vm_threads(name, buf, buf_sz,
+					counter, max_ops << VM_BOGO_SHIFT);
+			else
+#endif
+				(void)stress_vm_method(opt_vm_stressor, buf, buf_sz,
+					counter, max_ops << VM_BOGO_SHIFT);
+			if (hugepages != HUGEPAGES_NONE)
+				hugepages_metric_set(hugepages_mapped(buf, buf_sz));
 
 			if (opt_vm_hang == 0) {
 				for (;;) {
@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include "stress-ng.h"
+
+#if defined(STRESS_WAKEUP)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <sys/syscall.h>
+
+#define WAKEUP_PHASE_TIME	(0.5)	/* seconds per mechanism */
+
+#define WAKEUP_EVENTFD		(0)	/* eventfd(2) write and read */
+#define WAKEUP_EVENTFD_SEM	(1)	/* eventfd(2) with EFD_SEMAPHORE */
+#define WAKEUP_PIPE		(2)	/* pipe(2) byte write and read */
+#define WAKEUP_FUTEX		(3)	/* FUTEX_WAKE and FUTEX_WAIT */
+#define WAKEUP_SEM_POSIX	(4)	/* sem_post(3) and sem_wait(3) */
+#define WAKEUP_SEM_SYSV		(5)	/* semop(2) up and down */
+#define WAKEUP_MAX		(6)
+#define WAKEUP_ALL		(WAKEUP_MAX)
+
+/* semctl(2) argument, callers have to define it */
+union wakeup_semun {
+	int val;
+	struct semid_ds *buf;
+	unsigned short *array;
+};
+
+/* One direction of a notifier and waiter pair */
+typedef struct {
+	int fds[2];			/* eventfd in fds[0], or a pipe */
+	uint32_t futex;			/* futex word, 1 when notified */
+	sem_t sem;			/* POSIX semaphore */
+	int sem_id;			/* SysV semaphore set */
+} wakeup_chan_t;
+
+typedef struct {
+	const char *name;		/* --wakeup-method name */
+	int method;			/* WAKEUP_ value */
+} wakeup_method_t;
+
+static const wakeup_method_t wakeup_methods[] = {
+	{ "eventfd",	 WAKEUP_EVENTFD },
+	{ "eventfd-sem", WAKEUP_EVENTFD_SEM },
+	{ "pipe",	 WAKEUP_PIPE },
+	{ "futex",	 WAKEUP_FUTEX },
+	{ "sem-posix",	 WAKEUP_SEM_POSIX },
+	{ "sem-sysv",	 WAKEUP_SEM_SYSV },
+	{ "all",	 WAKEUP_ALL },
+};
+
+/* State shared by the notifier and the waiter thread */
+typedef struct {
+	int method;			/* WAKEUP_ value */
+	wakeup_chan_t ping;		/* notifier to waiter */
+	wakeup_chan_t pong;		/* waiter back to notifier */
+	bool run;			/* waiter keeps on waiting */
+	uint64_t t_notify;		/* ns when the ping was sent */
+	stress_latency_t *lat;		/* notify to wakeup latencies */
+	int cpu;			/* waiter CPU, -1 unpinned */
+} wakeup_ctl_t;
+
+static int opt_wakeup_method = WAKEUP_ALL;
+static int opt_wakeup_cpus[2] = { -1, -1 };	/* notifier, waiter */
+
+/*
+ *  stress_set_wakeup_method()
+ *	set the wakeup mechanism(s) to measure
+ */
+int stress_set_wakeup_method(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(wakeup_methods); i++) {
+		if (!strcmp(name, wakeup_methods[i].name)) {
+			opt_wakeup_method = wakeup_methods[i].method;
+			return 0;
+		}
+	}
+	fprintf(stderr, "wakeup-method must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(wakeup_methods); i++)
+		fprintf(stderr, " %s", wakeup_methods[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_wakeup_cpus()
+ *	pin the notifier and waiter, "X,Y"
+ */
+int stress_set_wakeup_cpus(const char *optarg)
+{
+	const int32_t max_cpus = stress_get_processors_configured();
+	int x, y;
+
+	if ((sscanf(optarg, "%d,%d", &x, &y) != 2) ||
+	    (x < 0) || (y < 0) || (x >= max_cpus) || (y >= max_cpus)) {
+		fprintf(stderr, "wakeup-cpus must be two CPUs X,Y in the range "
+			"0 to %" PRId32 "\n", max_cpus - 1);
+		return -1;
+	}
+	opt_wakeup_cpus[0] = x;
+	opt_wakeup_cpus[1] = y;
+
+	return 0;
+}
+
+/*
+ *  wakeup_pin()
+ *	pin the calling thread to a CPU, -1 leaves it be
+ */
+static void wakeup_pin(const int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	(void)sched_setaffinity(0, sizeof(set), &set);
+}
+
+/*
+ *  wakeup_chan_init()
+ *	create the objects of one direction
+ */
+static int wakeup_chan_init(const int method, wakeup_chan_t *chan)
+{
+	union wakeup_semun arg;
+
+	chan->fds[0] = -1;
+	chan->fds[1] = -1;
+	chan->futex = 0;
+	chan->sem_id = -1;
+
+	switch (method) {
+	case WAKEUP_EVENTFD:
+		chan->fds[0] = eventfd(0, 0);
+		return (chan->fds[0] < 0) ? -1 : 0;
+	case WAKEUP_EVENTFD_SEM:
+		chan->fds[0] = eventfd(0, EFD_SEMAPHORE);
+		return (chan->fds[0] < 0) ? -1 : 0;
+	case WAKEUP_PIPE:
+		return pipe(chan->fds);
+	case WAKEUP_FUTEX:
+		return 0;
+	case WAKEUP_SEM_POSIX:
+		return sem_init(&chan->sem, 0, 0);
+	case WAKEUP_SEM_SYSV:
+		chan->sem_id = semget(IPC_PRIVATE, 1, IPC_CREAT | S_IRUSR | S_IWUSR);
+		if (chan->sem_id < 0)
+			return -1;
+		arg.val = 0;
+		return semctl(chan->sem_id, 0, SETVAL, arg);
+	}
+	return -1;
+}
+
+/*
+ *  wakeup_chan_free()
+ *	destroy the objects of one direction
+ */
+static void wakeup_chan_free(const int method, wakeup_chan_t *chan)
+{
+	if (chan->fds[0] >= 0)
+		(void)close(chan->fds[0]);
+	if (chan->fds[1] >= 0)
+		(void)close(chan->fds[1]);
+	if (method == WAKEUP_SEM_POSIX)
+		(void)sem_destroy(&chan->sem);
+	if (chan->sem_id >= 0)
+		(void)semctl(chan->sem_id, 0, IPC_RMID);
+}
+
+/*
+ *  wakeup_notify()
+ *	wake the waiter of a direction
+ */
+static int wakeup_notify(const int method, wakeup_chan_t *chan)
+{
+	const uint64_t val = 1;
+	const uint8_t byte = 0;
+	struct sembuf sop;
+
+	switch (method) {
+	case WAKEUP_EVENTFD:
+	case WAKEUP_EVENTFD_SEM:
+		return (write(chan->fds[0], &val, sizeof(val)) == sizeof(val)) ? 0 : -1;
+	case WAKEUP_PIPE:
+		return (write(chan->fds[1], &byte, sizeof(byte)) == sizeof(byte)) ? 0 : -1;
+	case WAKEUP_FUTEX:
+		__atomic_store_n(&chan->futex, 1, __ATOMIC_RELEASE);
+		return (syscall(SYS_futex, &chan->futex, FUTEX_WAKE_PRIVATE,
+			1, NULL, NULL, 0) < 0) ? -1 : 0;
+	case WAKEUP_SEM_POSIX:
+		return sem_post(&chan->sem);
+	case WAKEUP_SEM_SYSV:
+		sop.sem_num = 0;
+		sop.sem_op = 1;
+		sop.sem_flg = 0;
+		return semop(chan->sem_id, &sop, 1);
+	}
+	return -1;
+}
+
+/*
+ *  wakeup_wait()
+ *	sleep until a direction is notified, signals
+ *	interrupting the wait are not wakeups
+ */
+static int wakeup_wait(const int method, wakeup_chan_t *chan)
+{
+	uint64_t val;
+	uint8_t byte;
+	struct sembuf sop;
+	int ret;
+
+	for (;;) {
+		switch (method) {
+		case WAKEUP_EVENTFD:
+		case WAKEUP_EVENTFD_SEM:
+			ret = (read(chan->fds[0], &val, sizeof(val)) == sizeof(val)) ? 0 : -1;
+			break;
+		case WAKEUP_PIPE:
+			ret = (read(chan->fds[0], &byte, sizeof(byte)) == sizeof(byte)) ? 0 : -1;
+			break;
+		case WAKEUP_FUTEX:
+			if (__atomic_exchange_n(&chan->futex, 0, __ATOMIC_ACQUIRE))
+				return 0;
+			(void)syscall(SYS_futex, &chan->futex, FUTEX_WAIT_PRIVATE,
+				0, NULL, NULL, 0);
+			continue;
+		case WAKEUP_SEM_POSIX:
+			ret = sem_wait(&chan->sem);
+			break;
+		case WAKEUP_SEM_SYSV:
+			sop.sem_num = 0;
+			sop.sem_op = -1;
+			sop.sem_flg = 0;
+			ret = semop(chan->sem_id, &sop, 1);
+			break;
+		default:
+			return -1;
+		}
+		if ((ret == 0) || (errno != EINTR))
+			return ret;
+	}
+}
+
+/*
+ *  wakeup_waiter()
+ *	wait for each ping, note how long after the notify it
+ *	woke and pong back so the notifier can ping again
+ */
+static void *wakeup_waiter(void *arg)
+{
+	static void *nowt = NULL;
+	wakeup_ctl_t *ctl = (wakeup_ctl_t *)arg;
+
+	wakeup_pin(ctl->cpu);
+	for (;;) {
+		uint64_t t;
+
+		if (wakeup_wait(ctl->method, &ctl->ping) < 0)
+			break;
+		t = time_now_ns();
+		if (!__atomic_load_n(&ctl->run, __ATOMIC_ACQUIRE))
+			break;
+		latency_record(ctl->lat, t - __atomic_load_n(&ctl->t_notify,
+			__ATOMIC_ACQUIRE));
+		if (wakeup_notify(ctl->method, &ctl->pong) < 0)
+			break;
+	}
+	return &nowt;
+}
+
+/*
+ *  stress_wakeup_phase()
+ *	ping-pong between the notifier and a waiter thread
+ *	with one mechanism, each round trip is two wakeups
+ */
+static int stress_wakeup_phase(
+	const char *name,
+	const int method,
+	stress_latency_t *lat,
+	double *secs,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	wakeup_ctl_t *ctl;
+	pthread_t pthread;
+	double t_start;
+	int ret, rc = 0;
+
+	ctl = calloc(1, sizeof(*ctl));
+	if (!ctl) {
+		pr_err(stderr, "%s: cannot allocate wakeup state\n", name);
+		return -1;
+	}
+	ctl->method = method;
+	ctl->lat = lat;
+	ctl->cpu = opt_wakeup_cpus[1];
+	ctl->run = true;
+	if ((wakeup_chan_init(method, &ctl->ping) < 0) ||
+	    (wakeup_chan_init(method, &ctl->pong) < 0)) {
+		pr_fail(stderr, "%s: %s setup failed: errno=%d (%s)\n",
+			name, wakeup_methods[method].name, errno, strerror(errno));
+		rc = -1;
+		goto free_chans;
+	}
+	ret = pthread_create(&pthread, NULL, wakeup_waiter, ctl);
+	if (ret) {
+		pr_fail(stderr, "%s: pthread_create failed: errno=%d (%s)\n",
+			name, ret, strerror(ret));
+		rc = -1;
+		goto free_chans;
+	}
+
+	t_start = time_now();
+	do {
+		__atomic_store_n(&ctl->t_notify, time_now_ns(), __ATOMIC_RELEASE);
+		if (wakeup_notify(method, &ctl->ping) < 0) {
+			pr_fail(stderr, "%s: %s notify failed: errno=%d (%s)\n",
+				name, wakeup_methods[method].name,
+				errno, strerror(errno));
+			rc = -1;
+			break;
+		}
+		if (wakeup_wait(method, &ctl->pong) < 0)
+			break;
+		(*counter)++;
+	} while (opt_do_run && (time_now() < t_start + WAKEUP_PHASE_TIME) &&
+		 (!max_ops || *counter < max_ops));
+	*secs += time_now() - t_start;
+
+	/* One last ping lets the waiter see it has to stop */
+	__atomic_store_n(&ctl->run, false, __ATOMIC_RELEASE);
+	(void)wakeup_notify(method, &ctl->ping);
+	(void)pthread_join(pthread, NULL);
+
+free_chans:
+	wakeup_chan_free(method, &ctl->ping);
+	wakeup_chan_free(method, &ctl->pong);
+	free(ctl);
+
+	return rc;
+}
+
+/*
+ *  stress_wakeup
+ *	compare the cross thread wakeup latency and rate
+ *	of eventfd, pipes, futexes and semaphores
+ */
+int stress_wakeup(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	stress_latency_t *lats;
+	double secs[WAKEUP_MAX];
+	bool available[WAKEUP_MAX];
+	cpu_set_t allowed;
+	bool reported = false;
+	int method, rc = EXIT_SUCCESS;
+	size_t idx = 0;
+
+	for (method = 0; method < WAKEUP_MAX; method++)
+		available[method] = (opt_wakeup_method == WAKEUP_ALL) ||
+				    (opt_wakeup_method == method);
+	memset(secs, 0, sizeof(secs));
+
+	lats = calloc(WAKEUP_MAX, sizeof(*lats));
+	if (!lats) {
+		pr_err(stderr, "%s: cannot allocate latency state\n", name);
+		return EXIT_NO_RESOURCE;
+	}
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+		CPU_ZERO(&allowed);
+	wakeup_pin(opt_wakeup_cpus[0]);
+
+	do {
+		for (method = 0; method < WAKEUP_MAX; method++) {
+			if (!available[method])
+				continue;
+			if (!opt_do_run || (max_ops && *counter >= max_ops))
+				goto done;
+			if (stress_wakeup_phase(name, method, &lats[method],
+					&secs[method], counter, max_ops) < 0) {
+				rc = EXIT_FAILURE;
+				goto done;
+			}
+		}
+		if ((instance == 0) && !reported) {
+			if (opt_wakeup_cpus[0] >= 0)
+				pr_inf(stderr, "%s: notifier on CPU %d, waiter "
+					"on CPU %d\n", name, opt_wakeup_cpus[0],
+					opt_wakeup_cpus[1]);
+			pr_inf(stderr, "%s: %11s %10s %10s %10s %11s\n", name,
+				"method", "p50 usec", "p99 usec", "p99.9 usec",
+				"wakeups/s");
+			for (method = 0; method < WAKEUP_MAX; method++) {
+				const stress_latency_t *lat = &lats[method];
+
+				if (!available[method] || !lat->count ||
+				    (secs[method] <= 0.0))
+					continue;
+				/* Two wakeups, the ping and the pong, per round trip */
+				pr_inf(stderr, "%s: %11s %10.1f %10.1f %10.1f %11.0f\n",
+					name, wakeup_methods[method].name,
+					latency_percentile_usec(lat, 0.50),
+					latency_percentile_usec(lat, 0.99),
+					latency_percentile_usec(lat, 0.999),
+					2.0 * (double)lat->count / secs[method]);
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	for (method = 0; method < WAKEUP_MAX; method++) {
+		char desc[40];
+
+		if (!lats[method].count)
+			continue;
+		(void)snprintf(desc, sizeof(desc), "%s p50 (usec)",
+			wakeup_methods[method].name);
+		stress_misc_metric_set(idx++, desc,
+			latency_percentile_usec(&lats[method], 0.50));
+	}
+	if (CPU_COUNT(&allowed))
+		(void)sched_setaffinity(0, sizeof(allowed), &allowed);
+	free(lats);
+
+	return rc;
+}
+#endif
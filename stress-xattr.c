@@ -31,6 +31,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -39,6 +41,308 @@
 #include <sys/types.h>
 #include <attr/xattr.h>
 
+#define XATTR_SWEEP_CELL_TIME	(0.1)	/* seconds per sweep cell */
+
+#define XATTR_OP_CREATE		(0)
+#define XATTR_OP_REPLACE	(1)
+#define XATTR_OP_GET		(2)
+#define XATTR_OP_LIST		(3)
+#define XATTR_OP_REMOVE		(4)
+#define XATTR_OPS		(5)
+
+#define XATTR_WHERE_UNKNOWN	(0)	/* cell not run yet */
+#define XATTR_WHERE_INODE	(1)	/* no blocks, stored in the inode */
+#define XATTR_WHERE_BLOCK	(2)	/* moved out to an xattr block */
+#define XATTR_WHERE_LIMIT	(3)	/* filesystem refused it */
+
+static bool opt_xattr_sweep = false;
+
+static const size_t xattr_sweep_sizes[] = {
+	16, 64, 256, 1 * KB, 4 * KB, 16 * KB, 64 * KB
+};
+
+static const uint32_t xattr_sweep_counts[] = {
+	1, 4, 16, 64
+};
+
+#define XATTR_SIZES	(SIZEOF_ARRAY(xattr_sweep_sizes))
+#define XATTR_COUNTS	(SIZEOF_ARRAY(xattr_sweep_counts))
+
+static const char *xattr_op_names[XATTR_OPS] = {
+	"create/s", "replace/s", "get/s", "list/s", "remove/s"
+};
+
+static const char *xattr_where_names[] = {
+	"-", "inode", "block", "limit"
+};
+
+/* Results of one value size and attribute count sweep cell */
+typedef struct {
+	uint64_t ops[XATTR_OPS];	/* operations done */
+	double duration[XATTR_OPS];	/* time in the operations */
+	int where;			/* XATTR_WHERE_* */
+} xattr_cell_t;
+
+void stress_set_xattr_sweep(void)
+{
+	opt_xattr_sweep = true;
+}
+
+/*
+ *  xattr_rate()
+ *	operations per second of op in a cell
+ */
+static inline double xattr_rate(const xattr_cell_t *cell, const int op)
+{
+	return (cell->duration[op] > 0.0) ?
+		(double)cell->ops[op] / cell->duration[op] : 0.0;
+}
+
+/*
+ *  stress_xattr_round()
+ *	create, replace, get, list and remove count attributes of
+ *	size bytes on an empty file, returns 0, -1 on failure or
+ *	the errno if the filesystem will not hold them
+ */
+static int stress_xattr_round(
+	const char *name,
+	const int fd,
+	const size_t size,
+	const uint32_t count,
+	char *value,
+	char *tmp,
+	xattr_cell_t *cell)
+{
+	char attrname[32], *list;
+	uint32_t i, created;
+	struct stat statbuf;
+	ssize_t sz;
+	double t;
+	int ret = 0;
+
+	t = time_now();
+	for (created = 0; created < count; created++) {
+		(void)snprintf(attrname, sizeof(attrname), "user.var_%" PRIu32,
+			created);
+		if (fsetxattr(fd, attrname, value, size, XATTR_CREATE) < 0) {
+			if ((errno == ENOSPC) || (errno == E2BIG) ||
+			    (errno == EDQUOT) || (errno == ERANGE) ||
+			    (errno == ENOTSUP)) {
+				ret = errno;
+			} else {
+				pr_fail_err(name, "fsetxattr");
+				ret = -1;
+			}
+			break;
+		}
+	}
+	cell->duration[XATTR_OP_CREATE] += time_now() - t;
+	cell->ops[XATTR_OP_CREATE] += created;
+	if (ret)
+		goto remove;
+
+	/* The file has no data, any blocks hold the attributes */
+	if ((fstat(fd, &statbuf) == 0) && (cell->where != XATTR_WHERE_BLOCK))
+		cell->where = statbuf.st_blocks ?
+			XATTR_WHERE_BLOCK : XATTR_WHERE_INODE;
+
+	value[0]++;
+	t = time_now();
+	for (i = 0; i < count; i++) {
+		(void)snprintf(attrname, sizeof(attrname), "user.var_%" PRIu32, i);
+		if (fsetxattr(fd, attrname, value, size, XATTR_REPLACE) < 0) {
+			pr_fail_err(name, "fsetxattr");
+			ret = -1;
+			break;
+		}
+	}
+	cell->duration[XATTR_OP_REPLACE] += time_now() - t;
+	cell->ops[XATTR_OP_REPLACE] += i;
+	if (ret)
+		goto remove;
+
+	t = time_now();
+	for (i = 0; i < count; i++) {
+		(void)snprintf(attrname, sizeof(attrname), "user.var_%" PRIu32, i);
+		sz = fgetxattr(fd, attrname, tmp, size);
+		if ((sz < 0) || ((size_t)sz != size)) {
+			pr_fail_err(name, "fgetxattr");
+			ret = -1;
+			break;
+		}
+	}
+	cell->duration[XATTR_OP_GET] += time_now() - t;
+	cell->ops[XATTR_OP_GET] += i;
+	if (ret)
+		goto remove;
+	if (memcmp(value, tmp, size)) {
+		pr_fail(stderr, "%s: fgetxattr values different\n", name);
+		ret = -1;
+		goto remove;
+	}
+
+	t = time_now();
+	sz = flistxattr(fd, NULL, 0);
+	if (sz > 0) {
+		list = malloc((size_t)sz);
+		if (list) {
+			sz = flistxattr(fd, list, (size_t)sz);
+			free(list);
+		}
+	}
+	cell->duration[XATTR_OP_LIST] += time_now() - t;
+	cell->ops[XATTR_OP_LIST]++;
+	if (sz < 0) {
+		pr_fail_err(name, "flistxattr");
+		ret = -1;
+	}
+
+remove:
+	t = time_now();
+	for (i = 0; i < created; i++) {
+		(void)snprintf(attrname, sizeof(attrname), "user.var_%" PRIu32, i);
+		if (fremovexattr(fd, attrname) < 0) {
+			pr_fail_err(name, "fremovexattr");
+			ret = -1;
+			break;
+		}
+	}
+	cell->duration[XATTR_OP_REMOVE] += time_now() - t;
+	cell->ops[XATTR_OP_REMOVE] += i;
+
+	return ret;
+}
+
+/*
+ *  stress_xattr_sweep()
+ *	sweep value sizes and attributes per inode, the first
+ *	instance reports a table of the first complete sweep
+ *	with where the filesystem put the attributes
+ */
+static int stress_xattr_sweep(
+	const char *name,
+	const uint32_t instance,
+	const int fd,
+	uint64_t *const counter,
+	const uint64_t max_ops)
+{
+	xattr_cell_t cells[XATTR_SIZES][XATTR_COUNTS];
+	const size_t max_size = xattr_sweep_sizes[XATTR_SIZES - 1];
+	size_t i, j, inline_max = 0;
+	bool reported = false;
+	char *value, *tmp;
+	int rc = EXIT_SUCCESS;
+
+	value = malloc(max_size);
+	tmp = malloc(max_size);
+	if (!value || !tmp) {
+		pr_err(stderr, "%s: cannot allocate value buffers\n", name);
+		free(value);
+		free(tmp);
+		return EXIT_NO_RESOURCE;
+	}
+	for (i = 0; i < max_size; i++)
+		value[i] = (char)mwc8();
+	(void)memset(cells, 0, sizeof(cells));
+
+	do {
+		for (i = 0; i < XATTR_SIZES; i++) {
+			for (j = 0; j < XATTR_COUNTS; j++) {
+				xattr_cell_t *cell = &cells[i][j];
+				double t_end;
+
+				/* Larger than one that did not fit */
+				if (cell->where == XATTR_WHERE_LIMIT)
+					continue;
+				if ((i > 0) && (cells[i - 1][j].where ==
+				     XATTR_WHERE_LIMIT)) {
+					cell->where = XATTR_WHERE_LIMIT;
+					continue;
+				}
+				t_end = time_now() + XATTR_SWEEP_CELL_TIME;
+				do {
+					int ret;
+
+					if (!opt_do_run || (max_ops && *counter >= max_ops))
+						goto done;
+					ret = stress_xattr_round(name, fd,
+						xattr_sweep_sizes[i],
+						xattr_sweep_counts[j],
+						value, tmp, cell);
+					if (ret < 0) {
+						rc = EXIT_FAILURE;
+						goto done;
+					}
+					if (ret == ENOTSUP) {
+						pr_inf(stderr, "%s stressor will be "
+							"skipped, filesystem does not "
+							"support xattr.\n", name);
+						goto done;
+					}
+					if (ret) {
+						cell->where = XATTR_WHERE_LIMIT;
+						break;
+					}
+					(*counter)++;
+				} while (time_now() < t_end);
+			}
+		}
+		if ((instance == 0) && !reported) {
+			int op;
+
+			pr_inf(stderr, "%s: %6s %5s %10s %10s %10s %10s %10s %6s\n",
+				name, "size", "count", xattr_op_names[0],
+				xattr_op_names[1], xattr_op_names[2],
+				xattr_op_names[3], xattr_op_names[4], "where");
+			for (i = 0; i < XATTR_SIZES; i++) {
+				for (j = 0; j < XATTR_COUNTS; j++) {
+					const xattr_cell_t *cell = &cells[i][j];
+					char rates[XATTR_OPS][16];
+
+					for (op = 0; op < XATTR_OPS; op++) {
+						if (cell->where == XATTR_WHERE_LIMIT)
+							(void)snprintf(rates[op], sizeof(rates[op]), "-");
+						else
+							(void)snprintf(rates[op], sizeof(rates[op]),
+								"%.0f", xattr_rate(cell, op));
+					}
+					pr_inf(stderr, "%s: %6zu %5" PRIu32
+						" %10s %10s %10s %10s %10s %6s\n",
+						name, xattr_sweep_sizes[i],
+						xattr_sweep_counts[j],
+						rates[0], rates[1], rates[2],
+						rates[3], rates[4],
+						xattr_where_names[cell->where]);
+				}
+			}
+			reported = true;
+		}
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+done:
+	/* Largest single value kept in the inode and largest that fitted */
+	for (i = 0, j = 0; i < XATTR_SIZES; i++) {
+		if (cells[i][0].where == XATTR_WHERE_INODE)
+			inline_max = xattr_sweep_sizes[i];
+		if (cells[i][0].ops[XATTR_OP_GET])
+			j = i;
+	}
+	stress_misc_metric_set(0, "largest inline value (bytes)",
+		(double)inline_max);
+	stress_misc_metric_set(1, "16 byte value get/s",
+		xattr_rate(&cells[0][0], XATTR_OP_GET));
+	stress_misc_metric_set(2, "16 byte value create/s",
+		xattr_rate(&cells[0][0], XATTR_OP_CREATE));
+	stress_misc_metric_set(3, "largest value size (bytes)",
+		(double)xattr_sweep_sizes[j]);
+	stress_misc_metric_set(4, "largest value get/s",
+		xattr_rate(&cells[j][0], XATTR_OP_GET));
+	stress_misc_metric_set(5, "largest value create/s",
+		xattr_rate(&cells[j][0], XATTR_OP_CREATE));
+	free(tmp);
+	free(value);
+
+	return rc;
+}
 
 /*
  *  stress_xattr
@@ -68,6 +372,11 @@ int stress_xattr(
 	}
 	(void)unlink(filename);
 
+	if (opt_xattr_sweep) {
+		rc = stress_xattr_sweep(name, instance, fd, counter, max_ops);
+		goto out_close;
+	}
+
 	do {
 		int i, j;
 		char attrname[32];
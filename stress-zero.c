@@ -50,6 +50,7 @@ int stress_zero(
 
 	(void)instance;
 
+	stress_units_per_op((double)page_size);
 	if ((fd = open("/dev/zero", O_RDONLY)) < 0) {
 		pr_fail_err(name, "open");
 		return EXIT_FAILURE;
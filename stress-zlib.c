@@ -35,10 +35,28 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <sys/mman.h>
+#if defined(HAVE_LIB_PTHREAD)
+#include <pthread.h>
+#endif
 
 #include "zlib.h"
+#if defined(HAVE_LIB_LZ4)
+#include <lz4.h>
+#endif
+#if defined(HAVE_LIB_ZSTD)
+#include <zstd.h>
+#endif
+
+#define ZLIB_ENGINE_ZLIB	(0)
+#define ZLIB_ENGINE_LZ4		(1)
+#define ZLIB_ENGINE_ZSTD	(2)
+#define ZLIB_ENGINE_MAX		(3)
+#define ZLIB_ENGINE_ALL		(ZLIB_ENGINE_MAX)
+
+#define ZLIB_RAND_DATA_ALL	(-1)
 
-#define DATA_SIZE 	(65536)		/* Must be a multiple of 8 bytes */
+#define ZLIB_CALIBRATE_TIME	(0.25)	/* secs of single thread deflate */
 
 typedef void (*stress_rand_data_func)(uint32_t *data, const int size);
 
@@ -186,17 +204,150 @@ static void stress_rand_data_rarely_0(uint32_t *data, const int size)
 		*data = ~(1 << (mwc32() & 0x1f));
 }
 
-static const stress_rand_data_func rand_data_funcs[] = {
-	stress_rand_data_rarely_1,
-	stress_rand_data_rarely_0,
-	stress_rand_data_binary,
-	stress_rand_data_text,
-	stress_rand_data_01,
-	stress_rand_data_digits,
-	stress_rand_data_00_ff,
-	stress_rand_data_nybble
+typedef struct {
+	const char *name;		/* User option */
+	const stress_rand_data_func func; /* Data generator */
+} zlib_rand_data_t;
+
+static const zlib_rand_data_t zlib_rand_data[] = {
+	{ "rarely1",	stress_rand_data_rarely_1 },
+	{ "rarely0",	stress_rand_data_rarely_0 },
+	{ "binary",	stress_rand_data_binary },
+	{ "text",	stress_rand_data_text },
+	{ "01",		stress_rand_data_01 },
+	{ "digits",	stress_rand_data_digits },
+	{ "00ff",	stress_rand_data_00_ff },
+	{ "nybble",	stress_rand_data_nybble },
+};
+
+#define ZLIB_RAND_DATA_MAX	(SIZEOF_ARRAY(zlib_rand_data))
+
+/* Block header sent down the pipe ahead of each compressed block */
+typedef struct {
+	uint32_t engine;		/* ZLIB_ENGINE_ */
+	uint32_t rand_data;		/* zlib_rand_data index */
+	uint32_t raw_size;		/* uncompressed bytes */
+	uint32_t comp_size;		/* compressed bytes that follow */
+	uint32_t checksum;		/* of the uncompressed bytes */
+} zlib_header_t;
+
+/* Throughput per engine and data generator, shared by both processes */
+typedef struct {
+	uint64_t blocks;		/* blocks compressed */
+	uint64_t raw_bytes;		/* uncompressed bytes */
+	uint64_t comp_bytes;		/* compressed bytes */
+	double comp_time;		/* compression time, parent */
+	uint64_t decomp_bytes;		/* bytes decompressed, child */
+	double decomp_time;		/* decompression time, child */
+} zlib_stats_t;
+
+/* Per process engine state */
+typedef struct {
+	z_stream deflate;		/* zlib compressor */
+	z_stream inflate;		/* zlib decompressor */
+	bool deflate_ok, inflate_ok;	/* zlib streams initialised */
+#if defined(HAVE_LIB_ZSTD)
+	ZSTD_CCtx *zstd_cctx;		/* zstd compressor */
+	ZSTD_DCtx *zstd_dctx;		/* zstd decompressor */
+#endif
+} zlib_ctx_t;
+
+typedef struct {
+	const char *name;		/* User option */
+	const int engine;		/* ZLIB_ENGINE_ */
+} zlib_engine_t;
+
+static const zlib_engine_t zlib_engines[] = {
+	{ "zlib",	ZLIB_ENGINE_ZLIB },
+#if defined(HAVE_LIB_LZ4)
+	{ "lz4",	ZLIB_ENGINE_LZ4 },
+#endif
+#if defined(HAVE_LIB_ZSTD)
+	{ "zstd",	ZLIB_ENGINE_ZSTD },
+#endif
+	{ "all",	ZLIB_ENGINE_ALL },
+};
+
+static const char *zlib_engine_names[ZLIB_ENGINE_MAX] = {
+	"zlib", "lz4", "zstd"
 };
 
+static int opt_zlib_engine = ZLIB_ENGINE_ZLIB;
+static int opt_zlib_rand_data = ZLIB_RAND_DATA_ALL;
+static uint32_t opt_zlib_level = DEFAULT_ZLIB_LEVEL;
+static uint64_t opt_zlib_block_size = DEFAULT_ZLIB_BLOCK_SIZE;
+static uint32_t opt_zlib_threads = DEFAULT_ZLIB_THREADS;
+
+/*
+ *  stress_set_zlib_engine()
+ *	set the compression engine, lz4 and zstd are
+ *	only available when built against their libraries
+ */
+int stress_set_zlib_engine(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < SIZEOF_ARRAY(zlib_engines); i++) {
+		if (!strcmp(name, zlib_engines[i].name)) {
+			opt_zlib_engine = zlib_engines[i].engine;
+			return 0;
+		}
+	}
+	fprintf(stderr, "zlib-engine must be one of:");
+	for (i = 0; i < SIZEOF_ARRAY(zlib_engines); i++)
+		fprintf(stderr, " %s", zlib_engines[i].name);
+	fprintf(stderr, "\n");
+	return -1;
+}
+
+/*
+ *  stress_set_zlib_rand_data()
+ *	set the data generator, all picks one at random per block
+ */
+int stress_set_zlib_rand_data(const char *name)
+{
+	size_t i;
+
+	if (!strcmp(name, "all")) {
+		opt_zlib_rand_data = ZLIB_RAND_DATA_ALL;
+		return 0;
+	}
+	for (i = 0; i < ZLIB_RAND_DATA_MAX; i++) {
+		if (!strcmp(name, zlib_rand_data[i].name)) {
+			opt_zlib_rand_data = (int)i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "zlib-rand-data must be one of:");
+	for (i = 0; i < ZLIB_RAND_DATA_MAX; i++)
+		fprintf(stderr, " %s", zlib_rand_data[i].name);
+	fprintf(stderr, " all\n");
+	return -1;
+}
+
+void stress_set_zlib_level(const char *optarg)
+{
+	opt_zlib_level = (uint32_t)get_uint64(optarg);
+	check_range("zlib-level", opt_zlib_level,
+		MIN_ZLIB_LEVEL, MAX_ZLIB_LEVEL);
+}
+
+void stress_set_zlib_block_size(const char *optarg)
+{
+	opt_zlib_block_size = get_uint64_byte(optarg);
+	check_range("zlib-block-size", opt_zlib_block_size,
+		MIN_ZLIB_BLOCK_SIZE, MAX_ZLIB_BLOCK_SIZE);
+	/* The data generators fill 8 bytes at a time */
+	opt_zlib_block_size &= ~(uint64_t)7;
+}
+
+void stress_set_zlib_threads(const char *optarg)
+{
+	opt_zlib_threads = (uint32_t)get_uint64(optarg);
+	check_range("zlib-threads", opt_zlib_threads,
+		MIN_ZLIB_THREADS, MAX_ZLIB_THREADS);
+}
+
 /*
  *  stress_zlib_err()
  *	turn a zlib error to something human readable
@@ -220,136 +371,999 @@ static const char *stress_zlib_err(const int zlib_err)
 		return "out of memory";
 	case Z_VERSION_ERROR:
 		return "zlib version mismatch";
+	case Z_BUF_ERROR:
+		return "output buffer too small";
 	default:
 		snprintf(buf, sizeof(buf), "unknown zlib error %d\n", zlib_err);
 		return buf;
 	}
 }
 
+/*
+ *  stress_zlib_checksum()
+ *	cheap checksum of a block for --verify
+ */
+static uint32_t stress_zlib_checksum(const uint32_t *data, const size_t size)
+{
+	const size_t n = size / sizeof(uint32_t);
+	register uint32_t sum = 0;
+	register size_t i;
+
+	for (i = 0; i < n; i++)
+		sum = ((sum << 5) | (sum >> 27)) ^ data[i];
+	return sum;
+}
 
 /*
- *  stress_zlib_inflate()
- *	inflate compressed data out of the read
- *	end of a pipe fd
+ *  stress_zlib_bound()
+ *	worst case compressed size of a block for any engine
  */
-static int stress_zlib_inflate(const char *name, const int fd)
+static size_t stress_zlib_bound(const size_t size)
+{
+	size_t bound = (size_t)compressBound((uLong)size);
+
+#if defined(HAVE_LIB_LZ4)
+	bound = STRESS_MAXIMUM(bound, (size_t)LZ4_compressBound((int)size));
+#endif
+#if defined(HAVE_LIB_ZSTD)
+	bound = STRESS_MAXIMUM(bound, ZSTD_compressBound(size));
+#endif
+	return bound;
+}
+
+/*
+ *  stress_zlib_ctx_init()
+ *	set up the compressor or decompressor of each engine,
+ *	level 0..9 is passed to zlib as is, zstd takes the level
+ *	as is with 0 its default, lz4 accelerates as the level
+ *	drops below 10
+ */
+static int stress_zlib_ctx_init(const char *name, zlib_ctx_t *ctx, const bool compress)
 {
 	int ret;
-	z_stream stream_inf;
 
-	stream_inf.zalloc = Z_NULL;
-	stream_inf.zfree = Z_NULL;
-	stream_inf.opaque = Z_NULL;
+	(void)memset(ctx, 0, sizeof(*ctx));
+	if (compress) {
+		const int level = STRESS_MINIMUM((int)opt_zlib_level, Z_BEST_COMPRESSION);
 
-	ret = inflateInit(&stream_inf);
-	if (ret != Z_OK) {
-		pr_fail(stderr, "%s: zlib inflateInit error: %s\n",
-			name, stress_zlib_err(ret));
-		return EXIT_FAILURE;
+		ret = deflateInit(&ctx->deflate, level);
+		if (ret != Z_OK) {
+			pr_fail(stderr, "%s: zlib deflateInit error: %s\n",
+				name, stress_zlib_err(ret));
+			return -1;
+		}
+		ctx->deflate_ok = true;
+#if defined(HAVE_LIB_ZSTD)
+		ctx->zstd_cctx = ZSTD_createCCtx();
+		if (!ctx->zstd_cctx) {
+			pr_fail(stderr, "%s: ZSTD_createCCtx failed\n", name);
+			return -1;
+		}
+#endif
+	} else {
+		ret = inflateInit(&ctx->inflate);
+		if (ret != Z_OK) {
+			pr_fail(stderr, "%s: zlib inflateInit error: %s\n",
+				name, stress_zlib_err(ret));
+			return -1;
+		}
+		ctx->inflate_ok = true;
+#if defined(HAVE_LIB_ZSTD)
+		ctx->zstd_dctx = ZSTD_createDCtx();
+		if (!ctx->zstd_dctx) {
+			pr_fail(stderr, "%s: ZSTD_createDCtx failed\n", name);
+			return -1;
+		}
+#endif
 	}
+	return 0;
+}
+
+/*
+ *  stress_zlib_ctx_free()
+ *	free the engine state
+ */
+static void stress_zlib_ctx_free(zlib_ctx_t *ctx)
+{
+	if (ctx->deflate_ok)
+		(void)deflateEnd(&ctx->deflate);
+	if (ctx->inflate_ok)
+		(void)inflateEnd(&ctx->inflate);
+#if defined(HAVE_LIB_ZSTD)
+	if (ctx->zstd_cctx)
+		(void)ZSTD_freeCCtx(ctx->zstd_cctx);
+	if (ctx->zstd_dctx)
+		(void)ZSTD_freeDCtx(ctx->zstd_dctx);
+#endif
+}
+
+/*
+ *  stress_zlib_compress()
+ *	compress a block as an independent frame, returns
+ *	the compressed size or 0 on failure
+ */
+static size_t stress_zlib_compress(
+	const char *name,
+	zlib_ctx_t *ctx,
+	const int engine,
+	const void *in,
+	const size_t in_size,
+	void *out,
+	const size_t out_size)
+{
+	int ret;
+
+	switch (engine) {
+#if defined(HAVE_LIB_LZ4)
+	case ZLIB_ENGINE_LZ4:
+		ret = LZ4_compress_fast(in, out, (int)in_size, (int)out_size,
+			(opt_zlib_level < 10) ? 10 - (int)opt_zlib_level : 1);
+		if (ret <= 0) {
+			pr_fail(stderr, "%s: LZ4_compress_fast failed\n", name);
+			return 0;
+		}
+		return (size_t)ret;
+#endif
+#if defined(HAVE_LIB_ZSTD)
+	case ZLIB_ENGINE_ZSTD: {
+		const size_t sz = ZSTD_compressCCtx(ctx->zstd_cctx, out, out_size,
+			in, in_size, (int)opt_zlib_level);
+
+		if (ZSTD_isError(sz)) {
+			pr_fail(stderr, "%s: zstd compress error: %s\n",
+				name, ZSTD_getErrorName(sz));
+			return 0;
+		}
+		return sz;
+	}
+#endif
+	default:
+		(void)deflateReset(&ctx->deflate);
+		ctx->deflate.next_in = (unsigned char *)in;
+		ctx->deflate.avail_in = (uInt)in_size;
+		ctx->deflate.next_out = out;
+		ctx->deflate.avail_out = (uInt)out_size;
+		ret = deflate(&ctx->deflate, Z_FINISH);
+		if (ret != Z_STREAM_END) {
+			pr_fail(stderr, "%s: zlib deflate error: %s\n",
+				name, stress_zlib_err(ret));
+			return 0;
+		}
+		return out_size - ctx->deflate.avail_out;
+	}
+}
+
+/*
+ *  stress_zlib_decompress()
+ *	decompress a frame, returns the decompressed size or
+ *	0 on failure
+ */
+static size_t stress_zlib_decompress(
+	const char *name,
+	zlib_ctx_t *ctx,
+	const int engine,
+	const void *in,
+	const size_t in_size,
+	void *out,
+	const size_t out_size)
+{
+	int ret;
+
+	switch (engine) {
+#if defined(HAVE_LIB_LZ4)
+	case ZLIB_ENGINE_LZ4:
+		ret = LZ4_decompress_safe(in, out, (int)in_size, (int)out_size);
+		if (ret < 0) {
+			pr_fail(stderr, "%s: LZ4_decompress_safe failed\n", name);
+			return 0;
+		}
+		return (size_t)ret;
+#endif
+#if defined(HAVE_LIB_ZSTD)
+	case ZLIB_ENGINE_ZSTD: {
+		const size_t sz = ZSTD_decompressDCtx(ctx->zstd_dctx, out, out_size,
+			in, in_size);
+
+		if (ZSTD_isError(sz)) {
+			pr_fail(stderr, "%s: zstd decompress error: %s\n",
+				name, ZSTD_getErrorName(sz));
+			return 0;
+		}
+		return sz;
+	}
+#endif
+	case ZLIB_ENGINE_ZLIB:
+		(void)inflateReset(&ctx->inflate);
+		ctx->inflate.next_in = (unsigned char *)in;
+		ctx->inflate.avail_in = (uInt)in_size;
+		ctx->inflate.next_out = out;
+		ctx->inflate.avail_out = (uInt)out_size;
+		ret = inflate(&ctx->inflate, Z_FINISH);
+		if (ret != Z_STREAM_END) {
+			pr_fail(stderr, "%s: zlib inflate error: %s\n",
+				name, stress_zlib_err(ret));
+			return 0;
+		}
+		return out_size - ctx->inflate.avail_out;
+	default:
+		pr_fail(stderr, "%s: unknown compression engine %d\n",
+			name, engine);
+		return 0;
+	}
+}
+
+/*
+ *  stress_zlib_read()
+ *	read exactly size bytes, returns false on EOF or error
+ */
+static bool stress_zlib_read(const int fd, void *buf, const size_t size)
+{
+	uint8_t *ptr = (uint8_t *)buf;
+	size_t n = 0;
+
+	while (n < size) {
+		const ssize_t ret = read(fd, ptr + n, size - n);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		if (ret == 0)
+			return false;
+		n += (size_t)ret;
+	}
+	return true;
+}
+
+/*
+ *  stress_zlib_inflate()
+ *	decompress the blocks out of the read end of a pipe fd,
+ *	timing each one for the per engine and data stats
+ */
+static int stress_zlib_inflate(const char *name, const int fd, zlib_stats_t *stats)
+{
+	const size_t block_size = (size_t)opt_zlib_block_size;
+	const size_t bound = stress_zlib_bound(block_size);
+	int ret = EXIT_FAILURE;
+	zlib_ctx_t ctx;
+	uint8_t *in;
+	uint32_t *out;
+
+	in = malloc(bound);
+	out = malloc(block_size);
+	if (!in || !out) {
+		pr_err(stderr, "%s: cannot allocate inflate buffers\n", name);
+		goto free_bufs;
+	}
+	if (stress_zlib_ctx_init(name, &ctx, false) < 0)
+		goto free_ctx;
 
 	for (;;) {
-		ssize_t sz;
-		unsigned char in[DATA_SIZE];
+		zlib_header_t hdr;
+		zlib_stats_t *s;
+		double t;
+		size_t sz;
 
-		sz = read(fd, in, DATA_SIZE);
-		if (sz <= 0)
+		if (!stress_zlib_read(fd, &hdr, sizeof(hdr))) {
+			ret = EXIT_SUCCESS;
+			break;
+		}
+		if ((hdr.engine >= ZLIB_ENGINE_MAX) ||
+		    (hdr.rand_data >= ZLIB_RAND_DATA_MAX) ||
+		    (hdr.raw_size > block_size) || (hdr.comp_size > bound)) {
+			pr_fail(stderr, "%s: corrupt block header\n", name);
+			break;
+		}
+		if (!stress_zlib_read(fd, in, hdr.comp_size)) {
+			ret = EXIT_SUCCESS;
+			break;
+		}
+		t = time_now();
+		sz = stress_zlib_decompress(name, &ctx, (int)hdr.engine,
+			in, hdr.comp_size, out, block_size);
+		t = time_now() - t;
+		if (!sz)
+			break;
+		if (sz != hdr.raw_size) {
+			pr_fail(stderr, "%s: decompressed %zu bytes, expected %"
+				PRIu32 "\n", name, sz, hdr.raw_size);
 			break;
-		stream_inf.avail_in = sz;
-		stream_inf.next_in = in;
+		}
+		if ((opt_flags & OPT_FLAGS_VERIFY) &&
+		    (stress_zlib_checksum(out, sz) != hdr.checksum)) {
+			pr_fail(stderr, "%s: %s decompressed data checksum "
+				"mismatch\n", name, zlib_engine_names[hdr.engine]);
+			break;
+		}
+		s = &stats[(hdr.engine * ZLIB_RAND_DATA_MAX) + hdr.rand_data];
+		s->decomp_bytes += sz;
+		s->decomp_time += t;
+	}
+free_ctx:
+	stress_zlib_ctx_free(&ctx);
+free_bufs:
+	free(out);
+	free(in);
+
+	return ret;
+}
 
-		do {
-			unsigned char out[DATA_SIZE];
+/*
+ *  stress_zlib_engines()
+ *	fill engines with the engines --zlib-engine selects,
+ *	returns how many there are
+ */
+static size_t stress_zlib_engines(int engines[ZLIB_ENGINE_MAX])
+{
+	size_t i, n_engines = 0;
 
-			stream_inf.avail_out = DATA_SIZE;
-			stream_inf.next_out = out;
+	for (i = 0; i < SIZEOF_ARRAY(zlib_engines); i++) {
+		const int engine = zlib_engines[i].engine;
 
-			ret = inflate(&stream_inf, Z_NO_FLUSH);
-		} while ((ret == Z_OK) && (stream_inf.avail_out == 0));
+		if ((engine != ZLIB_ENGINE_ALL) &&
+		    ((opt_zlib_engine == ZLIB_ENGINE_ALL) ||
+		     (opt_zlib_engine == engine)))
+			engines[n_engines++] = engine;
 	}
-	(void)inflateEnd(&stream_inf);
-
-	return ((ret == Z_OK) || (ret == Z_STREAM_END)) ?
-		EXIT_SUCCESS : EXIT_FAILURE;
+	return n_engines;
 }
 
 /*
  *  stress_zlib_deflate()
- *	compress random data and write it down the
- *	write end of a pipe fd
+ *	compress blocks of generated data as independent frames
+ *	and write them down the write end of a pipe fd
  */
 static int stress_zlib_deflate(
 	const char *name,
 	const int fd,
-	const uint32_t instance,
 	const uint64_t max_ops,
-	uint64_t *counter)
+	uint64_t *counter,
+	zlib_stats_t *stats)
 {
-	int ret;
-	bool do_run;
-	z_stream stream_def;
-	uint64_t bytes_in = 0, bytes_out = 0;
-
-	stream_def.zalloc = Z_NULL;
-	stream_def.zfree = Z_NULL;
-	stream_def.opaque = Z_NULL;
-
-	ret = deflateInit(&stream_def, Z_BEST_COMPRESSION);
-	if (ret != Z_OK) {
-		pr_fail(stderr, "%s: zlib deflateInit error: %s\n",
-			name, stress_zlib_err(ret));
-		return EXIT_FAILURE;
+	const size_t block_size = (size_t)opt_zlib_block_size;
+	const size_t bound = stress_zlib_bound(block_size);
+	int ret = EXIT_FAILURE;
+	int engines[ZLIB_ENGINE_MAX];
+	const size_t n_engines = stress_zlib_engines(engines);
+	zlib_ctx_t ctx;
+	uint32_t *in;
+	uint8_t *out;
+
+	in = malloc(block_size);
+	out = malloc(sizeof(zlib_header_t) + bound);
+	if (!in || !out) {
+		pr_err(stderr, "%s: cannot allocate deflate buffers\n", name);
+		goto free_bufs;
 	}
+	if (stress_zlib_ctx_init(name, &ctx, true) < 0)
+		goto free_ctx;
 
 	do {
-		uint32_t in[DATA_SIZE / sizeof(uint32_t)];
+		zlib_header_t *hdr = (zlib_header_t *)out;
+		const int engine = engines[mwc32() % n_engines];
+		const uint32_t rand_data = (opt_zlib_rand_data == ZLIB_RAND_DATA_ALL) ?
+			mwc32() % ZLIB_RAND_DATA_MAX : (uint32_t)opt_zlib_rand_data;
+		zlib_stats_t *s = &stats[(engine * ZLIB_RAND_DATA_MAX) + rand_data];
+		size_t sz, len;
+		ssize_t wret;
+		double t;
 
-		rand_data_funcs[mwc32() % SIZEOF_ARRAY(rand_data_funcs)](in, DATA_SIZE);
-		stream_def.avail_in = DATA_SIZE;
-		stream_def.next_in = (unsigned char *)in;
+		zlib_rand_data[rand_data].func(in, (int)block_size);
 
-		do_run = opt_do_run && (!max_ops || *counter < max_ops);
-
-		bytes_in += DATA_SIZE;
+		t = time_now();
+		sz = stress_zlib_compress(name, &ctx, engine, in, block_size,
+			out + sizeof(*hdr), bound);
+		t = time_now() - t;
+		if (!sz)
+			break;
 
-		do {
-			unsigned char out[DATA_SIZE];
-			int def_size, rc;
-			int flush = do_run ? Z_NO_FLUSH : Z_FINISH;
+		s->blocks++;
+		s->raw_bytes += block_size;
+		s->comp_bytes += sz;
+		s->comp_time += t;
 
-			stream_def.avail_out = DATA_SIZE;
-			stream_def.next_out = out;
-			rc = deflate(&stream_def, flush);
+		hdr->engine = (uint32_t)engine;
+		hdr->rand_data = rand_data;
+		hdr->raw_size = (uint32_t)block_size;
+		hdr->comp_size = (uint32_t)sz;
+		hdr->checksum = (opt_flags & OPT_FLAGS_VERIFY) ?
+			stress_zlib_checksum(in, block_size) : 0;
 
-			if ((rc != Z_OK) && (rc != Z_STREAM_END)) {
-				pr_fail(stderr, "%s: zlib deflate error: %s\n",
-					name, stress_zlib_err(rc));
-				do_run = false;
-				ret = EXIT_FAILURE;
+		len = sizeof(*hdr) + sz;
+		wret = write(fd, out, len);
+		if (wret != (ssize_t)len) {
+			if ((wret < 0) && (errno != EINTR) && (errno != EPIPE)) {
+				pr_fail(stderr, "%s: write error: errno=%d (%s)\n",
+					name, errno, strerror(errno));
 				break;
 			}
-			def_size = DATA_SIZE - stream_def.avail_out;
-			bytes_out += def_size;
-			if (write(fd, out, def_size) != def_size) {
-				if ((errno != EINTR) && (errno != EPIPE)) {
-					ret = EXIT_FAILURE;
-					pr_fail(stderr, "%s: write error: errno=%d (%s)\n",
-						name, errno, strerror(errno));
-				}
-				do_run = false;
+			ret = EXIT_SUCCESS;
+			break;
+		}
+		(*counter)++;
+		ret = EXIT_SUCCESS;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+free_ctx:
+	stress_zlib_ctx_free(&ctx);
+free_bufs:
+	free(out);
+	free(in);
+
+	return ret;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+
+#define ZLIB_SLOT_FREE		(0)	/* can be filled by the producer */
+#define ZLIB_SLOT_QUEUED	(1)	/* waiting for a worker */
+#define ZLIB_SLOT_BUSY		(2)	/* being (de)compressed */
+#define ZLIB_SLOT_DONE		(3)	/* waiting to be retired in order */
+
+/* A block in flight in a --zlib-threads pool */
+typedef struct {
+	uint64_t seq;			/* position in the stream */
+	int state;			/* ZLIB_SLOT_ */
+	bool ok;			/* worker succeeded */
+	double t;			/* time to (de)compress */
+	uint32_t *data;			/* uncompressed block */
+	uint8_t *buf;			/* header then compressed block */
+} zlib_slot_t;
+
+/*
+ *  A pigz style pool, the producer hands out the blocks of the
+ *  stream to worker threads in order, they are (de)compressed in
+ *  parallel and retired in stream order as they complete
+ */
+typedef struct zlib_pool {
+	const char *name;		/* stressor name */
+	bool compress;			/* deflate or inflate side */
+	bool stop;			/* tells the workers to exit */
+	pthread_mutex_t lock;		/* protects the slot states */
+	pthread_cond_t work;		/* a slot was queued or stop set */
+	pthread_cond_t done;		/* a worker finished a slot */
+	zlib_slot_t *slots;		/* the ring of blocks in flight */
+	size_t n_slots;
+	uint64_t seq_in;		/* next block to produce */
+	uint64_t seq_out;		/* next block to retire */
+	pthread_t *threads;
+	size_t n_threads;		/* threads started */
+	int fd;				/* pipe end */
+	zlib_stats_t *stats;		/* per engine and data stats */
+	uint64_t *counter;		/* bogo ops, deflate side */
+	uint64_t max_ops;
+	int engines[ZLIB_ENGINE_MAX];	/* engines to pick from */
+	size_t n_engines;
+	uint64_t raw_bytes;		/* uncompressed bytes retired */
+} zlib_pool_t;
+
+typedef int (*zlib_pool_func)(zlib_pool_t *pool, zlib_slot_t *slot);
+
+/*
+ *  stress_zlib_slot_deflate()
+ *	generate and compress the block of a slot, the producer
+ *	has already set the engine and data generator in the header
+ */
+static bool stress_zlib_slot_deflate(
+	const char *name,
+	zlib_ctx_t *ctx,
+	zlib_slot_t *slot)
+{
+	zlib_header_t *hdr = (zlib_header_t *)slot->buf;
+	const size_t block_size = (size_t)opt_zlib_block_size;
+	size_t sz;
+	double t;
+
+	zlib_rand_data[hdr->rand_data].func(slot->data, (int)block_size);
+	hdr->checksum = (opt_flags & OPT_FLAGS_VERIFY) ?
+		stress_zlib_checksum(slot->data, block_size) : 0;
+
+	t = time_now();
+	sz = stress_zlib_compress(name, ctx, (int)hdr->engine, slot->data,
+		block_size, slot->buf + sizeof(*hdr),
+		stress_zlib_bound(block_size));
+	slot->t = time_now() - t;
+	hdr->comp_size = (uint32_t)sz;
+
+	return sz != 0;
+}
+
+/*
+ *  stress_zlib_slot_inflate()
+ *	decompress and check the block of a slot
+ */
+static bool stress_zlib_slot_inflate(
+	const char *name,
+	zlib_ctx_t *ctx,
+	zlib_slot_t *slot)
+{
+	const zlib_header_t *hdr = (zlib_header_t *)slot->buf;
+	size_t sz;
+	double t;
+
+	t = time_now();
+	sz = stress_zlib_decompress(name, ctx, (int)hdr->engine,
+		slot->buf + sizeof(*hdr), hdr->comp_size, slot->data,
+		(size_t)opt_zlib_block_size);
+	slot->t = time_now() - t;
+	if (!sz)
+		return false;
+	if (sz != hdr->raw_size) {
+		pr_fail(stderr, "%s: decompressed %zu bytes, expected %"
+			PRIu32 "\n", name, sz, hdr->raw_size);
+		return false;
+	}
+	if ((opt_flags & OPT_FLAGS_VERIFY) &&
+	    (stress_zlib_checksum(slot->data, sz) != hdr->checksum)) {
+		pr_fail(stderr, "%s: %s decompressed data checksum "
+			"mismatch\n", name, zlib_engine_names[hdr->engine]);
+		return false;
+	}
+	return true;
+}
+
+/*
+ *  stress_zlib_pool_next()
+ *	the earliest queued slot, or NULL if there is none,
+ *	called with the pool lock held
+ */
+static zlib_slot_t *stress_zlib_pool_next(zlib_pool_t *pool)
+{
+	zlib_slot_t *next = NULL;
+	size_t i;
+
+	for (i = 0; i < pool->n_slots; i++) {
+		zlib_slot_t *slot = &pool->slots[i];
+
+		if ((slot->state == ZLIB_SLOT_QUEUED) &&
+		    (!next || (slot->seq < next->seq)))
+			next = slot;
+	}
+	return next;
+}
+
+/*
+ *  stress_zlib_pool_thread()
+ *	a worker, (de)compresses queued slots until told to stop
+ */
+static void *stress_zlib_pool_thread(void *arg)
+{
+	static void *nowt = NULL;
+	zlib_pool_t *pool = (zlib_pool_t *)arg;
+	zlib_ctx_t ctx;
+	bool ctx_ok;
+	sigset_t set;
+
+	/* Leave all signal handling to the instance thread */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	ctx_ok = stress_zlib_ctx_init(pool->name, &ctx, pool->compress) == 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		zlib_slot_t *slot = NULL;
+
+		while (!pool->stop && !(slot = stress_zlib_pool_next(pool)))
+			pthread_cond_wait(&pool->work, &pool->lock);
+		if (pool->stop)
+			break;
+		slot->state = ZLIB_SLOT_BUSY;
+		pthread_mutex_unlock(&pool->lock);
+
+		slot->ok = ctx_ok && (pool->compress ?
+			stress_zlib_slot_deflate(pool->name, &ctx, slot) :
+			stress_zlib_slot_inflate(pool->name, &ctx, slot));
+
+		pthread_mutex_lock(&pool->lock);
+		slot->state = ZLIB_SLOT_DONE;
+		pthread_cond_broadcast(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	stress_zlib_ctx_free(&ctx);
+
+	return &nowt;
+}
+
+/*
+ *  stress_zlib_pool_init()
+ *	allocate two slots per thread so the workers are kept busy
+ *	while the oldest block is retired, and start the threads
+ */
+static int stress_zlib_pool_init(
+	zlib_pool_t *pool,
+	const char *name,
+	const bool compress,
+	const int fd,
+	zlib_stats_t *stats)
+{
+	const size_t block_size = (size_t)opt_zlib_block_size;
+	const size_t buf_size = sizeof(zlib_header_t) + stress_zlib_bound(block_size);
+	size_t i;
+
+	(void)memset(pool, 0, sizeof(*pool));
+	pool->name = name;
+	pool->compress = compress;
+	pool->fd = fd;
+	pool->stats = stats;
+	pool->n_engines = stress_zlib_engines(pool->engines);
+	pool->n_slots = 2 * (size_t)opt_zlib_threads;
+
+	pool->slots = calloc(pool->n_slots, sizeof(*pool->slots));
+	pool->threads = calloc(opt_zlib_threads, sizeof(*pool->threads));
+	if (!pool->slots || !pool->threads)
+		goto err;
+	for (i = 0; i < pool->n_slots; i++) {
+		pool->slots[i].data = malloc(block_size);
+		pool->slots[i].buf = malloc(buf_size);
+		if (!pool->slots[i].data || !pool->slots[i].buf)
+			goto err;
+	}
+
+	(void)pthread_mutex_init(&pool->lock, NULL);
+	(void)pthread_cond_init(&pool->work, NULL);
+	(void)pthread_cond_init(&pool->done, NULL);
+	for (i = 0; i < opt_zlib_threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL,
+				   stress_zlib_pool_thread, pool))
+			break;
+		pool->n_threads++;
+	}
+	if (pool->n_threads < opt_zlib_threads)
+		pr_inf(stderr, "%s: only %zu of %" PRIu32 " %s threads started\n",
+			name, pool->n_threads, opt_zlib_threads,
+			compress ? "deflate" : "inflate");
+	if (pool->n_threads)
+		return 0;
+
+	(void)pthread_cond_destroy(&pool->done);
+	(void)pthread_cond_destroy(&pool->work);
+	(void)pthread_mutex_destroy(&pool->lock);
+err:
+	pr_err(stderr, "%s: cannot set up the %s threads\n",
+		name, compress ? "deflate" : "inflate");
+	for (i = 0; pool->slots && (i < pool->n_slots); i++) {
+		free(pool->slots[i].buf);
+		free(pool->slots[i].data);
+	}
+	free(pool->threads);
+	free(pool->slots);
+	return -1;
+}
+
+/*
+ *  stress_zlib_pool_free()
+ *	stop the threads and free the slots
+ */
+static void stress_zlib_pool_free(zlib_pool_t *pool)
+{
+	size_t i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->work);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 0; i < pool->n_threads; i++)
+		(void)pthread_join(pool->threads[i], NULL);
+
+	(void)pthread_cond_destroy(&pool->done);
+	(void)pthread_cond_destroy(&pool->work);
+	(void)pthread_mutex_destroy(&pool->lock);
+	for (i = 0; i < pool->n_slots; i++) {
+		free(pool->slots[i].buf);
+		free(pool->slots[i].data);
+	}
+	free(pool->threads);
+	free(pool->slots);
+}
+
+/*
+ *  stress_zlib_pool_run()
+ *	fill free slots with produce, which returns 1 for a block,
+ *	0 at the end of the stream and -1 on error, and pass the
+ *	completed blocks to retire in stream order, which returns
+ *	0, 1 if no more blocks should be produced or -1 on error
+ */
+static int stress_zlib_pool_run(
+	zlib_pool_t *pool,
+	const zlib_pool_func produce,
+	const zlib_pool_func retire)
+{
+	bool end = false, failed = false;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		zlib_slot_t *slot;
+
+		while (!end && (pool->seq_in - pool->seq_out < pool->n_slots)) {
+			int r;
+
+			slot = &pool->slots[pool->seq_in % pool->n_slots];
+			slot->seq = pool->seq_in;
+			pthread_mutex_unlock(&pool->lock);
+			r = produce(pool, slot);
+			pthread_mutex_lock(&pool->lock);
+			if (r <= 0) {
+				failed |= (r < 0);
+				end = true;
 				break;
 			}
-			(*counter)++;
-		} while (do_run && stream_def.avail_out == 0);
-	} while (do_run);
+			slot->state = ZLIB_SLOT_QUEUED;
+			pool->seq_in++;
+			pthread_cond_signal(&pool->work);
+		}
+		if (pool->seq_out == pool->seq_in)
+			break;
+
+		slot = &pool->slots[pool->seq_out % pool->n_slots];
+		while (slot->state != ZLIB_SLOT_DONE)
+			pthread_cond_wait(&pool->done, &pool->lock);
+		pthread_mutex_unlock(&pool->lock);
+		if (!failed) {
+			const int r = retire(pool, slot);
+
+			failed |= (r < 0);
+			end |= (r != 0);
+		}
+		pthread_mutex_lock(&pool->lock);
+		slot->state = ZLIB_SLOT_FREE;
+		pool->seq_out++;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ *  stress_zlib_deflate_produce()
+ *	pick the engine and data of the next block, the worker
+ *	generates the data so that the producer is not a bottleneck
+ */
+static int stress_zlib_deflate_produce(zlib_pool_t *pool, zlib_slot_t *slot)
+{
+	zlib_header_t *hdr = (zlib_header_t *)slot->buf;
+
+	if (!opt_do_run || (pool->max_ops && (slot->seq >= pool->max_ops)))
+		return 0;
+
+	hdr->engine = (uint32_t)pool->engines[mwc32() % pool->n_engines];
+	hdr->rand_data = (opt_zlib_rand_data == ZLIB_RAND_DATA_ALL) ?
+		mwc32() % ZLIB_RAND_DATA_MAX : (uint32_t)opt_zlib_rand_data;
+	hdr->raw_size = (uint32_t)opt_zlib_block_size;
+	return 1;
+}
+
+/*
+ *  stress_zlib_deflate_retire()
+ *	account for a compressed block and write it down the pipe
+ */
+static int stress_zlib_deflate_retire(zlib_pool_t *pool, zlib_slot_t *slot)
+{
+	const zlib_header_t *hdr = (zlib_header_t *)slot->buf;
+	zlib_stats_t *s;
+	size_t len;
+	ssize_t wret;
+
+	if (!slot->ok)
+		return -1;
+
+	s = &pool->stats[(hdr->engine * ZLIB_RAND_DATA_MAX) + hdr->rand_data];
+	s->blocks++;
+	s->raw_bytes += hdr->raw_size;
+	s->comp_bytes += hdr->comp_size;
+	s->comp_time += slot->t;
+
+	len = sizeof(*hdr) + hdr->comp_size;
+	wret = write(pool->fd, slot->buf, len);
+	if (wret != (ssize_t)len) {
+		if ((wret < 0) && (errno != EINTR) && (errno != EPIPE)) {
+			pr_fail(stderr, "%s: write error: errno=%d (%s)\n",
+				pool->name, errno, strerror(errno));
+			return -1;
+		}
+		/* Interrupted at the end of the run */
+		return 1;
+	}
+	pool->raw_bytes += hdr->raw_size;
+	(*pool->counter)++;
+	return 0;
+}
+
+/*
+ *  stress_zlib_inflate_produce()
+ *	read the next block out of the pipe
+ */
+static int stress_zlib_inflate_produce(zlib_pool_t *pool, zlib_slot_t *slot)
+{
+	zlib_header_t *hdr = (zlib_header_t *)slot->buf;
+
+	if (!stress_zlib_read(pool->fd, hdr, sizeof(*hdr)))
+		return 0;
+	if ((hdr->engine >= ZLIB_ENGINE_MAX) ||
+	    (hdr->rand_data >= ZLIB_RAND_DATA_MAX) ||
+	    (hdr->raw_size > opt_zlib_block_size) ||
+	    (hdr->comp_size > stress_zlib_bound((size_t)opt_zlib_block_size))) {
+		pr_fail(stderr, "%s: corrupt block header\n", pool->name);
+		return -1;
+	}
+	if (!stress_zlib_read(pool->fd, slot->buf + sizeof(*hdr), hdr->comp_size))
+		return 0;
+	return 1;
+}
+
+/*
+ *  stress_zlib_inflate_retire()
+ *	account for a decompressed block
+ */
+static int stress_zlib_inflate_retire(zlib_pool_t *pool, zlib_slot_t *slot)
+{
+	const zlib_header_t *hdr = (zlib_header_t *)slot->buf;
+	zlib_stats_t *s;
+
+	if (!slot->ok)
+		return -1;
+
+	s = &pool->stats[(hdr->engine * ZLIB_RAND_DATA_MAX) + hdr->rand_data];
+	s->decomp_bytes += hdr->raw_size;
+	s->decomp_time += slot->t;
+	pool->raw_bytes += hdr->raw_size;
+	return 0;
+}
+
+/*
+ *  stress_zlib_calibrate()
+ *	the single thread deflate rate in MB/s of the same engine and
+ *	data mix, the baseline of the scaling efficiency
+ */
+static double stress_zlib_calibrate(const char *name, zlib_pool_t *pool)
+{
+	zlib_slot_t *slot = &pool->slots[0];
+	uint64_t raw_bytes = 0;
+	zlib_ctx_t ctx;
+	double t, t_end;
+
+	if (stress_zlib_ctx_init(name, &ctx, true) < 0) {
+		stress_zlib_ctx_free(&ctx);
+		return 0.0;
+	}
+	t = time_now();
+	t_end = t + ZLIB_CALIBRATE_TIME;
+	do {
+		slot->seq = 0;
+		(void)stress_zlib_deflate_produce(pool, slot);
+		if (!stress_zlib_slot_deflate(name, &ctx, slot))
+			break;
+		raw_bytes += opt_zlib_block_size;
+	} while (opt_do_run && (time_now() < t_end));
+	t = time_now() - t;
+	stress_zlib_ctx_free(&ctx);
+
+	return (t > 0.0) ? (double)raw_bytes / (t * MB) : 0.0;
+}
+
+/*
+ *  stress_zlib_deflate_parallel()
+ *	compress the stream with a pool of threads, rate is set
+ *	to the aggregate MB/s and single to the single thread MB/s
+ */
+static int stress_zlib_deflate_parallel(
+	const char *name,
+	const int fd,
+	const uint64_t max_ops,
+	uint64_t *counter,
+	zlib_stats_t *stats,
+	double *rate,
+	double *single)
+{
+	zlib_pool_t pool;
+	double t;
+	int ret;
+
+	if (stress_zlib_pool_init(&pool, name, true, fd, stats) < 0)
+		return EXIT_NO_RESOURCE;
+	pool.counter = counter;
+	pool.max_ops = max_ops;
 
-	pr_inf(stderr, "%s: instance %" PRIu32 ": compression ratio: %5.2f%%\n",
-		name, instance, 100.0 * (double)bytes_out / (double)bytes_in);
+	*single = stress_zlib_calibrate(name, &pool);
+	t = time_now();
+	ret = stress_zlib_pool_run(&pool, stress_zlib_deflate_produce,
+		stress_zlib_deflate_retire);
+	t = time_now() - t;
+	*rate = (t > 0.0) ? (double)pool.raw_bytes / (t * MB) : 0.0;
 
-	(void)deflateEnd(&stream_def);
+	stress_zlib_pool_free(&pool);
 	return ret;
 }
 
+/*
+ *  stress_zlib_inflate_parallel()
+ *	decompress the stream out of the pipe with a pool of threads
+ */
+static int stress_zlib_inflate_parallel(
+	const char *name,
+	const int fd,
+	zlib_stats_t *stats)
+{
+	zlib_pool_t pool;
+	int ret;
+
+	if (stress_zlib_pool_init(&pool, name, false, fd, stats) < 0)
+		return EXIT_NO_RESOURCE;
+	ret = stress_zlib_pool_run(&pool, stress_zlib_inflate_produce,
+		stress_zlib_inflate_retire);
+	stress_zlib_pool_free(&pool);
+
+	return ret;
+}
+#endif
+
+/*
+ *  stress_zlib_report()
+ *	report the compress and decompress MB/s and the ratio
+ *	per engine, broken down by data generator on instance 0,
+ *	returns the number of misc metrics set
+ */
+static size_t stress_zlib_report(
+	const char *name,
+	const uint32_t instance,
+	const zlib_stats_t *stats)
+{
+	int engine;
+	size_t idx = 0;
+
+	if (instance == 0)
+		pr_inf(stderr, "%s: %6s %8s %13s %15s %8s (%zuK blocks, level %"
+			PRIu32 ")\n", name, "engine", "data", "compress MB/s",
+			"decompress MB/s", "ratio %", (size_t)(opt_zlib_block_size / KB),
+			opt_zlib_level);
+
+	for (engine = 0; engine < ZLIB_ENGINE_MAX; engine++) {
+		zlib_stats_t total;
+		size_t i;
+		char desc[40];
+
+		(void)memset(&total, 0, sizeof(total));
+		for (i = 0; i < ZLIB_RAND_DATA_MAX; i++) {
+			const zlib_stats_t *s = &stats[(engine * ZLIB_RAND_DATA_MAX) + i];
+
+			if (!s->blocks)
+				continue;
+			total.blocks += s->blocks;
+			total.raw_bytes += s->raw_bytes;
+			total.comp_bytes += s->comp_bytes;
+			total.comp_time += s->comp_time;
+			total.decomp_bytes += s->decomp_bytes;
+			total.decomp_time += s->decomp_time;
+			if (instance != 0)
+				continue;
+			pr_inf(stderr, "%s: %6s %8s %13.2f %15.2f %8.2f\n",
+				name, zlib_engine_names[engine], zlib_rand_data[i].name,
+				(s->comp_time > 0.0) ?
+					(double)s->raw_bytes / (s->comp_time * MB) : 0.0,
+				(s->decomp_time > 0.0) ?
+					(double)s->decomp_bytes / (s->decomp_time * MB) : 0.0,
+				100.0 * (double)s->comp_bytes / (double)s->raw_bytes);
+		}
+		if (!total.blocks)
+			continue;
+
+		(void)snprintf(desc, sizeof(desc), "%s compress MB/s",
+			zlib_engine_names[engine]);
+		stress_misc_metric_set(idx++, desc, (total.comp_time > 0.0) ?
+			(double)total.raw_bytes / (total.comp_time * MB) : 0.0);
+		(void)snprintf(desc, sizeof(desc), "%s decompress MB/s",
+			zlib_engine_names[engine]);
+		stress_misc_metric_set(idx++, desc, (total.decomp_time > 0.0) ?
+			(double)total.decomp_bytes / (total.decomp_time * MB) : 0.0);
+		(void)snprintf(desc, sizeof(desc), "%s compression ratio %%",
+			zlib_engine_names[engine]);
+		stress_misc_metric_set(idx++, desc,
+			100.0 * (double)total.comp_bytes / (double)total.raw_bytes);
+	}
+	return idx;
+}
+
 /*
  *  stress_zlib()
  *	stress cpu with compression and decompression
@@ -360,12 +1374,33 @@ int stress_zlib(
 	const uint64_t max_ops,
 	const char *name)
 {
-	int ret, fds[2], status;
+	const size_t stats_size = sizeof(zlib_stats_t) *
+		ZLIB_ENGINE_MAX * ZLIB_RAND_DATA_MAX;
+	int ret, fds[2], status = 0;
+	zlib_stats_t *stats;
 	pid_t pid;
+	double rate = 0.0, single = 0.0;
+	size_t idx;
+
+#if !defined(HAVE_LIB_PTHREAD)
+	if (opt_zlib_threads && (instance == 0))
+		pr_inf(stderr, "%s: --zlib-threads needs pthread support, "
+			"using one deflater and one inflater\n", name);
+	opt_zlib_threads = 0;
+#endif
+
+	stats = mmap(NULL, stats_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (stats == MAP_FAILED) {
+		pr_err(stderr, "%s: mmap failed, errno=%d (%s)\n",
+			name, errno, strerror(errno));
+		return EXIT_NO_RESOURCE;
+	}
 
 	if (pipe(fds) < 0) {
 		pr_err(stderr, "%s: pipe failed, errno=%d (%s)\n",
 			name, errno, strerror(errno));
+		(void)munmap(stats, stats_size);
 		return EXIT_FAILURE;
 	}
 
@@ -373,6 +1408,7 @@ int stress_zlib(
 	if (pid < 0) {
 		(void)close(fds[0]);
 		(void)close(fds[1]);
+		(void)munmap(stats, stats_size);
 		pr_err(stderr, "%s: fork failed, errno=%d (%s)\n",
 			name, errno, strerror(errno));
 		return EXIT_FAILURE;
@@ -381,17 +1417,49 @@ int stress_zlib(
 		stress_parent_died_alarm();
 
 		(void)close(fds[1]);
-		ret = stress_zlib_inflate(name, fds[0]);
+#if defined(HAVE_LIB_PTHREAD)
+		if (opt_zlib_threads)
+			ret = stress_zlib_inflate_parallel(name, fds[0], stats);
+		else
+#endif
+			ret = stress_zlib_inflate(name, fds[0], stats);
 		(void)close(fds[0]);
 
 		exit(ret);
 	} else {
 		(void)close(fds[0]);
-		ret = stress_zlib_deflate(name, fds[1], instance, max_ops, counter);
+#if defined(HAVE_LIB_PTHREAD)
+		if (opt_zlib_threads)
+			ret = stress_zlib_deflate_parallel(name, fds[1], max_ops,
+				counter, stats, &rate, &single);
+		else
+#endif
+			ret = stress_zlib_deflate(name, fds[1], max_ops, counter, stats);
 		(void)close(fds[1]);
 	}
-	(void)kill(pid, SIGKILL);
-	(void)waitpid(pid, &status, 0);
+	/* The child drains the pipe and exits at EOF */
+	if ((waitpid(pid, &status, 0) < 0) && (errno == EINTR)) {
+		(void)kill(pid, SIGKILL);
+		(void)waitpid(pid, &status, 0);
+	}
+	if (WIFEXITED(status) && (WEXITSTATUS(status) != EXIT_SUCCESS))
+		ret = EXIT_FAILURE;
+
+	idx = stress_zlib_report(name, instance, stats);
+	if (opt_zlib_threads && (single > 0.0)) {
+		/* Aggregate rate against perfect scaling of one thread */
+		const double efficiency = 100.0 * rate /
+			(single * (double)opt_zlib_threads);
+
+		stress_misc_metric_set(idx++, "parallel compress MB/s", rate);
+		stress_misc_metric_set(idx++, "single thread compress MB/s", single);
+		stress_misc_metric_set(idx, "scaling efficiency %", efficiency);
+		pr_inf(stderr, "%s: %" PRIu32 " threads compress %.2f MB/s, "
+			"one thread %.2f MB/s, %.1f%% scaling efficiency "
+			"(instance %" PRIu32 ")\n", name, opt_zlib_threads,
+			rate, single, efficiency, instance);
+	}
+	(void)munmap(stats, stats_size);
 
 	return ret;
 }
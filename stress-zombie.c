@@ -27,14 +27,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
 
 #include "stress-ng.h"
 
+#define ZOMBIE_REAP_MIN		(16)	/* smallest number of zombies reaped */
+
+/* ways of reaping a batch of zombies */
+enum {
+	ZOMBIE_REAP_WAIT = 0,		/* wait(2) each in turn */
+	ZOMBIE_REAP_WAITID,		/* waitid(2) P_ALL each in turn */
+	ZOMBIE_REAP_PIDFD,		/* epoll on a pidfd each */
+	ZOMBIE_REAP_METHODS,
+};
+
+static const char *zombie_reap_names[ZOMBIE_REAP_METHODS] = {
+	"wait", "waitid", "pidfd"
+};
+
 static uint64_t opt_zombie_max = DEFAULT_ZOMBIES;
 static bool set_zombie_max = false;
+static bool opt_zombie_reap = false;
 
 typedef struct zombie {
 	pid_t	pid;
@@ -141,6 +161,260 @@ void stress_set_zombie_max(const char *optarg)
 		MIN_ZOMBIES, MAX_ZOMBIES);
 }
 
+void stress_set_zombie_reap(void)
+{
+	opt_zombie_reap = true;
+}
+
+/*
+ *  stress_zombie_pidfd_open()
+ *	pidfd of a child, -1 if pidfds are not supported
+ */
+static int stress_zombie_pidfd_open(const pid_t pid)
+{
+#if defined(__linux__) && defined(__NR_pidfd_open)
+	return (int)syscall(__NR_pidfd_open, pid, 0);
+#else
+	(void)pid;
+
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+/*
+ *  stress_zombie_spawn()
+ *	fork n children that exit straight away and return once
+ *	all have exited, each holds the write end of a pipe so
+ *	the read end sees EOF when the last has gone. With pidfds
+ *	a pidfd is then opened for each zombie, these are not
+ *	opened as the children are forked so they do not inherit
+ *	them. Returns the number forked, the pidfds are all -1 if
+ *	any cannot be opened
+ */
+static uint32_t stress_zombie_spawn(
+	pid_t *pids,
+	int *pidfds,
+	const uint32_t n)
+{
+	uint32_t i, spawned = 0;
+	bool pidfd_ok = (pidfds != NULL);
+	int fds[2];
+	char ch;
+
+	if (pipe(fds) < 0)
+		return 0;
+	for (i = 0; opt_do_run && (i < n); i++) {
+		pids[i] = fork();
+		if (pids[i] == 0) {
+			(void)setpgid(0, pgrp);
+			_exit(0);
+		}
+		if (pids[i] < 0)
+			break;
+		(void)setpgid(pids[i], pgrp);
+		spawned++;
+	}
+	(void)close(fds[1]);
+	while (read(fds[0], &ch, sizeof(ch)) > 0)
+		;
+	(void)close(fds[0]);
+
+	for (i = 0; pidfd_ok && (i < spawned); i++) {
+		pidfds[i] = stress_zombie_pidfd_open(pids[i]);
+		if (pidfds[i] < 0)
+			pidfd_ok = false;
+	}
+
+	if (pidfds && !pidfd_ok) {
+		for (i = 0; i < spawned; i++) {
+			if (pidfds[i] >= 0)
+				(void)close(pidfds[i]);
+			pidfds[i] = -1;
+		}
+	}
+	return spawned;
+}
+
+#if defined(__linux__)
+/*
+ *  stress_zombie_reap_pidfd()
+ *	reap zombies as their pidfds on an epoll set become
+ *	readable, returns the number reaped
+ */
+static uint32_t stress_zombie_reap_pidfd(
+	const pid_t *pids,
+	int *pidfds,
+	const uint32_t n)
+{
+	struct epoll_event events[64];
+	uint32_t i, reaped = 0;
+	int epfd;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0)
+		return 0;
+	for (i = 0; i < n; i++) {
+		struct epoll_event ev;
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.u32 = i;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, pidfds[i], &ev) < 0)
+			break;
+	}
+	if (i < n) {
+		(void)close(epfd);
+		return 0;
+	}
+
+	while (reaped < n) {
+		int k, ret;
+
+		ret = epoll_wait(epfd, events, (int)SIZEOF_ARRAY(events), 1000);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (ret == 0)
+			break;
+		for (k = 0; k < ret; k++) {
+			const uint32_t idx = events[k].data.u32;
+			int status;
+
+			(void)waitpid(pids[idx], &status, WNOHANG);
+			(void)close(pidfds[idx]);
+			pidfds[idx] = -1;
+			reaped++;
+		}
+	}
+	(void)close(epfd);
+	return reaped;
+}
+#endif
+
+/*
+ *  stress_zombie_reap()
+ *	compare how fast batches of zombies are reaped by wait,
+ *	waitid P_ALL and pidfds with epoll as the batch grows
+ *	from ZOMBIE_REAP_MIN by 4x up to --zombie-max
+ */
+static int stress_zombie_reap(
+	uint64_t *const counter,
+	const uint32_t instance,
+	const uint64_t max_ops,
+	const char *name)
+{
+	const uint32_t max = (uint32_t)STRESS_MAXIMUM(opt_zombie_max, ZOMBIE_REAP_MIN);
+	pid_t *pids;
+	int *pidfds;
+	bool reported = false;
+
+	pids = calloc(max, sizeof(*pids));
+	pidfds = calloc(max, sizeof(*pidfds));
+	if (!pids || !pidfds) {
+		pr_err(stderr, "%s: out of memory\n", name);
+		free(pidfds);
+		free(pids);
+		return EXIT_NO_RESOURCE;
+	}
+
+	do {
+		uint32_t n;
+		size_t idx = 0;
+
+		if ((instance == 0) && !reported)
+			pr_inf(stderr, "%s: %9s %14s %14s %14s\n", name,
+				"zombies", "wait/sec", "waitid/sec", "pidfd/sec");
+
+		for (n = ZOMBIE_REAP_MIN; opt_do_run && (n <= max); n *= 4) {
+			double rates[ZOMBIE_REAP_METHODS];
+			char buf[ZOMBIE_REAP_METHODS][16];
+			int m;
+
+			for (m = 0; m < ZOMBIE_REAP_METHODS; m++) {
+				uint32_t i, spawned, reaped = 0;
+				double t;
+
+				rates[m] = -1.0;
+				for (i = 0; i < n; i++)
+					pidfds[i] = -1;
+				spawned = stress_zombie_spawn(pids, (m == ZOMBIE_REAP_PIDFD) ?
+					pidfds : NULL, n);
+
+				t = time_now();
+				switch (m) {
+				case ZOMBIE_REAP_WAIT:
+					for (i = 0; i < spawned; i++) {
+						int status;
+
+						if (wait(&status) > 0)
+							reaped++;
+					}
+					break;
+				case ZOMBIE_REAP_WAITID:
+					for (i = 0; i < spawned; i++) {
+						siginfo_t info;
+
+						if (waitid(P_ALL, 0, &info, WEXITED) == 0)
+							reaped++;
+					}
+					break;
+#if defined(__linux__)
+				case ZOMBIE_REAP_PIDFD:
+					if (spawned && (pidfds[0] >= 0))
+						reaped = stress_zombie_reap_pidfd(pids, pidfds, spawned);
+					break;
+#endif
+				default:
+					break;
+				}
+				t = time_now() - t;
+
+				/* Anything not reaped, or pidfds not closed, is cleaned up */
+				for (i = 0; i < spawned; i++) {
+					int status;
+
+					if (pidfds[i] >= 0)
+						(void)close(pidfds[i]);
+					(void)waitpid(pids[i], &status, WNOHANG);
+				}
+				/* Only whole batches count */
+				if ((spawned == n) && (reaped == n) && (t > 0.0))
+					rates[m] = (double)n / t;
+				(*counter) += spawned;
+				if (max_ops && (*counter >= max_ops))
+					break;
+			}
+
+			for (m = 0; m < ZOMBIE_REAP_METHODS; m++) {
+				char desc[32];
+
+				if (rates[m] < 0.0) {
+					(void)snprintf(buf[m], sizeof(buf[m]), "-");
+					continue;
+				}
+				(void)snprintf(buf[m], sizeof(buf[m]), "%.0f", rates[m]);
+				(void)snprintf(desc, sizeof(desc), "%s %" PRIu32 " reaps/sec",
+					zombie_reap_names[m], n);
+				if (idx < STRESS_MISC_METRICS_MAX)
+					stress_misc_metric_set(idx++, desc, rates[m]);
+			}
+			if ((instance == 0) && !reported)
+				pr_inf(stderr, "%s: %9" PRIu32 " %14s %14s %14s\n",
+					name, n, buf[0], buf[1], buf[2]);
+			if (max_ops && (*counter >= max_ops))
+				break;
+		}
+		reported = true;
+	} while (opt_do_run && (!max_ops || *counter < max_ops));
+
+	free(pidfds);
+	free(pids);
+	return EXIT_SUCCESS;
+}
+
 /*
  *  stress_zombie()
  *	stress by zombieing and exiting
@@ -161,6 +435,8 @@ int stress_zombie(
 		if (opt_flags & OPT_FLAGS_MINIMIZE)
 			opt_zombie_max = MIN_ZOMBIES;
 	}
+	if (opt_zombie_reap)
+		return stress_zombie_reap(counter, instance, max_ops, name);
 
 	do {
 		if (zombies.length < opt_zombie_max) {
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/*
+ *  The io-uring-net stressor needs multishot accept/recv
+ *  and provided buffer rings, so check for all of them
+ */
+int main(void)
+{
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	struct io_uring_recvmsg_out out;
+
+	(void)p;
+	(void)reg;
+	(void)out;
+
+	return IORING_ACCEPT_MULTISHOT + IORING_RECV_MULTISHOT +
+		IORING_REGISTER_PBUF_RING + IORING_OP_WRITE_FIXED +
+		(int)syscall(__NR_io_uring_setup, 0, NULL);
+}
@@ -33,10 +33,96 @@
 #include <inttypes.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <signal.h>
+#include <time.h>
 
 #include "stress-ng.h"
 
 #if defined(STRESS_THERMAL_ZONES)
+
+#define TZ_SAMPLE_INTERVAL	(250)	/* milliseconds */
+#define TZ_TEMP_MAX		(250000) /* ignore crazy temperatures > 250 C */
+
+/* CPU thermal throttle counters of all the CPUs */
+typedef struct {
+	uint64_t core_count;		/* core throttle events, summed */
+	uint64_t core_ms;		/* core throttled time, summed */
+	uint64_t package_count;		/* package throttle events */
+	uint64_t package_ms;		/* package throttled time */
+} tz_throttle_t;
+
+static tz_throttle_t tz_throttle_start;
+static tz_throttle_t tz_throttle_last;
+static bool tz_throttle_valid;		/* thermal_throttle is available */
+static double tz_throttle_first = -1.0;	/* run time of first throttle */
+static double tz_time_start = -1.0;
+
+#if defined(HAVE_LIB_PTHREAD)
+static pthread_t tz_pthread;
+static pthread_mutex_t tz_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tz_cond = PTHREAD_COND_INITIALIZER;
+static bool tz_keep_sampling;
+static bool tz_pthread_running;
+#endif
+
+/*
+ *  tz_read_u64()
+ *	read a number from a sysfs file, false if not readable
+ */
+static bool tz_read_u64(const char *path, uint64_t *val)
+{
+	FILE *fp;
+	bool ret;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return false;
+	ret = (fscanf(fp, "%" SCNu64, val) == 1);
+	(void)fclose(fp);
+
+	return ret;
+}
+
+/*
+ *  tz_init_trips()
+ *	gather the trip points of a thermal zone, disabled
+ *	trip points (0 or silly temperatures) are ignored
+ */
+static void tz_init_trips(tz_info_t *tz_info)
+{
+	int k;
+
+	for (k = 0; tz_info->trips < STRESS_THERMAL_TRIPS_MAX; k++) {
+		char path[PATH_MAX];
+		uint64_t temp;
+		FILE *fp;
+		const uint32_t t = tz_info->trips;
+
+		snprintf(path, sizeof(path),
+			"/sys/class/thermal/%s/trip_point_%d_temp",
+			tz_info->path, k);
+		if (access(path, R_OK) < 0)
+			break;
+		if (!tz_read_u64(path, &temp) ||
+		    (temp == 0) || (temp > TZ_TEMP_MAX))
+			continue;
+
+		snprintf(path, sizeof(path),
+			"/sys/class/thermal/%s/trip_point_%d_type",
+			tz_info->path, k);
+		strcpy(tz_info->trip_type[t], "unknown");
+		if ((fp = fopen(path, "r")) != NULL) {
+			char type[sizeof(tz_info->trip_type[t])];
+
+			if (fgets(type, sizeof(type), fp) != NULL) {
+				type[strcspn(type, "\n")] = '\0';
+				strcpy(tz_info->trip_type[t], type);
+			}
+			(void)fclose(fp);
+		}
+		tz_info->trip_temp[t] = temp;
+		tz_info->trips++;
+	}
+}
 /*
  *  tz_init()
  *	gather all thermal zones
@@ -95,6 +181,7 @@ int tz_init(tz_info_t **tz_info_list)
 			closedir(dir);
 			return -1;
 		}
+		tz_init_trips(tz_info);
 		tz_info->index = i++;
 		tz_info->next = *tz_info_list;
 		*tz_info_list = tz_info;
@@ -132,39 +219,307 @@ int tz_get_temperatures(tz_info_t **tz_info_list, stress_tz_t *tz)
 
 	for (tz_info = *tz_info_list; tz_info; tz_info = tz_info->next) {
 		char path[PATH_MAX];
-		FILE *fp;
 		size_t i = tz_info->index;
 
 		snprintf(path, sizeof(path),
 			"/sys/class/thermal/%s/temp",
 			tz_info->path);
 
-		tz->tz_stat[i].temperature = 0;
-		if ((fp = fopen(path, "r")) != NULL) {
-			if (fscanf(fp, "%" SCNu64,
-			     &tz->tz_stat[i].temperature) != 1) {
-				tz->tz_stat[i].temperature = 0;
-			}
-			fclose(fp);
-		}
+		if (!tz_read_u64(path, &tz->tz_stat[i].temperature))
+			tz->tz_stat[i].temperature = 0;
 	}
 	return 0;
 }
 
+/*
+ *  tz_throttle_read()
+ *	read the thermal_throttle counters of the CPUs, all the
+ *	CPUs of a package report the same package counters so
+ *	the highest is used. Returns false if there are none
+ */
+static bool tz_throttle_read(tz_throttle_t *t)
+{
+	const int32_t cpus = stress_get_processors_configured();
+	int32_t cpu;
+	bool found = false;
+
+	memset(t, 0, sizeof(*t));
+	for (cpu = 0; cpu < cpus; cpu++) {
+		char path[PATH_MAX];
+		uint64_t val;
+
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%"
+			PRId32 "/thermal_throttle/core_throttle_count", cpu);
+		if (!tz_read_u64(path, &val))
+			continue;
+		found = true;
+		t->core_count += val;
+
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%"
+			PRId32 "/thermal_throttle/core_throttle_total_time_ms", cpu);
+		if (tz_read_u64(path, &val))
+			t->core_ms += val;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%"
+			PRId32 "/thermal_throttle/package_throttle_count", cpu);
+		if (tz_read_u64(path, &val) && (val > t->package_count))
+			t->package_count = val;
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%"
+			PRId32 "/thermal_throttle/package_throttle_total_time_ms", cpu);
+		if (tz_read_u64(path, &val) && (val > t->package_ms))
+			t->package_ms = val;
+	}
+	return found;
+}
+
+/*
+ *  tz_sample()
+ *	sample the thermal zones and throttle counters, the time
+ *	since the last sample is charged to each trip point the
+ *	zone is at or above. Trip points being reached and new
+ *	throttling are reported at once so throughput dips can
+ *	be tied to them while the run is still going
+ */
+static void tz_sample(double *last_time)
+{
+	tz_info_t *tz_info;
+	tz_throttle_t t;
+	const double now = time_now();
+	const double dt = now - *last_time;
+
+	for (tz_info = shared->tz_info; tz_info; tz_info = tz_info->next) {
+		char path[PATH_MAX];
+		uint64_t temp;
+		uint32_t k;
+
+		snprintf(path, sizeof(path),
+			"/sys/class/thermal/%s/temp",
+			tz_info->path);
+		if (!tz_read_u64(path, &temp) || (temp > TZ_TEMP_MAX))
+			continue;
+
+		if (temp > tz_info->max_temp)
+			tz_info->max_temp = temp;
+		tz_info->sum_temp += temp;
+		tz_info->samples++;
+
+		for (k = 0; k < tz_info->trips; k++) {
+			if (temp < tz_info->trip_temp[k])
+				continue;
+			if (tz_info->trip_time[k] == 0.0)
+				pr_inf(stdout, "thermal zone %s reached %s trip "
+					"point %.2f °C after %.2fs\n",
+					tz_info->type, tz_info->trip_type[k],
+					(double)tz_info->trip_temp[k] / 1000.0,
+					now - tz_time_start);
+			tz_info->trip_time[k] += dt;
+		}
+	}
+
+	if (tz_throttle_valid && tz_throttle_read(&t)) {
+		if ((t.core_count > tz_throttle_last.core_count) ||
+		    (t.package_count > tz_throttle_last.package_count)) {
+			pr_inf(stdout, "CPU thermal throttling after %.2fs, "
+				"%" PRIu64 " core and %" PRIu64 " package events\n",
+				now - tz_time_start,
+				t.core_count - tz_throttle_last.core_count,
+				t.package_count - tz_throttle_last.package_count);
+			if (tz_throttle_first < 0.0)
+				tz_throttle_first = now - tz_time_start;
+		}
+		tz_throttle_last = t;
+	}
+	*last_time = now;
+}
+
+#if defined(HAVE_LIB_PTHREAD)
+/*
+ *  tz_sample_thread()
+ *	periodically sample the thermal zones until told to stop
+ */
+static void *tz_sample_thread(void *arg)
+{
+	static void *nowt = NULL;
+	double last_time = time_now();
+	sigset_t set;
+	struct timespec abstime;
+
+	(void)arg;
+
+	/* Leave all signal handling to the main parent thread */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, NULL);
+	(void)clock_gettime(CLOCK_REALTIME, &abstime);
+
+	pthread_mutex_lock(&tz_mutex);
+	while (tz_keep_sampling) {
+		abstime.tv_nsec += TZ_SAMPLE_INTERVAL * 1000000;
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_nsec -= 1000000000;
+			abstime.tv_sec++;
+		}
+		/* Sleep until the next sample is due or we are stopped */
+		while (tz_keep_sampling &&
+		       (pthread_cond_timedwait(&tz_cond, &tz_mutex, &abstime) == 0))
+			;
+		tz_sample(&last_time);
+	}
+	pthread_mutex_unlock(&tz_mutex);
+
+	return &nowt;
+}
+#endif
+
+/*
+ *  tz_sample_start()
+ *	start sampling the thermal zones from the parent while
+ *	the stressors run
+ */
+void tz_sample_start(void)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	int ret;
+
+	if (tz_time_start < 0.0) {
+		tz_time_start = time_now();
+		tz_throttle_valid = tz_throttle_read(&tz_throttle_start);
+		tz_throttle_last = tz_throttle_start;
+	}
+
+	tz_keep_sampling = true;
+	ret = pthread_create(&tz_pthread, NULL, tz_sample_thread, NULL);
+	if (ret) {
+		pr_err(stderr, "tz: cannot create sampling thread: "
+			"errno=%d (%s)\n", ret, strerror(ret));
+		return;
+	}
+	tz_pthread_running = true;
+#endif
+}
+
+/*
+ *  tz_sample_stop()
+ *	stop sampling and wait for the sample thread to finish
+ */
+void tz_sample_stop(void)
+{
+#if defined(HAVE_LIB_PTHREAD)
+	if (!tz_pthread_running)
+		return;
+
+	pthread_mutex_lock(&tz_mutex);
+	tz_keep_sampling = false;
+	pthread_cond_signal(&tz_cond);
+	pthread_mutex_unlock(&tz_mutex);
+	(void)pthread_join(tz_pthread, NULL);
+	tz_pthread_running = false;
+#endif
+}
+
+/*
+ *  tz_sample_dump()
+ *	dump the maximum and mean sampled temperatures, time
+ *	spent at or above trip points and CPU throttling
+ */
+static void tz_sample_dump(FILE *yaml, json_t *json)
+{
+	tz_info_t *tz_info;
+	bool dumped_heading = false;
+
+	for (tz_info = shared->tz_info; tz_info; tz_info = tz_info->next) {
+		const double max = (double)tz_info->max_temp / 1000.0;
+		double mean;
+		uint32_t k;
+
+		if (!tz_info->samples)
+			continue;
+		mean = ((double)tz_info->sum_temp / tz_info->samples) / 1000.0;
+		if (!dumped_heading) {
+			dumped_heading = true;
+			pr_inf(stdout, "thermal zones sampled every %dms:\n",
+				TZ_SAMPLE_INTERVAL);
+			pr_yaml(yaml, "thermal-zone-samples:\n");
+			json_array_begin(json, "thermal-zone-samples");
+		}
+		pr_inf(stdout, "%20s %7.2f °C max, %7.2f °C mean\n",
+			tz_info->type, max, mean);
+		pr_yaml(yaml, "    - zone: %s\n", tz_info->type);
+		pr_yaml(yaml, "      max: %7.2f\n", max);
+		pr_yaml(yaml, "      mean: %7.2f\n", mean);
+		json_obj_begin(json, NULL);
+		json_str(json, "zone", tz_info->type);
+		json_double(json, "max", max);
+		json_double(json, "mean", mean);
+		for (k = 0; k < tz_info->trips; k++) {
+			char key[64];
+
+			if (tz_info->trip_time[k] == 0.0)
+				continue;
+			snprintf(key, sizeof(key), "secs-above-%s-%.0f",
+				tz_info->trip_type[k],
+				(double)tz_info->trip_temp[k] / 1000.0);
+			pr_inf(stdout, "%20s %7.2fs at or above %s trip point "
+				"%.2f °C\n", "", tz_info->trip_time[k],
+				tz_info->trip_type[k],
+				(double)tz_info->trip_temp[k] / 1000.0);
+			pr_yaml(yaml, "      %s: %.2f\n", key, tz_info->trip_time[k]);
+			json_double(json, key, tz_info->trip_time[k]);
+		}
+		pr_yaml(yaml, "\n");
+		json_obj_end(json);
+	}
+	if (dumped_heading)
+		json_array_end(json);
+
+	if (tz_throttle_valid) {
+		const uint64_t core_count = tz_throttle_last.core_count -
+					    tz_throttle_start.core_count;
+		const uint64_t package_count = tz_throttle_last.package_count -
+					       tz_throttle_start.package_count;
+		const double core_secs = (double)(tz_throttle_last.core_ms -
+					  tz_throttle_start.core_ms) / 1000.0;
+		const double package_secs = (double)(tz_throttle_last.package_ms -
+					     tz_throttle_start.package_ms) / 1000.0;
+
+		if (core_count || package_count)
+			pr_inf(stdout, "CPU thermal throttling: %" PRIu64
+				" core events (%.2fs), %" PRIu64 " package events "
+				"(%.2fs), first after %.2fs\n",
+				core_count, core_secs, package_count,
+				package_secs, tz_throttle_first);
+		else
+			pr_inf(stdout, "no CPU thermal throttling detected\n");
+		pr_yaml(yaml, "thermal-throttling:\n");
+		pr_yaml(yaml, "      core-events: %" PRIu64 "\n", core_count);
+		pr_yaml(yaml, "      core-secs: %.2f\n", core_secs);
+		pr_yaml(yaml, "      package-events: %" PRIu64 "\n", package_count);
+		pr_yaml(yaml, "      package-secs: %.2f\n", package_secs);
+		pr_yaml(yaml, "      first-event-secs: %.2f\n", tz_throttle_first);
+		pr_yaml(yaml, "\n");
+		json_obj_begin(json, "thermal-throttling");
+		json_uint(json, "core-events", core_count);
+		json_double(json, "core-secs", core_secs);
+		json_uint(json, "package-events", package_count);
+		json_double(json, "package-secs", package_secs);
+		json_double(json, "first-event-secs", tz_throttle_first);
+		json_obj_end(json);
+	}
+}
+
 /*
  *  tz_dump()
  *	dump thermal zone temperatures
  */
 void tz_dump(
 	FILE *yaml,
+	json_t *json,
 	const stress_t stressors[],
-	const proc_info_t procs[STRESS_MAX],
-	const int32_t max_procs)
+	const proc_info_t procs[STRESS_MAX])
 {
 	uint32_t i;
 	bool no_tz_stats = true;
 
 	pr_yaml(yaml, "thermal-zones:\n");
+	json_array_begin(json, "thermal-zones");
 
 	for (i = 0; i < STRESS_MAX; i++) {
 		tz_info_t *tz_info;
@@ -176,11 +531,11 @@ void tz_dump(
 		for (tz_info = shared->tz_info; tz_info; tz_info = tz_info->next) {
 			for (j = 0; j < procs[i].started_procs; j++) {
 				uint64_t temp;
-				int32_t n = (i * max_procs) + j;
+				int32_t n = procs[i].stats_index + j;
 
-				temp = shared->stats[n].tz.tz_stat[tz_info->index].temperature;
+				temp = shared->tz_stats[n].tz_stat[tz_info->index].temperature;
 				/* Avoid crazy temperatures. e.g. > 250 C */
-				if (temp > 250000)
+				if (temp > TZ_TEMP_MAX)
 					temp = 0;
 				total += temp;
 				count++;
@@ -195,20 +550,28 @@ void tz_dump(
 					pr_inf(stdout, "%s:\n", munged);
 					pr_yaml(yaml, "    - stressor: %s\n",
 					munged);
+					json_obj_begin(json, NULL);
+					json_str(json, "stressor", munged);
 				}
 				pr_inf(stdout, "%20s %7.2f °C\n",
 					tz_info->type, temp);
 				pr_yaml(yaml, "      %s: %7.2f\n",
 					tz_info->type, temp);
+				json_double(json, tz_info->type, temp);
 				no_tz_stats = false;
 			}
 		}
 		if (total)
 			pr_yaml(yaml, "\n");
+		if (dumped_heading)
+			json_obj_end(json);
 	}
+	json_array_end(json);
 
 	if (no_tz_stats)
 		pr_inf(stdout, "thermal zone temperatures not available\n");
+
+	tz_sample_dump(yaml, json);
 }
 
 #endif
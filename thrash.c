@@ -44,8 +44,79 @@
 #include <errno.h>
 #include <dirent.h>
 #include <ctype.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if !defined(MADV_COLD)
+#define MADV_COLD		(20)
+#endif
+#if !defined(MADV_PAGEOUT)
+#define MADV_PAGEOUT		(21)
+#endif
+#if !defined(SYS_pidfd_open)
+#define SYS_pidfd_open		(434)
+#endif
+#if !defined(SYS_process_madvise)
+#define SYS_process_madvise	(440)
+#endif
+
+#define THRASH_RECLAIM_TICK	(100)	/* ms between reclaim rounds */
+#define THRASH_RECLAIM_IOV	(64)	/* ranges per process_madvise call */
+#define THRASH_PROBE_PAGES	(256)	/* pages of the refault probe */
+
+/* What the reclaim driver did, shared with the parent */
+typedef struct {
+	uint64_t advised;		/* bytes advised */
+	uint64_t calls;			/* process_madvise calls */
+	uint64_t failed;		/* process_madvise failures */
+	uint64_t procs;			/* stressor processes seen per round, summed */
+	uint64_t rounds;		/* reclaim rounds */
+	uint64_t probe_refaults;	/* probe pages found reclaimed */
+#if defined(STRESS_LATENCY)
+	stress_latency_t refault;	/* probe refault latency */
+#endif
+} thrash_reclaim_t;
+
+/* /proc/vmstat counters reported by the reclaim driver */
+static const char *thrash_vmstat[] = {
+	"workingset_refault_anon",
+	"workingset_refault_file",
+	"workingset_activate_anon",
+	"workingset_activate_file",
+	"pswpin",
+	"pswpout",
+};
+
+#define THRASH_VMSTATS	SIZEOF_ARRAY(thrash_vmstat)
 
 static pid_t thrash_pid;
+static uint64_t opt_thrash_reclaim;	/* MB/sec to reclaim, 0 = page in */
+static bool opt_thrash_reclaim_cold;	/* MADV_COLD rather than MADV_PAGEOUT */
+static thrash_reclaim_t *thrash_reclaim;
+static uint64_t thrash_vmstat_start[THRASH_VMSTATS];
+static double thrash_time_start;
+
+/*
+ *  stress_set_thrash_reclaim()
+ *	set the rate the reclaim driver advises stressor memory at
+ */
+void stress_set_thrash_reclaim(const char *optarg)
+{
+	opt_thrash_reclaim = get_uint64(optarg);
+	check_range("thrash-reclaim", opt_thrash_reclaim,
+		MIN_THRASH_RECLAIM, MAX_THRASH_RECLAIM);
+	opt_flags |= OPT_FLAGS_THRASH;
+}
+
+/*
+ *  stress_set_thrash_reclaim_cold()
+ *	deactivate the pages with MADV_COLD rather than reclaim them
+ */
+void stress_set_thrash_reclaim_cold(void)
+{
+	opt_thrash_reclaim_cold = true;
+}
 
 static int pagein_proc(const pid_t pid)
 {
@@ -117,6 +188,226 @@ static int pagein_all_procs(void)
 	return 0;
 }
 
+/*
+ *  thrash_vmstat_read()
+ *	read the refault and swap counters of /proc/vmstat
+ */
+static void thrash_vmstat_read(uint64_t vals[THRASH_VMSTATS])
+{
+	char buf[128];
+	FILE *fp;
+
+	memset(vals, 0, sizeof(uint64_t) * THRASH_VMSTATS);
+	fp = fopen("/proc/vmstat", "r");
+	if (!fp)
+		return;
+	while (fgets(buf, sizeof(buf), fp)) {
+		char name[64];
+		uint64_t val;
+		size_t i;
+
+		if (sscanf(buf, "%63s %" SCNu64, name, &val) != 2)
+			continue;
+		for (i = 0; i < THRASH_VMSTATS; i++)
+			if (!strcmp(name, thrash_vmstat[i]))
+				vals[i] = val;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ *  thrash_reclaim_proc()
+ *	advise up to budget bytes of the mappings of a process,
+ *	starting from a random mapping and wrapping around so
+ *	over the rounds the whole address space is covered,
+ *	returns the bytes advised
+ */
+static uint64_t thrash_reclaim_proc(const pid_t pid, const uint64_t budget)
+{
+	static struct iovec maps[4096];
+	char path[64], buffer[4096];
+	struct iovec iov[THRASH_RECLAIM_IOV];
+	uint64_t done = 0;
+	size_t n_maps = 0, i, n = 0, start;
+	int pidfd;
+	const int advice = opt_thrash_reclaim_cold ? MADV_COLD : MADV_PAGEOUT;
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return 0;
+	while (fgets(buffer, sizeof(buffer), fp) && (n_maps < SIZEOF_ARRAY(maps))) {
+		uintmax_t begin, end;
+
+		if (sscanf(buffer, "%jx-%jx", &begin, &end) != 2)
+			continue;
+		/* The vdso and friends cannot be reclaimed */
+		if (strstr(buffer, "[v"))
+			continue;
+		maps[n_maps].iov_base = (void *)begin;
+		maps[n_maps].iov_len = (size_t)(end - begin);
+		n_maps++;
+	}
+	(void)fclose(fp);
+	if (!n_maps)
+		return 0;
+
+	pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+	if (pidfd < 0)
+		return 0;
+	start = mwc32() % n_maps;
+	for (i = 0; (i < n_maps) && (done < budget); i++) {
+		const struct iovec *map = &maps[(start + i) % n_maps];
+
+		iov[n].iov_base = map->iov_base;
+		iov[n].iov_len = (size_t)STRESS_MINIMUM(map->iov_len, budget - done);
+		done += iov[n].iov_len;
+		if ((++n == THRASH_RECLAIM_IOV) || (i + 1 == n_maps) || (done >= budget)) {
+			thrash_reclaim->calls++;
+			if (syscall(SYS_process_madvise, pidfd, iov, n, advice, 0) < 0)
+				thrash_reclaim->failed++;
+			n = 0;
+		}
+	}
+	(void)close(pidfd);
+
+	return done;
+}
+
+/*
+ *  thrash_reclaim_round()
+ *	share budget bytes of reclaim between the stressor
+ *	processes, found by their process group
+ */
+static void thrash_reclaim_round(const uint64_t budget)
+{
+	pid_t pids[1024];
+	size_t n = 0, i;
+	DIR *dp;
+	struct dirent *d;
+	const pid_t self = getpid(), parent = getppid();
+
+	dp = opendir("/proc");
+	if (!dp)
+		return;
+	while (((d = readdir(dp)) != NULL) && (n < SIZEOF_ARRAY(pids))) {
+		pid_t pid;
+
+		if (!isdigit(d->d_name[0]) ||
+		    (sscanf(d->d_name, "%d", &pid) != 1))
+			continue;
+		if ((pid == self) || (pid == parent) || (getpgid(pid) != pgrp))
+			continue;
+		pids[n++] = pid;
+	}
+	(void)closedir(dp);
+
+	thrash_reclaim->rounds++;
+	thrash_reclaim->procs += n;
+	if (!n)
+		return;
+	for (i = 0; i < n; i++)
+		thrash_reclaim->advised +=
+			thrash_reclaim_proc(pids[i], budget / n);
+}
+
+/*
+ *  thrash_probe()
+ *	reclaim the probe pages and time touching them again, the
+ *	pages found reclaimed by mincore give the refault latency
+ *	of the moment
+ */
+static void thrash_probe(uint8_t *probe, const size_t page_size)
+{
+	unsigned char vec[THRASH_PROBE_PAGES];
+	size_t i;
+
+	(void)madvise(probe, THRASH_PROBE_PAGES * page_size, MADV_PAGEOUT);
+	if (mincore(probe, THRASH_PROBE_PAGES * page_size, vec) < 0)
+		return;
+	for (i = 0; i < THRASH_PROBE_PAGES; i++) {
+		volatile uint8_t *ptr = probe + (i * page_size);
+		uint64_t t;
+
+		if (vec[i] & 1)
+			continue;
+		t = time_ticks();
+		(void)*ptr;
+		t = time_ticks() - t;
+		thrash_reclaim->probe_refaults++;
+#if defined(STRESS_LATENCY)
+		latency_record(&thrash_reclaim->refault, time_ticks_to_ns(t));
+#else
+		(void)t;
+#endif
+	}
+}
+
+/*
+ *  thrash_reclaim_driver()
+ *	every tick advise the rate's share of the stressors'
+ *	memory with process_madvise and probe the refault cost
+ */
+static void thrash_reclaim_driver(void)
+{
+	const size_t page_size = stress_get_pagesize();
+	const uint64_t budget = (opt_thrash_reclaim * MB * THRASH_RECLAIM_TICK) / 1000;
+	uint8_t *probe;
+	size_t i;
+
+	/* Anonymous pages need swap, without it the probe never refaults */
+	probe = mmap(NULL, THRASH_PROBE_PAGES * page_size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (probe != MAP_FAILED)
+		for (i = 0; i < THRASH_PROBE_PAGES; i++)
+			probe[i * page_size] = (uint8_t)i | 1;
+
+	while (opt_do_run) {
+		thrash_reclaim_round(budget);
+		if (probe != MAP_FAILED)
+			thrash_probe(probe, page_size);
+		(void)usleep(THRASH_RECLAIM_TICK * 1000);
+	}
+}
+
+/*
+ *  thrash_reclaim_dump()
+ *	report what the reclaim driver did and the refaults
+ *	it caused
+ */
+static void thrash_reclaim_dump(void)
+{
+	uint64_t vals[THRASH_VMSTATS];
+	const double secs = time_now() - thrash_time_start;
+	size_t i;
+
+	pr_inf(stdout, "thrash: %s %.1f MB (%.1f MB/sec) of %.1f stressor "
+		"processes in %" PRIu64 " process_madvise calls, %" PRIu64
+		" failed\n", opt_thrash_reclaim_cold ? "MADV_COLD" : "MADV_PAGEOUT",
+		(double)thrash_reclaim->advised / (double)MB,
+		secs > 0.0 ? ((double)thrash_reclaim->advised / (double)MB) / secs : 0.0,
+		thrash_reclaim->rounds ?
+			(double)thrash_reclaim->procs / (double)thrash_reclaim->rounds : 0.0,
+		thrash_reclaim->calls, thrash_reclaim->failed);
+#if defined(STRESS_LATENCY)
+	if (thrash_reclaim->probe_refaults)
+		pr_inf(stdout, "thrash: probe refault latency p50 %" PRIu64
+			" ns, p99 %" PRIu64 " ns, max %" PRIu64 " ns over %"
+			PRIu64 " refaults\n",
+			latency_percentile(&thrash_reclaim->refault, 0.50),
+			latency_percentile(&thrash_reclaim->refault, 0.99),
+			thrash_reclaim->refault.max, thrash_reclaim->probe_refaults);
+	else
+#endif
+		pr_inf(stdout, "thrash: no probe pages were reclaimed, "
+			"anonymous pages need swap to be reclaimed\n");
+	thrash_vmstat_read(vals);
+	for (i = 0; i < THRASH_VMSTATS; i++)
+		pr_inf(stdout, "thrash: %-24s %12" PRIu64 "\n", thrash_vmstat[i],
+			vals[i] - thrash_vmstat_start[i]);
+}
+
 int thrash_start(void)
 {
 	if (geteuid() != 0) {
@@ -127,12 +418,27 @@ int thrash_start(void)
 		pr_err(stderr, "thrash background process already started\n");
 		return -1;
 	}
+	if (opt_thrash_reclaim) {
+		thrash_reclaim = mmap(NULL, sizeof(*thrash_reclaim),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (thrash_reclaim == MAP_FAILED) {
+			pr_err(stderr, "thrash: cannot mmap reclaim statistics\n");
+			thrash_reclaim = NULL;
+			return -1;
+		}
+		thrash_vmstat_read(thrash_vmstat_start);
+		thrash_time_start = time_now();
+	}
 	thrash_pid = fork();
 	if (thrash_pid < 0) {
 		pr_err(stderr, "thrash background process failed to fork: %d (%s)\n",
 			errno, strerror(errno));
 		return -1;
 	} else if (thrash_pid == 0) {
+		if (thrash_reclaim) {
+			thrash_reclaim_driver();
+			_exit(0);
+		}
 		while (opt_do_run) {
 			pagein_all_procs();
 			sleep(1);
@@ -153,6 +459,11 @@ void thrash_stop(void)
 	(void)waitpid(thrash_pid, &status, 0);
 
 	thrash_pid = 0;
+	if (thrash_reclaim) {
+		thrash_reclaim_dump();
+		(void)munmap(thrash_reclaim, sizeof(*thrash_reclaim));
+		thrash_reclaim = NULL;
+	}
 }
 
 #else
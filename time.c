@@ -25,16 +25,24 @@
 #define _GNU_SOURCE
 
 #include <stdio.h>
+#include <time.h>
 #include <sys/time.h>
 
 #include "stress-ng.h"
 
+#if defined(STRESS_X86)
+#include <cpuid.h>
+#endif
+
 #define SECONDS_IN_MINUTE	(60.0)
 #define SECONDS_IN_HOUR		(60.0 * SECONDS_IN_MINUTE)
 #define SECONDS_IN_DAY		(24.0 * SECONDS_IN_HOUR)
 #define SECONDS_IN_YEAR		(365.2425 * SECONDS_IN_DAY)
 				/* Approx, for Gregorian calendar */
 
+#define BW_PACE_SLACK		(0.01)	/* seconds behind before resync */
+#define CALIBRATE_NS		(20000000ULL)	/* TSC calibration period */
+
 /*
  *  time_now()
  *	time in seconds as a double
@@ -49,6 +57,79 @@ double time_now(void)
 	return timeval_to_double(&now);
 }
 
+/*
+ *  time_mono_ns()
+ *	CLOCK_MONOTONIC in nanoseconds, for time stamps passed
+ *	across exec where the time_now_ns() time base is lost
+ */
+uint64_t time_mono_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+		return 0;
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/*
+ *  time_calibrate()
+ *	pick the time_ticks() time base, called once from main()
+ *	once shared memory is mapped so all stressors share it.
+ *	x86 uses the TSC only when it is invariant and is calibrated
+ *	against CLOCK_MONOTONIC_RAW, arm64 reads the CNTVCT frequency
+ *	from CNTFRQ, anything else falls back to clock_gettime()
+ */
+void time_calibrate(void)
+{
+	shared->timebase.counter = false;
+	shared->timebase.ns_per_tick = 1.0;
+
+#if defined(STRESS_X86)
+	{
+		unsigned int eax, ebx, ecx, edx;
+		uint64_t ns0, ns1, t0, t1;
+
+		if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) ||
+		    !(edx & (1U << 8))) {
+			pr_dbg(stderr, "timebase: TSC not invariant, using clock_gettime()\n");
+			return;
+		}
+		ns0 = time_ticks();
+		shared->timebase.counter = true;
+		t0 = time_ticks();
+		shared->timebase.counter = false;
+		do {
+			ns1 = time_ticks();
+		} while (ns1 - ns0 < CALIBRATE_NS);
+		shared->timebase.counter = true;
+		t1 = time_ticks();
+		if (t1 <= t0) {
+			shared->timebase.counter = false;
+			pr_dbg(stderr, "timebase: TSC not advancing, using clock_gettime()\n");
+			return;
+		}
+		shared->timebase.ns_per_tick = (double)(ns1 - ns0) / (double)(t1 - t0);
+	}
+#elif defined(__aarch64__)
+	{
+		uint64_t freq;
+
+		asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+		if (!freq) {
+			pr_dbg(stderr, "timebase: CNTFRQ is zero, using clock_gettime()\n");
+			return;
+		}
+		shared->timebase.counter = true;
+		shared->timebase.ns_per_tick = 1000000000.0 / (double)freq;
+	}
+#endif
+	if (shared->timebase.counter)
+		pr_dbg(stderr, "timebase: cycle counter at %.3f MHz\n",
+			1000.0 / shared->timebase.ns_per_tick);
+	else
+		pr_dbg(stderr, "timebase: using clock_gettime()\n");
+}
+
 /*
  *  format_time()
  *	format a unit of time into human readable format
@@ -104,3 +185,46 @@ const char *duration_to_str(const double duration)
 	}
 	return str;
 }
+
+/*
+ *  bw_pace_init()
+ *	start pacing at rate bytes/sec, a rate of 0
+ *	turns pacing off
+ */
+void bw_pace_init(bw_pace_t *pace, const double rate)
+{
+	pace->start = time_now();
+	pace->bytes = 0.0;
+	pace->rate = rate;
+}
+
+/*
+ *  bw_pace()
+ *	account for bytes moved and sleep until the time
+ *	they are due at the target rate. Sleeps are against
+ *	the start time so any oversleep is made up on the
+ *	next quantum, but falling more than BW_PACE_SLACK
+ *	behind (e.g. descheduled) restarts the schedule
+ *	rather than bursting to catch up
+ */
+void bw_pace(bw_pace_t *pace, const uint64_t bytes)
+{
+	double now, due;
+
+	if (pace->rate <= 0.0)
+		return;
+
+	pace->bytes += (double)bytes;
+	due = pace->start + (pace->bytes / pace->rate);
+	now = time_now();
+	if (now < due) {
+		const double dt = due - now;
+		struct timespec ts;
+
+		ts.tv_sec = (time_t)dt;
+		ts.tv_nsec = (long)((dt - (double)ts.tv_sec) * 1000000000.0);
+		(void)nanosleep(&ts, NULL);
+	} else if (now - due > BW_PACE_SLACK) {
+		pace->start = now - (pace->bytes / pace->rate);
+	}
+}
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2013-2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+
+#include "stress-ng.h"
+
+/*
+ *  stress_usage_get()
+ *	account the scheduler delay, peak RSS, context switches
+ *	and faults of a stressor instance as it exits. The run
+ *	delay is that of the instance's own thread, the rusage of
+ *	a process instance includes its reaped children and that
+ *	of a threaded instance is just the thread. The I/O of a
+ *	threaded instance is process wide, see stress_usage_get_io
+ */
+void stress_usage_get(proc_usage_t *usage)
+{
+	struct rusage self;
+
+	memset(usage, 0, sizeof(*usage));
+#if defined(__linux__)
+	{
+		char buf[128];
+		unsigned long long run, delay;
+
+		if ((system_read("/proc/thread-self/schedstat", buf, sizeof(buf) - 1) > 0) &&
+		    (sscanf(buf, "%llu %llu", &run, &delay) == 2)) {
+			usage->run_nsec = (uint64_t)run;
+			usage->delay_nsec = (uint64_t)delay;
+			usage->sched_ok = true;
+		}
+	}
+#endif
+
+#if defined(RUSAGE_THREAD)
+	if (stress_thread_instance) {
+		if (getrusage(RUSAGE_THREAD, &self) < 0)
+			return;
+	} else
+#endif
+	{
+		struct rusage children;
+
+		if ((getrusage(RUSAGE_SELF, &self) < 0) ||
+		    (getrusage(RUSAGE_CHILDREN, &children) < 0))
+			return;
+		/* ru_maxrss of the children is that of the largest child */
+		if (children.ru_maxrss > self.ru_maxrss)
+			self.ru_maxrss = children.ru_maxrss;
+		self.ru_nvcsw += children.ru_nvcsw;
+		self.ru_nivcsw += children.ru_nivcsw;
+		self.ru_minflt += children.ru_minflt;
+		self.ru_majflt += children.ru_majflt;
+	}
+	usage->maxrss = (uint64_t)self.ru_maxrss;
+	usage->nvcsw = (uint64_t)self.ru_nvcsw;
+	usage->nivcsw = (uint64_t)self.ru_nivcsw;
+	usage->minflt = (uint64_t)self.ru_minflt;
+	usage->majflt = (uint64_t)self.ru_majflt;
+	usage->rusage_ok = true;
+
+	if (!stress_thread_instance)
+		stress_usage_get_io(usage);
+}
+
+/*
+ *  stress_usage_get_io()
+ *	account the device I/O of the process and its reaped
+ *	children
+ */
+void stress_usage_get_io(proc_usage_t *usage)
+{
+	stress_io_stats_t io;
+
+	if (!io_stats_get(&io))
+		return;
+	usage->read_bytes = io.read_bytes;
+	usage->write_bytes = io.write_bytes;
+	usage->io_ok = true;
+}
+
+/*
+ *  stress_usage_total()
+ *	sum the accounting of the instances of stressor i, the
+ *	peak RSS is that of the largest instance. Returns the
+ *	summed wall clock time of the instances
+ */
+static double stress_usage_total(
+	const int32_t i,
+	const proc_info_t procs[STRESS_MAX],
+	proc_usage_t *total)
+{
+	int32_t j, n = procs[i].stats_index;
+	double wall = 0.0;
+
+	memset(total, 0, sizeof(*total));
+	for (j = 0; j < procs[i].started_procs; j++, n++) {
+		const proc_usage_t *usage = &shared->stats[n].usage;
+
+		wall += shared->stats[n].finish - shared->stats[n].start;
+		if (usage->sched_ok) {
+			total->run_nsec += usage->run_nsec;
+			total->delay_nsec += usage->delay_nsec;
+			total->sched_ok = true;
+		}
+		if (usage->rusage_ok) {
+			if (usage->maxrss > total->maxrss)
+				total->maxrss = usage->maxrss;
+			total->nvcsw += usage->nvcsw;
+			total->nivcsw += usage->nivcsw;
+			total->minflt += usage->minflt;
+			total->majflt += usage->majflt;
+			total->rusage_ok = true;
+		}
+		if (usage->io_ok) {
+			total->read_bytes += usage->read_bytes;
+			total->write_bytes += usage->write_bytes;
+			total->io_ok = true;
+		}
+	}
+	return wall;
+}
+
+/*
+ *  stress_usage_metrics()
+ *	add the accounting of stressor i to its YAML and JSON
+ *	metrics entry
+ */
+void stress_usage_metrics(
+	FILE *yaml,
+	json_t *json,
+	const int32_t i,
+	const proc_info_t procs[STRESS_MAX])
+{
+	proc_usage_t total;
+	const double wall = stress_usage_total(i, procs, &total);
+
+	if (total.sched_ok) {
+		const double delay = (double)total.delay_nsec / 1.0E9;
+
+		pr_yaml(yaml, "      run-delay-time: %f\n", delay);
+		pr_yaml(yaml, "      run-delay-percent: %f\n",
+			wall > 0.0 ? 100.0 * delay / wall : 0.0);
+		json_double(json, "run-delay-time", delay);
+		json_double(json, "run-delay-percent",
+			wall > 0.0 ? 100.0 * delay / wall : 0.0);
+	}
+	if (total.rusage_ok) {
+		pr_yaml(yaml, "      max-rss-kb: %" PRIu64 "\n", total.maxrss);
+		pr_yaml(yaml, "      voluntary-context-switches: %" PRIu64 "\n", total.nvcsw);
+		pr_yaml(yaml, "      involuntary-context-switches: %" PRIu64 "\n", total.nivcsw);
+		pr_yaml(yaml, "      minor-page-faults: %" PRIu64 "\n", total.minflt);
+		pr_yaml(yaml, "      major-page-faults: %" PRIu64 "\n", total.majflt);
+		json_uint(json, "max-rss-kb", total.maxrss);
+		json_uint(json, "voluntary-context-switches", total.nvcsw);
+		json_uint(json, "involuntary-context-switches", total.nivcsw);
+		json_uint(json, "minor-page-faults", total.minflt);
+		json_uint(json, "major-page-faults", total.majflt);
+	}
+	if (total.io_ok) {
+		pr_yaml(yaml, "      device-read-bytes: %" PRIu64 "\n", total.read_bytes);
+		pr_yaml(yaml, "      device-write-bytes: %" PRIu64 "\n", total.write_bytes);
+		json_uint(json, "device-read-bytes", total.read_bytes);
+		json_uint(json, "device-write-bytes", total.write_bytes);
+	}
+}
+
+/*
+ *  stress_usage_dump()
+ *	report the share of the run time each stressor spent
+ *	runnable but waiting for a CPU next to its memory, context
+ *	switch, fault and device I/O accounting
+ */
+void stress_usage_dump(
+	const stress_t stressors[],
+	const proc_info_t procs[STRESS_MAX])
+{
+	int32_t i;
+	bool header = false;
+
+	for (i = 0; i < STRESS_MAX; i++) {
+		proc_usage_t total;
+		double wall;
+		char delay[16];
+
+		if (!procs[i].started_procs)
+			continue;
+		wall = stress_usage_total(i, procs, &total);
+		if (!total.sched_ok && !total.rusage_ok)
+			continue;
+		if (!header) {
+			pr_inf(stdout, "%-13s %7s %10s %10s %10s %10s %8s %10s %10s\n",
+				"stressor", "wait %", "max RSS K", "vol csw",
+				"invol csw", "min flt", "maj flt", "read K", "write K");
+			header = true;
+		}
+		if (total.sched_ok && (wall > 0.0))
+			(void)snprintf(delay, sizeof(delay), "%7.2f",
+				100.0 * ((double)total.delay_nsec / 1.0E9) / wall);
+		else
+			(void)snprintf(delay, sizeof(delay), "%7s", "-");
+		pr_inf(stdout, "%-13s %s %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+			" %10" PRIu64 " %8" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n",
+			munge_underscore(stressors[i].name), delay, total.maxrss,
+			total.nvcsw, total.nivcsw, total.minflt, total.majflt,
+			(uint64_t)(total.read_bytes / KB),
+			(uint64_t)(total.write_bytes / KB));
+	}
+}
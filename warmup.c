@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2016 Canonical, Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * This code is a complete clean re-write of the stress tool by
+ * Colin Ian King <colin.king@canonical.com> and attempts to be
+ * backwardly compatible with the stress tool by Amos Waterland
+ * <apw@rossby.metr.ou.edu> but has more stress tests and more
+ * functionality.
+ *
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+
+#include "stress-ng.h"
+
+#if defined(STRESS_WARMUP)
+
+#include <pthread.h>
+
+#define WARMUP_STACK_SIZE	(64 * 1024)
+
+uint64_t opt_warmup = 0;		/* warm-up time in seconds */
+
+static pthread_t warmup_pthread;
+static pthread_mutex_t warmup_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t warmup_cond = PTHREAD_COND_INITIALIZER;
+static bool warmup_keep_waiting;
+static bool warmup_pthread_running;
+static bool warmup_done;
+
+static int32_t warmup_slot;		/* shared stats slot of the instance */
+
+/*
+ *  stress_set_warmup()
+ *	set the time at the start of a run that is
+ *	excluded from the metrics
+ */
+void stress_set_warmup(const char *optarg)
+{
+	opt_warmup = get_uint64_time(optarg);
+}
+
+/*
+ *  warmup_snapshot()
+ *	the warm-up has ended, restart the start time, remember
+ *	the op count and run time so far and reset the perf
+ *	counters and latency histogram
+ */
+static void warmup_snapshot(void)
+{
+	proc_stats_t *stats = &shared->stats[warmup_slot];
+
+	stats->warmup_counter = shared->counters[warmup_slot].counter;
+	(void)times(&stats->warmup_tms);
+	stats->start = time_now();
+#if defined(STRESS_PERF_STATS)
+	if (opt_flags & OPT_FLAGS_PERF_STATS)
+		(void)perf_enable(&shared->perf_stats[warmup_slot]);
+#endif
+#if defined(STRESS_LATENCY)
+	/* Racy with the stressor, at worst a sample is lost */
+	if (opt_flags & OPT_FLAGS_LATENCY)
+		memset(&shared->lat_stats[warmup_slot], 0,
+			sizeof(shared->lat_stats[warmup_slot]));
+#endif
+	warmup_done = true;
+}
+
+/*
+ *  warmup_thread()
+ *	wait for the warm-up time to elapse and then take
+ *	the snapshot, unless told to stop before then
+ */
+static void *warmup_thread(void *arg)
+{
+	static void *nowt = NULL;
+	struct timespec abstime;
+
+	(void)arg;
+
+	(void)clock_gettime(CLOCK_REALTIME, &abstime);
+	abstime.tv_sec += opt_warmup;
+
+	pthread_mutex_lock(&warmup_mutex);
+	while (warmup_keep_waiting) {
+		if (pthread_cond_timedwait(&warmup_cond, &warmup_mutex, &abstime) == ETIMEDOUT) {
+			warmup_snapshot();
+			break;
+		}
+	}
+	pthread_mutex_unlock(&warmup_mutex);
+
+	return &nowt;
+}
+
+/*
+ *  warmup_start()
+ *	called by a stressor instance before it starts to
+ *	run, start the warm-up timer thread
+ */
+void warmup_start(const int32_t slot)
+{
+	pthread_attr_t attr;
+	sigset_t set, oldset;
+	int ret;
+
+	if (!opt_warmup)
+		return;
+
+	warmup_slot = slot;
+	warmup_keep_waiting = true;
+	warmup_done = false;
+
+	(void)pthread_attr_init(&attr);
+	(void)pthread_attr_setstacksize(&attr, WARMUP_STACK_SIZE);
+
+	/* Leave all signal handling to the stressor, the thread inherits the mask */
+	sigfillset(&set);
+	(void)pthread_sigmask(SIG_BLOCK, &set, &oldset);
+	ret = pthread_create(&warmup_pthread, &attr, warmup_thread, NULL);
+	(void)pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+	(void)pthread_attr_destroy(&attr);
+
+	if (ret) {
+		pr_dbg(stderr, "warmup: cannot create warm-up thread: "
+			"errno=%d (%s)\n", ret, strerror(ret));
+		return;
+	}
+	warmup_pthread_running = true;
+}
+
+/*
+ *  warmup_stop()
+ *	called by a stressor instance after it has finished and
+ *	the run times are gathered, stop the warm-up thread and
+ *	remove the warm-up run time from the run times
+ */
+void warmup_stop(proc_stats_t *stats)
+{
+	if (!warmup_pthread_running)
+		return;
+
+	pthread_mutex_lock(&warmup_mutex);
+	warmup_keep_waiting = false;
+	pthread_cond_signal(&warmup_cond);
+	pthread_mutex_unlock(&warmup_mutex);
+	(void)pthread_join(warmup_pthread, NULL);
+	warmup_pthread_running = false;
+
+	if (!warmup_done) {
+		pr_dbg(stderr, "warmup: instance finished before the end "
+			"of the warm-up time, all metrics are included\n");
+		return;
+	}
+	stats->tms.tms_utime -= stats->warmup_tms.tms_utime;
+	stats->tms.tms_stime -= stats->warmup_tms.tms_stime;
+	stats->tms.tms_cutime -= stats->warmup_tms.tms_cutime;
+	stats->tms.tms_cstime -= stats->warmup_tms.tms_cstime;
+}
+
+#endif